@@ -0,0 +1,232 @@
+#ifndef COROUTINEDECISIONMODEL_H
+#define COROUTINEDECISIONMODEL_H
+
+#include "IAgtDecisionModel.h"
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace agents {
+
+/**
+ * The memory of the coroutine frames of the agents of an engine: blocks of
+ * a few size classes, reused once their coroutine ends, so that creating and
+ * ending the behaviors of many agents does not go through the global heap.
+ * The frames larger than the classes are allocated from the heap.
+ *
+ * The pool can be used from any thread; it must outlive its frames.
+ */
+class CoroutineFramePool {
+public:
+  /** The size of the largest class of blocks, in bytes. */
+  static constexpr std::size_t MAX_POOLED_BYTES = 1024;
+
+  CoroutineFramePool() = default;
+  ~CoroutineFramePool();
+
+  CoroutineFramePool(const CoroutineFramePool &) = delete;
+  CoroutineFramePool &operator=(const CoroutineFramePool &) = delete;
+
+  void *allocate(std::size_t bytes);
+  void deallocate(void *block, std::size_t bytes);
+
+  /** Gets the number of blocks in use. */
+  std::size_t getLiveBlocks() const;
+
+  /** Gets the number of blocks obtained from the heap so far. */
+  std::size_t getAllocatedBlocks() const;
+
+  /** The pool of the frames created by the current thread, see Scope. */
+  static CoroutineFramePool *current();
+
+  /** Makes a pool the current one of the thread, while it lives. */
+  class Scope {
+  public:
+    explicit Scope(CoroutineFramePool *pool);
+    ~Scope();
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    CoroutineFramePool *previous;
+  };
+
+private:
+  // the classes of 64, 128, 256, 512 and 1024 bytes
+  static constexpr std::size_t CLASSES = 5;
+
+  mutable std::mutex mutex;
+  std::vector<void *> freeBlocks[CLASSES];
+  std::size_t liveBlocks = 0;
+  std::size_t allocatedBlocks = 0;
+
+  static std::size_t classOf(std::size_t bytes);
+};
+
+/**
+ * What a decision coroutine reads at each step: the arguments of the
+ * decide() call resuming it. The coroutine keeps a reference to it.
+ */
+struct DecisionContext {
+  microkernel::SimulationTimeStamp timeLowerBound{0};
+  microkernel::SimulationTimeStamp timeUpperBound{0};
+  microkernel::agents::IGlobalState *globalState = nullptr;
+  microkernel::agents::ILocalStateOfAgent *publicLocalState = nullptr;
+  microkernel::agents::ILocalStateOfAgent *privateLocalState = nullptr;
+  microkernel::agents::IPerceivedData *perceivedData = nullptr;
+
+  /** Gets the perceived data as the type of the perception model. */
+  template <typename Data> const Data &perceived() const {
+    return static_cast<const Data &>(*perceivedData);
+  }
+
+  // the influences of the running step
+  microkernel::influences::InfluencesMap *producedInfluences = nullptr;
+};
+
+/** Yielded by a decision coroutine to end the decisions of a step. */
+struct NextStep {};
+
+/** The end of the step, for co_yield nextStep. */
+inline constexpr NextStep nextStep{};
+
+/**
+ * A multi-step behavior of an agent, written as a coroutine: each
+ * co_yield of an influence emits it, and co_yield nextStep suspends the
+ * behavior until the decision of the next step, e.g.
+ *
+ *   DecisionCoroutine forage(const DecisionContext &context) {
+ *     while (true) {
+ *       while (!foundFood(context)) {
+ *         co_yield makeInfluence<Move>(...);
+ *         co_yield nextStep;
+ *       }
+ *       ...
+ *     }
+ *   }
+ *
+ * The mode of the agent is where its coroutine is suspended, and its
+ * locals are the state of the behavior, so that the decisions neither
+ * branch nor dispatch on a mode. The frames come from the current
+ * CoroutineFramePool. A behavior returning decides nothing from then on.
+ */
+class DecisionCoroutine {
+public:
+  struct promise_type {
+    microkernel::influences::InfluencesMap *influences = nullptr;
+    std::exception_ptr error;
+
+    DecisionCoroutine get_return_object() {
+      return DecisionCoroutine(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    // The behavior starts at the first decision
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { error = std::current_exception(); }
+
+    std::suspend_never
+    yield_value(std::shared_ptr<microkernel::influences::IInfluence> influence);
+    std::suspend_always yield_value(NextStep) { return {}; }
+
+    static void *operator new(std::size_t bytes);
+    static void operator delete(void *frame, std::size_t bytes);
+  };
+
+  DecisionCoroutine() = default;
+  DecisionCoroutine(DecisionCoroutine &&other) noexcept
+      : handle(other.handle) {
+    other.handle = nullptr;
+  }
+  DecisionCoroutine &operator=(DecisionCoroutine &&other) noexcept;
+  ~DecisionCoroutine();
+
+  DecisionCoroutine(const DecisionCoroutine &) = delete;
+  DecisionCoroutine &operator=(const DecisionCoroutine &) = delete;
+
+  /** Whether the behavior returned, or was never created. */
+  bool done() const { return !handle || handle.done(); }
+
+  /**
+   * Runs the behavior until its next co_yield nextStep, emitting its
+   * influences into a map.
+   * @throws The exception ending the behavior.
+   */
+  void resume(microkernel::influences::InfluencesMap &influences);
+
+private:
+  explicit DecisionCoroutine(std::coroutine_handle<promise_type> handle)
+      : handle(handle) {}
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+/**
+ * The decision model of an agent running a DecisionCoroutine: the first
+ * decision creates the coroutine in the frame pool, and each decision
+ * resumes it on the thread of the engine calling decide(). The model holds
+ * the state of a single agent: each agent needs its own instance, which
+ * the clones of the agents share.
+ */
+class CoroutineDecisionModel : public IAgtDecisionModel {
+public:
+  using Behavior = std::function<DecisionCoroutine(const DecisionContext &)>;
+
+  /**
+   * @param pool The pool of the frames, shared by the agents of an engine;
+   * nullptr for the heap.
+   */
+  CoroutineDecisionModel(const microkernel::LevelIdentifier &level,
+                         Behavior behavior,
+                         std::shared_ptr<CoroutineFramePool> pool = nullptr)
+      : level(level), behavior(std::move(behavior)), pool(std::move(pool)) {}
+
+  ~CoroutineDecisionModel() override {
+    // The frame is released before its pool
+    coroutine = DecisionCoroutine();
+  }
+
+  microkernel::LevelIdentifier getLevel() const override { return level; }
+
+  /** Whether the behavior was started and returned. */
+  bool isDone() const { return started && coroutine.done(); }
+
+  void decide(const microkernel::SimulationTimeStamp &timeLowerBound,
+              const microkernel::SimulationTimeStamp &timeUpperBound,
+              std::shared_ptr<microkernel::agents::IGlobalState> globalState,
+              std::shared_ptr<microkernel::agents::ILocalStateOfAgent>
+                  publicLocalState,
+              std::shared_ptr<microkernel::agents::ILocalStateOfAgent>
+                  privateLocalState,
+              std::shared_ptr<microkernel::agents::IPerceivedData>
+                  perceivedData,
+              std::shared_ptr<microkernel::influences::InfluencesMap>
+                  producedInfluences) override;
+
+private:
+  microkernel::LevelIdentifier level;
+  Behavior behavior;
+  std::shared_ptr<CoroutineFramePool> pool;
+  DecisionContext context;
+  DecisionCoroutine coroutine;
+  bool started = false;
+};
+
+} // namespace agents
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // COROUTINEDECISIONMODEL_H
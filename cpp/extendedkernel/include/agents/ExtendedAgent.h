@@ -4,6 +4,8 @@
 #include "IAgtDecisionModel.h"
 #include "IAgtGlobalStateRevisionModel.h"
 #include "IAgtPerceptionModel.h"
+#include "../libs/random/RandomStream.h"
+#include "checkpoint/ICheckpointable.h"
 #include "libs/AbstractAgent.h"
 #include <map>
 #include <memory>
@@ -19,14 +21,17 @@ namespace agents {
 /**
  * Models an agent in the extended kernel.
  * The behavior is defined in separate model classes for modularity.
+ * Its checkpoints hold its random stream.
  */
-class ExtendedAgent : public similar::microkernel::libs::AbstractAgent {
+class ExtendedAgent : public similar::microkernel::libs::AbstractAgent,
+                      public microkernel::checkpoint::ICheckpointable {
 private:
   std::map<microkernel::LevelIdentifier, std::shared_ptr<IAgtPerceptionModel>>
       perceptionModels;
   std::shared_ptr<IAgtGlobalStateRevisionModel> globalStateRevisionModel;
   std::map<microkernel::LevelIdentifier, std::shared_ptr<IAgtDecisionModel>>
       decisionModels;
+  std::shared_ptr<libs::random::RandomStream> randomStream;
 
 public:
   explicit ExtendedAgent(const microkernel::AgentCategory &category);
@@ -38,14 +43,14 @@ public: // Expose base class methods
   using similar::microkernel::libs::AbstractAgent::initializeGlobalState;
 
   // Extended agent methods
-  std::shared_ptr<IAgtGlobalStateRevisionModel>
+  const std::shared_ptr<IAgtGlobalStateRevisionModel> &
   getGlobalStateRevisionModel() const;
   void specifyGlobalStateRevisionModel(
       std::shared_ptr<IAgtGlobalStateRevisionModel> revisionMdl);
 
-  std::shared_ptr<IAgtPerceptionModel>
+  const std::shared_ptr<IAgtPerceptionModel> &
   getPerceptionModel(const microkernel::LevelIdentifier &levelId) const;
-  std::shared_ptr<IAgtDecisionModel>
+  const std::shared_ptr<IAgtDecisionModel> &
   getDecisionModel(const microkernel::LevelIdentifier &levelId) const;
 
   void
@@ -55,6 +60,21 @@ public: // Expose base class methods
 
   void removeBehaviorForLevel(const microkernel::LevelIdentifier &levelId);
 
+  /**
+   * Gives the agent its own random stream. While the agent perceives,
+   * revises its global state and decides, the PRNG methods draw from it.
+   * @param stream The stream of the agent, or nullptr to use the global
+   * generator.
+   */
+  void setRandomStream(std::shared_ptr<libs::random::RandomStream> stream);
+
+  std::shared_ptr<libs::random::RandomStream> getRandomStream() const;
+
+  void writeCheckpoint(
+      microkernel::checkpoint::CheckpointWriter &writer) const override;
+  void
+  readCheckpoint(microkernel::checkpoint::CheckpointReader &reader) override;
+
   // Microkernel agent interface implementations
   std::shared_ptr<microkernel::agents::IPerceivedData> perceive(
       const microkernel::LevelIdentifier &level,
@@ -8,6 +8,7 @@
 #include "../../../microkernel/include/dynamicstate/IPublicDynamicStateMap.h"
 #include <map>
 #include <memory>
+#include <utility>
 
 namespace fr {
 namespace univ_artois {
@@ -42,6 +43,31 @@ public:
           privateLocalState,
       std::shared_ptr<microkernel::dynamicstate::IPublicDynamicStateMap>
           dynamicStates) = 0;
+
+  /**
+   * Creates the data perceived by an agent, refilling the data it perceived
+   * at the previous step. The data were reset (see
+   * microkernel::agents::IPerceivedData::reset()) and are only held by the
+   * agent. By default, the recycled data are dropped for new ones.
+   * @param recycled The data of the previous perception of the agent.
+   * @return The perceived data, usually the recycled ones.
+   */
+  virtual std::shared_ptr<microkernel::agents::IPerceivedData>
+  perceiveInPlace(
+      const microkernel::SimulationTimeStamp &timeLowerBound,
+      const microkernel::SimulationTimeStamp &timeUpperBound,
+      const std::map<microkernel::LevelIdentifier,
+                     std::shared_ptr<microkernel::agents::ILocalStateOfAgent>>
+          &publicLocalStates,
+      std::shared_ptr<microkernel::agents::ILocalStateOfAgent>
+          privateLocalState,
+      std::shared_ptr<microkernel::dynamicstate::IPublicDynamicStateMap>
+          dynamicStates,
+      const std::shared_ptr<microkernel::agents::IPerceivedData>
+          & /*recycled*/) {
+    return perceive(timeLowerBound, timeUpperBound, publicLocalStates,
+                    std::move(privateLocalState), std::move(dynamicStates));
+  }
 };
 
 } // namespace agents
@@ -0,0 +1,304 @@
+#ifndef STATICEXTENDEDAGENT_H
+#define STATICEXTENDEDAGENT_H
+
+#include "ExtendedAgent.h"
+#include "engine/IAgentStepKernel.h"
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace agents {
+
+/**
+ * An extended agent whose behavior in one level is bound at compile time.
+ *
+ * The agent holds its models by value and calls them directly, without
+ * virtual calls nor lookups in the maps of ExtendedAgent. It also gives the
+ * engines a step kernel (see microkernel::engine::IAgentStepKernel), which
+ * steps the agents of the same type in that level in one batch.
+ *
+ * The models are copyable classes with the following methods, usually not
+ * virtual so that the compiler inlines them:
+ * - Perception: std::shared_ptr<P> perceive(timeLowerBound, timeUpperBound,
+ *   publicLocalState, privateLocalState, dynamicStates), where P is an
+ *   IPerceivedData, the data perceived in the bound level;
+ * - Revision: void reviseGlobalState(timeLowerBound, timeUpperBound,
+ *   perceivedData, globalState), with the data of the bound level;
+ * - Decision: void decide(timeLowerBound, timeUpperBound, globalState,
+ *   publicLocalState, privateLocalState, perceivedData,
+ *   producedInfluences).
+ * The shared pointers are passed by constant reference.
+ *
+ * The behaviors specified for other levels with specifyBehaviorForLevel()
+ * still run through the virtual path. Derived classes override clone().
+ */
+template <typename Perception, typename Decision, typename Revision>
+class StaticExtendedAgent : public ExtendedAgent {
+public:
+  using PerceivedDataPtr = decltype(std::declval<Perception &>().perceive(
+      std::declval<const microkernel::SimulationTimeStamp &>(),
+      std::declval<const microkernel::SimulationTimeStamp &>(),
+      std::declval<
+          const std::shared_ptr<microkernel::agents::ILocalStateOfAgent> &>(),
+      std::declval<
+          const std::shared_ptr<microkernel::agents::ILocalStateOfAgent> &>(),
+      std::declval<const std::shared_ptr<
+          microkernel::dynamicstate::IPublicDynamicStateMap> &>()));
+  using PerceivedData = typename PerceivedDataPtr::element_type;
+
+private:
+  /**
+   * Steps the agents of this type one after the other, in their bound level.
+   */
+  class StepKernel : public microkernel::engine::IAgentStepKernel {
+  public:
+    void step(const microkernel::LevelIdentifier &,
+              const microkernel::SimulationTimeStamp &timeLowerBound,
+              const microkernel::SimulationTimeStamp &timeUpperBound,
+              microkernel::agents::IAgent4Engine *const *agents,
+              std::size_t count,
+              const std::shared_ptr<
+                  microkernel::dynamicstate::IPublicDynamicStateMap>
+                  &dynamicStates,
+              const std::shared_ptr<microkernel::influences::InfluencesMap>
+                  &producedInfluences) const override {
+      for (std::size_t i = 0; i < count; ++i) {
+        // Only the agents of this type return this kernel
+        static_cast<StaticExtendedAgent &>(*agents[i])
+            .stepBoundLevel(timeLowerBound, timeUpperBound, dynamicStates,
+                            producedInfluences);
+      }
+    }
+  };
+
+  static const StepKernel &stepKernel() {
+    static const StepKernel kernel;
+    return kernel;
+  }
+
+  microkernel::LevelIdentifier boundLevel;
+  Perception perception;
+  Decision decision;
+  Revision revision;
+
+  // The states of the agent in the bound level, null while it lies outside
+  std::shared_ptr<microkernel::agents::ILocalStateOfAgent> publicState;
+  std::shared_ptr<microkernel::agents::ILocalStateOfAgent> privateState;
+  // The data lastly perceived in the bound level, a PerceivedData
+  std::shared_ptr<microkernel::agents::IPerceivedData> perceivedData;
+
+  using RandomScope = std::optional<libs::random::RandomStream::Scope>;
+
+  void installRandomStream(RandomScope &scope) const {
+    if (const auto stream = getRandomStream()) {
+      scope.emplace(*stream);
+    }
+  }
+
+  void stepBoundLevel(
+      const microkernel::SimulationTimeStamp &timeLowerBound,
+      const microkernel::SimulationTimeStamp &timeUpperBound,
+      const std::shared_ptr<microkernel::dynamicstate::IPublicDynamicStateMap>
+          &dynamicStates,
+      const std::shared_ptr<microkernel::influences::InfluencesMap>
+          &producedInfluences) {
+    RandomScope scope;
+    installRandomStream(scope);
+    PerceivedDataPtr data =
+        perception.perceive(timeLowerBound, timeUpperBound, publicState,
+                            privateState, dynamicStates);
+    const auto &globalState = borrowGlobalState();
+    revision.reviseGlobalState(timeLowerBound, timeUpperBound, data,
+                               globalState);
+    decision.decide(timeLowerBound, timeUpperBound, globalState, publicState,
+                    privateState, data, producedInfluences);
+    perceivedData = std::move(data);
+  }
+
+public:
+  /**
+   * Creates an agent behaving with the given models in a level.
+   * @param category The category of the agent
+   * @param level The level of the models
+   */
+  StaticExtendedAgent(const microkernel::AgentCategory &category,
+                      const microkernel::LevelIdentifier &level,
+                      Perception perception, Decision decision,
+                      Revision revision)
+      : ExtendedAgent(category), boundLevel(level),
+        perception(std::move(perception)), decision(std::move(decision)),
+        revision(std::move(revision)) {}
+
+  StaticExtendedAgent(const StaticExtendedAgent &other)
+      : ExtendedAgent(other), boundLevel(other.boundLevel),
+        perception(other.perception), decision(other.decision),
+        revision(other.revision), perceivedData(other.perceivedData) {
+    // The states were cloned by the copy of the base class
+    if (other.publicState) {
+      publicState = getPublicLocalState(boundLevel);
+      privateState = getPrivateLocalState(boundLevel);
+    }
+  }
+
+  const microkernel::LevelIdentifier &getBoundLevel() const {
+    return boundLevel;
+  }
+
+  Perception &getPerception() { return perception; }
+  Decision &getDecision() { return decision; }
+  Revision &getRevision() { return revision; }
+
+  /**
+   * Gets the data lastly perceived in the bound level, or nullptr.
+   */
+  std::shared_ptr<PerceivedData> getLastPerceivedData() const {
+    return std::static_pointer_cast<PerceivedData>(perceivedData);
+  }
+
+  void includeNewLevel(
+      const microkernel::LevelIdentifier &levelIdentifier,
+      std::shared_ptr<microkernel::agents::ILocalStateOfAgent>
+          publicLocalState,
+      std::shared_ptr<microkernel::agents::ILocalStateOfAgent>
+          privateLocalState) override {
+    ExtendedAgent::includeNewLevel(levelIdentifier, publicLocalState,
+                                   privateLocalState);
+    if (levelIdentifier == boundLevel) {
+      publicState = std::move(publicLocalState);
+      privateState = std::move(privateLocalState);
+    }
+  }
+
+  void excludeFromLevel(
+      const microkernel::LevelIdentifier &levelIdentifier) override {
+    ExtendedAgent::excludeFromLevel(levelIdentifier);
+    if (levelIdentifier == boundLevel) {
+      publicState.reset();
+      privateState.reset();
+      perceivedData.reset();
+    }
+  }
+
+  std::map<microkernel::LevelIdentifier,
+           std::shared_ptr<microkernel::agents::IPerceivedData>>
+  getPerceivedData() const override {
+    auto data = ExtendedAgent::getPerceivedData();
+    if (perceivedData) {
+      data[boundLevel] = perceivedData;
+    }
+    return data;
+  }
+
+  /**
+   * Sets the data lastly perceived; the data of the bound level are the
+   * ones the perception model of this agent returned.
+   */
+  void setPerceivedData(std::shared_ptr<microkernel::agents::IPerceivedData>
+                            data) override {
+    if (data != nullptr && data->getLevel() == boundLevel) {
+      perceivedData = std::move(data);
+    } else {
+      ExtendedAgent::setPerceivedData(std::move(data));
+    }
+  }
+
+  const std::shared_ptr<microkernel::agents::IPerceivedData> &
+  borrowLastPerceivedData(
+      const microkernel::LevelIdentifier &levelIdentifier) const override {
+    if (levelIdentifier == boundLevel) {
+      return perceivedData;
+    }
+    return ExtendedAgent::borrowLastPerceivedData(levelIdentifier);
+  }
+
+  const microkernel::engine::IAgentStepKernel *getStepKernel(
+      const microkernel::LevelIdentifier &levelIdentifier) const override {
+    return publicState && levelIdentifier == boundLevel ? &stepKernel()
+                                                        : nullptr;
+  }
+
+  std::shared_ptr<microkernel::agents::IPerceivedData> perceive(
+      const microkernel::LevelIdentifier &level,
+      const microkernel::SimulationTimeStamp &timeLowerBound,
+      const microkernel::SimulationTimeStamp &timeUpperBound,
+      const std::map<microkernel::LevelIdentifier,
+                     std::shared_ptr<microkernel::agents::ILocalStateOfAgent>>
+          &publicLocalStates,
+      std::shared_ptr<microkernel::agents::ILocalStateOfAgent>
+          privateLocalState,
+      std::shared_ptr<microkernel::dynamicstate::IPublicDynamicStateMap>
+          dynamicStates) final {
+    if (!(level == boundLevel)) {
+      return ExtendedAgent::perceive(level, timeLowerBound, timeUpperBound,
+                                     publicLocalStates, privateLocalState,
+                                     dynamicStates);
+    }
+    RandomScope scope;
+    installRandomStream(scope);
+    return perception.perceive(timeLowerBound, timeUpperBound, publicState,
+                               privateLocalState, dynamicStates);
+  }
+
+  /**
+   * Revises the global state from the data perceived in the bound level,
+   * the ones lastly perceived if the map lacks them.
+   */
+  void reviseGlobalState(
+      const microkernel::SimulationTimeStamp &timeLowerBound,
+      const microkernel::SimulationTimeStamp &timeUpperBound,
+      const std::map<microkernel::LevelIdentifier,
+                     std::shared_ptr<microkernel::agents::IPerceivedData>>
+          &perceivedData,
+      std::shared_ptr<microkernel::agents::IGlobalState> globalState) final {
+    auto it = perceivedData.find(boundLevel);
+    const auto data = std::static_pointer_cast<PerceivedData>(
+        it != perceivedData.end() ? it->second : this->perceivedData);
+    RandomScope scope;
+    installRandomStream(scope);
+    revision.reviseGlobalState(timeLowerBound, timeUpperBound, data,
+                               globalState);
+  }
+
+  void decide(
+      const microkernel::LevelIdentifier &levelId,
+      const microkernel::SimulationTimeStamp &timeLowerBound,
+      const microkernel::SimulationTimeStamp &timeUpperBound,
+      std::shared_ptr<microkernel::agents::IGlobalState> globalState,
+      std::shared_ptr<microkernel::agents::ILocalStateOfAgent> publicLocalState,
+      std::shared_ptr<microkernel::agents::ILocalStateOfAgent>
+          privateLocalState,
+      std::shared_ptr<microkernel::agents::IPerceivedData> perceivedData,
+      std::shared_ptr<microkernel::influences::InfluencesMap>
+          producedInfluences) final {
+    if (!(levelId == boundLevel)) {
+      ExtendedAgent::decide(levelId, timeLowerBound, timeUpperBound,
+                            globalState, publicLocalState, privateLocalState,
+                            perceivedData, producedInfluences);
+      return;
+    }
+    RandomScope scope;
+    installRandomStream(scope);
+    decision.decide(timeLowerBound, timeUpperBound, globalState,
+                    publicLocalState, privateLocalState,
+                    std::static_pointer_cast<PerceivedData>(perceivedData),
+                    producedInfluences);
+  }
+
+  std::shared_ptr<microkernel::agents::IAgent> clone() const override {
+    return std::make_shared<StaticExtendedAgent>(*this);
+  }
+};
+
+} // namespace agents
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // STATICEXTENDEDAGENT_H
@@ -28,7 +28,7 @@ namespace levels {
  * - The behavior of the level can evolve at runtime
  * - Separation of concerns between structure and behavior
  */
-class ExtendedLevel : public microkernel::libs::AbstractLevel {
+class ExtendedLevel : public microkernel::libs::abstractimpl::AbstractLevel {
 private:
   std::shared_ptr<microkernel::levels::ITimeModel> timeModel;
   std::shared_ptr<ILevelReactionModel> reactionModel;
@@ -111,6 +111,7 @@ public:
     getReactionModel()->makeRegularReaction(
         transitoryTimeMin, transitoryTimeMax, consistentState,
         regularInfluencesOftransitoryStateDynamics, remainingInfluences);
+    updateSpatialIndex();
   }
 
   void makeSystemReaction(
@@ -128,12 +129,28 @@ public:
         transitoryTimeMin, transitoryTimeMax, consistentState,
         systemInfluencesToManage, happensBeforeRegularReaction,
         newInfluencesToProcess);
+    updateSpatialIndex();
+  }
+
+  void prepareNaturalDynamics(
+      const microkernel::SimulationTimeStamp &transitoryTimeMin,
+      const microkernel::SimulationTimeStamp &transitoryTimeMax) override {
+    getReactionModel()->prepareNaturalDynamics(
+        transitoryTimeMin, transitoryTimeMax, getLastConsistentState());
   }
 
   microkernel::SimulationTimeStamp
   getNextTime(const microkernel::SimulationTimeStamp &currentTime) override {
     return getTimeModel()->getNextTime(currentTime);
   }
+
+  /**
+   * Clones the level with its states; the clone shares the time model and
+   * the reaction model of this level.
+   */
+  std::shared_ptr<microkernel::levels::ILevel> clone() const override {
+    return std::make_shared<ExtendedLevel>(*this);
+  }
 };
 
 } // namespace levels
@@ -75,6 +75,24 @@ public:
       bool happensBeforeRegularReaction,
       std::shared_ptr<microkernel::influences::InfluencesMap>
           newInfluencesToProcess) = 0;
+
+  /**
+   * Computes ahead the natural dynamics of the level which only read its
+   * consistent state, for the next makeRegularReaction() of the same period
+   * (see microkernel::levels::ILevel::prepareNaturalDynamics). It runs
+   * while the agents perceive and decide: it must not modify the consistent
+   * state. Does nothing by default.
+   *
+   * @param transitoryTimeMin Lower bound of the next transitory period
+   * @param transitoryTimeMax Upper bound of the next transitory period
+   * @param consistentState The consistent state, read only
+   */
+  virtual void prepareNaturalDynamics(
+      const microkernel::SimulationTimeStamp & /*transitoryTimeMin*/,
+      const microkernel::SimulationTimeStamp & /*transitoryTimeMax*/,
+      std::shared_ptr<
+          microkernel::dynamicstate::ConsistentPublicLocalDynamicState>
+      /*consistentState*/) {}
 };
 
 } // namespace levels
@@ -2,6 +2,7 @@
 #define ABSTRACTSIMULATIONPARAMETERS_H
 
 #include "../../simulationmodel/ISimulationParameters.h"
+#include "../../simulationmodel/ParameterStore.h"
 
 namespace fr {
 namespace univ_artois {
@@ -13,12 +14,22 @@ namespace abstractimpl {
 
 /**
  * An abstract implementation of the ISimulationParameters interface.
+ *
+ * The subclasses declare the parameters a view tunes in their store, and
+ * hand the handles to the agents reading them.
  */
 class AbstractSimulationParameters
     : public simulationmodel::ISimulationParameters {
+private:
+  simulationmodel::ParameterStore parameterStore;
+
 public:
   virtual ~AbstractSimulationParameters() = default;
 
+  simulationmodel::ParameterStore *getParameterStore() override {
+    return &parameterStore;
+  }
+
 protected:
   AbstractSimulationParameters() = default;
 };
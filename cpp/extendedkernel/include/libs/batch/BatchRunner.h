@@ -0,0 +1,114 @@
+#ifndef BATCHRUNNER_H
+#define BATCHRUNNER_H
+
+#include "ISimulationEngine.h"
+#include "engine/ModelPlugin.h"
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace batch {
+
+/**
+ * The configuration of a batch run, read from a JSON file such as:
+ *
+ *   {
+ *     "plugin": "libmodel.so",
+ *     "arguments": "agents=100000",
+ *     "engine": "multithreaded",
+ *     "threads": 0,
+ *     "probes": {"positions": "/scratch/positions.feather"},
+ *     "export": {
+ *       "format": "feather",
+ *       "agents": "/scratch/agents.feather",
+ *       "series": "/scratch/series.feather",
+ *       "period": 10
+ *     }
+ *   }
+ *
+ * Only "plugin" is required. "probes" are the probes of the plugin (see
+ * ModelPlugin::createProbe) with their arguments. "export" adds a
+ * ColumnarExportProbe of the category of the agents and of their number,
+ * observing one step in "period".
+ */
+struct BatchRunConfig {
+  enum class Engine { MULTITHREADED, SEQUENTIAL };
+  enum class ExportFormat { CSV, FEATHER, PARQUET };
+
+  std::string plugin;
+  std::string arguments;
+  Engine engine = Engine::MULTITHREADED;
+  /** The threads of the multithreaded engine, 0 for the hardware ones. */
+  std::size_t threads = 0;
+  std::map<std::string, std::string> probes;
+  ExportFormat exportFormat = ExportFormat::CSV;
+  /** The file of the agent table, empty for none. */
+  std::string exportAgents;
+  /** The file of the series table, empty for none. */
+  std::string exportSeries;
+  std::size_t exportPeriod = 1;
+  std::size_t exportSeriesBatchRows = 1024;
+
+  /**
+   * Reads a configuration.
+   * @throws std::invalid_argument If the JSON is malformed, "plugin" is
+   * missing, or a value is of the wrong type or unknown.
+   */
+  static BatchRunConfig parse(const std::string &json);
+
+  /**
+   * Reads the configuration of a file.
+   * @throws std::runtime_error If the file cannot be read.
+   * @throws std::invalid_argument As parse().
+   */
+  static BatchRunConfig load(const std::string &path);
+};
+
+/** The outcome of a batch run. */
+struct BatchRunResult {
+  long initialTime = 0;
+  long finalTime = 0;
+  std::size_t batchBehaviors = 0;
+  double seconds = 0.0;
+
+  double stepsPerSecond() const {
+    return seconds > 0.0 ? static_cast<double>(finalTime - initialTime) /
+                               seconds
+                         : 0.0;
+  }
+};
+
+/**
+ * Runs the model of a plugin until its end, on the engine of the
+ * configuration, with its probes and its batch behaviors.
+ *
+ * Nothing is printed: the probes observe the steps, the export writing on
+ * its own thread, so that the run goes at the speed of the engine.
+ *
+ * @throws std::runtime_error If the plugin cannot be loaded, or the export
+ * format is one of Arrow in a build without it.
+ */
+BatchRunResult runBatch(const BatchRunConfig &config);
+
+/**
+ * Makes the engine of a configuration.
+ */
+std::shared_ptr<microkernel::ISimulationEngine>
+makeBatchEngine(const BatchRunConfig &config);
+
+} // namespace batch
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // BATCHRUNNER_H
@@ -0,0 +1,174 @@
+#ifndef ENSEMBLERUNNER_H
+#define ENSEMBLERUNNER_H
+
+#include "ISimulationModel.h"
+#include "engine/MultiThreadedSimulationEngine.h"
+#include "engine/WorkStealingThreadPool.h"
+#include "libs/probes/StreamingStatistics.h"
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace ensemble {
+
+/**
+ * Runs seeded replications of a stochastic simulation, and estimates the
+ * means of their outcomes within confidence intervals.
+ *
+ * Each replication builds its own model from its seed, and runs it on its
+ * own engine: the replications run concurrently on a work-stealing pool
+ * shared by the whole ensemble, one replication by chunk, so that an idle
+ * worker takes the next replication whatever the cost of the others. While
+ * a replication is initialized and runs, a RandomStream seeded by its seed
+ * is installed on its thread: the draws of PRNG outside the streams of the
+ * agents come from it, which keeps the replications independent as long as
+ * their engines run on a single thread.
+ *
+ * The outcomes of the replications, e.g. read from the probes of their
+ * engines, fold into their moments in the order of the replications, as
+ * soon as all the previous ones ended: the estimates only depend on the
+ * seeds. With a convergence criterion, no replication starts once the
+ * estimates of the first ones converged, and the ones still running are
+ * left out of the estimates.
+ */
+class EnsembleRunner {
+public:
+  /** Builds the model of a replication, e.g. generating its agents. */
+  using ModelFactory =
+      std::function<std::shared_ptr<microkernel::ISimulationModel>(
+          std::size_t replication, std::uint64_t seed)>;
+
+  /** Prepares the engine of a replication, e.g. adds its probes. */
+  using SetupFunction = std::function<void(
+      std::size_t replication,
+      microkernel::engine::MultiThreadedSimulationEngine &engine)>;
+
+  /**
+   * Reads the outcomes of a replication once it ran, one per name of the
+   * runner, NaN leaving an outcome out.
+   */
+  using OutcomeFunction = std::function<std::vector<double>(
+      std::size_t replication,
+      const microkernel::engine::MultiThreadedSimulationEngine &engine)>;
+
+  /** The estimate of the mean of an outcome. */
+  struct Estimate {
+    std::string name;
+    probes::RunningMoments moments;
+    /** The half width of the confidence interval of the mean */
+    double halfWidth = 0.0;
+
+    double mean() const { return moments.mean(); }
+    double lower() const { return moments.mean() - halfWidth; }
+    double upper() const { return moments.mean() + halfWidth; }
+  };
+
+  /** The estimates of an ensemble. */
+  struct Results {
+    /** The replications folded into the estimates, failed ones included */
+    std::size_t replications = 0;
+    /** True if the estimates converged before the last replication */
+    bool converged = false;
+    std::vector<Estimate> estimates;
+    /** The replications that failed among the folded ones, by index */
+    std::vector<std::pair<std::size_t, std::exception_ptr>> failures;
+
+    /** @throws std::out_of_range If there is no such outcome. */
+    const Estimate &getEstimate(const std::string &name) const;
+  };
+
+  /**
+   * Builds a runner.
+   * @param outcomeNames The names of the outcomes of a replication.
+   * @param concurrentRuns The number of replications running at the same
+   * time (0 = auto-detect from hardware).
+   * @param baseSeed The seed the seeds of the replications derive from.
+   * @throws std::invalid_argument If there is no outcome, or two have the
+   * same name.
+   */
+  explicit EnsembleRunner(std::vector<std::string> outcomeNames,
+                          std::size_t concurrentRuns = 0,
+                          std::uint64_t baseSeed = 0);
+
+  /**
+   * Gets the number of replications running at the same time.
+   */
+  std::size_t getConcurrentRuns() const { return threadPool.size(); }
+
+  /**
+   * Gets the seed of a replication, the same for a base seed.
+   */
+  std::uint64_t getSeed(std::size_t replication) const;
+
+  /**
+   * Sets the level of the confidence intervals, 0.95 by default.
+   * @throws std::invalid_argument If the level is not in (0, 1).
+   */
+  void setConfidence(double level);
+
+  double getConfidence() const { return confidence; }
+
+  /**
+   * Stops the ensemble once the half width of the interval of every outcome
+   * is at most the greatest of absoluteHalfWidth and relativeHalfWidth
+   * times the magnitude of its mean, after at least minReplications
+   * replications. Without it, all the replications run.
+   * @throws std::invalid_argument If minReplications is below 2 or the
+   * widths are negative.
+   */
+  void setConvergence(std::size_t minReplications, double relativeHalfWidth,
+                      double absoluteHalfWidth = 0.0);
+
+  /** Runs all the replications again. */
+  void clearConvergence() { minReplications = 0; }
+
+  /**
+   * Runs the replications.
+   * @param factory Builds the model of a replication from its seed.
+   * @param maxReplications The number of replications to run at most.
+   * @param outcome Reads the outcomes of a replication once it ran.
+   * @param setup Prepares the engine of a replication, or nullptr.
+   * @param threadsPerRun The number of threads of the engine of each
+   * replication.
+   * @return The estimates, a failed replication or one of the wrong number
+   * of outcomes being left out of them.
+   */
+  Results run(const ModelFactory &factory, std::size_t maxReplications,
+              const OutcomeFunction &outcome,
+              const SetupFunction &setup = nullptr,
+              std::size_t threadsPerRun = 1);
+
+private:
+  std::vector<std::string> names;
+  std::uint64_t baseSeed;
+  double confidence = 0.95;
+  /** 0 without convergence criterion */
+  std::size_t minReplications = 0;
+  double relativeHalfWidth = 0.0;
+  double absoluteHalfWidth = 0.0;
+  /** The workers running the replications */
+  microkernel::engine::WorkStealingThreadPool threadPool;
+
+  bool hasConverged(const Results &results) const;
+};
+
+} // namespace ensemble
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // ENSEMBLERUNNER_H
@@ -0,0 +1,67 @@
+#ifndef AGENTSAMPLER_H
+#define AGENTSAMPLER_H
+
+#include "agents/IAgent4Engine.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace probes {
+
+/**
+ * The agents a probe observes: k agents of every n, in each category when
+ * the sample is stratified, so that the rare categories are kept.
+ *
+ * The agents kept are the ones of the least hashes of their address, mixed
+ * with a seed: the same agents are thus observed from one step to the
+ * next, while they live. A stratum of m agents keeps ceil(m * k / n) of
+ * them, one at least.
+ */
+class AgentSampler {
+public:
+  using AgentPtr = std::shared_ptr<microkernel::agents::IAgent4Engine>;
+
+  /**
+   * Builds a sampler.
+   * @param k The agents kept of every n.
+   * @param n The size of the groups of agents.
+   * @param stratified Whether each category is sampled on its own.
+   * @param seed The seed of the hashes choosing the agents.
+   * @throws std::invalid_argument If k is 0 or greater than n.
+   */
+  AgentSampler(std::size_t k, std::size_t n, bool stratified = true,
+               std::uint64_t seed = 0);
+
+  /**
+   * Samples agents, in their order.
+   */
+  std::vector<AgentPtr> sample(const std::set<AgentPtr> &agents) const;
+
+  std::size_t getK() const { return k; }
+  std::size_t getN() const { return n; }
+  bool isStratified() const { return stratified; }
+
+private:
+  std::size_t k;
+  std::size_t n;
+  bool stratified;
+  std::uint64_t seed;
+};
+
+} // namespace probes
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // AGENTSAMPLER_H
@@ -0,0 +1,61 @@
+#ifndef ARROWCOLUMNARWRITER_H
+#define ARROWCOLUMNARWRITER_H
+
+// Built with the SIMILAR_ARROW option of CMake only
+#ifdef SIMILAR_ARROW
+
+#include "ColumnarBatch.h"
+#include <memory>
+#include <string>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace probes {
+
+/**
+ * Writes the batches of a table as Apache Arrow record batches, to a
+ * Feather (Arrow IPC) or a Parquet file.
+ *
+ * The dictionary columns become dictionary arrays of int32 indices into
+ * utf8 strings: a Feather file gets the new entries of each batch as a
+ * delta dictionary, a Parquet file stores them dictionary encoded and keeps
+ * the Arrow schema, for readers to get the categories back.
+ */
+class ArrowColumnarWriter : public IColumnarWriter {
+public:
+  enum class Format { FEATHER, PARQUET };
+
+  /**
+   * @param path The file, created or truncated when the first batch comes.
+   * @param format The format of the file.
+   */
+  ArrowColumnarWriter(std::string path, Format format);
+  ~ArrowColumnarWriter() override;
+
+  /**
+   * @throws std::runtime_error If Arrow fails to open or write the file.
+   */
+  void write(const ColumnarBatch &batch) override;
+  void close() override;
+
+private:
+  // The Arrow objects, kept out of this header
+  struct Impl;
+  std::unique_ptr<Impl> impl;
+};
+
+} // namespace probes
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR_ARROW
+
+#endif // ARROWCOLUMNARWRITER_H
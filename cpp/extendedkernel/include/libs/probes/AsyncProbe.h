@@ -0,0 +1,254 @@
+#ifndef ASYNCPROBE_H
+#define ASYNCPROBE_H
+
+#include "IProbe.h"
+#include "ISimulationEngine.h"
+#include "SimulationTimeStamp.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace probes {
+
+/**
+ * What an AsyncProbe does with a snapshot when its buffer is full.
+ */
+enum class AsyncProbePolicy {
+  /** The simulation waits until the consumer frees a place. */
+  BLOCK,
+  /** The new snapshot is discarded. */
+  DROP_NEWEST,
+  /** The oldest snapshot still waiting is discarded. */
+  DROP_OLDEST
+};
+
+/**
+ * A probe moving the costly part of an observation off the simulation thread.
+ *
+ * On the simulation thread, the probe only builds an immutable snapshot of
+ * what it observes (e.g. copies of a few fields, or the snapshot() of the
+ * consistent states). The snapshots go through a bounded ring buffer to a
+ * dedicated thread, which hands them to the consumer (e.g. an exporter or a
+ * web view). When the consumer falls behind, the policy either slows the
+ * simulation down or drops snapshots.
+ *
+ * Snapshots of the initial, partial consistent and final times all go to
+ * the consumer. The final snapshot is never dropped, and the final
+ * observation blocks until every snapshot was consumed, so the consumer has
+ * seen the end of the run when the engine returns.
+ *
+ * @tparam Snapshot The type of the data handed to the consumer.
+ */
+template <typename Snapshot> class AsyncProbe : public microkernel::IProbe {
+public:
+  using SnapshotFunction = std::function<Snapshot(
+      const microkernel::SimulationTimeStamp &,
+      const microkernel::ISimulationEngine &)>;
+  using ConsumerFunction = std::function<void(
+      const microkernel::SimulationTimeStamp &, const Snapshot &)>;
+
+private:
+  using Entry = std::pair<microkernel::SimulationTimeStamp, Snapshot>;
+
+  SnapshotFunction snapshotFunction;
+  ConsumerFunction consumerFunction;
+  std::size_t capacity;
+  AsyncProbePolicy policy;
+
+  std::vector<std::optional<Entry>> ring;
+  std::size_t head = 0;
+  std::size_t count = 0;
+  bool consuming = false;
+  bool stopping = false;
+  std::mutex mutex;
+  std::condition_variable notEmpty;
+  std::condition_variable notFull;
+  std::condition_variable drained;
+  std::thread consumer;
+  std::atomic<std::size_t> droppedSnapshots{0};
+  // count, for the readers not taking the lock
+  std::atomic<std::size_t> queuedSnapshots{0};
+
+  void consumerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      notEmpty.wait(lock, [this]() { return count > 0 || stopping; });
+      if (count == 0) {
+        return;
+      }
+      Entry entry = std::move(*ring[head]);
+      ring[head].reset();
+      head = (head + 1) % capacity;
+      --count;
+      queuedSnapshots.store(count, std::memory_order_relaxed);
+      consuming = true;
+      notFull.notify_one();
+      lock.unlock();
+      consumerFunction(entry.first, entry.second);
+      lock.lock();
+      consuming = false;
+      if (count == 0) {
+        drained.notify_all();
+      }
+    }
+  }
+
+  void start() {
+    if (consumer.joinable()) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = false;
+    }
+    consumer = std::thread([this]() { consumerLoop(); });
+  }
+
+  void stop() {
+    if (!consumer.joinable()) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    notEmpty.notify_all();
+    consumer.join();
+  }
+
+  void push(const microkernel::SimulationTimeStamp &timestamp,
+            const microkernel::ISimulationEngine &engine, bool mustDeliver) {
+    start();
+    Snapshot snapshot = snapshotFunction(timestamp, engine);
+    std::unique_lock<std::mutex> lock(mutex);
+    if (count == capacity) {
+      switch (mustDeliver ? AsyncProbePolicy::BLOCK : policy) {
+      case AsyncProbePolicy::BLOCK:
+        notFull.wait(lock, [this]() { return count < capacity; });
+        break;
+      case AsyncProbePolicy::DROP_NEWEST:
+        droppedSnapshots.fetch_add(1, std::memory_order_relaxed);
+        return;
+      case AsyncProbePolicy::DROP_OLDEST:
+        ring[head].reset();
+        head = (head + 1) % capacity;
+        --count;
+        droppedSnapshots.fetch_add(1, std::memory_order_relaxed);
+        break;
+      }
+    }
+    ring[(head + count) % capacity].emplace(timestamp, std::move(snapshot));
+    ++count;
+    queuedSnapshots.store(count, std::memory_order_relaxed);
+    lock.unlock();
+    notEmpty.notify_one();
+  }
+
+public:
+  /**
+   * Builds an asynchronous probe.
+   * @param snapshotFunction Builds the snapshot on the simulation thread.
+   * @param consumerFunction Processes the snapshots on the consumer thread.
+   * @param capacity The number of snapshots waiting for the consumer at most.
+   * @param policy What to do with a snapshot when the buffer is full.
+   * @throws std::invalid_argument If a function is empty or capacity is 0.
+   */
+  AsyncProbe(SnapshotFunction snapshotFunction,
+             ConsumerFunction consumerFunction, std::size_t capacity = 64,
+             AsyncProbePolicy policy = AsyncProbePolicy::BLOCK)
+      : snapshotFunction(std::move(snapshotFunction)),
+        consumerFunction(std::move(consumerFunction)), capacity(capacity),
+        policy(policy), ring(capacity) {
+    if (!this->snapshotFunction || !this->consumerFunction) {
+      throw std::invalid_argument("The functions of the probe are required.");
+    }
+    if (capacity == 0) {
+      throw std::invalid_argument("The capacity has to be positive.");
+    }
+  }
+
+  ~AsyncProbe() override { stop(); }
+
+  AsyncProbe(const AsyncProbe &) = delete;
+  AsyncProbe &operator=(const AsyncProbe &) = delete;
+
+  /**
+   * Gets the number of snapshots discarded because the buffer was full.
+   */
+  std::size_t getDroppedCount() const {
+    return droppedSnapshots.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Gets the number of snapshots waiting for the consumer, without locking
+   * the buffer (e.g. for microkernel::libs::SimulationMetrics::addQueue).
+   */
+  std::size_t getQueueDepth() const {
+    return queuedSnapshots.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Waits until the consumer processed every snapshot pushed so far.
+   */
+  void flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    drained.wait(lock, [this]() {
+      return (count == 0 && !consuming) || !consumer.joinable();
+    });
+  }
+
+  void prepareObservation() override { start(); }
+
+  void observeAtInitialTimes(
+      const microkernel::SimulationTimeStamp &initialTimestamp,
+      const microkernel::ISimulationEngine &simulationEngine) override {
+    push(initialTimestamp, simulationEngine, false);
+  }
+
+  void observeAtPartialConsistentTime(
+      const microkernel::SimulationTimeStamp &timestamp,
+      const microkernel::ISimulationEngine &simulationEngine) override {
+    push(timestamp, simulationEngine, false);
+  }
+
+  void observeAtFinalTime(
+      const microkernel::SimulationTimeStamp &finalTimestamp,
+      const microkernel::ISimulationEngine &simulationEngine) override {
+    push(finalTimestamp, simulationEngine, true);
+    flush();
+  }
+
+  void endObservation() override {
+    flush();
+    stop();
+  }
+
+  std::shared_ptr<microkernel::IProbe> clone() const override {
+    return std::make_shared<AsyncProbe>(snapshotFunction, consumerFunction,
+                                        capacity, policy);
+  }
+};
+
+} // namespace probes
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // ASYNCPROBE_H
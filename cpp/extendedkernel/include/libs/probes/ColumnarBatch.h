@@ -0,0 +1,86 @@
+#ifndef COLUMNARBATCH_H
+#define COLUMNARBATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace probes {
+
+/**
+ * Rows of a table stored column by column, in the manner of an Apache Arrow
+ * record batch.
+ *
+ * The strings of a DICTIONARY column are stored as indices into a
+ * dictionary that grows over the batches of a table: a batch carries the
+ * entries added since the previous one only, so that a category repeated
+ * over millions of rows is written once.
+ */
+struct ColumnarBatch {
+  enum class ColumnType { INT64, FLOAT64, DICTIONARY };
+
+  struct Column {
+    std::string name;
+    ColumnType type = ColumnType::FLOAT64;
+    /** The values of an INT64 column. */
+    std::vector<std::int64_t> int64s;
+    /** The values of a FLOAT64 column. */
+    std::vector<double> float64s;
+    /** The indices in the dictionary of a DICTIONARY column. */
+    std::vector<std::int32_t> indices;
+    /**
+     * The entries of the dictionary added by this batch, whose indices start
+     * at dictionaryOffset.
+     */
+    std::vector<std::string> dictionaryDelta;
+    std::size_t dictionaryOffset = 0;
+
+    Column() = default;
+    Column(std::string name, ColumnType type)
+        : name(std::move(name)), type(type) {}
+  };
+
+  std::vector<Column> columns;
+  std::size_t rows = 0;
+
+  bool empty() const { return rows == 0; }
+};
+
+/**
+ * Writes the batches of a table, e.g. to a file, in the order they come.
+ * The batches of a table all have the same columns.
+ */
+class IColumnarWriter {
+public:
+  virtual ~IColumnarWriter() = default;
+
+  /**
+   * Writes a batch.
+   * @throws std::runtime_error If the batch cannot be written.
+   */
+  virtual void write(const ColumnarBatch &batch) = 0;
+
+  /**
+   * Writes what is left and closes the output. Called once, after the last
+   * batch.
+   */
+  virtual void close() = 0;
+};
+
+} // namespace probes
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // COLUMNARBATCH_H
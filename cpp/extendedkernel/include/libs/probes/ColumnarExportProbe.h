@@ -0,0 +1,205 @@
+#ifndef COLUMNAREXPORTPROBE_H
+#define COLUMNAREXPORTPROBE_H
+
+#include "AgentSampler.h"
+#include "AsyncProbe.h"
+#include "ColumnarBatch.h"
+#include "IProbe.h"
+#include "ISimulationEngine.h"
+#include "LevelIdentifier.h"
+#include "SimulationTimeStamp.h"
+#include "agents/IAgent4Engine.h"
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace probes {
+
+/**
+ * A probe exporting the states of the agents and time series of aggregates
+ * as columnar batches (see ColumnarBatch), e.g. to Arrow files read by
+ * analysis pipelines.
+ *
+ * At each observed time, the probe reads the columns of every agent and the
+ * aggregates on the simulation thread, into the columns of a batch; the
+ * batches are then written by the writers on the thread of an AsyncProbe,
+ * so that the encoding and the input/output do not slow the simulation. The
+ * agent table has a row per agent and time, starting with the columns
+ * "time" and "category", the category being dictionary encoded; the series
+ * table has a row per time, starting with "time".
+ *
+ * The rows of the series are written by batches of seriesBatchRows, the
+ * last one at the final time. The writers are closed by endObservation().
+ * An error of a writer is rethrown by the next observation.
+ */
+class ColumnarExportProbe : public microkernel::IProbe {
+public:
+  using AgentPtr = std::shared_ptr<microkernel::agents::IAgent4Engine>;
+  using Float64Column =
+      std::function<double(const microkernel::agents::IAgent4Engine &)>;
+  using Int64Column =
+      std::function<std::int64_t(const microkernel::agents::IAgent4Engine &)>;
+  using DictionaryColumn = std::function<std::string(
+      const microkernel::agents::IAgent4Engine &)>;
+  using SeriesColumn =
+      std::function<double(const microkernel::SimulationTimeStamp &,
+                           const microkernel::ISimulationEngine &)>;
+
+  /**
+   * Builds a probe.
+   * @param agentWriter Writes the agent table, or nullptr for none.
+   * @param seriesWriter Writes the series table, or nullptr for none.
+   * @param seriesBatchRows The rows of the series written at once.
+   * @param capacity The batches waiting for the writers at most, the
+   * simulation waiting when they fall behind.
+   * @throws std::invalid_argument If seriesBatchRows or capacity is 0.
+   */
+  ColumnarExportProbe(std::shared_ptr<IColumnarWriter> agentWriter,
+                      std::shared_ptr<IColumnarWriter> seriesWriter,
+                      std::size_t seriesBatchRows = 1024,
+                      std::size_t capacity = 8);
+
+  ~ColumnarExportProbe() override;
+
+  ColumnarExportProbe(const ColumnarExportProbe &) = delete;
+  ColumnarExportProbe &operator=(const ColumnarExportProbe &) = delete;
+
+  /**
+   * Adds a column of floating-point values to the agent table.
+   * @throws std::invalid_argument If the name is already used.
+   */
+  void addAgentColumn(const std::string &name, Float64Column column);
+
+  /**
+   * Adds a column of integers to the agent table.
+   * @throws std::invalid_argument If the name is already used.
+   */
+  void addAgentIntColumn(const std::string &name, Int64Column column);
+
+  /**
+   * Adds a dictionary-encoded column of strings to the agent table.
+   * @throws std::invalid_argument If the name is already used.
+   */
+  void addAgentDictionaryColumn(const std::string &name,
+                                DictionaryColumn column);
+
+  /**
+   * Adds an aggregate to the series table, e.g. a count or a mean over
+   * the agents.
+   * @throws std::invalid_argument If the name is already used.
+   */
+  void addSeriesColumn(const std::string &name, SeriesColumn column);
+
+  /**
+   * Keeps only the agents of a level in the agent table.
+   */
+  void setLevel(const microkernel::LevelIdentifier &level) {
+    levelFilter = level;
+  }
+
+  /**
+   * Keeps only a sample of the agents in the agent table, or all of them
+   * again with nullptr. The sampler is shared with the clones.
+   */
+  void setSampler(std::shared_ptr<const AgentSampler> agentSampler) {
+    sampler = std::move(agentSampler);
+  }
+
+  /**
+   * Waits until the writers wrote every batch built so far.
+   */
+  void flush() { async.flush(); }
+
+  void prepareObservation() override;
+
+  void observeAtInitialTimes(
+      const microkernel::SimulationTimeStamp &initialTimestamp,
+      const microkernel::ISimulationEngine &simulationEngine) override;
+
+  void observeAtPartialConsistentTime(
+      const microkernel::SimulationTimeStamp &timestamp,
+      const microkernel::ISimulationEngine &simulationEngine) override;
+
+  void observeAtFinalTime(
+      const microkernel::SimulationTimeStamp &finalTimestamp,
+      const microkernel::ISimulationEngine &simulationEngine) override;
+
+  void endObservation() override;
+
+  /**
+   * Clones the probe with the same columns and writers: a clone and its
+   * original must not observe at the same time.
+   */
+  std::shared_ptr<microkernel::IProbe> clone() const override;
+
+private:
+  /** The batches of an observation, handed to the writer thread. */
+  struct Batches {
+    std::shared_ptr<ColumnarBatch> agents;
+    std::shared_ptr<ColumnarBatch> series;
+  };
+
+  /** A column of the agent table and its dictionary. */
+  struct AgentColumn {
+    std::string name;
+    ColumnarBatch::ColumnType type = ColumnarBatch::ColumnType::FLOAT64;
+    Float64Column float64;
+    Int64Column int64;
+    DictionaryColumn dictionary;
+    std::unordered_map<std::string, std::int32_t> entries;
+    std::size_t written = 0; ///< Entries sent with earlier batches
+  };
+
+  std::shared_ptr<IColumnarWriter> agentWriter;
+  std::shared_ptr<IColumnarWriter> seriesWriter;
+  std::size_t seriesBatchRows;
+  std::size_t capacity;
+  std::optional<microkernel::LevelIdentifier> levelFilter;
+  std::shared_ptr<const AgentSampler> sampler;
+
+  std::vector<AgentColumn> agentColumns; ///< "category" first
+  std::vector<std::pair<std::string, SeriesColumn>> seriesColumns;
+  std::shared_ptr<ColumnarBatch> pendingSeries;
+  Batches next;
+
+  /** The first error of the writers, rethrown on the simulation thread. */
+  std::exception_ptr writeError;
+  std::mutex errorMutex;
+
+  AsyncProbe<Batches> async;
+
+  void checkName(const std::string &name) const;
+  void observe(const microkernel::SimulationTimeStamp &timestamp,
+               const microkernel::ISimulationEngine &engine, bool final);
+  std::shared_ptr<ColumnarBatch>
+  snapshotAgents(const microkernel::SimulationTimeStamp &timestamp,
+                 const microkernel::ISimulationEngine &engine);
+  void addSeriesRow(const microkernel::SimulationTimeStamp &timestamp,
+                    const microkernel::ISimulationEngine &engine);
+  void write(const Batches &batches);
+  void rethrowWriteError();
+};
+
+} // namespace probes
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // COLUMNAREXPORTPROBE_H
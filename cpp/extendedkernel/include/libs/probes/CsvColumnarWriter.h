@@ -0,0 +1,50 @@
+#ifndef CSVCOLUMNARWRITER_H
+#define CSVCOLUMNARWRITER_H
+
+#include "ColumnarBatch.h"
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace probes {
+
+/**
+ * Writes the batches of a table to a CSV file, with a header row, the
+ * dictionary columns being written as their strings.
+ *
+ * The fallback of the builds without Apache Arrow (see ArrowColumnarWriter):
+ * the rows are still formatted on the writer thread of the probe.
+ */
+class CsvColumnarWriter : public IColumnarWriter {
+public:
+  /**
+   * @param path The file, created or truncated.
+   * @throws std::runtime_error If the file cannot be opened.
+   */
+  explicit CsvColumnarWriter(const std::string &path);
+
+  void write(const ColumnarBatch &batch) override;
+  void close() override;
+
+private:
+  std::ofstream output;
+  bool headerWritten = false;
+  /** The dictionary of each column, empty for the others. */
+  std::vector<std::vector<std::string>> dictionaries;
+};
+
+} // namespace probes
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // CSVCOLUMNARWRITER_H
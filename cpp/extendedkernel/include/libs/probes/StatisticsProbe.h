@@ -0,0 +1,189 @@
+#ifndef STATISTICSPROBE_H
+#define STATISTICSPROBE_H
+
+#include "AgentSampler.h"
+#include "IProbe.h"
+#include "ISimulationEngine.h"
+#include "LevelIdentifier.h"
+#include "SimulationTimeStamp.h"
+#include "StreamingStatistics.h"
+#include "agents/IAgent4Engine.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace probes {
+
+/**
+ * A probe computing statistics over the agents at each observed time: the
+ * moments, histograms and quantile sketches of values of the agents, the
+ * numbers of agents by category and the densities of their positions on a
+ * grid (see StreamingStatistics.h).
+ *
+ * The agents are split into chunks of chunkSize, each chunk aggregated on
+ * its own and the chunks merged in their order, so that the statistics do
+ * not depend on the threads. The chunks run through
+ * WorkStealingThreadPool::parallelForOnCurrent(): on the workers of the
+ * engine when it lends them to the probes, sequentially otherwise. The
+ * value and position functions are thus called from several threads at
+ * once, and must only read the agents.
+ *
+ * The statistics of the last observation replace the previous ones
+ * atomically: another thread reads them during the simulation.
+ */
+class StatisticsProbe : public microkernel::IProbe {
+public:
+  using Value =
+      std::function<double(const microkernel::agents::IAgent4Engine &)>;
+  using Position = std::function<std::pair<double, double>(
+      const microkernel::agents::IAgent4Engine &)>;
+  using Category =
+      std::function<std::string(const microkernel::agents::IAgent4Engine &)>;
+
+  /** The statistics of an observation. */
+  struct Results {
+    /** The time of the observation, -1 before any. */
+    long time = -1;
+    std::size_t agents = 0;
+    std::vector<std::pair<std::string, RunningMoments>> moments;
+    std::vector<std::pair<std::string, FixedBinHistogram>> histograms;
+    std::vector<std::pair<std::string, QuantileSketch>> sketches;
+    std::vector<std::pair<std::string, CategoryCounter>> counters;
+    std::vector<std::pair<std::string, DensityGrid>> grids;
+
+    /** @throws std::out_of_range If there is no such statistic. */
+    const RunningMoments &getMoments(const std::string &name) const;
+    const FixedBinHistogram &getHistogram(const std::string &name) const;
+    const QuantileSketch &getSketch(const std::string &name) const;
+    const CategoryCounter &getCounter(const std::string &name) const;
+    const DensityGrid &getGrid(const std::string &name) const;
+  };
+
+  /**
+   * Builds a probe without statistics.
+   * @param chunkSize The agents aggregated by a chunk.
+   * @throws std::invalid_argument If chunkSize is 0.
+   */
+  explicit StatisticsProbe(std::size_t chunkSize = 1024);
+
+  /**
+   * Adds the moments of a value of the agents, NaN leaving an agent out.
+   * @throws std::invalid_argument If the name is already used.
+   */
+  void addMoments(const std::string &name, Value value);
+
+  /**
+   * Adds a histogram of a value of the agents.
+   * @throws std::invalid_argument If the name is already used, or the bins
+   * are invalid (see FixedBinHistogram).
+   */
+  void addHistogram(const std::string &name, Value value, double min,
+                    double max, std::size_t bins);
+
+  /**
+   * Adds a quantile sketch of a value of the agents.
+   * @throws std::invalid_argument If the name is already used, or the
+   * accuracy is invalid (see QuantileSketch).
+   */
+  void addQuantiles(const std::string &name, Value value,
+                    double relativeAccuracy = 0.01);
+
+  /**
+   * Adds the numbers of agents by a category of theirs, by default the name
+   * of their agent category.
+   * @throws std::invalid_argument If the name is already used.
+   */
+  void addCategoryCounts(const std::string &name, Category category = nullptr);
+
+  /**
+   * Adds the numbers of agents in the cells of a grid, by their position.
+   * @throws std::invalid_argument If the name is already used, or the grid
+   * is invalid (see DensityGrid).
+   */
+  void addDensityGrid(const std::string &name, Position position,
+                      double originX, double originY, double cellSize,
+                      std::size_t columns, std::size_t rows);
+
+  /**
+   * Keeps only the agents of a level.
+   */
+  void setLevel(const microkernel::LevelIdentifier &level) {
+    levelFilter = level;
+  }
+
+  /**
+   * Computes the statistics over a sample of the agents, or all of them
+   * again with nullptr; the agents of the results are then the ones
+   * sampled. The sampler is shared with the clones.
+   */
+  void setSampler(std::shared_ptr<const AgentSampler> agentSampler) {
+    sampler = std::move(agentSampler);
+  }
+
+  /**
+   * Gets the statistics of the last observation, empty before any.
+   */
+  std::shared_ptr<const Results> getResults() const;
+
+  void prepareObservation() override;
+
+  void observeAtInitialTimes(
+      const microkernel::SimulationTimeStamp &initialTimestamp,
+      const microkernel::ISimulationEngine &simulationEngine) override;
+
+  void observeAtPartialConsistentTime(
+      const microkernel::SimulationTimeStamp &timestamp,
+      const microkernel::ISimulationEngine &simulationEngine) override;
+
+  void observeAtFinalTime(
+      const microkernel::SimulationTimeStamp &finalTimestamp,
+      const microkernel::ISimulationEngine &simulationEngine) override;
+
+  std::shared_ptr<microkernel::IProbe> clone() const override;
+
+private:
+  using AgentPtr = std::shared_ptr<microkernel::agents::IAgent4Engine>;
+
+  std::size_t chunkSize;
+  std::optional<microkernel::LevelIdentifier> levelFilter;
+  std::shared_ptr<const AgentSampler> sampler;
+
+  std::vector<Value> momentValues;
+  std::vector<Value> histogramValues;
+  std::vector<Value> sketchValues;
+  std::vector<Category> counterCategories;
+  std::vector<Position> gridPositions;
+  /** The empty statistics, copied by each chunk. */
+  Results empty;
+
+  mutable std::mutex resultsMutex;
+  std::shared_ptr<const Results> results;
+
+  void checkName(const std::string &name) const;
+  void aggregate(const std::vector<AgentPtr> &agents, std::size_t begin,
+                 std::size_t end, Results &into) const;
+  void observe(const microkernel::SimulationTimeStamp &timestamp,
+               const microkernel::ISimulationEngine &engine);
+};
+
+} // namespace probes
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // STATISTICSPROBE_H
@@ -0,0 +1,252 @@
+#ifndef STREAMINGSTATISTICS_H
+#define STREAMINGSTATISTICS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace probes {
+
+/**
+ * The count, mean, variance and range of values seen one by one, by
+ * Welford's updates. Two of them merge into the moments of both sets of
+ * values, so that the values can be split over threads.
+ */
+class RunningMoments {
+private:
+  std::uint64_t n = 0;
+  double mu = 0.0;
+  double m2 = 0.0; ///< Sum of the squared deviations from the mean
+  double low = 0.0;
+  double high = 0.0;
+
+public:
+  /** Adds a value, NaN being ignored. */
+  void add(double value);
+
+  void merge(const RunningMoments &other);
+
+  std::uint64_t count() const { return n; }
+
+  /** Gets the mean, 0 without values. */
+  double mean() const { return mu; }
+
+  /** Gets the variance of the values, 0 without values. */
+  double variance() const { return n > 0 ? m2 / n : 0.0; }
+
+  /** Gets the unbiased variance of a sample, 0 below two values. */
+  double sampleVariance() const { return n > 1 ? m2 / (n - 1) : 0.0; }
+
+  /** Gets the least value, 0 without values. */
+  double min() const { return low; }
+
+  /** Gets the greatest value, 0 without values. */
+  double max() const { return high; }
+
+  /**
+   * Gets the half width of the Student confidence interval of the mean of
+   * the population the values were sampled from.
+   * @param confidence The confidence level, in (0, 1).
+   * @return The half width, infinite below two values.
+   * @throws std::invalid_argument If the level is not in (0, 1).
+   */
+  double confidenceHalfWidth(double confidence = 0.95) const;
+};
+
+/**
+ * The counts of values in bins of equal width over a range, and of the ones
+ * outside it.
+ */
+class FixedBinHistogram {
+private:
+  double low;
+  double high;
+  double scale; ///< Bins by unit of value
+  std::vector<std::uint64_t> bins;
+  std::uint64_t below = 0;
+  std::uint64_t above = 0;
+
+public:
+  /**
+   * Builds an empty histogram.
+   * @param min The start of the first bin.
+   * @param max The end of the last bin, the bins holding [min, max).
+   * @param numBins The number of bins.
+   * @throws std::invalid_argument If min is not below max or numBins is 0.
+   */
+  FixedBinHistogram(double min, double max, std::size_t numBins);
+
+  /** Counts a value, NaN being ignored. */
+  void add(double value);
+
+  /**
+   * Adds the counts of a histogram of the same bins.
+   * @throws std::invalid_argument If the bins differ.
+   */
+  void merge(const FixedBinHistogram &other);
+
+  const std::vector<std::uint64_t> &counts() const { return bins; }
+  std::uint64_t underflow() const { return below; }
+  std::uint64_t overflow() const { return above; }
+
+  /** Gets the number of values counted, outside the range included. */
+  std::uint64_t total() const;
+
+  /**
+   * Estimates a quantile, the values of a bin being spread evenly over it
+   * and the ones outside the range being at its bounds.
+   * @param q The quantile, in [0, 1].
+   * @return The estimate, NaN without values.
+   */
+  double quantile(double q) const;
+
+  double min() const { return low; }
+  double max() const { return high; }
+};
+
+/**
+ * A DDSketch, estimating the quantiles of values within a relative error.
+ *
+ * A value x is counted in the bucket ceil(log_gamma |x|), of the values
+ * between gamma^(i-1) and gamma^i, with gamma = (1 + a) / (1 - a) for a
+ * relative accuracy a: the estimate of a quantile is then within a * x of
+ * a value x of the set, whatever the distribution, and the sketches of two
+ * sets merge by adding their buckets. The values below 1e-300 in magnitude
+ * are counted as zeros.
+ */
+class QuantileSketch {
+private:
+  double accuracy;
+  double gamma;
+  double logGamma;
+  std::map<int, std::uint64_t> positives;
+  std::map<int, std::uint64_t> negatives; ///< By the bucket of -x
+  std::uint64_t zeros = 0;
+  std::uint64_t n = 0;
+
+  int bucketOf(double magnitude) const;
+  double valueOf(int bucket) const;
+
+public:
+  /**
+   * Builds an empty sketch.
+   * @param relativeAccuracy The relative error of the quantiles, in (0, 1).
+   * @throws std::invalid_argument If the accuracy is not in (0, 1).
+   */
+  explicit QuantileSketch(double relativeAccuracy = 0.01);
+
+  /** Counts a value, NaN and infinities being ignored. */
+  void add(double value);
+
+  /**
+   * Adds the buckets of a sketch of the same accuracy.
+   * @throws std::invalid_argument If the accuracies differ.
+   */
+  void merge(const QuantileSketch &other);
+
+  std::uint64_t count() const { return n; }
+
+  /** Gets the number of buckets in use, the memory of the sketch. */
+  std::size_t size() const { return positives.size() + negatives.size(); }
+
+  double relativeAccuracy() const { return accuracy; }
+
+  /**
+   * Estimates a quantile.
+   * @param q The quantile, in [0, 1].
+   * @return The estimate, NaN without values.
+   */
+  double quantile(double q) const;
+};
+
+/**
+ * The numbers of values of each category, e.g. of the agents by their
+ * category.
+ */
+class CategoryCounter {
+private:
+  std::map<std::string, std::uint64_t> entries;
+
+public:
+  void add(const std::string &category, std::uint64_t count = 1) {
+    entries[category] += count;
+  }
+
+  void merge(const CategoryCounter &other);
+
+  /** Gets the number of values of a category, 0 if none. */
+  std::uint64_t count(const std::string &category) const;
+
+  /** Gets the numbers of the categories seen, by category. */
+  const std::map<std::string, std::uint64_t> &counts() const {
+    return entries;
+  }
+};
+
+/**
+ * The numbers of points in the square cells of a grid, row after row, and
+ * of the ones outside it.
+ */
+class DensityGrid {
+private:
+  double originX;
+  double originY;
+  double size;
+  std::size_t numColumns;
+  std::size_t numRows;
+  std::vector<std::uint64_t> cells;
+  std::uint64_t outside = 0;
+
+public:
+  /**
+   * Builds an empty grid.
+   * @param originX The abscissa of the left side of the first column.
+   * @param originY The ordinate of the bottom side of the first row.
+   * @param cellSize The side of a cell.
+   * @param columns The number of columns.
+   * @param rows The number of rows.
+   * @throws std::invalid_argument If the cell size is not positive or the
+   * grid has no cell.
+   */
+  DensityGrid(double originX, double originY, double cellSize,
+              std::size_t columns, std::size_t rows);
+
+  /** Counts a point, a NaN coordinate counting as outside. */
+  void add(double x, double y);
+
+  /**
+   * Adds the counts of a grid of the same cells.
+   * @throws std::invalid_argument If the cells differ.
+   */
+  void merge(const DensityGrid &other);
+
+  /** Gets the counts of the cells, row after row, from the bottom row. */
+  const std::vector<std::uint64_t> &counts() const { return cells; }
+
+  std::uint64_t count(std::size_t column, std::size_t row) const {
+    return cells[row * numColumns + column];
+  }
+
+  std::uint64_t outsideCount() const { return outside; }
+  std::size_t columns() const { return numColumns; }
+  std::size_t rows() const { return numRows; }
+  double cellSize() const { return size; }
+};
+
+} // namespace probes
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // STREAMINGSTATISTICS_H
@@ -4,9 +4,11 @@
 #include <algorithm>
 #include <cmath>
 #include <random>
+#include <span>
 #include <stdexcept>
 #include <vector>
 
+#include "RandomStream.h"
 #include "Xoshiro256PlusPlus.h"
 
 // Define M_PI for Windows MSVC compatibility
@@ -28,8 +30,10 @@ namespace random {
  * Provides convenient static methods for generating random values.
  * Uses Xoshiro256++ as the default generator for high performance.
  *
- * Thread-safe: Each thread should have its own generator or use mutex
- * protection.
+ * The global generator is not thread-safe. Engines running agents on several
+ * threads give each agent its own RandomStream (see RandomStreams) and
+ * install it while the agent runs; the methods of this class then draw from
+ * that stream, which makes parallel runs reproducible.
  */
 class PRNG {
 private:
@@ -102,12 +106,53 @@ public:
    */
   static double randomGaussian(double mean, double sd);
 
+  /**
+   * Fills a buffer with random doubles between 0 (included) and 1
+   * (excluded), much faster than as many calls to randomDouble().
+   *
+   * The values come from several generators advanced together, seeded by
+   * the current stream or the global generator. They differ from the
+   * values the same number of calls to randomDouble() would return.
+   * @param out The buffer to fill
+   */
+  static void fillUniform(std::span<double> out);
+
+  /**
+   * Fills a buffer with random doubles within a range, e.g. random headings
+   * between -π and π.
+   * @param out The buffer to fill
+   * @param lowerBound The lower bound (included)
+   * @param higherBound The higher bound (excluded)
+   */
+  static void fillUniform(std::span<double> out, double lowerBound,
+                          double higherBound);
+
+  /**
+   * Fills a buffer with Gaussian distributed values of mean 0.0 and
+   * standard deviation 1.0, sampled with the Ziggurat method.
+   * @param out The buffer to fill
+   */
+  static void fillGaussian(std::span<double> out);
+
+  /**
+   * Fills a buffer with Gaussian distributed values of given mean and
+   * standard deviation.
+   * @param out The buffer to fill
+   * @param mean The mean
+   * @param sd The standard deviation
+   */
+  static void fillGaussian(std::span<double> out, double mean, double sd);
+
   /**
    * Shuffles the given vector.
    * @param vec The vector to shuffle
    */
   template <typename T> static void shuffle(std::vector<T> &vec) {
-    std::shuffle(vec.begin(), vec.end(), generator);
+    if (RandomStream *stream = RandomStream::current()) {
+      stream->shuffle(vec);
+    } else {
+      std::shuffle(vec.begin(), vec.end(), generator);
+    }
   }
 
   /**
@@ -115,6 +160,33 @@ public:
    * @return The generator name
    */
   static std::string getImplementationName();
+
+  /**
+   * Writes the state of the global generator in a checkpoint.
+   */
+  static void
+  writeCheckpoint(microkernel::checkpoint::CheckpointWriter &writer);
+
+  /**
+   * Restores the state of the global generator from a checkpoint.
+   */
+  static void readCheckpoint(microkernel::checkpoint::CheckpointReader &reader);
+};
+
+/**
+ * A checkpoint section holding the state of the global generator of PRNG.
+ */
+class PRNGCheckpoint : public microkernel::checkpoint::ICheckpointable {
+public:
+  void writeCheckpoint(
+      microkernel::checkpoint::CheckpointWriter &writer) const override {
+    PRNG::writeCheckpoint(writer);
+  }
+
+  void
+  readCheckpoint(microkernel::checkpoint::CheckpointReader &reader) override {
+    PRNG::readCheckpoint(reader);
+  }
 };
 
 } // namespace random
@@ -0,0 +1,219 @@
+#ifndef RANDOMSTREAM_H
+#define RANDOMSTREAM_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "Xoshiro256PlusPlus.h"
+#include "Xoshiro256PlusPlusLanes.h"
+#include "checkpoint/ICheckpointable.h"
+
+// Define M_PI for Windows MSVC compatibility
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace random {
+
+/**
+ * Writes the state of a generator and of the normal distribution drawing from
+ * it, which may hold a value computed ahead.
+ */
+inline void
+writeRandomState(microkernel::checkpoint::CheckpointWriter &writer,
+                 const Xoshiro256PlusPlus &generator,
+                 const std::normal_distribution<double> &normalDist) {
+  for (uint64_t word : generator.getState()) {
+    writer.writeU64(word);
+  }
+  std::ostringstream distribution;
+  distribution << normalDist;
+  writer.writeString(distribution.str());
+}
+
+/**
+ * Reads a state written by writeRandomState.
+ */
+inline void readRandomState(microkernel::checkpoint::CheckpointReader &reader,
+                            Xoshiro256PlusPlus &generator,
+                            std::normal_distribution<double> &normalDist) {
+  std::array<uint64_t, 4> state;
+  for (auto &word : state) {
+    word = reader.readU64();
+  }
+  generator.setState(state);
+  std::istringstream distribution(reader.readString());
+  if (!(distribution >> normalDist)) {
+    throw microkernel::checkpoint::CheckpointException(
+        "Invalid state of a normal distribution.");
+  }
+}
+
+/**
+ * An independent stream of random values, owned by a single agent or thread.
+ *
+ * A stream holds its own generator and distributions, so that drawing from it
+ * neither contends with other threads nor depends on their scheduling. While
+ * a stream is installed on a thread with a Scope, the static methods of PRNG
+ * draw from it instead of the global generator.
+ */
+class RandomStream : public microkernel::checkpoint::ICheckpointable {
+private:
+  Xoshiro256PlusPlus generator;
+  std::uniform_real_distribution<double> uniformDist{0.0, 1.0};
+  std::normal_distribution<double> normalDist{0.0, 1.0};
+
+  static RandomStream *&currentSlot() {
+    thread_local RandomStream *current = nullptr;
+    return current;
+  }
+
+public:
+  explicit RandomStream(const Xoshiro256PlusPlus &generator)
+      : generator(generator) {}
+
+  explicit RandomStream(uint64_t seed) : generator(seed) {}
+
+  /**
+   * Builds a new stream seeded from this one, e.g. for an agent created
+   * during a decision. The sequence of the new stream only depends on the
+   * values previously drawn from this stream.
+   */
+  RandomStream split() { return RandomStream(generator()); }
+
+  double randomDouble() { return uniformDist(generator); }
+
+  double randomDouble(double lowerBound, double higherBound) {
+    return lowerBound + (higherBound - lowerBound) * randomDouble();
+  }
+
+  double randomAngle() { return randomDouble(-M_PI, M_PI); }
+
+  bool randomBoolean() { return randomDouble() < 0.5; }
+
+  int randomInt(int bound) {
+    std::uniform_int_distribution<int> dist(0, bound - 1);
+    return dist(generator);
+  }
+
+  int randomSign() { return randomBoolean() ? 1 : -1; }
+
+  double randomGaussian() { return normalDist(generator); }
+
+  double randomGaussian(double mean, double sd) {
+    return mean + sd * randomGaussian();
+  }
+
+  /**
+   * Fills a buffer with random doubles in [0, 1), drawing from lanes seeded
+   * by this stream.
+   */
+  void fillUniform(double *out, std::size_t count) {
+    Xoshiro256PlusPlusLanes(generator).fillUniform(out, count);
+  }
+
+  void fillUniform(double *out, std::size_t count, double lowerBound,
+                   double higherBound) {
+    fillUniform(out, count);
+    for (std::size_t i = 0; i < count; ++i) {
+      out[i] = lowerBound + (higherBound - lowerBound) * out[i];
+    }
+  }
+
+  /**
+   * Fills a buffer with Gaussian values of mean 0 and standard deviation 1,
+   * drawing from lanes seeded by this stream.
+   */
+  void fillGaussian(double *out, std::size_t count) {
+    Xoshiro256PlusPlusLanes(generator).fillGaussian(out, count);
+  }
+
+  void fillGaussian(double *out, std::size_t count, double mean, double sd) {
+    fillGaussian(out, count);
+    for (std::size_t i = 0; i < count; ++i) {
+      out[i] = mean + sd * out[i];
+    }
+  }
+
+  template <typename T> void shuffle(std::vector<T> &vec) {
+    std::shuffle(vec.begin(), vec.end(), generator);
+  }
+
+  void writeCheckpoint(
+      microkernel::checkpoint::CheckpointWriter &writer) const override {
+    writeRandomState(writer, generator, normalDist);
+  }
+
+  void
+  readCheckpoint(microkernel::checkpoint::CheckpointReader &reader) override {
+    readRandomState(reader, generator, normalDist);
+  }
+
+  /**
+   * Gets the stream installed on the calling thread, or nullptr.
+   */
+  static RandomStream *current() { return currentSlot(); }
+
+  /**
+   * Makes a stream the one used by PRNG on the calling thread for the
+   * lifetime of the scope.
+   */
+  class Scope {
+  private:
+    RandomStream *previous;
+
+  public:
+    explicit Scope(RandomStream &stream) : previous(currentSlot()) {
+      currentSlot() = &stream;
+    }
+    ~Scope() { currentSlot() = previous; }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+  };
+};
+
+/**
+ * Hands out non-overlapping random streams derived from a master seed.
+ *
+ * The n-th stream starts 2^128 draws after the (n-1)-th one, using the jump
+ * function of Xoshiro256++. Giving the streams to the agents in a fixed order
+ * (e.g. while generating them) makes the random values drawn by each agent
+ * independent of the number of threads and of the scheduling of the engine.
+ */
+class RandomStreams {
+private:
+  Xoshiro256PlusPlus cursor;
+
+public:
+  explicit RandomStreams(uint64_t masterSeed) : cursor(masterSeed) {}
+
+  /**
+   * Gets the next stream.
+   */
+  RandomStream next() {
+    RandomStream stream(cursor);
+    cursor.jump();
+    return stream;
+  }
+};
+
+} // namespace random
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // RANDOMSTREAM_H
@@ -1,6 +1,7 @@
 #ifndef XOSHIRO256PLUSPLUS_H
 #define XOSHIRO256PLUSPLUS_H
 
+#include <array>
 #include <cstdint>
 #include <limits>
 
@@ -103,6 +104,20 @@ public:
     s[3] = s3;
   }
 
+  /**
+   * Gets the internal state, e.g. to save it in a checkpoint.
+   */
+  std::array<uint64_t, 4> getState() const { return {s[0], s[1], s[2], s[3]}; }
+
+  /**
+   * Replaces the internal state by one returned by getState().
+   */
+  void setState(const std::array<uint64_t, 4> &state) {
+    for (int i = 0; i < 4; ++i) {
+      s[i] = state[i];
+    }
+  }
+
 private:
   uint64_t s[4];
 
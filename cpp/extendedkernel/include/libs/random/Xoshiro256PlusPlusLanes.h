@@ -0,0 +1,109 @@
+#ifndef XOSHIRO256PLUSPLUSLANES_H
+#define XOSHIRO256PLUSPLUSLANES_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Xoshiro256PlusPlus.h"
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace random {
+
+/**
+ * Several independent Xoshiro256++ generators advanced together, to fill
+ * large buffers of random values.
+ *
+ * The state of the lanes is stored word by word, so that each step of the
+ * generators is a loop over the lanes the compiler turns into SIMD
+ * instructions. The lanes are seeded from draws of a scalar generator: the
+ * values of a batch only depend on the state of that generator, which
+ * advances by one draw per lane.
+ */
+class Xoshiro256PlusPlusLanes {
+public:
+  static constexpr std::size_t LANES = 4;
+
+  /**
+   * Seeds the lanes from a generator.
+   * @param seeder The generator, advanced by LANES draws
+   */
+  explicit Xoshiro256PlusPlusLanes(Xoshiro256PlusPlus &seeder) {
+    for (std::size_t lane = 0; lane < LANES; ++lane) {
+      const auto state = Xoshiro256PlusPlus(seeder()).getState();
+      for (std::size_t word = 0; word < 4; ++word) {
+        s[word][lane] = state[word];
+      }
+    }
+  }
+
+  /**
+   * Fills a buffer with random 64-bit words.
+   */
+  void fillBits(std::uint64_t *out, std::size_t count);
+
+  /**
+   * Fills a buffer with random doubles in [0, 1), uniformly spaced by 2^-53.
+   */
+  void fillUniform(double *out, std::size_t count);
+
+  /**
+   * Fills a buffer with Gaussian values of mean 0 and standard deviation 1,
+   * sampled with the 256-layer Ziggurat method.
+   */
+  void fillGaussian(double *out, std::size_t count);
+
+  /**
+   * Draws one word from the first lane, e.g. for the rare rejections of the
+   * Ziggurat method.
+   */
+  std::uint64_t next() {
+    const std::uint64_t result = rotl(s[0][0] + s[3][0], 23) + s[0][0];
+    const std::uint64_t t = s[1][0] << 17;
+    s[2][0] ^= s[0][0];
+    s[3][0] ^= s[1][0];
+    s[1][0] ^= s[2][0];
+    s[0][0] ^= s[3][0];
+    s[2][0] ^= t;
+    s[3][0] = rotl(s[3][0], 45);
+    return result;
+  }
+
+private:
+  // s[word][lane]
+  alignas(32) std::uint64_t s[4][LANES];
+
+  static inline std::uint64_t rotl(const std::uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+  }
+
+  /**
+   * Draws one word from each lane.
+   */
+  void step(std::uint64_t *out) {
+    for (std::size_t lane = 0; lane < LANES; ++lane) {
+      out[lane] = rotl(s[0][lane] + s[3][lane], 23) + s[0][lane];
+      const std::uint64_t t = s[1][lane] << 17;
+      s[2][lane] ^= s[0][lane];
+      s[3][lane] ^= s[1][lane];
+      s[1][lane] ^= s[2][lane];
+      s[0][lane] ^= s[3][lane];
+      s[2][lane] ^= t;
+      s[3][lane] = rotl(s[3][lane], 45);
+    }
+  }
+};
+
+} // namespace random
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // XOSHIRO256PLUSPLUSLANES_H
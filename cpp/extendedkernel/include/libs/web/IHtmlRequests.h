@@ -41,6 +41,27 @@ public:
    */
   virtual void handleSimulationPauseRequest() = 0;
 
+  /**
+   * Called by the view when the user wants to run a single step of the
+   * simulation, which stays paused afterwards.
+   */
+  virtual void handleSimulationStepRequest() = 0;
+
+  /**
+   * Called by the view when the user wants to pace the simulation.
+   * @param stepsPerSecond The steps per second at most, 0 for no limit.
+   * @throws std::invalid_argument If stepsPerSecond is negative.
+   */
+  virtual void handleStepRateRequest(double stepsPerSecond) = 0;
+
+  /**
+   * Called by the view when the user wants to go back to a recent step of
+   * the paused simulation, which stays paused afterwards.
+   * @param step The identifier of the step.
+   * @throws std::out_of_range If the step is no longer kept.
+   */
+  virtual void handleRewindRequest(long step) = 0;
+
   /**
    * Called by the view when the user wants to shut down the server.
    */
@@ -57,6 +78,8 @@ public:
    * Sets the value of a specific simulation parameter.
    * @param parameter The name of the parameter
    * @param value The new value for the parameter
+   * @throws std::invalid_argument If the parameter is unknown or the value
+   * is not of its type
    */
   virtual void setParameter(const std::string &parameter,
                             const std::string &value) = 0;
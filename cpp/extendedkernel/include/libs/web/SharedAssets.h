@@ -0,0 +1,113 @@
+#ifndef SHAREDASSETS_H
+#define SHAREDASSETS_H
+
+#include <cstddef>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace web {
+
+/**
+ * The immutable assets the sessions of a server share, such as parsed road
+ * networks, lookup tables or agent templates.
+ *
+ * An asset is loaded once, by the first session asking for it; the sessions
+ * asking meanwhile wait for that load instead of loading it again. The
+ * assets are reference counted: each session holds the ones it uses, and
+ * they are never modified, so that the sessions read them without locking.
+ */
+class SharedAssets {
+private:
+  struct Entry {
+    std::type_index type;
+    std::shared_future<std::shared_ptr<const void>> value;
+  };
+
+  mutable std::mutex mutex;
+  std::unordered_map<std::string, Entry> entries;
+
+public:
+  /**
+   * Gets an asset, loading it if no session did.
+   * @param key The name of the asset.
+   * @param load Builds the asset, returning a std::shared_ptr to it. If it
+   * throws, the exception reaches the sessions waiting, and the next
+   * request loads the asset again.
+   * @return The asset.
+   * @throws std::invalid_argument If the asset has another type.
+   */
+  template <typename T, typename Loader>
+  std::shared_ptr<const T> get(const std::string &key, Loader load) {
+    std::shared_future<std::shared_ptr<const void>> value;
+    std::promise<std::shared_ptr<const void>> loading;
+    bool loader = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = entries.find(key);
+      if (it == entries.end()) {
+        value = loading.get_future().share();
+        entries.emplace(key, Entry{std::type_index(typeid(T)), value});
+        loader = true;
+      } else if (it->second.type != std::type_index(typeid(T))) {
+        throw std::invalid_argument("The asset " + key +
+                                    " has another type.");
+      } else {
+        value = it->second.value;
+      }
+    }
+    if (loader) {
+      // Loaded outside the lock, so that the other assets are still served
+      try {
+        std::shared_ptr<const T> asset = load();
+        loading.set_value(std::move(asset));
+      } catch (...) {
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          entries.erase(key);
+        }
+        loading.set_exception(std::current_exception());
+      }
+    }
+    return std::static_pointer_cast<const T>(value.get());
+  }
+
+  bool contains(const std::string &key) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.count(key) != 0;
+  }
+
+  std::size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+  }
+
+  /**
+   * Forgets an asset; the sessions holding it keep it until they end.
+   */
+  void release(const std::string &key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.erase(key);
+  }
+};
+
+} // namespace web
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SHAREDASSETS_H
@@ -0,0 +1,155 @@
+#ifndef SIMILARSESSIONSERVER_H
+#define SIMILARSESSIONSERVER_H
+
+#include "ISimulationEngine.h"
+#include "SharedAssets.h"
+#include "SimilarWebConfig.h"
+#include "SimilarWebRunner.h"
+#include "simulationmodel/ISimulationModel.h"
+#include "view/StaticFileCache.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Forward declare httplib
+namespace httplib {
+class Server;
+class ThreadPool;
+} // namespace httplib
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace web {
+
+/**
+ * Hosts many concurrent simulations in one process, each one a session with
+ * the view of a SimilarWebRunner under /sessions/<id>/.
+ *
+ * The sessions share:
+ * - the assets their factory gets from the server, loaded once;
+ * - the static files of the view;
+ * - a pool of threads running their simulations, sized by the
+ *   configuration. Once all its threads are taken, the next runs wait.
+ *   A paused run keeps its thread.
+ *
+ * The sessions should use SequentialSimulationEngine, since the pool
+ * already spreads the sessions over the cores. Each state stream holds an
+ * HTTP thread, so the HTTP pool has one thread per possible stream on top
+ * of the configured ones.
+ */
+class SimilarSessionServer {
+public:
+  /**
+   * The engine and the model of a new session.
+   */
+  struct SessionSimulation {
+    std::shared_ptr<microkernel::ISimulationEngine> engine;
+    std::shared_ptr<simulationmodel::ISimulationModel> model;
+  };
+
+  /**
+   * Builds the simulation of a new session, from the shared assets. It may
+   * run concurrently for several sessions.
+   */
+  using SessionFactory = std::function<SessionSimulation(SharedAssets &)>;
+
+private:
+  SimilarWebConfig config;
+  SessionFactory factory;
+  SharedAssets assets;
+  std::shared_ptr<view::StaticFileCache> staticFiles;
+
+  mutable std::mutex sessionsMutex;
+  std::map<std::uint64_t, std::shared_ptr<SimilarWebRunner>> sessions;
+  std::uint64_t nextSessionId;
+  std::unique_ptr<httplib::ThreadPool> simulationPool;
+
+  std::unique_ptr<httplib::Server> server;
+  std::thread listener;
+  int boundPort;
+
+  void setupRoutes();
+  std::string generateLobbyPage();
+
+public:
+  /**
+   * Creates a server building the simulations of its sessions with a
+   * factory.
+   * @param factory The factory of the simulations
+   */
+  explicit SimilarSessionServer(SessionFactory factory);
+
+  /**
+   * Stops the server and closes its sessions.
+   */
+  ~SimilarSessionServer();
+
+  SimilarSessionServer(const SimilarSessionServer &) = delete;
+  SimilarSessionServer &operator=(const SimilarSessionServer &) = delete;
+
+  /**
+   * Gets the configuration, of the server and of the views of its sessions.
+   */
+  SimilarWebConfig *getConfig() { return &config; }
+
+  /**
+   * Gets the assets shared by the sessions.
+   */
+  SharedAssets &getAssets() { return assets; }
+
+  /**
+   * Opens a session, building its simulation.
+   * @return The identifier of the session
+   * @throws std::runtime_error if the server hosts the most sessions
+   */
+  std::uint64_t openSession();
+
+  /**
+   * Closes a session, aborting its simulation.
+   * @return False if no session has this identifier
+   */
+  bool closeSession(std::uint64_t id);
+
+  /**
+   * Gets a session.
+   * @return The runner of the session, nullptr if none has this identifier
+   */
+  std::shared_ptr<SimilarWebRunner> getSession(std::uint64_t id) const;
+
+  std::size_t getSessionCount() const;
+
+  /**
+   * Starts serving the sessions on the port of the configuration, or on any
+   * free port if it is 0, on all the network interfaces.
+   * @throws std::runtime_error if the port cannot be bound
+   */
+  void start();
+
+  /**
+   * Gets the port the server listens to, once started.
+   */
+  int getPort() const { return boundPort; }
+
+  /**
+   * Stops serving and closes the sessions.
+   */
+  void stop();
+};
+
+} // namespace web
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILARSESSIONSERVER_H
@@ -20,6 +20,13 @@ private:
   std::string simulationName;
   bool initialized;
   bool autoOpenBrowser;
+  int httpThreadCount;
+  int maxQueuedRequests;
+  int maxStreamClients;
+  int maxSessions;
+  int simulationThreadCount;
+  int rewindSteps;
+  int rewindKeyFramePeriod;
 
 public:
   /**
@@ -68,6 +75,89 @@ public:
    * Sets whether to automatically open browser.
    */
   void setAutoOpenBrowser(bool autoOpen) { this->autoOpenBrowser = autoOpen; }
+
+  /**
+   * Gets the number of threads handling the HTTP requests.
+   */
+  int getHttpThreadCount() const { return httpThreadCount; }
+
+  /**
+   * Sets the number of threads handling the HTTP requests, so that the view
+   * takes a bounded share of the cores from the simulation.
+   */
+  void setHttpThreadCount(int count) { this->httpThreadCount = count; }
+
+  /**
+   * Gets the number of requests waiting for a thread at most, the next ones
+   * being refused; 0 for no limit.
+   */
+  int getMaxQueuedRequests() const { return maxQueuedRequests; }
+
+  /**
+   * Sets the number of requests waiting for a thread at most.
+   */
+  void setMaxQueuedRequests(int count) { this->maxQueuedRequests = count; }
+
+  /**
+   * Gets the number of state streams open at once at most. A stream holds
+   * an HTTP thread while it is open, so this is kept below the number of
+   * threads.
+   */
+  int getMaxStreamClients() const { return maxStreamClients; }
+
+  /**
+   * Sets the number of state streams open at once at most.
+   */
+  void setMaxStreamClients(int count) { this->maxStreamClients = count; }
+
+  /**
+   * Gets the number of sessions a session server hosts at once at most.
+   */
+  int getMaxSessions() const { return maxSessions; }
+
+  /**
+   * Sets the number of sessions a session server hosts at once at most.
+   */
+  void setMaxSessions(int count) { this->maxSessions = count; }
+
+  /**
+   * Gets the number of threads of a session server running the simulations
+   * of its sessions, the next runs waiting for one; 0 for the number of
+   * cores.
+   */
+  int getSimulationThreadCount() const { return simulationThreadCount; }
+
+  /**
+   * Sets the number of threads of a session server running the simulations.
+   */
+  void setSimulationThreadCount(int count) {
+    this->simulationThreadCount = count;
+  }
+
+  /**
+   * Gets the number of recent steps the view can go back to; 0, the
+   * default, for none.
+   */
+  int getRewindSteps() const { return rewindSteps; }
+
+  /**
+   * Sets the number of recent steps the view can go back to, kept by a
+   * rewind buffer of the engine (see
+   * microkernel::engine::RewindBuffer).
+   */
+  void setRewindSteps(int steps) { this->rewindSteps = steps; }
+
+  /**
+   * Gets the number of steps between two snapshots of the rewind buffer.
+   */
+  int getRewindKeyFramePeriod() const { return rewindKeyFramePeriod; }
+
+  /**
+   * Sets the number of steps between two snapshots of the rewind buffer.
+   */
+  void setRewindKeyFramePeriod(int period) {
+    this->rewindKeyFramePeriod = period;
+  }
 };
 
 } // namespace web
@@ -5,10 +5,17 @@
 #include "ISimulationEngine.h"
 #include "SimilarWebConfig.h"
 #include "control/SimilarWebController.h"
+#include "engine/ModelPlugin.h"
+#include "libs/probes/AsyncProbe.h"
 #include "simulationmodel/ISimulationModel.h"
 #include "simulationmodel/ISimulationParameters.h"
+#include "SimulationExecutionThread.h"
 #include "view/SimilarHttpServer.h"
+#include "view/StaticFileCache.h"
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 // Forward declarations
 namespace fr::univ_artois::lgi2a::similar::microkernel {
@@ -41,6 +48,15 @@ private:
   simulationmodel::ISimulationParameters *simulationParameters;
   std::unique_ptr<control::SimilarWebController> controller;
   std::unique_ptr<view::SimilarHttpServer> httpServer;
+  std::shared_ptr<microkernel::libs::SimulationMetrics> metrics;
+  // The state stream probes, whose queues the metrics export
+  std::vector<std::pair<std::string,
+                        std::shared_ptr<probes::AsyncProbe<std::string>>>>
+      streamProbes;
+
+  void initialize(std::shared_ptr<microkernel::ISimulationEngine> engine,
+                  std::shared_ptr<simulationmodel::ISimulationModel> model,
+                  std::shared_ptr<view::StaticFileCache> staticFiles);
 
 public:
   /**
@@ -48,7 +64,10 @@ public:
    */
   SimilarWebRunner();
 
-  virtual ~SimilarWebRunner() = default;
+  /**
+   * Aborts the simulation still running, and waits for its end.
+   */
+  virtual ~SimilarWebRunner();
 
   /**
    * Initializes the runner with a specific simulation model.
@@ -61,6 +80,46 @@ public:
   initializeRunner(std::shared_ptr<microkernel::ISimulationEngine> engine,
                    std::shared_ptr<simulationmodel::ISimulationModel> model);
 
+  /**
+   * Initializes the runner with the model of a plugin, and the batch
+   * behaviors of the plugin set to the engine.
+   * This operation can only be performed once.
+   * @param engine The simulation engine
+   * @param plugin The plugin, whose model is a model of the extended kernel
+   * @param arguments The arguments of the model
+   * @throws std::runtime_error if already initialized
+   * @throws std::invalid_argument if the model is not one of the extended
+   * kernel
+   */
+  void initializeRunner(std::shared_ptr<microkernel::ISimulationEngine> engine,
+                        const microkernel::engine::ModelPlugin &plugin,
+                        const std::string &arguments = "");
+
+  /**
+   * Initializes the runner as a session of a session server: its view has
+   * no HTTP server of its own, and the server forwards the requests under
+   * the path of the session to handleViewRequest().
+   * @param engine The simulation engine
+   * @param model The simulation model
+   * @param staticFiles The static files, shared by the sessions
+   * @param executor Runs the simulations, such as a shared pool
+   * @throws std::runtime_error if already initialized
+   */
+  void
+  initializeRunner(std::shared_ptr<microkernel::ISimulationEngine> engine,
+                   std::shared_ptr<simulationmodel::ISimulationModel> model,
+                   std::shared_ptr<view::StaticFileCache> staticFiles,
+                   SimulationExecutionThread::Executor executor);
+
+  /**
+   * Answers a request of the view of a session.
+   * @param action The last segment of the path, empty for the page
+   * @return False if the action is unknown
+   * @throws std::runtime_error if not initialized
+   */
+  bool handleViewRequest(const std::string &action,
+                         const httplib::Request &req, httplib::Response &res);
+
   /**
    * Opens the view on the simulation.
    * @throws std::runtime_error if not initialized
@@ -90,6 +149,37 @@ public:
   void addProbe(const std::string &name,
                 std::shared_ptr<microkernel::IProbe> probe);
 
+  /**
+   * Adds a probe publishing the state of the simulation to the view, as the
+   * "state" events of /events.
+   *
+   * The snapshot function runs on the simulation thread; the publication
+   * runs on a thread of the probe, and the snapshots the view did not take
+   * yet are replaced by the newer ones, so the simulation never waits for
+   * the view. The runner adds one, publishing the step as {"step": n}.
+   * @param name The name of the probe
+   * @param snapshot Renders the state of the simulation, as JSON
+   * @throws std::runtime_error if not initialized
+   */
+  void addStateStreamProbe(
+      const std::string &name,
+      probes::AsyncProbe<std::string>::SnapshotFunction snapshot);
+
+  /**
+   * Serves the tiles of a source to the view, as /tiles and /tile.
+   * @throws std::runtime_error if not initialized
+   */
+  void setTileSource(std::shared_ptr<view::ITileSource> source);
+
+  /**
+   * Exports the telemetry of the simulation on /metrics: the metrics become
+   * the step timing listener of the engine, forwarding the timings to the
+   * former one, and the depth of the state stream probes is exported.
+   * @return The metrics
+   * @throws std::runtime_error if not initialized
+   */
+  std::shared_ptr<microkernel::libs::SimulationMetrics> enableMetrics();
+
   /**
    * Gets the simulation engine.
    * @return The engine
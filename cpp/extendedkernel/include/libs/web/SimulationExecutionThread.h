@@ -2,7 +2,10 @@
 #define SIMULATIONEXECUTIONTHREAD_H
 
 #include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <thread>
 
 // Forward declarations
@@ -23,25 +26,45 @@ namespace web {
 
 /**
  * Thread that executes a simulation in the background.
+ *
+ * The simulation runs on a thread of its own, or on the one an executor
+ * provides, such as a pool shared by the sessions of a server. A run still
+ * waiting for the executor can be cancelled.
  */
 class SimulationExecutionThread {
+public:
+  /**
+   * Runs a task on a thread, later.
+   */
+  using Executor = std::function<void(std::function<void()>)>;
+
 private:
+  enum class Phase { QUEUED, RUNNING, CANCELLED, FINISHED };
+
+  // Shared with the task, which the executor may run after this is gone
+  struct RunState {
+    std::atomic<Phase> phase{Phase::QUEUED};
+    std::mutex mutex;
+    std::condition_variable ended;
+  };
+
   std::shared_ptr<microkernel::ISimulationEngine> engine;
   std::shared_ptr<simulationmodel::ISimulationModel> model;
+  Executor executor;
   std::unique_ptr<std::thread> thread;
-  std::atomic<bool> finished;
-
-  void run();
+  std::shared_ptr<RunState> state;
 
 public:
   /**
    * Creates a new simulation execution thread.
    * @param engine The simulation engine
    * @param model The simulation model
+   * @param executor Runs the simulation; nullptr for a thread of its own
    */
   SimulationExecutionThread(
       std::shared_ptr<microkernel::ISimulationEngine> engine,
-      std::shared_ptr<simulationmodel::ISimulationModel> model);
+      std::shared_ptr<simulationmodel::ISimulationModel> model,
+      Executor executor = nullptr);
 
   ~SimulationExecutionThread();
 
@@ -52,9 +75,15 @@ public:
 
   /**
    * Checks if the simulation has finished.
-   * @return true if finished, false otherwise
+   * @return true if finished or cancelled, false otherwise
+   */
+  bool hasFinished() const;
+
+  /**
+   * Cancels the simulation if the executor did not start it yet.
+   * @return true if the simulation will not run
    */
-  bool hasFinished() const { return finished.load(); }
+  bool cancel();
 
   /**
    * Waits for the simulation thread to complete.
@@ -8,7 +8,9 @@
 #include "IProbe.h"
 #include "ISimulationEngine.h"
 #include "SimulationTimeStamp.h"
+#include "engine/StepBarrier.h"
 #include "simulationmodel/ISimulationModel.h"
+#include "simulationmodel/ParameterStore.h"
 #include <atomic>
 #include <memory>
 #include <mutex>
@@ -39,11 +41,19 @@ private:
                       simulationmodel::ISimulationModel>
       model;
   std::unique_ptr<SimulationExecutionThread> simuThread;
+  SimulationExecutionThread::Executor runExecutor;
   IHtmlControls *viewControls;
+  // Where the engine waits while paused, instead of in the probe
+  std::shared_ptr<fr::univ_artois::lgi2a::similar::microkernel::engine::
+                      StepBarrier>
+      stepBarrier;
+  // The parameters the view tunes, published between two steps; nullptr if
+  // the model has none
+  fr::univ_artois::lgi2a::similar::extendedkernel::simulationmodel::
+      ParameterStore *parameters;
 
   mutable std::mutex stateMutex;
   EngineState engineState;
-  std::atomic<bool> togglePause;
   std::atomic<bool> listenToRequests; // Renamed to avoid conflict
   std::atomic<bool> allowShutDown;
 
@@ -76,6 +86,21 @@ public:
    */
   void listenToViewRequests();
 
+  /**
+   * Sets what runs the simulations, such as a pool shared by the sessions
+   * of a server.
+   * @param executor The executor, or nullptr for a thread of their own
+   */
+  void setRunExecutor(SimulationExecutionThread::Executor executor) {
+    runExecutor = std::move(executor);
+  }
+
+  /**
+   * Stops listening to view requests, then aborts the simulation, or
+   * cancels it if it did not start, and waits for its end.
+   */
+  void stopSimulation();
+
   /**
    * Sets whether shutdown is allowed.
    */
@@ -91,6 +116,15 @@ public:
   void handleNewSimulationRequest() override;
   void handleSimulationAbortionRequest() override;
   void handleSimulationPauseRequest() override;
+  void handleSimulationStepRequest() override;
+  void handleStepRateRequest(double stepsPerSecond) override;
+  /**
+   * {@inheritDoc}
+   *
+   * Needs a MultiThreadedSimulationEngine with a rewind buffer, waiting
+   * paused at its step barrier.
+   */
+  void handleRewindRequest(long step) override;
   void handleShutDownRequest() override;
   std::string getParameter(const std::string &parameter) override;
   void setParameter(const std::string &parameter,
@@ -0,0 +1,58 @@
+#ifndef ITILESOURCE_H
+#define ITILESOURCE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace web {
+namespace view {
+
+/**
+ * The image tiles the view overlays on the simulation, e.g. the heatmaps of
+ * the pheromone fields, served as /tiles and /tile (see SimilarHttpServer).
+ *
+ * Each layer is a pyramid of tiles: at zoom 0 a tile covers the whole layer,
+ * and each zoom splits a tile into 2 x 2 tiles of the same size. A tile
+ * keeps its version until its content changes, so that the browsers reuse
+ * the tiles they already have.
+ */
+class ITileSource {
+public:
+  struct Tile {
+    // The encoded image, nullptr if the tile does not exist
+    std::shared_ptr<const std::string> data;
+    std::uint64_t version = 0;
+  };
+
+  virtual ~ITileSource() = default;
+
+  /**
+   * Describes the layers, as JSON: their names, sizes and zooms.
+   */
+  virtual std::string describeLayers() const = 0;
+
+  /**
+   * Gets a tile; it is called by the threads of the server.
+   */
+  virtual Tile getTile(const std::string &layer, int zoom, int x, int y) = 0;
+
+  virtual std::string getMimeType() const { return "image/png"; }
+};
+
+} // namespace view
+} // namespace web
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // ITILESOURCE_H
@@ -0,0 +1,66 @@
+#ifndef PNGENCODER_H
+#define PNGENCODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace web {
+namespace view {
+
+/**
+ * Encodes images of 8-bit palette indices as PNG files, e.g. the tiles of a
+ * heatmap (see ITileSource).
+ *
+ * The pixels are deflated with the fixed Huffman codes and the repeats of
+ * the previous pixel or of the pixel above: the runs and the flat regions of
+ * a colour-mapped field take a few bytes, with no dependency on zlib. The
+ * palette holds RGBA colors, their alpha going to a tRNS chunk.
+ */
+class PngEncoder {
+public:
+  /**
+   * @param paletteRgba The colors, 4 bytes each.
+   * @throws std::invalid_argument If the palette does not have 1 to 256
+   * colors.
+   */
+  explicit PngEncoder(std::vector<std::uint8_t> paletteRgba);
+
+  std::size_t getPaletteSize() const { return palette.size() / 4; }
+
+  /**
+   * Encodes an image.
+   * @param indices The palette indices of the pixels, row by row.
+   * @return The PNG file.
+   * @throws std::invalid_argument If a dimension is not positive.
+   */
+  std::string encode(int width, int height, const std::uint8_t *indices);
+
+private:
+  std::vector<std::uint8_t> palette;
+  // the rows of the image being encoded, each after its filter byte
+  std::vector<std::uint8_t> scanlines;
+  std::string file;
+
+  std::size_t beginChunk(const char *type);
+  void endChunk(std::size_t start);
+  void deflate(std::size_t stride);
+};
+
+} // namespace view
+} // namespace web
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // PNGENCODER_H
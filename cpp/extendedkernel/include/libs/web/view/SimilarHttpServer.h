@@ -4,6 +4,10 @@
 #include "../IHtmlControls.h"
 #include "../IHtmlInitializationData.h"
 #include "../IHtmlRequests.h"
+#include "ITileSource.h"
+#include "StateStream.h"
+#include "StaticFileCache.h"
+#include "libs/SimulationMetrics.h"
 #include <atomic>
 #include <memory>
 #include <string>
@@ -11,6 +15,8 @@
 // Forward declare httplib
 namespace httplib {
 class Server;
+struct Request;
+struct Response;
 }
 
 namespace fr {
@@ -25,19 +31,45 @@ namespace view {
 /**
  * HTTP server managing the HTML view on the simulation.
  * Uses cpp-httplib for HTTP serving.
+ *
+ * The requests are handled by a bounded pool of threads, sized by the
+ * configuration, so that the view never takes more than a few cores from
+ * the simulation. The static files are read from the disk once, then
+ * served from memory. Besides the polled /state, /events streams the
+ * messages of the state stream as server-sent events: the button states
+ * and what probes publish, such as the current step. /tile serves the
+ * images of a tile source with their version as ETag, so that the browsers
+ * only fetch the tiles that changed. /metrics exports the telemetry of the
+ * simulation, if metrics were set, to monitoring systems such as
+ * Prometheus: in the OpenMetrics format when the scraper accepts it, in the
+ * text format of Prometheus otherwise.
+ *
+ * A mounted server has no HTTP server of its own: a session server, hosting
+ * many views, forwards the requests under the path of the view to
+ * handleRequest().
  */
 class SimilarHttpServer : public IHtmlControls {
 private:
   IHtmlRequests *controller;
   IHtmlInitializationData *initData;
-  std::unique_ptr<httplib::Server> server;
+  std::unique_ptr<httplib::Server> server; // nullptr if mounted
   std::atomic<bool> running;
   int port;
+  std::shared_ptr<StateStream> stateStream;
+  // Shared with the streams, which may outlive a mounted view
+  std::shared_ptr<std::atomic<int>> streamClients;
+  std::atomic<bool> startActive;
+  std::atomic<bool> pauseActive;
+  std::atomic<bool> abortActive;
+  std::shared_ptr<StaticFileCache> staticFiles;
+  std::shared_ptr<ITileSource> tileSource;
+  std::shared_ptr<microkernel::libs::SimulationMetrics> metrics;
 
   void setupRoutes();
-  std::string loadStaticFile(const std::string &path);
-  std::string getMimeType(const std::string &path);
+  void serveTile(const httplib::Request &req, httplib::Response &res);
+  void serveMetrics(const httplib::Request &req, httplib::Response &res);
   std::string generateHtmlPage();
+  void publishControls();
 
 public:
   /**
@@ -48,6 +80,16 @@ public:
   SimilarHttpServer(IHtmlRequests *controller,
                     IHtmlInitializationData *initData);
 
+  /**
+   * Creates a mounted server, without an HTTP server of its own.
+   * @param controller The controller handling requests
+   * @param initData Initialization data
+   * @param staticFiles The static files, shared with the other views
+   */
+  SimilarHttpServer(IHtmlRequests *controller,
+                    IHtmlInitializationData *initData,
+                    std::shared_ptr<StaticFileCache> staticFiles);
+
   ~SimilarHttpServer();
 
   /**
@@ -61,10 +103,37 @@ public:
   void showView();
 
   /**
-   * Stops the server.
+   * Stops the server; a mounted server closes its state stream only.
    */
   void stop();
 
+  /**
+   * Answers a request of the view.
+   * @param action The last segment of the path: empty for the page, or
+   * state, start, stop, pause, step, rate, shutdown, setParameter,
+   * getParameter, events, tiles, tile or metrics.
+   * @return False if the action is unknown.
+   */
+  bool handleRequest(const std::string &action, const httplib::Request &req,
+                     httplib::Response &res);
+
+  /**
+   * Gets the stream of the messages pushed to the view.
+   */
+  std::shared_ptr<StateStream> getStateStream() const { return stateStream; }
+
+  /**
+   * Sets the tiles of /tiles and /tile, nullptr for none.
+   */
+  void setTileSource(std::shared_ptr<ITileSource> source);
+
+  /**
+   * Sets the metrics of /metrics, nullptr for none. They are given to the
+   * engine as its step timing listener by the caller.
+   */
+  void
+  setMetrics(std::shared_ptr<microkernel::libs::SimulationMetrics> metrics);
+
   // IHtmlControls implementation
   void setStartButtonState(bool active) override;
   void setPauseButtonState(bool active) override;
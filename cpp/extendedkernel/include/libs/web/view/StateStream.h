@@ -0,0 +1,78 @@
+#ifndef STATESTREAM_H
+#define STATESTREAM_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace web {
+namespace view {
+
+/**
+ * The latest messages of the web view, for its server-sent event streams.
+ *
+ * Each kind of event keeps its last message only: a publisher, such as a
+ * probe on the simulation thread, replaces it and never waits for the
+ * readers, and a slow reader skips to the latest messages instead of
+ * queuing the ones it missed. A reader keeps the version of the last
+ * messages it got, 0 at first.
+ */
+class StateStream {
+private:
+  struct Message {
+    std::uint64_t version;
+    std::string text; // Formatted as a server-sent event
+  };
+
+  mutable std::mutex mutex;
+  std::condition_variable updated;
+  std::map<std::string, Message> messages;
+  std::uint64_t version = 0;
+  bool closed = false;
+
+public:
+  /**
+   * Publishes a message, replacing the previous one of its event.
+   * @param event The name of the event, without line breaks.
+   * @param data The data of the message; each line becomes a data field.
+   */
+  void publish(const std::string &event, const std::string &data);
+
+  /**
+   * Waits for the messages published after a version.
+   * @param version The version of the messages read last, set to the one
+   * of the messages got.
+   * @param text Set to the messages, as server-sent events.
+   * @param timeout The longest wait.
+   * @return False on timeout or once the stream is closed.
+   */
+  bool waitForUpdate(std::uint64_t &version, std::string &text,
+                     std::chrono::milliseconds timeout);
+
+  /**
+   * Wakes up the readers for good, as the server stops.
+   */
+  void close();
+
+  bool isClosed() const;
+};
+
+} // namespace view
+} // namespace web
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // STATESTREAM_H
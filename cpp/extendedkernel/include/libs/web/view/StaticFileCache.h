@@ -0,0 +1,64 @@
+#ifndef STATICFILECACHE_H
+#define STATICFILECACHE_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Forward declare httplib
+namespace httplib {
+struct Response;
+}
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace web {
+namespace view {
+
+/**
+ * The static files of the web view, read from the disk once, then served
+ * from memory. The views of several sessions share a cache.
+ */
+class StaticFileCache {
+private:
+  std::string root;
+  std::mutex mutex;
+  std::unordered_map<std::string, std::shared_ptr<const std::string>> files;
+
+public:
+  /**
+   * Creates a cache of the files in a directory.
+   * @param root The directory, ending with a slash.
+   */
+  explicit StaticFileCache(std::string root = "extendedkernel/resources/web/");
+
+  /**
+   * Gets the content of a file.
+   * @param path The path of the file in the directory.
+   * @return The content, nullptr if the file cannot be read.
+   */
+  std::shared_ptr<const std::string> load(const std::string &path);
+
+  /**
+   * Answers a request with a file, or a 404 status if it does not exist.
+   */
+  void serve(const std::string &path, httplib::Response &res);
+
+  static std::string getMimeType(const std::string &path);
+};
+
+} // namespace view
+} // namespace web
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // STATICFILECACHE_H
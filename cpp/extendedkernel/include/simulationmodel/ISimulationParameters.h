@@ -8,6 +8,8 @@ namespace similar {
 namespace extendedkernel {
 namespace simulationmodel {
 
+class ParameterStore;
+
 /**
  * Stub interface for simulation parameters (minimal for web interface
  * compilation)
@@ -15,6 +17,12 @@ namespace simulationmodel {
 class ISimulationParameters {
 public:
   virtual ~ISimulationParameters() = default;
+
+  /**
+   * Gets the parameters a view may tune while the simulation runs.
+   * @return The store of the parameters, nullptr if none can be tuned.
+   */
+  virtual ParameterStore *getParameterStore() { return nullptr; }
 };
 
 } // namespace simulationmodel
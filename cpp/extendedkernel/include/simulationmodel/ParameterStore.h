@@ -0,0 +1,153 @@
+#ifndef PARAMETERSTORE_H
+#define PARAMETERSTORE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace simulationmodel {
+
+/**
+ * Typed parameters a view tunes while the simulation runs.
+ *
+ * The values are double-buffered. The view writes to staged values under a
+ * mutex. Between two steps, the engine thread calls commit() to publish
+ * them. The code of the agents reads the published values through a
+ * handle, without locking or waiting, and sees the same values during a
+ * whole step.
+ *
+ * The parameters are declared before the simulation starts. A reference to
+ * a value read is only valid until the end of the step.
+ */
+class ParameterStore {
+public:
+  using Value = std::variant<bool, std::int64_t, double, std::string>;
+
+  /**
+   * The handle of a parameter of type T, to read its value.
+   */
+  template <typename T> class Parameter {
+  private:
+    friend class ParameterStore;
+    std::size_t index;
+    explicit Parameter(std::size_t index) : index(index) {}
+  };
+
+private:
+  mutable std::mutex writerMutex;
+  std::map<std::string, std::size_t> indices;
+  std::vector<Value> staged;
+  std::atomic<bool> dirty{false};
+  // The published values, one buffer read while the other is refreshed
+  std::vector<Value> buffers[2];
+  std::atomic<const std::vector<Value> *> published{&buffers[0]};
+
+  std::size_t indexOf(const std::string &name) const;
+
+  template <typename T> static constexpr void checkType() {
+    static_assert(std::is_same_v<T, bool> || std::is_same_v<T, std::int64_t> ||
+                      std::is_same_v<T, double> ||
+                      std::is_same_v<T, std::string>,
+                  "The parameters are bool, std::int64_t, double or "
+                  "std::string");
+  }
+
+public:
+  ParameterStore() = default;
+  ParameterStore(const ParameterStore &) = delete;
+  ParameterStore &operator=(const ParameterStore &) = delete;
+
+  /**
+   * Declares a parameter, published at once.
+   * @param name The name of the parameter.
+   * @param initialValue Its value until a view changes it.
+   * @return The handle of the parameter.
+   * @throws std::invalid_argument If the name is already declared.
+   */
+  template <typename T>
+  Parameter<T> declare(const std::string &name, const T &initialValue) {
+    checkType<T>();
+    std::lock_guard<std::mutex> lock(writerMutex);
+    if (indices.count(name) != 0) {
+      throw std::invalid_argument("The parameter " + name +
+                                  " is already declared.");
+    }
+    const std::size_t index = staged.size();
+    indices.emplace(name, index);
+    staged.emplace_back(initialValue);
+    buffers[0] = staged;
+    buffers[1] = staged;
+    published.store(&buffers[0], std::memory_order_release);
+    return Parameter<T>(index);
+  }
+
+  /**
+   * Gets the value of a parameter published last, without waiting.
+   */
+  template <typename T> const T &get(const Parameter<T> &parameter) const {
+    const std::vector<Value> &values =
+        *published.load(std::memory_order_acquire);
+    return *std::get_if<T>(&values[parameter.index]);
+  }
+
+  /**
+   * Stages a new value of a parameter, published by the next commit().
+   */
+  template <typename T>
+  void set(const Parameter<T> &parameter, const std::common_type_t<T> &value) {
+    std::lock_guard<std::mutex> lock(writerMutex);
+    staged[parameter.index] = value;
+    dirty.store(true, std::memory_order_release);
+  }
+
+  /**
+   * Stages a new value of a parameter from its text, as a view sends it.
+   * @param name The name of the parameter.
+   * @param text The value: true or false, an integer, a real or any text,
+   * depending on the type of the parameter.
+   * @throws std::invalid_argument If the parameter is unknown or the text
+   * is not a value of its type.
+   */
+  void set(const std::string &name, const std::string &text);
+
+  /**
+   * Gets the text of the value of a parameter, staged last.
+   * @throws std::invalid_argument If the parameter is unknown.
+   */
+  std::string getText(const std::string &name) const;
+
+  bool isDeclared(const std::string &name) const;
+
+  /**
+   * Gets the names of the parameters, in alphabetical order.
+   */
+  std::vector<std::string> getNames() const;
+
+  /**
+   * Publishes the staged values. The engine thread calls it between two
+   * steps, while no agent reads the values.
+   * @return True if values were staged since the previous commit.
+   */
+  bool commit();
+};
+
+} // namespace simulationmodel
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // PARAMETERSTORE_H
@@ -76,6 +76,27 @@ function pauseSimulation() {
     $.get('pause');
 }
 
+/**
+ * Runs a single step of the simulation, then pauses it.
+ */
+function stepSimulation() {
+    $.get('step');
+}
+
+/**
+ * Limits the steps per second of the simulation, 0 for no limit.
+ */
+function setStepRate() {
+    $.get('rate?hz=' + $('#rate').val());
+}
+
+/**
+ * Brings the paused simulation back to a recent step.
+ */
+function rewindSimulation() {
+    $.get('rewind?step=' + $('#rewind').val());
+}
+
 /**
  * Exits the simulation.
  */
@@ -0,0 +1,177 @@
+#include "agents/CoroutineDecisionModel.h"
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace agents {
+
+namespace {
+
+thread_local CoroutineFramePool *currentPool = nullptr;
+
+// The frames start with the pool they come from, on a whole alignment so
+// that the frame keeps the one of the heap
+constexpr std::size_t HEADER = alignof(std::max_align_t);
+
+} // namespace
+
+CoroutineFramePool::~CoroutineFramePool() {
+  for (auto &blocks : freeBlocks) {
+    for (void *block : blocks) {
+      ::operator delete(block);
+    }
+  }
+}
+
+std::size_t CoroutineFramePool::classOf(std::size_t bytes) {
+  std::size_t size = 64;
+  std::size_t sizeClass = 0;
+  while (size < bytes) {
+    size *= 2;
+    ++sizeClass;
+  }
+  return sizeClass;
+}
+
+void *CoroutineFramePool::allocate(std::size_t bytes) {
+  if (bytes > MAX_POOLED_BYTES) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++liveBlocks;
+    ++allocatedBlocks;
+    return ::operator new(bytes);
+  }
+  const std::size_t sizeClass = classOf(bytes);
+  std::lock_guard<std::mutex> lock(mutex);
+  ++liveBlocks;
+  auto &blocks = freeBlocks[sizeClass];
+  if (!blocks.empty()) {
+    void *block = blocks.back();
+    blocks.pop_back();
+    return block;
+  }
+  ++allocatedBlocks;
+  return ::operator new(std::size_t(64) << sizeClass);
+}
+
+void CoroutineFramePool::deallocate(void *block, std::size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex);
+  --liveBlocks;
+  if (bytes > MAX_POOLED_BYTES) {
+    ::operator delete(block);
+    return;
+  }
+  freeBlocks[classOf(bytes)].push_back(block);
+}
+
+std::size_t CoroutineFramePool::getLiveBlocks() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return liveBlocks;
+}
+
+std::size_t CoroutineFramePool::getAllocatedBlocks() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return allocatedBlocks;
+}
+
+CoroutineFramePool *CoroutineFramePool::current() { return currentPool; }
+
+CoroutineFramePool::Scope::Scope(CoroutineFramePool *pool)
+    : previous(currentPool) {
+  currentPool = pool;
+}
+
+CoroutineFramePool::Scope::~Scope() { currentPool = previous; }
+
+std::suspend_never DecisionCoroutine::promise_type::yield_value(
+    std::shared_ptr<microkernel::influences::IInfluence> influence) {
+  influences->add(std::move(influence));
+  return {};
+}
+
+void *DecisionCoroutine::promise_type::operator new(std::size_t bytes) {
+  CoroutineFramePool *pool = currentPool;
+  void *block = pool ? pool->allocate(bytes + HEADER)
+                     : ::operator new(bytes + HEADER);
+  *static_cast<CoroutineFramePool **>(block) = pool;
+  return static_cast<char *>(block) + HEADER;
+}
+
+void DecisionCoroutine::promise_type::operator delete(void *frame,
+                                                      std::size_t bytes) {
+  void *block = static_cast<char *>(frame) - HEADER;
+  CoroutineFramePool *pool = *static_cast<CoroutineFramePool **>(block);
+  if (pool) {
+    pool->deallocate(block, bytes + HEADER);
+  } else {
+    ::operator delete(block);
+  }
+}
+
+DecisionCoroutine &
+DecisionCoroutine::operator=(DecisionCoroutine &&other) noexcept {
+  if (this != &other) {
+    if (handle) {
+      handle.destroy();
+    }
+    handle = other.handle;
+    other.handle = nullptr;
+  }
+  return *this;
+}
+
+DecisionCoroutine::~DecisionCoroutine() {
+  if (handle) {
+    handle.destroy();
+  }
+}
+
+void DecisionCoroutine::resume(
+    microkernel::influences::InfluencesMap &influences) {
+  if (done()) {
+    return;
+  }
+  promise_type &promise = handle.promise();
+  promise.influences = &influences;
+  handle.resume();
+  promise.influences = nullptr;
+  if (promise.error) {
+    std::rethrow_exception(std::exchange(promise.error, nullptr));
+  }
+}
+
+void CoroutineDecisionModel::decide(
+    const microkernel::SimulationTimeStamp &timeLowerBound,
+    const microkernel::SimulationTimeStamp &timeUpperBound,
+    std::shared_ptr<microkernel::agents::IGlobalState> globalState,
+    std::shared_ptr<microkernel::agents::ILocalStateOfAgent> publicLocalState,
+    std::shared_ptr<microkernel::agents::ILocalStateOfAgent> privateLocalState,
+    std::shared_ptr<microkernel::agents::IPerceivedData> perceivedData,
+    std::shared_ptr<microkernel::influences::InfluencesMap>
+        producedInfluences) {
+  context.timeLowerBound = timeLowerBound;
+  context.timeUpperBound = timeUpperBound;
+  context.globalState = globalState.get();
+  context.publicLocalState = publicLocalState.get();
+  context.privateLocalState = privateLocalState.get();
+  context.perceivedData = perceivedData.get();
+  context.producedInfluences = producedInfluences.get();
+  if (!started) {
+    CoroutineFramePool::Scope scope(pool.get());
+    coroutine = behavior(context);
+    started = true;
+  }
+  coroutine.resume(*producedInfluences);
+}
+
+} // namespace agents
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -1,5 +1,7 @@
 #include "../../include/agents/ExtendedAgent.h"
+#include <optional>
 #include <stdexcept>
+#include <utility>
 
 namespace fr {
 namespace univ_artois {
@@ -14,9 +16,15 @@ ExtendedAgent::ExtendedAgent(const microkernel::AgentCategory &category)
 ExtendedAgent::ExtendedAgent(const ExtendedAgent &other)
     : AbstractAgent(other), perceptionModels(other.perceptionModels),
       globalStateRevisionModel(other.globalStateRevisionModel),
-      decisionModels(other.decisionModels) {}
+      decisionModels(other.decisionModels) {
+  // The clone draws the same values as the original, from its own stream.
+  if (other.randomStream) {
+    randomStream =
+        std::make_shared<libs::random::RandomStream>(*other.randomStream);
+  }
+}
 
-std::shared_ptr<IAgtGlobalStateRevisionModel>
+const std::shared_ptr<IAgtGlobalStateRevisionModel> &
 ExtendedAgent::getGlobalStateRevisionModel() const {
   if (globalStateRevisionModel == nullptr) {
     throw std::out_of_range(
@@ -33,7 +41,7 @@ void ExtendedAgent::specifyGlobalStateRevisionModel(
   this->globalStateRevisionModel = revisionMdl;
 }
 
-std::shared_ptr<IAgtPerceptionModel> ExtendedAgent::getPerceptionModel(
+const std::shared_ptr<IAgtPerceptionModel> &ExtendedAgent::getPerceptionModel(
     const microkernel::LevelIdentifier &levelId) const {
   auto it = perceptionModels.find(levelId);
   if (it == perceptionModels.end()) {
@@ -44,7 +52,7 @@ std::shared_ptr<IAgtPerceptionModel> ExtendedAgent::getPerceptionModel(
   return it->second;
 }
 
-std::shared_ptr<IAgtDecisionModel> ExtendedAgent::getDecisionModel(
+const std::shared_ptr<IAgtDecisionModel> &ExtendedAgent::getDecisionModel(
     const microkernel::LevelIdentifier &levelId) const {
   auto it = decisionModels.find(levelId);
   if (it == decisionModels.end()) {
@@ -82,6 +90,36 @@ void ExtendedAgent::removeBehaviorForLevel(
   decisionModels.erase(levelId);
 }
 
+void ExtendedAgent::setRandomStream(
+    std::shared_ptr<libs::random::RandomStream> stream) {
+  this->randomStream = stream;
+}
+
+std::shared_ptr<libs::random::RandomStream>
+ExtendedAgent::getRandomStream() const {
+  return randomStream;
+}
+
+void ExtendedAgent::writeCheckpoint(
+    microkernel::checkpoint::CheckpointWriter &writer) const {
+  writer.writeBool(randomStream != nullptr);
+  if (randomStream) {
+    randomStream->writeCheckpoint(writer);
+  }
+}
+
+void ExtendedAgent::readCheckpoint(
+    microkernel::checkpoint::CheckpointReader &reader) {
+  if (!reader.readBool()) {
+    randomStream = nullptr;
+    return;
+  }
+  if (!randomStream) {
+    randomStream = std::make_shared<libs::random::RandomStream>(0);
+  }
+  randomStream->readCheckpoint(reader);
+}
+
 std::shared_ptr<microkernel::agents::IPerceivedData> ExtendedAgent::perceive(
     const microkernel::LevelIdentifier &level,
     const microkernel::SimulationTimeStamp &timeLowerBound,
@@ -93,9 +131,22 @@ std::shared_ptr<microkernel::agents::IPerceivedData> ExtendedAgent::perceive(
     std::shared_ptr<microkernel::dynamicstate::IPublicDynamicStateMap>
         dynamicStates) {
 
-  return getPerceptionModel(level)->perceive(timeLowerBound, timeUpperBound,
-                                             publicLocalStates,
-                                             privateLocalState, dynamicStates);
+  std::optional<libs::random::RandomStream::Scope> randomScope;
+  if (randomStream) {
+    randomScope.emplace(*randomStream);
+  }
+  const auto &perceptionModel = getPerceptionModel(level);
+  // The data of the previous step are refilled when nobody reads them
+  if (const auto recycled =
+          recyclePerceivedData(level, timeLowerBound, timeUpperBound)) {
+    return perceptionModel->perceiveInPlace(
+        timeLowerBound, timeUpperBound, publicLocalStates,
+        std::move(privateLocalState), std::move(dynamicStates), recycled);
+  }
+  return perceptionModel->perceive(timeLowerBound, timeUpperBound,
+                                   publicLocalStates,
+                                   std::move(privateLocalState),
+                                   std::move(dynamicStates));
 }
 
 void ExtendedAgent::reviseGlobalState(
@@ -106,8 +157,12 @@ void ExtendedAgent::reviseGlobalState(
         &perceivedData,
     std::shared_ptr<microkernel::agents::IGlobalState> globalState) {
 
+  std::optional<libs::random::RandomStream::Scope> randomScope;
+  if (randomStream) {
+    randomScope.emplace(*randomStream);
+  }
   getGlobalStateRevisionModel()->reviseGlobalState(
-      timeLowerBound, timeUpperBound, perceivedData, globalState);
+      timeLowerBound, timeUpperBound, perceivedData, std::move(globalState));
 }
 
 void ExtendedAgent::decide(
@@ -121,9 +176,14 @@ void ExtendedAgent::decide(
     std::shared_ptr<microkernel::influences::InfluencesMap>
         producedInfluences) {
 
-  getDecisionModel(levelId)->decide(timeLowerBound, timeUpperBound, globalState,
-                                    publicLocalState, privateLocalState,
-                                    perceivedData, producedInfluences);
+  std::optional<libs::random::RandomStream::Scope> randomScope;
+  if (randomStream) {
+    randomScope.emplace(*randomStream);
+  }
+  getDecisionModel(levelId)->decide(
+      timeLowerBound, timeUpperBound, std::move(globalState),
+      std::move(publicLocalState), std::move(privateLocalState),
+      std::move(perceivedData), std::move(producedInfluences));
 }
 
 std::shared_ptr<microkernel::agents::IAgent> ExtendedAgent::clone() const {
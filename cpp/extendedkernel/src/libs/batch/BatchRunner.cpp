@@ -0,0 +1,201 @@
+#include "libs/batch/BatchRunner.h"
+#include "IProbe.h"
+#include "engine/MultiThreadedSimulationEngine.h"
+#include "engine/ObservationSchedule.h"
+#include "engine/SequentialSimulationEngine.h"
+#include "json.hpp"
+#include "libs/probes/ArrowColumnarWriter.h"
+#include "libs/probes/ColumnarExportProbe.h"
+#include "libs/probes/CsvColumnarWriter.h"
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace batch {
+
+namespace {
+
+/** Records the initial and the final time of a run. */
+class RunTimesProbe : public microkernel::IProbe {
+public:
+  long initialTime = 0;
+  long finalTime = 0;
+
+  void observeAtInitialTimes(
+      const microkernel::SimulationTimeStamp &initialTimestamp,
+      const microkernel::ISimulationEngine &) override {
+    initialTime = finalTime = initialTimestamp.getIdentifier();
+  }
+
+  void observeAtPartialConsistentTime(
+      const microkernel::SimulationTimeStamp &timestamp,
+      const microkernel::ISimulationEngine &) override {
+    finalTime = timestamp.getIdentifier();
+  }
+
+  void observeAtFinalTime(
+      const microkernel::SimulationTimeStamp &finalTimestamp,
+      const microkernel::ISimulationEngine &) override {
+    finalTime = finalTimestamp.getIdentifier();
+  }
+
+  std::shared_ptr<microkernel::IProbe> clone() const override {
+    return std::make_shared<RunTimesProbe>(*this);
+  }
+};
+
+std::shared_ptr<probes::IColumnarWriter>
+makeWriter(BatchRunConfig::ExportFormat format, const std::string &path) {
+  if (path.empty()) {
+    return nullptr;
+  }
+  switch (format) {
+  case BatchRunConfig::ExportFormat::CSV:
+    return std::make_shared<probes::CsvColumnarWriter>(path);
+  case BatchRunConfig::ExportFormat::FEATHER:
+  case BatchRunConfig::ExportFormat::PARQUET:
+#ifdef SIMILAR_ARROW
+    return std::make_shared<probes::ArrowColumnarWriter>(
+        path, format == BatchRunConfig::ExportFormat::FEATHER
+                  ? probes::ArrowColumnarWriter::Format::FEATHER
+                  : probes::ArrowColumnarWriter::Format::PARQUET);
+#else
+    throw std::runtime_error("runBatch: built without Apache Arrow, export " +
+                             path + " as CSV");
+#endif
+  }
+  return nullptr;
+}
+
+} // namespace
+
+BatchRunConfig BatchRunConfig::parse(const std::string &json) {
+  BatchRunConfig config;
+  try {
+    const auto root = nlohmann::json::parse(json);
+    config.plugin = root.at("plugin").get<std::string>();
+    config.arguments = root.value("arguments", config.arguments);
+    const std::string engine = root.value("engine", "multithreaded");
+    if (engine == "multithreaded") {
+      config.engine = Engine::MULTITHREADED;
+    } else if (engine == "sequential") {
+      config.engine = Engine::SEQUENTIAL;
+    } else {
+      throw std::invalid_argument("BatchRunConfig: unknown engine " + engine);
+    }
+    config.threads = root.value("threads", config.threads);
+    if (root.contains("probes")) {
+      config.probes =
+          root.at("probes").get<std::map<std::string, std::string>>();
+    }
+    if (root.contains("export")) {
+      const auto &exported = root.at("export");
+      const std::string format = exported.value("format", "csv");
+      if (format == "csv") {
+        config.exportFormat = ExportFormat::CSV;
+      } else if (format == "feather") {
+        config.exportFormat = ExportFormat::FEATHER;
+      } else if (format == "parquet") {
+        config.exportFormat = ExportFormat::PARQUET;
+      } else {
+        throw std::invalid_argument("BatchRunConfig: unknown export format " +
+                                    format);
+      }
+      config.exportAgents = exported.value("agents", config.exportAgents);
+      config.exportSeries = exported.value("series", config.exportSeries);
+      config.exportPeriod = exported.value("period", config.exportPeriod);
+      config.exportSeriesBatchRows =
+          exported.value("series_batch_rows", config.exportSeriesBatchRows);
+      if (config.exportPeriod == 0 || config.exportSeriesBatchRows == 0) {
+        throw std::invalid_argument(
+            "BatchRunConfig: the export period and batch rows must be "
+            "positive");
+      }
+    }
+  } catch (const nlohmann::json::exception &e) {
+    throw std::invalid_argument(std::string("BatchRunConfig: ") + e.what());
+  }
+  return config;
+}
+
+BatchRunConfig BatchRunConfig::load(const std::string &path) {
+  std::ifstream file(path);
+  if (!file) {
+    throw std::runtime_error("BatchRunConfig: cannot read " + path);
+  }
+  std::ostringstream json;
+  json << file.rdbuf();
+  return parse(json.str());
+}
+
+std::shared_ptr<microkernel::ISimulationEngine>
+makeBatchEngine(const BatchRunConfig &config) {
+  if (config.engine == BatchRunConfig::Engine::SEQUENTIAL) {
+    return std::make_shared<microkernel::engine::SequentialSimulationEngine>();
+  }
+  return std::make_shared<microkernel::engine::MultiThreadedSimulationEngine>(
+      config.threads);
+}
+
+BatchRunResult runBatch(const BatchRunConfig &config) {
+  microkernel::engine::ModelPlugin plugin(config.plugin);
+  auto engine = makeBatchEngine(config);
+  BatchRunResult result;
+  result.batchBehaviors = plugin.installBatchBehaviors(*engine);
+
+  auto times = std::make_shared<RunTimesProbe>();
+  engine->addProbe("batch_times", times);
+  for (const auto &[name, arguments] : config.probes) {
+    engine->addProbe(name, plugin.createProbe(name, arguments));
+  }
+  if (!config.exportAgents.empty() || !config.exportSeries.empty()) {
+    auto exported = std::make_shared<probes::ColumnarExportProbe>(
+        makeWriter(config.exportFormat, config.exportAgents),
+        makeWriter(config.exportFormat, config.exportSeries),
+        config.exportSeriesBatchRows);
+    exported->addSeriesColumn(
+        "agents", [](const microkernel::SimulationTimeStamp &,
+                     const microkernel::ISimulationEngine &engine) {
+          return static_cast<double>(engine.getAgents().size());
+        });
+    engine->addProbe("batch_export", exported);
+    if (config.exportPeriod > 1) {
+      auto schedule =
+          std::make_shared<microkernel::engine::PeriodicObservationSchedule>(
+              config.exportPeriod);
+      if (auto *multiThreaded = dynamic_cast<
+              microkernel::engine::MultiThreadedSimulationEngine *>(
+              engine.get())) {
+        multiThreaded->setObservationSchedule("batch_export", schedule);
+      } else {
+        static_cast<microkernel::engine::SequentialSimulationEngine &>(*engine)
+            .setObservationSchedule("batch_export", schedule);
+      }
+    }
+  }
+
+  auto model = plugin.createModel(config.arguments);
+  const auto start = std::chrono::steady_clock::now();
+  engine->runNewSimulation(model);
+  result.seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  result.initialTime = times->initialTime;
+  result.finalTime = times->finalTime;
+  return result;
+}
+
+} // namespace batch
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
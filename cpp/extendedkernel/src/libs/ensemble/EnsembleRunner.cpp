@@ -0,0 +1,190 @@
+#include "libs/ensemble/EnsembleRunner.h"
+#include "libs/random/RandomStream.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace ensemble {
+
+using microkernel::engine::MultiThreadedSimulationEngine;
+
+namespace {
+
+std::size_t resolveConcurrentRuns(std::size_t concurrentRuns) {
+  if (concurrentRuns == 0) {
+    concurrentRuns = std::thread::hardware_concurrency();
+  }
+  return concurrentRuns == 0 ? 1 : concurrentRuns;
+}
+
+// The outcomes of a replication once it ended, or the exception that
+// ended it
+struct Replication {
+  bool ended = false;
+  std::vector<double> outcomes;
+  std::exception_ptr error;
+};
+
+} // namespace
+
+const EnsembleRunner::Estimate &
+EnsembleRunner::Results::getEstimate(const std::string &name) const {
+  for (const auto &estimate : estimates) {
+    if (estimate.name == name) {
+      return estimate;
+    }
+  }
+  throw std::out_of_range("No outcome is named " + name + ".");
+}
+
+EnsembleRunner::EnsembleRunner(std::vector<std::string> outcomeNames,
+                               std::size_t concurrentRuns,
+                               std::uint64_t baseSeed)
+    : names(std::move(outcomeNames)), baseSeed(baseSeed),
+      threadPool(resolveConcurrentRuns(concurrentRuns)) {
+  if (names.empty()) {
+    throw std::invalid_argument("An ensemble needs at least one outcome.");
+  }
+  if (std::set<std::string>(names.begin(), names.end()).size() !=
+      names.size()) {
+    throw std::invalid_argument("The outcomes need distinct names.");
+  }
+}
+
+std::uint64_t EnsembleRunner::getSeed(std::size_t replication) const {
+  // SplitMix64, whose outputs for consecutive inputs are independent
+  std::uint64_t z = baseSeed + (replication + 1) * 0x9e3779b97f4a7c15;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+void EnsembleRunner::setConfidence(double level) {
+  if (!(level > 0.0 && level < 1.0)) {
+    throw std::invalid_argument("A confidence level has to be in (0, 1).");
+  }
+  confidence = level;
+}
+
+void EnsembleRunner::setConvergence(std::size_t minimum, double relative,
+                                    double absolute) {
+  if (minimum < 2) {
+    throw std::invalid_argument(
+        "An ensemble needs two replications to estimate an interval.");
+  }
+  if (!(relative >= 0.0) || !(absolute >= 0.0)) {
+    throw std::invalid_argument("The half widths cannot be negative.");
+  }
+  minReplications = minimum;
+  relativeHalfWidth = relative;
+  absoluteHalfWidth = absolute;
+}
+
+bool EnsembleRunner::hasConverged(const Results &results) const {
+  if (minReplications == 0 || results.replications < minReplications) {
+    return false;
+  }
+  for (const auto &estimate : results.estimates) {
+    const double tolerance =
+        std::max(absoluteHalfWidth,
+                 relativeHalfWidth * std::abs(estimate.moments.mean()));
+    if (!(estimate.halfWidth <= tolerance)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+EnsembleRunner::Results EnsembleRunner::run(const ModelFactory &factory,
+                                            std::size_t maxReplications,
+                                            const OutcomeFunction &outcome,
+                                            const SetupFunction &setup,
+                                            std::size_t threadsPerRun) {
+  Results results;
+  for (const auto &name : names) {
+    results.estimates.push_back({name, {}, 0.0});
+  }
+  std::vector<Replication> replications(maxReplications);
+  std::mutex foldMutex;
+  std::atomic<bool> stopped{false};
+
+  // Folds the ended replications following the folded ones; called with
+  // foldMutex held
+  const auto fold = [&]() {
+    while (!stopped.load() && results.replications < maxReplications &&
+           replications[results.replications].ended) {
+      Replication &next = replications[results.replications];
+      if (next.error) {
+        results.failures.emplace_back(results.replications, next.error);
+      } else {
+        for (std::size_t i = 0; i < names.size(); ++i) {
+          results.estimates[i].moments.add(next.outcomes[i]);
+        }
+      }
+      next.outcomes.clear();
+      ++results.replications;
+      for (auto &estimate : results.estimates) {
+        estimate.halfWidth = estimate.moments.confidenceHalfWidth(confidence);
+      }
+      if (hasConverged(results)) {
+        results.converged = results.replications < maxReplications;
+        stopped.store(true);
+      }
+    }
+  };
+
+  const auto runReplication = [&](std::size_t r) {
+    Replication ended;
+    try {
+      random::RandomStream stream(getSeed(r));
+      random::RandomStream::Scope scope(stream);
+      MultiThreadedSimulationEngine engine(threadsPerRun == 0 ? 1
+                                                              : threadsPerRun);
+      engine.initializeSimulation(factory(r, getSeed(r)));
+      if (setup) {
+        setup(r, engine);
+      }
+      engine.startSimulation();
+      ended.outcomes = outcome(r, engine);
+      if (ended.outcomes.size() != names.size()) {
+        throw std::invalid_argument(
+            "A replication has to give one value per outcome.");
+      }
+    } catch (...) {
+      ended.outcomes.clear();
+      ended.error = std::current_exception();
+    }
+    ended.ended = true;
+    std::lock_guard<std::mutex> lock(foldMutex);
+    replications[r] = std::move(ended);
+    fold();
+  };
+
+  // One replication per chunk: their costs differ too much to be grouped.
+  threadPool.parallelFor(maxReplications, 1,
+                         [&](std::size_t first, std::size_t last, std::size_t) {
+                           for (std::size_t r = first;
+                                r < last && !stopped.load(); ++r) {
+                             runReplication(r);
+                           }
+                         });
+  return results;
+}
+
+} // namespace ensemble
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
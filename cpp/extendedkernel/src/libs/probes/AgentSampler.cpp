@@ -0,0 +1,77 @@
+#include "libs/probes/AgentSampler.h"
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace probes {
+
+namespace {
+
+// The finalizer of SplitMix64, spreading the addresses of the agents
+std::uint64_t mix(std::uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+} // namespace
+
+AgentSampler::AgentSampler(std::size_t k, std::size_t n, bool stratified,
+                           std::uint64_t seed)
+    : k(k), n(n), stratified(stratified), seed(seed) {
+  if (k == 0 || k > n) {
+    throw std::invalid_argument("A sample keeps k of n agents, 0 < k <= n.");
+  }
+}
+
+std::vector<AgentSampler::AgentPtr>
+AgentSampler::sample(const std::set<AgentPtr> &agents) const {
+  if (k == n) {
+    return std::vector<AgentPtr>(agents.begin(), agents.end());
+  }
+  // The hash and the index of the agents of each stratum
+  std::map<std::string, std::vector<std::pair<std::uint64_t, std::size_t>>>
+      strata;
+  std::size_t index = 0;
+  for (const AgentPtr &agent : agents) {
+    const auto address = reinterpret_cast<std::uintptr_t>(agent.get());
+    strata[stratified ? agent->getCategory().toString() : std::string()]
+        .emplace_back(
+        mix(address + seed), index++);
+  }
+
+  std::vector<bool> kept(agents.size(), false);
+  for (auto &stratum : strata) {
+    auto &members = stratum.second;
+    const std::size_t count = (members.size() * k + n - 1) / n;
+    std::nth_element(members.begin(), members.begin() + (count - 1),
+                     members.end());
+    for (std::size_t i = 0; i < count; ++i) {
+      kept[members[i].second] = true;
+    }
+  }
+  std::vector<AgentPtr> sampled;
+  index = 0;
+  for (const AgentPtr &agent : agents) {
+    if (kept[index++]) {
+      sampled.push_back(agent);
+    }
+  }
+  return sampled;
+}
+
+} // namespace probes
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
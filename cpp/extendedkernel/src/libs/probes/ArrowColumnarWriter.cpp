@@ -0,0 +1,176 @@
+#ifdef SIMILAR_ARROW
+
+#include "libs/probes/ArrowColumnarWriter.h"
+#include <arrow/api.h>
+#include <arrow/io/file.h>
+#include <arrow/ipc/writer.h>
+#include <parquet/arrow/writer.h>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace probes {
+
+namespace {
+
+void check(const arrow::Status &status) {
+  if (!status.ok()) {
+    throw std::runtime_error("Arrow: " + status.ToString());
+  }
+}
+
+template <typename T> T checked(arrow::Result<T> result) {
+  check(result.status());
+  return std::move(result).ValueUnsafe();
+}
+
+template <typename Builder, typename Value>
+std::shared_ptr<arrow::Array> toArray(const std::vector<Value> &values) {
+  Builder builder;
+  check(builder.AppendValues(values));
+  return checked(builder.Finish());
+}
+
+} // namespace
+
+struct ArrowColumnarWriter::Impl {
+  std::string path;
+  Format format;
+  std::shared_ptr<arrow::Schema> schema;
+  std::shared_ptr<arrow::io::FileOutputStream> output;
+  std::shared_ptr<arrow::ipc::RecordBatchWriter> feather;
+  std::unique_ptr<parquet::arrow::FileWriter> parquet;
+  // The dictionary of each column so far and its Arrow array
+  std::vector<std::vector<std::string>> dictionaries;
+  std::vector<std::shared_ptr<arrow::Array>> dictionaryArrays;
+
+  void open(const ColumnarBatch &batch) {
+    using ColumnType = ColumnarBatch::ColumnType;
+    std::vector<std::shared_ptr<arrow::Field>> fields;
+    for (const auto &column : batch.columns) {
+      std::shared_ptr<arrow::DataType> type;
+      switch (column.type) {
+      case ColumnType::INT64:
+        type = arrow::int64();
+        break;
+      case ColumnType::FLOAT64:
+        type = arrow::float64();
+        break;
+      case ColumnType::DICTIONARY:
+        type = arrow::dictionary(arrow::int32(), arrow::utf8());
+        break;
+      }
+      fields.push_back(arrow::field(column.name, type, false));
+    }
+    schema = arrow::schema(fields);
+    dictionaries.assign(batch.columns.size(), {});
+    dictionaryArrays.assign(batch.columns.size(), nullptr);
+    output = checked(arrow::io::FileOutputStream::Open(path));
+    if (format == Format::FEATHER) {
+      auto options = arrow::ipc::IpcWriteOptions::Defaults();
+      options.emit_dictionary_deltas = true;
+      feather = checked(arrow::ipc::MakeFileWriter(output, schema, options));
+    } else {
+      auto properties = parquet::ArrowWriterProperties::Builder()
+                            .store_schema()
+                            ->build();
+      parquet = checked(parquet::arrow::FileWriter::Open(
+          *schema, arrow::default_memory_pool(), output,
+          parquet::default_writer_properties(), properties));
+    }
+  }
+
+  std::shared_ptr<arrow::Array>
+  dictionaryColumn(std::size_t index, const ColumnarBatch::Column &column) {
+    std::vector<std::string> &dictionary = dictionaries[index];
+    if (!dictionaryArrays[index] || !column.dictionaryDelta.empty() ||
+        dictionary.size() != column.dictionaryOffset) {
+      dictionary.resize(column.dictionaryOffset);
+      dictionary.insert(dictionary.end(), column.dictionaryDelta.begin(),
+                        column.dictionaryDelta.end());
+      dictionaryArrays[index] = toArray<arrow::StringBuilder>(dictionary);
+    }
+    return checked(arrow::DictionaryArray::FromArrays(
+        schema->field(static_cast<int>(index))->type(),
+        toArray<arrow::Int32Builder>(column.indices),
+        dictionaryArrays[index]));
+  }
+};
+
+ArrowColumnarWriter::ArrowColumnarWriter(std::string path, Format format)
+    : impl(std::make_unique<Impl>()) {
+  impl->path = std::move(path);
+  impl->format = format;
+}
+
+ArrowColumnarWriter::~ArrowColumnarWriter() {
+  try {
+    close();
+  } catch (const std::exception &) {
+    // A destructor does not throw; close() reports the errors
+  }
+}
+
+void ArrowColumnarWriter::write(const ColumnarBatch &batch) {
+  using ColumnType = ColumnarBatch::ColumnType;
+  if (!impl->schema) {
+    impl->open(batch);
+  }
+  if (batch.columns.size() != impl->dictionaries.size()) {
+    throw std::runtime_error("The batches of a table have different columns");
+  }
+  std::vector<std::shared_ptr<arrow::Array>> arrays;
+  arrays.reserve(batch.columns.size());
+  for (std::size_t c = 0; c < batch.columns.size(); ++c) {
+    const ColumnarBatch::Column &column = batch.columns[c];
+    switch (column.type) {
+    case ColumnType::INT64:
+      arrays.push_back(toArray<arrow::Int64Builder>(column.int64s));
+      break;
+    case ColumnType::FLOAT64:
+      arrays.push_back(toArray<arrow::DoubleBuilder>(column.float64s));
+      break;
+    case ColumnType::DICTIONARY:
+      arrays.push_back(impl->dictionaryColumn(c, column));
+      break;
+    }
+  }
+  auto records = arrow::RecordBatch::Make(
+      impl->schema, static_cast<std::int64_t>(batch.rows), arrays);
+  if (impl->feather) {
+    check(impl->feather->WriteRecordBatch(*records));
+  } else {
+    auto table = checked(arrow::Table::FromRecordBatches({records}));
+    check(impl->parquet->WriteTable(*table, table->num_rows()));
+  }
+}
+
+void ArrowColumnarWriter::close() {
+  if (impl->feather) {
+    check(impl->feather->Close());
+    impl->feather.reset();
+  }
+  if (impl->parquet) {
+    check(impl->parquet->Close());
+    impl->parquet.reset();
+  }
+  if (impl->output && !impl->output->closed()) {
+    check(impl->output->Close());
+  }
+}
+
+} // namespace probes
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR_ARROW
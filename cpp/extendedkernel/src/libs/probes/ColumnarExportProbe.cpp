@@ -0,0 +1,267 @@
+#include "libs/probes/ColumnarExportProbe.h"
+#include <stdexcept>
+#include <utility>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace probes {
+
+using ColumnType = ColumnarBatch::ColumnType;
+
+ColumnarExportProbe::ColumnarExportProbe(
+    std::shared_ptr<IColumnarWriter> agentWriter,
+    std::shared_ptr<IColumnarWriter> seriesWriter, std::size_t seriesBatchRows,
+    std::size_t capacity)
+    : agentWriter(std::move(agentWriter)),
+      seriesWriter(std::move(seriesWriter)), seriesBatchRows(seriesBatchRows),
+      capacity(capacity),
+      async(
+          [this](const microkernel::SimulationTimeStamp &,
+                 const microkernel::ISimulationEngine &) {
+            return std::move(next);
+          },
+          [this](const microkernel::SimulationTimeStamp &,
+                 const Batches &batches) { write(batches); },
+          capacity == 0 ? 1 : capacity) {
+  if (seriesBatchRows == 0 || capacity == 0) {
+    throw std::invalid_argument(
+        "The rows of a series batch and the capacity have to be positive.");
+  }
+  AgentColumn category;
+  category.name = "category";
+  category.type = ColumnType::DICTIONARY;
+  category.dictionary = [](const microkernel::agents::IAgent4Engine &agent) {
+    return agent.getCategory().toString();
+  };
+  agentColumns.push_back(std::move(category));
+}
+
+ColumnarExportProbe::~ColumnarExportProbe() = default;
+
+void ColumnarExportProbe::checkName(const std::string &name) const {
+  bool used = name == "time";
+  for (const auto &column : agentColumns) {
+    used = used || column.name == name;
+  }
+  for (const auto &column : seriesColumns) {
+    used = used || column.first == name;
+  }
+  if (used) {
+    throw std::invalid_argument("The column '" + name + "' already exists.");
+  }
+}
+
+void ColumnarExportProbe::addAgentColumn(const std::string &name,
+                                         Float64Column column) {
+  checkName(name);
+  AgentColumn added;
+  added.name = name;
+  added.type = ColumnType::FLOAT64;
+  added.float64 = std::move(column);
+  agentColumns.push_back(std::move(added));
+}
+
+void ColumnarExportProbe::addAgentIntColumn(const std::string &name,
+                                            Int64Column column) {
+  checkName(name);
+  AgentColumn added;
+  added.name = name;
+  added.type = ColumnType::INT64;
+  added.int64 = std::move(column);
+  agentColumns.push_back(std::move(added));
+}
+
+void ColumnarExportProbe::addAgentDictionaryColumn(const std::string &name,
+                                                   DictionaryColumn column) {
+  checkName(name);
+  AgentColumn added;
+  added.name = name;
+  added.type = ColumnType::DICTIONARY;
+  added.dictionary = std::move(column);
+  agentColumns.push_back(std::move(added));
+}
+
+void ColumnarExportProbe::addSeriesColumn(const std::string &name,
+                                          SeriesColumn column) {
+  checkName(name);
+  seriesColumns.emplace_back(name, std::move(column));
+}
+
+void ColumnarExportProbe::prepareObservation() {
+  // The dictionaries start again with the tables of a new run
+  for (auto &column : agentColumns) {
+    column.entries.clear();
+    column.written = 0;
+  }
+  pendingSeries.reset();
+  writeError = nullptr;
+  async.prepareObservation();
+}
+
+std::shared_ptr<ColumnarBatch> ColumnarExportProbe::snapshotAgents(
+    const microkernel::SimulationTimeStamp &timestamp,
+    const microkernel::ISimulationEngine &engine) {
+  const std::set<AgentPtr> registered =
+      levelFilter ? engine.getAgents(*levelFilter) : engine.getAgents();
+  const std::vector<AgentPtr> agents =
+      sampler ? sampler->sample(registered)
+              : std::vector<AgentPtr>(registered.begin(), registered.end());
+  auto batch = std::make_shared<ColumnarBatch>();
+  batch->rows = agents.size();
+  batch->columns.reserve(agentColumns.size() + 1);
+  batch->columns.emplace_back("time", ColumnType::INT64);
+  batch->columns.back().int64s.assign(agents.size(),
+                                      timestamp.getIdentifier());
+  for (AgentColumn &column : agentColumns) {
+    batch->columns.emplace_back(column.name, column.type);
+    ColumnarBatch::Column &values = batch->columns.back();
+    switch (column.type) {
+    case ColumnType::INT64:
+      values.int64s.reserve(agents.size());
+      for (const AgentPtr &agent : agents) {
+        values.int64s.push_back(column.int64(*agent));
+      }
+      break;
+    case ColumnType::FLOAT64:
+      values.float64s.reserve(agents.size());
+      for (const AgentPtr &agent : agents) {
+        values.float64s.push_back(column.float64(*agent));
+      }
+      break;
+    case ColumnType::DICTIONARY:
+      values.indices.reserve(agents.size());
+      values.dictionaryOffset = column.written;
+      for (const AgentPtr &agent : agents) {
+        std::string entry = column.dictionary(*agent);
+        auto found = column.entries.find(entry);
+        if (found == column.entries.end()) {
+          const auto index = static_cast<std::int32_t>(column.entries.size());
+          found = column.entries.emplace(entry, index).first;
+          values.dictionaryDelta.push_back(std::move(entry));
+        }
+        values.indices.push_back(found->second);
+      }
+      column.written = column.entries.size();
+      break;
+    }
+  }
+  return batch;
+}
+
+void ColumnarExportProbe::addSeriesRow(
+    const microkernel::SimulationTimeStamp &timestamp,
+    const microkernel::ISimulationEngine &engine) {
+  if (!pendingSeries) {
+    pendingSeries = std::make_shared<ColumnarBatch>();
+    pendingSeries->columns.emplace_back("time", ColumnType::INT64);
+    for (const auto &column : seriesColumns) {
+      pendingSeries->columns.emplace_back(column.first, ColumnType::FLOAT64);
+    }
+  }
+  pendingSeries->columns[0].int64s.push_back(timestamp.getIdentifier());
+  for (std::size_t i = 0; i < seriesColumns.size(); ++i) {
+    pendingSeries->columns[i + 1].float64s.push_back(
+        seriesColumns[i].second(timestamp, engine));
+  }
+  ++pendingSeries->rows;
+}
+
+void ColumnarExportProbe::observe(
+    const microkernel::SimulationTimeStamp &timestamp,
+    const microkernel::ISimulationEngine &engine, bool final) {
+  rethrowWriteError();
+  next = Batches();
+  if (agentWriter) {
+    next.agents = snapshotAgents(timestamp, engine);
+  }
+  if (seriesWriter) {
+    addSeriesRow(timestamp, engine);
+    if (final || pendingSeries->rows >= seriesBatchRows) {
+      next.series = std::move(pendingSeries);
+    }
+  }
+}
+
+void ColumnarExportProbe::observeAtInitialTimes(
+    const microkernel::SimulationTimeStamp &initialTimestamp,
+    const microkernel::ISimulationEngine &simulationEngine) {
+  observe(initialTimestamp, simulationEngine, false);
+  async.observeAtInitialTimes(initialTimestamp, simulationEngine);
+}
+
+void ColumnarExportProbe::observeAtPartialConsistentTime(
+    const microkernel::SimulationTimeStamp &timestamp,
+    const microkernel::ISimulationEngine &simulationEngine) {
+  observe(timestamp, simulationEngine, false);
+  async.observeAtPartialConsistentTime(timestamp, simulationEngine);
+}
+
+void ColumnarExportProbe::observeAtFinalTime(
+    const microkernel::SimulationTimeStamp &finalTimestamp,
+    const microkernel::ISimulationEngine &simulationEngine) {
+  observe(finalTimestamp, simulationEngine, true);
+  async.observeAtFinalTime(finalTimestamp, simulationEngine);
+  rethrowWriteError();
+}
+
+void ColumnarExportProbe::endObservation() {
+  async.endObservation();
+  if (agentWriter) {
+    agentWriter->close();
+  }
+  if (seriesWriter) {
+    seriesWriter->close();
+  }
+  rethrowWriteError();
+}
+
+void ColumnarExportProbe::write(const Batches &batches) {
+  // The errors of the writers are rethrown on the simulation thread
+  try {
+    if (batches.agents) {
+      agentWriter->write(*batches.agents);
+    }
+    if (batches.series) {
+      seriesWriter->write(*batches.series);
+    }
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(errorMutex);
+    if (!writeError) {
+      writeError = std::current_exception();
+    }
+  }
+}
+
+void ColumnarExportProbe::rethrowWriteError() {
+  std::exception_ptr error;
+  {
+    std::lock_guard<std::mutex> lock(errorMutex);
+    error = writeError;
+    writeError = nullptr;
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+std::shared_ptr<microkernel::IProbe> ColumnarExportProbe::clone() const {
+  auto copy = std::make_shared<ColumnarExportProbe>(
+      agentWriter, seriesWriter, seriesBatchRows, capacity);
+  copy->levelFilter = levelFilter;
+  copy->sampler = sampler;
+  copy->agentColumns = agentColumns;
+  copy->seriesColumns = seriesColumns;
+  return copy;
+}
+
+} // namespace probes
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
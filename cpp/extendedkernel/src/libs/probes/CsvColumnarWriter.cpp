@@ -0,0 +1,102 @@
+#include "libs/probes/CsvColumnarWriter.h"
+#include <stdexcept>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace probes {
+
+namespace {
+
+// Quotes a field holding a separator, a quote or a line break
+void writeField(std::ofstream &output, const std::string &field) {
+  if (field.find_first_of(",\"\n\r") == std::string::npos) {
+    output << field;
+    return;
+  }
+  output << '"';
+  for (const char c : field) {
+    if (c == '"') {
+      output << '"';
+    }
+    output << c;
+  }
+  output << '"';
+}
+
+} // namespace
+
+CsvColumnarWriter::CsvColumnarWriter(const std::string &path)
+    : output(path, std::ios::out | std::ios::trunc) {
+  if (!output) {
+    throw std::runtime_error("Cannot open " + path);
+  }
+  output.precision(17);
+}
+
+void CsvColumnarWriter::write(const ColumnarBatch &batch) {
+  using ColumnType = ColumnarBatch::ColumnType;
+  if (!headerWritten) {
+    for (std::size_t c = 0; c < batch.columns.size(); ++c) {
+      if (c != 0) {
+        output << ',';
+      }
+      writeField(output, batch.columns[c].name);
+    }
+    output << '\n';
+    dictionaries.assign(batch.columns.size(), {});
+    headerWritten = true;
+  }
+  if (batch.columns.size() != dictionaries.size()) {
+    throw std::runtime_error("The batches of a table have different columns");
+  }
+  for (std::size_t c = 0; c < batch.columns.size(); ++c) {
+    const ColumnarBatch::Column &column = batch.columns[c];
+    if (column.type == ColumnType::DICTIONARY) {
+      std::vector<std::string> &dictionary = dictionaries[c];
+      dictionary.resize(column.dictionaryOffset);
+      dictionary.insert(dictionary.end(), column.dictionaryDelta.begin(),
+                        column.dictionaryDelta.end());
+    }
+  }
+  for (std::size_t row = 0; row < batch.rows; ++row) {
+    for (std::size_t c = 0; c < batch.columns.size(); ++c) {
+      if (c != 0) {
+        output << ',';
+      }
+      const ColumnarBatch::Column &column = batch.columns[c];
+      switch (column.type) {
+      case ColumnType::INT64:
+        output << column.int64s[row];
+        break;
+      case ColumnType::FLOAT64:
+        output << column.float64s[row];
+        break;
+      case ColumnType::DICTIONARY:
+        writeField(output, dictionaries[c][column.indices[row]]);
+        break;
+      }
+    }
+    output << '\n';
+  }
+  if (!output) {
+    throw std::runtime_error("Cannot write a CSV batch");
+  }
+}
+
+void CsvColumnarWriter::close() {
+  if (output.is_open()) {
+    output.close();
+  }
+}
+
+} // namespace probes
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -0,0 +1,239 @@
+#include "libs/probes/StatisticsProbe.h"
+#include "engine/WorkStealingThreadPool.h"
+#include <algorithm>
+#include <set>
+#include <stdexcept>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace probes {
+
+namespace {
+
+template <typename Statistic>
+const Statistic &
+find(const std::vector<std::pair<std::string, Statistic>> &statistics,
+     const std::string &name) {
+  for (const auto &statistic : statistics) {
+    if (statistic.first == name) {
+      return statistic.second;
+    }
+  }
+  throw std::out_of_range("No statistic named '" + name + "'.");
+}
+
+template <typename Statistic>
+bool contains(const std::vector<std::pair<std::string, Statistic>> &statistics,
+              const std::string &name) {
+  for (const auto &statistic : statistics) {
+    if (statistic.first == name) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename Statistic>
+void mergeAll(std::vector<std::pair<std::string, Statistic>> &into,
+              const std::vector<std::pair<std::string, Statistic>> &from) {
+  for (std::size_t i = 0; i < into.size(); ++i) {
+    into[i].second.merge(from[i].second);
+  }
+}
+
+} // namespace
+
+const RunningMoments &
+StatisticsProbe::Results::getMoments(const std::string &name) const {
+  return find(moments, name);
+}
+
+const FixedBinHistogram &
+StatisticsProbe::Results::getHistogram(const std::string &name) const {
+  return find(histograms, name);
+}
+
+const QuantileSketch &
+StatisticsProbe::Results::getSketch(const std::string &name) const {
+  return find(sketches, name);
+}
+
+const CategoryCounter &
+StatisticsProbe::Results::getCounter(const std::string &name) const {
+  return find(counters, name);
+}
+
+const DensityGrid &
+StatisticsProbe::Results::getGrid(const std::string &name) const {
+  return find(grids, name);
+}
+
+StatisticsProbe::StatisticsProbe(std::size_t chunkSize)
+    : chunkSize(chunkSize), results(std::make_shared<Results>()) {
+  if (chunkSize == 0) {
+    throw std::invalid_argument("The chunk size has to be positive.");
+  }
+}
+
+void StatisticsProbe::checkName(const std::string &name) const {
+  if (contains(empty.moments, name) || contains(empty.histograms, name) ||
+      contains(empty.sketches, name) || contains(empty.counters, name) ||
+      contains(empty.grids, name)) {
+    throw std::invalid_argument("The statistic '" + name +
+                                "' already exists.");
+  }
+}
+
+void StatisticsProbe::addMoments(const std::string &name, Value value) {
+  checkName(name);
+  empty.moments.emplace_back(name, RunningMoments());
+  momentValues.push_back(std::move(value));
+}
+
+void StatisticsProbe::addHistogram(const std::string &name, Value value,
+                                   double min, double max, std::size_t bins) {
+  checkName(name);
+  empty.histograms.emplace_back(name, FixedBinHistogram(min, max, bins));
+  histogramValues.push_back(std::move(value));
+}
+
+void StatisticsProbe::addQuantiles(const std::string &name, Value value,
+                                   double relativeAccuracy) {
+  checkName(name);
+  empty.sketches.emplace_back(name, QuantileSketch(relativeAccuracy));
+  sketchValues.push_back(std::move(value));
+}
+
+void StatisticsProbe::addCategoryCounts(const std::string &name,
+                                        Category category) {
+  checkName(name);
+  if (!category) {
+    category = [](const microkernel::agents::IAgent4Engine &agent) {
+      return agent.getCategory().toString();
+    };
+  }
+  empty.counters.emplace_back(name, CategoryCounter());
+  counterCategories.push_back(std::move(category));
+}
+
+void StatisticsProbe::addDensityGrid(const std::string &name,
+                                     Position position, double originX,
+                                     double originY, double cellSize,
+                                     std::size_t columns, std::size_t rows) {
+  checkName(name);
+  empty.grids.emplace_back(
+      name, DensityGrid(originX, originY, cellSize, columns, rows));
+  gridPositions.push_back(std::move(position));
+}
+
+std::shared_ptr<const StatisticsProbe::Results>
+StatisticsProbe::getResults() const {
+  std::lock_guard<std::mutex> lock(resultsMutex);
+  return results;
+}
+
+void StatisticsProbe::prepareObservation() {
+  std::lock_guard<std::mutex> lock(resultsMutex);
+  results = std::make_shared<Results>();
+}
+
+void StatisticsProbe::aggregate(const std::vector<AgentPtr> &agents,
+                                std::size_t begin, std::size_t end,
+                                Results &into) const {
+  for (std::size_t a = begin; a < end; ++a) {
+    const microkernel::agents::IAgent4Engine &agent = *agents[a];
+    for (std::size_t i = 0; i < momentValues.size(); ++i) {
+      into.moments[i].second.add(momentValues[i](agent));
+    }
+    for (std::size_t i = 0; i < histogramValues.size(); ++i) {
+      into.histograms[i].second.add(histogramValues[i](agent));
+    }
+    for (std::size_t i = 0; i < sketchValues.size(); ++i) {
+      into.sketches[i].second.add(sketchValues[i](agent));
+    }
+    for (std::size_t i = 0; i < counterCategories.size(); ++i) {
+      into.counters[i].second.add(counterCategories[i](agent));
+    }
+    for (std::size_t i = 0; i < gridPositions.size(); ++i) {
+      const std::pair<double, double> point = gridPositions[i](agent);
+      into.grids[i].second.add(point.first, point.second);
+    }
+  }
+}
+
+void StatisticsProbe::observe(
+    const microkernel::SimulationTimeStamp &timestamp,
+    const microkernel::ISimulationEngine &engine) {
+  const std::set<AgentPtr> registered =
+      levelFilter ? engine.getAgents(*levelFilter) : engine.getAgents();
+  const std::vector<AgentPtr> agents =
+      sampler ? sampler->sample(registered)
+              : std::vector<AgentPtr>(registered.begin(), registered.end());
+
+  // Each chunk on its own, then merged in the order of the chunks
+  const std::size_t numChunks = (agents.size() + chunkSize - 1) / chunkSize;
+  std::vector<Results> chunks(numChunks, empty);
+  microkernel::engine::WorkStealingThreadPool::parallelForOnCurrent(
+      numChunks, 1, [&](std::size_t begin, std::size_t end, std::size_t) {
+        for (std::size_t c = begin; c < end; ++c) {
+          aggregate(agents, c * chunkSize,
+                    std::min(agents.size(), (c + 1) * chunkSize), chunks[c]);
+        }
+      });
+  auto observed = std::make_shared<Results>(empty);
+  for (const Results &chunk : chunks) {
+    mergeAll(observed->moments, chunk.moments);
+    mergeAll(observed->histograms, chunk.histograms);
+    mergeAll(observed->sketches, chunk.sketches);
+    mergeAll(observed->counters, chunk.counters);
+    mergeAll(observed->grids, chunk.grids);
+  }
+  observed->time = timestamp.getIdentifier();
+  observed->agents = agents.size();
+
+  std::lock_guard<std::mutex> lock(resultsMutex);
+  results = std::move(observed);
+}
+
+void StatisticsProbe::observeAtInitialTimes(
+    const microkernel::SimulationTimeStamp &initialTimestamp,
+    const microkernel::ISimulationEngine &simulationEngine) {
+  observe(initialTimestamp, simulationEngine);
+}
+
+void StatisticsProbe::observeAtPartialConsistentTime(
+    const microkernel::SimulationTimeStamp &timestamp,
+    const microkernel::ISimulationEngine &simulationEngine) {
+  observe(timestamp, simulationEngine);
+}
+
+void StatisticsProbe::observeAtFinalTime(
+    const microkernel::SimulationTimeStamp &finalTimestamp,
+    const microkernel::ISimulationEngine &simulationEngine) {
+  observe(finalTimestamp, simulationEngine);
+}
+
+std::shared_ptr<microkernel::IProbe> StatisticsProbe::clone() const {
+  auto copy = std::make_shared<StatisticsProbe>(chunkSize);
+  copy->levelFilter = levelFilter;
+  copy->sampler = sampler;
+  copy->momentValues = momentValues;
+  copy->histogramValues = histogramValues;
+  copy->sketchValues = sketchValues;
+  copy->counterCategories = counterCategories;
+  copy->gridPositions = gridPositions;
+  copy->empty = empty;
+  return copy;
+}
+
+} // namespace probes
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
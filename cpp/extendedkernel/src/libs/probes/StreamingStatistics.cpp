@@ -0,0 +1,325 @@
+#include "libs/probes/StreamingStatistics.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numbers>
+#include <stdexcept>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace probes {
+
+namespace {
+
+// The magnitudes counted as zeros by a quantile sketch
+constexpr double SKETCH_MIN_MAGNITUDE = 1e-300;
+
+// The rank of the quantile q among count values, from 0
+double rankOf(double q, std::uint64_t count) {
+  if (!(q >= 0.0 && q <= 1.0)) {
+    throw std::invalid_argument("A quantile has to be in [0, 1].");
+  }
+  return q * static_cast<double>(count - 1);
+}
+
+// Acklam's rational approximation of the quantile p of the standard normal
+// distribution, of relative error below 1.2e-9
+double normalQuantile(double p) {
+  static const double a[] = {-3.969683028665376e+01, 2.209460984245205e+02,
+                             -2.759285104469687e+02, 1.383577518672690e+02,
+                             -3.066479806614716e+01, 2.506628277459239e+00};
+  static const double b[] = {-5.447609879822406e+01, 1.615858368580409e+02,
+                             -1.556989798598866e+02, 6.680131188771972e+01,
+                             -1.328068155288572e+01};
+  static const double c[] = {-7.784894002430293e-03, -3.223964580411365e-01,
+                             -2.400758277161838e+00, -2.549732539343734e+00,
+                             4.374664141464968e+00,  2.938163982698783e+00};
+  static const double d[] = {7.784695709041462e-03, 3.224671290700398e-01,
+                             2.445134137142996e+00, 3.754408661907416e+00};
+  constexpr double low = 0.02425;
+  if (p < low || p > 1.0 - low) {
+    const double q = std::sqrt(-2.0 * std::log(p < low ? p : 1.0 - p));
+    const double x =
+        (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q +
+         c[5]) /
+        ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+    return p < low ? x : -x;
+  }
+  const double q = p - 0.5;
+  const double r = q * q;
+  return (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r +
+          a[5]) *
+         q /
+         (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1.0);
+}
+
+// The quantile p of the Student distribution of dof degrees of freedom,
+// exact below three degrees and by the Cornish-Fisher expansion above
+// (Abramowitz and Stegun 26.7.5), within 0.1% from three degrees
+double studentQuantile(double p, std::uint64_t dof) {
+  if (dof == 1) {
+    return std::tan(std::numbers::pi * (p - 0.5));
+  }
+  if (dof == 2) {
+    return (2.0 * p - 1.0) / std::sqrt(2.0 * p * (1.0 - p));
+  }
+  const double z = normalQuantile(p);
+  const double z2 = z * z;
+  const double v = static_cast<double>(dof);
+  const double g1 = z * (z2 + 1.0) / 4.0;
+  const double g2 = z * ((5.0 * z2 + 16.0) * z2 + 3.0) / 96.0;
+  const double g3 = z * (((3.0 * z2 + 19.0) * z2 + 17.0) * z2 - 15.0) / 384.0;
+  const double g4 =
+      z * ((((79.0 * z2 + 776.0) * z2 + 1482.0) * z2 - 1920.0) * z2 - 945.0) /
+      92160.0;
+  return z + (g1 + (g2 + (g3 + g4 / v) / v) / v) / v;
+}
+
+} // namespace
+
+void RunningMoments::add(double value) {
+  if (std::isnan(value)) {
+    return;
+  }
+  if (n == 0) {
+    low = high = value;
+  } else {
+    low = std::min(low, value);
+    high = std::max(high, value);
+  }
+  ++n;
+  const double delta = value - mu;
+  mu += delta / static_cast<double>(n);
+  m2 += delta * (value - mu);
+}
+
+void RunningMoments::merge(const RunningMoments &other) {
+  if (other.n == 0) {
+    return;
+  }
+  if (n == 0) {
+    *this = other;
+    return;
+  }
+  // Chan et al.'s combination of the two sets
+  const double total = static_cast<double>(n + other.n);
+  const double delta = other.mu - mu;
+  mu += delta * static_cast<double>(other.n) / total;
+  m2 += other.m2 + delta * delta * static_cast<double>(n) *
+                       static_cast<double>(other.n) / total;
+  n += other.n;
+  low = std::min(low, other.low);
+  high = std::max(high, other.high);
+}
+
+double RunningMoments::confidenceHalfWidth(double confidence) const {
+  if (!(confidence > 0.0 && confidence < 1.0)) {
+    throw std::invalid_argument("A confidence level has to be in (0, 1).");
+  }
+  if (n < 2) {
+    return std::numeric_limits<double>::infinity();
+  }
+  const double t = studentQuantile(0.5 + confidence / 2.0, n - 1);
+  return t * std::sqrt(sampleVariance() / static_cast<double>(n));
+}
+
+FixedBinHistogram::FixedBinHistogram(double min, double max,
+                                     std::size_t numBins)
+    : low(min), high(max) {
+  if (!(min < max) || numBins == 0) {
+    throw std::invalid_argument(
+        "A histogram needs a range and at least one bin.");
+  }
+  bins.assign(numBins, 0);
+  scale = static_cast<double>(numBins) / (max - min);
+}
+
+void FixedBinHistogram::add(double value) {
+  if (std::isnan(value)) {
+    return;
+  }
+  if (value < low) {
+    ++below;
+  } else if (value >= high) {
+    ++above;
+  } else {
+    const auto bin = static_cast<std::size_t>((value - low) * scale);
+    ++bins[std::min(bin, bins.size() - 1)];
+  }
+}
+
+void FixedBinHistogram::merge(const FixedBinHistogram &other) {
+  if (other.low != low || other.high != high ||
+      other.bins.size() != bins.size()) {
+    throw std::invalid_argument("The histograms have different bins.");
+  }
+  for (std::size_t i = 0; i < bins.size(); ++i) {
+    bins[i] += other.bins[i];
+  }
+  below += other.below;
+  above += other.above;
+}
+
+std::uint64_t FixedBinHistogram::total() const {
+  std::uint64_t sum = below + above;
+  for (std::uint64_t count : bins) {
+    sum += count;
+  }
+  return sum;
+}
+
+double FixedBinHistogram::quantile(double q) const {
+  const std::uint64_t count = total();
+  if (count == 0) {
+    rankOf(q, 1);
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  // The values of the quantile rank, from 0, spread evenly over their bin
+  double rank = rankOf(q, count);
+  if (rank < static_cast<double>(below)) {
+    return low;
+  }
+  rank -= static_cast<double>(below);
+  const double width = 1.0 / scale;
+  for (std::size_t i = 0; i < bins.size(); ++i) {
+    if (rank < static_cast<double>(bins[i])) {
+      return low + width * (static_cast<double>(i) +
+                            (rank + 0.5) / static_cast<double>(bins[i]));
+    }
+    rank -= static_cast<double>(bins[i]);
+  }
+  return high;
+}
+
+QuantileSketch::QuantileSketch(double relativeAccuracy)
+    : accuracy(relativeAccuracy) {
+  if (!(relativeAccuracy > 0.0 && relativeAccuracy < 1.0)) {
+    throw std::invalid_argument(
+        "The relative accuracy of a sketch has to be in (0, 1).");
+  }
+  gamma = (1.0 + relativeAccuracy) / (1.0 - relativeAccuracy);
+  logGamma = std::log(gamma);
+}
+
+int QuantileSketch::bucketOf(double magnitude) const {
+  return static_cast<int>(std::ceil(std::log(magnitude) / logGamma));
+}
+
+double QuantileSketch::valueOf(int bucket) const {
+  // The middle of [gamma^(i-1), gamma^i] in relative error
+  return 2.0 * std::exp(logGamma * bucket) / (gamma + 1.0);
+}
+
+void QuantileSketch::add(double value) {
+  if (!std::isfinite(value)) {
+    return;
+  }
+  ++n;
+  if (std::abs(value) < SKETCH_MIN_MAGNITUDE) {
+    ++zeros;
+  } else if (value > 0.0) {
+    ++positives[bucketOf(value)];
+  } else {
+    ++negatives[bucketOf(-value)];
+  }
+}
+
+void QuantileSketch::merge(const QuantileSketch &other) {
+  if (other.accuracy != accuracy) {
+    throw std::invalid_argument("The sketches have different accuracies.");
+  }
+  for (const auto &bucket : other.positives) {
+    positives[bucket.first] += bucket.second;
+  }
+  for (const auto &bucket : other.negatives) {
+    negatives[bucket.first] += bucket.second;
+  }
+  zeros += other.zeros;
+  n += other.n;
+}
+
+double QuantileSketch::quantile(double q) const {
+  if (n == 0) {
+    rankOf(q, 1);
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  // The buckets in the order of their values: the negatives from the
+  // largest magnitude, the zeros, then the positives
+  const double rank = rankOf(q, n);
+  double seen = 0.0;
+  for (auto it = negatives.rbegin(); it != negatives.rend(); ++it) {
+    seen += static_cast<double>(it->second);
+    if (rank < seen) {
+      return -valueOf(it->first);
+    }
+  }
+  seen += static_cast<double>(zeros);
+  if (rank < seen) {
+    return 0.0;
+  }
+  for (const auto &bucket : positives) {
+    seen += static_cast<double>(bucket.second);
+    if (rank < seen) {
+      return valueOf(bucket.first);
+    }
+  }
+  return valueOf(positives.rbegin()->first);
+}
+
+void CategoryCounter::merge(const CategoryCounter &other) {
+  for (const auto &entry : other.entries) {
+    entries[entry.first] += entry.second;
+  }
+}
+
+std::uint64_t CategoryCounter::count(const std::string &category) const {
+  const auto found = entries.find(category);
+  return found != entries.end() ? found->second : 0;
+}
+
+DensityGrid::DensityGrid(double originX, double originY, double cellSize,
+                         std::size_t columns, std::size_t rows)
+    : originX(originX), originY(originY), size(cellSize), numColumns(columns),
+      numRows(rows) {
+  if (!(cellSize > 0.0) || columns == 0 || rows == 0) {
+    throw std::invalid_argument(
+        "A density grid needs a positive cell size and at least one cell.");
+  }
+  cells.assign(columns * rows, 0);
+}
+
+void DensityGrid::add(double x, double y) {
+  const double column = std::floor((x - originX) / size);
+  const double row = std::floor((y - originY) / size);
+  if (column >= 0.0 && column < static_cast<double>(numColumns) &&
+      row >= 0.0 && row < static_cast<double>(numRows)) {
+    ++cells[static_cast<std::size_t>(row) * numColumns +
+            static_cast<std::size_t>(column)];
+  } else {
+    ++outside;
+  }
+}
+
+void DensityGrid::merge(const DensityGrid &other) {
+  if (other.originX != originX || other.originY != originY ||
+      other.size != size || other.numColumns != numColumns ||
+      other.numRows != numRows) {
+    throw std::invalid_argument("The density grids have different cells.");
+  }
+  for (std::size_t i = 0; i < cells.size(); ++i) {
+    cells[i] += other.cells[i];
+  }
+  outside += other.outside;
+}
+
+} // namespace probes
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
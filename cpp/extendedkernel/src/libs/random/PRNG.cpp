@@ -15,7 +15,20 @@ std::normal_distribution<double> PRNG::normalDist(0.0, 1.0);
 
 void PRNG::setSeed(uint64_t seed) { generator.seed(seed); }
 
-double PRNG::randomDouble() { return uniformDist(generator); }
+void PRNG::writeCheckpoint(microkernel::checkpoint::CheckpointWriter &writer) {
+  writeRandomState(writer, generator, normalDist);
+}
+
+void PRNG::readCheckpoint(microkernel::checkpoint::CheckpointReader &reader) {
+  readRandomState(reader, generator, normalDist);
+}
+
+double PRNG::randomDouble() {
+  if (RandomStream *stream = RandomStream::current()) {
+    return stream->randomDouble();
+  }
+  return uniformDist(generator);
+}
 
 double PRNG::randomDouble(double lowerBound, double higherBound) {
   return lowerBound + (higherBound - lowerBound) * randomDouble();
@@ -26,18 +39,57 @@ double PRNG::randomAngle() { return randomDouble(-M_PI, M_PI); }
 bool PRNG::randomBoolean() { return randomDouble() < 0.5; }
 
 int PRNG::randomInt(int bound) {
+  if (RandomStream *stream = RandomStream::current()) {
+    return stream->randomInt(bound);
+  }
   std::uniform_int_distribution<int> dist(0, bound - 1);
   return dist(generator);
 }
 
 int PRNG::randomSign() { return randomBoolean() ? 1 : -1; }
 
-double PRNG::randomGaussian() { return normalDist(generator); }
+double PRNG::randomGaussian() {
+  if (RandomStream *stream = RandomStream::current()) {
+    return stream->randomGaussian();
+  }
+  return normalDist(generator);
+}
 
 double PRNG::randomGaussian(double mean, double sd) {
   return mean + sd * randomGaussian();
 }
 
+void PRNG::fillUniform(std::span<double> out) {
+  if (RandomStream *stream = RandomStream::current()) {
+    stream->fillUniform(out.data(), out.size());
+  } else {
+    Xoshiro256PlusPlusLanes(generator).fillUniform(out.data(), out.size());
+  }
+}
+
+void PRNG::fillUniform(std::span<double> out, double lowerBound,
+                       double higherBound) {
+  fillUniform(out);
+  for (double &value : out) {
+    value = lowerBound + (higherBound - lowerBound) * value;
+  }
+}
+
+void PRNG::fillGaussian(std::span<double> out) {
+  if (RandomStream *stream = RandomStream::current()) {
+    stream->fillGaussian(out.data(), out.size());
+  } else {
+    Xoshiro256PlusPlusLanes(generator).fillGaussian(out.data(), out.size());
+  }
+}
+
+void PRNG::fillGaussian(std::span<double> out, double mean, double sd) {
+  fillGaussian(out);
+  for (double &value : out) {
+    value = mean + sd * value;
+  }
+}
+
 std::string PRNG::getImplementationName() { return "Xoshiro256++"; }
 
 } // namespace random
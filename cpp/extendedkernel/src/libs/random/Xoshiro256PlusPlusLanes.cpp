@@ -0,0 +1,144 @@
+#include "libs/random/Xoshiro256PlusPlusLanes.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Define M_PI for Windows MSVC compatibility
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace random {
+
+namespace {
+
+constexpr std::size_t BLOCK = 256;
+constexpr double UNIT = 0x1.0p-53;
+
+// The start of the tail of the 256-layer Ziggurat of the normal distribution
+constexpr double ZIGGURAT_R = 3.654152885361008796;
+
+inline double density(double x) { return std::exp(-0.5 * x * x); }
+
+/**
+ * The layers of the Ziggurat (Marsaglia and Tsang, with the tables of
+ * Doornik): x[i] is the right edge of the layer i and f[i] the density
+ * there. The layer 0 is the base, whose area includes the tail.
+ */
+struct ZigguratTables {
+  double x[257];
+  double f[257];
+
+  ZigguratTables() {
+    const double r = ZIGGURAT_R;
+    const double area =
+        r * density(r) + std::sqrt(M_PI / 2.0) * std::erfc(r / std::sqrt(2.0));
+    x[0] = area / density(r);
+    x[1] = r;
+    for (int i = 2; i < 256; ++i) {
+      x[i] = std::sqrt(-2.0 * std::log(area / x[i - 1] + density(x[i - 1])));
+    }
+    x[256] = 0.0;
+    for (int i = 0; i <= 256; ++i) {
+      f[i] = density(x[i]);
+    }
+  }
+};
+
+const ZigguratTables &zigguratTables() {
+  static const ZigguratTables tables;
+  return tables;
+}
+
+inline double toUniform(std::uint64_t bits) {
+  // Through a signed integer, which converts to SIMD without AVX-512
+  return static_cast<double>(static_cast<std::int64_t>(bits >> 11)) * UNIT;
+}
+
+// In (0, 1), for the logarithms of the tail
+inline double toOpenUniform(std::uint64_t bits) {
+  return (static_cast<double>(static_cast<std::int64_t>(bits >> 12)) + 0.5) *
+         0x1.0p-52;
+}
+
+} // namespace
+
+void Xoshiro256PlusPlusLanes::fillBits(std::uint64_t *out,
+                                       std::size_t count) {
+  std::size_t i = 0;
+  for (; i + LANES <= count; i += LANES) {
+    step(out + i);
+  }
+  if (i < count) {
+    std::uint64_t last[LANES];
+    step(last);
+    std::copy_n(last, count - i, out + i);
+  }
+}
+
+void Xoshiro256PlusPlusLanes::fillUniform(double *out, std::size_t count) {
+  alignas(32) std::uint64_t bits[BLOCK];
+  for (std::size_t start = 0; start < count; start += BLOCK) {
+    const std::size_t block = std::min(BLOCK, count - start);
+    fillBits(bits, block);
+    double *values = out + start;
+    for (std::size_t i = 0; i < block; ++i) {
+      values[i] = toUniform(bits[i]);
+    }
+  }
+}
+
+void Xoshiro256PlusPlusLanes::fillGaussian(double *out, std::size_t count) {
+  const ZigguratTables &tables = zigguratTables();
+  alignas(32) std::uint64_t bits[BLOCK];
+  for (std::size_t start = 0; start < count; start += BLOCK) {
+    const std::size_t block = std::min(BLOCK, count - start);
+    fillBits(bits, block);
+    for (std::size_t i = 0; i < block; ++i) {
+      // The low byte picks the layer, the high 53 bits the abscissa
+      std::uint64_t word = bits[i];
+      for (;;) {
+        const std::size_t layer = word & 0xff;
+        const double u = 2.0 * toUniform(word) - 1.0;
+        const double x = u * tables.x[layer];
+        if (std::abs(x) < tables.x[layer + 1]) {
+          out[start + i] = x;
+          break;
+        }
+        if (layer == 0) {
+          // The tail beyond R, sampled as Marsaglia does
+          double tail;
+          double y;
+          do {
+            tail = -std::log(toOpenUniform(next())) / ZIGGURAT_R;
+            y = -std::log(toOpenUniform(next()));
+          } while (2.0 * y < tail * tail);
+          out[start + i] = u < 0.0 ? -(ZIGGURAT_R + tail) : ZIGGURAT_R + tail;
+          break;
+        }
+        const double height =
+            tables.f[layer] +
+            (tables.f[layer + 1] - tables.f[layer]) * toUniform(next());
+        if (height < density(x)) {
+          out[start + i] = x;
+          break;
+        }
+        word = next();
+      }
+    }
+  }
+}
+
+} // namespace random
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
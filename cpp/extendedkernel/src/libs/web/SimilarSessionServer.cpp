@@ -0,0 +1,245 @@
+#include "libs/web/SimilarSessionServer.h"
+#include "third_party/httplib.h"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace web {
+
+SimilarSessionServer::SimilarSessionServer(SessionFactory factory)
+    : factory(std::move(factory)),
+      staticFiles(std::make_shared<view::StaticFileCache>()),
+      nextSessionId(1), boundPort(0) {
+  if (!this->factory) {
+    throw std::invalid_argument("The session factory cannot be null");
+  }
+}
+
+SimilarSessionServer::~SimilarSessionServer() { stop(); }
+
+std::uint64_t SimilarSessionServer::openSession() {
+  const std::size_t maxSessions =
+      static_cast<std::size_t>(std::max(0, config.getMaxSessions()));
+  std::uint64_t id;
+  httplib::ThreadPool *pool;
+  {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    if (sessions.size() >= maxSessions) {
+      throw std::runtime_error("The server hosts the most sessions");
+    }
+    if (!simulationPool) {
+      int threads = config.getSimulationThreadCount();
+      if (threads <= 0) {
+        threads = static_cast<int>(
+            std::max(1u, std::thread::hardware_concurrency()));
+      }
+      simulationPool = std::make_unique<httplib::ThreadPool>(
+          static_cast<std::size_t>(threads));
+    }
+    id = nextSessionId++;
+    pool = simulationPool.get();
+  }
+
+  // Built outside the lock: the factory may load the shared assets
+  SessionSimulation simulation = factory(assets);
+  auto runner = std::make_shared<SimilarWebRunner>();
+  SimilarWebConfig *sessionConfig = runner->getConfig();
+  sessionConfig->setSimulationName(config.getSimulationName() + " #" +
+                                   std::to_string(id));
+  sessionConfig->setPort(boundPort != 0 ? boundPort : config.getPort());
+  sessionConfig->setMaxStreamClients(config.getMaxStreamClients());
+  runner->initializeRunner(
+      simulation.engine, simulation.model, staticFiles,
+      [pool](std::function<void()> task) { pool->enqueue(std::move(task)); });
+  // A session is closed, not the server it shares
+  runner->getController()->setAllowShutDown(false);
+
+  std::lock_guard<std::mutex> lock(sessionsMutex);
+  if (sessions.size() >= maxSessions) {
+    throw std::runtime_error("The server hosts the most sessions");
+  }
+  sessions.emplace(id, std::move(runner));
+  return id;
+}
+
+bool SimilarSessionServer::closeSession(std::uint64_t id) {
+  std::shared_ptr<SimilarWebRunner> runner;
+  {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    auto it = sessions.find(id);
+    if (it == sessions.end()) {
+      return false;
+    }
+    runner = std::move(it->second);
+    sessions.erase(it);
+  }
+  // Outside the lock: the runner waits for the end of its simulation
+  runner.reset();
+  return true;
+}
+
+std::shared_ptr<SimilarWebRunner>
+SimilarSessionServer::getSession(std::uint64_t id) const {
+  std::lock_guard<std::mutex> lock(sessionsMutex);
+  auto it = sessions.find(id);
+  return it != sessions.end() ? it->second : nullptr;
+}
+
+std::size_t SimilarSessionServer::getSessionCount() const {
+  std::lock_guard<std::mutex> lock(sessionsMutex);
+  return sessions.size();
+}
+
+std::string SimilarSessionServer::generateLobbyPage() {
+  std::string list;
+  std::size_t count;
+  {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    count = sessions.size();
+    for (const auto &session : sessions) {
+      const std::string id = std::to_string(session.first);
+      list += "<li class=\"list-group-item\"><a href=\"/sessions/" + id +
+              "/\">" + session.second->getConfig()->getSimulationName() +
+              "</a></li>\n";
+    }
+  }
+
+  return R"HTML(<!DOCTYPE html>
+<html lang="en">
+<head>
+    <meta charset="UTF-8">
+    <meta name="viewport" content="width=device-width, initial-scale=1.0">
+    <title>)HTML" +
+         config.getSimulationName() + R"HTML(</title>
+    <link rel="stylesheet" href="/css/bootstrap.min.css">
+</head>
+<body>
+    <div class="container mt-4">
+        <h1>)HTML" +
+         config.getSimulationName() + R"HTML(</h1>
+        <p>Sessions: <strong>)HTML" +
+         std::to_string(count) + " / " +
+         std::to_string(config.getMaxSessions()) + R"HTML(</strong></p>
+        <a class="btn btn-success" href="/sessions/new">New session</a>
+        <ul class="list-group mt-4">
+)HTML" + list +
+         R"HTML(        </ul>
+    </div>
+</body>
+</html>)HTML";
+}
+
+void SimilarSessionServer::setupRoutes() {
+  server->Get("/", [this](const httplib::Request &, httplib::Response &res) {
+    res.set_content(generateLobbyPage(), "text/html");
+  });
+
+  server->Get("/sessions/new",
+              [this](const httplib::Request &, httplib::Response &res) {
+                try {
+                  std::uint64_t id = openSession();
+                  res.set_redirect("/sessions/" + std::to_string(id) + "/",
+                                   httplib::StatusCode::SeeOther_303);
+                } catch (const std::runtime_error &e) {
+                  res.status = 503;
+                  res.set_content(e.what(), "text/plain");
+                }
+              });
+
+  // The page of a session requests its actions relative to its path
+  server->Get(R"(/sessions/(\d+))",
+              [](const httplib::Request &req, httplib::Response &res) {
+                res.set_redirect(req.path + "/",
+                                 httplib::StatusCode::MovedPermanently_301);
+              });
+
+  server->Get(
+      R"(/sessions/(\d+)/([A-Za-z]*))",
+      [this](const httplib::Request &req, httplib::Response &res) {
+        const std::uint64_t id = std::stoull(req.matches[1].str());
+        const std::string action = req.matches[2].str();
+        if (action == "close") {
+          res.status = closeSession(id) ? 200 : 404;
+          return;
+        }
+        // Held until the request ends, even if the session is closed
+        std::shared_ptr<SimilarWebRunner> runner = getSession(id);
+        if (!runner || !runner->handleViewRequest(action, req, res)) {
+          res.status = 404;
+        }
+      });
+
+  server->Get(R"(/((css|js|img)/.+))",
+              [this](const httplib::Request &req, httplib::Response &res) {
+                staticFiles->serve(req.matches[1].str(), res);
+              });
+}
+
+void SimilarSessionServer::start() {
+  if (server) {
+    throw std::logic_error("The session server is already started");
+  }
+  server = std::make_unique<httplib::Server>();
+  // Each open state stream holds a thread
+  std::size_t threads =
+      static_cast<std::size_t>(std::max(1, config.getHttpThreadCount())) +
+      static_cast<std::size_t>(std::max(0, config.getMaxSessions()) *
+                               std::max(0, config.getMaxStreamClients()));
+  std::size_t queued =
+      static_cast<std::size_t>(std::max(0, config.getMaxQueuedRequests()));
+  server->new_task_queue = [threads, queued]() {
+    return new httplib::ThreadPool(threads, queued);
+  };
+  setupRoutes();
+
+  const std::string host = "0.0.0.0";
+  if (config.getPort() == 0) {
+    boundPort = server->bind_to_any_port(host);
+  } else if (server->bind_to_port(host, config.getPort())) {
+    boundPort = config.getPort();
+  }
+  if (boundPort <= 0) {
+    server.reset();
+    boundPort = 0;
+    throw std::runtime_error("The session server cannot bind its port");
+  }
+  listener = std::thread([this]() { server->listen_after_bind(); });
+  std::cout << "Session server listening on port " << boundPort << std::endl;
+}
+
+void SimilarSessionServer::stop() {
+  if (server) {
+    server->stop();
+  }
+  if (listener.joinable()) {
+    listener.join();
+  }
+  server.reset();
+
+  std::map<std::uint64_t, std::shared_ptr<SimilarWebRunner>> closed;
+  std::unique_ptr<httplib::ThreadPool> pool;
+  {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    closed.swap(sessions);
+    pool = std::move(simulationPool);
+  }
+  // The runners abort their simulations, or cancel the ones waiting
+  closed.clear();
+  if (pool) {
+    pool->shutdown();
+  }
+}
+
+} // namespace web
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -10,7 +10,9 @@ namespace web {
 
 SimilarWebConfig::SimilarWebConfig()
     : port(8080), simulationName("SIMILAR Simulation"), initialized(false),
-      autoOpenBrowser(false) {}
+      autoOpenBrowser(false), httpThreadCount(4), maxQueuedRequests(64),
+      maxStreamClients(2), maxSessions(64), simulationThreadCount(0),
+      rewindSteps(0), rewindKeyFramePeriod(32) {}
 
 } // namespace web
 } // namespace libs
@@ -1,8 +1,11 @@
 #include "libs/web/SimilarWebRunner.h"
 #include "IProbe.h"
 #include "ISimulationEngine.h"
+#include "engine/MultiThreadedSimulationEngine.h"
+#include "engine/RewindBuffer.h"
 #include "simulationmodel/ISimulationModel.h"
 #include "simulationmodel/ISimulationParameters.h"
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 
@@ -19,9 +22,67 @@ using microkernel::IProbe;
 
 SimilarWebRunner::SimilarWebRunner() : simulationParameters(nullptr) {}
 
+SimilarWebRunner::~SimilarWebRunner() {
+  // The engine calls the controller and the view until the run ends
+  if (controller) {
+    controller->stopSimulation();
+  }
+}
+
 void SimilarWebRunner::initializeRunner(
     std::shared_ptr<microkernel::ISimulationEngine> engine,
     std::shared_ptr<simulationmodel::ISimulationModel> model) {
+  initialize(engine, model, nullptr);
+  std::cout << "✅ Web interface initialized successfully!" << std::endl;
+  std::cout << "   Simulation: " << config.getSimulationName() << std::endl;
+  std::cout << "   Port: " << config.getPort() << std::endl;
+}
+
+void SimilarWebRunner::initializeRunner(
+    std::shared_ptr<microkernel::ISimulationEngine> engine,
+    const microkernel::engine::ModelPlugin &plugin,
+    const std::string &arguments) {
+  if (config.isAlreadyInitialized()) {
+    throw std::runtime_error("The runner is already initialized");
+  }
+  auto model = std::dynamic_pointer_cast<simulationmodel::ISimulationModel>(
+      plugin.createModel(arguments));
+  if (!model) {
+    throw std::invalid_argument("The model of the plugin " + plugin.getPath() +
+                                " is not a model of the extended kernel");
+  }
+  if (engine) {
+    plugin.installBatchBehaviors(*engine);
+  }
+  initializeRunner(engine, model);
+}
+
+void SimilarWebRunner::initializeRunner(
+    std::shared_ptr<microkernel::ISimulationEngine> engine,
+    std::shared_ptr<simulationmodel::ISimulationModel> model,
+    std::shared_ptr<view::StaticFileCache> staticFiles,
+    SimulationExecutionThread::Executor executor) {
+  if (!staticFiles) {
+    throw std::invalid_argument("The static files cannot be null");
+  }
+  initialize(engine, model, std::move(staticFiles));
+  controller->setRunExecutor(std::move(executor));
+  controller->listenToViewRequests();
+}
+
+bool SimilarWebRunner::handleViewRequest(const std::string &action,
+                                         const httplib::Request &req,
+                                         httplib::Response &res) {
+  if (!config.isAlreadyInitialized()) {
+    throw std::runtime_error("The runner is not initialized");
+  }
+  return httpServer->handleRequest(action, req, res);
+}
+
+void SimilarWebRunner::initialize(
+    std::shared_ptr<microkernel::ISimulationEngine> engine,
+    std::shared_ptr<simulationmodel::ISimulationModel> model,
+    std::shared_ptr<view::StaticFileCache> staticFiles) {
 
   if (!model) {
     throw std::invalid_argument("The model cannot be null");
@@ -50,13 +111,31 @@ void SimilarWebRunner::initializeRunner(
   // Create controller
   controller = std::make_unique<control::SimilarWebController>(engine, model);
 
+  // Keep the recent steps for the view to go back to them, unless the
+  // engine was given a buffer of its own, e.g. with influence codecs
+  auto multiThreaded = std::dynamic_pointer_cast<
+      microkernel::engine::MultiThreadedSimulationEngine>(engine);
+  if (config.getRewindSteps() > 0 && multiThreaded &&
+      !multiThreaded->getRewindBuffer()) {
+    multiThreaded->setRewindBuffer(
+        std::make_shared<microkernel::engine::RewindBuffer>(
+            static_cast<std::size_t>(config.getRewindSteps()),
+            static_cast<std::size_t>(
+                std::max(1, config.getRewindKeyFramePeriod()))));
+  }
+
   // Add controller as a probe to the engine (non-owning shared_ptr)
   std::shared_ptr<IProbe> probePtr(controller.get(), [](IProbe *) {});
   engine->addProbe("Web Controller", probePtr);
 
-  // Create HTTP server
-  httpServer =
-      std::make_unique<view::SimilarHttpServer>(controller.get(), this);
+  // Create HTTP server, or the view mounted on a session server
+  if (staticFiles) {
+    httpServer = std::make_unique<view::SimilarHttpServer>(
+        controller.get(), this, std::move(staticFiles));
+  } else {
+    httpServer =
+        std::make_unique<view::SimilarHttpServer>(controller.get(), this);
+  }
 
   // Initialize server
   httpServer->initServer();
@@ -64,9 +143,14 @@ void SimilarWebRunner::initializeRunner(
   // Bind view and controller
   controller->setViewControls(httpServer.get());
 
-  std::cout << "✅ Web interface initialized successfully!" << std::endl;
-  std::cout << "   Simulation: " << config.getSimulationName() << std::endl;
-  std::cout << "   Port: " << config.getPort() << std::endl;
+  // Push the step to the view
+  addStateStreamProbe(
+      "Web State Stream",
+      [](const microkernel::SimulationTimeStamp &timestamp,
+         const microkernel::ISimulationEngine &) {
+        return "{\"step\":" + std::to_string(timestamp.getIdentifier()) +
+               "}";
+      });
 }
 
 void SimilarWebRunner::showView() {
@@ -86,6 +170,51 @@ void SimilarWebRunner::showView() {
   std::cout << "   Press Ctrl+C to stop" << std::endl;
 }
 
+void SimilarWebRunner::addStateStreamProbe(
+    const std::string &name,
+    probes::AsyncProbe<std::string>::SnapshotFunction snapshot) {
+  if (!config.isAlreadyInitialized()) {
+    throw std::runtime_error(
+        "The runner must be initialized before adding probes");
+  }
+  std::shared_ptr<view::StateStream> stream = httpServer->getStateStream();
+  auto probe = std::make_shared<probes::AsyncProbe<std::string>>(
+      std::move(snapshot),
+      [stream](const microkernel::SimulationTimeStamp &,
+               const std::string &state) { stream->publish("state", state); },
+      1, probes::AsyncProbePolicy::DROP_OLDEST);
+  engine->addProbe(name, probe);
+  streamProbes.emplace_back(name, probe);
+  if (metrics) {
+    metrics->addQueue(name, [probe]() { return probe->getQueueDepth(); });
+  }
+}
+
+void SimilarWebRunner::setTileSource(
+    std::shared_ptr<view::ITileSource> source) {
+  if (!config.isAlreadyInitialized()) {
+    throw std::runtime_error("The runner is not initialized");
+  }
+  httpServer->setTileSource(std::move(source));
+}
+
+std::shared_ptr<microkernel::libs::SimulationMetrics>
+SimilarWebRunner::enableMetrics() {
+  if (!config.isAlreadyInitialized()) {
+    throw std::runtime_error("The runner is not initialized");
+  }
+  if (!metrics) {
+    metrics = std::make_shared<microkernel::libs::SimulationMetrics>(
+        engine->getStepTimingListener());
+    for (const auto &[name, probe] : streamProbes) {
+      metrics->addQueue(name, [probe]() { return probe->getQueueDepth(); });
+    }
+    engine->setStepTimingListener(metrics);
+    httpServer->setMetrics(metrics);
+  }
+  return metrics;
+}
+
 void SimilarWebRunner::addProbe(const std::string &name,
                                 std::shared_ptr<microkernel::IProbe> probe) {
 
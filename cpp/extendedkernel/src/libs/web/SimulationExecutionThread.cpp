@@ -12,33 +12,71 @@ namespace web {
 
 SimulationExecutionThread::SimulationExecutionThread(
     std::shared_ptr<microkernel::ISimulationEngine> engine,
-    std::shared_ptr<simulationmodel::ISimulationModel> model)
-    : engine(engine), model(model), finished(false) {}
+    std::shared_ptr<simulationmodel::ISimulationModel> model,
+    Executor executor)
+    : engine(engine), model(model), executor(std::move(executor)) {}
 
 SimulationExecutionThread::~SimulationExecutionThread() {
+  if (!cancel()) {
+    join();
+  }
   if (thread && thread->joinable()) {
     thread->join();
   }
 }
 
-void SimulationExecutionThread::run() {
-  try {
-    // Run the simulation using the engine
-    engine->runNewSimulation(model);
-  } catch (...) {
-    // Errors are handled by probes
+void SimulationExecutionThread::start() {
+  state = std::make_shared<RunState>();
+  auto task = [engine = engine, model = model, state = state]() {
+    Phase queued = Phase::QUEUED;
+    if (state->phase.compare_exchange_strong(queued, Phase::RUNNING)) {
+      try {
+        // Run the simulation using the engine
+        engine->runNewSimulation(model);
+      } catch (...) {
+        // Errors are handled by probes
+      }
+      std::lock_guard<std::mutex> lock(state->mutex);
+      state->phase = Phase::FINISHED;
+    }
+    state->ended.notify_all();
+  };
+  if (executor) {
+    executor(std::move(task));
+  } else {
+    thread = std::make_unique<std::thread>(std::move(task));
   }
-  finished.store(true);
 }
 
-void SimulationExecutionThread::start() {
-  finished.store(false);
-  thread = std::make_unique<std::thread>(&SimulationExecutionThread::run, this);
+bool SimulationExecutionThread::hasFinished() const {
+  if (!state) {
+    return true;
+  }
+  Phase phase = state->phase.load();
+  return phase == Phase::FINISHED || phase == Phase::CANCELLED;
+}
+
+bool SimulationExecutionThread::cancel() {
+  if (!state) {
+    return true;
+  }
+  std::lock_guard<std::mutex> lock(state->mutex);
+  Phase queued = Phase::QUEUED;
+  if (state->phase.compare_exchange_strong(queued, Phase::CANCELLED)) {
+    state->ended.notify_all();
+    return true;
+  }
+  return queued == Phase::CANCELLED;
 }
 
 void SimulationExecutionThread::join() {
   if (thread && thread->joinable()) {
     thread->join();
+    return;
+  }
+  if (state) {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->ended.wait(lock, [this]() { return hasFinished(); });
   }
 }
 
@@ -1,8 +1,11 @@
 #include "libs/web/control/SimilarWebController.h"
 #include "ISimulationEngine.h"
+#include "engine/MultiThreadedSimulationEngine.h"
 #include "libs/web/SimulationExecutionThread.h"
+#include "simulationmodel/ISimulationParameters.h"
 #include <chrono>
 #include <iostream>
+#include <stdexcept>
 #include <thread>
 
 namespace fr {
@@ -18,8 +21,14 @@ SimilarWebController::SimilarWebController(
     std::shared_ptr<microkernel::ISimulationEngine> engine,
     std::shared_ptr<simulationmodel::ISimulationModel> model)
     : engine(engine), model(model), viewControls(nullptr),
-      engineState(EngineState::IDLE), togglePause(false),
-      listenToRequests(false), allowShutDown(true) {}
+      stepBarrier(std::make_shared<microkernel::engine::StepBarrier>()),
+      parameters(nullptr), engineState(EngineState::IDLE),
+      listenToRequests(false), allowShutDown(true) {
+  engine->setStepBarrier(stepBarrier);
+  if (auto *simulationParameters = model->getSimulationParameters()) {
+    parameters = simulationParameters->getParameterStore();
+  }
+}
 
 void SimilarWebController::setViewControls(IHtmlControls *viewControls) {
   this->viewControls = viewControls;
@@ -34,6 +43,26 @@ void SimilarWebController::listenToViewRequests() {
   listenToRequests.store(true);
 }
 
+void SimilarWebController::stopSimulation() {
+  listenToRequests.store(false);
+  SimulationExecutionThread *run = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    run = simuThread.get();
+  }
+  // The probe callbacks of the run take the state mutex: it is not held
+  if (!run || run->cancel()) {
+    return;
+  }
+  // The engine clears its abortion flag as a run starts: it is requested
+  // again until the run ends
+  while (!run->hasFinished()) {
+    engine->requestSimulationAbortion();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  run->join();
+}
+
 void SimilarWebController::changeEngineState(EngineState newState) {
   engineState = newState;
   if (viewControls) {
@@ -68,8 +97,9 @@ void SimilarWebController::handleNewSimulationRequest() {
 
   // Start new simulation
   changeEngineState(EngineState::RUN_PLANNED);
-  togglePause.store(false);
-  simuThread = std::make_unique<SimulationExecutionThread>(engine, model);
+  stepBarrier->resume();
+  simuThread =
+      std::make_unique<SimulationExecutionThread>(engine, model, runExecutor);
   simuThread->start();
 }
 
@@ -103,7 +133,63 @@ void SimilarWebController::handleSimulationPauseRequest() {
     return;
   }
 
-  togglePause.store(true);
+  if (engineState == EngineState::PAUSED) {
+    stepBarrier->resume();
+    changeEngineState(EngineState::RUN);
+  } else {
+    stepBarrier->pause();
+    changeEngineState(EngineState::PAUSED);
+  }
+}
+
+void SimilarWebController::handleSimulationStepRequest() {
+  if (!listenToRequests.load()) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(stateMutex);
+
+  if (!EngineStateUtil::allowsPause(engineState)) {
+    std::cout << "Ignored simulation step request (current state: "
+              << EngineStateUtil::toString(engineState) << ")" << std::endl;
+    return;
+  }
+
+  stepBarrier->step();
+  changeEngineState(EngineState::PAUSED);
+}
+
+void SimilarWebController::handleStepRateRequest(double stepsPerSecond) {
+  if (!listenToRequests.load()) {
+    return;
+  }
+  stepBarrier->setStepRate(stepsPerSecond);
+}
+
+void SimilarWebController::handleRewindRequest(long step) {
+  if (!listenToRequests.load()) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(stateMutex);
+
+  auto multiThreaded =
+      std::dynamic_pointer_cast<microkernel::engine::MultiThreadedSimulationEngine>(
+          engine);
+  if (engineState != EngineState::PAUSED || !multiThreaded ||
+      !multiThreaded->getRewindBuffer()) {
+    std::cout << "Ignored simulation rewind request (current state: "
+              << EngineStateUtil::toString(engineState) << ")" << std::endl;
+    return;
+  }
+
+  // The engine may still finish the step it ran when it was paused
+  const bool rewound = stepBarrier->whileParked(
+      [&]() { multiThreaded->rewind(microkernel::SimulationTimeStamp(step)); });
+  if (!rewound) {
+    std::cout << "Ignored simulation rewind request (the step is not over)"
+              << std::endl;
+  }
 }
 
 void SimilarWebController::handleShutDownRequest() {
@@ -127,9 +213,10 @@ std::string SimilarWebController::getParameter(const std::string &parameter) {
   if (!listenToRequests.load()) {
     return "";
   }
-  // Parameter reflection would go here
-  // For now, return placeholder
-  return "Parameter reflection not yet implemented";
+  if (!parameters || !parameters->isDeclared(parameter)) {
+    return "Unknown parameter: " + parameter;
+  }
+  return parameters->getText(parameter);
 }
 
 void SimilarWebController::setParameter(const std::string &parameter,
@@ -137,8 +224,11 @@ void SimilarWebController::setParameter(const std::string &parameter,
   if (!listenToRequests.load()) {
     return;
   }
-  // Parameter reflection would go here
-  std::cout << "Set parameter: " << parameter << " = " << value << std::endl;
+  if (!parameters) {
+    throw std::invalid_argument("Unknown parameter: " + parameter);
+  }
+  // Published by the engine thread at the end of the step
+  parameters->set(parameter, value);
 }
 
 // IProbe implementation
@@ -154,6 +244,9 @@ void SimilarWebController::prepareObservation() {
 void SimilarWebController::observeAtInitialTimes(
     const microkernel::SimulationTimeStamp &initialTimestamp,
     const microkernel::ISimulationEngine &simulationEngine) {
+  if (parameters) {
+    parameters->commit();
+  }
 
   std::lock_guard<std::mutex> lock(stateMutex);
   if (!EngineStateUtil::isAborting(engineState) &&
@@ -165,38 +258,10 @@ void SimilarWebController::observeAtInitialTimes(
 void SimilarWebController::observeAtPartialConsistentTime(
     const microkernel::SimulationTimeStamp &timestamp,
     const microkernel::ISimulationEngine &simulationEngine) {
-
-  // Handle pause/resume
-  bool paused = false;
-  {
-    std::lock_guard<std::mutex> lock(stateMutex);
-    if (EngineStateUtil::allowsPause(engineState)) {
-      paused = (engineState == EngineState::RUN) && togglePause.load();
-      togglePause.store(false);
-      if (paused) {
-        changeEngineState(EngineState::PAUSED);
-      }
-    }
-  }
-
-  // While paused, wait
-  while (paused) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
-
-    std::lock_guard<std::mutex> lock(stateMutex);
-    paused = !togglePause.load() && !EngineStateUtil::isAborting(engineState) &&
-             !EngineStateUtil::isShuttingDown(engineState);
-  }
-
-  // Resume
-  {
-    std::lock_guard<std::mutex> lock(stateMutex);
-    togglePause.store(false);
-    if (!EngineStateUtil::isAborting(engineState) &&
-        !EngineStateUtil::isShuttingDown(engineState) &&
-        engineState != EngineState::RUN) {
-      changeEngineState(EngineState::RUN);
-    }
+  // The engine waits at the step barrier while paused. The agents read the
+  // parameters during the steps only: the new values are published now.
+  if (parameters) {
+    parameters->commit();
   }
 }
 
@@ -0,0 +1,253 @@
+#include "libs/web/view/PngEncoder.h"
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace web {
+namespace view {
+
+namespace {
+
+// The bases and extra bits of the length codes 257 to 285 and of the
+// distance codes 0 to 29 (RFC 1951, 3.2.5)
+constexpr std::array<std::uint16_t, 29> LENGTH_BASES = {
+    3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+    31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr std::array<std::uint8_t, 29> LENGTH_EXTRA = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+    2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr std::array<std::uint16_t, 30> DISTANCE_BASES = {
+    1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+    33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+    1025, 1537, 2049, 3073, 4097, 6145,  8193,  12289, 16385, 24577};
+constexpr std::array<std::uint8_t, 30> DISTANCE_EXTRA = {
+    0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+    6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+constexpr std::size_t MAX_MATCH = 258;
+constexpr std::size_t MAX_DISTANCE = 32768;
+
+const std::array<std::uint32_t, 256> &crcTable() {
+  static const std::array<std::uint32_t, 256> table = [] {
+    std::array<std::uint32_t, 256> values{};
+    for (std::uint32_t n = 0; n < 256; ++n) {
+      std::uint32_t c = n;
+      for (int k = 0; k < 8; ++k) {
+        c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      }
+      values[n] = c;
+    }
+    return values;
+  }();
+  return table;
+}
+
+std::uint32_t crc32(const char *data, std::size_t size) {
+  const auto &table = crcTable();
+  std::uint32_t c = 0xffffffffu;
+  for (std::size_t i = 0; i < size; ++i) {
+    c = table[(c ^ static_cast<std::uint8_t>(data[i])) & 0xff] ^ (c >> 8);
+  }
+  return c ^ 0xffffffffu;
+}
+
+void putBigEndian(std::string &out, std::uint32_t value) {
+  out.push_back(static_cast<char>(value >> 24));
+  out.push_back(static_cast<char>(value >> 16));
+  out.push_back(static_cast<char>(value >> 8));
+  out.push_back(static_cast<char>(value));
+}
+
+// Writes the bits of a deflate stream, least significant first
+class BitWriter {
+public:
+  explicit BitWriter(std::string &out) : out(out) {}
+
+  void bits(std::uint32_t value, int count) {
+    buffer |= static_cast<std::uint64_t>(value) << used;
+    used += count;
+    while (used >= 8) {
+      out.push_back(static_cast<char>(buffer & 0xff));
+      buffer >>= 8;
+      used -= 8;
+    }
+  }
+
+  // A Huffman code, whose most significant bit comes first
+  void code(std::uint32_t value, int length) {
+    std::uint32_t reversed = 0;
+    for (int i = 0; i < length; ++i) {
+      reversed |= ((value >> i) & 1u) << (length - 1 - i);
+    }
+    bits(reversed, length);
+  }
+
+  void literal(std::uint32_t symbol) {
+    if (symbol < 144) {
+      code(0x30 + symbol, 8);
+    } else if (symbol < 256) {
+      code(0x190 + symbol - 144, 9);
+    } else if (symbol < 280) {
+      code(symbol - 256, 7);
+    } else {
+      code(0xc0 + symbol - 280, 8);
+    }
+  }
+
+  void match(std::size_t length, std::size_t distance) {
+    std::size_t l = LENGTH_BASES.size() - 1;
+    while (LENGTH_BASES[l] > length) {
+      --l;
+    }
+    literal(257 + static_cast<std::uint32_t>(l));
+    bits(static_cast<std::uint32_t>(length - LENGTH_BASES[l]),
+         LENGTH_EXTRA[l]);
+    std::size_t d = DISTANCE_BASES.size() - 1;
+    while (DISTANCE_BASES[d] > distance) {
+      --d;
+    }
+    code(static_cast<std::uint32_t>(d), 5);
+    bits(static_cast<std::uint32_t>(distance - DISTANCE_BASES[d]),
+         DISTANCE_EXTRA[d]);
+  }
+
+  void flush() {
+    if (used > 0) {
+      out.push_back(static_cast<char>(buffer & 0xff));
+    }
+    buffer = 0;
+    used = 0;
+  }
+
+private:
+  std::string &out;
+  std::uint64_t buffer = 0;
+  int used = 0;
+};
+
+} // namespace
+
+PngEncoder::PngEncoder(std::vector<std::uint8_t> paletteRgba)
+    : palette(std::move(paletteRgba)) {
+  if (palette.empty() || palette.size() % 4 != 0 || palette.size() > 1024) {
+    throw std::invalid_argument("A PNG palette has 1 to 256 RGBA colors.");
+  }
+}
+
+std::size_t PngEncoder::beginChunk(const char *type) {
+  const std::size_t start = file.size();
+  putBigEndian(file, 0);
+  file.append(type, 4);
+  return start;
+}
+
+void PngEncoder::endChunk(std::size_t start) {
+  const std::size_t length = file.size() - start - 8;
+  for (int i = 0; i < 4; ++i) {
+    file[start + i] = static_cast<char>(length >> (24 - 8 * i));
+  }
+  putBigEndian(file, crc32(file.data() + start + 4, length + 4));
+}
+
+void PngEncoder::deflate(std::size_t stride) {
+  // The zlib header of a deflate stream with a 32 KiB window
+  file.push_back(0x78);
+  file.push_back(0x01);
+  BitWriter writer(file);
+  writer.bits(1, 1); // the final block
+  writer.bits(1, 2); // of fixed Huffman codes
+  const std::uint8_t *data = scanlines.data();
+  const std::size_t size = scanlines.size();
+  const std::size_t distances[2] = {1, stride};
+  std::size_t i = 0;
+  while (i < size) {
+    std::size_t bestLength = 0;
+    std::size_t bestDistance = 0;
+    for (std::size_t distance : distances) {
+      if (distance > i || distance > MAX_DISTANCE) {
+        continue;
+      }
+      const std::size_t limit = std::min(MAX_MATCH, size - i);
+      std::size_t length = 0;
+      while (length < limit && data[i + length] == data[i + length - distance]) {
+        ++length;
+      }
+      if (length > bestLength) {
+        bestLength = length;
+        bestDistance = distance;
+      }
+    }
+    if (bestLength >= 3) {
+      writer.match(bestLength, bestDistance);
+      i += bestLength;
+    } else {
+      writer.literal(data[i]);
+      ++i;
+    }
+  }
+  writer.literal(256); // the end of the block
+  writer.flush();
+
+  std::uint32_t a = 1;
+  std::uint32_t b = 0;
+  for (std::size_t k = 0; k < size; ++k) {
+    a = (a + data[k]) % 65521;
+    b = (b + a) % 65521;
+  }
+  putBigEndian(file, (b << 16) | a);
+}
+
+std::string PngEncoder::encode(int width, int height,
+                               const std::uint8_t *indices) {
+  if (width <= 0 || height <= 0) {
+    throw std::invalid_argument("The dimensions must be positive.");
+  }
+  const std::size_t rowSize = static_cast<std::size_t>(width);
+  scanlines.resize((rowSize + 1) * height);
+  for (int y = 0; y < height; ++y) {
+    std::uint8_t *scanline = scanlines.data() + (rowSize + 1) * y;
+    scanline[0] = 0; // no filter
+    std::memcpy(scanline + 1, indices + rowSize * y, rowSize);
+  }
+
+  file.clear();
+  file.append("\x89PNG\r\n\x1a\n", 8);
+  std::size_t chunk = beginChunk("IHDR");
+  putBigEndian(file, static_cast<std::uint32_t>(width));
+  putBigEndian(file, static_cast<std::uint32_t>(height));
+  file.push_back(8); // bits per index
+  file.push_back(3); // palette colors
+  file.append(3, '\0'); // deflate, adaptive filters, no interlace
+  endChunk(chunk);
+
+  chunk = beginChunk("PLTE");
+  for (std::size_t c = 0; c < palette.size(); c += 4) {
+    file.append(reinterpret_cast<const char *>(&palette[c]), 3);
+  }
+  endChunk(chunk);
+  chunk = beginChunk("tRNS");
+  for (std::size_t c = 0; c < palette.size(); c += 4) {
+    file.push_back(static_cast<char>(palette[c + 3]));
+  }
+  endChunk(chunk);
+
+  chunk = beginChunk("IDAT");
+  deflate(rowSize + 1);
+  endChunk(chunk);
+  endChunk(beginChunk("IEND"));
+  return file;
+}
+
+} // namespace view
+} // namespace web
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -1,9 +1,10 @@
 #include "libs/web/view/SimilarHttpServer.h"
 #include "third_party/httplib.h"
 #include "libs/web/SimilarWebConfig.h"
-#include <fstream>
+#include <algorithm>
+#include <chrono>
 #include <iostream>
-#include <sstream>
+#include <stdexcept>
 #include <thread>
 
 #ifdef __APPLE__
@@ -21,43 +22,39 @@ namespace view {
 
 SimilarHttpServer::SimilarHttpServer(IHtmlRequests *controller,
                                      IHtmlInitializationData *initData)
-    : controller(controller), initData(initData), running(false) {
-
-  port = initData->getConfig()->getPort();
+    : SimilarHttpServer(controller, initData,
+                        std::make_shared<StaticFileCache>()) {
+  SimilarWebConfig *config = initData->getConfig();
   server = std::make_unique<httplib::Server>();
+
+  // A bounded pool, refusing the requests beyond its queue
+  std::size_t threads =
+      static_cast<std::size_t>(std::max(1, config->getHttpThreadCount()));
+  std::size_t queued =
+      static_cast<std::size_t>(std::max(0, config->getMaxQueuedRequests()));
+  server->new_task_queue = [threads, queued]() {
+    return new httplib::ThreadPool(threads, queued);
+  };
 }
 
-SimilarHttpServer::~SimilarHttpServer() { stop(); }
+SimilarHttpServer::SimilarHttpServer(
+    IHtmlRequests *controller, IHtmlInitializationData *initData,
+    std::shared_ptr<StaticFileCache> staticFiles)
+    : controller(controller), initData(initData), running(false),
+      port(initData->getConfig()->getPort()),
+      stateStream(std::make_shared<StateStream>()),
+      streamClients(std::make_shared<std::atomic<int>>(0)),
+      startActive(true), pauseActive(false), abortActive(false),
+      staticFiles(std::move(staticFiles)) {}
 
-std::string SimilarHttpServer::getMimeType(const std::string &path) {
-  if (path.ends_with(".html"))
-    return "text/html";
-  if (path.ends_with(".css"))
-    return "text/css";
-  if (path.ends_with(".js"))
-    return "application/javascript";
-  if (path.ends_with(".json"))
-    return "application/json";
-  if (path.ends_with(".png"))
-    return "image/png";
-  if (path.ends_with(".jpg") || path.ends_with(".jpeg"))
-    return "image/jpeg";
-  if (path.ends_with(".gif"))
-    return "image/gif";
-  if (path.ends_with(".svg"))
-    return "image/svg+xml";
-  return "application/octet-stream";
-}
+SimilarHttpServer::~SimilarHttpServer() { stop(); }
 
-std::string SimilarHttpServer::loadStaticFile(const std::string &path) {
-  std::string fullPath = "extendedkernel/resources/web/" + path;
-  std::ifstream file(fullPath, std::ios::binary);
-  if (!file) {
-    return "";
-  }
-  std::stringstream buffer;
-  buffer << file.rdbuf();
-  return buffer.str();
+void SimilarHttpServer::publishControls() {
+  stateStream->publish(
+      "controls",
+      std::string("{\"start\":") + (startActive.load() ? "true" : "false") +
+          ",\"pause\":" + (pauseActive.load() ? "true" : "false") +
+          ",\"abort\":" + (abortActive.load() ? "true" : "false") + "}");
 }
 
 std::string SimilarHttpServer::generateHtmlPage() {
@@ -88,6 +85,9 @@ std::string SimilarHttpServer::generateHtmlPage() {
                     <button id="pauseBtn" class="btn btn-warning" onclick="pauseSimulation()">
                         &#9208; Pause
                     </button>
+                    <button id="stepBtn" class="btn btn-info" onclick="stepSimulation()">
+                        &#9197; Step
+                    </button>
                     <button id="stopBtn" class="btn btn-danger" onclick="stopSimulation()">
                         &#9209; Stop
                     </button>
@@ -98,6 +98,14 @@ std::string SimilarHttpServer::generateHtmlPage() {
                 
                 <div class="mt-3">
                     <strong>Status:</strong> <span id="status">IDLE</span>
+                    <strong class="ms-3">Step:</strong> <span id="step">-</span>
+                    <label class="ms-3" for="rate"><strong>Steps/s:</strong></label>
+                    <input id="rate" type="number" min="0" value="0" style="width: 6em"
+                           title="0 for no limit" onchange="setStepRate()">
+                    <label class="ms-3" for="rewind"><strong>Back to step:</strong></label>
+                    <input id="rewind" type="number" min="0" style="width: 6em"
+                           title="A recent step of the paused simulation"
+                           onchange="rewindSimulation()">
                 </div>
             </div>
         </div>
@@ -118,113 +126,227 @@ std::string SimilarHttpServer::generateHtmlPage() {
     <script src="/js/bootstrap.min.js"></script>
     <script src="/js/similar-gui.js"></script>
     <script>
-        // Poll for status updates
-        setInterval(function() {
-    $.get(
-        '/state',
-        function(data) { $('#status').text(new TextDecoder().decode(data)); });
-        }, 1000);
+        function updateStatus() {
+            $.get('state', function(data) { $('#status').text(data); });
+        }
+        if (window.EventSource) {
+            // Pushed by the server: the state is fetched when it changes
+            var events = new EventSource('events');
+            events.addEventListener('controls', function(event) {
+                var controls = JSON.parse(event.data);
+                $('#startBtn').prop('disabled', !controls.start);
+                $('#pauseBtn').prop('disabled', !controls.pause);
+                $('#stepBtn').prop('disabled', !controls.pause);
+                $('#stopBtn').prop('disabled', !controls.abort);
+                updateStatus();
+            });
+            events.addEventListener('state', function(event) {
+                $('#step').text(JSON.parse(event.data).step);
+            });
+            updateStatus();
+        } else {
+            setInterval(updateStatus, 1000);
+        }
     </script>
 </body>
 </html>)HTML";
 }
 
-void SimilarHttpServer::setupRoutes() {
-  // Main page
-  server->Get("/", [this](const httplib::Request &req, httplib::Response &res) {
+bool SimilarHttpServer::handleRequest(const std::string &action,
+                                      const httplib::Request &req,
+                                      httplib::Response &res) {
+  // The actions are relative to the page, so that a session server mounts
+  // the view under a path of its own
+  if (action.empty()) {
     res.set_content(generateHtmlPage(), "text/html");
-  });
-
-  // API endpoints
-  server->Get(
-      "/state", [this](const httplib::Request &req, httplib::Response &res) {
-        auto state = controller->handleSimulationStateRequest();
-        res.set_content(std::string(state.begin(), state.end()), "text/plain");
-      });
-
-  server->Get("/start",
-              [this](const httplib::Request &req, httplib::Response &res) {
-                controller->handleNewSimulationRequest();
-                res.set_content("OK", "text/plain");
-              });
-
-  server->Get("/stop",
-              [this](const httplib::Request &req, httplib::Response &res) {
-                controller->handleSimulationAbortionRequest();
-                res.set_content("OK", "text/plain");
-              });
+  } else if (action == "state") {
+    auto state = controller->handleSimulationStateRequest();
+    res.set_content(std::string(state.begin(), state.end()), "text/plain");
+  } else if (action == "start") {
+    controller->handleNewSimulationRequest();
+    res.set_content("OK", "text/plain");
+  } else if (action == "stop") {
+    controller->handleSimulationAbortionRequest();
+    res.set_content("OK", "text/plain");
+  } else if (action == "pause") {
+    controller->handleSimulationPauseRequest();
+    res.set_content("OK", "text/plain");
+  } else if (action == "step") {
+    controller->handleSimulationStepRequest();
+    res.set_content("OK", "text/plain");
+  } else if (action == "rate") {
+    try {
+      controller->handleStepRateRequest(std::stod(req.get_param_value("hz")));
+    } catch (const std::exception &e) {
+      res.status = 400;
+      res.set_content(e.what(), "text/plain");
+      return true;
+    }
+    res.set_content("OK", "text/plain");
+  } else if (action == "rewind") {
+    try {
+      controller->handleRewindRequest(std::stol(req.get_param_value("step")));
+    } catch (const std::exception &e) {
+      res.status = 400;
+      res.set_content(e.what(), "text/plain");
+      return true;
+    }
+    res.set_content("OK", "text/plain");
+  } else if (action == "shutdown") {
+    controller->handleShutDownRequest();
+    res.set_content("OK", "text/plain");
+  } else if (action == "setParameter") {
+    try {
+      for (const auto &param : req.params) {
+        controller->setParameter(param.first, param.second);
+      }
+    } catch (const std::exception &e) {
+      res.status = 400;
+      res.set_content(e.what(), "text/plain");
+      return true;
+    }
+    res.set_content("OK", "text/plain");
+  } else if (action == "getParameter") {
+    std::string result;
+    for (const auto &param : req.params) {
+      result +=
+          param.first + ": " + controller->getParameter(param.first) + "\n";
+    }
+    res.set_content(result, "text/plain");
+  } else if (action == "events") {
+    // Server-sent events, each stream holding a thread of the pool. The
+    // stream outlives the request: it only holds what it shares with the
+    // view, which a session server may close meanwhile.
+    int maxClients = initData->getConfig()->getMaxStreamClients();
+    if (streamClients->fetch_add(1) >= maxClients) {
+      streamClients->fetch_sub(1);
+      res.status = 503;
+      return true;
+    }
+    res.set_header("Cache-Control", "no-cache");
+    auto version = std::make_shared<std::uint64_t>(0);
+    res.set_chunked_content_provider(
+        "text/event-stream",
+        [stream = stateStream, version](std::size_t,
+                                        httplib::DataSink &sink) {
+          std::string text;
+          if (stream->waitForUpdate(*version, text, std::chrono::seconds(1))) {
+            return sink.write(text.data(), text.size());
+          }
+          if (stream->isClosed()) {
+            sink.done();
+            return true;
+          }
+          // A comment, which detects the closed connections
+          static const std::string ping = ": ping\n\n";
+          return sink.write(ping.data(), ping.size());
+        },
+        [clients = streamClients](bool) { clients->fetch_sub(1); });
+  } else if (action == "tiles") {
+    auto source = std::atomic_load(&tileSource);
+    if (!source) {
+      return false;
+    }
+    res.set_content(source->describeLayers(), "application/json");
+  } else if (action == "tile") {
+    serveTile(req, res);
+  } else if (action == "metrics") {
+    serveMetrics(req, res);
+  } else {
+    return false;
+  }
+  return true;
+}
 
-  server->Get("/pause",
-              [this](const httplib::Request &req, httplib::Response &res) {
-                controller->handleSimulationPauseRequest();
-                res.set_content("OK", "text/plain");
-              });
+void SimilarHttpServer::serveTile(const httplib::Request &req,
+                                  httplib::Response &res) {
+  auto source = std::atomic_load(&tileSource);
+  if (!source) {
+    res.status = 404;
+    return;
+  }
+  ITileSource::Tile tile;
+  try {
+    tile = source->getTile(req.get_param_value("layer"),
+                           std::stoi(req.get_param_value("z")),
+                           std::stoi(req.get_param_value("x")),
+                           std::stoi(req.get_param_value("y")));
+  } catch (const std::exception &e) {
+    res.status = 400;
+    res.set_content(e.what(), "text/plain");
+    return;
+  }
+  if (!tile.data) {
+    res.status = 404;
+    return;
+  }
+  // The browsers revalidate the tiles, which change with the simulation
+  const std::string etag = "\"" + std::to_string(tile.version) + "\"";
+  res.set_header("ETag", etag);
+  res.set_header("Cache-Control", "no-cache");
+  if (req.get_header_value("If-None-Match") == etag) {
+    res.status = 304;
+    return;
+  }
+  res.set_content(*tile.data, source->getMimeType());
+}
 
-  server->Get("/shutdown",
-              [this](const httplib::Request &req, httplib::Response &res) {
-                controller->handleShutDownRequest();
-                res.set_content("OK", "text/plain");
-              });
+void SimilarHttpServer::setTileSource(std::shared_ptr<ITileSource> source) {
+  std::atomic_store(&tileSource, std::move(source));
+}
 
-  server->Get("/setParameter",
-              [this](const httplib::Request &req, httplib::Response &res) {
-                for (const auto &param : req.params) {
-                  controller->setParameter(param.first, param.second);
-                }
-                res.set_content("OK", "text/plain");
-              });
+void SimilarHttpServer::serveMetrics(const httplib::Request &req,
+                                     httplib::Response &res) {
+  auto source = std::atomic_load(&metrics);
+  if (!source) {
+    res.status = 404;
+    return;
+  }
+  const bool openMetrics =
+      req.get_header_value("Accept").find("application/openmetrics-text") !=
+      std::string::npos;
+  res.set_header("Cache-Control", "no-store");
+  res.set_content(source->toText(openMetrics),
+                  microkernel::libs::SimulationMetrics::getContentType(
+                      openMetrics));
+}
 
-  server->Get("/getParameter",
-              [this](const httplib::Request &req, httplib::Response &res) {
-                std::string result;
-                for (const auto &param : req.params) {
-                  result += param.first + ": " +
-                            controller->getParameter(param.first) + "\n";
-                }
-                res.set_content(result, "text/plain");
-              });
+void SimilarHttpServer::setMetrics(
+    std::shared_ptr<microkernel::libs::SimulationMetrics> metrics) {
+  std::atomic_store(&this->metrics, std::move(metrics));
+}
 
-  // Static files
-  server->Get(R"(/css/(.+))",
-              [this](const httplib::Request &req, httplib::Response &res) {
-                std::string path = "css/" + req.matches[1].str();
-                std::string content = loadStaticFile(path);
-                if (!content.empty()) {
-                  res.set_content(content, getMimeType(path));
-                } else {
-                  res.status = 404;
-                }
-              });
+void SimilarHttpServer::setupRoutes() {
+  server->Get("/", [this](const httplib::Request &req, httplib::Response &res) {
+    handleRequest("", req, res);
+  });
 
-  server->Get(R"(/js/(.+))",
+  server->Get(R"(/([A-Za-z]+))",
               [this](const httplib::Request &req, httplib::Response &res) {
-                std::string path = "js/" + req.matches[1].str();
-                std::string content = loadStaticFile(path);
-                if (!content.empty()) {
-                  res.set_content(content, getMimeType(path));
-                } else {
+                if (!handleRequest(req.matches[1].str(), req, res)) {
                   res.status = 404;
                 }
               });
 
-  server->Get(R"(/img/(.+))",
+  // Static files
+  server->Get(R"(/((css|js|img)/.+))",
               [this](const httplib::Request &req, httplib::Response &res) {
-                std::string path = "img/" + req.matches[1].str();
-                std::string content = loadStaticFile(path);
-                if (!content.empty()) {
-                  res.set_content(content, getMimeType(path));
-                } else {
-                  res.status = 404;
-                }
+                staticFiles->serve(req.matches[1].str(), res);
               });
 }
 
 void SimilarHttpServer::initServer() {
-  setupRoutes();
-  std::cout << "HTTP server initialized on port " << port << std::endl;
+  publishControls();
+  if (server) {
+    setupRoutes();
+    std::cout << "HTTP server initialized on port " << port << std::endl;
+  }
 }
 
 void SimilarHttpServer::showView() {
+  if (!server) {
+    throw std::logic_error("A mounted view is served by its session server");
+  }
   // Start server in background thread
   running.store(true);
   std::thread serverThread([this]() {
@@ -258,8 +380,13 @@ void SimilarHttpServer::showView() {
 }
 
 void SimilarHttpServer::stop() {
+  if (!server) {
+    stateStream->close();
+    return;
+  }
   if (running.load()) {
     running.store(false);
+    stateStream->close();
     if (server) {
       server->stop();
     }
@@ -267,17 +394,20 @@ void SimilarHttpServer::stop() {
   }
 }
 
-// IHtmlControls implementation (button states managed by JavaScript)
+// IHtmlControls implementation, pushed to the pages on /events
 void SimilarHttpServer::setStartButtonState(bool active) {
-  // In web version, button states are managed client-side via JavaScript
+  startActive.store(active);
+  publishControls();
 }
 
 void SimilarHttpServer::setPauseButtonState(bool active) {
-  // In web version, button states are managed client-side via JavaScript
+  pauseActive.store(active);
+  publishControls();
 }
 
 void SimilarHttpServer::setAbortButtonState(bool active) {
-  // In web version, button states are managed client-side via JavaScript
+  abortActive.store(active);
+  publishControls();
 }
 
 void SimilarHttpServer::shutDownView() { stop(); }
@@ -0,0 +1,72 @@
+#include "libs/web/view/StateStream.h"
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace web {
+namespace view {
+
+void StateStream::publish(const std::string &event, const std::string &data) {
+  std::string text = "event: " + event + "\n";
+  std::size_t begin = 0;
+  while (true) {
+    std::size_t end = data.find('\n', begin);
+    text += "data: " + data.substr(begin, end - begin) + "\n";
+    if (end == std::string::npos) {
+      break;
+    }
+    begin = end + 1;
+  }
+  text += "\n";
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    Message &message = messages[event];
+    message.version = ++version;
+    message.text = std::move(text);
+  }
+  updated.notify_all();
+}
+
+bool StateStream::waitForUpdate(std::uint64_t &version, std::string &text,
+                                std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (!updated.wait_for(lock, timeout, [this, version]() {
+        return closed || this->version > version;
+      }) ||
+      closed) {
+    return false;
+  }
+  text.clear();
+  for (const auto &entry : messages) {
+    if (entry.second.version > version) {
+      text += entry.second.text;
+    }
+  }
+  version = this->version;
+  return true;
+}
+
+void StateStream::close() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+  }
+  updated.notify_all();
+}
+
+bool StateStream::isClosed() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return closed;
+}
+
+} // namespace view
+} // namespace web
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
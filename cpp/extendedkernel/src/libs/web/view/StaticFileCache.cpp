@@ -0,0 +1,75 @@
+#include "libs/web/view/StaticFileCache.h"
+#include "third_party/httplib.h"
+#include <fstream>
+#include <sstream>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace libs {
+namespace web {
+namespace view {
+
+StaticFileCache::StaticFileCache(std::string root) : root(std::move(root)) {}
+
+std::string StaticFileCache::getMimeType(const std::string &path) {
+  if (path.ends_with(".html"))
+    return "text/html";
+  if (path.ends_with(".css"))
+    return "text/css";
+  if (path.ends_with(".js"))
+    return "application/javascript";
+  if (path.ends_with(".json"))
+    return "application/json";
+  if (path.ends_with(".png"))
+    return "image/png";
+  if (path.ends_with(".jpg") || path.ends_with(".jpeg"))
+    return "image/jpeg";
+  if (path.ends_with(".gif"))
+    return "image/gif";
+  if (path.ends_with(".svg"))
+    return "image/svg+xml";
+  return "application/octet-stream";
+}
+
+std::shared_ptr<const std::string>
+StaticFileCache::load(const std::string &path) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto cached = files.find(path);
+    if (cached != files.end()) {
+      return cached->second;
+    }
+  }
+  // Outside the lock: the other files are still served meanwhile
+  std::ifstream file(root + path, std::ios::binary);
+  if (!file) {
+    return nullptr;
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  auto content = std::make_shared<const std::string>(buffer.str());
+  std::lock_guard<std::mutex> lock(mutex);
+  return files.emplace(path, std::move(content)).first->second;
+}
+
+void StaticFileCache::serve(const std::string &path, httplib::Response &res) {
+  auto content = load(path);
+  if (content && !content->empty()) {
+    res.set_content(*content, getMimeType(path));
+    res.set_header("Cache-Control", "max-age=3600");
+  } else {
+    res.status = 404;
+  }
+}
+
+} // namespace view
+} // namespace web
+} // namespace libs
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -0,0 +1,136 @@
+#include "simulationmodel/ParameterStore.h"
+#include <sstream>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace extendedkernel {
+namespace simulationmodel {
+
+namespace {
+
+struct TextParser {
+  const std::string &name;
+  const std::string &text;
+
+  [[noreturn]] void reject(const char *type) const {
+    throw std::invalid_argument("The parameter " + name + " expects " + type +
+                                ", not \"" + text + "\".");
+  }
+
+  ParameterStore::Value operator()(bool) const {
+    if (text == "true" || text == "1") {
+      return true;
+    }
+    if (text == "false" || text == "0") {
+      return false;
+    }
+    reject("true or false");
+  }
+
+  ParameterStore::Value operator()(std::int64_t) const {
+    std::size_t parsed = 0;
+    std::int64_t value = 0;
+    try {
+      value = std::stoll(text, &parsed);
+    } catch (const std::exception &) {
+      reject("an integer");
+    }
+    if (parsed != text.size()) {
+      reject("an integer");
+    }
+    return value;
+  }
+
+  ParameterStore::Value operator()(double) const {
+    std::size_t parsed = 0;
+    double value = 0.0;
+    try {
+      value = std::stod(text, &parsed);
+    } catch (const std::exception &) {
+      reject("a real");
+    }
+    if (parsed != text.size()) {
+      reject("a real");
+    }
+    return value;
+  }
+
+  ParameterStore::Value operator()(const std::string &) const { return text; }
+};
+
+struct TextFormatter {
+  std::string operator()(bool value) const { return value ? "true" : "false"; }
+  std::string operator()(std::int64_t value) const {
+    return std::to_string(value);
+  }
+  std::string operator()(double value) const {
+    std::ostringstream text;
+    text.precision(15);
+    text << value;
+    return text.str();
+  }
+  std::string operator()(const std::string &value) const { return value; }
+};
+
+} // namespace
+
+std::size_t ParameterStore::indexOf(const std::string &name) const {
+  auto it = indices.find(name);
+  if (it == indices.end()) {
+    throw std::invalid_argument("Unknown parameter: " + name);
+  }
+  return it->second;
+}
+
+void ParameterStore::set(const std::string &name, const std::string &text) {
+  std::lock_guard<std::mutex> lock(writerMutex);
+  Value &value = staged[indexOf(name)];
+  value = std::visit(TextParser{name, text}, value);
+  dirty.store(true, std::memory_order_release);
+}
+
+std::string ParameterStore::getText(const std::string &name) const {
+  std::lock_guard<std::mutex> lock(writerMutex);
+  return std::visit(TextFormatter{}, staged[indexOf(name)]);
+}
+
+bool ParameterStore::isDeclared(const std::string &name) const {
+  std::lock_guard<std::mutex> lock(writerMutex);
+  return indices.count(name) != 0;
+}
+
+std::vector<std::string> ParameterStore::getNames() const {
+  std::lock_guard<std::mutex> lock(writerMutex);
+  std::vector<std::string> names;
+  names.reserve(indices.size());
+  for (const auto &entry : indices) {
+    names.push_back(entry.first);
+  }
+  return names;
+}
+
+bool ParameterStore::commit() {
+  // Most steps have nothing to publish, and do not lock
+  if (!dirty.load(std::memory_order_acquire)) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(writerMutex);
+  dirty.store(false, std::memory_order_relaxed);
+  // The buffer not read since the previous commit: the agents read the
+  // other one during the step that just ended
+  std::vector<Value> &next =
+      published.load(std::memory_order_relaxed) == &buffers[0] ? buffers[1]
+                                                                : buffers[0];
+  next = staged;
+  published.store(&next, std::memory_order_release);
+  return true;
+}
+
+} // namespace simulationmodel
+} // namespace extendedkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
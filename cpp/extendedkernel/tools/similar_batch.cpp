@@ -0,0 +1,75 @@
+// The headless batch runner: runs the model of a plugin (see
+// microkernel/include/engine/ModelPlugin.h) with the engine, the threads,
+// the probes and the export of a configuration file (see
+// extendedkernel/include/libs/batch/BatchRunner.h), e.g. in a cluster job.
+//
+//   similar_batch run.json
+//   similar_batch run.json --threads 32 --arguments "seed=7" --quiet
+//
+// The options override the values of the file. Nothing is printed while the
+// model runs; a line sums the run up at its end, unless --quiet.
+
+#include "libs/batch/BatchRunner.h"
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace batch = fr::univ_artois::lgi2a::similar::extendedkernel::libs::batch;
+
+namespace {
+
+int usage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " config.json [--plugin library] [--arguments arguments]"
+               " [--engine multithreaded|sequential] [--threads n] [--quiet]"
+            << std::endl;
+  return 2;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    return usage(argv[0]);
+  }
+  try {
+    batch::BatchRunConfig config = batch::BatchRunConfig::load(argv[1]);
+    bool quiet = false;
+    for (int i = 2; i < argc; ++i) {
+      const std::string argument = argv[i];
+      const bool hasValue = i + 1 < argc;
+      if (argument == "--quiet") {
+        quiet = true;
+      } else if (argument == "--plugin" && hasValue) {
+        config.plugin = argv[++i];
+      } else if (argument == "--arguments" && hasValue) {
+        config.arguments = argv[++i];
+      } else if (argument == "--engine" && hasValue) {
+        const std::string engine = argv[++i];
+        if (engine == "multithreaded") {
+          config.engine = batch::BatchRunConfig::Engine::MULTITHREADED;
+        } else if (engine == "sequential") {
+          config.engine = batch::BatchRunConfig::Engine::SEQUENTIAL;
+        } else {
+          return usage(argv[0]);
+        }
+      } else if (argument == "--threads" && hasValue) {
+        config.threads = std::stoul(argv[++i]);
+      } else {
+        return usage(argv[0]);
+      }
+    }
+
+    const batch::BatchRunResult result = batch::runBatch(config);
+    if (!quiet) {
+      std::cout << config.plugin << ": " << result.finalTime - result.initialTime
+                << " steps in " << result.seconds << " s ("
+                << result.stepsPerSecond() << " steps/s)" << std::endl;
+    }
+  } catch (const std::exception &e) {
+    std::cerr << argv[0] << ": " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,461 @@
+// Microbenchmarks of the hot paths of JamFree, from 1k to 1M vehicles (or
+// cells): the IDM against its lookup table, the leader search of the lanes
+// against a linear scan, MOBIL, the LWR and CTM updates, the compute
+// backends, the parsing of the bundled OSM files and whole steps of the
+// AdaptiveSimulator, microscopic only or switching to macroscopic.
+//
+// Run with --benchmark_out=results.json --benchmark_out_format=json (or
+// build the jamfree_benchmarks_json target) to keep the numbers that the
+// documents quote.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../gpu/ComputeBackend.h"
+#include "../gpu/cpu/CpuCompute.h"
+#ifdef JAMFREE_HAS_CUDA
+#include "../gpu/cuda/CudaCompute.h"
+#endif
+#include "../hybrid/include/AdaptiveSimulator.h"
+#include "../kernel/include/model/Lane.h"
+#include "../kernel/include/model/Point2D.h"
+#include "../kernel/include/model/Road.h"
+#include "../kernel/include/model/Vehicle.h"
+#include "../macroscopic/include/CTM.h"
+#include "../macroscopic/include/LWR.h"
+#include "../macroscopic/include/MacroscopicBatch.h"
+#include "../microscopic/include/IDM.h"
+#include "../microscopic/include/IDMLookup.h"
+#include "../microscopic/include/MOBIL.h"
+#include "../realdata/include/OSMParser.h"
+
+namespace {
+
+namespace jfk = jamfree::kernel;
+namespace jfm = jamfree::microscopic;
+namespace jfma = jamfree::macroscopic;
+
+using jfk::model::Lane;
+using jfk::model::Vehicle;
+
+// The sizes of the benchmarks scaling with the vehicles: 1k to 1M
+void vehicleCounts(benchmark::internal::Benchmark *benchmark) {
+  benchmark->RangeMultiplier(10)->Range(1000, 1000000);
+}
+
+// Fills a lane with vehicles every spacing metres, of speeds from 20 to
+// 30 m/s; the vehicles do not own the lane, which owns them
+void fillLane(Lane &lane, std::size_t count, double spacing,
+              const std::string &prefix) {
+  for (std::size_t i = 0; i < count; ++i) {
+    auto vehicle = std::make_shared<Vehicle>(prefix + std::to_string(i));
+    vehicle->setLane(&lane);
+    vehicle->setLanePosition(static_cast<double>(i) * spacing);
+    vehicle->setSpeed(20.0 + static_cast<double>((i * 7) % 11));
+    lane.addVehicle(vehicle);
+  }
+}
+
+std::shared_ptr<Lane> makeLane(const std::string &id, int index,
+                               std::size_t count, double spacing) {
+  auto lane = std::make_shared<Lane>(
+      id, index, 3.5, static_cast<double>(count) * spacing + spacing);
+  fillLane(*lane, count, spacing, id + "_");
+  return lane;
+}
+
+// ---------------------------------------------------------------------------
+// Car following
+
+// The acceleration of every vehicle of a lane behind its leader, exact or
+// from the lookup table
+template <typename Model> void BM_CarFollowing(benchmark::State &state) {
+  const auto count = static_cast<std::size_t>(state.range(0));
+  const auto lane = makeLane("lane", 0, count, 25.0);
+  const auto &vehicles = lane->getVehicles();
+  const Model model(33.3, 1.5, 2.0, 1.0, 1.5, 4.0);
+  for (auto _ : state) {
+    double sum = 0.0;
+    for (std::size_t i = 0; i < count; ++i) {
+      const Vehicle *leader = i + 1 < count ? vehicles[i + 1].get() : nullptr;
+      sum += model.calculateAcceleration(*vehicles[i], leader);
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK_TEMPLATE(BM_CarFollowing, jfm::models::IDM)->Apply(vehicleCounts);
+BENCHMARK_TEMPLATE(BM_CarFollowing, jfm::models::IDMLookup)
+    ->Apply(vehicleCounts);
+
+// The batch of accelerations of IDM::computeAccelerations(), as the
+// adaptive simulator computes them
+void BM_CarFollowingBatch(benchmark::State &state) {
+  const auto count = static_cast<std::size_t>(state.range(0));
+  std::vector<double> speeds(count), gaps(count), dvs(count), out(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    speeds[i] = 20.0 + static_cast<double>((i * 7) % 11);
+    gaps[i] = i + 1 < count ? 20.0 : std::numeric_limits<double>::infinity();
+    dvs[i] = static_cast<double>((i * 3) % 5) - 2.0;
+  }
+  const jfm::models::IDM idm(33.3, 1.5, 2.0, 1.0, 1.5, 4.0);
+  for (auto _ : state) {
+    idm.computeAccelerations(speeds.data(), gaps.data(), dvs.data(),
+                             out.data(), count);
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_CarFollowingBatch)->Apply(vehicleCounts);
+
+// ---------------------------------------------------------------------------
+// Leader search
+
+// The vehicles whose leaders are searched, spread over the lane: as many
+// for both searches, the linear one being too slow to search for all
+std::vector<const Vehicle *> sampleVehicles(const Lane &lane) {
+  const auto &vehicles = lane.getVehicles();
+  const std::size_t samples = std::min<std::size_t>(vehicles.size(), 1024);
+  std::vector<const Vehicle *> sampled;
+  for (std::size_t i = 0; i < samples; ++i) {
+    sampled.push_back(vehicles[i * vehicles.size() / samples].get());
+  }
+  return sampled;
+}
+
+// Lane::getLeader(), a binary search of the sorted vehicles of the lane
+void BM_LeaderSpatialIndex(benchmark::State &state) {
+  const auto lane = makeLane("lane", 0, state.range(0), 25.0);
+  const auto sampled = sampleVehicles(*lane);
+  for (auto _ : state) {
+    for (const Vehicle *vehicle : sampled) {
+      benchmark::DoNotOptimize(lane->getLeader(*vehicle));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * sampled.size());
+}
+BENCHMARK(BM_LeaderSpatialIndex)->Apply(vehicleCounts);
+
+// The nearest vehicle ahead by a scan of all the vehicles of the lane
+void BM_LeaderLinearScan(benchmark::State &state) {
+  const auto lane = makeLane("lane", 0, state.range(0), 25.0);
+  const auto &vehicles = lane->getVehicles();
+  const auto sampled = sampleVehicles(*lane);
+  for (auto _ : state) {
+    for (const Vehicle *vehicle : sampled) {
+      const double position = vehicle->getLanePosition();
+      const Vehicle *leader = nullptr;
+      double nearest = std::numeric_limits<double>::infinity();
+      for (const auto &other : vehicles) {
+        const double ahead = other->getLanePosition() - position;
+        if (ahead > 0.0 && ahead < nearest) {
+          nearest = ahead;
+          leader = other.get();
+        }
+      }
+      benchmark::DoNotOptimize(leader);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * sampled.size());
+}
+// Up to 100k vehicles only: a run of 1M takes 15 s by iteration
+BENCHMARK(BM_LeaderLinearScan)->RangeMultiplier(10)->Range(1000, 100000);
+
+// ---------------------------------------------------------------------------
+// Lane changes
+
+// Three lanes sharing the vehicles, shifted so that they interleave
+struct ThreeLanes {
+  std::shared_ptr<Lane> lanes[3];
+
+  explicit ThreeLanes(std::size_t count) {
+    const std::size_t perLane = std::max<std::size_t>(1, count / 3);
+    for (int i = 0; i < 3; ++i) {
+      lanes[i] = std::make_shared<Lane>(
+          "lane" + std::to_string(i), i, 3.5,
+          static_cast<double>(perLane) * 30.0 + 30.0);
+      const auto &lane = lanes[i];
+      for (std::size_t k = 0; k < perLane; ++k) {
+        auto vehicle = std::make_shared<Vehicle>(lane->getId() + "_" +
+                                                 std::to_string(k));
+        vehicle->setLane(lane.get());
+        vehicle->setLanePosition(static_cast<double>(k) * 30.0 + i * 10.0);
+        vehicle->setSpeed(20.0 + static_cast<double>((k * 7 + i) % 11));
+        lane->addVehicle(vehicle);
+      }
+    }
+  }
+
+  std::size_t size() const {
+    return lanes[0]->getVehicles().size() * 3;
+  }
+};
+
+// MOBIL::decideLaneChange() for every vehicle, searching its neighbours
+void BM_MobilDecide(benchmark::State &state) {
+  const ThreeLanes road(state.range(0));
+  const jfm::models::MOBIL mobil;
+  const jfm::models::IDM idm;
+  for (auto _ : state) {
+    for (int i = 0; i < 3; ++i) {
+      const Lane *left = i > 0 ? road.lanes[i - 1].get() : nullptr;
+      const Lane *right = i < 2 ? road.lanes[i + 1].get() : nullptr;
+      for (const auto &vehicle : road.lanes[i]->getVehicles()) {
+        benchmark::DoNotOptimize(mobil.decideLaneChange(
+            *vehicle, *road.lanes[i], left, right, idm));
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * road.size());
+}
+BENCHMARK(BM_MobilDecide)->Apply(vehicleCounts);
+
+// MOBIL::evaluateLaneChanges() from every lane to its neighbours, walking
+// the sorted lanes together
+void BM_MobilEvaluateBatch(benchmark::State &state) {
+  const ThreeLanes road(state.range(0));
+  const jfm::models::MOBIL mobil;
+  const jfm::models::IDM idm;
+  std::vector<double> accels[3];
+  for (int i = 0; i < 3; ++i) {
+    const auto &vehicles = road.lanes[i]->getVehicles();
+    for (std::size_t k = 0; k < vehicles.size(); ++k) {
+      const Vehicle *leader =
+          k + 1 < vehicles.size() ? vehicles[k + 1].get() : nullptr;
+      accels[i].push_back(idm.calculateAcceleration(*vehicles[k], leader));
+    }
+  }
+  std::vector<double> advantages(road.lanes[0]->getVehicles().size());
+  std::int64_t evaluated = 0;
+  for (auto _ : state) {
+    for (int i = 0; i < 3; ++i) {
+      for (int target : {i - 1, i + 1}) {
+        if (target < 0 || target > 2) {
+          continue;
+        }
+        mobil.evaluateLaneChanges(*road.lanes[i], accels[i].data(),
+                                  *road.lanes[target], accels[target].data(),
+                                  idm, advantages.data());
+        benchmark::DoNotOptimize(advantages.data());
+        evaluated += static_cast<std::int64_t>(advantages.size());
+      }
+    }
+  }
+  state.SetItemsProcessed(evaluated);
+}
+BENCHMARK(BM_MobilEvaluateBatch)->Apply(vehicleCounts);
+
+// ---------------------------------------------------------------------------
+// Macroscopic models, by cells of 10 m half full
+
+void BM_LWRUpdate(benchmark::State &state) {
+  const int cells = static_cast<int>(state.range(0));
+  jfma::models::LWR lwr(33.3, 0.15, cells * 10.0, cells);
+  for (int i = 0; i < cells; ++i) {
+    lwr.setDensity(i, 0.02 + 0.1 * ((i * 7) % 10) / 10.0);
+  }
+  for (auto _ : state) {
+    lwr.update(0.1);
+  }
+  state.SetItemsProcessed(state.iterations() * cells);
+}
+BENCHMARK(BM_LWRUpdate)->Apply(vehicleCounts);
+
+void BM_CTMUpdate(benchmark::State &state) {
+  const int cells = static_cast<int>(state.range(0));
+  jfma::models::CTM ctm(33.3, 5.56, 0.15, cells * 10.0, cells);
+  for (int i = 0; i < cells; ++i) {
+    ctm.setNumVehicles(i, 0.2 + ((i * 7) % 10) / 10.0);
+  }
+  for (auto _ : state) {
+    ctm.update(0.1);
+  }
+  state.SetItemsProcessed(state.iterations() * cells);
+}
+BENCHMARK(BM_CTMUpdate)->Apply(vehicleCounts);
+
+// The same cells as links of 1 km in one batch, as the adaptive simulator
+// keeps its macroscopic lanes
+void BM_LWRBatchUpdate(benchmark::State &state) {
+  const int cells = static_cast<int>(state.range(0));
+  jfma::models::LWRBatch batch;
+  for (int first = 0; first < cells; first += 100) {
+    const std::size_t link = batch.addLink(33.3, 0.15, 1000.0, 100);
+    for (int i = 0; i < 100; ++i) {
+      batch.setDensity(link, i, 0.02 + 0.1 * (((first + i) * 7) % 10) / 10.0);
+    }
+  }
+  for (auto _ : state) {
+    batch.update(0.1);
+  }
+  state.SetItemsProcessed(state.iterations() * batch.getTotalCells());
+}
+BENCHMARK(BM_LWRBatchUpdate)->Apply(vehicleCounts);
+
+void BM_CTMBatchUpdate(benchmark::State &state) {
+  const int cells = static_cast<int>(state.range(0));
+  jfma::models::CTMBatch batch;
+  for (int first = 0; first < cells; first += 100) {
+    const std::size_t link = batch.addLink(33.3, 5.56, 0.15, 1000.0, 100);
+    for (int i = 0; i < 100; ++i) {
+      batch.setNumVehicles(link, i, 0.2 + (((first + i) * 7) % 10) / 10.0);
+    }
+  }
+  for (auto _ : state) {
+    batch.update(0.1);
+  }
+  state.SetItemsProcessed(state.iterations() * batch.getTotalCells());
+}
+BENCHMARK(BM_CTMBatchUpdate)->Apply(vehicleCounts);
+
+// ---------------------------------------------------------------------------
+// Compute backends
+
+// IComputeBackend::simulationStep() on lanes of 1000 vehicles: gaps, IDM
+// accelerations and positions
+template <typename Backend> void BM_BackendStep(benchmark::State &state) {
+  if (!Backend::isAvailable()) {
+    state.SkipWithError("backend not available");
+    return;
+  }
+  const auto count = static_cast<std::size_t>(state.range(0));
+  std::vector<std::shared_ptr<Lane>> lanes;
+  std::vector<std::shared_ptr<Vehicle>> vehicles;
+  for (std::size_t first = 0; first < count; first += 1000) {
+    lanes.push_back(makeLane("lane" + std::to_string(lanes.size()),
+                             0, std::min<std::size_t>(1000, count - first),
+                             25.0));
+    const auto &laneVehicles = lanes.back()->getVehicles();
+    vehicles.insert(vehicles.end(), laneVehicles.begin(), laneVehicles.end());
+  }
+  Backend backend;
+  if (!backend.initialize("")) {
+    state.SkipWithError("backend not initialized");
+    return;
+  }
+  backend.uploadVehicles(vehicles);
+  backend.setIDMParams(33.3, 1.5, 2.0, 1.0, 1.5, 4.0);
+  for (auto _ : state) {
+    backend.simulationStep(count, 0.1);
+  }
+  // The step of the last iteration, which the GPUs may still be running
+  backend.requestSnapshot(count);
+  benchmark::DoNotOptimize(backend.getSnapshot());
+  state.SetItemsProcessed(state.iterations() * count);
+  state.SetLabel(backend.getDeviceName());
+}
+BENCHMARK_TEMPLATE(BM_BackendStep, jamfree::gpu::cpu::CpuCompute)
+    ->Apply(vehicleCounts);
+#ifdef JAMFREE_HAS_CUDA
+BENCHMARK_TEMPLATE(BM_BackendStep, jamfree::gpu::cuda::CudaCompute)
+    ->Apply(vehicleCounts);
+#endif
+
+// ---------------------------------------------------------------------------
+// End to end
+
+// Roads of 2 km and 3 lanes, dense ones (100 vehicles by lane and km)
+// alternating with sparse ones (15), updated by the adaptive simulator:
+// every lane microscopic, or the dense ones switching to macroscopic
+void adaptiveSteps(benchmark::State &state, bool adaptive) {
+  const auto count = static_cast<std::size_t>(state.range(0));
+  std::vector<std::shared_ptr<jfk::model::Road>> roads;
+  jamfree::hybrid::AdaptiveSimulator simulator;
+  std::size_t placed = 0;
+  while (placed < count) {
+    const bool dense = roads.size() % 2 == 0;
+    const double y = static_cast<double>(roads.size()) * 20.0;
+    roads.push_back(std::make_shared<jfk::model::Road>(
+        "road" + std::to_string(roads.size()), jfk::model::Point2D(0.0, y),
+        jfk::model::Point2D(2000.0, y), 3, 3.5));
+    for (int i = 0; i < 3 && placed < count; ++i) {
+      const auto lane = roads.back()->getLane(i);
+      const std::size_t onLane =
+          std::min<std::size_t>(dense ? 200 : 30, count - placed);
+      fillLane(*lane, onLane, dense ? 10.0 : 60.0, lane->getId() + "_");
+      placed += onLane;
+      simulator.registerLane(lane);
+      if (!adaptive) {
+        simulator.forceMicroscopic(lane->getId());
+      }
+    }
+  }
+  const jfm::models::IDM idm;
+  // The lanes keep their first mode for 30 steps, then the dense ones switch
+  for (int step = 0; step < 40; ++step) {
+    simulator.update(0.1, idm);
+  }
+  for (auto _ : state) {
+    simulator.update(0.1, idm);
+  }
+  const auto statistics = simulator.getStatistics();
+  state.SetItemsProcessed(state.iterations() * count);
+  state.counters["micro_lanes"] = statistics.micro_lanes;
+  state.counters["macro_lanes"] = statistics.macro_lanes;
+}
+
+void BM_EndToEndMicro(benchmark::State &state) { adaptiveSteps(state, false); }
+BENCHMARK(BM_EndToEndMicro)->Apply(vehicleCounts)->Unit(benchmark::kMillisecond);
+
+void BM_EndToEndAdaptive(benchmark::State &state) {
+  adaptiveSteps(state, true);
+}
+BENCHMARK(BM_EndToEndAdaptive)
+    ->Apply(vehicleCounts)
+    ->Unit(benchmark::kMillisecond);
+
+// ---------------------------------------------------------------------------
+// OSM parsing, registered by main() for each bundled file
+
+void parseOsmFile(benchmark::State &state, const std::string &path) {
+  std::size_t roads = 0;
+  for (auto _ : state) {
+    const auto network = jamfree::realdata::osm::OSMParser::parseFile(path);
+    roads = network.roads.size();
+    benchmark::DoNotOptimize(roads);
+  }
+  state.SetBytesProcessed(
+      state.iterations() *
+      static_cast<std::int64_t>(std::filesystem::file_size(path)));
+  state.counters["roads"] = static_cast<double>(roads);
+}
+
+void registerOsmBenchmarks() {
+  std::vector<std::filesystem::path> files;
+  std::error_code error;
+  for (const auto &entry :
+       std::filesystem::directory_iterator(JAMFREE_UPLOADS_DIR, error)) {
+    if (entry.path().extension() == ".osm") {
+      files.push_back(entry.path());
+    }
+  }
+  std::sort(files.begin(), files.end());
+  for (const auto &file : files) {
+    benchmark::RegisterBenchmark(
+        ("BM_OSMParseFile/" + file.filename().string()).c_str(),
+        parseOsmFile, file.string())
+        ->Unit(benchmark::kMillisecond);
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  registerOsmBenchmarks();
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
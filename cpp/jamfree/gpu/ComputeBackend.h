@@ -0,0 +1,492 @@
+#ifndef JAMFREE_GPU_COMPUTE_BACKEND_H
+#define JAMFREE_GPU_COMPUTE_BACKEND_H
+
+#include "../kernel/include/model/Vehicle.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace jamfree {
+namespace gpu {
+
+/**
+ * @brief Vehicle state for GPU processing.
+ */
+struct GPUVehicleState {
+  /**
+   * @brief leader_index of a slot without vehicle, which keeps still.
+   */
+  static constexpr int IDLE = -2;
+
+  float position;
+  float speed;
+  float acceleration;
+  int leader_index; ///< Slot of the leader, -1 if none
+  float gap;
+  float relative_speed;
+  int lane; ///< Lane, -1 if none
+};
+
+/**
+ * @brief State to write to a slot of the device, for a spawn or a despawn.
+ */
+struct GPUVehicleWrite {
+  std::uint32_t index;
+  GPUVehicleState state;
+};
+
+/**
+ * @brief Leader to write to a slot of the device, for a lane change.
+ */
+struct GPULeaderWrite {
+  std::uint32_t index;
+  int leader_index;
+};
+
+/**
+ * @brief Lane to write to a slot of the device, for a lane change.
+ */
+struct GPULaneWrite {
+  std::uint32_t index;
+  int lane;
+};
+
+/**
+ * @brief Neighbours of a vehicle, as slots, -1 if none.
+ *
+ * The leaders of the adjacent lanes are the first vehicles at or ahead of
+ * the position of the vehicle, the followers the last ones behind: the
+ * vehicles MOBIL weighs a lane change against.
+ */
+struct GPUNeighbours {
+  int follower_index;
+  int left_leader;
+  int left_follower;
+  int right_leader;
+  int right_follower;
+};
+
+/**
+ * @brief IDM parameters for GPU.
+ */
+struct GPUIDMParams {
+  float desired_speed;
+  float time_headway;
+  float min_gap;
+  float max_accel;
+  float comfortable_decel;
+  float accel_exponent;
+};
+
+/**
+ * @brief A small scenario of an ensemble, stepped with the others on the
+ * device (see IComputeBackend::uploadScenarios()).
+ */
+struct GPUScenario {
+  /// Vehicles, as IComputeBackend::uploadVehicles() takes them
+  std::vector<std::shared_ptr<kernel::model::Vehicle>> vehicles;
+  /// IDM parameters of the vehicles of the scenario
+  GPUIDMParams params;
+};
+
+/**
+ * @brief Where the scenarios of an ensemble lie on the device.
+ *
+ * The scenario i holds the slots [first_slot[i], first_slot[i + 1]) and the
+ * lanes [first_lane[i], first_lane[i + 1]), for setLaneNeighbours().
+ */
+struct GPUEnsembleLayout {
+  std::vector<std::uint32_t> first_slot;
+  std::vector<int> first_lane;
+
+  size_t numScenarios() const {
+    return first_slot.empty() ? 0 : first_slot.size() - 1;
+  }
+  size_t numSlots() const {
+    return first_slot.empty() ? 0 : first_slot.back();
+  }
+};
+
+/**
+ * @brief Compute engine for traffic simulation, whatever the device.
+ *
+ * The vehicles are uploaded once, stepped on the device by the kernels,
+ * then downloaded. All the backends run the same single-precision kernels:
+ * - calculateGaps(): the gap to the leader, minus a vehicle length of 5 m,
+ *   and the speed difference with it, 1000 m and 0 without leader;
+ * - computeIDMAccelerations(): the IDM acceleration, the one behind a
+ *   leader clamped to [-10, 5] m/s², zero for an idle slot;
+ * - updatePositions(): the speed, not negative, then the position;
+ * - updateLWR(): one Godunov step of a periodic LWR road, the flux being
+ *   the demand upstream against the supply downstream.
+ *
+ * The vehicle states may also stay on the device across the steps, in
+ * slots: after uploadVehicles() or resizeVehicles(), each step only sends
+ * the spawns and despawns by writeVehicles() and the lane changes by
+ * writeLanes(), or their new leaders by writeLeaders(), and the host reads
+ * the states back when it needs them, for example to draw them, by a
+ * snapshot that the device copies while the host goes on. sortVehicles()
+ * derives the leaders, and the neighbours a lane change looks at, on the
+ * device, by sorting the slots by lane and position.
+ *
+ * An ensemble of small independent scenarios, e.g. the corridors of a
+ * sensitivity analysis differing only by their parameters, is packed into
+ * the slots by uploadScenarios(): the scenarios are consecutive, with lanes
+ * and leaders of their own, and a table of IDM parameters by scenario, so
+ * that each step of the kernels advances all of them at once and the small
+ * scenarios fill the device together.
+ */
+class IComputeBackend {
+public:
+  virtual ~IComputeBackend() = default;
+
+  /**
+   * @brief Initialize the device and the kernels.
+   *
+   * @param shader_path Path to compiled kernels, if the backend loads them;
+   *                    empty for the built-in ones
+   * @return True if initialization successful
+   */
+  virtual bool initialize(const std::string &shader_path) = 0;
+
+  /**
+   * @brief Upload vehicle states to the device.
+   *
+   * The vehicles of a lane are to be consecutive, in the order of their
+   * lane positions as Lane::getVehicles() gives them: the leader of a
+   * vehicle is the next one, if on the same lane. Each vehicle gets the
+   * slot of its index, and the lanes are numbered from 0 in the order they
+   * come, the vehicles without lane on none.
+   *
+   * @param vehicles Vector of vehicles
+   */
+  virtual void uploadVehicles(
+      const std::vector<std::shared_ptr<kernel::model::Vehicle>> &vehicles) = 0;
+
+  /**
+   * @brief Download vehicle states from the device.
+   *
+   * @param vehicles Vector of vehicles to update, as uploaded
+   */
+  virtual void downloadVehicles(
+      std::vector<std::shared_ptr<kernel::model::Vehicle>> &vehicles) = 0;
+
+  /**
+   * @brief Set the number of vehicle slots of the device.
+   *
+   * The states of the slots kept are left on the device; the new slots are
+   * idle, with GPUVehicleState::IDLE as leader and a zero speed.
+   *
+   * @param num_vehicles Number of slots
+   */
+  virtual void resizeVehicles(size_t num_vehicles) = 0;
+
+  /**
+   * @brief Write the states of some slots of the device.
+   *
+   * A despawn writes an idle state; the followers of a slot changed are to
+   * be given their new leader by writeLeaders().
+   *
+   * @param writes Slot and state of each write
+   * @param count Number of writes
+   * @throws std::out_of_range If a slot is beyond the number of slots
+   */
+  virtual void writeVehicles(const GPUVehicleWrite *writes, size_t count) = 0;
+
+  /**
+   * @brief Write the leaders of some slots of the device.
+   *
+   * @param writes Slot and leader of each write
+   * @param count Number of writes
+   * @throws std::out_of_range If a slot is beyond the number of slots
+   */
+  virtual void writeLeaders(const GPULeaderWrite *writes, size_t count) = 0;
+
+  /**
+   * @brief Write the lanes of some slots of the device.
+   *
+   * The leaders are the ones of the previous lanes until sortVehicles().
+   *
+   * @param writes Slot and lane of each write
+   * @param count Number of writes
+   * @throws std::out_of_range If a slot is beyond the number of slots
+   */
+  virtual void writeLanes(const GPULaneWrite *writes, size_t count) = 0;
+
+  /**
+   * @brief Set the adjacent lanes of each lane, for the neighbours.
+   *
+   * @param left Lane on the left of each lane, -1 if none
+   * @param right Lane on the right of each lane, -1 if none
+   * @throws std::invalid_argument If the two are not of the same size
+   */
+  virtual void setLaneNeighbours(const std::vector<int> &left,
+                                 const std::vector<int> &right) = 0;
+
+  /**
+   * @brief Derive the leaders and the neighbours of the slots on the device.
+   *
+   * The slots of a lane are sorted by position, then by slot, with a radix
+   * or bitonic sort of the keys (lane, position): the leader of a vehicle
+   * is the next one of its lane, its follower the previous one, and the
+   * leader and the follower on an adjacent lane a binary search away. The
+   * idle slots and the ones without lane keep their leader.
+   *
+   * @param num_vehicles Number of slots, from the first
+   */
+  virtual void sortVehicles(size_t num_vehicles) = 0;
+
+  /**
+   * @brief Download the neighbours of the last sortVehicles().
+   *
+   * @param neighbours Set to the neighbours of each slot sorted
+   */
+  virtual void downloadNeighbours(std::vector<GPUNeighbours> &neighbours) = 0;
+
+  /**
+   * @brief Start copying the states of the slots to the host.
+   *
+   * The copy runs after the steps already submitted, while the host goes
+   * on; it goes to the one of the two snapshot buffers that
+   * getSnapshot() does not return.
+   *
+   * @param num_vehicles Number of slots to copy, from the first
+   */
+  virtual void requestSnapshot(size_t num_vehicles) = 0;
+
+  /**
+   * @brief Get the states of the last snapshot requested.
+   *
+   * Waits for its copy if it is not done yet. The states stay valid until
+   * the second next requestSnapshot().
+   *
+   * @return The states of the slots copied, null if none was requested
+   */
+  virtual const GPUVehicleState *getSnapshot() = 0;
+
+  /**
+   * @brief Set IDM parameters.
+   *
+   * @param desired_speed Desired speed (m/s)
+   * @param time_headway Time headway (s)
+   * @param min_gap Minimum gap (m)
+   * @param max_accel Maximum acceleration (m/s²)
+   * @param comfortable_decel Comfortable deceleration (m/s²)
+   * @param accel_exponent Acceleration exponent
+   */
+  virtual void setIDMParams(double desired_speed, double time_headway,
+                            double min_gap, double max_accel,
+                            double comfortable_decel,
+                            double accel_exponent) = 0;
+
+  /**
+   * @brief Set IDM parameters by scenario, for an ensemble.
+   *
+   * Until the next setIDMParams(), computeIDMAccelerations() gives the slot
+   * i the parameters of the scenario slot_scenarios[i], the slots beyond
+   * the ones of setIDMParams().
+   *
+   * @param params Parameters of each scenario
+   * @param slot_scenarios Scenario of each slot, from the first
+   * @throws std::invalid_argument If a slot has no scenario of params
+   */
+  virtual void setScenarioParams(
+      const std::vector<GPUIDMParams> &params,
+      const std::vector<std::uint32_t> &slot_scenarios) = 0;
+
+  /**
+   * @brief Upload an ensemble of scenarios, in place of the vehicles.
+   *
+   * The slots of a scenario follow the ones of the previous scenario, its
+   * vehicles in the order uploadVehicles() takes them, and its lanes are
+   * numbered after the ones of the previous scenario, so that no leader
+   * and no neighbour is taken from another scenario. simulationStep() and
+   * sortVehicles() over layout.numSlots() slots then step the ensemble.
+   *
+   * @param scenarios Scenarios of the ensemble
+   * @return Where the scenarios lie on the device
+   */
+  GPUEnsembleLayout uploadScenarios(const std::vector<GPUScenario> &scenarios) {
+    GPUEnsembleLayout layout;
+    layout.first_slot.reserve(scenarios.size() + 1);
+    layout.first_lane.reserve(scenarios.size() + 1);
+    std::vector<GPUVehicleWrite> writes;
+    std::vector<GPUVehicleState> states;
+    std::vector<GPUIDMParams> params;
+    std::vector<std::uint32_t> slot_scenarios;
+    std::uint32_t slot = 0;
+    int lane = 0;
+    for (const GPUScenario &scenario : scenarios) {
+      layout.first_slot.push_back(slot);
+      layout.first_lane.push_back(lane);
+      states.resize(scenario.vehicles.size());
+      packVehicles(scenario.vehicles, states.data());
+      int lanes = 0;
+      for (GPUVehicleState &state : states) {
+        if (state.leader_index >= 0) {
+          state.leader_index += static_cast<int>(slot);
+        }
+        if (state.lane >= 0) {
+          lanes = std::max(lanes, state.lane + 1);
+          state.lane += lane;
+        }
+        writes.push_back(GPUVehicleWrite{slot++, state});
+        slot_scenarios.push_back(static_cast<std::uint32_t>(params.size()));
+      }
+      params.push_back(scenario.params);
+      lane += lanes;
+    }
+    layout.first_slot.push_back(slot);
+    layout.first_lane.push_back(lane);
+    resizeVehicles(0);
+    resizeVehicles(slot);
+    writeVehicles(writes.data(), writes.size());
+    setScenarioParams(params, slot_scenarios);
+    return layout;
+  }
+
+  /**
+   * @brief Download the vehicles of an ensemble, as downloadVehicles().
+   *
+   * @param scenarios Scenarios to update, as uploaded
+   * @param layout Layout given by uploadScenarios()
+   * @throws std::invalid_argument If the scenarios are not the ones of the
+   * layout
+   */
+  void downloadScenarios(std::vector<GPUScenario> &scenarios,
+                         const GPUEnsembleLayout &layout) {
+    if (scenarios.size() != layout.numScenarios()) {
+      throw std::invalid_argument(
+          "The scenarios are not the ones of the ensemble");
+    }
+    requestSnapshot(layout.numSlots());
+    const GPUVehicleState *states = getSnapshot();
+    for (size_t i = 0; i < scenarios.size(); ++i) {
+      auto &vehicles = scenarios[i].vehicles;
+      const std::uint32_t first = layout.first_slot[i];
+      if (vehicles.size() != layout.first_slot[i + 1] - first) {
+        throw std::invalid_argument(
+            "The scenarios are not the ones of the ensemble");
+      }
+      for (size_t v = 0; v < vehicles.size(); ++v) {
+        vehicles[v]->setLanePosition(states[first + v].position);
+        vehicles[v]->setSpeed(states[first + v].speed);
+      }
+    }
+  }
+
+  /**
+   * @brief Compute IDM accelerations on the device.
+   *
+   * @param num_vehicles Number of vehicles
+   */
+  virtual void computeIDMAccelerations(size_t num_vehicles) = 0;
+
+  /**
+   * @brief Update vehicle positions on the device.
+   *
+   * @param num_vehicles Number of vehicles
+   * @param dt Time step (s)
+   */
+  virtual void updatePositions(size_t num_vehicles, double dt) = 0;
+
+  /**
+   * @brief Calculate gaps and relative speeds on the device.
+   *
+   * @param num_vehicles Number of vehicles
+   */
+  virtual void calculateGaps(size_t num_vehicles) = 0;
+
+  /**
+   * @brief Run complete simulation step on the device.
+   *
+   * Combines gap calculation, IDM acceleration, and position update.
+   *
+   * @param num_vehicles Number of vehicles
+   * @param dt Time step (s)
+   */
+  virtual void simulationStep(size_t num_vehicles, double dt) {
+    calculateGaps(num_vehicles);
+    computeIDMAccelerations(num_vehicles);
+    updatePositions(num_vehicles, dt);
+  }
+
+  /**
+   * @brief Update LWR macroscopic model on the device.
+   *
+   * @param density Input density array
+   * @param density_new Output density array
+   * @param num_cells Number of cells
+   * @param dt Time step
+   * @param dx Cell length
+   * @param free_flow_speed Free-flow speed
+   * @param jam_density Jam density
+   */
+  virtual void updateLWR(const std::vector<double> &density,
+                         std::vector<double> &density_new, size_t num_cells,
+                         double dt, double dx, double free_flow_speed,
+                         double jam_density) = 0;
+
+  /**
+   * @brief Get device name.
+   *
+   * @return Device name string
+   */
+  virtual std::string getDeviceName() const = 0;
+
+  /**
+   * @brief Get the state of a slot without vehicle.
+   */
+  static GPUVehicleState idleVehicle() {
+    return GPUVehicleState{0.0f, 0.0f, 0.0f, GPUVehicleState::IDLE, 0.0f,
+                           0.0f, -1};
+  }
+
+protected:
+  /**
+   * @brief Fill the device states of vehicles, their leaders included.
+   *
+   * @param vehicles Vehicles, as uploadVehicles() takes them
+   * @param states Set to one state by vehicle
+   */
+  static void packVehicles(
+      const std::vector<std::shared_ptr<kernel::model::Vehicle>> &vehicles,
+      GPUVehicleState *states) {
+    int lane = -1;
+    for (size_t i = 0; i < vehicles.size(); ++i) {
+      const auto &vehicle = *vehicles[i];
+      if (!vehicle.getCurrentLane()) {
+        states[i].lane = -1;
+      } else {
+        if (i == 0 ||
+            vehicles[i - 1]->getCurrentLane() != vehicle.getCurrentLane()) {
+          ++lane;
+        }
+        states[i].lane = lane;
+      }
+      states[i].position = static_cast<float>(vehicle.getLanePosition());
+      states[i].speed = static_cast<float>(vehicle.getSpeed());
+      states[i].acceleration = 0.0f;
+      states[i].leader_index = -1;
+      states[i].gap = 0.0f;
+      states[i].relative_speed = 0.0f;
+      if (i + 1 < vehicles.size()) {
+        const auto &next = *vehicles[i + 1];
+        if (vehicle.getCurrentLane() &&
+            next.getCurrentLane() == vehicle.getCurrentLane() &&
+            next.getLanePosition() >= vehicle.getLanePosition()) {
+          states[i].leader_index = static_cast<int>(i + 1);
+        }
+      }
+    }
+  }
+};
+
+} // namespace gpu
+} // namespace jamfree
+
+#endif // JAMFREE_GPU_COMPUTE_BACKEND_H
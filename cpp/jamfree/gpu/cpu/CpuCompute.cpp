@@ -0,0 +1,281 @@
+#include "CpuCompute.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace jamfree {
+namespace gpu {
+namespace cpu {
+
+namespace {
+
+// As the LWR kernel of the device backends
+float lwrFlow(float rho, float v_f, float rho_j) {
+  const float speed = rho >= rho_j ? 0.0f : v_f * (1.0f - rho / rho_j);
+  return rho * speed;
+}
+
+// The demand upstream against the supply downstream
+float lwrFlux(float rho_l, float rho_r, float v_f, float rho_j) {
+  const float rho_c = rho_j / 2.0f;
+  return std::min(lwrFlow(std::min(rho_l, rho_c), v_f, rho_j),
+                  lwrFlow(std::max(rho_r, rho_c), v_f, rho_j));
+}
+
+void checkSlot(std::uint32_t index, size_t num_vehicles) {
+  if (index >= num_vehicles) {
+    throw std::out_of_range("Vehicle slot " + std::to_string(index) +
+                            " out of the " + std::to_string(num_vehicles) +
+                            " slots");
+  }
+}
+
+// The key of the sort by lane, as the device backends: the lane, the ones
+// without last, then the bits of the position, flipped to order as floats
+std::uint64_t laneKey(int lane, float position) {
+  std::uint32_t bits;
+  std::memcpy(&bits, &position, sizeof(bits));
+  bits = (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+  return static_cast<std::uint64_t>(static_cast<std::uint32_t>(lane)) << 32 |
+         bits;
+}
+
+int laneOf(std::uint64_t key) {
+  return static_cast<int>(static_cast<std::uint32_t>(key >> 32));
+}
+
+} // namespace
+
+// The defaults of the IDM
+CpuCompute::CpuCompute() : m_params{33.3f, 1.5f, 2.0f, 1.0f, 1.5f, 4.0f} {}
+
+bool CpuCompute::initialize(const std::string &) { return true; }
+
+void CpuCompute::uploadVehicles(
+    const std::vector<std::shared_ptr<kernel::model::Vehicle>> &vehicles) {
+  m_vehicles.resize(vehicles.size());
+  packVehicles(vehicles, m_vehicles.data());
+}
+
+void CpuCompute::downloadVehicles(
+    std::vector<std::shared_ptr<kernel::model::Vehicle>> &vehicles) {
+  const size_t count = std::min(vehicles.size(), m_vehicles.size());
+  for (size_t i = 0; i < count; ++i) {
+    vehicles[i]->setLanePosition(m_vehicles[i].position);
+    vehicles[i]->setSpeed(m_vehicles[i].speed);
+  }
+}
+
+void CpuCompute::resizeVehicles(size_t num_vehicles) {
+  m_vehicles.resize(num_vehicles, idleVehicle());
+}
+
+void CpuCompute::writeVehicles(const GPUVehicleWrite *writes, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    checkSlot(writes[i].index, m_vehicles.size());
+    m_vehicles[writes[i].index] = writes[i].state;
+  }
+}
+
+void CpuCompute::writeLeaders(const GPULeaderWrite *writes, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    checkSlot(writes[i].index, m_vehicles.size());
+    m_vehicles[writes[i].index].leader_index = writes[i].leader_index;
+  }
+}
+
+void CpuCompute::writeLanes(const GPULaneWrite *writes, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    checkSlot(writes[i].index, m_vehicles.size());
+    m_vehicles[writes[i].index].lane = writes[i].lane;
+  }
+}
+
+void CpuCompute::setLaneNeighbours(const std::vector<int> &left,
+                                   const std::vector<int> &right) {
+  if (left.size() != right.size()) {
+    throw std::invalid_argument(
+        "Lane neighbours: one left and one right lane by lane");
+  }
+  m_left_lanes = left;
+  m_right_lanes = right;
+}
+
+void CpuCompute::sortVehicles(size_t num_vehicles) {
+  num_vehicles = std::min(num_vehicles, m_vehicles.size());
+  m_sorted.resize(num_vehicles);
+  for (size_t i = 0; i < num_vehicles; ++i) {
+    const GPUVehicleState &vehicle = m_vehicles[i];
+    const int lane =
+        vehicle.leader_index == GPUVehicleState::IDLE ? -1 : vehicle.lane;
+    m_sorted[i] = {laneKey(lane, vehicle.position),
+                   static_cast<std::uint32_t>(i)};
+  }
+  std::sort(m_sorted.begin(), m_sorted.end());
+
+  // The slot at a position of the sort if on a lane, -1 otherwise
+  const auto slotOn = [this](size_t k, int lane) {
+    return k < m_sorted.size() && laneOf(m_sorted[k].first) == lane
+               ? static_cast<int>(m_sorted[k].second)
+               : -1;
+  };
+  const auto neighboursOn = [&](int lane, float position, int &leader,
+                                int &follower) {
+    leader = follower = -1;
+    if (lane < 0) {
+      return;
+    }
+    const auto found = std::lower_bound(
+        m_sorted.begin(), m_sorted.end(),
+        std::make_pair(laneKey(lane, position), std::uint32_t(0)));
+    const size_t k = static_cast<size_t>(found - m_sorted.begin());
+    leader = slotOn(k, lane);
+    follower = k > 0 ? slotOn(k - 1, lane) : -1;
+  };
+  m_neighbours.assign(num_vehicles, GPUNeighbours{-1, -1, -1, -1, -1});
+  const int num_lanes = static_cast<int>(m_left_lanes.size());
+  for (size_t k = 0; k < num_vehicles; ++k) {
+    const int lane = laneOf(m_sorted[k].first);
+    if (lane < 0) {
+      break; // The idle slots and the ones without lane, last
+    }
+    const std::uint32_t slot = m_sorted[k].second;
+    GPUVehicleState &vehicle = m_vehicles[slot];
+    GPUNeighbours &neighbours = m_neighbours[slot];
+    vehicle.leader_index = slotOn(k + 1, lane);
+    neighbours.follower_index = k > 0 ? slotOn(k - 1, lane) : -1;
+    if (lane < num_lanes) {
+      neighboursOn(m_left_lanes[lane], vehicle.position,
+                   neighbours.left_leader, neighbours.left_follower);
+      neighboursOn(m_right_lanes[lane], vehicle.position,
+                   neighbours.right_leader, neighbours.right_follower);
+    }
+  }
+}
+
+void CpuCompute::downloadNeighbours(std::vector<GPUNeighbours> &neighbours) {
+  neighbours = m_neighbours;
+}
+
+void CpuCompute::requestSnapshot(size_t num_vehicles) {
+  m_snapshot = m_snapshot == 0 ? 1 : 0;
+  num_vehicles = std::min(num_vehicles, m_vehicles.size());
+  m_snapshots[m_snapshot].assign(m_vehicles.begin(),
+                                 m_vehicles.begin() + num_vehicles);
+}
+
+const GPUVehicleState *CpuCompute::getSnapshot() {
+  return m_snapshot < 0 ? nullptr : m_snapshots[m_snapshot].data();
+}
+
+void CpuCompute::setIDMParams(double desired_speed, double time_headway,
+                              double min_gap, double max_accel,
+                              double comfortable_decel,
+                              double accel_exponent) {
+  m_params.desired_speed = static_cast<float>(desired_speed);
+  m_params.time_headway = static_cast<float>(time_headway);
+  m_params.min_gap = static_cast<float>(min_gap);
+  m_params.max_accel = static_cast<float>(max_accel);
+  m_params.comfortable_decel = static_cast<float>(comfortable_decel);
+  m_params.accel_exponent = static_cast<float>(accel_exponent);
+  m_scenario_params.clear();
+  m_slot_scenarios.clear();
+}
+
+void CpuCompute::setScenarioParams(
+    const std::vector<GPUIDMParams> &params,
+    const std::vector<std::uint32_t> &slot_scenarios) {
+  for (std::uint32_t scenario : slot_scenarios) {
+    if (scenario >= params.size()) {
+      throw std::invalid_argument("Scenario " + std::to_string(scenario) +
+                                  " out of the " +
+                                  std::to_string(params.size()) + " ones");
+    }
+  }
+  m_scenario_params = params;
+  m_slot_scenarios = slot_scenarios;
+}
+
+void CpuCompute::computeIDMAccelerations(size_t num_vehicles) {
+  num_vehicles = std::min(num_vehicles, m_vehicles.size());
+  for (size_t i = 0; i < num_vehicles; ++i) {
+    GPUVehicleState &vehicle = m_vehicles[i];
+    if (vehicle.leader_index == GPUVehicleState::IDLE) {
+      vehicle.acceleration = 0.0f;
+      continue;
+    }
+    const GPUIDMParams &params = i < m_slot_scenarios.size()
+                                     ? m_scenario_params[m_slot_scenarios[i]]
+                                     : m_params;
+    const float a = params.max_accel;
+    const float v = vehicle.speed;
+    const float accel_free =
+        a * (1.0f - std::pow(v / params.desired_speed, params.accel_exponent));
+    if (vehicle.leader_index < 0) {
+      vehicle.acceleration = accel_free;
+      continue;
+    }
+    const float sqrt_ab = std::sqrt(a * params.comfortable_decel);
+    const float s = std::max(vehicle.gap, 0.1f);
+    const float s_star = params.min_gap + v * params.time_headway +
+                         v * vehicle.relative_speed / (2.0f * sqrt_ab);
+    const float ratio = s_star / s;
+    vehicle.acceleration =
+        std::max(-10.0f, std::min(5.0f, accel_free - a * ratio * ratio));
+  }
+}
+
+void CpuCompute::updatePositions(size_t num_vehicles, double dt) {
+  const float dt_float = static_cast<float>(dt);
+  num_vehicles = std::min(num_vehicles, m_vehicles.size());
+  for (size_t i = 0; i < num_vehicles; ++i) {
+    GPUVehicleState &vehicle = m_vehicles[i];
+    vehicle.speed =
+        std::max(0.0f, vehicle.speed + vehicle.acceleration * dt_float);
+    vehicle.position += vehicle.speed * dt_float;
+  }
+}
+
+void CpuCompute::calculateGaps(size_t num_vehicles) {
+  const float vehicle_length = 5.0f;
+  num_vehicles = std::min(num_vehicles, m_vehicles.size());
+  const int count = static_cast<int>(num_vehicles);
+  for (size_t i = 0; i < num_vehicles; ++i) {
+    GPUVehicleState &vehicle = m_vehicles[i];
+    if (vehicle.leader_index >= 0 && vehicle.leader_index < count) {
+      const GPUVehicleState &leader = m_vehicles[vehicle.leader_index];
+      vehicle.gap = leader.position - vehicle.position - vehicle_length;
+      vehicle.relative_speed = vehicle.speed - leader.speed;
+    } else {
+      vehicle.gap = 1000.0f;
+      vehicle.relative_speed = 0.0f;
+    }
+  }
+}
+
+void CpuCompute::updateLWR(const std::vector<double> &density,
+                           std::vector<double> &density_new, size_t num_cells,
+                           double dt, double dx, double free_flow_speed,
+                           double jam_density) {
+  m_density.assign(density.begin(), density.begin() + num_cells);
+  m_density_new.resize(num_cells);
+  const float ratio = static_cast<float>(dt) / static_cast<float>(dx);
+  const float v_f = static_cast<float>(free_flow_speed);
+  const float rho_j = static_cast<float>(jam_density);
+  for (size_t i = 0; i < num_cells; ++i) {
+    const float rho = m_density[i];
+    const float rho_prev = m_density[i == 0 ? num_cells - 1 : i - 1];
+    const float rho_next = m_density[(i + 1) % num_cells];
+    const float flux_left = lwrFlux(rho_prev, rho, v_f, rho_j);
+    const float flux_right = lwrFlux(rho, rho_next, v_f, rho_j);
+    m_density_new[i] = std::max(
+        0.0f, std::min(rho_j, rho - ratio * (flux_right - flux_left)));
+  }
+  density_new.assign(m_density_new.begin(), m_density_new.end());
+}
+
+} // namespace cpu
+} // namespace gpu
+} // namespace jamfree
@@ -0,0 +1,97 @@
+#ifndef JAMFREE_GPU_CPU_COMPUTE_H
+#define JAMFREE_GPU_CPU_COMPUTE_H
+
+#include "../ComputeBackend.h"
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace jamfree {
+namespace gpu {
+namespace cpu {
+
+/**
+ * @brief Compute engine running the kernels on the host.
+ *
+ * The IComputeBackend of the hosts without GPU, and the reference of the
+ * device backends: each kernel is a loop over the vehicles or the cells,
+ * in the same single precision.
+ */
+class CpuCompute : public IComputeBackend {
+public:
+  CpuCompute();
+
+  /**
+   * @brief Always available.
+   */
+  static bool isAvailable() { return true; }
+
+  /**
+   * @brief Nothing to load; the kernels are built in.
+   */
+  bool initialize(const std::string &shader_path) override;
+
+  void uploadVehicles(const std::vector<std::shared_ptr<kernel::model::Vehicle>>
+                          &vehicles) override;
+  void downloadVehicles(
+      std::vector<std::shared_ptr<kernel::model::Vehicle>> &vehicles) override;
+  void resizeVehicles(size_t num_vehicles) override;
+  void writeVehicles(const GPUVehicleWrite *writes, size_t count) override;
+  void writeLeaders(const GPULeaderWrite *writes, size_t count) override;
+  void writeLanes(const GPULaneWrite *writes, size_t count) override;
+  void setLaneNeighbours(const std::vector<int> &left,
+                         const std::vector<int> &right) override;
+  void sortVehicles(size_t num_vehicles) override;
+  void downloadNeighbours(std::vector<GPUNeighbours> &neighbours) override;
+
+  /**
+   * @brief Copy the states at once; there is nothing to overlap.
+   */
+  void requestSnapshot(size_t num_vehicles) override;
+  const GPUVehicleState *getSnapshot() override;
+  void setIDMParams(double desired_speed, double time_headway, double min_gap,
+                    double max_accel, double comfortable_decel,
+                    double accel_exponent) override;
+  void setScenarioParams(
+      const std::vector<GPUIDMParams> &params,
+      const std::vector<std::uint32_t> &slot_scenarios) override;
+  void computeIDMAccelerations(size_t num_vehicles) override;
+  void updatePositions(size_t num_vehicles, double dt) override;
+  void calculateGaps(size_t num_vehicles) override;
+  void updateLWR(const std::vector<double> &density,
+                 std::vector<double> &density_new, size_t num_cells, double dt,
+                 double dx, double free_flow_speed,
+                 double jam_density) override;
+  std::string getDeviceName() const override { return "CPU"; }
+
+  /**
+   * @brief Get the states of the vehicles uploaded.
+   */
+  const std::vector<GPUVehicleState> &getVehicleStates() const {
+    return m_vehicles;
+  }
+
+private:
+  std::vector<GPUVehicleState> m_vehicles;
+  std::vector<GPUVehicleState> m_snapshots[2];
+  int m_snapshot = -1; // Last one requested
+
+  // Sort by lane: the key and the slot of each vehicle, in order
+  std::vector<int> m_left_lanes;
+  std::vector<int> m_right_lanes;
+  std::vector<std::pair<std::uint64_t, std::uint32_t>> m_sorted;
+  std::vector<GPUNeighbours> m_neighbours;
+  GPUIDMParams m_params;
+  // Parameters by scenario and scenario of each slot, for an ensemble
+  std::vector<GPUIDMParams> m_scenario_params;
+  std::vector<std::uint32_t> m_slot_scenarios;
+  std::vector<float> m_density;
+  std::vector<float> m_density_new;
+};
+
+} // namespace cpu
+} // namespace gpu
+} // namespace jamfree
+
+#endif // JAMFREE_GPU_CPU_COMPUTE_H
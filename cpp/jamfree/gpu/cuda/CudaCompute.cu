@@ -0,0 +1,696 @@
+#ifdef JAMFREE_HAS_CUDA
+
+#include "CudaCompute.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cub/device/device_radix_sort.cuh>
+#include <cuda_runtime.h>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace jamfree {
+namespace gpu {
+namespace cuda {
+
+namespace {
+
+constexpr unsigned BLOCK_SIZE = 256;
+
+unsigned numBlocks(size_t num_threads) {
+  return static_cast<unsigned>((num_threads + BLOCK_SIZE - 1) / BLOCK_SIZE);
+}
+
+void check(cudaError_t error, const char *what) {
+  if (error != cudaSuccess) {
+    throw std::runtime_error(std::string("CUDA: ") + what + ": " +
+                             cudaGetErrorString(error));
+  }
+}
+
+template <typename Write>
+void checkSlots(const Write *writes, size_t count, size_t num_vehicles) {
+  for (size_t i = 0; i < count; ++i) {
+    if (writes[i].index >= num_vehicles) {
+      throw std::out_of_range("Vehicle slot " +
+                              std::to_string(writes[i].index) + " out of the " +
+                              std::to_string(num_vehicles) + " slots");
+    }
+  }
+}
+
+// The kernels of MetalCompute, one thread by vehicle or cell
+
+__device__ float desiredGap(float speed, float speed_diff,
+                            const GPUIDMParams &params) {
+  const float sqrt_ab = sqrtf(params.max_accel * params.comfortable_decel);
+  return params.min_gap + speed * params.time_headway +
+         speed * speed_diff / (2.0f * sqrt_ab);
+}
+
+__device__ void idmAcceleration(GPUVehicleState &vehicle,
+                                const GPUIDMParams &params) {
+  if (vehicle.leader_index == GPUVehicleState::IDLE) {
+    vehicle.acceleration = 0.0f;
+    return;
+  }
+  const float v = vehicle.speed;
+  const float a = params.max_accel;
+  const float accel_free =
+      a * (1.0f - powf(v / params.desired_speed, params.accel_exponent));
+  if (vehicle.leader_index < 0) {
+    vehicle.acceleration = accel_free;
+    return;
+  }
+  const float s = fmaxf(vehicle.gap, 0.1f);
+  const float ratio = desiredGap(v, vehicle.relative_speed, params) / s;
+  vehicle.acceleration =
+      fminf(5.0f, fmaxf(-10.0f, accel_free - a * ratio * ratio));
+}
+
+__global__ void idmAccelerationKernel(GPUVehicleState *vehicles,
+                                      GPUIDMParams params,
+                                      unsigned num_vehicles) {
+  const unsigned i = blockIdx.x * blockDim.x + threadIdx.x;
+  if (i >= num_vehicles) {
+    return;
+  }
+  idmAcceleration(vehicles[i], params);
+}
+
+// The slots of the ensemble take the parameters of their scenario, the
+// other ones the parameters of setIDMParams()
+__global__ void idmAccelerationEnsembleKernel(
+    GPUVehicleState *vehicles, const GPUIDMParams *scenario_params,
+    const std::uint32_t *slot_scenarios, unsigned num_scenario_slots,
+    GPUIDMParams params, unsigned num_vehicles) {
+  const unsigned i = blockIdx.x * blockDim.x + threadIdx.x;
+  if (i >= num_vehicles) {
+    return;
+  }
+  idmAcceleration(vehicles[i], i < num_scenario_slots
+                                   ? scenario_params[slot_scenarios[i]]
+                                   : params);
+}
+
+__global__ void updatePositionsKernel(GPUVehicleState *vehicles, float dt,
+                                      unsigned num_vehicles) {
+  const unsigned i = blockIdx.x * blockDim.x + threadIdx.x;
+  if (i >= num_vehicles) {
+    return;
+  }
+  GPUVehicleState &vehicle = vehicles[i];
+  vehicle.speed = fmaxf(0.0f, vehicle.speed + vehicle.acceleration * dt);
+  vehicle.position += vehicle.speed * dt;
+}
+
+__global__ void calculateGapsKernel(GPUVehicleState *vehicles,
+                                    unsigned num_vehicles) {
+  const unsigned i = blockIdx.x * blockDim.x + threadIdx.x;
+  if (i >= num_vehicles) {
+    return;
+  }
+  GPUVehicleState &vehicle = vehicles[i];
+  if (vehicle.leader_index >= 0 &&
+      vehicle.leader_index < static_cast<int>(num_vehicles)) {
+    const GPUVehicleState &leader = vehicles[vehicle.leader_index];
+    const float vehicle_length = 5.0f;
+    vehicle.gap = leader.position - vehicle.position - vehicle_length;
+    vehicle.relative_speed = vehicle.speed - leader.speed;
+  } else {
+    vehicle.gap = 1000.0f;
+    vehicle.relative_speed = 0.0f;
+  }
+}
+
+__global__ void writeVehiclesKernel(GPUVehicleState *vehicles,
+                                    const GPUVehicleWrite *writes,
+                                    unsigned count) {
+  const unsigned i = blockIdx.x * blockDim.x + threadIdx.x;
+  if (i < count) {
+    vehicles[writes[i].index] = writes[i].state;
+  }
+}
+
+__global__ void writeLeadersKernel(GPUVehicleState *vehicles,
+                                   const GPULeaderWrite *writes,
+                                   unsigned count) {
+  const unsigned i = blockIdx.x * blockDim.x + threadIdx.x;
+  if (i < count) {
+    vehicles[writes[i].index].leader_index = writes[i].leader_index;
+  }
+}
+
+__global__ void writeLanesKernel(GPUVehicleState *vehicles,
+                                 const GPULaneWrite *writes, unsigned count) {
+  const unsigned i = blockIdx.x * blockDim.x + threadIdx.x;
+  if (i < count) {
+    vehicles[writes[i].index].lane = writes[i].lane;
+  }
+}
+
+// The key of the sort by lane: the lane, the ones without last, then the
+// bits of the position, flipped to order as floats
+__device__ std::uint64_t laneKey(int lane, float position) {
+  std::uint32_t bits = __float_as_uint(position);
+  bits = (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+  return static_cast<std::uint64_t>(static_cast<std::uint32_t>(lane)) << 32 |
+         bits;
+}
+
+__device__ int laneOf(std::uint64_t key) {
+  return static_cast<int>(static_cast<std::uint32_t>(key >> 32));
+}
+
+__global__ void laneKeysKernel(const GPUVehicleState *vehicles,
+                               std::uint64_t *keys, std::uint32_t *slots,
+                               unsigned num_vehicles) {
+  const unsigned i = blockIdx.x * blockDim.x + threadIdx.x;
+  if (i >= num_vehicles) {
+    return;
+  }
+  const GPUVehicleState &vehicle = vehicles[i];
+  const int lane =
+      vehicle.leader_index == GPUVehicleState::IDLE ? -1 : vehicle.lane;
+  keys[i] = laneKey(lane, vehicle.position);
+  slots[i] = i;
+}
+
+// The slot at a position of the sort if on a lane, -1 otherwise
+__device__ int slotOn(const std::uint64_t *keys, const std::uint32_t *order,
+                      unsigned k, unsigned n, int lane) {
+  return k < n && laneOf(keys[k]) == lane ? static_cast<int>(order[k]) : -1;
+}
+
+__device__ void neighboursOn(const std::uint64_t *keys,
+                             const std::uint32_t *order, unsigned n, int lane,
+                             float position, int &leader, int &follower) {
+  leader = follower = -1;
+  if (lane < 0) {
+    return;
+  }
+  // Lower bound of the key
+  const std::uint64_t key = laneKey(lane, position);
+  unsigned low = 0;
+  unsigned high = n;
+  while (low < high) {
+    const unsigned middle = (low + high) / 2;
+    if (keys[middle] < key) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  leader = slotOn(keys, order, low, n, lane);
+  follower = low > 0 ? slotOn(keys, order, low - 1, n, lane) : -1;
+}
+
+__global__ void linkNeighboursKernel(GPUVehicleState *vehicles,
+                                     GPUNeighbours *neighbours,
+                                     const std::uint64_t *keys,
+                                     const std::uint32_t *order, unsigned n,
+                                     const int *lanes, int num_lanes) {
+  const unsigned k = blockIdx.x * blockDim.x + threadIdx.x;
+  if (k >= n) {
+    return;
+  }
+  const std::uint32_t slot = order[k];
+  GPUNeighbours &around = neighbours[slot];
+  around = GPUNeighbours{-1, -1, -1, -1, -1};
+  const int lane = laneOf(keys[k]);
+  if (lane < 0) {
+    return;
+  }
+  GPUVehicleState &vehicle = vehicles[slot];
+  vehicle.leader_index = slotOn(keys, order, k + 1, n, lane);
+  around.follower_index = k > 0 ? slotOn(keys, order, k - 1, n, lane) : -1;
+  if (lane < num_lanes) {
+    neighboursOn(keys, order, n, lanes[lane], vehicle.position,
+                 around.left_leader, around.left_follower);
+    neighboursOn(keys, order, n, lanes[num_lanes + lane], vehicle.position,
+                 around.right_leader, around.right_follower);
+  }
+}
+
+__device__ float lwrFlow(float rho, float v_f, float rho_j) {
+  const float speed = rho >= rho_j ? 0.0f : v_f * (1.0f - rho / rho_j);
+  return rho * speed;
+}
+
+// The demand upstream against the supply downstream
+__device__ float lwrFlux(float rho_l, float rho_r, float v_f, float rho_j) {
+  const float rho_c = rho_j / 2.0f;
+  return fminf(lwrFlow(fminf(rho_l, rho_c), v_f, rho_j),
+               lwrFlow(fmaxf(rho_r, rho_c), v_f, rho_j));
+}
+
+__global__ void lwrUpdateKernel(const float *density, float *density_new,
+                                unsigned num_cells, float ratio, float v_f,
+                                float rho_j) {
+  const unsigned i = blockIdx.x * blockDim.x + threadIdx.x;
+  if (i >= num_cells) {
+    return;
+  }
+  const float rho = density[i];
+  const float rho_prev = density[i == 0 ? num_cells - 1 : i - 1];
+  const float rho_next = density[(i + 1) % num_cells];
+  const float flux_left = lwrFlux(rho_prev, rho, v_f, rho_j);
+  const float flux_right = lwrFlux(rho, rho_next, v_f, rho_j);
+  density_new[i] =
+      fminf(rho_j, fmaxf(0.0f, rho - ratio * (flux_right - flux_left)));
+}
+
+} // namespace
+
+// The defaults of the IDM
+CudaCompute::CudaCompute(int device)
+    : m_device(device), m_params{33.3f, 1.5f, 2.0f, 1.0f, 1.5f, 4.0f} {}
+
+CudaCompute::~CudaCompute() {
+  cudaDeviceSynchronize();
+  cudaFree(m_vehicles);
+  cudaFree(m_density);
+  cudaFree(m_density_new);
+  cudaFree(m_staging);
+  cudaFreeHost(m_host_staging);
+  cudaFree(m_keys);
+  cudaFree(m_order);
+  cudaFree(m_sort_scratch);
+  cudaFree(m_neighbours);
+  cudaFree(m_lanes);
+  cudaFree(m_scenario_params);
+  cudaFree(m_slot_scenarios);
+  for (int i = 0; i < 2; ++i) {
+    cudaFreeHost(m_snapshots[i]);
+    if (m_snapshot_events[i]) {
+      cudaEventDestroy(m_snapshot_events[i]);
+    }
+  }
+  if (m_staging_event) {
+    cudaEventDestroy(m_staging_event);
+  }
+  if (m_snapshot_stream) {
+    cudaStreamDestroy(m_snapshot_stream);
+  }
+}
+
+bool CudaCompute::isAvailable() {
+  int count = 0;
+  return cudaGetDeviceCount(&count) == cudaSuccess && count > 0;
+}
+
+bool CudaCompute::initialize(const std::string &) {
+  cudaError_t error = cudaSetDevice(m_device);
+  cudaDeviceProp properties;
+  if (error == cudaSuccess) {
+    error = cudaGetDeviceProperties(&properties, m_device);
+  }
+  if (error != cudaSuccess) {
+    std::cerr << "CUDA is not supported on this device: "
+              << cudaGetErrorString(error) << std::endl;
+    return false;
+  }
+  // The snapshot stream is a blocking one: its copies follow the kernels
+  // queued before on the default stream
+  if (!m_snapshot_stream) {
+    error = cudaStreamCreate(&m_snapshot_stream);
+    for (int i = 0; i < 2 && error == cudaSuccess; ++i) {
+      error = cudaEventCreateWithFlags(&m_snapshot_events[i],
+                                       cudaEventDisableTiming);
+    }
+    if (error == cudaSuccess) {
+      error = cudaEventCreateWithFlags(&m_staging_event,
+                                       cudaEventDisableTiming);
+    }
+    if (error != cudaSuccess) {
+      std::cerr << "Failed to create the CUDA streams: "
+                << cudaGetErrorString(error) << std::endl;
+      return false;
+    }
+  }
+  m_device_name = properties.name;
+  std::cout << "CUDA compute initialized on: " << m_device_name << std::endl;
+  return true;
+}
+
+void CudaCompute::uploadVehicles(
+    const std::vector<std::shared_ptr<kernel::model::Vehicle>> &vehicles) {
+  m_num_vehicles = vehicles.size();
+  if (m_vehicle_capacity < m_num_vehicles) {
+    check(cudaFree(m_vehicles), "free");
+    m_vehicles = nullptr;
+    m_vehicle_capacity = 0;
+    check(cudaMalloc(&m_vehicles, m_num_vehicles * sizeof(GPUVehicleState)),
+          "allocation of the vehicles");
+    m_vehicle_capacity = m_num_vehicles;
+  }
+  m_host_vehicles.resize(m_num_vehicles);
+  packVehicles(vehicles, m_host_vehicles.data());
+  check(cudaMemcpy(m_vehicles, m_host_vehicles.data(),
+                   m_num_vehicles * sizeof(GPUVehicleState),
+                   cudaMemcpyHostToDevice),
+        "upload of the vehicles");
+}
+
+void CudaCompute::downloadVehicles(
+    std::vector<std::shared_ptr<kernel::model::Vehicle>> &vehicles) {
+  const size_t count = std::min(vehicles.size(), m_num_vehicles);
+  check(cudaMemcpy(m_host_vehicles.data(), m_vehicles,
+                   count * sizeof(GPUVehicleState), cudaMemcpyDeviceToHost),
+        "download of the vehicles");
+  for (size_t i = 0; i < count; ++i) {
+    vehicles[i]->setLanePosition(m_host_vehicles[i].position);
+    vehicles[i]->setSpeed(m_host_vehicles[i].speed);
+  }
+}
+
+void CudaCompute::resizeVehicles(size_t num_vehicles) {
+  const size_t kept = std::min(num_vehicles, m_num_vehicles);
+  if (m_vehicle_capacity < num_vehicles) {
+    GPUVehicleState *vehicles = nullptr;
+    check(cudaMalloc(&vehicles, num_vehicles * sizeof(GPUVehicleState)),
+          "allocation of the vehicles");
+    if (kept > 0) {
+      check(cudaMemcpy(vehicles, m_vehicles, kept * sizeof(GPUVehicleState),
+                       cudaMemcpyDeviceToDevice),
+            "copy of the vehicles");
+    }
+    check(cudaFree(m_vehicles), "free");
+    m_vehicles = vehicles;
+    m_vehicle_capacity = num_vehicles;
+  }
+  if (kept < num_vehicles) {
+    m_host_vehicles.assign(num_vehicles - kept, idleVehicle());
+    check(cudaMemcpy(m_vehicles + kept, m_host_vehicles.data(),
+                     (num_vehicles - kept) * sizeof(GPUVehicleState),
+                     cudaMemcpyHostToDevice),
+          "upload of the idle vehicles");
+  }
+  m_num_vehicles = num_vehicles;
+  m_host_vehicles.resize(num_vehicles);
+}
+
+void *CudaCompute::stage(const void *writes, size_t bytes) {
+  if (m_staging_capacity < bytes) {
+    check(cudaEventSynchronize(m_staging_event), "staging");
+    check(cudaFree(m_staging), "free");
+    check(cudaFreeHost(m_host_staging), "free");
+    m_staging = m_host_staging = nullptr;
+    m_staging_capacity = 0;
+    check(cudaMalloc(&m_staging, bytes), "allocation of the writes");
+    check(cudaMallocHost(&m_host_staging, bytes), "allocation of the writes");
+    m_staging_capacity = bytes;
+  }
+  // The copy of the previous writes is usually done long ago
+  check(cudaEventSynchronize(m_staging_event), "staging");
+  std::memcpy(m_host_staging, writes, bytes);
+  check(cudaMemcpyAsync(m_staging, m_host_staging, bytes,
+                        cudaMemcpyHostToDevice, 0),
+        "upload of the writes");
+  check(cudaEventRecord(m_staging_event, 0), "staging");
+  return m_staging;
+}
+
+void CudaCompute::writeVehicles(const GPUVehicleWrite *writes, size_t count) {
+  checkSlots(writes, count, m_num_vehicles);
+  if (count == 0) {
+    return;
+  }
+  auto *staged = static_cast<GPUVehicleWrite *>(
+      stage(writes, count * sizeof(GPUVehicleWrite)));
+  writeVehiclesKernel<<<numBlocks(count), BLOCK_SIZE>>>(
+      m_vehicles, staged, static_cast<unsigned>(count));
+  check(cudaGetLastError(), "vehicle writes");
+}
+
+void CudaCompute::writeLeaders(const GPULeaderWrite *writes, size_t count) {
+  checkSlots(writes, count, m_num_vehicles);
+  if (count == 0) {
+    return;
+  }
+  auto *staged = static_cast<GPULeaderWrite *>(
+      stage(writes, count * sizeof(GPULeaderWrite)));
+  writeLeadersKernel<<<numBlocks(count), BLOCK_SIZE>>>(
+      m_vehicles, staged, static_cast<unsigned>(count));
+  check(cudaGetLastError(), "leader writes");
+}
+
+void CudaCompute::writeLanes(const GPULaneWrite *writes, size_t count) {
+  checkSlots(writes, count, m_num_vehicles);
+  if (count == 0) {
+    return;
+  }
+  auto *staged = static_cast<GPULaneWrite *>(
+      stage(writes, count * sizeof(GPULaneWrite)));
+  writeLanesKernel<<<numBlocks(count), BLOCK_SIZE>>>(
+      m_vehicles, staged, static_cast<unsigned>(count));
+  check(cudaGetLastError(), "lane writes");
+}
+
+void CudaCompute::setLaneNeighbours(const std::vector<int> &left,
+                                    const std::vector<int> &right) {
+  if (left.size() != right.size()) {
+    throw std::invalid_argument(
+        "Lane neighbours: one left and one right lane by lane");
+  }
+  std::vector<int> lanes(left);
+  lanes.insert(lanes.end(), right.begin(), right.end());
+  check(cudaFree(m_lanes), "free");
+  m_lanes = nullptr;
+  m_num_lanes = 0;
+  if (!lanes.empty()) {
+    check(cudaMalloc(&m_lanes, lanes.size() * sizeof(int)),
+          "allocation of the lanes");
+    check(cudaMemcpy(m_lanes, lanes.data(), lanes.size() * sizeof(int),
+                     cudaMemcpyHostToDevice),
+          "upload of the lanes");
+  }
+  m_num_lanes = static_cast<int>(left.size());
+}
+
+void CudaCompute::sortVehicles(size_t num_vehicles) {
+  num_vehicles = std::min(num_vehicles, m_num_vehicles);
+  m_num_sorted = num_vehicles;
+  if (num_vehicles == 0) {
+    return;
+  }
+  // Two halves: the keys and the slots before the sort, then after
+  if (m_sort_capacity < num_vehicles) {
+    check(cudaFree(m_keys), "free");
+    check(cudaFree(m_order), "free");
+    check(cudaFree(m_neighbours), "free");
+    m_keys = nullptr;
+    m_order = nullptr;
+    m_neighbours = nullptr;
+    m_sort_capacity = 0;
+    check(cudaMalloc(&m_keys, 2 * num_vehicles * sizeof(std::uint64_t)),
+          "allocation of the sort");
+    check(cudaMalloc(&m_order, 2 * num_vehicles * sizeof(std::uint32_t)),
+          "allocation of the sort");
+    check(cudaMalloc(&m_neighbours, num_vehicles * sizeof(GPUNeighbours)),
+          "allocation of the neighbours");
+    m_sort_capacity = num_vehicles;
+  }
+  const int count = static_cast<int>(num_vehicles);
+  std::uint64_t *sorted_keys = m_keys + num_vehicles;
+  std::uint32_t *sorted_order = m_order + num_vehicles;
+  size_t scratch_size = 0;
+  check(cub::DeviceRadixSort::SortPairs(nullptr, scratch_size, m_keys,
+                                        sorted_keys, m_order, sorted_order,
+                                        count),
+        "sort");
+  if (m_sort_scratch_size < scratch_size) {
+    check(cudaFree(m_sort_scratch), "free");
+    m_sort_scratch = nullptr;
+    m_sort_scratch_size = 0;
+    check(cudaMalloc(&m_sort_scratch, scratch_size), "allocation of the sort");
+    m_sort_scratch_size = scratch_size;
+  }
+
+  laneKeysKernel<<<numBlocks(num_vehicles), BLOCK_SIZE>>>(
+      m_vehicles, m_keys, m_order, static_cast<unsigned>(num_vehicles));
+  check(cudaGetLastError(), "lane keys");
+  // Stable: the slots of a lane at a same position stay in order
+  check(cub::DeviceRadixSort::SortPairs(m_sort_scratch, scratch_size, m_keys,
+                                        sorted_keys, m_order, sorted_order,
+                                        count),
+        "sort");
+  linkNeighboursKernel<<<numBlocks(num_vehicles), BLOCK_SIZE>>>(
+      m_vehicles, m_neighbours, sorted_keys, sorted_order,
+      static_cast<unsigned>(num_vehicles), m_lanes, m_num_lanes);
+  check(cudaGetLastError(), "neighbour kernel");
+}
+
+void CudaCompute::downloadNeighbours(std::vector<GPUNeighbours> &neighbours) {
+  neighbours.resize(m_num_sorted);
+  if (m_num_sorted > 0) {
+    check(cudaMemcpy(neighbours.data(), m_neighbours,
+                     m_num_sorted * sizeof(GPUNeighbours),
+                     cudaMemcpyDeviceToHost),
+          "download of the neighbours");
+  }
+}
+
+void CudaCompute::requestSnapshot(size_t num_vehicles) {
+  const int next = m_snapshot == 0 ? 1 : 0;
+  num_vehicles = std::min(num_vehicles, m_num_vehicles);
+  if (m_snapshot_capacity[next] < num_vehicles) {
+    check(cudaEventSynchronize(m_snapshot_events[next]), "snapshot");
+    check(cudaFreeHost(m_snapshots[next]), "free");
+    m_snapshots[next] = nullptr;
+    m_snapshot_capacity[next] = 0;
+    check(cudaMallocHost(&m_snapshots[next],
+                         num_vehicles * sizeof(GPUVehicleState)),
+          "allocation of the snapshot");
+    m_snapshot_capacity[next] = num_vehicles;
+  }
+  if (num_vehicles > 0) {
+    check(cudaMemcpyAsync(m_snapshots[next], m_vehicles,
+                          num_vehicles * sizeof(GPUVehicleState),
+                          cudaMemcpyDeviceToHost, m_snapshot_stream),
+          "snapshot");
+  }
+  check(cudaEventRecord(m_snapshot_events[next], m_snapshot_stream),
+        "snapshot");
+  m_snapshot = next;
+}
+
+const GPUVehicleState *CudaCompute::getSnapshot() {
+  if (m_snapshot < 0) {
+    return nullptr;
+  }
+  check(cudaEventSynchronize(m_snapshot_events[m_snapshot]), "snapshot");
+  return m_snapshots[m_snapshot];
+}
+
+void CudaCompute::setIDMParams(double desired_speed, double time_headway,
+                               double min_gap, double max_accel,
+                               double comfortable_decel,
+                               double accel_exponent) {
+  // Passed by value to the kernel
+  m_params.desired_speed = static_cast<float>(desired_speed);
+  m_params.time_headway = static_cast<float>(time_headway);
+  m_params.min_gap = static_cast<float>(min_gap);
+  m_params.max_accel = static_cast<float>(max_accel);
+  m_params.comfortable_decel = static_cast<float>(comfortable_decel);
+  m_params.accel_exponent = static_cast<float>(accel_exponent);
+  m_num_scenario_slots = 0;
+}
+
+void CudaCompute::setScenarioParams(
+    const std::vector<GPUIDMParams> &params,
+    const std::vector<std::uint32_t> &slot_scenarios) {
+  for (std::uint32_t scenario : slot_scenarios) {
+    if (scenario >= params.size()) {
+      throw std::invalid_argument("Scenario " + std::to_string(scenario) +
+                                  " out of the " +
+                                  std::to_string(params.size()) + " ones");
+    }
+  }
+  check(cudaFree(m_scenario_params), "free");
+  check(cudaFree(m_slot_scenarios), "free");
+  m_scenario_params = nullptr;
+  m_slot_scenarios = nullptr;
+  m_num_scenario_slots = 0;
+  if (slot_scenarios.empty()) {
+    return;
+  }
+  check(cudaMalloc(&m_scenario_params, params.size() * sizeof(GPUIDMParams)),
+        "allocation of the scenarios");
+  check(cudaMalloc(&m_slot_scenarios,
+                   slot_scenarios.size() * sizeof(std::uint32_t)),
+        "allocation of the scenarios");
+  check(cudaMemcpy(m_scenario_params, params.data(),
+                   params.size() * sizeof(GPUIDMParams),
+                   cudaMemcpyHostToDevice),
+        "upload of the scenarios");
+  check(cudaMemcpy(m_slot_scenarios, slot_scenarios.data(),
+                   slot_scenarios.size() * sizeof(std::uint32_t),
+                   cudaMemcpyHostToDevice),
+        "upload of the scenarios");
+  m_num_scenario_slots = slot_scenarios.size();
+}
+
+void CudaCompute::computeIDMAccelerations(size_t num_vehicles) {
+  num_vehicles = std::min(num_vehicles, m_num_vehicles);
+  if (num_vehicles == 0) {
+    return;
+  }
+  if (m_num_scenario_slots > 0) {
+    idmAccelerationEnsembleKernel<<<numBlocks(num_vehicles), BLOCK_SIZE>>>(
+        m_vehicles, m_scenario_params, m_slot_scenarios,
+        static_cast<unsigned>(m_num_scenario_slots), m_params,
+        static_cast<unsigned>(num_vehicles));
+  } else {
+    idmAccelerationKernel<<<numBlocks(num_vehicles), BLOCK_SIZE>>>(
+        m_vehicles, m_params, static_cast<unsigned>(num_vehicles));
+  }
+  check(cudaGetLastError(), "IDM kernel");
+}
+
+void CudaCompute::updatePositions(size_t num_vehicles, double dt) {
+  num_vehicles = std::min(num_vehicles, m_num_vehicles);
+  if (num_vehicles == 0) {
+    return;
+  }
+  updatePositionsKernel<<<numBlocks(num_vehicles), BLOCK_SIZE>>>(
+      m_vehicles, static_cast<float>(dt), static_cast<unsigned>(num_vehicles));
+  check(cudaGetLastError(), "position kernel");
+}
+
+void CudaCompute::calculateGaps(size_t num_vehicles) {
+  num_vehicles = std::min(num_vehicles, m_num_vehicles);
+  if (num_vehicles == 0) {
+    return;
+  }
+  calculateGapsKernel<<<numBlocks(num_vehicles), BLOCK_SIZE>>>(
+      m_vehicles, static_cast<unsigned>(num_vehicles));
+  check(cudaGetLastError(), "gap kernel");
+}
+
+void CudaCompute::updateLWR(const std::vector<double> &density,
+                            std::vector<double> &density_new, size_t num_cells,
+                            double dt, double dx, double free_flow_speed,
+                            double jam_density) {
+  if (num_cells == 0) {
+    density_new.clear();
+    return;
+  }
+  if (m_density_capacity < num_cells) {
+    check(cudaFree(m_density), "free");
+    check(cudaFree(m_density_new), "free");
+    m_density = m_density_new = nullptr;
+    m_density_capacity = 0;
+    check(cudaMalloc(&m_density, num_cells * sizeof(float)),
+          "allocation of the densities");
+    check(cudaMalloc(&m_density_new, num_cells * sizeof(float)),
+          "allocation of the densities");
+    m_density_capacity = num_cells;
+  }
+
+  // Single precision, as the other backends
+  m_host_density.assign(density.begin(), density.begin() + num_cells);
+  check(cudaMemcpy(m_density, m_host_density.data(), num_cells * sizeof(float),
+                   cudaMemcpyHostToDevice),
+        "upload of the densities");
+  const float ratio = static_cast<float>(dt) / static_cast<float>(dx);
+  lwrUpdateKernel<<<numBlocks(num_cells), BLOCK_SIZE>>>(
+      m_density, m_density_new, static_cast<unsigned>(num_cells), ratio,
+      static_cast<float>(free_flow_speed), static_cast<float>(jam_density));
+  check(cudaGetLastError(), "LWR kernel");
+  check(cudaMemcpy(m_host_density.data(), m_density_new,
+                   num_cells * sizeof(float), cudaMemcpyDeviceToHost),
+        "download of the densities");
+  density_new.assign(m_host_density.begin(), m_host_density.end());
+}
+
+std::string CudaCompute::getDeviceName() const {
+  return m_device_name.empty() ? "No device" : m_device_name;
+}
+
+} // namespace cuda
+} // namespace gpu
+} // namespace jamfree
+
+#endif // JAMFREE_HAS_CUDA
@@ -0,0 +1,142 @@
+#ifndef JAMFREE_GPU_CUDA_COMPUTE_H
+#define JAMFREE_GPU_CUDA_COMPUTE_H
+
+#ifdef JAMFREE_HAS_CUDA
+
+#include "../ComputeBackend.h"
+#include <cstdint>
+#include <cuda_runtime.h>
+#include <string>
+#include <vector>
+
+namespace jamfree {
+namespace gpu {
+namespace cuda {
+
+/**
+ * @brief CUDA compute engine for traffic simulation.
+ *
+ * The IComputeBackend of NVIDIA hardware. The kernels are compiled in, so
+ * initialize() only selects the device. The vehicle and density buffers of
+ * the device grow as needed and are reused by the next calls. The vehicle
+ * kernels and writes are queued on the device and return at once;
+ * downloadVehicles() and getSnapshot() wait for them, and the snapshots
+ * are copied on a stream of their own into pinned host memory. A failing
+ * CUDA call after initialize() throws std::runtime_error, possibly one
+ * of a kernel queued before.
+ */
+class CudaCompute : public IComputeBackend {
+public:
+  /**
+   * @param device Index of the CUDA device
+   */
+  explicit CudaCompute(int device = 0);
+
+  /**
+   * @brief Destructor - releases the device buffers.
+   */
+  ~CudaCompute() override;
+
+  CudaCompute(const CudaCompute &) = delete;
+  CudaCompute &operator=(const CudaCompute &) = delete;
+
+  /**
+   * @brief Check if a CUDA device is available.
+   *
+   * @return True if CUDA is supported
+   */
+  static bool isAvailable();
+
+  bool initialize(const std::string &shader_path) override;
+  void uploadVehicles(const std::vector<std::shared_ptr<kernel::model::Vehicle>>
+                          &vehicles) override;
+  void downloadVehicles(
+      std::vector<std::shared_ptr<kernel::model::Vehicle>> &vehicles) override;
+  void resizeVehicles(size_t num_vehicles) override;
+  void writeVehicles(const GPUVehicleWrite *writes, size_t count) override;
+  void writeLeaders(const GPULeaderWrite *writes, size_t count) override;
+  void writeLanes(const GPULaneWrite *writes, size_t count) override;
+  void setLaneNeighbours(const std::vector<int> &left,
+                         const std::vector<int> &right) override;
+
+  /**
+   * @brief Derive the leaders and the neighbours with a radix sort of cub.
+   */
+  void sortVehicles(size_t num_vehicles) override;
+  void downloadNeighbours(std::vector<GPUNeighbours> &neighbours) override;
+  void requestSnapshot(size_t num_vehicles) override;
+  const GPUVehicleState *getSnapshot() override;
+  void setIDMParams(double desired_speed, double time_headway, double min_gap,
+                    double max_accel, double comfortable_decel,
+                    double accel_exponent) override;
+  void setScenarioParams(
+      const std::vector<GPUIDMParams> &params,
+      const std::vector<std::uint32_t> &slot_scenarios) override;
+  void computeIDMAccelerations(size_t num_vehicles) override;
+  void updatePositions(size_t num_vehicles, double dt) override;
+  void calculateGaps(size_t num_vehicles) override;
+  void updateLWR(const std::vector<double> &density,
+                 std::vector<double> &density_new, size_t num_cells, double dt,
+                 double dx, double free_flow_speed,
+                 double jam_density) override;
+  std::string getDeviceName() const override;
+
+private:
+  int m_device;
+  std::string m_device_name;
+  GPUIDMParams m_params;
+  // Parameters by scenario and scenario of each slot, for an ensemble
+  GPUIDMParams *m_scenario_params = nullptr;
+  std::uint32_t *m_slot_scenarios = nullptr;
+  size_t m_num_scenario_slots = 0;
+
+  // Device buffers, and the host copies they are staged through
+  GPUVehicleState *m_vehicles = nullptr;
+  size_t m_vehicle_capacity = 0;
+  size_t m_num_vehicles = 0;
+  std::vector<GPUVehicleState> m_host_vehicles;
+
+  // Writes, staged through pinned memory until their copy is done
+  void *m_staging = nullptr;
+  void *m_host_staging = nullptr;
+  size_t m_staging_capacity = 0;
+  cudaEvent_t m_staging_event = nullptr;
+
+  // Sort by lane: the keys and the slots before and after the sort, the
+  // scratch of cub, and the neighbours of the slots
+  std::uint64_t *m_keys = nullptr;
+  std::uint32_t *m_order = nullptr;
+  size_t m_sort_capacity = 0;
+  void *m_sort_scratch = nullptr;
+  size_t m_sort_scratch_size = 0;
+  GPUNeighbours *m_neighbours = nullptr;
+  size_t m_num_sorted = 0;
+  int *m_lanes = nullptr; // Left then right lane of each lane
+  int m_num_lanes = 0;
+
+  // Snapshots, double-buffered in pinned memory
+  cudaStream_t m_snapshot_stream = nullptr;
+  GPUVehicleState *m_snapshots[2] = {nullptr, nullptr};
+  size_t m_snapshot_capacity[2] = {0, 0};
+  cudaEvent_t m_snapshot_events[2] = {nullptr, nullptr};
+  int m_snapshot = -1; // Last one requested
+
+  float *m_density = nullptr;
+  float *m_density_new = nullptr;
+  size_t m_density_capacity = 0;
+  std::vector<float> m_host_density;
+
+  /**
+   * @brief Copy the writes to the device, once the previous ones are done.
+   *
+   * @return The writes on the device
+   */
+  void *stage(const void *writes, size_t bytes);
+};
+
+} // namespace cuda
+} // namespace gpu
+} // namespace jamfree
+
+#endif // JAMFREE_HAS_CUDA
+#endif // JAMFREE_GPU_CUDA_COMPUTE_H
@@ -3,7 +3,7 @@
 
 #ifdef __APPLE__
 
-#include "../../kernel/include/model/Vehicle.h"
+#include "../ComputeBackend.h"
 #include <Metal/Metal.h>
 #include <memory>
 #include <string>
@@ -13,37 +13,22 @@ namespace jamfree {
 namespace gpu {
 namespace metal {
 
-/**
- * @brief Vehicle state for GPU processing.
- */
-struct GPUVehicleState {
-  float position;
-  float speed;
-  float acceleration;
-  int leader_index;
-  float gap;
-  float relative_speed;
-};
-
-/**
- * @brief IDM parameters for GPU.
- */
-struct GPUIDMParams {
-  float desired_speed;
-  float time_headway;
-  float min_gap;
-  float max_accel;
-  float comfortable_decel;
-  float accel_exponent;
-};
+using gpu::GPUIDMParams;
+using gpu::GPULaneWrite;
+using gpu::GPULeaderWrite;
+using gpu::GPUNeighbours;
+using gpu::GPUVehicleState;
+using gpu::GPUVehicleWrite;
 
 /**
  * @brief Metal compute engine for traffic simulation.
  *
- * Provides GPU-accelerated traffic simulation using Apple Metal.
+ * The IComputeBackend of Apple hardware, using Metal. The vehicle buffer is
+ * in memory shared with the host, which writes the slots in place between
+ * the kernels; the snapshots are blit copies the host does not wait for.
  * Achieves 10-100x speedup for large-scale simulations (10,000+ vehicles).
  */
-class MetalCompute {
+class MetalCompute : public IComputeBackend {
 public:
   /**
    * @brief Constructor - initializes Metal device and pipeline.
@@ -53,7 +38,7 @@ public:
   /**
    * @brief Destructor - releases Metal resources.
    */
-  ~MetalCompute();
+  ~MetalCompute() override;
 
   /**
    * @brief Check if Metal is available.
@@ -68,15 +53,15 @@ public:
    * @param shader_path Path to compiled Metal shader library
    * @return True if initialization successful
    */
-  bool initialize(const std::string &shader_path);
+  bool initialize(const std::string &shader_path) override;
 
   /**
    * @brief Upload vehicle states to GPU.
    *
    * @param vehicles Vector of vehicles
    */
-  void uploadVehicles(
-      const std::vector<std::shared_ptr<kernel::model::Vehicle>> &vehicles);
+  void uploadVehicles(const std::vector<std::shared_ptr<kernel::model::Vehicle>>
+                          &vehicles) override;
 
   /**
    * @brief Download vehicle states from GPU.
@@ -84,7 +69,75 @@ public:
    * @param vehicles Vector of vehicles to update
    */
   void downloadVehicles(
-      std::vector<std::shared_ptr<kernel::model::Vehicle>> &vehicles);
+      std::vector<std::shared_ptr<kernel::model::Vehicle>> &vehicles) override;
+
+  /**
+   * @brief Set the number of vehicle slots of the GPU.
+   *
+   * @param num_vehicles Number of slots
+   */
+  void resizeVehicles(size_t num_vehicles) override;
+
+  /**
+   * @brief Write the states of some slots, in the shared buffer.
+   *
+   * @param writes Slot and state of each write
+   * @param count Number of writes
+   */
+  void writeVehicles(const GPUVehicleWrite *writes, size_t count) override;
+
+  /**
+   * @brief Write the leaders of some slots, in the shared buffer.
+   *
+   * @param writes Slot and leader of each write
+   * @param count Number of writes
+   */
+  void writeLeaders(const GPULeaderWrite *writes, size_t count) override;
+
+  /**
+   * @brief Write the lanes of some slots, in the shared buffer.
+   *
+   * @param writes Slot and lane of each write
+   * @param count Number of writes
+   */
+  void writeLanes(const GPULaneWrite *writes, size_t count) override;
+
+  /**
+   * @brief Set the adjacent lanes of each lane, for the neighbours.
+   *
+   * @param left Lane on the left of each lane, -1 if none
+   * @param right Lane on the right of each lane, -1 if none
+   */
+  void setLaneNeighbours(const std::vector<int> &left,
+                         const std::vector<int> &right) override;
+
+  /**
+   * @brief Derive the leaders and the neighbours by a bitonic sort on GPU.
+   *
+   * @param num_vehicles Number of slots
+   */
+  void sortVehicles(size_t num_vehicles) override;
+
+  /**
+   * @brief Download the neighbours of the last sort.
+   *
+   * @param neighbours Set to the neighbours of each slot sorted
+   */
+  void downloadNeighbours(std::vector<GPUNeighbours> &neighbours) override;
+
+  /**
+   * @brief Start a blit copy of the slots to a snapshot buffer.
+   *
+   * @param num_vehicles Number of slots to copy
+   */
+  void requestSnapshot(size_t num_vehicles) override;
+
+  /**
+   * @brief Get the states of the last snapshot, once its blit is done.
+   *
+   * @return The states copied, null if none was requested
+   */
+  const GPUVehicleState *getSnapshot() override;
 
   /**
    * @brief Set IDM parameters.
@@ -98,14 +151,21 @@ public:
    */
   void setIDMParams(double desired_speed, double time_headway, double min_gap,
                     double max_accel, double comfortable_decel,
-                    double accel_exponent);
+                    double accel_exponent) override;
+
+  /**
+   * @brief Set IDM parameters by scenario, read by an ensemble kernel.
+   */
+  void setScenarioParams(
+      const std::vector<GPUIDMParams> &params,
+      const std::vector<std::uint32_t> &slot_scenarios) override;
 
   /**
    * @brief Compute IDM accelerations on GPU.
    *
    * @param num_vehicles Number of vehicles
    */
-  void computeIDMAccelerations(size_t num_vehicles);
+  void computeIDMAccelerations(size_t num_vehicles) override;
 
   /**
    * @brief Update vehicle positions on GPU.
@@ -113,14 +173,14 @@ public:
    * @param num_vehicles Number of vehicles
    * @param dt Time step (s)
    */
-  void updatePositions(size_t num_vehicles, double dt);
+  void updatePositions(size_t num_vehicles, double dt) override;
 
   /**
    * @brief Calculate gaps and relative speeds on GPU.
    *
    * @param num_vehicles Number of vehicles
    */
-  void calculateGaps(size_t num_vehicles);
+  void calculateGaps(size_t num_vehicles) override;
 
   /**
    * @brief Run complete simulation step on GPU.
@@ -130,7 +190,7 @@ public:
    * @param num_vehicles Number of vehicles
    * @param dt Time step (s)
    */
-  void simulationStep(size_t num_vehicles, double dt);
+  void simulationStep(size_t num_vehicles, double dt) override;
 
   /**
    * @brief Update LWR macroscopic model on GPU.
@@ -145,14 +205,15 @@ public:
    */
   void updateLWR(const std::vector<double> &density,
                  std::vector<double> &density_new, size_t num_cells, double dt,
-                 double dx, double free_flow_speed, double jam_density);
+                 double dx, double free_flow_speed,
+                 double jam_density) override;
 
   /**
    * @brief Get GPU device name.
    *
    * @return Device name string
    */
-  std::string getDeviceName() const;
+  std::string getDeviceName() const override;
 
   /**
    * @brief Get maximum threads per threadgroup.
@@ -171,6 +232,9 @@ private:
   id<MTLComputePipelineState> m_update_pipeline;
   id<MTLComputePipelineState> m_gaps_pipeline;
   id<MTLComputePipelineState> m_lwr_pipeline;
+  id<MTLComputePipelineState> m_keys_pipeline;
+  id<MTLComputePipelineState> m_sort_pipeline;
+  id<MTLComputePipelineState> m_link_pipeline;
 
   // Buffers
   id<MTLBuffer> m_vehicle_buffer;
@@ -180,6 +244,28 @@ private:
 
   size_t m_vehicle_buffer_size;
   size_t m_density_buffer_size;
+  size_t m_num_vehicles;
+
+  // Sort by lane: the keys and the slots, padded to a power of two, the
+  // neighbours of the slots, and the left then right lane of each lane
+  id<MTLBuffer> m_keys_buffer;
+  id<MTLBuffer> m_order_buffer;
+  id<MTLBuffer> m_neighbours_buffer;
+  id<MTLBuffer> m_lanes_buffer;
+  size_t m_sort_capacity;
+  size_t m_num_sorted;
+  int m_num_lanes;
+
+  // Snapshots, double-buffered, and the blits that fill them
+  id<MTLBuffer> m_snapshot_buffers[2];
+  id<MTLCommandBuffer> m_snapshot_commands[2];
+  int m_snapshot; // Last one requested
+
+  // Ensemble: the parameters of each scenario and the scenario of each slot
+  id<MTLComputePipelineState> m_idm_ensemble_pipeline;
+  id<MTLBuffer> m_scenario_params_buffer;
+  id<MTLBuffer> m_slot_scenarios_buffer;
+  uint32_t m_num_scenario_slots;
 
   /**
    * @brief Create compute pipeline for kernel.
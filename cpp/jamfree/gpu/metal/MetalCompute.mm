@@ -2,7 +2,10 @@
 
 #include "MetalCompute.h"
 #include <Foundation/Foundation.h>
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
 
 namespace jamfree {
 namespace gpu {
@@ -13,7 +16,17 @@ MetalCompute::MetalCompute()
       m_update_pipeline(nil), m_gaps_pipeline(nil), m_lwr_pipeline(nil),
       m_vehicle_buffer(nil), m_params_buffer(nil), m_density_buffer(nil),
       m_density_new_buffer(nil), m_vehicle_buffer_size(0),
-      m_density_buffer_size(0) {}
+      m_density_buffer_size(0), m_num_vehicles(0), m_keys_pipeline(nil),
+      m_sort_pipeline(nil), m_link_pipeline(nil), m_keys_buffer(nil),
+      m_order_buffer(nil), m_neighbours_buffer(nil), m_lanes_buffer(nil),
+      m_sort_capacity(0), m_num_sorted(0), m_num_lanes(0), m_snapshot(-1),
+      m_idm_ensemble_pipeline(nil), m_scenario_params_buffer(nil),
+      m_slot_scenarios_buffer(nil), m_num_scenario_slots(0) {
+  for (int i = 0; i < 2; ++i) {
+    m_snapshot_buffers[i] = nil;
+    m_snapshot_commands[i] = nil;
+  }
+}
 
 MetalCompute::~MetalCompute() {
   // Metal uses ARC, objects will be released automatically
@@ -38,6 +51,15 @@ struct VehicleState {
     int leader_index;
     float gap;
     float relative_speed;
+    int lane;
+};
+
+struct Neighbours {
+    int follower_index;
+    int left_leader;
+    int left_follower;
+    int right_leader;
+    int right_follower;
 };
 
 struct IDMParams {
@@ -59,15 +81,13 @@ inline float calculate_desired_gap(float speed, float speed_diff, constant IDMPa
     return s0 + speed * T + interaction;
 }
 
-kernel void idm_acceleration_kernel(
-    device VehicleState* vehicles [[buffer(0)]],
-    constant IDMParams& params [[buffer(1)]],
-    constant uint& num_vehicles [[buffer(2)]],
-    uint thread_id [[thread_position_in_grid]])
+inline void idm_acceleration(device VehicleState& vehicle,
+                             constant IDMParams& params)
 {
-    if (thread_id >= num_vehicles) return;
-    
-    device VehicleState& vehicle = vehicles[thread_id];
+    if (vehicle.leader_index == -2) {  // Idle slot
+        vehicle.acceleration = 0.0f;
+        return;
+    }
     float v = vehicle.speed;
     float v0 = params.desired_speed;
     float a = params.max_accel;
@@ -92,6 +112,34 @@ kernel void idm_acceleration_kernel(
     vehicle.acceleration = clamp(vehicle.acceleration, -10.0f, 5.0f);
 }
 
+kernel void idm_acceleration_kernel(
+    device VehicleState* vehicles [[buffer(0)]],
+    constant IDMParams& params [[buffer(1)]],
+    constant uint& num_vehicles [[buffer(2)]],
+    uint thread_id [[thread_position_in_grid]])
+{
+    if (thread_id >= num_vehicles) return;
+    idm_acceleration(vehicles[thread_id], params);
+}
+
+kernel void idm_acceleration_ensemble_kernel(
+    device VehicleState* vehicles [[buffer(0)]],
+    constant IDMParams& params [[buffer(1)]],
+    constant uint& num_vehicles [[buffer(2)]],
+    constant IDMParams* scenario_params [[buffer(3)]],
+    constant uint* slot_scenarios [[buffer(4)]],
+    constant uint& num_scenario_slots [[buffer(5)]],
+    uint thread_id [[thread_position_in_grid]])
+{
+    if (thread_id >= num_vehicles) return;
+    if (thread_id < num_scenario_slots) {
+        idm_acceleration(vehicles[thread_id],
+                         scenario_params[slot_scenarios[thread_id]]);
+    } else {
+        idm_acceleration(vehicles[thread_id], params);
+    }
+}
+
 kernel void update_positions_kernel(
     device VehicleState* vehicles [[buffer(0)]],
     constant float& dt [[buffer(1)]],
@@ -124,6 +172,121 @@ kernel void calculate_gaps_kernel(
     }
 }
 
+// The key of the sort by lane: the lane, the ones without last, then the
+// bits of the position, flipped to order as floats
+inline ulong lane_key(int lane, float position) {
+    uint bits = as_type<uint>(position);
+    bits = (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+    return (ulong(uint(lane)) << 32) | ulong(bits);
+}
+
+inline int lane_of(ulong key) {
+    return int(uint(key >> 32));
+}
+
+kernel void lane_keys_kernel(
+    device const VehicleState* vehicles [[buffer(0)]],
+    device ulong* keys [[buffer(1)]],
+    device uint* order [[buffer(2)]],
+    constant uint& num_vehicles [[buffer(3)]],
+    uint thread_id [[thread_position_in_grid]])
+{
+    // Padded to a power of two by keys after all the others
+    if (thread_id >= num_vehicles) {
+        keys[thread_id] = 0xFFFFFFFFFFFFFFFFul;
+        order[thread_id] = 0xFFFFFFFFu;
+        return;
+    }
+    VehicleState vehicle = vehicles[thread_id];
+    int lane = vehicle.leader_index == -2 ? -1 : vehicle.lane;
+    keys[thread_id] = lane_key(lane, vehicle.position);
+    order[thread_id] = thread_id;
+}
+
+// One compare-exchange pass of a bitonic sort of (key, slot)
+kernel void bitonic_sort_kernel(
+    device ulong* keys [[buffer(0)]],
+    device uint* order [[buffer(1)]],
+    constant uint& j [[buffer(2)]],
+    constant uint& k [[buffer(3)]],
+    uint thread_id [[thread_position_in_grid]])
+{
+    uint partner = thread_id ^ j;
+    if (partner <= thread_id) return;
+    ulong key = keys[thread_id];
+    ulong partner_key = keys[partner];
+    uint slot = order[thread_id];
+    uint partner_slot = order[partner];
+    bool greater = key > partner_key ||
+                   (key == partner_key && slot > partner_slot);
+    if (greater == ((thread_id & k) == 0)) {
+        keys[thread_id] = partner_key;
+        keys[partner] = key;
+        order[thread_id] = partner_slot;
+        order[partner] = slot;
+    }
+}
+
+// The slot at a position of the sort if on a lane, -1 otherwise
+inline int slot_on(device const ulong* keys, device const uint* order,
+                   uint k, uint n, int lane) {
+    return k < n && lane_of(keys[k]) == lane ? int(order[k]) : -1;
+}
+
+inline void neighbours_on(device const ulong* keys, device const uint* order,
+                          uint n, int lane, float position,
+                          thread int& leader, thread int& follower) {
+    leader = -1;
+    follower = -1;
+    if (lane < 0) return;
+    // Lower bound of the key
+    ulong key = lane_key(lane, position);
+    uint low = 0;
+    uint high = n;
+    while (low < high) {
+        uint middle = (low + high) / 2;
+        if (keys[middle] < key) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    leader = slot_on(keys, order, low, n, lane);
+    follower = low > 0 ? slot_on(keys, order, low - 1, n, lane) : -1;
+}
+
+kernel void link_neighbours_kernel(
+    device VehicleState* vehicles [[buffer(0)]],
+    device Neighbours* neighbours [[buffer(1)]],
+    device const ulong* keys [[buffer(2)]],
+    device const uint* order [[buffer(3)]],
+    constant uint& num_vehicles [[buffer(4)]],
+    device const int* lanes [[buffer(5)]],
+    constant int& num_lanes [[buffer(6)]],
+    uint thread_id [[thread_position_in_grid]])
+{
+    if (thread_id >= num_vehicles) return;
+    uint slot = order[thread_id];
+    Neighbours around = {-1, -1, -1, -1, -1};
+    int lane = lane_of(keys[thread_id]);
+    if (lane >= 0) {
+        device VehicleState& vehicle = vehicles[slot];
+        vehicle.leader_index =
+            slot_on(keys, order, thread_id + 1, num_vehicles, lane);
+        around.follower_index = thread_id > 0
+            ? slot_on(keys, order, thread_id - 1, num_vehicles, lane) : -1;
+        if (lane < num_lanes) {
+            neighbours_on(keys, order, num_vehicles, lanes[lane],
+                          vehicle.position, around.left_leader,
+                          around.left_follower);
+            neighbours_on(keys, order, num_vehicles, lanes[num_lanes + lane],
+                          vehicle.position, around.right_leader,
+                          around.right_follower);
+        }
+    }
+    neighbours[slot] = around;
+}
+
 // Helper functions for LWR
 inline float calculate_speed(float rho, float v_f, float rho_j) {
     if (rho >= rho_j) return 0.0f;
@@ -134,15 +297,11 @@ inline float calculate_flow(float rho, float v_f, float rho_j) {
     return rho * calculate_speed(rho, v_f, rho_j);
 }
 
+// The demand upstream against the supply downstream
 inline float calculate_flux(float rho_l, float rho_r, float v_f, float rho_j) {
     float rho_c = rho_j / 2.0f;
-    if (rho_l <= rho_c && rho_r <= rho_c) {
-        return min(calculate_flow(rho_l, v_f, rho_j), calculate_flow(rho_r, v_f, rho_j));
-    } else if (rho_l >= rho_c && rho_r >= rho_c) {
-        return min(calculate_flow(rho_l, v_f, rho_j), calculate_flow(rho_r, v_f, rho_j));
-    } else {
-        return calculate_flow(rho_c, v_f, rho_j);
-    }
+    return min(calculate_flow(min(rho_l, rho_c), v_f, rho_j),
+               calculate_flow(max(rho_r, rho_c), v_f, rho_j));
 }
 
 kernel void lwr_update_kernel(
@@ -228,9 +387,14 @@ bool MetalCompute::initialize(const std::string &shader_path) {
 
     // Create compute pipelines
     m_idm_pipeline = createPipeline("idm_acceleration_kernel");
+    m_idm_ensemble_pipeline =
+        createPipeline("idm_acceleration_ensemble_kernel");
     m_update_pipeline = createPipeline("update_positions_kernel");
     m_gaps_pipeline = createPipeline("calculate_gaps_kernel");
     m_lwr_pipeline = createPipeline("lwr_update_kernel");
+    m_keys_pipeline = createPipeline("lane_keys_kernel");
+    m_sort_pipeline = createPipeline("bitonic_sort_kernel");
+    m_link_pipeline = createPipeline("link_neighbours_kernel");
 
     if (!m_idm_pipeline || !m_update_pipeline || !m_gaps_pipeline) {
       std::cerr << "Failed to create compute pipelines" << std::endl;
@@ -258,21 +422,216 @@ void MetalCompute::uploadVehicles(
     }
 
     // Copy vehicle data to GPU
-    GPUVehicleState *gpu_vehicles =
-        (GPUVehicleState *)[m_vehicle_buffer contents];
+    packVehicles(vehicles, (GPUVehicleState *)[m_vehicle_buffer contents]);
+    m_num_vehicles = num_vehicles;
+  }
+}
 
-    for (size_t i = 0; i < num_vehicles; ++i) {
-      const auto &vehicle = vehicles[i];
-      gpu_vehicles[i].position = vehicle->getLanePosition();
-      gpu_vehicles[i].speed = vehicle->getSpeed();
-      gpu_vehicles[i].acceleration = 0.0f;
-      gpu_vehicles[i].leader_index = -1; // Will be set by calculateGaps
-      gpu_vehicles[i].gap = 0.0f;
-      gpu_vehicles[i].relative_speed = 0.0f;
+void MetalCompute::resizeVehicles(size_t num_vehicles) {
+  @autoreleasepool {
+    const size_t kept = std::min(num_vehicles, m_num_vehicles);
+    const size_t buffer_size = num_vehicles * sizeof(GPUVehicleState);
+    if (!m_vehicle_buffer || m_vehicle_buffer_size < buffer_size) {
+      id<MTLBuffer> buffer =
+          [m_device newBufferWithLength:std::max<size_t>(buffer_size, 1)
+                                options:MTLResourceStorageModeShared];
+      if (kept > 0) {
+        memcpy([buffer contents], [m_vehicle_buffer contents],
+               kept * sizeof(GPUVehicleState));
+      }
+      m_vehicle_buffer = buffer;
+      m_vehicle_buffer_size = buffer_size;
+    }
+    GPUVehicleState *states = (GPUVehicleState *)[m_vehicle_buffer contents];
+    std::fill(states + kept, states + num_vehicles, idleVehicle());
+    m_num_vehicles = num_vehicles;
+  }
+}
+
+void MetalCompute::writeVehicles(const GPUVehicleWrite *writes,
+                                 size_t count) {
+  // The kernels are done when they return: the buffer is free to write
+  GPUVehicleState *states =
+      count > 0 ? (GPUVehicleState *)[m_vehicle_buffer contents] : nullptr;
+  for (size_t i = 0; i < count; ++i) {
+    if (writes[i].index >= m_num_vehicles) {
+      throw std::out_of_range("Vehicle slot " +
+                              std::to_string(writes[i].index) +
+                              " out of the GPU slots");
+    }
+    states[writes[i].index] = writes[i].state;
+  }
+}
+
+void MetalCompute::writeLeaders(const GPULeaderWrite *writes, size_t count) {
+  GPUVehicleState *states =
+      count > 0 ? (GPUVehicleState *)[m_vehicle_buffer contents] : nullptr;
+  for (size_t i = 0; i < count; ++i) {
+    if (writes[i].index >= m_num_vehicles) {
+      throw std::out_of_range("Vehicle slot " +
+                              std::to_string(writes[i].index) +
+                              " out of the GPU slots");
     }
+    states[writes[i].index].leader_index = writes[i].leader_index;
   }
 }
 
+void MetalCompute::writeLanes(const GPULaneWrite *writes, size_t count) {
+  GPUVehicleState *states =
+      count > 0 ? (GPUVehicleState *)[m_vehicle_buffer contents] : nullptr;
+  for (size_t i = 0; i < count; ++i) {
+    if (writes[i].index >= m_num_vehicles) {
+      throw std::out_of_range("Vehicle slot " +
+                              std::to_string(writes[i].index) +
+                              " out of the GPU slots");
+    }
+    states[writes[i].index].lane = writes[i].lane;
+  }
+}
+
+void MetalCompute::setLaneNeighbours(const std::vector<int> &left,
+                                     const std::vector<int> &right) {
+  @autoreleasepool {
+    if (left.size() != right.size()) {
+      throw std::invalid_argument(
+          "Lane neighbours: one left and one right lane by lane");
+    }
+    std::vector<int> lanes(left);
+    lanes.insert(lanes.end(), right.begin(), right.end());
+    // A buffer is always bound, even without lanes
+    m_lanes_buffer = [m_device
+        newBufferWithLength:std::max<size_t>(lanes.size() * sizeof(int), 1)
+                    options:MTLResourceStorageModeShared];
+    if (!lanes.empty()) {
+      memcpy([m_lanes_buffer contents], lanes.data(),
+             lanes.size() * sizeof(int));
+    }
+    m_num_lanes = static_cast<int>(left.size());
+  }
+}
+
+void MetalCompute::sortVehicles(size_t num_vehicles) {
+  @autoreleasepool {
+    num_vehicles = std::min(num_vehicles, m_num_vehicles);
+    m_num_sorted = num_vehicles;
+    if (num_vehicles == 0) {
+      return;
+    }
+    size_t padded = 1;
+    while (padded < num_vehicles) {
+      padded *= 2;
+    }
+    if (m_sort_capacity < padded) {
+      m_keys_buffer =
+          [m_device newBufferWithLength:padded * sizeof(uint64_t)
+                                options:MTLResourceStorageModePrivate];
+      m_order_buffer =
+          [m_device newBufferWithLength:padded * sizeof(uint32_t)
+                                options:MTLResourceStorageModePrivate];
+      m_neighbours_buffer =
+          [m_device newBufferWithLength:padded * sizeof(GPUNeighbours)
+                                options:MTLResourceStorageModeShared];
+      m_sort_capacity = padded;
+    }
+    if (!m_lanes_buffer) {
+      setLaneNeighbours({}, {});
+    }
+
+    // All the passes in one command buffer, in order
+    id<MTLCommandBuffer> command_buffer = [m_command_queue commandBuffer];
+    id<MTLComputeCommandEncoder> encoder =
+        [command_buffer computeCommandEncoder];
+    const uint32_t count = static_cast<uint32_t>(num_vehicles);
+    const auto dispatch = [&](id<MTLComputePipelineState> pipeline,
+                              size_t num_threads) {
+      NSUInteger group = std::min<NSUInteger>(
+          pipeline.maxTotalThreadsPerThreadgroup, num_threads);
+      [encoder dispatchThreadgroups:MTLSizeMake(
+                                        (num_threads + group - 1) / group, 1, 1)
+              threadsPerThreadgroup:MTLSizeMake(group, 1, 1)];
+    };
+
+    [encoder setComputePipelineState:m_keys_pipeline];
+    [encoder setBuffer:m_vehicle_buffer offset:0 atIndex:0];
+    [encoder setBuffer:m_keys_buffer offset:0 atIndex:1];
+    [encoder setBuffer:m_order_buffer offset:0 atIndex:2];
+    [encoder setBytes:&count length:sizeof(uint32_t) atIndex:3];
+    dispatch(m_keys_pipeline, padded);
+
+    [encoder setComputePipelineState:m_sort_pipeline];
+    [encoder setBuffer:m_keys_buffer offset:0 atIndex:0];
+    [encoder setBuffer:m_order_buffer offset:0 atIndex:1];
+    for (uint32_t k = 2; k <= padded; k *= 2) {
+      for (uint32_t j = k / 2; j > 0; j /= 2) {
+        [encoder setBytes:&j length:sizeof(uint32_t) atIndex:2];
+        [encoder setBytes:&k length:sizeof(uint32_t) atIndex:3];
+        dispatch(m_sort_pipeline, padded);
+      }
+    }
+
+    [encoder setComputePipelineState:m_link_pipeline];
+    [encoder setBuffer:m_vehicle_buffer offset:0 atIndex:0];
+    [encoder setBuffer:m_neighbours_buffer offset:0 atIndex:1];
+    [encoder setBuffer:m_keys_buffer offset:0 atIndex:2];
+    [encoder setBuffer:m_order_buffer offset:0 atIndex:3];
+    [encoder setBytes:&count length:sizeof(uint32_t) atIndex:4];
+    [encoder setBuffer:m_lanes_buffer offset:0 atIndex:5];
+    [encoder setBytes:&m_num_lanes length:sizeof(int) atIndex:6];
+    dispatch(m_link_pipeline, num_vehicles);
+
+    [encoder endEncoding];
+    [command_buffer commit];
+    [command_buffer waitUntilCompleted];
+  }
+}
+
+void MetalCompute::downloadNeighbours(std::vector<GPUNeighbours> &neighbours) {
+  neighbours.resize(m_num_sorted);
+  if (m_num_sorted > 0) {
+    memcpy(neighbours.data(), [m_neighbours_buffer contents],
+           m_num_sorted * sizeof(GPUNeighbours));
+  }
+}
+
+void MetalCompute::requestSnapshot(size_t num_vehicles) {
+  @autoreleasepool {
+    const int next = m_snapshot == 0 ? 1 : 0;
+    const size_t buffer_size =
+        std::min(num_vehicles, m_num_vehicles) * sizeof(GPUVehicleState);
+    if (m_snapshot_commands[next]) {
+      [m_snapshot_commands[next] waitUntilCompleted];
+    }
+    if (!m_snapshot_buffers[next] ||
+        [m_snapshot_buffers[next] length] < buffer_size) {
+      m_snapshot_buffers[next] =
+          [m_device newBufferWithLength:std::max<size_t>(buffer_size, 1)
+                                options:MTLResourceStorageModeShared];
+    }
+
+    id<MTLCommandBuffer> command_buffer = [m_command_queue commandBuffer];
+    if (buffer_size > 0) {
+      id<MTLBlitCommandEncoder> blit = [command_buffer blitCommandEncoder];
+      [blit copyFromBuffer:m_vehicle_buffer
+               sourceOffset:0
+                   toBuffer:m_snapshot_buffers[next]
+          destinationOffset:0
+                       size:buffer_size];
+      [blit endEncoding];
+    }
+    [command_buffer commit];
+    m_snapshot_commands[next] = command_buffer;
+    m_snapshot = next;
+  }
+}
+
+const GPUVehicleState *MetalCompute::getSnapshot() {
+  if (m_snapshot < 0) {
+    return nullptr;
+  }
+  [m_snapshot_commands[m_snapshot] waitUntilCompleted];
+  return (const GPUVehicleState *)[m_snapshot_buffers[m_snapshot] contents];
+}
+
 void MetalCompute::downloadVehicles(
     std::vector<std::shared_ptr<kernel::model::Vehicle>> &vehicles) {
   @autoreleasepool {
@@ -308,6 +667,36 @@ void MetalCompute::setIDMParams(double desired_speed, double time_headway,
     params->max_accel = max_accel;
     params->comfortable_decel = comfortable_decel;
     params->accel_exponent = accel_exponent;
+    m_num_scenario_slots = 0;
+  }
+}
+
+void MetalCompute::setScenarioParams(
+    const std::vector<GPUIDMParams> &params,
+    const std::vector<std::uint32_t> &slot_scenarios) {
+  for (std::uint32_t scenario : slot_scenarios) {
+    if (scenario >= params.size()) {
+      throw std::invalid_argument("Scenario " + std::to_string(scenario) +
+                                  " out of the " +
+                                  std::to_string(params.size()) + " ones");
+    }
+  }
+  @autoreleasepool {
+    m_scenario_params_buffer = nil;
+    m_slot_scenarios_buffer = nil;
+    m_num_scenario_slots = 0;
+    if (slot_scenarios.empty()) {
+      return;
+    }
+    m_scenario_params_buffer =
+        [m_device newBufferWithBytes:params.data()
+                              length:params.size() * sizeof(GPUIDMParams)
+                             options:MTLResourceStorageModeShared];
+    m_slot_scenarios_buffer = [m_device
+        newBufferWithBytes:slot_scenarios.data()
+                    length:slot_scenarios.size() * sizeof(std::uint32_t)
+                   options:MTLResourceStorageModeShared];
+    m_num_scenario_slots = static_cast<uint32_t>(slot_scenarios.size());
   }
 }
 
@@ -317,13 +706,23 @@ void MetalCompute::computeIDMAccelerations(size_t num_vehicles) {
     id<MTLComputeCommandEncoder> encoder =
         [command_buffer computeCommandEncoder];
 
-    [encoder setComputePipelineState:m_idm_pipeline];
+    // The ensemble in the same dispatch, each slot with its scenario
+    id<MTLComputePipelineState> pipeline =
+        m_num_scenario_slots > 0 ? m_idm_ensemble_pipeline : m_idm_pipeline;
+    [encoder setComputePipelineState:pipeline];
     [encoder setBuffer:m_vehicle_buffer offset:0 atIndex:0];
     [encoder setBuffer:m_params_buffer offset:0 atIndex:1];
     [encoder setBytes:&num_vehicles length:sizeof(uint32_t) atIndex:2];
+    if (m_num_scenario_slots > 0) {
+      [encoder setBuffer:m_scenario_params_buffer offset:0 atIndex:3];
+      [encoder setBuffer:m_slot_scenarios_buffer offset:0 atIndex:4];
+      [encoder setBytes:&m_num_scenario_slots
+                 length:sizeof(uint32_t)
+                atIndex:5];
+    }
 
     // Calculate thread configuration
-    NSUInteger thread_group_size = m_idm_pipeline.maxTotalThreadsPerThreadgroup;
+    NSUInteger thread_group_size = pipeline.maxTotalThreadsPerThreadgroup;
     MTLSize threads_per_group = MTLSizeMake(thread_group_size, 1, 1);
     MTLSize num_thread_groups = MTLSizeMake(
         (num_vehicles + thread_group_size - 1) / thread_group_size, 1, 1);
@@ -11,9 +11,21 @@ struct VehicleState {
     float position;        // Lane position (m)
     float speed;           // Current speed (m/s)
     float acceleration;    // Current acceleration (m/s²)
-    int leader_index;      // Index of leader vehicle (-1 if none)
+    int leader_index;      // Index of leader vehicle (-1 if none, -2 idle)
     float gap;             // Gap to leader (m)
     float relative_speed;  // Relative speed to leader (m/s)
+    int lane;              // Lane (-1 if none)
+};
+
+/**
+ * @brief Neighbours of a vehicle, as slots (-1 if none).
+ */
+struct Neighbours {
+    int follower_index;
+    int left_leader;      // First vehicle at or ahead on the left lane
+    int left_follower;    // Last vehicle behind on the left lane
+    int right_leader;
+    int right_follower;
 };
 
 /**
@@ -47,28 +59,20 @@ inline float calculate_desired_gap(float speed, float speed_diff,
 }
 
 /**
- * @brief IDM acceleration kernel.
- *
- * Computes acceleration for all vehicles in parallel.
+ * @brief IDM acceleration of a vehicle.
  *
- * @param vehicles Input/output vehicle states
+ * @param vehicle Input/output vehicle state
  * @param params IDM parameters
- * @param num_vehicles Number of vehicles
- * @param thread_id Thread identifier
  */
-kernel void idm_acceleration_kernel(
-    device VehicleState* vehicles [[buffer(0)]],
-    constant IDMParams& params [[buffer(1)]],
-    constant uint& num_vehicles [[buffer(2)]],
-    uint thread_id [[thread_position_in_grid]])
+inline void idm_acceleration(device VehicleState& vehicle,
+                             constant IDMParams& params)
 {
-    // Bounds check
-    if (thread_id >= num_vehicles) {
+    // Slot without vehicle: keep still
+    if (vehicle.leader_index == -2) {
+        vehicle.acceleration = 0.0f;
         return;
     }
-    
-    // Get vehicle state
-    device VehicleState& vehicle = vehicles[thread_id];
+
     float v = vehicle.speed;
     float v0 = params.desired_speed;
     float a = params.max_accel;
@@ -107,6 +111,63 @@ kernel void idm_acceleration_kernel(
     vehicle.acceleration = clamp(vehicle.acceleration, -10.0f, 5.0f);
 }
 
+/**
+ * @brief IDM acceleration kernel.
+ *
+ * Computes acceleration for all vehicles in parallel.
+ *
+ * @param vehicles Input/output vehicle states
+ * @param params IDM parameters
+ * @param num_vehicles Number of vehicles
+ * @param thread_id Thread identifier
+ */
+kernel void idm_acceleration_kernel(
+    device VehicleState* vehicles [[buffer(0)]],
+    constant IDMParams& params [[buffer(1)]],
+    constant uint& num_vehicles [[buffer(2)]],
+    uint thread_id [[thread_position_in_grid]])
+{
+    // Bounds check
+    if (thread_id >= num_vehicles) {
+        return;
+    }
+    idm_acceleration(vehicles[thread_id], params);
+}
+
+/**
+ * @brief IDM acceleration kernel of an ensemble of scenarios.
+ *
+ * The slots of the ensemble take the parameters of their scenario, the
+ * other ones the parameters of setIDMParams().
+ *
+ * @param vehicles Input/output vehicle states
+ * @param params IDM parameters of the slots out of the ensemble
+ * @param num_vehicles Number of vehicles
+ * @param scenario_params IDM parameters of each scenario
+ * @param slot_scenarios Scenario of each slot of the ensemble
+ * @param num_scenario_slots Number of slots of the ensemble
+ * @param thread_id Thread identifier
+ */
+kernel void idm_acceleration_ensemble_kernel(
+    device VehicleState* vehicles [[buffer(0)]],
+    constant IDMParams& params [[buffer(1)]],
+    constant uint& num_vehicles [[buffer(2)]],
+    constant IDMParams* scenario_params [[buffer(3)]],
+    constant uint* slot_scenarios [[buffer(4)]],
+    constant uint& num_scenario_slots [[buffer(5)]],
+    uint thread_id [[thread_position_in_grid]])
+{
+    if (thread_id >= num_vehicles) {
+        return;
+    }
+    if (thread_id < num_scenario_slots) {
+        idm_acceleration(vehicles[thread_id],
+                         scenario_params[slot_scenarios[thread_id]]);
+    } else {
+        idm_acceleration(vehicles[thread_id], params);
+    }
+}
+
 /**
  * @brief Update vehicle positions kernel.
  *
@@ -176,6 +237,130 @@ kernel void calculate_gaps_kernel(
     }
 }
 
+/**
+ * @brief Sort of the vehicles by lane and position.
+ *
+ * lane_keys_kernel builds the keys (lane, position) of the slots, padded to
+ * a power of two; the passes of bitonic_sort_kernel sort them with their
+ * slots; link_neighbours_kernel derives from the order the leader and the
+ * follower of each vehicle, and by a binary search its neighbours on the
+ * adjacent lanes, the left ones then the right ones in lanes.
+ */
+// The key of the sort by lane: the lane, the ones without last, then the
+// bits of the position, flipped to order as floats
+inline ulong lane_key(int lane, float position) {
+    uint bits = as_type<uint>(position);
+    bits = (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+    return (ulong(uint(lane)) << 32) | ulong(bits);
+}
+
+inline int lane_of(ulong key) {
+    return int(uint(key >> 32));
+}
+
+kernel void lane_keys_kernel(
+    device const VehicleState* vehicles [[buffer(0)]],
+    device ulong* keys [[buffer(1)]],
+    device uint* order [[buffer(2)]],
+    constant uint& num_vehicles [[buffer(3)]],
+    uint thread_id [[thread_position_in_grid]])
+{
+    // Padded to a power of two by keys after all the others
+    if (thread_id >= num_vehicles) {
+        keys[thread_id] = 0xFFFFFFFFFFFFFFFFul;
+        order[thread_id] = 0xFFFFFFFFu;
+        return;
+    }
+    VehicleState vehicle = vehicles[thread_id];
+    int lane = vehicle.leader_index == -2 ? -1 : vehicle.lane;
+    keys[thread_id] = lane_key(lane, vehicle.position);
+    order[thread_id] = thread_id;
+}
+
+// One compare-exchange pass of a bitonic sort of (key, slot)
+kernel void bitonic_sort_kernel(
+    device ulong* keys [[buffer(0)]],
+    device uint* order [[buffer(1)]],
+    constant uint& j [[buffer(2)]],
+    constant uint& k [[buffer(3)]],
+    uint thread_id [[thread_position_in_grid]])
+{
+    uint partner = thread_id ^ j;
+    if (partner <= thread_id) return;
+    ulong key = keys[thread_id];
+    ulong partner_key = keys[partner];
+    uint slot = order[thread_id];
+    uint partner_slot = order[partner];
+    bool greater = key > partner_key ||
+                   (key == partner_key && slot > partner_slot);
+    if (greater == ((thread_id & k) == 0)) {
+        keys[thread_id] = partner_key;
+        keys[partner] = key;
+        order[thread_id] = partner_slot;
+        order[partner] = slot;
+    }
+}
+
+// The slot at a position of the sort if on a lane, -1 otherwise
+inline int slot_on(device const ulong* keys, device const uint* order,
+                   uint k, uint n, int lane) {
+    return k < n && lane_of(keys[k]) == lane ? int(order[k]) : -1;
+}
+
+inline void neighbours_on(device const ulong* keys, device const uint* order,
+                          uint n, int lane, float position,
+                          thread int& leader, thread int& follower) {
+    leader = -1;
+    follower = -1;
+    if (lane < 0) return;
+    // Lower bound of the key
+    ulong key = lane_key(lane, position);
+    uint low = 0;
+    uint high = n;
+    while (low < high) {
+        uint middle = (low + high) / 2;
+        if (keys[middle] < key) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    leader = slot_on(keys, order, low, n, lane);
+    follower = low > 0 ? slot_on(keys, order, low - 1, n, lane) : -1;
+}
+
+kernel void link_neighbours_kernel(
+    device VehicleState* vehicles [[buffer(0)]],
+    device Neighbours* neighbours [[buffer(1)]],
+    device const ulong* keys [[buffer(2)]],
+    device const uint* order [[buffer(3)]],
+    constant uint& num_vehicles [[buffer(4)]],
+    device const int* lanes [[buffer(5)]],
+    constant int& num_lanes [[buffer(6)]],
+    uint thread_id [[thread_position_in_grid]])
+{
+    if (thread_id >= num_vehicles) return;
+    uint slot = order[thread_id];
+    Neighbours around = {-1, -1, -1, -1, -1};
+    int lane = lane_of(keys[thread_id]);
+    if (lane >= 0) {
+        device VehicleState& vehicle = vehicles[slot];
+        vehicle.leader_index =
+            slot_on(keys, order, thread_id + 1, num_vehicles, lane);
+        around.follower_index = thread_id > 0
+            ? slot_on(keys, order, thread_id - 1, num_vehicles, lane) : -1;
+        if (lane < num_lanes) {
+            neighbours_on(keys, order, num_vehicles, lanes[lane],
+                          vehicle.position, around.left_leader,
+                          around.left_follower);
+            neighbours_on(keys, order, num_vehicles, lanes[num_lanes + lane],
+                          vehicle.position, around.right_leader,
+                          around.right_follower);
+        }
+    }
+    neighbours[slot] = around;
+}
+
 /**
  * @brief Macroscopic LWR update kernel.
  *
@@ -228,15 +413,11 @@ kernel void lwr_update_kernel(
         return rho * speed_from_density(rho, free_flow_speed, jam_density);
     };
     
-    // Godunov flux calculation
+    // Godunov flux calculation: the demand upstream against the supply
+    // downstream
     auto godunov_flux = [&](float rho_l, float rho_r) -> float {
-        if (rho_l <= rho_c && rho_r <= rho_c) {
-            return min(flow_from_density(rho_l), flow_from_density(rho_r));
-        } else if (rho_l >= rho_c && rho_r >= rho_c) {
-            return min(flow_from_density(rho_l), flow_from_density(rho_r));
-        } else {
-            return flow_from_density(rho_c);
-        }
+        return min(flow_from_density(min(rho_l, rho_c)),
+                   flow_from_density(max(rho_r, rho_c)));
     };
     
     // Calculate fluxes
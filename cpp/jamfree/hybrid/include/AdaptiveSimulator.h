@@ -1,13 +1,20 @@
 #ifndef JAMFREE_HYBRID_ADAPTIVE_SIMULATOR_H
 #define JAMFREE_HYBRID_ADAPTIVE_SIMULATOR_H
 
+#include "../../gpu/ComputeBackend.h"
 #include "../../kernel/include/model/Lane.h"
 #include "../../kernel/include/model/Road.h"
 #include "../../kernel/include/model/Vehicle.h"
+#include "../../macroscopic/include/FundamentalDiagramEstimator.h"
 #include "../../macroscopic/include/LWR.h"
+#include "../../macroscopic/include/MacroscopicBatch.h"
 #include "../../macroscopic/include/MicroMacroBridge.h"
 #include "../../microscopic/include/IDM.h"
+#include "../../../microkernel/include/engine/WorkStealingThreadPool.h"
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <shared_mutex>
 #include <unordered_map>
 #include <vector>
 
@@ -33,6 +40,47 @@ enum class SimulationMode {
  * - Use microscopic where detail matters (low density, critical areas)
  * - Use macroscopic where flow matters (high density, highways)
  * - Seamless transitions preserve traffic state
+ *
+ * The lanes in macroscopic mode are links of one LWRBatch, all updated by
+ * a single pass over their cells.
+ *
+ * With a frame budget, the modes follow a cost model instead of the
+ * thresholds: the update times of each lane in each mode are measured and
+ * smoothed, and each step the lanes run microscopically are the ones
+ * tracking the most vehicles per millisecond of microscopic update that
+ * keep the estimated time of the step within the budget.
+ *
+ * The lanes do not exchange vehicles: a step computes the metrics of all
+ * the lanes, then switches their modes, then updates the microscopic lanes
+ * and the cells of the macroscopic ones, each phase in parallel over the
+ * lanes when a thread pool is set.
+ *
+ * The microscopic updates run in chunks of a fixed number of lanes, or,
+ * with a rebalancing period, in tasks of about the same measured cost: the
+ * lanes are sorted by their smoothed update times every period, the
+ * costliest first, and grouped into a few tasks per thread.
+ *
+ * With a compute backend, the microscopic lanes are shared between the
+ * device and the threads: every device period, the lanes whose update is
+ * cheapest on the device relative to the host go to it, as long as the
+ * device finishes its batch before the threads finish theirs. The batch
+ * of the device is one more task of the parallel loop, so that the device
+ * steps its lanes while the other threads update theirs, and its
+ * vehicles are copied back into their lanes at the end of the step, where
+ * the metrics, the transitions and the exports read them. Until the
+ * device is measured, it takes the lanes of at least device_min_vehicles.
+ *
+ * With coarse_steps above 1, the free-flowing vehicles of the lanes on the
+ * threads are integrated at a multi-rate: a vehicle whose gap to its
+ * leader is at least coarse_min_gap and whose acceleration is within
+ * coarse_max_accel holds that acceleration for coarse_steps steps, then is
+ * integrated over them in one step (see kernel::model::Vehicle::defer). A
+ * vehicle is due when its held time is over, and the others are skipped
+ * without looking up their leaders or evaluating the IDM. The state read
+ * from a held vehicle is its state at the current step, so that its
+ * follower sees it as at the fine rate; a vehicle evaluated within
+ * coarse_min_gap of a held leader ends the hold of the leader, so that the
+ * interacting vehicles all run the fine step.
  */
 class AdaptiveSimulator {
 public:
@@ -53,6 +101,11 @@ public:
 
     // Macroscopic discretization
     int macro_num_cells = 50; ///< Cells for macroscopic model
+    // Steps between the updates of the macroscopic lanes, each advancing
+    // them by the time elapsed in sub-steps within their CFL condition; a
+    // lane switching mode in between gains or loses at most
+    // macro_period - 1 steps of macroscopic evolution
+    int macro_period = 1;
 
     // Hysteresis to prevent oscillation
     double hysteresis_factor = 1.2; ///< Prevent rapid switching
@@ -61,25 +114,32 @@ public:
     bool force_micro_intersections = true;
     bool force_micro_ramps = true;
 
+    // Cost model
+    double frame_budget_ms = 0.0; ///< Time of a step, 0 for the thresholds
+    double cost_smoothing = 0.2;  ///< Weight of a new measured time
+
+    // Load balancing of the microscopic updates over the threads
+    int rebalance_period = 0; ///< Steps between balancing, 0 for chunks
+
+    // Co-scheduling of the microscopic lanes with a compute backend
+    int device_period = 50;        ///< Steps between the lane assignments
+    int device_min_vehicles = 200; ///< Vehicles of a lane for the device,
+                                   ///< until the device is measured
+
+    // Multi-rate integration of the free-flowing vehicles
+    int coarse_steps = 1;           ///< Steps of a held vehicle, 1 for none
+    double coarse_min_gap = 150.0;  ///< Gap to the leader of a held vehicle
+    double coarse_max_accel = 0.2;  ///< Acceleration of a held vehicle (m/s²)
+
+    // LWR parameters of each lane from the fundamental diagram estimated
+    // online, instead of its speed limit and a fixed jam density
+    bool calibrate_online = false;
+    macroscopic::models::FundamentalDiagramEstimator::Config diagram;
+
     // Explicit default constructor
     Config() = default;
   };
 
-  /**
-   * @brief Stored vehicle data for micro-macro transitions.
-   *
-   * Preserves individual vehicle properties during macroscopic simulation
-   * to allow perfect reconstruction when switching back to microscopic.
-   */
-  struct VehicleData {
-    std::string id;
-    double position;     // Lane position (m)
-    double speed;        // Speed (m/s)
-    double acceleration; // Acceleration (m/s²)
-    double length;       // Vehicle length (m)
-    // Can add more: route, destination, driver characteristics, etc.
-  };
-
   /**
    * @brief Lane simulation state.
    */
@@ -89,12 +149,19 @@ public:
 
     // Microscopic state
     std::vector<std::shared_ptr<kernel::model::Vehicle>> vehicles;
+    // Vehicles by macroscopic cell, kept up to date through the moves
+    macroscopic::models::LaneProfile profile;
+
+    // Macroscopic state: link of the lane in getMacroscopicBatch()
+    std::size_t macro_link = macroscopic::models::CellBatch::NONE;
 
-    // Macroscopic state
-    std::unique_ptr<macroscopic::models::LWR> lwr_model;
+    // Fed by the profile in micro mode, with calibrate_online
+    macroscopic::models::FundamentalDiagramEstimator diagram;
+    std::uint64_t diagram_revision = 0; ///< Applied to the link
 
-    // Vehicle data preservation (stored during macro mode)
-    std::vector<VehicleData> stored_vehicle_data;
+    // Vehicles kept during macro mode, with all their properties, to be
+    // put back when switching back to microscopic
+    std::vector<std::shared_ptr<kernel::model::Vehicle>> stored_vehicles;
 
     // Metrics
     double current_density;
@@ -103,6 +170,14 @@ public:
     int vehicle_count;
     double last_update_time_ms;
 
+    // Cost model: smoothed update times, negative until measured
+    double micro_ms_per_vehicle;
+    double macro_ms;
+    double update_ms = -1.0; ///< Of the microscopic update, smoothed
+
+    // Stepped by the compute backend, while microscopic
+    bool on_device = false;
+
     // Transition state
     bool is_critical_area;
     int frames_since_transition;
@@ -133,13 +208,33 @@ public:
   /**
    * @brief Update all lanes for one time step.
    *
-   * Automatically switches between micro/macro as needed.
+   * Automatically switches between micro/macro as needed. The update holds
+   * getAccessMutex() alone.
    *
    * @param dt Time step (seconds)
    * @param idm IDM model for microscopic simulation
    */
   void update(double dt, const microscopic::models::IDM &idm);
 
+  /**
+   * @brief Set the number of threads updating the lanes.
+   *
+   * Used when no thread pool is lent by the caller of update().
+   * @param numThreads Number of threads (1 = sequential)
+   */
+  void setNumThreads(std::size_t numThreads);
+
+  /**
+   * @brief Set the backend stepping part of the microscopic lanes, or none
+   * for the threads only.
+   *
+   * The device runs its own IDM kernels in single precision, with the
+   * parameters of the IDM given to update().
+   *
+   * @throws std::runtime_error If the backend cannot be initialized
+   */
+  void setComputeBackend(std::shared_ptr<gpu::IComputeBackend> backend);
+
   /**
    * @brief Get current mode for a lane.
    *
@@ -156,6 +251,18 @@ public:
    */
   const LaneState *getLaneState(const std::string &lane_id) const;
 
+  /**
+   * @brief Get the fundamental diagram estimated for a lane, e.g. to feed
+   * it with the reports of its loop detectors, while in macroscopic mode.
+   *
+   * With calibrate_online, its new estimates are applied to the LWR cells
+   * of the lane at the next update.
+   *
+   * @return nullptr if the lane is not registered
+   */
+  macroscopic::models::FundamentalDiagramEstimator *
+  getFundamentalDiagram(const std::string &lane_id);
+
   /**
    * @brief Get overall statistics.
    *
@@ -166,14 +273,32 @@ public:
     int micro_lanes;
     int macro_lanes;
     int transitioning_lanes;
+    int device_lanes; ///< Microscopic lanes stepped by the compute backend
+    int held_vehicles; ///< Integrated at the coarse rate (see coarse_steps)
     int total_vehicles;
     double avg_density;
     double total_update_time_ms;
+    double estimated_update_time_ms; ///< Of the current modes, by the costs
     double speedup_factor;
   };
 
   Statistics getStatistics() const;
 
+  /**
+   * @brief Write the states of the vehicles of the lanes in microscopic
+   * mode, in the rows of kernel::model::exportVehicleStates().
+   *
+   * @param rows Set to one row by vehicle, numbered across the lanes
+   */
+  void exportVehicleStates(std::vector<double> &rows) const;
+
+  /**
+   * @brief Get the LWR cells of the lanes in macroscopic mode.
+   */
+  const macroscopic::models::LWRBatch &getMacroscopicBatch() const {
+    return m_macro;
+  }
+
   /**
    * @brief Force a lane to microscopic mode.
    *
@@ -195,9 +320,64 @@ public:
    */
   void allowAutomatic(const std::string &lane_id);
 
+  /**
+   * @brief Get the lock of the Python bindings, whose calls the
+   * free-threaded build runs in parallel: the queries share it and the
+   * updates hold it alone. update() holds it alone itself; the other
+   * methods of the simulator do not take it.
+   */
+  std::shared_mutex &getAccessMutex() const { return m_access.mutex; }
+
 private:
+  // The lock of the bindings, a new one for each copy of the simulator
+  struct AccessMutex {
+    mutable std::shared_mutex mutex;
+
+    AccessMutex() = default;
+    AccessMutex(const AccessMutex &) {}
+    AccessMutex &operator=(const AccessMutex &) { return *this; }
+  };
+
+  AccessMutex m_access;
   Config m_config;
   std::unordered_map<std::string, LaneState> m_lane_states;
+  macroscopic::models::LWRBatch m_macro;
+
+  // Costs of the lanes not measured in a mode yet: the mean costs of the
+  // lanes measured, negative if none
+  double m_micro_ms_per_vehicle = -1.0;
+  double m_macro_ms_per_cell = -1.0;
+
+  // Densities of the lane switching to macroscopic mode
+  std::vector<double> m_profile;
+
+  // Steps and time since the last update of the macroscopic lanes
+  int m_macro_steps = 0;
+  double m_macro_elapsed = 0.0;
+
+  // The lanes of m_lane_states, in the order of the parallel loops
+  std::vector<LaneState *> m_lane_order;
+
+  // The lanes by decreasing update cost, and the first lane of each task of
+  // the microscopic updates, then their number, with a rebalancing period
+  std::vector<LaneState *> m_balanced_order;
+  std::vector<std::size_t> m_task_starts;
+  int m_steps_since_balance = 0;
+  std::shared_ptr<fr::univ_artois::lgi2a::similar::microkernel::engine::
+                      WorkStealingThreadPool>
+      m_pool;
+
+  // The compute backend, its update time by vehicle, smoothed, negative
+  // until measured, and the steps since the last assignment of the lanes
+  std::shared_ptr<gpu::IComputeBackend> m_backend;
+  double m_device_ms_per_vehicle = -1.0;
+  int m_steps_since_assignment = -1;
+
+  // The lanes of the device in the current step, and their vehicles with
+  // their positions and speeds before the step
+  std::vector<LaneState *> m_device_lanes;
+  std::vector<std::shared_ptr<kernel::model::Vehicle>> m_device_vehicles;
+  std::vector<double> m_device_moves;
 
   /**
    * @brief Evaluate if lane should switch modes.
@@ -207,6 +387,43 @@ private:
    */
   bool shouldSwitchMode(LaneState &state);
 
+  /**
+   * @brief Set the costs of the lanes not measured in a mode yet.
+   */
+  void updateFleetCosts();
+
+  /**
+   * @brief Group the lanes into tasks of about the same update cost.
+   */
+  void balanceLanes();
+
+  /**
+   * @brief Share the microscopic lanes between the device and the threads,
+   * so that the two finish their updates at about the same time.
+   */
+  void assignDevices();
+
+  /**
+   * @brief Update the lanes of the device, as one batch.
+   */
+  void updateOnDevice(double dt, const microscopic::models::IDM &idm);
+
+  /**
+   * @brief Switch the lanes to the modes that track the most vehicles
+   * within the frame budget.
+   */
+  void selectModes();
+
+  /**
+   * @brief Estimate the update time of a lane in microscopic mode (ms).
+   */
+  double estimateMicroCost(const LaneState &state) const;
+
+  /**
+   * @brief Estimate the update time of a lane in macroscopic mode (ms).
+   */
+  double estimateMacroCost(const LaneState &state) const;
+
   /**
    * @brief Transition from microscopic to macroscopic.
    *
@@ -231,17 +448,12 @@ private:
   void updateMicroscopic(LaneState &state, double dt,
                          const microscopic::models::IDM &idm);
 
-  /**
-   * @brief Update lane in macroscopic mode.
-   *
-   * @param state Lane state
-   * @param dt Time step
-   */
-  void updateMacroscopic(LaneState &state, double dt);
-
   /**
    * @brief Update lane metrics.
    *
+   * Also folds the update time of the lane in the previous step into the
+   * costs of its mode.
+   *
    * @param state Lane state
    */
   void updateMetrics(LaneState &state);
@@ -1,10 +1,44 @@
 #include "../include/AdaptiveSimulator.h"
+#include "../../kernel/include/model/VehicleStateExport.h"
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
 
 namespace jamfree {
 namespace hybrid {
 
+using fr::univ_artois::lgi2a::similar::microkernel::engine::
+    WorkStealingThreadPool;
+
+namespace {
+
+// Lanes by task of the parallel loops, of up to hundreds of vehicles
+constexpr std::size_t LANE_CHUNK_SIZE = 8;
+
+// Tasks of the balanced microscopic updates, by thread
+constexpr std::size_t TASKS_PER_THREAD = 4;
+
+// Macroscopic lanes by task, of tens of cells
+constexpr std::size_t MACRO_CHUNK_SIZE = 64;
+
+// Frames a lane stays in a mode before switching again (~3 s at 10 FPS)
+constexpr int MIN_FRAMES_IN_MODE = 30;
+
+// Shortest road simulated macroscopically (m)
+constexpr double MIN_MACRO_ROAD_LENGTH = 100.0;
+
+// Exponential smoothing of a cost, set by its first measure
+void smoothCost(double &cost, double measured, double weight) {
+  cost = cost < 0.0 ? measured : cost + weight * (measured - cost);
+}
+
+} // namespace
+
 void AdaptiveSimulator::registerLane(
     const std::shared_ptr<kernel::model::Lane> &lane, bool is_critical) {
 
@@ -16,48 +50,401 @@ void AdaptiveSimulator::registerLane(
   state.flow = 0.0;
   state.vehicle_count = 0;
   state.last_update_time_ms = 0.0;
+  state.micro_ms_per_vehicle = -1.0;
+  state.macro_ms = -1.0;
   state.is_critical_area = is_critical || isCriticalArea(lane);
   state.frames_since_transition = 0;
   state.force_mode = false;
 
   // Get existing vehicles
   state.vehicles = lane->getVehicles();
+  if (lane->getLength() > 0.0 && m_config.macro_num_cells > 0) {
+    state.profile = macroscopic::models::LaneProfile(
+        lane->getLength(), m_config.macro_num_cells);
+  }
+  state.profile.rebuild(*lane);
+  if (m_config.calibrate_online) {
+    state.diagram =
+        macroscopic::models::FundamentalDiagramEstimator(m_config.diagram);
+  }
 
+  // The cells of the lane registered before
+  auto it = m_lane_states.find(lane->getId());
+  if (it != m_lane_states.end() && m_macro.hasLink(it->second.macro_link)) {
+    m_macro.removeLink(it->second.macro_link);
+  }
   m_lane_states[lane->getId()] = std::move(state);
 }
 
 void AdaptiveSimulator::update(double dt, const microscopic::models::IDM &idm) {
+  const std::unique_lock<std::shared_mutex> access(m_access.mutex);
+  std::unique_ptr<WorkStealingThreadPool::Scope> scope;
+  if (m_pool && WorkStealingThreadPool::currentSize() == 1) {
+    scope = std::make_unique<WorkStealingThreadPool::Scope>(m_pool.get());
+  }
+  m_lane_order.clear();
   for (auto &[lane_id, state] : m_lane_states) {
-    auto start = std::chrono::high_resolution_clock::now();
+    m_lane_order.push_back(&state);
+  }
 
-    // Update metrics
-    updateMetrics(state);
+  WorkStealingThreadPool::parallelForOnCurrent(
+      m_lane_order.size(), LANE_CHUNK_SIZE,
+      [this](std::size_t begin, std::size_t end, std::size_t) {
+        for (std::size_t i = begin; i < end; ++i) {
+          updateMetrics(*m_lane_order[i]);
+        }
+      });
+  updateFleetCosts();
+
+  // Check if mode switches needed
+  if (m_config.frame_budget_ms > 0.0) {
+    selectModes();
+  } else {
+    for (LaneState *state : m_lane_order) {
+      if (!shouldSwitchMode(*state)) {
+        continue;
+      }
+      if (state->mode == SimulationMode::MICROSCOPIC) {
+        transitionToMacro(*state);
+      } else if (state->mode == SimulationMode::MACROSCOPIC) {
+        transitionToMicro(*state);
+      }
+    }
+  }
 
-    // Check if mode switch needed
-    if (shouldSwitchMode(state)) {
-      if (state.mode == SimulationMode::MICROSCOPIC) {
-        transitionToMacro(state);
-      } else if (state.mode == SimulationMode::MACROSCOPIC) {
-        transitionToMicro(state);
+  // The lanes of the device for this step, updated by the first task
+  m_device_lanes.clear();
+  if (m_backend) {
+    if (m_steps_since_assignment < 0 ||
+        ++m_steps_since_assignment >= std::max(1, m_config.device_period)) {
+      assignDevices();
+    }
+    for (LaneState *state : m_lane_order) {
+      if (state->on_device && state->mode == SimulationMode::MICROSCOPIC) {
+        m_device_lanes.push_back(state);
       }
     }
+  }
+  const std::size_t device_tasks = m_device_lanes.empty() ? 0 : 1;
 
-    // Update based on current mode
+  // Update based on current mode, the macroscopic lanes all at once
+  auto updateLane = [this, dt, &idm](LaneState &state) {
+    if (state.on_device && state.mode == SimulationMode::MICROSCOPIC &&
+        !m_device_lanes.empty()) {
+      return; // Updated by the device task
+    }
+    state.last_update_time_ms = 0.0;
     if (state.mode == SimulationMode::MICROSCOPIC) {
+      auto start = std::chrono::high_resolution_clock::now();
       updateMicroscopic(state, dt, idm);
-    } else if (state.mode == SimulationMode::MACROSCOPIC) {
-      updateMacroscopic(state, dt);
+      auto end_time = std::chrono::high_resolution_clock::now();
+      state.last_update_time_ms =
+          std::chrono::duration<double, std::milli>(end_time - start).count();
+    }
+    state.frames_since_transition++;
+  };
+  if (m_config.rebalance_period > 0) {
+    if (m_task_starts.empty() ||
+        m_balanced_order.size() != m_lane_order.size() ||
+        ++m_steps_since_balance >= m_config.rebalance_period) {
+      balanceLanes();
     }
+    WorkStealingThreadPool::parallelForOnCurrent(
+        device_tasks + m_task_starts.size() - 1, 1,
+        [this, dt, &idm, &updateLane, device_tasks](
+            std::size_t begin, std::size_t end, std::size_t) {
+          for (std::size_t task = begin; task < end; ++task) {
+            if (task < device_tasks) {
+              updateOnDevice(dt, idm);
+              continue;
+            }
+            const std::size_t t = task - device_tasks;
+            for (std::size_t i = m_task_starts[t]; i < m_task_starts[t + 1];
+                 ++i) {
+              LaneState &state = *m_balanced_order[i];
+              updateLane(state);
+              if (state.mode == SimulationMode::MICROSCOPIC &&
+                  !state.on_device) {
+                smoothCost(state.update_ms, state.last_update_time_ms,
+                           m_config.cost_smoothing);
+              }
+            }
+          }
+        });
+  } else {
+    const std::size_t chunks =
+        (m_lane_order.size() + LANE_CHUNK_SIZE - 1) / LANE_CHUNK_SIZE;
+    WorkStealingThreadPool::parallelForOnCurrent(
+        device_tasks + chunks, 1,
+        [this, dt, &idm, &updateLane, device_tasks](
+            std::size_t begin, std::size_t end, std::size_t) {
+          for (std::size_t task = begin; task < end; ++task) {
+            if (task < device_tasks) {
+              updateOnDevice(dt, idm);
+              continue;
+            }
+            const std::size_t first = (task - device_tasks) * LANE_CHUNK_SIZE;
+            const std::size_t last =
+                std::min(first + LANE_CHUNK_SIZE, m_lane_order.size());
+            for (std::size_t i = first; i < last; ++i) {
+              updateLane(*m_lane_order[i]);
+            }
+          }
+        });
+  }
 
-    // Track update time
+  // The estimates fed since the last update, by the detectors
+  if (m_config.calibrate_online) {
+    for (LaneState *state : m_lane_order) {
+      if (state->mode != SimulationMode::MACROSCOPIC ||
+          state->diagram_revision == state->diagram.getRevision()) {
+        continue;
+      }
+      state->diagram_revision = state->diagram.getRevision();
+      const auto estimate = state->diagram.getEstimate();
+      if (estimate.fitted && m_macro.hasLink(state->macro_link)) {
+        m_macro.setParameters(state->macro_link, estimate.free_flow_speed,
+                              estimate.jam_density);
+      }
+    }
+  }
+
+  // The macroscopic lanes once every macro_period steps, by the time
+  // elapsed since their last update
+  const std::size_t macro_lanes = m_macro.getNumLinks();
+  m_macro_elapsed += dt;
+  if (macro_lanes == 0) {
+    m_macro_steps = 0;
+    m_macro_elapsed = 0.0;
+  } else if (++m_macro_steps >= m_config.macro_period) {
+    const double macro_dt = m_macro_elapsed;
+    m_macro_steps = 0;
+    m_macro_elapsed = 0.0;
+    auto start = std::chrono::high_resolution_clock::now();
+    WorkStealingThreadPool::parallelForOnCurrent(
+        macro_lanes, MACRO_CHUNK_SIZE,
+        [this, macro_dt](std::size_t begin, std::size_t end, std::size_t) {
+          m_macro.advance(macro_dt, begin, end);
+        });
     auto end = std::chrono::high_resolution_clock::now();
-    state.last_update_time_ms =
-        std::chrono::duration<double, std::milli>(end - start).count();
+    // The time of the batch, shared by its lanes
+    const double share =
+        std::chrono::duration<double, std::milli>(end - start).count() /
+        macro_lanes;
+    for (LaneState *state : m_lane_order) {
+      if (state->mode == SimulationMode::MACROSCOPIC) {
+        state->last_update_time_ms += share;
+      }
+    }
+  }
+}
 
-    state.frames_since_transition++;
+void AdaptiveSimulator::setNumThreads(std::size_t numThreads) {
+  if (numThreads > 1) {
+    m_pool = std::make_shared<WorkStealingThreadPool>(numThreads);
+  } else {
+    m_pool.reset();
+  }
+}
+
+void AdaptiveSimulator::setComputeBackend(
+    std::shared_ptr<gpu::IComputeBackend> backend) {
+  if (backend && !backend->initialize("")) {
+    throw std::runtime_error("The compute backend " +
+                             backend->getDeviceName() +
+                             " cannot be initialized");
+  }
+  m_backend = std::move(backend);
+  m_device_ms_per_vehicle = -1.0;
+  m_steps_since_assignment = -1;
+  for (auto &[lane_id, state] : m_lane_states) {
+    state.on_device = false;
+  }
+}
+
+void AdaptiveSimulator::assignDevices() {
+  m_steps_since_assignment = 0;
+  std::vector<LaneState *> lanes;
+  for (LaneState *state : m_lane_order) {
+    state->on_device = false;
+    if (state->mode == SimulationMode::MICROSCOPIC) {
+      lanes.push_back(state);
+    }
+  }
+
+  // The long dense lanes until the device is measured
+  if (m_device_ms_per_vehicle < 0.0) {
+    for (LaneState *state : lanes) {
+      state->on_device =
+          state->vehicle_count >= std::max(1, m_config.device_min_vehicles);
+    }
+    return;
+  }
+  auto deviceCost = [this](const LaneState *state) {
+    return m_device_ms_per_vehicle * std::max(1, state->vehicle_count);
+  };
+
+  // Without other thread, the device waits for nothing: each lane goes
+  // where it is cheaper
+  const std::size_t num_threads = WorkStealingThreadPool::currentSize();
+  if (num_threads <= 1) {
+    for (LaneState *state : lanes) {
+      state->on_device = deviceCost(state) < estimateMicroCost(*state);
+    }
+    return;
+  }
+
+  // Otherwise the lanes by decreasing gain of the device, the first ones
+  // to it, up to the split ending both sides the soonest, the thread of
+  // the device taking no lane of its own
+  std::vector<double> cpu_ms(lanes.size());
+  std::vector<double> device_ms(lanes.size());
+  std::vector<std::size_t> order(lanes.size());
+  for (std::size_t i = 0; i < lanes.size(); ++i) {
+    cpu_ms[i] = estimateMicroCost(*lanes[i]);
+    device_ms[i] = deviceCost(lanes[i]);
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&](std::size_t a, std::size_t b) {
+                     return cpu_ms[a] * device_ms[b] > cpu_ms[b] * device_ms[a];
+                   });
+  const double workers = static_cast<double>(num_threads - 1);
+  double cpu_left =
+      std::accumulate(cpu_ms.begin(), cpu_ms.end(), 0.0) / workers;
+  double device_total = 0.0;
+  double best = cpu_left;
+  std::size_t best_split = 0;
+  for (std::size_t k = 0; k < order.size(); ++k) {
+    device_total += device_ms[order[k]];
+    cpu_left -= cpu_ms[order[k]] / workers;
+    const double makespan = std::max(device_total, cpu_left);
+    if (makespan < best) {
+      best = makespan;
+      best_split = k + 1;
+    }
+  }
+  for (std::size_t k = 0; k < best_split; ++k) {
+    lanes[order[k]]->on_device = true;
+  }
+}
+
+void AdaptiveSimulator::updateOnDevice(double dt,
+                                       const microscopic::models::IDM &idm) {
+  auto start = std::chrono::high_resolution_clock::now();
+  // The vehicles of a lane consecutive, in the order of their positions
+  m_device_vehicles.clear();
+  m_device_moves.clear();
+  for (LaneState *state : m_device_lanes) {
+    for (const auto &vehicle : state->vehicles) {
+      m_device_vehicles.push_back(vehicle);
+      m_device_moves.push_back(vehicle->getLanePosition());
+      m_device_moves.push_back(vehicle->getSpeed());
+    }
+  }
+  const std::size_t num_vehicles = m_device_vehicles.size();
+  if (num_vehicles > 0) {
+    m_backend->setIDMParams(idm.getDesiredSpeed(), idm.getTimeHeadway(),
+                            idm.getMinGap(), idm.getMaxAccel(),
+                            idm.getComfortableDecel(),
+                            idm.getAccelExponent());
+    m_backend->uploadVehicles(m_device_vehicles);
+    m_backend->simulationStep(num_vehicles, dt);
+    m_backend->downloadVehicles(m_device_vehicles);
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  const double elapsed_ms =
+      std::chrono::duration<double, std::milli>(end - start).count();
+
+  // The states copied back into the lanes, sorted again as on the host;
+  // the time of the batch is shared by its lanes by their vehicles
+  std::size_t i = 0;
+  for (LaneState *state : m_device_lanes) {
+    for (const auto &vehicle : state->vehicles) {
+      state->profile.move(m_device_moves[2 * i], m_device_moves[2 * i + 1],
+                          vehicle->getLanePosition(), vehicle->getSpeed());
+      ++i;
+    }
+    state->last_update_time_ms =
+        num_vehicles > 0 ? elapsed_ms * state->vehicles.size() / num_vehicles
+                         : 0.0;
+    state->lane->sortVehicles();
+    state->vehicles = state->lane->getVehicles();
+    if (m_config.calibrate_online) {
+      state->diagram.observe(state->profile);
+    }
+    state->frames_since_transition++;
+  }
+  if (num_vehicles > 0) {
+    smoothCost(m_device_ms_per_vehicle, elapsed_ms / num_vehicles,
+               m_config.cost_smoothing);
   }
 }
 
+void AdaptiveSimulator::updateFleetCosts() {
+  double micro_total = 0.0;
+  double macro_total = 0.0;
+  int micro_lanes = 0;
+  int macro_lanes = 0;
+  for (const LaneState *state : m_lane_order) {
+    if (state->micro_ms_per_vehicle >= 0.0) {
+      micro_total += state->micro_ms_per_vehicle;
+      ++micro_lanes;
+    }
+    if (state->macro_ms >= 0.0) {
+      macro_total += state->macro_ms;
+      ++macro_lanes;
+    }
+  }
+  m_micro_ms_per_vehicle = micro_lanes > 0 ? micro_total / micro_lanes : -1.0;
+  m_macro_ms_per_cell =
+      macro_lanes > 0
+          ? macro_total / (macro_lanes * std::max(1, m_config.macro_num_cells))
+          : -1.0;
+}
+
+void AdaptiveSimulator::balanceLanes() {
+  m_steps_since_balance = 0;
+  // The lanes not measured yet, or macroscopic, cost nothing to update
+  auto cost = [](const LaneState *state) {
+    return state->mode == SimulationMode::MICROSCOPIC && !state->on_device
+               ? std::max(state->update_ms, 0.0)
+               : 0.0;
+  };
+  m_balanced_order = m_lane_order;
+  std::stable_sort(m_balanced_order.begin(), m_balanced_order.end(),
+                   [&cost](const LaneState *a, const LaneState *b) {
+                     return cost(a) > cost(b);
+                   });
+  double total = 0.0;
+  for (const LaneState *state : m_balanced_order) {
+    total += cost(state);
+  }
+
+  // The costliest lanes alone, the cheaper ones together, in uniform chunks
+  // until measured
+  m_task_starts.clear();
+  const std::size_t lanes = m_balanced_order.size();
+  if (!(total > 0.0)) {
+    for (std::size_t i = 0; i < lanes; i += LANE_CHUNK_SIZE) {
+      m_task_starts.push_back(i);
+    }
+    m_task_starts.push_back(lanes);
+    return;
+  }
+  const double target =
+      total / (WorkStealingThreadPool::currentSize() * TASKS_PER_THREAD);
+  double task_cost = 0.0;
+  for (std::size_t i = 0; i < lanes; ++i) {
+    if (m_task_starts.empty() || task_cost >= target) {
+      m_task_starts.push_back(i);
+      task_cost = 0.0;
+    }
+    task_cost += cost(m_balanced_order[i]);
+  }
+  m_task_starts.push_back(lanes);
+}
+
 bool AdaptiveSimulator::shouldSwitchMode(LaneState &state) {
   // Don't switch if forced mode
   if (state.force_mode) {
@@ -70,7 +457,7 @@ bool AdaptiveSimulator::shouldSwitchMode(LaneState &state) {
   }
 
   // Prevent rapid oscillation (hysteresis)
-  if (state.frames_since_transition < 30) { // ~3 seconds at 10 FPS
+  if (state.frames_since_transition < MIN_FRAMES_IN_MODE) {
     return false;
   }
 
@@ -79,7 +466,8 @@ bool AdaptiveSimulator::shouldSwitchMode(LaneState &state) {
     // For long roads, switch to macro if density is high
     // For short roads/crossings, stay in micro
     auto parent_road = state.lane->getParentRoad();
-    bool is_long_road = parent_road && parent_road->getLength() >= 100.0;
+    bool is_long_road =
+        parent_road && parent_road->getLength() >= MIN_MACRO_ROAD_LENGTH;
 
     if (!is_long_road) {
       return false; // Short roads always stay micro
@@ -105,45 +493,115 @@ bool AdaptiveSimulator::shouldSwitchMode(LaneState &state) {
   return false;
 }
 
+void AdaptiveSimulator::selectModes() {
+  struct Candidate {
+    LaneState *state;
+    double fidelity; // Vehicles tracked in microscopic mode
+    double extra_ms; // Microscopic over macroscopic update time
+  };
+  std::vector<Candidate> candidates;
+  candidates.reserve(m_lane_states.size());
+
+  // The lanes that keep their mode, the others in macroscopic mode first
+  double used_ms = 0.0;
+  for (auto &[lane_id, state] : m_lane_states) {
+    const double micro_ms = estimateMicroCost(state);
+    const double macro_ms = estimateMacroCost(state);
+    auto parent_road = state.lane->getParentRoad();
+    const bool fixed =
+        state.force_mode ||
+        (state.is_critical_area && m_config.force_micro_intersections) ||
+        !parent_road || parent_road->getLength() < MIN_MACRO_ROAD_LENGTH ||
+        state.frames_since_transition < MIN_FRAMES_IN_MODE;
+    if (fixed) {
+      used_ms +=
+          state.mode == SimulationMode::MACROSCOPIC ? macro_ms : micro_ms;
+    } else {
+      used_ms += macro_ms;
+      candidates.push_back({&state, state.vehicle_count + 1.0,
+                            std::max(0.0, micro_ms - macro_ms)});
+    }
+  }
+
+  // Then the most vehicles by millisecond in microscopic mode that fit
+  std::sort(candidates.begin(), candidates.end(),
+            [](const Candidate &a, const Candidate &b) {
+              return a.fidelity * b.extra_ms > b.fidelity * a.extra_ms;
+            });
+  for (const Candidate &candidate : candidates) {
+    LaneState &state = *candidate.state;
+    const bool micro =
+        used_ms + candidate.extra_ms <= m_config.frame_budget_ms;
+    if (micro) {
+      used_ms += candidate.extra_ms;
+    }
+    if (micro && state.mode == SimulationMode::MACROSCOPIC) {
+      transitionToMicro(state);
+    } else if (!micro && state.mode == SimulationMode::MICROSCOPIC) {
+      transitionToMacro(state);
+    }
+  }
+}
+
+double AdaptiveSimulator::estimateMicroCost(const LaneState &state) const {
+  const double per_vehicle = state.micro_ms_per_vehicle >= 0.0
+                                 ? state.micro_ms_per_vehicle
+                                 : std::max(0.0, m_micro_ms_per_vehicle);
+  return per_vehicle * std::max(1, state.vehicle_count);
+}
+
+double AdaptiveSimulator::estimateMacroCost(const LaneState &state) const {
+  if (state.macro_ms >= 0.0) {
+    return state.macro_ms;
+  }
+  return std::max(0.0, m_macro_ms_per_cell) * m_config.macro_num_cells;
+}
+
 void AdaptiveSimulator::transitionToMacro(LaneState &state) {
   std::cout << "Lane " << state.lane->getId()
             << ": Transitioning to MACROSCOPIC (density="
             << state.current_density << ", vehicles=" << state.vehicle_count
-            << ")" << std::endl;
+            << ")\n";
 
-  // Store vehicle data for later reconstruction
-  state.stored_vehicle_data.clear();
-  for (const auto &vehicle : state.vehicles) {
-    VehicleData vdata;
-    vdata.id = vehicle->getId();
-    vdata.position = vehicle->getLanePosition();
-    vdata.speed = vehicle->getSpeed();
-    vdata.acceleration = vehicle->getAcceleration();
-    vdata.length = vehicle->getLength();
-    state.stored_vehicle_data.push_back(vdata);
-  }
-
-  std::cout << "  Stored " << state.stored_vehicle_data.size()
-            << " vehicle data records" << std::endl;
+  // Keep the vehicles for later reconstruction, the storage of each
+  // vector being reused by the next transitions
+  state.stored_vehicles.swap(state.vehicles);
+  state.vehicles.clear();
 
-  // Create LWR model
-  state.lwr_model = std::make_unique<macroscopic::models::LWR>(
-      state.lane->getSpeedLimit(),
-      0.15, // jam_density
-      state.lane->getLength(), m_config.macro_num_cells);
+  std::cout << "  Stored " << state.stored_vehicles.size() << " vehicles\n";
+
+  // Create the LWR cells of the lane
+  const int num_cells = m_config.macro_num_cells;
+  double free_flow_speed = state.lane->getSpeedLimit();
+  double jam_density = 0.15;
+  if (m_config.calibrate_online) {
+    const auto estimate = state.diagram.getEstimate();
+    if (estimate.fitted) {
+      free_flow_speed = estimate.free_flow_speed;
+      jam_density = estimate.jam_density;
+    }
+    state.diagram_revision = state.diagram.getRevision();
+  }
+  state.macro_link = m_macro.addLink(free_flow_speed, jam_density,
+                                     state.lane->getLength(), num_cells);
 
   // Initialize LWR from microscopic state
-  macroscopic::models::MicroMacroBridge::initializeLWRFromLane(
-      state.lane, *state.lwr_model);
+  m_profile.resize(num_cells);
+  if (state.profile.getNumCells() == num_cells) {
+    state.profile.getDensities(m_profile.data());
+  } else {
+    macroscopic::models::MicroMacroBridge::extractDensityProfile(
+        *state.lane, m_profile.data(), num_cells);
+  }
+  m_macro.setDensities(state.macro_link, m_profile.data());
 
   // Remove individual vehicles from lane
   // (They're now represented as density)
-  for (auto &vehicle : state.vehicles) {
-    state.lane->removeVehicle(vehicle);
-  }
-  state.vehicles.clear();
+  state.lane->clearVehicles();
+  state.profile.clear();
 
   state.mode = SimulationMode::MACROSCOPIC;
+  state.on_device = false;
   state.frames_since_transition = 0;
 }
 
@@ -151,60 +609,47 @@ void AdaptiveSimulator::transitionToMicro(LaneState &state) {
   std::cout << "Lane " << state.lane->getId()
             << ": Transitioning to MICROSCOPIC (density="
             << state.current_density << ", vehicles=" << state.vehicle_count
-            << ")" << std::endl;
+            << ")\n";
 
-  if (!state.lwr_model) {
+  if (!m_macro.hasLink(state.macro_link)) {
     std::cerr << "Error: No LWR model to transition from" << std::endl;
     return;
   }
+  const std::size_t link = state.macro_link;
+  int num_cells = m_macro.getNumCells(link);
+  double cell_length = m_macro.getCellLength(link);
 
-  // Try to restore vehicles from stored data first
-  if (!state.stored_vehicle_data.empty()) {
-    std::cout << "  Restoring " << state.stored_vehicle_data.size()
-              << " vehicles from stored data" << std::endl;
-
-    // Get current macroscopic speeds for each position
-    int num_cells = state.lwr_model->getNumCells();
-    double cell_length = state.lwr_model->getCellLength();
-
-    for (const auto &vdata : state.stored_vehicle_data) {
-      auto vehicle = std::make_shared<kernel::model::Vehicle>(vdata.id);
-
-      // Restore position
-      vehicle->setCurrentLane(state.lane);
-      vehicle->setLanePosition(vdata.position);
+  // Put the stored vehicles back first
+  if (!state.stored_vehicles.empty()) {
+    std::cout << "  Restoring " << state.stored_vehicles.size()
+              << " vehicles\n";
 
+    for (const auto &vehicle : state.stored_vehicles) {
       // Update speed from macroscopic model (traffic may have evolved)
-      int cell_index = static_cast<int>(vdata.position / cell_length);
+      int cell_index =
+          static_cast<int>(vehicle->getLanePosition() / cell_length);
       if (cell_index >= 0 && cell_index < num_cells) {
-        double macro_speed = state.lwr_model->getSpeed(cell_index);
+        double macro_speed = m_macro.getSpeed(link, cell_index);
         // Blend stored speed with macro speed
-        double blended_speed = 0.7 * macro_speed + 0.3 * vdata.speed;
-        vehicle->setSpeed(blended_speed);
-      } else {
-        vehicle->setSpeed(vdata.speed);
+        vehicle->setSpeed(0.7 * macro_speed + 0.3 * vehicle->getSpeed());
       }
 
-      // Restore other properties
-      // (length is set by constructor, but we could override if needed)
-
+      // In the order of the lane positions, appended
+      vehicle->setCurrentLane(state.lane);
       state.lane->addVehicle(vehicle);
-      state.vehicles.push_back(vehicle);
     }
 
-    state.stored_vehicle_data.clear();
+    state.vehicles.swap(state.stored_vehicles);
+    state.stored_vehicles.clear();
 
   } else {
     // Fallback: Generate vehicles from macroscopic density
-    std::cout << "  Generating vehicles from macroscopic density" << std::endl;
-
-    int num_cells = state.lwr_model->getNumCells();
-    double cell_length = state.lwr_model->getCellLength();
+    std::cout << "  Generating vehicles from macroscopic density\n";
 
     int vehicle_id = 0;
     for (int i = 0; i < num_cells; ++i) {
-      double density = state.lwr_model->getDensity(i);
-      double speed = state.lwr_model->getSpeed(i);
+      double density = m_macro.getDensity(link, i);
+      double speed = m_macro.getSpeed(link, i);
 
       // Calculate number of vehicles in this cell
       int num_vehicles_in_cell = static_cast<int>(density * cell_length + 0.5);
@@ -228,8 +673,11 @@ void AdaptiveSimulator::transitionToMicro(LaneState &state) {
     }
   }
 
+  state.profile.rebuild(*state.lane);
+
   // Clear macroscopic model
-  state.lwr_model.reset();
+  m_macro.removeLink(link);
+  state.macro_link = macroscopic::models::CellBatch::NONE;
 
   state.mode = SimulationMode::MICROSCOPIC;
   state.frames_since_transition = 0;
@@ -238,32 +686,70 @@ void AdaptiveSimulator::transitionToMicro(LaneState &state) {
 void AdaptiveSimulator::updateMicroscopic(LaneState &state, double dt,
                                           const microscopic::models::IDM &idm) {
 
-  // Update each vehicle using IDM
+  // A held vehicle is due within half a step of the end of its hold
+  const bool multirate = m_config.coarse_steps > 1;
+  const double hold_time = (m_config.coarse_steps - 0.5) * dt;
+
+  // Update each vehicle using IDM, and its cell
   for (auto &vehicle : state.vehicles) {
-    auto leader = state.lane->getLeader(*vehicle);
-    double acc = idm.calculateAcceleration(*vehicle, leader);
-    vehicle->update(dt, acc);
+    const double position = vehicle->getLanePosition();
+    const double speed = vehicle->getSpeed();
+    const double pending = vehicle->getPendingTime();
+    if (pending > 0.0 && pending < hold_time) {
+      vehicle->defer(dt, vehicle->getAcceleration());
+    } else {
+      vehicle->catchUp();
+      auto leader = state.lane->getLeader(*vehicle);
+      double acc = idm.calculateAcceleration(*vehicle, leader);
+      const double gap = leader ? vehicle->getGapTo(*leader)
+                                : std::numeric_limits<double>::infinity();
+      if (multirate && gap >= m_config.coarse_min_gap &&
+          std::abs(acc) <= m_config.coarse_max_accel) {
+        vehicle->defer(dt, acc);
+      } else {
+        if (leader && leader->getPendingTime() > 0.0 &&
+            gap < m_config.coarse_min_gap) {
+          leader->catchUp();
+        }
+        vehicle->update(dt, acc);
+      }
+    }
+    state.profile.move(position, speed, vehicle->getLanePosition(),
+                       vehicle->getSpeed());
   }
 
-  // Sync with lane's vehicle list
+  // Sync with lane's vehicle list, sorted again after the moves
+  state.lane->sortVehicles();
   state.vehicles = state.lane->getVehicles();
-}
 
-void AdaptiveSimulator::updateMacroscopic(LaneState &state, double dt) {
-  if (!state.lwr_model) {
-    std::cerr << "Error: No LWR model for macroscopic update" << std::endl;
-    return;
+  if (m_config.calibrate_online) {
+    state.diagram.observe(state.profile);
   }
-
-  // Update LWR model
-  state.lwr_model->update(dt);
 }
 
 void AdaptiveSimulator::updateMetrics(LaneState &state) {
+  // The update time of the previous step, in the mode the lane still has
+  if (state.frames_since_transition > 0) {
+    const double weight = m_config.cost_smoothing;
+    if (state.mode == SimulationMode::MICROSCOPIC && !state.on_device) {
+      const double per_vehicle =
+          state.last_update_time_ms /
+          std::max<std::size_t>(1, state.vehicles.size());
+      smoothCost(state.micro_ms_per_vehicle, per_vehicle, weight);
+    } else if (state.mode == SimulationMode::MACROSCOPIC) {
+      smoothCost(state.macro_ms, state.last_update_time_ms, weight);
+    }
+  }
+
   if (state.mode == SimulationMode::MICROSCOPIC) {
-    // Calculate from individual vehicles
+    // Calculate from the profile, counted again if vehicles entered or
+    // left the lane behind its back
+    if (static_cast<std::size_t>(state.profile.getVehicleCount()) !=
+        state.lane->getVehicles().size()) {
+      state.profile.rebuild(*state.lane);
+    }
     auto stats = macroscopic::models::MicroMacroBridge::calculateAggregateStats(
-        state.lane);
+        state.profile, state.lane->getLength());
 
     state.current_density = stats.avg_density;
     state.avg_speed = stats.avg_speed;
@@ -272,23 +758,24 @@ void AdaptiveSimulator::updateMetrics(LaneState &state) {
 
   } else if (state.mode == SimulationMode::MACROSCOPIC) {
     // Calculate from LWR model
-    if (state.lwr_model) {
-      int num_cells = state.lwr_model->getNumCells();
+    if (m_macro.hasLink(state.macro_link)) {
+      const std::size_t link = state.macro_link;
+      int num_cells = m_macro.getNumCells(link);
       double total_density = 0.0;
       double total_speed = 0.0;
       double total_flow = 0.0;
       int total_vehicles = 0;
 
       for (int i = 0; i < num_cells; ++i) {
-        double density = state.lwr_model->getDensity(i);
-        double speed = state.lwr_model->getSpeed(i);
-        double flow = state.lwr_model->getFlow(i);
+        double density = m_macro.getDensity(link, i);
+        double speed = m_macro.getSpeed(link, i);
+        double flow = m_macro.getFlow(link, i);
 
         total_density += density;
         total_speed += speed;
         total_flow += flow;
         total_vehicles +=
-            static_cast<int>(density * state.lwr_model->getCellLength());
+            static_cast<int>(density * m_macro.getCellLength(link));
       }
 
       state.current_density = total_density / num_cells;
@@ -336,20 +823,53 @@ AdaptiveSimulator::getLaneState(const std::string &lane_id) const {
   return nullptr;
 }
 
+macroscopic::models::FundamentalDiagramEstimator *
+AdaptiveSimulator::getFundamentalDiagram(const std::string &lane_id) {
+  auto it = m_lane_states.find(lane_id);
+  if (it != m_lane_states.end()) {
+    return &it->second.diagram;
+  }
+  return nullptr;
+}
+
+void AdaptiveSimulator::exportVehicleStates(std::vector<double> &rows) const {
+  using kernel::model::NUM_STATE_COLUMNS;
+  std::size_t num_vehicles = 0;
+  for (const auto &entry : m_lane_states) {
+    num_vehicles += entry.second.lane->getVehicles().size();
+  }
+  rows.resize(num_vehicles * NUM_STATE_COLUMNS);
+  std::size_t first = 0;
+  for (const auto &entry : m_lane_states) {
+    const auto &vehicles = entry.second.lane->getVehicles();
+    kernel::model::exportVehicleStates(vehicles,
+                                       rows.data() + first * NUM_STATE_COLUMNS,
+                                       num_vehicles - first, first);
+    first += vehicles.size();
+  }
+}
+
 AdaptiveSimulator::Statistics AdaptiveSimulator::getStatistics() const {
   Statistics stats{};
   stats.total_lanes = m_lane_states.size();
   stats.micro_lanes = 0;
   stats.macro_lanes = 0;
   stats.transitioning_lanes = 0;
+  stats.device_lanes = 0;
+  stats.held_vehicles = 0;
   stats.total_vehicles = 0;
   stats.avg_density = 0.0;
   stats.total_update_time_ms = 0.0;
+  stats.estimated_update_time_ms = 0.0;
 
   for (const auto &[lane_id, state] : m_lane_states) {
     switch (state.mode) {
     case SimulationMode::MICROSCOPIC:
       stats.micro_lanes++;
+      stats.device_lanes += state.on_device ? 1 : 0;
+      for (const auto &vehicle : state.vehicles) {
+        stats.held_vehicles += vehicle->getPendingTime() > 0.0 ? 1 : 0;
+      }
       break;
     case SimulationMode::MACROSCOPIC:
       stats.macro_lanes++;
@@ -362,6 +882,9 @@ AdaptiveSimulator::Statistics AdaptiveSimulator::getStatistics() const {
     stats.total_vehicles += state.vehicle_count;
     stats.avg_density += state.current_density;
     stats.total_update_time_ms += state.last_update_time_ms;
+    stats.estimated_update_time_ms +=
+        state.mode == SimulationMode::MACROSCOPIC ? estimateMacroCost(state)
+                                                  : estimateMicroCost(state);
   }
 
   if (stats.total_lanes > 0) {
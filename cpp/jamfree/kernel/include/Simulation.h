@@ -3,8 +3,10 @@
 
 #include "../../microscopic/include/IDM.h"
 #include "model/Lane.h"
+#include "model/LaneVehicleStore.h"
 #include "model/Road.h"
 #include "model/Vehicle.h"
+#include <algorithm>
 #include <map>
 #include <memory>
 #include <vector>
@@ -49,11 +51,8 @@ public:
     vehicle->setLanePosition(position);
     vehicle->setSpeed(speed);
 
-    // Update 2D position
-    if (lane && lane->getParentRoad()) {
-      vehicle->setPosition(lane->getPositionAt(position));
-      vehicle->setHeading(lane->getHeadingAt(position));
-    }
+    // The 2D position follows on demand
+    vehicle->invalidatePosition();
 
     lane->addVehicle(vehicle);
     m_vehicles.push_back(vehicle);
@@ -78,33 +77,40 @@ public:
    * @brief Run simulation for one time step.
    */
   void step() {
-    // Calculate accelerations for all vehicles
-    std::map<std::string, double> accelerations;
-
+    // The lanes of the vehicles, each one stepping as passes over the
+    // columns of its vehicles
+    std::vector<model::Lane *> lanes;
     for (auto &vehicle : m_vehicles) {
-      auto lane = vehicle->getCurrentLane();
-      if (!lane)
-        continue;
-
-      // Find leader
-      model::Vehicle *leader = nullptr;
-      auto leader_ptr = lane->getVehicleAhead(vehicle->getLanePosition());
-      if (leader_ptr) {
-        leader = leader_ptr.get();
-      }
-
-      // Get model and calculate acceleration
-      auto model = m_vehicle_models[vehicle->getId()];
-      if (model) {
-        double accel = model->calculateAcceleration(*vehicle, leader);
-        accelerations[vehicle->getId()] = accel;
+      if (auto lane = vehicle->getCurrentLane()) {
+        lanes.push_back(lane.get());
+      } else {
+        vehicle->update(m_dt, 0.0);
       }
     }
+    std::sort(lanes.begin(), lanes.end());
+    lanes.erase(std::unique(lanes.begin(), lanes.end()), lanes.end());
+
+    for (auto *lane : lanes) {
+      m_store.clear();
+      for (const auto &vehicle : lane->getVehicles()) {
+        auto found = m_vehicle_models.find(vehicle->getId());
+        // Only the vehicles of the simulation in this lane move; the
+        // others are leaders
+        bool integrated =
+            found != m_vehicle_models.end() && vehicle->getLane() == lane;
+        if (integrated && found->second) {
+          auto parameters = found->second->getDriverParameters();
+          m_store.add(*vehicle, &parameters);
+        } else {
+          m_store.add(*vehicle, nullptr, integrated);
+        }
+      }
+      m_store.computeAccelerations();
+      m_store.integrate(m_dt);
+      m_store.scatter();
 
-    // Update all vehicles
-    for (auto &vehicle : m_vehicles) {
-      double accel = accelerations[vehicle->getId()];
-      vehicle->update(m_dt, accel);
+      // Restore the order of the lane the vehicles moved along
+      lane->sortVehicles();
     }
 
     m_time += m_dt;
@@ -158,6 +164,7 @@ private:
   std::vector<std::shared_ptr<model::Vehicle>> m_vehicles;
   std::map<std::string, std::shared_ptr<microscopic::models::IDM>>
       m_vehicle_models;
+  model::LaneVehicleStore m_store;
 };
 
 } // namespace kernel
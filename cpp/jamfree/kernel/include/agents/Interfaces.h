@@ -13,6 +13,7 @@
 #include "../../../../microkernel/include/dynamicstate/IPublicDynamicStateMap.h"
 #include "../../../../microkernel/include/influences/IInfluence.h"
 #include "../../../../microkernel/include/influences/InfluencesMap.h"
+#include "../../../../microkernel/include/libs/SymbolTable.h"
 #include <functional>
 
 namespace jamfree {
@@ -23,6 +24,7 @@ namespace agents {
 using AgentCategory =
     fr::univ_artois::lgi2a::similar::microkernel::AgentCategory;
 using IAgent = fr::univ_artois::lgi2a::similar::microkernel::agents::IAgent;
+using Symbol = fr::univ_artois::lgi2a::similar::microkernel::libs::Symbol;
 using LevelIdentifier =
     fr::univ_artois::lgi2a::similar::microkernel::LevelIdentifier;
 using SimulationTimeStamp =
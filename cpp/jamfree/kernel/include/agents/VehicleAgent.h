@@ -48,11 +48,23 @@ public:
             other),
         m_id(other.m_id) {}
 
+  /**
+   * @brief Reset to a new agent, without level, for a pool to reuse it.
+   * @param id Unique identifier for the agent
+   */
+  void reset(const std::string &id);
+
   /**
    * @brief Get agent ID.
    * @return Agent identifier
    */
-  const std::string &getId() const { return m_id; }
+  const std::string &getId() const { return m_id.str(); }
+
+  /**
+   * @brief Get the interned agent ID, compared as an integer.
+   * @return Agent identifier
+   */
+  Symbol getSymbol() const { return m_id; }
 
   /**
    * @brief Add a simulation level to this agent.
@@ -150,7 +162,7 @@ public:
                  std::shared_ptr<IDecisionModel> decisionModel);
 
 private:
-  std::string m_id;
+  Symbol m_id;
 };
 
 } // namespace agents
@@ -0,0 +1,141 @@
+#ifndef JAMFREE_KERNEL_MODEL_DETECTOR_SET_H
+#define JAMFREE_KERNEL_MODEL_DETECTOR_SET_H
+
+#include "../../../../microkernel/include/engine/WorkStealingThreadPool.h"
+#include "Lane.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace jamfree {
+namespace kernel {
+namespace model {
+
+/**
+ * @brief Measures of detectors over periods, in columns.
+ *
+ * The measures of the period p and the detector d are at the index
+ * p * num_detectors + d of each column.
+ */
+struct DetectorReports {
+  std::size_t num_detectors = 0;
+  std::vector<double> period_end;     ///< Time of the end of each period (s)
+  std::vector<std::uint32_t> counts;  ///< Vehicles over the detector
+  std::vector<float> occupancy;       ///< Fraction of the time occupied
+  std::vector<float> harmonic_speed;  ///< Space-mean speed (m/s), NaN if none
+  std::vector<float> mean_speed;      ///< Time-mean speed (m/s), NaN if none
+
+  std::size_t getNumPeriods() const { return period_end.size(); }
+
+  void clear() {
+    period_end.clear();
+    counts.clear();
+    occupancy.clear();
+    harmonic_speed.clear();
+    mean_speed.clear();
+  }
+};
+
+/**
+ * @brief Virtual loop detectors on lanes, aggregated as the vehicles cross.
+ *
+ * At each update, a detector counts the vehicles of its lane that crossed
+ * its position since the previous one: the ones now between it and the
+ * last vehicle that was behind it, the vehicles of a lane keeping their
+ * order. It adds up their speeds and inverse speeds, for the time-mean and
+ * space-mean (harmonic) speeds, and the time its loop is under a vehicle.
+ * At the end of each period, the measures of all the detectors are
+ * appended to the columns of the reports, which exportReports() hands
+ * over; nothing is allocated by vehicle, and the updates of the detectors
+ * run in parallel.
+ *
+ * The lanes are to be sorted, as after Lane::sortVehicles(), and the
+ * vehicles moved, when update() is called.
+ */
+class DetectorSet {
+public:
+  /**
+   * @param period Aggregation period (seconds)
+   * @throws std::invalid_argument If the period is not positive
+   */
+  explicit DetectorSet(double period = 60.0);
+
+  /**
+   * @brief Add a detector.
+   *
+   * @param lane Lane
+   * @param position Position of the start of the loop along the lane (m)
+   * @param loop_length Length of the loop (m)
+   * @return Index of the detector in the reports
+   * @throws std::invalid_argument If the lane is null or the length negative
+   */
+  std::size_t addDetector(std::shared_ptr<Lane> lane, double position,
+                          double loop_length = 2.0);
+
+  std::size_t getNumDetectors() const { return m_lanes.size(); }
+  double getPeriod() const { return m_period; }
+  double getTime() const { return m_time; }
+
+  /**
+   * @brief Set the number of threads updating the detectors.
+   *
+   * Used when no thread pool is lent by the caller of update().
+   * @param numThreads Number of threads (1 = sequential)
+   */
+  void setNumThreads(std::size_t numThreads);
+
+  /**
+   * @brief Measure the step that just ended.
+   *
+   * @param dt Duration of the step (seconds)
+   */
+  void update(double dt);
+
+  /**
+   * @brief Get the vehicles counted by a detector in the current period.
+   */
+  std::uint32_t getCurrentCount(std::size_t detector) const {
+    return m_counts[detector];
+  }
+
+  /**
+   * @brief Hand over the reports of the periods ended since the previous
+   * export.
+   *
+   * @param reports Set to the reports; their storage is reused by the next
+   *                ones
+   */
+  void exportReports(DetectorReports &reports);
+
+private:
+  using ThreadPool =
+      fr::univ_artois::lgi2a::similar::microkernel::engine::
+          WorkStealingThreadPool;
+
+  double m_period;
+  double m_time = 0.0;
+  double m_period_start = 0.0;
+  std::shared_ptr<ThreadPool> m_pool;
+
+  // By detector
+  std::vector<std::shared_ptr<Lane>> m_lanes;
+  std::vector<double> m_positions;
+  std::vector<double> m_loop_ends;
+  std::vector<std::weak_ptr<Vehicle>> m_upstream;
+  std::vector<std::uint32_t> m_counts;
+  std::vector<double> m_speed_sums;
+  std::vector<double> m_inverse_speed_sums;
+  std::vector<double> m_occupied_times;
+
+  DetectorReports m_reports;
+
+  void measure(std::size_t detector, double dt);
+  void closePeriod();
+};
+
+} // namespace model
+} // namespace kernel
+} // namespace jamfree
+
+#endif // JAMFREE_KERNEL_MODEL_DETECTOR_SET_H
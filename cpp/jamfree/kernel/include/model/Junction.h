@@ -0,0 +1,197 @@
+#ifndef JAMFREE_KERNEL_MODEL_JUNCTION_H
+#define JAMFREE_KERNEL_MODEL_JUNCTION_H
+
+#include "Lane.h"
+#include "Point2D.h"
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace jamfree {
+namespace kernel {
+namespace model {
+
+/**
+ * @brief A junction: the movements from its incoming lanes to its outgoing
+ * lanes, the zones where they conflict, and the time-space reservations of
+ * the vehicles crossing them.
+ *
+ * The conflict zones are computed once, as the movements are added: where
+ * the paths of two movements from different lanes cross, and where two
+ * movements merge into the same lane. Each zone keeps the time windows of
+ * the vehicles that reserved it, so that whether a vehicle may enter its
+ * movement, and when, is answered from the few reservations of the zones of
+ * that movement, without comparing the vehicles near the junction pairwise.
+ * The vehicles following each other on a lane, or a movement, are left to
+ * the car-following models.
+ *
+ * A vehicle crosses its movement at a constant speed: it occupies a zone
+ * from its front reaching the zone to its rear leaving it. Junctions are
+ * independent of each other, so that distinct junctions may be handled in
+ * parallel; the queries of a junction are const, reserve() and the
+ * releases are not.
+ */
+class Junction {
+public:
+  /// Index of no movement
+  static constexpr std::size_t NONE = std::numeric_limits<std::size_t>::max();
+
+  /// Speed below which a vehicle crosses as at this one (m/s)
+  static constexpr double MIN_CROSSING_SPEED = 1.0;
+
+  /**
+   * @brief A conflict zone along a movement.
+   */
+  struct Crossing {
+    std::size_t zone;
+    double entry; ///< Distance along the path to the zone (m)
+    double exit;  ///< Distance along the path out of the zone (m)
+  };
+
+  /**
+   * @brief A path through the junction from a lane to another.
+   */
+  struct Movement {
+    std::shared_ptr<Lane> from;
+    std::shared_ptr<Lane> to;
+    std::vector<Point2D> path;       ///< From the end of from to to
+    double length;                   ///< Of the path (m)
+    std::vector<Crossing> crossings; ///< By entry
+  };
+
+  /**
+   * @brief The time a vehicle holds a conflict zone.
+   */
+  struct Reservation {
+    std::string vehicle;
+    std::size_t movement;
+    double enter; ///< s
+    double exit;  ///< s
+  };
+
+  /**
+   * @brief Where two movements conflict.
+   */
+  struct ConflictZone {
+    std::size_t movements[2];
+    Point2D position;
+    bool merge; ///< Into the same lane, else the paths cross
+    std::vector<Reservation> reservations;
+  };
+
+  /**
+   * @param id Junction identifier
+   * @param path_width Width of the path of a movement (m), the extent of
+   *        the zones where paths cross at right angle
+   * @throws std::invalid_argument If the width is not positive
+   */
+  explicit Junction(const std::string &id, double path_width = 3.5);
+
+  const std::string &getId() const { return m_id; }
+  double getPathWidth() const { return m_path_width; }
+
+  /**
+   * @brief Add a movement, and its conflicts with the movements added
+   * before.
+   *
+   * @param path Points from the end of from to the start of to
+   * @return Index of the movement
+   * @throws std::invalid_argument If a lane is null or the path has less
+   *         than two points
+   */
+  std::size_t addMovement(std::shared_ptr<Lane> from, std::shared_ptr<Lane> to,
+                          std::vector<Point2D> path);
+
+  /**
+   * @brief Add a movement along the straight line from the end of a lane
+   * to the start of another.
+   */
+  std::size_t addMovement(std::shared_ptr<Lane> from,
+                          std::shared_ptr<Lane> to);
+
+  /**
+   * @brief Find the movement from a lane to another.
+   *
+   * @return Index of the movement, NONE if none
+   */
+  std::size_t findMovement(const Lane &from, const Lane &to) const;
+
+  std::size_t getNumMovements() const { return m_movements.size(); }
+  const Movement &getMovement(std::size_t movement) const {
+    return m_movements[movement];
+  }
+  std::size_t getNumZones() const { return m_zones.size(); }
+  const ConflictZone &getZone(std::size_t zone) const { return m_zones[zone]; }
+
+  /**
+   * @brief Check if a vehicle entering a movement at a time keeps a
+   * critical gap to the reservations of the other vehicles in all its
+   * conflict zones.
+   *
+   * @param movement Index of the movement
+   * @param vehicle Identifier of the vehicle, whose reservations are ignored
+   * @param entry_time Time the front of the vehicle enters the path (s)
+   * @param speed Speed through the junction (m/s)
+   * @param vehicle_length m
+   * @param critical_gap Time kept free before and after the other vehicles
+   *        (s)
+   */
+  bool isGapAcceptable(std::size_t movement, const std::string &vehicle,
+                       double entry_time, double speed, double vehicle_length,
+                       double critical_gap) const;
+
+  /**
+   * @brief Find the earliest time, from a time on, at which a vehicle may
+   * enter a movement, as isGapAcceptable().
+   *
+   * @return Time (s), in O(reservations of the zones of the movement)
+   *         passes over them
+   */
+  double findEntryTime(std::size_t movement, const std::string &vehicle,
+                       double earliest_time, double speed,
+                       double vehicle_length, double critical_gap) const;
+
+  /**
+   * @brief Reserve the conflict zones of a movement for a vehicle, if it
+   * may enter then, replacing its reservations of that movement.
+   *
+   * @return false, reserving nothing, if the gap is not acceptable
+   */
+  bool reserve(std::size_t movement, const std::string &vehicle,
+               double entry_time, double speed, double vehicle_length,
+               double critical_gap);
+
+  /**
+   * @brief Cancel the reservations of a vehicle for a movement, e.g. once
+   * it left the junction or changed its plans.
+   */
+  void release(std::size_t movement, const std::string &vehicle);
+
+  /**
+   * @brief Drop the reservations over before a time.
+   */
+  void expire(double time);
+
+  /**
+   * @brief Number of reservations, over all the zones.
+   */
+  std::size_t getNumReservations() const;
+
+private:
+  std::string m_id;
+  double m_path_width;
+  std::vector<Movement> m_movements;
+  std::vector<ConflictZone> m_zones;
+
+  void addZone(const Crossing &first, std::size_t first_movement,
+               const Crossing &second, std::size_t second_movement,
+               const Point2D &position, bool merge);
+};
+
+} // namespace model
+} // namespace kernel
+} // namespace jamfree
+
+#endif // JAMFREE_KERNEL_MODEL_JUNCTION_H
@@ -2,6 +2,7 @@
 #define JAMFREE_KERNEL_MODEL_LANE_H
 
 #include "Point2D.h"
+#include "SpatialIndex.h"
 #include <memory>
 #include <string>
 #include <vector>
@@ -84,6 +85,9 @@ public:
   /**
    * @brief Add vehicle to lane.
    *
+   * The vehicle is inserted at its place in the order of the lane
+   * positions, found by binary search.
+   *
    * @param vehicle Vehicle to add
    */
   void addVehicle(std::shared_ptr<Vehicle> vehicle);
@@ -95,17 +99,47 @@ public:
    */
   void removeVehicle(std::shared_ptr<Vehicle> vehicle);
 
+  /**
+   * @brief Remove vehicles from lane, in one pass over the lane.
+   *
+   * @param vehicles Vehicles to remove, for example the ones leaving the
+   *                 network in a step
+   */
+  void removeVehicles(const std::vector<std::shared_ptr<Vehicle>> &vehicles);
+
+  /**
+   * @brief Remove all the vehicles from lane, keeping the storage.
+   */
+  void clearVehicles() { m_spatial_index.clear(); }
+
+  /**
+   * @brief Restore the order of the vehicles after they moved.
+   *
+   * Updates the spatial index (see SpatialIndex::update()), once per step.
+   * The lookups of the vehicles ahead and behind see the order of the last
+   * update until the moved vehicles are sorted again.
+   */
+  void sortVehicles();
+
   /**
    * @brief Get all vehicles in lane.
    *
-   * @return Vector of vehicles
+   * @return Vector of vehicles, sorted by lane position
    */
   const std::vector<std::shared_ptr<Vehicle>> &getVehicles() const {
-    return m_vehicles;
+    return m_spatial_index.getVehicles();
   }
 
   /**
-   * @brief Get vehicle ahead of given position.
+   * @brief Get the index of the vehicles in lane, which the perception
+   * queries.
+   *
+   * @return Spatial index, updated by sortVehicles()
+   */
+  const SpatialIndex &getSpatialIndex() const { return m_spatial_index; }
+
+  /**
+   * @brief Get vehicle ahead of given position, by binary search.
    *
    * @param position Current position along lane
    * @return Vehicle ahead, or nullptr if none
@@ -113,7 +147,7 @@ public:
   std::shared_ptr<Vehicle> getVehicleAhead(double position) const;
 
   /**
-   * @brief Get vehicle behind given position.
+   * @brief Get vehicle behind given position, by binary search.
    *
    * @param position Current position along lane
    * @return Vehicle behind, or nullptr if none
@@ -151,7 +185,7 @@ private:
   double m_length;
   double m_speed_limit;
   Road *m_parent_road;
-  std::vector<std::shared_ptr<Vehicle>> m_vehicles;
+  SpatialIndex m_spatial_index;
 };
 
 } // namespace model
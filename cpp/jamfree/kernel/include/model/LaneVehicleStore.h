@@ -0,0 +1,176 @@
+#ifndef JAMFREE_KERNEL_MODEL_LANE_VEHICLE_STORE_H
+#define JAMFREE_KERNEL_MODEL_LANE_VEHICLE_STORE_H
+
+#include "../../../../microkernel/include/libs/MemoryAccounting.h"
+#include "../tools/Precision.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace jamfree {
+namespace kernel {
+namespace model {
+
+class Vehicle;
+
+/**
+ * @brief Car-following (IDM) parameters of a driver.
+ */
+struct DriverParameters {
+  double desired_speed;     ///< v₀: Desired speed (m/s)
+  double time_headway;      ///< T: Desired time headway (s)
+  double min_gap;           ///< s₀: Minimum gap (m)
+  double max_accel;         ///< a: Maximum acceleration (m/s²)
+  double comfortable_decel; ///< b: Comfortable deceleration (m/s²)
+  double accel_exponent;    ///< δ: Acceleration exponent
+};
+
+/**
+ * @brief Structure-of-arrays state of the vehicles of a lane.
+ *
+ * Gathers the vehicles of a lane, sorted by lane position, into contiguous
+ * columns (position, speed, acceleration, length, limits and driver
+ * parameters), so that the gaps, the IDM accelerations and the integration
+ * of a step run as streaming passes over memory; scatter() then writes the
+ * new state back to the vehicles, which stay the handles the rest of the
+ * simulation uses.
+ *
+ * The columns hold values of the precision of the build,
+ * tools::Precision::State, the passes computing in it too; the vehicles
+ * keep doubles.
+ *
+ * The leader of a vehicle is the next vehicle strictly ahead in the lane,
+ * as for Lane::getVehicleAhead(). A store is meant to be reused from lane
+ * to lane: clear() keeps the capacity of the columns.
+ */
+class LaneVehicleStore {
+public:
+  /** The type of the columns. */
+  using Value = tools::Precision::State;
+
+  /**
+   * @brief Constructor.
+   */
+  LaneVehicleStore() = default;
+
+  /**
+   * @brief Remove all vehicles, keeping the allocated columns.
+   */
+  void clear();
+
+  /**
+   * @brief Append a vehicle, after the ones behind or level with it.
+   *
+   * @param vehicle Vehicle handle, written back by scatter()
+   * @param driver Driver parameters, or nullptr for a vehicle that does not
+   *               accelerate
+   * @param integrated Whether integrate() and scatter() update the vehicle;
+   *                   otherwise it is only a leader for the others
+   */
+  void add(Vehicle &vehicle, const DriverParameters *driver,
+           bool integrated = true);
+
+  /**
+   * @brief Compute the IDM acceleration of every vehicle.
+   *
+   * The gap to the leader is its lane position minus the front of the
+   * vehicle, as for Vehicle::getGapTo().
+   */
+  void computeAccelerations();
+
+  /**
+   * @brief Compute the accelerations of every vehicle with one
+   * car-following model, whatever the driver parameters.
+   *
+   * The gaps and relative speeds are computed into columns first, an
+   * infinite gap meaning no leader, then handed to the batch of the model,
+   * which the compiler inlines and vectorizes for the model type. A vehicle
+   * without driver still does not accelerate.
+   *
+   * @param model Model with a computeAccelerations(v, gap, dv, out, n)
+   *              batch over Value, e.g. microscopic::models::IDM
+   */
+  template <typename Model> void computeAccelerations(const Model &model) {
+    computeGaps();
+    model.computeAccelerations(m_speeds.data(), m_gaps.data(),
+                               m_relative_speeds.data(),
+                               m_accelerations.data(), m_vehicles.size());
+    clearUndriven();
+  }
+
+  /**
+   * @brief Integrate one time step, as Vehicle::update() does.
+   *
+   * The accelerations and the speeds are clamped to the vehicle limits.
+   *
+   * @param dt Time step (seconds)
+   */
+  void integrate(double dt);
+
+  /**
+   * @brief Write the state of the integrated vehicles back to them.
+   *
+   * Also updates their 2D position and heading from their lane.
+   */
+  void scatter() const;
+
+  /**
+   * @brief Get number of vehicles in store.
+   *
+   * @return Vehicle count
+   */
+  size_t size() const { return m_vehicles.size(); }
+
+  /**
+   * @brief The account of the memory of the columns.
+   */
+  struct Memory {
+    static const char *name() { return "vehicles"; }
+  };
+
+  template <typename T>
+  using Column = std::vector<
+      T, fr::univ_artois::lgi2a::similar::microkernel::libs::TrackedAllocator<
+             T, Memory>>;
+
+  // Columns, in lane order
+  const Column<Value> &getPositions() const { return m_positions; }
+  const Column<Value> &getSpeeds() const { return m_speeds; }
+  const Column<Value> &getAccelerations() const { return m_accelerations; }
+
+private:
+  Column<Vehicle *> m_vehicles;
+  Column<std::uint8_t> m_integrated;
+
+  // State
+  Column<Value> m_positions;
+  Column<Value> m_speeds;
+  Column<Value> m_accelerations;
+
+  // Vehicle properties
+  Column<Value> m_lengths;
+  Column<Value> m_max_speeds;
+  Column<Value> m_max_accels;
+  Column<Value> m_max_decels;
+
+  // Driver parameters, the ones of a vehicle without driver being 0
+  Column<Value> m_desired_speeds;
+  Column<Value> m_time_headways;
+  Column<Value> m_min_gaps;
+  Column<Value> m_idm_accels;
+  Column<Value> m_comfortable_decels;
+  Column<Value> m_accel_exponents;
+
+  // Scratch of computeAccelerations(model)
+  Column<Value> m_gaps;
+  Column<Value> m_relative_speeds;
+
+  void computeGaps();
+  void clearUndriven();
+};
+
+} // namespace model
+} // namespace kernel
+} // namespace jamfree
+
+#endif // JAMFREE_KERNEL_MODEL_LANE_VEHICLE_STORE_H
@@ -1,8 +1,11 @@
 #ifndef JAMFREE_KERNEL_MODEL_ROAD_H
 #define JAMFREE_KERNEL_MODEL_ROAD_H
 
+#include "../../../../microkernel/include/libs/MemoryAccounting.h"
 #include "Lane.h"
 #include "Point2D.h"
+#include <algorithm>
+#include <cmath>
 #include <memory>
 #include <string>
 #include <vector>
@@ -20,6 +23,18 @@ namespace model {
  */
 class Road {
 public:
+  /**
+   * @brief The account of the memory of the geometry of the network.
+   */
+  struct GeometryMemory {
+    static const char *name() { return "network geometry"; }
+  };
+
+  using Waypoints = std::vector<
+      Point2D,
+      fr::univ_artois::lgi2a::similar::microkernel::libs::TrackedAllocator<
+          Point2D, GeometryMemory>>;
+
   /**
    * @brief Constructor for straight road.
    *
@@ -32,6 +47,8 @@ public:
   Road(const std::string &id, const Point2D &start, const Point2D &end,
        int num_lanes = 1, double lane_width = 3.5)
       : m_id(id), m_start(start), m_end(end), m_lane_width(lane_width) {
+    const Point2D ends[] = {start, end};
+    buildSegments(ends, 2);
     // Create lanes
     double length = start.distanceTo(end);
     for (int i = 0; i < num_lanes; ++i) {
@@ -52,10 +69,12 @@ public:
    */
   Road(const std::string &id, const std::vector<Point2D> &waypoints,
        int num_lanes = 1, double lane_width = 3.5)
-      : m_id(id), m_waypoints(waypoints), m_lane_width(lane_width) {
+      : m_id(id), m_waypoints(waypoints.begin(), waypoints.end()),
+        m_lane_width(lane_width) {
     if (waypoints.size() >= 2) {
       m_start = waypoints.front();
       m_end = waypoints.back();
+      buildSegments(waypoints.data(), waypoints.size());
 
       // Calculate total length
       double length = 0.0;
@@ -77,6 +96,7 @@ public:
   const std::string &getId() const { return m_id; }
   const Point2D &getStart() const { return m_start; }
   const Point2D &getEnd() const { return m_end; }
+  const Waypoints &getWaypoints() const { return m_waypoints; }
   double getLaneWidth() const { return m_lane_width; }
   int getNumLanes() const { return m_lanes.size(); }
 
@@ -115,19 +135,41 @@ public:
   /**
    * @brief Get position at distance along road centerline.
    *
+   * A binary search of the segment table and one interpolation: the
+   * lengths and directions of the segments are computed once, by the
+   * constructor.
+   *
    * @param distance Distance from start (meters)
    * @return 2D position
    */
   Point2D getPositionAt(double distance) const {
+    return getPositionAt(distance, 0.0);
+  }
+
+  /**
+   * @brief Get position at distance along a line parallel to the
+   * centerline, e.g. the centerline of a lane.
+   *
+   * @param distance Distance from start (meters)
+   * @param offset Distance to the right of the centerline (meters)
+   * @return 2D position
+   */
+  Point2D getPositionAt(double distance, double offset) const {
+    if (m_segments.empty()) {
+      return m_waypoints.empty() ? m_start : m_waypoints.back();
+    }
     if (m_waypoints.empty()) {
       // Straight road
-      double t = distance / m_start.distanceTo(m_end);
-      t = std::max(0.0, std::min(1.0, t));
-      return m_start + (m_end - m_start) * t;
-    } else {
-      // Curved road - interpolate along waypoints
-      return interpolateAlongWaypoints(distance);
+      distance = std::max(0.0, distance);
     }
+    const Segment &segment = segmentAt(distance);
+    const double along = distance - segment.start;
+    const Point2D center =
+        along >= segment.length
+            ? segment.end
+            : segment.origin + (segment.end - segment.origin) *
+                                   (along * segment.inverse_length);
+    return center + segment.normal * offset;
   }
 
   /**
@@ -137,11 +179,37 @@ public:
    * @return Heading in radians
    */
   double getHeadingAt(double distance) const {
-    if (m_waypoints.empty()) {
-      return m_start.angleTo(m_end);
-    } else {
-      return getHeadingAlongWaypoints(distance);
+    return m_segments.empty() ? 0.0 : segmentAt(distance).heading;
+  }
+
+  /**
+   * @brief Get distance along road of the closest point of the centerline.
+   *
+   * Projects the position onto each segment, which suits the few segments
+   * of a road; RoadIndex finds the road itself among many.
+   *
+   * @param position Position to project
+   * @return Distance from start (meters)
+   */
+  double getDistanceAlong(const Point2D &position) const {
+    double best = -1.0;
+    double distance_along = 0.0;
+    for (const Segment &segment : m_segments) {
+      const double t = std::max(
+          0.0, std::min(segment.length,
+                        (position - segment.origin)
+                            .dot(segment.end - segment.origin) *
+                            segment.inverse_length));
+      const Point2D gap = position - (segment.origin +
+                                      (segment.end - segment.origin) *
+                                          (t * segment.inverse_length));
+      const double squared = gap.dot(gap);
+      if (best < 0.0 || squared < best) {
+        best = squared;
+        distance_along = segment.start + t;
+      }
     }
+    return distance_along;
   }
 
   /**
@@ -157,46 +225,58 @@ private:
   std::string m_id;
   Point2D m_start;
   Point2D m_end;
-  std::vector<Point2D> m_waypoints;
+  Waypoints m_waypoints;
   double m_lane_width;
   std::vector<std::shared_ptr<Lane>> m_lanes;
 
   /**
-   * @brief Interpolate position along waypoints.
+   * @brief A straight piece of the geometry, with what the lookups need.
    */
-  Point2D interpolateAlongWaypoints(double distance) const {
-    double accumulated = 0.0;
-    for (size_t i = 1; i < m_waypoints.size(); ++i) {
-      double segment_length = m_waypoints[i - 1].distanceTo(m_waypoints[i]);
-      if (accumulated + segment_length >= distance) {
-        // Position is in this segment
-        double t = (distance - accumulated) / segment_length;
-        return m_waypoints[i - 1] + (m_waypoints[i] - m_waypoints[i - 1]) * t;
-      }
-      accumulated += segment_length;
+  struct Segment {
+    Point2D origin;
+    Point2D end;
+    Point2D normal;        // unit vector to the right of the direction
+    double start;          // distance of the origin from the road start
+    double length;
+    double inverse_length; // 0 for a segment of no length
+    double heading;
+  };
+
+  std::vector<Segment, fr::univ_artois::lgi2a::similar::microkernel::libs::
+                           TrackedAllocator<Segment, GeometryMemory>>
+      m_segments;
+
+  void buildSegments(const Point2D *points, size_t count) {
+    m_segments.reserve(count > 1 ? count - 1 : 0);
+    double start = 0.0;
+    for (size_t i = 1; i < count; ++i) {
+      Segment segment;
+      segment.origin = points[i - 1];
+      segment.end = points[i];
+      segment.length = points[i - 1].distanceTo(points[i]);
+      segment.inverse_length =
+          segment.length > 0.0 ? 1.0 / segment.length : 0.0;
+      segment.heading = points[i - 1].angleTo(points[i]);
+      // The right of the heading, at heading - pi / 2
+      segment.normal =
+          Point2D(std::sin(segment.heading), -std::cos(segment.heading));
+      segment.start = start;
+      start += segment.length;
+      m_segments.push_back(segment);
     }
-    // Beyond end
-    return m_waypoints.back();
   }
 
   /**
-   * @brief Get heading along waypoints.
+   * @brief Get the first segment ending at or after a distance, else the
+   * last one.
    */
-  double getHeadingAlongWaypoints(double distance) const {
-    double accumulated = 0.0;
-    for (size_t i = 1; i < m_waypoints.size(); ++i) {
-      double segment_length = m_waypoints[i - 1].distanceTo(m_waypoints[i]);
-      if (accumulated + segment_length >= distance) {
-        // Heading is direction of this segment
-        return m_waypoints[i - 1].angleTo(m_waypoints[i]);
-      }
-      accumulated += segment_length;
-    }
-    // Use last segment
-    if (m_waypoints.size() >= 2) {
-      return m_waypoints[m_waypoints.size() - 2].angleTo(m_waypoints.back());
-    }
-    return 0.0;
+  const Segment &segmentAt(double distance) const {
+    auto it = std::partition_point(
+        m_segments.begin(), m_segments.end() - 1,
+        [distance](const Segment &segment) {
+          return segment.start + segment.length < distance;
+        });
+    return *it;
   }
 };
 
@@ -0,0 +1,140 @@
+#ifndef JAMFREE_KERNEL_MODEL_ROAD_INDEX_H
+#define JAMFREE_KERNEL_MODEL_ROAD_INDEX_H
+
+#include "Point2D.h"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace jamfree {
+namespace kernel {
+namespace model {
+
+class Road;
+
+/**
+ * @brief R-tree over the segments of the roads, for map matching.
+ *
+ * Bulk-loaded by Sort-Tile-Recursive packing: the segments are sorted by
+ * the x of their centers into vertical slabs, each slab by y, and cut into
+ * full leaves; the nodes of each level are packed the same way into their
+ * parents, up to the root. The tree is built once, after the network is,
+ * and is read-only afterwards, so that the queries of many threads may run
+ * at once. The geometry of the roads is not to change while it is in use;
+ * the roads replaced by an update of the network are swapped with update().
+ */
+class RoadIndex {
+public:
+  /// Most children of a node, and most segments of a leaf
+  static constexpr std::size_t NODE_CAPACITY = 16;
+
+  /**
+   * @brief A straight piece of a road.
+   */
+  struct Segment {
+    const Road *road;
+    std::uint32_t index; ///< Index of the segment along the road
+    Point2D start;
+    Point2D end;
+    double offset; ///< Distance of start from the road start (m)
+  };
+
+  /**
+   * @brief The point of a road closest to a position.
+   */
+  struct Match {
+    const Segment *segment = nullptr;
+    Point2D point;             ///< Closest point of the segment
+    double distance_along = 0; ///< Distance of point from the road start (m)
+    double distance = 0;       ///< Distance of the position to point (m)
+  };
+
+  RoadIndex() = default;
+
+  explicit RoadIndex(const std::vector<std::shared_ptr<Road>> &roads) {
+    build(roads);
+  }
+
+  /**
+   * @brief Index the segments of roads, replacing the previous ones.
+   */
+  void build(const std::vector<std::shared_ptr<Road>> &roads);
+
+  /**
+   * @brief Replace the segments of some roads, keeping the others.
+   *
+   * The segments of the other roads are not computed again, only the tree
+   * being packed again over them.
+   *
+   * @param removed Roads whose segments are removed
+   * @param added Roads whose segments are added
+   */
+  void update(const std::vector<std::shared_ptr<Road>> &removed,
+              const std::vector<std::shared_ptr<Road>> &added);
+
+  void clear();
+
+  /** @brief Number of segments indexed. */
+  std::size_t size() const { return m_segments.size(); }
+
+  bool empty() const { return m_segments.empty(); }
+
+  /**
+   * @brief Find the segment closest to a position.
+   *
+   * The nodes are visited closest first and the search stops at the first
+   * node farther than the best segment found.
+   *
+   * @param position Position, e.g. a GPS probe in network meters
+   * @param match Set to the closest point, if found
+   * @param max_distance Distance beyond which no segment matches (m)
+   * @return True if a segment lies within max_distance
+   */
+  bool nearest(const Point2D &position, Match &match,
+               double max_distance =
+                   std::numeric_limits<double>::infinity()) const;
+
+  /**
+   * @brief Find the segments whose bounding boxes meet a window.
+   *
+   * @param min_point Lower corner of the window
+   * @param max_point Upper corner of the window
+   * @param segments Filled with the segments, in the order of the tree
+   * @return Number of segments found
+   */
+  std::size_t query(const Point2D &min_point, const Point2D &max_point,
+                    std::vector<const Segment *> &segments) const;
+
+  /**
+   * @brief Find the roads with a segment meeting a window, each once.
+   */
+  std::vector<const Road *> getRoadsIn(const Point2D &min_point,
+                                       const Point2D &max_point) const;
+
+private:
+  struct Box {
+    double min_x, min_y, max_x, max_y;
+  };
+
+  struct Node {
+    Box box;
+    std::uint32_t first; ///< First child node, or first segment of a leaf
+    std::uint32_t count;
+    bool leaf;
+  };
+
+  std::vector<Segment> m_segments;
+  std::vector<Node> m_nodes;
+  std::uint32_t m_root = 0;
+
+  void addSegments(const Road &road);
+  void pack();
+};
+
+} // namespace model
+} // namespace kernel
+} // namespace jamfree
+
+#endif // JAMFREE_KERNEL_MODEL_ROAD_INDEX_H
@@ -1,8 +1,7 @@
 #ifndef JAMFREE_KERNEL_MODEL_SPATIAL_INDEX_H
 #define JAMFREE_KERNEL_MODEL_SPATIAL_INDEX_H
 
-#include "Vehicle.h"
-#include <algorithm>
+#include <cstddef>
 #include <memory>
 #include <vector>
 
@@ -10,11 +9,15 @@ namespace jamfree {
 namespace kernel {
 namespace model {
 
+class Vehicle;
+
 /**
  * @brief Spatial index for efficient vehicle queries.
  *
  * Provides O(log N) queries instead of O(N) for finding leaders/followers.
- * Uses a sorted array with binary search.
+ * Uses a sorted array with binary search: the vehicles are inserted at their
+ * place, and update() restores the order once the vehicles moved. Each Lane
+ * owns the index of its vehicles.
  *
  * For more advanced needs, this can be extended to R-tree or grid-based index.
  */
@@ -28,37 +31,56 @@ public:
   /**
    * @brief Add vehicle to index.
    *
+   * Inserted after the vehicles at the same position, by binary search.
+   *
    * @param vehicle Vehicle to add
    */
-  void addVehicle(const std::shared_ptr<Vehicle> &vehicle) {
-    m_vehicles.push_back(vehicle);
-    m_needs_sort = true;
-  }
+  void addVehicle(const std::shared_ptr<Vehicle> &vehicle);
 
   /**
    * @brief Remove vehicle from index.
    *
+   * Found by binary search at its position, if it did not move since the
+   * last update(), else by a scan.
+   *
    * @param vehicle Vehicle to remove
    */
-  void removeVehicle(const std::shared_ptr<Vehicle> &vehicle) {
-    auto it = std::find(m_vehicles.begin(), m_vehicles.end(), vehicle);
-    if (it != m_vehicles.end()) {
-      m_vehicles.erase(it);
-      m_needs_sort = true;
-    }
-  }
+  void removeVehicle(const std::shared_ptr<Vehicle> &vehicle);
 
   /**
-   * @brief Update index (resort if needed).
+   * @brief Remove vehicles from index, in one pass.
+   *
+   * The vehicles after the removed ones are moved once, whatever their
+   * number: a boundary despawning many vehicles in a step costs N.
    *
-   * Call this after vehicle positions have changed.
+   * @param vehicles Vehicles to remove
    */
-  void update() {
-    if (m_needs_sort) {
-      sortVehicles();
-      m_needs_sort = false;
-    }
-  }
+  void removeVehicles(const std::vector<std::shared_ptr<Vehicle>> &vehicles);
+
+  /**
+   * @brief Update index after vehicle positions have changed.
+   *
+   * Call this once per step: an insertion sort, moving each vehicle back
+   * past the ones it overtook, costs about N on the nearly sorted order a
+   * step leaves. Until then, the queries see the order of the last update.
+   */
+  void update();
+
+  /**
+   * @brief Find the first vehicle ahead of a position.
+   *
+   * @param position Position along the lane (meters)
+   * @return Vehicle ahead or nullptr
+   */
+  const std::shared_ptr<Vehicle> *findAhead(double position) const;
+
+  /**
+   * @brief Find the last vehicle behind a position.
+   *
+   * @param position Position along the lane (meters)
+   * @return Vehicle behind or nullptr
+   */
+  const std::shared_ptr<Vehicle> *findBehind(double position) const;
 
   /**
    * @brief Find leader (vehicle ahead).
@@ -68,39 +90,7 @@ public:
    * @param vehicle Query vehicle
    * @return Leader vehicle or nullptr
    */
-  Vehicle *findLeader(const Vehicle &vehicle) {
-    if (m_needs_sort) {
-      sortVehicles();
-      m_needs_sort = false;
-    }
-
-    if (m_vehicles.empty()) {
-      return nullptr;
-    }
-
-    double pos = vehicle.getLanePosition();
-
-    // Binary search for first vehicle ahead
-    auto it = std::upper_bound(
-        m_vehicles.begin(), m_vehicles.end(), pos,
-        [](double position, const std::shared_ptr<Vehicle> &v) {
-          return position < v->getLanePosition();
-        });
-
-    if (it != m_vehicles.end()) {
-      // Make sure it's not the same vehicle
-      if (it->get() != &vehicle) {
-        return it->get();
-      }
-      // Try next vehicle
-      ++it;
-      if (it != m_vehicles.end()) {
-        return it->get();
-      }
-    }
-
-    return nullptr;
-  }
+  Vehicle *findLeader(const Vehicle &vehicle) const;
 
   /**
    * @brief Find follower (vehicle behind).
@@ -110,40 +100,7 @@ public:
    * @param vehicle Query vehicle
    * @return Follower vehicle or nullptr
    */
-  Vehicle *findFollower(const Vehicle &vehicle) {
-    if (m_needs_sort) {
-      sortVehicles();
-      m_needs_sort = false;
-    }
-
-    if (m_vehicles.empty()) {
-      return nullptr;
-    }
-
-    double pos = vehicle.getLanePosition();
-
-    // Binary search for last vehicle behind
-    auto it = std::lower_bound(
-        m_vehicles.begin(), m_vehicles.end(), pos,
-        [](const std::shared_ptr<Vehicle> &v, double position) {
-          return v->getLanePosition() < position;
-        });
-
-    if (it != m_vehicles.begin()) {
-      --it;
-      // Make sure it's not the same vehicle
-      if (it->get() != &vehicle) {
-        return it->get();
-      }
-      // Try previous vehicle
-      if (it != m_vehicles.begin()) {
-        --it;
-        return it->get();
-      }
-    }
-
-    return nullptr;
-  }
+  Vehicle *findFollower(const Vehicle &vehicle) const;
 
   /**
    * @brief Find all vehicles in range.
@@ -152,33 +109,7 @@ public:
    * @param max_pos Maximum position
    * @return Vector of vehicles in range
    */
-  std::vector<Vehicle *> findInRange(double min_pos, double max_pos) {
-    if (m_needs_sort) {
-      sortVehicles();
-      m_needs_sort = false;
-    }
-
-    std::vector<Vehicle *> result;
-
-    // Binary search for range
-    auto it_start = std::lower_bound(
-        m_vehicles.begin(), m_vehicles.end(), min_pos,
-        [](const std::shared_ptr<Vehicle> &v, double position) {
-          return v->getLanePosition() < position;
-        });
-
-    auto it_end = std::upper_bound(
-        m_vehicles.begin(), m_vehicles.end(), max_pos,
-        [](double position, const std::shared_ptr<Vehicle> &v) {
-          return position < v->getLanePosition();
-        });
-
-    for (auto it = it_start; it != it_end; ++it) {
-      result.push_back(it->get());
-    }
-
-    return result;
-  }
+  std::vector<Vehicle *> findInRange(double min_pos, double max_pos) const;
 
   /**
    * @brief Get number of vehicles in index.
@@ -190,38 +121,19 @@ public:
   /**
    * @brief Clear index.
    */
-  void clear() {
-    m_vehicles.clear();
-    m_needs_sort = false;
-  }
+  void clear() { m_vehicles.clear(); }
 
   /**
    * @brief Get all vehicles (sorted by position).
    *
    * @return Vector of vehicles
    */
-  const std::vector<std::shared_ptr<Vehicle>> &getVehicles() {
-    if (m_needs_sort) {
-      sortVehicles();
-      m_needs_sort = false;
-    }
+  const std::vector<std::shared_ptr<Vehicle>> &getVehicles() const {
     return m_vehicles;
   }
 
 private:
   std::vector<std::shared_ptr<Vehicle>> m_vehicles;
-  bool m_needs_sort = false;
-
-  /**
-   * @brief Sort vehicles by lane position.
-   */
-  void sortVehicles() {
-    std::sort(m_vehicles.begin(), m_vehicles.end(),
-              [](const std::shared_ptr<Vehicle> &a,
-                 const std::shared_ptr<Vehicle> &b) {
-                return a->getLanePosition() < b->getLanePosition();
-              });
-  }
 };
 
 } // namespace model
@@ -1,9 +1,17 @@
 #ifndef JAMFREE_KERNEL_MODEL_TRAFFIC_CONTROL_H
 #define JAMFREE_KERNEL_MODEL_TRAFFIC_CONTROL_H
 
+#include "Lane.h"
 #include "Point2D.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <queue>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace jamfree {
@@ -76,6 +84,30 @@ public:
    */
   virtual void update(double dt) {}
 
+  /**
+   * @brief Get the time until the state changes by itself.
+   *
+   * The TrafficControlManager updates a control only when this time has
+   * passed, or on a detector event. The default, zero, updates the control
+   * at each step.
+   *
+   * @return Time (seconds), infinite if the state never changes by itself
+   */
+  virtual double getTimeToNextChange() const { return 0.0; }
+
+  /**
+   * @brief Check if the control reads detectors, polled at each step.
+   */
+  virtual bool hasDetectors() const { return false; }
+
+  /**
+   * @brief Read the detectors of the control.
+   *
+   * @return True if the detections change the time of the next change,
+   *         in which case the control is updated at once
+   */
+  virtual bool pollDetectors() { return false; }
+
 protected:
   std::string m_id;
   TrafficControlType m_type;
@@ -102,6 +134,10 @@ public:
   }
 
   double getStoppingDistance() const override { return 10.0; }
+
+  double getTimeToNextChange() const override {
+    return std::numeric_limits<double>::infinity();
+  }
 };
 
 /**
@@ -163,6 +199,10 @@ public:
     }
   }
 
+  double getTimeToNextChange() const override {
+    return std::max(0.0, m_phases[m_current_phase].duration - m_phase_time);
+  }
+
   LightPhase getCurrentPhase() const { return m_phases[m_current_phase].phase; }
 
   void setPhase(LightPhase phase) {
@@ -178,12 +218,123 @@ public:
 
   double getStoppingDistance() const override { return 15.0; }
 
-private:
+protected:
   size_t m_current_phase;
   double m_phase_time;
   std::vector<PhaseConfig> m_phases;
 };
 
+/**
+ * @brief Loop detector counting the vehicles over a position of a lane.
+ *
+ * A poll counts the vehicles of the lane now between the position and the
+ * last vehicle that was behind it at the previous poll, which crossed it
+ * since, the vehicles of a lane keeping their order. The lane is to be
+ * sorted, as after Lane::sortVehicles().
+ */
+class LoopDetector {
+public:
+  /**
+   * @param lane Lane
+   * @param position Position along the lane (meters)
+   */
+  LoopDetector(std::shared_ptr<Lane> lane, double position)
+      : m_lane(std::move(lane)), m_position(position) {}
+
+  /**
+   * @brief Count the vehicles that crossed since the previous poll.
+   *
+   * @return Number of vehicles
+   */
+  int poll();
+
+  /**
+   * @brief Get the number of vehicles counted since the creation.
+   */
+  long getCount() const { return m_count; }
+
+  const std::shared_ptr<Lane> &getLane() const { return m_lane; }
+  double getPosition() const { return m_position; }
+
+private:
+  std::shared_ptr<Lane> m_lane;
+  double m_position;
+  std::weak_ptr<Vehicle> m_upstream;
+  long m_count = 0;
+};
+
+/**
+ * @brief Traffic light whose green phases last as long as the demand.
+ *
+ * A green phase lasts at least the minimum green, then ends once the
+ * detectors have counted no vehicle for the extension time (gap-out), or
+ * at the maximum green (max-out). The other phases last their configured
+ * durations.
+ */
+class ActuatedTrafficLight : public TrafficLight {
+public:
+  /**
+   * @brief Timing of the green phases.
+   */
+  struct Timing {
+    double min_green = 10.0; ///< Seconds
+    double max_green = 60.0; ///< Seconds
+    double extension = 3.0;  ///< Seconds added by a vehicle detected
+
+    Timing() = default;
+  };
+
+  /**
+   * @param id Identifier
+   * @param position Position
+   * @param phases Phases, as TrafficLight; the durations of the green ones
+   *               are not used
+   * @param timing Timing of the green phases
+   * @throws std::invalid_argument If the minimum green is above the maximum
+   */
+  ActuatedTrafficLight(const std::string &id, const Point2D &position,
+                       const std::vector<PhaseConfig> &phases,
+                       const Timing &timing);
+
+  ActuatedTrafficLight(const std::string &id, const Point2D &position,
+                       const std::vector<PhaseConfig> &phases = {})
+      : ActuatedTrafficLight(id, position, phases, Timing()) {}
+
+  /**
+   * @brief Add a detector whose vehicles extend the green phases.
+   *
+   * @param lane Lane
+   * @param position Position along the lane (meters)
+   */
+  void addDetector(std::shared_ptr<Lane> lane, double position) {
+    m_detectors.emplace_back(std::move(lane), position);
+  }
+
+  const std::vector<LoopDetector> &getDetectors() const { return m_detectors; }
+
+  bool hasDetectors() const override { return !m_detectors.empty(); }
+
+  /**
+   * @return True if vehicles were detected during a green phase
+   */
+  bool pollDetectors() override;
+
+  void update(double dt) override;
+
+  double getTimeToNextChange() const override;
+
+  /**
+   * @brief Get the time the current phase is to last, so far (seconds).
+   */
+  double getPhaseDuration() const;
+
+private:
+  Timing m_timing;
+  std::vector<LoopDetector> m_detectors;
+  double m_green_end;
+  int m_pending = 0; // Vehicles detected since the last update
+};
+
 /**
  * @brief Yield sign.
  */
@@ -204,71 +355,120 @@ public:
   }
 
   double getStoppingDistance() const override { return 8.0; }
+
+  double getTimeToNextChange() const override {
+    return std::numeric_limits<double>::infinity();
+  }
 };
 
 /**
  * @brief Manager for traffic control devices.
+ *
+ * The controls are indexed by a uniform grid of their positions, so that
+ * getControlsNear() visits the cells around a position only. update() is
+ * event-driven: each control is updated only when its next change is due,
+ * from getTimeToNextChange(), with the time since its previous update, or
+ * at once when its detectors change its schedule. A light is then updated
+ * at the same steps as if it were updated at each one, and the idle
+ * controls, such as signs, cost nothing.
  */
 class TrafficControlManager {
 public:
   /**
-   * @brief Add traffic control device.
+   * @param cell_size Side of the cells of the grid (meters)
+   * @throws std::invalid_argument If the cell size is not positive
    */
-  void addControl(std::shared_ptr<TrafficControl> control) {
-    m_controls.push_back(control);
-  }
+  explicit TrafficControlManager(double cell_size = 100.0);
+
+  /**
+   * @brief Add traffic control device, with its detectors if any.
+   */
+  void addControl(std::shared_ptr<TrafficControl> control);
 
   /**
    * @brief Remove traffic control device.
    */
-  void removeControl(const std::string &id) {
-    m_controls.erase(
-        std::remove_if(m_controls.begin(), m_controls.end(),
-                       [&id](const auto &c) { return c->getId() == id; }),
-        m_controls.end());
-  }
+  void removeControl(const std::string &id);
+
+  /**
+   * @brief Schedule a control again, after a change of its state such as
+   * TrafficLight::setPhase().
+   */
+  void reschedule(const std::string &id);
 
   /**
    * @brief Get all controls near a position.
    */
   std::vector<std::shared_ptr<TrafficControl>>
-  getControlsNear(const Point2D &position, double radius) const {
-    std::vector<std::shared_ptr<TrafficControl>> result;
+  getControlsNear(const Point2D &position, double radius) const;
 
-    for (const auto &control : m_controls) {
-      if (control->getPosition().distanceTo(position) <= radius) {
-        result.push_back(control);
+  /**
+   * @brief Call body(control) for each control near a position, until it
+   * returns false.
+   *
+   * @return False if body returned false, true otherwise
+   */
+  template <typename Body>
+  bool forEachControlNear(const Point2D &position, double radius,
+                          Body body) const {
+    const auto visit = [&](const std::vector<std::shared_ptr<TrafficControl>>
+                               &cell) {
+      for (const auto &control : cell) {
+        if (control->getPosition().distanceTo(position) <= radius &&
+            !body(control)) {
+          return false;
+        }
+      }
+      return true;
+    };
+    // Beyond as many cells as in use, visit these instead
+    const double span = 2.0 * radius / m_cell_size + 1.0;
+    if (!(span * span <= static_cast<double>(m_grid.size()))) {
+      for (const auto &cell : m_grid) {
+        if (!visit(cell.second)) {
+          return false;
+        }
+      }
+      return true;
+    }
+    const std::int64_t min_column = cellOf(position.x - radius);
+    const std::int64_t max_column = cellOf(position.x + radius);
+    const std::int64_t min_row = cellOf(position.y - radius);
+    const std::int64_t max_row = cellOf(position.y + radius);
+    for (std::int64_t column = min_column; column <= max_column; ++column) {
+      for (std::int64_t row = min_row; row <= max_row; ++row) {
+        const auto found = m_grid.find(cellKey(column, row));
+        if (found != m_grid.end() && !visit(found->second)) {
+          return false;
+        }
       }
     }
-
-    return result;
+    return true;
   }
 
   /**
-   * @brief Update all time-dependent controls.
+   * @brief Update the time-dependent controls whose change is due.
+   *
+   * @param dt Time step (seconds)
    */
-  void update(double dt) {
-    for (auto &control : m_controls) {
-      control->update(dt);
-    }
-  }
+  void update(double dt);
+
+  /**
+   * @brief Get the time since the creation (seconds).
+   */
+  double getTime() const { return m_time; }
+
+  /**
+   * @brief Get the number of control updates of the previous update().
+   */
+  std::size_t getNumUpdated() const { return m_num_updated; }
 
   /**
    * @brief Check if vehicle should stop for any control.
    */
   bool shouldStopForControl(const Point2D &vehicle_position,
                             double vehicle_speed,
-                            double look_ahead_distance = 50.0) const {
-    auto nearby = getControlsNear(vehicle_position, look_ahead_distance);
-
-    for (const auto &control : nearby) {
-      if (control->shouldStop(vehicle_position, vehicle_speed)) {
-        return true;
-      }
-    }
-
-    return false;
-  }
+                            double look_ahead_distance = 50.0) const;
 
   /**
    * @brief Get all controls.
@@ -278,7 +478,42 @@ public:
   }
 
 private:
+  struct Entry {
+    std::shared_ptr<TrafficControl> control;
+    double last_update;
+    std::uint64_t version = 0; // Of the event to come
+    bool removed = false;
+  };
+
+  struct Event {
+    double time;
+    std::uint64_t version;
+    std::shared_ptr<Entry> entry;
+
+    bool operator>(const Event &other) const { return time > other.time; }
+  };
+
+  double m_cell_size;
+  double m_time = 0.0;
+  std::size_t m_num_updated = 0;
   std::vector<std::shared_ptr<TrafficControl>> m_controls;
+  std::vector<std::shared_ptr<Entry>> m_entries; // As m_controls
+  std::vector<std::shared_ptr<Entry>> m_detecting;
+  std::unordered_map<std::int64_t, std::vector<std::shared_ptr<TrafficControl>>>
+      m_grid;
+  std::priority_queue<Event, std::vector<Event>, std::greater<Event>>
+      m_events;
+  std::vector<std::shared_ptr<Entry>> m_due;
+
+  std::int64_t cellKey(std::int64_t column, std::int64_t row) const {
+    return column * 0x100000000LL + (row & 0xFFFFFFFFLL);
+  }
+  std::int64_t cellOf(double coordinate) const {
+    return static_cast<std::int64_t>(std::floor(coordinate / m_cell_size));
+  }
+
+  void schedule(const std::shared_ptr<Entry> &entry);
+  void updateEntry(Entry &entry);
 };
 
 } // namespace model
@@ -34,7 +34,32 @@ public:
         ,
         m_max_speed(max_speed), m_max_accel(max_accel), m_max_decel(max_decel),
         m_position(0.0, 0.0), m_speed(0.0), m_acceleration(0.0), m_heading(0.0),
-        m_lane_position(0.0), m_current_lane(nullptr) {}
+        m_lane_position(0.0), m_pending_time(0.0), m_current_lane(nullptr),
+        m_position_stale(false) {}
+
+  /**
+   * @brief Reset to the state of a new vehicle, for a pool to reuse it.
+   *
+   * The parameters of the constructor.
+   */
+  void reset(const std::string &id, double length = 5.0,
+             double max_speed = 55.0, double max_accel = 3.0,
+             double max_decel = 6.0) {
+    m_id = id;
+    m_length = length;
+    m_width = 2.0;
+    m_max_speed = max_speed;
+    m_max_accel = max_accel;
+    m_max_decel = max_decel;
+    m_position = Point2D(0.0, 0.0);
+    m_speed = 0.0;
+    m_acceleration = 0.0;
+    m_heading = 0.0;
+    m_lane_position = 0.0;
+    m_pending_time = 0.0;
+    m_current_lane.reset();
+    m_position_stale = false;
+  }
 
   // Getters - Identity
   const std::string &getId() const { return m_id; }
@@ -47,11 +72,27 @@ public:
   double getMaxDecel() const { return m_max_decel; }
 
   // Getters - State
-  const Point2D &getPosition() const { return m_position; }
-  double getSpeed() const { return m_speed; }
+  /**
+   * @brief Get the 2D position, computed from the lane position on the
+   * first read after a move (see invalidatePosition()).
+   */
+  const Point2D &getPosition() const {
+    materializePosition();
+    return m_position;
+  }
+  double getSpeed() const {
+    return m_pending_time > 0.0 ? caughtUpSpeed() : m_speed;
+  }
   double getAcceleration() const { return m_acceleration; }
-  double getHeading() const { return m_heading; }
-  double getLanePosition() const { return m_lane_position; }
+  double getHeading() const {
+    materializePosition();
+    return m_heading;
+  }
+  double getLanePosition() const {
+    return m_pending_time > 0.0
+               ? m_lane_position + caughtUpSpeed() * m_pending_time
+               : m_lane_position;
+  }
   std::shared_ptr<Lane> getCurrentLane() const { return m_current_lane; }
 
   // Setters - Properties
@@ -62,11 +103,26 @@ public:
   void setMaxDecel(double max_decel) { m_max_decel = max_decel; }
 
   // Setters - State
-  void setPosition(const Point2D &position) { m_position = position; }
-  void setSpeed(double speed) { m_speed = std::max(0.0, speed); }
-  void setAcceleration(double acceleration) { m_acceleration = acceleration; }
-  void setHeading(double heading) { m_heading = heading; }
-  void setLanePosition(double position) { m_lane_position = position; }
+  void setPosition(const Point2D &position) {
+    materializePosition();
+    m_position = position;
+  }
+  void setSpeed(double speed) {
+    catchUp();
+    m_speed = std::max(0.0, speed);
+  }
+  void setAcceleration(double acceleration) {
+    catchUp();
+    m_acceleration = acceleration;
+  }
+  void setHeading(double heading) {
+    materializePosition();
+    m_heading = heading;
+  }
+  void setLanePosition(double position) {
+    catchUp();
+    m_lane_position = position;
+  }
   void setCurrentLane(std::shared_ptr<Lane> lane) { m_current_lane = lane; }
 
   // Convenience methods (aliases)
@@ -77,6 +133,20 @@ public:
     m_current_lane.reset(lane, [](Lane *) {}); // Non-owning shared_ptr
   }
 
+  /**
+   * @brief Mark the 2D position and heading as out of date after the lane
+   * position moved.
+   *
+   * They are computed from the geometry of the lane by the next read of
+   * getPosition(), getHeading() or the front and rear positions, e.g. by a
+   * probe or a web frame, so that the steps of a headless run, which only
+   * need the lane positions, skip the geometry. The reads must not overlap
+   * the updates of the vehicle, as for the other state.
+   */
+  void invalidatePosition() {
+    m_position_stale = m_current_lane && m_current_lane->getParentRoad();
+  }
+
   /**
    * @brief Update vehicle state for one time step.
    *
@@ -84,6 +154,8 @@ public:
    * @param acceleration Desired acceleration (m/s²)
    */
   void update(double dt, double acceleration) {
+    catchUp();
+
     // Clamp acceleration to vehicle limits
     acceleration = std::max(-m_max_decel, std::min(m_max_accel, acceleration));
     m_acceleration = acceleration;
@@ -95,19 +167,58 @@ public:
     // Update position along lane
     m_lane_position += m_speed * dt;
 
-    // Update 2D position if we have a lane
-    if (m_current_lane && m_current_lane->getParentRoad()) {
-      m_position = m_current_lane->getPositionAt(m_lane_position);
-      m_heading = m_current_lane->getHeadingAt(m_lane_position);
+    // The 2D position follows on demand
+    invalidatePosition();
+  }
+
+  /**
+   * @brief Advance the vehicle by a time step at a held acceleration,
+   * integrated later in one step, for a multi-rate scheme.
+   *
+   * The state read through the getters is the one the vehicle has at the
+   * end of the step, projected from its last integration as update() would
+   * compute it over the time deferred; catchUp(), or any update() or
+   * setter, integrates it, so that the integration is invisible to the
+   * readers. A held acceleration different from the current one first
+   * integrates the time deferred with the current one.
+   *
+   * @param dt Time step (seconds)
+   * @param acceleration Held acceleration (m/s²), clamped as by update()
+   */
+  void defer(double dt, double acceleration) {
+    acceleration = std::max(-m_max_decel, std::min(m_max_accel, acceleration));
+    if (acceleration != m_acceleration) {
+      catchUp();
+      m_acceleration = acceleration;
+    }
+    m_pending_time += dt;
+    invalidatePosition();
+  }
+
+  /**
+   * @brief Integrate the time deferred by defer(), in one step.
+   */
+  void catchUp() {
+    if (m_pending_time > 0.0) {
+      const double dt = m_pending_time;
+      m_pending_time = 0.0;
+      m_speed = caughtUpSpeed(dt);
+      m_lane_position += m_speed * dt;
     }
   }
 
+  /**
+   * @brief Get the time deferred since the last integration (seconds).
+   */
+  double getPendingTime() const { return m_pending_time; }
+
   /**
    * @brief Get front position of vehicle.
    *
    * @return Position of vehicle front
    */
   Point2D getFrontPosition() const {
+    materializePosition();
     return m_position + Point2D(m_length * std::cos(m_heading),
                                 m_length * std::sin(m_heading));
   }
@@ -117,7 +228,7 @@ public:
    *
    * @return Position of vehicle rear
    */
-  Point2D getRearPosition() const { return m_position; }
+  Point2D getRearPosition() const { return getPosition(); }
 
   /**
    * @brief Get distance to vehicle ahead.
@@ -128,7 +239,7 @@ public:
   double getGapTo(const Vehicle &leader) const {
     // Gap = leader rear position - this front position
     double leader_rear = leader.getLanePosition();
-    double this_front = m_lane_position + m_length;
+    double this_front = getLanePosition() + m_length;
     return leader_rear - this_front;
   }
 
@@ -139,7 +250,7 @@ public:
    * @return Speed difference (m/s), positive if approaching
    */
   double getRelativeSpeedTo(const Vehicle &leader) const {
-    return m_speed - leader.getSpeed();
+    return getSpeed() - leader.getSpeed();
   }
 
   /**
@@ -148,7 +259,9 @@ public:
    * @param threshold Speed threshold (m/s)
    * @return True if speed below threshold
    */
-  bool isStopped(double threshold = 0.1) const { return m_speed < threshold; }
+  bool isStopped(double threshold = 0.1) const {
+    return getSpeed() < threshold;
+  }
 
 private:
   // Identity
@@ -162,12 +275,32 @@ private:
   double m_max_decel;
 
   // State (dynamic)
-  Point2D m_position;     ///< 2D position
-  double m_speed;         ///< Current speed (m/s)
-  double m_acceleration;  ///< Current acceleration (m/s²)
-  double m_heading;       ///< Direction (radians)
-  double m_lane_position; ///< Position along current lane (meters)
+  mutable Point2D m_position; ///< 2D position
+  double m_speed;             ///< Current speed (m/s)
+  double m_acceleration;      ///< Current acceleration (m/s²)
+  mutable double m_heading;   ///< Direction (radians)
+  double m_lane_position;     ///< Position along current lane (meters)
+  double m_pending_time;      ///< Deferred at m_acceleration (seconds)
   std::shared_ptr<Lane> m_current_lane; ///< Current lane
+  mutable bool m_position_stale; ///< 2D position behind the lane position
+
+  /** The speed update() reaches over the time deferred */
+  double caughtUpSpeed(double dt) const {
+    return std::max(0.0, std::min(m_max_speed, m_speed + m_acceleration * dt));
+  }
+  double caughtUpSpeed() const { return caughtUpSpeed(m_pending_time); }
+
+  void materializePosition() const {
+    if (m_position_stale) {
+      m_position_stale = false;
+      Lane *lane = m_current_lane.get();
+      if (lane && lane->getParentRoad()) {
+        const double lane_position = getLanePosition();
+        m_position = lane->getPositionAt(lane_position);
+        m_heading = lane->getHeadingAt(lane_position);
+      }
+    }
+  }
 };
 
 } // namespace model
@@ -0,0 +1,138 @@
+#ifndef JAMFREE_KERNEL_MODEL_VEHICLE_FRAME_CODEC_H
+#define JAMFREE_KERNEL_MODEL_VEHICLE_FRAME_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace jamfree {
+namespace kernel {
+namespace model {
+
+/**
+ * @brief Area the vehicles of a network stay in (m).
+ */
+struct FrameBounds {
+  double min_x = 0.0;
+  double min_y = 0.0;
+  double max_x = 0.0;
+  double max_y = 0.0;
+};
+
+/**
+ * @brief Compact binary frames of vehicle states, for a viewer.
+ *
+ * A frame holds the position, speed, heading and lane of each row of
+ * exportVehicleStates(), quantized: the positions to a resolution from the
+ * corner of the network bounds, the speeds to a resolution, the heading to
+ * 1/65536 turn. Each value is written as the zigzag varint of its
+ * difference with the one of the same row in the previous frame, column
+ * after column, so that the slow changes of a step take a byte or two per
+ * vehicle; a key frame, every few frames, differs from zero, for the
+ * viewers joining. The payload may also be deflated by zlib.
+ *
+ * Layout, little-endian:
+ * - "JF", version 1, flags (1: key frame, 2: deflated payload);
+ * - varint frame number, varint number of vehicles;
+ * - float64 min_x, min_y, float32 position and speed resolutions;
+ * - if deflated, varint size of the payload inflated;
+ * - payload: the differences of x, then y, speed, heading and lane.
+ */
+class VehicleFrameEncoder {
+public:
+  /**
+   * @brief Encoding parameters.
+   */
+  struct Config {
+    double position_resolution = 0.1; ///< m
+    double speed_resolution = 0.1;    ///< m/s
+
+    /// Frames from a key frame to the next one, 1 for key frames only
+    std::size_t keyframe_interval = 30;
+
+    /// Deflate the payload, if JamFree was built with zlib
+    bool compress = false;
+
+    Config() = default;
+  };
+
+  explicit VehicleFrameEncoder(const FrameBounds &bounds);
+
+  /**
+   * @throws std::invalid_argument If a resolution is not positive, or the
+   *         key frame interval is 0
+   */
+  VehicleFrameEncoder(const FrameBounds &bounds, const Config &config);
+
+  /**
+   * @brief Encode the next frame.
+   *
+   * @param rows Rows of exportVehicleStates(), NaN values as 0
+   * @param num_vehicles Number of rows
+   * @param frame Set to the frame
+   */
+  void encode(const double *rows, std::size_t num_vehicles,
+              std::vector<std::uint8_t> &frame);
+
+  /**
+   * @brief Make the next frame a key frame, for a viewer joining.
+   */
+  void requestKeyFrame() { m_key_requested = true; }
+
+  /**
+   * @brief Get the number of the next frame.
+   */
+  std::uint64_t getFrameNumber() const { return m_frame_number; }
+
+  const Config &getConfig() const { return m_config; }
+
+private:
+  FrameBounds m_bounds;
+  Config m_config;
+  std::uint64_t m_frame_number = 0;
+  bool m_key_requested = true;
+  std::vector<std::int64_t> m_previous; // Quantized, column after column
+  std::vector<std::int64_t> m_current;
+  std::vector<std::uint8_t> m_payload;
+};
+
+/**
+ * @brief Decoder of the frames of VehicleFrameEncoder.
+ */
+class VehicleFrameDecoder {
+public:
+  /**
+   * @brief Decode a frame.
+   *
+   * The rows get the vehicle index, the lane, the position, the speed and
+   * the heading of the frame; the lane position and the acceleration,
+   * which the frames do not carry, are NaN.
+   *
+   * @param data Frame
+   * @param size Size of the frame
+   * @param rows Set to the rows of exportVehicleStates(), if decoded
+   * @return False if the frame differs from one not decoded: the frames
+   *         are to be decoded in order, from a key frame
+   * @throws std::runtime_error If the frame is malformed
+   */
+  bool decode(const std::uint8_t *data, std::size_t size,
+              std::vector<double> &rows);
+
+  /**
+   * @brief Get the number of the last frame decoded.
+   */
+  std::uint64_t getFrameNumber() const { return m_frame_number; }
+
+private:
+  bool m_has_frame = false;
+  std::uint64_t m_frame_number = 0;
+  std::vector<std::int64_t> m_previous;
+  std::vector<std::int64_t> m_current;
+  std::vector<std::uint8_t> m_payload;
+};
+
+} // namespace model
+} // namespace kernel
+} // namespace jamfree
+
+#endif // JAMFREE_KERNEL_MODEL_VEHICLE_FRAME_CODEC_H
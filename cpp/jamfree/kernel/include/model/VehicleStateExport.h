@@ -0,0 +1,62 @@
+#ifndef JAMFREE_KERNEL_MODEL_VEHICLE_STATE_EXPORT_H
+#define JAMFREE_KERNEL_MODEL_VEHICLE_STATE_EXPORT_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace jamfree {
+namespace kernel {
+namespace model {
+
+class Vehicle;
+
+/**
+ * @brief Columns of a row of exported vehicle state.
+ */
+enum VehicleStateColumn : std::size_t {
+  STATE_VEHICLE_INDEX,  ///< Index of the vehicle in the exported ones
+  STATE_LANE_INDEX,     ///< Index of its lane in its road, -1 if none
+  STATE_LANE_POSITION,  ///< Position along the lane (m)
+  STATE_X,              ///< Position (m)
+  STATE_Y,              ///< Position (m)
+  STATE_SPEED,          ///< Speed (m/s)
+  STATE_ACCELERATION,   ///< Acceleration (m/s²)
+  STATE_HEADING,        ///< Heading (radians)
+  NUM_STATE_COLUMNS
+};
+
+/**
+ * @brief Write the state of a vehicle into a row of doubles.
+ *
+ * @param vehicle Vehicle
+ * @param index Vehicle index of the row
+ * @param row Row of NUM_STATE_COLUMNS doubles
+ */
+void writeVehicleState(const Vehicle &vehicle, std::size_t index,
+                       double *row);
+
+/**
+ * @brief Write the states of vehicles into rows of doubles.
+ *
+ * The row i, at rows + i * NUM_STATE_COLUMNS, holds the state of the
+ * vehicle i, so that a caller draws the vehicles from one buffer without
+ * asking each one for its fields.
+ *
+ * @param vehicles Vehicles
+ * @param rows Rows to fill
+ * @param capacity Number of rows, the vehicles beyond being left out
+ * @param first_index Vehicle index of the first vehicle, for the rows of
+ *                    several sets of vehicles in one buffer
+ * @return Number of vehicles, which may exceed the capacity
+ */
+std::size_t
+exportVehicleStates(const std::vector<std::shared_ptr<Vehicle>> &vehicles,
+                    double *rows, std::size_t capacity,
+                    std::size_t first_index = 0);
+
+} // namespace model
+} // namespace kernel
+} // namespace jamfree
+
+#endif // JAMFREE_KERNEL_MODEL_VEHICLE_STATE_EXPORT_H
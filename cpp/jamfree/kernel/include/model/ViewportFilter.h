@@ -0,0 +1,157 @@
+#ifndef JAMFREE_KERNEL_MODEL_VIEWPORT_FILTER_H
+#define JAMFREE_KERNEL_MODEL_VIEWPORT_FILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace jamfree {
+namespace kernel {
+namespace model {
+
+class Road;
+class Vehicle;
+
+/**
+ * @brief Area of the network a viewer draws (m), and its zoom.
+ */
+struct Viewport {
+  double min_x = 0.0;
+  double min_y = 0.0;
+  double max_x = 0.0;
+  double max_y = 0.0;
+
+  /// Zoom level of the map, one more for twice the detail
+  double zoom = 0.0;
+};
+
+/**
+ * @brief Vehicles of a viewport, counted by square tiles.
+ *
+ * The tile (column, row) covers [origin_x + column * tile_size,
+ * origin_x + (column + 1) * tile_size) along x, and the same along y from
+ * origin_y; the tiles are row-major.
+ */
+struct DensityTiles {
+  double origin_x = 0.0;
+  double origin_y = 0.0;
+  double tile_size = 0.0; ///< m
+  std::size_t columns = 0;
+  std::size_t rows = 0;
+  std::vector<std::uint32_t> counts;
+  std::vector<float> mean_speeds; ///< m/s, 0 for an empty tile
+};
+
+/**
+ * @brief The vehicles a viewer sees, at the level of detail of its zoom.
+ *
+ * A viewer zoomed in gets the states of the vehicles in its viewport only;
+ * zoomed out, below the detail zoom, it gets their counts by tile instead,
+ * the side of the tiles doubling at each zoom level less. Either way, what
+ * a viewer is sent depends on its screen more than on the network.
+ *
+ * The roads are cut into the bounding boxes of their segments, once: a
+ * query skips the roads out of the viewport, then looks up, in the sorted
+ * vehicles of each lane of a road, the positions along it that the
+ * segments in the viewport span. The geometry of the roads is not to
+ * change while the filter is in use.
+ */
+class ViewportFilter {
+public:
+  /**
+   * @brief Level of detail parameters.
+   */
+  struct Config {
+    /// Lowest zoom at which the vehicles themselves are sent
+    double detail_zoom = 15.0;
+
+    /// Side of a tile at the zoom just below detail_zoom (m)
+    double tile_size = 100.0;
+
+    /// Most tiles of a viewport, the tiles growing beyond
+    std::size_t max_tiles = 16384;
+
+    /// Distance around the viewport the vehicles are still sent from (m)
+    double margin = 10.0;
+
+    Config() = default;
+  };
+
+  explicit ViewportFilter(const std::vector<std::shared_ptr<Road>> &roads);
+
+  /**
+   * @throws std::invalid_argument If tile_size or max_tiles is not
+   *         positive, or margin is negative
+   */
+  ViewportFilter(const std::vector<std::shared_ptr<Road>> &roads,
+                 const Config &config);
+
+  /**
+   * @brief Whether a viewport is sent the vehicles, rather than tiles.
+   */
+  bool isDetailed(const Viewport &viewport) const {
+    return viewport.zoom >= m_config.detail_zoom;
+  }
+
+  /**
+   * @brief Write the states of the vehicles in a viewport into rows.
+   *
+   * The rows are those of exportVehicleStates(), numbered in the order of
+   * the roads and their lanes.
+   *
+   * @param viewport Viewport
+   * @param rows Rows to fill
+   * @param capacity Number of rows, the vehicles beyond being left out
+   * @return Number of vehicles in the viewport, which may exceed capacity
+   */
+  std::size_t exportVisibleStates(const Viewport &viewport, double *rows,
+                                  std::size_t capacity) const;
+
+  /**
+   * @brief Count the vehicles in a viewport by tile.
+   *
+   * The tiles are aligned on multiples of their side, so that they stay
+   * the same as the viewport pans.
+   *
+   * @param viewport Viewport
+   * @param tiles Set to the tiles covering the viewport
+   */
+  void exportDensityTiles(const Viewport &viewport,
+                          DensityTiles &tiles) const;
+
+  /**
+   * @brief Get the side of the tiles at the zoom of a viewport (m).
+   */
+  double getTileSize(const Viewport &viewport) const;
+
+  const Config &getConfig() const { return m_config; }
+
+private:
+  // A segment of a road, with its bounding box
+  struct Segment {
+    double begin; // Distance along the road (m)
+    double end;
+    double min_x, min_y, max_x, max_y;
+  };
+
+  struct RoadEntry {
+    std::shared_ptr<Road> road;
+    std::size_t first_segment;
+    std::size_t end_segment;
+    double min_x, min_y, max_x, max_y;
+  };
+
+  Config m_config;
+  std::vector<RoadEntry> m_roads;
+  std::vector<Segment> m_segments;
+
+  template <typename Visitor>
+  void forEachVisible(const Viewport &viewport, Visitor visit) const;
+};
+
+} // namespace model
+} // namespace kernel
+} // namespace jamfree
+
+#endif // JAMFREE_KERNEL_MODEL_VIEWPORT_FILTER_H
@@ -0,0 +1,126 @@
+#ifndef JAMFREE_KERNEL_ROUTING_NETWORK_PARTITION_H
+#define JAMFREE_KERNEL_ROUTING_NETWORK_PARTITION_H
+
+#include "RoadGraph.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace jamfree {
+namespace kernel {
+namespace routing {
+
+/**
+ * @brief Partition of a road graph into balanced parts, one per rank of a
+ * distributed simulation.
+ *
+ * The nodes are partitioned and each edge belongs to the part of its
+ * source, so that the vehicles leaving a node are simulated by one part: a
+ * vehicle changes part only at the end of a cut edge, whose endpoints lie
+ * in different parts.
+ *
+ * The partition is computed as METIS does, by multilevel recursive
+ * bisection: the graph is coarsened by heavy-edge matching, the coarsest
+ * graph is bisected by greedy graph growing, and the bisection is refined
+ * by Fiduccia-Mattheyses moves while it is projected back to the finer
+ * graphs. The weight of an edge, the cost of simulating it, is its length
+ * in lane-km plus the vehicles expected on it; the cost of cutting it is
+ * the exchange of the leaders of its lanes plus the handoff of these
+ * vehicles.
+ */
+class NetworkPartition {
+public:
+  struct Options {
+    double imbalance = 1.05;         ///< Largest part weight over the mean
+    double lane_km_weight = 1.0;     ///< Weight of a lane-km of edge
+    std::size_t coarsest_nodes = 64; ///< Nodes at which coarsening stops
+    int refinement_passes = 8;       ///< Moves passes at each level
+
+    // Explicit default constructor
+    Options() = default;
+  };
+
+  /**
+   * @brief Partition a graph.
+   *
+   * @param graph Road graph, which must outlive the partition
+   * @param num_parts Number of parts, at least 1
+   * @param demand Vehicles expected on each edge, e.g. the flow of the
+   *               routed trips times the travel time, or empty for none
+   * @param options Options of the partitioning
+   * @throws std::invalid_argument If there are no parts, or if the demand
+   *         is neither empty nor of one value per edge
+   */
+  NetworkPartition(const RoadGraph &graph, std::size_t num_parts,
+                   const std::vector<double> &demand, const Options &options);
+
+  /**
+   * @brief Partition a graph, with the default options.
+   */
+  NetworkPartition(const RoadGraph &graph, std::size_t num_parts,
+                   const std::vector<double> &demand = {})
+      : NetworkPartition(graph, num_parts, demand, Options()) {}
+
+  std::size_t getNumParts() const { return m_part_weights.size(); }
+
+  std::uint32_t getPartOfNode(std::uint32_t node) const {
+    return m_node_parts[node];
+  }
+
+  /**
+   * @brief Get the part of an edge, the part of its source.
+   */
+  std::uint32_t getPartOfEdge(std::uint32_t edge) const {
+    return m_node_parts[m_graph.getSource(edge)];
+  }
+
+  /**
+   * @brief Check whether the vehicles leaving an edge change part.
+   */
+  bool isCutEdge(std::uint32_t edge) const {
+    return m_node_parts[m_graph.getSource(edge)] !=
+           m_node_parts[m_graph.getTarget(edge)];
+  }
+
+  const std::vector<std::uint32_t> &getNodeParts() const {
+    return m_node_parts;
+  }
+
+  /**
+   * @brief Get the weights of the edges, as partitioned.
+   */
+  const std::vector<double> &getEdgeWeights() const { return m_edge_weights; }
+
+  /**
+   * @brief Get the sum of the weights of the edges of each part.
+   */
+  const std::vector<double> &getPartWeights() const { return m_part_weights; }
+
+  /**
+   * @brief Get the largest part weight over the mean part weight.
+   */
+  double getImbalance() const;
+
+  /**
+   * @brief Get the sum of the costs of the cut edges.
+   */
+  double getCutCost() const { return m_cut_cost; }
+
+  std::size_t getNumCutEdges() const { return m_num_cut_edges; }
+
+  const RoadGraph &getGraph() const { return m_graph; }
+
+private:
+  const RoadGraph &m_graph;
+  std::vector<std::uint32_t> m_node_parts;
+  std::vector<double> m_edge_weights;
+  std::vector<double> m_part_weights;
+  double m_cut_cost = 0.0;
+  std::size_t m_num_cut_edges = 0;
+};
+
+} // namespace routing
+} // namespace kernel
+} // namespace jamfree
+
+#endif // JAMFREE_KERNEL_ROUTING_NETWORK_PARTITION_H
@@ -0,0 +1,202 @@
+#ifndef JAMFREE_KERNEL_ROUTING_ROAD_GRAPH_H
+#define JAMFREE_KERNEL_ROUTING_ROAD_GRAPH_H
+
+#include "../model/Point2D.h"
+#include "../model/Road.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace jamfree {
+namespace kernel {
+namespace routing {
+
+/**
+ * @brief Directed graph of a road network in compressed sparse row form.
+ *
+ * The endpoints of the roads are the nodes, the roads ending at the same
+ * point sharing a node, and each road is an edge from its start to its
+ * end. The outgoing edges of node v are the indices in
+ * [getFirstEdge(v), getFirstEdge(v + 1)), the incoming ones being kept the
+ * same way for the searches toward a node. The lengths and the free-flow
+ * travel times of the edges are flat arrays, so that a search reads no
+ * road.
+ */
+class RoadGraph {
+public:
+  /**
+   * @brief Value of a node or an edge that does not exist
+   */
+  static constexpr std::uint32_t NONE = 0xffffffffu;
+
+  /**
+   * @brief Build the graph of roads.
+   *
+   * The roads without lanes are left out.
+   *
+   * @param roads Roads, each one an edge in the direction of its lanes
+   */
+  explicit RoadGraph(const std::vector<std::shared_ptr<model::Road>> &roads);
+
+  std::size_t getNumNodes() const { return m_positions.size(); }
+  std::size_t getNumEdges() const { return m_targets.size(); }
+
+  const model::Point2D &getPosition(std::uint32_t node) const {
+    return m_positions[node];
+  }
+
+  // Outgoing edges, by source node
+  std::uint32_t getFirstEdge(std::uint32_t node) const {
+    return m_first_edge[node];
+  }
+  std::uint32_t getTarget(std::uint32_t edge) const { return m_targets[edge]; }
+
+  // Incoming edges, by target node, as indices of outgoing edges
+  std::uint32_t getFirstIncomingEdge(std::uint32_t node) const {
+    return m_first_incoming[node];
+  }
+  std::uint32_t getIncomingEdge(std::uint32_t index) const {
+    return m_incoming_edges[index];
+  }
+  std::uint32_t getSource(std::uint32_t edge) const { return m_sources[edge]; }
+
+  /**
+   * @brief Get the lengths of the edges (meters).
+   */
+  const std::vector<double> &getLengths() const { return m_lengths; }
+
+  /**
+   * @brief Get the free-flow travel times of the edges, at the highest
+   * speed limit of their lanes (seconds).
+   */
+  const std::vector<double> &getTimes() const { return m_times; }
+
+  /**
+   * @brief Get the highest speed limit of the network (m/s).
+   */
+  double getMaxSpeed() const { return m_max_speed; }
+
+  /**
+   * @brief Get the edge of a road.
+   *
+   * @param index Index of the road in the roads of the graph
+   * @return Edge, NONE for a road without lanes
+   */
+  std::uint32_t getEdgeOfRoad(std::size_t index) const {
+    return m_road_edges[index];
+  }
+
+  /**
+   * @brief Get the road of an edge.
+   */
+  const std::shared_ptr<model::Road> &getRoad(std::uint32_t edge) const {
+    return m_roads[edge];
+  }
+
+  /**
+   * @brief Find the node nearest to a point.
+   *
+   * @param point Point (meters)
+   * @return Node, NONE if the graph is empty
+   */
+  std::uint32_t findNearestNode(const model::Point2D &point) const;
+
+private:
+  std::vector<model::Point2D> m_positions;
+  std::vector<std::uint32_t> m_first_edge;
+  std::vector<std::uint32_t> m_targets;
+  std::vector<std::uint32_t> m_sources;
+  std::vector<std::uint32_t> m_first_incoming;
+  std::vector<std::uint32_t> m_incoming_edges;
+  std::vector<double> m_lengths;
+  std::vector<double> m_times;
+  std::vector<std::shared_ptr<model::Road>> m_roads;
+  std::vector<std::uint32_t> m_road_edges;
+  double m_max_speed = 0.0;
+
+  // Uniform grid of the nodes, in compressed sparse row form
+  double m_grid_x = 0.0;
+  double m_grid_y = 0.0;
+  double m_cell_size = 1.0;
+  std::size_t m_columns = 0;
+  std::size_t m_rows = 0;
+  std::vector<std::uint32_t> m_first_in_cell;
+  std::vector<std::uint32_t> m_cell_nodes;
+
+  void buildGrid();
+};
+
+/**
+ * @brief ALT preprocessing of a road graph: A*, landmarks and the triangle
+ * inequality.
+ *
+ * Stores the shortest distances from and to a few landmarks, chosen far
+ * apart, for a metric of the edges. For the landmark L,
+ * d(L, t) - d(L, v) and d(v, L) - d(t, L) are lower bounds of d(v, t), so
+ * the largest of them is a consistent A* potential: a query settles the
+ * nodes toward the target only.
+ *
+ * The bounds stay valid for any weights at least the preprocessed ones,
+ * e.g. the travel times in congestion, so the preprocessing is done once
+ * for the free-flow times and the rerouting reuses it.
+ */
+class Landmarks {
+public:
+  /**
+   * @brief Preprocess a graph.
+   *
+   * @param graph Road graph, which must outlive the landmarks
+   * @param weights Weights of the edges
+   * @param count Number of landmarks, at most the number of nodes
+   */
+  Landmarks(const RoadGraph &graph, const std::vector<double> &weights,
+            std::size_t count);
+
+  std::size_t getCount() const { return m_landmarks.size(); }
+
+  const std::vector<std::uint32_t> &getLandmarks() const {
+    return m_landmarks;
+  }
+
+  /**
+   * @brief Get the preprocessed weights of the edges.
+   */
+  const std::vector<double> &getWeights() const { return m_weights; }
+
+  /**
+   * @brief Get a lower bound of the distance between two nodes.
+   *
+   * @return The bound, infinity if target cannot be reached from node
+   */
+  double lowerBound(std::uint32_t node, std::uint32_t target) const;
+
+  /**
+   * @brief Compute the distances from a node (or to it, backward) with
+   * Dijkstra.
+   *
+   * @param graph Road graph
+   * @param weights Weights of the edges
+   * @param source Source node
+   * @param backward Whether to follow the edges backward
+   * @param distances Set to the distance of each node, infinity if out of
+   *                  reach
+   */
+  static void shortestDistances(const RoadGraph &graph,
+                                const std::vector<double> &weights,
+                                std::uint32_t source, bool backward,
+                                std::vector<double> &distances);
+
+private:
+  std::vector<double> m_weights;
+  std::vector<std::uint32_t> m_landmarks;
+  // Node major, so that a bound reads contiguous memory
+  std::vector<double> m_from; // d(L, v) at v * count + L
+  std::vector<double> m_to;   // d(v, L) at v * count + L
+};
+
+} // namespace routing
+} // namespace kernel
+} // namespace jamfree
+
+#endif // JAMFREE_KERNEL_ROUTING_ROAD_GRAPH_H
@@ -0,0 +1,200 @@
+#ifndef JAMFREE_KERNEL_ROUTING_ROUTE_TABLE_H
+#define JAMFREE_KERNEL_ROUTING_ROUTE_TABLE_H
+
+#include "RoadGraph.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace jamfree {
+namespace kernel {
+namespace routing {
+
+struct Route; // Router.h
+
+/**
+ * @brief Position of a vehicle along an interned route: the route and the
+ * index of its current edge.
+ */
+struct RouteProgress {
+  std::uint32_t route;
+  std::uint32_t index;
+};
+
+/**
+ * @brief Routes over a road graph, each distinct one stored once.
+ *
+ * The edges of all the routes are one flat array, route r owning the ones
+ * in [first(r), first(r + 1)), with the lane to use on each edge alongside.
+ * intern() looks a route up by the hash of its edges and lanes, so that the
+ * trips sharing an origin and a destination, the most of a demand, share
+ * one route, and a vehicle keeps a RouteProgress of 8 bytes instead of its
+ * own Route and the shared pointers of its roads. Following a route walks
+ * the array.
+ *
+ * The queries are const; intern() is not.
+ */
+class RouteTable {
+public:
+  using RouteId = std::uint32_t;
+
+  /// Value of no route or no edge
+  static constexpr std::uint32_t NONE = RoadGraph::NONE;
+
+  /**
+   * @param graph Graph of the edges of the routes, which must outlive the
+   *        table, e.g. Router::getGraph()
+   */
+  explicit RouteTable(const RoadGraph &graph);
+
+  const RoadGraph &getGraph() const { return m_graph; }
+
+  /**
+   * @brief Intern a route of roads of the graph.
+   *
+   * @return Identifier of the route, the one of an identical route interned
+   *         before if any; NONE for an empty route
+   * @throws std::invalid_argument If a road is not an edge of the graph, or
+   *         a lane index not in [0, 255]
+   */
+  RouteId intern(const Route &route);
+
+  /**
+   * @brief Intern a route of edges.
+   *
+   * @param lanes Lane index on each edge, nullptr for the first lanes
+   * @throws std::invalid_argument If an edge is not one of the graph
+   */
+  RouteId intern(const std::uint32_t *edges, const std::uint8_t *lanes,
+                 std::size_t num_edges, double total_distance,
+                 double estimated_time, double cost);
+
+  /**
+   * @brief Number of distinct routes.
+   */
+  std::size_t size() const { return m_routes.size() - 1; }
+
+  /**
+   * @brief Number of intern() calls answered by an existing route.
+   */
+  std::size_t getNumShared() const { return m_num_shared; }
+
+  std::size_t getNumEdges(RouteId route) const {
+    return m_routes[route + 1].first - m_routes[route].first;
+  }
+  const std::uint32_t *getEdges(RouteId route) const {
+    return m_edges.data() + m_routes[route].first;
+  }
+  const std::uint8_t *getLanes(RouteId route) const {
+    return m_lanes.data() + m_routes[route].first;
+  }
+  double getTotalDistance(RouteId route) const {
+    return m_routes[route].total_distance;
+  }
+  double getEstimatedTime(RouteId route) const {
+    return m_routes[route].estimated_time;
+  }
+  double getCost(RouteId route) const { return m_routes[route].cost; }
+
+  /**
+   * @brief Expand a route back into its roads.
+   */
+  Route toRoute(RouteId route) const;
+
+  /**
+   * @brief The start of a route.
+   */
+  static RouteProgress begin(RouteId route) { return {route, 0}; }
+
+  bool isFinished(const RouteProgress &progress) const {
+    return progress.route == NONE ||
+           progress.index >= getNumEdges(progress.route);
+  }
+
+  /**
+   * @brief Edge the vehicle is on, NONE once finished.
+   */
+  std::uint32_t getCurrentEdge(const RouteProgress &progress) const {
+    return isFinished(progress) ? NONE
+                                : getEdges(progress.route)[progress.index];
+  }
+
+  /**
+   * @brief Edge after the current one, NONE on the last.
+   */
+  std::uint32_t getNextEdge(const RouteProgress &progress) const {
+    return progress.route == NONE ||
+                   progress.index + 1 >= getNumEdges(progress.route)
+               ? NONE
+               : getEdges(progress.route)[progress.index + 1];
+  }
+
+  /**
+   * @brief Lane to use on the current edge.
+   */
+  int getCurrentLane(const RouteProgress &progress) const {
+    return isFinished(progress) ? 0 : getLanes(progress.route)[progress.index];
+  }
+
+  /**
+   * @brief Road the vehicle is on, nullptr once finished.
+   */
+  const model::Road *getCurrentRoad(const RouteProgress &progress) const {
+    return isFinished(progress)
+               ? nullptr
+               : m_graph.getRoad(getCurrentEdge(progress)).get();
+  }
+
+  /**
+   * @brief Move on to the next edge.
+   *
+   * @return false once past the last edge
+   */
+  bool advance(RouteProgress &progress) const {
+    if (isFinished(progress)) {
+      return false;
+    }
+    ++progress.index;
+    return !isFinished(progress);
+  }
+
+  /**
+   * @brief Move on to an edge, searched for from the current one on, e.g.
+   * when the vehicle entered a road.
+   *
+   * @return false, leaving the progress unchanged, if the rest of the route
+   *         does not hold the edge
+   */
+  bool advanceTo(RouteProgress &progress, std::uint32_t edge) const;
+
+  /**
+   * @brief Bytes held by the table.
+   */
+  std::size_t getMemoryUsage() const;
+
+private:
+  struct Entry {
+    std::uint32_t first; ///< Of the edges of the route
+    double total_distance;
+    double estimated_time;
+    double cost;
+  };
+
+  const RoadGraph &m_graph;
+  std::unordered_map<const model::Road *, std::uint32_t> m_road_edges;
+  std::vector<std::uint32_t> m_edges;
+  std::vector<std::uint8_t> m_lanes;
+  std::vector<Entry> m_routes; ///< Then the end of the last route
+  std::unordered_multimap<std::uint64_t, RouteId> m_index;
+  std::size_t m_num_shared = 0;
+  std::vector<std::uint32_t> m_edge_buffer;
+  std::vector<std::uint8_t> m_lane_buffer;
+};
+
+} // namespace routing
+} // namespace kernel
+} // namespace jamfree
+
+#endif // JAMFREE_KERNEL_ROUTING_ROUTE_TABLE_H
@@ -4,10 +4,18 @@
 #include "../model/Lane.h"
 #include "../model/Point2D.h"
 #include "../model/Road.h"
+#include "../../../../microkernel/include/engine/WorkStealingThreadPool.h"
+#include "RoadGraph.h"
+#include "RouteTable.h"
+#include <cstddef>
+#include <cstdint>
 #include <limits>
+#include <map>
 #include <memory>
 #include <queue>
+#include <random>
 #include <string>
+#include <tuple>
 #include <unordered_map>
 #include <vector>
 
@@ -21,9 +29,9 @@ namespace routing {
 struct Route {
   std::vector<std::shared_ptr<model::Road>> roads;
   std::vector<int> lane_indices; // Which lane to use on each road
-  double total_distance;
-  double estimated_time;
-  double cost; // Generalized cost (time + distance + ...)
+  double total_distance = 0.0;
+  double estimated_time = 0.0;
+  double cost = 0.0; // Generalized cost (time + distance + ...)
 
   bool isEmpty() const { return roads.empty(); }
 };
@@ -46,7 +54,15 @@ struct ODPair {
 /**
  * @brief Router for finding optimal paths.
  *
- * Uses A* algorithm with customizable cost functions.
+ * Uses A* algorithm with customizable cost functions. The roads are
+ * preprocessed once into a RoadGraph and its ALT Landmarks for the cost of
+ * the strategy, after which a query settles the nodes toward the
+ * destination only; the roads are then read only to build the route.
+ *
+ * The routes start and end at the road endpoints nearest to the origin and
+ * the destination. The preprocessing is shared by the copies of a router,
+ * but a router is used by one thread at a time; findRoutes() runs the
+ * queries of a batch in parallel, each worker with its own search state.
  */
 class Router {
 public:
@@ -69,7 +85,33 @@ public:
   /**
    * @brief Set routing strategy.
    */
-  void setStrategy(Strategy strategy) { m_strategy = strategy; }
+  void setStrategy(Strategy strategy);
+
+  /**
+   * @brief Preprocess roads for the queries.
+   *
+   * Builds the CSR graph of the roads and the landmarks of the strategy.
+   * The queries given the same roads reuse it, and preprocess them
+   * otherwise.
+   *
+   * @param roads Available roads
+   * @param num_landmarks Number of ALT landmarks
+   */
+  void preprocess(const std::vector<std::shared_ptr<model::Road>> &roads,
+                  std::size_t num_landmarks = 16);
+
+  /**
+   * @brief Get the graph of the preprocessed roads, nullptr if none.
+   */
+  const RoadGraph *getGraph() const { return m_graph.get(); }
+
+  /**
+   * @brief Set the number of threads running the queries of findRoutes().
+   *
+   * Used when no thread pool is lent by the caller of findRoutes().
+   * @param numThreads Number of threads (1 = sequential)
+   */
+  void setNumThreads(std::size_t numThreads);
 
   /**
    * @brief Find route between origin and destination.
@@ -91,7 +133,8 @@ public:
    * @param origin Origin point
    * @param destination Destination point
    * @param roads Available roads
-   * @param traffic_speeds Current speeds on roads (road_id -> speed)
+   * @param traffic_speeds Current speeds on roads (road_id -> speed);
+   *                       speeds above the speed limits are ignored
    * @return Optimal route considering current traffic
    */
   Route findRouteWithTraffic(
@@ -99,6 +142,28 @@ public:
       const std::vector<std::shared_ptr<model::Road>> &roads,
       const std::unordered_map<std::string, double> &traffic_speeds);
 
+  /**
+   * @brief Find the routes of many trips, in parallel.
+   *
+   * The travel times are read by edge of the graph of the roads, an array
+   * refreshed each rerouting period from the simulated speeds, e.g.
+   * through RoadGraph::getEdgeOfRoad(), instead of looking up a road id per
+   * settled edge. A time below the free-flow one is ignored, so that the
+   * landmarks stay valid. Ignored by SHORTEST_DISTANCE.
+   *
+   * @param trips Origins and destinations of the trips
+   * @param roads Available roads
+   * @param travel_times Travel time of each edge of getGraph() (seconds),
+   *                     empty for the free-flow ones
+   * @return Route of each trip, in the order of the trips
+   * @throws std::invalid_argument If travel_times is neither empty nor of
+   *         the number of edges
+   */
+  std::vector<Route>
+  findRoutes(const std::vector<ODPair> &trips,
+             const std::vector<std::shared_ptr<model::Road>> &roads,
+             const std::vector<double> &travel_times = {});
+
   /**
    * @brief Reroute if current route is no longer optimal.
    *
@@ -117,9 +182,37 @@ public:
 
 private:
   Strategy m_strategy;
+  std::size_t m_num_landmarks = 16;
+  std::shared_ptr<const RoadGraph> m_graph;
+  std::size_t m_num_roads = 0;
+  const model::Road *m_first_road = nullptr;
+  std::shared_ptr<const Landmarks> m_landmarks;
+
+  // A* state by node, valid where the generation is the current one
+  struct SearchState {
+    std::vector<double> g_costs;
+    std::vector<double> h_costs;
+    std::vector<std::uint32_t> parent_edges;
+    std::vector<std::uint32_t> generations;
+    std::vector<std::uint8_t> closed;
+    std::uint32_t generation = 0;
+
+    void resize(std::size_t num_nodes);
+  };
+  SearchState m_state;
+  // One by worker of findRoutes()
+  std::vector<SearchState> m_worker_states;
+
+  // Shared by the copies, as the preprocessing
+  std::shared_ptr<fr::univ_artois::lgi2a::similar::microkernel::engine::
+                      WorkStealingThreadPool>
+      m_pool;
 
   /**
    * @brief Calculate cost for a road segment.
+   *
+   * Never lower than at a higher speed, so that the landmarks of the
+   * free-flow costs bound the costs in traffic.
    */
   double calculateCost(const std::shared_ptr<model::Road> &road,
                        double current_speed, double current_time) const;
@@ -130,38 +223,60 @@ private:
   double heuristic(const model::Point2D &from, const model::Point2D &to) const;
 
   /**
-   * @brief Build road graph for routing.
+   * @brief Preprocess the roads if they are not the preprocessed ones, and
+   * the landmarks of the strategy if missing.
    */
-  struct RoadNode {
-    std::shared_ptr<model::Road> road;
-    model::Point2D position;
-    std::vector<std::shared_ptr<RoadNode>> neighbors;
-    double g_cost; // Cost from start
-    double h_cost; // Heuristic cost to goal
-    double f_cost; // Total cost
-    std::shared_ptr<RoadNode> parent;
+  void ensurePreprocessed(
+      const std::vector<std::shared_ptr<model::Road>> &roads);
 
-    RoadNode(std::shared_ptr<model::Road> r, const model::Point2D &pos)
-        : road(r), position(pos),
-          g_cost(std::numeric_limits<double>::infinity()), h_cost(0.0),
-          f_cost(std::numeric_limits<double>::infinity()), parent(nullptr) {}
-  };
+  /**
+   * @brief Find the cheapest route between the nearest nodes, with A*.
+   *
+   * Reads the preprocessing only, so that searches with distinct states run
+   * concurrently.
+   */
+  Route search(SearchState &state, const model::Point2D &origin,
+               const model::Point2D &destination,
+               const std::unordered_map<std::string, double> *traffic_speeds,
+               const std::vector<double> *travel_times,
+               double current_time) const;
 };
 
 /**
  * @brief Origin-Destination Matrix.
  *
- * Stores trip demand between zones.
+ * Stores trip demand between zones. The zones are numbered in the order
+ * they are added, and the demand of each time period is a CSR matrix: the
+ * destinations of the origin i, sorted, are the entries in
+ * [first[i], first[i + 1]). The demand added since the last read is kept
+ * aside and merged by the next read, which also builds the alias table of
+ * the period, so that sampling an OD pair takes constant time.
+ *
+ * The reads update that state: a matrix is used by one thread at a time.
  */
 class ODMatrix {
 public:
+  /**
+   * @brief Add a zone, or set its centroid.
+   *
+   * @param zone Zone ID
+   * @param centroid Centroid of the zone, origin and destination of its trips
+   * @return Index of the zone
+   */
+  std::size_t addZone(const std::string &zone, const model::Point2D &centroid);
+
+  std::size_t getNumZones() const { return m_zone_names.size(); }
+
   /**
    * @brief Add OD pair with demand.
    *
+   * The zones not added yet are added, at the point (0, 0).
+   *
    * @param origin_zone Origin zone ID
    * @param dest_zone Destination zone ID
    * @param demand Number of trips
    * @param time_period Time period (hour of day)
+   * @throws std::invalid_argument If demand is negative or not finite
    */
   void addDemand(const std::string &origin_zone, const std::string &dest_zone,
                  double demand, int time_period = 0);
@@ -172,40 +287,116 @@ public:
   double getDemand(const std::string &origin_zone, const std::string &dest_zone,
                    int time_period = 0) const;
 
+  /**
+   * @brief Get the total demand of a time period.
+   */
+  double getTotalDemand(int time_period = 0) const;
+
+  /**
+   * @brief Seed the generator of sampleODPair().
+   */
+  void setSeed(std::uint64_t seed) { m_rng.seed(seed); }
+
   /**
    * @brief Sample OD pair based on demand distribution.
    *
+   * The departure time is uniform within the hour of the time period.
+   *
    * @param time_period Time period
    * @return Random OD pair weighted by demand
+   * @throws std::runtime_error If the time period has no demand
    */
   ODPair sampleODPair(int time_period = 0) const;
 
   /**
    * @brief Load OD matrix from file.
    *
-   * Supports formats: CSV, JSON, VISUM
+   * Supports CSV lines "origin,destination,demand[,time_period]", after an
+   * optional header line. The zones keep their centroids, if any, and the
+   * new ones are added in the order they appear.
+   *
+   * The file is mapped in memory and parsed by chunks of lines in parallel,
+   * on the threads of setNumThreads() when no thread pool is lent. With a
+   * cache, the parsed lines are also written to getCacheFilename(), which
+   * the next loads of the same content read instead of parsing the file.
+   *
+   * @param use_cache Read or write the cache of the file
+   * @return False if the file cannot be read or a line is malformed, in
+   *         which case no demand is added; a cache that cannot be written
+   *         is only skipped
+   */
+  bool loadFromFile(const std::string &filename, bool use_cache = false);
+
+  /**
+   * @brief Get the cache of an OD file, next to it.
+   *
+   * The cache records the size and the hash of the file it comes from, and
+   * is ignored once the file changes.
+   */
+  static std::string getCacheFilename(const std::string &filename) {
+    return filename + ".odcache";
+  }
+
+  /**
+   * @brief Set the number of threads running generateSynthetic().
+   *
+   * Used when no thread pool is lent by the caller.
+   * @param numThreads Number of threads (1 = sequential)
    */
-  bool loadFromFile(const std::string &filename);
+  void setNumThreads(std::size_t numThreads);
 
   /**
    * @brief Generate synthetic OD matrix.
    *
-   * Uses gravity model: T_ij = k * P_i * A_j / d_ij^2
+   * Uses gravity model: T_ij = k * P_i * A_j / d_ij^2, with k such that the
+   * trips add up to the total population, no trip within a zone, and the
+   * distances below 100 m taken as 100 m. The zones are the ones with a
+   * centroid, added in the order of their IDs; the origins are computed in
+   * parallel. Replaces the demand of the time period.
+   *
+   * @param time_period Time period of the demand
    */
   void generateSynthetic(
       const std::unordered_map<std::string, double> &zone_populations,
       const std::unordered_map<std::string, double> &zone_attractions,
-      const std::unordered_map<std::string, model::Point2D> &zone_centroids);
+      const std::unordered_map<std::string, model::Point2D> &zone_centroids,
+      int time_period = 0);
 
 private:
-  // OD matrix: origin -> destination -> time_period -> demand
-  std::unordered_map<
-      std::string,
-      std::unordered_map<std::string, std::unordered_map<int, double>>>
-      m_matrix;
-
-  // Zone centroids for sampling
-  std::unordered_map<std::string, model::Point2D> m_zone_centroids;
+  // Demand of a time period
+  struct TimeSlice {
+    // CSR matrix, first empty until the first read
+    std::vector<std::uint32_t> first;
+    std::vector<std::uint32_t> destinations;
+    std::vector<double> demands;
+    double total = 0.0;
+
+    // Added since the last read, as (origin, destination, demand)
+    std::vector<std::tuple<std::uint32_t, std::uint32_t, double>> pending;
+
+    // Alias table of the entries, empty until the first sample
+    std::vector<double> probabilities;
+    std::vector<std::uint32_t> aliases;
+  };
+
+  std::unordered_map<std::string, std::uint32_t> m_zone_indices;
+  std::vector<std::string> m_zone_names;
+  std::vector<model::Point2D> m_zone_centroids;
+
+  mutable std::map<int, TimeSlice> m_slices;
+  mutable std::mt19937_64 m_rng;
+
+  std::shared_ptr<fr::univ_artois::lgi2a::similar::microkernel::engine::
+                      WorkStealingThreadPool>
+      m_pool;
+
+  std::uint32_t zoneIndex(const std::string &zone);
+
+  /**
+   * @brief Get a time period with its pending demand merged, nullptr if it
+   * has no demand.
+   */
+  const TimeSlice *getSlice(int time_period) const;
 };
 
 /**
@@ -239,6 +430,25 @@ public:
   generateTrips(int time_period, int num_trips,
                 const std::vector<std::shared_ptr<model::Road>> &roads);
 
+  /**
+   * @brief Generate multiple trips for time period, their routes interned
+   * into a table.
+   *
+   * The routes are found by batches, in parallel as by
+   * Router::findRoutes(), and interned as each batch is done, so that only
+   * the distinct ones are kept.
+   *
+   * @param table Table of the graph of the router for the roads
+   * @return Vector of OD pairs and the progress of the vehicles at the
+   *         start of their routes, NONE for a trip without route
+   * @throws std::invalid_argument If the table is not of the graph of the
+   *         router
+   */
+  std::vector<std::pair<ODPair, RouteProgress>>
+  generateTrips(int time_period, int num_trips,
+                const std::vector<std::shared_ptr<model::Road>> &roads,
+                RouteTable &table);
+
 private:
   const ODMatrix &m_od_matrix;
   Router &m_router;
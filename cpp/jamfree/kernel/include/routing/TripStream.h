@@ -0,0 +1,161 @@
+#ifndef JAMFREE_KERNEL_ROUTING_TRIP_STREAM_H
+#define JAMFREE_KERNEL_ROUTING_TRIP_STREAM_H
+
+#include "../model/Lane.h"
+#include "../model/Road.h"
+#include "../model/Vehicle.h"
+#include "RouteTable.h"
+#include "Router.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace jamfree {
+namespace kernel {
+namespace routing {
+
+/**
+ * @brief Trips of an OD matrix, generated as the simulation reaches them
+ * and injected at the entry of their first lane.
+ *
+ * The departures are sampled by time slice, as many in a slice as the
+ * demand of its period in proportion of its length, and routed by batches
+ * in parallel, as Router::findRoutes(), into a RouteTable. Only the slices
+ * up to Config::lookahead ahead of the time asked for are generated, so
+ * that the simulation starts once the first of them are routed and the
+ * pending trips stay bounded by the demand of the lookahead. The trips of
+ * the slices are queued by departure time.
+ *
+ * inject() moves the departed trips to the entry of their first lane,
+ * where each waits, after the trips before it on that lane, until the
+ * rearmost vehicle of the lane is far enough from the start.
+ *
+ * A stream uses its router and its table alone while it generates trips.
+ */
+class TripStream {
+public:
+  struct Config {
+    double start_time = 0.0;     ///< Of the first slice (s)
+    double slice_length = 60.0;  ///< Of a slice (s), cut at the periods
+    double lookahead = 300.0;    ///< Generated ahead of the time (s)
+    std::size_t batch_size = 1024; ///< Trips routed at once
+    std::uint64_t seed = 1;      ///< Of the numbers of trips of the slices
+
+    Config() = default;
+  };
+
+  /**
+   * @brief A trip, queued until it departs.
+   */
+  struct Trip {
+    std::uint64_t id;      ///< In the order of generation
+    double departure_time; ///< s
+    RouteProgress route;   ///< At the start of its route
+  };
+
+  /**
+   * @brief Make the vehicle of a departing trip, before its placement at
+   * the start of the lane; nullptr to drop the trip.
+   */
+  using VehicleFactory = std::function<std::shared_ptr<model::Vehicle>(
+      const Trip &, const std::shared_ptr<model::Lane> &)>;
+
+  /**
+   * @param od_matrix Demand, which must outlive the stream
+   * @param router Router of the roads, which must outlive the stream
+   * @param roads Available roads, which must outlive the stream
+   * @param table Table of the graph of the router for the roads, which must
+   *        outlive the stream
+   */
+  TripStream(const ODMatrix &od_matrix, Router &router,
+             const std::vector<std::shared_ptr<model::Road>> &roads,
+             RouteTable &table);
+
+  /**
+   * @throws std::invalid_argument If a length or the batch size is not
+   *         positive, or the lookahead negative
+   */
+  TripStream(const ODMatrix &od_matrix, Router &router,
+             const std::vector<std::shared_ptr<model::Road>> &roads,
+             RouteTable &table, const Config &config);
+
+  const Config &getConfig() const { return m_config; }
+
+  /**
+   * @brief Generate the slices up to the lookahead after a time.
+   *
+   * @throws std::invalid_argument If the table is not of the graph of the
+   *         router
+   */
+  void prepare(double time);
+
+  /**
+   * @brief Take the trips departing up to a time, after prepare(time).
+   *
+   * @param trips Appended the trips, by departure time
+   * @return Number of trips taken
+   */
+  std::size_t popDue(double time, std::vector<Trip> &trips);
+
+  /**
+   * @brief Inject the trips departed up to a time whose entry lane is free.
+   *
+   * A trip enters at the start of the lane of its first edge, when the
+   * rearmost vehicle of the lane is at least min_gap from it; the others
+   * wait for a next call, in their order.
+   *
+   * @param min_gap Lane position of the rear of the rearmost vehicle for a
+   *        trip to enter, e.g. a vehicle length and a standstill gap (m)
+   * @param make Maker of the vehicles
+   * @return Number of vehicles injected
+   */
+  std::size_t inject(double time, double min_gap, const VehicleFactory &make);
+
+  /** @brief End of the slices generated (s). */
+  double getGeneratedTime() const { return m_generated_time; }
+
+  /** @brief Number of trips generated, not departed yet. */
+  std::size_t getNumPending() const { return m_pending.size(); }
+
+  /** @brief Number of trips departed, waiting for their lane. */
+  std::size_t getNumWaiting() const { return m_waiting.size(); }
+
+  /** @brief Number of trips generated, routed or not. */
+  std::uint64_t getNumGenerated() const { return m_next_id; }
+
+  /** @brief Number of trips dropped without a route. */
+  std::uint64_t getNumUnrouted() const { return m_num_unrouted; }
+
+  /** @brief Number of vehicles injected. */
+  std::uint64_t getNumInjected() const { return m_num_injected; }
+
+private:
+  const ODMatrix &m_od_matrix;
+  Router &m_router;
+  const std::vector<std::shared_ptr<model::Road>> &m_roads;
+  RouteTable &m_table;
+  Config m_config;
+  std::mt19937_64 m_rng;
+  double m_generated_time;
+  double m_carry = 0.0; ///< Fraction of a trip left by the last slice
+  std::uint64_t m_next_id = 0;
+  std::uint64_t m_num_unrouted = 0;
+  std::uint64_t m_num_injected = 0;
+  std::deque<Trip> m_pending;
+  std::deque<Trip> m_waiting;
+  std::vector<ODPair> m_batch;
+  std::vector<Trip> m_slice;
+  std::vector<Trip> m_due;
+
+  void generateSlice(int time_period, double begin, double end);
+};
+
+} // namespace routing
+} // namespace kernel
+} // namespace jamfree
+
+#endif // JAMFREE_KERNEL_ROUTING_TRIP_STREAM_H
@@ -0,0 +1,241 @@
+#ifndef JAMFREE_KERNEL_SIMULATION_DISTRIBUTED_SIMULATION_H
+#define JAMFREE_KERNEL_SIMULATION_DISTRIBUTED_SIMULATION_H
+
+#include "../../../microscopic/include/IDM.h"
+#include "../model/Vehicle.h"
+#include "../routing/NetworkPartition.h"
+#include "RankExchange.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace jamfree {
+namespace kernel {
+namespace simulation {
+
+/**
+ * @brief Microscopic simulation of the part of a road network owned by one
+ * rank of a distributed simulation.
+ *
+ * Each rank simulates the vehicles on the edges of its part of a
+ * routing::NetworkPartition, with the IDM. At each step, the ranks sharing
+ * cut edges first exchange the rear vehicles of the lanes following them,
+ * the leaders of the vehicles at the end of the cut edges, then move their
+ * vehicles, and finally hand off the vehicles that crossed into the part
+ * of a peer. All the accelerations are computed before any vehicle moves,
+ * so the result does not depend on the partition: one rank or many
+ * simulate the same traffic.
+ *
+ * The vehicles follow routes of graph edges, entering the next edge of
+ * their route on the same lane, or on its last lane if it has fewer. A
+ * vehicle travels at most one edge per step, the edges being longer than
+ * a step at the highest speed.
+ *
+ * With rebalancing on, the ranks measure the time they spend moving their
+ * vehicles and the vehicles on each edge. When the busiest rank is slower
+ * than the mean by more than a threshold, the network is partitioned again
+ * with the vehicles seen on the edges as demand, and the vehicles and the
+ * trips of the edges changing part move to their new rank.
+ */
+class DistributedSimulation {
+public:
+  /**
+   * @brief Trip of a vehicle, along edges of the road graph.
+   */
+  struct Trip {
+    std::string id;
+    std::vector<std::uint32_t> edges; ///< Route, each edge following the last
+    double departure = 0.0;           ///< Time of departure (seconds)
+    double length = 5.0;              ///< Vehicle length (meters)
+    double max_speed = 55.0;          ///< Maximum speed (m/s)
+    double max_accel = 3.0;           ///< Maximum acceleration (m/s²)
+    double max_decel = 6.0;           ///< Maximum deceleration (m/s²)
+  };
+
+  /**
+   * @brief Counts of the vehicles over all the ranks.
+   */
+  struct Statistics {
+    double vehicles = 0.0;   ///< On the network
+    double departed = 0.0;   ///< Since the start
+    double arrived = 0.0;    ///< Since the start
+    double handed_off = 0.0; ///< Since the start, from a rank to another
+    double mean_speed = 0.0; ///< Of the vehicles on the network (m/s)
+  };
+
+  /**
+   * @brief Set up the simulation of the part of a rank.
+   *
+   * @param partition Partition of the road graph, the same on every rank,
+   *                  which must outlive the simulation, as its graph; a
+   *                  rebalancing replaces it with a partition of its own
+   * @param exchange Exchange of the rank, of as many ranks as parts
+   * @param idm Car-following model of the vehicles
+   * @param dt Time step (seconds)
+   * @throws std::invalid_argument If the exchange is null or its size is
+   *         not the number of parts
+   */
+  DistributedSimulation(const routing::NetworkPartition &partition,
+                        std::shared_ptr<IRankExchange> exchange,
+                        const microscopic::models::IDM &idm, double dt = 0.1);
+
+  /**
+   * @brief Add a trip.
+   *
+   * Every rank adds all the trips, in the same order: the one owning the
+   * first edge of a trip keeps it, the others ignore it. The vehicle enters
+   * lane 0 of its first edge at its departure, as soon as there is room.
+   *
+   * @throws std::invalid_argument If the route is empty, or an edge does
+   *         not exist or does not follow the last one
+   */
+  void addTrip(const Trip &trip);
+
+  /**
+   * @brief Advance the simulation by one time step.
+   *
+   * A collective call of the ranks.
+   */
+  void step();
+
+  /**
+   * @brief Get the counts of the vehicles over all the ranks.
+   *
+   * A collective call of the ranks.
+   */
+  Statistics getGlobalStatistics();
+
+  /**
+   * @brief Rebalance the parts during the steps.
+   *
+   * Every `period` steps, the ranks compare their times moving vehicles
+   * and partition the network again if the largest is above `threshold`
+   * times the mean. The same on every rank.
+   *
+   * @param period Steps between the comparisons, 0 for no rebalancing
+   * @param threshold Largest time over the mean time, at least 1
+   * @throws std::invalid_argument If the threshold is below 1
+   */
+  void setRebalancing(std::size_t period, double threshold = 1.1);
+
+  /**
+   * @brief Get the number of times the network was partitioned again.
+   */
+  std::size_t getRebalanceCount() const { return m_rebalance_count; }
+
+  /**
+   * @brief Get the current partition of the network.
+   */
+  const routing::NetworkPartition &getPartition() const {
+    return *m_partition;
+  }
+
+  double getTime() const { return m_time; }
+  double getDt() const { return m_dt; }
+
+  int getRank() const { return m_rank; }
+
+  /**
+   * @brief Get the ranks sharing cut edges with this one.
+   */
+  const std::vector<int> &getPeers() const { return m_peers; }
+
+  bool ownsEdge(std::uint32_t edge) const {
+    return static_cast<int>(m_partition->getPartOfEdge(edge)) == m_rank;
+  }
+
+  /**
+   * @brief Get the vehicles of the part, by edge, lane and position.
+   */
+  std::vector<std::shared_ptr<model::Vehicle>> getVehicles() const;
+
+  std::size_t getNumVehicles() const { return m_travellers.size(); }
+  std::size_t getNumPendingTrips() const { return m_pending.size(); }
+
+private:
+  // A vehicle on the network and the rest of its route
+  struct Traveller {
+    std::shared_ptr<model::Vehicle> vehicle;
+    std::vector<std::uint32_t> edges;
+    std::size_t leg = 0; ///< Index of the current edge in the route
+  };
+
+  // A vehicle entering the lane of an edge within a step
+  struct Entry {
+    std::uint32_t edge;
+    int lane;
+    Traveller traveller;
+  };
+
+  // Rear vehicle of a lane, the leader of the vehicles entering it
+  struct Rear {
+    double position;
+    double speed;
+  };
+
+  // Ranks sharing cut edges, with the lanes whose rears they exchange
+  struct Peer {
+    int rank;
+    std::vector<std::uint32_t> sent_lanes;     // Lanes of this part
+    std::vector<std::uint32_t> received_lanes; // Lanes of the peer
+  };
+
+  const routing::NetworkPartition *m_partition;
+  std::unique_ptr<routing::NetworkPartition> m_rebalanced; // If any
+  const routing::RoadGraph &m_graph;
+  std::shared_ptr<IRankExchange> m_exchange;
+  microscopic::models::IDM m_idm;
+  double m_dt;
+  double m_time = 0.0;
+  int m_rank;
+
+  std::vector<std::uint32_t> m_owned_edges;
+  std::vector<std::uint32_t> m_first_lane; // Of each edge, and the total
+  std::vector<int> m_peers;
+  std::vector<Peer> m_peer_lanes;
+  std::vector<int> m_peer_of_rank; // Index in the peers, -1 if none
+
+  std::unordered_map<const model::Vehicle *, Traveller> m_travellers;
+  std::vector<Trip> m_pending; // Kept trips, in order of departure
+
+  std::size_t m_departed = 0;
+  std::size_t m_arrived = 0;
+  std::size_t m_handed_off = 0;
+
+  std::size_t m_rebalance_period = 0;
+  double m_rebalance_threshold = 1.1;
+  std::size_t m_steps_since_rebalance = 0;
+  std::size_t m_rebalance_count = 0;
+  double m_busy_time = 0.0;             // Moving vehicles (seconds)
+  std::vector<double> m_edge_vehicles; // Sums over the steps, of each edge
+
+  // Buffers reused by the steps
+  std::vector<Rear> m_rears; // Of each lane, infinite position if empty
+  std::vector<double> m_speeds;
+  std::vector<double> m_gaps;
+  std::vector<double> m_relative_speeds;
+  std::vector<double> m_accelerations;
+  std::vector<std::vector<Entry>> m_handoffs; // To each peer
+  std::vector<Entry> m_entries;
+  std::vector<std::shared_ptr<model::Vehicle>> m_leaving;
+  std::vector<std::vector<std::uint8_t>> m_outgoing;
+  std::vector<std::vector<std::uint8_t>> m_incoming;
+
+  void buildPeers();
+  void exchangeRears();
+  void moveVehicles();
+  void exchangeHandoffs();
+  void enterVehicles();
+  void departVehicles();
+  void rebalanceIfNeeded();
+  void repartition(std::unique_ptr<routing::NetworkPartition> partition);
+};
+
+} // namespace simulation
+} // namespace kernel
+} // namespace jamfree
+
+#endif // JAMFREE_KERNEL_SIMULATION_DISTRIBUTED_SIMULATION_H
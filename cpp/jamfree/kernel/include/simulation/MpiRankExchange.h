@@ -0,0 +1,50 @@
+#ifndef JAMFREE_KERNEL_SIMULATION_MPI_RANK_EXCHANGE_H
+#define JAMFREE_KERNEL_SIMULATION_MPI_RANK_EXCHANGE_H
+
+// Built with the JAMFREE_MPI option of CMake only
+#ifdef JAMFREE_HAS_MPI
+
+#include "RankExchange.h"
+#include <mpi.h>
+
+namespace jamfree {
+namespace kernel {
+namespace simulation {
+
+/**
+ * @brief The ranks of a distributed simulation run by the processes of an
+ * MPI communicator.
+ *
+ * MPI is initialized and finalized by the program, around the lifetime of
+ * the exchanges.
+ */
+class MpiRankExchange : public IRankExchange {
+public:
+  explicit MpiRankExchange(MPI_Comm communicator = MPI_COMM_WORLD);
+
+  int getRank() const override { return m_rank; }
+  int getSize() const override { return m_size; }
+
+  /**
+   * @brief Exchange the sizes of the messages, then the messages, with
+   * non-blocking point-to-point calls.
+   */
+  void exchange(const std::vector<int> &peers,
+                const std::vector<std::vector<std::uint8_t>> &outgoing,
+                std::vector<std::vector<std::uint8_t>> &incoming) override;
+
+  void allReduceSum(double *values, std::size_t count) override;
+
+private:
+  MPI_Comm m_communicator;
+  int m_rank = 0;
+  int m_size = 1;
+};
+
+} // namespace simulation
+} // namespace kernel
+} // namespace jamfree
+
+#endif // JAMFREE_HAS_MPI
+
+#endif // JAMFREE_KERNEL_SIMULATION_MPI_RANK_EXCHANGE_H
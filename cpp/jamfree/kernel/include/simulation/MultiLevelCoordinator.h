@@ -3,8 +3,13 @@
 
 #include "../agents/Interfaces.h"
 #include "../agents/VehicleAgent.h"
+#include "../../../../microkernel/include/engine/WorkStealingThreadPool.h"
 #include "SimulationEngine.h"
+#include <cstddef>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -23,6 +28,12 @@ namespace simulation {
  * - State synchronization between levels
  * - Level transitions (micro ↔ macro)
  * - Hierarchical control
+ *
+ * With setNumThreads(), the levels due in a step that are marked
+ * independent update at the same time, then the others one after another,
+ * in the order they were added. The transitions requested meanwhile, e.g.
+ * by the level updates at the entries and exits of the network, are
+ * applied together at the synchronization point that ends the step.
  */
 class MultiLevelCoordinator {
 public:
@@ -34,10 +45,35 @@ public:
     double time_step;     // Time step for this level (seconds)
     int update_frequency; // How often to update (1 = every step)
     bool active;          // Is this level active?
+    // Whether it may update at the same time as the other independent
+    // levels, sharing no state with them
+    bool independent;
 
     LevelConfig(const agents::LevelIdentifier &lvl, double dt = 0.1,
-                int freq = 1)
-        : level(lvl), time_step(dt), update_frequency(freq), active(true) {}
+                int freq = 1, bool indep = false)
+        : level(lvl), time_step(dt), update_frequency(freq), active(true),
+          independent(indep) {}
+  };
+
+  /**
+   * @brief Update of a level for one of its steps.
+   *
+   * Called with the level, the current time and the time step of the level.
+   */
+  using LevelUpdate = std::function<void(const agents::LevelIdentifier &,
+                                         double, double)>;
+
+  /**
+   * @brief A move of an agent from one level to another.
+   */
+  struct Transition {
+    std::string agent_id;
+    agents::LevelIdentifier from_level;
+    agents::LevelIdentifier to_level;
+
+    Transition(const std::string &id, const agents::LevelIdentifier &from,
+               const agents::LevelIdentifier &to)
+        : agent_id(id), from_level(from), to_level(to) {}
   };
 
   /**
@@ -51,6 +87,20 @@ public:
    */
   void addLevel(const LevelConfig &config);
 
+  /**
+   * @brief Set the update of a level, run when the level is due.
+   * @param level Level identifier, added before
+   * @param update Update of the level
+   */
+  void setLevelUpdate(const agents::LevelIdentifier &level, LevelUpdate update);
+
+  /**
+   * @brief Set the number of threads updating the independent levels and
+   * cloning the states of the transitions.
+   * @param numThreads Number of threads (1 = sequential)
+   */
+  void setNumThreads(std::size_t numThreads);
+
   /**
    * @brief Set simulation engine.
    * @param engine Simulation engine
@@ -89,6 +139,35 @@ public:
                        const agents::LevelIdentifier &fromLevel,
                        const agents::LevelIdentifier &toLevel);
 
+  /**
+   * @brief Transition agents from level to level at once.
+   *
+   * The states of the source levels are cloned in parallel, then set in
+   * the target levels of the agents one transition after another. The
+   * clones are all taken before any is set: a batch is to move an agent
+   * once. The transitions whose agent or source states are missing are
+   * skipped and reported once for the batch.
+   *
+   * @param transitions Transitions to apply
+   * @return Number of transitions applied
+   */
+  std::size_t transitionAgents(const std::vector<Transition> &transitions);
+
+  /**
+   * @brief Request a transition, applied with the others at the end of
+   * the current step, or by the next step.
+   *
+   * May be called by level updates running at the same time.
+   */
+  void requestTransition(const std::string &agentId,
+                         const agents::LevelIdentifier &fromLevel,
+                         const agents::LevelIdentifier &toLevel);
+
+  /**
+   * @brief Get the number of transitions requested and not applied yet.
+   */
+  std::size_t getPendingTransitionCount() const;
+
   /**
    * @brief Synchronize state between levels.
    *
@@ -124,10 +203,24 @@ private:
                      agents::LevelIdentifierHash>
       m_levels;
 
+  // The levels in the order they were added, and their updates
+  std::vector<agents::LevelIdentifier> m_level_order;
+  std::unordered_map<agents::LevelIdentifier, LevelUpdate,
+                     agents::LevelIdentifierHash>
+      m_level_updates;
+
   // Track which agents are in which levels
   std::unordered_map<std::string, std::vector<agents::LevelIdentifier>>
       m_agent_levels;
 
+  std::unique_ptr<fr::univ_artois::lgi2a::similar::microkernel::engine::
+                      WorkStealingThreadPool>
+      m_pool;
+
+  // Transitions requested during the step
+  mutable std::mutex m_transitions_mutex;
+  std::vector<Transition> m_pending_transitions;
+
   /**
    * @brief Check if a level should update this step.
    * @param level Level identifier
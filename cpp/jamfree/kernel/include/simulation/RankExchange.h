@@ -0,0 +1,103 @@
+#ifndef JAMFREE_KERNEL_SIMULATION_RANK_EXCHANGE_H
+#define JAMFREE_KERNEL_SIMULATION_RANK_EXCHANGE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace jamfree {
+namespace kernel {
+namespace simulation {
+
+/**
+ * @brief Messages between the ranks of a distributed simulation.
+ *
+ * Both operations are collective: each rank of the peers, or of the
+ * group, calls them in the same order.
+ */
+class IRankExchange {
+public:
+  virtual ~IRankExchange() = default;
+
+  virtual int getRank() const = 0;
+  virtual int getSize() const = 0;
+
+  /**
+   * @brief Send a message to each peer and receive one from each.
+   *
+   * The peers of a rank list it among their peers.
+   *
+   * @param peers Ranks of the peers
+   * @param outgoing Message to each peer, in the order of the peers
+   * @param incoming Set to the message of each peer, in the same order
+   */
+  virtual void exchange(const std::vector<int> &peers,
+                        const std::vector<std::vector<std::uint8_t>> &outgoing,
+                        std::vector<std::vector<std::uint8_t>> &incoming) = 0;
+
+  /**
+   * @brief Sum values over all the ranks.
+   *
+   * The values are added in the order of the ranks, so that every rank
+   * gets the same sums, whatever the order of the messages.
+   */
+  virtual void allReduceSum(double *values, std::size_t count) = 0;
+};
+
+/**
+ * @brief The ranks of a distributed simulation run by threads of one
+ * process, e.g. to test a partition without MPI.
+ */
+class LocalRankExchange : public IRankExchange {
+public:
+  /**
+   * @brief Create the exchanges of a group of ranks, the one of rank r at
+   * index r.
+   *
+   * @throws std::invalid_argument If size is not positive
+   */
+  static std::vector<std::shared_ptr<LocalRankExchange>> createGroup(int size);
+
+  int getRank() const override { return m_rank; }
+  int getSize() const override { return m_group->size; }
+
+  void exchange(const std::vector<int> &peers,
+                const std::vector<std::vector<std::uint8_t>> &outgoing,
+                std::vector<std::vector<std::uint8_t>> &incoming) override;
+
+  void allReduceSum(double *values, std::size_t count) override;
+
+private:
+  // State shared by the ranks of a group
+  struct Group {
+    int size;
+    std::mutex mutex;
+    std::condition_variable released;
+    int waiting = 0;
+    unsigned long generation = 0;
+    std::vector<std::vector<std::uint8_t>> mailboxes; // [from * size + to]
+    std::vector<std::vector<double>> contributions;   // Of allReduceSum
+
+    explicit Group(int size)
+        : size(size), mailboxes(static_cast<std::size_t>(size) * size),
+          contributions(static_cast<std::size_t>(size)) {}
+
+    // Wait until all the ranks reach the barrier
+    void await();
+  };
+
+  std::shared_ptr<Group> m_group;
+  int m_rank;
+
+  LocalRankExchange(std::shared_ptr<Group> group, int rank)
+      : m_group(std::move(group)), m_rank(rank) {}
+};
+
+} // namespace simulation
+} // namespace kernel
+} // namespace jamfree
+
+#endif // JAMFREE_KERNEL_SIMULATION_RANK_EXCHANGE_H
@@ -3,7 +3,13 @@
 
 #include "../agents/Interfaces.h"
 #include "../agents/VehicleAgent.h"
+#include "../../../../microkernel/include/IStepTimingListener.h"
+#include "../../../../microkernel/include/engine/WorkStealingThreadPool.h"
+#include "../../../../microkernel/include/libs/MemoryAccounting.h"
+#include <cstddef>
+#include <functional>
 #include <memory>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -22,6 +28,13 @@ namespace simulation {
  *
  * Supports multi-level simulation with different levels running
  * at different time scales.
+ *
+ * With setNumThreads(), the agents perceive and decide in parallel, in
+ * chunks of consecutive agents, and the reaction models can split their
+ * own loops over the same pool. The influences are merged in the order of
+ * the agents, so a step gives the same result with any number of threads;
+ * agents perceiving or deciding at the same time must then not share their
+ * perception or decision models, which keep per-call state.
  */
 class SimulationEngine {
 public:
@@ -37,11 +50,40 @@ public:
    */
   void addAgent(std::shared_ptr<agents::VehicleAgent> agent);
 
+  /**
+   * @brief Add agents at once, as addAgent() in their order.
+   * @param agents Agents to add
+   */
+  void
+  addAgents(const std::vector<std::shared_ptr<agents::VehicleAgent>> &agents);
+
+  /**
+   * @brief Creates an agent from its index, e.g. as its seed.
+   */
+  using AgentFactory =
+      std::function<std::shared_ptr<agents::VehicleAgent>(std::size_t index)>;
+
+  /**
+   * @brief Create agents in parallel, then add them in index order.
+   *
+   * The factory is called concurrently for chunks of indices, on the pool
+   * of setNumThreads() or the one lent by the caller. The agents must not
+   * share their perception or decision models (see the class).
+   * @param count Number of agents to create
+   * @param factory Factory of the agents; the null agents are skipped
+   */
+  void addAgents(std::size_t count, const AgentFactory &factory);
+
   /**
    * @brief Remove an agent from the simulation.
+   *
+   * The last agent takes its place, so that a removal costs O(1); the
+   * order of the agents, in which the influences merge, changes.
    * @param agentId ID of agent to remove
+   * @return The agent removed, for example for a pool to reuse it, or
+   * nullptr if not found
    */
-  void removeAgent(const std::string &agentId);
+  std::shared_ptr<agents::VehicleAgent> removeAgent(const std::string &agentId);
 
   /**
    * @brief Get an agent by ID.
@@ -50,6 +92,13 @@ public:
    */
   std::shared_ptr<agents::VehicleAgent> getAgent(const std::string &agentId);
 
+  /**
+   * @brief Get an agent by interned ID.
+   * @param agentId Agent ID
+   * @return Agent or nullptr if not found
+   */
+  std::shared_ptr<agents::VehicleAgent> getAgent(agents::Symbol agentId);
+
   /**
    * @brief Get all agents.
    * @return Vector of all agents
@@ -58,6 +107,14 @@ public:
     return m_agents;
   }
 
+  /**
+   * @brief Set the number of threads running the agents.
+   *
+   * Used when no thread pool is lent by the caller of step().
+   * @param numThreads Number of threads (1 = sequential)
+   */
+  void setNumThreads(std::size_t numThreads);
+
   /**
    * @brief Set reaction model for a level.
    * @param level Level identifier
@@ -78,10 +135,37 @@ public:
    * @brief Run one simulation step.
    *
    * Executes the complete perception-decision-reaction cycle
-   * for all agents at all levels.
+   * for all agents at all levels. The step holds getAccessMutex() alone, so
+   * the models it runs must not query the engine through the bindings.
    */
   void step();
 
+  /**
+   * @brief Set the listener receiving the timings of the steps, e.g. a
+   * SimulationMetrics exported by the web server, or nullptr.
+   *
+   * The perception, decision and reaction phases are timed only while a
+   * listener is set; the decisions include the merge of the influences,
+   * and the busy time of the threads is not measured.
+   * @param listener Listener called at the end of each step
+   */
+  void setStepTimingListener(
+      std::shared_ptr<fr::univ_artois::lgi2a::similar::microkernel::
+                          IStepTimingListener>
+          listener) {
+    m_step_timing_listener = std::move(listener);
+  }
+
+  /**
+   * @brief Get the listener of the timings of the steps.
+   * @return The listener, or nullptr
+   */
+  const std::shared_ptr<
+      fr::univ_artois::lgi2a::similar::microkernel::IStepTimingListener> &
+  getStepTimingListener() const {
+    return m_step_timing_listener;
+  }
+
   /**
    * @brief Run multiple simulation steps.
    * @param numSteps Number of steps to run
@@ -112,20 +196,55 @@ public:
    */
   int getStepCount() const { return m_step_count; }
 
+  /**
+   * @brief Get the live and peak bytes of the accounted subsystems, e.g.
+   * the vehicle columns of the lanes and the geometry of the roads.
+   *
+   * The accounts cover the whole process, not only this engine.
+   * @return The usage of each subsystem
+   */
+  std::vector<fr::univ_artois::lgi2a::similar::microkernel::libs::MemoryUsage>
+  getMemoryUsage() const {
+    return fr::univ_artois::lgi2a::similar::microkernel::libs::
+        MemoryAccounting::snapshot();
+  }
+
   /**
    * @brief Reset simulation.
    */
   void reset();
 
+  /**
+   * @brief Get the lock of the Python bindings, whose calls the
+   * free-threaded build runs in parallel: the queries share it and the
+   * updates hold it alone. step() holds it alone itself, so that a query
+   * never sees a step half done; the other methods of the engine do not
+   * take it.
+   */
+  std::shared_mutex &getAccessMutex() const { return m_access_mutex; }
+
 private:
+  mutable std::shared_mutex m_access_mutex;
   double m_dt;           // Time step
   double m_current_time; // Current simulation time
   int m_step_count;      // Number of steps executed
 
   // Agents
   std::vector<std::shared_ptr<agents::VehicleAgent>> m_agents;
-  std::unordered_map<std::string, std::shared_ptr<agents::VehicleAgent>>
-      m_agents_by_id;
+  std::unordered_map<agents::Symbol, std::size_t> m_agent_indices; // In m_agents
+
+  // Perceived data of each agent, from the perception to the decision phase
+  std::vector<std::shared_ptr<agents::IPerceivedData>> m_perceived_data;
+  // Influences of each agent, until they are merged in agent order
+  std::vector<std::shared_ptr<agents::InfluencesMap>> m_agent_influences;
+
+  std::unique_ptr<fr::univ_artois::lgi2a::similar::microkernel::engine::
+                      WorkStealingThreadPool>
+      m_pool;
+
+  std::shared_ptr<
+      fr::univ_artois::lgi2a::similar::microkernel::IStepTimingListener>
+      m_step_timing_listener;
 
   // Reaction models per level
   std::unordered_map<agents::LevelIdentifier,
@@ -156,12 +275,26 @@ private:
    */
   void perceptionPhase();
 
+  /**
+   * @brief Execute the perception of an agent.
+   * @param index Index of the agent in m_agents
+   */
+  void perceiveAgent(std::size_t index, const agents::SimulationTimeStamp &t0,
+                     const agents::SimulationTimeStamp &t1);
+
   /**
    * @brief Execute decision phase for all agents.
    * @return All influences produced
    */
   agents::InfluencesMap decisionPhase();
 
+  /**
+   * @brief Execute the decision of an agent.
+   * @param index Index of the agent in m_agents
+   */
+  void decideAgent(std::size_t index, const agents::SimulationTimeStamp &t0,
+                   const agents::SimulationTimeStamp &t1);
+
   /**
    * @brief Execute reaction phase.
    * @param influences Influences to apply
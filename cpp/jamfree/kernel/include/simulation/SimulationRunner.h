@@ -0,0 +1,123 @@
+#ifndef JAMFREE_KERNEL_SIMULATION_SIMULATION_RUNNER_H
+#define JAMFREE_KERNEL_SIMULATION_SIMULATION_RUNNER_H
+
+#include "../tools/TripleBuffer.h"
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace jamfree {
+namespace kernel {
+namespace simulation {
+
+/**
+ * @brief Runs the steps of a simulation for a while, or on a thread of its
+ * own, publishing snapshots of it.
+ *
+ * A step and a capture of the state, for example the rows of
+ * model::exportVehicleStates(), are given as functions; runFor() runs steps
+ * in the calling thread, and start() runs them on a background thread
+ * until stop(). After the steps, the capture writes into a buffer that
+ * the reader takes by updateSnapshot(), lock-free: a viewer reads the
+ * newest frame without ever blocking the simulation, the frames it misses
+ * being dropped.
+ *
+ * While the background thread runs, only the runner may touch the
+ * simulation.
+ */
+class SimulationRunner {
+public:
+  using StepFunction = std::function<void()>;
+  using CaptureFunction = std::function<void(std::vector<double> &)>;
+
+  /**
+   * @param step Runs one step of the simulation
+   * @param capture Writes the state of the simulation, or nullptr for no
+   *                snapshot
+   */
+  explicit SimulationRunner(StepFunction step,
+                            CaptureFunction capture = nullptr);
+
+  /**
+   * @brief Destructor, stopping the background thread.
+   */
+  ~SimulationRunner();
+
+  SimulationRunner(const SimulationRunner &) = delete;
+  SimulationRunner &operator=(const SimulationRunner &) = delete;
+
+  /**
+   * @brief Run steps in the calling thread, then capture a snapshot.
+   *
+   * @param max_steps Number of steps, 0 for no limit
+   * @param wallclock_ms Time after which no step starts (ms), 0 for no limit
+   * @return Number of steps run
+   * @throws std::invalid_argument If neither limit is given
+   * @throws std::logic_error If the background thread runs
+   */
+  std::size_t runFor(std::size_t max_steps, double wallclock_ms = 0.0);
+
+  /**
+   * @brief Run steps on a background thread until stop().
+   *
+   * @param step_period_ms Wall-clock time between the starts of two steps
+   *                       (ms), 0 to run as fast as possible
+   * @param capture_every Number of steps between two snapshots
+   * @throws std::logic_error If the background thread runs already
+   */
+  void start(double step_period_ms = 0.0, std::size_t capture_every = 1);
+
+  /**
+   * @brief Stop the background thread, after its current step.
+   *
+   * @throws The exception a step threw, which stopped the thread
+   */
+  void stop();
+
+  bool isRunning() const { return m_running.load(std::memory_order_acquire); }
+
+  /**
+   * @brief Get the number of steps run, by any of the threads.
+   */
+  std::size_t getNumSteps() const {
+    return m_num_steps.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Take the newest snapshot, if any since the last call.
+   *
+   * To be called by one reader thread only.
+   * @return True if getSnapshot() changed
+   */
+  bool updateSnapshot() { return m_snapshots.update(); }
+
+  /**
+   * @brief Get the snapshot the last updateSnapshot() took, empty if none.
+   */
+  const std::vector<double> &getSnapshot() const {
+    return m_snapshots.front();
+  }
+
+private:
+  StepFunction m_step;
+  CaptureFunction m_capture;
+  tools::TripleBuffer<std::vector<double>> m_snapshots;
+
+  std::thread m_thread;
+  std::atomic<bool> m_running{false};
+  std::atomic<bool> m_stop{false};
+  std::atomic<std::size_t> m_num_steps{0};
+  std::exception_ptr m_error; // Of the background thread
+
+  void runBackground(double step_period_ms, std::size_t capture_every);
+  void capture();
+};
+
+} // namespace simulation
+} // namespace kernel
+} // namespace jamfree
+
+#endif // JAMFREE_KERNEL_SIMULATION_SIMULATION_RUNNER_H
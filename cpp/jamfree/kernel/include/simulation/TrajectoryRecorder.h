@@ -0,0 +1,240 @@
+#ifndef JAMFREE_KERNEL_SIMULATION_TRAJECTORY_RECORDER_H
+#define JAMFREE_KERNEL_SIMULATION_TRAJECTORY_RECORDER_H
+
+#include "../../../../microkernel/include/checkpoint/MappedFile.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace jamfree {
+namespace kernel {
+namespace simulation {
+
+/**
+ * @brief Records the trajectories of the vehicles in a file, frame after
+ * frame, on a writer thread.
+ *
+ * A frame holds the time of a step and the rows of
+ * model::exportVehicleStates() of all the vehicles, bit for bit. The frames
+ * are written in chunks of a number of frames: the first frame of a chunk,
+ * a key frame, holds its values, the next ones the differences of the bits
+ * of each value with the one of the same row in the previous frame, as
+ * zigzag varints, column after column; a vehicle moving a little changes
+ * its position by a few bytes, and its index and lane by none. A chunk may
+ * also be deflated by zlib as a whole. An index of the chunks and of the
+ * times of the frames ends the file, for TrajectoryReader to seek a frame
+ * by decoding a chunk.
+ *
+ * record() only hands the rows to the writer thread, which encodes,
+ * compresses and writes them, so that the steps go on meanwhile. If the
+ * disk is slower than the steps for long, record() waits for the writer
+ * to catch up, no frame being dropped.
+ *
+ * Layout, little-endian:
+ * - "JFTR", version 1, number of columns;
+ * - chunks: "JC", flags (1: deflated), varint size of the payload,
+ *   varint size stored, payload: for each frame, varint number of rows,
+ *   then the differences;
+ * - index: "JI", varint number of chunks, and for each one varint offset,
+ *   number of its first frame and number of frames; varint number of
+ *   frames, and the float64 time of each one;
+ * - uint64 offset of the index, "JFTR".
+ */
+class TrajectoryRecorder {
+public:
+  /**
+   * @brief Recording parameters.
+   */
+  struct Config {
+    /// Frames of a chunk, from a key frame to the next one; a chunk is
+    /// held in memory until written, and when read
+    std::size_t keyframe_interval = 100;
+
+    /// Deflate the chunks, if JamFree was built with zlib
+    bool compress = true;
+
+    /// Frames handed to the writer before record() waits, at least 1
+    std::size_t max_pending_frames = 4;
+
+    Config() = default;
+  };
+
+  explicit TrajectoryRecorder(const std::string &path);
+
+  /**
+   * @param path File to create, or to overwrite
+   * @throws std::invalid_argument If the key frame interval or the pending
+   *         frames are 0
+   * @throws std::runtime_error If the file cannot be created
+   */
+  TrajectoryRecorder(const std::string &path, const Config &config);
+
+  /**
+   * @brief Destructor, closing the file, its errors being ignored.
+   */
+  ~TrajectoryRecorder();
+
+  TrajectoryRecorder(const TrajectoryRecorder &) = delete;
+  TrajectoryRecorder &operator=(const TrajectoryRecorder &) = delete;
+
+  /**
+   * @brief Record the next frame.
+   *
+   * The rows are swapped with a buffer of a frame already written, whose
+   * values are left to be overwritten: a capture of the next step fills it
+   * again without allocating.
+   *
+   * @param time Time of the step (seconds)
+   * @param rows Rows of exportVehicleStates(), a multiple of
+   *             model::NUM_STATE_COLUMNS values
+   * @throws std::invalid_argument If the rows are not whole
+   * @throws std::logic_error If the recorder is closed
+   * @throws std::runtime_error The error of the writer thread, if any
+   */
+  void record(double time, std::vector<double> &rows);
+
+  /**
+   * @brief Write the frames left, the index, and close the file.
+   *
+   * @throws std::runtime_error The error of the writer thread, if any
+   */
+  void close();
+
+  /**
+   * @brief Get the number of frames recorded.
+   */
+  std::size_t getNumFrames() const { return m_num_frames; }
+
+  const Config &getConfig() const { return m_config; }
+
+private:
+  struct Frame {
+    double time;
+    std::vector<double> rows;
+  };
+
+  struct Chunk {
+    std::uint64_t offset;
+    std::uint64_t first_frame;
+    std::uint64_t num_frames;
+  };
+
+  Config m_config;
+  std::ofstream m_file;
+  std::size_t m_num_frames = 0;
+  bool m_closed = false;
+
+  // Shared with the writer thread
+  std::thread m_thread;
+  std::mutex m_mutex;
+  std::condition_variable m_changed;
+  std::deque<Frame> m_pending;
+  std::vector<std::vector<double>> m_free; // Buffers of the frames written
+  bool m_stop = false;
+  std::exception_ptr m_error;
+
+  // Of the writer thread
+  std::vector<std::uint64_t> m_previous; // Bits of the previous frame
+  std::vector<std::uint64_t> m_current;
+  std::vector<std::uint8_t> m_payload; // Of the current chunk
+  std::vector<std::uint8_t> m_stored;
+  std::size_t m_chunk_frames = 0;
+  std::uint64_t m_offset = 0;
+  std::vector<Chunk> m_chunks;
+  std::vector<double> m_times;
+
+  void runWriter();
+  void encode(const Frame &frame);
+  void writeChunk();
+  void writeIndex();
+  void write(const std::uint8_t *bytes, std::size_t size);
+  void rethrowError();
+};
+
+/**
+ * @brief Reader of the files of TrajectoryRecorder, frame by frame in any
+ * order.
+ *
+ * The file is mapped in memory: the chunks stored as is are decoded in
+ * place, and only the pages of the chunks read are loaded.
+ */
+class TrajectoryReader {
+public:
+  /**
+   * @brief Map a file and read its index.
+   *
+   * @throws std::runtime_error If the file cannot be read or is malformed
+   */
+  explicit TrajectoryReader(const std::string &path);
+  ~TrajectoryReader();
+
+  TrajectoryReader(const TrajectoryReader &) = delete;
+  TrajectoryReader &operator=(const TrajectoryReader &) = delete;
+
+  std::size_t getNumFrames() const { return m_times.size(); }
+
+  /**
+   * @brief Get the time of a frame (seconds).
+   */
+  double getTime(std::size_t frame) const { return m_times.at(frame); }
+
+  /**
+   * @brief Find the last frame at a time or before, the first if none.
+   *
+   * @throws std::out_of_range If there is no frame
+   */
+  std::size_t findFrame(double time) const;
+
+  /**
+   * @brief Read the rows of a frame, as recorded.
+   *
+   * The frames of a chunk are decoded from its key frame: reading the
+   * frames in order decodes each chunk once, going back decodes the chunk
+   * again up to the frame.
+   *
+   * @throws std::out_of_range If there is no such frame
+   * @throws std::runtime_error If the chunk is malformed
+   */
+  void readFrame(std::size_t frame, std::vector<double> &rows);
+
+private:
+  struct Chunk {
+    std::uint64_t offset;
+    std::uint64_t first_frame;
+    std::uint64_t num_frames;
+  };
+
+  std::unique_ptr<
+      fr::univ_artois::lgi2a::similar::microkernel::checkpoint::MappedFile>
+      m_file;
+  std::uint64_t m_index_offset = 0;
+  std::vector<Chunk> m_chunks;
+  std::vector<double> m_times;
+
+  // The chunk being read, in the file or inflated, and the frame next in it
+  std::size_t m_chunk = static_cast<std::size_t>(-1);
+  std::uint64_t m_next_frame = 0;
+  const std::uint8_t *m_payload = nullptr;
+  std::size_t m_payload_size = 0;
+  std::vector<std::uint8_t> m_inflated;
+  std::size_t m_position = 0;
+  std::vector<std::uint64_t> m_previous; // Bits of the last frame decoded
+  std::vector<std::uint64_t> m_current;
+
+  void loadChunk(std::size_t chunk);
+  void decodeFrame();
+};
+
+} // namespace simulation
+} // namespace kernel
+} // namespace jamfree
+
+#endif // JAMFREE_KERNEL_SIMULATION_TRAJECTORY_RECORDER_H
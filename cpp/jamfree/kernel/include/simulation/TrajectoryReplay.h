@@ -0,0 +1,99 @@
+#ifndef JAMFREE_KERNEL_SIMULATION_TRAJECTORY_REPLAY_H
+#define JAMFREE_KERNEL_SIMULATION_TRAJECTORY_REPLAY_H
+
+#include "TrajectoryRecorder.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace jamfree {
+namespace kernel {
+namespace simulation {
+
+/**
+ * @brief Plays a file of TrajectoryRecorder back, as a simulation would run.
+ *
+ * The replay has a time, which advance() moves on by the wall-clock time
+ * elapsed times the playback speed, and seek() moves anywhere in the
+ * recording. updateFrame() then decodes the frame recorded at that time,
+ * the rows of exportVehicleStates() of a live simulation, for the viewers
+ * and the streams of frames to show without simulating: only the changes
+ * of frame decode a frame, and a seek decodes the frames of a chunk from
+ * its key frame at most.
+ */
+class TrajectoryReplay {
+public:
+  /**
+   * @brief Map a recording, the replay being at its first frame, decoded.
+   *
+   * @throws std::runtime_error If the file cannot be read or is malformed
+   * @throws std::invalid_argument If the recording has no frame
+   */
+  explicit TrajectoryReplay(const std::string &path);
+
+  /**
+   * @brief Set the playback speed.
+   *
+   * @param speed Seconds of the recording by second of wall-clock time, 0
+   *              to pause
+   * @throws std::invalid_argument If the speed is negative or not finite
+   */
+  void setSpeed(double speed);
+
+  double getSpeed() const { return m_speed; }
+
+  /**
+   * @brief Move to a time, within the recording.
+   */
+  void seek(double time);
+
+  /**
+   * @brief Move on by a wall-clock time, at the playback speed.
+   *
+   * @param wallclock_seconds Time elapsed since the last call (seconds)
+   */
+  void advance(double wallclock_seconds);
+
+  /**
+   * @brief Decode the frame recorded at the time, if it changed.
+   *
+   * @return True if getFrame() changed
+   */
+  bool updateFrame();
+
+  /**
+   * @brief Get the rows the last updateFrame() decoded.
+   */
+  const std::vector<double> &getFrame() const { return m_rows; }
+
+  /**
+   * @brief Get the index of the frame getFrame() holds.
+   */
+  std::size_t getFrameIndex() const { return m_frame; }
+
+  double getTime() const { return m_time; }
+  double getStartTime() const { return m_reader.getTime(0); }
+  double getEndTime() const {
+    return m_reader.getTime(m_reader.getNumFrames() - 1);
+  }
+
+  /**
+   * @brief Check if the replay reached the last frame.
+   */
+  bool isAtEnd() const { return m_time >= getEndTime(); }
+
+  const TrajectoryReader &getReader() const { return m_reader; }
+
+private:
+  TrajectoryReader m_reader;
+  double m_time;
+  double m_speed = 1.0;
+  std::size_t m_frame = static_cast<std::size_t>(-1);
+  std::vector<double> m_rows;
+};
+
+} // namespace simulation
+} // namespace kernel
+} // namespace jamfree
+
+#endif // JAMFREE_KERNEL_SIMULATION_TRAJECTORY_REPLAY_H
@@ -0,0 +1,95 @@
+#ifndef JAMFREE_KERNEL_TOOLS_OBJECT_POOL_H
+#define JAMFREE_KERNEL_TOOLS_OBJECT_POOL_H
+
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace jamfree {
+namespace kernel {
+namespace tools {
+
+/**
+ * @brief Pool of objects, reused instead of allocated at each spawn.
+ *
+ * acquire() hands out a released object, reset with the arguments of the
+ * constructor by its reset() method, or makes a new one: the object and
+ * the control block of its shared pointer are allocated once, and the
+ * storage it owns, such as the capacity of its strings, is kept. The
+ * objects are released explicitly, when despawned: only the ones that
+ * nothing else holds go back to the pool.
+ *
+ * @tparam T Type of the objects, with a reset() taking the arguments of
+ *           its constructor
+ */
+template <typename T> class ObjectPool {
+public:
+  /**
+   * @param max_free Number of released objects kept at most
+   */
+  explicit ObjectPool(
+      std::size_t max_free = std::numeric_limits<std::size_t>::max())
+      : m_max_free(max_free) {}
+
+  /**
+   * @brief Get an object, as constructed with the arguments.
+   */
+  template <typename... Args> std::shared_ptr<T> acquire(Args &&...args) {
+    if (m_free.empty()) {
+      return std::make_shared<T>(std::forward<Args>(args)...);
+    }
+    std::shared_ptr<T> object = std::move(m_free.back());
+    m_free.pop_back();
+    object->reset(std::forward<Args>(args)...);
+    return object;
+  }
+
+  /**
+   * @brief Give an object back for the next acquire().
+   *
+   * @param object Object, which the caller holds no more
+   * @return True if the object is kept, false if it is still shared or the
+   *         pool is full
+   */
+  bool release(std::shared_ptr<T> object) {
+    if (!object || object.use_count() != 1 || m_free.size() >= m_max_free) {
+      return false;
+    }
+    m_free.push_back(std::move(object));
+    return true;
+  }
+
+  /**
+   * @brief Make objects in advance, so that the next acquire() allocate
+   * nothing.
+   *
+   * @param count Number of objects free after the call, at least
+   * @param args Arguments of their constructor
+   */
+  template <typename... Args>
+  void reserve(std::size_t count, const Args &...args) {
+    m_free.reserve(count);
+    while (m_free.size() < count) {
+      m_free.push_back(std::make_shared<T>(args...));
+    }
+  }
+
+  std::size_t getNumFree() const { return m_free.size(); }
+
+  /**
+   * @brief Free the objects released.
+   */
+  void clear() { m_free.clear(); }
+
+private:
+  std::size_t m_max_free;
+  std::vector<std::shared_ptr<T>> m_free;
+};
+
+} // namespace tools
+} // namespace kernel
+} // namespace jamfree
+
+#endif // JAMFREE_KERNEL_TOOLS_OBJECT_POOL_H
@@ -0,0 +1,49 @@
+#ifndef JAMFREE_KERNEL_TOOLS_PRECISION_H
+#define JAMFREE_KERNEL_TOOLS_PRECISION_H
+
+namespace jamfree {
+namespace kernel {
+namespace tools {
+
+/**
+ * @brief The type of the vehicle states stored in bulk by the microscopic
+ * passes.
+ *
+ * The columns of a model::LaneVehicleStore (lane positions, speeds,
+ * accelerations, gaps and the vehicle and driver parameters) and the batch
+ * kernels of the car-following models run in this type, while the
+ * model::Vehicle handles and the rest of the API keep doubles. The
+ * positions are lane positions, relative to the start of their lane, so
+ * that their precision does not degrade with the length of the road.
+ *
+ * @tparam StateType The type of the positions, speeds and accelerations
+ */
+template <typename StateType> struct PrecisionPolicy {
+  using State = StateType;
+};
+
+using DoublePrecision = PrecisionPolicy<double>;
+
+/**
+ * @brief Doubles the number of vehicles per vector instruction of the IDM
+ * passes and halves their memory traffic, at the cost of about 7
+ * significant digits: a centimetre on a 100 km lane. The results are the
+ * ones of the float kernels of the GPU backends.
+ */
+using SinglePrecision = PrecisionPolicy<float>;
+
+/**
+ * @brief The precision of the build, single when JAMFREE_FLOAT32 is defined
+ * (the CMake option of the same name), double otherwise.
+ */
+#if defined(JAMFREE_FLOAT32) && JAMFREE_FLOAT32
+using Precision = SinglePrecision;
+#else
+using Precision = DoublePrecision;
+#endif
+
+} // namespace tools
+} // namespace kernel
+} // namespace jamfree
+
+#endif // JAMFREE_KERNEL_TOOLS_PRECISION_H
@@ -0,0 +1,70 @@
+#ifndef JAMFREE_KERNEL_TOOLS_TRIPLE_BUFFER_H
+#define JAMFREE_KERNEL_TOOLS_TRIPLE_BUFFER_H
+
+#include <array>
+#include <atomic>
+
+namespace jamfree {
+namespace kernel {
+namespace tools {
+
+/**
+ * @brief Lock-free handoff of the latest value from a writer to a reader.
+ *
+ * Of the three slots, the writer fills its back one then publishes it by
+ * swapping it with the middle one, and the reader takes the middle one, if
+ * newer, by swapping it with its front one: neither waits for the other,
+ * the values the reader skips are overwritten, and each slot keeps its
+ * storage across the swaps. One thread writes and one thread reads.
+ *
+ * @tparam T Type of the values
+ */
+template <typename T> class TripleBuffer {
+public:
+  /**
+   * @brief Get the slot to write, which the reader does not see.
+   */
+  T &back() { return m_slots[m_back]; }
+
+  /**
+   * @brief Hand the back slot over to the reader, as the latest value.
+   */
+  void publish() {
+    m_back = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel) &
+             INDEX;
+  }
+
+  /**
+   * @brief Take the latest value published, if any since the last call.
+   *
+   * @return True if front() changed
+   */
+  bool update() {
+    if (!(m_middle.load(std::memory_order_relaxed) & FRESH)) {
+      return false;
+    }
+    m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX;
+    return true;
+  }
+
+  /**
+   * @brief Get the value the last update() took, which the writer does not
+   * touch.
+   */
+  const T &front() const { return m_slots[m_front]; }
+
+private:
+  static constexpr unsigned INDEX = 3;
+  static constexpr unsigned FRESH = 4; // The middle slot is not read yet
+
+  std::array<T, 3> m_slots{};
+  unsigned m_back = 0;
+  unsigned m_front = 1;
+  std::atomic<unsigned> m_middle{2};
+};
+
+} // namespace tools
+} // namespace kernel
+} // namespace jamfree
+
+#endif // JAMFREE_KERNEL_TOOLS_TRIPLE_BUFFER_H
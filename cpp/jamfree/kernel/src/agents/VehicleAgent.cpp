@@ -12,6 +12,14 @@ VehicleAgent::VehicleAgent(const std::string &id)
               "Vehicle")),
       m_id(id) {}
 
+void VehicleAgent::reset(const std::string &id) {
+  m_id = Symbol(id);
+  for (const auto &level : getLevels()) {
+    removeBehaviorForLevel(level);
+    excludeFromLevel(level);
+  }
+}
+
 void VehicleAgent::addLevel(const LevelIdentifier &level) {
   (void)level;
   // In SIMILAR, levels are added via includeNewLevel with states.
@@ -0,0 +1,149 @@
+#include "kernel/include/model/DetectorSet.h"
+#include "kernel/include/model/Vehicle.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace jamfree {
+namespace kernel {
+namespace model {
+
+namespace {
+
+// Detectors by task of the parallel loop, of a few binary searches each
+constexpr std::size_t DETECTOR_CHUNK_SIZE = 256;
+
+// Speed below which a crossing vehicle counts as this one, so that its
+// inverse stays finite (m/s)
+constexpr double MIN_CROSSING_SPEED = 0.1;
+
+} // namespace
+
+DetectorSet::DetectorSet(double period) : m_period(period) {
+  if (!(period > 0.0)) {
+    throw std::invalid_argument("Detector set: the period must be positive");
+  }
+}
+
+std::size_t DetectorSet::addDetector(std::shared_ptr<Lane> lane,
+                                     double position, double loop_length) {
+  if (!lane) {
+    throw std::invalid_argument("Detector set: a detector needs a lane");
+  }
+  if (!(loop_length >= 0.0)) {
+    throw std::invalid_argument(
+        "Detector set: the loop length must not be negative");
+  }
+  m_lanes.push_back(std::move(lane));
+  m_positions.push_back(position);
+  m_loop_ends.push_back(position + loop_length);
+  m_upstream.emplace_back();
+  m_counts.push_back(0);
+  m_speed_sums.push_back(0.0);
+  m_inverse_speed_sums.push_back(0.0);
+  m_occupied_times.push_back(0.0);
+  return m_lanes.size() - 1;
+}
+
+void DetectorSet::setNumThreads(std::size_t numThreads) {
+  if (numThreads > 1) {
+    m_pool = std::make_shared<ThreadPool>(numThreads);
+  } else {
+    m_pool.reset();
+  }
+}
+
+void DetectorSet::update(double dt) {
+  std::unique_ptr<ThreadPool::Scope> scope;
+  if (m_pool && ThreadPool::currentSize() == 1) {
+    scope = std::make_unique<ThreadPool::Scope>(m_pool.get());
+  }
+  ThreadPool::parallelForOnCurrent(
+      m_lanes.size(), DETECTOR_CHUNK_SIZE,
+      [this, dt](std::size_t begin, std::size_t end, std::size_t) {
+        for (std::size_t i = begin; i < end; ++i) {
+          measure(i, dt);
+        }
+      });
+
+  m_time += dt;
+  if (m_time >= m_period_start + m_period) {
+    closePeriod();
+  }
+}
+
+void DetectorSet::measure(std::size_t detector, double dt) {
+  const Lane &lane = *m_lanes[detector];
+  const double position = m_positions[detector];
+  const auto &vehicles = lane.getVehicles();
+  const auto first = std::lower_bound(
+      vehicles.begin(), vehicles.end(), position,
+      [](const std::shared_ptr<Vehicle> &vehicle, double x) {
+        return vehicle->getLanePosition() < x;
+      });
+
+  // The vehicles from the position to the one that was behind it
+  const auto upstream = m_upstream[detector].lock();
+  if (upstream && upstream->getCurrentLane() == m_lanes[detector] &&
+      upstream->getLanePosition() >= position) {
+    const auto last = std::find(first, vehicles.end(), upstream);
+    if (last != vehicles.end()) {
+      for (auto it = first; it <= last; ++it) {
+        const double speed =
+            std::max(MIN_CROSSING_SPEED, (*it)->getSpeed());
+        ++m_counts[detector];
+        m_speed_sums[detector] += speed;
+        m_inverse_speed_sums[detector] += 1.0 / speed;
+      }
+    }
+  }
+  m_upstream[detector] =
+      first != vehicles.begin() ? *(first - 1) : std::shared_ptr<Vehicle>();
+
+  // Occupied if the last vehicle whose rear is before the loop end, the
+  // nearest one, reaches the loop start with its front
+  const auto over = std::upper_bound(
+      first, vehicles.end(), m_loop_ends[detector],
+      [](double x, const std::shared_ptr<Vehicle> &vehicle) {
+        return x < vehicle->getLanePosition();
+      });
+  if (over != vehicles.begin()) {
+    const Vehicle &nearest = **(over - 1);
+    if (nearest.getLanePosition() + nearest.getLength() >= position) {
+      m_occupied_times[detector] += dt;
+    }
+  }
+}
+
+void DetectorSet::closePeriod() {
+  const double duration = m_time - m_period_start;
+  const float none = std::numeric_limits<float>::quiet_NaN();
+  m_reports.num_detectors = m_lanes.size();
+  m_reports.period_end.push_back(m_time);
+  for (std::size_t i = 0; i < m_lanes.size(); ++i) {
+    const std::uint32_t count = m_counts[i];
+    m_reports.counts.push_back(count);
+    m_reports.occupancy.push_back(
+        static_cast<float>(m_occupied_times[i] / duration));
+    m_reports.harmonic_speed.push_back(
+        count > 0 ? static_cast<float>(count / m_inverse_speed_sums[i])
+                  : none);
+    m_reports.mean_speed.push_back(
+        count > 0 ? static_cast<float>(m_speed_sums[i] / count) : none);
+  }
+  std::fill(m_counts.begin(), m_counts.end(), 0);
+  std::fill(m_speed_sums.begin(), m_speed_sums.end(), 0.0);
+  std::fill(m_inverse_speed_sums.begin(), m_inverse_speed_sums.end(), 0.0);
+  std::fill(m_occupied_times.begin(), m_occupied_times.end(), 0.0);
+  m_period_start = m_time;
+}
+
+void DetectorSet::exportReports(DetectorReports &reports) {
+  reports.clear();
+  std::swap(reports, m_reports);
+  m_reports.num_detectors = m_lanes.size();
+}
+
+} // namespace model
+} // namespace kernel
+} // namespace jamfree
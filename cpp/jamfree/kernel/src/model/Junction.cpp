@@ -0,0 +1,269 @@
+#include "kernel/include/model/Junction.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace jamfree {
+namespace kernel {
+namespace model {
+
+namespace {
+
+// Sine of the crossing angle under which the paths count as merging at
+// this angle, bounding the extent of the zones of near-parallel paths
+constexpr double MIN_CROSSING_SINE = 0.25;
+
+double cross(const Point2D &a, const Point2D &b) { return a.x * b.y - a.y * b.x; }
+
+// The window a vehicle entering at entry_time holds a crossing
+struct Window {
+  double enter;
+  double exit;
+};
+
+Window holdWindow(const Junction::Crossing &crossing, double entry_time,
+                  double speed, double vehicle_length) {
+  return {entry_time + crossing.entry / speed,
+          entry_time + (crossing.exit + vehicle_length) / speed};
+}
+
+bool overlaps(const Window &window, const Junction::Reservation &reservation,
+              double gap) {
+  return window.enter < reservation.exit + gap &&
+         reservation.enter < window.exit + gap;
+}
+
+} // namespace
+
+Junction::Junction(const std::string &id, double path_width)
+    : m_id(id), m_path_width(path_width) {
+  if (!(path_width > 0.0)) {
+    throw std::invalid_argument("Junction: the path width must be positive");
+  }
+}
+
+std::size_t Junction::addMovement(std::shared_ptr<Lane> from,
+                                  std::shared_ptr<Lane> to) {
+  if (!from || !to) {
+    throw std::invalid_argument("Junction: a movement needs two lanes");
+  }
+  std::vector<Point2D> path = {from->getPositionAt(from->getLength()),
+                               to->getPositionAt(0.0)};
+  return addMovement(std::move(from), std::move(to), std::move(path));
+}
+
+std::size_t Junction::addMovement(std::shared_ptr<Lane> from,
+                                  std::shared_ptr<Lane> to,
+                                  std::vector<Point2D> path) {
+  if (!from || !to) {
+    throw std::invalid_argument("Junction: a movement needs two lanes");
+  }
+  if (path.size() < 2) {
+    throw std::invalid_argument(
+        "Junction: the path of a movement needs two points");
+  }
+  Movement movement;
+  movement.from = std::move(from);
+  movement.to = std::move(to);
+  movement.path = std::move(path);
+  movement.length = 0.0;
+  for (std::size_t i = 1; i < movement.path.size(); ++i) {
+    movement.length += movement.path[i - 1].distanceTo(movement.path[i]);
+  }
+  const std::size_t index = m_movements.size();
+  m_movements.push_back(std::move(movement));
+
+  const Movement &added = m_movements[index];
+  for (std::size_t other = 0; other < index; ++other) {
+    const Movement &existing = m_movements[other];
+    // Vehicles from the same lane follow each other
+    if (existing.from == added.from) {
+      continue;
+    }
+    if (existing.to == added.to) {
+      // The last path width of both paths, up to where they join
+      addZone({0, std::max(0.0, existing.length - m_path_width),
+               existing.length},
+              other,
+              {0, std::max(0.0, added.length - m_path_width), added.length},
+              index, added.path.back(), true);
+      continue;
+    }
+    // Where the segments of the paths cross
+    double existing_start = 0.0;
+    for (std::size_t i = 1; i < existing.path.size(); ++i) {
+      const Point2D &p = existing.path[i - 1];
+      const Point2D r = existing.path[i] - p;
+      const double r_length = r.magnitude();
+      double added_start = 0.0;
+      for (std::size_t j = 1; j < added.path.size(); ++j) {
+        const Point2D &q = added.path[j - 1];
+        const Point2D d = added.path[j] - q;
+        const double d_length = d.magnitude();
+        const double denominator = cross(r, d);
+        if (r_length > 0.0 && d_length > 0.0 && denominator != 0.0) {
+          const double t = cross(q - p, d) / denominator;
+          const double u = cross(q - p, r) / denominator;
+          // The segments half-open but the last, a crossing at a vertex
+          // counting once
+          const bool existing_last = i + 1 == existing.path.size();
+          const bool added_last = j + 1 == added.path.size();
+          if (t >= 0.0 && (t < 1.0 || (existing_last && t == 1.0)) &&
+              u >= 0.0 && (u < 1.0 || (added_last && u == 1.0))) {
+            const double sine = std::max(
+                MIN_CROSSING_SINE,
+                std::abs(denominator) / (r_length * d_length));
+            const double half = 0.5 * m_path_width / sine;
+            const double existing_at = existing_start + t * r_length;
+            const double added_at = added_start + u * d_length;
+            addZone({0, std::max(0.0, existing_at - half),
+                     std::min(existing.length, existing_at + half)},
+                    other,
+                    {0, std::max(0.0, added_at - half),
+                     std::min(added.length, added_at + half)},
+                    index, p + r * t, false);
+          }
+        }
+        added_start += d_length;
+      }
+      existing_start += r_length;
+    }
+  }
+  return index;
+}
+
+void Junction::addZone(const Crossing &first, std::size_t first_movement,
+                       const Crossing &second, std::size_t second_movement,
+                       const Point2D &position, bool merge) {
+  const std::size_t zone = m_zones.size();
+  m_zones.push_back({{first_movement, second_movement}, position, merge, {}});
+  for (auto [crossing, movement] :
+       {std::make_pair(first, first_movement),
+        std::make_pair(second, second_movement)}) {
+    crossing.zone = zone;
+    auto &crossings = m_movements[movement].crossings;
+    crossings.insert(
+        std::upper_bound(crossings.begin(), crossings.end(), crossing,
+                         [](const Crossing &a, const Crossing &b) {
+                           return a.entry < b.entry;
+                         }),
+        crossing);
+  }
+}
+
+std::size_t Junction::findMovement(const Lane &from, const Lane &to) const {
+  for (std::size_t i = 0; i < m_movements.size(); ++i) {
+    if (m_movements[i].from.get() == &from && m_movements[i].to.get() == &to) {
+      return i;
+    }
+  }
+  return NONE;
+}
+
+bool Junction::isGapAcceptable(std::size_t movement, const std::string &vehicle,
+                               double entry_time, double speed,
+                               double vehicle_length,
+                               double critical_gap) const {
+  speed = std::max(speed, MIN_CROSSING_SPEED);
+  for (const Crossing &crossing : m_movements.at(movement).crossings) {
+    const Window window =
+        holdWindow(crossing, entry_time, speed, vehicle_length);
+    for (const Reservation &reservation :
+         m_zones[crossing.zone].reservations) {
+      if (reservation.vehicle != vehicle &&
+          overlaps(window, reservation, critical_gap)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+double Junction::findEntryTime(std::size_t movement,
+                               const std::string &vehicle,
+                               double earliest_time, double speed,
+                               double vehicle_length,
+                               double critical_gap) const {
+  speed = std::max(speed, MIN_CROSSING_SPEED);
+  const Movement &crossed = m_movements.at(movement);
+  // Each pass moves past the reservations in the way, which stay behind
+  double time = earliest_time;
+  for (;;) {
+    double next = time;
+    for (const Crossing &crossing : crossed.crossings) {
+      const Window window = holdWindow(crossing, time, speed, vehicle_length);
+      for (const Reservation &reservation :
+           m_zones[crossing.zone].reservations) {
+        if (reservation.vehicle != vehicle &&
+            overlaps(window, reservation, critical_gap)) {
+          next = std::max(next, reservation.exit + critical_gap -
+                                    crossing.entry / speed);
+        }
+      }
+    }
+    if (next == time) {
+      return time;
+    }
+    time = next;
+  }
+}
+
+bool Junction::reserve(std::size_t movement, const std::string &vehicle,
+                       double entry_time, double speed,
+                       double vehicle_length, double critical_gap) {
+  if (!isGapAcceptable(movement, vehicle, entry_time, speed, vehicle_length,
+                       critical_gap)) {
+    return false;
+  }
+  release(movement, vehicle);
+  speed = std::max(speed, MIN_CROSSING_SPEED);
+  for (const Crossing &crossing : m_movements[movement].crossings) {
+    const Window window =
+        holdWindow(crossing, entry_time, speed, vehicle_length);
+    auto &reservations = m_zones[crossing.zone].reservations;
+    reservations.insert(
+        std::upper_bound(reservations.begin(), reservations.end(),
+                         window.enter,
+                         [](double enter, const Reservation &reservation) {
+                           return enter < reservation.enter;
+                         }),
+        {vehicle, movement, window.enter, window.exit});
+  }
+  return true;
+}
+
+void Junction::release(std::size_t movement, const std::string &vehicle) {
+  for (const Crossing &crossing : m_movements.at(movement).crossings) {
+    auto &reservations = m_zones[crossing.zone].reservations;
+    reservations.erase(
+        std::remove_if(reservations.begin(), reservations.end(),
+                       [&](const Reservation &reservation) {
+                         return reservation.movement == movement &&
+                                reservation.vehicle == vehicle;
+                       }),
+        reservations.end());
+  }
+}
+
+void Junction::expire(double time) {
+  for (ConflictZone &zone : m_zones) {
+    zone.reservations.erase(
+        std::remove_if(zone.reservations.begin(), zone.reservations.end(),
+                       [time](const Reservation &reservation) {
+                         return reservation.exit < time;
+                       }),
+        zone.reservations.end());
+  }
+}
+
+std::size_t Junction::getNumReservations() const {
+  std::size_t count = 0;
+  for (const ConflictZone &zone : m_zones) {
+    count += zone.reservations.size();
+  }
+  return count;
+}
+
+} // namespace model
+} // namespace kernel
+} // namespace jamfree
@@ -11,17 +11,9 @@ namespace model {
 
 Point2D Lane::getPositionAt(double distance) const {
   if (m_parent_road) {
-    // Get position from parent road and offset by lane index
-    Point2D center_pos = m_parent_road->getPositionAt(distance);
-    double heading = m_parent_road->getHeadingAt(distance);
-
     // Offset perpendicular to road direction
     // Lane 0 is rightmost, so offset to the right
-    double offset = (m_index + 0.5) * m_width;
-    double perp_heading = heading - M_PI / 2.0; // 90 degrees right
-
-    return Point2D(center_pos.x + offset * std::cos(perp_heading),
-                   center_pos.y + offset * std::sin(perp_heading));
+    return m_parent_road->getPositionAt(distance, (m_index + 0.5) * m_width);
   }
   return Point2D(distance, 0);
 }
@@ -41,81 +33,58 @@ bool Lane::containsPosition(const Point2D &position, double tolerance) const {
 }
 
 double Lane::getDistanceAlong(const Point2D &position) const {
-  // Project position onto lane
-  // For now, simple implementation assuming straight lane
+  // Project position onto the segments of the road
   if (m_parent_road) {
-    Point2D start = m_parent_road->getStart();
-    Point2D end = m_parent_road->getEnd();
-
-    // Project onto road direction
-    Point2D dir = (end - start).normalized();
-    Point2D to_pos = position - start;
-    double dist = to_pos.dot(dir);
-
+    double dist = m_parent_road->getDistanceAlong(position);
     return std::max(0.0, std::min(m_length, dist));
   }
   return 0.0;
 }
 
 void Lane::addVehicle(std::shared_ptr<Vehicle> vehicle) {
-  m_vehicles.push_back(vehicle);
-
-  // Sort by position (for efficient leader/follower queries)
-  std::sort(
-      m_vehicles.begin(), m_vehicles.end(),
-      [](const std::shared_ptr<Vehicle> &a, const std::shared_ptr<Vehicle> &b) {
-        return a->getLanePosition() < b->getLanePosition();
-      });
+  m_spatial_index.addVehicle(vehicle);
 }
 
 void Lane::removeVehicle(std::shared_ptr<Vehicle> vehicle) {
-  auto it = std::find(m_vehicles.begin(), m_vehicles.end(), vehicle);
-  if (it != m_vehicles.end()) {
-    m_vehicles.erase(it);
-  }
+  m_spatial_index.removeVehicle(vehicle);
 }
 
+void Lane::removeVehicles(
+    const std::vector<std::shared_ptr<Vehicle>> &vehicles) {
+  m_spatial_index.removeVehicles(vehicles);
+}
+
+void Lane::sortVehicles() { m_spatial_index.update(); }
+
 std::shared_ptr<Vehicle> Lane::getVehicleAhead(double position) const {
-  // Vehicles are sorted by position
-  for (const auto &vehicle : m_vehicles) {
-    if (vehicle->getLanePosition() > position) {
-      return vehicle;
-    }
-  }
-  return nullptr;
+  const auto *ahead = m_spatial_index.findAhead(position);
+  return ahead ? *ahead : nullptr;
 }
 
 std::shared_ptr<Vehicle> Lane::getVehicleBehind(double position) const {
-  // Vehicles are sorted by position
-  std::shared_ptr<Vehicle> behind = nullptr;
-  for (const auto &vehicle : m_vehicles) {
-    if (vehicle->getLanePosition() < position) {
-      behind = vehicle;
-    } else {
-      break;
-    }
-  }
-  return behind;
+  const auto *behind = m_spatial_index.findBehind(position);
+  return behind ? *behind : nullptr;
 }
 
+// The lookups below borrow the vehicles held by the index, without copying
+// their shared pointers.
+
 double Lane::getGapAhead(double position) const {
-  auto ahead = getVehicleAhead(position);
+  const auto *ahead = m_spatial_index.findAhead(position);
   if (ahead) {
-    return ahead->getLanePosition() - position;
+    return (*ahead)->getLanePosition() - position;
   }
   return std::numeric_limits<double>::infinity();
 }
 
 Vehicle *Lane::getLeader(const Vehicle &vehicle) const {
-  double pos = vehicle.getLanePosition();
-  auto ahead = getVehicleAhead(pos);
-  return ahead ? ahead.get() : nullptr;
+  const auto *ahead = m_spatial_index.findAhead(vehicle.getLanePosition());
+  return ahead ? ahead->get() : nullptr;
 }
 
 Vehicle *Lane::getFollower(const Vehicle &vehicle) const {
-  double pos = vehicle.getLanePosition();
-  auto behind = getVehicleBehind(pos);
-  return behind ? behind.get() : nullptr;
+  const auto *behind = m_spatial_index.findBehind(vehicle.getLanePosition());
+  return behind ? behind->get() : nullptr;
 }
 
 } // namespace model
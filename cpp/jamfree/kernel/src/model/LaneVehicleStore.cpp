@@ -0,0 +1,155 @@
+#include "kernel/include/model/LaneVehicleStore.h"
+#include "kernel/include/model/Vehicle.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace jamfree {
+namespace kernel {
+namespace model {
+
+void LaneVehicleStore::clear() {
+  m_vehicles.clear();
+  m_integrated.clear();
+  m_positions.clear();
+  m_speeds.clear();
+  m_accelerations.clear();
+  m_lengths.clear();
+  m_max_speeds.clear();
+  m_max_accels.clear();
+  m_max_decels.clear();
+  m_desired_speeds.clear();
+  m_time_headways.clear();
+  m_min_gaps.clear();
+  m_idm_accels.clear();
+  m_comfortable_decels.clear();
+  m_accel_exponents.clear();
+}
+
+void LaneVehicleStore::add(Vehicle &vehicle, const DriverParameters *driver,
+                           bool integrated) {
+  static const DriverParameters no_driver = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+  const DriverParameters &parameters = driver ? *driver : no_driver;
+
+  m_vehicles.push_back(&vehicle);
+  m_integrated.push_back(integrated ? 1 : 0);
+  m_positions.push_back(static_cast<Value>(vehicle.getLanePosition()));
+  m_speeds.push_back(static_cast<Value>(vehicle.getSpeed()));
+  m_accelerations.push_back(Value(0));
+  m_lengths.push_back(static_cast<Value>(vehicle.getLength()));
+  m_max_speeds.push_back(static_cast<Value>(vehicle.getMaxSpeed()));
+  m_max_accels.push_back(static_cast<Value>(vehicle.getMaxAccel()));
+  m_max_decels.push_back(static_cast<Value>(vehicle.getMaxDecel()));
+  m_desired_speeds.push_back(static_cast<Value>(parameters.desired_speed));
+  m_time_headways.push_back(static_cast<Value>(parameters.time_headway));
+  m_min_gaps.push_back(static_cast<Value>(parameters.min_gap));
+  m_idm_accels.push_back(static_cast<Value>(parameters.max_accel));
+  m_comfortable_decels.push_back(
+      static_cast<Value>(parameters.comfortable_decel));
+  m_accel_exponents.push_back(static_cast<Value>(parameters.accel_exponent));
+}
+
+void LaneVehicleStore::computeAccelerations() {
+  const size_t n = m_vehicles.size();
+  // The nearest vehicle strictly ahead, found walking from the front
+  size_t ahead = n;
+  for (size_t k = n; k-- > 0;) {
+    if (k + 1 < n && m_positions[k + 1] > m_positions[k]) {
+      ahead = k + 1;
+    }
+
+    const Value a = m_idm_accels[k];
+    if (a == Value(0)) {
+      // No driver
+      m_accelerations[k] = Value(0);
+      continue;
+    }
+
+    // Free-flow acceleration term
+    const Value v = m_speeds[k];
+    Value accel = a * (Value(1) - std::pow(v / m_desired_speeds[k],
+                                           m_accel_exponents[k]));
+
+    if (ahead < n) {
+      const Value s = m_positions[ahead] - (m_positions[k] + m_lengths[k]);
+      const Value dv = v - m_speeds[ahead];
+
+      // Desired gap s* = s₀ + v*T + v*Δv / (2√(a*b))
+      const Value s_star =
+          m_min_gaps[k] + v * m_time_headways[k] +
+          v * dv / (Value(2) * std::sqrt(a * m_comfortable_decels[k]));
+
+      // Interaction term
+      const Value ratio = s_star / s;
+      accel -= a * ratio * ratio;
+    }
+    m_accelerations[k] = accel;
+  }
+}
+
+void LaneVehicleStore::computeGaps() {
+  const size_t n = m_vehicles.size();
+  m_gaps.resize(n);
+  m_relative_speeds.resize(n);
+  size_t ahead = n;
+  for (size_t k = n; k-- > 0;) {
+    if (k + 1 < n && m_positions[k + 1] > m_positions[k]) {
+      ahead = k + 1;
+    }
+    if (ahead < n) {
+      m_gaps[k] = m_positions[ahead] - (m_positions[k] + m_lengths[k]);
+      m_relative_speeds[k] = m_speeds[k] - m_speeds[ahead];
+    } else {
+      m_gaps[k] = std::numeric_limits<Value>::infinity();
+      m_relative_speeds[k] = Value(0);
+    }
+  }
+}
+
+void LaneVehicleStore::clearUndriven() {
+  const size_t n = m_vehicles.size();
+  for (size_t k = 0; k < n; ++k) {
+    if (m_idm_accels[k] == Value(0)) {
+      m_accelerations[k] = Value(0);
+    }
+  }
+}
+
+void LaneVehicleStore::integrate(double dt) {
+  const size_t n = m_vehicles.size();
+  const Value step = static_cast<Value>(dt);
+  for (size_t k = 0; k < n; ++k) {
+    if (!m_integrated[k]) {
+      continue;
+    }
+    // Clamp acceleration to vehicle limits
+    const Value accel = std::max(
+        -m_max_decels[k], std::min(m_max_accels[k], m_accelerations[k]));
+    m_accelerations[k] = accel;
+
+    const Value speed = std::max(
+        Value(0), std::min(m_max_speeds[k], m_speeds[k] + accel * step));
+    m_speeds[k] = speed;
+    m_positions[k] += speed * step;
+  }
+}
+
+void LaneVehicleStore::scatter() const {
+  const size_t n = m_vehicles.size();
+  for (size_t k = 0; k < n; ++k) {
+    if (!m_integrated[k]) {
+      continue;
+    }
+    Vehicle &vehicle = *m_vehicles[k];
+    vehicle.setAcceleration(m_accelerations[k]);
+    vehicle.setSpeed(m_speeds[k]);
+    vehicle.setLanePosition(m_positions[k]);
+
+    // The 2D position follows on demand
+    vehicle.invalidatePosition();
+  }
+}
+
+} // namespace model
+} // namespace kernel
+} // namespace jamfree
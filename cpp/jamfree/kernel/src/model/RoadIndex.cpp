@@ -0,0 +1,286 @@
+#include "kernel/include/model/RoadIndex.h"
+#include "kernel/include/model/Road.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <numeric>
+#include <queue>
+#include <unordered_set>
+#include <utility>
+
+namespace jamfree {
+namespace kernel {
+namespace model {
+
+namespace {
+
+template <typename BoxOf>
+void sortTileRecursive(std::vector<std::uint32_t> &order, BoxOf boxOf) {
+  // Slabs of as many leaves as there are slabs, ties broken by index so
+  // that the tree only depends on the roads
+  const std::size_t count = order.size();
+  const std::size_t leaves =
+      (count + RoadIndex::NODE_CAPACITY - 1) / RoadIndex::NODE_CAPACITY;
+  const std::size_t slabs = static_cast<std::size_t>(
+      std::ceil(std::sqrt(static_cast<double>(leaves))));
+  const std::size_t slab_size = slabs * RoadIndex::NODE_CAPACITY;
+  auto byX = [&](std::uint32_t a, std::uint32_t b) {
+    const double ca = boxOf(a).min_x + boxOf(a).max_x;
+    const double cb = boxOf(b).min_x + boxOf(b).max_x;
+    return ca < cb || (ca == cb && a < b);
+  };
+  auto byY = [&](std::uint32_t a, std::uint32_t b) {
+    const double ca = boxOf(a).min_y + boxOf(a).max_y;
+    const double cb = boxOf(b).min_y + boxOf(b).max_y;
+    return ca < cb || (ca == cb && a < b);
+  };
+  std::sort(order.begin(), order.end(), byX);
+  for (std::size_t begin = 0; begin < count; begin += slab_size) {
+    const std::size_t end = std::min(count, begin + slab_size);
+    std::sort(order.begin() + begin, order.begin() + end, byY);
+  }
+}
+
+template <typename Box>
+double squaredDistanceTo(const Box &box, const Point2D &position) {
+  const double dx =
+      std::max({box.min_x - position.x, 0.0, position.x - box.max_x});
+  const double dy =
+      std::max({box.min_y - position.y, 0.0, position.y - box.max_y});
+  return dx * dx + dy * dy;
+}
+
+template <typename Box>
+bool overlaps(const Box &box, const Point2D &min_point,
+              const Point2D &max_point) {
+  return box.min_x <= max_point.x && box.max_x >= min_point.x &&
+         box.min_y <= max_point.y && box.max_y >= min_point.y;
+}
+
+} // namespace
+
+void RoadIndex::clear() {
+  m_segments.clear();
+  m_nodes.clear();
+  m_root = 0;
+}
+
+void RoadIndex::build(const std::vector<std::shared_ptr<Road>> &roads) {
+  clear();
+  for (const auto &road : roads) {
+    addSegments(*road);
+  }
+  pack();
+}
+
+void RoadIndex::update(const std::vector<std::shared_ptr<Road>> &removed,
+                       const std::vector<std::shared_ptr<Road>> &added) {
+  std::unordered_set<const Road *> gone;
+  for (const auto &road : removed) {
+    gone.insert(road.get());
+  }
+  m_segments.erase(std::remove_if(m_segments.begin(), m_segments.end(),
+                                  [&](const Segment &segment) {
+                                    return gone.count(segment.road) != 0;
+                                  }),
+                   m_segments.end());
+  for (const auto &road : added) {
+    addSegments(*road);
+  }
+  m_nodes.clear();
+  m_root = 0;
+  pack();
+}
+
+void RoadIndex::addSegments(const Road &road) {
+  std::vector<Point2D> points(road.getWaypoints().begin(),
+                              road.getWaypoints().end());
+  if (points.size() < 2) {
+    points = {road.getStart(), road.getEnd()};
+  }
+  double offset = 0.0;
+  for (std::size_t i = 1; i < points.size(); ++i) {
+    m_segments.push_back(Segment{&road, static_cast<std::uint32_t>(i - 1),
+                                 points[i - 1], points[i], offset});
+    offset += points[i - 1].distanceTo(points[i]);
+  }
+}
+
+void RoadIndex::pack() {
+  if (m_segments.empty()) {
+    return;
+  }
+
+  // The leaves, over the segments in their packed order
+  auto boxOfSegment = [](const Segment &segment) {
+    return Box{std::min(segment.start.x, segment.end.x),
+               std::min(segment.start.y, segment.end.y),
+               std::max(segment.start.x, segment.end.x),
+               std::max(segment.start.y, segment.end.y)};
+  };
+  std::vector<std::uint32_t> order(m_segments.size());
+  std::iota(order.begin(), order.end(), 0u);
+  sortTileRecursive(order, [&](std::uint32_t i) {
+    return boxOfSegment(m_segments[i]);
+  });
+  std::vector<Segment> packed;
+  packed.reserve(m_segments.size());
+  for (std::uint32_t i : order) {
+    packed.push_back(m_segments[i]);
+  }
+  m_segments = std::move(packed);
+
+  auto parentOf = [](const auto &items, std::size_t begin, std::size_t end,
+                     std::uint32_t first, bool leaf, auto boxOf) {
+    Node node{boxOf(items[begin]), first,
+              static_cast<std::uint32_t>(end - begin), leaf};
+    for (std::size_t i = begin + 1; i < end; ++i) {
+      const Box box = boxOf(items[i]);
+      node.box.min_x = std::min(node.box.min_x, box.min_x);
+      node.box.min_y = std::min(node.box.min_y, box.min_y);
+      node.box.max_x = std::max(node.box.max_x, box.max_x);
+      node.box.max_y = std::max(node.box.max_y, box.max_y);
+    }
+    return node;
+  };
+  std::vector<Node> level;
+  for (std::size_t begin = 0; begin < m_segments.size();
+       begin += NODE_CAPACITY) {
+    const std::size_t end =
+        std::min(m_segments.size(), begin + NODE_CAPACITY);
+    level.push_back(parentOf(m_segments, begin, end,
+                             static_cast<std::uint32_t>(begin), true,
+                             boxOfSegment));
+  }
+
+  // Each level packed in turn, its nodes stored contiguously
+  auto boxOfNode = [](const Node &node) { return node.box; };
+  while (true) {
+    order.resize(level.size());
+    std::iota(order.begin(), order.end(), 0u);
+    if (level.size() > 1) {
+      sortTileRecursive(order,
+                        [&](std::uint32_t i) { return level[i].box; });
+    }
+    const std::size_t base = m_nodes.size();
+    for (std::uint32_t i : order) {
+      m_nodes.push_back(level[i]);
+    }
+    if (level.size() == 1) {
+      m_root = static_cast<std::uint32_t>(base);
+      break;
+    }
+    std::vector<Node> parents;
+    for (std::size_t begin = base; begin < m_nodes.size();
+         begin += NODE_CAPACITY) {
+      const std::size_t end = std::min(m_nodes.size(), begin + NODE_CAPACITY);
+      parents.push_back(parentOf(m_nodes, begin, end,
+                                 static_cast<std::uint32_t>(begin), false,
+                                 boxOfNode));
+    }
+    level = std::move(parents);
+  }
+}
+
+bool RoadIndex::nearest(const Point2D &position, Match &match,
+                        double max_distance) const {
+  if (m_nodes.empty()) {
+    return false;
+  }
+  double best = max_distance * max_distance;
+  bool found = false;
+  using Entry = std::pair<double, std::uint32_t>;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+  queue.emplace(squaredDistanceTo(m_nodes[m_root].box, position), m_root);
+  while (!queue.empty() && queue.top().first <= best) {
+    const Node &node = m_nodes[queue.top().second];
+    queue.pop();
+    if (!node.leaf) {
+      for (std::uint32_t i = node.first; i < node.first + node.count; ++i) {
+        const double distance = squaredDistanceTo(m_nodes[i].box, position);
+        if (distance <= best) {
+          queue.emplace(distance, i);
+        }
+      }
+      continue;
+    }
+    for (std::uint32_t i = node.first; i < node.first + node.count; ++i) {
+      const Segment &segment = m_segments[i];
+      const Point2D direction = segment.end - segment.start;
+      const double length2 = direction.dot(direction);
+      double t = length2 > 0.0
+                     ? (position - segment.start).dot(direction) / length2
+                     : 0.0;
+      t = std::max(0.0, std::min(1.0, t));
+      const Point2D point = segment.start + direction * t;
+      const Point2D gap = position - point;
+      const double distance = gap.dot(gap);
+      // Ties keep the first segment found
+      if (distance < best || (!found && distance <= best)) {
+        best = distance;
+        found = true;
+        match.segment = &segment;
+        match.point = point;
+        match.distance_along = segment.offset + std::sqrt(length2) * t;
+      }
+    }
+  }
+  if (found) {
+    match.distance = std::sqrt(best);
+  }
+  return found;
+}
+
+std::size_t RoadIndex::query(const Point2D &min_point,
+                             const Point2D &max_point,
+                             std::vector<const Segment *> &segments) const {
+  segments.clear();
+  if (m_nodes.empty()) {
+    return 0;
+  }
+  std::vector<std::uint32_t> stack{m_root};
+  while (!stack.empty()) {
+    const Node &node = m_nodes[stack.back()];
+    stack.pop_back();
+    if (!overlaps(node.box, min_point, max_point)) {
+      continue;
+    }
+    if (!node.leaf) {
+      // Pushed last to first, so that the first child is visited first
+      for (std::uint32_t i = node.first + node.count; i-- > node.first;) {
+        stack.push_back(i);
+      }
+      continue;
+    }
+    for (std::uint32_t i = node.first; i < node.first + node.count; ++i) {
+      const Segment &segment = m_segments[i];
+      const Box box{std::min(segment.start.x, segment.end.x),
+                    std::min(segment.start.y, segment.end.y),
+                    std::max(segment.start.x, segment.end.x),
+                    std::max(segment.start.y, segment.end.y)};
+      if (overlaps(box, min_point, max_point)) {
+        segments.push_back(&segment);
+      }
+    }
+  }
+  return segments.size();
+}
+
+std::vector<const Road *>
+RoadIndex::getRoadsIn(const Point2D &min_point,
+                      const Point2D &max_point) const {
+  std::vector<const Segment *> segments;
+  query(min_point, max_point, segments);
+  std::vector<const Road *> roads;
+  std::unordered_set<const Road *> seen;
+  for (const Segment *segment : segments) {
+    if (seen.insert(segment->road).second) {
+      roads.push_back(segment->road);
+    }
+  }
+  return roads;
+}
+
+} // namespace model
+} // namespace kernel
+} // namespace jamfree
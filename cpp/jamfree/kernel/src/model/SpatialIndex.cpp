@@ -0,0 +1,123 @@
+#include "kernel/include/model/SpatialIndex.h"
+#include "kernel/include/model/Vehicle.h"
+#include <algorithm>
+#include <utility>
+
+namespace jamfree {
+namespace kernel {
+namespace model {
+
+namespace {
+
+// Orders the vehicles by lane position, and a vehicle against a position.
+struct ByPosition {
+  bool operator()(const std::shared_ptr<Vehicle> &v, double position) const {
+    return v->getLanePosition() < position;
+  }
+  bool operator()(double position, const std::shared_ptr<Vehicle> &v) const {
+    return position < v->getLanePosition();
+  }
+};
+
+} // namespace
+
+void SpatialIndex::addVehicle(const std::shared_ptr<Vehicle> &vehicle) {
+  auto it = std::upper_bound(m_vehicles.begin(), m_vehicles.end(),
+                             vehicle->getLanePosition(), ByPosition());
+  m_vehicles.insert(it, vehicle);
+}
+
+void SpatialIndex::removeVehicle(const std::shared_ptr<Vehicle> &vehicle) {
+  // Among the vehicles at its position, unless it moved since the update
+  const auto range =
+      std::equal_range(m_vehicles.begin(), m_vehicles.end(),
+                       vehicle->getLanePosition(), ByPosition());
+  auto it = std::find(range.first, range.second, vehicle);
+  if (it == range.second) {
+    it = std::find(m_vehicles.begin(), m_vehicles.end(), vehicle);
+  }
+  if (it != m_vehicles.end()) {
+    m_vehicles.erase(it);
+  }
+}
+
+void SpatialIndex::removeVehicles(
+    const std::vector<std::shared_ptr<Vehicle>> &vehicles) {
+  if (vehicles.empty()) {
+    return;
+  }
+  std::vector<const Vehicle *> removed;
+  removed.reserve(vehicles.size());
+  for (const auto &vehicle : vehicles) {
+    removed.push_back(vehicle.get());
+  }
+  std::sort(removed.begin(), removed.end());
+  m_vehicles.erase(
+      std::remove_if(m_vehicles.begin(), m_vehicles.end(),
+                     [&removed](const std::shared_ptr<Vehicle> &vehicle) {
+                       return std::binary_search(removed.begin(),
+                                                 removed.end(),
+                                                 vehicle.get());
+                     }),
+      m_vehicles.end());
+}
+
+void SpatialIndex::update() {
+  // Insertion sort, moving each vehicle back past the ones it overtook
+  for (std::size_t i = 1; i < m_vehicles.size(); ++i) {
+    const double position = m_vehicles[i]->getLanePosition();
+    if (!(position < m_vehicles[i - 1]->getLanePosition())) {
+      continue;
+    }
+    auto vehicle = std::move(m_vehicles[i]);
+    std::size_t j = i;
+    for (; j > 0 && position < m_vehicles[j - 1]->getLanePosition(); --j) {
+      m_vehicles[j] = std::move(m_vehicles[j - 1]);
+    }
+    m_vehicles[j] = std::move(vehicle);
+  }
+}
+
+const std::shared_ptr<Vehicle> *SpatialIndex::findAhead(double position) const {
+  auto it = std::upper_bound(m_vehicles.begin(), m_vehicles.end(), position,
+                             ByPosition());
+  return it != m_vehicles.end() ? &*it : nullptr;
+}
+
+const std::shared_ptr<Vehicle> *
+SpatialIndex::findBehind(double position) const {
+  auto it = std::lower_bound(m_vehicles.begin(), m_vehicles.end(), position,
+                             ByPosition());
+  return it != m_vehicles.begin() ? &*(it - 1) : nullptr;
+}
+
+Vehicle *SpatialIndex::findLeader(const Vehicle &vehicle) const {
+  const auto *ahead = findAhead(vehicle.getLanePosition());
+  return ahead ? ahead->get() : nullptr;
+}
+
+Vehicle *SpatialIndex::findFollower(const Vehicle &vehicle) const {
+  const auto *behind = findBehind(vehicle.getLanePosition());
+  return behind ? behind->get() : nullptr;
+}
+
+std::vector<Vehicle *> SpatialIndex::findInRange(double min_pos,
+                                                 double max_pos) const {
+  std::vector<Vehicle *> result;
+
+  // Binary search for range
+  auto it_start = std::lower_bound(m_vehicles.begin(), m_vehicles.end(),
+                                   min_pos, ByPosition());
+  auto it_end =
+      std::upper_bound(it_start, m_vehicles.end(), max_pos, ByPosition());
+
+  for (auto it = it_start; it < it_end; ++it) {
+    result.push_back(it->get());
+  }
+
+  return result;
+}
+
+} // namespace model
+} // namespace kernel
+} // namespace jamfree
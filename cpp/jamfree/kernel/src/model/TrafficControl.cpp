@@ -0,0 +1,206 @@
+#include "kernel/include/model/TrafficControl.h"
+#include "kernel/include/model/Vehicle.h"
+#include <stdexcept>
+
+namespace jamfree {
+namespace kernel {
+namespace model {
+
+int LoopDetector::poll() {
+  int arrivals = 0;
+  const auto upstream = m_upstream.lock();
+  if (upstream && upstream->getCurrentLane() == m_lane &&
+      upstream->getLanePosition() >= m_position) {
+    // The vehicles from the position to the one that was behind it
+    const auto &vehicles = m_lane->getVehicles();
+    const auto first = std::lower_bound(
+        vehicles.begin(), vehicles.end(), m_position,
+        [](const std::shared_ptr<Vehicle> &vehicle, double position) {
+          return vehicle->getLanePosition() < position;
+        });
+    const auto last = std::find(first, vehicles.end(), upstream);
+    if (last != vehicles.end()) {
+      arrivals = static_cast<int>(last - first) + 1;
+    }
+  }
+  m_upstream = m_lane->getVehicleBehind(m_position);
+  m_count += arrivals;
+  return arrivals;
+}
+
+ActuatedTrafficLight::ActuatedTrafficLight(
+    const std::string &id, const Point2D &position,
+    const std::vector<PhaseConfig> &phases, const Timing &timing)
+    : TrafficLight(id, position, phases), m_timing(timing),
+      m_green_end(timing.min_green) {
+  if (!(timing.min_green <= timing.max_green)) {
+    throw std::invalid_argument(
+        "Actuated traffic light: the minimum green is above the maximum");
+  }
+}
+
+bool ActuatedTrafficLight::pollDetectors() {
+  int arrivals = 0;
+  for (auto &detector : m_detectors) {
+    arrivals += detector.poll();
+  }
+  if (arrivals == 0 || getCurrentPhase() != LightPhase::GREEN) {
+    return false;
+  }
+  m_pending += arrivals;
+  return true;
+}
+
+double ActuatedTrafficLight::getPhaseDuration() const {
+  return getCurrentPhase() == LightPhase::GREEN
+             ? m_green_end
+             : m_phases[m_current_phase].duration;
+}
+
+void ActuatedTrafficLight::update(double dt) {
+  m_phase_time += dt;
+  // The vehicles detected now hold the green for the extension
+  if (m_pending > 0 && getCurrentPhase() == LightPhase::GREEN) {
+    m_green_end =
+        std::min(m_timing.max_green,
+                 std::max(m_green_end, m_phase_time + m_timing.extension));
+  }
+  m_pending = 0;
+  if (m_phase_time >= getPhaseDuration()) {
+    m_phase_time = 0.0;
+    m_current_phase = (m_current_phase + 1) % m_phases.size();
+    m_green_end = m_timing.min_green;
+  }
+}
+
+double ActuatedTrafficLight::getTimeToNextChange() const {
+  return std::max(0.0, getPhaseDuration() - m_phase_time);
+}
+
+TrafficControlManager::TrafficControlManager(double cell_size)
+    : m_cell_size(cell_size) {
+  if (!(cell_size > 0.0)) {
+    throw std::invalid_argument(
+        "Traffic control manager: the cell size must be positive");
+  }
+}
+
+void TrafficControlManager::addControl(
+    std::shared_ptr<TrafficControl> control) {
+  const Point2D &position = control->getPosition();
+  m_grid[cellKey(cellOf(position.x), cellOf(position.y))].push_back(control);
+  auto entry = std::make_shared<Entry>();
+  entry->control = control;
+  entry->last_update = m_time;
+  m_controls.push_back(std::move(control));
+  m_entries.push_back(entry);
+  if (entry->control->hasDetectors()) {
+    m_detecting.push_back(entry);
+  }
+  schedule(entry);
+}
+
+void TrafficControlManager::removeControl(const std::string &id) {
+  const auto matches = [&id](const auto &control) {
+    return control->getId() == id;
+  };
+  for (auto &entry : m_entries) {
+    entry->removed = entry->removed || matches(entry->control);
+  }
+  const auto removed = [](const std::shared_ptr<Entry> &entry) {
+    return entry->removed;
+  };
+  m_entries.erase(
+      std::remove_if(m_entries.begin(), m_entries.end(), removed),
+      m_entries.end());
+  m_detecting.erase(
+      std::remove_if(m_detecting.begin(), m_detecting.end(), removed),
+      m_detecting.end());
+  m_controls.erase(
+      std::remove_if(m_controls.begin(), m_controls.end(), matches),
+      m_controls.end());
+  for (auto cell = m_grid.begin(); cell != m_grid.end();) {
+    auto &controls = cell->second;
+    controls.erase(std::remove_if(controls.begin(), controls.end(), matches),
+                   controls.end());
+    cell = controls.empty() ? m_grid.erase(cell) : std::next(cell);
+  }
+}
+
+void TrafficControlManager::reschedule(const std::string &id) {
+  for (const auto &entry : m_entries) {
+    if (entry->control->getId() == id) {
+      entry->last_update = m_time;
+      schedule(entry);
+    }
+  }
+}
+
+std::vector<std::shared_ptr<TrafficControl>>
+TrafficControlManager::getControlsNear(const Point2D &position,
+                                       double radius) const {
+  std::vector<std::shared_ptr<TrafficControl>> result;
+  forEachControlNear(position, radius,
+                     [&result](const std::shared_ptr<TrafficControl> &control) {
+                       result.push_back(control);
+                       return true;
+                     });
+  return result;
+}
+
+bool TrafficControlManager::shouldStopForControl(
+    const Point2D &vehicle_position, double vehicle_speed,
+    double look_ahead_distance) const {
+  return !forEachControlNear(
+      vehicle_position, look_ahead_distance,
+      [&](const std::shared_ptr<TrafficControl> &control) {
+        return !control->shouldStop(vehicle_position, vehicle_speed);
+      });
+}
+
+void TrafficControlManager::schedule(const std::shared_ptr<Entry> &entry) {
+  // A later event replaces the one pending, left in the queue
+  ++entry->version;
+  const double delay = entry->control->getTimeToNextChange();
+  if (delay < std::numeric_limits<double>::infinity()) {
+    m_events.push(Event{m_time + delay, entry->version, entry});
+  }
+}
+
+void TrafficControlManager::updateEntry(Entry &entry) {
+  entry.control->update(m_time - entry.last_update);
+  entry.last_update = m_time;
+  ++m_num_updated;
+}
+
+void TrafficControlManager::update(double dt) {
+  m_time += dt;
+  m_num_updated = 0;
+
+  // The detector events first, as the detections of the step
+  for (const auto &entry : m_detecting) {
+    if (entry->control->pollDetectors()) {
+      updateEntry(*entry);
+      schedule(entry);
+    }
+  }
+
+  // Then the changes due; rescheduled once all are taken, so that a
+  // control due again at once waits for the next step
+  while (!m_events.empty() && m_events.top().time <= m_time) {
+    const Event event = m_events.top();
+    m_events.pop();
+    if (!event.entry->removed && event.version == event.entry->version) {
+      m_due.push_back(event.entry);
+    }
+  }
+  for (const auto &entry : m_due) {
+    updateEntry(*entry);
+    schedule(entry);
+  }
+  m_due.clear();
+}
+
+} // namespace model
+} // namespace kernel
+} // namespace jamfree
@@ -0,0 +1,355 @@
+#include "kernel/include/model/VehicleFrameCodec.h"
+#include "kernel/include/model/VehicleStateExport.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#ifdef JAMFREE_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+namespace jamfree {
+namespace kernel {
+namespace model {
+
+namespace {
+
+constexpr std::uint8_t VERSION = 1;
+constexpr std::uint8_t KEY_FRAME = 1;
+constexpr std::uint8_t DEFLATED = 2;
+
+// The columns of a frame, in the order of the payload
+enum FrameColumn : std::size_t {
+  FRAME_X,
+  FRAME_Y,
+  FRAME_SPEED,
+  FRAME_HEADING,
+  FRAME_LANE,
+  NUM_FRAME_COLUMNS
+};
+
+// Steps of a turn of the quantized heading
+constexpr std::int64_t HEADING_STEPS = 65536;
+constexpr double TWO_PI = 6.283185307179586;
+
+// Largest payload a frame may announce, inflated
+constexpr std::uint64_t MAX_PAYLOAD_SIZE = 1ull << 32;
+
+[[noreturn]] void malformed() {
+  throw std::runtime_error("Malformed vehicle frame");
+}
+
+void writeVarint(std::vector<std::uint8_t> &out, std::uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<std::uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<std::uint8_t>(value));
+}
+
+void writeSignedVarint(std::vector<std::uint8_t> &out, std::int64_t value) {
+  writeVarint(out, (static_cast<std::uint64_t>(value) << 1) ^
+                       static_cast<std::uint64_t>(value >> 63));
+}
+
+template <typename Bits>
+void writeBits(std::vector<std::uint8_t> &out, Bits bits) {
+  for (std::size_t i = 0; i < sizeof(Bits); ++i) {
+    out.push_back(static_cast<std::uint8_t>(bits >> (8 * i)));
+  }
+}
+
+void writeDouble(std::vector<std::uint8_t> &out, double value) {
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  writeBits(out, bits);
+}
+
+void writeFloat(std::vector<std::uint8_t> &out, float value) {
+  std::uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  writeBits(out, bits);
+}
+
+/**
+ * Reader of the fields of a frame, in place.
+ */
+class FrameReader {
+public:
+  FrameReader(const std::uint8_t *data, std::size_t size)
+      : m_pos(data), m_end(data + size) {}
+
+  const std::uint8_t *position() const { return m_pos; }
+  std::size_t remaining() const {
+    return static_cast<std::size_t>(m_end - m_pos);
+  }
+
+  std::uint8_t byte() {
+    if (m_pos >= m_end) {
+      malformed();
+    }
+    return *m_pos++;
+  }
+
+  std::uint64_t varint() {
+    std::uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      const std::uint8_t next = byte();
+      value |= static_cast<std::uint64_t>(next & 0x7f) << shift;
+      if (!(next & 0x80)) {
+        return value;
+      }
+    }
+    malformed();
+  }
+
+  std::int64_t svarint() {
+    const std::uint64_t value = varint();
+    return static_cast<std::int64_t>(value >> 1) ^
+           -static_cast<std::int64_t>(value & 1);
+  }
+
+  template <typename Bits> Bits bits() {
+    Bits value = 0;
+    for (std::size_t i = 0; i < sizeof(Bits); ++i) {
+      value |= static_cast<Bits>(byte()) << (8 * i);
+    }
+    return value;
+  }
+
+  double float64() {
+    const std::uint64_t value = bits<std::uint64_t>();
+    double result;
+    std::memcpy(&result, &value, sizeof(result));
+    return result;
+  }
+
+  float float32() {
+    const std::uint32_t value = bits<std::uint32_t>();
+    float result;
+    std::memcpy(&result, &value, sizeof(result));
+    return result;
+  }
+
+private:
+  const std::uint8_t *m_pos;
+  const std::uint8_t *m_end;
+};
+
+// The quantized value of a coordinate, clamped to the bounds
+std::int64_t quantize(double value, double origin, double resolution,
+                      std::int64_t max) {
+  if (!std::isfinite(value)) {
+    return 0;
+  }
+  const double steps = std::round((value - origin) / resolution);
+  return static_cast<std::int64_t>(
+      std::max(0.0, std::min(static_cast<double>(max), steps)));
+}
+
+// The difference of two headings, the shortest way round
+std::int64_t headingDelta(std::int64_t heading, std::int64_t previous) {
+  return ((heading - previous + HEADING_STEPS / 2) & (HEADING_STEPS - 1)) -
+         HEADING_STEPS / 2;
+}
+
+} // namespace
+
+VehicleFrameEncoder::VehicleFrameEncoder(const FrameBounds &bounds)
+    : VehicleFrameEncoder(bounds, Config()) {}
+
+VehicleFrameEncoder::VehicleFrameEncoder(const FrameBounds &bounds,
+                                         const Config &config)
+    : m_bounds(bounds), m_config(config) {
+  if (!(config.position_resolution > 0.0) ||
+      !(config.speed_resolution > 0.0)) {
+    throw std::invalid_argument(
+        "Vehicle frame encoder: the resolutions must be positive");
+  }
+  if (config.keyframe_interval == 0) {
+    throw std::invalid_argument(
+        "Vehicle frame encoder: the key frame interval must be positive");
+  }
+}
+
+void VehicleFrameEncoder::encode(const double *rows, std::size_t num_vehicles,
+                                 std::vector<std::uint8_t> &frame) {
+  const bool key = m_key_requested ||
+                   m_frame_number % m_config.keyframe_interval == 0;
+  m_key_requested = false;
+
+  // Quantize, column after column
+  const double resolution = m_config.position_resolution;
+  const std::int64_t max_x = static_cast<std::int64_t>(
+      std::ceil((m_bounds.max_x - m_bounds.min_x) / resolution));
+  const std::int64_t max_y = static_cast<std::int64_t>(
+      std::ceil((m_bounds.max_y - m_bounds.min_y) / resolution));
+  const std::int64_t max_speed =
+      std::numeric_limits<std::int32_t>::max();
+  m_current.resize(num_vehicles * NUM_FRAME_COLUMNS);
+  std::int64_t *x = m_current.data() + FRAME_X * num_vehicles;
+  std::int64_t *y = m_current.data() + FRAME_Y * num_vehicles;
+  std::int64_t *speed = m_current.data() + FRAME_SPEED * num_vehicles;
+  std::int64_t *heading = m_current.data() + FRAME_HEADING * num_vehicles;
+  std::int64_t *lane = m_current.data() + FRAME_LANE * num_vehicles;
+  for (std::size_t i = 0; i < num_vehicles; ++i) {
+    const double *row = rows + i * NUM_STATE_COLUMNS;
+    x[i] = quantize(row[STATE_X], m_bounds.min_x, resolution, max_x);
+    y[i] = quantize(row[STATE_Y], m_bounds.min_y, resolution, max_y);
+    speed[i] =
+        quantize(row[STATE_SPEED], 0.0, m_config.speed_resolution, max_speed);
+    double angle = std::isfinite(row[STATE_HEADING])
+                       ? std::fmod(row[STATE_HEADING], TWO_PI)
+                       : 0.0;
+    if (angle < 0.0) {
+      angle += TWO_PI;
+    }
+    heading[i] = static_cast<std::int64_t>(std::llround(
+                     angle / TWO_PI * HEADING_STEPS)) &
+                 (HEADING_STEPS - 1);
+    lane[i] = std::isfinite(row[STATE_LANE_INDEX])
+                  ? std::llround(row[STATE_LANE_INDEX])
+                  : -1;
+  }
+
+  // The differences with the same rows of the previous frame
+  const std::size_t previous_count =
+      key ? 0 : m_previous.size() / NUM_FRAME_COLUMNS;
+  m_payload.clear();
+  for (std::size_t column = 0; column < NUM_FRAME_COLUMNS; ++column) {
+    const std::int64_t *values = m_current.data() + column * num_vehicles;
+    const std::int64_t *previous = m_previous.data() + column * previous_count;
+    for (std::size_t i = 0; i < num_vehicles; ++i) {
+      const std::int64_t before = i < previous_count ? previous[i] : 0;
+      writeSignedVarint(m_payload, column == FRAME_HEADING
+                                       ? headingDelta(values[i], before)
+                                       : values[i] - before);
+    }
+  }
+  m_previous.swap(m_current);
+
+  std::uint8_t flags = key ? KEY_FRAME : 0;
+#ifdef JAMFREE_HAS_ZLIB
+  std::vector<std::uint8_t> deflated;
+  if (m_config.compress) {
+    uLongf length = compressBound(static_cast<uLong>(m_payload.size()));
+    deflated.resize(length);
+    if (compress2(deflated.data(), &length, m_payload.data(),
+                  static_cast<uLong>(m_payload.size()),
+                  Z_BEST_SPEED) == Z_OK) {
+      deflated.resize(length);
+      flags |= DEFLATED;
+    }
+  }
+#endif
+
+  frame.clear();
+  frame.push_back('J');
+  frame.push_back('F');
+  frame.push_back(VERSION);
+  frame.push_back(flags);
+  writeVarint(frame, m_frame_number++);
+  writeVarint(frame, num_vehicles);
+  writeDouble(frame, m_bounds.min_x);
+  writeDouble(frame, m_bounds.min_y);
+  writeFloat(frame, static_cast<float>(resolution));
+  writeFloat(frame, static_cast<float>(m_config.speed_resolution));
+#ifdef JAMFREE_HAS_ZLIB
+  if (flags & DEFLATED) {
+    writeVarint(frame, m_payload.size());
+    frame.insert(frame.end(), deflated.begin(), deflated.end());
+    return;
+  }
+#endif
+  frame.insert(frame.end(), m_payload.begin(), m_payload.end());
+}
+
+bool VehicleFrameDecoder::decode(const std::uint8_t *data, std::size_t size,
+                                 std::vector<double> &rows) {
+  FrameReader reader(data, size);
+  if (reader.byte() != 'J' || reader.byte() != 'F' ||
+      reader.byte() != VERSION) {
+    malformed();
+  }
+  const std::uint8_t flags = reader.byte();
+  const bool key = flags & KEY_FRAME;
+  const std::uint64_t frame_number = reader.varint();
+  const std::uint64_t num_vehicles = reader.varint();
+  const double min_x = reader.float64();
+  const double min_y = reader.float64();
+  const double resolution = reader.float32();
+  const double speed_resolution = reader.float32();
+  if (!key && (!m_has_frame || frame_number != m_frame_number + 1)) {
+    return false;
+  }
+
+  const std::uint8_t *payload = reader.position();
+  std::size_t payload_size = reader.remaining();
+  if (flags & DEFLATED) {
+    const std::uint64_t inflated_size = reader.varint();
+    if (inflated_size > MAX_PAYLOAD_SIZE) {
+      malformed();
+    }
+#ifdef JAMFREE_HAS_ZLIB
+    m_payload.resize(static_cast<std::size_t>(inflated_size));
+    uLongf length = static_cast<uLongf>(inflated_size);
+    if (uncompress(m_payload.data(), &length, reader.position(),
+                   static_cast<uLong>(reader.remaining())) != Z_OK ||
+        length != inflated_size) {
+      malformed();
+    }
+    payload = m_payload.data();
+    payload_size = m_payload.size();
+#else
+    throw std::runtime_error(
+        "Cannot inflate vehicle frame: JamFree was built without zlib");
+#endif
+  }
+  // A difference takes a byte at least
+  if (num_vehicles > payload_size / NUM_FRAME_COLUMNS) {
+    malformed();
+  }
+
+  const std::size_t count = static_cast<std::size_t>(num_vehicles);
+  const std::size_t previous_count =
+      key ? 0 : m_previous.size() / NUM_FRAME_COLUMNS;
+  FrameReader values(payload, payload_size);
+  m_current.resize(count * NUM_FRAME_COLUMNS);
+  for (std::size_t column = 0; column < NUM_FRAME_COLUMNS; ++column) {
+    std::int64_t *current = m_current.data() + column * count;
+    const std::int64_t *previous = m_previous.data() + column * previous_count;
+    for (std::size_t i = 0; i < count; ++i) {
+      const std::int64_t before = i < previous_count ? previous[i] : 0;
+      current[i] = before + values.svarint();
+      if (column == FRAME_HEADING) {
+        current[i] &= HEADING_STEPS - 1;
+      }
+    }
+  }
+  m_previous.swap(m_current);
+  m_has_frame = true;
+  m_frame_number = frame_number;
+
+  const double none = std::numeric_limits<double>::quiet_NaN();
+  rows.resize(count * NUM_STATE_COLUMNS);
+  for (std::size_t i = 0; i < count; ++i) {
+    double *row = rows.data() + i * NUM_STATE_COLUMNS;
+    row[STATE_VEHICLE_INDEX] = static_cast<double>(i);
+    row[STATE_LANE_INDEX] =
+        static_cast<double>(m_previous[FRAME_LANE * count + i]);
+    row[STATE_LANE_POSITION] = none;
+    row[STATE_X] = min_x + resolution * m_previous[FRAME_X * count + i];
+    row[STATE_Y] = min_y + resolution * m_previous[FRAME_Y * count + i];
+    row[STATE_SPEED] =
+        speed_resolution * m_previous[FRAME_SPEED * count + i];
+    row[STATE_ACCELERATION] = none;
+    row[STATE_HEADING] = TWO_PI / HEADING_STEPS *
+                         m_previous[FRAME_HEADING * count + i];
+  }
+  return true;
+}
+
+} // namespace model
+} // namespace kernel
+} // namespace jamfree
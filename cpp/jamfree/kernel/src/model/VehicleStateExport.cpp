@@ -0,0 +1,36 @@
+#include "kernel/include/model/VehicleStateExport.h"
+#include "kernel/include/model/Vehicle.h"
+#include <algorithm>
+
+namespace jamfree {
+namespace kernel {
+namespace model {
+
+void writeVehicleState(const Vehicle &vehicle, std::size_t index,
+                       double *row) {
+  const Lane *lane = vehicle.getLane();
+  row[STATE_VEHICLE_INDEX] = static_cast<double>(index);
+  row[STATE_LANE_INDEX] = lane ? lane->getIndex() : -1.0;
+  row[STATE_LANE_POSITION] = vehicle.getLanePosition();
+  row[STATE_X] = vehicle.getPosition().x;
+  row[STATE_Y] = vehicle.getPosition().y;
+  row[STATE_SPEED] = vehicle.getSpeed();
+  row[STATE_ACCELERATION] = vehicle.getAcceleration();
+  row[STATE_HEADING] = vehicle.getHeading();
+}
+
+std::size_t
+exportVehicleStates(const std::vector<std::shared_ptr<Vehicle>> &vehicles,
+                    double *rows, std::size_t capacity,
+                    std::size_t first_index) {
+  const std::size_t count = std::min(vehicles.size(), capacity);
+  for (std::size_t i = 0; i < count; ++i) {
+    writeVehicleState(*vehicles[i], first_index + i,
+                      rows + i * NUM_STATE_COLUMNS);
+  }
+  return vehicles.size();
+}
+
+} // namespace model
+} // namespace kernel
+} // namespace jamfree
@@ -0,0 +1,182 @@
+#include "kernel/include/model/ViewportFilter.h"
+#include "kernel/include/model/Lane.h"
+#include "kernel/include/model/Road.h"
+#include "kernel/include/model/Vehicle.h"
+#include "kernel/include/model/VehicleStateExport.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace jamfree {
+namespace kernel {
+namespace model {
+
+namespace {
+
+bool overlaps(double min_x, double min_y, double max_x, double max_y,
+              const Viewport &area) {
+  return min_x <= area.max_x && max_x >= area.min_x && min_y <= area.max_y &&
+         max_y >= area.min_y;
+}
+
+} // namespace
+
+ViewportFilter::ViewportFilter(const std::vector<std::shared_ptr<Road>> &roads)
+    : ViewportFilter(roads, Config()) {}
+
+ViewportFilter::ViewportFilter(const std::vector<std::shared_ptr<Road>> &roads,
+                               const Config &config)
+    : m_config(config) {
+  if (!(config.tile_size > 0.0) || config.max_tiles == 0) {
+    throw std::invalid_argument(
+        "Viewport filter: the tile size and the most tiles must be positive");
+  }
+  if (!(config.margin >= 0.0)) {
+    throw std::invalid_argument(
+        "Viewport filter: the margin must not be negative");
+  }
+
+  std::vector<Point2D> points;
+  for (const auto &road : roads) {
+    points.assign(road->getWaypoints().begin(), road->getWaypoints().end());
+    if (points.size() < 2) {
+      points = {road->getStart(), road->getEnd()};
+    }
+    // The lanes lie on the right of the centerline
+    const double width = road->getNumLanes() * road->getLaneWidth();
+    RoadEntry entry{road, m_segments.size(), m_segments.size(),
+                    points[0].x, points[0].y, points[0].x, points[0].y};
+    double distance = 0.0;
+    for (std::size_t i = 1; i < points.size(); ++i) {
+      const Point2D &from = points[i - 1];
+      const Point2D &to = points[i];
+      const double length = from.distanceTo(to);
+      Segment segment{distance, distance + length,
+                      std::min(from.x, to.x) - width,
+                      std::min(from.y, to.y) - width,
+                      std::max(from.x, to.x) + width,
+                      std::max(from.y, to.y) + width};
+      entry.min_x = std::min(entry.min_x, segment.min_x);
+      entry.min_y = std::min(entry.min_y, segment.min_y);
+      entry.max_x = std::max(entry.max_x, segment.max_x);
+      entry.max_y = std::max(entry.max_y, segment.max_y);
+      m_segments.push_back(segment);
+      distance += length;
+    }
+    entry.end_segment = m_segments.size();
+    m_roads.push_back(std::move(entry));
+  }
+}
+
+template <typename Visitor>
+void ViewportFilter::forEachVisible(const Viewport &viewport,
+                                    Visitor visit) const {
+  Viewport area = viewport;
+  area.min_x -= m_config.margin;
+  area.min_y -= m_config.margin;
+  area.max_x += m_config.margin;
+  area.max_y += m_config.margin;
+  for (const RoadEntry &entry : m_roads) {
+    if (!overlaps(entry.min_x, entry.min_y, entry.max_x, entry.max_y,
+                  area)) {
+      continue;
+    }
+    // The distances along the road its segments in the viewport span
+    double begin = INFINITY;
+    double end = -INFINITY;
+    for (std::size_t i = entry.first_segment; i < entry.end_segment; ++i) {
+      const Segment &segment = m_segments[i];
+      if (overlaps(segment.min_x, segment.min_y, segment.max_x,
+                   segment.max_y, area)) {
+        begin = std::min(begin, segment.begin);
+        end = std::max(end, segment.end);
+      }
+    }
+    if (begin > end) {
+      continue;
+    }
+    // A vehicle whose rear is before the span may still reach into it
+    begin -= m_config.margin;
+    for (const auto &lane : entry.road->getLanes()) {
+      const auto &vehicles = lane->getVehicles();
+      auto it = std::lower_bound(
+          vehicles.begin(), vehicles.end(), begin,
+          [](const std::shared_ptr<Vehicle> &vehicle, double position) {
+            return vehicle->getLanePosition() < position;
+          });
+      for (; it != vehicles.end() && (*it)->getLanePosition() <= end; ++it) {
+        const Point2D &position = (*it)->getPosition();
+        if (position.x >= area.min_x && position.x <= area.max_x &&
+            position.y >= area.min_y && position.y <= area.max_y) {
+          visit(**it);
+        }
+      }
+    }
+  }
+}
+
+std::size_t ViewportFilter::exportVisibleStates(const Viewport &viewport,
+                                                double *rows,
+                                                std::size_t capacity) const {
+  std::size_t count = 0;
+  forEachVisible(viewport, [&](const Vehicle &vehicle) {
+    if (count < capacity) {
+      writeVehicleState(vehicle, count, rows + count * NUM_STATE_COLUMNS);
+    }
+    ++count;
+  });
+  return count;
+}
+
+double ViewportFilter::getTileSize(const Viewport &viewport) const {
+  return m_config.tile_size *
+         std::exp2(m_config.detail_zoom - 1.0 - viewport.zoom);
+}
+
+void ViewportFilter::exportDensityTiles(const Viewport &viewport,
+                                        DensityTiles &tiles) const {
+  double size = getTileSize(viewport);
+  const double width = std::max(0.0, viewport.max_x - viewport.min_x);
+  const double height = std::max(0.0, viewport.max_y - viewport.min_y);
+  // Tiles twice as wide until they are few enough, with one more along
+  // each axis for the alignment
+  while ((std::floor(width / size) + 2.0) * (std::floor(height / size) + 2.0) >
+         static_cast<double>(m_config.max_tiles)) {
+    size *= 2.0;
+  }
+  tiles.tile_size = size;
+  tiles.origin_x = std::floor(viewport.min_x / size) * size;
+  tiles.origin_y = std::floor(viewport.min_y / size) * size;
+  tiles.columns = static_cast<std::size_t>(
+      std::floor((viewport.min_x + width - tiles.origin_x) / size)) + 1;
+  tiles.rows = static_cast<std::size_t>(
+      std::floor((viewport.min_y + height - tiles.origin_y) / size)) + 1;
+  tiles.counts.assign(tiles.columns * tiles.rows, 0);
+  tiles.mean_speeds.assign(tiles.columns * tiles.rows, 0.0f);
+
+  const double inverse = 1.0 / size;
+  forEachVisible(viewport, [&](const Vehicle &vehicle) {
+    // The margin is for the vehicles drawn, not for the tiles
+    const Point2D &position = vehicle.getPosition();
+    const double column = std::floor((position.x - tiles.origin_x) * inverse);
+    const double row = std::floor((position.y - tiles.origin_y) * inverse);
+    if (column < 0.0 || row < 0.0 ||
+        column >= static_cast<double>(tiles.columns) ||
+        row >= static_cast<double>(tiles.rows)) {
+      return;
+    }
+    const std::size_t tile = static_cast<std::size_t>(row) * tiles.columns +
+                             static_cast<std::size_t>(column);
+    ++tiles.counts[tile];
+    tiles.mean_speeds[tile] += static_cast<float>(vehicle.getSpeed());
+  });
+  for (std::size_t i = 0; i < tiles.counts.size(); ++i) {
+    if (tiles.counts[i] > 0) {
+      tiles.mean_speeds[i] /= static_cast<float>(tiles.counts[i]);
+    }
+  }
+}
+
+} // namespace model
+} // namespace kernel
+} // namespace jamfree
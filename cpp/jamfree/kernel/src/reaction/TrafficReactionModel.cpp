@@ -88,7 +88,7 @@ void TrafficReactionModel::applyInfluences(
                       microscopic::agents::VehiclePublicLocalStateMicro>(
                       target);
                   if (pls) {
-                    std::string vehicleId = pls->getOwnerId();
+                    const std::string &vehicleId = pls->getOwnerId();
                     std::shared_ptr<model::Vehicle> vehicleToMove = nullptr;
 
                     // Find vehicle in current lane
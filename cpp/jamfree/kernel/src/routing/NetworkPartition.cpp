@@ -0,0 +1,493 @@
+#include "../../include/routing/NetworkPartition.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+
+namespace jamfree {
+namespace kernel {
+namespace routing {
+
+namespace {
+
+constexpr std::uint32_t NONE = RoadGraph::NONE;
+
+// Tries of the greedy graph growing, from seeds spread over the nodes
+constexpr std::size_t GROWING_TRIES = 4;
+
+// Coarsening stops when it merges fewer nodes than this fraction
+constexpr double MIN_COARSENING = 0.95;
+
+// An adjacency of an undirected graph, in both directions
+struct Link {
+  std::uint32_t from;
+  std::uint32_t to;
+  double cost;
+};
+
+// Undirected graph in compressed sparse row form: the neighbours of v are
+// adjacent[first[v] .. first[v + 1]), each with the cost of cutting it
+struct WeightedGraph {
+  std::vector<std::uint32_t> first;
+  std::vector<std::uint32_t> adjacent;
+  std::vector<double> costs;
+  std::vector<double> weights;
+
+  std::size_t size() const { return weights.size(); }
+
+  double totalWeight() const {
+    double total = 0.0;
+    for (double weight : weights) {
+      total += weight;
+    }
+    return total;
+  }
+};
+
+// Builds a graph from links given in both directions, merging the links
+// between the same nodes
+WeightedGraph buildGraph(std::vector<double> weights, std::vector<Link> links) {
+  std::sort(links.begin(), links.end(), [](const Link &a, const Link &b) {
+    return a.from != b.from ? a.from < b.from : a.to < b.to;
+  });
+  WeightedGraph graph;
+  graph.weights = std::move(weights);
+  graph.first.assign(graph.weights.size() + 1, 0);
+  for (std::size_t i = 0; i < links.size(); ++i) {
+    const Link &link = links[i];
+    if (!graph.adjacent.empty() && i > 0 && links[i - 1].from == link.from &&
+        links[i - 1].to == link.to) {
+      graph.costs.back() += link.cost;
+      continue;
+    }
+    graph.adjacent.push_back(link.to);
+    graph.costs.push_back(link.cost);
+    ++graph.first[link.from + 1];
+  }
+  for (std::size_t v = 0; v < graph.weights.size(); ++v) {
+    graph.first[v + 1] += graph.first[v];
+  }
+  return graph;
+}
+
+// Merges pairs of neighbours joined by their costliest link, the merged
+// node weighing at most max_weight, and sets coarse_of to the node of
+// each node in the coarse graph
+WeightedGraph coarsen(const WeightedGraph &graph, double max_weight,
+                      std::vector<std::uint32_t> &coarse_of) {
+  const std::size_t n = graph.size();
+  // The nodes with few neighbours first, which have few choices
+  std::vector<std::uint32_t> order(n);
+  for (std::uint32_t v = 0; v < n; ++v) {
+    order[v] = v;
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&](std::uint32_t a, std::uint32_t b) {
+                     return graph.first[a + 1] - graph.first[a] <
+                            graph.first[b + 1] - graph.first[b];
+                   });
+
+  coarse_of.assign(n, NONE);
+  std::vector<double> weights;
+  for (std::uint32_t u : order) {
+    if (coarse_of[u] != NONE) {
+      continue;
+    }
+    std::uint32_t mate = NONE;
+    double best = -1.0;
+    for (std::uint32_t i = graph.first[u]; i < graph.first[u + 1]; ++i) {
+      const std::uint32_t v = graph.adjacent[i];
+      if (coarse_of[v] == NONE && v != u && graph.costs[i] > best &&
+          graph.weights[u] + graph.weights[v] <= max_weight) {
+        best = graph.costs[i];
+        mate = v;
+      }
+    }
+    const auto coarse = static_cast<std::uint32_t>(weights.size());
+    coarse_of[u] = coarse;
+    weights.push_back(graph.weights[u]);
+    if (mate != NONE) {
+      coarse_of[mate] = coarse;
+      weights.back() += graph.weights[mate];
+    }
+  }
+
+  std::vector<Link> links;
+  links.reserve(graph.adjacent.size());
+  for (std::uint32_t u = 0; u < n; ++u) {
+    for (std::uint32_t i = graph.first[u]; i < graph.first[u + 1]; ++i) {
+      const std::uint32_t from = coarse_of[u];
+      const std::uint32_t to = coarse_of[graph.adjacent[i]];
+      if (from != to) {
+        links.push_back({from, to, graph.costs[i]});
+      }
+    }
+  }
+  return buildGraph(std::move(weights), std::move(links));
+}
+
+// Cost of the links of v to the other side less the cost of its links to
+// its side: what moving v to the other side saves
+double gainOf(const WeightedGraph &graph, const std::vector<std::uint8_t> &side,
+              std::uint32_t v) {
+  double gain = 0.0;
+  for (std::uint32_t i = graph.first[v]; i < graph.first[v + 1]; ++i) {
+    gain += side[graph.adjacent[i]] != side[v] ? graph.costs[i]
+                                               : -graph.costs[i];
+  }
+  return gain;
+}
+
+bool isBoundary(const WeightedGraph &graph,
+                const std::vector<std::uint8_t> &side, std::uint32_t v) {
+  for (std::uint32_t i = graph.first[v]; i < graph.first[v + 1]; ++i) {
+    if (side[graph.adjacent[i]] != side[v]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+double cutCost(const WeightedGraph &graph,
+               const std::vector<std::uint8_t> &side) {
+  double cost = 0.0;
+  for (std::uint32_t v = 0; v < graph.size(); ++v) {
+    for (std::uint32_t i = graph.first[v]; i < graph.first[v + 1]; ++i) {
+      if (side[graph.adjacent[i]] != side[v]) {
+        cost += graph.costs[i];
+      }
+    }
+  }
+  return cost / 2.0;
+}
+
+// The bounds of the weights of the sides of a bisection
+struct Balance {
+  double target[2];
+  double limit[2];
+
+  Balance(const WeightedGraph &graph, double fraction, double imbalance) {
+    const double total = graph.totalWeight();
+    double heaviest = 0.0;
+    for (double weight : graph.weights) {
+      heaviest = std::max(heaviest, weight);
+    }
+    target[0] = total * fraction;
+    target[1] = total - target[0];
+    for (int s = 0; s < 2; ++s) {
+      // A coarse node may not fit the tolerance, the finer levels do
+      limit[s] = std::max(target[s] * imbalance, target[s] + heaviest);
+    }
+  }
+};
+
+// Moves the nodes of the boundary saving cut cost, Fiduccia-Mattheyses
+// fashion without the uphill moves, then moves the nodes of an overweight
+// side until it fits its limit
+void refine(const WeightedGraph &graph, std::vector<std::uint8_t> &side,
+            const Balance &balance, int passes) {
+  double weights[2] = {0.0, 0.0};
+  for (std::uint32_t v = 0; v < graph.size(); ++v) {
+    weights[side[v]] += graph.weights[v];
+  }
+  std::vector<std::pair<double, std::uint32_t>> candidates;
+  auto collect = [&](int only_side) {
+    candidates.clear();
+    for (std::uint32_t v = 0; v < graph.size(); ++v) {
+      if ((only_side < 0 || side[v] == only_side) &&
+          isBoundary(graph, side, v)) {
+        candidates.emplace_back(gainOf(graph, side, v), v);
+      }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const auto &a, const auto &b) {
+                return a.first != b.first ? a.first > b.first
+                                          : a.second < b.second;
+              });
+  };
+  auto move = [&](std::uint32_t v) {
+    weights[side[v]] -= graph.weights[v];
+    side[v] ^= 1;
+    weights[side[v]] += graph.weights[v];
+  };
+
+  for (int pass = 0; pass < passes; ++pass) {
+    std::size_t moved = 0;
+    collect(-1);
+    for (const auto &candidate : candidates) {
+      const std::uint32_t v = candidate.second;
+      const int from = side[v];
+      const int to = from ^ 1;
+      const double gain = gainOf(graph, side, v);
+      if (weights[to] + graph.weights[v] > balance.limit[to]) {
+        continue;
+      }
+      // A move saving nothing is kept when it evens the sides
+      const bool evens = std::abs(weights[to] + graph.weights[v] -
+                                  balance.target[to]) <
+                         std::abs(weights[to] - balance.target[to]);
+      if (gain > 0.0 || (gain == 0.0 && evens)) {
+        move(v);
+        ++moved;
+      }
+    }
+    if (moved == 0) {
+      break;
+    }
+  }
+
+  for (int from = 0; from < 2; ++from) {
+    if (weights[from] <= balance.limit[from]) {
+      continue;
+    }
+    const int to = from ^ 1;
+    collect(from);
+    if (candidates.empty()) {
+      // A side without boundary, in a disconnected graph
+      for (std::uint32_t v = 0; v < graph.size(); ++v) {
+        if (side[v] == from) {
+          candidates.emplace_back(0.0, v);
+        }
+      }
+    }
+    for (const auto &candidate : candidates) {
+      if (weights[from] <= balance.limit[from]) {
+        break;
+      }
+      const std::uint32_t v = candidate.second;
+      if (weights[to] + graph.weights[v] <= balance.limit[to]) {
+        move(v);
+      }
+    }
+  }
+}
+
+// Grows side 0 from a seed, adding the boundary node saving the most cut
+// cost, until it weighs its target
+std::vector<std::uint8_t> grow(const WeightedGraph &graph, std::uint32_t seed,
+                               const Balance &balance) {
+  const std::size_t n = graph.size();
+  std::vector<std::uint8_t> side(n, 1);
+  std::vector<double> gains(n, 0.0);
+  for (std::uint32_t v = 0; v < n; ++v) {
+    for (std::uint32_t i = graph.first[v]; i < graph.first[v + 1]; ++i) {
+      gains[v] -= graph.costs[i];
+    }
+  }
+  std::priority_queue<std::pair<double, std::uint32_t>> queue;
+  queue.emplace(gains[seed], seed);
+  std::uint32_t next_seed = 0;
+  double weight = 0.0;
+  while (weight < balance.target[0]) {
+    if (queue.empty()) {
+      // Another component of the graph
+      while (next_seed < n && side[next_seed] == 0) {
+        ++next_seed;
+      }
+      if (next_seed == n) {
+        break;
+      }
+      queue.emplace(gains[next_seed], next_seed);
+    }
+    const auto top = queue.top();
+    queue.pop();
+    const std::uint32_t v = top.second;
+    if (side[v] == 0 || top.first != gains[v]) {
+      continue; // Added, or queued again with another gain
+    }
+    // Stop at the weight nearest to the target
+    const double after = weight + graph.weights[v];
+    if (after > balance.target[0] &&
+        after - balance.target[0] > balance.target[0] - weight) {
+      break;
+    }
+    side[v] = 0;
+    weight = after;
+    for (std::uint32_t i = graph.first[v]; i < graph.first[v + 1]; ++i) {
+      const std::uint32_t u = graph.adjacent[i];
+      if (side[u] == 1) {
+        gains[u] += 2.0 * graph.costs[i];
+        queue.emplace(gains[u], u);
+      }
+    }
+  }
+  return side;
+}
+
+// Splits a graph into side 0, weighing fraction of its weight, and side 1
+std::vector<std::uint8_t> bisect(const WeightedGraph &graph, double fraction,
+                                 double imbalance,
+                                 const NetworkPartition::Options &options) {
+  std::vector<WeightedGraph> levels;
+  std::vector<std::vector<std::uint32_t>> maps;
+  const WeightedGraph *coarsest = &graph;
+  const double max_weight =
+      1.5 * graph.totalWeight() /
+      static_cast<double>(std::max<std::size_t>(options.coarsest_nodes, 1));
+  while (coarsest->size() > options.coarsest_nodes) {
+    std::vector<std::uint32_t> coarse_of;
+    WeightedGraph coarse = coarsen(*coarsest, max_weight, coarse_of);
+    if (static_cast<double>(coarse.size()) >
+        MIN_COARSENING * static_cast<double>(coarsest->size())) {
+      break;
+    }
+    levels.push_back(std::move(coarse));
+    maps.push_back(std::move(coarse_of));
+    coarsest = &levels.back();
+  }
+
+  const Balance coarsest_balance(*coarsest, fraction, imbalance);
+  std::vector<std::uint8_t> side;
+  double best = std::numeric_limits<double>::infinity();
+  const std::size_t tries = std::min(GROWING_TRIES, coarsest->size());
+  for (std::size_t t = 0; t < tries; ++t) {
+    const auto seed =
+        static_cast<std::uint32_t>(t * coarsest->size() / tries);
+    auto grown = grow(*coarsest, seed, coarsest_balance);
+    refine(*coarsest, grown, coarsest_balance, options.refinement_passes);
+    const double cost = cutCost(*coarsest, grown);
+    if (cost < best) {
+      best = cost;
+      side = std::move(grown);
+    }
+  }
+
+  // Back to the finer graphs, refining at each level
+  for (std::size_t level = levels.size(); level-- > 0;) {
+    const WeightedGraph &finer = level == 0 ? graph : levels[level - 1];
+    const auto &coarse_of = maps[level];
+    std::vector<std::uint8_t> projected(finer.size());
+    for (std::uint32_t v = 0; v < finer.size(); ++v) {
+      projected[v] = side[coarse_of[v]];
+    }
+    side = std::move(projected);
+    refine(finer, side, Balance(finer, fraction, imbalance),
+           options.refinement_passes);
+  }
+  return side;
+}
+
+// Partitions the nodes of graph, which are the nodes ids of the road graph,
+// into the parts [first_part, first_part + num_parts)
+void partition(const WeightedGraph &graph,
+               const std::vector<std::uint32_t> &ids, std::uint32_t first_part,
+               std::size_t num_parts, double imbalance,
+               const NetworkPartition::Options &options,
+               std::vector<std::uint32_t> &parts) {
+  if (num_parts == 1 || graph.size() == 0) {
+    for (std::uint32_t id : ids) {
+      parts[id] = first_part;
+    }
+    return;
+  }
+  const std::size_t left = num_parts / 2;
+  const auto side =
+      bisect(graph, static_cast<double>(left) / num_parts, imbalance, options);
+
+  std::vector<std::uint32_t> local(graph.size());
+  for (int s = 0; s < 2; ++s) {
+    std::vector<std::uint32_t> sub_ids;
+    std::vector<double> weights;
+    for (std::uint32_t v = 0; v < graph.size(); ++v) {
+      if (side[v] == s) {
+        local[v] = static_cast<std::uint32_t>(sub_ids.size());
+        sub_ids.push_back(ids[v]);
+        weights.push_back(graph.weights[v]);
+      }
+    }
+    std::vector<Link> links;
+    for (std::uint32_t v = 0; v < graph.size(); ++v) {
+      if (side[v] != s) {
+        continue;
+      }
+      for (std::uint32_t i = graph.first[v]; i < graph.first[v + 1]; ++i) {
+        const std::uint32_t u = graph.adjacent[i];
+        if (side[u] == s) {
+          links.push_back({local[v], local[u], graph.costs[i]});
+        }
+      }
+    }
+    const WeightedGraph sub = buildGraph(std::move(weights), std::move(links));
+    partition(sub, sub_ids,
+              s == 0 ? first_part
+                     : first_part + static_cast<std::uint32_t>(left),
+              s == 0 ? left : num_parts - left, imbalance, options, parts);
+  }
+}
+
+} // namespace
+
+NetworkPartition::NetworkPartition(const RoadGraph &graph,
+                                   std::size_t num_parts,
+                                   const std::vector<double> &demand,
+                                   const Options &options)
+    : m_graph(graph) {
+  if (num_parts == 0) {
+    throw std::invalid_argument("A partition has at least one part");
+  }
+  const std::size_t num_edges = graph.getNumEdges();
+  if (!demand.empty() && demand.size() != num_edges) {
+    throw std::invalid_argument("The demand has one value per edge");
+  }
+
+  std::vector<double> node_weights(graph.getNumNodes(), 0.0);
+  std::vector<Link> links;
+  links.reserve(2 * num_edges);
+  m_edge_weights.resize(num_edges);
+  for (std::uint32_t edge = 0; edge < num_edges; ++edge) {
+    const double lanes = graph.getRoad(edge)->getNumLanes();
+    const double expected = demand.empty() ? 0.0 : demand[edge];
+    m_edge_weights[edge] = options.lane_km_weight * lanes *
+                               graph.getLengths()[edge] / 1000.0 +
+                           expected;
+    const std::uint32_t source = graph.getSource(edge);
+    const std::uint32_t target = graph.getTarget(edge);
+    node_weights[source] += m_edge_weights[edge];
+    if (source != target) {
+      links.push_back({source, target, lanes + expected});
+      links.push_back({target, source, lanes + expected});
+    }
+  }
+
+  const WeightedGraph weighted =
+      buildGraph(std::move(node_weights), std::move(links));
+  std::vector<std::uint32_t> ids(weighted.size());
+  for (std::uint32_t v = 0; v < ids.size(); ++v) {
+    ids[v] = v;
+  }
+  // The tolerance is shared by the bisections leading to a part
+  const double depth = std::ceil(std::log2(static_cast<double>(num_parts)));
+  const double imbalance =
+      depth > 0.0 ? std::pow(std::max(options.imbalance, 1.0), 1.0 / depth)
+                  : 1.0;
+  m_node_parts.assign(weighted.size(), 0);
+  partition(weighted, ids, 0, num_parts, imbalance, options, m_node_parts);
+
+  m_part_weights.assign(num_parts, 0.0);
+  for (std::uint32_t edge = 0; edge < num_edges; ++edge) {
+    m_part_weights[getPartOfEdge(edge)] += m_edge_weights[edge];
+    if (isCutEdge(edge)) {
+      m_cut_cost += graph.getRoad(edge)->getNumLanes() +
+                    (demand.empty() ? 0.0 : demand[edge]);
+      ++m_num_cut_edges;
+    }
+  }
+}
+
+double NetworkPartition::getImbalance() const {
+  double total = 0.0;
+  double heaviest = 0.0;
+  for (double weight : m_part_weights) {
+    total += weight;
+    heaviest = std::max(heaviest, weight);
+  }
+  return total > 0.0
+             ? heaviest * static_cast<double>(m_part_weights.size()) / total
+             : 1.0;
+}
+
+} // namespace routing
+} // namespace kernel
+} // namespace jamfree
@@ -0,0 +1,669 @@
+#include "../../include/routing/Router.h"
+#include "../../../../microkernel/include/checkpoint/MappedFile.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+namespace jamfree {
+namespace kernel {
+namespace routing {
+
+using fr::univ_artois::lgi2a::similar::microkernel::checkpoint::
+    CheckpointReader;
+using fr::univ_artois::lgi2a::similar::microkernel::checkpoint::
+    CheckpointWriter;
+using fr::univ_artois::lgi2a::similar::microkernel::checkpoint::MappedFile;
+using fr::univ_artois::lgi2a::similar::microkernel::engine::
+    WorkStealingThreadPool;
+
+namespace {
+
+// Origins by task of generateSynthetic(), each one a pass over the zones
+constexpr std::size_t ORIGIN_CHUNK_SIZE = 8;
+
+// Distance below which the gravity model no longer grows (meters)
+constexpr double MIN_DISTANCE = 100.0;
+
+constexpr double SECONDS_PER_PERIOD = 3600.0;
+
+// Bytes of an OD file parsed by a task of loadFromFile(), cut at a line end
+constexpr std::size_t FILE_CHUNK_SIZE = 1 << 20;
+
+// "JFOD" in little-endian order
+constexpr std::uint32_t CACHE_MAGIC = 0x444f464a;
+
+// Version of the format of the caches, increased when it changes
+constexpr std::uint32_t CACHE_VERSION = 1;
+
+std::string_view trim(std::string_view text) {
+  const auto begin = text.find_first_not_of(" \t\r");
+  if (begin == std::string_view::npos) {
+    return std::string_view();
+  }
+  const auto end = text.find_last_not_of(" \t\r");
+  return text.substr(begin, end - begin + 1);
+}
+
+// A line of an OD file, its zones numbered in the order they appear
+struct FileEntry {
+  std::uint32_t origin;
+  std::uint32_t destination;
+  double demand;
+  int time_period;
+};
+
+// The content of an OD file, or of a chunk of it
+struct FileContent {
+  std::vector<std::string> zones;
+  std::vector<FileEntry> entries;
+};
+
+// A chunk of an OD file, its zones numbered in the chunk and viewing the
+// mapped file
+struct FileChunk {
+  std::vector<std::string_view> zones;
+  std::vector<FileEntry> entries;
+  bool valid = true;
+};
+
+// The number of a field, the whole field being the number
+template <typename Number> bool parseNumber(std::string_view field,
+                                            Number &value) {
+  if (!field.empty() && field.front() == '+') {
+    field.remove_prefix(1);
+  }
+  const char *end = field.data() + field.size();
+  const auto result = std::from_chars(field.data(), end, value);
+  return result.ec == std::errc() && result.ptr == end;
+}
+
+// Parses the lines of [begin, end), the first line of the file being
+// skipped if its numbers do not parse, as a header
+void parseChunk(const char *begin, const char *end, bool first_of_file,
+                FileChunk &chunk) {
+  std::unordered_map<std::string_view, std::uint32_t> indices;
+  auto zone = [&](std::string_view name) {
+    auto it = indices.find(name);
+    if (it != indices.end()) {
+      return it->second;
+    }
+    const auto index = static_cast<std::uint32_t>(chunk.zones.size());
+    indices.emplace(name, index);
+    chunk.zones.push_back(name);
+    return index;
+  };
+  bool first_line = first_of_file;
+  for (const char *line = begin; line < end;) {
+    const char *line_end =
+        static_cast<const char *>(std::memchr(line, '\n', end - line));
+    if (!line_end) {
+      line_end = end;
+    }
+    const std::string_view text = trim(std::string_view(line, line_end - line));
+    const bool header = first_line;
+    first_line = false;
+    line = line_end + 1;
+    if (text.empty()) {
+      continue;
+    }
+    std::string_view fields[4];
+    std::size_t count = 0;
+    for (std::size_t start = 0;; ++count) {
+      const std::size_t comma = text.find(',', start);
+      if (count == 4) {
+        chunk.valid = false;
+        return;
+      }
+      fields[count] = trim(text.substr(start, comma - start));
+      if (comma == std::string_view::npos) {
+        ++count;
+        break;
+      }
+      start = comma + 1;
+    }
+    if (count < 3) {
+      chunk.valid = false;
+      return;
+    }
+    FileEntry entry{0, 0, 0.0, 0};
+    if (!parseNumber(fields[2], entry.demand) ||
+        (count == 4 && !parseNumber(fields[3], entry.time_period))) {
+      if (header) {
+        continue;
+      }
+      chunk.valid = false;
+      return;
+    }
+    if (!(entry.demand >= 0.0) || std::isinf(entry.demand)) {
+      chunk.valid = false;
+      return;
+    }
+    entry.origin = zone(fields[0]);
+    entry.destination = zone(fields[1]);
+    chunk.entries.push_back(entry);
+  }
+}
+
+// Parses an OD file by chunks of lines, in parallel, then numbers the zones
+// of the chunks in the order they appear in the file
+bool parseFile(const char *data, std::size_t size, FileContent &content) {
+  std::vector<std::size_t> starts{0};
+  while (starts.back() + FILE_CHUNK_SIZE < size) {
+    const void *line_end = std::memchr(data + starts.back() + FILE_CHUNK_SIZE,
+                                       '\n', size - starts.back() -
+                                                 FILE_CHUNK_SIZE);
+    if (!line_end) {
+      break;
+    }
+    starts.push_back(static_cast<const char *>(line_end) - data + 1);
+  }
+  starts.push_back(size);
+  std::vector<FileChunk> chunks(starts.size() - 1);
+  WorkStealingThreadPool::parallelForOnCurrent(
+      chunks.size(), 1, [&](std::size_t begin, std::size_t end, std::size_t) {
+        for (std::size_t c = begin; c < end; ++c) {
+          parseChunk(data + starts[c], data + starts[c + 1], c == 0,
+                     chunks[c]);
+        }
+      });
+
+  std::unordered_map<std::string_view, std::uint32_t> indices;
+  std::vector<std::uint32_t> file_zones;
+  std::size_t num_entries = 0;
+  for (const FileChunk &chunk : chunks) {
+    if (!chunk.valid) {
+      return false;
+    }
+    num_entries += chunk.entries.size();
+  }
+  content.entries.reserve(num_entries);
+  for (const FileChunk &chunk : chunks) {
+    file_zones.clear();
+    for (std::string_view name : chunk.zones) {
+      auto it = indices.emplace(name, static_cast<std::uint32_t>(
+                                          content.zones.size()));
+      if (it.second) {
+        content.zones.emplace_back(name);
+      }
+      file_zones.push_back(it.first->second);
+    }
+    for (FileEntry entry : chunk.entries) {
+      entry.origin = file_zones[entry.origin];
+      entry.destination = file_zones[entry.destination];
+      content.entries.push_back(entry);
+    }
+  }
+  return true;
+}
+
+std::uint64_t rotate(std::uint64_t x, int bits) {
+  return (x << bits) | (x >> (64 - bits));
+}
+
+// Final mix of splitmix64
+std::uint64_t mix(std::uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+// Hash of the content of a mapped file, eight bytes at a time
+std::uint64_t hashContent(const std::uint8_t *data, std::size_t size) {
+  std::uint64_t hash = 0x9e3779b97f4a7c15ULL ^ size;
+  std::size_t pos = 0;
+  for (; pos + 8 <= size; pos += 8) {
+    std::uint64_t word;
+    std::memcpy(&word, data + pos, sizeof(word));
+    hash = rotate(hash ^ (word * 0x87c37b91114253d5ULL), 31) *
+           0x4cf5ad432745937fULL;
+  }
+  std::uint64_t tail = 0;
+  for (std::size_t shift = 0; pos < size; ++pos, shift += 8) {
+    tail |= static_cast<std::uint64_t>(data[pos]) << shift;
+  }
+  return mix(hash ^ tail);
+}
+
+void writeCache(const FileContent &content, std::uint64_t source_size,
+                std::uint64_t source_hash, const std::string &cache_filename) {
+  CheckpointWriter writer;
+  writer.writeU32(CACHE_MAGIC);
+  writer.writeU32(CACHE_VERSION);
+  writer.writeU64(source_size);
+  writer.writeU64(source_hash);
+  writer.writeU64(content.zones.size());
+  for (const std::string &zone : content.zones) {
+    writer.writeString(zone);
+  }
+  writer.writeU64(content.entries.size());
+  for (const FileEntry &entry : content.entries) {
+    writer.writeU32(entry.origin);
+    writer.writeU32(entry.destination);
+    writer.writeDouble(entry.demand);
+    writer.writeI64(entry.time_period);
+  }
+  writer.saveTo(cache_filename);
+}
+
+bool readCache(const std::string &cache_filename, std::uint64_t source_size,
+               std::uint64_t source_hash, FileContent &content) {
+  try {
+    MappedFile cache(cache_filename);
+    CheckpointReader reader = cache.reader();
+    if (reader.readU32() != CACHE_MAGIC || reader.readU32() != CACHE_VERSION ||
+        reader.readU64() != source_size || reader.readU64() != source_hash) {
+      return false;
+    }
+    FileContent cached;
+    const std::uint64_t num_zones = reader.readU64();
+    cached.zones.reserve(static_cast<std::size_t>(
+        std::min<std::uint64_t>(num_zones, reader.remaining() / 8)));
+    for (std::uint64_t i = 0; i < num_zones; ++i) {
+      cached.zones.push_back(reader.readString());
+    }
+    const std::uint64_t num_entries = reader.readU64();
+    cached.entries.reserve(static_cast<std::size_t>(
+        std::min<std::uint64_t>(num_entries, reader.remaining() / 24)));
+    for (std::uint64_t i = 0; i < num_entries; ++i) {
+      FileEntry entry;
+      entry.origin = reader.readU32();
+      entry.destination = reader.readU32();
+      entry.demand = reader.readDouble();
+      entry.time_period = static_cast<int>(reader.readI64());
+      if (entry.origin >= num_zones || entry.destination >= num_zones) {
+        return false;
+      }
+      cached.entries.push_back(entry);
+    }
+    content = std::move(cached);
+    return true;
+  } catch (const std::exception &) {
+    // Missing or truncated
+    return false;
+  }
+}
+
+// Vose's alias method: entry i is kept with probabilities[i], and replaced
+// by aliases[i] otherwise
+void buildAliasTable(const std::vector<double> &weights, double total,
+                     std::vector<double> &probabilities,
+                     std::vector<std::uint32_t> &aliases) {
+  const std::size_t count = weights.size();
+  probabilities.resize(count);
+  aliases.resize(count);
+  std::vector<std::uint32_t> small;
+  std::vector<std::uint32_t> large;
+  for (std::size_t i = 0; i < count; ++i) {
+    probabilities[i] = weights[i] * count / total;
+    aliases[i] = static_cast<std::uint32_t>(i);
+    (probabilities[i] < 1.0 ? small : large)
+        .push_back(static_cast<std::uint32_t>(i));
+  }
+  while (!small.empty() && !large.empty()) {
+    const std::uint32_t less = small.back();
+    small.pop_back();
+    const std::uint32_t more = large.back();
+    aliases[less] = more;
+    probabilities[more] -= 1.0 - probabilities[less];
+    if (probabilities[more] < 1.0) {
+      large.pop_back();
+      small.push_back(more);
+    }
+  }
+  // Left by the rounding errors, all of probability 1
+  for (std::uint32_t i : small) {
+    probabilities[i] = 1.0;
+  }
+  for (std::uint32_t i : large) {
+    probabilities[i] = 1.0;
+  }
+}
+
+} // namespace
+
+std::size_t ODMatrix::addZone(const std::string &zone,
+                              const model::Point2D &centroid) {
+  const std::uint32_t index = zoneIndex(zone);
+  m_zone_centroids[index] = centroid;
+  return index;
+}
+
+std::uint32_t ODMatrix::zoneIndex(const std::string &zone) {
+  auto it = m_zone_indices.find(zone);
+  if (it != m_zone_indices.end()) {
+    return it->second;
+  }
+  if (m_zone_names.size() >= RoadGraph::NONE) {
+    throw std::length_error("Too many zones for an ODMatrix");
+  }
+  const auto index = static_cast<std::uint32_t>(m_zone_names.size());
+  m_zone_indices.emplace(zone, index);
+  m_zone_names.push_back(zone);
+  m_zone_centroids.emplace_back();
+  return index;
+}
+
+void ODMatrix::addDemand(const std::string &origin_zone,
+                         const std::string &dest_zone, double demand,
+                         int time_period) {
+  if (!(demand >= 0.0) || std::isinf(demand)) {
+    throw std::invalid_argument("ODMatrix::addDemand: invalid demand");
+  }
+  const std::uint32_t origin = zoneIndex(origin_zone);
+  const std::uint32_t destination = zoneIndex(dest_zone);
+  if (demand > 0.0) {
+    m_slices[time_period].pending.emplace_back(origin, destination, demand);
+  }
+}
+
+const ODMatrix::TimeSlice *ODMatrix::getSlice(int time_period) const {
+  auto it = m_slices.find(time_period);
+  if (it == m_slices.end()) {
+    return nullptr;
+  }
+  TimeSlice &slice = it->second;
+  const std::size_t num_zones = m_zone_names.size();
+  if (!slice.pending.empty()) {
+    // The entries of the matrix and the pending ones, sorted and summed
+    auto &entries = slice.pending;
+    for (std::size_t origin = 0; origin + 1 < slice.first.size(); ++origin) {
+      for (std::uint32_t e = slice.first[origin]; e < slice.first[origin + 1];
+           ++e) {
+        entries.emplace_back(static_cast<std::uint32_t>(origin),
+                             slice.destinations[e], slice.demands[e]);
+      }
+    }
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const auto &a, const auto &b) {
+                       return std::get<0>(a) < std::get<0>(b) ||
+                              (std::get<0>(a) == std::get<0>(b) &&
+                               std::get<1>(a) < std::get<1>(b));
+                     });
+    if (entries.size() >= RoadGraph::NONE) {
+      throw std::length_error("Too many OD pairs for an ODMatrix");
+    }
+    slice.first.assign(num_zones + 1, 0);
+    slice.destinations.clear();
+    slice.demands.clear();
+    slice.total = 0.0;
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+      const auto &entry = entries[i];
+      if (i > 0 && std::get<0>(entries[i - 1]) == std::get<0>(entry) &&
+          std::get<1>(entries[i - 1]) == std::get<1>(entry)) {
+        slice.demands.back() += std::get<2>(entry);
+      } else {
+        ++slice.first[std::get<0>(entry) + 1];
+        slice.destinations.push_back(std::get<1>(entry));
+        slice.demands.push_back(std::get<2>(entry));
+      }
+      slice.total += std::get<2>(entry);
+    }
+    for (std::size_t origin = 0; origin < num_zones; ++origin) {
+      slice.first[origin + 1] += slice.first[origin];
+    }
+    entries.clear();
+    entries.shrink_to_fit();
+    slice.probabilities.clear();
+    slice.aliases.clear();
+  } else if (!slice.first.empty() && slice.first.size() != num_zones + 1) {
+    // The zones added since have no demand
+    slice.first.resize(num_zones + 1, slice.first.back());
+  }
+  return &slice;
+}
+
+double ODMatrix::getDemand(const std::string &origin_zone,
+                           const std::string &dest_zone,
+                           int time_period) const {
+  auto origin = m_zone_indices.find(origin_zone);
+  auto destination = m_zone_indices.find(dest_zone);
+  const TimeSlice *slice = getSlice(time_period);
+  if (origin == m_zone_indices.end() || destination == m_zone_indices.end() ||
+      !slice || slice->first.empty()) {
+    return 0.0;
+  }
+  const auto begin = slice->destinations.begin() + slice->first[origin->second];
+  const auto end =
+      slice->destinations.begin() + slice->first[origin->second + 1];
+  auto it = std::lower_bound(begin, end, destination->second);
+  if (it == end || *it != destination->second) {
+    return 0.0;
+  }
+  return slice->demands[it - slice->destinations.begin()];
+}
+
+double ODMatrix::getTotalDemand(int time_period) const {
+  const TimeSlice *slice = getSlice(time_period);
+  return slice ? slice->total : 0.0;
+}
+
+ODPair ODMatrix::sampleODPair(int time_period) const {
+  const TimeSlice *found = getSlice(time_period);
+  if (!found || !(found->total > 0.0)) {
+    throw std::runtime_error("ODMatrix::sampleODPair: no demand in period " +
+                             std::to_string(time_period));
+  }
+  TimeSlice &slice = m_slices.find(time_period)->second;
+  if (slice.aliases.empty()) {
+    buildAliasTable(slice.demands, slice.total, slice.probabilities,
+                    slice.aliases);
+  }
+
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  const std::size_t count = slice.demands.size();
+  const double u = uniform(m_rng) * count;
+  const std::size_t column = std::min(static_cast<std::size_t>(u), count - 1);
+  const std::uint32_t entry = u - column < slice.probabilities[column]
+                                  ? static_cast<std::uint32_t>(column)
+                                  : slice.aliases[column];
+  const std::size_t origin =
+      std::upper_bound(slice.first.begin(), slice.first.end(), entry) -
+      slice.first.begin() - 1;
+  const std::size_t destination = slice.destinations[entry];
+
+  ODPair pair{};
+  pair.origin = m_zone_centroids[origin];
+  pair.destination = m_zone_centroids[destination];
+  pair.origin_id = m_zone_names[origin];
+  pair.destination_id = m_zone_names[destination];
+  pair.departure_time = (time_period + uniform(m_rng)) * SECONDS_PER_PERIOD;
+  return pair;
+}
+
+bool ODMatrix::loadFromFile(const std::string &filename, bool use_cache) {
+  std::unique_ptr<MappedFile> source;
+  try {
+    source = std::make_unique<MappedFile>(filename);
+  } catch (const std::exception &) {
+    return false;
+  }
+  FileContent content;
+  const std::string cache_filename = getCacheFilename(filename);
+  std::uint64_t hash = 0;
+  bool cached = false;
+  if (use_cache) {
+    hash = hashContent(source->data(), source->size());
+    cached = readCache(cache_filename, source->size(), hash, content);
+  }
+  if (!cached) {
+    std::unique_ptr<WorkStealingThreadPool::Scope> scope;
+    if (m_pool && WorkStealingThreadPool::currentSize() == 1) {
+      scope = std::make_unique<WorkStealingThreadPool::Scope>(m_pool.get());
+    }
+    if (!parseFile(reinterpret_cast<const char *>(source->data()),
+                   source->size(), content)) {
+      return false;
+    }
+    if (use_cache) {
+      try {
+        writeCache(content, source->size(), hash, cache_filename);
+      } catch (const std::exception &) {
+        // The next load parses the file again
+      }
+    }
+  }
+
+  // As addDemand() would, the zones being numbered in the order they appear
+  std::vector<std::uint32_t> indices;
+  indices.reserve(content.zones.size());
+  for (const std::string &zone : content.zones) {
+    indices.push_back(zoneIndex(zone));
+  }
+  TimeSlice *slice = nullptr;
+  int time_period = 0;
+  for (const FileEntry &entry : content.entries) {
+    if (!(entry.demand > 0.0)) {
+      continue;
+    }
+    if (!slice || entry.time_period != time_period) {
+      time_period = entry.time_period;
+      slice = &m_slices[time_period];
+    }
+    slice->pending.emplace_back(indices[entry.origin],
+                                indices[entry.destination], entry.demand);
+  }
+  return true;
+}
+
+void ODMatrix::setNumThreads(std::size_t numThreads) {
+  if (numThreads > 1) {
+    m_pool = std::make_shared<WorkStealingThreadPool>(numThreads);
+  } else {
+    m_pool.reset();
+  }
+}
+
+void ODMatrix::generateSynthetic(
+    const std::unordered_map<std::string, double> &zone_populations,
+    const std::unordered_map<std::string, double> &zone_attractions,
+    const std::unordered_map<std::string, model::Point2D> &zone_centroids,
+    int time_period) {
+  std::vector<std::string> zones;
+  zones.reserve(zone_centroids.size());
+  for (const auto &entry : zone_centroids) {
+    zones.push_back(entry.first);
+  }
+  std::sort(zones.begin(), zones.end());
+  for (const std::string &zone : zones) {
+    addZone(zone, zone_centroids.at(zone));
+  }
+
+  // The zones as arrays, those of former calls without trips
+  const std::size_t num_zones = m_zone_names.size();
+  std::vector<double> xs(num_zones);
+  std::vector<double> ys(num_zones);
+  std::vector<double> populations(num_zones, 0.0);
+  std::vector<double> attractions(num_zones, 0.0);
+  double total_population = 0.0;
+  for (std::size_t i = 0; i < num_zones; ++i) {
+    xs[i] = m_zone_centroids[i].x;
+    ys[i] = m_zone_centroids[i].y;
+  }
+  for (const std::string &zone : zones) {
+    const std::uint32_t i = m_zone_indices.at(zone);
+    auto population = zone_populations.find(zone);
+    if (population != zone_populations.end() && population->second > 0.0) {
+      populations[i] = population->second;
+      total_population += population->second;
+    }
+    auto attraction = zone_attractions.find(zone);
+    if (attraction != zone_attractions.end() && attraction->second > 0.0) {
+      attractions[i] = attraction->second;
+    }
+  }
+
+  // P_i * A_j / d_ij^2 by origin, in parallel
+  std::vector<std::vector<std::uint32_t>> row_destinations(num_zones);
+  std::vector<std::vector<double>> row_demands(num_zones);
+  std::vector<double> row_totals(num_zones, 0.0);
+  std::unique_ptr<WorkStealingThreadPool::Scope> scope;
+  if (m_pool && WorkStealingThreadPool::currentSize() == 1) {
+    scope = std::make_unique<WorkStealingThreadPool::Scope>(m_pool.get());
+  }
+  WorkStealingThreadPool::parallelForOnCurrent(
+      num_zones, ORIGIN_CHUNK_SIZE,
+      [&](std::size_t begin, std::size_t end, std::size_t) {
+        std::vector<double> weights(num_zones);
+        const double min_squared = MIN_DISTANCE * MIN_DISTANCE;
+        for (std::size_t i = begin; i < end; ++i) {
+          if (populations[i] == 0.0) {
+            continue;
+          }
+          const double x = xs[i];
+          const double y = ys[i];
+          const double population = populations[i];
+          // No branch, so that the loop is vectorized
+          for (std::size_t j = 0; j < num_zones; ++j) {
+            const double dx = xs[j] - x;
+            const double dy = ys[j] - y;
+            weights[j] = population * attractions[j] /
+                         std::max(dx * dx + dy * dy, min_squared);
+          }
+          weights[i] = 0.0;
+
+          std::size_t count = 0;
+          for (std::size_t j = 0; j < num_zones; ++j) {
+            count += weights[j] > 0.0;
+          }
+          auto &destinations = row_destinations[i];
+          auto &demands = row_demands[i];
+          destinations.reserve(count);
+          demands.reserve(count);
+          double total = 0.0;
+          for (std::size_t j = 0; j < num_zones; ++j) {
+            if (weights[j] > 0.0) {
+              destinations.push_back(static_cast<std::uint32_t>(j));
+              demands.push_back(weights[j]);
+              total += weights[j];
+            }
+          }
+          row_totals[i] = total;
+        }
+      });
+
+  double total = 0.0;
+  for (double row_total : row_totals) {
+    total += row_total;
+  }
+  const double k = total > 0.0 ? total_population / total : 0.0;
+
+  std::size_t num_entries = 0;
+  for (const auto &demands : row_demands) {
+    num_entries += demands.size();
+  }
+  if (num_entries >= RoadGraph::NONE) {
+    throw std::length_error("Too many OD pairs for an ODMatrix");
+  }
+
+  TimeSlice &slice = m_slices[time_period];
+  slice = TimeSlice();
+  slice.first.assign(num_zones + 1, 0);
+  for (std::size_t i = 0; i < num_zones; ++i) {
+    slice.first[i + 1] =
+        slice.first[i] + static_cast<std::uint32_t>(row_demands[i].size());
+  }
+  slice.destinations.reserve(slice.first.back());
+  slice.demands.reserve(slice.first.back());
+  for (std::size_t i = 0; i < num_zones; ++i) {
+    slice.destinations.insert(slice.destinations.end(),
+                              row_destinations[i].begin(),
+                              row_destinations[i].end());
+    for (double demand : row_demands[i]) {
+      slice.demands.push_back(k * demand);
+    }
+    std::vector<std::uint32_t>().swap(row_destinations[i]);
+    std::vector<double>().swap(row_demands[i]);
+  }
+  slice.total = k * total;
+}
+
+} // namespace routing
+} // namespace kernel
+} // namespace jamfree
@@ -0,0 +1,358 @@
+#include "../../include/routing/RoadGraph.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace jamfree {
+namespace kernel {
+namespace routing {
+
+namespace {
+
+constexpr double INFINITE = std::numeric_limits<double>::infinity();
+
+// Nodes among which the landmarks start
+constexpr std::size_t SAMPLED_NODES = 8;
+
+// Endpoints are merged when their coordinates are equal
+struct PointKey {
+  std::uint64_t x;
+  std::uint64_t y;
+
+  explicit PointKey(const model::Point2D &point) {
+    std::memcpy(&x, &point.x, sizeof(x));
+    std::memcpy(&y, &point.y, sizeof(y));
+  }
+
+  bool operator==(const PointKey &other) const {
+    return x == other.x && y == other.y;
+  }
+};
+
+struct PointKeyHash {
+  std::size_t operator()(const PointKey &key) const {
+    return std::hash<std::uint64_t>()(key.x * 0x9e3779b97f4a7c15ULL ^ key.y);
+  }
+};
+
+} // namespace
+
+RoadGraph::RoadGraph(const std::vector<std::shared_ptr<model::Road>> &roads) {
+  std::unordered_map<PointKey, std::uint32_t, PointKeyHash> nodes;
+  auto nodeAt = [&](const model::Point2D &point) {
+    auto inserted = nodes.emplace(PointKey(point),
+                                  static_cast<std::uint32_t>(nodes.size()));
+    if (inserted.second) {
+      m_positions.push_back(point);
+    }
+    return inserted.first->second;
+  };
+
+  // The edges in the order of the roads, then sorted by source
+  std::vector<std::uint32_t> sources;
+  std::vector<std::uint32_t> targets;
+  std::vector<const std::shared_ptr<model::Road> *> edge_roads;
+  std::vector<std::size_t> road_indices;
+  for (std::size_t index = 0; index < roads.size(); ++index) {
+    const auto &road = roads[index];
+    if (!road || road->getNumLanes() == 0) {
+      continue;
+    }
+    road_indices.push_back(index);
+    sources.push_back(nodeAt(road->getStart()));
+    targets.push_back(nodeAt(road->getEnd()));
+    edge_roads.push_back(&road);
+  }
+  if (m_positions.size() >= NONE || sources.size() >= NONE) {
+    throw std::length_error("Too many roads for a RoadGraph");
+  }
+
+  const std::size_t num_nodes = m_positions.size();
+  const std::size_t num_edges = sources.size();
+  m_first_edge.assign(num_nodes + 1, 0);
+  for (std::uint32_t source : sources) {
+    ++m_first_edge[source + 1];
+  }
+  for (std::size_t v = 0; v < num_nodes; ++v) {
+    m_first_edge[v + 1] += m_first_edge[v];
+  }
+
+  m_targets.resize(num_edges);
+  m_sources.resize(num_edges);
+  m_lengths.resize(num_edges);
+  m_times.resize(num_edges);
+  m_roads.resize(num_edges);
+  m_road_edges.assign(roads.size(), NONE);
+  std::vector<std::uint32_t> next(m_first_edge.begin(), m_first_edge.end() - 1);
+  for (std::size_t i = 0; i < num_edges; ++i) {
+    const std::uint32_t edge = next[sources[i]]++;
+    const auto &road = *edge_roads[i];
+    double speed = 0.0;
+    for (const auto &lane : road->getLanes()) {
+      speed = std::max(speed, lane->getSpeedLimit());
+    }
+    m_targets[edge] = targets[i];
+    m_sources[edge] = sources[i];
+    m_lengths[edge] = road->getLength();
+    m_times[edge] = speed > 0.0 ? m_lengths[edge] / speed : INFINITE;
+    m_roads[edge] = road;
+    m_road_edges[road_indices[i]] = edge;
+    m_max_speed = std::max(m_max_speed, speed);
+  }
+
+  m_first_incoming.assign(num_nodes + 1, 0);
+  for (std::uint32_t target : m_targets) {
+    ++m_first_incoming[target + 1];
+  }
+  for (std::size_t v = 0; v < num_nodes; ++v) {
+    m_first_incoming[v + 1] += m_first_incoming[v];
+  }
+  m_incoming_edges.resize(num_edges);
+  next.assign(m_first_incoming.begin(), m_first_incoming.end() - 1);
+  for (std::uint32_t edge = 0; edge < num_edges; ++edge) {
+    m_incoming_edges[next[m_targets[edge]]++] = edge;
+  }
+
+  buildGrid();
+}
+
+void RoadGraph::buildGrid() {
+  const std::size_t num_nodes = m_positions.size();
+  if (num_nodes == 0) {
+    return;
+  }
+  double max_x = m_positions[0].x;
+  double max_y = m_positions[0].y;
+  m_grid_x = m_positions[0].x;
+  m_grid_y = m_positions[0].y;
+  for (const auto &position : m_positions) {
+    m_grid_x = std::min(m_grid_x, position.x);
+    m_grid_y = std::min(m_grid_y, position.y);
+    max_x = std::max(max_x, position.x);
+    max_y = std::max(max_y, position.y);
+  }
+
+  // About one node per cell
+  const double side = std::ceil(std::sqrt(static_cast<double>(num_nodes)));
+  m_cell_size = std::max(max_x - m_grid_x, max_y - m_grid_y) / side;
+  if (!(m_cell_size > 0.0)) {
+    m_cell_size = 1.0;
+  }
+  m_columns = static_cast<std::size_t>((max_x - m_grid_x) / m_cell_size) + 1;
+  m_rows = static_cast<std::size_t>((max_y - m_grid_y) / m_cell_size) + 1;
+
+  auto cellOf = [this](const model::Point2D &position) {
+    std::size_t column = std::min(
+        m_columns - 1,
+        static_cast<std::size_t>((position.x - m_grid_x) / m_cell_size));
+    std::size_t row = std::min(
+        m_rows - 1,
+        static_cast<std::size_t>((position.y - m_grid_y) / m_cell_size));
+    return row * m_columns + column;
+  };
+  m_first_in_cell.assign(m_columns * m_rows + 1, 0);
+  for (const auto &position : m_positions) {
+    ++m_first_in_cell[cellOf(position) + 1];
+  }
+  for (std::size_t c = 0; c + 1 < m_first_in_cell.size(); ++c) {
+    m_first_in_cell[c + 1] += m_first_in_cell[c];
+  }
+  m_cell_nodes.resize(num_nodes);
+  std::vector<std::uint32_t> next(m_first_in_cell.begin(),
+                                  m_first_in_cell.end() - 1);
+  for (std::uint32_t node = 0; node < num_nodes; ++node) {
+    m_cell_nodes[next[cellOf(m_positions[node])]++] = node;
+  }
+}
+
+std::uint32_t RoadGraph::findNearestNode(const model::Point2D &point) const {
+  if (m_positions.empty()) {
+    return NONE;
+  }
+
+  // The cell of the point, or of the nearest point of the grid
+  const double x = std::max(0.0, point.x - m_grid_x);
+  const double y = std::max(0.0, point.y - m_grid_y);
+  const long column = static_cast<long>(std::min<double>(
+      static_cast<double>(m_columns - 1), std::floor(x / m_cell_size)));
+  const long row = static_cast<long>(std::min<double>(
+      static_cast<double>(m_rows - 1), std::floor(y / m_cell_size)));
+
+  std::uint32_t best = NONE;
+  double best_distance = INFINITE;
+  auto visit = [&](long c, long r) {
+    if (c < 0 || r < 0 || c >= static_cast<long>(m_columns) ||
+        r >= static_cast<long>(m_rows)) {
+      return;
+    }
+    const std::size_t cell = static_cast<std::size_t>(r) * m_columns + c;
+    for (std::uint32_t i = m_first_in_cell[cell];
+         i < m_first_in_cell[cell + 1]; ++i) {
+      const std::uint32_t node = m_cell_nodes[i];
+      const double distance = point.distanceTo(m_positions[node]);
+      if (distance < best_distance) {
+        best_distance = distance;
+        best = node;
+      }
+    }
+  };
+
+  // Rings of cells around the cell of the point: the nodes of ring r + 1
+  // and beyond are at least r cells away
+  const long rings = static_cast<long>(std::max(m_columns, m_rows));
+  for (long r = 0; r <= rings; ++r) {
+    if (r == 0) {
+      visit(column, row);
+    } else {
+      for (long c = column - r; c <= column + r; ++c) {
+        visit(c, row - r);
+        visit(c, row + r);
+      }
+      for (long k = row - r + 1; k < row + r; ++k) {
+        visit(column - r, k);
+        visit(column + r, k);
+      }
+    }
+    if (best != NONE && best_distance <= r * m_cell_size) {
+      break;
+    }
+  }
+  return best;
+}
+
+Landmarks::Landmarks(const RoadGraph &graph,
+                     const std::vector<double> &weights, std::size_t count)
+    : m_weights(weights) {
+  const std::size_t num_nodes = graph.getNumNodes();
+  count = std::min(count, num_nodes);
+
+  // Farthest selection within the strongly connected component of the
+  // best connected of a few sampled nodes, the other nodes not being
+  // reached both ways: each landmark is the node of the component farthest
+  // from the ones chosen, summing the distances from and to them
+  std::vector<std::vector<double>> from(count);
+  std::vector<std::vector<double>> to(count);
+  std::vector<double> nearest;
+  std::vector<double> forward;
+  std::vector<double> backward;
+  std::size_t best_reach = 0;
+  for (std::size_t sample = 0; sample < SAMPLED_NODES && count > 0;
+       ++sample) {
+    const auto node =
+        static_cast<std::uint32_t>(sample * num_nodes / SAMPLED_NODES);
+    shortestDistances(graph, m_weights, node, false, forward);
+    shortestDistances(graph, m_weights, node, true, backward);
+    std::size_t reach = 0;
+    for (std::size_t v = 0; v < num_nodes; ++v) {
+      if (forward[v] != INFINITE && backward[v] != INFINITE) {
+        ++reach;
+      }
+    }
+    if (sample == 0 || reach > best_reach) {
+      best_reach = reach;
+      nearest.resize(num_nodes);
+      for (std::size_t v = 0; v < num_nodes; ++v) {
+        nearest[v] = forward[v] + backward[v];
+      }
+    }
+  }
+  for (std::size_t l = 0; l < count; ++l) {
+    std::uint32_t landmark = 0;
+    double farthest = -1.0;
+    for (std::uint32_t v = 0; v < num_nodes; ++v) {
+      if (nearest[v] != INFINITE && nearest[v] > farthest) {
+        farthest = nearest[v];
+        landmark = v;
+      }
+    }
+    if (farthest < 0.0) {
+      // The component is smaller than the landmarks
+      break;
+    }
+    m_landmarks.push_back(landmark);
+    shortestDistances(graph, m_weights, landmark, false, from[l]);
+    shortestDistances(graph, m_weights, landmark, true, to[l]);
+    for (std::uint32_t v = 0; v < num_nodes; ++v) {
+      nearest[v] = std::min(nearest[v], from[l][v] + to[l][v]);
+    }
+    nearest[landmark] = -INFINITE;
+  }
+  count = m_landmarks.size();
+
+  m_from.resize(num_nodes * count);
+  m_to.resize(num_nodes * count);
+  for (std::size_t v = 0; v < num_nodes; ++v) {
+    for (std::size_t l = 0; l < count; ++l) {
+      m_from[v * count + l] = from[l][v];
+      m_to[v * count + l] = to[l][v];
+    }
+  }
+}
+
+double Landmarks::lowerBound(std::uint32_t node, std::uint32_t target) const {
+  const std::size_t count = m_landmarks.size();
+  const double *from_node = m_from.data() + node * count;
+  const double *from_target = m_from.data() + target * count;
+  const double *to_node = m_to.data() + node * count;
+  const double *to_target = m_to.data() + target * count;
+  double bound = 0.0;
+  for (std::size_t l = 0; l < count; ++l) {
+    // A landmark reaching the node but not the target, or reached from the
+    // target but not from the node, proves the target out of reach
+    if (from_node[l] != INFINITE) {
+      bound = std::max(bound, from_target[l] - from_node[l]);
+    }
+    if (to_target[l] != INFINITE) {
+      bound = std::max(bound, to_node[l] - to_target[l]);
+    }
+  }
+  return bound;
+}
+
+void Landmarks::shortestDistances(const RoadGraph &graph,
+                                  const std::vector<double> &weights,
+                                  std::uint32_t source, bool backward,
+                                  std::vector<double> &distances) {
+  distances.assign(graph.getNumNodes(), INFINITE);
+  using Entry = std::pair<double, std::uint32_t>;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+  distances[source] = 0.0;
+  queue.emplace(0.0, source);
+  while (!queue.empty()) {
+    const Entry entry = queue.top();
+    queue.pop();
+    const std::uint32_t node = entry.second;
+    if (entry.first > distances[node]) {
+      continue;
+    }
+    auto relax = [&](std::uint32_t edge, std::uint32_t next) {
+      const double distance = entry.first + weights[edge];
+      if (distance < distances[next]) {
+        distances[next] = distance;
+        queue.emplace(distance, next);
+      }
+    };
+    if (backward) {
+      for (std::uint32_t i = graph.getFirstIncomingEdge(node);
+           i < graph.getFirstIncomingEdge(node + 1); ++i) {
+        const std::uint32_t edge = graph.getIncomingEdge(i);
+        relax(edge, graph.getSource(edge));
+      }
+    } else {
+      for (std::uint32_t edge = graph.getFirstEdge(node);
+           edge < graph.getFirstEdge(node + 1); ++edge) {
+        relax(edge, graph.getTarget(edge));
+      }
+    }
+  }
+}
+
+} // namespace routing
+} // namespace kernel
+} // namespace jamfree
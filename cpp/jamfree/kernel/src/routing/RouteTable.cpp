@@ -0,0 +1,158 @@
+#include "../../include/routing/RouteTable.h"
+#include "../../include/routing/Router.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace jamfree {
+namespace kernel {
+namespace routing {
+
+namespace {
+
+// FNV-1a over the edges and the lanes
+std::uint64_t hashRoute(const std::uint32_t *edges, const std::uint8_t *lanes,
+                        std::size_t num_edges) {
+  std::uint64_t hash = 14695981039346656037ull;
+  for (std::size_t i = 0; i < num_edges; ++i) {
+    const std::uint64_t word = (static_cast<std::uint64_t>(edges[i]) << 8) |
+                               (lanes ? lanes[i] : 0u);
+    for (int byte = 0; byte < 5; ++byte) {
+      hash ^= (word >> (8 * byte)) & 0xffu;
+      hash *= 1099511628211ull;
+    }
+  }
+  return hash;
+}
+
+} // namespace
+
+RouteTable::RouteTable(const RoadGraph &graph) : m_graph(graph) {
+  m_road_edges.reserve(graph.getNumEdges());
+  for (std::uint32_t edge = 0; edge < graph.getNumEdges(); ++edge) {
+    m_road_edges.emplace(graph.getRoad(edge).get(), edge);
+  }
+  m_routes.push_back({0, 0.0, 0.0, 0.0});
+}
+
+RouteTable::RouteId RouteTable::intern(const Route &route) {
+  m_edge_buffer.clear();
+  m_lane_buffer.clear();
+  for (std::size_t i = 0; i < route.roads.size(); ++i) {
+    auto it = m_road_edges.find(route.roads[i].get());
+    if (it == m_road_edges.end()) {
+      throw std::invalid_argument(
+          "RouteTable::intern: road not in the graph of the table");
+    }
+    const int lane = i < route.lane_indices.size() ? route.lane_indices[i] : 0;
+    if (lane < 0 || lane > 255) {
+      throw std::invalid_argument("RouteTable::intern: lane index out of range");
+    }
+    m_edge_buffer.push_back(it->second);
+    m_lane_buffer.push_back(static_cast<std::uint8_t>(lane));
+  }
+  return intern(m_edge_buffer.data(), m_lane_buffer.data(),
+                m_edge_buffer.size(), route.total_distance,
+                route.estimated_time, route.cost);
+}
+
+RouteTable::RouteId RouteTable::intern(const std::uint32_t *edges,
+                                       const std::uint8_t *lanes,
+                                       std::size_t num_edges,
+                                       double total_distance,
+                                       double estimated_time, double cost) {
+  if (num_edges == 0) {
+    return NONE;
+  }
+  for (std::size_t i = 0; i < num_edges; ++i) {
+    if (edges[i] >= m_graph.getNumEdges()) {
+      throw std::invalid_argument(
+          "RouteTable::intern: edge not in the graph of the table");
+    }
+  }
+
+  const std::uint64_t hash = hashRoute(edges, lanes, num_edges);
+  auto range = m_index.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    const RouteId candidate = it->second;
+    if (getNumEdges(candidate) != num_edges ||
+        !std::equal(edges, edges + num_edges, getEdges(candidate))) {
+      continue;
+    }
+    const std::uint8_t *candidate_lanes = getLanes(candidate);
+    const bool same_lanes =
+        lanes ? std::equal(lanes, lanes + num_edges, candidate_lanes)
+              : std::all_of(candidate_lanes, candidate_lanes + num_edges,
+                            [](std::uint8_t lane) { return lane == 0; });
+    if (same_lanes) {
+      ++m_num_shared;
+      return candidate;
+    }
+  }
+
+  if (m_edges.size() + num_edges > NONE) {
+    throw std::length_error("RouteTable::intern: too many edges");
+  }
+  const RouteId route = static_cast<RouteId>(size());
+  m_edges.insert(m_edges.end(), edges, edges + num_edges);
+  if (lanes) {
+    m_lanes.insert(m_lanes.end(), lanes, lanes + num_edges);
+  } else {
+    m_lanes.resize(m_edges.size(), 0);
+  }
+  Entry &entry = m_routes.back();
+  entry.total_distance = total_distance;
+  entry.estimated_time = estimated_time;
+  entry.cost = cost;
+  m_routes.push_back(
+      {static_cast<std::uint32_t>(m_edges.size()), 0.0, 0.0, 0.0});
+  m_index.emplace(hash, route);
+  return route;
+}
+
+Route RouteTable::toRoute(RouteId route) const {
+  Route result;
+  if (route == NONE) {
+    return result;
+  }
+  const std::size_t n = getNumEdges(route);
+  const std::uint32_t *edges = getEdges(route);
+  const std::uint8_t *lanes = getLanes(route);
+  result.roads.reserve(n);
+  result.lane_indices.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    result.roads.push_back(m_graph.getRoad(edges[i]));
+    result.lane_indices.push_back(lanes[i]);
+  }
+  result.total_distance = getTotalDistance(route);
+  result.estimated_time = getEstimatedTime(route);
+  result.cost = getCost(route);
+  return result;
+}
+
+bool RouteTable::advanceTo(RouteProgress &progress, std::uint32_t edge) const {
+  if (isFinished(progress)) {
+    return false;
+  }
+  const std::uint32_t *edges = getEdges(progress.route);
+  const std::uint32_t n = static_cast<std::uint32_t>(getNumEdges(progress.route));
+  for (std::uint32_t i = progress.index; i < n; ++i) {
+    if (edges[i] == edge) {
+      progress.index = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+std::size_t RouteTable::getMemoryUsage() const {
+  return m_edges.capacity() * sizeof(std::uint32_t) +
+         m_lanes.capacity() * sizeof(std::uint8_t) +
+         m_routes.capacity() * sizeof(Entry) +
+         m_index.size() * (sizeof(std::uint64_t) + sizeof(RouteId) +
+                           2 * sizeof(void *)) +
+         m_index.bucket_count() * sizeof(void *);
+}
+
+} // namespace routing
+} // namespace kernel
+} // namespace jamfree
@@ -0,0 +1,361 @@
+#include "../../include/routing/Router.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+
+namespace jamfree {
+namespace kernel {
+namespace routing {
+
+using fr::univ_artois::lgi2a::similar::microkernel::engine::
+    WorkStealingThreadPool;
+
+namespace {
+
+// Trips by task of findRoutes(), a query settling thousands of nodes
+constexpr std::size_t ROUTE_CHUNK_SIZE = 16;
+
+// Trips routed at once by TripGenerator::generateTrips() into a table
+constexpr std::size_t TRIP_BATCH_SIZE = 4096;
+
+constexpr double SECONDS_PER_PERIOD = 3600.0;
+
+constexpr double INFINITE = std::numeric_limits<double>::infinity();
+
+// Speed above which AVOID_HIGHWAYS doubles the cost of a road (90 km/h)
+constexpr double HIGHWAY_SPEED = 25.0;
+
+double freeFlowSpeed(const model::Road &road) {
+  double speed = 0.0;
+  for (const auto &lane : road.getLanes()) {
+    speed = std::max(speed, lane->getSpeedLimit());
+  }
+  return speed;
+}
+
+} // namespace
+
+void Router::SearchState::resize(std::size_t num_nodes) {
+  if (generations.size() != num_nodes) {
+    g_costs.assign(num_nodes, INFINITE);
+    h_costs.assign(num_nodes, 0.0);
+    parent_edges.assign(num_nodes, RoadGraph::NONE);
+    generations.assign(num_nodes, 0);
+    closed.assign(num_nodes, 0);
+    generation = 0;
+  }
+}
+
+void Router::setNumThreads(std::size_t numThreads) {
+  if (numThreads > 1) {
+    m_pool = std::make_shared<WorkStealingThreadPool>(numThreads);
+  } else {
+    m_pool.reset();
+  }
+}
+
+void Router::setStrategy(Strategy strategy) {
+  if (strategy != m_strategy) {
+    m_strategy = strategy;
+    // The landmarks of the former costs
+    m_landmarks.reset();
+  }
+}
+
+void Router::preprocess(const std::vector<std::shared_ptr<model::Road>> &roads,
+                        std::size_t num_landmarks) {
+  m_num_landmarks = num_landmarks;
+  m_graph.reset();
+  ensurePreprocessed(roads);
+}
+
+void Router::ensurePreprocessed(
+    const std::vector<std::shared_ptr<model::Road>> &roads) {
+  // The same roads, as far as a query can tell in constant time
+  if (!m_graph || roads.size() != m_num_roads ||
+      (!roads.empty() && roads.front().get() != m_first_road)) {
+    m_graph = std::make_shared<RoadGraph>(roads);
+    m_num_roads = roads.size();
+    m_first_road = roads.empty() ? nullptr : roads.front().get();
+    m_landmarks.reset();
+  }
+
+  if (!m_landmarks) {
+    std::vector<double> weights(m_graph->getNumEdges());
+    for (std::uint32_t edge = 0; edge < weights.size(); ++edge) {
+      const auto &road = m_graph->getRoad(edge);
+      weights[edge] = calculateCost(road, freeFlowSpeed(*road), 0.0);
+    }
+    m_landmarks =
+        std::make_shared<Landmarks>(*m_graph, weights, m_num_landmarks);
+  }
+}
+
+Route Router::findRoute(const model::Point2D &origin,
+                        const model::Point2D &destination,
+                        const std::vector<std::shared_ptr<model::Road>> &roads,
+                        double current_time) {
+  ensurePreprocessed(roads);
+  m_state.resize(m_graph->getNumNodes());
+  return search(m_state, origin, destination, nullptr, nullptr,
+                current_time);
+}
+
+Route Router::findRouteWithTraffic(
+    const model::Point2D &origin, const model::Point2D &destination,
+    const std::vector<std::shared_ptr<model::Road>> &roads,
+    const std::unordered_map<std::string, double> &traffic_speeds) {
+  ensurePreprocessed(roads);
+  m_state.resize(m_graph->getNumNodes());
+  return search(m_state, origin, destination, &traffic_speeds, nullptr, 0.0);
+}
+
+std::vector<Route>
+Router::findRoutes(const std::vector<ODPair> &trips,
+                   const std::vector<std::shared_ptr<model::Road>> &roads,
+                   const std::vector<double> &travel_times) {
+  ensurePreprocessed(roads);
+  if (!travel_times.empty() && travel_times.size() != m_graph->getNumEdges()) {
+    throw std::invalid_argument(
+        "Router::findRoutes: one travel time by edge expected");
+  }
+  const std::vector<double> *times =
+      travel_times.empty() ? nullptr : &travel_times;
+
+  std::unique_ptr<WorkStealingThreadPool::Scope> scope;
+  if (m_pool && WorkStealingThreadPool::currentSize() == 1) {
+    scope = std::make_unique<WorkStealingThreadPool::Scope>(m_pool.get());
+  }
+  const std::size_t num_workers = WorkStealingThreadPool::currentSize();
+  if (m_worker_states.size() < num_workers) {
+    m_worker_states.resize(num_workers);
+  }
+  for (std::size_t w = 0; w < num_workers; ++w) {
+    m_worker_states[w].resize(m_graph->getNumNodes());
+  }
+
+  std::vector<Route> routes(trips.size());
+  WorkStealingThreadPool::parallelForOnCurrent(
+      trips.size(), ROUTE_CHUNK_SIZE,
+      [&](std::size_t begin, std::size_t end, std::size_t worker) {
+        SearchState &state = m_worker_states[worker];
+        for (std::size_t i = begin; i < end; ++i) {
+          routes[i] = search(state, trips[i].origin, trips[i].destination,
+                             nullptr, times, trips[i].departure_time);
+        }
+      });
+  return routes;
+}
+
+double Router::calculateCost(const std::shared_ptr<model::Road> &road,
+                             double current_speed, double) const {
+  const double length = road->getLength();
+  if (m_strategy == Strategy::SHORTEST_DISTANCE) {
+    return length;
+  }
+  if (current_speed <= 0.0) {
+    return INFINITE;
+  }
+  // Travel time; the roads carry no toll nor other cost
+  double cost = length / current_speed;
+  if (m_strategy == Strategy::AVOID_HIGHWAYS &&
+      freeFlowSpeed(*road) > HIGHWAY_SPEED) {
+    cost *= 2.0;
+  }
+  return cost;
+}
+
+double Router::heuristic(const model::Point2D &from,
+                         const model::Point2D &to) const {
+  const double distance = from.distanceTo(to);
+  if (m_strategy == Strategy::SHORTEST_DISTANCE) {
+    return distance;
+  }
+  const double max_speed = m_graph->getMaxSpeed();
+  return max_speed > 0.0 ? distance / max_speed : 0.0;
+}
+
+Route Router::search(
+    SearchState &state, const model::Point2D &origin,
+    const model::Point2D &destination,
+    const std::unordered_map<std::string, double> *traffic_speeds,
+    const std::vector<double> *travel_times, double current_time) const {
+  Route route;
+  const std::uint32_t source = m_graph->findNearestNode(origin);
+  const std::uint32_t target = m_graph->findNearestNode(destination);
+  if (source == RoadGraph::NONE || source == target) {
+    return route;
+  }
+
+  std::vector<double> &g_costs = state.g_costs;
+  std::vector<double> &h_costs = state.h_costs;
+  std::vector<std::uint32_t> &parent_edges = state.parent_edges;
+  std::vector<std::uint32_t> &generations = state.generations;
+  std::vector<std::uint8_t> &closed = state.closed;
+  if (++state.generation == 0) {
+    std::fill(generations.begin(), generations.end(), 0);
+    state.generation = 1;
+  }
+  const std::uint32_t generation = state.generation;
+  const model::Point2D &goal = m_graph->getPosition(target);
+  auto reach = [&](std::uint32_t node) {
+    if (generations[node] != generation) {
+      generations[node] = generation;
+      g_costs[node] = INFINITE;
+      h_costs[node] = std::max(m_landmarks->lowerBound(node, target),
+                               heuristic(m_graph->getPosition(node), goal));
+      parent_edges[node] = RoadGraph::NONE;
+      closed[node] = 0;
+    }
+  };
+
+  // The preprocessed costs, or the costs at the traffic speeds or times
+  const std::vector<double> &weights = m_landmarks->getWeights();
+  const std::vector<double> &free_times = m_graph->getTimes();
+  const bool timed = m_strategy != Strategy::SHORTEST_DISTANCE;
+  auto edgeCost = [&](std::uint32_t edge) {
+    if (travel_times && timed) {
+      // The cost of the free-flow time, scaled to the travel time
+      const double free_time = free_times[edge];
+      if (free_time > 0.0 && free_time != INFINITE) {
+        return std::max(weights[edge],
+                        weights[edge] / free_time * (*travel_times)[edge]);
+      }
+    } else if (traffic_speeds && timed) {
+      const auto &road = m_graph->getRoad(edge);
+      auto it = traffic_speeds->find(road->getId());
+      if (it != traffic_speeds->end()) {
+        const double speed = std::min(it->second, freeFlowSpeed(*road));
+        return std::max(weights[edge],
+                        calculateCost(road, speed, current_time));
+      }
+    }
+    return weights[edge];
+  };
+
+  using Entry = std::pair<double, std::uint32_t>;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+  reach(source);
+  g_costs[source] = 0.0;
+  open.emplace(h_costs[source], source);
+  while (!open.empty()) {
+    const std::uint32_t node = open.top().second;
+    open.pop();
+    if (closed[node]) {
+      continue;
+    }
+    closed[node] = 1;
+    if (node == target) {
+      break;
+    }
+    for (std::uint32_t edge = m_graph->getFirstEdge(node);
+         edge < m_graph->getFirstEdge(node + 1); ++edge) {
+      const std::uint32_t next = m_graph->getTarget(edge);
+      reach(next);
+      const double g_cost = g_costs[node] + edgeCost(edge);
+      if (g_cost < g_costs[next] && h_costs[next] != INFINITE) {
+        g_costs[next] = g_cost;
+        parent_edges[next] = edge;
+        open.emplace(g_cost + h_costs[next], next);
+      }
+    }
+  }
+
+  if (generations[target] != generation || g_costs[target] == INFINITE) {
+    route.cost = INFINITE;
+    return route;
+  }
+
+  // The edges from the target back to the source
+  std::vector<std::uint32_t> edges;
+  for (std::uint32_t node = target; node != source;
+       node = m_graph->getSource(parent_edges[node])) {
+    edges.push_back(parent_edges[node]);
+  }
+  std::reverse(edges.begin(), edges.end());
+  route.roads.reserve(edges.size());
+  route.lane_indices.assign(edges.size(), 0);
+  for (std::uint32_t edge : edges) {
+    const auto &road = m_graph->getRoad(edge);
+    route.roads.push_back(road);
+    route.total_distance += road->getLength();
+    if (travel_times) {
+      route.estimated_time +=
+          std::max(free_times[edge], (*travel_times)[edge]);
+      continue;
+    }
+    double speed = freeFlowSpeed(*road);
+    if (traffic_speeds) {
+      auto it = traffic_speeds->find(road->getId());
+      if (it != traffic_speeds->end()) {
+        speed = std::min(speed, it->second);
+      }
+    }
+    route.estimated_time += speed > 0.0 ? road->getLength() / speed : INFINITE;
+  }
+  route.cost = g_costs[target];
+  return route;
+}
+
+std::pair<ODPair, Route> TripGenerator::generateTrip(
+    double current_time,
+    const std::vector<std::shared_ptr<model::Road>> &roads) {
+  const int time_period =
+      static_cast<int>(std::floor(current_time / SECONDS_PER_PERIOD));
+  ODPair trip = m_od_matrix.sampleODPair(time_period);
+  trip.departure_time = current_time;
+  Route route =
+      m_router.findRoute(trip.origin, trip.destination, roads, current_time);
+  return {std::move(trip), std::move(route)};
+}
+
+std::vector<std::pair<ODPair, Route>> TripGenerator::generateTrips(
+    int time_period, int num_trips,
+    const std::vector<std::shared_ptr<model::Road>> &roads) {
+  std::vector<ODPair> trips;
+  trips.reserve(std::max(num_trips, 0));
+  for (int i = 0; i < num_trips; ++i) {
+    trips.push_back(m_od_matrix.sampleODPair(time_period));
+  }
+  std::vector<Route> routes = m_router.findRoutes(trips, roads);
+  std::vector<std::pair<ODPair, Route>> result;
+  result.reserve(trips.size());
+  for (std::size_t i = 0; i < trips.size(); ++i) {
+    result.emplace_back(std::move(trips[i]), std::move(routes[i]));
+  }
+  return result;
+}
+
+std::vector<std::pair<ODPair, RouteProgress>> TripGenerator::generateTrips(
+    int time_period, int num_trips,
+    const std::vector<std::shared_ptr<model::Road>> &roads,
+    RouteTable &table) {
+  std::vector<std::pair<ODPair, RouteProgress>> result;
+  result.reserve(std::max(num_trips, 0));
+  std::vector<ODPair> batch;
+  for (int done = 0; done < num_trips;) {
+    const int count =
+        std::min(num_trips - done, static_cast<int>(TRIP_BATCH_SIZE));
+    batch.clear();
+    for (int i = 0; i < count; ++i) {
+      batch.push_back(m_od_matrix.sampleODPair(time_period));
+    }
+    std::vector<Route> routes = m_router.findRoutes(batch, roads);
+    if (m_router.getGraph() != &table.getGraph()) {
+      throw std::invalid_argument(
+          "TripGenerator::generateTrips: table not of the graph of the router");
+    }
+    for (int i = 0; i < count; ++i) {
+      result.emplace_back(std::move(batch[i]),
+                          RouteTable::begin(table.intern(routes[i])));
+    }
+    done += count;
+  }
+  return result;
+}
+
+} // namespace routing
+} // namespace kernel
+} // namespace jamfree
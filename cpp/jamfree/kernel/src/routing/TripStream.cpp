@@ -0,0 +1,141 @@
+#include "../../include/routing/TripStream.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace jamfree {
+namespace kernel {
+namespace routing {
+
+namespace {
+
+constexpr double SECONDS_PER_PERIOD = 3600.0;
+
+} // namespace
+
+TripStream::TripStream(const ODMatrix &od_matrix, Router &router,
+                       const std::vector<std::shared_ptr<model::Road>> &roads,
+                       RouteTable &table)
+    : TripStream(od_matrix, router, roads, table, Config()) {}
+
+TripStream::TripStream(const ODMatrix &od_matrix, Router &router,
+                       const std::vector<std::shared_ptr<model::Road>> &roads,
+                       RouteTable &table, const Config &config)
+    : m_od_matrix(od_matrix), m_router(router), m_roads(roads),
+      m_table(table), m_config(config), m_rng(config.seed),
+      m_generated_time(config.start_time) {
+  if (!(config.slice_length > 0.0) || !(config.lookahead >= 0.0) ||
+      config.batch_size == 0) {
+    throw std::invalid_argument(
+        "TripStream: slice length and batch size must be positive, "
+        "lookahead non-negative");
+  }
+}
+
+void TripStream::prepare(double time) {
+  const double horizon = time + m_config.lookahead;
+  while (m_generated_time <= horizon) {
+    const int time_period =
+        static_cast<int>(std::floor(m_generated_time / SECONDS_PER_PERIOD));
+    const double end =
+        std::min(m_generated_time + m_config.slice_length,
+                 (time_period + 1) * SECONDS_PER_PERIOD);
+    generateSlice(time_period, m_generated_time, end);
+    m_generated_time = end;
+  }
+}
+
+void TripStream::generateSlice(int time_period, double begin, double end) {
+  const double expected =
+      m_od_matrix.getTotalDemand(time_period) * (end - begin) /
+          SECONDS_PER_PERIOD +
+      m_carry;
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  // Rounded at random, so that the slices add up to the demand
+  const std::size_t count = static_cast<std::size_t>(
+      std::max(0.0, std::floor(expected + uniform(m_rng))));
+  m_carry = expected - count;
+  if (count == 0) {
+    return;
+  }
+
+  m_slice.clear();
+  for (std::size_t done = 0; done < count;) {
+    const std::size_t size = std::min(count - done, m_config.batch_size);
+    m_batch.clear();
+    for (std::size_t i = 0; i < size; ++i) {
+      m_batch.push_back(m_od_matrix.sampleODPair(time_period));
+      m_batch.back().departure_time = begin + uniform(m_rng) * (end - begin);
+    }
+    std::vector<Route> routes = m_router.findRoutes(m_batch, m_roads);
+    if (m_router.getGraph() != &m_table.getGraph()) {
+      throw std::invalid_argument(
+          "TripStream: table not of the graph of the router");
+    }
+    for (std::size_t i = 0; i < size; ++i) {
+      const std::uint64_t id = m_next_id++;
+      const RouteTable::RouteId route = m_table.intern(routes[i]);
+      if (route == RouteTable::NONE) {
+        ++m_num_unrouted;
+        continue;
+      }
+      m_slice.push_back(
+          {id, m_batch[i].departure_time, RouteTable::begin(route)});
+    }
+    done += size;
+  }
+  // The slices follow each other, so the queue stays sorted
+  std::sort(m_slice.begin(), m_slice.end(),
+            [](const Trip &a, const Trip &b) {
+              return a.departure_time < b.departure_time;
+            });
+  m_pending.insert(m_pending.end(), m_slice.begin(), m_slice.end());
+}
+
+std::size_t TripStream::popDue(double time, std::vector<Trip> &trips) {
+  prepare(time);
+  std::size_t count = 0;
+  while (!m_pending.empty() && m_pending.front().departure_time <= time) {
+    trips.push_back(m_pending.front());
+    m_pending.pop_front();
+    ++count;
+  }
+  return count;
+}
+
+std::size_t TripStream::inject(double time, double min_gap,
+                               const VehicleFactory &make) {
+  m_due.clear();
+  popDue(time, m_due);
+  m_waiting.insert(m_waiting.end(), m_due.begin(), m_due.end());
+
+  std::size_t injected = 0;
+  std::deque<Trip> still_waiting;
+  for (const Trip &trip : m_waiting) {
+    const model::Road *road = m_table.getCurrentRoad(trip.route);
+    const int lane_index =
+        std::min(m_table.getCurrentLane(trip.route), road->getNumLanes() - 1);
+    std::shared_ptr<model::Lane> lane = road->getLane(lane_index);
+    const auto &vehicles = lane->getVehicles();
+    if (!vehicles.empty() && vehicles.front()->getLanePosition() < min_gap) {
+      still_waiting.push_back(trip);
+      continue;
+    }
+    std::shared_ptr<model::Vehicle> vehicle = make(trip, lane);
+    if (!vehicle) {
+      continue;
+    }
+    vehicle->setCurrentLane(lane);
+    vehicle->setLanePosition(0.0);
+    vehicle->invalidatePosition();
+    lane->addVehicle(vehicle);
+    ++injected;
+  }
+  m_waiting.swap(still_waiting);
+  m_num_injected += injected;
+  return injected;
+}
+
+} // namespace routing
+} // namespace kernel
+} // namespace jamfree
@@ -0,0 +1,593 @@
+#include "../../include/simulation/DistributedSimulation.h"
+#include "../../../../microkernel/include/checkpoint/CheckpointStream.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+
+namespace jamfree {
+namespace kernel {
+namespace simulation {
+
+using fr::univ_artois::lgi2a::similar::microkernel::checkpoint::
+    CheckpointReader;
+using fr::univ_artois::lgi2a::similar::microkernel::checkpoint::
+    CheckpointWriter;
+
+namespace {
+
+constexpr double NO_VEHICLE = std::numeric_limits<double>::infinity();
+
+// Lane entered on an edge from lane `lane` of the previous one
+int nextLane(const model::Road &road, int lane) {
+  return std::min(lane, road.getNumLanes() - 1);
+}
+
+void writeEntry(CheckpointWriter &writer, const model::Vehicle &vehicle,
+                std::uint32_t edge, int lane,
+                const std::vector<std::uint32_t> &edges, std::size_t leg) {
+  writer.writeString(vehicle.getId());
+  writer.writeDouble(vehicle.getLength());
+  writer.writeDouble(vehicle.getMaxSpeed());
+  writer.writeDouble(vehicle.getMaxAccel());
+  writer.writeDouble(vehicle.getMaxDecel());
+  writer.writeDouble(vehicle.getSpeed());
+  writer.writeDouble(vehicle.getAcceleration());
+  writer.writeDouble(vehicle.getLanePosition());
+  writer.writeU32(edge);
+  writer.writeU32(static_cast<std::uint32_t>(lane));
+  writer.writeU64(edges.size() - leg);
+  for (std::size_t i = leg; i < edges.size(); ++i) {
+    writer.writeU32(edges[i]);
+  }
+}
+
+// Reads a vehicle written by writeEntry(), with the rest of its route
+std::shared_ptr<model::Vehicle>
+readEntry(CheckpointReader &reader, std::uint32_t &edge, int &lane,
+          std::vector<std::uint32_t> &edges) {
+  const std::string id = reader.readString();
+  const double length = reader.readDouble();
+  const double max_speed = reader.readDouble();
+  const double max_accel = reader.readDouble();
+  const double max_decel = reader.readDouble();
+  auto vehicle = std::make_shared<model::Vehicle>(id, length, max_speed,
+                                                  max_accel, max_decel);
+  vehicle->setSpeed(reader.readDouble());
+  vehicle->setAcceleration(reader.readDouble());
+  vehicle->setLanePosition(reader.readDouble());
+  edge = reader.readU32();
+  lane = static_cast<int>(reader.readU32());
+  edges.resize(reader.readU64());
+  for (std::uint32_t &e : edges) {
+    e = reader.readU32();
+  }
+  return vehicle;
+}
+
+void writeTrip(CheckpointWriter &writer,
+               const DistributedSimulation::Trip &trip) {
+  writer.writeString(trip.id);
+  writer.writeU64(trip.edges.size());
+  for (std::uint32_t edge : trip.edges) {
+    writer.writeU32(edge);
+  }
+  writer.writeDouble(trip.departure);
+  writer.writeDouble(trip.length);
+  writer.writeDouble(trip.max_speed);
+  writer.writeDouble(trip.max_accel);
+  writer.writeDouble(trip.max_decel);
+}
+
+DistributedSimulation::Trip readTrip(CheckpointReader &reader) {
+  DistributedSimulation::Trip trip;
+  trip.id = reader.readString();
+  trip.edges.resize(reader.readU64());
+  for (std::uint32_t &edge : trip.edges) {
+    edge = reader.readU32();
+  }
+  trip.departure = reader.readDouble();
+  trip.length = reader.readDouble();
+  trip.max_speed = reader.readDouble();
+  trip.max_accel = reader.readDouble();
+  trip.max_decel = reader.readDouble();
+  return trip;
+}
+
+} // namespace
+
+DistributedSimulation::DistributedSimulation(
+    const routing::NetworkPartition &partition,
+    std::shared_ptr<IRankExchange> exchange,
+    const microscopic::models::IDM &idm, double dt)
+    : m_partition(&partition), m_graph(partition.getGraph()),
+      m_exchange(std::move(exchange)), m_idm(idm), m_dt(dt) {
+  if (!m_exchange) {
+    throw std::invalid_argument("A distributed simulation needs an exchange");
+  }
+  if (static_cast<std::size_t>(m_exchange->getSize()) !=
+      partition.getNumParts()) {
+    throw std::invalid_argument(
+        "A distributed simulation runs one rank per part");
+  }
+  m_rank = m_exchange->getRank();
+
+  const std::size_t num_edges = m_graph.getNumEdges();
+  m_first_lane.resize(num_edges + 1);
+  m_first_lane[0] = 0;
+  for (std::uint32_t edge = 0; edge < num_edges; ++edge) {
+    m_first_lane[edge + 1] =
+        m_first_lane[edge] + m_graph.getRoad(edge)->getNumLanes();
+    if (ownsEdge(edge)) {
+      m_owned_edges.push_back(edge);
+    }
+  }
+  m_rears.assign(m_first_lane.back(), Rear{NO_VEHICLE, 0.0});
+  buildPeers();
+}
+
+void DistributedSimulation::buildPeers() {
+  // The nodes of this part entered from each other part, whose outgoing
+  // lanes are sent, and the nodes of other parts entered from this one,
+  // whose outgoing lanes are received: both ranks list the same nodes
+  const std::size_t size = m_partition->getNumParts();
+  std::vector<std::vector<std::uint32_t>> sent_nodes(size);
+  std::vector<std::vector<std::uint32_t>> received_nodes(size);
+  for (std::uint32_t edge = 0; edge < m_graph.getNumEdges(); ++edge) {
+    const std::uint32_t target = m_graph.getTarget(edge);
+    const int from = static_cast<int>(m_partition->getPartOfEdge(edge));
+    const int to = static_cast<int>(m_partition->getPartOfNode(target));
+    if (from == to) {
+      continue;
+    }
+    if (to == m_rank) {
+      sent_nodes[from].push_back(target);
+    } else if (from == m_rank) {
+      received_nodes[to].push_back(target);
+    }
+  }
+
+  auto outgoingLanes = [this](std::vector<std::uint32_t> &nodes) {
+    std::sort(nodes.begin(), nodes.end());
+    nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+    std::vector<std::uint32_t> lanes;
+    for (std::uint32_t node : nodes) {
+      for (std::uint32_t edge = m_graph.getFirstEdge(node);
+           edge < m_graph.getFirstEdge(node + 1); ++edge) {
+        for (std::uint32_t lane = m_first_lane[edge];
+             lane < m_first_lane[edge + 1]; ++lane) {
+          lanes.push_back(lane);
+        }
+      }
+    }
+    return lanes;
+  };
+
+  m_peers.clear();
+  m_peer_lanes.clear();
+  m_peer_of_rank.assign(size, -1);
+  for (std::size_t rank = 0; rank < size; ++rank) {
+    if (sent_nodes[rank].empty() && received_nodes[rank].empty()) {
+      continue;
+    }
+    m_peer_of_rank[rank] = static_cast<int>(m_peers.size());
+    m_peers.push_back(static_cast<int>(rank));
+    m_peer_lanes.push_back(Peer{static_cast<int>(rank),
+                                outgoingLanes(sent_nodes[rank]),
+                                outgoingLanes(received_nodes[rank])});
+  }
+  m_handoffs.resize(m_peers.size());
+  m_outgoing.resize(m_peers.size());
+}
+
+void DistributedSimulation::addTrip(const Trip &trip) {
+  if (trip.edges.empty()) {
+    throw std::invalid_argument("The route of a trip is empty");
+  }
+  for (std::size_t i = 0; i < trip.edges.size(); ++i) {
+    if (trip.edges[i] >= m_graph.getNumEdges()) {
+      throw std::invalid_argument("The route of a trip has an unknown edge");
+    }
+    if (i > 0 && m_graph.getSource(trip.edges[i]) !=
+                     m_graph.getTarget(trip.edges[i - 1])) {
+      throw std::invalid_argument("The route of a trip is not connected");
+    }
+  }
+  if (!ownsEdge(trip.edges.front())) {
+    return;
+  }
+  auto later = std::upper_bound(
+      m_pending.begin(), m_pending.end(), trip.departure,
+      [](double departure, const Trip &t) { return departure < t.departure; });
+  m_pending.insert(later, trip);
+}
+
+void DistributedSimulation::setRebalancing(std::size_t period,
+                                           double threshold) {
+  if (!(threshold >= 1.0)) {
+    throw std::invalid_argument("The rebalancing threshold is below 1");
+  }
+  m_rebalance_period = period;
+  m_rebalance_threshold = threshold;
+  m_steps_since_rebalance = 0;
+  m_busy_time = 0.0;
+  m_edge_vehicles.assign(period > 0 ? m_graph.getNumEdges() : 0, 0.0);
+}
+
+void DistributedSimulation::step() {
+  exchangeRears();
+  if (m_rebalance_period > 0) {
+    const auto start = std::chrono::steady_clock::now();
+    moveVehicles();
+    m_busy_time += std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  } else {
+    moveVehicles();
+  }
+  exchangeHandoffs();
+  enterVehicles();
+  m_time += m_dt;
+  departVehicles();
+  rebalanceIfNeeded();
+}
+
+void DistributedSimulation::exchangeRears() {
+  for (std::uint32_t edge : m_owned_edges) {
+    const model::Road &road = *m_graph.getRoad(edge);
+    for (int l = 0; l < road.getNumLanes(); ++l) {
+      const auto &vehicles = road.getLane(l)->getVehicles();
+      m_rears[m_first_lane[edge] + l] =
+          vehicles.empty() ? Rear{NO_VEHICLE, 0.0}
+                           : Rear{vehicles.front()->getLanePosition(),
+                                  vehicles.front()->getSpeed()};
+    }
+  }
+
+  for (std::size_t p = 0; p < m_peer_lanes.size(); ++p) {
+    CheckpointWriter writer;
+    for (std::uint32_t lane : m_peer_lanes[p].sent_lanes) {
+      writer.writeDouble(m_rears[lane].position);
+      writer.writeDouble(m_rears[lane].speed);
+    }
+    m_outgoing[p] = writer.getBytes();
+  }
+  m_exchange->exchange(m_peers, m_outgoing, m_incoming);
+  for (std::size_t p = 0; p < m_peer_lanes.size(); ++p) {
+    CheckpointReader reader(m_incoming[p].data(), m_incoming[p].size());
+    for (std::uint32_t lane : m_peer_lanes[p].received_lanes) {
+      m_rears[lane].position = reader.readDouble();
+      m_rears[lane].speed = reader.readDouble();
+    }
+  }
+}
+
+void DistributedSimulation::moveVehicles() {
+  for (std::uint32_t edge : m_owned_edges) {
+    const model::Road &road = *m_graph.getRoad(edge);
+    for (int l = 0; l < road.getNumLanes(); ++l) {
+      model::Lane &lane = *road.getLane(l);
+      const auto &vehicles = lane.getVehicles();
+      const std::size_t n = vehicles.size();
+      if (n == 0) {
+        continue;
+      }
+      if (!m_edge_vehicles.empty()) {
+        m_edge_vehicles[edge] += static_cast<double>(n);
+      }
+
+      // The leader of the front vehicle is the rear one of the lane it
+      // enters next, as it was before any vehicle moved
+      m_speeds.resize(n);
+      m_gaps.resize(n);
+      m_relative_speeds.resize(n);
+      m_accelerations.resize(n);
+      for (std::size_t i = 0; i < n; ++i) {
+        const model::Vehicle &vehicle = *vehicles[i];
+        m_speeds[i] = vehicle.getSpeed();
+        m_gaps[i] = NO_VEHICLE;
+        m_relative_speeds[i] = 0.0;
+        if (i + 1 < n) {
+          m_gaps[i] = vehicle.getGapTo(*vehicles[i + 1]);
+          m_relative_speeds[i] = vehicle.getRelativeSpeedTo(*vehicles[i + 1]);
+          continue;
+        }
+        const Traveller &traveller = m_travellers.at(&vehicle);
+        if (traveller.leg + 1 == traveller.edges.size()) {
+          continue;
+        }
+        const std::uint32_t next = traveller.edges[traveller.leg + 1];
+        const Rear &rear = m_rears[m_first_lane[next] +
+                                   nextLane(*m_graph.getRoad(next), l)];
+        if (rear.position != NO_VEHICLE) {
+          m_gaps[i] = rear.position + lane.getLength() -
+                      (vehicle.getLanePosition() + vehicle.getLength());
+          m_relative_speeds[i] = vehicle.getSpeed() - rear.speed;
+        }
+      }
+      m_idm.computeAccelerations(m_speeds.data(), m_gaps.data(),
+                                 m_relative_speeds.data(),
+                                 m_accelerations.data(), n);
+
+      m_leaving.clear();
+      for (std::size_t i = 0; i < n; ++i) {
+        const std::shared_ptr<model::Vehicle> &vehicle = vehicles[i];
+        vehicle->update(m_dt, m_accelerations[i]);
+        if (vehicle->getLanePosition() < lane.getLength()) {
+          continue;
+        }
+        m_leaving.push_back(vehicle);
+        auto found = m_travellers.find(vehicle.get());
+        Traveller traveller = std::move(found->second);
+        m_travellers.erase(found);
+        if (traveller.leg + 1 == traveller.edges.size()) {
+          ++m_arrived;
+          continue;
+        }
+        ++traveller.leg;
+        const std::uint32_t next = traveller.edges[traveller.leg];
+        const model::Road &next_road = *m_graph.getRoad(next);
+        vehicle->setLanePosition(
+            std::min(vehicle->getLanePosition() - lane.getLength(),
+                     next_road.getLength()));
+        Entry entry{next, nextLane(next_road, l), std::move(traveller)};
+        if (ownsEdge(next)) {
+          m_entries.push_back(std::move(entry));
+        } else {
+          const int part = static_cast<int>(m_partition->getPartOfEdge(next));
+          m_handoffs[m_peer_of_rank[part]].push_back(std::move(entry));
+          ++m_handed_off;
+        }
+      }
+      if (!m_leaving.empty()) {
+        lane.removeVehicles(m_leaving);
+      }
+      lane.sortVehicles();
+    }
+  }
+}
+
+void DistributedSimulation::exchangeHandoffs() {
+  for (std::size_t p = 0; p < m_handoffs.size(); ++p) {
+    CheckpointWriter writer;
+    writer.writeU64(m_handoffs[p].size());
+    for (const Entry &entry : m_handoffs[p]) {
+      writeEntry(writer, *entry.traveller.vehicle, entry.edge, entry.lane,
+                 entry.traveller.edges, entry.traveller.leg);
+    }
+    m_outgoing[p] = writer.getBytes();
+    m_handoffs[p].clear();
+  }
+  m_exchange->exchange(m_peers, m_outgoing, m_incoming);
+
+  for (const auto &message : m_incoming) {
+    CheckpointReader reader(message.data(), message.size());
+    const std::uint64_t count = reader.readU64();
+    for (std::uint64_t k = 0; k < count; ++k) {
+      std::uint32_t edge;
+      int lane;
+      std::vector<std::uint32_t> edges;
+      auto vehicle = readEntry(reader, edge, lane, edges);
+      m_entries.push_back(
+          Entry{edge, lane, Traveller{std::move(vehicle), std::move(edges)}});
+    }
+  }
+}
+
+void DistributedSimulation::enterVehicles() {
+  // In an order independent of the partition, for the lanes to keep the
+  // vehicles of equal positions in the same order on any number of ranks
+  std::sort(m_entries.begin(), m_entries.end(),
+            [](const Entry &a, const Entry &b) {
+              const model::Vehicle &u = *a.traveller.vehicle;
+              const model::Vehicle &v = *b.traveller.vehicle;
+              return std::forward_as_tuple(a.edge, a.lane, u.getLanePosition(),
+                                           u.getId()) <
+                     std::forward_as_tuple(b.edge, b.lane, v.getLanePosition(),
+                                           v.getId());
+            });
+  for (Entry &entry : m_entries) {
+    const std::shared_ptr<model::Lane> &lane =
+        m_graph.getRoad(entry.edge)->getLane(entry.lane);
+    model::Vehicle &vehicle = *entry.traveller.vehicle;
+    vehicle.setCurrentLane(lane);
+    vehicle.invalidatePosition();
+    lane->addVehicle(entry.traveller.vehicle);
+    m_travellers.emplace(&vehicle, std::move(entry.traveller));
+  }
+  m_entries.clear();
+}
+
+void DistributedSimulation::departVehicles() {
+  auto departed = std::remove_if(
+      m_pending.begin(), m_pending.end(), [this](const Trip &trip) {
+        if (trip.departure > m_time) {
+          return false;
+        }
+        const std::shared_ptr<model::Lane> &lane =
+            m_graph.getRoad(trip.edges.front())->getLane(0);
+        const auto &vehicles = lane->getVehicles();
+        if (!vehicles.empty() && vehicles.front()->getLanePosition() <
+                                     trip.length + m_idm.getMinGap()) {
+          return false;
+        }
+        auto vehicle = std::make_shared<model::Vehicle>(
+            trip.id, trip.length, trip.max_speed, trip.max_accel,
+            trip.max_decel);
+        vehicle->setCurrentLane(lane);
+        vehicle->invalidatePosition();
+        lane->addVehicle(vehicle);
+        m_travellers.emplace(vehicle.get(), Traveller{vehicle, trip.edges});
+        ++m_departed;
+        return true;
+      });
+  m_pending.erase(departed, m_pending.end());
+}
+
+void DistributedSimulation::rebalanceIfNeeded() {
+  if (m_rebalance_period == 0 ||
+      ++m_steps_since_rebalance < m_rebalance_period) {
+    return;
+  }
+  // Every rank sees the times of all the ranks, and the same demand
+  const std::size_t size = m_partition->getNumParts();
+  std::vector<double> times(size, 0.0);
+  times[m_rank] = m_busy_time;
+  m_exchange->allReduceSum(times.data(), size);
+  std::vector<double> demand(m_edge_vehicles.size());
+  for (std::size_t edge = 0; edge < demand.size(); ++edge) {
+    demand[edge] = m_edge_vehicles[edge] / m_steps_since_rebalance;
+  }
+  m_steps_since_rebalance = 0;
+  m_busy_time = 0.0;
+  std::fill(m_edge_vehicles.begin(), m_edge_vehicles.end(), 0.0);
+
+  double total = 0.0;
+  double largest = 0.0;
+  for (double time : times) {
+    total += time;
+    largest = std::max(largest, time);
+  }
+  const double mean = total / size;
+  if (!(mean > 0.0) || largest <= m_rebalance_threshold * mean) {
+    return;
+  }
+  m_exchange->allReduceSum(demand.data(), demand.size());
+  auto partition =
+      std::make_unique<routing::NetworkPartition>(m_graph, size, demand);
+  if (partition->getNodeParts() == m_partition->getNodeParts()) {
+    return;
+  }
+  repartition(std::move(partition));
+  ++m_rebalance_count;
+}
+
+void DistributedSimulation::repartition(
+    std::unique_ptr<routing::NetworkPartition> partition) {
+  // The vehicles and the trips of the edges changing part leave for their
+  // new rank, every rank exchanging with all the others
+  const std::size_t size = partition->getNumParts();
+  std::vector<std::vector<Entry>> leaving(size);
+  for (std::uint32_t edge : m_owned_edges) {
+    const auto owner = partition->getPartOfEdge(edge);
+    if (static_cast<int>(owner) == m_rank) {
+      continue;
+    }
+    const model::Road &road = *m_graph.getRoad(edge);
+    for (int l = 0; l < road.getNumLanes(); ++l) {
+      model::Lane &lane = *road.getLane(l);
+      for (const auto &vehicle : lane.getVehicles()) {
+        auto found = m_travellers.find(vehicle.get());
+        leaving[owner].push_back(Entry{edge, l, std::move(found->second)});
+        m_travellers.erase(found);
+      }
+      lane.clearVehicles();
+    }
+  }
+  std::vector<std::vector<Trip>> trips(size);
+  auto moved = std::remove_if(
+      m_pending.begin(), m_pending.end(), [&](const Trip &trip) {
+        const auto owner = partition->getPartOfEdge(trip.edges.front());
+        if (static_cast<int>(owner) == m_rank) {
+          return false;
+        }
+        trips[owner].push_back(trip);
+        return true;
+      });
+  m_pending.erase(moved, m_pending.end());
+
+  std::vector<int> ranks;
+  std::vector<std::vector<std::uint8_t>> outgoing;
+  for (std::size_t rank = 0; rank < size; ++rank) {
+    if (static_cast<int>(rank) == m_rank) {
+      continue;
+    }
+    CheckpointWriter writer;
+    writer.writeU64(leaving[rank].size());
+    for (const Entry &entry : leaving[rank]) {
+      writeEntry(writer, *entry.traveller.vehicle, entry.edge, entry.lane,
+                 entry.traveller.edges, entry.traveller.leg);
+    }
+    writer.writeU64(trips[rank].size());
+    for (const Trip &trip : trips[rank]) {
+      writeTrip(writer, trip);
+    }
+    ranks.push_back(static_cast<int>(rank));
+    outgoing.push_back(writer.getBytes());
+  }
+  m_exchange->exchange(ranks, outgoing, m_incoming);
+
+  m_rebalanced = std::move(partition);
+  m_partition = m_rebalanced.get();
+  m_owned_edges.clear();
+  for (std::uint32_t edge = 0; edge < m_graph.getNumEdges(); ++edge) {
+    if (ownsEdge(edge)) {
+      m_owned_edges.push_back(edge);
+    }
+  }
+  buildPeers();
+
+  // The trips of each edge come from one rank, in their order
+  for (const auto &message : m_incoming) {
+    CheckpointReader reader(message.data(), message.size());
+    const std::uint64_t count = reader.readU64();
+    for (std::uint64_t k = 0; k < count; ++k) {
+      std::uint32_t edge;
+      int lane;
+      std::vector<std::uint32_t> edges;
+      auto vehicle = readEntry(reader, edge, lane, edges);
+      m_entries.push_back(
+          Entry{edge, lane, Traveller{std::move(vehicle), std::move(edges)}});
+    }
+    const std::uint64_t num_trips = reader.readU64();
+    for (std::uint64_t k = 0; k < num_trips; ++k) {
+      Trip trip = readTrip(reader);
+      auto later = std::upper_bound(m_pending.begin(), m_pending.end(),
+                                    trip.departure,
+                                    [](double departure, const Trip &t) {
+                                      return departure < t.departure;
+                                    });
+      m_pending.insert(later, std::move(trip));
+    }
+  }
+  enterVehicles();
+}
+
+DistributedSimulation::Statistics
+DistributedSimulation::getGlobalStatistics() {
+  double speeds = 0.0;
+  for (const auto &entry : m_travellers) {
+    speeds += entry.first->getSpeed();
+  }
+  double values[] = {static_cast<double>(m_travellers.size()),
+                     static_cast<double>(m_departed),
+                     static_cast<double>(m_arrived),
+                     static_cast<double>(m_handed_off), speeds};
+  m_exchange->allReduceSum(values, 5);
+
+  Statistics statistics;
+  statistics.vehicles = values[0];
+  statistics.departed = values[1];
+  statistics.arrived = values[2];
+  statistics.handed_off = values[3];
+  statistics.mean_speed = values[0] > 0.0 ? values[4] / values[0] : 0.0;
+  return statistics;
+}
+
+std::vector<std::shared_ptr<model::Vehicle>>
+DistributedSimulation::getVehicles() const {
+  std::vector<std::shared_ptr<model::Vehicle>> vehicles;
+  vehicles.reserve(m_travellers.size());
+  for (std::uint32_t edge : m_owned_edges) {
+    for (const auto &lane : m_graph.getRoad(edge)->getLanes()) {
+      vehicles.insert(vehicles.end(), lane->getVehicles().begin(),
+                      lane->getVehicles().end());
+    }
+  }
+  return vehicles;
+}
+
+} // namespace simulation
+} // namespace kernel
+} // namespace jamfree
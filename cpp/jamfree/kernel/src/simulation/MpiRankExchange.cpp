@@ -0,0 +1,106 @@
+#ifdef JAMFREE_HAS_MPI
+
+#include "../../include/simulation/MpiRankExchange.h"
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace jamfree {
+namespace kernel {
+namespace simulation {
+
+namespace {
+
+constexpr int SIZE_TAG = 1;
+constexpr int MESSAGE_TAG = 2;
+
+void check(int error, const char *operation) {
+  if (error != MPI_SUCCESS) {
+    throw std::runtime_error(std::string("MPI failed to ") + operation);
+  }
+}
+
+} // namespace
+
+MpiRankExchange::MpiRankExchange(MPI_Comm communicator)
+    : m_communicator(communicator) {
+  check(MPI_Comm_rank(communicator, &m_rank), "get the rank");
+  check(MPI_Comm_size(communicator, &m_size), "get the size");
+}
+
+void MpiRankExchange::exchange(
+    const std::vector<int> &peers,
+    const std::vector<std::vector<std::uint8_t>> &outgoing,
+    std::vector<std::vector<std::uint8_t>> &incoming) {
+  if (peers.size() != outgoing.size()) {
+    throw std::invalid_argument("A message is sent to each peer");
+  }
+  const std::size_t count = peers.size();
+  std::vector<unsigned long long> sent_sizes(count);
+  std::vector<unsigned long long> received_sizes(count);
+  std::vector<MPI_Request> requests;
+  requests.reserve(2 * count);
+  for (std::size_t i = 0; i < count; ++i) {
+    if (outgoing[i].size() >
+        static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+      throw std::length_error("A message exceeds the size of an MPI message");
+    }
+    sent_sizes[i] = outgoing[i].size();
+    requests.emplace_back();
+    check(MPI_Irecv(&received_sizes[i], 1, MPI_UNSIGNED_LONG_LONG, peers[i],
+                    SIZE_TAG, m_communicator, &requests.back()),
+          "receive a size");
+    requests.emplace_back();
+    check(MPI_Isend(&sent_sizes[i], 1, MPI_UNSIGNED_LONG_LONG, peers[i],
+                    SIZE_TAG, m_communicator, &requests.back()),
+          "send a size");
+  }
+  check(MPI_Waitall(static_cast<int>(requests.size()), requests.data(),
+                    MPI_STATUSES_IGNORE),
+        "exchange the sizes");
+
+  requests.clear();
+  incoming.resize(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    incoming[i].resize(static_cast<std::size_t>(received_sizes[i]));
+    requests.emplace_back();
+    check(MPI_Irecv(incoming[i].data(), static_cast<int>(received_sizes[i]),
+                    MPI_BYTE, peers[i], MESSAGE_TAG, m_communicator,
+                    &requests.back()),
+          "receive a message");
+    requests.emplace_back();
+    check(MPI_Isend(outgoing[i].data(), static_cast<int>(outgoing[i].size()),
+                    MPI_BYTE, peers[i], MESSAGE_TAG, m_communicator,
+                    &requests.back()),
+          "send a message");
+  }
+  check(MPI_Waitall(static_cast<int>(requests.size()), requests.data(),
+                    MPI_STATUSES_IGNORE),
+        "exchange the messages");
+}
+
+void MpiRankExchange::allReduceSum(double *values, std::size_t count) {
+  if (count == 0) {
+    return;
+  }
+  // Gathered, then added in the order of the ranks on every rank: the
+  // order of MPI_Allreduce is left to the implementation
+  std::vector<double> gathered(count * static_cast<std::size_t>(m_size));
+  check(MPI_Allgather(values, static_cast<int>(count), MPI_DOUBLE,
+                      gathered.data(), static_cast<int>(count), MPI_DOUBLE,
+                      m_communicator),
+        "gather the values");
+  for (std::size_t i = 0; i < count; ++i) {
+    double sum = 0.0;
+    for (int rank = 0; rank < m_size; ++rank) {
+      sum += gathered[rank * count + i];
+    }
+    values[i] = sum;
+  }
+}
+
+} // namespace simulation
+} // namespace kernel
+} // namespace jamfree
+
+#endif // JAMFREE_HAS_MPI
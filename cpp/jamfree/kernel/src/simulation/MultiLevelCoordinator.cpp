@@ -1,16 +1,47 @@
 #include "../../include/simulation/MultiLevelCoordinator.h"
 #include "../../include/levels/LevelIdentifiers.h"
 #include <iostream>
+#include <stdexcept>
+#include <utility>
 
 namespace jamfree {
 namespace kernel {
 namespace simulation {
 
+using fr::univ_artois::lgi2a::similar::microkernel::engine::
+    WorkStealingThreadPool;
+
+namespace {
+
+// Clone the states of an agent in a level, false if it has none
+bool cloneLevelStates(agents::VehicleAgent &agent,
+                      const agents::LevelIdentifier &level,
+                      std::shared_ptr<agents::ILocalState> &publicState,
+                      std::shared_ptr<agents::ILocalState> &privateState) {
+  if (!agent.hasLevel(level)) {
+    return false;
+  }
+  auto sourcePublicState = agent.getPublicLocalState(level);
+  auto sourcePrivateState = agent.getPrivateLocalState(level);
+  if (!sourcePublicState || !sourcePrivateState) {
+    return false;
+  }
+  publicState = std::dynamic_pointer_cast<agents::ILocalState>(
+      sourcePublicState->clone());
+  privateState = std::dynamic_pointer_cast<agents::ILocalState>(
+      sourcePrivateState->clone());
+  return publicState && privateState;
+}
+
+} // namespace
+
 MultiLevelCoordinator::MultiLevelCoordinator()
     : m_current_time(0.0), m_step_count(0) {}
 
 void MultiLevelCoordinator::addLevel(const LevelConfig &config) {
-  m_levels.insert_or_assign(config.level, config);
+  if (m_levels.insert_or_assign(config.level, config).second) {
+    m_level_order.push_back(config.level);
+  }
   std::cout << "Added level: " << config.level.toString()
             << " (dt=" << config.time_step
             << "s, freq=" << config.update_frequency << ")" << std::endl;
@@ -22,16 +53,40 @@ void MultiLevelCoordinator::step() {
     return;
   }
 
-  // Update each level according to its frequency
-  for (auto &[level, config] : m_levels) {
-    if (!config.active) {
-      continue;
+  // The levels due this step, the independent ones updating at once
+  std::vector<const agents::LevelIdentifier *> independent;
+  std::vector<const agents::LevelIdentifier *> dependent;
+  for (const auto &level : m_level_order) {
+    const LevelConfig &config = m_levels.at(level);
+    if (config.active && shouldUpdateLevel(level)) {
+      (config.independent ? independent : dependent).push_back(&level);
     }
-
-    if (shouldUpdateLevel(level)) {
-      updateLevel(level);
+  }
+  if (m_pool && independent.size() > 1) {
+    m_pool->parallelFor(independent.size(), 1,
+                        [&](std::size_t begin, std::size_t end, std::size_t) {
+                          for (std::size_t i = begin; i < end; ++i) {
+                            updateLevel(*independent[i]);
+                          }
+                        });
+  } else {
+    for (const auto *level : independent) {
+      updateLevel(*level);
     }
   }
+  for (const auto *level : dependent) {
+    updateLevel(*level);
+  }
+
+  // The transitions requested by the updates, at one synchronization point
+  std::vector<Transition> transitions;
+  {
+    std::lock_guard<std::mutex> lock(m_transitions_mutex);
+    transitions.swap(m_pending_transitions);
+  }
+  if (!transitions.empty()) {
+    transitionAgents(transitions);
+  }
 
   // Synchronize state between levels
   synchronizeLevels();
@@ -67,41 +122,92 @@ void MultiLevelCoordinator::transitionAgent(
             << fromLevel.toString() << " to " << toLevel.toString()
             << std::endl;
 
-  // Get state from source level
-  auto sourcePublicState = agent->getPublicLocalState(fromLevel);
-  auto sourcePrivateState = agent->getPrivateLocalState(fromLevel);
-
-  if (!sourcePublicState || !sourcePrivateState) {
-    std::cerr << "Error: Agent " << agentId << " has no state in "
+  // Clone the states of the source level for the target level
+  std::shared_ptr<agents::ILocalState> targetPublicState;
+  std::shared_ptr<agents::ILocalState> targetPrivateState;
+  if (!cloneLevelStates(*agent, fromLevel, targetPublicState,
+                        targetPrivateState)) {
+    std::cerr << "Error: Agent " << agentId << " has no state to clone in "
               << fromLevel.toString() << std::endl;
     return;
   }
 
-  // Clone states to target level
-  auto targetPublicState = std::dynamic_pointer_cast<agents::ILocalState>(
-      sourcePublicState->clone());
-  auto targetPrivateState = std::dynamic_pointer_cast<agents::ILocalState>(
-      sourcePrivateState->clone());
+  // Enter the target level, or replace its states
+  if (agent->hasLevel(toLevel)) {
+    agent->excludeFromLevel(toLevel);
+  }
+  agent->includeNewLevel(toLevel, targetPublicState, targetPrivateState);
 
-  if (!targetPublicState || !targetPrivateState) {
-    std::cerr << "Error: Failed to clone states when transitioning agent "
-              << agentId << std::endl;
-    return;
+  // Update tracking
+  m_agent_levels[agentId].push_back(toLevel);
+
+  std::cout << "  Transition complete" << std::endl;
+}
+
+std::size_t MultiLevelCoordinator::transitionAgents(
+    const std::vector<Transition> &transitions) {
+  if (!m_engine) {
+    std::cerr << "Error: No simulation engine set" << std::endl;
+    return 0;
   }
 
-  // Add target level if not already present
-  if (!agent->hasLevel(toLevel)) {
-    agent->addLevel(toLevel);
+  // The clones, in parallel: the engine and the agents are only read
+  struct Move {
+    std::shared_ptr<agents::VehicleAgent> agent;
+    std::shared_ptr<agents::ILocalState> publicState;
+    std::shared_ptr<agents::ILocalState> privateState;
+  };
+  std::vector<Move> moves(transitions.size());
+  auto clone = [&](std::size_t begin, std::size_t end, std::size_t) {
+    for (std::size_t i = begin; i < end; ++i) {
+      auto agent = m_engine->getAgent(transitions[i].agent_id);
+      if (agent && cloneLevelStates(*agent, transitions[i].from_level,
+                                    moves[i].publicState,
+                                    moves[i].privateState)) {
+        moves[i].agent = std::move(agent);
+      }
+    }
+  };
+  if (m_pool && transitions.size() > 1) {
+    m_pool->parallelFor(transitions.size(), 0, clone);
+  } else {
+    clone(0, transitions.size(), 0);
   }
 
-  // Set states in target level
-  agent->setPublicLocalState(toLevel, targetPublicState);
-  agent->setPrivateLocalState(toLevel, targetPrivateState);
+  std::size_t applied = 0;
+  for (std::size_t i = 0; i < transitions.size(); ++i) {
+    Move &move = moves[i];
+    if (!move.agent) {
+      continue;
+    }
+    const agents::LevelIdentifier &toLevel = transitions[i].to_level;
+    if (move.agent->hasLevel(toLevel)) {
+      move.agent->excludeFromLevel(toLevel);
+    }
+    move.agent->includeNewLevel(toLevel, std::move(move.publicState),
+                                std::move(move.privateState));
+    m_agent_levels[transitions[i].agent_id].push_back(toLevel);
+    ++applied;
+  }
+  if (applied < transitions.size()) {
+    std::cerr << "Error: " << transitions.size() - applied << " of "
+              << transitions.size()
+              << " transitions had no agent or no state to clone"
+              << std::endl;
+  }
+  return applied;
+}
 
-  // Update tracking
-  m_agent_levels[agentId].push_back(toLevel);
+void MultiLevelCoordinator::requestTransition(
+    const std::string &agentId, const agents::LevelIdentifier &fromLevel,
+    const agents::LevelIdentifier &toLevel) {
+  std::lock_guard<std::mutex> lock(m_transitions_mutex);
+  m_pending_transitions.emplace_back(agentId, fromLevel, toLevel);
+}
 
-  std::cout << "  Transition complete" << std::endl;
+std::size_t MultiLevelCoordinator::getPendingTransitionCount() const {
+  std::lock_guard<std::mutex> lock(m_transitions_mutex);
+  return m_pending_transitions.size();
 }
 
 void MultiLevelCoordinator::synchronizeLevels() {
@@ -120,10 +226,31 @@ void MultiLevelCoordinator::synchronizeLevels() {
   // - Control → Both: Apply control signals (speed limits, signals)
 }
 
+void MultiLevelCoordinator::setLevelUpdate(
+    const agents::LevelIdentifier &level, LevelUpdate update) {
+  if (m_levels.find(level) == m_levels.end()) {
+    throw std::invalid_argument("MultiLevelCoordinator: unknown level " +
+                                level.toString());
+  }
+  m_level_updates[level] = std::move(update);
+}
+
+void MultiLevelCoordinator::setNumThreads(std::size_t numThreads) {
+  if (numThreads > 1) {
+    m_pool = std::make_unique<WorkStealingThreadPool>(numThreads);
+  } else {
+    m_pool.reset();
+  }
+}
+
 void MultiLevelCoordinator::reset() {
   m_current_time = 0.0;
   m_step_count = 0;
   m_agent_levels.clear();
+  {
+    std::lock_guard<std::mutex> lock(m_transitions_mutex);
+    m_pending_transitions.clear();
+  }
 
   if (m_engine) {
     m_engine->reset();
@@ -144,6 +271,12 @@ bool MultiLevelCoordinator::shouldUpdateLevel(
 }
 
 void MultiLevelCoordinator::updateLevel(const agents::LevelIdentifier &level) {
+  auto update = m_level_updates.find(level);
+  if (update != m_level_updates.end() && update->second) {
+    update->second(level, m_current_time, m_levels.at(level).time_step);
+    return;
+  }
+
   // Update specific level
   // For now, we use the main engine which updates all levels
   // In a full implementation, this would update only the specified level
@@ -0,0 +1,72 @@
+#include "../../include/simulation/RankExchange.h"
+#include <stdexcept>
+#include <utility>
+
+namespace jamfree {
+namespace kernel {
+namespace simulation {
+
+std::vector<std::shared_ptr<LocalRankExchange>>
+LocalRankExchange::createGroup(int size) {
+  if (size < 1) {
+    throw std::invalid_argument("A group holds at least one rank");
+  }
+  auto group = std::make_shared<Group>(size);
+  std::vector<std::shared_ptr<LocalRankExchange>> exchanges;
+  exchanges.reserve(static_cast<std::size_t>(size));
+  for (int rank = 0; rank < size; ++rank) {
+    exchanges.push_back(std::shared_ptr<LocalRankExchange>(
+        new LocalRankExchange(group, rank)));
+  }
+  return exchanges;
+}
+
+void LocalRankExchange::Group::await() {
+  std::unique_lock<std::mutex> lock(mutex);
+  const unsigned long arrival = generation;
+  if (++waiting == size) {
+    waiting = 0;
+    ++generation;
+    released.notify_all();
+    return;
+  }
+  released.wait(lock, [&] { return generation != arrival; });
+}
+
+void LocalRankExchange::exchange(
+    const std::vector<int> &peers,
+    const std::vector<std::vector<std::uint8_t>> &outgoing,
+    std::vector<std::vector<std::uint8_t>> &incoming) {
+  if (peers.size() != outgoing.size()) {
+    throw std::invalid_argument("A message is sent to each peer");
+  }
+  const auto size = static_cast<std::size_t>(m_group->size);
+  for (std::size_t i = 0; i < peers.size(); ++i) {
+    m_group->mailboxes[m_rank * size + peers[i]] = outgoing[i];
+  }
+  m_group->await();
+  incoming.resize(peers.size());
+  for (std::size_t i = 0; i < peers.size(); ++i) {
+    // Only this rank reads the mailbox, refilled after the next barrier
+    incoming[i].swap(m_group->mailboxes[peers[i] * size + m_rank]);
+    m_group->mailboxes[peers[i] * size + m_rank].clear();
+  }
+  m_group->await();
+}
+
+void LocalRankExchange::allReduceSum(double *values, std::size_t count) {
+  m_group->contributions[m_rank].assign(values, values + count);
+  m_group->await();
+  for (std::size_t i = 0; i < count; ++i) {
+    double sum = 0.0;
+    for (const auto &contribution : m_group->contributions) {
+      sum += contribution.at(i);
+    }
+    values[i] = sum;
+  }
+  m_group->await();
+}
+
+} // namespace simulation
+} // namespace kernel
+} // namespace jamfree
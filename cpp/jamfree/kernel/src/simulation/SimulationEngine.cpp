@@ -1,11 +1,33 @@
 #include "../../include/simulation/SimulationEngine.h"
+#include "../../../../microkernel/include/libs/ExecutionTracer.h"
 #include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <mutex>
 
 namespace jamfree {
 namespace kernel {
 namespace simulation {
 
+using fr::univ_artois::lgi2a::similar::microkernel::StepTimings;
+using fr::univ_artois::lgi2a::similar::microkernel::engine::
+    WorkStealingThreadPool;
+
+namespace {
+
+// The agents perceiving or deciding in a task of the thread pool
+constexpr std::size_t AGENT_CHUNK_SIZE = 64;
+
+// The agents created in a task of the thread pool
+constexpr std::size_t CREATION_CHUNK_SIZE = 1024;
+
+const agents::LevelIdentifier &microscopicLevel() {
+  static const agents::LevelIdentifier level("Microscopic");
+  return level;
+}
+
+} // namespace
+
 SimulationEngine::SimulationEngine(double dt)
     : m_dt(dt), m_current_time(0.0), m_step_count(0),
       m_global_state(std::make_shared<SimulationGlobalState>(0.0)) {}
@@ -16,42 +38,90 @@ void SimulationEngine::addAgent(std::shared_ptr<agents::VehicleAgent> agent) {
   }
 
   // Check if already exists
-  if (m_agents_by_id.find(agent->getId()) != m_agents_by_id.end()) {
+  if (!m_agent_indices.emplace(agent->getSymbol(), m_agents.size()).second) {
     std::cerr << "Warning: Agent " << agent->getId() << " already exists"
               << std::endl;
     return;
   }
 
   m_agents.push_back(agent);
-  m_agents_by_id[agent->getId()] = agent;
 }
 
-void SimulationEngine::removeAgent(const std::string &agentId) {
-  auto it = m_agents_by_id.find(agentId);
-  if (it == m_agents_by_id.end()) {
-    return;
+void SimulationEngine::addAgents(
+    const std::vector<std::shared_ptr<agents::VehicleAgent>> &agents) {
+  m_agents.reserve(m_agents.size() + agents.size());
+  m_agent_indices.reserve(m_agents.size() + agents.size());
+  for (const auto &agent : agents) {
+    addAgent(agent);
+  }
+}
+
+void SimulationEngine::addAgents(std::size_t count,
+                                 const AgentFactory &factory) {
+  std::vector<std::shared_ptr<agents::VehicleAgent>> created(count);
+  std::unique_ptr<WorkStealingThreadPool::Scope> scope;
+  if (m_pool && WorkStealingThreadPool::currentSize() == 1) {
+    scope = std::make_unique<WorkStealingThreadPool::Scope>(m_pool.get());
   }
+  WorkStealingThreadPool::parallelForOnCurrent(
+      count, CREATION_CHUNK_SIZE,
+      [&](std::size_t begin, std::size_t end, std::size_t) {
+        for (std::size_t i = begin; i < end; ++i) {
+          created[i] = factory(i);
+        }
+      });
+  addAgents(created);
+}
 
-  // Remove from vector
-  m_agents.erase(std::remove_if(m_agents.begin(), m_agents.end(),
-                                [&agentId](const auto &agent) {
-                                  return agent->getId() == agentId;
-                                }),
-                 m_agents.end());
+std::shared_ptr<agents::VehicleAgent>
+SimulationEngine::removeAgent(const std::string &agentId) {
+  agents::Symbol symbol;
+  if (!agents::Symbol::find(agentId, symbol)) {
+    return nullptr;
+  }
+  auto it = m_agent_indices.find(symbol);
+  if (it == m_agent_indices.end()) {
+    return nullptr;
+  }
 
-  // Remove from map
-  m_agents_by_id.erase(it);
+  // Swap with the last agent, then pop it
+  const std::size_t index = it->second;
+  m_agent_indices.erase(it);
+  auto removed = std::move(m_agents[index]);
+  if (index + 1 < m_agents.size()) {
+    m_agents[index] = std::move(m_agents.back());
+    m_agent_indices[m_agents[index]->getSymbol()] = index;
+  }
+  m_agents.pop_back();
+  return removed;
 }
 
 std::shared_ptr<agents::VehicleAgent>
 SimulationEngine::getAgent(const std::string &agentId) {
-  auto it = m_agents_by_id.find(agentId);
-  if (it != m_agents_by_id.end()) {
-    return it->second;
+  agents::Symbol symbol;
+  if (!agents::Symbol::find(agentId, symbol)) {
+    return nullptr;
+  }
+  return getAgent(symbol);
+}
+
+std::shared_ptr<agents::VehicleAgent>
+SimulationEngine::getAgent(agents::Symbol agentId) {
+  auto it = m_agent_indices.find(agentId);
+  if (it != m_agent_indices.end()) {
+    return m_agents[it->second];
   }
   return nullptr;
 }
 
+void SimulationEngine::setNumThreads(std::size_t numThreads) {
+  if (numThreads > 1) {
+    m_pool = std::make_unique<WorkStealingThreadPool>(numThreads);
+  } else {
+    m_pool.reset();
+  }
+}
+
 void SimulationEngine::setReactionModel(
     const agents::LevelIdentifier &level,
     std::shared_ptr<agents::IReactionModel> reactionModel) {
@@ -68,17 +138,70 @@ SimulationEngine::getReactionModel(const agents::LevelIdentifier &level) {
 }
 
 void SimulationEngine::step() {
+  SIMILAR_TRACE_SCOPE("jamfree", "step");
+  const std::unique_lock<std::shared_mutex> access(m_access_mutex);
   // Update global state time
   m_global_state->setTime(m_current_time);
 
+  // The phases split their loops over our pool, which the reaction models
+  // may use too, unless the caller lends one
+  std::unique_ptr<WorkStealingThreadPool::Scope> scope;
+  if (m_pool && WorkStealingThreadPool::currentSize() == 1) {
+    scope = std::make_unique<WorkStealingThreadPool::Scope>(m_pool.get());
+  }
+
+  // The phases are timed only when someone listens to the timings
+  using Clock = std::chrono::steady_clock;
+  const bool timed = static_cast<bool>(m_step_timing_listener);
+  StepTimings timings;
+  const Clock::time_point stepStart = timed ? Clock::now() : Clock::time_point();
+  Clock::time_point mark = stepStart;
+  auto lap = [&](StepTimings::Duration StepTimings::*phase) {
+    if (timed) {
+      const Clock::time_point now = Clock::now();
+      timings.*phase = std::chrono::duration_cast<StepTimings::Duration>(
+          now - mark);
+      mark = now;
+    }
+  };
+  if (timed) {
+    timings.timeLowerBound = agents::SimulationTimeStamp(m_step_count);
+    timings.timeUpperBound = agents::SimulationTimeStamp(m_step_count + 1);
+    timings.threadCount = WorkStealingThreadPool::currentSize();
+    timings.agentCount = m_agents.size();
+  }
+
   // Execute simulation cycle
-  perceptionPhase();
-  auto influences = decisionPhase();
-  reactionPhase(influences);
+  {
+    SIMILAR_TRACE_SCOPE("jamfree", "perception");
+    perceptionPhase();
+  }
+  lap(&StepTimings::perception);
+  agents::InfluencesMap influences;
+  {
+    SIMILAR_TRACE_SCOPE("jamfree", "decision");
+    influences = decisionPhase();
+  }
+  lap(&StepTimings::decision);
+  if (timed) {
+    timings.influenceCount = influences.size();
+  }
+  {
+    SIMILAR_TRACE_SCOPE("jamfree", "reaction");
+    reactionPhase(influences);
+  }
+  lap(&StepTimings::reaction);
 
   // Advance time
   m_current_time += m_dt;
   m_step_count++;
+
+  if (timed) {
+    timings.agentPhase = timings.perception + timings.decision;
+    timings.total =
+        std::chrono::duration_cast<StepTimings::Duration>(mark - stepStart);
+    m_step_timing_listener->stepTimed(timings);
+  }
 }
 
 void SimulationEngine::run(int numSteps) {
@@ -92,108 +215,122 @@ void SimulationEngine::reset() {
   m_step_count = 0;
   m_global_state->setTime(0.0);
   m_agents.clear();
-  m_agents_by_id.clear();
+  m_agent_indices.clear();
+  m_perceived_data.clear();
+  m_agent_influences.clear();
 }
 
 void SimulationEngine::perceptionPhase() {
   agents::SimulationTimeStamp t0(m_current_time);
   agents::SimulationTimeStamp t1(m_current_time + m_dt);
 
-  agents::LevelIdentifier microLevel("Microscopic");
-
-  for (auto &agent : m_agents) {
-    // For each level the agent participates in
-    // For now, we focus on microscopic level
-    auto levels = agent->getLevels();
-    if (levels.find(microLevel) == levels.end()) {
-      continue;
-    }
-
-    auto perceptionModel = agent->getPerceptionModel(microLevel);
-    if (!perceptionModel) {
-      continue;
-    }
+  m_perceived_data.resize(m_agents.size());
+  WorkStealingThreadPool::parallelForOnCurrent(
+      m_agents.size(), AGENT_CHUNK_SIZE,
+      [&](std::size_t begin, std::size_t end, std::size_t) {
+        for (std::size_t i = begin; i < end; ++i) {
+          perceiveAgent(i, t0, t1);
+        }
+      });
+}
 
-    // Get all public states for the agent
-    std::map<agents::LevelIdentifier, std::shared_ptr<agents::ILocalState>>
-        publicStates;
-    for (const auto &level : levels) {
-      auto pubState = agent->getPublicLocalState(level);
-      if (pubState) {
-        publicStates[level] = pubState;
-      }
-    }
+void SimulationEngine::perceiveAgent(std::size_t index,
+                                     const agents::SimulationTimeStamp &t0,
+                                     const agents::SimulationTimeStamp &t1) {
+  const agents::LevelIdentifier &microLevel = microscopicLevel();
+  auto &agent = m_agents[index];
+  // The data of the previous step, refilled in place when nobody holds them
+  std::shared_ptr<agents::IPerceivedData> recycled =
+      std::move(m_perceived_data[index]);
+  if (recycled && (recycled.use_count() != 1 || !recycled->reset(t0, t1))) {
+    recycled.reset();
+  }
 
-    auto privateState = agent->getPrivateLocalState(microLevel);
-    if (!privateState) {
-      continue;
-    }
+  // For each level the agent participates in
+  // For now, we focus on microscopic level. The states are borrowed from
+  // the agent, which holds them during the step.
+  const auto &publicStates = agent->borrowPublicLocalStates();
+  if (publicStates.find(microLevel) == publicStates.end()) {
+    return;
+  }
 
-    // Execute perception - it returns perceived data
-    auto perceivedData =
-        perceptionModel->perceive(t0, t1, publicStates, privateState, nullptr);
+  auto perceptionModel = agent->getPerceptionModel(microLevel);
+  if (!perceptionModel) {
+    return;
+  }
 
-    // TODO: Store perceived data in agent for decision phase
-    // For now, decision phase will re-perceive (inefficient but functional)
+  const auto &privateState = agent->borrowPrivateLocalState(microLevel);
+  if (!privateState) {
+    return;
   }
+
+  // Execute perception, the decision phase using its data
+  m_perceived_data[index] =
+      recycled ? perceptionModel->perceiveInPlace(t0, t1, publicStates,
+                                                  privateState, nullptr,
+                                                  recycled)
+               : perceptionModel->perceive(t0, t1, publicStates,
+                                           privateState, nullptr);
 }
 
 agents::InfluencesMap SimulationEngine::decisionPhase() {
   agents::SimulationTimeStamp t0(m_current_time);
   agents::SimulationTimeStamp t1(m_current_time + m_dt);
 
-  agents::InfluencesMap allInfluences;
-  agents::LevelIdentifier microLevel("Microscopic");
-
-  for (auto &agent : m_agents) {
-    auto levels = agent->getLevels();
-    if (levels.find(microLevel) == levels.end()) {
-      continue;
-    }
+  m_agent_influences.resize(m_agents.size());
+  WorkStealingThreadPool::parallelForOnCurrent(
+      m_agents.size(), AGENT_CHUNK_SIZE,
+      [&](std::size_t begin, std::size_t end, std::size_t) {
+        for (std::size_t i = begin; i < end; ++i) {
+          decideAgent(i, t0, t1);
+        }
+      });
 
-    auto decisionModel = agent->getDecisionModel(microLevel);
-    if (!decisionModel) {
-      continue;
+  // Merge influences in the order of the agents, whatever the threads
+  agents::InfluencesMap allInfluences;
+  for (auto &agentInfluences : m_agent_influences) {
+    if (agentInfluences) {
+      allInfluences.addAll(*agentInfluences);
+      agentInfluences.reset();
     }
+  }
 
-    auto publicState = agent->getPublicLocalState(microLevel);
-    auto privateState = agent->getPrivateLocalState(microLevel);
+  return allInfluences;
+}
 
-    if (!publicState || !privateState) {
-      continue;
-    }
+void SimulationEngine::decideAgent(std::size_t index,
+                                   const agents::SimulationTimeStamp &t0,
+                                   const agents::SimulationTimeStamp &t1) {
+  const agents::LevelIdentifier &microLevel = microscopicLevel();
+  auto &agent = m_agents[index];
+  const auto &publicStates = agent->borrowPublicLocalStates();
+  if (publicStates.find(microLevel) == publicStates.end()) {
+    return;
+  }
 
-    // Re-perceive (TODO: use stored perceived data from perception phase)
-    auto perceptionModel = agent->getPerceptionModel(microLevel);
-    std::shared_ptr<agents::IPerceivedData> perceivedData;
-
-    if (perceptionModel) {
-      std::map<agents::LevelIdentifier, std::shared_ptr<agents::ILocalState>>
-          publicStates;
-      for (const auto &level : levels) {
-        auto pubState = agent->getPublicLocalState(level);
-        if (pubState) {
-          publicStates[level] = pubState;
-        }
-      }
-      perceivedData = perceptionModel->perceive(t0, t1, publicStates,
-                                                privateState, nullptr);
-    }
+  auto decisionModel = agent->getDecisionModel(microLevel);
+  if (!decisionModel) {
+    return;
+  }
 
-    if (!perceivedData) {
-      continue;
-    }
+  const auto &publicState = agent->borrowPublicLocalState(microLevel);
+  const auto &privateState = agent->borrowPrivateLocalState(microLevel);
 
-    // Execute decision
-    auto agentInfluences = std::make_shared<agents::InfluencesMap>();
-    decisionModel->decide(t0, t1, m_global_state, publicState, privateState,
-                          perceivedData, agentInfluences);
+  if (!publicState || !privateState) {
+    return;
+  }
 
-    // Merge influences
-    allInfluences.addAll(*agentInfluences);
+  // The data of the perception phase
+  const auto &perceivedData = m_perceived_data[index];
+  if (!perceivedData) {
+    return;
   }
 
-  return allInfluences;
+  // Execute decision
+  auto agentInfluences = std::make_shared<agents::InfluencesMap>();
+  decisionModel->decide(t0, t1, m_global_state, publicState, privateState,
+                        perceivedData, agentInfluences);
+  m_agent_influences[index] = std::move(agentInfluences);
 }
 
 void SimulationEngine::reactionPhase(const agents::InfluencesMap &influences) {
@@ -0,0 +1,112 @@
+#include "../../include/simulation/SimulationRunner.h"
+#include <chrono>
+#include <stdexcept>
+
+namespace jamfree {
+namespace kernel {
+namespace simulation {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+Clock::duration milliseconds(double ms) {
+  return std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double, std::milli>(ms));
+}
+
+} // namespace
+
+SimulationRunner::SimulationRunner(StepFunction step, CaptureFunction capture)
+    : m_step(std::move(step)), m_capture(std::move(capture)) {
+  if (!m_step) {
+    throw std::invalid_argument("Simulation runner: a step is required");
+  }
+}
+
+SimulationRunner::~SimulationRunner() {
+  m_stop.store(true, std::memory_order_release);
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
+
+std::size_t SimulationRunner::runFor(std::size_t max_steps,
+                                     double wallclock_ms) {
+  if (max_steps == 0 && !(wallclock_ms > 0.0)) {
+    throw std::invalid_argument(
+        "Simulation runner: a number of steps or a duration is required");
+  }
+  if (m_thread.joinable()) {
+    throw std::logic_error("Simulation runner: the background thread runs");
+  }
+  const Clock::time_point deadline =
+      wallclock_ms > 0.0 ? Clock::now() + milliseconds(wallclock_ms)
+                         : Clock::time_point::max();
+  std::size_t steps = 0;
+  while ((max_steps == 0 || steps < max_steps) && Clock::now() < deadline) {
+    m_step();
+    ++steps;
+    m_num_steps.fetch_add(1, std::memory_order_relaxed);
+  }
+  capture();
+  return steps;
+}
+
+void SimulationRunner::start(double step_period_ms,
+                             std::size_t capture_every) {
+  if (m_thread.joinable()) {
+    throw std::logic_error("Simulation runner: the background thread runs");
+  }
+  m_stop.store(false, std::memory_order_relaxed);
+  m_error = nullptr;
+  m_running.store(true, std::memory_order_release);
+  m_thread = std::thread(&SimulationRunner::runBackground, this,
+                         step_period_ms, capture_every > 0 ? capture_every : 1);
+}
+
+void SimulationRunner::stop() {
+  m_stop.store(true, std::memory_order_release);
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+  if (m_error) {
+    std::exception_ptr error = m_error;
+    m_error = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void SimulationRunner::runBackground(double step_period_ms,
+                                     std::size_t capture_every) {
+  const Clock::duration period = milliseconds(step_period_ms);
+  Clock::time_point next = Clock::now();
+  std::size_t steps = 0;
+  try {
+    while (!m_stop.load(std::memory_order_acquire)) {
+      m_step();
+      m_num_steps.fetch_add(1, std::memory_order_relaxed);
+      if (++steps % capture_every == 0) {
+        capture();
+      }
+      if (step_period_ms > 0.0) {
+        next += period;
+        std::this_thread::sleep_until(next);
+      }
+    }
+  } catch (...) {
+    m_error = std::current_exception();
+  }
+  m_running.store(false, std::memory_order_release);
+}
+
+void SimulationRunner::capture() {
+  if (m_capture) {
+    m_capture(m_snapshots.back());
+    m_snapshots.publish();
+  }
+}
+
+} // namespace simulation
+} // namespace kernel
+} // namespace jamfree
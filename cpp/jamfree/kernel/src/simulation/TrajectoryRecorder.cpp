@@ -0,0 +1,525 @@
+#include "../../include/simulation/TrajectoryRecorder.h"
+#include "../../include/model/VehicleStateExport.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#ifdef JAMFREE_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+namespace jamfree {
+namespace kernel {
+namespace simulation {
+
+using fr::univ_artois::lgi2a::similar::microkernel::checkpoint::MappedFile;
+
+namespace {
+
+constexpr std::uint8_t VERSION = 1;
+constexpr std::uint8_t DEFLATED = 1;
+
+// Size of the header of a file, and of its trailer
+constexpr std::size_t HEADER_SIZE = 6;
+constexpr std::size_t TRAILER_SIZE = 12;
+
+// Largest payload a chunk may announce, inflated
+constexpr std::uint64_t MAX_PAYLOAD_SIZE = 1ull << 36;
+
+[[noreturn]] void malformed() {
+  throw std::runtime_error("Malformed trajectory file");
+}
+
+void writeVarint(std::vector<std::uint8_t> &out, std::uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<std::uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<std::uint8_t>(value));
+}
+
+void writeSignedVarint(std::vector<std::uint8_t> &out, std::int64_t value) {
+  writeVarint(out, (static_cast<std::uint64_t>(value) << 1) ^
+                       static_cast<std::uint64_t>(value >> 63));
+}
+
+void writeBits(std::vector<std::uint8_t> &out, std::uint64_t bits) {
+  for (std::size_t i = 0; i < sizeof(bits); ++i) {
+    out.push_back(static_cast<std::uint8_t>(bits >> (8 * i)));
+  }
+}
+
+std::uint64_t bitsOf(double value) {
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+double valueOf(std::uint64_t bits) {
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/**
+ * Reader of the fields of a chunk or of the index, in place.
+ */
+class ByteReader {
+public:
+  ByteReader(const std::uint8_t *data, std::size_t size)
+      : m_begin(data), m_pos(data), m_end(data + size) {}
+
+  std::size_t offset() const {
+    return static_cast<std::size_t>(m_pos - m_begin);
+  }
+  std::size_t remaining() const {
+    return static_cast<std::size_t>(m_end - m_pos);
+  }
+
+  std::uint8_t byte() {
+    if (m_pos >= m_end) {
+      malformed();
+    }
+    return *m_pos++;
+  }
+
+  std::uint64_t varint() {
+    std::uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      const std::uint8_t next = byte();
+      value |= static_cast<std::uint64_t>(next & 0x7f) << shift;
+      if (!(next & 0x80)) {
+        return value;
+      }
+    }
+    malformed();
+  }
+
+  std::int64_t svarint() {
+    const std::uint64_t value = varint();
+    return static_cast<std::int64_t>(value >> 1) ^
+           -static_cast<std::int64_t>(value & 1);
+  }
+
+  std::uint64_t bits() {
+    std::uint64_t value = 0;
+    for (std::size_t i = 0; i < sizeof(value); ++i) {
+      value |= static_cast<std::uint64_t>(byte()) << (8 * i);
+    }
+    return value;
+  }
+
+private:
+  const std::uint8_t *m_begin;
+  const std::uint8_t *m_pos;
+  const std::uint8_t *m_end;
+};
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// TrajectoryRecorder
+// ---------------------------------------------------------------------------
+
+TrajectoryRecorder::TrajectoryRecorder(const std::string &path)
+    : TrajectoryRecorder(path, Config()) {}
+
+TrajectoryRecorder::TrajectoryRecorder(const std::string &path,
+                                       const Config &config)
+    : m_config(config) {
+  if (config.keyframe_interval == 0 || config.max_pending_frames == 0) {
+    throw std::invalid_argument(
+        "Trajectory recorder: the key frame interval and the pending frames "
+        "must be positive");
+  }
+  m_file.open(path, std::ios::binary | std::ios::trunc);
+  if (!m_file) {
+    throw std::runtime_error("Trajectory recorder: cannot create " + path);
+  }
+  const std::uint8_t header[HEADER_SIZE] = {
+      'J', 'F', 'T', 'R', VERSION,
+      static_cast<std::uint8_t>(model::NUM_STATE_COLUMNS)};
+  write(header, sizeof(header));
+  m_thread = std::thread(&TrajectoryRecorder::runWriter, this);
+}
+
+TrajectoryRecorder::~TrajectoryRecorder() {
+  try {
+    close();
+  } catch (...) {
+  }
+}
+
+void TrajectoryRecorder::record(double time, std::vector<double> &rows) {
+  if (m_closed) {
+    throw std::logic_error("Trajectory recorder: the recorder is closed");
+  }
+  if (rows.size() % model::NUM_STATE_COLUMNS != 0) {
+    throw std::invalid_argument(
+        "Trajectory recorder: the rows must have all their columns");
+  }
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_changed.wait(lock, [this]() {
+      return m_error || m_pending.size() < m_config.max_pending_frames;
+    });
+    if (!m_error) {
+      Frame frame{time, {}};
+      if (!m_free.empty()) {
+        frame.rows.swap(m_free.back());
+        m_free.pop_back();
+      }
+      frame.rows.swap(rows);
+      m_pending.push_back(std::move(frame));
+    }
+  }
+  m_changed.notify_all();
+  rethrowError();
+  ++m_num_frames;
+}
+
+void TrajectoryRecorder::close() {
+  if (m_closed) {
+    return;
+  }
+  m_closed = true;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_changed.notify_all();
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+  m_file.close();
+  rethrowError();
+  if (!m_file) {
+    throw std::runtime_error("Trajectory recorder: cannot close the file");
+  }
+}
+
+void TrajectoryRecorder::rethrowError() {
+  std::exception_ptr error;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    error = m_error;
+    m_error = nullptr;
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void TrajectoryRecorder::runWriter() {
+  bool failed = false;
+  while (true) {
+    Frame frame;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_changed.wait(lock, [this]() { return m_stop || !m_pending.empty(); });
+      if (m_pending.empty()) {
+        break;
+      }
+      frame = std::move(m_pending.front());
+      m_pending.pop_front();
+    }
+    m_changed.notify_all();
+    if (!failed) {
+      try {
+        encode(frame);
+      } catch (...) {
+        failed = true;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_error = std::current_exception();
+        m_pending.clear();
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_free.push_back(std::move(frame.rows));
+    }
+    if (failed) {
+      m_changed.notify_all();
+    }
+  }
+  if (!failed) {
+    try {
+      writeChunk();
+      writeIndex();
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_error = std::current_exception();
+    }
+  }
+}
+
+void TrajectoryRecorder::encode(const Frame &frame) {
+  constexpr std::size_t columns = model::NUM_STATE_COLUMNS;
+  const std::size_t count = frame.rows.size() / columns;
+  if (m_chunk_frames == 0) {
+    // A key frame starts the chunk
+    m_chunks.push_back({m_offset, m_times.size(), 0});
+    m_previous.clear();
+  }
+  const std::size_t previous_count = m_previous.size() / columns;
+
+  // The bits of the values, column after column, and their differences
+  m_current.resize(count * columns);
+  writeVarint(m_payload, count);
+  for (std::size_t column = 0; column < columns; ++column) {
+    std::uint64_t *current = m_current.data() + column * count;
+    const std::uint64_t *previous =
+        m_previous.data() + column * previous_count;
+    for (std::size_t i = 0; i < count; ++i) {
+      current[i] = bitsOf(frame.rows[i * columns + column]);
+      const std::uint64_t before = i < previous_count ? previous[i] : 0;
+      writeSignedVarint(m_payload,
+                        static_cast<std::int64_t>(current[i] - before));
+    }
+  }
+  m_previous.swap(m_current);
+
+  m_times.push_back(frame.time);
+  ++m_chunks.back().num_frames;
+  if (++m_chunk_frames == m_config.keyframe_interval) {
+    writeChunk();
+  }
+}
+
+void TrajectoryRecorder::writeChunk() {
+  if (m_chunk_frames == 0) {
+    return;
+  }
+  std::uint8_t flags = 0;
+  const std::uint8_t *stored = m_payload.data();
+  std::size_t stored_size = m_payload.size();
+#ifdef JAMFREE_HAS_ZLIB
+  if (m_config.compress) {
+    uLongf length = compressBound(static_cast<uLong>(m_payload.size()));
+    m_stored.resize(length);
+    if (compress2(m_stored.data(), &length, m_payload.data(),
+                  static_cast<uLong>(m_payload.size()),
+                  Z_BEST_SPEED) == Z_OK &&
+        length < m_payload.size()) {
+      flags |= DEFLATED;
+      stored = m_stored.data();
+      stored_size = length;
+    }
+  }
+#endif
+  std::vector<std::uint8_t> header = {'J', 'C', flags};
+  writeVarint(header, m_payload.size());
+  writeVarint(header, stored_size);
+  write(header.data(), header.size());
+  write(stored, stored_size);
+  m_payload.clear();
+  m_chunk_frames = 0;
+}
+
+void TrajectoryRecorder::writeIndex() {
+  const std::uint64_t index_offset = m_offset;
+  std::vector<std::uint8_t> index = {'J', 'I'};
+  writeVarint(index, m_chunks.size());
+  for (const Chunk &chunk : m_chunks) {
+    writeVarint(index, chunk.offset);
+    writeVarint(index, chunk.first_frame);
+    writeVarint(index, chunk.num_frames);
+  }
+  writeVarint(index, m_times.size());
+  for (double time : m_times) {
+    writeBits(index, bitsOf(time));
+  }
+  writeBits(index, index_offset);
+  index.insert(index.end(), {'J', 'F', 'T', 'R'});
+  write(index.data(), index.size());
+  m_file.flush();
+  if (!m_file) {
+    throw std::runtime_error("Trajectory recorder: cannot write the file");
+  }
+}
+
+void TrajectoryRecorder::write(const std::uint8_t *bytes, std::size_t size) {
+  m_file.write(reinterpret_cast<const char *>(bytes),
+               static_cast<std::streamsize>(size));
+  if (!m_file) {
+    throw std::runtime_error("Trajectory recorder: cannot write the file");
+  }
+  m_offset += size;
+}
+
+// ---------------------------------------------------------------------------
+// TrajectoryReader
+// ---------------------------------------------------------------------------
+
+TrajectoryReader::TrajectoryReader(const std::string &path) {
+  try {
+    m_file = std::make_unique<MappedFile>(path);
+  } catch (const std::exception &) {
+    throw std::runtime_error("Trajectory reader: cannot open " + path);
+  }
+  const std::uint8_t *data = m_file->data();
+  const std::size_t size = m_file->size();
+  if (size < HEADER_SIZE + TRAILER_SIZE ||
+      std::memcmp(data, "JFTR", 4) != 0 || data[4] != VERSION ||
+      data[5] != model::NUM_STATE_COLUMNS) {
+    malformed();
+  }
+  const std::uint8_t *trailer = data + size - TRAILER_SIZE;
+  m_index_offset = ByteReader(trailer, TRAILER_SIZE).bits();
+  if (std::memcmp(trailer + 8, "JFTR", 4) != 0 ||
+      m_index_offset < HEADER_SIZE || m_index_offset > size - TRAILER_SIZE) {
+    malformed();
+  }
+
+  ByteReader index(data + m_index_offset,
+                   size - TRAILER_SIZE -
+                       static_cast<std::size_t>(m_index_offset));
+  if (index.byte() != 'J' || index.byte() != 'I') {
+    malformed();
+  }
+  // A chunk takes three bytes of the index at least, a time eight
+  const std::uint64_t num_chunks = index.varint();
+  if (num_chunks > index.remaining() / 3) {
+    malformed();
+  }
+  std::uint64_t frames = 0;
+  std::uint64_t offset = HEADER_SIZE;
+  m_chunks.resize(static_cast<std::size_t>(num_chunks));
+  for (Chunk &chunk : m_chunks) {
+    chunk.offset = index.varint();
+    chunk.first_frame = index.varint();
+    chunk.num_frames = index.varint();
+    if (chunk.offset < offset || chunk.offset >= m_index_offset ||
+        chunk.first_frame != frames || chunk.num_frames == 0) {
+      malformed();
+    }
+    offset = chunk.offset + 1;
+    frames += chunk.num_frames;
+  }
+  if (index.varint() != frames || frames > index.remaining() / 8) {
+    malformed();
+  }
+  m_times.resize(static_cast<std::size_t>(frames));
+  for (double &time : m_times) {
+    time = valueOf(index.bits());
+  }
+}
+
+TrajectoryReader::~TrajectoryReader() = default;
+
+std::size_t TrajectoryReader::findFrame(double time) const {
+  if (m_times.empty()) {
+    throw std::out_of_range("Trajectory reader: no frame");
+  }
+  const auto after = std::upper_bound(m_times.begin(), m_times.end(), time);
+  return after == m_times.begin()
+             ? 0
+             : static_cast<std::size_t>(after - m_times.begin()) - 1;
+}
+
+void TrajectoryReader::readFrame(std::size_t frame,
+                                 std::vector<double> &rows) {
+  if (frame >= m_times.size()) {
+    throw std::out_of_range("Trajectory reader: no such frame");
+  }
+  const auto next = std::upper_bound(
+      m_chunks.begin(), m_chunks.end(), frame,
+      [](std::size_t value, const Chunk &chunk) {
+        return value < chunk.first_frame;
+      });
+  const std::size_t chunk =
+      static_cast<std::size_t>(next - m_chunks.begin()) - 1;
+  const std::uint64_t local = frame - m_chunks[chunk].first_frame;
+  if (chunk != m_chunk || local + 1 < m_next_frame) {
+    loadChunk(chunk);
+  }
+  while (m_next_frame <= local) {
+    decodeFrame();
+  }
+
+  constexpr std::size_t columns = model::NUM_STATE_COLUMNS;
+  const std::size_t count = m_previous.size() / columns;
+  rows.resize(count * columns);
+  for (std::size_t column = 0; column < columns; ++column) {
+    const std::uint64_t *values = m_previous.data() + column * count;
+    for (std::size_t i = 0; i < count; ++i) {
+      rows[i * columns + column] = valueOf(values[i]);
+    }
+  }
+}
+
+void TrajectoryReader::loadChunk(std::size_t chunk) {
+  m_chunk = static_cast<std::size_t>(-1);
+  const std::uint64_t offset = m_chunks[chunk].offset;
+  const std::uint64_t end = chunk + 1 < m_chunks.size()
+                                ? m_chunks[chunk + 1].offset
+                                : m_index_offset;
+  ByteReader header(m_file->data() + offset,
+                    static_cast<std::size_t>(end - offset));
+  if (header.byte() != 'J' || header.byte() != 'C') {
+    malformed();
+  }
+  const std::uint8_t flags = header.byte();
+  const std::uint64_t payload_size = header.varint();
+  const std::uint64_t stored_size = header.varint();
+  if (payload_size > MAX_PAYLOAD_SIZE || stored_size > header.remaining() ||
+      (!(flags & DEFLATED) && stored_size != payload_size)) {
+    malformed();
+  }
+  const std::uint8_t *stored = m_file->data() + offset + header.offset();
+
+  if (flags & DEFLATED) {
+#ifdef JAMFREE_HAS_ZLIB
+    m_inflated.resize(static_cast<std::size_t>(payload_size));
+    uLongf length = static_cast<uLongf>(payload_size);
+    if (uncompress(m_inflated.data(), &length, stored,
+                   static_cast<uLong>(stored_size)) != Z_OK ||
+        length != payload_size) {
+      malformed();
+    }
+    m_payload = m_inflated.data();
+#else
+    throw std::runtime_error(
+        "Cannot inflate trajectory chunk: JamFree was built without zlib");
+#endif
+  } else {
+    m_payload = stored;
+  }
+  m_payload_size = static_cast<std::size_t>(payload_size);
+  m_chunk = chunk;
+  m_next_frame = 0;
+  m_position = 0;
+  m_previous.clear();
+}
+
+void TrajectoryReader::decodeFrame() {
+  if (m_next_frame >= m_chunks[m_chunk].num_frames) {
+    malformed();
+  }
+  constexpr std::size_t columns = model::NUM_STATE_COLUMNS;
+  ByteReader reader(m_payload + m_position, m_payload_size - m_position);
+  // A difference takes a byte at least
+  const std::uint64_t num_vehicles = reader.varint();
+  if (num_vehicles > reader.remaining() / columns) {
+    malformed();
+  }
+  const std::size_t count = static_cast<std::size_t>(num_vehicles);
+  const std::size_t previous_count = m_previous.size() / columns;
+  m_current.resize(count * columns);
+  for (std::size_t column = 0; column < columns; ++column) {
+    std::uint64_t *current = m_current.data() + column * count;
+    const std::uint64_t *previous =
+        m_previous.data() + column * previous_count;
+    for (std::size_t i = 0; i < count; ++i) {
+      const std::uint64_t before = i < previous_count ? previous[i] : 0;
+      current[i] = before + static_cast<std::uint64_t>(reader.svarint());
+    }
+  }
+  m_previous.swap(m_current);
+  m_position += reader.offset();
+  ++m_next_frame;
+}
+
+} // namespace simulation
+} // namespace kernel
+} // namespace jamfree
@@ -0,0 +1,58 @@
+#include "../../include/simulation/TrajectoryReplay.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace jamfree {
+namespace kernel {
+namespace simulation {
+
+namespace {
+
+const TrajectoryReader &checkFrames(const TrajectoryReader &reader) {
+  if (reader.getNumFrames() == 0) {
+    throw std::invalid_argument("Trajectory replay: the recording is empty");
+  }
+  return reader;
+}
+
+} // namespace
+
+TrajectoryReplay::TrajectoryReplay(const std::string &path)
+    : m_reader(path), m_time(checkFrames(m_reader).getTime(0)) {
+  updateFrame();
+}
+
+void TrajectoryReplay::setSpeed(double speed) {
+  if (!(speed >= 0.0) || !std::isfinite(speed)) {
+    throw std::invalid_argument(
+        "Trajectory replay: the speed must be positive or 0");
+  }
+  m_speed = speed;
+}
+
+void TrajectoryReplay::seek(double time) {
+  if (!std::isnan(time)) {
+    m_time = std::max(getStartTime(), std::min(getEndTime(), time));
+  }
+}
+
+void TrajectoryReplay::advance(double wallclock_seconds) {
+  if (wallclock_seconds > 0.0) {
+    seek(m_time + m_speed * wallclock_seconds);
+  }
+}
+
+bool TrajectoryReplay::updateFrame() {
+  const std::size_t frame = m_reader.findFrame(m_time);
+  if (frame == m_frame) {
+    return false;
+  }
+  m_reader.readFrame(frame, m_rows);
+  m_frame = frame;
+  return true;
+}
+
+} // namespace simulation
+} // namespace kernel
+} // namespace jamfree
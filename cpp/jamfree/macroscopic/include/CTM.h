@@ -43,6 +43,7 @@ public:
     // Initialize state
     m_num_vehicles.resize(num_cells, 0.0);
     m_num_vehicles_new.resize(num_cells, 0.0);
+    m_flows.resize(num_cells + 1, 0.0);
 
     // Calculate derived parameters
     m_critical_density = calculateCriticalDensity();
@@ -87,7 +88,7 @@ public:
    */
   void update(double dt) {
     // Calculate flows between cells
-    std::vector<double> flows(m_num_cells + 1, 0.0);
+    std::vector<double> &flows = m_flows;
 
     for (int i = 0; i < m_num_cells; ++i) {
       int i_next = (i + 1) % m_num_cells; // Periodic BC
@@ -97,6 +98,8 @@ public:
       double receive = receivingFlow(m_num_vehicles[i_next], dt);
       flows[i + 1] = std::min(send, receive);
     }
+    // The flow out of the last cell enters the first one
+    flows[0] = flows[m_num_cells];
 
     // Update number of vehicles in each cell
     for (int i = 0; i < m_num_cells; ++i) {
@@ -112,6 +115,33 @@ public:
     m_num_vehicles.swap(m_num_vehicles_new);
   }
 
+  /**
+   * @brief Longest time step of update() within the CFL condition, over
+   * which no wave crosses more than one cell.
+   *
+   * @return Time step (seconds)
+   */
+  double getStableTimeStep() const {
+    return m_cell_length / std::max(m_free_flow_speed, m_wave_speed);
+  }
+
+  /**
+   * @brief Advance by a time step of any length, as the fewest equal
+   * update() steps within getStableTimeStep().
+   *
+   * @param dt Time step (seconds)
+   * @return Number of update() steps
+   */
+  int advance(double dt) {
+    const double stable = getStableTimeStep();
+    const int steps =
+        std::max(1, static_cast<int>(std::ceil(dt / stable * (1.0 - 1e-12))));
+    for (int i = 0; i < steps; ++i) {
+      update(dt / steps);
+    }
+    return steps;
+  }
+
   /**
    * @brief Set number of vehicles in a cell.
    *
@@ -208,6 +238,7 @@ private:
 
   std::vector<double> m_num_vehicles;     ///< Current state
   std::vector<double> m_num_vehicles_new; ///< Next state
+  std::vector<double> m_flows;            ///< Flows into each cell
 
   /**
    * @brief Calculate critical density.
@@ -0,0 +1,149 @@
+#ifndef JAMFREE_MACROSCOPIC_MODELS_FUNDAMENTAL_DIAGRAM_ESTIMATOR_H
+#define JAMFREE_MACROSCOPIC_MODELS_FUNDAMENTAL_DIAGRAM_ESTIMATOR_H
+
+#include "../../kernel/include/model/DetectorSet.h"
+#include "LaneProfile.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace jamfree {
+namespace macroscopic {
+namespace models {
+
+/**
+ * @brief Online estimate of the Greenshields fundamental diagram of a lane,
+ * from a stream of density-speed samples.
+ *
+ * The samples are binned by density, each bin keeping the weighted sums of
+ * its densities and speeds, and forget() ages all of them at once by the
+ * forgetting factor, in O(1): the weights of the new samples grow instead,
+ * and the sums are scaled back only when they would overflow. The estimate
+ * is the line v = v_f (1 - k / k_jam) fitted by least squares through the
+ * mean of each bin holding enough weight, every bin counting the same, so
+ * that the many free-flow samples do not hide the few congested ones.
+ *
+ * It is fed by the profile of a lane, whose cells are grouped into samples
+ * of about Config::sample_length, or by the reports of loop detectors,
+ * whose densities are their flows over their space-mean speeds, and is read
+ * when the LWR or CTM parameters of the lane are needed, instead of
+ * scanning its vehicles as MicroMacroBridge::calibrateFundamentalDiagram()
+ * does.
+ */
+class FundamentalDiagramEstimator {
+public:
+  struct Config {
+    double max_density = 0.15;  ///< Upper bound of the bins (vehicles/m)
+    int num_bins = 15;          ///< Over [0, max_density]
+    double forgetting = 0.999;  ///< Weight kept by a sample at each forget()
+    double min_bin_weight = 1.0; ///< Weight of a bin to enter the fit
+    double sample_length = 100.0; ///< Length of a sample of a profile (m)
+
+    // Until fitted
+    double free_flow_speed = 33.3; ///< m/s
+    double jam_density = 0.15;     ///< vehicles/m
+
+    Config() = default;
+  };
+
+  /**
+   * @brief The fitted diagram, or the priors of the configuration.
+   */
+  struct Estimate {
+    double free_flow_speed;  ///< m/s
+    double jam_density;      ///< vehicles/m
+    double critical_density; ///< Of the maximum flow (vehicles/m)
+    double capacity;         ///< Maximum flow (vehicles/s)
+    int num_bins;            ///< Bins of the fit
+    bool fitted;             ///< false for the priors
+  };
+
+  /**
+   * @brief An estimator of the default configuration.
+   */
+  FundamentalDiagramEstimator();
+
+  /**
+   * @throws std::invalid_argument If a density, a length or the number of
+   *         bins is not positive, or the forgetting factor not in (0, 1]
+   */
+  explicit FundamentalDiagramEstimator(const Config &config);
+
+  const Config &getConfig() const { return m_config; }
+
+  /**
+   * @brief Add a sample.
+   *
+   * @param density vehicles/m, above max_density in the last bin
+   * @param speed Mean speed at that density (m/s)
+   * @param weight E.g. the number of vehicles measured
+   */
+  void addSample(double density, double speed, double weight = 1.0);
+
+  /**
+   * @brief Add a sample measured as a flow, at the density flow / speed.
+   *
+   * @param flow vehicles/s
+   * @param speed Space-mean speed (m/s), no sample if not positive
+   */
+  void addFlowSample(double flow, double speed, double weight = 1.0);
+
+  /**
+   * @brief Add the samples of the occupied groups of cells of a profile,
+   * weighted by their vehicles, then forget().
+   */
+  void observe(const LaneProfile &profile);
+
+  /**
+   * @brief Add the measures of a detector in all the periods of reports,
+   * forgetting after each period.
+   *
+   * @param period Aggregation period of the detectors (s)
+   */
+  void observe(const kernel::model::DetectorReports &reports,
+               std::size_t detector, double period);
+
+  /**
+   * @brief Age all the samples by the forgetting factor.
+   */
+  void forget();
+
+  /**
+   * @brief Fit the diagram, in O(num_bins).
+   */
+  Estimate getEstimate() const;
+
+  /**
+   * @brief Total weight of the samples, once aged.
+   */
+  double getTotalWeight() const;
+
+  /**
+   * @brief Number of the samples added, to tell a new estimate.
+   */
+  std::uint64_t getRevision() const { return m_revision; }
+
+  /**
+   * @brief Forget all the samples.
+   */
+  void reset();
+
+private:
+  struct Bin {
+    double weight = 0.0;
+    double density_sum = 0.0;
+    double speed_sum = 0.0;
+  };
+
+  Config m_config;
+  double m_bin_width;
+  std::vector<Bin> m_bins;
+  double m_scale = 1.0; ///< Weight of a new sample, 1 / forgetting^age
+  std::uint64_t m_revision = 0;
+};
+
+} // namespace models
+} // namespace macroscopic
+} // namespace jamfree
+
+#endif // JAMFREE_MACROSCOPIC_MODELS_FUNDAMENTAL_DIAGRAM_ESTIMATOR_H
@@ -121,6 +121,38 @@ public:
     m_density.swap(m_density_new);
   }
 
+  /**
+   * @brief Longest time step of update() within the CFL condition.
+   *
+   * The characteristic speeds of the Greenshields diagram are within
+   * [-v_f, v_f], a wave crossing at most one cell per step.
+   *
+   * @return Time step (seconds)
+   */
+  double getStableTimeStep() const {
+    return m_cell_length / m_free_flow_speed;
+  }
+
+  /**
+   * @brief Advance by a time step of any length, as the fewest equal
+   * update() steps within getStableTimeStep().
+   *
+   * So that the model may be updated once every several steps of a
+   * microscopic clock.
+   *
+   * @param dt Time step (seconds)
+   * @return Number of update() steps
+   */
+  int advance(double dt) {
+    const double stable = getStableTimeStep();
+    const int steps =
+        std::max(1, static_cast<int>(std::ceil(dt / stable * (1.0 - 1e-12))));
+    for (int i = 0; i < steps; ++i) {
+      update(dt / steps);
+    }
+    return steps;
+  }
+
   /**
    * @brief Set density at a specific cell.
    *
@@ -200,20 +232,13 @@ private:
   double calculateFlux(double rho_left, double rho_right) const {
     double rho_c = getCriticalDensity();
 
-    // Godunov flux (exact Riemann solver for LWR)
-    if (rho_left <= rho_c && rho_right <= rho_c) {
-      // Both in free-flow regime
-      return std::min(flowFromDensity(rho_left), flowFromDensity(rho_right));
-    } else if (rho_left >= rho_c && rho_right >= rho_c) {
-      // Both in congested regime
-      return std::min(flowFromDensity(rho_left), flowFromDensity(rho_right));
-    } else if (rho_left < rho_c && rho_right > rho_c) {
-      // Shock wave
-      return flowFromDensity(rho_c);
-    } else {
-      // Rarefaction wave
-      return flowFromDensity(rho_c);
-    }
+    // Godunov flux (exact Riemann solver for LWR), in demand-supply form:
+    // the upstream demand, the flow of the left density up to capacity,
+    // against the downstream supply, capacity down to the flow of the right
+    // density
+    double demand = flowFromDensity(std::min(rho_left, rho_c));
+    double supply = flowFromDensity(std::max(rho_right, rho_c));
+    return std::min(demand, supply);
   }
 };
 
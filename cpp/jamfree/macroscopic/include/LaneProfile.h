@@ -0,0 +1,187 @@
+#ifndef JAMFREE_MACROSCOPIC_MODELS_LANE_PROFILE_H
+#define JAMFREE_MACROSCOPIC_MODELS_LANE_PROFILE_H
+
+#include "../../kernel/include/model/Lane.h"
+#include "../../kernel/include/model/Vehicle.h"
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+namespace jamfree {
+namespace macroscopic {
+namespace models {
+
+/**
+ * @brief Cell counts and speed sums of the vehicles of a lane, kept up to
+ * date as they move.
+ *
+ * The owner of the lane reports each vehicle entering, leaving or moving
+ * with add(), remove() and move(), in O(1), so that the density, flow and
+ * speed profiles, and the aggregate statistics, are read without iterating
+ * the vehicles, and the three profiles share one pass of bookkeeping. The
+ * cells are the ones of MicroMacroBridge::extractDensityProfile(): the
+ * vehicles outside the lane count in the totals but in no cell.
+ *
+ * The speed sums accumulate rounding errors over the moves; rebuild()
+ * computes them again from the lane.
+ */
+class LaneProfile {
+public:
+  /**
+   * @brief A profile of no cell, tracking the totals only.
+   */
+  LaneProfile() : m_cell_length(0.0) {}
+
+  /**
+   * @brief An empty profile of a lane.
+   *
+   * @param lane_length Length of the lane (m)
+   * @param num_cells Number of cells for discretization
+   * @throws std::invalid_argument If the length or the number of cells is
+   *         not positive
+   */
+  LaneProfile(double lane_length, int num_cells)
+      : m_cell_length(lane_length / std::max(num_cells, 1)),
+        m_counts(std::max(num_cells, 0), 0),
+        m_speed_sums(std::max(num_cells, 0), 0.0) {
+    if (!(lane_length > 0.0) || num_cells <= 0) {
+      throw std::invalid_argument(
+          "LaneProfile: lane length and number of cells must be positive");
+    }
+  }
+
+  int getNumCells() const { return static_cast<int>(m_counts.size()); }
+  double getCellLength() const { return m_cell_length; }
+
+  /**
+   * @brief Get the cell of a lane position.
+   *
+   * @return Index of the cell, -1 outside the lane
+   */
+  int cellOf(double position) const {
+    if (m_counts.empty()) {
+      return -1;
+    }
+    const int cell = static_cast<int>(position / m_cell_length);
+    return cell >= 0 && cell < getNumCells() ? cell : -1;
+  }
+
+  /**
+   * @brief Count a vehicle entering the lane.
+   */
+  void add(double position, double speed) {
+    ++m_total_count;
+    m_total_speed += speed;
+    const int cell = cellOf(position);
+    if (cell >= 0) {
+      ++m_counts[cell];
+      m_speed_sums[cell] += speed;
+    }
+  }
+
+  /**
+   * @brief Count a vehicle leaving the lane, with its last reported
+   * position and speed.
+   */
+  void remove(double position, double speed) {
+    --m_total_count;
+    m_total_speed = m_total_count > 0 ? m_total_speed - speed : 0.0;
+    const int cell = cellOf(position);
+    if (cell >= 0) {
+      --m_counts[cell];
+      m_speed_sums[cell] =
+          m_counts[cell] > 0 ? m_speed_sums[cell] - speed : 0.0;
+    }
+  }
+
+  /**
+   * @brief Count a vehicle moving on the lane, e.g. after
+   * Vehicle::update().
+   */
+  void move(double old_position, double old_speed, double new_position,
+            double new_speed) {
+    m_total_speed += new_speed - old_speed;
+    const int from = cellOf(old_position);
+    const int to = cellOf(new_position);
+    if (from == to) {
+      if (from >= 0) {
+        m_speed_sums[from] += new_speed - old_speed;
+      }
+      return;
+    }
+    if (from >= 0) {
+      --m_counts[from];
+      m_speed_sums[from] =
+          m_counts[from] > 0 ? m_speed_sums[from] - old_speed : 0.0;
+    }
+    if (to >= 0) {
+      ++m_counts[to];
+      m_speed_sums[to] += new_speed;
+    }
+  }
+
+  /**
+   * @brief Count again the vehicles of a lane, from scratch.
+   */
+  void rebuild(const kernel::model::Lane &lane) {
+    clear();
+    for (const auto &vehicle : lane.getVehicles()) {
+      add(vehicle->getLanePosition(), vehicle->getSpeed());
+    }
+  }
+
+  /**
+   * @brief Forget all the vehicles.
+   */
+  void clear() {
+    std::fill(m_counts.begin(), m_counts.end(), 0);
+    std::fill(m_speed_sums.begin(), m_speed_sums.end(), 0.0);
+    m_total_count = 0;
+    m_total_speed = 0.0;
+  }
+
+  /** @brief Number of vehicles in a cell. */
+  int getCount(int cell) const { return m_counts[cell]; }
+
+  /** @brief Density of a cell (vehicles/m). */
+  double getDensity(int cell) const { return m_counts[cell] / m_cell_length; }
+
+  /** @brief Average speed in a cell (m/s), 0 if empty. */
+  double getSpeed(int cell) const {
+    return m_counts[cell] > 0 ? m_speed_sums[cell] / m_counts[cell] : 0.0;
+  }
+
+  /** @brief Sum of the speeds in a cell (m/s). */
+  double getSpeedSum(int cell) const { return m_speed_sums[cell]; }
+
+  /** @brief Flow of a cell, density times average speed (vehicles/s). */
+  double getFlow(int cell) const { return m_speed_sums[cell] / m_cell_length; }
+
+  /** @brief Number of vehicles counted, in the cells or not. */
+  int getVehicleCount() const { return m_total_count; }
+
+  /** @brief Sum of the speeds of the vehicles counted (m/s). */
+  double getSpeedSum() const { return m_total_speed; }
+
+  /**
+   * @brief Copy the densities of the cells into a buffer of getNumCells().
+   */
+  void getDensities(double *density) const {
+    for (int i = 0; i < getNumCells(); ++i) {
+      density[i] = getDensity(i);
+    }
+  }
+
+private:
+  double m_cell_length;
+  std::vector<int> m_counts;
+  std::vector<double> m_speed_sums;
+  int m_total_count = 0;
+  double m_total_speed = 0.0;
+};
+
+} // namespace models
+} // namespace macroscopic
+} // namespace jamfree
+
+#endif // JAMFREE_MACROSCOPIC_MODELS_LANE_PROFILE_H
@@ -0,0 +1,393 @@
+#ifndef JAMFREE_MACROSCOPIC_MODELS_MACROSCOPIC_BATCH_H
+#define JAMFREE_MACROSCOPIC_MODELS_MACROSCOPIC_BATCH_H
+
+#include "CTM.h"
+#include "LWR.h"
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace jamfree {
+namespace macroscopic {
+namespace models {
+
+/**
+ * @brief Cells of many links in contiguous arrays.
+ *
+ * The cells of all the links are laid out one link after the other in
+ * structure-of-arrays form: one array for the states and one for the fluxes
+ * at the cell boundaries, the parameters of the links in a third one. A
+ * solver updates the links in the order of the buffer, each one with a
+ * short loop over its contiguous cells, which the compiler vectorizes, and
+ * its fluxes still in cache. Each link is a ring, as the LWR and CTM models:
+ * a ghost cell on each side holds a copy of the cell at the other end.
+ *
+ * A link is identified by the index addLink() returns, which stays valid
+ * until the link is removed and may then be reused.
+ */
+class CellBatch {
+public:
+  /**
+   * @brief Index of a link that does not exist
+   */
+  static constexpr std::size_t NONE = std::numeric_limits<std::size_t>::max();
+
+  std::size_t getNumLinks() const { return m_links.size(); }
+
+  /**
+   * @brief Get the number of cells of all the links.
+   */
+  std::size_t getTotalCells() const { return m_total_cells; }
+
+  bool hasLink(std::size_t link) const {
+    return link < m_link_slots.size() && m_link_slots[link] != NONE;
+  }
+
+  int getNumCells(std::size_t link) const {
+    return m_links[linkSlot(link)].num_cells;
+  }
+  double getCellLength(std::size_t link) const {
+    return m_links[linkSlot(link)].cell_length;
+  }
+
+  /**
+   * @brief Remove a link, moving the cells of the next ones.
+   *
+   * @throws std::out_of_range If the link does not exist
+   */
+  void removeLink(std::size_t link);
+
+protected:
+  /**
+   * @param num_parameters Number of parameters of a link
+   */
+  explicit CellBatch(std::size_t num_parameters)
+      : m_num_parameters(num_parameters) {}
+
+  /**
+   * @brief Add the cells of a link, at state 0.
+   *
+   * @param num_cells Number of cells
+   * @param cell_length Length of a cell (m)
+   * @param parameters Parameters of the link
+   * @return Link
+   * @throws std::invalid_argument If num_cells is not positive
+   */
+  std::size_t addCells(int num_cells, double cell_length,
+                       const std::vector<double> &parameters);
+
+  /**
+   * @brief Get the parameters of a link.
+   *
+   * @throws std::out_of_range If the link does not exist
+   */
+  const double *parameters(std::size_t link) const {
+    return m_parameters.data() + linkSlot(link) * m_num_parameters;
+  }
+  double *parameters(std::size_t link) {
+    return m_parameters.data() + linkSlot(link) * m_num_parameters;
+  }
+
+  /**
+   * @brief Call body(state, flux, num_cells, parameters) for each link.
+   *
+   * state[-1] and state[num_cells] are the ghost cells; flux[i] is to be
+   * set to the flux into the cell i, for i in [0, num_cells].
+   */
+  template <typename Body> void forEachLink(Body body) {
+    forEachLink(0, m_links.size(), body);
+  }
+
+  /**
+   * @brief Call body(state, flux, num_cells, parameters) for the links at
+   * positions [begin, end) in the buffer, disjoint ranges being independent.
+   */
+  template <typename Body>
+  void forEachLink(std::size_t begin, std::size_t end, Body body) {
+    double *state = m_state.data();
+    double *flux = m_flux.data();
+    for (std::size_t i = begin; i < end; ++i) {
+      const std::size_t first = m_links[i].first + 1;
+      body(state + first, flux + first, m_links[i].num_cells,
+           m_parameters.data() + i * m_num_parameters);
+    }
+  }
+
+  /**
+   * @brief Get the index of the first cell of a link in the arrays.
+   *
+   * @throws std::out_of_range If the link does not exist
+   */
+  std::size_t firstCell(std::size_t link) const {
+    return m_links[linkSlot(link)].first + 1;
+  }
+
+  /**
+   * @brief Get the index in the arrays of a cell of a link.
+   *
+   * @throws std::out_of_range If the link or the cell does not exist
+   */
+  std::size_t cellIndex(std::size_t link, int cell) const;
+
+  /**
+   * @brief Copy the cells at the ends of a link to its ghost cells.
+   */
+  void syncGhosts(std::size_t link);
+
+  std::vector<double> m_state;
+
+private:
+  struct Link {
+    std::size_t first; // Ghost cell before the cells
+    int num_cells;
+    double cell_length;
+    std::size_t id;
+  };
+
+  std::size_t m_num_parameters;
+  std::vector<double> m_flux;
+  std::vector<double> m_parameters; // By link, in the order of m_links
+  std::vector<Link> m_links;
+  std::vector<std::size_t> m_link_slots; // By link, its index in m_links
+  std::vector<std::size_t> m_free_links;
+  std::size_t m_total_cells = 0;
+
+  std::size_t linkSlot(std::size_t link) const;
+};
+
+/**
+ * @brief The LWR model of many links, in one buffer.
+ *
+ * Each link evolves as an LWR of the same parameters: Greenshields
+ * fundamental diagram, Godunov fluxes, periodic boundaries. The fluxes are
+ * computed in their demand-supply form, min(D(ρ_left), S(ρ_right)), without
+ * branches, so that the compiler vectorizes the loops over the cells; an
+ * update allocates nothing.
+ */
+class LWRBatch : public CellBatch {
+public:
+  LWRBatch() : CellBatch(NUM_PARAMETERS) {}
+
+  /**
+   * @brief Add a link, empty.
+   *
+   * The parameters of the LWR constructor.
+   * @return Link
+   * @throws std::invalid_argument If a parameter is not positive
+   */
+  std::size_t addLink(double free_flow_speed, double jam_density,
+                      double road_length, int num_cells);
+
+  /**
+   * @brief Add a link with the parameters and the densities of a model.
+   */
+  std::size_t addLink(const LWR &model);
+
+  /**
+   * @brief Update all the links for one time step.
+   *
+   * @param dt Time step (seconds)
+   */
+  void update(double dt) { update(dt, 0, getNumLinks()); }
+
+  /**
+   * @brief Update the links at positions [begin, end) in the buffer.
+   *
+   * The updates of disjoint ranges may run in parallel.
+   */
+  void update(double dt, std::size_t begin, std::size_t end);
+
+  /**
+   * @brief Get the longest time step of update() within the CFL condition
+   * of a link.
+   *
+   * @throws std::out_of_range If the link does not exist
+   */
+  double getStableTimeStep(std::size_t link) const;
+
+  /**
+   * @brief Advance all the links by a time step of any length.
+   *
+   * @param dt Time step (seconds)
+   */
+  void advance(double dt) { advance(dt, 0, getNumLinks()); }
+
+  /**
+   * @brief Advance the links at positions [begin, end) in the buffer by a
+   * time step of any length, each as the fewest equal update() steps within
+   * its stable time step, e.g. once every several microscopic steps.
+   *
+   * The advances of disjoint ranges may run in parallel.
+   */
+  void advance(double dt, std::size_t begin, std::size_t end);
+
+  /**
+   * @brief Set the density of a cell, clamped to [0, jam density].
+   */
+  void setDensity(std::size_t link, int cell, double density);
+
+  /**
+   * @brief Set the densities of all the cells of a link, clamped to
+   * [0, jam density].
+   *
+   * @param densities One density by cell
+   */
+  void setDensities(std::size_t link, const double *densities);
+
+  double getDensity(std::size_t link, int cell) const {
+    return m_state[cellIndex(link, cell)];
+  }
+
+  /**
+   * @brief Get the densities of the cells of a link, contiguous.
+   */
+  const double *getDensities(std::size_t link) const {
+    return m_state.data() + firstCell(link);
+  }
+
+  double getSpeed(std::size_t link, int cell) const;
+
+  double getFlow(std::size_t link, int cell) const {
+    return getDensity(link, cell) * getSpeed(link, cell);
+  }
+
+  double getFreeFlowSpeed(std::size_t link) const {
+    return parameters(link)[FREE_FLOW_SPEED];
+  }
+  double getJamDensity(std::size_t link) const {
+    return parameters(link)[JAM_DENSITY];
+  }
+
+  /**
+   * @brief Change the fundamental diagram of a link, e.g. to a fresh
+   * estimate, its densities clamped to the new jam density.
+   *
+   * @throws std::invalid_argument If a parameter is not positive
+   * @throws std::out_of_range If the link does not exist
+   */
+  void setParameters(std::size_t link, double free_flow_speed,
+                     double jam_density);
+
+private:
+  enum Parameter : std::size_t {
+    FREE_FLOW_SPEED,
+    JAM_DENSITY,
+    INVERSE_JAM_DENSITY,
+    INVERSE_CELL_LENGTH,
+    NUM_PARAMETERS
+  };
+  static double stableTimeStep(const double *parameters);
+  static void step(double dt, double *density, double *flux, int num_cells,
+                   const double *parameters);
+};
+
+/**
+ * @brief The CTM of many links, in one buffer.
+ *
+ * Each link evolves as a CTM of the same parameters, the flow between two
+ * cells being min(S(n_left), R(n_right)); the loops over the cells are
+ * branchless, so that the compiler vectorizes them, and an update allocates
+ * nothing.
+ */
+class CTMBatch : public CellBatch {
+public:
+  CTMBatch() : CellBatch(NUM_PARAMETERS) {}
+
+  /**
+   * @brief Add a link, empty.
+   *
+   * The parameters of the CTM constructor.
+   * @return Link
+   * @throws std::invalid_argument If a parameter is not positive
+   */
+  std::size_t addLink(double free_flow_speed, double wave_speed,
+                      double jam_density, double road_length, int num_cells);
+
+  /**
+   * @brief Add a link with the parameters and the vehicles of a model.
+   */
+  std::size_t addLink(const CTM &model);
+
+  /**
+   * @brief Update all the links for one time step.
+   *
+   * @param dt Time step (seconds)
+   */
+  void update(double dt) { update(dt, 0, getNumLinks()); }
+
+  /**
+   * @brief Update the links at positions [begin, end) in the buffer.
+   *
+   * The updates of disjoint ranges may run in parallel.
+   */
+  void update(double dt, std::size_t begin, std::size_t end);
+
+  /**
+   * @brief Get the longest time step of update() within the CFL condition
+   * of a link.
+   *
+   * @throws std::out_of_range If the link does not exist
+   */
+  double getStableTimeStep(std::size_t link) const;
+
+  /**
+   * @brief Advance all the links by a time step of any length.
+   *
+   * @param dt Time step (seconds)
+   */
+  void advance(double dt) { advance(dt, 0, getNumLinks()); }
+
+  /**
+   * @brief Advance the links at positions [begin, end) in the buffer by a
+   * time step of any length, each as the fewest equal update() steps within
+   * its stable time step, e.g. once every several microscopic steps.
+   *
+   * The advances of disjoint ranges may run in parallel.
+   */
+  void advance(double dt, std::size_t begin, std::size_t end);
+
+  /**
+   * @brief Set the number of vehicles of a cell, clamped to its capacity.
+   */
+  void setNumVehicles(std::size_t link, int cell, double num_vehicles);
+
+  double getNumVehicles(std::size_t link, int cell) const {
+    return m_state[cellIndex(link, cell)];
+  }
+
+  /**
+   * @brief Get the numbers of vehicles of the cells of a link, contiguous.
+   */
+  const double *getNumVehiclesArray(std::size_t link) const {
+    return m_state.data() + firstCell(link);
+  }
+
+  double getDensity(std::size_t link, int cell) const {
+    return getNumVehicles(link, cell) / getCellLength(link);
+  }
+
+  double getSpeed(std::size_t link, int cell) const;
+
+  double getFlow(std::size_t link, int cell) const {
+    return getDensity(link, cell) * getSpeed(link, cell);
+  }
+
+private:
+  enum Parameter : std::size_t {
+    MAX_FLOW, // Vehicles/s
+    MAX_VEHICLES,
+    FREE_FLOW_SPEED,
+    WAVE_SPEED,
+    JAM_DENSITY,
+    NUM_PARAMETERS
+  };
+  static double stableTimeStep(const double *parameters);
+  static void step(double dt, double *vehicles, double *flow, int num_cells,
+                   const double *parameters);
+};
+
+} // namespace models
+} // namespace macroscopic
+} // namespace jamfree
+
+#endif // JAMFREE_MACROSCOPIC_MODELS_MACROSCOPIC_BATCH_H
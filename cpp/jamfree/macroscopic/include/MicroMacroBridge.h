@@ -5,6 +5,8 @@
 #include "../../kernel/include/model/Vehicle.h"
 #include "CTM.h"
 #include "LWR.h"
+#include "LaneProfile.h"
+#include <algorithm>
 #include <memory>
 #include <vector>
 
@@ -42,11 +44,26 @@ public:
       return density;
     }
 
-    double lane_length = lane->getLength();
+    extractDensityProfile(*lane, density.data(), num_cells);
+    return density;
+  }
+
+  /**
+   * @brief Extract the density profile of a lane into a buffer.
+   *
+   * @param lane Lane with vehicles
+   * @param density Set to the densities of the cells (vehicles/m)
+   * @param num_cells Number of cells for discretization
+   */
+  static void extractDensityProfile(const kernel::model::Lane &lane,
+                                    double *density, int num_cells) {
+    std::fill(density, density + num_cells, 0.0);
+
+    double lane_length = lane.getLength();
     double cell_length = lane_length / num_cells;
 
     // Count vehicles in each cell
-    const auto &vehicles = lane->getVehicles();
+    const auto &vehicles = lane.getVehicles();
     for (const auto &vehicle : vehicles) {
       double pos = vehicle->getLanePosition();
       int cell_index = static_cast<int>(pos / cell_length);
@@ -55,8 +72,6 @@ public:
         density[cell_index] += 1.0 / cell_length;
       }
     }
-
-    return density;
   }
 
   /**
@@ -302,6 +317,25 @@ public:
 
     return stats;
   }
+
+  /**
+   * @brief Calculate the aggregate statistics of a lane from its profile,
+   * without iterating its vehicles.
+   *
+   * @param profile Profile kept up to date with the vehicles of the lane
+   * @param lane_length Length of the lane (m)
+   */
+  static AggregateStats calculateAggregateStats(const LaneProfile &profile,
+                                                double lane_length) {
+    AggregateStats stats{0.0, 0.0, 0.0, profile.getVehicleCount()};
+    if (stats.num_vehicles <= 0) {
+      return stats;
+    }
+    stats.avg_density = stats.num_vehicles / lane_length;
+    stats.avg_speed = profile.getSpeedSum() / stats.num_vehicles;
+    stats.avg_flow = stats.avg_density * stats.avg_speed;
+    return stats;
+  }
 };
 
 } // namespace models
@@ -0,0 +1,189 @@
+#ifndef JAMFREE_MACROSCOPIC_MODELS_NETWORK_CTM_H
+#define JAMFREE_MACROSCOPIC_MODELS_NETWORK_CTM_H
+
+#include "../../kernel/include/model/Road.h"
+#include "../../kernel/include/routing/RoadGraph.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace jamfree {
+namespace macroscopic {
+namespace models {
+
+/**
+ * @brief Cell Transmission Model of a road network.
+ *
+ * Each road is a link of the RoadGraph of the roads, split into cells of
+ * at least the distance covered at free-flow speed in a time step, with the
+ * triangular fundamental diagram of its lanes (Daganzo, 1995). At each node
+ * the flows from the incoming links to the outgoing ones follow a general
+ * first-order node model (Tampère et al., 2011): the sending flows split by
+ * turning fractions, the outflow of each incoming link is limited by its
+ * most restrictive outgoing link, keeping its turning fractions (FIFO), and
+ * the receiving flow of an outgoing link is shared by the incoming links in
+ * proportion to their capacities. A node of one incoming and one outgoing
+ * link, a merge and a diverge are its special cases. The links leading to
+ * no other leave the network, and the vehicles added to a link wait in its
+ * entry queue for room.
+ *
+ * A step computes the flows of all the cells and nodes from the state of
+ * the previous one, then updates all the cells, so that the vehicles are
+ * conserved across the nodes.
+ */
+class NetworkCTM {
+public:
+  /**
+   * @brief Parameters of the lanes.
+   */
+  struct Config {
+    double jam_density = 0.15; ///< Vehicles/m by lane
+    double wave_speed = 5.56;  ///< Backward wave speed (m/s)
+
+    Config() = default;
+  };
+
+  /**
+   * @brief Build the links of roads.
+   *
+   * The turning fractions of a link are the capacities of the next ones,
+   * without the road back to its start unless it is the only one.
+   *
+   * @param roads Roads, the ones without lanes being left out
+   * @param dt Time step the cells are sized for (seconds)
+   * @param config Parameters of the lanes
+   * @throws std::invalid_argument If dt or a parameter is not positive
+   */
+  NetworkCTM(const std::vector<std::shared_ptr<kernel::model::Road>> &roads,
+             double dt, const Config &config);
+
+  /**
+   * @brief Build the links of roads, with the default parameters.
+   */
+  NetworkCTM(const std::vector<std::shared_ptr<kernel::model::Road>> &roads,
+             double dt)
+      : NetworkCTM(roads, dt, Config()) {}
+
+  /**
+   * @brief Get the graph of the roads, whose edges are the links.
+   */
+  const kernel::routing::RoadGraph &getGraph() const { return *m_graph; }
+
+  std::size_t getNumCells(std::uint32_t link) const {
+    return m_first_cell[link + 1] - m_first_cell[link];
+  }
+  double getCellLength(std::uint32_t link) const {
+    return m_links[link].cell_length;
+  }
+
+  /**
+   * @brief Set the turning fractions at the end of a link.
+   *
+   * @param link Link
+   * @param fractions Fraction of the outflow to each outgoing link of its
+   *                  end node, in the order of the graph; normalized
+   * @throws std::invalid_argument If the fractions are not one by outgoing
+   *         link, negative or all zero
+   */
+  void setTurningFractions(std::uint32_t link,
+                           const std::vector<double> &fractions);
+
+  /**
+   * @brief Add vehicles to the entry queue of a link.
+   */
+  void addVehicles(std::uint32_t link, double vehicles);
+
+  /**
+   * @brief Set the number of vehicles of a cell, clamped to its capacity.
+   */
+  void setNumVehicles(std::uint32_t link, std::size_t cell, double vehicles);
+
+  double getNumVehicles(std::uint32_t link, std::size_t cell) const {
+    return m_vehicles[m_first_cell[link] + cell];
+  }
+
+  /**
+   * @brief Get the number of vehicles on a link, out of its entry queue.
+   */
+  double getNumVehicles(std::uint32_t link) const;
+
+  double getQueue(std::uint32_t link) const { return m_queues[link]; }
+
+  /**
+   * @brief Get the number of vehicles on the links and in the queues.
+   */
+  double getTotalVehicles() const;
+
+  /**
+   * @brief Get the number of vehicles that left the network.
+   */
+  double getExitedVehicles() const { return m_exited; }
+
+  /**
+   * @brief Get the speed in a cell, from its density (m/s).
+   */
+  double getSpeed(std::uint32_t link, std::size_t cell) const;
+
+  /**
+   * @brief Get the travel time of each link at the speeds of its cells.
+   *
+   * @param times Set to the time of each edge of getGraph() (seconds);
+   *              infinite on a jammed cell
+   */
+  void getTravelTimes(std::vector<double> &times) const;
+
+  /**
+   * @brief Advance the network by one time step.
+   *
+   * @param dt Time step (seconds); above the one of the constructor, the
+   *           vehicles cross a cell in less than a step and the flows are
+   *           bounded by the vehicles present
+   */
+  void update(double dt);
+
+private:
+  struct Link {
+    double cell_length;
+    double free_flow_speed;
+    double capacity;     // Vehicles/s
+    double max_vehicles; // By cell
+  };
+
+  std::shared_ptr<const kernel::routing::RoadGraph> m_graph;
+  Config m_config;
+  std::vector<Link> m_links;
+
+  // Cells of the links, by link in CSR form
+  std::vector<std::size_t> m_first_cell;
+  std::vector<double> m_vehicles;
+  // Vehicles into each cell during a step, and out of the last one of
+  // each link: link l has the slots [m_first_cell[l] + l,
+  // m_first_cell[l + 1] + l]
+  std::vector<double> m_flows;
+
+  // Turning fractions at the end of each link, over the outgoing links of
+  // its end node
+  std::vector<std::size_t> m_first_turn;
+  std::vector<double> m_turns;
+
+  std::vector<double> m_queues;
+  double m_exited = 0.0;
+
+  // Node model, by link
+  std::vector<double> m_sending;
+  std::vector<double> m_receiving;
+  std::vector<double> m_inflows;
+  std::vector<double> m_outflows;
+  // By incoming and outgoing link of the node being solved
+  std::vector<std::uint8_t> m_unresolved;
+  std::vector<double> m_remaining;
+
+  void solveNode(std::uint32_t node, double dt);
+};
+
+} // namespace models
+} // namespace macroscopic
+} // namespace jamfree
+
+#endif // JAMFREE_MACROSCOPIC_MODELS_NETWORK_CTM_H
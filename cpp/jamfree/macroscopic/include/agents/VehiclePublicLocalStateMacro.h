@@ -25,6 +25,12 @@ public:
    */
   explicit VehiclePublicLocalStateMacro(const std::string &ownerId);
 
+  /**
+   * @brief Constructor.
+   * @param ownerId The interned identifier of the agent owning this state.
+   */
+  explicit VehiclePublicLocalStateMacro(kernel::agents::Symbol ownerId);
+
   /**
    * @brief Clone this state.
    * @return Cloned state
@@ -70,7 +76,7 @@ public:
   void setActive(bool active) { m_active = active; }
 
 private:
-  std::string m_ownerId;
+  kernel::agents::Symbol m_ownerId;
   kernel::agents::LevelIdentifier m_level;
 
   // Flow properties
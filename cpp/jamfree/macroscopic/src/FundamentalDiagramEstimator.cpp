@@ -0,0 +1,166 @@
+#include "../include/FundamentalDiagramEstimator.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace jamfree {
+namespace macroscopic {
+namespace models {
+
+namespace {
+
+// Scale of the weights of the new samples over which the sums are scaled
+// back
+constexpr double MAX_SCALE = 1e100;
+
+FundamentalDiagramEstimator::Estimate greenshields(double free_flow_speed,
+                                                   double jam_density,
+                                                   int num_bins, bool fitted) {
+  return {free_flow_speed, jam_density, jam_density / 2.0,
+          free_flow_speed * jam_density / 4.0, num_bins, fitted};
+}
+
+} // namespace
+
+FundamentalDiagramEstimator::FundamentalDiagramEstimator()
+    : FundamentalDiagramEstimator(Config()) {}
+
+FundamentalDiagramEstimator::FundamentalDiagramEstimator(const Config &config)
+    : m_config(config) {
+  if (!(config.max_density > 0.0) || config.num_bins <= 0 ||
+      !(config.sample_length > 0.0) || !(config.free_flow_speed > 0.0) ||
+      !(config.jam_density > 0.0)) {
+    throw std::invalid_argument(
+        "FundamentalDiagramEstimator: the densities, lengths, speeds and "
+        "number of bins must be positive");
+  }
+  if (!(config.forgetting > 0.0 && config.forgetting <= 1.0)) {
+    throw std::invalid_argument(
+        "FundamentalDiagramEstimator: the forgetting factor must be in (0, 1]");
+  }
+  m_bin_width = config.max_density / config.num_bins;
+  m_bins.resize(config.num_bins);
+}
+
+void FundamentalDiagramEstimator::addSample(double density, double speed,
+                                            double weight) {
+  if (!(density >= 0.0) || !std::isfinite(speed) || !(weight > 0.0)) {
+    return;
+  }
+  const int last = static_cast<int>(m_bins.size()) - 1;
+  const int index = std::min(last, static_cast<int>(density / m_bin_width));
+  Bin &bin = m_bins[index];
+  const double scaled = weight * m_scale;
+  bin.weight += scaled;
+  bin.density_sum += scaled * density;
+  bin.speed_sum += scaled * speed;
+  ++m_revision;
+}
+
+void FundamentalDiagramEstimator::addFlowSample(double flow, double speed,
+                                                double weight) {
+  if (speed > 0.0) {
+    addSample(flow / speed, speed, weight);
+  }
+}
+
+void FundamentalDiagramEstimator::observe(const LaneProfile &profile) {
+  const int num_cells = profile.getNumCells();
+  const double cell_length = profile.getCellLength();
+  if (num_cells == 0) {
+    forget();
+    return;
+  }
+  const int group = std::max(
+      1, static_cast<int>(std::lround(m_config.sample_length / cell_length)));
+  for (int begin = 0; begin < num_cells; begin += group) {
+    const int end = std::min(num_cells, begin + group);
+    int count = 0;
+    double speed_sum = 0.0;
+    for (int i = begin; i < end; ++i) {
+      count += profile.getCount(i);
+      speed_sum += profile.getSpeedSum(i);
+    }
+    if (count > 0) {
+      addSample(count / ((end - begin) * cell_length), speed_sum / count,
+                count);
+    }
+  }
+  forget();
+}
+
+void FundamentalDiagramEstimator::observe(
+    const kernel::model::DetectorReports &reports, std::size_t detector,
+    double period) {
+  if (detector >= reports.num_detectors || !(period > 0.0)) {
+    return;
+  }
+  for (std::size_t p = 0; p < reports.getNumPeriods(); ++p) {
+    const std::size_t index = p * reports.num_detectors + detector;
+    const std::uint32_t count = reports.counts[index];
+    if (count > 0) {
+      addFlowSample(count / period, reports.harmonic_speed[index], count);
+    }
+    forget();
+  }
+}
+
+void FundamentalDiagramEstimator::forget() {
+  m_scale /= m_config.forgetting;
+  if (m_scale > MAX_SCALE) {
+    for (Bin &bin : m_bins) {
+      bin.weight /= m_scale;
+      bin.density_sum /= m_scale;
+      bin.speed_sum /= m_scale;
+    }
+    m_scale = 1.0;
+  }
+}
+
+FundamentalDiagramEstimator::Estimate
+FundamentalDiagramEstimator::getEstimate() const {
+  // Least squares of the speed by the density through the bin means
+  const double min_weight = m_config.min_bin_weight * m_scale;
+  int n = 0;
+  double sum_k = 0.0, sum_v = 0.0, sum_kk = 0.0, sum_kv = 0.0;
+  for (const Bin &bin : m_bins) {
+    if (bin.weight < min_weight || !(bin.weight > 0.0)) {
+      continue;
+    }
+    const double k = bin.density_sum / bin.weight;
+    const double v = bin.speed_sum / bin.weight;
+    ++n;
+    sum_k += k;
+    sum_v += v;
+    sum_kk += k * k;
+    sum_kv += k * v;
+  }
+  const double denominator = n * sum_kk - sum_k * sum_k;
+  if (n >= 2 && denominator > 0.0) {
+    const double slope = (n * sum_kv - sum_k * sum_v) / denominator;
+    const double free_flow_speed = (sum_v - slope * sum_k) / n;
+    if (slope < 0.0 && free_flow_speed > 0.0) {
+      return greenshields(free_flow_speed, -free_flow_speed / slope, n, true);
+    }
+  }
+  return greenshields(m_config.free_flow_speed, m_config.jam_density, n,
+                      false);
+}
+
+double FundamentalDiagramEstimator::getTotalWeight() const {
+  double weight = 0.0;
+  for (const Bin &bin : m_bins) {
+    weight += bin.weight;
+  }
+  return weight / m_scale;
+}
+
+void FundamentalDiagramEstimator::reset() {
+  std::fill(m_bins.begin(), m_bins.end(), Bin());
+  m_scale = 1.0;
+  ++m_revision;
+}
+
+} // namespace models
+} // namespace macroscopic
+} // namespace jamfree
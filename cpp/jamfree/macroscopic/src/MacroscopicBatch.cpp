@@ -0,0 +1,310 @@
+#include "../include/MacroscopicBatch.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace jamfree {
+namespace macroscopic {
+namespace models {
+
+namespace {
+
+void checkPositive(double value, const char *name) {
+  if (!(value > 0.0)) {
+    throw std::invalid_argument(std::string("Macroscopic batch: ") + name +
+                                " must be positive");
+  }
+}
+
+// Fewest equal steps of at most stable seconds in dt
+int stableSteps(double dt, double stable) {
+  return std::max(1,
+                  static_cast<int>(std::ceil(dt / stable * (1.0 - 1e-12))));
+}
+
+} // namespace
+
+std::size_t CellBatch::linkSlot(std::size_t link) const {
+  if (!hasLink(link)) {
+    throw std::out_of_range("Unknown macroscopic link " +
+                            std::to_string(link));
+  }
+  return m_link_slots[link];
+}
+
+std::size_t CellBatch::cellIndex(std::size_t link, int cell) const {
+  const Link &entry = m_links[linkSlot(link)];
+  if (cell < 0 || cell >= entry.num_cells) {
+    throw std::out_of_range("Cell " + std::to_string(cell) +
+                            " out of the macroscopic link " +
+                            std::to_string(link));
+  }
+  return entry.first + 1 + cell;
+}
+
+std::size_t CellBatch::addCells(int num_cells, double cell_length,
+                                const std::vector<double> &parameters) {
+  if (num_cells <= 0) {
+    throw std::invalid_argument(
+        "Macroscopic batch: the number of cells must be positive");
+  }
+  std::size_t link;
+  if (m_free_links.empty()) {
+    link = m_link_slots.size();
+    m_link_slots.push_back(NONE);
+  } else {
+    link = m_free_links.back();
+    m_free_links.pop_back();
+  }
+
+  // The cells and their two ghost cells
+  const std::size_t first = m_state.size();
+  const std::size_t size = static_cast<std::size_t>(num_cells) + 2;
+  m_state.resize(first + size, 0.0);
+  m_flux.resize(first + size, 0.0);
+  m_parameters.insert(m_parameters.end(), parameters.begin(),
+                      parameters.end());
+  m_link_slots[link] = m_links.size();
+  m_links.push_back(Link{first, num_cells, cell_length, link});
+  m_total_cells += num_cells;
+  return link;
+}
+
+void CellBatch::removeLink(std::size_t link) {
+  const std::size_t slot = linkSlot(link);
+  const Link removed = m_links[slot];
+  const std::size_t size = static_cast<std::size_t>(removed.num_cells) + 2;
+  m_state.erase(m_state.begin() + removed.first,
+                m_state.begin() + removed.first + size);
+  m_flux.erase(m_flux.begin() + removed.first,
+               m_flux.begin() + removed.first + size);
+  m_parameters.erase(m_parameters.begin() + slot * m_num_parameters,
+                     m_parameters.begin() + (slot + 1) * m_num_parameters);
+  m_links.erase(m_links.begin() + slot);
+  for (std::size_t i = slot; i < m_links.size(); ++i) {
+    m_links[i].first -= size;
+    m_link_slots[m_links[i].id] = i;
+  }
+  m_link_slots[link] = NONE;
+  m_free_links.push_back(link);
+  m_total_cells -= removed.num_cells;
+}
+
+void CellBatch::syncGhosts(std::size_t link) {
+  const Link &entry = m_links[linkSlot(link)];
+  m_state[entry.first] = m_state[entry.first + entry.num_cells];
+  m_state[entry.first + entry.num_cells + 1] = m_state[entry.first + 1];
+}
+
+std::size_t LWRBatch::addLink(double free_flow_speed, double jam_density,
+                              double road_length, int num_cells) {
+  checkPositive(free_flow_speed, "the free-flow speed");
+  checkPositive(jam_density, "the jam density");
+  checkPositive(road_length, "the road length");
+  const double cell_length = road_length / num_cells;
+  return addCells(num_cells, cell_length,
+                  {free_flow_speed, jam_density, 1.0 / jam_density,
+                   1.0 / cell_length});
+}
+
+std::size_t LWRBatch::addLink(const LWR &model) {
+  const std::size_t link =
+      addLink(model.getFreeFlowSpeed(), model.getJamDensity(),
+              model.getRoadLength(), model.getNumCells());
+  const std::vector<double> &densities = model.getDensities();
+  std::copy(densities.begin(), densities.end(),
+            m_state.begin() + firstCell(link));
+  syncGhosts(link);
+  return link;
+}
+
+void LWRBatch::setParameters(std::size_t link, double free_flow_speed,
+                             double jam_density) {
+  checkPositive(free_flow_speed, "the free-flow speed");
+  checkPositive(jam_density, "the jam density");
+  double *parameter = parameters(link);
+  parameter[FREE_FLOW_SPEED] = free_flow_speed;
+  if (parameter[JAM_DENSITY] != jam_density) {
+    parameter[JAM_DENSITY] = jam_density;
+    parameter[INVERSE_JAM_DENSITY] = 1.0 / jam_density;
+    setDensities(link, getDensities(link));
+  }
+}
+
+void LWRBatch::setDensity(std::size_t link, int cell, double density) {
+  m_state[cellIndex(link, cell)] =
+      std::max(0.0, std::min(getJamDensity(link), density));
+  syncGhosts(link);
+}
+
+void LWRBatch::setDensities(std::size_t link, const double *densities) {
+  const double jam_density = getJamDensity(link);
+  double *cells = m_state.data() + firstCell(link);
+  for (int i = 0; i < getNumCells(link); ++i) {
+    cells[i] = std::max(0.0, std::min(jam_density, densities[i]));
+  }
+  syncGhosts(link);
+}
+
+double LWRBatch::getSpeed(std::size_t link, int cell) const {
+  const double jam_density = getJamDensity(link);
+  const double density = getDensity(link, cell);
+  if (density >= jam_density) {
+    return 0.0;
+  }
+  return getFreeFlowSpeed(link) * (1.0 - density / jam_density);
+}
+
+void LWRBatch::update(double dt, std::size_t begin, std::size_t end) {
+  forEachLink(begin, end, [dt](double *density, double *flux, int num_cells,
+                              const double *parameters) {
+    step(dt, density, flux, num_cells, parameters);
+  });
+}
+
+double LWRBatch::getStableTimeStep(std::size_t link) const {
+  return stableTimeStep(parameters(link));
+}
+
+void LWRBatch::advance(double dt, std::size_t begin, std::size_t end) {
+  forEachLink(begin, end, [dt](double *density, double *flux, int num_cells,
+                              const double *parameters) {
+    const int steps = stableSteps(dt, stableTimeStep(parameters));
+    for (int i = 0; i < steps; ++i) {
+      step(dt / steps, density, flux, num_cells, parameters);
+    }
+  });
+}
+
+double LWRBatch::stableTimeStep(const double *parameters) {
+  return 1.0 / (parameters[FREE_FLOW_SPEED] * parameters[INVERSE_CELL_LENGTH]);
+}
+
+void LWRBatch::step(double dt, double *density, double *flux, int num_cells,
+                    const double *parameters) {
+  const double free_flow_speed = parameters[FREE_FLOW_SPEED];
+  const double jam_density = parameters[JAM_DENSITY];
+  const double inverse_jam = parameters[INVERSE_JAM_DENSITY];
+  const double ratio = dt * parameters[INVERSE_CELL_LENGTH];
+  const double critical = 0.5 * jam_density;
+
+  // The Godunov flux of a concave diagram: the demand upstream, bounded
+  // by the capacity, against the supply downstream
+  for (int i = 0; i <= num_cells; ++i) {
+    const double sending = std::min(density[i - 1], critical);
+    const double receiving = std::max(density[i], critical);
+    const double demand =
+        free_flow_speed * sending * (1.0 - sending * inverse_jam);
+    const double supply =
+        free_flow_speed * receiving * (1.0 - receiving * inverse_jam);
+    flux[i] = std::min(demand, supply);
+  }
+  for (int i = 0; i < num_cells; ++i) {
+    const double next = density[i] - ratio * (flux[i + 1] - flux[i]);
+    density[i] = std::max(0.0, std::min(jam_density, next));
+  }
+  density[-1] = density[num_cells - 1];
+  density[num_cells] = density[0];
+}
+
+std::size_t CTMBatch::addLink(double free_flow_speed, double wave_speed,
+                              double jam_density, double road_length,
+                              int num_cells) {
+  checkPositive(free_flow_speed, "the free-flow speed");
+  checkPositive(wave_speed, "the wave speed");
+  checkPositive(jam_density, "the jam density");
+  checkPositive(road_length, "the road length");
+  const double cell_length = road_length / num_cells;
+  // As CTM: triangular fundamental diagram
+  const double critical_density =
+      jam_density * wave_speed / (free_flow_speed + wave_speed);
+  return addCells(num_cells, cell_length,
+                  {critical_density * free_flow_speed,
+                   jam_density * cell_length, free_flow_speed, wave_speed,
+                   jam_density});
+}
+
+std::size_t CTMBatch::addLink(const CTM &model) {
+  const std::size_t link =
+      addLink(model.getFreeFlowSpeed(), model.getWaveSpeed(),
+              model.getJamDensity(), model.getRoadLength(),
+              model.getNumCells());
+  const std::vector<double> &vehicles = model.getNumVehiclesArray();
+  std::copy(vehicles.begin(), vehicles.end(),
+            m_state.begin() + firstCell(link));
+  syncGhosts(link);
+  return link;
+}
+
+void CTMBatch::setNumVehicles(std::size_t link, int cell,
+                              double num_vehicles) {
+  m_state[cellIndex(link, cell)] = std::max(
+      0.0, std::min(parameters(link)[MAX_VEHICLES], num_vehicles));
+  syncGhosts(link);
+}
+
+double CTMBatch::getSpeed(std::size_t link, int cell) const {
+  const double *link_parameters = parameters(link);
+  const double free_flow_speed = link_parameters[FREE_FLOW_SPEED];
+  const double wave_speed = link_parameters[WAVE_SPEED];
+  const double jam_density = link_parameters[JAM_DENSITY];
+  const double critical_density =
+      jam_density * wave_speed / (free_flow_speed + wave_speed);
+  const double density = getDensity(link, cell);
+  if (density < critical_density) {
+    return free_flow_speed;
+  }
+  return wave_speed * (jam_density - density) /
+         (jam_density - critical_density);
+}
+
+void CTMBatch::update(double dt, std::size_t begin, std::size_t end) {
+  forEachLink(begin, end, [dt](double *vehicles, double *flow, int num_cells,
+                              const double *parameters) {
+    step(dt, vehicles, flow, num_cells, parameters);
+  });
+}
+
+double CTMBatch::getStableTimeStep(std::size_t link) const {
+  return stableTimeStep(parameters(link));
+}
+
+void CTMBatch::advance(double dt, std::size_t begin, std::size_t end) {
+  forEachLink(begin, end, [dt](double *vehicles, double *flow, int num_cells,
+                              const double *parameters) {
+    const int steps = stableSteps(dt, stableTimeStep(parameters));
+    for (int i = 0; i < steps; ++i) {
+      step(dt / steps, vehicles, flow, num_cells, parameters);
+    }
+  });
+}
+
+double CTMBatch::stableTimeStep(const double *parameters) {
+  // The cell length, from the vehicles of a jammed cell
+  return parameters[MAX_VEHICLES] / parameters[JAM_DENSITY] /
+         std::max(parameters[FREE_FLOW_SPEED], parameters[WAVE_SPEED]);
+}
+
+void CTMBatch::step(double dt, double *vehicles, double *flow, int num_cells,
+                    const double *parameters) {
+  const double capacity = parameters[MAX_FLOW] * dt;
+  const double max_vehicles = parameters[MAX_VEHICLES];
+
+  // Vehicles over each boundary during the step, as CTM::update
+  for (int i = 0; i <= num_cells; ++i) {
+    const double sending = std::min(vehicles[i - 1], capacity);
+    const double receiving = std::min(max_vehicles - vehicles[i], capacity);
+    flow[i] = std::min(sending, receiving);
+  }
+  for (int i = 0; i < num_cells; ++i) {
+    const double next = vehicles[i] + flow[i] - flow[i + 1];
+    vehicles[i] = std::max(0.0, std::min(max_vehicles, next));
+  }
+  vehicles[-1] = vehicles[num_cells - 1];
+  vehicles[num_cells] = vehicles[0];
+}
+
+} // namespace models
+} // namespace macroscopic
+} // namespace jamfree
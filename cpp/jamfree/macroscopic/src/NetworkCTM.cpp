@@ -0,0 +1,335 @@
+#include "../include/NetworkCTM.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace jamfree {
+namespace macroscopic {
+namespace models {
+
+using kernel::routing::RoadGraph;
+
+namespace {
+
+constexpr double INFINITE = std::numeric_limits<double>::infinity();
+
+void checkPositive(double value, const char *name) {
+  if (!(value > 0.0) || std::isinf(value)) {
+    throw std::invalid_argument(std::string("NetworkCTM: ") + name +
+                                " must be positive");
+  }
+}
+
+} // namespace
+
+NetworkCTM::NetworkCTM(
+    const std::vector<std::shared_ptr<kernel::model::Road>> &roads,
+    double dt, const Config &config)
+    : m_config(config) {
+  checkPositive(dt, "the time step");
+  checkPositive(config.jam_density, "the jam density");
+  checkPositive(config.wave_speed, "the wave speed");
+  m_graph = std::make_shared<RoadGraph>(roads);
+  const RoadGraph &graph = *m_graph;
+  const std::size_t num_links = graph.getNumEdges();
+
+  // Cells of at least the free-flow distance of a step, so that no vehicle
+  // crosses a cell in one step; a shorter road is a single cell of that
+  // length
+  m_links.resize(num_links);
+  m_first_cell.assign(num_links + 1, 0);
+  for (std::uint32_t l = 0; l < num_links; ++l) {
+    const auto &road = graph.getRoad(l);
+    double speed = 0.0;
+    for (const auto &lane : road->getLanes()) {
+      speed = std::max(speed, lane->getSpeedLimit());
+    }
+    checkPositive(speed, "the speed limit of a road");
+    const double length = graph.getLengths()[l];
+    const double min_length = speed * dt;
+    const std::size_t num_cells = std::max<std::size_t>(
+        1, static_cast<std::size_t>(std::floor(length / min_length)));
+    const double lanes = road->getNumLanes();
+    Link &link = m_links[l];
+    link.cell_length = std::max(length / num_cells, min_length);
+    link.free_flow_speed = speed;
+    link.capacity = lanes * speed * config.wave_speed * config.jam_density /
+                    (speed + config.wave_speed);
+    link.max_vehicles = lanes * config.jam_density * link.cell_length;
+    m_first_cell[l + 1] = m_first_cell[l] + num_cells;
+  }
+  m_vehicles.assign(m_first_cell.back(), 0.0);
+  m_flows.assign(m_first_cell.back() + num_links, 0.0);
+
+  // Turns in proportion to the capacities, no U-turn if avoidable
+  m_first_turn.assign(num_links + 1, 0);
+  for (std::uint32_t l = 0; l < num_links; ++l) {
+    const std::uint32_t node = graph.getTarget(l);
+    m_first_turn[l + 1] = m_first_turn[l] + graph.getFirstEdge(node + 1) -
+                          graph.getFirstEdge(node);
+  }
+  m_turns.assign(m_first_turn.back(), 0.0);
+  std::size_t max_degree = 0;
+  for (std::uint32_t l = 0; l < num_links; ++l) {
+    const std::uint32_t node = graph.getTarget(l);
+    const std::uint32_t first = graph.getFirstEdge(node);
+    const std::uint32_t end = graph.getFirstEdge(node + 1);
+    if (first == end) {
+      continue;
+    }
+    std::vector<double> fractions(end - first, 0.0);
+    bool any = false;
+    for (std::uint32_t out = first; out < end; ++out) {
+      if (graph.getTarget(out) != graph.getSource(l)) {
+        fractions[out - first] = m_links[out].capacity;
+        any = true;
+      }
+    }
+    if (!any) {
+      for (std::uint32_t out = first; out < end; ++out) {
+        fractions[out - first] = m_links[out].capacity;
+      }
+    }
+    setTurningFractions(l, fractions);
+  }
+  for (std::uint32_t node = 0; node < graph.getNumNodes(); ++node) {
+    max_degree = std::max<std::size_t>(
+        max_degree,
+        std::max(graph.getFirstEdge(node + 1) - graph.getFirstEdge(node),
+                 graph.getFirstIncomingEdge(node + 1) -
+                     graph.getFirstIncomingEdge(node)));
+  }
+
+  m_queues.assign(num_links, 0.0);
+  m_sending.assign(num_links, 0.0);
+  m_receiving.assign(num_links, 0.0);
+  m_inflows.assign(num_links, 0.0);
+  m_outflows.assign(num_links, 0.0);
+  m_unresolved.assign(max_degree, 0);
+  m_remaining.assign(max_degree, 0.0);
+}
+
+void NetworkCTM::setTurningFractions(std::uint32_t link,
+                                     const std::vector<double> &fractions) {
+  const std::size_t first = m_first_turn[link];
+  const std::size_t count = m_first_turn[link + 1] - first;
+  if (fractions.size() != count) {
+    throw std::invalid_argument(
+        "NetworkCTM: one turning fraction by outgoing link expected");
+  }
+  double total = 0.0;
+  for (double fraction : fractions) {
+    if (!(fraction >= 0.0) || std::isinf(fraction)) {
+      throw std::invalid_argument("NetworkCTM: invalid turning fraction");
+    }
+    total += fraction;
+  }
+  if (count > 0 && !(total > 0.0)) {
+    throw std::invalid_argument("NetworkCTM: turning fractions all zero");
+  }
+  for (std::size_t j = 0; j < count; ++j) {
+    m_turns[first + j] = fractions[j] / total;
+  }
+}
+
+void NetworkCTM::addVehicles(std::uint32_t link, double vehicles) {
+  if (!(vehicles >= 0.0) || std::isinf(vehicles)) {
+    throw std::invalid_argument("NetworkCTM: invalid number of vehicles");
+  }
+  m_queues[link] += vehicles;
+}
+
+void NetworkCTM::setNumVehicles(std::uint32_t link, std::size_t cell,
+                                double vehicles) {
+  m_vehicles[m_first_cell[link] + cell] =
+      std::max(0.0, std::min(m_links[link].max_vehicles, vehicles));
+}
+
+double NetworkCTM::getNumVehicles(std::uint32_t link) const {
+  double total = 0.0;
+  for (std::size_t c = m_first_cell[link]; c < m_first_cell[link + 1]; ++c) {
+    total += m_vehicles[c];
+  }
+  return total;
+}
+
+double NetworkCTM::getTotalVehicles() const {
+  double total = 0.0;
+  for (double vehicles : m_vehicles) {
+    total += vehicles;
+  }
+  for (double queue : m_queues) {
+    total += queue;
+  }
+  return total;
+}
+
+double NetworkCTM::getSpeed(std::uint32_t link, std::size_t cell) const {
+  const Link &parameters = m_links[link];
+  const double vehicles = getNumVehicles(link, cell);
+  if (vehicles <= 0.0) {
+    return parameters.free_flow_speed;
+  }
+  // Triangular diagram: w (k_jam - k) / k in the congested branch
+  return std::min(parameters.free_flow_speed,
+                  m_config.wave_speed *
+                      (parameters.max_vehicles - vehicles) / vehicles);
+}
+
+void NetworkCTM::getTravelTimes(std::vector<double> &times) const {
+  times.assign(m_links.size(), 0.0);
+  for (std::uint32_t l = 0; l < m_links.size(); ++l) {
+    double time = 0.0;
+    for (std::size_t c = 0; c < getNumCells(l); ++c) {
+      const double speed = getSpeed(l, c);
+      time += speed > 0.0 ? m_links[l].cell_length / speed : INFINITE;
+    }
+    // The cells of a road shorter than a cell cover more than the road
+    const double covered = m_links[l].cell_length * getNumCells(l);
+    if (!std::isinf(time)) {
+      time *= std::min(1.0, m_graph->getLengths()[l] / covered);
+    }
+    times[l] = time;
+  }
+}
+
+void NetworkCTM::solveNode(std::uint32_t node, double dt) {
+  const RoadGraph &graph = *m_graph;
+  const std::uint32_t first_in = graph.getFirstIncomingEdge(node);
+  const std::uint32_t num_in = graph.getFirstIncomingEdge(node + 1) - first_in;
+  const std::uint32_t first_out = graph.getFirstEdge(node);
+  const std::uint32_t num_out = graph.getFirstEdge(node + 1) - first_out;
+
+  if (num_out == 0) {
+    // Out of the network
+    for (std::uint32_t i = 0; i < num_in; ++i) {
+      const std::uint32_t in = graph.getIncomingEdge(first_in + i);
+      m_outflows[in] = m_sending[in];
+      m_exited += m_sending[in];
+    }
+    return;
+  }
+
+  for (std::uint32_t j = 0; j < num_out; ++j) {
+    m_remaining[j] = m_receiving[first_out + j];
+  }
+  std::uint32_t unresolved = 0;
+  for (std::uint32_t i = 0; i < num_in; ++i) {
+    const std::uint32_t in = graph.getIncomingEdge(first_in + i);
+    m_outflows[in] = 0.0;
+    m_unresolved[i] = m_sending[in] > 0.0;
+    unresolved += m_unresolved[i];
+  }
+
+  auto resolve = [&](std::uint32_t i, double flow) {
+    const std::uint32_t in = graph.getIncomingEdge(first_in + i);
+    const double *turns = m_turns.data() + m_first_turn[in];
+    m_outflows[in] = flow;
+    for (std::uint32_t j = 0; j < num_out; ++j) {
+      m_inflows[first_out + j] += turns[j] * flow;
+      m_remaining[j] = std::max(0.0, m_remaining[j] - turns[j] * flow);
+    }
+    m_unresolved[i] = 0;
+    --unresolved;
+  };
+
+  while (unresolved > 0) {
+    // The most restrictive outgoing link, shared by capacity
+    double factor = INFINITE;
+    std::uint32_t restrictive = num_out;
+    for (std::uint32_t j = 0; j < num_out; ++j) {
+      double claims = 0.0;
+      for (std::uint32_t i = 0; i < num_in; ++i) {
+        if (m_unresolved[i]) {
+          const std::uint32_t in = graph.getIncomingEdge(first_in + i);
+          claims += m_links[in].capacity * dt * m_turns[m_first_turn[in] + j];
+        }
+      }
+      if (claims > 0.0 && m_remaining[j] / claims < factor) {
+        factor = m_remaining[j] / claims;
+        restrictive = j;
+      }
+    }
+    if (restrictive == num_out) {
+      break;
+    }
+
+    // The links sending less than their share are not constrained
+    bool constrained = true;
+    for (std::uint32_t i = 0; i < num_in; ++i) {
+      const std::uint32_t in = graph.getIncomingEdge(first_in + i);
+      if (m_unresolved[i] &&
+          m_sending[in] <= factor * m_links[in].capacity * dt) {
+        resolve(i, m_sending[in]);
+        constrained = false;
+      }
+    }
+    if (constrained) {
+      for (std::uint32_t i = 0; i < num_in; ++i) {
+        const std::uint32_t in = graph.getIncomingEdge(first_in + i);
+        if (m_unresolved[i] &&
+            m_turns[m_first_turn[in] + restrictive] > 0.0) {
+          resolve(i, factor * m_links[in].capacity * dt);
+        }
+      }
+    }
+  }
+}
+
+void NetworkCTM::update(double dt) {
+  checkPositive(dt, "the time step");
+  const std::uint32_t num_links = static_cast<std::uint32_t>(m_links.size());
+  const double wave_speed = m_config.wave_speed;
+
+  // Flows between the cells of each link, and its sending and receiving
+  // flows
+  for (std::uint32_t l = 0; l < num_links; ++l) {
+    const Link &link = m_links[l];
+    const double capacity = link.capacity * dt;
+    const double max_vehicles = link.max_vehicles;
+    const double send_ratio =
+        std::min(1.0, link.free_flow_speed * dt / link.cell_length);
+    const double receive_ratio =
+        std::min(1.0, wave_speed * dt / link.cell_length);
+    const double *vehicles = m_vehicles.data() + m_first_cell[l];
+    double *flows = m_flows.data() + m_first_cell[l] + l;
+    const std::size_t num_cells = getNumCells(l);
+    for (std::size_t c = 1; c < num_cells; ++c) {
+      const double sending = std::min(vehicles[c - 1] * send_ratio, capacity);
+      const double receiving =
+          std::min((max_vehicles - vehicles[c]) * receive_ratio, capacity);
+      flows[c] = std::min(sending, receiving);
+    }
+    m_sending[l] =
+        std::min(vehicles[num_cells - 1] * send_ratio, capacity);
+    m_receiving[l] =
+        std::max(0.0, std::min((max_vehicles - vehicles[0]) * receive_ratio,
+                               capacity));
+    m_inflows[l] = 0.0;
+  }
+
+  for (std::uint32_t node = 0; node < m_graph->getNumNodes(); ++node) {
+    solveNode(node, dt);
+  }
+
+  // The entry queues fill the room left, then the cells are updated
+  for (std::uint32_t l = 0; l < num_links; ++l) {
+    const double entering = std::min(
+        m_queues[l], std::max(0.0, m_receiving[l] - m_inflows[l]));
+    m_queues[l] -= entering;
+    double *vehicles = m_vehicles.data() + m_first_cell[l];
+    double *flows = m_flows.data() + m_first_cell[l] + l;
+    const std::size_t num_cells = getNumCells(l);
+    flows[0] = m_inflows[l] + entering;
+    flows[num_cells] = m_outflows[l];
+    for (std::size_t c = 0; c < num_cells; ++c) {
+      vehicles[c] = std::max(0.0, vehicles[c] + flows[c] - flows[c + 1]);
+    }
+  }
+}
+
+} // namespace models
+} // namespace macroscopic
+} // namespace jamfree
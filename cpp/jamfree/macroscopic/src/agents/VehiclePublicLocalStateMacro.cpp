@@ -8,6 +8,10 @@ namespace agents {
 
 VehiclePublicLocalStateMacro::VehiclePublicLocalStateMacro(
     const std::string &ownerId)
+    : VehiclePublicLocalStateMacro(kernel::agents::Symbol(ownerId)) {}
+
+VehiclePublicLocalStateMacro::VehiclePublicLocalStateMacro(
+    kernel::agents::Symbol ownerId)
     : m_ownerId(ownerId), m_level("Macroscopic"), m_density(0.0), m_flow(0.0),
       m_average_speed(0.0), m_current_lane(nullptr), m_cell_position(0.0),
       m_cell_index(0), m_active(true) {}
@@ -36,7 +40,7 @@ bool VehiclePublicLocalStateMacro::isOwnedBy(
   const auto *vehicleAgent =
       dynamic_cast<const kernel::agents::VehicleAgent *>(&agent);
   if (vehicleAgent) {
-    return vehicleAgent->getId() == m_ownerId;
+    return vehicleAgent->getSymbol() == m_ownerId;
   }
   return false;
 }
@@ -0,0 +1,221 @@
+#ifndef JAMFREE_MICROSCOPIC_CALIBRATION_H
+#define JAMFREE_MICROSCOPIC_CALIBRATION_H
+
+#include "../../../microkernel/include/engine/WorkStealingThreadPool.h"
+#include "../../kernel/include/model/DetectorSet.h"
+#include "../../kernel/include/model/Road.h"
+#include "IDM.h"
+#include "MOBIL.h"
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace jamfree {
+namespace microscopic {
+namespace calibration {
+
+/**
+ * @brief A short simulation to score driver parameters on, replayed from
+ * the same initial state by every run.
+ *
+ * The roads are a template: each run builds its own copies of them, with
+ * its own vehicles, so that the runs share nothing and may run at once.
+ */
+struct Scenario {
+  /// A vehicle of the initial state
+  struct VehicleState {
+    std::size_t road; ///< Index in roads
+    int lane;
+    double position; ///< Along the lane (m)
+    double speed;    ///< m/s
+    double length = 5.0;
+    double max_speed = 55.0;
+  };
+
+  /// Vehicles entering a lane at its start, at a steady rate
+  struct Inflow {
+    std::size_t road;
+    int lane;
+    double rate;  ///< Vehicles per second
+    double speed; ///< Speed of entry (m/s)
+    double length = 5.0;
+  };
+
+  /// A loop detector, as DetectorSet::addDetector() takes
+  struct Detector {
+    std::size_t road;
+    int lane;
+    double position;
+    double loop_length = 2.0;
+  };
+
+  std::vector<std::shared_ptr<kernel::model::Road>> roads;
+  std::vector<VehicleState> vehicles;
+  std::vector<Inflow> inflows;
+  std::vector<Detector> detectors;
+  double dt = 0.5;                ///< Time step (s)
+  double duration = 300.0;        ///< Simulated time (s)
+  double detector_period = 60.0;  ///< Aggregation period (s)
+  bool lane_changes = true;       ///< Whether MOBIL changes lanes
+
+  /**
+   * @brief Take the vehicles on the lanes of the roads as the initial
+   * state, e.g. of a network warmed up by a simulation.
+   */
+  void captureVehicles();
+};
+
+/**
+ * @brief Run a scenario with driver models.
+ *
+ * Each step, MOBIL moves the vehicles that gain from it to a neighbouring
+ * lane, the lanes are integrated with the IDM as Simulation does, the
+ * vehicles beyond the end of their lane leave, the inflows enter vehicles
+ * where there is room, and the detectors measure the step.
+ *
+ * @return Reports of the detectors, one period per detector_period
+ */
+kernel::model::DetectorReports simulate(const Scenario &scenario,
+                                        const models::IDM &idm,
+                                        const models::MOBIL &mobil);
+
+/**
+ * @brief Score of simulated reports, lower being better.
+ */
+using Objective = std::function<double(const kernel::model::DetectorReports &)>;
+
+/**
+ * @brief Distance of simulated reports to observed ones.
+ *
+ * The root mean square error of the space-mean speeds (m/s), over the
+ * periods and detectors both have a speed for, plus flow_weight times the
+ * one of the counts; the periods beyond the shorter reports are ignored.
+ */
+Objective detectorError(kernel::model::DetectorReports observed,
+                        double flow_weight = 1.0);
+
+/**
+ * @brief A searched parameter, between bounds.
+ *
+ * The names are those of the setters of the models: "desired_speed",
+ * "time_headway", "min_gap", "max_accel", "comfortable_decel" and
+ * "accel_exponent" for the IDM, "politeness", "threshold",
+ * "max_safe_decel" and "bias_right" for MOBIL.
+ */
+struct Parameter {
+  std::string name;
+  double lower;
+  double upper;
+  double initial;
+};
+
+/**
+ * @brief Outcome of a calibration.
+ */
+struct CalibrationResult {
+  std::vector<double> values; ///< Best values, in the order of parameters
+  double objective = 0.0;     ///< Their score
+  std::size_t evaluations = 0;
+  std::size_t iterations = 0;
+};
+
+/**
+ * @brief Searches driver parameters minimizing an objective, over
+ * simulations of a scenario run in parallel.
+ *
+ * The search is a Nelder-Mead simplex over the parameters scaled to
+ * [0, 1], the points out of the bounds being clamped. Its steps are made
+ * parallel by evaluating at once what a step may need: the points of the
+ * initial simplex, then at each iteration the reflection, the expansion
+ * and both contractions, and the points of a shrink. Each evaluation is a
+ * simulate() of its own, so the result does not depend on the number of
+ * threads.
+ */
+class Calibrator {
+public:
+  /**
+   * @brief Search parameters.
+   */
+  struct Config {
+    std::size_t max_iterations = 200;
+    std::size_t max_evaluations = 2000;
+    /// Spread of the scores of the simplex at which the search stops
+    double tolerance = 1e-6;
+    /// Size of the initial simplex, as a fraction of the ranges
+    double initial_step = 0.2;
+    /// Threads running the simulations (0 = hardware threads)
+    std::size_t num_threads = 0;
+
+    Config() = default;
+  };
+
+  /**
+   * @param scenario Scenario run by every evaluation
+   * @param parameters Parameters searched
+   * @param objective Score of the reports of a run
+   * @throws std::invalid_argument If there are no parameters, a name is
+   *         unknown or bounds are empty, or the objective is empty
+   */
+  Calibrator(Scenario scenario, std::vector<Parameter> parameters,
+             Objective objective);
+
+  /**
+   * @param config Search parameters
+   */
+  Calibrator(Scenario scenario, std::vector<Parameter> parameters,
+             Objective objective, const Config &config);
+
+  /**
+   * @brief Set the models whose parameters are not searched.
+   */
+  void setBaseModels(const models::IDM &idm, const models::MOBIL &mobil) {
+    m_idm = idm;
+    m_mobil = mobil;
+  }
+
+  /**
+   * @brief Score parameter values, with one simulation.
+   */
+  double evaluate(const std::vector<double> &values) const;
+
+  /**
+   * @brief Score several parameter vectors, their simulations in parallel.
+   */
+  std::vector<double>
+  evaluateAll(const std::vector<std::vector<double>> &candidates);
+
+  /**
+   * @brief Search from the initial values of the parameters.
+   */
+  CalibrationResult run();
+
+  /**
+   * @brief Set a parameter of the models by name.
+   *
+   * @throws std::invalid_argument If the name is unknown
+   */
+  static void applyParameter(const std::string &name, double value,
+                             models::IDM &idm, models::MOBIL &mobil);
+
+private:
+  using ThreadPool =
+      fr::univ_artois::lgi2a::similar::microkernel::engine::
+          WorkStealingThreadPool;
+
+  Scenario m_scenario;
+  std::vector<Parameter> m_parameters;
+  Objective m_objective;
+  Config m_config;
+  models::IDM m_idm;
+  models::MOBIL m_mobil;
+  std::unique_ptr<ThreadPool> m_pool;
+  std::size_t m_evaluations = 0;
+};
+
+} // namespace calibration
+} // namespace microscopic
+} // namespace jamfree
+
+#endif // JAMFREE_MICROSCOPIC_CALIBRATION_H
@@ -0,0 +1,88 @@
+#ifndef JAMFREE_MICROSCOPIC_MODELS_CAR_FOLLOWING_MODEL_H
+#define JAMFREE_MICROSCOPIC_MODELS_CAR_FOLLOWING_MODEL_H
+
+#include "../../kernel/include/model/LaneVehicleStore.h"
+#include "../../kernel/include/model/Vehicle.h"
+#include "IDM.h"
+#include "IDMLookup.h"
+#include <cstddef>
+#include <variant>
+
+namespace jamfree {
+namespace microscopic {
+namespace models {
+
+/**
+ * @brief One of the car-following models, chosen per vehicle class.
+ *
+ * The models do not share a virtual interface: each has its own inline
+ * calculateAcceleration(v, s, dv) and computeAccelerations() batch, so that
+ * the code instantiated for a model type, such as
+ * ForwardAccelerationDMSFor or LaneVehicleStore::computeAccelerations(),
+ * inlines its acceleration. A fleet mixing models holds this variant
+ * instead, dispatched once per call (per lane for a batch) rather than
+ * once per vehicle. IDMEnhanced, which depends on the traffic controls and
+ * the route of its vehicle, is not one of them.
+ */
+using CarFollowingModel = std::variant<IDM, IDMPlus, IDMLookup>;
+
+/**
+ * @brief Get the IDM parameters of a model.
+ */
+inline const IDM &getParameters(const CarFollowingModel &model) {
+  return std::visit([](const auto &m) -> const IDM & { return m; }, model);
+}
+
+/**
+ * @brief Calculate acceleration from raw values with a model.
+ *
+ * @param v Current speed (m/s)
+ * @param s Gap to leader (m), infinite without leader
+ * @param dv Relative speed to leader (v - v_leader) (m/s)
+ * @return Acceleration in m/s²
+ */
+inline double calculateAcceleration(const CarFollowingModel &model, double v,
+                                    double s, double dv) {
+  return std::visit(
+      [&](const auto &m) { return m.calculateAcceleration(v, s, dv); }, model);
+}
+
+/**
+ * @brief Calculate the acceleration of a vehicle with a model.
+ *
+ * @param leader Vehicle ahead (nullptr if no leader)
+ */
+inline double
+calculateAcceleration(const CarFollowingModel &model,
+                      const kernel::model::Vehicle &vehicle,
+                      const kernel::model::Vehicle *leader = nullptr) {
+  return std::visit(
+      [&](const auto &m) { return m.calculateAcceleration(vehicle, leader); },
+      model);
+}
+
+/**
+ * @brief Calculate the accelerations of a batch of vehicles with a model.
+ */
+inline void computeAccelerations(const CarFollowingModel &model,
+                                 const double *v, const double *gap,
+                                 const double *dv, double *out,
+                                 std::size_t n) {
+  std::visit([&](const auto &m) { m.computeAccelerations(v, gap, dv, out, n); },
+             model);
+}
+
+/**
+ * @brief Compute the accelerations of the vehicles of a store with a model,
+ * the pass being instantiated for the type it holds.
+ */
+inline void computeAccelerations(const CarFollowingModel &model,
+                                 kernel::model::LaneVehicleStore &store) {
+  std::visit([&](const auto &m) { store.computeAccelerations(m); }, model);
+}
+
+} // namespace models
+} // namespace microscopic
+} // namespace jamfree
+
+#endif // JAMFREE_MICROSCOPIC_MODELS_CAR_FOLLOWING_MODEL_H
@@ -1,9 +1,13 @@
 #ifndef JAMFREE_MICROSCOPIC_MODELS_IDM_H
 #define JAMFREE_MICROSCOPIC_MODELS_IDM_H
 
+#include "../../kernel/include/model/LaneVehicleStore.h"
 #include "../../kernel/include/model/Vehicle.h"
 #include "../../kernel/include/tools/MathTools.h"
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <limits>
 #include <memory>
 
 namespace jamfree {
@@ -115,6 +119,34 @@ public:
     return accel_free + accel_interaction;
   }
 
+  /**
+   * @brief Calculate the accelerations of a batch of vehicles.
+   *
+   * The same as calculateAcceleration(v, s, dv) for each vehicle, an
+   * infinite gap meaning no leader, but branchless, so that the compiler
+   * vectorizes the loop. The common exponent 4 uses multiplies instead of
+   * std::pow, which would keep the loop scalar. The loop computes in the type
+   * of the values, float doubling the vehicles per vector instruction.
+   *
+   * @tparam T double or float, as kernel::tools::Precision::State
+   * @param v Current speeds (m/s)
+   * @param gap Gaps to the leaders (m), infinite without leader
+   * @param dv Relative speeds to the leaders (m/s)
+   * @param out Accelerations in m/s² (may alias an input)
+   * @param n Number of vehicles
+   */
+  template <typename T>
+  void computeAccelerations(const T *v, const T *gap, const T *dv, T *out,
+                            std::size_t n) const {
+    if (m_accel_exponent == 4.0) {
+      computeAccelerationsWith<4>(v, gap, dv, out, n);
+    } else if (m_accel_exponent == 2.0) {
+      computeAccelerationsWith<2>(v, gap, dv, out, n);
+    } else {
+      computeAccelerationsWith<0>(v, gap, dv, out, n);
+    }
+  }
+
   /**
    * @brief Calculate desired gap.
    *
@@ -137,6 +169,16 @@ public:
     return s0 + speed * T + interaction;
   }
 
+  /**
+   * @brief Get the parameters, for the passes of a LaneVehicleStore.
+   *
+   * @return Driver parameters
+   */
+  kernel::model::DriverParameters getDriverParameters() const {
+    return {m_desired_speed, m_time_headway,      m_min_gap,
+            m_max_accel,     m_comfortable_decel, m_accel_exponent};
+  }
+
   // Getters
   double getDesiredSpeed() const { return m_desired_speed; }
   double getTimeHeadway() const { return m_time_headway; }
@@ -154,6 +196,36 @@ public:
   void setAccelExponent(double delta) { m_accel_exponent = delta; }
 
 private:
+  // (v / v0)^delta, by multiplies for an integer Delta, std::pow for 0
+  template <int Delta, typename T> T speedPower(T ratio) const {
+    if constexpr (Delta == 0) {
+      return std::pow(ratio, static_cast<T>(m_accel_exponent));
+    }
+    T power = ratio;
+    for (int i = 1; i < Delta; ++i) {
+      power *= ratio;
+    }
+    return power;
+  }
+
+  template <int Delta, typename T>
+  void computeAccelerationsWith(const T *v, const T *gap, const T *dv, T *out,
+                                std::size_t n) const {
+    const T a = static_cast<T>(m_max_accel);
+    const T inv_v0 = static_cast<T>(1.0 / m_desired_speed);
+    const T s0 = static_cast<T>(m_min_gap);
+    const T headway = static_cast<T>(m_time_headway);
+    const T inv_braking = static_cast<T>(
+        1.0 / (2.0 * std::sqrt(m_max_accel * m_comfortable_decel)));
+    for (std::size_t i = 0; i < n; ++i) {
+      const T speed = v[i];
+      const T s_star = s0 + speed * headway + speed * dv[i] * inv_braking;
+      // Zero for an infinite gap
+      const T ratio = s_star / gap[i];
+      out[i] = a * (T(1) - speedPower<Delta>(speed * inv_v0) - ratio * ratio);
+    }
+  }
+
   double m_desired_speed;     ///< v₀: Desired speed (m/s)
   double m_time_headway;      ///< T: Desired time headway (s)
   double m_min_gap;           ///< s₀: Minimum gap (m)
@@ -180,13 +252,21 @@ public:
     if (leader == nullptr) {
       return IDM::calculateAcceleration(vehicle, leader);
     }
+    return calculateAcceleration(vehicle.getSpeed(), vehicle.getGapTo(*leader),
+                                 vehicle.getRelativeSpeedTo(*leader));
+  }
 
-    double accel_idm = IDM::calculateAcceleration(vehicle, leader);
-
-    // Emergency braking term
-    double s = vehicle.getGapTo(*leader);
-    double v = vehicle.getSpeed();
-    double dv = vehicle.getRelativeSpeedTo(*leader);
+  /**
+   * @brief Calculate acceleration with improved emergency braking, from raw
+   * values.
+   *
+   * @param v Current speed (m/s)
+   * @param s Gap to leader (m), infinite without leader
+   * @param dv Relative speed to leader (v - v_leader) (m/s)
+   * @return Acceleration in m/s²
+   */
+  double calculateAcceleration(double v, double s, double dv) const {
+    double accel_idm = IDM::calculateAcceleration(v, s, dv);
 
     // Critical gap for collision avoidance
     double s_crit = getMinGap() + v * getTimeHeadway();
@@ -199,6 +279,36 @@ public:
 
     return accel_idm;
   }
+
+  /**
+   * @brief Calculate the accelerations of a batch of vehicles, as
+   * IDM::computeAccelerations() does, with the emergency braking.
+   */
+  template <typename T>
+  void computeAccelerations(const T *v, const T *gap, const T *dv, T *out,
+                            std::size_t n) const {
+    // By blocks, the inputs of a vehicle being read before its output is
+    // written, so that out may still alias an input
+    constexpr std::size_t BLOCK = 64;
+    T accel_idm[BLOCK];
+    const T s0 = static_cast<T>(getMinGap());
+    const T headway = static_cast<T>(getTimeHeadway());
+    const T b = static_cast<T>(getComfortableDecel());
+    for (std::size_t begin = 0; begin < n; begin += BLOCK) {
+      const std::size_t count = std::min(BLOCK, n - begin);
+      IDM::computeAccelerations(v + begin, gap + begin, dv + begin, accel_idm,
+                                count);
+      for (std::size_t i = 0; i < count; ++i) {
+        const T s = gap[begin + i];
+        const T s_crit = s0 + v[begin + i] * headway;
+        const T accel_emergency =
+            s < s_crit && dv[begin + i] > 0
+                ? -b * (s_crit - s) / s_crit
+                : std::numeric_limits<T>::infinity();
+        out[begin + i] = std::min(accel_idm[i], accel_emergency);
+      }
+    }
+  }
 };
 
 } // namespace models
@@ -140,35 +140,37 @@ private:
 
     // Look ahead for traffic controls
     double look_ahead = 50.0; // meters
-    auto controls =
-        m_traffic_control_manager->getControlsNear(position, look_ahead);
-
     double min_accel = std::numeric_limits<double>::max();
 
-    for (const auto &control : controls) {
-      if (control->shouldStop(position, speed)) {
-        // Calculate deceleration needed to stop
-        double distance = position.distanceTo(control->getPosition());
-        distance -= control->getStoppingDistance();
-
-        if (distance > 0) {
-          // a = -v² / (2 * d)
-          double required_decel = -(speed * speed) / (2.0 * distance);
-
-          // Add safety margin
-          required_decel *= 1.2;
-
-          // Clamp to comfortable deceleration
-          required_decel =
-              std::max(required_decel, -getComfortableDecel() * 1.5);
-
-          min_accel = std::min(min_accel, required_decel);
-        } else {
-          // Too close, emergency brake
-          min_accel = -getComfortableDecel() * 2.0;
-        }
-      }
-    }
+    // Through the grid of the manager, without a list of the controls
+    m_traffic_control_manager->forEachControlNear(
+        position, look_ahead,
+        [&](const std::shared_ptr<kernel::model::TrafficControl> &control) {
+          if (!control->shouldStop(position, speed)) {
+            return true;
+          }
+          // Calculate deceleration needed to stop
+          double distance = position.distanceTo(control->getPosition());
+          distance -= control->getStoppingDistance();
+
+          if (distance > 0) {
+            // a = -v² / (2 * d)
+            double required_decel = -(speed * speed) / (2.0 * distance);
+
+            // Add safety margin
+            required_decel *= 1.2;
+
+            // Clamp to comfortable deceleration
+            required_decel =
+                std::max(required_decel, -getComfortableDecel() * 1.5);
+
+            min_accel = std::min(min_accel, required_decel);
+          } else {
+            // Too close, emergency brake
+            min_accel = -getComfortableDecel() * 2.0;
+          }
+          return true;
+        });
 
     return (min_accel == std::numeric_limits<double>::max()) ? getMaxAccel()
                                                              : min_accel;
@@ -2,10 +2,17 @@
 #define JAMFREE_MICROSCOPIC_MODELS_MOBIL_H
 
 #include "../../kernel/include/model/Lane.h"
+#include "../../kernel/include/model/Road.h"
 #include "../../kernel/include/model/Vehicle.h"
 #include "IDM.h"
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <limits>
 #include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
 namespace jamfree {
 namespace microscopic {
@@ -97,6 +104,183 @@ public:
     return Direction::NONE;
   }
 
+  /**
+   * @brief Evaluate the changes of all the vehicles of a lane to a target
+   * lane, in one pass.
+   *
+   * The same criteria as for decideLaneChange(), the neighbours being found
+   * by walking the two sorted lanes together instead of searching them for
+   * each vehicle. The accelerations of the vehicles in their own lane, as
+   * computed for the step, are reused: those of the vehicle, of its
+   * follower and of the new follower before the change, leaving three IDM
+   * evaluations per vehicle instead of six.
+   *
+   * @param lane Current lane
+   * @param lane_accels Accelerations of the vehicles of lane, in its order
+   * @param target Target lane
+   * @param target_accels Accelerations of the vehicles of target
+   * @param cf_model Car-following model
+   * @param advantages Advantage of each vehicle of lane, in its order
+   *                   (-infinity if unsafe)
+   */
+  void evaluateLaneChanges(const kernel::model::Lane &lane,
+                           const double *lane_accels,
+                           const kernel::model::Lane &target,
+                           const double *target_accels,
+                           const IDM &cf_model, double *advantages) const {
+    const auto &vehicles = lane.getVehicles();
+    const auto &others = target.getVehicles();
+    const std::size_t n = vehicles.size();
+    const std::size_t m = others.size();
+
+    // Leaders are the first vehicles strictly ahead, followers the last
+    // ones strictly behind, as for Lane::getLeader() and getFollower()
+    std::size_t leader = 0;
+    std::size_t follower = 0; // one past the follower
+    std::size_t target_leader = 0;
+    std::size_t target_follower = 0;
+    for (std::size_t k = 0; k < n; ++k) {
+      const kernel::model::Vehicle &vehicle = *vehicles[k];
+      const double position = vehicle.getLanePosition();
+      leader = std::max(leader, k);
+      while (leader < n && vehicles[leader]->getLanePosition() <= position) {
+        ++leader;
+      }
+      while (vehicles[follower]->getLanePosition() < position) {
+        ++follower;
+      }
+      while (target_leader < m &&
+             others[target_leader]->getLanePosition() <= position) {
+        ++target_leader;
+      }
+      while (target_follower < m &&
+             others[target_follower]->getLanePosition() < position) {
+        ++target_follower;
+      }
+      const kernel::model::Vehicle *new_leader =
+          target_leader < m ? others[target_leader].get() : nullptr;
+
+      // Safety criterion: Check if new follower can brake safely
+      double new_follower_disadvantage = 0.0;
+      if (target_follower > 0) {
+        const auto &new_follower = *others[target_follower - 1];
+        double accel_after =
+            cf_model.calculateAcceleration(new_follower, &vehicle);
+        if (accel_after < -m_max_safe_decel) {
+          advantages[k] = -std::numeric_limits<double>::infinity();
+          continue;
+        }
+        new_follower_disadvantage =
+            accel_after - target_accels[target_follower - 1];
+      }
+
+      // Own advantage
+      double own_advantage =
+          cf_model.calculateAcceleration(vehicle, new_leader) -
+          lane_accels[k];
+
+      // Old follower's advantage (in current lane)
+      double old_follower_advantage = 0.0;
+      if (follower > 0) {
+        const kernel::model::Vehicle *old_leader =
+            leader < n ? vehicles[leader].get() : nullptr;
+        old_follower_advantage =
+            cf_model.calculateAcceleration(*vehicles[follower - 1],
+                                           old_leader) -
+            lane_accels[follower - 1];
+      }
+
+      advantages[k] =
+          own_advantage +
+          m_politeness * (old_follower_advantage + new_follower_disadvantage);
+    }
+  }
+
+  /**
+   * @brief Decide the lane changes of all the vehicles of a road.
+   *
+   * Evaluates each lane against its neighbours with evaluateLaneChanges(),
+   * the lanes being shared among threads. Lower lane indices are on the
+   * left, as for the ChangeLane influences.
+   *
+   * @param road Road whose lanes are sorted
+   * @param accelerations Accelerations of the vehicles of each lane, in its
+   *                      order, as computed for the step
+   * @param cf_model Car-following model
+   * @param decisions Direction of each vehicle of each lane
+   * @param num_threads Number of threads (at least 1)
+   * @throws std::invalid_argument If the accelerations do not match the
+   *         lanes
+   */
+  void decideLaneChanges(const kernel::model::Road &road,
+                         const std::vector<std::vector<double>> &accelerations,
+                         const IDM &cf_model,
+                         std::vector<std::vector<Direction>> &decisions,
+                         unsigned num_threads = 1) const {
+    const int num_lanes = road.getNumLanes();
+    if (accelerations.size() != static_cast<std::size_t>(num_lanes)) {
+      throw std::invalid_argument("MOBIL: one acceleration list per lane");
+    }
+    for (int i = 0; i < num_lanes; ++i) {
+      if (accelerations[i].size() != road.getLane(i)->getVehicles().size()) {
+        throw std::invalid_argument(
+            "MOBIL: one acceleration per vehicle of the lane");
+      }
+    }
+    decisions.resize(num_lanes);
+
+    auto decide_lanes = [&](int first) {
+      std::vector<double> left;
+      std::vector<double> right;
+      for (int i = first; i < num_lanes;
+           i += static_cast<int>(num_threads)) {
+        const auto &lane = *road.getLane(i);
+        const std::size_t n = lane.getVehicles().size();
+        const double no_lane = -std::numeric_limits<double>::infinity();
+        left.assign(n, no_lane);
+        right.assign(n, no_lane);
+        if (i > 0) {
+          evaluateLaneChanges(lane, accelerations[i].data(),
+                              *road.getLane(i - 1),
+                              accelerations[i - 1].data(), cf_model,
+                              left.data());
+        }
+        if (i + 1 < num_lanes) {
+          evaluateLaneChanges(lane, accelerations[i].data(),
+                              *road.getLane(i + 1),
+                              accelerations[i + 1].data(), cf_model,
+                              right.data());
+        }
+
+        // The best direction, the right lane with its bias
+        auto &lane_decisions = decisions[i];
+        lane_decisions.assign(n, Direction::NONE);
+        for (std::size_t k = 0; k < n; ++k) {
+          double best = left[k];
+          Direction direction = Direction::LEFT;
+          if (right[k] + m_bias_right > best) {
+            best = right[k] + m_bias_right;
+            direction = Direction::RIGHT;
+          }
+          if (best > m_threshold) {
+            lane_decisions[k] = direction;
+          }
+        }
+      }
+    };
+
+    num_threads = std::max(1u, std::min(num_threads,
+                                        static_cast<unsigned>(num_lanes)));
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < num_threads; ++t) {
+      workers.emplace_back(decide_lanes, static_cast<int>(t));
+    }
+    decide_lanes(0);
+    for (auto &worker : workers) {
+      worker.join();
+    }
+  }
+
   // Setters
   void setPoliteness(double p) { m_politeness = p; }
   void setThreshold(double t) { m_threshold = t; }
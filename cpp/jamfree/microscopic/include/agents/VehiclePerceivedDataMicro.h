@@ -37,6 +37,14 @@ public:
   kernel::agents::SimulationTimeStamp getTransitoryPeriodMin() const override;
   kernel::agents::SimulationTimeStamp getTransitoryPeriodMax() const override;
 
+  /**
+   * @brief Clear the data for a new perception refilling them.
+   * @return true, the data being always reusable
+   */
+  bool reset(const kernel::agents::SimulationTimeStamp &timeLowerBound,
+             const kernel::agents::SimulationTimeStamp &timeUpperBound)
+      override;
+
   void setTransitoryPeriodMin(kernel::agents::SimulationTimeStamp t) {
     m_transitory_min = t;
   }
@@ -0,0 +1,65 @@
+#ifndef JAMFREE_MICROSCOPIC_AGENTS_VEHICLE_PERCEIVED_RECORD_MICRO_H
+#define JAMFREE_MICROSCOPIC_AGENTS_VEHICLE_PERCEIVED_RECORD_MICRO_H
+
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+namespace jamfree {
+namespace microscopic {
+namespace agents {
+
+/**
+ * @brief Fixed-size perceived data of a vehicle, stored by value in the
+ * array of its lane.
+ *
+ * The same information as VehiclePerceivedDataMicro for the car-following
+ * and the lane changes, without pointers: the neighbours are indices in
+ * the sorted vehicles of their lane, so that a lane of records is filled
+ * by VehiclePerceptionModelMicro::perceiveLane() without allocating, and
+ * read back as plain columns.
+ */
+struct VehiclePerceivedRecordMicro {
+  /// Index of no vehicle
+  static constexpr std::uint32_t NONE =
+      std::numeric_limits<std::uint32_t>::max();
+
+  /// Sides, indexing lanes: the left, the current and the right lane
+  enum Side : std::uint8_t { LEFT = 0, CURRENT = 1, RIGHT = 2 };
+
+  /**
+   * @brief The neighbours of the vehicle in a lane.
+   *
+   * The gaps are as Vehicle::getGapTo() computes them, infinite without a
+   * neighbour within the perception range.
+   */
+  struct Neighbours {
+    std::uint32_t leader;        ///< Index in the lane, or NONE
+    std::uint32_t follower;      ///< Index in the lane, or NONE
+    double gap_to_leader;        ///< From the front of the vehicle (m)
+    double gap_to_follower;      ///< From the front of the follower (m)
+    double leader_relative_speed;   ///< v - v_leader (m/s), 0 without
+    double follower_relative_speed; ///< v_follower - v (m/s), 0 without
+  };
+
+  /// By Side; the neighbours in a missing lane are none
+  Neighbours lanes[3];
+  double distance_to_lane_end; ///< m
+  double speed_limit;          ///< Of the current lane (m/s)
+  bool has_left_lane;
+  bool has_right_lane;
+
+  const Neighbours &current() const { return lanes[CURRENT]; }
+  const Neighbours &left() const { return lanes[LEFT]; }
+  const Neighbours &right() const { return lanes[RIGHT]; }
+};
+
+static_assert(std::is_trivially_copyable<VehiclePerceivedRecordMicro>::value &&
+                  std::is_standard_layout<VehiclePerceivedRecordMicro>::value,
+              "perceived records are plain data");
+
+} // namespace agents
+} // namespace microscopic
+} // namespace jamfree
+
+#endif // JAMFREE_MICROSCOPIC_AGENTS_VEHICLE_PERCEIVED_RECORD_MICRO_H
@@ -26,6 +26,21 @@ public:
    */
   explicit VehiclePrivateLocalStateMicro(const std::string &ownerId);
 
+  /**
+   * @brief Constructor.
+   * @param ownerId The interned identifier of the agent owning this state.
+   */
+  explicit VehiclePrivateLocalStateMicro(kernel::agents::Symbol ownerId);
+
+  /**
+   * @brief Reset to the state of a new vehicle, for a pool to reuse it.
+   * @param ownerId The identifier of the agent owning this state.
+   */
+  void reset(const std::string &ownerId) {
+    reset(kernel::agents::Symbol(ownerId));
+  }
+  void reset(kernel::agents::Symbol ownerId);
+
   /**
    * @brief Clone this state.
    * @return Cloned state
@@ -107,7 +122,7 @@ public:
   }
 
 private:
-  std::string m_ownerId;
+  kernel::agents::Symbol m_ownerId;
   kernel::agents::LevelIdentifier m_level;
 
   // IDM parameters
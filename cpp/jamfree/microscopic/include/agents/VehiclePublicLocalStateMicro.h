@@ -4,6 +4,7 @@
 #include "../../../kernel/include/agents/Interfaces.h"
 #include "../../../kernel/include/model/Lane.h"
 #include "../../../kernel/include/model/Point2D.h"
+#include <cstddef>
 #include <memory>
 
 namespace jamfree {
@@ -18,12 +19,32 @@ namespace agents {
  */
 class VehiclePublicLocalStateMicro : public kernel::agents::ILocalState {
 public:
+  /**
+   * @brief Agent index of a state no reaction has indexed yet.
+   */
+  static constexpr std::size_t NO_AGENT_INDEX = static_cast<std::size_t>(-1);
+
   /**
    * @brief Constructor.
    * @param ownerId The identifier of the agent owning this state.
    */
   explicit VehiclePublicLocalStateMicro(const std::string &ownerId);
 
+  /**
+   * @brief Constructor.
+   * @param ownerId The interned identifier of the agent owning this state.
+   */
+  explicit VehiclePublicLocalStateMicro(kernel::agents::Symbol ownerId);
+
+  /**
+   * @brief Reset to the state of a new vehicle, for a pool to reuse it.
+   * @param ownerId The identifier of the agent owning this state.
+   */
+  void reset(const std::string &ownerId) {
+    reset(kernel::agents::Symbol(ownerId));
+  }
+  void reset(kernel::agents::Symbol ownerId);
+
   /**
    * @brief Clone this state.
    * @return Cloned state
@@ -50,7 +71,22 @@ public:
   /**
    * @brief Gets the owner ID.
    */
-  std::string getOwnerId() const { return m_ownerId; }
+  const std::string &getOwnerId() const { return m_ownerId.str(); }
+
+  /**
+   * @brief Gets the interned owner ID.
+   */
+  kernel::agents::Symbol getOwnerSymbol() const { return m_ownerId; }
+
+  /**
+   * @brief Gets the index of the owner among the agents of its engine.
+   *
+   * Assigned by the reaction model at each step, and carried by the
+   * influences targeting this state so that the reaction writes it
+   * directly; NO_AGENT_INDEX until then.
+   */
+  std::size_t getAgentIndex() const { return m_agent_index; }
+  void setAgentIndex(std::size_t index) { m_agent_index = index; }
 
   // Position and orientation
   const kernel::model::Point2D &getPosition() const { return m_position; }
@@ -93,7 +129,8 @@ public:
   void setActive(bool active) { m_active = active; }
 
 private:
-  std::string m_ownerId;
+  kernel::agents::Symbol m_ownerId;
+  std::size_t m_agent_index = NO_AGENT_INDEX;
   kernel::agents::LevelIdentifier m_level;
 
   // Position and orientation
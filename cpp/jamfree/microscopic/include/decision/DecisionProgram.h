@@ -0,0 +1,123 @@
+#ifndef JAMFREE_MICROSCOPIC_DECISION_DECISION_PROGRAM_H
+#define JAMFREE_MICROSCOPIC_DECISION_DECISION_PROGRAM_H
+
+#include "IDecisionMicroSubmodel.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace jamfree {
+namespace microscopic {
+namespace decision {
+
+/**
+ * @brief A tree of Decision Micro Sub-models flattened into a linear
+ * program.
+ *
+ * compile() walks the tree once: SubsumptionDMS and ConjunctionDMS nodes
+ * become jumps and accumulations over a register holding whether the last
+ * sub-model handled the situation, nested composites of the same kind are
+ * merged with their parent and composites of a single sub-model replaced
+ * by it, so that executing a decision is one loop over the leaves reached,
+ * without the virtual calls and shared_ptr walks of the composites. The
+ * leaves, e.g. ForwardAccelerationDMS and LaneChangeDMS, are called as in
+ * the tree, in the same order, and produce the same influences.
+ *
+ * A program is immutable and may be shared by the decision models of all
+ * the vehicles of a driver profile, and executed by several threads at
+ * once if its leaves may. The tree is read at compile time only: the
+ * sub-models added to it afterwards are not in the program.
+ */
+class DecisionProgram {
+public:
+  /// Most nested ConjunctionDMS, once merged
+  static constexpr std::size_t MAX_CONJUNCTION_DEPTH = 64;
+
+  /**
+   * @brief The states of a vehicle to decide for.
+   */
+  struct Inputs {
+    const agents::VehiclePublicLocalStateMicro *publicState;
+    const agents::VehiclePrivateLocalStateMicro *privateState;
+    const agents::VehiclePerceivedDataMicro *perceivedData;
+  };
+
+  /**
+   * @brief Flatten a DMS tree.
+   *
+   * @param root Root of the tree, kept alive by the program
+   * @throws std::invalid_argument If root is null, or conjunctions are
+   *         nested deeper than MAX_CONJUNCTION_DEPTH
+   */
+  static std::shared_ptr<const DecisionProgram>
+  compile(std::shared_ptr<IDecisionMicroSubmodel> root);
+
+  /**
+   * @brief Decide for a vehicle, as manageDecision() on the root does.
+   *
+   * @return true if the root handled the situation
+   */
+  bool execute(kernel::agents::SimulationTimeStamp timeLowerBound,
+               kernel::agents::SimulationTimeStamp timeUpperBound,
+               const agents::VehiclePublicLocalStateMicro &publicState,
+               const agents::VehiclePrivateLocalStateMicro &privateState,
+               const agents::VehiclePerceivedDataMicro &perceivedData,
+               const kernel::agents::GlobalState &globalState,
+               kernel::agents::InfluencesMap &producedInfluences) const;
+
+  /**
+   * @brief Decide for vehicles sharing the profile, e.g. the ones of a
+   * lane, in one loop.
+   *
+   * The influences are produced in the order of the vehicles.
+   *
+   * @return Number of vehicles whose situation was handled
+   */
+  std::size_t executeAll(kernel::agents::SimulationTimeStamp timeLowerBound,
+                         kernel::agents::SimulationTimeStamp timeUpperBound,
+                         const std::vector<Inputs> &vehicles,
+                         const kernel::agents::GlobalState &globalState,
+                         kernel::agents::InfluencesMap &producedInfluences)
+      const;
+
+  const std::shared_ptr<IDecisionMicroSubmodel> &getRoot() const {
+    return m_root;
+  }
+
+  /** @brief Number of instructions. */
+  std::size_t size() const { return m_code.size(); }
+
+  /** @brief Number of leaf calls, a leaf reached twice counting twice. */
+  std::size_t getLeafCount() const { return m_leaf_count; }
+
+private:
+  enum class Op : std::uint8_t {
+    CALL,            ///< handled = leaf->manageDecision()
+    JUMP_IF_HANDLED, ///< Priority of a SubsumptionDMS
+    BEGIN_ANY,       ///< Start of a ConjunctionDMS
+    ACCUMULATE,      ///< any |= handled
+    END_ANY,         ///< handled = any, end of a ConjunctionDMS
+    CLEAR            ///< handled = false, an empty composite
+  };
+
+  struct Instruction {
+    Op op;
+    std::uint32_t target; ///< Of a jump
+    IDecisionMicroSubmodel *leaf;
+  };
+
+  std::shared_ptr<IDecisionMicroSubmodel> m_root;
+  std::vector<Instruction> m_code;
+  std::size_t m_leaf_count = 0;
+
+  DecisionProgram() = default;
+
+  void emit(IDecisionMicroSubmodel &node, std::size_t depth);
+};
+
+} // namespace decision
+} // namespace microscopic
+} // namespace jamfree
+
+#endif // JAMFREE_MICROSCOPIC_DECISION_DECISION_PROGRAM_H
@@ -5,6 +5,7 @@
 #include "../agents/VehiclePerceivedDataMicro.h"
 #include "../agents/VehiclePrivateLocalStateMicro.h"
 #include "../agents/VehiclePublicLocalStateMicro.h"
+#include "DecisionProgram.h"
 #include "IDecisionMicroSubmodel.h"
 #include <memory>
 
@@ -31,6 +32,17 @@ public:
   explicit VehicleDecisionModelMicro(
       std::shared_ptr<IDecisionMicroSubmodel> rootDMS);
 
+  /**
+   * @brief Constructor from a flattened DMS tree.
+   *
+   * The decisions execute the program rather than walk its tree; the
+   * vehicles of a driver profile may share it.
+   *
+   * @param program Program compiled by DecisionProgram::compile()
+   */
+  explicit VehicleDecisionModelMicro(
+      std::shared_ptr<const DecisionProgram> program);
+
   /**
    * @brief Make decisions and produce influences.
    *
@@ -59,8 +71,16 @@ public:
    */
   IDecisionMicroSubmodel *getRootDMS() const { return m_root_dms.get(); }
 
+  /**
+   * @brief Get the program the decisions execute, or nullptr for the tree.
+   */
+  const std::shared_ptr<const DecisionProgram> &getProgram() const {
+    return m_program;
+  }
+
 private:
   std::shared_ptr<IDecisionMicroSubmodel> m_root_dms;
+  std::shared_ptr<const DecisionProgram> m_program;
 };
 
 } // namespace decision
@@ -1,9 +1,16 @@
 #ifndef JAMFREE_MICROSCOPIC_DECISION_DMS_FORWARD_ACCELERATION_DMS_H
 #define JAMFREE_MICROSCOPIC_DECISION_DMS_FORWARD_ACCELERATION_DMS_H
 
+#include "../../../../../microkernel/include/influences/InfluenceArena.h"
+#include "../../../include/CarFollowingModel.h"
 #include "../../../include/IDM.h"
+#include "../../influences/ChangeAcceleration.h"
 #include "../IDecisionMicroSubmodel.h"
+#include <algorithm>
+#include <limits>
 #include <memory>
+#include <type_traits>
+#include <utility>
 
 namespace jamfree {
 namespace microscopic {
@@ -50,6 +57,76 @@ private:
   std::shared_ptr<models::IDM> m_idm;
 };
 
+/**
+ * @brief Forward Acceleration Decision Micro Sub-model, instantiated for a
+ * car-following model type.
+ *
+ * The model is held by value and its acceleration inlined into the
+ * decision, rather than called on a shared IDM whose parameters are set
+ * from each vehicle. The parameters are thus those of the model, which
+ * stands for a class of drivers; a fleet mixing models uses
+ * ForwardAccelerationDMSFor<models::CarFollowingModel>, dispatched on the
+ * type once per decision. As ForwardAccelerationDMS, it does not accelerate
+ * beyond the speed limit and emits a ChangeAcceleration influence.
+ *
+ * @tparam Model models::IDM, models::IDMPlus, models::IDMLookup or
+ *               models::CarFollowingModel
+ */
+template <typename Model>
+class ForwardAccelerationDMSFor : public IDecisionMicroSubmodel {
+public:
+  /**
+   * @brief Constructor.
+   * @param model Car-following model of the drivers
+   */
+  explicit ForwardAccelerationDMSFor(Model model = Model())
+      : m_model(std::move(model)) {}
+
+  const Model &getModel() const { return m_model; }
+
+  bool
+  manageDecision(kernel::agents::SimulationTimeStamp timeLowerBound,
+                 kernel::agents::SimulationTimeStamp timeUpperBound,
+                 const agents::VehiclePublicLocalStateMicro &publicState,
+                 const agents::VehiclePrivateLocalStateMicro &privateState,
+                 const agents::VehiclePerceivedDataMicro &perceivedData,
+                 const kernel::agents::GlobalState &globalState,
+                 kernel::agents::InfluencesMap &producedInfluences) override {
+    const double currentSpeed = publicState.getSpeed();
+
+    // If no leader, use infinite gap (free flow)
+    double gapToLeader = std::numeric_limits<double>::infinity();
+    double deltaV = 0.0;
+    if (perceivedData.getLeader()) {
+      gapToLeader = perceivedData.getGapToLeader();
+      deltaV = currentSpeed - perceivedData.getLeaderSpeed();
+    }
+
+    double acceleration;
+    if constexpr (std::is_same_v<Model, models::CarFollowingModel>) {
+      acceleration = models::calculateAcceleration(m_model, currentSpeed,
+                                                   gapToLeader, deltaV);
+    } else {
+      acceleration =
+          m_model.calculateAcceleration(currentSpeed, gapToLeader, deltaV);
+    }
+
+    // Don't accelerate if already at or above speed limit
+    if (currentSpeed >= perceivedData.getCurrentSpeedLimit()) {
+      acceleration = std::min(0.0, acceleration);
+    }
+
+    auto influence = fr::univ_artois::lgi2a::similar::microkernel::
+        influences::makeInfluence<influences::ChangeAcceleration>(
+            timeLowerBound, timeUpperBound, publicState, acceleration);
+    producedInfluences.add(influence);
+    return true;
+  }
+
+private:
+  Model m_model;
+};
+
 } // namespace dms
 } // namespace decision
 } // namespace microscopic
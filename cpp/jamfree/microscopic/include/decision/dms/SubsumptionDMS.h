@@ -60,6 +60,14 @@ public:
    */
   size_t getSubmodelCount() const { return m_submodels.size(); }
 
+  /**
+   * @brief Get the sub-models, in the order they were added.
+   */
+  const std::vector<std::shared_ptr<IDecisionMicroSubmodel>> &
+  getSubmodels() const {
+    return m_submodels;
+  }
+
 private:
   std::vector<std::shared_ptr<IDecisionMicroSubmodel>> m_submodels;
 };
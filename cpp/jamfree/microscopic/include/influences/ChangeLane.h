@@ -3,6 +3,8 @@
 
 #include "../../../../microkernel/include/influences/RegularInfluence.h"
 #include "../../../kernel/include/agents/Interfaces.h"
+#include "../agents/VehiclePublicLocalStateMicro.h"
+#include <cstddef>
 #include <string>
 
 namespace jamfree {
@@ -44,6 +46,22 @@ public:
              kernel::agents::SimulationTimeStamp timeUpperBound,
              const std::string &ownerId, Direction direction);
 
+  /**
+   * @brief Constructor targeting a public state.
+   *
+   * Carries the agent index of the state and the state itself, which the
+   * reaction updates without looking the vehicle up by identifier.
+   *
+   * @param timeLowerBound Lower bound of time interval
+   * @param timeUpperBound Upper bound of time interval
+   * @param target Public state of the vehicle
+   * @param direction Lane change direction
+   */
+  ChangeLane(kernel::agents::SimulationTimeStamp timeLowerBound,
+             kernel::agents::SimulationTimeStamp timeUpperBound,
+             const agents::VehiclePublicLocalStateMicro &target,
+             Direction direction);
+
   /**
    * @brief Get lane change direction.
    * @return Direction (LEFT or RIGHT)
@@ -54,10 +72,41 @@ public:
    * @brief Get the identifier of the target vehicle.
    * @return Vehicle owner ID
    */
-  const std::string &getOwnerId() const { return m_ownerId; }
+  const std::string &getOwnerId() const { return m_ownerId.str(); }
+
+  /**
+   * @brief Get the interned identifier of the target vehicle.
+   * @return Vehicle owner ID
+   */
+  kernel::agents::Symbol getOwnerSymbol() const { return m_ownerId; }
+
+  /**
+   * @brief Get the agent index of the target public state.
+   * @return Index, or NO_AGENT_INDEX without target
+   */
+  std::size_t getAgentIndex() const { return m_agent_index; }
+
+  /**
+   * @brief Get the target public state.
+   * @return State, or nullptr when only the owner ID is known
+   */
+  const agents::VehiclePublicLocalStateMicro *getTarget() const {
+    return m_target;
+  }
+
+  /**
+   * @brief Get the type tag used to dispatch this influence.
+   */
+  std::size_t getTypeTag() const override {
+    return fr::univ_artois::lgi2a::similar::microkernel::influences::
+        influenceTypeTag<ChangeLane>();
+  }
 
 private:
-  std::string m_ownerId;
+  kernel::agents::Symbol m_ownerId;
+  std::size_t m_agent_index =
+      agents::VehiclePublicLocalStateMicro::NO_AGENT_INDEX;
+  const agents::VehiclePublicLocalStateMicro *m_target = nullptr;
   Direction m_direction;
 };
 
@@ -3,9 +3,11 @@
 
 #include "../../../kernel/include/agents/Interfaces.h"
 #include "../agents/VehiclePerceivedDataMicro.h"
+#include "../agents/VehiclePerceivedRecordMicro.h"
 #include "../agents/VehiclePrivateLocalStateMicro.h"
 #include "../agents/VehiclePublicLocalStateMicro.h"
 #include <memory>
+#include <vector>
 
 namespace jamfree {
 namespace microscopic {
@@ -21,6 +23,9 @@ namespace perception {
  * - Lane end proximity
  * - Routing information
  * - Speed limits
+ *
+ * The perceived data of the previous step of a vehicle, handed back by
+ * perceiveInPlace(), are refilled instead of allocating new ones.
  */
 class VehiclePerceptionModelMicro : public kernel::agents::IPerceptionModel {
 public:
@@ -50,8 +55,53 @@ public:
            std::shared_ptr<kernel::agents::IPublicDynamicStateMap>
                dynamicStates) override;
 
+  /**
+   * @brief Perceive, refilling the data of the previous perception.
+   *
+   * @param recycled The reset data of the previous perception; new data
+   * are allocated if they are not a VehiclePerceivedDataMicro
+   * @return The perceived data
+   */
+  std::shared_ptr<kernel::agents::IPerceivedData> perceiveInPlace(
+      const kernel::agents::SimulationTimeStamp &timeLowerBound,
+      const kernel::agents::SimulationTimeStamp &timeUpperBound,
+      const std::map<kernel::agents::LevelIdentifier,
+                     std::shared_ptr<kernel::agents::ILocalState>>
+          &publicLocalStates,
+      std::shared_ptr<kernel::agents::ILocalState> privateLocalState,
+      std::shared_ptr<kernel::agents::IPublicDynamicStateMap> dynamicStates,
+      const std::shared_ptr<kernel::agents::IPerceivedData> &recycled)
+      override;
+
   kernel::agents::LevelIdentifier getLevel() const override;
 
+  /**
+   * @brief Perceive for all the vehicles of a lane at once.
+   *
+   * The vehicles of the lane and of each neighbouring lane are swept
+   * together once, in the order of their lane positions, the neighbours
+   * ahead and behind moving forward with the vehicle: the leaders and
+   * followers are the ones findLeader() and findFollower() give, strictly
+   * ahead and behind, without a search nor an allocation per vehicle.
+   *
+   * @param lane Lane, its vehicles and the ones of its neighbours sorted
+   * @param records Resized to the vehicles of the lane, in their order
+   */
+  void perceiveLane(
+      const kernel::model::Lane &lane,
+      std::vector<agents::VehiclePerceivedRecordMicro> &records) const;
+
+  /**
+   * @brief Perceive for the vehicles of every lane of a road.
+   *
+   * @param records Resized to one array per lane, in lane order, keeping
+   *                the capacity of the previous step
+   */
+  void perceiveRoad(
+      const kernel::model::Road &road,
+      std::vector<std::vector<agents::VehiclePerceivedRecordMicro>> &records)
+      const;
+
 private:
   double m_perception_range; // Maximum perception distance (m)
 
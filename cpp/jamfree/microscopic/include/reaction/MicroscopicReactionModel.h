@@ -5,7 +5,10 @@
 #include "../agents/VehiclePublicLocalStateMicro.h"
 #include "../influences/ChangeAcceleration.h"
 #include "../influences/ChangeLane.h"
+#include "../../../../microkernel/include/engine/WorkStealingThreadPool.h"
+#include <cstddef>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 namespace jamfree {
@@ -30,6 +33,15 @@ namespace reaction {
  * - Physics updates (position, speed)
  * - Collision detection
  * - State validation
+ *
+ * The influences built from a public state carry the agent index the
+ * reaction gave it at the previous step, and are applied to the state
+ * found at that index; the others look their vehicle up by identifier.
+ *
+ * The lane changes are applied first, as a synchronization phase; then
+ * each lane moves, validates and re-sorts its vehicles as an independent
+ * task, on the thread pool the engine lends to the reaction or on the one
+ * of setNumThreads().
  */
 class MicroscopicReactionModel : public kernel::agents::IReactionModel {
 public:
@@ -70,10 +82,51 @@ public:
    */
   double getTimeStep() const { return m_dt; }
 
+  /**
+   * @brief Set the number of threads updating the lanes.
+   *
+   * Used when no thread pool is lent by the engine running the reaction.
+   * @param numThreads Number of threads (1 = sequential)
+   */
+  void setNumThreads(std::size_t numThreads);
+
 private:
+  using PublicState = std::shared_ptr<agents::VehiclePublicLocalStateMicro>;
+
   double m_dt; // Time step for physics integration
   kernel::simulation::SimulationEngine *
       m_engine = nullptr; // Non-owning pointer to simulation engine
+  std::unique_ptr<fr::univ_artois::lgi2a::similar::microkernel::engine::
+                      WorkStealingThreadPool>
+      m_pool;
+
+  // The microscopic public state of each agent of the engine, by index
+  std::vector<PublicState> m_agent_states;
+
+  // The active states of each lane, the buckets being kept between steps
+  std::unordered_map<kernel::model::Lane *, std::size_t> m_lane_slots;
+  std::vector<kernel::model::Lane *> m_lanes;
+  std::vector<std::vector<PublicState>> m_lane_states;
+  // The active states without lane
+  std::vector<PublicState> m_laneless_states;
+
+  /**
+   * @brief Gather the public states of the agents, giving them their index.
+   */
+  void indexAgents();
+
+  /**
+   * @brief Find the public state targeted by an influence.
+   *
+   * Uses the agent index of the influence when it still designates its
+   * target, else looks the owner up in the engine.
+   * @param influence ChangeAcceleration or ChangeLane influence
+   * @param ignored Note logged with the errors
+   * @return The state, or nullptr if the owner has none
+   */
+  template <typename Influence>
+  agents::VehiclePublicLocalStateMicro *findTarget(const Influence &influence,
+                                                   const char *ignored) const;
 
   /**
    * @brief Apply acceleration changes.
@@ -88,15 +141,24 @@ private:
    */
   void applyLaneChanges(const kernel::agents::InfluencesMap &influences);
 
+  /**
+   * @brief Group the active public states by lane.
+   */
+  void partitionByLane();
+
   /**
    * @brief Update vehicle physics (position, speed).
+   * @param state Vehicle public state
    */
-  void updatePhysics();
+  void updatePhysics(agents::VehiclePublicLocalStateMicro &state) const;
 
   /**
-   * @brief Validate states and handle collisions.
+   * @brief Move, validate and re-sort the vehicles of a lane.
+   *
+   * Handles the collisions, then updates the index of the lane.
+   * @param slot Index of the lane in m_lanes
    */
-  void validateStates();
+  void updateLane(std::size_t slot);
 
   /**
    * @brief Extract influences of a specific type.
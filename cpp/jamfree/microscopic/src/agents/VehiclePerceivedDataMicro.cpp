@@ -107,6 +107,17 @@ void VehiclePerceivedDataMicro::clear() {
 
   m_next_road_id = "";
   m_target_lane_index = -1;
+
+  m_current_speed_limit = 33.3; // Default 120 km/h
+}
+
+bool VehiclePerceivedDataMicro::reset(
+    const kernel::agents::SimulationTimeStamp &timeLowerBound,
+    const kernel::agents::SimulationTimeStamp &timeUpperBound) {
+  clear();
+  m_transitory_min = timeLowerBound;
+  m_transitory_max = timeUpperBound;
+  return true;
 }
 
 } // namespace agents
@@ -8,13 +8,32 @@ namespace agents {
 
 VehiclePrivateLocalStateMicro::VehiclePrivateLocalStateMicro(
     const std::string &ownerId)
-    : m_ownerId(ownerId), m_level("microscopic"),
-      m_desired_speed(33.33), // 120 km/h
-      m_time_headway(1.5), m_min_gap(2.0), m_max_acceleration(1.0),
-      m_comfortable_deceleration(2.0), m_acceleration_exponent(4.0),
-      m_politeness(0.1), m_lane_change_threshold(0.2),
-      m_max_safe_deceleration(4.0), m_right_lane_bias(0.1),
-      m_current_route_index(0), m_reaction_time(1.0), m_aggressiveness(0.5) {}
+    : VehiclePrivateLocalStateMicro(kernel::agents::Symbol(ownerId)) {}
+
+VehiclePrivateLocalStateMicro::VehiclePrivateLocalStateMicro(
+    kernel::agents::Symbol ownerId)
+    : m_level("microscopic") {
+  reset(ownerId);
+}
+
+void VehiclePrivateLocalStateMicro::reset(kernel::agents::Symbol ownerId) {
+  m_ownerId = ownerId;
+  m_desired_speed = 33.33; // 120 km/h
+  m_time_headway = 1.5;
+  m_min_gap = 2.0;
+  m_max_acceleration = 1.0;
+  m_comfortable_deceleration = 2.0;
+  m_acceleration_exponent = 4.0;
+  m_politeness = 0.1;
+  m_lane_change_threshold = 0.2;
+  m_max_safe_deceleration = 4.0;
+  m_right_lane_bias = 0.1;
+  m_route.clear(); // Its storage kept for the next route
+  m_current_route_index = 0;
+  m_destination.clear();
+  m_reaction_time = 1.0;
+  m_aggressiveness = 0.5;
+}
 
 std::shared_ptr<
     fr::univ_artois::lgi2a::similar::microkernel::ILocalState>
@@ -49,7 +68,7 @@ bool VehiclePrivateLocalStateMicro::isOwnedBy(
   const auto *vehicleAgent =
       dynamic_cast<const kernel::agents::VehicleAgent *>(&agent);
   if (vehicleAgent) {
-    return vehicleAgent->getId() == m_ownerId;
+    return vehicleAgent->getSymbol() == m_ownerId;
   }
   return false;
 }
@@ -8,9 +8,29 @@ namespace agents {
 
 VehiclePublicLocalStateMicro::VehiclePublicLocalStateMicro(
     const std::string &ownerId)
-    : m_ownerId(ownerId), m_level("microscopic"), m_heading(0), m_speed(0),
-      m_acceleration(0), m_current_lane(nullptr), m_lane_position(0),
-      m_lane_index(0), m_length(0), m_width(0), m_height(0), m_active(true) {}
+    : VehiclePublicLocalStateMicro(kernel::agents::Symbol(ownerId)) {}
+
+VehiclePublicLocalStateMicro::VehiclePublicLocalStateMicro(
+    kernel::agents::Symbol ownerId)
+    : m_level("microscopic") {
+  reset(ownerId);
+}
+
+void VehiclePublicLocalStateMicro::reset(kernel::agents::Symbol ownerId) {
+  m_ownerId = ownerId;
+  m_agent_index = NO_AGENT_INDEX;
+  m_position = kernel::model::Point2D();
+  m_heading = 0;
+  m_speed = 0;
+  m_acceleration = 0;
+  m_current_lane = nullptr;
+  m_lane_position = 0;
+  m_lane_index = 0;
+  m_length = 0;
+  m_width = 0;
+  m_height = 0;
+  m_active = true;
+}
 
 std::shared_ptr<
     fr::univ_artois::lgi2a::similar::microkernel::ILocalState>
@@ -41,7 +61,7 @@ bool VehiclePublicLocalStateMicro::isOwnedBy(
   const auto *vehicleAgent =
       dynamic_cast<const kernel::agents::VehicleAgent *>(&agent);
   if (vehicleAgent) {
-    return vehicleAgent->getId() == m_ownerId;
+    return vehicleAgent->getSymbol() == m_ownerId;
   }
   return false;
 }
@@ -0,0 +1,467 @@
+#include "microscopic/include/Calibration.h"
+#include "kernel/include/model/LaneVehicleStore.h"
+#include "kernel/include/model/Vehicle.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace jamfree {
+namespace microscopic {
+namespace calibration {
+
+using kernel::model::DetectorReports;
+using kernel::model::Lane;
+using kernel::model::Point2D;
+using kernel::model::Road;
+using kernel::model::Vehicle;
+
+namespace {
+
+std::shared_ptr<Road> cloneRoad(const Road &road) {
+  std::shared_ptr<Road> copy;
+  if (road.getWaypoints().size() >= 2) {
+    copy = std::make_shared<Road>(
+        road.getId(),
+        std::vector<Point2D>(road.getWaypoints().begin(),
+                             road.getWaypoints().end()),
+        road.getNumLanes(), road.getLaneWidth());
+  } else {
+    copy = std::make_shared<Road>(road.getId(), road.getStart(),
+                                  road.getEnd(), road.getNumLanes(),
+                                  road.getLaneWidth());
+  }
+  for (int i = 0; i < road.getNumLanes(); ++i) {
+    copy->getLane(i)->setSpeedLimit(road.getLane(i)->getSpeedLimit());
+  }
+  return copy;
+}
+
+std::shared_ptr<Lane>
+laneOf(const std::vector<std::shared_ptr<Road>> &roads, std::size_t road,
+       int lane) {
+  std::shared_ptr<Lane> found =
+      road < roads.size() ? roads[road]->getLane(lane) : nullptr;
+  if (!found) {
+    throw std::invalid_argument("Calibration: no lane " +
+                                std::to_string(lane) + " on road " +
+                                std::to_string(road));
+  }
+  return found;
+}
+
+// Gather the vehicles of a lane, all driven by the same parameters
+void gather(kernel::model::LaneVehicleStore &store, const Lane &lane,
+            const kernel::model::DriverParameters &driver) {
+  store.clear();
+  for (const auto &vehicle : lane.getVehicles()) {
+    store.add(*vehicle, &driver);
+  }
+}
+
+void changeLanes(const Road &road, const models::IDM &idm,
+                 const models::MOBIL &mobil,
+                 const kernel::model::DriverParameters &driver,
+                 kernel::model::LaneVehicleStore &store) {
+  const int num_lanes = road.getNumLanes();
+  std::vector<std::vector<double>> accelerations(num_lanes);
+  for (int i = 0; i < num_lanes; ++i) {
+    gather(store, *road.getLane(i), driver);
+    store.computeAccelerations();
+    accelerations[i].assign(store.getAccelerations().begin(),
+                            store.getAccelerations().end());
+  }
+  std::vector<std::vector<models::MOBIL::Direction>> decisions;
+  mobil.decideLaneChanges(road, accelerations, idm, decisions);
+
+  // Lower lane indices are on the left
+  std::vector<std::vector<std::shared_ptr<Vehicle>>> leaving(num_lanes);
+  std::vector<std::pair<std::shared_ptr<Vehicle>, int>> moves;
+  for (int i = 0; i < num_lanes; ++i) {
+    const auto &vehicles = road.getLane(i)->getVehicles();
+    for (std::size_t k = 0; k < vehicles.size(); ++k) {
+      int target = i;
+      if (decisions[i][k] == models::MOBIL::Direction::LEFT) {
+        target = i - 1;
+      } else if (decisions[i][k] == models::MOBIL::Direction::RIGHT) {
+        target = i + 1;
+      }
+      if (target != i && target >= 0 && target < num_lanes) {
+        leaving[i].push_back(vehicles[k]);
+        moves.emplace_back(vehicles[k], target);
+      }
+    }
+  }
+  for (int i = 0; i < num_lanes; ++i) {
+    if (!leaving[i].empty()) {
+      road.getLane(i)->removeVehicles(leaving[i]);
+    }
+  }
+  for (auto &move : moves) {
+    const std::shared_ptr<Lane> &lane = road.getLane(move.second);
+    move.first->setCurrentLane(lane);
+    lane->addVehicle(move.first);
+  }
+}
+
+double rootMeanSquare(double sum, std::size_t count) {
+  return count > 0 ? std::sqrt(sum / static_cast<double>(count)) : 0.0;
+}
+
+} // namespace
+
+void Scenario::captureVehicles() {
+  vehicles.clear();
+  for (std::size_t r = 0; r < roads.size(); ++r) {
+    for (int l = 0; l < roads[r]->getNumLanes(); ++l) {
+      for (const auto &vehicle : roads[r]->getLane(l)->getVehicles()) {
+        vehicles.push_back(VehicleState{r, l, vehicle->getLanePosition(),
+                                        vehicle->getSpeed(),
+                                        vehicle->getLength(),
+                                        vehicle->getMaxSpeed()});
+      }
+    }
+  }
+}
+
+DetectorReports simulate(const Scenario &scenario, const models::IDM &idm,
+                         const models::MOBIL &mobil) {
+  if (!(scenario.dt > 0.0)) {
+    throw std::invalid_argument("Calibration: the time step must be positive");
+  }
+  std::vector<std::shared_ptr<Road>> roads;
+  roads.reserve(scenario.roads.size());
+  for (const auto &road : scenario.roads) {
+    roads.push_back(cloneRoad(*road));
+  }
+
+  std::size_t next_id = 0;
+  auto enter = [&](const std::shared_ptr<Lane> &lane, double position,
+                   double speed, double length, double max_speed) {
+    auto vehicle =
+        std::make_shared<Vehicle>("c" + std::to_string(next_id++), length,
+                                  max_speed);
+    vehicle->setCurrentLane(lane);
+    vehicle->setLanePosition(position);
+    vehicle->setSpeed(speed);
+    lane->addVehicle(vehicle);
+  };
+  for (const auto &state : scenario.vehicles) {
+    enter(laneOf(roads, state.road, state.lane), state.position, state.speed,
+          state.length, state.max_speed);
+  }
+  std::vector<std::shared_ptr<Lane>> inflow_lanes;
+  for (const auto &inflow : scenario.inflows) {
+    inflow_lanes.push_back(laneOf(roads, inflow.road, inflow.lane));
+  }
+
+  kernel::model::DetectorSet detectors(scenario.detector_period);
+  for (const auto &detector : scenario.detectors) {
+    detectors.addDetector(laneOf(roads, detector.road, detector.lane),
+                          detector.position, detector.loop_length);
+  }
+
+  const kernel::model::DriverParameters driver = idm.getDriverParameters();
+  kernel::model::LaneVehicleStore store;
+  std::vector<double> pending(scenario.inflows.size(), 0.0);
+  std::vector<std::shared_ptr<Vehicle>> gone;
+  const auto steps =
+      static_cast<std::size_t>(std::llround(scenario.duration / scenario.dt));
+  for (std::size_t step = 0; step < steps; ++step) {
+    if (scenario.lane_changes) {
+      for (const auto &road : roads) {
+        if (road->getNumLanes() > 1) {
+          changeLanes(*road, idm, mobil, driver, store);
+        }
+      }
+    }
+
+    for (const auto &road : roads) {
+      for (const auto &lane : road->getLanes()) {
+        gather(store, *lane, driver);
+        store.computeAccelerations();
+        store.integrate(scenario.dt);
+        store.scatter();
+        lane->sortVehicles();
+      }
+    }
+    detectors.update(scenario.dt);
+
+    // The vehicles beyond the end of their lane leave the network
+    for (const auto &road : roads) {
+      for (const auto &lane : road->getLanes()) {
+        gone.clear();
+        const auto &vehicles = lane->getVehicles();
+        for (auto it = vehicles.rbegin();
+             it != vehicles.rend() &&
+             (*it)->getLanePosition() > lane->getLength();
+             ++it) {
+          gone.push_back(*it);
+        }
+        if (!gone.empty()) {
+          lane->removeVehicles(gone);
+        }
+      }
+    }
+
+    // The inflows wait for room at the start of their lane
+    for (std::size_t i = 0; i < scenario.inflows.size(); ++i) {
+      const Scenario::Inflow &inflow = scenario.inflows[i];
+      const std::shared_ptr<Lane> &lane = inflow_lanes[i];
+      pending[i] += inflow.rate * scenario.dt;
+      while (pending[i] >= 1.0) {
+        const auto &vehicles = lane->getVehicles();
+        if (!vehicles.empty() && vehicles.front()->getLanePosition() <
+                                     inflow.length + idm.getMinGap()) {
+          break;
+        }
+        enter(lane, 0.0, inflow.speed, inflow.length, 55.0);
+        pending[i] -= 1.0;
+      }
+    }
+  }
+
+  DetectorReports reports;
+  detectors.exportReports(reports);
+  return reports;
+}
+
+Objective detectorError(DetectorReports observed, double flow_weight) {
+  return [observed = std::move(observed),
+          flow_weight](const DetectorReports &simulated) {
+    if (simulated.num_detectors != observed.num_detectors) {
+      return std::numeric_limits<double>::infinity();
+    }
+    const std::size_t count =
+        std::min(simulated.getNumPeriods(), observed.getNumPeriods()) *
+        observed.num_detectors;
+    double speed_sum = 0.0;
+    std::size_t speeds = 0;
+    double count_sum = 0.0;
+    for (std::size_t i = 0; i < count; ++i) {
+      const double observed_speed = observed.harmonic_speed[i];
+      const double simulated_speed = simulated.harmonic_speed[i];
+      if (std::isfinite(observed_speed) && std::isfinite(simulated_speed)) {
+        speed_sum += (observed_speed - simulated_speed) *
+                     (observed_speed - simulated_speed);
+        ++speeds;
+      }
+      const double difference = static_cast<double>(observed.counts[i]) -
+                                static_cast<double>(simulated.counts[i]);
+      count_sum += difference * difference;
+    }
+    return rootMeanSquare(speed_sum, speeds) +
+           flow_weight * rootMeanSquare(count_sum, count);
+  };
+}
+
+void Calibrator::applyParameter(const std::string &name, double value,
+                                models::IDM &idm, models::MOBIL &mobil) {
+  if (name == "desired_speed") {
+    idm.setDesiredSpeed(value);
+  } else if (name == "time_headway") {
+    idm.setTimeHeadway(value);
+  } else if (name == "min_gap") {
+    idm.setMinGap(value);
+  } else if (name == "max_accel") {
+    idm.setMaxAccel(value);
+  } else if (name == "comfortable_decel") {
+    idm.setComfortableDecel(value);
+  } else if (name == "accel_exponent") {
+    idm.setAccelExponent(value);
+  } else if (name == "politeness") {
+    mobil.setPoliteness(value);
+  } else if (name == "threshold") {
+    mobil.setThreshold(value);
+  } else if (name == "max_safe_decel") {
+    mobil.setMaxSafeDecel(value);
+  } else if (name == "bias_right") {
+    mobil.setBiasRight(value);
+  } else {
+    throw std::invalid_argument("Calibration: unknown parameter " + name);
+  }
+}
+
+Calibrator::Calibrator(Scenario scenario, std::vector<Parameter> parameters,
+                       Objective objective)
+    : Calibrator(std::move(scenario), std::move(parameters),
+                 std::move(objective), Config()) {}
+
+Calibrator::Calibrator(Scenario scenario, std::vector<Parameter> parameters,
+                       Objective objective, const Config &config)
+    : m_scenario(std::move(scenario)), m_parameters(std::move(parameters)),
+      m_objective(std::move(objective)), m_config(config) {
+  if (m_parameters.empty() || !m_objective) {
+    throw std::invalid_argument(
+        "Calibration: parameters and an objective are required");
+  }
+  models::IDM idm;
+  models::MOBIL mobil;
+  for (const Parameter &parameter : m_parameters) {
+    applyParameter(parameter.name, parameter.initial, idm, mobil);
+    if (!(parameter.upper > parameter.lower)) {
+      throw std::invalid_argument("Calibration: empty bounds for " +
+                                  parameter.name);
+    }
+  }
+  std::size_t threads = config.num_threads;
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  m_pool = std::make_unique<ThreadPool>(threads);
+}
+
+double Calibrator::evaluate(const std::vector<double> &values) const {
+  models::IDM idm = m_idm;
+  models::MOBIL mobil = m_mobil;
+  for (std::size_t i = 0; i < m_parameters.size(); ++i) {
+    const Parameter &parameter = m_parameters[i];
+    applyParameter(parameter.name,
+                   std::max(parameter.lower,
+                            std::min(parameter.upper, values.at(i))),
+                   idm, mobil);
+  }
+  const double score = m_objective(simulate(m_scenario, idm, mobil));
+  return std::isnan(score) ? std::numeric_limits<double>::infinity() : score;
+}
+
+std::vector<double>
+Calibrator::evaluateAll(const std::vector<std::vector<double>> &candidates) {
+  std::vector<double> scores(candidates.size());
+  // One simulation per chunk, the costliest ones being stolen
+  m_pool->parallelFor(candidates.size(), 1,
+                      [&](std::size_t begin, std::size_t end, std::size_t) {
+                        for (std::size_t i = begin; i < end; ++i) {
+                          scores[i] = evaluate(candidates[i]);
+                        }
+                      });
+  m_evaluations += candidates.size();
+  return scores;
+}
+
+CalibrationResult Calibrator::run() {
+  const std::size_t n = m_parameters.size();
+  using Point = std::vector<double>;
+  auto clamp = [](Point &u) {
+    for (double &x : u) {
+      x = std::max(0.0, std::min(1.0, x));
+    }
+  };
+  auto valuesOf = [&](const Point &u) {
+    Point values(n);
+    for (std::size_t i = 0; i < n; ++i) {
+      const Parameter &parameter = m_parameters[i];
+      values[i] = parameter.lower + u[i] * (parameter.upper - parameter.lower);
+    }
+    return values;
+  };
+  auto scoresOf = [&](const std::vector<Point> &points) {
+    std::vector<Point> candidates;
+    candidates.reserve(points.size());
+    for (const Point &u : points) {
+      candidates.push_back(valuesOf(u));
+    }
+    return evaluateAll(candidates);
+  };
+  // u = x0 + t * (x1 - x0)
+  auto along = [&](const Point &x0, const Point &x1, double t) {
+    Point u(n);
+    for (std::size_t i = 0; i < n; ++i) {
+      u[i] = x0[i] + t * (x1[i] - x0[i]);
+    }
+    clamp(u);
+    return u;
+  };
+
+  m_evaluations = 0;
+  std::vector<Point> simplex(n + 1, Point(n));
+  for (std::size_t i = 0; i < n; ++i) {
+    const Parameter &parameter = m_parameters[i];
+    simplex[0][i] = (parameter.initial - parameter.lower) /
+                    (parameter.upper - parameter.lower);
+  }
+  clamp(simplex[0]);
+  for (std::size_t i = 0; i < n; ++i) {
+    simplex[i + 1] = simplex[0];
+    double &x = simplex[i + 1][i];
+    x = x + m_config.initial_step <= 1.0 ? x + m_config.initial_step
+                                         : x - m_config.initial_step;
+  }
+  std::vector<double> scores = scoresOf(simplex);
+
+  CalibrationResult result;
+  std::vector<std::size_t> order(n + 1);
+  auto sortSimplex = [&]() {
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](std::size_t a, std::size_t b) {
+                       return scores[a] < scores[b];
+                     });
+    std::vector<Point> points;
+    std::vector<double> sorted;
+    for (std::size_t i : order) {
+      points.push_back(std::move(simplex[i]));
+      sorted.push_back(scores[i]);
+    }
+    simplex = std::move(points);
+    scores = std::move(sorted);
+  };
+  sortSimplex();
+  while (result.iterations < m_config.max_iterations &&
+         m_evaluations < m_config.max_evaluations &&
+         !(scores[n] - scores[0] <= m_config.tolerance)) {
+    Point centroid(n, 0.0);
+    for (std::size_t j = 0; j < n; ++j) {
+      for (std::size_t i = 0; i < n; ++i) {
+        centroid[i] += simplex[j][i] / static_cast<double>(n);
+      }
+    }
+    const Point &worst = simplex[n];
+    // Reflection, expansion, outside and inside contractions, at once
+    const std::vector<Point> trials = {
+        along(centroid, worst, -1.0), along(centroid, worst, -2.0),
+        along(centroid, worst, -0.5), along(centroid, worst, 0.5)};
+    const std::vector<double> trial_scores = scoresOf(trials);
+    const double reflected = trial_scores[0];
+    int accepted = -1;
+    if (reflected < scores[0]) {
+      accepted = trial_scores[1] < reflected ? 1 : 0;
+    } else if (reflected < scores[n - 1]) {
+      accepted = 0;
+    } else if (reflected < scores[n]) {
+      accepted = trial_scores[2] <= reflected ? 2 : -1;
+    } else {
+      accepted = trial_scores[3] < scores[n] ? 3 : -1;
+    }
+    if (accepted >= 0) {
+      simplex[n] = trials[accepted];
+      scores[n] = trial_scores[accepted];
+    } else {
+      // Shrink towards the best point
+      std::vector<Point> shrunk;
+      for (std::size_t j = 1; j <= n; ++j) {
+        shrunk.push_back(along(simplex[0], simplex[j], 0.5));
+      }
+      const std::vector<double> shrunk_scores = scoresOf(shrunk);
+      for (std::size_t j = 1; j <= n; ++j) {
+        simplex[j] = std::move(shrunk[j - 1]);
+        scores[j] = shrunk_scores[j - 1];
+      }
+    }
+    sortSimplex();
+    ++result.iterations;
+  }
+
+  result.values = valuesOf(simplex[0]);
+  result.objective = scores[0];
+  result.evaluations = m_evaluations;
+  return result;
+}
+
+} // namespace calibration
+} // namespace microscopic
+} // namespace jamfree
@@ -0,0 +1,160 @@
+#include "../../include/decision/DecisionProgram.h"
+#include "../../include/decision/dms/ConjunctionDMS.h"
+#include "../../include/decision/dms/SubsumptionDMS.h"
+#include <stdexcept>
+#include <typeinfo>
+
+namespace jamfree {
+namespace microscopic {
+namespace decision {
+
+namespace {
+
+// The composites themselves, not subclasses which may decide otherwise
+template <typename Composite>
+const Composite *asComposite(const IDecisionMicroSubmodel &node) {
+  return typeid(node) == typeid(Composite)
+             ? static_cast<const Composite *>(&node)
+             : nullptr;
+}
+
+// The sub-models of a composite, the ones of its nested composites of the
+// same kind in their place
+template <typename Composite>
+void gatherSubmodels(const Composite &composite,
+                     std::vector<IDecisionMicroSubmodel *> &submodels) {
+  for (const auto &submodel : composite.getSubmodels()) {
+    if (const Composite *nested = asComposite<Composite>(*submodel)) {
+      gatherSubmodels(*nested, submodels);
+    } else {
+      submodels.push_back(submodel.get());
+    }
+  }
+}
+
+} // namespace
+
+std::shared_ptr<const DecisionProgram>
+DecisionProgram::compile(std::shared_ptr<IDecisionMicroSubmodel> root) {
+  if (!root) {
+    throw std::invalid_argument("DecisionProgram: root DMS cannot be null");
+  }
+  std::shared_ptr<DecisionProgram> program(new DecisionProgram());
+  program->m_root = std::move(root);
+  program->emit(*program->m_root, 0);
+  return program;
+}
+
+void DecisionProgram::emit(IDecisionMicroSubmodel &node, std::size_t depth) {
+  std::vector<IDecisionMicroSubmodel *> submodels;
+  if (const auto *subsumption = asComposite<dms::SubsumptionDMS>(node)) {
+    gatherSubmodels(*subsumption, submodels);
+    if (submodels.empty()) {
+      m_code.push_back({Op::CLEAR, 0, nullptr});
+      return;
+    }
+    // The last sub-model decides alone whether the composite handled it
+    std::vector<std::size_t> jumps;
+    for (std::size_t i = 0; i + 1 < submodels.size(); ++i) {
+      emit(*submodels[i], depth);
+      jumps.push_back(m_code.size());
+      m_code.push_back({Op::JUMP_IF_HANDLED, 0, nullptr});
+    }
+    emit(*submodels.back(), depth);
+    for (std::size_t jump : jumps) {
+      m_code[jump].target = static_cast<std::uint32_t>(m_code.size());
+    }
+    return;
+  }
+
+  if (const auto *conjunction = asComposite<dms::ConjunctionDMS>(node)) {
+    gatherSubmodels(*conjunction, submodels);
+    if (submodels.empty()) {
+      m_code.push_back({Op::CLEAR, 0, nullptr});
+      return;
+    }
+    if (submodels.size() == 1) {
+      emit(*submodels.front(), depth);
+      return;
+    }
+    if (depth == MAX_CONJUNCTION_DEPTH) {
+      throw std::invalid_argument(
+          "DecisionProgram: conjunctions nested too deep");
+    }
+    m_code.push_back({Op::BEGIN_ANY, 0, nullptr});
+    for (IDecisionMicroSubmodel *submodel : submodels) {
+      emit(*submodel, depth + 1);
+      m_code.push_back({Op::ACCUMULATE, 0, nullptr});
+    }
+    m_code.push_back({Op::END_ANY, 0, nullptr});
+    return;
+  }
+
+  m_code.push_back({Op::CALL, 0, &node});
+  ++m_leaf_count;
+}
+
+bool DecisionProgram::execute(
+    kernel::agents::SimulationTimeStamp timeLowerBound,
+    kernel::agents::SimulationTimeStamp timeUpperBound,
+    const agents::VehiclePublicLocalStateMicro &publicState,
+    const agents::VehiclePrivateLocalStateMicro &privateState,
+    const agents::VehiclePerceivedDataMicro &perceivedData,
+    const kernel::agents::GlobalState &globalState,
+    kernel::agents::InfluencesMap &producedInfluences) const {
+  bool handled = false;
+  // One bit per open conjunction, the innermost being the lowest
+  std::uint64_t any = 0;
+  const std::size_t n = m_code.size();
+  std::size_t pc = 0;
+  while (pc < n) {
+    const Instruction &instruction = m_code[pc++];
+    switch (instruction.op) {
+    case Op::CALL:
+      handled = instruction.leaf->manageDecision(
+          timeLowerBound, timeUpperBound, publicState, privateState,
+          perceivedData, globalState, producedInfluences);
+      break;
+    case Op::JUMP_IF_HANDLED:
+      if (handled) {
+        pc = instruction.target;
+      }
+      break;
+    case Op::BEGIN_ANY:
+      any <<= 1;
+      break;
+    case Op::ACCUMULATE:
+      any |= handled ? 1u : 0u;
+      break;
+    case Op::END_ANY:
+      handled = (any & 1u) != 0;
+      any >>= 1;
+      break;
+    case Op::CLEAR:
+      handled = false;
+      break;
+    }
+  }
+  return handled;
+}
+
+std::size_t DecisionProgram::executeAll(
+    kernel::agents::SimulationTimeStamp timeLowerBound,
+    kernel::agents::SimulationTimeStamp timeUpperBound,
+    const std::vector<Inputs> &vehicles,
+    const kernel::agents::GlobalState &globalState,
+    kernel::agents::InfluencesMap &producedInfluences) const {
+  std::size_t handled = 0;
+  for (const Inputs &vehicle : vehicles) {
+    if (execute(timeLowerBound, timeUpperBound, *vehicle.publicState,
+                *vehicle.privateState, *vehicle.perceivedData, globalState,
+                producedInfluences)) {
+      ++handled;
+    }
+  }
+  return handled;
+}
+
+} // namespace decision
+} // namespace microscopic
+} // namespace jamfree
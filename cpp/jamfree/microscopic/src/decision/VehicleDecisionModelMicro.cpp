@@ -1,5 +1,6 @@
 #include "../../include/decision/VehicleDecisionModelMicro.h"
 #include <stdexcept>
+#include <utility>
 
 namespace {
 class EmptyGlobalState
@@ -27,6 +28,16 @@ VehicleDecisionModelMicro::VehicleDecisionModelMicro(
   }
 }
 
+VehicleDecisionModelMicro::VehicleDecisionModelMicro(
+    std::shared_ptr<const DecisionProgram> program)
+    : m_program(std::move(program)) {
+  if (!m_program) {
+    throw std::invalid_argument(
+        "VehicleDecisionModelMicro: program cannot be null");
+  }
+  m_root_dms = m_program->getRoot();
+}
+
 kernel::agents::LevelIdentifier VehicleDecisionModelMicro::getLevel() const {
   return kernel::agents::LevelIdentifier("Microscopic");
 }
@@ -55,14 +66,17 @@ void VehicleDecisionModelMicro::decide(
         "Invalid state/data types in VehicleDecisionModelMicro");
   }
 
-  // Delegate to root DMS
-  if (m_root_dms) {
-    // Note: globalState is not available in this context, passing empty
-    // shared_ptr This should be fixed when proper global state management is
-    // implemented
-    auto emptyGlobalState = std::make_shared<EmptyGlobalState>();
+  // Note: globalState is not available in this context, passing an empty
+  // one. This should be fixed when proper global state management is
+  // implemented
+  static const EmptyGlobalState emptyGlobalState{};
+  if (m_program) {
+    m_program->execute(timeLowerBound, timeUpperBound, *publicState,
+                       *privateState, *pData, emptyGlobalState,
+                       *producedInfluences);
+  } else {
     m_root_dms->manageDecision(timeLowerBound, timeUpperBound, *publicState,
-                               *privateState, *pData, *emptyGlobalState,
+                               *privateState, *pData, emptyGlobalState,
                                *producedInfluences);
   }
 }
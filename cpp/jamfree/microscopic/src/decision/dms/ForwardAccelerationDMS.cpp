@@ -1,5 +1,6 @@
 #include "../../../include/decision/dms/ForwardAccelerationDMS.h"
 #include "../../../include/influences/ChangeAcceleration.h"
+#include "../../../../../microkernel/include/influences/InfluenceArena.h"
 #include <algorithm>
 #include <limits>
 
@@ -61,8 +62,10 @@ bool ForwardAccelerationDMS::manageDecision(
   }
 
   // Create and emit ChangeAcceleration influence targeting this vehicle
-  auto influence = std::make_shared<influences::ChangeAcceleration>(
-      timeLowerBound, timeUpperBound, publicState.getOwnerId(), acceleration);
+  // Allocated from the step arena of the engine when one is installed.
+  auto influence = fr::univ_artois::lgi2a::similar::microkernel::
+      influences::makeInfluence<influences::ChangeAcceleration>(
+      timeLowerBound, timeUpperBound, publicState, acceleration);
   producedInfluences.add(influence);
 
   return true; // Always handles the situation
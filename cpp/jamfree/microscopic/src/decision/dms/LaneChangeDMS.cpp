@@ -1,5 +1,6 @@
 #include "../../../include/decision/dms/LaneChangeDMS.h"
 #include "../../../include/influences/ChangeLane.h"
+#include "../../../../../microkernel/include/influences/InfluenceArena.h"
 #include <limits>
 
 namespace jamfree {
@@ -83,8 +84,10 @@ bool LaneChangeDMS::manageDecision(
       direction = influences::ChangeLane::Direction::RIGHT;
     }
 
-    auto influence = std::make_shared<influences::ChangeLane>(
-        timeLowerBound, timeUpperBound, publicState.getOwnerId(), direction);
+    // Allocated from the step arena of the engine when one is installed.
+    auto influence = fr::univ_artois::lgi2a::similar::microkernel::
+        influences::makeInfluence<influences::ChangeLane>(
+        timeLowerBound, timeUpperBound, publicState, direction);
     producedInfluences.add(influence);
   }
 
@@ -15,6 +15,17 @@ ChangeAcceleration::ChangeAcceleration(
           timeLowerBound, timeUpperBound),
       m_ownerId(ownerId), m_acceleration(acceleration) {}
 
+ChangeAcceleration::ChangeAcceleration(
+    kernel::agents::SimulationTimeStamp timeLowerBound,
+    kernel::agents::SimulationTimeStamp timeUpperBound,
+    const agents::VehiclePublicLocalStateMicro &target, double acceleration)
+    : RegularInfluence(
+          CATEGORY, kernel::agents::LevelIdentifier("Microscopic"),
+          timeLowerBound, timeUpperBound),
+      m_ownerId(target.getOwnerSymbol()),
+      m_agent_index(target.getAgentIndex()), m_target(&target),
+      m_acceleration(acceleration) {}
+
 } // namespace influences
 } // namespace microscopic
 } // namespace jamfree
@@ -14,6 +14,17 @@ ChangeLane::ChangeLane(kernel::agents::SimulationTimeStamp timeLowerBound,
           timeLowerBound, timeUpperBound),
       m_ownerId(ownerId), m_direction(direction) {}
 
+ChangeLane::ChangeLane(kernel::agents::SimulationTimeStamp timeLowerBound,
+                       kernel::agents::SimulationTimeStamp timeUpperBound,
+                       const agents::VehiclePublicLocalStateMicro &target,
+                       Direction direction)
+    : RegularInfluence(
+          CATEGORY, kernel::agents::LevelIdentifier("Microscopic"),
+          timeLowerBound, timeUpperBound),
+      m_ownerId(target.getOwnerSymbol()),
+      m_agent_index(target.getAgentIndex()), m_target(&target),
+      m_direction(direction) {}
+
 } // namespace influences
 } // namespace microscopic
 } // namespace jamfree
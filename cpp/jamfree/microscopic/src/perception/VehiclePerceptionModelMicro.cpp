@@ -19,9 +19,28 @@ VehiclePerceptionModelMicro::perceive(
         &publicLocalStates,
     std::shared_ptr<kernel::agents::ILocalState> privateLocalState,
     std::shared_ptr<kernel::agents::IPublicDynamicStateMap> dynamicStates) {
+  return perceiveInPlace(timeLowerBound, timeUpperBound, publicLocalStates,
+                         std::move(privateLocalState), std::move(dynamicStates),
+                         nullptr);
+}
 
-  // Create perceived data
-  auto perceivedData = std::make_shared<agents::VehiclePerceivedDataMicro>();
+std::shared_ptr<kernel::agents::IPerceivedData>
+VehiclePerceptionModelMicro::perceiveInPlace(
+    const kernel::agents::SimulationTimeStamp &timeLowerBound,
+    const kernel::agents::SimulationTimeStamp &timeUpperBound,
+    const std::map<kernel::agents::LevelIdentifier,
+                   std::shared_ptr<kernel::agents::ILocalState>>
+        &publicLocalStates,
+    std::shared_ptr<kernel::agents::ILocalState> privateLocalState,
+    std::shared_ptr<kernel::agents::IPublicDynamicStateMap>,
+    const std::shared_ptr<kernel::agents::IPerceivedData> &recycled) {
+
+  // The recycled data were reset by the agent or the engine
+  auto perceivedData =
+      std::dynamic_pointer_cast<agents::VehiclePerceivedDataMicro>(recycled);
+  if (!perceivedData) {
+    perceivedData = std::make_shared<agents::VehiclePerceivedDataMicro>();
+  }
   perceivedData->setTransitoryPeriodMin(timeLowerBound);
   perceivedData->setTransitoryPeriodMax(timeUpperBound);
 
@@ -189,26 +208,16 @@ VehiclePerceptionModelMicro::findLeader(kernel::model::Lane *lane,
     return {nullptr, std::numeric_limits<double>::infinity()};
   }
 
-  const auto &vehicles = lane->getVehicles();
-
-  kernel::model::Vehicle *closestLeader = nullptr;
-  double minGap = std::numeric_limits<double>::infinity();
-
-  for (const auto &vehicle : vehicles) {
-    double vehiclePos = vehicle->getLanePosition();
-
-    // Vehicle is ahead
-    if (vehiclePos > position) {
-      double gap = vehiclePos - position - vehicle->getLength();
-
-      if (gap < minGap && gap < maxRange) {
-        minGap = gap;
-        closestLeader = vehicle.get();
-      }
+  // The nearest vehicle ahead, from the index of the lane
+  const auto *leader = lane->getSpatialIndex().findAhead(position);
+  if (leader) {
+    double gap =
+        (*leader)->getLanePosition() - position - (*leader)->getLength();
+    if (gap < maxRange) {
+      return {leader->get(), gap};
     }
   }
-
-  return {closestLeader, minGap};
+  return {nullptr, std::numeric_limits<double>::infinity()};
 }
 
 std::pair<kernel::model::Vehicle *, double>
@@ -218,29 +227,116 @@ VehiclePerceptionModelMicro::findFollower(kernel::model::Lane *lane,
     return {nullptr, std::numeric_limits<double>::infinity()};
   }
 
-  const auto &vehicles = lane->getVehicles();
-
-  kernel::model::Vehicle *closestFollower = nullptr;
-  double minGap = std::numeric_limits<double>::infinity();
-
-  for (const auto &vehicle : vehicles) {
-    double vehiclePos = vehicle->getLanePosition();
+  // The nearest vehicle behind, from the index of the lane
+  const auto *follower = lane->getSpatialIndex().findBehind(position);
+  if (follower) {
+    double gap =
+        position - (*follower)->getLanePosition() - (*follower)->getLength();
+    if (gap < maxRange) {
+      return {follower->get(), gap};
+    }
+  }
+  return {nullptr, std::numeric_limits<double>::infinity()};
+}
 
-    // Vehicle is behind
-    if (vehiclePos < position) {
-      double gap = position - vehiclePos - vehicle->getLength();
+namespace {
+
+using Record = agents::VehiclePerceivedRecordMicro;
+using LaneVehicles = std::vector<std::shared_ptr<kernel::model::Vehicle>>;
+
+// The neighbours in others of the vehicles, both sorted by lane position
+void sweepNeighbours(const LaneVehicles &vehicles, const LaneVehicles *others,
+                     double range, Record::Side side,
+                     std::vector<Record> &records) {
+  const double inf = std::numeric_limits<double>::infinity();
+  const Record::Neighbours none = {Record::NONE, Record::NONE, inf, inf,
+                                   0.0,          0.0};
+  const std::size_t n = vehicles.size();
+  if (!others) {
+    for (std::size_t k = 0; k < n; ++k) {
+      records[k].lanes[side] = none;
+    }
+    return;
+  }
+  const std::size_t m = others->size();
+  std::size_t ahead = 0;  // First strictly ahead
+  std::size_t behind = 0; // First not strictly behind
+  for (std::size_t k = 0; k < n; ++k) {
+    const kernel::model::Vehicle &vehicle = *vehicles[k];
+    const double position = vehicle.getLanePosition();
+    while (ahead < m && (*others)[ahead]->getLanePosition() <= position) {
+      ++ahead;
+    }
+    while (behind < m && (*others)[behind]->getLanePosition() < position) {
+      ++behind;
+    }
 
-      if (gap < minGap && gap < maxRange) {
-        minGap = gap;
-        closestFollower = vehicle.get();
+    Record::Neighbours &neighbours = records[k].lanes[side];
+    neighbours = none;
+    if (ahead < m) {
+      const kernel::model::Vehicle &leader = *(*others)[ahead];
+      const double gap = vehicle.getGapTo(leader);
+      if (gap < range) {
+        neighbours.leader = static_cast<std::uint32_t>(ahead);
+        neighbours.gap_to_leader = gap;
+        neighbours.leader_relative_speed = vehicle.getRelativeSpeedTo(leader);
+      }
+    }
+    if (behind > 0) {
+      const kernel::model::Vehicle &follower = *(*others)[behind - 1];
+      const double gap = follower.getGapTo(vehicle);
+      if (gap < range) {
+        neighbours.follower = static_cast<std::uint32_t>(behind - 1);
+        neighbours.gap_to_follower = gap;
+        neighbours.follower_relative_speed =
+            follower.getRelativeSpeedTo(vehicle);
       }
     }
   }
+}
 
-  return {closestFollower, minGap};
+} // namespace
+
+void VehiclePerceptionModelMicro::perceiveLane(
+    const kernel::model::Lane &lane, std::vector<Record> &records) const {
+  const LaneVehicles &vehicles = lane.getVehicles();
+  const std::size_t n = vehicles.size();
+  records.resize(n);
+
+  const kernel::model::Road *road = lane.getParentRoad();
+  const int index = lane.getIndex();
+  const kernel::model::Lane *left =
+      road && index > 0 ? road->getLane(index - 1).get() : nullptr;
+  const kernel::model::Lane *right =
+      road && index + 1 < road->getNumLanes() ? road->getLane(index + 1).get()
+                                              : nullptr;
+
+  const double length = lane.getLength();
+  const double speed_limit = lane.getSpeedLimit();
+  for (std::size_t k = 0; k < n; ++k) {
+    Record &record = records[k];
+    record.distance_to_lane_end = length - vehicles[k]->getLanePosition();
+    record.speed_limit = speed_limit;
+    record.has_left_lane = left != nullptr;
+    record.has_right_lane = right != nullptr;
+  }
+  sweepNeighbours(vehicles, &vehicles, m_perception_range, Record::CURRENT,
+                  records);
+  sweepNeighbours(vehicles, left ? &left->getVehicles() : nullptr,
+                  m_perception_range, Record::LEFT, records);
+  sweepNeighbours(vehicles, right ? &right->getVehicles() : nullptr,
+                  m_perception_range, Record::RIGHT, records);
 }
 
-// ... (existing code)
+void VehiclePerceptionModelMicro::perceiveRoad(
+    const kernel::model::Road &road,
+    std::vector<std::vector<Record>> &records) const {
+  const auto &lanes = road.getLanes();
+  records.resize(lanes.size());
+  for (std::size_t i = 0; i < lanes.size(); ++i) {
+    perceiveLane(*lanes[i], records[i]);
+  }
+}
 
 kernel::agents::LevelIdentifier VehiclePerceptionModelMicro::getLevel() const {
   return kernel::agents::LevelIdentifier("Microscopic");
@@ -3,9 +3,9 @@
 #include "../../../kernel/include/model/Lane.h"
 #include "../../../kernel/include/model/Road.h"
 #include "../../../kernel/include/simulation/SimulationEngine.h"
+#include "../../../../microkernel/include/libs/ExecutionTracer.h"
 #include <algorithm>
 #include <iostream>
-#include <unordered_map>
 
 namespace jamfree {
 namespace microscopic {
@@ -15,9 +15,19 @@ using jamfree::kernel::agents::LevelIdentifier;
 using jamfree::kernel::agents::VehicleAgent;
 using jamfree::kernel::model::Lane;
 using jamfree::microscopic::agents::VehiclePublicLocalStateMicro;
+using fr::univ_artois::lgi2a::similar::microkernel::engine::
+    WorkStealingThreadPool;
 
 MicroscopicReactionModel::MicroscopicReactionModel(double dt) : m_dt(dt) {}
 
+void MicroscopicReactionModel::setNumThreads(std::size_t numThreads) {
+  if (numThreads > 1) {
+    m_pool = std::make_unique<WorkStealingThreadPool>(numThreads);
+  } else {
+    m_pool.reset();
+  }
+}
+
 void MicroscopicReactionModel::setSimulationEngine(
     kernel::simulation::SimulationEngine *engine) {
   m_engine = engine;
@@ -34,16 +44,114 @@ void MicroscopicReactionModel::react(
     return;
   }
 
-  // Apply influences in order:
-  // 1. Lane changes (must happen before acceleration)
+  // Apply influences in order, once the states are indexed:
+  // 1. Lane changes (must happen before acceleration), the synchronization
+  //    phase between the lanes
   // 2. Acceleration changes
-  // 3. Physics updates
-  // 4. State validation
+  // 3. For each lane, in parallel: physics updates, then state validation,
+  //    which updates the lane index once per step
 
+  indexAgents();
   applyLaneChanges(influences);
   applyAccelerationChanges(influences);
-  updatePhysics();
-  validateStates();
+  partitionByLane();
+
+  for (const auto &state : m_laneless_states) {
+    updatePhysics(*state);
+  }
+
+  // The pool of the engine, if it lends one, else ours
+  std::unique_ptr<WorkStealingThreadPool::Scope> scope;
+  if (m_pool && WorkStealingThreadPool::currentSize() == 1) {
+    scope = std::make_unique<WorkStealingThreadPool::Scope>(m_pool.get());
+  }
+  WorkStealingThreadPool::parallelForOnCurrent(
+      m_lanes.size(), 1, [this](size_t begin, size_t end, size_t) {
+        SIMILAR_TRACE_SCOPE("jamfree", "lane update");
+        for (size_t slot = begin; slot < end; ++slot) {
+          updateLane(slot);
+        }
+      });
+}
+
+void MicroscopicReactionModel::indexAgents() {
+  LevelIdentifier microLevel("Microscopic");
+
+  const auto &agents = m_engine->getAgents();
+  m_agent_states.resize(agents.size());
+  for (std::size_t i = 0; i < agents.size(); ++i) {
+    m_agent_states[i].reset();
+    if (!agents[i]) {
+      continue;
+    }
+
+    auto publicStateBase = agents[i]->getPublicLocalState(microLevel);
+    auto publicState = std::dynamic_pointer_cast<VehiclePublicLocalStateMicro>(
+        publicStateBase);
+    if (publicState) {
+      publicState->setAgentIndex(i);
+      m_agent_states[i] = std::move(publicState);
+    }
+  }
+}
+
+template <typename Influence>
+VehiclePublicLocalStateMicro *
+MicroscopicReactionModel::findTarget(const Influence &influence,
+                                     const char *ignored) const {
+  std::size_t index = influence.getAgentIndex();
+  if (index < m_agent_states.size() && m_agent_states[index] &&
+      m_agent_states[index].get() == influence.getTarget()) {
+    return m_agent_states[index].get();
+  }
+
+  // Built from an identifier, or before the agents changed
+  auto agent = m_engine->getAgent(influence.getOwnerSymbol());
+  const std::string &ownerId = influence.getOwnerId();
+  if (!agent) {
+    std::cerr << "[MicroscopicReactionModel] No agent found for ownerId="
+              << ownerId << ignored << "." << std::endl;
+    return nullptr;
+  }
+
+  auto publicStateBase =
+      agent->getPublicLocalState(LevelIdentifier("Microscopic"));
+  auto publicState = std::dynamic_pointer_cast<VehiclePublicLocalStateMicro>(
+      publicStateBase);
+  if (!publicState) {
+    std::cerr
+        << "[MicroscopicReactionModel] Invalid public state type for agent "
+        << ownerId << " in microscopic level" << ignored << "." << std::endl;
+    return nullptr;
+  }
+  // The engine keeps the state alive
+  return publicState.get();
+}
+
+void MicroscopicReactionModel::partitionByLane() {
+  for (auto &states : m_lane_states) {
+    states.clear();
+  }
+  m_laneless_states.clear();
+
+  for (const auto &publicState : m_agent_states) {
+    if (!publicState || !publicState->isActive()) {
+      continue;
+    }
+
+    Lane *lane = publicState->getCurrentLane();
+    if (!lane) {
+      m_laneless_states.push_back(publicState);
+      continue;
+    }
+
+    auto slot = m_lane_slots.emplace(lane, m_lanes.size());
+    if (slot.second) {
+      m_lanes.push_back(lane);
+      m_lane_states.emplace_back();
+    }
+    m_lane_states[slot.first->second].push_back(publicState);
+  }
 }
 
 void MicroscopicReactionModel::applyAccelerationChanges(
@@ -51,30 +159,16 @@ void MicroscopicReactionModel::applyAccelerationChanges(
   auto accelInfluences = extractInfluencesByCategory(
       influences, influences::ChangeAcceleration::CATEGORY);
 
-  LevelIdentifier microLevel("Microscopic");
-
   for (const auto &influence : accelInfluences) {
-    auto changeAccel =
-        std::dynamic_pointer_cast<influences::ChangeAcceleration>(influence);
-    if (!changeAccel) {
+    if (influence->getTypeTag() !=
+        fr::univ_artois::lgi2a::similar::microkernel::influences::
+            influenceTypeTag<influences::ChangeAcceleration>()) {
       continue;
     }
+    auto changeAccel = std::static_pointer_cast<influences::ChangeAcceleration>(influence);
 
-    const std::string &ownerId = changeAccel->getOwnerId();
-    auto agent = m_engine->getAgent(ownerId);
-    if (!agent) {
-      std::cerr << "[MicroscopicReactionModel] No agent found for ownerId="
-                << ownerId << std::endl;
-      continue;
-    }
-
-    auto publicStateBase = agent->getPublicLocalState(microLevel);
-    auto publicState = std::dynamic_pointer_cast<VehiclePublicLocalStateMicro>(
-        publicStateBase);
+    auto publicState = findTarget(*changeAccel, "");
     if (!publicState) {
-      std::cerr
-          << "[MicroscopicReactionModel] Invalid public state type for agent "
-          << ownerId << " in microscopic level." << std::endl;
       continue;
     }
 
@@ -88,31 +182,17 @@ void MicroscopicReactionModel::applyLaneChanges(
   auto laneChangeInfluences =
       extractInfluencesByCategory(influences, influences::ChangeLane::CATEGORY);
 
-  LevelIdentifier microLevel("Microscopic");
-
   for (const auto &influence : laneChangeInfluences) {
-    auto changeLane =
-        std::dynamic_pointer_cast<influences::ChangeLane>(influence);
-    if (!changeLane) {
-      continue;
-    }
-
-    const std::string &ownerId = changeLane->getOwnerId();
-    auto agent = m_engine->getAgent(ownerId);
-    if (!agent) {
-      std::cerr << "[MicroscopicReactionModel] No agent found for ownerId="
-                << ownerId << " (lane change ignored)." << std::endl;
+    // The type tag replaces a dynamic cast on this per-vehicle path.
+    if (influence->getTypeTag() !=
+        fr::univ_artois::lgi2a::similar::microkernel::influences::
+            influenceTypeTag<influences::ChangeLane>()) {
       continue;
     }
+    auto changeLane = std::static_pointer_cast<influences::ChangeLane>(influence);
 
-    auto publicStateBase = agent->getPublicLocalState(microLevel);
-    auto publicState = std::dynamic_pointer_cast<VehiclePublicLocalStateMicro>(
-        publicStateBase);
+    auto publicState = findTarget(*changeLane, " (lane change ignored)");
     if (!publicState) {
-      std::cerr
-          << "[MicroscopicReactionModel] Invalid public state type for agent "
-          << ownerId << " in microscopic level (lane change ignored)."
-          << std::endl;
       continue;
     }
 
@@ -147,112 +227,72 @@ void MicroscopicReactionModel::applyLaneChanges(
   }
 }
 
-void MicroscopicReactionModel::updatePhysics() {
-  if (!m_engine) {
-    return;
-  }
-
-  LevelIdentifier microLevel("Microscopic");
-
-  for (const auto &agentPtr : m_engine->getAgents()) {
-    if (!agentPtr) {
-      continue;
-    }
-
-    auto publicStateBase = agentPtr->getPublicLocalState(microLevel);
-    auto publicState = std::dynamic_pointer_cast<VehiclePublicLocalStateMicro>(
-        publicStateBase);
-    if (!publicState || !publicState->isActive()) {
-      continue;
-    }
+void MicroscopicReactionModel::updatePhysics(
+    VehiclePublicLocalStateMicro &state) const {
+  double speed = state.getSpeed();
+  double accel = state.getAcceleration();
 
-    double speed = publicState->getSpeed();
-    double accel = publicState->getAcceleration();
+  double newSpeed = speed + accel * m_dt;
+  if (newSpeed < 0.0) {
+    newSpeed = 0.0;
+  }
 
-    double newSpeed = speed + accel * m_dt;
-    if (newSpeed < 0.0) {
-      newSpeed = 0.0;
-    }
+  double lanePos = state.getLanePosition();
+  double newLanePos = lanePos + newSpeed * m_dt;
 
-    double lanePos = publicState->getLanePosition();
-    double newLanePos = lanePos + newSpeed * m_dt;
+  state.setSpeed(newSpeed);
+  state.setLanePosition(newLanePos);
 
-    publicState->setSpeed(newSpeed);
-    publicState->setLanePosition(newLanePos);
+  Lane *lane = state.getCurrentLane();
+  if (lane) {
+    auto globalPos = lane->getPositionAt(newLanePos);
+    state.setPosition(globalPos);
 
-    Lane *lane = publicState->getCurrentLane();
-    if (lane) {
-      auto globalPos = lane->getPositionAt(newLanePos);
-      publicState->setPosition(globalPos);
-
-      double heading = lane->getHeadingAt(newLanePos);
-      publicState->setHeading(heading);
-    }
+    double heading = lane->getHeadingAt(newLanePos);
+    state.setHeading(heading);
   }
 }
 
-void MicroscopicReactionModel::validateStates() {
-  if (!m_engine) {
+void MicroscopicReactionModel::updateLane(std::size_t slot) {
+  auto &vehicles = m_lane_states[slot];
+  if (vehicles.empty()) {
     return;
   }
+  Lane *lane = m_lanes[slot];
 
-  LevelIdentifier microLevel("Microscopic");
-
-  std::unordered_map<Lane *,
-                     std::vector<std::shared_ptr<VehiclePublicLocalStateMicro>>>
-      laneToVehicles;
-
-  for (const auto &agentPtr : m_engine->getAgents()) {
-    if (!agentPtr) {
-      continue;
-    }
-
-    auto publicStateBase = agentPtr->getPublicLocalState(microLevel);
-    auto publicState = std::dynamic_pointer_cast<VehiclePublicLocalStateMicro>(
-        publicStateBase);
-    if (!publicState || !publicState->isActive()) {
-      continue;
-    }
-
-    Lane *lane = publicState->getCurrentLane();
-    if (!lane) {
-      continue;
-    }
+  double laneLength = lane->getLength();
+  for (const auto &publicState : vehicles) {
+    updatePhysics(*publicState);
 
     double lanePos = publicState->getLanePosition();
-    double laneLength = lane->getLength();
     if (lanePos < 0.0) {
       publicState->setLanePosition(0.0);
     } else if (lanePos > laneLength) {
       publicState->setLanePosition(laneLength);
     }
-
-    laneToVehicles[lane].push_back(publicState);
   }
 
-  for (auto &entry : laneToVehicles) {
-    auto &vehicles = entry.second;
-
-    std::sort(vehicles.begin(), vehicles.end(),
-              [](const std::shared_ptr<VehiclePublicLocalStateMicro> &a,
-                 const std::shared_ptr<VehiclePublicLocalStateMicro> &b) {
-                return a->getLanePosition() < b->getLanePosition();
-              });
+  std::sort(vehicles.begin(), vehicles.end(),
+            [](const PublicState &a, const PublicState &b) {
+              return a->getLanePosition() < b->getLanePosition();
+            });
 
-    for (std::size_t i = 1; i < vehicles.size(); ++i) {
-      auto &rear = vehicles[i - 1];
-      auto &front = vehicles[i];
+  for (std::size_t i = 1; i < vehicles.size(); ++i) {
+    auto &rear = vehicles[i - 1];
+    auto &front = vehicles[i];
 
-      double rearFrontPos = rear->getLanePosition() + rear->getLength();
-      double gap = front->getLanePosition() - rearFrontPos;
+    double rearFrontPos = rear->getLanePosition() + rear->getLength();
+    double gap = front->getLanePosition() - rearFrontPos;
 
-      if (gap < 0.0) {
-        front->setLanePosition(rearFrontPos);
-        double minSpeed = std::min(front->getSpeed(), rear->getSpeed());
-        front->setSpeed(minSpeed);
-      }
+    if (gap < 0.0) {
+      front->setLanePosition(rearFrontPos);
+      double minSpeed = std::min(front->getSpeed(), rear->getSpeed());
+      front->setSpeed(minSpeed);
     }
   }
+
+  // The perception of the next step queries the index of the lane
+  lane->sortVehicles();
 }
 
 std::vector<std::shared_ptr<kernel::agents::IInfluence>>
@@ -30,10 +30,13 @@ from ._jamfree import (
     AdaptiveSimulatorConfig,
     AdaptiveSimulatorStatistics,
     SimulationMode,
+    DetectorSet,
     
     # OSM (OpenStreetMap) support
     RoadNetwork,
     OSMParser,
+    NetworkCache,
+    RoadIndex,
     
     # Utility functions
     kmh_to_ms,
@@ -60,8 +63,38 @@ from ._jamfree import (
     
     # Simulation Engine (JamFree Kernel)
     SimulationEngine,
+    SimulationRunner,
     IReactionModel,
     MicroscopicReactionModel,
+
+    # Vehicle state frames
+    FrameBounds,
+    VehicleFrameEncoder,
+    VehicleFrameDecoder,
+    NUM_STATE_COLUMNS,
+    STATE_VEHICLE_INDEX,
+    STATE_LANE_INDEX,
+    STATE_LANE_POSITION,
+    STATE_X,
+    STATE_Y,
+    STATE_SPEED,
+    STATE_ACCELERATION,
+    STATE_HEADING,
+    export_vehicle_states,
+    Viewport,
+    ViewportFilter,
+
+    # Trajectory recording
+    TrajectoryRecorder,
+    TrajectoryReader,
+    TrajectoryReplay,
+
+    # Telemetry
+    SimulationMetrics,
+    StepTimingListener,
+    MemoryUsage,
+    memory_usage,
+    reset_memory_peaks,
 )
 
 __version__ = '0.1.0'
@@ -88,9 +121,12 @@ __all__ = [
     'AdaptiveSimulatorConfig',
     'AdaptiveSimulatorStatistics',
     'SimulationMode',
+    'DetectorSet',
     # OSM
     'RoadNetwork',
     'OSMParser',
+    'NetworkCache',
+    'RoadIndex',
     # Utils
     'kmh_to_ms',
     'ms_to_kmh',
@@ -113,8 +149,35 @@ __all__ = [
     'SubsumptionDMS',
     # Simulation Engine
     'SimulationEngine',
+    'SimulationRunner',
     'IReactionModel',
     'MicroscopicReactionModel',
+    # Vehicle state frames
+    'FrameBounds',
+    'VehicleFrameEncoder',
+    'VehicleFrameDecoder',
+    'NUM_STATE_COLUMNS',
+    'STATE_VEHICLE_INDEX',
+    'STATE_LANE_INDEX',
+    'STATE_LANE_POSITION',
+    'STATE_X',
+    'STATE_Y',
+    'STATE_SPEED',
+    'STATE_ACCELERATION',
+    'STATE_HEADING',
+    'export_vehicle_states',
+    'Viewport',
+    'ViewportFilter',
+    # Trajectory recording
+    'TrajectoryRecorder',
+    'TrajectoryReader',
+    'TrajectoryReplay',
+    # Telemetry
+    'SimulationMetrics',
+    'StepTimingListener',
+    'MemoryUsage',
+    'memory_usage',
+    'reset_memory_peaks',
     # Metal GPU
     'MetalCompute',
     'GPUVehicleState',
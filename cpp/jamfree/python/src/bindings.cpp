@@ -6,16 +6,30 @@
  * Python.
  */
 
+#include <pybind11/numpy.h>
 #include <pybind11/operators.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
+#include <algorithm>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 
 #include "../../hybrid/include/AdaptiveSimulator.h"
+#include "../../kernel/include/model/DetectorSet.h"
 #include "../../kernel/include/model/Lane.h"
 #include "../../kernel/include/model/Point2D.h"
 #include "../../kernel/include/model/Road.h"
+#include "../../kernel/include/model/RoadIndex.h"
 #include "../../kernel/include/model/SpatialIndex.h"
 #include "../../kernel/include/model/Vehicle.h"
+#include "../../kernel/include/model/VehicleFrameCodec.h"
+#include "../../kernel/include/model/VehicleStateExport.h"
+#include "../../kernel/include/model/ViewportFilter.h"
 #include "../../kernel/include/tools/FastMath.h"
 #include "../../macroscopic/include/CTM.h"
 #include "../../macroscopic/include/LWR.h"
@@ -23,6 +37,7 @@
 #include "../../microscopic/include/IDM.h"
 #include "../../microscopic/include/IDMLookup.h"
 #include "../../microscopic/include/MOBIL.h"
+#include "../../realdata/include/NetworkCache.h"
 #include "../../realdata/include/OSMParser.h"
 
 namespace py = pybind11;
@@ -36,9 +51,14 @@ using namespace jamfree::hybrid;
 
 #include "../../../microkernel/include/engine/MultiThreadedSimulationEngine.h"
 #include "../../../microkernel/include/engine/SequentialSimulationEngine.h"
+#include "../../../microkernel/include/libs/SimulationMetrics.h"
 #include "../../kernel/include/agents/VehicleAgent.h"
+#include "../../kernel/include/levels/LevelIdentifiers.h"
 #include "../../kernel/include/simulation/SimulationEngine.h"
+#include "../../kernel/include/simulation/SimulationRunner.h"
 #include "../../kernel/include/simulation/TrafficSimulationModel.h"
+#include "../../kernel/include/simulation/TrajectoryRecorder.h"
+#include "../../kernel/include/simulation/TrajectoryReplay.h"
 #include "../../microscopic/include/agents/VehiclePrivateLocalStateMicro.h"
 #include "../../microscopic/include/agents/VehiclePublicLocalStateMicro.h"
 #include "../../microscopic/include/decision/VehicleDecisionModelMicro.h"
@@ -51,7 +71,121 @@ using namespace jamfree::hybrid;
 
 using namespace jamfree::kernel::agents;
 
-PYBIND11_MODULE(_jamfree, m) {
+namespace {
+
+using jamfree::kernel::simulation::SimulationEngine;
+
+// The engines and adaptive simulators that Python threads share are locked
+// by the bindings, since the free-threaded build runs their calls in
+// parallel: the queries share the lock of the object and the updates hold
+// it alone. The steps, SimulationEngine::step() and
+// AdaptiveSimulator::update(), take it themselves and are called without
+// the GIL. A thread waits for a lock without the GIL (detached from the
+// interpreter in the free-threaded build), which the holder may need.
+using SharedAccess = std::shared_lock<std::shared_mutex>;
+using ExclusiveAccess = std::unique_lock<std::shared_mutex>;
+
+template <typename Lock> Lock acquire(std::shared_mutex &mutex) {
+  Lock lock(mutex, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    if (PyGILState_Check()) {
+      py::gil_scoped_release release;
+      lock.lock();
+    } else {
+      lock.lock();
+    }
+  }
+  return lock;
+}
+
+template <typename Object> SharedAccess sharedAccess(const Object &object) {
+  return acquire<SharedAccess>(object.getAccessMutex());
+}
+
+template <typename Object>
+ExclusiveAccess exclusiveAccess(const Object &object) {
+  return acquire<ExclusiveAccess>(object.getAccessMutex());
+}
+
+// A const method of a shared object, bound as a query: its result is
+// copied under the lock.
+template <typename Object, typename Return, typename... Args>
+auto query(Return (Object::*method)(Args...) const) {
+  return [method](const Object &object, Args... args) -> std::decay_t<Return> {
+    const SharedAccess lock = sharedAccess(object);
+    return (object.*method)(std::forward<Args>(args)...);
+  };
+}
+
+// A method of a shared object, bound as an update.
+template <typename Object, typename Return, typename... Args>
+auto update(Return (Object::*method)(Args...)) {
+  return [method](Object &object, Args... args) -> std::decay_t<Return> {
+    const ExclusiveAccess lock = exclusiveAccess(object);
+    return (object.*method)(std::forward<Args>(args)...);
+  };
+}
+
+using StateArray = py::array_t<double, py::array::c_style>;
+
+// The rows of a preallocated array of NUM_STATE_COLUMNS columns, which the
+// state exports fill in place
+double *stateRows(StateArray &out, std::size_t &capacity) {
+  if (out.ndim() != 2 ||
+      out.shape(1) != static_cast<py::ssize_t>(NUM_STATE_COLUMNS)) {
+    throw std::invalid_argument(
+        "The state array must have NUM_STATE_COLUMNS columns");
+  }
+  capacity = static_cast<std::size_t>(out.shape(0));
+  return out.mutable_data();
+}
+
+// The rows of the microscopic public states of the agents of an engine
+std::size_t
+exportAgentStates(const jamfree::kernel::simulation::SimulationEngine &engine,
+                  double *rows, std::size_t capacity) {
+  using jamfree::microscopic::agents::VehiclePublicLocalStateMicro;
+  const double none = std::numeric_limits<double>::quiet_NaN();
+  const auto &agents = engine.getAgents();
+  const std::size_t count = std::min(agents.size(), capacity);
+  for (std::size_t i = 0; i < count; ++i) {
+    const auto state = agents[i]->getPublicLocalState(
+        jamfree::kernel::levels::LevelIdentifiers::MICROSCOPIC);
+    const auto *micro =
+        dynamic_cast<const VehiclePublicLocalStateMicro *>(state.get());
+    double *row = rows + i * NUM_STATE_COLUMNS;
+    row[STATE_VEHICLE_INDEX] = static_cast<double>(i);
+    if (!micro) {
+      // Not on the microscopic level
+      std::fill(row + STATE_LANE_INDEX, row + NUM_STATE_COLUMNS, none);
+      row[STATE_LANE_INDEX] = -1.0;
+      continue;
+    }
+    row[STATE_LANE_INDEX] =
+        micro->getCurrentLane() ? micro->getLaneIndex() : -1.0;
+    row[STATE_LANE_POSITION] = micro->getLanePosition();
+    row[STATE_X] = micro->getPosition().x;
+    row[STATE_Y] = micro->getPosition().y;
+    row[STATE_SPEED] = micro->getSpeed();
+    row[STATE_ACCELERATION] = micro->getAcceleration();
+    row[STATE_HEADING] = micro->getHeading();
+  }
+  return agents.size();
+}
+
+// A copy of rows of states, as an array of NUM_STATE_COLUMNS columns
+py::array_t<double> stateArray(const std::vector<double> &rows) {
+  const std::vector<py::ssize_t> shape = {
+      static_cast<py::ssize_t>(rows.size() / NUM_STATE_COLUMNS),
+      static_cast<py::ssize_t>(NUM_STATE_COLUMNS)};
+  return py::array_t<double>(shape, rows.data());
+}
+
+} // namespace
+
+// The module runs without the GIL in the free-threaded build, the engines
+// and the adaptive simulators being locked by their bindings.
+PYBIND11_MODULE(_jamfree, m, py::mod_gil_not_used()) {
   m.doc() = "JamFree: Traffic simulation library with microscopic models";
 
   // ========================================================================
@@ -109,7 +243,25 @@ PYBIND11_MODULE(_jamfree, m) {
            "Add vehicle to lane")
       .def("remove_vehicle", &Lane::removeVehicle, py::arg("vehicle"),
            "Remove vehicle from lane")
+      .def("remove_vehicles", &Lane::removeVehicles, py::arg("vehicles"),
+           "Remove vehicles from lane, in one pass")
+      .def("sort_vehicles", &Lane::sortVehicles,
+           "Restore the order of the vehicles after they moved")
       .def("get_vehicles", &Lane::getVehicles, "Get all vehicles in lane")
+      .def(
+          "export_state",
+          [](const Lane &lane, StateArray out) {
+            std::size_t capacity;
+            double *rows = stateRows(out, capacity);
+            py::gil_scoped_release release;
+            return exportVehicleStates(lane.getVehicles(), rows, capacity);
+          },
+          py::arg("out").noconvert(),
+          "Fill the rows of a float64 array of NUM_STATE_COLUMNS columns with "
+          "the states of the vehicles in lane, returning their number")
+      .def("get_spatial_index", &Lane::getSpatialIndex,
+           py::return_value_policy::reference_internal,
+           "Get the index of the vehicles in lane")
       .def("get_leader", &Lane::getLeader, py::arg("vehicle"),
            "Get leader vehicle", py::return_value_policy::reference)
       .def("get_follower", &Lane::getFollower, py::arg("vehicle"),
@@ -135,8 +287,14 @@ PYBIND11_MODULE(_jamfree, m) {
       .def("get_length", &Road::getLength, "Get road length")
       .def("get_num_lanes", &Road::getNumLanes, "Get number of lanes")
       .def("get_lane", &Road::getLane, py::arg("index"), "Get lane by index")
-      .def("get_position_at", &Road::getPositionAt, py::arg("distance"),
-           "Get position at distance along road")
+      .def("get_position_at",
+           py::overload_cast<double>(&Road::getPositionAt, py::const_),
+           py::arg("distance"), "Get position at distance along road")
+      .def("get_position_at",
+           py::overload_cast<double, double>(&Road::getPositionAt,
+                                             py::const_),
+           py::arg("distance"), py::arg("offset"),
+           "Get position at distance along a line offset to the right")
       .def("get_heading_at", &Road::getHeadingAt, py::arg("distance"),
            "Get heading at distance along road")
       .def("__repr__", [](const Road &r) {
@@ -198,6 +356,25 @@ PYBIND11_MODULE(_jamfree, m) {
           },
           py::arg("vehicle"), py::arg("leader") = nullptr,
           "Calculate acceleration for a vehicle")
+      .def(
+          "compute_accelerations",
+          [](const IDM &idm, const std::vector<double> &speeds,
+             const std::vector<double> &gaps,
+             const std::vector<double> &speed_diffs) {
+            if (gaps.size() != speeds.size() ||
+                speed_diffs.size() != speeds.size()) {
+              throw std::invalid_argument(
+                  "speeds, gaps and speed_diffs must have the same length");
+            }
+            std::vector<double> accelerations(speeds.size());
+            idm.computeAccelerations(speeds.data(), gaps.data(),
+                                     speed_diffs.data(), accelerations.data(),
+                                     speeds.size());
+            return accelerations;
+          },
+          py::arg("speeds"), py::arg("gaps"), py::arg("speed_diffs"),
+          "Calculate the accelerations of a batch of vehicles (infinite gap "
+          "without leader)")
       .def("calculate_desired_gap", &IDM::calculateDesiredGap, py::arg("speed"),
            py::arg("speed_diff"), "Calculate desired gap")
       .def("get_desired_speed", &IDM::getDesiredSpeed, "Get desired speed")
@@ -254,6 +431,23 @@ PYBIND11_MODULE(_jamfree, m) {
           py::arg("vehicle"), py::arg("current_lane"), py::arg("left_lane"),
           py::arg("right_lane"), py::arg("car_following_model"),
           "Decide whether to change lanes")
+      .def(
+          "decide_lane_changes",
+          [](const MOBIL &mobil, const Road &road,
+             const std::vector<std::vector<double>> &accelerations,
+             const IDM &cf_model, unsigned num_threads) {
+            std::vector<std::vector<MOBIL::Direction>> decisions;
+            {
+              py::gil_scoped_release release;
+              mobil.decideLaneChanges(road, accelerations, cf_model,
+                                      decisions, num_threads);
+            }
+            return decisions;
+          },
+          py::arg("road"), py::arg("accelerations"),
+          py::arg("car_following_model"), py::arg("num_threads") = 1,
+          "Decide the lane changes of all the vehicles of a road, in one "
+          "pass per lane pair")
       .def("__repr__", [](const MOBIL &mobil) {
         return "MOBIL(politeness=0.5, threshold=0.1)";
       });
@@ -268,13 +462,19 @@ PYBIND11_MODULE(_jamfree, m) {
       .def_readonly("max_lat", &RoadNetwork::max_lat, "Maximum latitude")
       .def_readonly("min_lon", &RoadNetwork::min_lon, "Minimum longitude")
       .def_readonly("max_lon", &RoadNetwork::max_lon, "Maximum longitude")
+      .def_readonly("road_index", &RoadNetwork::road_index,
+                    "R-tree of the segments of the roads")
+      .def("index_roads", &RoadNetwork::indexRoads,
+           "Index the roads again, after they changed")
       .def("__repr__", [](const RoadNetwork &net) {
         return "RoadNetwork(roads=" + std::to_string(net.roads.size()) + ")";
       });
 
   py::class_<OSMParser>(m, "OSMParser")
-      .def_static("parse_file", &OSMParser::parseFile, py::arg("filename"),
-                  "Parse OSM XML file and return road network")
+      .def_static("parse_file",
+                  py::overload_cast<const std::string &>(&OSMParser::parseFile),
+                  py::arg("filename"),
+                  "Parse OSM XML or PBF file and return road network")
       .def_static("parse_string", &OSMParser::parseString,
                   py::arg("xml_content"),
                   "Parse OSM XML string and return road network")
@@ -291,6 +491,55 @@ PYBIND11_MODULE(_jamfree, m) {
                   py::arg("highway_type"), py::arg("country") = "FR",
                   "Get default speed limit for highway type");
 
+  py::class_<RoadIndex>(m, "RoadIndex")
+      .def(py::init<const std::vector<std::shared_ptr<Road>> &>(),
+           py::arg("roads"), py::keep_alive<1, 2>(),
+           "Index the segments of roads in an R-tree")
+      .def("size", &RoadIndex::size, "Number of segments indexed")
+      .def(
+          "nearest",
+          [](const RoadIndex &index, double x, double y,
+             double max_distance) -> py::object {
+            RoadIndex::Match match;
+            if (!index.nearest(Point2D(x, y), match, max_distance)) {
+              return py::none();
+            }
+            return py::make_tuple(match.segment->road->getId(),
+                                  match.distance_along, match.distance);
+          },
+          py::arg("x"), py::arg("y"),
+          py::arg("max_distance") = std::numeric_limits<double>::infinity(),
+          "Closest road as (road_id, distance_along, distance), or None")
+      .def(
+          "roads_in",
+          [](const RoadIndex &index, double min_x, double min_y, double max_x,
+             double max_y) {
+            std::vector<std::string> ids;
+            for (const Road *road : index.getRoadsIn(Point2D(min_x, min_y),
+                                                     Point2D(max_x, max_y))) {
+              ids.push_back(road->getId());
+            }
+            return ids;
+          },
+          py::arg("min_x"), py::arg("min_y"), py::arg("max_x"),
+          py::arg("max_y"), "Ids of the roads with a segment in a window");
+
+  py::class_<NetworkCache>(m, "NetworkCache")
+      .def_static("load_or_parse",
+                  py::overload_cast<const std::string &, const std::string &>(
+                      &NetworkCache::loadOrParse),
+                  py::arg("source_filename"), py::arg("cache_filename"),
+                  "Read the cached road network of an OSM file, parsing and "
+                  "caching it if the cache is missing or stale")
+      .def_static("save",
+                  py::overload_cast<const RoadNetwork &, const std::string &,
+                                    const std::string &>(&NetworkCache::save),
+                  py::arg("network"), py::arg("source_filename"),
+                  py::arg("cache_filename"),
+                  "Write the cache of a road network parsed from an OSM file")
+      .def_static("hash_file", &NetworkCache::hashFile, py::arg("filename"),
+                  "Hash the content of a file");
+
   // ========================================================================
   // Macroscopic Models
   // ========================================================================
@@ -302,6 +551,10 @@ PYBIND11_MODULE(_jamfree, m) {
            py::arg("road_length") = 1000.0, py::arg("num_cells") = 100,
            "Create LWR macroscopic model")
       .def("update", &LWR::update, py::arg("dt"), "Update traffic state")
+      .def("advance", &LWR::advance, py::arg("dt"),
+           "Advance by any time step, in stable sub-steps")
+      .def("get_stable_time_step", &LWR::getStableTimeStep,
+           "Longest stable time step of update")
       .def("set_density", &LWR::setDensity, py::arg("cell_index"),
            py::arg("density"), "Set density at cell")
       .def("get_density", &LWR::getDensity, py::arg("cell_index"),
@@ -334,6 +587,10 @@ PYBIND11_MODULE(_jamfree, m) {
            py::arg("jam_density") = 0.15, py::arg("road_length") = 1000.0,
            py::arg("num_cells") = 100, "Create CTM macroscopic model")
       .def("update", &CTM::update, py::arg("dt"), "Update traffic state")
+      .def("advance", &CTM::advance, py::arg("dt"),
+           "Advance by any time step, in stable sub-steps")
+      .def("get_stable_time_step", &CTM::getStableTimeStep,
+           "Longest stable time step of update")
       .def("set_num_vehicles", &CTM::setNumVehicles, py::arg("cell_index"),
            py::arg("num_vehicles"), "Set number of vehicles in cell")
       .def("get_num_vehicles", &CTM::getNumVehicles, py::arg("cell_index"),
@@ -374,8 +631,10 @@ PYBIND11_MODULE(_jamfree, m) {
 
   py::class_<MicroMacroBridge>(m, "MicroMacroBridge")
       .def_static("extract_density_profile",
-                  &MicroMacroBridge::extractDensityProfile, py::arg("lane"),
-                  py::arg("num_cells"), "Extract density profile from lane")
+                  py::overload_cast<const std::shared_ptr<Lane> &, int>(
+                      &MicroMacroBridge::extractDensityProfile),
+                  py::arg("lane"), py::arg("num_cells"),
+                  "Extract density profile from lane")
       .def_static("extract_flow_profile", &MicroMacroBridge::extractFlowProfile,
                   py::arg("lane"), py::arg("num_cells"),
                   "Extract flow profile from lane")
@@ -410,7 +669,9 @@ PYBIND11_MODULE(_jamfree, m) {
            py::arg("min_gap") = 2.0, py::arg("max_accel") = 1.0,
            py::arg("comfortable_decel") = 1.5, py::arg("accel_exponent") = 4.0,
            "Create IDM with lookup tables (30-40% faster)")
-      .def("calculate_acceleration", &IDMLookup::calculateAcceleration,
+      .def("calculate_acceleration",
+           py::overload_cast<const Vehicle &, const Vehicle *>(
+               &IDMLookup::calculateAcceleration, py::const_),
            py::arg("vehicle"), py::arg("leader") = nullptr,
            "Calculate acceleration using lookup tables")
       .def("__repr__", [](const IDMLookup &idm) {
@@ -446,7 +707,9 @@ PYBIND11_MODULE(_jamfree, m) {
            "Add vehicle to index")
       .def("remove_vehicle", &SpatialIndex::removeVehicle, py::arg("vehicle"),
            "Remove vehicle from index")
-      .def("update", &SpatialIndex::update, "Update index (resort if needed)")
+      .def("remove_vehicles", &SpatialIndex::removeVehicles,
+           py::arg("vehicles"), "Remove vehicles from index, in one pass")
+      .def("update", &SpatialIndex::update, "Update index after the vehicles moved")
       .def("find_leader", &SpatialIndex::findLeader, py::arg("vehicle"),
            "Find leader (O(log N))", py::return_value_policy::reference)
       .def("find_follower", &SpatialIndex::findFollower, py::arg("vehicle"),
@@ -501,6 +764,13 @@ PYBIND11_MODULE(_jamfree, m) {
       .def_readwrite("force_micro_ramps",
                      &AdaptiveSimulator::Config::force_micro_ramps,
                      "Force microscopic mode at ramps")
+      .def_readwrite("frame_budget_ms",
+                     &AdaptiveSimulator::Config::frame_budget_ms,
+                     "Update time budget of a step (ms), 0 for the "
+                     "thresholds")
+      .def_readwrite("cost_smoothing",
+                     &AdaptiveSimulator::Config::cost_smoothing,
+                     "Weight of a new measured update time")
       .def("__repr__", [](const AdaptiveSimulator::Config &c) {
         return "AdaptiveSimulatorConfig(micro_to_macro_density=" +
                std::to_string(c.micro_to_macro_density) +
@@ -527,6 +797,9 @@ PYBIND11_MODULE(_jamfree, m) {
       .def_readonly("total_update_time_ms",
                     &AdaptiveSimulator::Statistics::total_update_time_ms,
                     "Total update time (ms)")
+      .def_readonly("estimated_update_time_ms",
+                    &AdaptiveSimulator::Statistics::estimated_update_time_ms,
+                    "Update time of the current modes by the cost model (ms)")
       .def_readonly("speedup_factor",
                     &AdaptiveSimulator::Statistics::speedup_factor,
                     "Speedup factor vs pure microscopic")
@@ -560,34 +833,257 @@ PYBIND11_MODULE(_jamfree, m) {
       .def(py::init<>(), "Create adaptive hybrid simulator with default config")
       .def(py::init<const AdaptiveSimulator::Config &>(), py::arg("config"),
            "Create adaptive hybrid simulator with custom config")
-      .def("register_lane", &AdaptiveSimulator::registerLane, py::arg("lane"),
-           py::arg("is_critical") = false,
+      .def("register_lane", update(&AdaptiveSimulator::registerLane),
+           py::arg("lane"), py::arg("is_critical") = false,
            "Register a lane for adaptive simulation")
-      .def("update", &AdaptiveSimulator::update, py::arg("dt"), py::arg("idm"),
+      .def("update", &AdaptiveSimulator::update, py::arg("dt"),
+           py::arg("idm"), py::call_guard<py::gil_scoped_release>(),
            "Update all lanes for one time step")
-      .def("get_mode", &AdaptiveSimulator::getMode, py::arg("lane_id"),
+      .def(
+          "export_state",
+          [](const AdaptiveSimulator &simulator) {
+            std::vector<double> rows;
+            {
+              const SharedAccess lock = sharedAccess(simulator);
+              simulator.exportVehicleStates(rows);
+            }
+            return stateArray(rows);
+          },
+          "Get the states of the microscopic vehicles, as an array of "
+          "NUM_STATE_COLUMNS columns")
+      .def("get_mode", query(&AdaptiveSimulator::getMode), py::arg("lane_id"),
            "Get current simulation mode for a lane")
-      .def("get_lane_state", &AdaptiveSimulator::getLaneState,
-           py::arg("lane_id"), "Get lane state with metrics",
-           py::return_value_policy::reference)
-      .def("get_statistics", &AdaptiveSimulator::getStatistics,
+      .def(
+          "get_lane_state",
+          [](const AdaptiveSimulator &simulator, const std::string &lane_id)
+              -> std::optional<AdaptiveSimulator::LaneState> {
+            const SharedAccess lock = sharedAccess(simulator);
+            const auto *state = simulator.getLaneState(lane_id);
+            if (!state) {
+              return std::nullopt;
+            }
+            return *state;
+          },
+          py::arg("lane_id"),
+          "Get a copy of the lane state with metrics, None for an unknown "
+          "lane")
+      .def("get_statistics", query(&AdaptiveSimulator::getStatistics),
            "Get overall statistics")
-      .def("force_microscopic", &AdaptiveSimulator::forceMicroscopic,
+      .def("force_microscopic", update(&AdaptiveSimulator::forceMicroscopic),
            py::arg("lane_id"), "Force a lane to microscopic mode")
-      .def("force_macroscopic", &AdaptiveSimulator::forceMacroscopic,
+      .def("force_macroscopic", update(&AdaptiveSimulator::forceMacroscopic),
            py::arg("lane_id"), "Force a lane to macroscopic mode")
-      .def("allow_automatic", &AdaptiveSimulator::allowAutomatic,
+      .def("allow_automatic", update(&AdaptiveSimulator::allowAutomatic),
            py::arg("lane_id"), "Allow automatic mode switching")
       .def("__repr__", [](const AdaptiveSimulator &sim) {
-        auto stats = sim.getStatistics();
+        const auto stats = query(&AdaptiveSimulator::getStatistics)(sim);
         return "AdaptiveSimulator(lanes=" + std::to_string(stats.total_lanes) +
                ", micro=" + std::to_string(stats.micro_lanes) +
                ", macro=" + std::to_string(stats.macro_lanes) + ")";
       });
 
+  // DetectorSet
+  py::class_<DetectorSet>(m, "DetectorSet")
+      .def(py::init<double>(), py::arg("period") = 60.0,
+           "Create virtual loop detectors aggregated over periods (s)")
+      .def("add_detector", &DetectorSet::addDetector, py::arg("lane"),
+           py::arg("position"), py::arg("loop_length") = 2.0,
+           "Add a detector on a lane, returning its column in the reports")
+      .def("set_num_threads", &DetectorSet::setNumThreads,
+           py::arg("num_threads"), "Set the threads updating the detectors")
+      .def("update", &DetectorSet::update, py::arg("dt"),
+           "Measure the step that just ended")
+      .def_property_readonly("num_detectors", &DetectorSet::getNumDetectors)
+      .def_property_readonly("period", &DetectorSet::getPeriod)
+      .def(
+          "export_reports",
+          [](DetectorSet &detectors) {
+            DetectorReports reports;
+            detectors.exportReports(reports);
+            // One row by period, one column by detector
+            const std::vector<py::ssize_t> shape = {
+                static_cast<py::ssize_t>(reports.getNumPeriods()),
+                static_cast<py::ssize_t>(reports.num_detectors)};
+            py::dict result;
+            result["period_end"] = py::array_t<double>(
+                reports.period_end.size(), reports.period_end.data());
+            result["count"] =
+                py::array_t<std::uint32_t>(shape, reports.counts.data());
+            result["occupancy"] =
+                py::array_t<float>(shape, reports.occupancy.data());
+            result["harmonic_speed"] =
+                py::array_t<float>(shape, reports.harmonic_speed.data());
+            result["mean_speed"] =
+                py::array_t<float>(shape, reports.mean_speed.data());
+            return result;
+          },
+          "Get the measures of the periods ended since the previous export, "
+          "as arrays of one row by period");
+
+  // Vehicle frames
+  py::class_<FrameBounds>(m, "FrameBounds")
+      .def(py::init([](double min_x, double min_y, double max_x,
+                       double max_y) {
+             return FrameBounds{min_x, min_y, max_x, max_y};
+           }),
+           py::arg("min_x"), py::arg("min_y"), py::arg("max_x"),
+           py::arg("max_y"))
+      .def_readwrite("min_x", &FrameBounds::min_x)
+      .def_readwrite("min_y", &FrameBounds::min_y)
+      .def_readwrite("max_x", &FrameBounds::max_x)
+      .def_readwrite("max_y", &FrameBounds::max_y);
+
+  py::class_<VehicleFrameEncoder>(m, "VehicleFrameEncoder")
+      .def(py::init([](const FrameBounds &bounds, double position_resolution,
+                       double speed_resolution, std::size_t keyframe_interval,
+                       bool compress) {
+             VehicleFrameEncoder::Config config;
+             config.position_resolution = position_resolution;
+             config.speed_resolution = speed_resolution;
+             config.keyframe_interval = keyframe_interval;
+             config.compress = compress;
+             return std::make_unique<VehicleFrameEncoder>(bounds, config);
+           }),
+           py::arg("bounds"), py::arg("position_resolution") = 0.1,
+           py::arg("speed_resolution") = 0.1,
+           py::arg("keyframe_interval") = 30, py::arg("compress") = false,
+           "Create an encoder of the vehicle states within bounds")
+      .def(
+          "encode",
+          [](VehicleFrameEncoder &encoder, StateArray states,
+             std::size_t count) {
+            std::size_t capacity;
+            const double *rows = stateRows(states, capacity);
+            std::vector<std::uint8_t> frame;
+            {
+              py::gil_scoped_release release;
+              encoder.encode(rows, std::min(count, capacity), frame);
+            }
+            return py::bytes(reinterpret_cast<const char *>(frame.data()),
+                             frame.size());
+          },
+          py::arg("states").noconvert(), py::arg("count"),
+          "Encode the first count rows of a state array as a binary frame")
+      .def("request_key_frame", &VehicleFrameEncoder::requestKeyFrame,
+           "Make the next frame a key frame, for a new client")
+      .def_property_readonly("frame_number",
+                             &VehicleFrameEncoder::getFrameNumber);
+
+  py::class_<VehicleFrameDecoder>(m, "VehicleFrameDecoder")
+      .def(py::init<>())
+      .def(
+          "decode",
+          [](VehicleFrameDecoder &decoder, py::bytes frame) -> py::object {
+            const std::string data = frame;
+            std::vector<double> rows;
+            if (!decoder.decode(
+                    reinterpret_cast<const std::uint8_t *>(data.data()),
+                    data.size(), rows)) {
+              return py::none();
+            }
+            return stateArray(rows);
+          },
+          py::arg("frame"),
+          "Decode a binary frame into a state array, None for a delta "
+          "frame the decoder cannot apply")
+      .def_property_readonly("frame_number",
+                             &VehicleFrameDecoder::getFrameNumber);
+
+  // Viewports
+  py::class_<Viewport>(m, "Viewport")
+      .def(py::init([](double min_x, double min_y, double max_x,
+                       double max_y, double zoom) {
+             return Viewport{min_x, min_y, max_x, max_y, zoom};
+           }),
+           py::arg("min_x"), py::arg("min_y"), py::arg("max_x"),
+           py::arg("max_y"), py::arg("zoom"))
+      .def_readwrite("min_x", &Viewport::min_x)
+      .def_readwrite("min_y", &Viewport::min_y)
+      .def_readwrite("max_x", &Viewport::max_x)
+      .def_readwrite("max_y", &Viewport::max_y)
+      .def_readwrite("zoom", &Viewport::zoom);
+
+  py::class_<ViewportFilter>(m, "ViewportFilter")
+      .def(py::init([](const std::vector<std::shared_ptr<Road>> &roads,
+                       double detail_zoom, double tile_size,
+                       std::size_t max_tiles, double margin) {
+             ViewportFilter::Config config;
+             config.detail_zoom = detail_zoom;
+             config.tile_size = tile_size;
+             config.max_tiles = max_tiles;
+             config.margin = margin;
+             return std::make_unique<ViewportFilter>(roads, config);
+           }),
+           py::arg("roads"), py::arg("detail_zoom") = 15.0,
+           py::arg("tile_size") = 100.0, py::arg("max_tiles") = 16384,
+           py::arg("margin") = 10.0,
+           "Create a filter of the vehicles of roads by viewport")
+      .def("is_detailed", &ViewportFilter::isDetailed, py::arg("viewport"),
+           "Whether a viewport is sent the vehicles rather than tiles")
+      .def("tile_size", &ViewportFilter::getTileSize, py::arg("viewport"))
+      .def(
+          "export_visible_states",
+          [](const ViewportFilter &filter, const Viewport &viewport,
+             StateArray out) {
+            std::size_t capacity;
+            double *rows = stateRows(out, capacity);
+            py::gil_scoped_release release;
+            return filter.exportVisibleStates(viewport, rows, capacity);
+          },
+          py::arg("viewport"), py::arg("out").noconvert(),
+          "Fill the rows of a state array with the vehicles in a viewport, "
+          "returning their number")
+      .def(
+          "export_density_tiles",
+          [](const ViewportFilter &filter, const Viewport &viewport) {
+            DensityTiles tiles;
+            {
+              py::gil_scoped_release release;
+              filter.exportDensityTiles(viewport, tiles);
+            }
+            const std::vector<py::ssize_t> shape = {
+                static_cast<py::ssize_t>(tiles.rows),
+                static_cast<py::ssize_t>(tiles.columns)};
+            py::dict result;
+            result["origin_x"] = tiles.origin_x;
+            result["origin_y"] = tiles.origin_y;
+            result["tile_size"] = tiles.tile_size;
+            result["counts"] =
+                py::array_t<std::uint32_t>(shape, tiles.counts.data());
+            result["mean_speeds"] =
+                py::array_t<float>(shape, tiles.mean_speeds.data());
+            return result;
+          },
+          py::arg("viewport"),
+          "Count the vehicles in a viewport by tile, as arrays of one row "
+          "by row of tiles");
+
   // ========================================================================
   // Utility functions
   // ========================================================================
+  m.attr("NUM_STATE_COLUMNS") = static_cast<int>(NUM_STATE_COLUMNS);
+  m.attr("STATE_VEHICLE_INDEX") = static_cast<int>(STATE_VEHICLE_INDEX);
+  m.attr("STATE_LANE_INDEX") = static_cast<int>(STATE_LANE_INDEX);
+  m.attr("STATE_LANE_POSITION") = static_cast<int>(STATE_LANE_POSITION);
+  m.attr("STATE_X") = static_cast<int>(STATE_X);
+  m.attr("STATE_Y") = static_cast<int>(STATE_Y);
+  m.attr("STATE_SPEED") = static_cast<int>(STATE_SPEED);
+  m.attr("STATE_ACCELERATION") = static_cast<int>(STATE_ACCELERATION);
+  m.attr("STATE_HEADING") = static_cast<int>(STATE_HEADING);
+
+  m.def(
+      "export_vehicle_states",
+      [](const std::vector<std::shared_ptr<Vehicle>> &vehicles,
+         StateArray out) {
+        std::size_t capacity;
+        double *rows = stateRows(out, capacity);
+        py::gil_scoped_release release;
+        return exportVehicleStates(vehicles, rows, capacity);
+      },
+      py::arg("vehicles"), py::arg("out").noconvert(),
+      "Fill the rows of a float64 array of NUM_STATE_COLUMNS columns with "
+      "the states of vehicles, returning their number");
+
   m.def(
       "kmh_to_ms", [](double kmh) { return kmh / 3.6; }, py::arg("kmh"),
       "Convert km/h to m/s");
@@ -879,30 +1375,245 @@ PYBIND11_MODULE(_jamfree, m) {
   py::class_<SimulationEngine, std::shared_ptr<SimulationEngine>>(
       m, "SimulationEngine")
       .def(py::init<double>(), py::arg("dt") = 0.1, "Create simulation engine")
-      .def("add_agent", &SimulationEngine::addAgent, py::arg("agent"),
+      .def("add_agent", update(&SimulationEngine::addAgent), py::arg("agent"),
            "Add agent")
-      .def("remove_agent", &SimulationEngine::removeAgent, py::arg("agent_id"),
-           "Remove agent")
-      .def("get_agent", &SimulationEngine::getAgent, py::arg("agent_id"),
+      .def("add_agents",
+           update(py::overload_cast<
+                  const std::vector<std::shared_ptr<VehicleAgent>> &>(
+               &SimulationEngine::addAgents)),
+           py::arg("agents"), "Add agents at once, in their order")
+      .def("remove_agent", update(&SimulationEngine::removeAgent),
+           py::arg("agent_id"),
+           "Remove agent, returning it")
+      .def(
+          "get_agent",
+          [](SimulationEngine &engine, const std::string &agent_id) {
+            const SharedAccess lock = sharedAccess(engine);
+            return engine.getAgent(agent_id);
+          },
+          py::arg("agent_id"),
            "Get agent")
+      .def(
+          "export_state",
+          [](const SimulationEngine &engine, StateArray out) {
+            std::size_t capacity;
+            double *rows = stateRows(out, capacity);
+            py::gil_scoped_release release;
+            const SharedAccess lock = sharedAccess(engine);
+            return exportAgentStates(engine, rows, capacity);
+          },
+          py::arg("out").noconvert(),
+          "Fill the rows of a float64 array of NUM_STATE_COLUMNS columns with "
+          "the microscopic states of the agents, in their order, returning "
+          "their number")
       .def(
           "set_reaction_model",
           [](SimulationEngine &engine, const std::string &level,
              std::shared_ptr<IReactionModel> model) {
+            const ExclusiveAccess lock = exclusiveAccess(engine);
             engine.setReactionModel(
                 jamfree::kernel::agents::LevelIdentifier(level), model);
           },
           py::arg("level"), py::arg("model"), "Set reaction model for level")
-      .def("step", &SimulationEngine::step, "Execute one simulation step")
+      .def("set_num_threads", update(&SimulationEngine::setNumThreads),
+           py::arg("num_threads"),
+           "Set the number of threads running the agents (1 = sequential)")
+      .def("step", &SimulationEngine::step,
+           py::call_guard<py::gil_scoped_release>(),
+           "Execute one simulation step")
       .def("run", &SimulationEngine::run, py::arg("num_steps"),
-           "Run multiple steps")
-      .def("reset", &SimulationEngine::reset, "Reset simulation")
-      .def("get_current_time", &SimulationEngine::getCurrentTime,
+           py::call_guard<py::gil_scoped_release>(), "Run multiple steps")
+      .def(
+          "run_for",
+          [](SimulationEngine &engine, std::size_t steps, double wallclock_ms) {
+            SimulationRunner runner([&engine]() { engine.step(); });
+            return runner.runFor(steps, wallclock_ms);
+          },
+          py::arg("steps") = 0, py::arg("wallclock_ms") = 0.0,
+          py::call_guard<py::gil_scoped_release>(),
+          "Run steps up to a number or a wall-clock time (ms), without the "
+          "GIL, returning the number run")
+      .def("reset", update(&SimulationEngine::reset), "Reset simulation")
+      .def("get_current_time", query(&SimulationEngine::getCurrentTime),
            "Get current time")
-      .def("get_time_step", &SimulationEngine::getTimeStep, "Get time step")
-      .def("set_time_step", &SimulationEngine::setTimeStep, py::arg("dt"),
-           "Set time step")
-      .def("get_step_count", &SimulationEngine::getStepCount, "Get step count");
+      .def("get_time_step", query(&SimulationEngine::getTimeStep),
+           "Get time step")
+      .def("set_time_step", update(&SimulationEngine::setTimeStep),
+           py::arg("dt"), "Set time step")
+      .def("get_step_count", query(&SimulationEngine::getStepCount),
+           "Get step count")
+      .def("set_step_timing_listener",
+           update(&SimulationEngine::setStepTimingListener),
+           py::arg("listener"),
+           "Set the listener of the timings of the steps, e.g. a "
+           "SimulationMetrics, or None")
+      .def("get_step_timing_listener",
+           query(&SimulationEngine::getStepTimingListener),
+           "Get the listener of the timings of the steps")
+      .def("get_memory_usage", &SimulationEngine::getMemoryUsage,
+           "Get the live and peak bytes of the accounted subsystems");
+
+  // Telemetry of the steps, local to this module as the similar2logo one
+  // binds the same classes
+  using fr::univ_artois::lgi2a::similar::microkernel::IStepTimingListener;
+  using fr::univ_artois::lgi2a::similar::microkernel::libs::SimulationMetrics;
+  py::class_<IStepTimingListener, std::shared_ptr<IStepTimingListener>>(
+      m, "StepTimingListener", py::module_local());
+  py::class_<SimulationMetrics, IStepTimingListener,
+             std::shared_ptr<SimulationMetrics>>(m, "SimulationMetrics",
+                                                 py::module_local())
+      .def(py::init<std::shared_ptr<IStepTimingListener>>(),
+           py::arg("next") = nullptr,
+           "Counters of the steps, forwarding the timings to the next "
+           "listener if any")
+      .def("add_queue", &SimulationMetrics::addQueue, py::arg("name"),
+           py::arg("depth"), "Export the depth of a queue, called at scrapes")
+      .def("remove_queue", &SimulationMetrics::removeQueue, py::arg("name"))
+      .def("get_steps", &SimulationMetrics::getSteps)
+      .def("get_steps_per_second", &SimulationMetrics::getStepsPerSecond)
+      .def("reset", &SimulationMetrics::reset)
+      .def("to_text", &SimulationMetrics::toText,
+           py::arg("open_metrics") = true,
+           "Get the page of the metrics, in the OpenMetrics format or the "
+           "text format of Prometheus")
+      .def_static("get_content_type", &SimulationMetrics::getContentType,
+                  py::arg("open_metrics") = true);
+
+  // Memory accounting of the process
+  using fr::univ_artois::lgi2a::similar::microkernel::libs::MemoryAccounting;
+  using fr::univ_artois::lgi2a::similar::microkernel::libs::MemoryUsage;
+  py::class_<MemoryUsage>(m, "MemoryUsage")
+      .def_readonly("subsystem", &MemoryUsage::subsystem)
+      .def_readonly("live_bytes", &MemoryUsage::liveBytes)
+      .def_readonly("peak_bytes", &MemoryUsage::peakBytes)
+      .def_readonly("allocations", &MemoryUsage::allocations);
+  m.def("memory_usage", &MemoryAccounting::snapshot,
+        "Get the live and peak bytes of the accounted subsystems");
+  m.def("reset_memory_peaks", &MemoryAccounting::resetPeaks,
+        "Start the peaks again from the live bytes");
+
+  // SimulationRunner
+  py::class_<SimulationRunner>(m, "SimulationRunner")
+      .def(py::init([](std::shared_ptr<SimulationEngine> engine) {
+             return std::make_unique<SimulationRunner>(
+                 [engine]() { engine->step(); },
+                 [engine](std::vector<double> &rows) {
+                   const SharedAccess lock = sharedAccess(*engine);
+                   rows.resize(engine->getAgents().size() * NUM_STATE_COLUMNS);
+                   exportAgentStates(*engine, rows.data(),
+                                     engine->getAgents().size());
+                 });
+           }),
+           py::arg("engine"),
+           "Run the steps of an engine, with snapshots of its agents")
+      .def(py::init([](AdaptiveSimulator &simulator, double dt,
+                       const IDM &idm) {
+             return std::make_unique<SimulationRunner>(
+                 [&simulator, dt, &idm]() { simulator.update(dt, idm); },
+                 [&simulator](std::vector<double> &rows) {
+                   const SharedAccess lock = sharedAccess(simulator);
+                   simulator.exportVehicleStates(rows);
+                 });
+           }),
+           py::arg("simulator"), py::arg("dt"), py::arg("idm"),
+           py::keep_alive<1, 2>(), py::keep_alive<1, 4>(),
+           "Run the updates of an adaptive simulator, with snapshots of its "
+           "microscopic vehicles")
+      .def("run_for", &SimulationRunner::runFor, py::arg("steps") = 0,
+           py::arg("wallclock_ms") = 0.0,
+           py::call_guard<py::gil_scoped_release>(),
+           "Run steps up to a number or a wall-clock time (ms), without the "
+           "GIL, returning the number run")
+      .def("start", &SimulationRunner::start, py::arg("step_period_ms") = 0.0,
+           py::arg("capture_every") = 1,
+           "Run steps on a background thread until stop()")
+      .def("stop", &SimulationRunner::stop,
+           py::call_guard<py::gil_scoped_release>(),
+           "Stop the background thread")
+      .def("is_running", &SimulationRunner::isRunning,
+           "Check if the background thread runs")
+      .def_property_readonly("num_steps", &SimulationRunner::getNumSteps)
+      .def(
+          "latest",
+          [](SimulationRunner &runner) {
+            runner.updateSnapshot();
+            return stateArray(runner.getSnapshot());
+          },
+          "Get the newest snapshot, without waiting for the simulation, as "
+          "an array of NUM_STATE_COLUMNS columns");
+
+  // Trajectories
+  py::class_<TrajectoryRecorder>(m, "TrajectoryRecorder")
+      .def(py::init([](const std::string &path, std::size_t keyframe_interval,
+                       bool compress, std::size_t max_pending_frames) {
+             TrajectoryRecorder::Config config;
+             config.keyframe_interval = keyframe_interval;
+             config.compress = compress;
+             config.max_pending_frames = max_pending_frames;
+             return std::make_unique<TrajectoryRecorder>(path, config);
+           }),
+           py::arg("path"), py::arg("keyframe_interval") = 100,
+           py::arg("compress") = true, py::arg("max_pending_frames") = 4)
+      .def(
+          "record",
+          [](TrajectoryRecorder &recorder, double time, StateArray states,
+             std::size_t count) {
+            std::size_t capacity;
+            const double *rows = stateRows(states, capacity);
+            std::vector<double> frame(
+                rows, rows + std::min(count, capacity) * NUM_STATE_COLUMNS);
+            py::gil_scoped_release release;
+            recorder.record(time, frame);
+          },
+          py::arg("time"), py::arg("states").noconvert(), py::arg("count"),
+          "Record the first count rows of a state array as the frame of a "
+          "time, written on a background thread")
+      .def("close", &TrajectoryRecorder::close,
+           py::call_guard<py::gil_scoped_release>(),
+           "Write the frames left and the index, and close the file")
+      .def_property_readonly("num_frames", &TrajectoryRecorder::getNumFrames);
+
+  py::class_<TrajectoryReader>(m, "TrajectoryReader")
+      .def(py::init<const std::string &>(), py::arg("path"))
+      .def_property_readonly("num_frames", &TrajectoryReader::getNumFrames)
+      .def("get_time", &TrajectoryReader::getTime, py::arg("frame"))
+      .def("find_frame", &TrajectoryReader::findFrame, py::arg("time"),
+           "Get the last frame at a time or before")
+      .def(
+          "read_frame",
+          [](TrajectoryReader &reader, std::size_t frame) {
+            std::vector<double> rows;
+            {
+              py::gil_scoped_release release;
+              reader.readFrame(frame, rows);
+            }
+            return stateArray(rows);
+          },
+          py::arg("frame"), "Read a frame as a state array");
+
+  py::class_<TrajectoryReplay>(m, "TrajectoryReplay")
+      .def(py::init<const std::string &>(), py::arg("path"))
+      .def_property("speed", &TrajectoryReplay::getSpeed,
+                    &TrajectoryReplay::setSpeed,
+                    "Seconds of the recording by wall-clock second")
+      .def("seek", &TrajectoryReplay::seek, py::arg("time"))
+      .def("advance", &TrajectoryReplay::advance,
+           py::arg("wallclock_seconds"),
+           "Move on by a wall-clock time, at the playback speed")
+      .def("update_frame", &TrajectoryReplay::updateFrame,
+           py::call_guard<py::gil_scoped_release>(),
+           "Decode the frame at the time, returning whether it changed")
+      .def(
+          "frame",
+          [](const TrajectoryReplay &replay) {
+            return stateArray(replay.getFrame());
+          },
+          "Get the frame last decoded, as a state array")
+      .def_property_readonly("frame_index", &TrajectoryReplay::getFrameIndex)
+      .def_property_readonly("time", &TrajectoryReplay::getTime)
+      .def_property_readonly("start_time", &TrajectoryReplay::getStartTime)
+      .def_property_readonly("end_time", &TrajectoryReplay::getEndTime)
+      .def("is_at_end", &TrajectoryReplay::isAtEnd);
 
   // ========================================================================
   // Reaction Models
@@ -918,5 +1629,8 @@ PYBIND11_MODULE(_jamfree, m) {
            "Create microscopic reaction model")
       .def("set_simulation_engine",
            &MicroscopicReactionModel::setSimulationEngine, py::arg("engine"),
-           "Set simulation engine");
+           "Set simulation engine")
+      .def("set_num_threads", &MicroscopicReactionModel::setNumThreads,
+           py::arg("num_threads"),
+           "Set the number of threads updating the lanes (1 = sequential)");
 }
@@ -0,0 +1,55 @@
+#!/usr/bin/env python3
+"""
+Smoke test of the _jamfree module, run by ctest when pybind11 is found.
+
+Checks that the module keeps the GIL disabled on a free-threaded
+interpreter, and that queries running in other threads during the steps of
+an engine see whole steps only.
+
+Usage: test_bindings_smoke.py <directory of the module>
+"""
+
+import sys
+import sysconfig
+import threading
+
+sys.path.insert(0, sys.argv[1] if len(sys.argv) > 1 else '.')
+
+import _jamfree  # noqa: E402
+
+
+def test_gil_stays_disabled():
+    if sysconfig.get_config_var('Py_GIL_DISABLED'):
+        assert not sys._is_gil_enabled(), 'importing _jamfree enabled the GIL'
+
+
+def test_concurrent_queries():
+    engine = _jamfree.SimulationEngine(0.5)
+    done = threading.Event()
+    errors = []
+
+    def query():
+        last = 0
+        while not done.is_set():
+            steps = engine.get_step_count()
+            # A step updates the time and the count under the same lock
+            if steps < last or engine.get_current_time() < 0.5 * steps:
+                errors.append(steps)
+            last = steps
+
+    readers = [threading.Thread(target=query) for _ in range(4)]
+    for reader in readers:
+        reader.start()
+    engine.run(2000)
+    done.set()
+    for reader in readers:
+        reader.join()
+    assert not errors, f'inconsistent queries at steps {errors[:5]}'
+    assert engine.get_step_count() == 2000
+    assert engine.get_current_time() == 1000.0
+
+
+if __name__ == '__main__':
+    test_gil_stays_disabled()
+    test_concurrent_queries()
+    print('jamfree binding smoke test PASSED')
@@ -0,0 +1,202 @@
+#!/usr/bin/env python3
+"""
+Test script for the binary vehicle frames of the web UI.
+
+Streams the vehicles of an OSM network to a WebSocket test client and
+decodes the frames it receives.
+"""
+
+import os
+import sys
+import tempfile
+import time
+
+# Add python/ to path to import jamfree, and python/web for the web UI
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, HERE)
+sys.path.insert(0, os.path.join(HERE, 'web'))
+
+import numpy as np
+
+import jamfree
+import app as web
+
+NAMESPACE = '/simulation'
+OSM_FILE = os.path.join(HERE, 'web', 'uploads', 'osm_download_48.85_2.34.osm')
+
+
+def load_network(num_vehicles=5):
+    """Load the test network, with vehicles on its first lane."""
+    network = jamfree.OSMParser.parse_file(OSM_FILE)
+    lane = network.roads[0].get_lane(0)
+    vehicles = []
+    for i in range(num_vehicles):
+        vehicle = jamfree.Vehicle(f'v{i}')
+        vehicle.set_current_lane(lane)
+        vehicle.set_lane_position(
+            min(10.0 * i, lane.get_length() * i / num_vehicles))
+        vehicle.set_speed(10.0 + i)
+        vehicles.append(vehicle)
+    web.simulation_state['network'] = network
+    web.simulation_state['vehicles'] = vehicles
+    return network, vehicles
+
+
+def reset_stream():
+    """Stop the stream and forget its encoders."""
+    web.frame_stream['running'] = False
+    thread = web.frame_stream['thread']
+    if thread is not None:
+        thread.join(timeout=2.0)
+    web.frame_stream.update({'thread': None, 'encoder': None, 'options': {},
+                             'filter': None, 'replay': None})
+    web.frame_stream['clients'].clear()
+    web.frame_stream['viewports'].clear()
+
+
+def wait_for(client, name, timeout=5.0):
+    """Wait for the messages of a name sent to a test client."""
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        messages = [m for m in client.get_received(NAMESPACE)
+                    if m['name'] == name]
+        if messages:
+            return messages
+        time.sleep(0.05)
+    raise AssertionError(f"No '{name}' message within {timeout} s")
+
+
+def test_frame_stream():
+    """The frames decode into the states of the vehicles."""
+    _, vehicles = load_network()
+    reset_stream()
+    client = web.socketio.test_client(web.app, namespace=NAMESPACE)
+    assert client.is_connected(NAMESPACE)
+    client.get_received(NAMESPACE)
+
+    client.emit('start_frame_stream', {'fps': 50, 'position_resolution': 0.01},
+                namespace=NAMESPACE)
+    frames = wait_for(client, 'vehicle_frame')
+
+    # The first frame received is a key frame
+    decoder = jamfree.VehicleFrameDecoder()
+    decoded = decoder.decode(frames[0]['args'][0])
+    assert decoded is not None
+    assert decoded.shape == (len(vehicles), jamfree.NUM_STATE_COLUMNS)
+
+    expected = np.empty((len(vehicles), jamfree.NUM_STATE_COLUMNS))
+    assert jamfree.export_vehicle_states(vehicles, expected) == len(vehicles)
+    for column in (jamfree.STATE_X, jamfree.STATE_Y):
+        assert np.allclose(decoded[:, column], expected[:, column], atol=0.01)
+    assert np.allclose(decoded[:, jamfree.STATE_SPEED],
+                       expected[:, jamfree.STATE_SPEED], atol=0.1)
+
+    # The next frames apply to the decoded one
+    for frame in frames[1:] + wait_for(client, 'vehicle_frame'):
+        assert decoder.decode(frame['args'][0]) is not None
+
+    client.emit('stop_frame_stream', namespace=NAMESPACE)
+    statuses = wait_for(client, 'status')
+    assert statuses[-1]['args'][0] == {'frame_stream': False}
+    assert not web.frame_stream['running']
+    client.disconnect(NAMESPACE)
+    reset_stream()
+    print("   ✓ start_frame_stream")
+
+
+def test_viewport_stream():
+    """A viewport gets its vehicles zoomed in, and tiles zoomed out."""
+    network, vehicles = load_network()
+    reset_stream()
+    client = web.socketio.test_client(web.app, namespace=NAMESPACE)
+    client.get_received(NAMESPACE)
+    area = {'min_lat': network.min_lat, 'min_lon': network.min_lon,
+            'max_lat': network.max_lat, 'max_lon': network.max_lon}
+
+    client.emit('subscribe_viewport', dict(area, zoom=17), namespace=NAMESPACE)
+    assert wait_for(client, 'status')[-1]['args'][0]['detailed']
+    assert isinstance(web.frame_stream['filter'], jamfree.ViewportFilter)
+    (subscriber,) = web.frame_stream['viewports'].values()
+    viewport = subscriber['viewport']
+    assert isinstance(viewport, jamfree.Viewport)
+    assert viewport.zoom == 17
+    frame = wait_for(client, 'vehicle_frame')[0]['args'][0]
+    decoded = jamfree.VehicleFrameDecoder().decode(frame)
+    assert decoded is not None and len(decoded) == len(vehicles)
+
+    client.emit('subscribe_viewport', dict(area, zoom=10), namespace=NAMESPACE)
+    assert not wait_for(client, 'status')[-1]['args'][0]['detailed']
+    tiles = wait_for(client, 'density_tiles')[-1]['args'][0]
+    assert tiles['rows'] > 0 and tiles['columns'] > 0
+
+    client.disconnect(NAMESPACE)
+    reset_stream()
+    print("   ✓ subscribe_viewport")
+
+
+def test_replay_stream():
+    """A recorded trajectory streams as the frames of a live network."""
+    _, vehicles = load_network()
+    reset_stream()
+    states = np.empty((len(vehicles), jamfree.NUM_STATE_COLUMNS))
+    with tempfile.TemporaryDirectory() as directory:
+        path = os.path.join(directory, 'trajectory.jft')
+        recorder = jamfree.TrajectoryRecorder(path, keyframe_interval=2)
+        for step in range(5):
+            for vehicle in vehicles:
+                vehicle.update(0.1, 1.0)
+            count = jamfree.export_vehicle_states(vehicles, states)
+            recorder.record(0.1 * step, states, count)
+        recorder.close()
+        assert recorder.num_frames == 5
+        assert jamfree.TrajectoryReader(path).num_frames == 5
+
+        client = web.socketio.test_client(web.app, namespace=NAMESPACE)
+        client.get_received(NAMESPACE)
+        client.emit('start_replay', {'path': path, 'speed': 0.0},
+                    namespace=NAMESPACE)
+        status = wait_for(client, 'status')[-1]['args'][0]
+        assert status['replay']
+        assert isinstance(web.frame_stream['replay'], jamfree.TrajectoryReplay)
+        assert status['end_time'] > status['start_time']
+
+        # Paused at the start, the replay streams its first frame
+        frame = wait_for(client, 'vehicle_frame')[0]['args'][0]
+        decoded = jamfree.VehicleFrameDecoder().decode(frame)
+        assert decoded is not None and len(decoded) == len(vehicles)
+        assert wait_for(client, 'replay_status')[-1]['args'][0]['time'] == \
+            status['start_time']
+
+        client.emit('replay_control', {'seek': status['end_time']},
+                    namespace=NAMESPACE)
+        assert wait_for(client, 'status')[-1]['args'][0]['time'] == \
+            status['end_time']
+        client.emit('stop_replay', namespace=NAMESPACE)
+        assert wait_for(client, 'status')[-1]['args'][0] == {'replay': False}
+        assert web.frame_stream['replay'] is None
+        client.disconnect(NAMESPACE)
+        reset_stream()
+    print("   ✓ start_replay")
+
+
+def test_frame_stream_without_network():
+    """The stream does not start without a network."""
+    web.simulation_state['network'] = None
+    reset_stream()
+    client = web.socketio.test_client(web.app, namespace=NAMESPACE)
+    client.get_received(NAMESPACE)
+    client.emit('start_frame_stream', {}, namespace=NAMESPACE)
+    errors = wait_for(client, 'error')
+    assert errors[0]['args'][0] == {'message': 'No network loaded'}
+    assert not web.frame_stream['running']
+    client.disconnect(NAMESPACE)
+    print("   ✓ start_frame_stream without a network")
+
+
+if __name__ == '__main__':
+    print("Testing the binary vehicle frames...")
+    test_frame_stream()
+    test_viewport_stream()
+    test_replay_stream()
+    test_frame_stream_without_network()
+    print("All frame stream tests passed")
@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""
+Test script for the telemetry of the web UI.
+
+Tests the counters of the steps, the /metrics page and the metrics of the
+engine manager.
+"""
+
+import os
+import sys
+
+# Add python/ to path to import jamfree, and python/web for the web UI
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                'web'))
+
+from metrics import (StepMetrics, BUCKET_BOUNDS, OPEN_METRICS_TYPE,
+                     PROMETHEUS_TYPE, accepts_open_metrics)
+
+
+class DummyNetwork:
+    min_lat = 48.8
+    max_lat = 48.9
+    min_lon = 2.3
+    max_lon = 2.4
+
+
+class DummyUsage:
+    subsystem = 'lanes "main"'
+    live_bytes = 2048
+    peak_bytes = 4096
+
+
+def test_step_metrics():
+    """The counters, histogram and formats of StepMetrics."""
+    metrics = StepMetrics()
+    metrics.observe(0.002, 10, micro_lanes=3, macro_lanes=1)
+    metrics.observe(0.2, 12, micro_lanes=2, macro_lanes=2)
+    metrics.add_queue('frames', lambda: 7)
+
+    text = metrics.to_text(open_metrics=True, memory_usage=[DummyUsage()])
+    lines = text.splitlines()
+    assert lines[-1] == '# EOF'
+    assert '# TYPE jamfree_steps counter' in lines
+    assert 'jamfree_steps_total 2' in lines
+    assert 'jamfree_vehicles 12' in lines
+    assert 'jamfree_micro_lanes 2' in lines
+    assert 'jamfree_macro_lanes 2' in lines
+    assert 'jamfree_queue_depth{queue="frames"} 7' in lines
+    assert ('jamfree_memory_live_bytes{subsystem="lanes \\"main\\""} 2048'
+            in lines)
+    assert 'jamfree_step_seconds_count 2' in lines
+
+    # The buckets are cumulative, the last one counting every step
+    buckets = [line for line in lines
+               if line.startswith('jamfree_step_seconds_bucket')]
+    assert len(buckets) == len(BUCKET_BOUNDS) + 1
+    counts = [int(line.rsplit(' ', 1)[1]) for line in buckets]
+    assert counts == sorted(counts)
+    assert 'jamfree_step_seconds_bucket{le="0.0025"} 1' in lines
+    assert counts[-1] == 2
+
+    # The text format of Prometheus suffixes the counter families
+    text = metrics.to_text(open_metrics=False)
+    assert '# TYPE jamfree_steps_total counter' in text
+    assert '# EOF' not in text
+
+    metrics.remove_queue('frames')
+    metrics.reset()
+    text = metrics.to_text()
+    assert 'jamfree_steps_total 0' in text
+    assert 'jamfree_queue_depth' not in text
+    assert metrics.steps_per_second() == 0.0
+
+    assert accepts_open_metrics('application/openmetrics-text; version=1.0.0')
+    assert not accepts_open_metrics('text/plain')
+    assert not accepts_open_metrics(None)
+    print("   ✓ StepMetrics")
+
+
+def test_metrics_endpoint():
+    """The /metrics page, in both formats."""
+    from app import app
+
+    client = app.test_client()
+    response = client.get(
+        '/metrics', headers={'Accept': 'application/openmetrics-text'})
+    assert response.status_code == 200
+    assert response.headers['Content-Type'] == OPEN_METRICS_TYPE
+    assert response.headers['Cache-Control'] == 'no-store'
+    text = response.get_data(as_text=True)
+    assert 'jamfree_steps_total' in text
+    assert text.endswith('# EOF\n')
+
+    response = client.get('/metrics', headers={'Accept': 'text/plain'})
+    assert response.status_code == 200
+    assert response.headers['Content-Type'] == PROMETHEUS_TYPE
+    assert '# EOF' not in response.get_data(as_text=True)
+    print("   ✓ /metrics")
+
+
+def test_engine_manager_metrics():
+    """The engine manager counts the steps of its engine."""
+    import jamfree
+    from engine_manager import SimulationEngineManager
+
+    manager = SimulationEngineManager(DummyNetwork(), {'num_threads': 1})
+    assert isinstance(manager.metrics, jamfree.SimulationMetrics)
+    assert isinstance(manager.metrics, jamfree.StepTimingListener)
+    assert manager.metrics.get_steps() == 0
+    assert 'jamfree_steps_total 0' in manager.metrics.to_text(False)
+    for usage in jamfree.memory_usage():
+        assert isinstance(usage, jamfree.MemoryUsage)
+        assert usage.peak_bytes >= usage.live_bytes
+    print("   ✓ SimulationEngineManager.metrics")
+
+
+if __name__ == '__main__':
+    print("Testing the telemetry of the web UI...")
+    test_step_metrics()
+    test_metrics_endpoint()
+    test_engine_manager_metrics()
+    print("All telemetry tests passed")
@@ -20,6 +20,8 @@ import math
 import threading
 import time
 from routing import RoutingEngine
+from metrics import (StepMetrics, OPEN_METRICS_TYPE, PROMETHEUS_TYPE,
+                     accepts_open_metrics)
 
 # Try to import jamfree and engine_manager
 try:
@@ -91,11 +93,24 @@ simulation_state = {
 # Track vehicle history for export
 vehicle_history = []
 
+# Telemetry of the steps, scraped on /metrics
+step_metrics = StepMetrics()
+
 @app.route('/')
 def index():
     """Main page."""
     return render_template('index.html', jamfree_available=JAMFREE_AVAILABLE)
 
+@app.route('/metrics')
+def get_metrics():
+    """Telemetry of the simulation, for Prometheus or OpenMetrics scrapers."""
+    open_metrics = accepts_open_metrics(request.headers.get('Accept'))
+    memory = jamfree.memory_usage() if JAMFREE_AVAILABLE else None
+    return app.response_class(
+        step_metrics.to_text(open_metrics, memory),
+        content_type=OPEN_METRICS_TYPE if open_metrics else PROMETHEUS_TYPE,
+        headers={'Cache-Control': 'no-store'})
+
 @app.route('/api/status')
 def get_status():
     """Get simulation status."""
@@ -137,7 +152,9 @@ def upload_osm():
     # Parse OSM file if jamfree available
     if JAMFREE_AVAILABLE:
         try:
-            network = jamfree.OSMParser.parse_file(str(filepath))
+            # Uploading the same file again reuses the parsed network
+            network = jamfree.NetworkCache.load_or_parse(
+                str(filepath), str(filepath) + '.cache')
             simulation_state['network'] = network
             
             # Calculate and store center coordinates for coordinate conversion
@@ -979,6 +996,9 @@ def simulation_step():
     # Track performance
     step_time = (time.time() - step_start) * 1000  # ms
     simulation_state['performance_stats']['avg_update_time_ms'] = step_time
+    step_metrics.observe(step_time / 1000.0, num_vehicles,
+                         simulation_state['performance_stats']['micro_lanes'],
+                         simulation_state['performance_stats']['macro_lanes'])
     
     # Calculate speedup estimate (use adaptive speedup if available)
     adaptive_sim = simulation_state.get('adaptive_simulator')
@@ -1373,6 +1393,9 @@ def execute_simulation_step():
     simulation_state['step'] += 1
 
     step_time = (time.time() - step_start) * 1000  # ms
+    step_metrics.observe(step_time / 1000.0, num_vehicles,
+                         simulation_state['performance_stats']['micro_lanes'],
+                         simulation_state['performance_stats']['macro_lanes'])
     
     return {
         'step': simulation_state['step'],
@@ -1397,6 +1420,7 @@ def handle_connect():
 def handle_disconnect():
     """Handle WebSocket disconnection."""
     print('❌ Client disconnected from WebSocket')
+    unsubscribe_frames(request.sid)
 
 @socketio.on('start_simulation', namespace='/simulation')
 def handle_start_simulation(data):
@@ -1450,6 +1474,332 @@ def handle_set_playback_speed(data):
     simulation_state['playback_speed'] = speed
     emit('status', {'playback_speed': speed})
 
+# ============================================================================
+# Binary vehicle frames
+# ============================================================================
+
+# The vehicle states pushed as delta-encoded binary frames, at a fixed rate.
+# The clients of the whole network share an encoder; a client subscribed to
+# a viewport gets the vehicles in it only, from its own encoder, or their
+# density tiles when zoomed out.
+frame_stream = {
+    'running': False,
+    'thread': None,
+    'encoder': None,
+    'fps': 20.0,
+    'options': {},
+    'clients': set(),  # sids streamed the whole network
+    'filter': None,  # jamfree.ViewportFilter of the network roads
+    'viewports': {},  # sid -> {'viewport', 'encoder', 'detailed'}
+    'replay': None,  # jamfree.TrajectoryReplay streamed instead of the engine
+}
+
+def network_center(network):
+    """Center of a network, the origin of its coordinates in meters."""
+    return ((network.min_lat + network.max_lat) / 2.0,
+            (network.min_lon + network.max_lon) / 2.0)
+
+def network_frame_bounds(network):
+    """Bounds of a network, in meters around its center, for the frames."""
+    center_lat, center_lon = network_center(network)
+    low = jamfree.OSMParser.lat_lon_to_meters(
+        network.min_lat, network.min_lon, center_lat, center_lon)
+    high = jamfree.OSMParser.lat_lon_to_meters(
+        network.max_lat, network.max_lon, center_lat, center_lon)
+    # A margin for the vehicles drawn on the border roads
+    return jamfree.FrameBounds(low.x - 100.0, low.y - 100.0,
+                               high.x + 100.0, high.y + 100.0)
+
+def replay_frame_bounds(replay):
+    """Bounds of the vehicles of the first and last frames of a replay."""
+    import numpy as np
+
+    low_x = low_y = math.inf
+    high_x = high_y = -math.inf
+    frames = [replay.frame()]
+    replay.seek(replay.end_time)
+    replay.update_frame()
+    frames.append(replay.frame())
+    replay.seek(replay.start_time)
+    replay.update_frame()
+    for states in frames:
+        if len(states):
+            x = states[:, jamfree.STATE_X]
+            y = states[:, jamfree.STATE_Y]
+            low_x, high_x = min(low_x, np.nanmin(x)), max(high_x, np.nanmax(x))
+            low_y, high_y = min(low_y, np.nanmin(y)), max(high_y, np.nanmax(y))
+    if low_x > high_x:
+        low_x = low_y = high_x = high_y = 0.0
+    # A wide margin, the frames between going anywhere
+    return jamfree.FrameBounds(low_x - 1000.0, low_y - 1000.0,
+                               high_x + 1000.0, high_y + 1000.0)
+
+def make_frame_encoder():
+    """Frame encoder of the network or the replay, with the options of the
+    stream."""
+    options = frame_stream['options']
+    if frame_stream['replay'] is not None:
+        bounds = frame_stream['replay_bounds']
+    else:
+        bounds = network_frame_bounds(simulation_state['network'])
+    return jamfree.VehicleFrameEncoder(
+        bounds,
+        position_resolution=float(options.get('position_resolution', 0.1)),
+        speed_resolution=float(options.get('speed_resolution', 0.1)),
+        keyframe_interval=int(options.get('keyframe_interval', 30)),
+        compress=bool(options.get('compress', False)))
+
+def emit_viewport_frame(sid, client, states):
+    """Emit the vehicles or the density tiles of the viewport of a client."""
+    viewport = client['viewport']
+    view_filter = frame_stream['filter']
+    if not view_filter.is_detailed(viewport):
+        tiles = view_filter.export_density_tiles(viewport)
+        counts = tiles['counts']
+        socketio.emit('density_tiles', {
+            'origin_x': tiles['origin_x'],
+            'origin_y': tiles['origin_y'],
+            'tile_size': tiles['tile_size'],
+            'rows': counts.shape[0],
+            'columns': counts.shape[1],
+            'counts': counts.tobytes(),
+            'mean_speeds': tiles['mean_speeds'].tobytes(),
+        }, namespace='/simulation', to=sid)
+        client['detailed'] = False
+        return
+    if not client['detailed']:
+        # Back from the tiles, the client has no frame to apply a delta to
+        client['encoder'].request_key_frame()
+        client['detailed'] = True
+    count = view_filter.export_visible_states(viewport, states)
+    frame = client['encoder'].encode(states, min(count, len(states)))
+    socketio.emit('vehicle_frame', frame, namespace='/simulation', to=sid)
+
+def emit_replay_viewport_frame(sid, client, states):
+    """Emit the vehicles of a replay in the viewport of a client."""
+    viewport = client['viewport']
+    x = states[:, jamfree.STATE_X]
+    y = states[:, jamfree.STATE_Y]
+    visible = states[(x >= viewport.min_x) & (x <= viewport.max_x) &
+                     (y >= viewport.min_y) & (y <= viewport.max_y)]
+    if not client['detailed']:
+        client['encoder'].request_key_frame()
+        client['detailed'] = True
+    frame = client['encoder'].encode(visible, len(visible))
+    socketio.emit('vehicle_frame', frame, namespace='/simulation', to=sid)
+
+def emit_replay_frames(replay, elapsed):
+    """Move a replay on by a wall-clock time, and emit its frame."""
+    replay.advance(elapsed)
+    replay.update_frame()
+    states = replay.frame()
+    if frame_stream['clients']:
+        frame = frame_stream['encoder'].encode(states, len(states))
+        for sid in list(frame_stream['clients']):
+            socketio.emit('vehicle_frame', frame,
+                          namespace='/simulation', to=sid)
+    for sid, client in list(frame_stream['viewports'].items()):
+        emit_replay_viewport_frame(sid, client, states)
+    socketio.emit('replay_status', {
+        'time': replay.time,
+        'start_time': replay.start_time,
+        'end_time': replay.end_time,
+        'speed': replay.speed,
+    }, namespace='/simulation')
+
+def frame_stream_task():
+    """Background thread that encodes the vehicle states and emits them."""
+    import numpy as np
+
+    states = np.empty((0, jamfree.NUM_STATE_COLUMNS))
+    period = 1.0 / frame_stream['fps']
+    next_frame = time.time()
+    last_frame = next_frame
+    while frame_stream['running']:
+        now = time.time()
+        elapsed, last_frame = now - last_frame, now
+        replay = frame_stream['replay']
+        if replay is not None:
+            try:
+                emit_replay_frames(replay, elapsed)
+            except Exception as e:
+                print(f"Error in replay stream: {e}")
+                socketio.emit('error', {'message': str(e)},
+                              namespace='/simulation')
+            next_frame += period
+            delay = next_frame - time.time()
+            if delay > 0:
+                time.sleep(delay)
+            else:
+                next_frame = time.time()
+            continue
+
+        vehicles = simulation_state['vehicles']
+        if len(vehicles) > len(states):
+            # Room for the next spawns too
+            states = np.empty((2 * len(vehicles), jamfree.NUM_STATE_COLUMNS))
+        try:
+            if frame_stream['clients']:
+                count = jamfree.export_vehicle_states(vehicles, states)
+                frame = frame_stream['encoder'].encode(states, count)
+                for sid in list(frame_stream['clients']):
+                    socketio.emit('vehicle_frame', frame,
+                                  namespace='/simulation', to=sid)
+            for sid, client in list(frame_stream['viewports'].items()):
+                emit_viewport_frame(sid, client, states)
+        except Exception as e:
+            print(f"Error in frame stream: {e}")
+            socketio.emit('error', {'message': str(e)}, namespace='/simulation')
+
+        # A fixed rate, whatever the time to encode a frame
+        next_frame += period
+        delay = next_frame - time.time()
+        if delay > 0:
+            time.sleep(delay)
+        else:
+            next_frame = time.time()
+
+def ensure_frame_stream(data):
+    """Set up the frame stream of the network, and start its thread."""
+    if frame_stream['encoder'] is None:
+        frame_stream['options'] = dict(data)
+        frame_stream['fps'] = float(data.get('fps', frame_stream['fps']))
+        frame_stream['encoder'] = make_frame_encoder()
+    if (frame_stream['filter'] is None and
+            simulation_state['network'] is not None):
+        frame_stream['filter'] = jamfree.ViewportFilter(
+            simulation_state['network'].roads)
+    if not frame_stream['running']:
+        frame_stream['running'] = True
+        frame_stream['thread'] = socketio.start_background_task(
+            frame_stream_task)
+
+@socketio.on('start_frame_stream', namespace='/simulation')
+def handle_start_frame_stream(data=None):
+    """Start pushing binary vehicle frames of the network, a key frame first.
+
+    Options: fps, position_resolution (m), speed_resolution (m/s),
+    keyframe_interval (frames) and compress (deflate the frames).
+    """
+    if not JAMFREE_AVAILABLE or (simulation_state['network'] is None and
+                                 frame_stream['replay'] is None):
+        emit('error', {'message': 'No network loaded'})
+        return
+    ensure_frame_stream(data or {})
+    # A client joining the stream needs a key frame to start from
+    frame_stream['encoder'].request_key_frame()
+    frame_stream['viewports'].pop(request.sid, None)
+    frame_stream['clients'].add(request.sid)
+    emit('status', {'frame_stream': True, 'fps': frame_stream['fps']})
+
+@socketio.on('subscribe_viewport', namespace='/simulation')
+def handle_subscribe_viewport(data):
+    """Stream the vehicles of a map viewport only, at its level of detail.
+
+    data: min_lat, min_lon, max_lat, max_lon and zoom, the map zoom level,
+    sent again whenever the map moves. Zoomed out, the client gets
+    'density_tiles' messages instead of 'vehicle_frame' ones.
+    """
+    if not JAMFREE_AVAILABLE or simulation_state['network'] is None:
+        emit('error', {'message': 'No network loaded'})
+        return
+    ensure_frame_stream({})
+    center_lat, center_lon = network_center(simulation_state['network'])
+    low = jamfree.OSMParser.lat_lon_to_meters(
+        float(data['min_lat']), float(data['min_lon']), center_lat, center_lon)
+    high = jamfree.OSMParser.lat_lon_to_meters(
+        float(data['max_lat']), float(data['max_lon']), center_lat, center_lon)
+    viewport = jamfree.Viewport(low.x, low.y, high.x, high.y,
+                                float(data['zoom']))
+    client = frame_stream['viewports'].get(request.sid)
+    if client is None:
+        frame_stream['clients'].discard(request.sid)
+        client = {'encoder': make_frame_encoder(), 'detailed': False}
+        frame_stream['viewports'][request.sid] = client
+    client['viewport'] = viewport
+    emit('status', {'frame_stream': True,
+                    'detailed': frame_stream['filter'].is_detailed(viewport)})
+
+@socketio.on('start_replay', namespace='/simulation')
+def handle_start_replay(data):
+    """Stream the frames of a recorded trajectory file, without simulating.
+
+    data: path of a file of jamfree.TrajectoryRecorder, and speed, seconds
+    of the recording by second. The client then gets the 'vehicle_frame'
+    messages of a live network, and 'replay_status' ones with the time.
+    """
+    if not JAMFREE_AVAILABLE:
+        emit('error', {'message': 'JamFree not available'})
+        return
+    try:
+        replay = jamfree.TrajectoryReplay(str(data['path']))
+        replay.speed = float(data.get('speed', 1.0))
+    except Exception as e:
+        emit('error', {'message': f'Cannot replay: {e}'})
+        return
+    frame_stream['replay'] = replay
+    frame_stream['replay_bounds'] = replay_frame_bounds(replay)
+    # The encoders of the network do not fit the frames of the replay
+    frame_stream['encoder'] = None
+    for client in frame_stream['viewports'].values():
+        client['encoder'] = make_frame_encoder()
+        client['detailed'] = False
+    ensure_frame_stream(data)
+    frame_stream['encoder'].request_key_frame()
+    if request.sid not in frame_stream['viewports']:
+        frame_stream['clients'].add(request.sid)
+    emit('status', {'replay': True, 'start_time': replay.start_time,
+                    'end_time': replay.end_time})
+
+@socketio.on('replay_control', namespace='/simulation')
+def handle_replay_control(data):
+    """Seek a time of the replay, or change its speed (0 pauses)."""
+    replay = frame_stream['replay']
+    if replay is None:
+        emit('error', {'message': 'No replay'})
+        return
+    try:
+        if 'speed' in data:
+            replay.speed = float(data['speed'])
+        if 'seek' in data:
+            replay.seek(float(data['seek']))
+    except Exception as e:
+        emit('error', {'message': str(e)})
+        return
+    emit('status', {'replay': True, 'time': replay.time,
+                    'speed': replay.speed})
+
+@socketio.on('stop_replay', namespace='/simulation')
+def handle_stop_replay():
+    """Stop the replay, the stream going back to the live network, if any."""
+    frame_stream['replay'] = None
+    frame_stream['encoder'] = None
+    if simulation_state['network'] is not None:
+        frame_stream['encoder'] = make_frame_encoder()
+        for client in frame_stream['viewports'].values():
+            client['encoder'] = make_frame_encoder()
+            client['detailed'] = False
+    else:
+        frame_stream['clients'].clear()
+        frame_stream['viewports'].clear()
+    unsubscribe_frames(request.sid)
+    frame_stream['running'] = (frame_stream['running'] and
+                               frame_stream['encoder'] is not None)
+    emit('status', {'replay': False})
+
+def unsubscribe_frames(sid):
+    """Stop streaming frames to a client."""
+    frame_stream['clients'].discard(sid)
+    frame_stream['viewports'].pop(sid, None)
+    if not frame_stream['clients'] and not frame_stream['viewports']:
+        frame_stream['running'] = False
+
+@socketio.on('stop_frame_stream', namespace='/simulation')
+def handle_stop_frame_stream():
+    """Stop pushing binary vehicle frames."""
+    unsubscribe_frames(request.sid)
+    emit('status', {'frame_stream': False})
+
 # Keep existing REST endpoints for backwards compatibility
 
 if __name__ == '__main__':
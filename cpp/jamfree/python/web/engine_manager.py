@@ -69,6 +69,8 @@ class SimulationEngineManager:
         self.current_time = jamfree.SimulationTimeStamp(0)
         self.final_time = jamfree.SimulationTimeStamp(10000)  # Default: 1000 seconds at 0.1s steps
         self.probe = None
+        # Telemetry of the steps of the engine, kept across restarts
+        self.metrics = jamfree.SimulationMetrics()
         
         # Calculate network center for coordinate conversion
         self.center_lat = (network.min_lat + network.max_lat) / 2.0
@@ -161,6 +163,7 @@ class SimulationEngineManager:
             # Create SimulationEngine (JamFree Kernel)
             # We use the sequential engine for now to support step-by-step execution
             self.engine = jamfree.SimulationEngine(0.1)  # dt = 0.1s
+            self.engine.set_step_timing_listener(self.metrics)
             
             # Create Microscopic Reaction Model
             reaction_model = jamfree.MicroscopicReactionModel(0.1)
@@ -185,14 +188,17 @@ class SimulationEngineManager:
             
             # Create some test vehicles
             num_vehicles = self.config.get('num_vehicles', 10)
+            vehicle_config = self.config.copy()
+            agents = []
             for i in range(num_vehicles):
                 vehicle_id = f"veh_{i}"
-                vehicle_config = self.config.copy()
                 vehicle_config['initial_position'] = i * 20.0  # Space them out
-                
-                agent = self.create_vehicle_agent(vehicle_id, first_lane, vehicle_config)
-                self.engine.add_agent(agent)
-                self.vehicles.append(agent)
+                agents.append(
+                    self.create_vehicle_agent(vehicle_id, first_lane, vehicle_config))
+
+            # One call registers them all, reserving the engine's tables once
+            self.engine.add_agents(agents)
+            self.vehicles.extend(agents)
             
             # Create visualization probe
             self.probe = VisualizationProbe(self.center_lat, self.center_lon)
@@ -0,0 +1,160 @@
+"""
+Telemetry of the simulation for monitoring systems such as Prometheus.
+
+The steps of the web UI run in Python, so their counters live here; the
+memory of the C++ subsystems comes from jamfree.memory_usage(). The page
+follows the OpenMetrics format when the scraper accepts it, and the text
+format of Prometheus otherwise, as the /metrics page of SimilarHttpServer.
+"""
+
+import bisect
+import threading
+import time
+
+# The upper bounds of the buckets of the step durations, in seconds, as in
+# the C++ SimulationMetrics
+BUCKET_BOUNDS = (1e-5, 2.5e-5, 5e-5, 1e-4, 2.5e-4, 5e-4, 1e-3, 2.5e-3, 5e-3,
+                 1e-2, 2.5e-2, 5e-2, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0)
+
+OPEN_METRICS_TYPE = 'application/openmetrics-text; version=1.0.0; charset=utf-8'
+PROMETHEUS_TYPE = 'text/plain; version=0.0.4; charset=utf-8'
+
+# The weight of the last period in the smoothed one
+PERIOD_SMOOTHING = 0.2
+
+
+class StepMetrics:
+    """Counters of the steps, updated by the thread running them."""
+
+    def __init__(self):
+        self._lock = threading.Lock()
+        self._queues = {}
+        self.reset()
+
+    def reset(self):
+        """Start the counters and the histogram again from 0."""
+        with self._lock:
+            self.steps = 0
+            self.vehicles = 0
+            self.micro_lanes = 0
+            self.macro_lanes = 0
+            self._buckets = [0] * (len(BUCKET_BOUNDS) + 1)
+            self._sum = 0.0
+            self._last_end = None
+            self._mean_period = 0.0
+
+    def observe(self, seconds, vehicles, micro_lanes=0, macro_lanes=0):
+        """Count a step lasting a number of seconds."""
+        now = time.monotonic()
+        with self._lock:
+            self._buckets[bisect.bisect_left(BUCKET_BOUNDS, seconds)] += 1
+            self._sum += seconds
+            self.steps += 1
+            self.vehicles = vehicles
+            self.micro_lanes = micro_lanes
+            self.macro_lanes = macro_lanes
+            if self._last_end is not None:
+                period = now - self._last_end
+                self._mean_period = (
+                    period if self._mean_period == 0 else
+                    self._mean_period +
+                    PERIOD_SMOOTHING * (period - self._mean_period))
+            self._last_end = now
+
+    def add_queue(self, name, depth):
+        """Export the depth of a queue, depth() being called at scrapes."""
+        with self._lock:
+            self._queues[name] = depth
+
+    def remove_queue(self, name):
+        with self._lock:
+            self._queues.pop(name, None)
+
+    def steps_per_second(self):
+        """Steps per second, smoothed; 0 once the steps stopped."""
+        with self._lock:
+            period, last = self._mean_period, self._last_end
+        if period <= 0 or time.monotonic() - last > max(4 * period, 1.0):
+            return 0.0
+        return 1.0 / period
+
+    def to_text(self, open_metrics=True, memory_usage=None):
+        """
+        Get the page of the metrics.
+
+        Args:
+            open_metrics: True for OpenMetrics, False for the text format
+                of Prometheus
+            memory_usage: The MemoryUsage of the subsystems, if any
+        """
+        rate = self.steps_per_second()
+        with self._lock:
+            steps = self.steps
+            buckets = list(self._buckets)
+            total = self._sum
+            gauges = (('jamfree_vehicles', 'Vehicles simulated.',
+                       self.vehicles),
+                      ('jamfree_micro_lanes',
+                       'Lanes simulated vehicle by vehicle.',
+                       self.micro_lanes),
+                      ('jamfree_macro_lanes',
+                       'Lanes simulated as flows.', self.macro_lanes))
+            queues = list(self._queues.items())
+
+        lines = []
+
+        def family(name, kind, help_text):
+            if not open_metrics and kind == 'counter':
+                name += '_total'
+            lines.append(f'# HELP {name} {help_text}')
+            lines.append(f'# TYPE {name} {kind}')
+
+        family('jamfree_steps', 'counter', 'Steps run.')
+        lines.append(f'jamfree_steps_total {steps}')
+        family('jamfree_steps_per_second', 'gauge',
+               'Steps per second, smoothed over the last steps.')
+        lines.append(f'jamfree_steps_per_second {rate!r}')
+        family('jamfree_step_seconds', 'histogram', 'Duration of the steps.')
+        count = 0
+        for bound, bucket in zip(BUCKET_BOUNDS + ('+Inf',), buckets):
+            count += bucket
+            lines.append(f'jamfree_step_seconds_bucket{{le="{bound}"}} '
+                         f'{count}')
+        lines.append(f'jamfree_step_seconds_sum {total!r}')
+        lines.append(f'jamfree_step_seconds_count {count}')
+        for name, help_text, value in gauges:
+            family(name, 'gauge', help_text)
+            lines.append(f'{name} {value}')
+        if queues:
+            family('jamfree_queue_depth', 'gauge',
+                   'Items waiting in the queues.')
+            for name, depth in queues:
+                lines.append(f'jamfree_queue_depth{{queue="{_label(name)}"}} '
+                             f'{depth()}')
+        if memory_usage:
+            family('jamfree_memory_live_bytes', 'gauge',
+                   'Bytes allocated and not released by a subsystem.')
+            for usage in memory_usage:
+                lines.append('jamfree_memory_live_bytes{subsystem="'
+                             f'{_label(usage.subsystem)}"}} '
+                             f'{usage.live_bytes}')
+            family('jamfree_memory_peak_bytes', 'gauge',
+                   'Most live bytes of a subsystem.')
+            for usage in memory_usage:
+                lines.append('jamfree_memory_peak_bytes{subsystem="'
+                             f'{_label(usage.subsystem)}"}} '
+                             f'{usage.peak_bytes}')
+        if open_metrics:
+            lines.append('# EOF')
+        return '\n'.join(lines) + '\n'
+
+
+def _label(value):
+    """Escape a label value."""
+    return (value.replace('\\', '\\\\').replace('"', '\\"')
+            .replace('\n', '\\n'))
+
+
+def accepts_open_metrics(accept_header):
+    """Tell whether a scraper accepts the OpenMetrics format."""
+    return 'application/openmetrics-text' in (accept_header or '')
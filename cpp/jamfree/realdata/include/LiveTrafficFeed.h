@@ -0,0 +1,179 @@
+#ifndef JAMFREE_REALDATA_LIVE_TRAFFIC_FEED_H
+#define JAMFREE_REALDATA_LIVE_TRAFFIC_FEED_H
+
+#include "../../kernel/include/tools/TripleBuffer.h"
+#include "TrafficDataSource.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace jamfree {
+namespace realdata {
+
+/**
+ * @brief Fetches live traffic speeds on a thread of its own, for the
+ * simulation to read without waiting for the network.
+ *
+ * The areas of interest are cut into the tiles of a grid, and the runs of
+ * tiles along a row are merged into the boxes requested: overlapping areas
+ * cost one request. Each refresh asks the source for the speeds of every
+ * box, falling back on the fallback source, e.g. an EstimatedDataSource,
+ * for the boxes the source fails or is unavailable for. The speeds are kept
+ * by road id and dropped once older than their time to live, and the cache
+ * is published after each refresh into a triple buffer that the simulation
+ * takes by updateSnapshot(), lock-free, at the start of its steps.
+ */
+class LiveTrafficFeed {
+public:
+  using Speeds = std::unordered_map<std::string, TrafficSpeedData>;
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * @brief Refresh parameters.
+   */
+  struct Config {
+    /// Wall-clock time between the starts of two refreshes (ms)
+    double refresh_period_ms = 60000.0;
+    /// Age beyond which the speed of a road is dropped (ms)
+    double ttl_ms = 300000.0;
+    /// Side of the tiles the areas are cut into (m)
+    double tile_size = 2000.0;
+
+    Config() = default;
+  };
+
+  /**
+   * @param source Source of the live speeds, or nullptr for the fallback
+   *               only
+   * @param fallback Source of the boxes the source fails for, or nullptr
+   * @throws std::invalid_argument If neither source is given
+   */
+  LiveTrafficFeed(std::shared_ptr<TrafficDataSource> source,
+                  std::shared_ptr<TrafficDataSource> fallback);
+
+  /**
+   * @param config Refresh parameters
+   * @throws std::invalid_argument If neither source is given, or a period,
+   *         time to live or tile size is not positive
+   */
+  LiveTrafficFeed(std::shared_ptr<TrafficDataSource> source,
+                  std::shared_ptr<TrafficDataSource> fallback,
+                  const Config &config);
+
+  /**
+   * @brief Destructor, stopping the background thread.
+   */
+  ~LiveTrafficFeed();
+
+  LiveTrafficFeed(const LiveTrafficFeed &) = delete;
+  LiveTrafficFeed &operator=(const LiveTrafficFeed &) = delete;
+
+  /**
+   * @brief Add an area whose roads are to be fetched, in network meters.
+   *
+   * @throws std::logic_error If the background thread runs
+   */
+  void addArea(const kernel::model::Point2D &min_point,
+               const kernel::model::Point2D &max_point);
+
+  /**
+   * @brief Get the boxes each refresh requests, in the order of the rows.
+   */
+  const std::vector<std::pair<kernel::model::Point2D, kernel::model::Point2D>>
+      &getBoxes() const {
+    return m_boxes;
+  }
+
+  /**
+   * @brief Refresh once in the calling thread, then publish the cache.
+   *
+   * @throws std::logic_error If the background thread runs
+   */
+  void refresh();
+
+  /**
+   * @brief Refresh every refresh_period_ms on a background thread, the
+   * first time at once, until stop().
+   *
+   * @throws std::logic_error If the background thread runs already
+   */
+  void start();
+
+  /**
+   * @brief Stop the background thread, after its current refresh.
+   */
+  void stop();
+
+  bool isRunning() const { return m_thread.joinable(); }
+
+  /**
+   * @brief Take the speeds of the last refresh, if any since the last
+   * call.
+   *
+   * To be called by one reader thread only, e.g. once per step.
+   * @return True if getSnapshot() changed
+   */
+  bool updateSnapshot() { return m_snapshots.update(); }
+
+  /**
+   * @brief Get the speeds the last updateSnapshot() took, by road id.
+   */
+  const Speeds &getSnapshot() const { return m_snapshots.front(); }
+
+  /** @brief Number of refreshes done. */
+  std::size_t getNumRefreshes() const {
+    return m_num_refreshes.load(std::memory_order_relaxed);
+  }
+
+  /** @brief Number of box requests served by the fallback, or by none. */
+  std::size_t getNumFallbacks() const {
+    return m_num_fallbacks.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Entry {
+    TrafficSpeedData data;
+    Clock::time_point fetched;
+    bool live; // From the source rather than the fallback
+  };
+
+  std::shared_ptr<TrafficDataSource> m_source;
+  std::shared_ptr<TrafficDataSource> m_fallback;
+  Config m_config;
+
+  // The tiles of the areas, as (row, column), and the boxes merging them
+  std::vector<std::pair<long long, long long>> m_tiles;
+  std::vector<std::pair<kernel::model::Point2D, kernel::model::Point2D>>
+      m_boxes;
+
+  // Only touched by the refreshing thread
+  std::unordered_map<std::string, Entry> m_cache;
+  kernel::tools::TripleBuffer<Speeds> m_snapshots;
+
+  std::thread m_thread;
+  std::mutex m_mutex; // Of the wake-up of the thread
+  std::condition_variable m_wake;
+  bool m_stop = false;
+  std::atomic<std::size_t> m_num_refreshes{0};
+  std::atomic<std::size_t> m_num_fallbacks{0};
+
+  void refreshAt(Clock::time_point now);
+  bool fetch(TrafficDataSource &source, bool live,
+             const std::pair<kernel::model::Point2D, kernel::model::Point2D>
+                 &box,
+             Clock::time_point now);
+  void runBackground();
+};
+
+} // namespace realdata
+} // namespace jamfree
+
+#endif // JAMFREE_REALDATA_LIVE_TRAFFIC_FEED_H
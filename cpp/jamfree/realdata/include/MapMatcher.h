@@ -0,0 +1,66 @@
+#ifndef JAMFREE_REALDATA_MAP_MATCHER_H
+#define JAMFREE_REALDATA_MAP_MATCHER_H
+
+#include "../../kernel/include/model/RoadIndex.h"
+#include "TrafficDataSource.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace jamfree {
+namespace realdata {
+
+/**
+ * @brief Matches located observations to the roads of a network.
+ *
+ * Each observation goes to the closest segment of the R-tree of the roads
+ * (see RoadIndex::nearest()), so that a batch costs a logarithmic search
+ * per observation rather than a scan of the network. The index is only
+ * read: several matchers may share it across threads.
+ */
+class MapMatcher {
+public:
+  /**
+   * @param index Index of the roads, outliving the matcher
+   * @param max_distance Distance beyond which an observation matches no
+   *                     road (m)
+   * @throws std::invalid_argument If max_distance is negative
+   */
+  explicit MapMatcher(const kernel::model::RoadIndex &index,
+                      double max_distance = 25.0);
+
+  /**
+   * @brief Match a location to the closest road within max_distance.
+   */
+  bool match(const kernel::model::Point2D &location,
+             kernel::model::RoadIndex::Match &match) const {
+    return m_index.nearest(location, match, m_max_distance);
+  }
+
+  /**
+   * @brief Aggregate observations into the speed data of their roads.
+   *
+   * The speed of a road is the mean of the observations matched to it,
+   * with the time and source of the last one; its free-flow speed is the
+   * speed limit of its first lane. The unmatched observations are
+   * dropped.
+   *
+   * @param observations Observations, in the order they were made
+   * @param unmatched Set to the number of observations dropped, if given
+   * @return Map of road_id -> speed data
+   */
+  std::unordered_map<std::string, TrafficSpeedData>
+  matchSpeeds(const std::vector<SpeedObservation> &observations,
+              std::size_t *unmatched = nullptr) const;
+
+  double getMaxDistance() const { return m_max_distance; }
+
+private:
+  const kernel::model::RoadIndex &m_index;
+  double m_max_distance;
+};
+
+} // namespace realdata
+} // namespace jamfree
+
+#endif // JAMFREE_REALDATA_MAP_MATCHER_H
@@ -0,0 +1,120 @@
+#ifndef JAMFREE_REALDATA_NETWORK_CACHE_H
+#define JAMFREE_REALDATA_NETWORK_CACHE_H
+
+#include "OSMParser.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace jamfree {
+namespace realdata {
+namespace osm {
+
+/**
+ * @brief Binary cache of the road network parsed from an OSM file.
+ *
+ * Keeps what OSMParser produces — the bounding box, the nodes, the ways and
+ * the roads with their geometry, lanes and speed limits — as consecutive
+ * arrays of little-endian records, so that a network is restored from a
+ * mapped file without parsing OSM again nor creating the roads from the
+ * ways. A cache records the size and the hash of the file it comes from,
+ * and of the OSM change files applied to it since, and is ignored once one
+ * of these files changes.
+ */
+class NetworkCache {
+public:
+  /**
+   * @brief Version of the format, increased when it changes
+   */
+  static constexpr std::uint32_t FORMAT_VERSION = 2;
+
+  /**
+   * @brief Write the cache of a network.
+   *
+   * The cache is written to a temporary file renamed once complete.
+   *
+   * @param network Network parsed from the source file
+   * @param source_filename Path to the OSM file of the network
+   * @param cache_filename Path to the cache
+   * @throws std::runtime_error If a file cannot be read or written
+   */
+  static void save(const RoadNetwork &network,
+                   const std::string &source_filename,
+                   const std::string &cache_filename);
+
+  /**
+   * @brief Write the cache of a network updated by OSM change files.
+   *
+   * @param network Network parsed from the source file, then changed
+   * @param source_filename Path to the OSM file of the network
+   * @param change_filenames Paths to the change files applied, in order
+   * @param cache_filename Path to the cache
+   * @throws std::runtime_error If a file cannot be read or written
+   */
+  static void save(const RoadNetwork &network,
+                   const std::string &source_filename,
+                   const std::vector<std::string> &change_filenames,
+                   const std::string &cache_filename);
+
+  /**
+   * @brief Read the cache of a network.
+   *
+   * @param cache_filename Path to the cache
+   * @param source_filename Path to the OSM file of the network
+   * @param network Set to the cached network
+   * @return False if the cache is missing, damaged, of another version or
+   *         of another content of the source file, or if changes were
+   *         applied to it
+   */
+  static bool load(const std::string &cache_filename,
+                   const std::string &source_filename, RoadNetwork &network);
+
+  /**
+   * @brief Read the cache of a network, parsing and caching it if needed.
+   *
+   * @param source_filename Path to the OSM file
+   * @param cache_filename Path to the cache
+   * @return Parsed road network
+   * @throws std::runtime_error If the source file cannot be parsed; a cache
+   *         that cannot be written is only skipped
+   */
+  static RoadNetwork loadOrParse(const std::string &source_filename,
+                                 const std::string &cache_filename);
+
+  /**
+   * @brief Read the cache of a network updated by OSM change files,
+   * applying the changes it lacks.
+   *
+   * A cache of the source with the first changes only, e.g. of the day
+   * before, gets the others with OSMParser::applyChange(), which rebuilds
+   * the changed roads only; the network is parsed again only if there is
+   * no such cache. The updated network is cached in turn.
+   *
+   * @param source_filename Path to the OSM file
+   * @param change_filenames Paths to the .osc files of the source, in order
+   * @param cache_filename Path to the cache
+   * @return Parsed and changed road network
+   * @throws std::runtime_error If a file cannot be parsed; a cache that
+   *         cannot be written is only skipped
+   */
+  static RoadNetwork
+  loadOrParse(const std::string &source_filename,
+              const std::vector<std::string> &change_filenames,
+              const std::string &cache_filename);
+
+  /**
+   * @brief Hash the content of a file, the source files being recognized by
+   * their size and hash.
+   *
+   * @param filename Path to the file
+   * @return 64-bit hash
+   * @throws std::runtime_error If the file cannot be read
+   */
+  static std::uint64_t hashFile(const std::string &filename);
+};
+
+} // namespace osm
+} // namespace realdata
+} // namespace jamfree
+
+#endif // JAMFREE_REALDATA_NETWORK_CACHE_H
@@ -4,9 +4,13 @@
 #include "../../kernel/include/model/Lane.h"
 #include "../../kernel/include/model/Point2D.h"
 #include "../../kernel/include/model/Road.h"
+#include "../../kernel/include/model/RoadIndex.h"
+#include <cstddef>
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace jamfree {
@@ -43,17 +47,61 @@ struct OSMWay {
  * @brief Road network extracted from OSM data
  */
 struct RoadNetwork {
-  std::map<long long, OSMNode> nodes;
+  std::map<long long, OSMNode> nodes; // The nodes of the ways
   std::vector<OSMWay> ways;
   std::vector<std::shared_ptr<kernel::model::Road>> roads;
 
+  // The segments of the roads, for map matching
+  kernel::model::RoadIndex road_index;
+
   // Bounding box
   double min_lat, max_lat;
   double min_lon, max_lon;
+
+  /**
+   * @brief Index the roads again, after they changed.
+   */
+  void indexRoads() { road_index.build(roads); }
+};
+
+/**
+ * @brief Changes of an OSM change file (.osc) to an extract
+ *
+ * The nodes and ways created or modified, with their new content, and the
+ * identifiers of the ones deleted, in the order of the file.
+ */
+struct OSMChange {
+  std::vector<OSMNode> nodes;
+  std::vector<OSMWay> ways;
+  std::vector<long long> deleted_nodes;
+  std::vector<long long> deleted_ways;
+};
+
+/**
+ * @brief Roads of a network replaced by OSMParser::applyChange()
+ *
+ * The removed roads are kept alive here, so that the structures built on
+ * them, e.g. a routing graph, can be patched before they are released.
+ */
+struct NetworkPatch {
+  std::vector<std::shared_ptr<kernel::model::Road>> removed_roads;
+  std::vector<std::shared_ptr<kernel::model::Road>> added_roads;
 };
 
+class NodeCoordinates;
+class RoadFilter;
+
 /**
- * @brief Parser for OpenStreetMap XML files
+ * @brief Parser for OpenStreetMap XML and PBF files
+ *
+ * Streams the document with an OSMPullParser, a file being mapped rather
+ * than read: the coordinates of the nodes go to a flat NodeCoordinates
+ * table and the roads are kept as their ways are reached, so that the
+ * memory used grows with the nodes and the roads, not with the file.
+ *
+ * PBF files are decoded a batch of blocks at a time, the blocks of a batch
+ * in parallel; a RoadFilter is applied as the ways are decoded, so that
+ * the rejected ones are never kept.
  */
 class OSMParser {
 public:
@@ -65,6 +113,39 @@ public:
    */
   static RoadNetwork parseFile(const std::string &filename);
 
+  /**
+   * @brief Parse OSM XML or PBF file, keeping the roads a filter accepts
+   *
+   * Files whose name ends with ".pbf" are read as OSM PBF, the others as
+   * OSM XML.
+   *
+   * @param filename Path to .osm or .osm.pbf file
+   * @param filter Filter of the roads, or nullptr to keep them all
+   * @param num_threads Threads decoding PBF blocks, 0 for one per core
+   * @return Parsed road network
+   */
+  static RoadNetwork parseFile(const std::string &filename,
+                               const RoadFilter *filter,
+                               std::size_t num_threads = 0);
+
+  /**
+   * @brief Parse OSM PBF content
+   *
+   * Supports the raw and zlib compressed blobs, the latter only when built
+   * with zlib (JAMFREE_HAS_ZLIB).
+   *
+   * @param data OSM PBF content
+   * @param size Content size (bytes)
+   * @param filter Filter of the roads, or nullptr to keep them all
+   * @param num_threads Threads decoding the blocks, 0 for one per core
+   * @return Parsed road network
+   * @throws std::runtime_error If the content is malformed or uses an
+   *         unsupported feature or compression
+   */
+  static RoadNetwork parsePbf(const std::uint8_t *data, std::size_t size,
+                              const RoadFilter *filter = nullptr,
+                              std::size_t num_threads = 0);
+
   /**
    * @brief Parse OSM XML string
    *
@@ -73,6 +154,44 @@ public:
    */
   static RoadNetwork parseString(const std::string &xml_content);
 
+  /**
+   * @brief Parse an OSM change file (.osc)
+   *
+   * @param filename Path to .osc file
+   * @return Changes of the file
+   * @throws std::runtime_error If the file cannot be read or is malformed
+   */
+  static OSMChange parseChangeFile(const std::string &filename);
+
+  /**
+   * @brief Parse OSM change XML
+   *
+   * @param xml_content osmChange XML content
+   * @return Changes of the content
+   * @throws std::runtime_error If the content is malformed
+   */
+  static OSMChange parseChange(std::string_view xml_content);
+
+  /**
+   * @brief Apply the changes of an OSM change file to a network
+   *
+   * Only the roads of the ways changed, deleted or using a node changed
+   * are built again, the others being kept as they are; the road index is
+   * patched the same way. The bounding box, and so the projection of the
+   * coordinates, stays the one of the network, so that the kept roads do
+   * not move. The ways created or modified may only use the nodes of the
+   * network and of the change, the other nodes of the extract being
+   * unknown to the network.
+   *
+   * @param network Network to update
+   * @param change Changes, e.g. of the daily diff of the extract
+   * @param filter Filter of the roads, or nullptr to keep them all
+   * @return Roads removed and added
+   */
+  static NetworkPatch applyChange(RoadNetwork &network,
+                                  const OSMChange &change,
+                                  const RoadFilter *filter = nullptr);
+
   /**
    * @brief Convert lat/lon to local coordinates
    *
@@ -120,10 +239,14 @@ public:
                                      const std::string &country = "FR");
 
 private:
-  static void parseNodes(const std::string &xml, RoadNetwork &network);
-  static void parseWays(const std::string &xml, RoadNetwork &network);
+  static RoadNetwork parse(std::string_view xml, const RoadFilter *filter);
   static void extractWayAttributes(OSMWay &way);
+  static bool acceptWay(OSMWay &way, const RoadFilter *filter);
+  static void finishNetwork(RoadNetwork &network,
+                            const NodeCoordinates &coordinates);
   static void createRoads(RoadNetwork &network);
+  static std::shared_ptr<kernel::model::Road>
+  createRoad(const OSMWay &way, const RoadNetwork &network);
 };
 
 /**
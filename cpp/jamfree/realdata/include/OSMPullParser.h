@@ -0,0 +1,175 @@
+#ifndef JAMFREE_REALDATA_OSM_PULL_PARSER_H
+#define JAMFREE_REALDATA_OSM_PULL_PARSER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace jamfree {
+namespace realdata {
+namespace osm {
+
+/**
+ * @brief Pull parser of OSM XML.
+ *
+ * Walks the elements of an OSM document in place, without building a tree
+ * or copying the text: next() stops at the start tag of each node, way, nd
+ * and tag element and at the end tag of each node and way, whose
+ * attributes are then read with attribute(); in an OSM change file it also
+ * stops at the start tag of each create, modify and delete section. The
+ * other elements, the comments and the declarations are skipped. The content, e.g. a mapped
+ * file, must outlive the parser.
+ */
+class OSMPullParser {
+public:
+  /**
+   * @brief Element reached by next().
+   */
+  enum class Event {
+    NODE,     ///< <node> start tag
+    WAY,      ///< <way> start tag
+    ND,       ///< <nd> start tag
+    TAG,      ///< <tag> start tag
+    END_NODE, ///< </node> end tag
+    END_WAY,  ///< </way> end tag
+    CREATE,   ///< <create> start tag, of an osmChange document
+    MODIFY,   ///< <modify> start tag, of an osmChange document
+    DELETE,   ///< <delete> start tag, of an osmChange document
+    END       ///< End of the document
+  };
+
+  /**
+   * @brief Constructor.
+   * @param xml OSM XML content
+   */
+  explicit OSMPullParser(std::string_view xml) : m_xml(xml) {}
+
+  /**
+   * @brief Advance to the next element of interest.
+   *
+   * @return The element reached
+   * @throws std::runtime_error If a tag is not closed
+   */
+  Event next();
+
+  /**
+   * @brief Get an attribute of the start tag reached, still escaped.
+   *
+   * @param name Attribute name
+   * @return Raw value, empty if the tag has no such attribute
+   */
+  std::string_view attribute(std::string_view name) const;
+
+  /**
+   * @brief Check if the start tag reached closes itself, as <node .../>.
+   */
+  bool isEmptyElement() const { return m_empty; }
+
+  /**
+   * @brief Replace the character and entity references of a value.
+   *
+   * @param value Raw attribute value
+   * @return Unescaped value
+   */
+  static std::string decode(std::string_view value);
+
+  /**
+   * @brief Parse the integer at the start of a text.
+   *
+   * @param text Text, e.g. "2;3" for 2
+   * @param value Parsed value
+   * @return True if the text starts with an integer
+   */
+  static bool parseInteger(std::string_view text, long long &value);
+
+  /**
+   * @brief Parse the decimal number at the start of a text.
+   *
+   * @param text Text, e.g. "50 mph" for 50
+   * @param value Parsed value
+   * @param rest Set to the characters after the number, if not null
+   * @return True if the text starts with a number
+   */
+  static bool parseDouble(std::string_view text, double &value,
+                          std::string_view *rest = nullptr);
+
+private:
+  std::string_view m_xml;
+  std::size_t m_pos = 0;
+  bool m_empty = false;
+  // Names and values of the attributes of the start tag reached
+  std::vector<std::pair<std::string_view, std::string_view>> m_attributes;
+
+  /**
+   * @brief Read the attributes of a start tag up to its end.
+   * @param pos Position after the element name
+   * @return Position after the tag
+   */
+  std::size_t readAttributes(std::size_t pos);
+};
+
+/**
+ * @brief Coordinates of OSM nodes by identifier.
+ *
+ * Flat open-addressing hash table of 16 byte slots, the coordinates being
+ * kept in 1e-7 degrees as OSM stores them, so that the nodes of a regional
+ * extract fit in bounded memory. Coordinates given with at most 7 decimals
+ * are restored exactly.
+ */
+class NodeCoordinates {
+public:
+  /**
+   * @brief Add a node, replacing the coordinates of a known one.
+   *
+   * @param id Node identifier
+   * @param lat Latitude (degrees)
+   * @param lon Longitude (degrees)
+   */
+  void insert(long long id, double lat, double lon);
+
+  /**
+   * @brief Add a node given in 1e-7 degrees, as OSM PBF decodes them.
+   *
+   * @param id Node identifier
+   * @param lat Latitude (1e-7 degrees)
+   * @param lon Longitude (1e-7 degrees)
+   */
+  void insertFixed(long long id, std::int32_t lat, std::int32_t lon);
+
+  /**
+   * @brief Find the coordinates of a node.
+   *
+   * @param id Node identifier
+   * @param lat Set to the latitude (degrees)
+   * @param lon Set to the longitude (degrees)
+   * @return True if the node is known
+   */
+  bool find(long long id, double &lat, double &lon) const;
+
+  /**
+   * @brief Get number of nodes.
+   */
+  std::size_t size() const { return m_size; }
+
+private:
+  struct Slot {
+    long long id;
+    std::int32_t lat; // 1e-7 degrees
+    std::int32_t lon; // 1e-7 degrees
+  };
+
+  std::vector<Slot> m_slots;
+  std::size_t m_size = 0;
+
+  std::size_t slotOf(long long id) const;
+  void grow();
+};
+
+} // namespace osm
+} // namespace realdata
+} // namespace jamfree
+
+#endif // JAMFREE_REALDATA_OSM_PULL_PARSER_H
@@ -1,7 +1,7 @@
 #ifndef JAMFREE_REALDATA_TRAFFIC_DATA_SOURCE_H
 #define JAMFREE_REALDATA_TRAFFIC_DATA_SOURCE_H
 
-#include "../kernel/include/model/Point2D.h"
+#include "../../kernel/include/model/Point2D.h"
 #include <chrono>
 #include <memory>
 #include <string>
@@ -65,6 +65,17 @@ struct TrafficSpeedData {
   std::string source; // "google", "tomtom", "here", "estimated"
 };
 
+/**
+ * @brief A speed measured at a location, e.g. by a GPS probe, not yet
+ * matched to a road (see MapMatcher).
+ */
+struct SpeedObservation {
+  kernel::model::Point2D location; // Network meters
+  double speed_kmh;
+  DateTime timestamp;
+  std::string source;
+};
+
 /**
  * @brief Traffic incident data.
  */
@@ -0,0 +1,180 @@
+#include "../include/LiveTrafficFeed.h"
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <stdexcept>
+
+namespace jamfree {
+namespace realdata {
+
+using kernel::model::Point2D;
+
+LiveTrafficFeed::LiveTrafficFeed(std::shared_ptr<TrafficDataSource> source,
+                                 std::shared_ptr<TrafficDataSource> fallback)
+    : LiveTrafficFeed(std::move(source), std::move(fallback), Config()) {}
+
+LiveTrafficFeed::LiveTrafficFeed(std::shared_ptr<TrafficDataSource> source,
+                                 std::shared_ptr<TrafficDataSource> fallback,
+                                 const Config &config)
+    : m_source(std::move(source)), m_fallback(std::move(fallback)),
+      m_config(config) {
+  if (!m_source && !m_fallback) {
+    throw std::invalid_argument("Live traffic feed: a source is required");
+  }
+  if (!(config.refresh_period_ms > 0.0) || !(config.ttl_ms > 0.0) ||
+      !(config.tile_size > 0.0)) {
+    throw std::invalid_argument(
+        "Live traffic feed: the period, time to live and tile size must be "
+        "positive");
+  }
+}
+
+LiveTrafficFeed::~LiveTrafficFeed() { stop(); }
+
+void LiveTrafficFeed::addArea(const Point2D &min_point,
+                              const Point2D &max_point) {
+  if (isRunning()) {
+    throw std::logic_error("Live traffic feed: the background thread runs");
+  }
+  const double size = m_config.tile_size;
+  const long long first_column =
+      static_cast<long long>(std::floor(std::min(min_point.x, max_point.x) /
+                                        size));
+  const long long last_column =
+      static_cast<long long>(std::floor(std::max(min_point.x, max_point.x) /
+                                        size));
+  const long long first_row =
+      static_cast<long long>(std::floor(std::min(min_point.y, max_point.y) /
+                                        size));
+  const long long last_row =
+      static_cast<long long>(std::floor(std::max(min_point.y, max_point.y) /
+                                        size));
+  for (long long row = first_row; row <= last_row; ++row) {
+    for (long long column = first_column; column <= last_column; ++column) {
+      m_tiles.emplace_back(row, column);
+    }
+  }
+  std::sort(m_tiles.begin(), m_tiles.end());
+  m_tiles.erase(std::unique(m_tiles.begin(), m_tiles.end()), m_tiles.end());
+
+  // A box per run of tiles along a row
+  m_boxes.clear();
+  for (std::size_t begin = 0; begin < m_tiles.size();) {
+    std::size_t end = begin + 1;
+    while (end < m_tiles.size() &&
+           m_tiles[end].first == m_tiles[begin].first &&
+           m_tiles[end].second == m_tiles[end - 1].second + 1) {
+      ++end;
+    }
+    const double row = static_cast<double>(m_tiles[begin].first);
+    m_boxes.emplace_back(
+        Point2D(static_cast<double>(m_tiles[begin].second) * size,
+                row * size),
+        Point2D(static_cast<double>(m_tiles[end - 1].second + 1) * size,
+                (row + 1.0) * size));
+    begin = end;
+  }
+}
+
+void LiveTrafficFeed::refresh() {
+  if (isRunning()) {
+    throw std::logic_error("Live traffic feed: the background thread runs");
+  }
+  refreshAt(Clock::now());
+}
+
+void LiveTrafficFeed::start() {
+  if (isRunning()) {
+    throw std::logic_error("Live traffic feed: the background thread runs");
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = false;
+  }
+  m_thread = std::thread(&LiveTrafficFeed::runBackground, this);
+}
+
+void LiveTrafficFeed::stop() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
+
+void LiveTrafficFeed::runBackground() {
+  const auto period = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double, std::milli>(m_config.refresh_period_ms));
+  Clock::time_point next = Clock::now();
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (!m_stop) {
+    lock.unlock();
+    refreshAt(Clock::now());
+    lock.lock();
+    next += period;
+    m_wake.wait_until(lock, next, [this] { return m_stop; });
+  }
+}
+
+bool LiveTrafficFeed::fetch(TrafficDataSource &source, bool live,
+                            const std::pair<Point2D, Point2D> &box,
+                            Clock::time_point now) {
+  Speeds speeds;
+  try {
+    if (!source.isAvailable()) {
+      return false;
+    }
+    speeds = source.getTrafficSpeeds(box.first, box.second);
+  } catch (const std::exception &) {
+    // A failed request, e.g. a timeout, is served by the fallback
+    return false;
+  }
+  const auto ttl = std::chrono::duration<double, std::milli>(m_config.ttl_ms);
+  for (auto &speed : speeds) {
+    auto it = m_cache.find(speed.first);
+    if (it == m_cache.end()) {
+      m_cache.emplace(speed.first,
+                      Entry{std::move(speed.second), now, live});
+    } else if (live || !it->second.live || now - it->second.fetched > ttl) {
+      // An estimate does not replace the live speed of a road
+      it->second = Entry{std::move(speed.second), now, live};
+    }
+  }
+  return true;
+}
+
+void LiveTrafficFeed::refreshAt(Clock::time_point now) {
+  for (const auto &box : m_boxes) {
+    if (m_source && fetch(*m_source, true, box, now)) {
+      continue;
+    }
+    m_num_fallbacks.fetch_add(1, std::memory_order_relaxed);
+    if (m_fallback) {
+      fetch(*m_fallback, false, box, now);
+    }
+  }
+
+  // The speeds older than their time to live are dropped
+  const auto ttl = std::chrono::duration<double, std::milli>(m_config.ttl_ms);
+  for (auto it = m_cache.begin(); it != m_cache.end();) {
+    if (now - it->second.fetched > ttl) {
+      it = m_cache.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  Speeds &snapshot = m_snapshots.back();
+  snapshot.clear();
+  for (const auto &entry : m_cache) {
+    snapshot.emplace(entry.first, entry.second.data);
+  }
+  m_snapshots.publish();
+  m_num_refreshes.fetch_add(1, std::memory_order_relaxed);
+}
+
+} // namespace realdata
+} // namespace jamfree
@@ -0,0 +1,59 @@
+#include "../include/MapMatcher.h"
+#include "../../kernel/include/model/Road.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace jamfree {
+namespace realdata {
+
+MapMatcher::MapMatcher(const kernel::model::RoadIndex &index,
+                       double max_distance)
+    : m_index(index), m_max_distance(max_distance) {
+  if (!(max_distance >= 0.0)) {
+    throw std::invalid_argument("max_distance must not be negative");
+  }
+}
+
+std::unordered_map<std::string, TrafficSpeedData>
+MapMatcher::matchSpeeds(const std::vector<SpeedObservation> &observations,
+                        std::size_t *unmatched) const {
+  std::unordered_map<std::string, TrafficSpeedData> speeds;
+  std::unordered_map<std::string, std::size_t> counts;
+  std::size_t dropped = 0;
+  kernel::model::RoadIndex::Match found;
+  for (const SpeedObservation &observation : observations) {
+    if (!match(observation.location, found)) {
+      ++dropped;
+      continue;
+    }
+    const kernel::model::Road &road = *found.segment->road;
+    TrafficSpeedData &data = speeds[road.getId()];
+    const std::size_t count = ++counts[road.getId()];
+    if (count == 1) {
+      data.road_id = road.getId();
+      data.speed_kmh = 0.0;
+      data.free_flow_speed_kmh =
+          road.getNumLanes() > 0 ? road.getLane(0)->getSpeedLimit() * 3.6
+                                 : 0.0;
+    }
+    // Running mean, in the order of the observations
+    data.speed_kmh += (observation.speed_kmh - data.speed_kmh) / count;
+    data.timestamp = observation.timestamp;
+    data.source = observation.source;
+  }
+  for (auto &entry : speeds) {
+    TrafficSpeedData &data = entry.second;
+    data.congestion_level =
+        data.free_flow_speed_kmh > 0.0
+            ? std::max(0.0, std::min(1.0, 1.0 - data.speed_kmh /
+                                                     data.free_flow_speed_kmh))
+            : 0.0;
+  }
+  if (unmatched) {
+    *unmatched = dropped;
+  }
+  return speeds;
+}
+
+} // namespace realdata
+} // namespace jamfree
@@ -0,0 +1,373 @@
+#include "../include/NetworkCache.h"
+#include "../../../microkernel/include/checkpoint/MappedFile.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace jamfree {
+namespace realdata {
+namespace osm {
+
+using fr::univ_artois::lgi2a::similar::microkernel::checkpoint::
+    CheckpointReader;
+using fr::univ_artois::lgi2a::similar::microkernel::checkpoint::
+    CheckpointWriter;
+using fr::univ_artois::lgi2a::similar::microkernel::checkpoint::MappedFile;
+
+namespace {
+
+// "JFNC" in little-endian order
+constexpr std::uint32_t MAGIC = 0x434e464a;
+
+std::uint64_t rotate(std::uint64_t x, int bits) {
+  return (x << bits) | (x >> (64 - bits));
+}
+
+// Final mix of splitmix64
+std::uint64_t mix(std::uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+std::unique_ptr<MappedFile> mapSource(const std::string &filename) {
+  try {
+    return std::make_unique<MappedFile>(filename);
+  } catch (const std::exception &) {
+    throw std::runtime_error("Cannot open file: " + filename);
+  }
+}
+
+// Hash of the content of a mapped file, eight bytes at a time
+std::uint64_t hashContent(const std::uint8_t *data, std::size_t size) {
+  std::uint64_t hash = 0x9e3779b97f4a7c15ULL ^ size;
+  std::size_t pos = 0;
+  for (; pos + 8 <= size; pos += 8) {
+    std::uint64_t word;
+    std::memcpy(&word, data + pos, sizeof(word));
+    hash = rotate(hash ^ (word * 0x87c37b91114253d5ULL), 31) *
+           0x4cf5ad432745937fULL;
+  }
+  std::uint64_t tail = 0;
+  for (std::size_t shift = 0; pos < size; ++pos, shift += 8) {
+    tail |= static_cast<std::uint64_t>(data[pos]) << shift;
+  }
+  return mix(hash ^ tail);
+}
+
+void writePoint(CheckpointWriter &writer, const kernel::model::Point2D &p) {
+  writer.writeDouble(p.x);
+  writer.writeDouble(p.y);
+}
+
+kernel::model::Point2D readPoint(CheckpointReader &reader) {
+  double x = reader.readDouble();
+  double y = reader.readDouble();
+  return kernel::model::Point2D(x, y);
+}
+
+void writeNodes(CheckpointWriter &writer, const RoadNetwork &network) {
+  writer.writeU64(network.nodes.size());
+  for (const auto &entry : network.nodes) {
+    writer.writeI64(entry.second.id);
+    writer.writeDouble(entry.second.lat);
+    writer.writeDouble(entry.second.lon);
+  }
+}
+
+void readNodes(CheckpointReader reader, RoadNetwork &network) {
+  const std::uint64_t count = reader.readU64();
+  for (std::uint64_t i = 0; i < count; ++i) {
+    OSMNode node;
+    const long long id = reader.readI64();
+    node.id = id;
+    node.lat = reader.readDouble();
+    node.lon = reader.readDouble();
+    // Written in the order of the map
+    network.nodes.emplace_hint(network.nodes.end(), id, std::move(node));
+  }
+}
+
+void writeWays(CheckpointWriter &writer, const RoadNetwork &network) {
+  writer.writeU64(network.ways.size());
+  for (const OSMWay &way : network.ways) {
+    writer.writeI64(way.id);
+    writer.writeString(way.highway_type);
+    writer.writeI64(way.lanes);
+    writer.writeDouble(way.max_speed);
+    writer.writeBool(way.oneway);
+    writer.writeString(way.name);
+    writer.writeU64(way.node_refs.size());
+    for (long long ref : way.node_refs) {
+      writer.writeI64(ref);
+    }
+    writer.writeU64(way.tags.size());
+    for (const auto &tag : way.tags) {
+      writer.writeString(tag.first);
+      writer.writeString(tag.second);
+    }
+  }
+}
+
+void readWays(CheckpointReader reader, RoadNetwork &network) {
+  const std::uint64_t count = reader.readU64();
+  network.ways.reserve(static_cast<std::size_t>(
+      std::min<std::uint64_t>(count, reader.remaining())));
+  for (std::uint64_t i = 0; i < count; ++i) {
+    OSMWay way;
+    way.id = reader.readI64();
+    way.highway_type = reader.readString();
+    way.lanes = static_cast<int>(reader.readI64());
+    way.max_speed = reader.readDouble();
+    way.oneway = reader.readBool();
+    way.name = reader.readString();
+    const std::uint64_t refs = reader.readU64();
+    way.node_refs.reserve(static_cast<std::size_t>(
+        std::min<std::uint64_t>(refs, reader.remaining() / 8)));
+    for (std::uint64_t r = 0; r < refs; ++r) {
+      way.node_refs.push_back(reader.readI64());
+    }
+    const std::uint64_t tags = reader.readU64();
+    for (std::uint64_t t = 0; t < tags; ++t) {
+      std::string key = reader.readString();
+      way.tags.emplace_hint(way.tags.end(), std::move(key),
+                            reader.readString());
+    }
+    network.ways.push_back(std::move(way));
+  }
+}
+
+void writeRoads(CheckpointWriter &writer, const RoadNetwork &network) {
+  writer.writeU64(network.roads.size());
+  for (const auto &road : network.roads) {
+    writer.writeString(road->getId());
+    writer.writeDouble(road->getLaneWidth());
+    writePoint(writer, road->getStart());
+    writePoint(writer, road->getEnd());
+    const auto &waypoints = road->getWaypoints();
+    writer.writeU64(waypoints.size());
+    for (const auto &point : waypoints) {
+      writePoint(writer, point);
+    }
+    writer.writeU64(road->getLanes().size());
+    for (const auto &lane : road->getLanes()) {
+      writer.writeDouble(lane->getSpeedLimit());
+    }
+  }
+}
+
+void readRoads(CheckpointReader reader, RoadNetwork &network) {
+  const std::uint64_t count = reader.readU64();
+  network.roads.reserve(static_cast<std::size_t>(
+      std::min<std::uint64_t>(count, reader.remaining())));
+  std::vector<kernel::model::Point2D> waypoints;
+  std::vector<double> speed_limits;
+  for (std::uint64_t i = 0; i < count; ++i) {
+    std::string id = reader.readString();
+    double lane_width = reader.readDouble();
+    kernel::model::Point2D start = readPoint(reader);
+    kernel::model::Point2D end = readPoint(reader);
+    waypoints.clear();
+    const std::uint64_t points = reader.readU64();
+    for (std::uint64_t p = 0; p < points; ++p) {
+      waypoints.push_back(readPoint(reader));
+    }
+    speed_limits.clear();
+    const std::uint64_t lanes = reader.readU64();
+    for (std::uint64_t l = 0; l < lanes; ++l) {
+      speed_limits.push_back(reader.readDouble());
+    }
+
+    // Built as OSMParser built them, so that the lane lengths match
+    const int num_lanes = static_cast<int>(speed_limits.size());
+    auto road = waypoints.empty()
+                    ? std::make_shared<kernel::model::Road>(
+                          id, start, end, num_lanes, lane_width)
+                    : std::make_shared<kernel::model::Road>(
+                          id, waypoints, num_lanes, lane_width);
+    for (int l = 0; l < road->getNumLanes(); ++l) {
+      road->getLane(l)->setSpeedLimit(speed_limits[l]);
+    }
+    network.roads.push_back(road);
+  }
+}
+
+// The files a cache comes from are recognized by their size and hash
+struct FileIdentity {
+  std::uint64_t size;
+  std::uint64_t hash;
+
+  bool operator==(const FileIdentity &other) const {
+    return size == other.size && hash == other.hash;
+  }
+};
+
+FileIdentity identify(const std::string &filename) {
+  std::unique_ptr<MappedFile> file = mapSource(filename);
+  return FileIdentity{file->size(), hashContent(file->data(), file->size())};
+}
+
+std::vector<FileIdentity>
+identifyAll(const std::vector<std::string> &filenames) {
+  std::vector<FileIdentity> identities;
+  identities.reserve(filenames.size());
+  for (const std::string &filename : filenames) {
+    identities.push_back(identify(filename));
+  }
+  return identities;
+}
+
+void writeCache(const RoadNetwork &network, const FileIdentity &source,
+                const std::vector<FileIdentity> &changes,
+                const std::string &cache_filename) {
+  CheckpointWriter writer;
+  writer.writeU32(MAGIC);
+  writer.writeU32(NetworkCache::FORMAT_VERSION);
+  writer.writeU64(source.size);
+  writer.writeU64(source.hash);
+  writer.writeU64(changes.size());
+  for (const FileIdentity &change : changes) {
+    writer.writeU64(change.size);
+    writer.writeU64(change.hash);
+  }
+  writer.writeDouble(network.min_lat);
+  writer.writeDouble(network.max_lat);
+  writer.writeDouble(network.min_lon);
+  writer.writeDouble(network.max_lon);
+
+  CheckpointWriter nodes;
+  writeNodes(nodes, network);
+  writer.writeBlock(nodes);
+  CheckpointWriter ways;
+  writeWays(ways, network);
+  writer.writeBlock(ways);
+  CheckpointWriter roads;
+  writeRoads(roads, network);
+  writer.writeBlock(roads);
+
+  writer.saveTo(cache_filename);
+}
+
+// Reads a cache of the source with the first changes applied, setting
+// applied to their number
+bool readCache(const std::string &cache_filename, const FileIdentity &source,
+               const std::vector<FileIdentity> &changes, RoadNetwork &network,
+               std::size_t &applied) {
+  try {
+    MappedFile cache(cache_filename);
+    CheckpointReader reader = cache.reader();
+    if (reader.readU32() != MAGIC ||
+        reader.readU32() != NetworkCache::FORMAT_VERSION) {
+      return false;
+    }
+    FileIdentity cached_source;
+    cached_source.size = reader.readU64();
+    cached_source.hash = reader.readU64();
+    if (!(cached_source == source)) {
+      return false;
+    }
+    const std::uint64_t cached_changes = reader.readU64();
+    if (cached_changes > changes.size()) {
+      return false;
+    }
+    for (std::uint64_t i = 0; i < cached_changes; ++i) {
+      FileIdentity change;
+      change.size = reader.readU64();
+      change.hash = reader.readU64();
+      if (!(change == changes[i])) {
+        return false;
+      }
+    }
+
+    RoadNetwork cached;
+    cached.min_lat = reader.readDouble();
+    cached.max_lat = reader.readDouble();
+    cached.min_lon = reader.readDouble();
+    cached.max_lon = reader.readDouble();
+    readNodes(reader.readBlock(), cached);
+    readWays(reader.readBlock(), cached);
+    readRoads(reader.readBlock(), cached);
+    cached.indexRoads();
+    network = std::move(cached);
+    applied = static_cast<std::size_t>(cached_changes);
+    return true;
+  } catch (const std::exception &) {
+    // Missing or truncated
+    return false;
+  }
+}
+
+} // namespace
+
+void NetworkCache::save(const RoadNetwork &network,
+                        const std::string &source_filename,
+                        const std::string &cache_filename) {
+  save(network, source_filename, {}, cache_filename);
+}
+
+void NetworkCache::save(const RoadNetwork &network,
+                        const std::string &source_filename,
+                        const std::vector<std::string> &change_filenames,
+                        const std::string &cache_filename) {
+  writeCache(network, identify(source_filename), identifyAll(change_filenames),
+             cache_filename);
+}
+
+bool NetworkCache::load(const std::string &cache_filename,
+                        const std::string &source_filename,
+                        RoadNetwork &network) {
+  try {
+    std::size_t applied;
+    return readCache(cache_filename, identify(source_filename), {}, network,
+                     applied);
+  } catch (const std::exception &) {
+    // Missing source
+    return false;
+  }
+}
+
+RoadNetwork NetworkCache::loadOrParse(const std::string &source_filename,
+                                      const std::string &cache_filename) {
+  return loadOrParse(source_filename, {}, cache_filename);
+}
+
+RoadNetwork
+NetworkCache::loadOrParse(const std::string &source_filename,
+                          const std::vector<std::string> &change_filenames,
+                          const std::string &cache_filename) {
+  const FileIdentity source = identify(source_filename);
+  const std::vector<FileIdentity> changes = identifyAll(change_filenames);
+  RoadNetwork network;
+  std::size_t applied = 0;
+  if (readCache(cache_filename, source, changes, network, applied)) {
+    if (applied == changes.size()) {
+      return network;
+    }
+  } else {
+    network = OSMParser::parseFile(source_filename);
+  }
+  for (std::size_t i = applied; i < change_filenames.size(); ++i) {
+    OSMParser::applyChange(network,
+                           OSMParser::parseChangeFile(change_filenames[i]));
+  }
+  try {
+    writeCache(network, source, changes, cache_filename);
+  } catch (const std::exception &) {
+    // The next call parses the file again
+  }
+  return network;
+}
+
+std::uint64_t NetworkCache::hashFile(const std::string &filename) {
+  std::unique_ptr<MappedFile> file = mapSource(filename);
+  return hashContent(file->data(), file->size());
+}
+
+} // namespace osm
+} // namespace realdata
+} // namespace jamfree
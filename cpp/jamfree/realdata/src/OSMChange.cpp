@@ -0,0 +1,273 @@
+#include "../include/OSMParser.h"
+#include "../include/OSMPullParser.h"
+#include "../../../microkernel/include/checkpoint/MappedFile.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace jamfree {
+namespace realdata {
+namespace osm {
+
+namespace {
+
+std::string roadIdOf(long long way_id) {
+  return "osm_way_" + std::to_string(way_id);
+}
+
+} // namespace
+
+OSMChange OSMParser::parseChangeFile(const std::string &filename) {
+  std::unique_ptr<fr::univ_artois::lgi2a::similar::microkernel::checkpoint::
+                      MappedFile>
+      file;
+  try {
+    file = std::make_unique<fr::univ_artois::lgi2a::similar::microkernel::
+                                checkpoint::MappedFile>(filename);
+  } catch (const std::exception &) {
+    throw std::runtime_error("Cannot open file: " + filename);
+  }
+  return parseChange(std::string_view(
+      reinterpret_cast<const char *>(file->data()), file->size()));
+}
+
+OSMChange OSMParser::parseChange(std::string_view xml_content) {
+  OSMChange change;
+  OSMPullParser parser(xml_content);
+  // The elements outside of a section are ignored
+  enum class Section { NONE, UPSERT, DELETE } section = Section::NONE;
+  OSMWay way;
+  bool in_way = false;
+
+  for (auto event = parser.next(); event != OSMPullParser::Event::END;
+       event = parser.next()) {
+    switch (event) {
+    case OSMPullParser::Event::CREATE:
+    case OSMPullParser::Event::MODIFY:
+      section = Section::UPSERT;
+      break;
+    case OSMPullParser::Event::DELETE:
+      section = Section::DELETE;
+      break;
+    case OSMPullParser::Event::NODE: {
+      long long id;
+      if (!OSMPullParser::parseInteger(parser.attribute("id"), id)) {
+        break;
+      }
+      if (section == Section::DELETE) {
+        change.deleted_nodes.push_back(id);
+        break;
+      }
+      OSMNode node;
+      node.id = id;
+      if (section == Section::UPSERT &&
+          OSMPullParser::parseDouble(parser.attribute("lat"), node.lat) &&
+          OSMPullParser::parseDouble(parser.attribute("lon"), node.lon) &&
+          std::abs(node.lat) <= 90.0 && std::abs(node.lon) <= 180.0) {
+        change.nodes.push_back(std::move(node));
+      }
+      break;
+    }
+    case OSMPullParser::Event::WAY: {
+      long long id = 0;
+      OSMPullParser::parseInteger(parser.attribute("id"), id);
+      if (section == Section::DELETE) {
+        change.deleted_ways.push_back(id);
+        break;
+      }
+      if (section != Section::UPSERT) {
+        break;
+      }
+      way = OSMWay();
+      way.id = id;
+      in_way = !parser.isEmptyElement();
+      if (!in_way) {
+        change.ways.push_back(std::move(way));
+      }
+      break;
+    }
+    case OSMPullParser::Event::ND:
+      if (in_way) {
+        long long ref;
+        if (OSMPullParser::parseInteger(parser.attribute("ref"), ref)) {
+          way.node_refs.push_back(ref);
+        }
+      }
+      break;
+    case OSMPullParser::Event::TAG:
+      if (in_way) {
+        way.tags[OSMPullParser::decode(parser.attribute("k"))] =
+            OSMPullParser::decode(parser.attribute("v"));
+      }
+      break;
+    case OSMPullParser::Event::END_WAY:
+      if (in_way) {
+        in_way = false;
+        change.ways.push_back(std::move(way));
+      }
+      break;
+    default:
+      break;
+    }
+  }
+  return change;
+}
+
+NetworkPatch OSMParser::applyChange(RoadNetwork &network,
+                                    const OSMChange &change,
+                                    const RoadFilter *filter) {
+  NetworkPatch patch;
+
+  // The nodes moved or deleted, whose ways are built again
+  std::unordered_map<long long, const OSMNode *> change_nodes;
+  std::unordered_set<long long> moved;
+  for (const OSMNode &node : change.nodes) {
+    change_nodes[node.id] = &node;
+    auto it = network.nodes.find(node.id);
+    if (it != network.nodes.end() &&
+        (it->second.lat != node.lat || it->second.lon != node.lon)) {
+      it->second.lat = node.lat;
+      it->second.lon = node.lon;
+      moved.insert(node.id);
+    }
+  }
+  for (long long id : change.deleted_nodes) {
+    if (network.nodes.erase(id) != 0) {
+      moved.insert(id);
+    }
+  }
+
+  std::unordered_set<long long> affected;
+  std::unordered_map<long long, std::size_t> way_indices;
+  for (std::size_t i = 0; i < network.ways.size(); ++i) {
+    way_indices[network.ways[i].id] = i;
+    if (!moved.empty()) {
+      for (long long ref : network.ways[i].node_refs) {
+        if (moved.count(ref) != 0) {
+          affected.insert(network.ways[i].id);
+          break;
+        }
+      }
+    }
+  }
+
+  // The ways created or modified, then the ones deleted; the nodes of the
+  // ways replaced may be released with them
+  std::vector<bool> removed(network.ways.size(), false);
+  std::unordered_set<long long> released;
+  auto release = [&](const OSMWay &old_way) {
+    released.insert(old_way.node_refs.begin(), old_way.node_refs.end());
+  };
+  for (const OSMWay &changed : change.ways) {
+    OSMWay way = changed;
+    const bool accepted = acceptWay(way, filter);
+    if (accepted) {
+      for (long long ref : way.node_refs) {
+        auto node = change_nodes.find(ref);
+        if (node != change_nodes.end() && network.nodes.count(ref) == 0) {
+          OSMNode added;
+          added.id = ref;
+          added.lat = node->second->lat;
+          added.lon = node->second->lon;
+          network.nodes.emplace(ref, std::move(added));
+        }
+      }
+    }
+    auto known = way_indices.find(way.id);
+    if (known != way_indices.end()) {
+      const std::size_t index = known->second;
+      release(network.ways[index]);
+      if (accepted) {
+        network.ways[index] = std::move(way);
+        removed[index] = false;
+      } else {
+        removed[index] = true;
+      }
+      affected.insert(changed.id);
+    } else if (accepted) {
+      way_indices[way.id] = network.ways.size();
+      network.ways.push_back(std::move(way));
+      removed.push_back(false);
+      affected.insert(changed.id);
+    }
+  }
+  for (long long id : change.deleted_ways) {
+    auto known = way_indices.find(id);
+    if (known != way_indices.end() && !removed[known->second]) {
+      release(network.ways[known->second]);
+      removed[known->second] = true;
+      affected.insert(id);
+    }
+  }
+
+  // Only the nodes of the kept ways stay, as after a parse
+  std::size_t kept = 0;
+  for (std::size_t i = 0; i < network.ways.size(); ++i) {
+    if (!removed[i]) {
+      if (kept != i) {
+        network.ways[kept] = std::move(network.ways[i]);
+      }
+      ++kept;
+    }
+  }
+  network.ways.resize(kept);
+  if (!released.empty()) {
+    for (const OSMWay &way : network.ways) {
+      for (long long ref : way.node_refs) {
+        released.erase(ref);
+      }
+    }
+    for (long long ref : released) {
+      network.nodes.erase(ref);
+    }
+  }
+
+  // The roads of the affected ways, replaced in place; the new ones are
+  // added in the order of the ways
+  std::unordered_set<std::string> affected_roads;
+  for (long long id : affected) {
+    affected_roads.insert(roadIdOf(id));
+  }
+  std::unordered_map<std::string, std::shared_ptr<kernel::model::Road>>
+      rebuilt;
+  std::vector<std::shared_ptr<kernel::model::Road>> appended;
+  for (const OSMWay &way : network.ways) {
+    if (affected.count(way.id) != 0) {
+      if (auto road = createRoad(way, network)) {
+        rebuilt[road->getId()] = road;
+        appended.push_back(road);
+      }
+    }
+  }
+  std::vector<std::shared_ptr<kernel::model::Road>> roads;
+  roads.reserve(network.roads.size() + appended.size());
+  std::unordered_set<const kernel::model::Road *> placed;
+  for (auto &road : network.roads) {
+    if (affected_roads.count(road->getId()) == 0) {
+      roads.push_back(std::move(road));
+      continue;
+    }
+    auto replacement = rebuilt.find(road->getId());
+    patch.removed_roads.push_back(std::move(road));
+    if (replacement != rebuilt.end() &&
+        placed.insert(replacement->second.get()).second) {
+      roads.push_back(replacement->second);
+    }
+  }
+  for (auto &road : appended) {
+    if (placed.count(road.get()) == 0) {
+      roads.push_back(road);
+    }
+  }
+  network.roads = std::move(roads);
+  patch.added_roads = std::move(appended);
+
+  network.road_index.update(patch.removed_roads, patch.added_roads);
+  return patch;
+}
+
+} // namespace osm
+} // namespace realdata
+} // namespace jamfree
@@ -1,8 +1,9 @@
 #include "../include/OSMParser.h"
+#include "../include/OSMPullParser.h"
+#include "../../../microkernel/include/checkpoint/MappedFile.h"
 #include <algorithm>
 #include <cmath>
-#include <fstream>
-#include <sstream>
+#include <stdexcept>
 
 namespace jamfree {
 namespace realdata {
@@ -12,29 +13,35 @@ namespace osm {
 constexpr double EARTH_RADIUS = 6371000.0;
 
 RoadNetwork OSMParser::parseFile(const std::string &filename) {
-  std::ifstream file(filename);
-  if (!file.is_open()) {
+  return parseFile(filename, nullptr);
+}
+
+RoadNetwork OSMParser::parseFile(const std::string &filename,
+                                 const RoadFilter *filter,
+                                 std::size_t num_threads) {
+  // Mapped rather than read, the pages being read once as the parse goes
+  std::unique_ptr<fr::univ_artois::lgi2a::similar::microkernel::checkpoint::
+                      MappedFile>
+      file;
+  try {
+    file = std::make_unique<fr::univ_artois::lgi2a::similar::microkernel::
+                                checkpoint::MappedFile>(filename);
+  } catch (const std::exception &) {
     throw std::runtime_error("Cannot open file: " + filename);
   }
-
-  std::stringstream buffer;
-  buffer << file.rdbuf();
-  return parseString(buffer.str());
+  const std::string pbf_extension = ".pbf";
+  if (filename.size() > pbf_extension.size() &&
+      filename.compare(filename.size() - pbf_extension.size(),
+                       pbf_extension.size(), pbf_extension) == 0) {
+    return parsePbf(file->data(), file->size(), filter, num_threads);
+  }
+  return parse(std::string_view(reinterpret_cast<const char *>(file->data()),
+                                file->size()),
+               filter);
 }
 
 RoadNetwork OSMParser::parseString(const std::string &xml_content) {
-  RoadNetwork network;
-
-  // Parse nodes
-  parseNodes(xml_content, network);
-
-  // Parse ways
-  parseWays(xml_content, network);
-
-  // Create roads from ways
-  createRoads(network);
-
-  return network;
+  return parse(xml_content, nullptr);
 }
 
 kernel::model::Point2D OSMParser::latLonToMeters(double lat, double lon,
@@ -123,121 +130,105 @@ double OSMParser::getDefaultSpeedLimit(const std::string &highway_type,
   return 50.0;
 }
 
-void OSMParser::parseNodes(const std::string &xml, RoadNetwork &network) {
-  // Simple XML parsing (in production, use a proper XML library)
-  size_t pos = 0;
-
+RoadNetwork OSMParser::parse(std::string_view xml,
+                             const RoadFilter *filter) {
+  RoadNetwork network;
   network.min_lat = 90.0;
   network.max_lat = -90.0;
   network.min_lon = 180.0;
   network.max_lon = -180.0;
 
-  while ((pos = xml.find("<node", pos)) != std::string::npos) {
-    size_t end = xml.find("/>", pos);
-    if (end == std::string::npos) {
-      end = xml.find("</node>", pos);
-    }
-    if (end == std::string::npos)
-      break;
-
-    std::string node_str = xml.substr(pos, end - pos);
-
-    OSMNode node;
+  // The coordinates of all the nodes, the ways coming after them
+  NodeCoordinates coordinates;
+  OSMPullParser parser(xml);
+  OSMWay way;
+  bool in_way = false;
 
-    // Extract id
-    size_t id_pos = node_str.find("id=\"");
-    if (id_pos != std::string::npos) {
-      id_pos += 4;
-      size_t id_end = node_str.find("\"", id_pos);
-      node.id = std::stoll(node_str.substr(id_pos, id_end - id_pos));
+  auto finishWay = [&]() {
+    in_way = false;
+    if (acceptWay(way, filter)) {
+      network.ways.push_back(std::move(way));
     }
-
-    // Extract lat
-    size_t lat_pos = node_str.find("lat=\"");
-    if (lat_pos != std::string::npos) {
-      lat_pos += 5;
-      size_t lat_end = node_str.find("\"", lat_pos);
-      node.lat = std::stod(node_str.substr(lat_pos, lat_end - lat_pos));
-
-      network.min_lat = std::min(network.min_lat, node.lat);
-      network.max_lat = std::max(network.max_lat, node.lat);
+  };
+
+  for (auto event = parser.next(); event != OSMPullParser::Event::END;
+       event = parser.next()) {
+    switch (event) {
+    case OSMPullParser::Event::NODE: {
+      long long id;
+      double lat;
+      double lon;
+      if (OSMPullParser::parseInteger(parser.attribute("id"), id) &&
+          OSMPullParser::parseDouble(parser.attribute("lat"), lat) &&
+          OSMPullParser::parseDouble(parser.attribute("lon"), lon) &&
+          std::abs(lat) <= 90.0 && std::abs(lon) <= 180.0) {
+        coordinates.insert(id, lat, lon);
+        network.min_lat = std::min(network.min_lat, lat);
+        network.max_lat = std::max(network.max_lat, lat);
+        network.min_lon = std::min(network.min_lon, lon);
+        network.max_lon = std::max(network.max_lon, lon);
+      }
+      break;
     }
-
-    // Extract lon
-    size_t lon_pos = node_str.find("lon=\"");
-    if (lon_pos != std::string::npos) {
-      lon_pos += 5;
-      size_t lon_end = node_str.find("\"", lon_pos);
-      node.lon = std::stod(node_str.substr(lon_pos, lon_end - lon_pos));
-
-      network.min_lon = std::min(network.min_lon, node.lon);
-      network.max_lon = std::max(network.max_lon, node.lon);
+    case OSMPullParser::Event::WAY:
+      way = OSMWay();
+      way.id = 0;
+      OSMPullParser::parseInteger(parser.attribute("id"), way.id);
+      in_way = true;
+      if (parser.isEmptyElement()) {
+        finishWay();
+      }
+      break;
+    case OSMPullParser::Event::ND:
+      if (in_way) {
+        long long ref;
+        if (OSMPullParser::parseInteger(parser.attribute("ref"), ref)) {
+          way.node_refs.push_back(ref);
+        }
+      }
+      break;
+    case OSMPullParser::Event::TAG:
+      // The tags of the nodes and relations are not kept
+      if (in_way) {
+        way.tags[OSMPullParser::decode(parser.attribute("k"))] =
+            OSMPullParser::decode(parser.attribute("v"));
+      }
+      break;
+    case OSMPullParser::Event::END_WAY:
+      if (in_way) {
+        finishWay();
+      }
+      break;
+    default:
+      break;
     }
-
-    network.nodes[node.id] = node;
-    pos = end;
   }
-}
 
-void OSMParser::parseWays(const std::string &xml, RoadNetwork &network) {
-  size_t pos = 0;
-
-  while ((pos = xml.find("<way", pos)) != std::string::npos) {
-    size_t end = xml.find("</way>", pos);
-    if (end == std::string::npos)
-      break;
-
-    std::string way_str = xml.substr(pos, end - pos);
-
-    OSMWay way;
-
-    // Extract id
-    size_t id_pos = way_str.find("id=\"");
-    if (id_pos != std::string::npos) {
-      id_pos += 4;
-      size_t id_end = way_str.find("\"", id_pos);
-      way.id = std::stoll(way_str.substr(id_pos, id_end - id_pos));
-    }
+  finishNetwork(network, coordinates);
+  return network;
+}
 
-    // Extract node references
-    size_t nd_pos = 0;
-    while ((nd_pos = way_str.find("<nd ref=\"", nd_pos)) != std::string::npos) {
-      nd_pos += 9;
-      size_t nd_end = way_str.find("\"", nd_pos);
-      long long node_id = std::stoll(way_str.substr(nd_pos, nd_end - nd_pos));
-      way.node_refs.push_back(node_id);
-      nd_pos = nd_end;
-    }
+bool OSMParser::acceptWay(OSMWay &way, const RoadFilter *filter) {
+  extractWayAttributes(way);
+  // Only add if it's a road
+  return !way.highway_type.empty() && (!filter || filter->accept(way));
+}
 
-    // Extract tags
-    size_t tag_pos = 0;
-    while ((tag_pos = way_str.find("<tag k=\"", tag_pos)) !=
-           std::string::npos) {
-      tag_pos += 8;
-      size_t key_end = way_str.find("\"", tag_pos);
-      std::string key = way_str.substr(tag_pos, key_end - tag_pos);
-
-      size_t val_pos = way_str.find("v=\"", key_end);
-      if (val_pos != std::string::npos) {
-        val_pos += 3;
-        size_t val_end = way_str.find("\"", val_pos);
-        std::string value = way_str.substr(val_pos, val_end - val_pos);
-        way.tags[key] = value;
+void OSMParser::finishNetwork(RoadNetwork &network,
+                              const NodeCoordinates &coordinates) {
+  // Only the nodes of the roads are kept
+  for (const auto &road_way : network.ways) {
+    for (long long ref : road_way.node_refs) {
+      OSMNode node;
+      node.id = ref;
+      if (coordinates.find(ref, node.lat, node.lon)) {
+        network.nodes.emplace(ref, std::move(node));
       }
-
-      tag_pos = key_end;
-    }
-
-    // Extract way attributes
-    extractWayAttributes(way);
-
-    // Only add if it's a road
-    if (!way.highway_type.empty()) {
-      network.ways.push_back(way);
     }
-
-    pos = end;
   }
+
+  // Create roads from ways
+  createRoads(network);
 }
 
 void OSMParser::extractWayAttributes(OSMWay &way) {
@@ -247,18 +238,27 @@ void OSMParser::extractWayAttributes(OSMWay &way) {
     way.highway_type = highway_it->second;
   }
 
-  // Lanes
+  // Lanes, e.g. "2" or "2;3"
   auto lanes_it = way.tags.find("lanes");
-  if (lanes_it != way.tags.end()) {
-    way.lanes = std::stoi(lanes_it->second);
+  long long lanes;
+  if (lanes_it != way.tags.end() &&
+      OSMPullParser::parseInteger(lanes_it->second, lanes)) {
+    way.lanes = static_cast<int>(lanes);
   } else {
     way.lanes = getDefaultLanes(way.highway_type);
   }
 
-  // Max speed
+  // Max speed, e.g. "50" or "30 mph"; the others, as "none" or
+  // "FR:urban", get the default of the highway type
   auto maxspeed_it = way.tags.find("maxspeed");
-  if (maxspeed_it != way.tags.end()) {
-    way.max_speed = std::stod(maxspeed_it->second);
+  double max_speed;
+  std::string_view unit;
+  if (maxspeed_it != way.tags.end() &&
+      OSMPullParser::parseDouble(maxspeed_it->second, max_speed, &unit)) {
+    while (!unit.empty() && unit.front() == ' ') {
+      unit.remove_prefix(1);
+    }
+    way.max_speed = unit == "mph" ? max_speed * 1.609344 : max_speed;
   } else {
     way.max_speed = getDefaultSpeedLimit(way.highway_type);
   }
@@ -277,45 +277,53 @@ void OSMParser::extractWayAttributes(OSMWay &way) {
 }
 
 void OSMParser::createRoads(RoadNetwork &network) {
-  // Calculate center for coordinate conversion
-  double center_lat = (network.min_lat + network.max_lat) / 2.0;
-  double center_lon = (network.min_lon + network.max_lon) / 2.0;
-
   // Create roads from ways
   for (const auto &way : network.ways) {
-    if (way.node_refs.size() < 2)
-      continue;
+    if (auto road = createRoad(way, network)) {
+      network.roads.push_back(road);
+    }
+  }
+  network.indexRoads();
+}
 
-    // Get start and end nodes
-    auto start_it = network.nodes.find(way.node_refs.front());
-    auto end_it = network.nodes.find(way.node_refs.back());
+std::shared_ptr<kernel::model::Road>
+OSMParser::createRoad(const OSMWay &way, const RoadNetwork &network) {
+  if (way.node_refs.size() < 2)
+    return nullptr;
 
-    if (start_it == network.nodes.end() || end_it == network.nodes.end()) {
-      continue;
-    }
+  // Get start and end nodes
+  auto start_it = network.nodes.find(way.node_refs.front());
+  auto end_it = network.nodes.find(way.node_refs.back());
 
-    // Convert to local coordinates
-    auto start_pos = latLonToMeters(start_it->second.lat, start_it->second.lon,
-                                    center_lat, center_lon);
+  if (start_it == network.nodes.end() || end_it == network.nodes.end()) {
+    return nullptr;
+  }
+
+  // Calculate center for coordinate conversion
+  double center_lat = (network.min_lat + network.max_lat) / 2.0;
+  double center_lon = (network.min_lon + network.max_lon) / 2.0;
 
-    auto end_pos = latLonToMeters(end_it->second.lat, end_it->second.lon,
+  // Convert to local coordinates
+  auto start_pos = latLonToMeters(start_it->second.lat, start_it->second.lon,
                                   center_lat, center_lon);
 
-    // Create road
-    std::string road_id = "osm_way_" + std::to_string(way.id);
-    auto road = std::make_shared<kernel::model::Road>(road_id, start_pos,
-                                                      end_pos, way.lanes,
-                                                      3.5 // Default lane width
-    );
-
-    // Set speed limit (convert km/h to m/s)
-    for (int i = 0; i < way.lanes; i++) {
-      auto lane = road->getLane(i);
-      lane->setSpeedLimit(way.max_speed / 3.6);
-    }
+  auto end_pos = latLonToMeters(end_it->second.lat, end_it->second.lon,
+                                center_lat, center_lon);
 
-    network.roads.push_back(road);
+  // Create road
+  std::string road_id = "osm_way_" + std::to_string(way.id);
+  auto road = std::make_shared<kernel::model::Road>(road_id, start_pos,
+                                                    end_pos, way.lanes,
+                                                    3.5 // Default lane width
+  );
+
+  // Set speed limit (convert km/h to m/s)
+  for (int i = 0; i < way.lanes; i++) {
+    auto lane = road->getLane(i);
+    lane->setSpeedLimit(way.max_speed / 3.6);
   }
+
+  return road;
 }
 
 } // namespace osm
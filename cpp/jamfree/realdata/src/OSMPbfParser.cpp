@@ -0,0 +1,515 @@
+#include "../include/OSMParser.h"
+#include "../include/OSMPullParser.h"
+#include "../../../microkernel/include/engine/WorkStealingThreadPool.h"
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <thread>
+#ifdef JAMFREE_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+namespace jamfree {
+namespace realdata {
+namespace osm {
+
+using fr::univ_artois::lgi2a::similar::microkernel::engine::
+    WorkStealingThreadPool;
+
+namespace {
+
+// Limits of the OSM PBF format
+constexpr std::size_t MAX_BLOB_HEADER_SIZE = 64 * 1024;
+constexpr std::size_t MAX_BLOB_SIZE = 32 * 1024 * 1024;
+
+// Blocks decoded at the same time, per thread
+constexpr std::size_t BLOCKS_PER_THREAD = 4;
+
+[[noreturn]] void malformed() {
+  throw std::runtime_error("Malformed OSM PBF data");
+}
+
+/**
+ * Reader of the fields of a protocol buffer message, in place.
+ */
+class ProtoReader {
+public:
+  ProtoReader(const std::uint8_t *data, std::size_t size)
+      : m_pos(data), m_end(data + size) {}
+
+  explicit ProtoReader(std::string_view bytes)
+      : ProtoReader(reinterpret_cast<const std::uint8_t *>(bytes.data()),
+                    bytes.size()) {}
+
+  bool atEnd() const { return m_pos >= m_end; }
+
+  // Reads the key of the next field, false at the end of the message
+  bool next() {
+    if (atEnd()) {
+      return false;
+    }
+    std::uint64_t key = varint();
+    m_field = static_cast<std::uint32_t>(key >> 3);
+    m_wire = static_cast<std::uint32_t>(key & 7);
+    return true;
+  }
+
+  std::uint32_t field() const { return m_field; }
+
+  std::uint64_t varint() {
+    std::uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (m_pos >= m_end) {
+        malformed();
+      }
+      std::uint8_t byte = *m_pos++;
+      value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+        return value;
+      }
+    }
+    malformed();
+  }
+
+  // sint32 and sint64, zigzag encoded
+  std::int64_t svarint() {
+    std::uint64_t value = varint();
+    return static_cast<std::int64_t>(value >> 1) ^
+           -static_cast<std::int64_t>(value & 1);
+  }
+
+  // Length-delimited fields: bytes, strings, messages and packed arrays
+  std::string_view bytes() {
+    std::uint64_t length = varint();
+    if (length > static_cast<std::uint64_t>(m_end - m_pos)) {
+      malformed();
+    }
+    std::string_view value(reinterpret_cast<const char *>(m_pos),
+                           static_cast<std::size_t>(length));
+    m_pos += length;
+    return value;
+  }
+
+  void skip() {
+    switch (m_wire) {
+    case 0:
+      varint();
+      break;
+    case 1:
+      advance(8);
+      break;
+    case 2:
+      bytes();
+      break;
+    case 5:
+      advance(4);
+      break;
+    default:
+      malformed();
+    }
+  }
+
+private:
+  const std::uint8_t *m_pos;
+  const std::uint8_t *m_end;
+  std::uint32_t m_field = 0;
+  std::uint32_t m_wire = 0;
+
+  void advance(std::size_t count) {
+    if (count > static_cast<std::size_t>(m_end - m_pos)) {
+      malformed();
+    }
+    m_pos += count;
+  }
+};
+
+// The strings of a block are referenced by index
+std::string_view stringAt(const std::vector<std::string_view> &strings,
+                          std::uint64_t index) {
+  if (index >= strings.size()) {
+    malformed();
+  }
+  return strings[index];
+}
+
+// Nanodegrees to the 1e-7 degrees of NodeCoordinates, rounded
+std::int32_t toFixed(std::int64_t nanodegrees) {
+  std::int64_t fixed =
+      nanodegrees >= 0 ? (nanodegrees + 50) / 100 : -((50 - nanodegrees) / 100);
+  return static_cast<std::int32_t>(
+      std::max<std::int64_t>(-1800000000LL, std::min<std::int64_t>(
+                                                1800000000LL, fixed)));
+}
+
+struct DecodedNode {
+  long long id;
+  std::int32_t lat; // 1e-7 degrees
+  std::int32_t lon; // 1e-7 degrees
+};
+
+/**
+ * Nodes and accepted ways of a PrimitiveBlock.
+ */
+struct DecodedBlock {
+  std::vector<DecodedNode> nodes;
+  std::vector<OSMWay> ways;
+  // Decompressed content, reused from batch to batch
+  std::vector<std::uint8_t> buffer;
+};
+
+/**
+ * Gets the content of a Blob, decompressed if needed.
+ */
+std::string_view blobContent(std::string_view blob,
+                             std::vector<std::uint8_t> &buffer) {
+  std::string_view raw;
+  std::string_view zlib_data;
+  std::uint64_t raw_size = 0;
+  bool has_raw = false;
+  ProtoReader reader(blob);
+  while (reader.next()) {
+    switch (reader.field()) {
+    case 1:
+      raw = reader.bytes();
+      has_raw = true;
+      break;
+    case 2:
+      raw_size = reader.varint();
+      break;
+    case 3:
+      zlib_data = reader.bytes();
+      break;
+    case 4:
+    case 6:
+    case 7:
+      throw std::runtime_error("Unsupported OSM PBF compression "
+                               "(only raw and zlib blobs are)");
+    default:
+      reader.skip();
+    }
+  }
+  if (has_raw || zlib_data.empty()) {
+    return raw;
+  }
+  if (raw_size > MAX_BLOB_SIZE) {
+    malformed();
+  }
+#ifdef JAMFREE_HAS_ZLIB
+  buffer.resize(static_cast<std::size_t>(raw_size));
+  uLongf length = static_cast<uLongf>(raw_size);
+  if (uncompress(buffer.data(), &length,
+                 reinterpret_cast<const Bytef *>(zlib_data.data()),
+                 static_cast<uLong>(zlib_data.size())) != Z_OK ||
+      length != raw_size) {
+    malformed();
+  }
+  return std::string_view(reinterpret_cast<const char *>(buffer.data()),
+                          buffer.size());
+#else
+  (void)buffer;
+  throw std::runtime_error(
+      "Cannot decompress OSM PBF blob: JamFree was built without zlib");
+#endif
+}
+
+/**
+ * Checks that the features an OSMHeader block requires are supported.
+ */
+void checkHeader(std::string_view header) {
+  ProtoReader reader(header);
+  while (reader.next()) {
+    if (reader.field() != 4) {
+      reader.skip();
+      continue;
+    }
+    std::string_view feature = reader.bytes();
+    if (feature != "OsmSchema-V0.6" && feature != "DenseNodes") {
+      throw std::runtime_error("Unsupported OSM PBF feature: " +
+                               std::string(feature));
+    }
+  }
+}
+
+/**
+ * Decodes the nodes and the ways of a PrimitiveBlock.
+ *
+ * A way is materialized only if it has a highway tag, and kept only if
+ * accept() takes it.
+ */
+template <typename Accept>
+void decodeBlock(std::string_view block, const Accept &accept,
+                 DecodedBlock &decoded) {
+  // The parameters of the block may follow its groups
+  std::vector<std::string_view> strings;
+  std::vector<std::string_view> groups;
+  std::int64_t granularity = 100;
+  std::int64_t lat_offset = 0;
+  std::int64_t lon_offset = 0;
+  ProtoReader reader(block);
+  while (reader.next()) {
+    switch (reader.field()) {
+    case 1: {
+      ProtoReader table(reader.bytes());
+      while (table.next()) {
+        if (table.field() == 1) {
+          strings.push_back(table.bytes());
+        } else {
+          table.skip();
+        }
+      }
+      break;
+    }
+    case 2:
+      groups.push_back(reader.bytes());
+      break;
+    case 17:
+      granularity = static_cast<std::int64_t>(reader.varint());
+      break;
+    case 19:
+      lat_offset = static_cast<std::int64_t>(reader.varint());
+      break;
+    case 20:
+      lon_offset = static_cast<std::int64_t>(reader.varint());
+      break;
+    default:
+      reader.skip();
+    }
+  }
+
+  std::uint64_t highway = strings.size();
+  for (std::size_t i = 0; i < strings.size(); ++i) {
+    if (strings[i] == "highway") {
+      highway = i;
+      break;
+    }
+  }
+
+  auto addNode = [&](std::int64_t id, std::int64_t lat, std::int64_t lon) {
+    DecodedNode node{static_cast<long long>(id),
+                     toFixed(lat_offset + granularity * lat),
+                     toFixed(lon_offset + granularity * lon)};
+    if (std::abs(node.lat) <= 900000000 && std::abs(node.lon) <= 1800000000) {
+      decoded.nodes.push_back(node);
+    }
+  };
+
+  for (std::string_view group : groups) {
+    ProtoReader items(group);
+    while (items.next()) {
+      switch (items.field()) {
+      case 1: {
+        // Node
+        std::int64_t id = 0;
+        std::int64_t lat = 0;
+        std::int64_t lon = 0;
+        ProtoReader node(items.bytes());
+        while (node.next()) {
+          if (node.field() == 1) {
+            id = node.svarint();
+          } else if (node.field() == 8) {
+            lat = node.svarint();
+          } else if (node.field() == 9) {
+            lon = node.svarint();
+          } else {
+            node.skip();
+          }
+        }
+        addNode(id, lat, lon);
+        break;
+      }
+      case 2: {
+        // DenseNodes, delta coded
+        std::string_view ids;
+        std::string_view lats;
+        std::string_view lons;
+        ProtoReader dense(items.bytes());
+        while (dense.next()) {
+          if (dense.field() == 1) {
+            ids = dense.bytes();
+          } else if (dense.field() == 8) {
+            lats = dense.bytes();
+          } else if (dense.field() == 9) {
+            lons = dense.bytes();
+          } else {
+            dense.skip();
+          }
+        }
+        ProtoReader id_reader(ids);
+        ProtoReader lat_reader(lats);
+        ProtoReader lon_reader(lons);
+        std::int64_t id = 0;
+        std::int64_t lat = 0;
+        std::int64_t lon = 0;
+        while (!id_reader.atEnd()) {
+          id += id_reader.svarint();
+          lat += lat_reader.svarint();
+          lon += lon_reader.svarint();
+          addNode(id, lat, lon);
+        }
+        break;
+      }
+      case 3: {
+        // Way
+        std::int64_t id = 0;
+        std::string_view keys;
+        std::string_view values;
+        std::string_view refs;
+        ProtoReader way_reader(items.bytes());
+        while (way_reader.next()) {
+          switch (way_reader.field()) {
+          case 1:
+            id = static_cast<std::int64_t>(way_reader.varint());
+            break;
+          case 2:
+            keys = way_reader.bytes();
+            break;
+          case 3:
+            values = way_reader.bytes();
+            break;
+          case 8:
+            refs = way_reader.bytes();
+            break;
+          default:
+            way_reader.skip();
+          }
+        }
+
+        // Most ways are not roads
+        bool road = false;
+        for (ProtoReader key_reader(keys); !key_reader.atEnd();) {
+          if (key_reader.varint() == highway) {
+            road = true;
+            break;
+          }
+        }
+        if (!road) {
+          break;
+        }
+
+        OSMWay way;
+        way.id = static_cast<long long>(id);
+        ProtoReader key_reader(keys);
+        ProtoReader value_reader(values);
+        while (!key_reader.atEnd()) {
+          std::string_view key = stringAt(strings, key_reader.varint());
+          std::string_view value = stringAt(strings, value_reader.varint());
+          way.tags[std::string(key)] = std::string(value);
+        }
+        std::int64_t ref = 0;
+        for (ProtoReader ref_reader(refs); !ref_reader.atEnd();) {
+          ref += ref_reader.svarint();
+          way.node_refs.push_back(static_cast<long long>(ref));
+        }
+        if (accept(way)) {
+          decoded.ways.push_back(std::move(way));
+        }
+        break;
+      }
+      default:
+        items.skip();
+      }
+    }
+  }
+}
+
+} // namespace
+
+RoadNetwork OSMParser::parsePbf(const std::uint8_t *data, std::size_t size,
+                                const RoadFilter *filter,
+                                std::size_t num_threads) {
+  RoadNetwork network;
+  network.min_lat = 90.0;
+  network.max_lat = -90.0;
+  network.min_lon = 180.0;
+  network.max_lon = -180.0;
+
+  // The file is a sequence of BlobHeader and Blob pairs, each header
+  // preceded by its size in network byte order
+  std::vector<std::string_view> blocks;
+  std::size_t pos = 0;
+  while (pos < size) {
+    if (size - pos < 4) {
+      malformed();
+    }
+    std::size_t header_size = (std::size_t(data[pos]) << 24) |
+                              (std::size_t(data[pos + 1]) << 16) |
+                              (std::size_t(data[pos + 2]) << 8) |
+                              std::size_t(data[pos + 3]);
+    pos += 4;
+    if (header_size > MAX_BLOB_HEADER_SIZE || header_size > size - pos) {
+      malformed();
+    }
+    std::string_view type;
+    std::uint64_t blob_size = 0;
+    ProtoReader header(data + pos, header_size);
+    while (header.next()) {
+      if (header.field() == 1) {
+        type = header.bytes();
+      } else if (header.field() == 3) {
+        blob_size = header.varint();
+      } else {
+        header.skip();
+      }
+    }
+    pos += header_size;
+    if (blob_size > MAX_BLOB_SIZE || blob_size > size - pos) {
+      malformed();
+    }
+    std::string_view blob(reinterpret_cast<const char *>(data + pos),
+                          static_cast<std::size_t>(blob_size));
+    pos += blob_size;
+
+    // The blobs of unknown types are skipped
+    if (type == "OSMHeader") {
+      std::vector<std::uint8_t> buffer;
+      checkHeader(blobContent(blob, buffer));
+    } else if (type == "OSMData") {
+      blocks.push_back(blob);
+    }
+  }
+
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  WorkStealingThreadPool pool(num_threads);
+  auto accept = [filter](OSMWay &way) { return acceptWay(way, filter); };
+
+  // Batches of blocks are decoded in parallel, then merged in file order so
+  // that the network does not depend on the number of threads
+  NodeCoordinates coordinates;
+  std::vector<DecodedBlock> batch(pool.size() * BLOCKS_PER_THREAD);
+  for (std::size_t first = 0; first < blocks.size(); first += batch.size()) {
+    const std::size_t count = std::min(batch.size(), blocks.size() - first);
+    pool.parallelFor(count, 1, [&](size_t begin, size_t end, size_t) {
+      for (size_t i = begin; i < end; ++i) {
+        DecodedBlock &decoded = batch[i];
+        decoded.nodes.clear();
+        decoded.ways.clear();
+        decodeBlock(blobContent(blocks[first + i], decoded.buffer), accept,
+                    decoded);
+      }
+    });
+
+    for (std::size_t i = 0; i < count; ++i) {
+      for (const DecodedNode &node : batch[i].nodes) {
+        coordinates.insertFixed(node.id, node.lat, node.lon);
+        double lat = node.lat / 1e7;
+        double lon = node.lon / 1e7;
+        network.min_lat = std::min(network.min_lat, lat);
+        network.max_lat = std::max(network.max_lat, lat);
+        network.min_lon = std::min(network.min_lon, lon);
+        network.max_lon = std::max(network.max_lon, lon);
+      }
+      for (OSMWay &way : batch[i].ways) {
+        network.ways.push_back(std::move(way));
+      }
+    }
+  }
+
+  finishNetwork(network, coordinates);
+  return network;
+}
+
+} // namespace osm
+} // namespace realdata
+} // namespace jamfree
@@ -0,0 +1,370 @@
+#include "../include/OSMPullParser.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace jamfree {
+namespace realdata {
+namespace osm {
+
+namespace {
+
+// Identifier of the free slots, which no OSM element uses
+constexpr long long EMPTY_ID = std::numeric_limits<long long>::min();
+
+// Coordinates are kept in 1e-7 degrees
+constexpr double FIXED_SCALE = 1e7;
+constexpr long long FIXED_LIMIT = 1800000000LL;
+
+[[noreturn]] void malformed(std::size_t offset) {
+  throw std::runtime_error("Malformed OSM XML at offset " +
+                           std::to_string(offset));
+}
+
+bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool startsWith(std::string_view text, std::string_view prefix) {
+  return text.substr(0, prefix.size()) == prefix;
+}
+
+// Final mix of splitmix64, spreading sequential identifiers over the table
+std::uint64_t mix(std::uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+std::int32_t toFixed(double degrees) {
+  long long fixed = std::llround(degrees * FIXED_SCALE);
+  if (fixed > FIXED_LIMIT) {
+    fixed = FIXED_LIMIT;
+  } else if (fixed < -FIXED_LIMIT) {
+    fixed = -FIXED_LIMIT;
+  }
+  return static_cast<std::int32_t>(fixed);
+}
+
+void appendUtf8(std::string &out, unsigned long code) {
+  if (code < 0x80) {
+    out += static_cast<char>(code);
+  } else if (code < 0x800) {
+    out += static_cast<char>(0xc0 | (code >> 6));
+    out += static_cast<char>(0x80 | (code & 0x3f));
+  } else if (code < 0x10000) {
+    out += static_cast<char>(0xe0 | (code >> 12));
+    out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+    out += static_cast<char>(0x80 | (code & 0x3f));
+  } else {
+    out += static_cast<char>(0xf0 | (code >> 18));
+    out += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+    out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+    out += static_cast<char>(0x80 | (code & 0x3f));
+  }
+}
+
+} // namespace
+
+OSMPullParser::Event OSMPullParser::next() {
+  const std::size_t size = m_xml.size();
+  while (true) {
+    std::size_t open = m_xml.find('<', m_pos);
+    if (open == std::string_view::npos) {
+      m_pos = size;
+      return Event::END;
+    }
+
+    // Comments, CDATA sections and declarations
+    std::string_view rest = m_xml.substr(open + 1);
+    std::string_view skipped_end;
+    if (startsWith(rest, "!--")) {
+      skipped_end = "-->";
+    } else if (startsWith(rest, "![CDATA[")) {
+      skipped_end = "]]>";
+    } else if (startsWith(rest, "?") || startsWith(rest, "!")) {
+      skipped_end = ">";
+    }
+    if (!skipped_end.empty()) {
+      std::size_t close = m_xml.find(skipped_end, open + 2);
+      if (close == std::string_view::npos) {
+        malformed(open);
+      }
+      m_pos = close + skipped_end.size();
+      continue;
+    }
+
+    // End tags
+    if (startsWith(rest, "/")) {
+      std::size_t close = m_xml.find('>', open);
+      if (close == std::string_view::npos) {
+        malformed(open);
+      }
+      std::size_t name_end = open + 2;
+      while (name_end < close && !isSpace(m_xml[name_end])) {
+        ++name_end;
+      }
+      std::string_view name = m_xml.substr(open + 2, name_end - open - 2);
+      m_pos = close + 1;
+      if (name == "node") {
+        return Event::END_NODE;
+      }
+      if (name == "way") {
+        return Event::END_WAY;
+      }
+      continue;
+    }
+
+    // Start tags
+    std::size_t name_end = open + 1;
+    while (name_end < size && !isSpace(m_xml[name_end]) &&
+           m_xml[name_end] != '/' && m_xml[name_end] != '>') {
+      ++name_end;
+    }
+    std::string_view name = m_xml.substr(open + 1, name_end - open - 1);
+    m_pos = readAttributes(name_end);
+    if (name == "node") {
+      return Event::NODE;
+    }
+    if (name == "way") {
+      return Event::WAY;
+    }
+    if (name == "nd") {
+      return Event::ND;
+    }
+    if (name == "tag") {
+      return Event::TAG;
+    }
+    if (name == "create") {
+      return Event::CREATE;
+    }
+    if (name == "modify") {
+      return Event::MODIFY;
+    }
+    if (name == "delete") {
+      return Event::DELETE;
+    }
+  }
+}
+
+std::size_t OSMPullParser::readAttributes(std::size_t pos) {
+  const std::size_t size = m_xml.size();
+  m_attributes.clear();
+  m_empty = false;
+
+  while (true) {
+    while (pos < size && isSpace(m_xml[pos])) {
+      ++pos;
+    }
+    if (pos >= size) {
+      malformed(pos);
+    }
+    if (m_xml[pos] == '>') {
+      return pos + 1;
+    }
+    if (m_xml[pos] == '/') {
+      if (pos + 1 < size && m_xml[pos + 1] == '>') {
+        m_empty = true;
+        return pos + 2;
+      }
+      malformed(pos);
+    }
+
+    // name = "value", or with single quotes
+    std::size_t name_begin = pos;
+    while (pos < size && m_xml[pos] != '=' && !isSpace(m_xml[pos]) &&
+           m_xml[pos] != '>' && m_xml[pos] != '/') {
+      ++pos;
+    }
+    std::string_view name = m_xml.substr(name_begin, pos - name_begin);
+    while (pos < size && isSpace(m_xml[pos])) {
+      ++pos;
+    }
+    if (pos >= size || m_xml[pos] != '=') {
+      malformed(name_begin);
+    }
+    ++pos;
+    while (pos < size && isSpace(m_xml[pos])) {
+      ++pos;
+    }
+    if (pos >= size || (m_xml[pos] != '"' && m_xml[pos] != '\'')) {
+      malformed(name_begin);
+    }
+    std::size_t value_end = m_xml.find(m_xml[pos], pos + 1);
+    if (value_end == std::string_view::npos) {
+      malformed(name_begin);
+    }
+    m_attributes.emplace_back(name,
+                              m_xml.substr(pos + 1, value_end - pos - 1));
+    pos = value_end + 1;
+  }
+}
+
+std::string_view OSMPullParser::attribute(std::string_view name) const {
+  for (const auto &attribute : m_attributes) {
+    if (attribute.first == name) {
+      return attribute.second;
+    }
+  }
+  return {};
+}
+
+std::string OSMPullParser::decode(std::string_view value) {
+  std::size_t amp = value.find('&');
+  if (amp == std::string_view::npos) {
+    return std::string(value);
+  }
+
+  std::string decoded(value.substr(0, amp));
+  while (amp != std::string_view::npos) {
+    std::size_t semicolon = value.find(';', amp);
+    if (semicolon == std::string_view::npos) {
+      break;
+    }
+    std::string_view entity = value.substr(amp + 1, semicolon - amp - 1);
+    bool known = true;
+    if (entity == "amp") {
+      decoded += '&';
+    } else if (entity == "lt") {
+      decoded += '<';
+    } else if (entity == "gt") {
+      decoded += '>';
+    } else if (entity == "quot") {
+      decoded += '"';
+    } else if (entity == "apos") {
+      decoded += '\'';
+    } else if (startsWith(entity, "#")) {
+      // &#65; or &#x41;
+      bool hex = startsWith(entity, "#x") || startsWith(entity, "#X");
+      std::string_view digits = entity.substr(hex ? 2 : 1);
+      unsigned long code = 0;
+      auto result = std::from_chars(digits.data(),
+                                    digits.data() + digits.size(), code,
+                                    hex ? 16 : 10);
+      known = result.ec == std::errc() &&
+              result.ptr == digits.data() + digits.size() && code <= 0x10ffff;
+      if (known) {
+        appendUtf8(decoded, code);
+      }
+    } else {
+      known = false;
+    }
+
+    // An unknown reference is kept as it is
+    std::size_t next = value.find('&', semicolon + 1);
+    if (!known) {
+      decoded.append(value.substr(amp, semicolon + 1 - amp));
+    }
+    decoded.append(value.substr(semicolon + 1, next == std::string_view::npos
+                                                   ? std::string_view::npos
+                                                   : next - semicolon - 1));
+    amp = next;
+  }
+  if (amp != std::string_view::npos) {
+    decoded.append(value.substr(amp));
+  }
+  return decoded;
+}
+
+bool OSMPullParser::parseInteger(std::string_view text, long long &value) {
+  auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+  return result.ec == std::errc();
+}
+
+bool OSMPullParser::parseDouble(std::string_view text, double &value,
+                                std::string_view *rest) {
+  const char *begin = text.data();
+  const char *end = text.data() + text.size();
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  auto result = std::from_chars(begin, end, value);
+  if (result.ec != std::errc()) {
+    return false;
+  }
+  const char *parsed = result.ptr;
+#else
+  // Standard libraries without floating-point from_chars
+  char buffer[64];
+  std::size_t length = std::min(text.size(), sizeof(buffer) - 1);
+  std::memcpy(buffer, begin, length);
+  buffer[length] = '\0';
+  if (length == 0 || isSpace(buffer[0]) || buffer[0] == '+') {
+    return false;
+  }
+  char *stop = nullptr;
+  value = std::strtod(buffer, &stop);
+  if (stop == buffer) {
+    return false;
+  }
+  const char *parsed = begin + (stop - buffer);
+#endif
+  if (rest) {
+    *rest = std::string_view(parsed, end - parsed);
+  }
+  return true;
+}
+
+void NodeCoordinates::insert(long long id, double lat, double lon) {
+  insertFixed(id, toFixed(lat), toFixed(lon));
+}
+
+void NodeCoordinates::insertFixed(long long id, std::int32_t lat,
+                                  std::int32_t lon) {
+  if (id == EMPTY_ID) {
+    return;
+  }
+  if ((m_size + 1) * 10 > m_slots.size() * 7) {
+    grow();
+  }
+  Slot &slot = m_slots[slotOf(id)];
+  if (slot.id == EMPTY_ID) {
+    ++m_size;
+  }
+  slot.id = id;
+  slot.lat = lat;
+  slot.lon = lon;
+}
+
+bool NodeCoordinates::find(long long id, double &lat, double &lon) const {
+  if (m_slots.empty() || id == EMPTY_ID) {
+    return false;
+  }
+  const Slot &slot = m_slots[slotOf(id)];
+  if (slot.id == EMPTY_ID) {
+    return false;
+  }
+  // The division restores the decimal value of the file exactly
+  lat = slot.lat / FIXED_SCALE;
+  lon = slot.lon / FIXED_SCALE;
+  return true;
+}
+
+std::size_t NodeCoordinates::slotOf(long long id) const {
+  const std::size_t mask = m_slots.size() - 1;
+  std::size_t index = mix(static_cast<std::uint64_t>(id)) & mask;
+  while (m_slots[index].id != id && m_slots[index].id != EMPTY_ID) {
+    index = (index + 1) & mask;
+  }
+  return index;
+}
+
+void NodeCoordinates::grow() {
+  std::vector<Slot> old;
+  old.swap(m_slots);
+  m_slots.assign(old.empty() ? 1024 : old.size() * 2, Slot{EMPTY_ID, 0, 0});
+  for (const Slot &slot : old) {
+    if (slot.id != EMPTY_ID) {
+      m_slots[slotOf(slot.id)] = slot;
+    }
+  }
+}
+
+} // namespace osm
+} // namespace realdata
+} // namespace jamfree
@@ -20,7 +20,19 @@ class get_pybind_include:
 cpp_sources = [
     'python/src/bindings.cpp',
     'kernel/src/model/Lane.cpp',
+    'kernel/src/model/SpatialIndex.cpp',
+    'kernel/src/model/LaneVehicleStore.cpp',
+    'kernel/src/model/Junction.cpp',
+    'kernel/src/model/RoadIndex.cpp',
+    'realdata/src/LiveTrafficFeed.cpp',
+    'realdata/src/MapMatcher.cpp',
+    'realdata/src/NetworkCache.cpp',
+    'realdata/src/OSMChange.cpp',
     'realdata/src/OSMParser.cpp',
+    'realdata/src/OSMPbfParser.cpp',
+    'realdata/src/OSMPullParser.cpp',
+    'macroscopic/src/MacroscopicBatch.cpp',
+    'macroscopic/src/FundamentalDiagramEstimator.cpp',
     'hybrid/src/AdaptiveSimulator.cpp',
 ]
 
@@ -38,6 +50,9 @@ ext_modules = [
         include_dirs=include_dirs,
         language='c++',
         extra_compile_args=['-std=c++17'],
+        # zlib decompresses the blobs of OSM PBF files
+        define_macros=[('JAMFREE_HAS_ZLIB', '1')],
+        libraries=['z'],
     ),
 ]
 
@@ -53,7 +68,7 @@ setup(
     packages=['jamfree'],
     package_dir={'jamfree': 'python/jamfree'},
     install_requires=[
-        'pybind11>=2.6.0',
+        'pybind11>=2.13',
     ],
     python_requires='>=3.7',
     classifiers=[
@@ -1,23 +1,90 @@
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <shared_mutex>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <variant>
 #include <vector>
 
 // JamFree Core Kernel includes (only the ones that work)
 #include "../kernel/include/model/Vehicle.h"
 #include "../kernel/include/model/Road.h"
 #include "../kernel/include/model/Lane.h"
+#include "../kernel/include/model/DetectorSet.h"
+#include "../kernel/include/model/Junction.h"
+#include "../kernel/include/model/LaneVehicleStore.h"
 #include "../kernel/include/model/Point2D.h"
+#include "../kernel/include/model/RoadIndex.h"
 #include "../kernel/include/model/SpatialIndex.h"
+#include "../kernel/include/model/TrafficControl.h"
+#include "../kernel/include/model/VehicleFrameCodec.h"
+#include "../kernel/include/model/VehicleStateExport.h"
+#include "../kernel/include/model/ViewportFilter.h"
+#include "../kernel/include/routing/NetworkPartition.h"
+#include "../kernel/include/routing/Router.h"
+#include "../kernel/include/routing/TripStream.h"
+#include "../kernel/include/simulation/DistributedSimulation.h"
+#include "../kernel/include/simulation/MultiLevelCoordinator.h"
+#include "../kernel/include/simulation/RankExchange.h"
+#include "../kernel/include/simulation/SimulationEngine.h"
+#include "../kernel/include/simulation/SimulationRunner.h"
+#include "../kernel/include/simulation/TrajectoryRecorder.h"
+#include "../kernel/include/simulation/TrajectoryReplay.h"
 #include "../kernel/include/tools/MathTools.h"
 #include "../kernel/include/tools/GeometryTools.h"
 #include "../kernel/include/tools/FastMath.h"
+#include "../kernel/include/tools/ObjectPool.h"
+#include "../kernel/include/tools/TripleBuffer.h"
+#include "../../microkernel/include/libs/SimulationMetrics.h"
+#include "../../microkernel/include/libs/StepTimingRecorder.h"
 
 // Microscopic Models
+#include "../microscopic/include/Calibration.h"
+#include "../microscopic/include/CarFollowingModel.h"
 #include "../microscopic/include/IDM.h"
+#include "../microscopic/include/decision/DecisionProgram.h"
+#include "../microscopic/include/decision/VehicleDecisionModelMicro.h"
+#include "../microscopic/include/agents/VehiclePrivateLocalStateMicro.h"
+#include "../microscopic/include/agents/VehiclePublicLocalStateMicro.h"
+#include "../microscopic/include/decision/dms/ConjunctionDMS.h"
+#include "../microscopic/include/decision/dms/ForwardAccelerationDMS.h"
+#include "../microscopic/include/decision/dms/LaneChangeDMS.h"
+#include "../microscopic/include/decision/dms/SubsumptionDMS.h"
+#include "../microscopic/include/perception/VehiclePerceptionModelMicro.h"
+#include "../microscopic/include/IDMLookup.h"
 #include "../microscopic/include/MOBIL.h"
+#include "../microscopic/include/reaction/MicroscopicReactionModel.h"
+
+// Macroscopic Models
+#include "../macroscopic/include/MacroscopicBatch.h"
+#include "../macroscopic/include/NetworkCTM.h"
+
+// Hybrid
+#include "../hybrid/include/AdaptiveSimulator.h"
+
+// Compute backends
+#include "../gpu/cpu/CpuCompute.h"
+
+// Real data
+#include "../realdata/include/LiveTrafficFeed.h"
+#include "../realdata/include/MapMatcher.h"
+#include "../realdata/include/NetworkCache.h"
+#include "../realdata/include/OSMParser.h"
+#include "../realdata/include/OSMPullParser.h"
 
 // Namespace aliases
 namespace jf = jamfree;
@@ -53,7 +120,8 @@ void testJamFreePoint2D() {
     jfk::model::Point2D origin(0.0, 0.0);
     jfk::model::Point2D p10(3.0, 4.0);
 
-    assert(std::abs(p10.distanceTo(p2) - 1.0) < 1e-9);
+    assert(std::abs(p10.distanceTo(origin) - 5.0) < 1e-9);
+    assert(p10.distanceTo(p2) == 0.0);
     assert(std::abs(p10.magnitude() - 5.0) < 1e-9);
 
     std::cout << "JamFree Point2D tests PASSED" << std::endl;
@@ -94,8 +162,48 @@ void testVehicle() {
     vehicle.setSpeed(-5.0);
     assert(vehicle.getSpeed() == 0.0);
 
-    vehicle.setSpeed(60.0); // Above max
-    assert(vehicle.getSpeed() == 50.0); // Clamped to max
+    // The maximum speed bounds the models, not the setter
+    vehicle.setSpeed(60.0);
+    assert(vehicle.getSpeed() == 60.0);
+
+    // The 2D position follows the lane position on the first read
+    jfk::model::Road road("road", jfk::model::Point2D(0.0, 0.0),
+                          jfk::model::Point2D(0.0, 200.0), 1, 4.0);
+    vehicle.setCurrentLane(road.getLane(0));
+    vehicle.setLanePosition(10.0);
+    vehicle.setSpeed(10.0);
+    vehicle.update(1.0, 0.0);
+    assert(std::abs(vehicle.getLanePosition() - 20.0) < 1e-9);
+    assert(std::abs(vehicle.getPosition().x - 2.0) < 1e-9 &&
+           std::abs(vehicle.getPosition().y - 20.0) < 1e-9);
+    assert(std::abs(vehicle.getHeading() - M_PI / 2.0) < 1e-9);
+    vehicle.update(1.0, 0.0);
+    vehicle.setPosition(jfk::model::Point2D(7.0, 8.0));
+    assert(vehicle.getPosition().x == 7.0 && vehicle.getPosition().y == 8.0);
+    assert(std::abs(vehicle.getHeading() - M_PI / 2.0) < 1e-9);
+
+    // Deferred steps read as one update over their time, integrated once
+    jfk::model::Vehicle held("held"), stepped("stepped");
+    for (auto *v : {&held, &stepped}) {
+        v->setCurrentLane(road.getLane(0));
+        v->setLanePosition(10.0);
+        v->setSpeed(10.0);
+    }
+    held.defer(0.5, 0.4);
+    held.defer(0.5, 0.4);
+    assert(held.getPendingTime() == 1.0);
+    stepped.update(1.0, 0.4);
+    assert(held.getLanePosition() == stepped.getLanePosition());
+    assert(held.getSpeed() == stepped.getSpeed());
+    assert(std::abs(held.getPosition().y - stepped.getPosition().y) < 1e-9);
+    held.catchUp();
+    assert(held.getPendingTime() == 0.0);
+    assert(held.getLanePosition() == stepped.getLanePosition());
+    held.defer(1.0, 0.4);
+    held.setSpeed(5.0); // A setter integrates the deferred time first
+    stepped.update(1.0, 0.4);
+    assert(held.getPendingTime() == 0.0 && held.getSpeed() == 5.0);
+    assert(held.getLanePosition() == stepped.getLanePosition());
 
     std::cout << "Vehicle tests PASSED" << std::endl;
 }
@@ -111,8 +219,8 @@ void testRoadAndLane() {
 
     // Test road properties
     assert(road.getId() == "test_road");
-    assert(road.getStart() == start);
-    assert(road.getEnd() == end);
+    assert(road.getStart().x == start.x && road.getStart().y == start.y);
+    assert(road.getEnd().x == end.x && road.getEnd().y == end.y);
     assert(road.getNumLanes() == 2);
     assert(std::abs(road.getLaneWidth() - 3.5) < 1e-9);
 
@@ -131,19 +239,1280 @@ void testRoadAndLane() {
     assert(std::abs(lane0->getWidth() - 3.5) < 1e-9);
     assert(std::abs(lane0->getLength() - 100.0) < 1e-9);
 
-    // Test position calculation (straight road)
+    // Test position calculation (straight road), the lanes offset to the
+    // right of the center line by half a lane width more each
     auto pos0 = lane0->getPositionAt(0.0);
     auto pos50 = lane0->getPositionAt(50.0);
-    auto pos100 = lane0->getPositionAt(100.0);
+    auto pos100 = lane1->getPositionAt(100.0);
+
+    assert(std::abs(pos0.x - 0.0) < 1e-9 && std::abs(pos0.y + 1.75) < 1e-9);
+    assert(std::abs(pos50.x - 50.0) < 1e-9 && std::abs(pos50.y + 1.75) < 1e-9);
+    assert(std::abs(pos100.x - 100.0) < 1e-9 &&
+           std::abs(pos100.y + 5.25) < 1e-9);
 
-    assert(pos0 == start);
-    assert(std::abs(pos50.x - 50.0) < 1e-9 && std::abs(pos50.y - 0.0) < 1e-9);
-    assert(pos100 == end);
+    // Curved road: an L of two 100 m segments, east then north
+    jfk::model::Road bend("bend",
+                          {jfk::model::Point2D(0.0, 0.0),
+                           jfk::model::Point2D(100.0, 0.0),
+                           jfk::model::Point2D(100.0, 100.0)},
+                          1, 4.0);
+    auto bendLane = bend.getLane(0);
+    assert(std::abs(bendLane->getLength() - 200.0) < 1e-9);
+    auto onFirst = bendLane->getPositionAt(40.0);
+    assert(std::abs(onFirst.x - 40.0) < 1e-9 &&
+           std::abs(onFirst.y + 2.0) < 1e-9);
+    auto onSecond = bendLane->getPositionAt(150.0);
+    assert(std::abs(onSecond.x - 102.0) < 1e-9 &&
+           std::abs(onSecond.y - 50.0) < 1e-9);
+    assert(std::abs(bendLane->getHeadingAt(40.0)) < 1e-9);
+    assert(std::abs(bendLane->getHeadingAt(150.0) - M_PI / 2.0) < 1e-9);
+    auto beyond = bend.getPositionAt(250.0);
+    assert(std::abs(beyond.x - 100.0) < 1e-9 &&
+           std::abs(beyond.y - 100.0) < 1e-9);
 
     std::cout << "Road and Lane tests PASSED" << std::endl;
 }
 
+// Test the order of the vehicles of a lane
+void testLaneOrdering() {
+    std::cout << "Testing Lane vehicle ordering..." << std::endl;
+
+    jfk::model::Lane lane("lane", 0, 3.5, 1000.0);
+    std::vector<std::shared_ptr<jfk::model::Vehicle>> vehicles;
+    const double positions[] = {50.0, 10.0, 30.0, 70.0, 30.0};
+    for (int i = 0; i < 5; ++i) {
+        auto vehicle = std::make_shared<jfk::model::Vehicle>("v" + std::to_string(i));
+        vehicle->setLanePosition(positions[i]);
+        vehicles.push_back(vehicle);
+        lane.addVehicle(vehicle);
+    }
+
+    // Inserted in order, the equal positions in the order of insertion
+    const auto &sorted = lane.getVehicles();
+    assert(sorted.size() == 5);
+    assert(sorted[0] == vehicles[1] && sorted[1] == vehicles[2] &&
+           sorted[2] == vehicles[4] && sorted[3] == vehicles[0] &&
+           sorted[4] == vehicles[3]);
+
+    assert(lane.getVehicleAhead(30.0) == vehicles[0]);
+    assert(lane.getVehicleAhead(70.0) == nullptr);
+    assert(lane.getVehicleBehind(30.0) == vehicles[1]);
+    assert(lane.getVehicleBehind(10.0) == nullptr);
+    assert(lane.getLeader(*vehicles[0]) == vehicles[3].get());
+    assert(lane.getFollower(*vehicles[0]) == vehicles[4].get());
+    assert(std::abs(lane.getGapAhead(40.0) - 10.0) < 1e-9);
+
+    // After the moves, a sort restores the order
+    vehicles[1]->setLanePosition(60.0); // overtakes v2, v4 and v0
+    vehicles[3]->setLanePosition(80.0);
+    lane.sortVehicles();
+    assert(sorted[0] == vehicles[2] && sorted[1] == vehicles[4] &&
+           sorted[2] == vehicles[0] && sorted[3] == vehicles[1] &&
+           sorted[4] == vehicles[3]);
+    assert(lane.getVehicleAhead(55.0) == vehicles[1]);
+
+    // The perception queries the index the lane owns
+    const auto &index = lane.getSpatialIndex();
+    assert(index.size() == 5);
+    assert(index.findLeader(*vehicles[0]) == vehicles[1].get());
+    assert(index.findInRange(30.0, 60.0).size() == 4);
+
+    lane.removeVehicle(vehicles[0]);
+    assert(lane.getVehicleBehind(60.0) == vehicles[4]);
+
+    // A vehicle moved since the sort is still found
+    vehicles[2]->setLanePosition(65.0);
+    lane.removeVehicle(vehicles[2]);
+    assert(lane.getVehicles().size() == 3);
+    lane.removeVehicles({vehicles[4], vehicles[3], vehicles[0]});
+    assert(lane.getVehicles().size() == 1 && sorted[0] == vehicles[1]);
+
+    std::cout << "Lane vehicle ordering tests PASSED" << std::endl;
+}
+
+// Test the export of the vehicle states into rows
+void testVehicleStateExport() {
+    std::cout << "Testing vehicle state export..." << std::endl;
+
+    using namespace jfk::model;
+    auto lane = std::make_shared<Lane>("lane", 2, 3.5, 1000.0);
+    for (int i = 0; i < 3; ++i) {
+        auto vehicle = std::make_shared<Vehicle>("v" + std::to_string(i));
+        vehicle->setCurrentLane(lane);
+        vehicle->setLanePosition(10.0 * i);
+        vehicle->setPosition(Point2D(10.0 * i, -1.0));
+        vehicle->setSpeed(5.0 + i);
+        vehicle->setAcceleration(0.5);
+        vehicle->setHeading(0.25);
+        lane->addVehicle(vehicle);
+    }
+    lane->getVehicles()[2]->setCurrentLane(nullptr);
+
+    std::vector<double> rows(3 * NUM_STATE_COLUMNS, 0.0);
+    assert(exportVehicleStates(lane->getVehicles(), rows.data(), 3) == 3);
+    const double *row = rows.data() + NUM_STATE_COLUMNS;
+    assert(row[STATE_VEHICLE_INDEX] == 1.0 && row[STATE_LANE_INDEX] == 2.0);
+    assert(row[STATE_LANE_POSITION] == 10.0);
+    assert(row[STATE_X] == 10.0 && row[STATE_Y] == -1.0);
+    assert(row[STATE_SPEED] == 6.0 && row[STATE_ACCELERATION] == 0.5);
+    assert(row[STATE_HEADING] == 0.25);
+    assert(rows[2 * NUM_STATE_COLUMNS + STATE_LANE_INDEX] == -1.0);
+
+    // The vehicles beyond the rows are left out, but counted
+    std::fill(rows.begin(), rows.end(), 0.0);
+    assert(exportVehicleStates(lane->getVehicles(), rows.data(), 1) == 3);
+    assert(rows[NUM_STATE_COLUMNS + STATE_SPEED] == 0.0);
+
+    std::cout << "Vehicle state export tests PASSED" << std::endl;
+}
+
+// Test the reuse of despawned vehicles and agents
+void testObjectPool() {
+    std::cout << "Testing ObjectPool..." << std::endl;
+
+    auto lane = std::make_shared<jfk::model::Lane>("lane", 0, 3.5, 1000.0);
+    jfk::tools::ObjectPool<jfk::model::Vehicle> vehicles;
+    auto vehicle = vehicles.acquire("a", 4.0);
+    vehicle->setCurrentLane(lane);
+    vehicle->setSpeed(20.0);
+    jfk::model::Vehicle *const address = vehicle.get();
+
+    // A vehicle still held elsewhere is not reused
+    auto held = vehicle;
+    assert(!vehicles.release(vehicle));
+    vehicle = std::move(held);
+    assert(vehicles.release(std::move(vehicle)));
+    assert(vehicles.getNumFree() == 1);
+
+    // The vehicle comes back as a new one
+    auto reused = vehicles.acquire("b");
+    assert(reused.get() == address && vehicles.getNumFree() == 0);
+    assert(reused->getId() == "b" && reused->getLength() == 5.0);
+    assert(reused->getSpeed() == 0.0 && !reused->getCurrentLane());
+    vehicles.reserve(3, std::string("spare"));
+    assert(vehicles.getNumFree() == 3);
+
+    // The engine hands the agents it removes back, swapping the last one
+    // into their place
+    jfk::simulation::SimulationEngine engine;
+    jfk::tools::ObjectPool<jfk::agents::VehicleAgent> agents;
+    for (int i = 0; i < 4; ++i) {
+        engine.addAgent(agents.acquire("agent" + std::to_string(i)));
+    }
+    auto removed = engine.removeAgent("agent1");
+    assert(removed && removed->getId() == "agent1");
+    assert(!engine.removeAgent("agent1"));
+    assert(engine.getAgents().size() == 3);
+    assert(engine.getAgents()[1]->getId() == "agent3");
+    assert(engine.getAgent("agent3") == engine.getAgents()[1]);
+    assert(engine.getAgent("agent1") == nullptr);
+    jfk::agents::VehicleAgent *const agent = removed.get();
+    assert(agents.release(std::move(removed)));
+    engine.addAgent(agents.acquire("agent4"));
+    assert(engine.getAgent("agent4").get() == agent);
+    assert(engine.getAgent("agent4")->getLevels().empty());
+
+    // The steps are timed once a listener is set
+    auto recorder = std::make_shared<
+        fr::univ_artois::lgi2a::similar::microkernel::libs::
+            StepTimingRecorder>();
+    auto metrics = std::make_shared<
+        fr::univ_artois::lgi2a::similar::microkernel::libs::
+            SimulationMetrics>(recorder);
+    engine.setStepTimingListener(metrics);
+    engine.run(3);
+    assert(metrics->getSteps() == 3 && recorder->getRecordedSteps() == 3);
+    const auto timings = recorder->getLatest();
+    assert(timings.agentCount == 4 && timings.influenceCount == 0);
+    assert(timings.timeUpperBound.getIdentifier() == 3);
+    assert(timings.total >= timings.perception + timings.decision);
+    engine.setStepTimingListener(nullptr);
+    engine.step();
+    assert(metrics->getSteps() == 3);
+
+    std::cout << "ObjectPool tests PASSED" << std::endl;
+}
+
+// Test the runs of steps and the handoff of their snapshots
+void testSimulationRunner() {
+    std::cout << "Testing SimulationRunner..." << std::endl;
+
+    // The reader takes the latest value published, once
+    jfk::tools::TripleBuffer<int> buffer;
+    assert(!buffer.update());
+    buffer.back() = 1;
+    buffer.publish();
+    buffer.back() = 2;
+    buffer.publish();
+    assert(buffer.update() && buffer.front() == 2);
+    assert(!buffer.update() && buffer.front() == 2);
+
+    // A snapshot holds the number of steps and, in all its cells, the same
+    std::atomic<int> steps{0};
+    jfk::simulation::SimulationRunner runner(
+        [&steps]() { ++steps; },
+        [&steps](std::vector<double> &rows) {
+            rows.assign(1000, static_cast<double>(steps.load()));
+        });
+    assert(runner.runFor(25) == 25 && steps == 25);
+    assert(runner.updateSnapshot() && runner.getSnapshot()[0] == 25.0);
+    const std::size_t timed = runner.runFor(0, 5.0);
+    assert(timed > 0 && runner.getNumSteps() == 25 + timed);
+
+    // The reader sees the steps go on in the background
+    runner.start();
+    assert(runner.isRunning());
+    double seen = 0.0;
+    while (seen < 1000.0) {
+        if (runner.updateSnapshot()) {
+            const auto &rows = runner.getSnapshot();
+            assert(rows.size() == 1000 && rows.front() == rows.back());
+            assert(rows.front() >= seen);
+            seen = rows.front();
+        }
+    }
+    bool thrown = false;
+    try {
+        runner.runFor(1);
+    } catch (const std::logic_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+    runner.stop();
+    assert(!runner.isRunning());
+    assert(runner.getNumSteps() == static_cast<std::size_t>(steps.load()));
+
+    // An error of a step stops the thread, and comes back from stop()
+    jfk::simulation::SimulationRunner failing(
+        []() { throw std::runtime_error("step"); });
+    failing.start();
+    while (failing.isRunning()) {
+        std::this_thread::yield();
+    }
+    thrown = false;
+    try {
+        failing.stop();
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+    thrown = false;
+    try {
+        failing.runFor(0, 0.0);
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    std::cout << "SimulationRunner tests PASSED" << std::endl;
+}
+
+// Test the delta-encoded frames of the vehicle states
+void testVehicleFrameCodec() {
+    std::cout << "Testing VehicleFrameCodec..." << std::endl;
+
+    using namespace jfk::model;
+    const std::size_t count = 50;
+    std::vector<double> rows(count * NUM_STATE_COLUMNS, 0.0);
+    auto move = [&rows, count](int step) {
+        for (std::size_t i = 0; i < count; ++i) {
+            double *row = rows.data() + i * NUM_STATE_COLUMNS;
+            row[STATE_VEHICLE_INDEX] = static_cast<double>(i);
+            row[STATE_LANE_INDEX] = static_cast<double>(i % 3);
+            row[STATE_X] = -500.0 + 17.3 * i + 1.5 * step;
+            row[STATE_Y] = 20.0 - 3.1 * i;
+            row[STATE_SPEED] = 10.0 + 0.2 * i;
+            row[STATE_HEADING] = -3.0 + 0.12 * i;
+        }
+    };
+
+    const FrameBounds bounds{-1000.0, -1000.0, 1000.0, 1000.0};
+    VehicleFrameEncoder::Config config;
+    config.keyframe_interval = 10;
+    VehicleFrameEncoder encoder(bounds, config);
+    VehicleFrameDecoder decoder;
+    std::vector<std::uint8_t> key, delta;
+    std::vector<double> decoded;
+    move(0);
+    encoder.encode(rows.data(), count, key);
+    assert(decoder.decode(key.data(), key.size(), decoded));
+    assert(decoded.size() == rows.size());
+
+    // The states come back within the resolutions
+    move(1);
+    encoder.encode(rows.data(), count, delta);
+    assert(delta.size() < key.size() / 2);
+    assert(decoder.decode(delta.data(), delta.size(), decoded));
+    assert(decoder.getFrameNumber() == 1);
+    for (std::size_t i = 0; i < count; ++i) {
+        const double *row = rows.data() + i * NUM_STATE_COLUMNS;
+        const double *back = decoded.data() + i * NUM_STATE_COLUMNS;
+        assert(back[STATE_LANE_INDEX] == row[STATE_LANE_INDEX]);
+        assert(std::abs(back[STATE_X] - row[STATE_X]) <= 0.05 + 1e-9);
+        assert(std::abs(back[STATE_Y] - row[STATE_Y]) <= 0.05 + 1e-9);
+        assert(std::abs(back[STATE_SPEED] - row[STATE_SPEED]) <= 0.05 + 1e-9);
+        const double turn = std::remainder(
+            back[STATE_HEADING] - row[STATE_HEADING], 2.0 * M_PI);
+        assert(std::abs(turn) < 1e-3);
+        assert(std::isnan(back[STATE_ACCELERATION]));
+    }
+
+    // A decoder joining midstream waits for a key frame
+    VehicleFrameDecoder late;
+    move(2);
+    encoder.encode(rows.data(), count, delta);
+    assert(!late.decode(delta.data(), delta.size(), decoded));
+    encoder.requestKeyFrame();
+    encoder.encode(rows.data(), count, key);
+    assert(late.decode(key.data(), key.size(), decoded));
+    assert(decoder.decode(key.data(), key.size(), decoded));
+
+    // A vehicle less, then the frame beyond the bounds clamped
+    rows[(count - 1) * NUM_STATE_COLUMNS + STATE_X] = 5000.0;
+    encoder.encode(rows.data(), count - 1, delta);
+    assert(late.decode(delta.data(), delta.size(), decoded));
+    assert(decoded.size() == (count - 1) * NUM_STATE_COLUMNS);
+    encoder.encode(rows.data(), count, delta);
+    assert(late.decode(delta.data(), delta.size(), decoded));
+    assert(std::abs(decoded[(count - 1) * NUM_STATE_COLUMNS + STATE_X] -
+                    1000.0) < 0.1);
+
+    // A truncated frame is malformed
+    bool thrown = false;
+    try {
+        VehicleFrameDecoder other;
+        other.decode(key.data(), key.size() / 2, decoded);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // Deflated frames, when JamFree has zlib
+    config.compress = true;
+    VehicleFrameEncoder deflating(bounds, config);
+    VehicleFrameDecoder inflating;
+    deflating.encode(rows.data(), count, key);
+    assert(inflating.decode(key.data(), key.size(), decoded));
+    assert(std::abs(decoded[STATE_Y] - rows[STATE_Y]) <= 0.05 + 1e-9);
+
+    thrown = false;
+    try {
+        config.position_resolution = 0.0;
+        VehicleFrameEncoder invalid(bounds, config);
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    std::cout << "VehicleFrameCodec tests PASSED" << std::endl;
+}
+
+void testTrajectoryRecorder() {
+    std::cout << "Testing TrajectoryRecorder..." << std::endl;
+
+    using namespace jfk::model;
+    using jfk::simulation::TrajectoryReader;
+    using jfk::simulation::TrajectoryRecorder;
+    const std::string path = std::filesystem::temp_directory_path().string() +
+                             "/jamfree_trajectory.jft";
+    // Vehicles enter during the run, the frames of some steps being empty.
+    // The values are exact in binary, so that every inlined copy computes
+    // them to the same bits, contracted into FMAs or not
+    auto frameAt = [](int step) {
+        const std::size_t count = step % 7 == 6 ? 0 : 30 + step;
+        std::vector<double> rows(count * NUM_STATE_COLUMNS);
+        for (std::size_t i = 0; i < count; ++i) {
+            double *row = rows.data() + i * NUM_STATE_COLUMNS;
+            row[STATE_VEHICLE_INDEX] = static_cast<double>(i);
+            row[STATE_LANE_INDEX] = static_cast<double>(i % 3);
+            row[STATE_LANE_POSITION] = 0.375 * step + 11.125 * i;
+            row[STATE_X] = -250.0 + row[STATE_LANE_POSITION];
+            row[STATE_Y] = 3.5 * (i % 3);
+            row[STATE_SPEED] = 13.875 + 0.015625 * step;
+            row[STATE_ACCELERATION] = i == 0 ? std::nan("") : -0.5;
+            row[STATE_HEADING] = 0.1 * i;
+        }
+        return rows;
+    };
+
+    TrajectoryRecorder::Config config;
+    config.keyframe_interval = 10;
+    config.max_pending_frames = 2;
+    const int steps = 25;
+    {
+        TrajectoryRecorder recorder(path, config);
+        std::vector<double> rows;
+        for (int step = 0; step < steps; ++step) {
+            rows = frameAt(step);
+            recorder.record(0.1 * step, rows);
+        }
+        assert(recorder.getNumFrames() == steps);
+
+        // Rows missing a column are refused, and so are frames after close
+        bool thrown = false;
+        rows.assign(NUM_STATE_COLUMNS + 1, 0.0);
+        try {
+            recorder.record(0.0, rows);
+        } catch (const std::invalid_argument &) {
+            thrown = true;
+        }
+        assert(thrown);
+        recorder.close();
+        thrown = false;
+        try {
+            recorder.record(0.0, rows);
+        } catch (const std::logic_error &) {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+
+    // The frames come back bit for bit, in order and out of order
+    TrajectoryReader reader(path);
+    assert(reader.getNumFrames() == steps);
+    std::vector<double> rows;
+    auto same = [](const std::vector<double> &a, const std::vector<double> &b) {
+        return a.size() == b.size() &&
+               (a.empty() || std::memcmp(a.data(), b.data(),
+                                         a.size() * sizeof(double)) == 0);
+    };
+    for (int step = 0; step < steps; ++step) {
+        reader.readFrame(step, rows);
+        assert(same(rows, frameAt(step)));
+    }
+    for (int step : {17, 3, 24, 9, 10, 9, 0}) {
+        reader.readFrame(step, rows);
+        assert(same(rows, frameAt(step)));
+    }
+    assert(std::abs(reader.getTime(12) - 1.2) < 1e-12);
+    assert(reader.findFrame(1.25) == 12);
+    assert(reader.findFrame(-1.0) == 0 && reader.findFrame(99.0) == 24);
+    bool thrown = false;
+    try {
+        reader.readFrame(steps, rows);
+    } catch (const std::out_of_range &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // The differences take less than the values
+    std::size_t raw = 0;
+    for (int step = 0; step < steps; ++step) {
+        raw += frameAt(step).size() * sizeof(double);
+    }
+    assert(std::filesystem::file_size(path) < raw / 2);
+
+    // A truncated file is malformed
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 3);
+    thrown = false;
+    try {
+        TrajectoryReader truncated(path);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+    std::remove(path.c_str());
+
+    std::cout << "TrajectoryRecorder tests PASSED" << std::endl;
+}
+
+void testTrajectoryReplay() {
+    std::cout << "Testing TrajectoryReplay..." << std::endl;
+
+    using namespace jfk::model;
+    using jfk::simulation::TrajectoryRecorder;
+    using jfk::simulation::TrajectoryReplay;
+    const std::string path = std::filesystem::temp_directory_path().string() +
+                             "/jamfree_replay.jft";
+    // A vehicle at x = step, one frame by half second
+    TrajectoryRecorder::Config config;
+    config.keyframe_interval = 4;
+    {
+        TrajectoryRecorder recorder(path, config);
+        std::vector<double> rows;
+        for (int step = 0; step <= 20; ++step) {
+            rows.assign(NUM_STATE_COLUMNS, 0.0);
+            rows[STATE_X] = step;
+            recorder.record(0.5 * step, rows);
+        }
+    }
+
+    TrajectoryReplay replay(path);
+    assert(replay.getFrameIndex() == 0 && replay.getFrame()[STATE_X] == 0.0);
+    assert(replay.getStartTime() == 0.0 && replay.getEndTime() == 10.0);
+    assert(!replay.updateFrame());
+
+    // Twice as fast as recorded: a wall-clock second is four frames
+    replay.setSpeed(2.0);
+    replay.advance(1.0);
+    assert(replay.updateFrame() && replay.getFrame()[STATE_X] == 4.0);
+    replay.advance(0.1);
+    assert(!replay.updateFrame());
+
+    // Seeking back and forth, and past the end
+    replay.seek(7.3);
+    assert(replay.updateFrame() && replay.getFrameIndex() == 14);
+    replay.seek(1.0);
+    assert(replay.updateFrame() && replay.getFrame()[STATE_X] == 2.0);
+    replay.seek(99.0);
+    assert(replay.isAtEnd() && replay.updateFrame());
+    assert(replay.getFrame()[STATE_X] == 20.0);
+
+    // Paused, the time stays
+    replay.seek(3.0);
+    replay.setSpeed(0.0);
+    replay.advance(5.0);
+    assert(replay.getTime() == 3.0);
+    bool thrown = false;
+    try {
+        replay.setSpeed(-1.0);
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // An empty recording has nothing to replay
+    { TrajectoryRecorder empty(path); }
+    thrown = false;
+    try {
+        TrajectoryReplay nothing(path);
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    assert(thrown);
+    std::remove(path.c_str());
+
+    std::cout << "TrajectoryReplay tests PASSED" << std::endl;
+}
+
+// Test the vehicles sent to a viewport, and their tiles zoomed out
+void testViewportFilter() {
+    std::cout << "Testing ViewportFilter..." << std::endl;
+
+    using namespace jfk::model;
+    // An L of two segments, and a road far away
+    auto bend = std::make_shared<Road>(
+        "bend",
+        std::vector<Point2D>{Point2D(0, 0), Point2D(1000, 0),
+                             Point2D(1000, 1000)},
+        2);
+    auto far = std::make_shared<Road>("far", Point2D(5000, 5000),
+                                      Point2D(6000, 5000));
+    std::vector<std::shared_ptr<Vehicle>> vehicles;
+    auto place = [&vehicles](const std::shared_ptr<Lane> &lane,
+                              double position) {
+        auto vehicle = std::make_shared<Vehicle>(
+            "v" + std::to_string(vehicles.size()));
+        vehicle->setCurrentLane(lane);
+        vehicle->setLanePosition(position);
+        vehicle->setPosition(lane->getPositionAt(position));
+        vehicle->setSpeed(position / 100.0);
+        lane->addVehicle(vehicle);
+        vehicles.push_back(vehicle);
+    };
+    for (double position = 50.0; position < 2000.0; position += 100.0) {
+        place(bend->getLane(0), position);
+        place(bend->getLane(1), position + 50.0);
+    }
+    place(far->getLane(0), 500.0);
+
+    ViewportFilter filter({bend, far});
+    // Around the corner, zoomed in
+    Viewport viewport;
+    viewport.min_x = 800.0;
+    viewport.min_y = -100.0;
+    viewport.max_x = 1100.0;
+    viewport.max_y = 200.0;
+    viewport.zoom = 17.0;
+    assert(filter.isDetailed(viewport));
+    std::size_t expected = 0;
+    for (const auto &vehicle : vehicles) {
+        const Point2D &p = vehicle->getPosition();
+        expected += p.x >= 790.0 && p.x <= 1110.0 && p.y >= -110.0 &&
+                    p.y <= 210.0;
+    }
+    assert(expected > 0 && expected < vehicles.size() / 2);
+    std::vector<double> rows(vehicles.size() * NUM_STATE_COLUMNS);
+    assert(filter.exportVisibleStates(viewport, rows.data(),
+                                      vehicles.size()) == expected);
+    for (std::size_t i = 0; i < expected; ++i) {
+        const double *row = rows.data() + i * NUM_STATE_COLUMNS;
+        assert(row[STATE_VEHICLE_INDEX] == static_cast<double>(i));
+        assert(row[STATE_X] >= 790.0 && row[STATE_Y] <= 210.0);
+    }
+    // The vehicles beyond the rows are counted
+    assert(filter.exportVisibleStates(viewport, rows.data(), 1) == expected);
+
+    // Zoomed out, the counts by tile hold all the vehicles
+    viewport.min_x = -200.0;
+    viewport.min_y = -200.0;
+    viewport.max_x = 7000.0;
+    viewport.max_y = 7000.0;
+    viewport.zoom = 12.0;
+    assert(!filter.isDetailed(viewport));
+    assert(filter.getTileSize(viewport) == 400.0);
+    DensityTiles tiles;
+    filter.exportDensityTiles(viewport, tiles);
+    assert(tiles.tile_size == 400.0 && tiles.origin_x == -400.0);
+    assert(tiles.counts.size() == tiles.columns * tiles.rows);
+    std::size_t total = 0;
+    for (std::uint32_t count : tiles.counts) {
+        total += count;
+    }
+    assert(total == vehicles.size());
+    // The tile of the far vehicle, at (5500, 5000)
+    const std::size_t tile = 13 * tiles.columns + 14;
+    assert(tiles.counts[tile] == 1 && tiles.mean_speeds[tile] == 5.0f);
+
+    // Too many tiles grow larger
+    ViewportFilter::Config config;
+    config.max_tiles = 16;
+    ViewportFilter coarse({bend, far}, config);
+    coarse.exportDensityTiles(viewport, tiles);
+    assert(tiles.columns * tiles.rows <= 16 && tiles.tile_size > 400.0);
+
+    std::cout << "ViewportFilter tests PASSED" << std::endl;
+}
+
+// Test the R-tree of the road segments against scans of the segments
+void testRoadIndex() {
+    std::cout << "Testing RoadIndex..." << std::endl;
+
+    using namespace jfk::model;
+    // A grid of straight roads, and a zigzag crossing it
+    std::vector<std::shared_ptr<Road>> roads;
+    for (int i = 0; i < 30; ++i) {
+        roads.push_back(std::make_shared<Road>(
+            "h" + std::to_string(i), Point2D(0.0, i * 100.0),
+            Point2D(2900.0, i * 100.0 + 7.0)));
+        roads.push_back(std::make_shared<Road>(
+            "v" + std::to_string(i), Point2D(i * 100.0 + 3.0, 0.0),
+            Point2D(i * 100.0, 2900.0)));
+    }
+    std::vector<Point2D> zigzag;
+    for (int i = 0; i <= 40; ++i) {
+        zigzag.emplace_back(i * 70.0 + 11.0, (i % 2) * 60.0 + 1200.0);
+    }
+    roads.push_back(std::make_shared<Road>("zigzag", zigzag));
+    RoadIndex index(roads);
+    assert(index.size() == 60 + 40);
+
+    auto squaredDistance = [](const RoadIndex::Segment &segment,
+                              const Point2D &p) {
+        const Point2D d = segment.end - segment.start;
+        double t = (p - segment.start).dot(d) / d.dot(d);
+        t = std::max(0.0, std::min(1.0, t));
+        const Point2D gap = p - (segment.start + d * t);
+        return gap.dot(gap);
+    };
+    std::vector<const RoadIndex::Segment *> all;
+    index.query(Point2D(-1e9, -1e9), Point2D(1e9, 1e9), all);
+    assert(all.size() == index.size());
+
+    std::uint64_t state = 12345;
+    auto next = [&state]() {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<double>(state >> 11) / 9007199254740992.0;
+    };
+    for (int k = 0; k < 500; ++k) {
+        const Point2D p(next() * 3200.0 - 150.0, next() * 3200.0 - 150.0);
+        double best = std::numeric_limits<double>::infinity();
+        for (const RoadIndex::Segment *segment : all) {
+            best = std::min(best, squaredDistance(*segment, p));
+        }
+        RoadIndex::Match match;
+        assert(index.nearest(p, match));
+        assert(std::abs(match.distance - std::sqrt(best)) < 1e-9);
+        assert(std::abs(squaredDistance(*match.segment, p) - best) < 1e-6);
+        assert(match.distance_along >= match.segment->offset - 1e-9);
+
+        // A window finds the segments whose boxes meet it
+        const Point2D low(p.x - 120.0, p.y - 80.0);
+        const Point2D high(p.x + 120.0, p.y + 80.0);
+        std::vector<const RoadIndex::Segment *> found;
+        index.query(low, high, found);
+        std::size_t expected = 0;
+        for (const RoadIndex::Segment *segment : all) {
+            if (std::min(segment->start.x, segment->end.x) <= high.x &&
+                std::max(segment->start.x, segment->end.x) >= low.x &&
+                std::min(segment->start.y, segment->end.y) <= high.y &&
+                std::max(segment->start.y, segment->end.y) >= low.y) {
+                ++expected;
+                assert(std::find(found.begin(), found.end(), segment) !=
+                       found.end());
+            }
+        }
+        assert(found.size() == expected);
+    }
+
+    // Nothing within the maximum distance
+    RoadIndex::Match match;
+    assert(!index.nearest(Point2D(-500.0, -500.0), match, 10.0));
+    assert(index.nearest(Point2D(116.0, 1231.0), match, 10.0));
+    assert(match.segment->road->getId() == "zigzag");
+    assert(match.segment->index == 1);
+    assert(std::abs(match.distance_along - std::hypot(70.0, 60.0) * 1.5) <
+           1.0);
+    auto window = index.getRoadsIn(Point2D(1400.0, 1198.0),
+                                   Point2D(1410.0, 1203.0));
+    assert(window.size() == 3);
+
+    // The lanes project onto their curved road
+    auto lane = roads.back()->getLane(0);
+    const double along = lane->getDistanceAlong(Point2D(116.0, 1231.0));
+    assert(std::abs(along - match.distance_along) < 1e-9);
+
+    // The observations are averaged by road
+    jf::realdata::MapMatcher matcher(index, 5.0);
+    std::vector<jf::realdata::SpeedObservation> observations(3);
+    observations[0].location = Point2D(500.0, 301.0);
+    observations[0].speed_kmh = 40.0;
+    observations[1].location = Point2D(1500.0, 304.0);
+    observations[1].speed_kmh = 60.0;
+    observations[1].source = "probe";
+    observations[2].location = Point2D(-500.0, -500.0);
+    observations[2].speed_kmh = 10.0;
+    std::size_t unmatched = 0;
+    auto speeds = matcher.matchSpeeds(observations, &unmatched);
+    assert(unmatched == 1 && speeds.size() == 1);
+    const auto &h3 = speeds.at("h3");
+    assert(std::abs(h3.speed_kmh - 50.0) < 1e-9);
+    assert(h3.source == "probe");
+    assert(std::abs(h3.free_flow_speed_kmh - 33.3 * 3.6) < 1e-9);
+    assert(std::abs(h3.congestion_level - (1.0 - 50.0 / (33.3 * 3.6))) <
+           1e-9);
+
+    std::cout << "RoadIndex tests PASSED" << std::endl;
+}
+
+// Test the background refreshes of live speeds, with a stand-in source
+void testLiveTrafficFeed() {
+    std::cout << "Testing LiveTrafficFeed..." << std::endl;
+
+    using jfk::model::Point2D;
+    using jf::realdata::TrafficSpeedData;
+    // One road per box requested, named by its corner and the call
+    struct Source : jf::realdata::TrafficDataSource {
+        std::atomic<int> calls{0};
+        std::atomic<bool> failing{false};
+        double speed;
+        explicit Source(double speed) : speed(speed) {}
+        std::unordered_map<std::string, TrafficSpeedData>
+        getTrafficSpeeds(const Point2D &min_point,
+                         const Point2D &) override {
+            const int call = ++calls;
+            if (failing) {
+                throw std::runtime_error("timeout");
+            }
+            TrafficSpeedData data{};
+            data.road_id = std::to_string(static_cast<int>(min_point.x)) +
+                           "," + std::to_string(static_cast<int>(min_point.y));
+            data.speed_kmh = speed + call;
+            return {{data.road_id, data}};
+        }
+        std::vector<jf::realdata::TrafficIncident>
+        getIncidents(const Point2D &, const Point2D &) override {
+            return {};
+        }
+        jf::realdata::WeatherData getWeather(const Point2D &) override {
+            return {};
+        }
+        bool isAvailable() const override { return true; }
+    };
+    auto live = std::make_shared<Source>(100.0);
+    auto estimated = std::make_shared<Source>(10.0);
+
+    jf::realdata::LiveTrafficFeed::Config config;
+    config.tile_size = 1000.0;
+    config.refresh_period_ms = 1.0;
+    jf::realdata::LiveTrafficFeed feed(live, estimated, config);
+    // Two overlapping areas: a row of three tiles, then one more row
+    feed.addArea(Point2D(100.0, 100.0), Point2D(2500.0, 900.0));
+    feed.addArea(Point2D(1500.0, 500.0), Point2D(1600.0, 1200.0));
+    assert(feed.getBoxes().size() == 2);
+    assert(feed.getBoxes()[0].first.x == 0.0 &&
+           feed.getBoxes()[0].second.x == 3000.0);
+    assert(feed.getBoxes()[1].first.x == 1000.0 &&
+           feed.getBoxes()[1].first.y == 1000.0);
+
+    assert(!feed.updateSnapshot() && feed.getSnapshot().empty());
+    feed.refresh();
+    assert(live->calls == 2 && estimated->calls == 0);
+    assert(feed.updateSnapshot() && feed.getSnapshot().size() == 2);
+    assert(feed.getSnapshot().at("0,0").speed_kmh == 101.0);
+
+    // A failing source is replaced by the fallback, which keeps the live
+    // speeds still alive
+    live->failing = true;
+    feed.refresh();
+    assert(feed.getNumFallbacks() == 2 && estimated->calls == 2);
+    assert(feed.updateSnapshot());
+    assert(feed.getSnapshot().at("0,0").speed_kmh == 101.0);
+    live->failing = false;
+
+    // In the background, the reader never waits for the refreshes
+    feed.start();
+    bool thrown = false;
+    try {
+        feed.refresh();
+    } catch (const std::logic_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+    while (feed.getNumRefreshes() < 5) {
+        std::this_thread::yield();
+        feed.updateSnapshot();
+    }
+    feed.stop();
+    feed.updateSnapshot();
+    assert(feed.getSnapshot().at("0,0").speed_kmh > 102.0);
+
+    // The speeds outlive their time to live only until the next refresh
+    config.ttl_ms = 1e-6;
+    jf::realdata::LiveTrafficFeed shortLived(nullptr, estimated, config);
+    shortLived.addArea(Point2D(0.0, 0.0), Point2D(10.0, 10.0));
+    shortLived.refresh();
+    shortLived.addArea(Point2D(5000.0, 0.0), Point2D(5010.0, 10.0));
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    estimated->failing = true;
+    shortLived.refresh();
+    assert(shortLived.updateSnapshot() && shortLived.getSnapshot().empty());
+
+    thrown = false;
+    try {
+        jf::realdata::LiveTrafficFeed none(nullptr, nullptr);
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    std::cout << "LiveTrafficFeed tests PASSED" << std::endl;
+}
+
+// Test the OD matrix
+void testODMatrix() {
+    std::cout << "Testing ODMatrix class..." << std::endl;
+
+    using jfk::model::Point2D;
+    jfk::routing::ODMatrix matrix;
+    matrix.addZone("a", Point2D(0, 0));
+    matrix.addDemand("a", "b", 30.0, 8);
+    matrix.addDemand("b", "a", 10.0, 8);
+    matrix.addDemand("a", "b", 20.0, 8);
+    matrix.addDemand("a", "c", 40.0, 9);
+    assert(matrix.getNumZones() == 3);
+    assert(matrix.getDemand("a", "b", 8) == 50.0);
+    assert(matrix.getDemand("b", "a", 8) == 10.0);
+    assert(matrix.getDemand("a", "c", 8) == 0.0);
+    assert(matrix.getDemand("a", "x", 8) == 0.0);
+    assert(matrix.getTotalDemand(8) == 60.0);
+    matrix.addDemand("c", "a", 60.0, 8);
+    assert(matrix.getTotalDemand(8) == 120.0);
+
+    // Sampled as often as the demand
+    matrix.setSeed(42);
+    std::unordered_map<std::string, int> counts;
+    const int samples = 12000;
+    for (int i = 0; i < samples; ++i) {
+        jfk::routing::ODPair pair = matrix.sampleODPair(8);
+        assert(pair.departure_time >= 8 * 3600.0 &&
+               pair.departure_time < 9 * 3600.0);
+        counts[pair.origin_id + pair.destination_id]++;
+    }
+    assert(counts.size() == 3);
+    assert(std::abs(counts["ab"] - 5000) < 300);
+    assert(std::abs(counts["ba"] - 1000) < 150);
+    assert(std::abs(counts["ca"] - 6000) < 300);
+    bool rejected = false;
+    try {
+        matrix.sampleODPair(10);
+    } catch (const std::runtime_error &) {
+        rejected = true;
+    }
+    assert(rejected);
+
+    // Gravity model, the same in parallel
+    std::unordered_map<std::string, double> populations = {
+        {"z0", 100.0}, {"z1", 200.0}, {"z2", 0.0}};
+    std::unordered_map<std::string, double> attractions = {
+        {"z0", 1.0}, {"z1", 1.0}, {"z2", 3.0}};
+    std::unordered_map<std::string, Point2D> centroids = {
+        {"z0", Point2D(0, 0)}, {"z1", Point2D(1000, 0)},
+        {"z2", Point2D(0, 2000)}};
+    jfk::routing::ODMatrix gravity;
+    gravity.generateSynthetic(populations, attractions, centroids);
+    assert(std::abs(gravity.getTotalDemand() - 300.0) < 1e-9);
+    assert(gravity.getDemand("z2", "z0") == 0.0);
+    assert(gravity.getDemand("z0", "z0") == 0.0);
+    // 100 / 1000^2 and 3 * 100 / 2000^2, i.e. 4 to 3
+    const double ratio =
+        gravity.getDemand("z0", "z1") / gravity.getDemand("z0", "z2");
+    assert(std::abs(ratio - 4.0 / 3.0) < 1e-9);
+    jfk::routing::ODMatrix parallel;
+    parallel.setNumThreads(3);
+    parallel.generateSynthetic(populations, attractions, centroids);
+    for (const auto &origin : centroids) {
+        for (const auto &destination : centroids) {
+            assert(parallel.getDemand(origin.first, destination.first) ==
+                   gravity.getDemand(origin.first, destination.first));
+        }
+    }
+
+    const std::string csv =
+        std::filesystem::temp_directory_path().string() + "/jamfree_od.csv";
+    {
+        std::ofstream out(csv);
+        out << "origin,destination,demand,period\n"
+            << "z0, z1, 5\n"
+            << "z1,z2,2.5,7\n";
+    }
+    const double before = gravity.getDemand("z0", "z1");
+    assert(gravity.loadFromFile(csv));
+    assert(std::abs(gravity.getDemand("z0", "z1") - before - 5.0) < 1e-9);
+    assert(gravity.getDemand("z1", "z2", 7) == 2.5);
+    {
+        std::ofstream out(csv);
+        out << "z0,z1,5\nz1,z2,lots\n";
+    }
+    assert(!parallel.loadFromFile(csv));
+    assert(parallel.getDemand("z1", "z2", 0) ==
+           gravity.getDemand("z1", "z2", 0));
+
+    // Files of several chunks, parsed in parallel, and their caches
+    {
+        std::ofstream out(csv);
+        out << "origin,destination,demand,period\n";
+        for (int i = 0; i < 100000; ++i) {
+            out << "zone" << (i * 7) % 1000 << ",zone" << (i * 13) % 997
+                << "," << 0.5 + i % 3 << "," << i % 4 << "\n";
+        }
+    }
+    const std::string cache = jfk::routing::ODMatrix::getCacheFilename(csv);
+    std::remove(cache.c_str());
+    jfk::routing::ODMatrix sequential;
+    assert(sequential.loadFromFile(csv));
+    jfk::routing::ODMatrix chunked;
+    chunked.setNumThreads(4);
+    assert(chunked.loadFromFile(csv, true));
+    assert(std::filesystem::exists(cache));
+    jfk::routing::ODMatrix cached;
+    assert(cached.loadFromFile(csv, true));
+    assert(sequential.getNumZones() == 1000);
+    for (int period = 0; period < 4; ++period) {
+        assert(sequential.getTotalDemand(period) > 30000.0);
+        assert(chunked.getTotalDemand(period) ==
+               sequential.getTotalDemand(period));
+        assert(cached.getTotalDemand(period) ==
+               sequential.getTotalDemand(period));
+    }
+    assert(chunked.getDemand("zone7", "zone13", 1) ==
+           sequential.getDemand("zone7", "zone13", 1));
+    assert(cached.getDemand("zone7", "zone13", 1) ==
+           sequential.getDemand("zone7", "zone13", 1));
+    // The zones are numbered in the same order
+    chunked.setSeed(3);
+    cached.setSeed(3);
+    sequential.setSeed(3);
+    for (int i = 0; i < 10; ++i) {
+        const auto expected = sequential.sampleODPair(2);
+        assert(chunked.sampleODPair(2).origin_id == expected.origin_id);
+        assert(cached.sampleODPair(2).destination_id ==
+               expected.destination_id);
+    }
+    // A changed file is parsed again
+    {
+        std::ofstream out(csv);
+        out << "a,b,4\n";
+    }
+    jfk::routing::ODMatrix changed;
+    assert(changed.loadFromFile(csv, true));
+    assert(changed.getDemand("a", "b") == 4.0);
+    assert(changed.getNumZones() == 2);
+    std::remove(cache.c_str());
+    std::remove(csv.c_str());
+
+    std::cout << "ODMatrix tests PASSED" << std::endl;
+}
+
+// Test the event-driven traffic control manager
+void testTrafficControl() {
+    std::cout << "Testing TrafficControlManager..." << std::endl;
+
+    using jfk::model::LightPhase;
+    using jfk::model::Point2D;
+    using jfk::model::TrafficLight;
+    jfk::model::TrafficControlManager manager(50.0);
+    const std::vector<TrafficLight::PhaseConfig> phases = {
+        {LightPhase::GREEN, 10.0}, {LightPhase::YELLOW, 2.0},
+        {LightPhase::RED, 8.0}};
+    auto light = std::make_shared<TrafficLight>("light", Point2D(0, 0), phases);
+    TrafficLight ticked("ticked", Point2D(0, 0), phases);
+    manager.addControl(light);
+    for (int i = 0; i < 200; ++i) {
+        manager.addControl(std::make_shared<jfk::model::StopSign>(
+            "stop" + std::to_string(i), Point2D(40.0 * i, 25.0 * (i % 7))));
+    }
+
+    // The light changes at the steps of a light updated at each one, and is
+    // the only control updated, at its changes only
+    std::size_t updates = 0;
+    for (int step = 0; step < 400; ++step) {
+        manager.update(0.25);
+        ticked.update(0.25);
+        assert(light->getCurrentPhase() == ticked.getCurrentPhase());
+        updates += manager.getNumUpdated();
+    }
+    assert(updates == 15); // 100 s of cycles of 20 s, in 3 phases
+    assert(std::abs(manager.getTime() - 100.0) < 1e-9);
+
+    // The grid finds the controls a scan finds
+    for (double radius : {10.0, 60.0, 500.0, 1e9}) {
+        const Point2D position(1000.0, 40.0);
+        std::size_t count = 0;
+        for (const auto &control : manager.getControls()) {
+            count += control->getPosition().distanceTo(position) <= radius;
+        }
+        assert(manager.getControlsNear(position, radius).size() == count);
+    }
+    manager.removeControl("stop25");
+    assert(manager.getControls().size() == 200);
+    assert(manager.getControlsNear(Point2D(1000.0, 100.0), 1.0).empty());
+
+    // An actuated green lasts its minimum without demand, and as long as
+    // vehicles arrive up to its maximum
+    auto lane = std::make_shared<jfk::model::Lane>("lane", 0, 3.5, 1000.0);
+    jfk::model::ActuatedTrafficLight::Timing timing;
+    timing.min_green = 5.0;
+    timing.max_green = 20.0;
+    timing.extension = 2.0;
+    auto actuated = std::make_shared<jfk::model::ActuatedTrafficLight>(
+        "actuated", Point2D(500, 500), phases, timing);
+    actuated->addDetector(lane, 100.0);
+    manager.addControl(actuated);
+    double green = 0.0;
+    while (actuated->getCurrentPhase() == LightPhase::GREEN) {
+        manager.update(0.5);
+        green += 0.5;
+    }
+    assert(std::abs(green - 5.0) < 1e-9);
+    while (actuated->getCurrentPhase() != LightPhase::GREEN) {
+        manager.update(0.5);
+    }
+    // A vehicle over the detector every second
+    std::vector<std::shared_ptr<jfk::model::Vehicle>> vehicles;
+    for (int i = 0; i < 40; ++i) {
+        auto vehicle =
+            std::make_shared<jfk::model::Vehicle>("d" + std::to_string(i));
+        vehicle->setCurrentLane(lane);
+        vehicle->setLanePosition(100.0 - 10.0 * i - 5.0);
+        lane->addVehicle(vehicle);
+        vehicles.push_back(vehicle);
+    }
+    manager.update(0.0); // The detector sees the first vehicle upstream
+    green = 0.0;
+    while (actuated->getCurrentPhase() == LightPhase::GREEN) {
+        for (const auto &vehicle : vehicles) {
+            vehicle->setLanePosition(vehicle->getLanePosition() + 5.0);
+        }
+        lane->sortVehicles();
+        manager.update(0.5);
+        green += 0.5;
+    }
+    assert(std::abs(green - 20.0) < 1e-9);
+    assert(actuated->getDetectors()[0].getCount() == 20);
+
+    std::cout << "TrafficControlManager tests PASSED" << std::endl;
+}
+
+void testDetectorSet() {
+    std::cout << "Testing DetectorSet..." << std::endl;
+
+    // Vehicles 20 m apart, 5 m further at each step of 0.5 s, reporting
+    // speeds of 5 and 20 m/s in turn
+    auto lane = std::make_shared<jfk::model::Lane>("lane", 0, 3.5, 1000.0);
+    std::vector<std::shared_ptr<jfk::model::Vehicle>> vehicles;
+    for (int i = 0; i < 40; ++i) {
+        auto vehicle =
+            std::make_shared<jfk::model::Vehicle>("v" + std::to_string(i));
+        vehicle->setCurrentLane(lane);
+        vehicle->setLanePosition(495.0 - 20.0 * i);
+        vehicle->setSpeed(i % 2 == 0 ? 5.0 : 20.0);
+        lane->addVehicle(vehicle);
+        vehicles.push_back(vehicle);
+    }
+    lane->sortVehicles();
+    const auto run = [&](jfk::model::DetectorSet &detectors, int steps) {
+        for (int step = 0; step < steps; ++step) {
+            for (const auto &vehicle : vehicles) {
+                vehicle->setLanePosition(vehicle->getLanePosition() + 5.0);
+            }
+            lane->sortVehicles();
+            detectors.update(0.5);
+        }
+    };
+
+    jfk::model::DetectorSet detectors(10.0);
+    assert(detectors.addDetector(lane, 500.0) == 0);
+    assert(detectors.addDetector(lane, 900.0) == 1);
+    detectors.update(0.0); // The detectors see the vehicles upstream
+    run(detectors, 30);
+    assert(detectors.getCurrentCount(0) == 3);
+
+    jfk::model::DetectorReports reports;
+    detectors.exportReports(reports);
+    assert(reports.num_detectors == 2 && reports.getNumPeriods() == 1);
+    assert(std::abs(reports.period_end[0] - 10.0) < 1e-9);
+    assert(reports.counts[0] == 5); // Vehicles 0, 2 and 4 at 5 m/s
+    assert(std::abs(reports.mean_speed[0] - 11.0f) < 1e-5f);
+    assert(std::abs(reports.harmonic_speed[0] - 5.0f / 0.7f) < 1e-5f);
+    assert(std::abs(reports.occupancy[0] - 0.5f) < 1e-6f);
+    assert(reports.counts[1] == 0 && reports.occupancy[1] == 0.0f);
+    assert(std::isnan(reports.mean_speed[1]));
+    assert(std::isnan(reports.harmonic_speed[1]));
+
+    run(detectors, 10);
+    detectors.exportReports(reports);
+    assert(reports.getNumPeriods() == 1);
+    assert(std::abs(reports.period_end[0] - 20.0) < 1e-9);
+    assert(reports.counts[0] == 5); // Vehicles 5, 7 and 9 at 20 m/s
+    assert(std::abs(reports.mean_speed[0] - 14.0f) < 1e-5f);
+    assert(std::abs(reports.harmonic_speed[0] - 5.0f / 0.55f) < 1e-5f);
+    detectors.exportReports(reports);
+    assert(reports.getNumPeriods() == 0);
+
+    // Many detectors measure the same in parallel
+    jfk::model::DetectorSet serial(5.0);
+    jfk::model::DetectorSet parallel(5.0);
+    parallel.setNumThreads(4);
+    for (int i = 0; i < 1000; ++i) {
+        serial.addDetector(lane, 600.0 + 0.7 * i, 1.5);
+        parallel.addDetector(lane, 600.0 + 0.7 * i, 1.5);
+    }
+    jfk::model::DetectorReports serial_reports;
+    jfk::model::DetectorReports parallel_reports;
+    for (int step = 0; step < 40; ++step) {
+        for (const auto &vehicle : vehicles) {
+            vehicle->setLanePosition(vehicle->getLanePosition() + 5.0);
+        }
+        lane->sortVehicles();
+        serial.update(0.5);
+        parallel.update(0.5);
+    }
+    serial.exportReports(serial_reports);
+    parallel.exportReports(parallel_reports);
+    assert(serial_reports.getNumPeriods() == 4);
+    assert(serial_reports.counts == parallel_reports.counts);
+    assert(serial_reports.occupancy == parallel_reports.occupancy);
+
+    bool thrown = false;
+    try {
+        jfk::model::DetectorSet invalid(0.0);
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    assert(thrown);
+    thrown = false;
+    try {
+        detectors.addDetector(nullptr, 0.0);
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    std::cout << "DetectorSet tests PASSED" << std::endl;
+}
+
 // Test IDM (Intelligent Driver Model)
+void testJunction() {
+    std::cout << "Testing Junction..." << std::endl;
+
+    using jfk::model::Junction;
+    using jfk::model::Point2D;
+    using jfk::model::Road;
+
+    // A crossroads: from the west and the south, to the east and the north
+    auto west = std::make_shared<Road>("west", Point2D(-100.0, 0.0),
+                                       Point2D(-10.0, 0.0), 1, 3.5);
+    auto east = std::make_shared<Road>("east", Point2D(10.0, 0.0),
+                                       Point2D(100.0, 0.0), 1, 3.5);
+    auto south = std::make_shared<Road>("south", Point2D(0.0, -100.0),
+                                        Point2D(0.0, -10.0), 1, 3.5);
+    auto north = std::make_shared<Road>("north", Point2D(0.0, 10.0),
+                                        Point2D(0.0, 100.0), 1, 3.5);
+    Junction junction("crossroads");
+    const std::size_t through =
+        junction.addMovement(west->getLane(0), east->getLane(0));
+    const std::size_t crossing =
+        junction.addMovement(south->getLane(0), north->getLane(0));
+    // Turning left from the west, behind the through vehicles
+    const auto entry = west->getLane(0)->getPositionAt(west->getLength());
+    const auto exit = north->getLane(0)->getPositionAt(0.0);
+    const std::size_t left = junction.addMovement(
+        west->getLane(0), north->getLane(0),
+        {entry, Point2D(exit.x, entry.y), exit});
+
+    // The through paths cross, the crossing and the left turn merge
+    assert(junction.getNumMovements() == 3);
+    assert(junction.getNumZones() == 2);
+    assert(!junction.getZone(0).merge && junction.getZone(1).merge);
+    assert(junction.getMovement(through).crossings.size() == 1);
+    assert(junction.getMovement(left).crossings.size() == 1);
+    const auto &crossings = junction.getMovement(crossing).crossings;
+    assert(crossings.size() == 2 && crossings[0].entry < crossings[1].entry);
+    assert(std::abs(junction.getMovement(through).length - 20.0) < 1e-9);
+    const auto &zone = junction.getZone(0);
+    assert(std::abs(zone.position.y - entry.y) < 1e-9);
+    assert(std::abs(zone.position.x - exit.x) < 1e-9);
+    assert(junction.findMovement(*south->getLane(0), *north->getLane(0)) ==
+           crossing);
+    assert(junction.findMovement(*south->getLane(0), *east->getLane(0)) ==
+           Junction::NONE);
+
+    // A vehicle through holds the zone; a crossing one waits for it
+    const double speed = 10.0;
+    const double length = 5.0;
+    const double gap = 1.0;
+    assert(junction.reserve(through, "a", 0.0, speed, length, gap));
+    assert(!junction.isGapAcceptable(crossing, "b", 0.0, speed, length, gap));
+    assert(junction.isGapAcceptable(through, "a", 0.0, speed, length, gap));
+    const double wait =
+        junction.findEntryTime(crossing, "b", 0.0, speed, length, gap);
+    assert(wait > 1.0);
+    assert(junction.isGapAcceptable(crossing, "b", wait, speed, length, gap));
+    assert(!junction.isGapAcceptable(crossing, "b", wait - 0.05, speed,
+                                     length, gap));
+    assert(!junction.reserve(crossing, "b", 0.0, speed, length, gap));
+    assert(junction.reserve(crossing, "b", wait, speed, length, gap));
+    assert(junction.getNumReservations() == 3);
+
+    // The left turn, clear of a, merges before b or after it
+    assert(junction.isGapAcceptable(left, "c", 0.0, speed, length, gap));
+    const double turn =
+        junction.findEntryTime(left, "c", 1.0, speed, length, gap);
+    assert(turn > wait);
+    assert(junction.reserve(left, "c", turn, speed, length, gap));
+    // Reserving again replaces the former times
+    assert(junction.reserve(left, "c", turn + 5.0, speed, length, gap));
+    assert(junction.getNumReservations() == 4);
+
+    junction.release(crossing, "b");
+    assert(junction.getNumReservations() == 2);
+    assert(junction.isGapAcceptable(crossing, "b", wait, speed, length, gap));
+    assert(junction.findEntryTime(left, "d", 0.0, speed, length, gap) == 0.0);
+    junction.expire(1e3);
+    assert(junction.getNumReservations() == 0);
+
+    bool thrown = false;
+    try {
+        junction.addMovement(west->getLane(0), east->getLane(0), {entry});
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    std::cout << "Junction tests PASSED" << std::endl;
+}
+
 void testIDM() {
     std::cout << "Testing IDM class..." << std::endl;
 
@@ -171,77 +1540,815 @@ void testIDM() {
     double desired_gap = idm.calculateDesiredGap(20.0, 5.0); // 20 m/s, approaching at 5 m/s
     assert(desired_gap > 2.0); // Should be greater than minimum gap
 
+    // The batch matches the scalar model, for the exponent 4 and others
+    const double speeds[] = {0.0, 12.0, 20.0, 35.0};
+    const double gaps[] = {5.0, std::numeric_limits<double>::infinity(), 10.0, 40.0};
+    const double speed_diffs[] = {-1.0, 0.0, 5.0, -3.0};
+    double accels[4];
+    for (double delta : {4.0, 2.5}) {
+        idm.setAccelExponent(delta);
+        idm.computeAccelerations(speeds, gaps, speed_diffs, accels, 4);
+        for (int i = 0; i < 4; ++i) {
+            double expected = idm.calculateAcceleration(speeds[i], gaps[i], speed_diffs[i]);
+            assert(std::abs(accels[i] - expected) < 1e-12);
+        }
+    }
+
     std::cout << "IDM tests PASSED" << std::endl;
 }
 
-// Test MOBIL (Lane-changing model)
-void testMOBIL() {
-    std::cout << "Testing MOBIL class..." << std::endl;
-
-    // Create MOBIL
-    jfm::models::MOBIL mobil(0.5, 0.1, 4.0, 0.3);
+// Test the shared lookup tables of IDMLookup
+void testIDMLookup() {
+    std::cout << "Testing IDMLookup class..." << std::endl;
 
-    // Create road with lanes
-    jfk::model::Point2D start(0.0, 0.0);
-    jfk::model::Point2D end(1000.0, 0.0);
-    jfk::model::Road road("test_road", start, end, 3, 3.5);
+    jfm::models::IDMLookup car(30.0, 1.5, 2.0, 1.0, 1.5, 4.0);
+    jfm::models::IDMLookup other_car(30.0, 1.5, 2.0, 1.0, 1.5, 4.0);
+    jfm::models::IDMLookup truck(22.0, 2.0, 4.0, 0.5, 1.0, 4.0);
 
-    auto lane1 = road.getLane(1); // Middle lane
+    // The cars share one table, the trucks get their own
+    assert(car.getTable() == other_car.getTable());
+    assert(car.getTable() != truck.getTable());
 
-    // Create ego vehicle
+    // The interpolated accelerations stay close to the exact ones
     jfk::model::Vehicle ego("ego");
-    ego.setCurrentLane(lane1);
-    ego.setLanePosition(500.0);
-    ego.setSpeed(25.0);
+    ego.setSpeed(20.0);
+    ego.setLanePosition(50.0);
+    jfk::model::Vehicle leader("leader");
+    leader.setSpeed(18.0);
+    leader.setLanePosition(90.0);
+    for (const jfm::models::IDMLookup *idm : {&car, &truck}) {
+        const jfm::models::IDM &exact = *idm;
+        assert(std::abs(idm->calculateAcceleration(ego, &leader) -
+                        exact.calculateAcceleration(ego, &leader)) < 0.05);
+        assert(std::abs(idm->calculateAcceleration(ego, nullptr) -
+                        exact.calculateAcceleration(ego, nullptr)) < 0.01);
+    }
 
-    // Test lane change decision with empty lanes
-    jfm::models::IDM idm;
-    auto decision = mobil.decideLaneChange(ego, *lane1, nullptr, nullptr, idm);
+    std::cout << "IDMLookup tests PASSED" << std::endl;
+}
 
-    // Should return NONE (no adjacent lanes to change to)
-    assert(decision == jfm::models::MOBIL::Direction::NONE);
+// Test the structure-of-arrays step of a lane against the per-vehicle one
+void testLaneVehicleStore() {
+    std::cout << "Testing LaneVehicleStore class..." << std::endl;
 
-    std::cout << "MOBIL tests PASSED" << std::endl;
-}
+    jfk::model::Lane lane("lane", 0, 3.5, 1000.0);
+    std::vector<std::shared_ptr<jfk::model::Vehicle>> vehicles;
+    std::vector<jfk::model::Vehicle> expected;
+    const double positions[] = {0.0, 20.0, 20.0, 45.0};
+    const double speeds[] = {25.0, 20.0, 18.0, 15.0};
+    for (int i = 0; i < 4; ++i) {
+        auto vehicle = std::make_shared<jfk::model::Vehicle>("v" + std::to_string(i));
+        vehicle->setLanePosition(positions[i]);
+        vehicle->setSpeed(speeds[i]);
+        vehicles.push_back(vehicle);
+        expected.push_back(*vehicle);
+        lane.addVehicle(vehicle);
+    }
 
-// Test MathTools
-void testMathTools() {
-    std::cout << "Testing MathTools class..." << std::endl;
+    jfm::models::IDM idm(30.0, 1.5, 2.0, 1.0, 1.5, 4.0);
+    auto parameters = idm.getDriverParameters();
+    jfk::model::LaneVehicleStore store;
+    for (const auto &vehicle : lane.getVehicles()) {
+        store.add(*vehicle, &parameters);
+    }
+    assert(store.size() == 4);
+    store.computeAccelerations();
+    store.integrate(0.1);
+    store.scatter();
 
-    // Test square function
-    assert(jfk::tools::MathTools::square(3.0) == 9.0);
-    assert(jfk::tools::MathTools::square(-2.0) == 4.0);
-    assert(jfk::tools::MathTools::square(0.0) == 0.0);
+    // The leaders are the vehicles strictly ahead, v3 for both v1 and v2
+    const int leaders[] = {1, 3, 3, -1};
+    for (int i = 0; i < 4; ++i) {
+        const jfk::model::Vehicle *leader =
+            leaders[i] < 0 ? nullptr : &expected[leaders[i]];
+        double accel = idm.calculateAcceleration(expected[i], leader);
+        auto &reference = expected[i];
+        reference.update(0.1, accel);
+    }
+    for (int i = 0; i < 4; ++i) {
+        assert(std::abs(vehicles[i]->getSpeed() - expected[i].getSpeed()) < 1e-9);
+        assert(std::abs(vehicles[i]->getLanePosition() -
+                        expected[i].getLanePosition()) < 1e-9);
+        assert(std::abs(vehicles[i]->getAcceleration() -
+                        expected[i].getAcceleration()) < 1e-9);
+    }
 
-    // Test clamp
-    assert(jfk::tools::MathTools::clamp(5.0, 0.0, 10.0) == 5.0);
-    assert(jfk::tools::MathTools::clamp(-5.0, 0.0, 10.0) == 0.0);
-    assert(jfk::tools::MathTools::clamp(15.0, 0.0, 10.0) == 10.0);
+    // A vehicle that is not integrated only leads the others
+    store.clear();
+    store.add(*vehicles[2], &parameters);
+    store.add(*vehicles[3], nullptr, false);
+    const double position = vehicles[3]->getLanePosition();
+    store.computeAccelerations();
+    store.integrate(0.1);
+    store.scatter();
+    assert(store.getAccelerations()[1] == 0.0);
+    assert(vehicles[3]->getLanePosition() == position);
 
-    std::cout << "MathTools tests PASSED" << std::endl;
+    std::cout << "LaneVehicleStore tests PASSED" << std::endl;
 }
 
-// Test GeometryTools (simplified)
-void testGeometryTools() {
-    std::cout << "Testing GeometryTools class..." << std::endl;
+// Test the car-following models selected at compile time
+void testCarFollowingModel() {
+    std::cout << "Testing CarFollowingModel..." << std::endl;
+    namespace models = jfm::models;
 
-    jfk::model::Point2D p1(0.0, 0.0);
-    jfk::model::Point2D p2(3.0, 4.0);
+    const double inf = std::numeric_limits<double>::infinity();
+    const double v[] = {20.0, 25.0, 10.0, 30.0, 0.0};
+    const double gap[] = {15.0, 40.0, inf, 5.0, 2.5};
+    const double dv[] = {5.0, -2.0, 0.0, 8.0, -1.0};
+    const std::size_t n = 5;
 
-    // Test that the class exists and basic functionality works
-    // (Distance function signature may vary, so we'll test basic structure)
+    // The batches match the raw values, the emergency braking of IDM+ and
+    // the tables of IDMLookup included
+    models::IDM idm(30.0, 1.5, 2.0, 1.0, 1.5, 4.0);
+    models::IDMPlus plus(30.0, 1.5, 2.0, 1.0, 1.5, 4.0);
+    models::IDMLookup lookup(30.0, 1.5, 2.0, 1.0, 1.5, 4.0);
+    const models::CarFollowingModel fleet[] = {idm, plus, lookup};
+    double out[n];
+    for (const auto &model : fleet) {
+        models::computeAccelerations(model, v, gap, dv, out, n);
+        for (std::size_t i = 0; i < n; ++i) {
+            const double expected =
+                models::calculateAcceleration(model, v[i], gap[i], dv[i]);
+            assert(std::abs(out[i] - expected) < 1e-9);
+        }
+        assert(models::getParameters(model).getDesiredSpeed() == 30.0);
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+        assert(plus.calculateAcceleration(v[i], gap[i], dv[i]) <=
+               idm.calculateAcceleration(v[i], gap[i], dv[i]));
+    }
+    assert(plus.calculateAcceleration(10.0, inf, 0.0) ==
+           idm.calculateAcceleration(10.0, inf, 0.0));
+    assert(lookup.calculateAcceleration(10.0, inf, 0.0) ==
+           lookup.getTable()->freeFlowAccel(10.0));
 
-    std::cout << "GeometryTools basic structure tests PASSED" << std::endl;
-}
+    // The single-precision batches round the double ones
+    float v32[n], gap32[n], dv32[n], out32[n];
+    for (std::size_t i = 0; i < n; ++i) {
+        v32[i] = static_cast<float>(v[i]);
+        gap32[i] = static_cast<float>(gap[i]);
+        dv32[i] = static_cast<float>(dv[i]);
+    }
+    for (const auto &model : fleet) {
+        models::computeAccelerations(model, v, gap, dv, out, n);
+        std::visit([&](const auto &m) {
+            m.computeAccelerations(v32, gap32, dv32, out32, n);
+        }, model);
+        for (std::size_t i = 0; i < n; ++i) {
+            assert(std::abs(out32[i] - out[i]) <=
+                   1e-5 * std::max(1.0, std::abs(out[i])));
+        }
+    }
 
-// Test FastMath (simplified)
-void testJamFreeFastMath() {
+    // The object and raw-value forms of IDM+ agree
+    jfk::model::Vehicle follower("follower");
+    jfk::model::Vehicle leader("leader");
+    follower.setLanePosition(0.0);
+    follower.setSpeed(20.0);
+    leader.setLanePosition(12.0);
+    leader.setSpeed(5.0);
+    assert(std::abs(plus.calculateAcceleration(follower, &leader) -
+                    plus.calculateAcceleration(
+                        20.0, follower.getGapTo(leader),
+                        follower.getRelativeSpeedTo(leader))) < 1e-12);
+
+    // A lane pass instantiated for the IDM matches the one over the driver
+    // parameters, and leaves the vehicles without driver alone
+    jfk::model::Lane lane("lane", 0, 3.5, 1000.0);
+    const double positions[] = {0.0, 20.0, 20.0, 45.0, 80.0};
+    for (int i = 0; i < 5; ++i) {
+        auto vehicle = std::make_shared<jfk::model::Vehicle>("v" + std::to_string(i));
+        vehicle->setLanePosition(positions[i]);
+        vehicle->setSpeed(v[i]);
+        lane.addVehicle(vehicle);
+    }
+    auto parameters = idm.getDriverParameters();
+    jfk::model::LaneVehicleStore store;
+    for (const auto &vehicle : lane.getVehicles()) {
+        store.add(*vehicle, vehicle->getId() == "v4" ? nullptr : &parameters);
+    }
+    store.computeAccelerations();
+    std::vector<double> expected(store.getAccelerations().begin(),
+                                 store.getAccelerations().end());
+    store.computeAccelerations(idm);
+    // Both passes round to the precision of the build
+    const double tolerance =
+        std::is_same_v<jfk::model::LaneVehicleStore::Value, float> ? 1e-4
+                                                                   : 1e-9;
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        assert(std::abs(store.getAccelerations()[i] - expected[i]) <
+               tolerance);
+    }
+    assert(store.getAccelerations()[4] == 0.0);
+    models::computeAccelerations(fleet[1], store);
+    assert(store.getAccelerations()[4] == 0.0);
+    for (std::size_t i = 0; i < 4; ++i) {
+        assert(store.getAccelerations()[i] <= expected[i] + tolerance);
+    }
+
+    std::cout << "CarFollowingModel tests PASSED" << std::endl;
+}
+
+// Test the flattening of the DMS trees
+namespace {
+// A leaf recording its calls, handling the situation or not
+class RecordingDMS : public jfm::decision::IDecisionMicroSubmodel {
+public:
+    RecordingDMS(int id, std::vector<int> &log) : id(id), log(log) {}
+
+    bool manageDecision(jfk::agents::SimulationTimeStamp,
+                        jfk::agents::SimulationTimeStamp,
+                        const jfm::agents::VehiclePublicLocalStateMicro &,
+                        const jfm::agents::VehiclePrivateLocalStateMicro &,
+                        const jfm::agents::VehiclePerceivedDataMicro &,
+                        const jfk::agents::GlobalState &,
+                        jfk::agents::InfluencesMap &) override {
+        log.push_back(id);
+        return handles;
+    }
+
+    int id;
+    bool handles = false;
+    std::vector<int> &log;
+};
+
+class NoGlobalState : public jfk::agents::GlobalState {
+public:
+    std::shared_ptr<jfk::agents::GlobalState> clone() const override {
+        return std::make_shared<NoGlobalState>(*this);
+    }
+};
+} // namespace
+
+void testDecisionProgram() {
+    std::cout << "Testing DecisionProgram..." << std::endl;
+    namespace dms = jfm::decision::dms;
+
+    // Conjunction(Subsumption(0, 1, Subsumption(2)), Conjunction(3,
+    // Conjunction(4)), Subsumption(), 5)
+    std::vector<int> log;
+    std::vector<std::shared_ptr<RecordingDMS>> leaves;
+    for (int i = 0; i < 6; ++i) {
+        leaves.push_back(std::make_shared<RecordingDMS>(i, log));
+    }
+    auto priority = std::make_shared<dms::SubsumptionDMS>();
+    priority->addSubmodel(leaves[0]);
+    priority->addSubmodel(leaves[1]);
+    auto nested_priority = std::make_shared<dms::SubsumptionDMS>();
+    nested_priority->addSubmodel(leaves[2]);
+    priority->addSubmodel(nested_priority);
+    auto all = std::make_shared<dms::ConjunctionDMS>();
+    all->addSubmodel(leaves[3]);
+    auto nested_all = std::make_shared<dms::ConjunctionDMS>();
+    nested_all->addSubmodel(leaves[4]);
+    all->addSubmodel(nested_all);
+    auto root = std::make_shared<dms::ConjunctionDMS>();
+    root->addSubmodel(priority);
+    root->addSubmodel(all);
+    root->addSubmodel(std::make_shared<dms::SubsumptionDMS>());
+    root->addSubmodel(leaves[5]);
+
+    auto program = jfm::decision::DecisionProgram::compile(root);
+    assert(program->getLeafCount() == 6);
+    assert(program->getRoot() == root);
+
+    jfm::agents::VehiclePublicLocalStateMicro public_state("v");
+    jfm::agents::VehiclePrivateLocalStateMicro private_state("v");
+    jfm::agents::VehiclePerceivedDataMicro perceived;
+    NoGlobalState global;
+    jfk::agents::InfluencesMap influences;
+    const jfk::agents::SimulationTimeStamp t0(0), t1(1);
+
+    // The same leaves are called in the same order, with the same outcome,
+    // whichever leaves handle the situation
+    for (int mask = 0; mask < 64; ++mask) {
+        for (int i = 0; i < 6; ++i) {
+            leaves[i]->handles = (mask >> i) & 1;
+        }
+        log.clear();
+        const bool expected = root->manageDecision(
+            t0, t1, public_state, private_state, perceived, global, influences);
+        const std::vector<int> expected_log = log;
+        log.clear();
+        const bool handled = program->execute(
+            t0, t1, public_state, private_state, perceived, global, influences);
+        assert(handled == expected);
+        assert(log == expected_log);
+    }
+
+    // The root alone, and the subsumption of a subsumption
+    auto leaf_program = jfm::decision::DecisionProgram::compile(leaves[1]);
+    assert(leaf_program->size() == 1);
+    auto priority_program =
+        jfm::decision::DecisionProgram::compile(priority);
+    assert(priority_program->getLeafCount() == 3);
+    for (int mask = 0; mask < 8; ++mask) {
+        for (int i = 0; i < 3; ++i) {
+            leaves[i]->handles = (mask >> i) & 1;
+        }
+        log.clear();
+        const bool handled = priority_program->execute(
+            t0, t1, public_state, private_state, perceived, global, influences);
+        assert(handled == (mask != 0));
+        // Stops at the first leaf handling it
+        int first = 0;
+        while (first < 2 && !((mask >> first) & 1)) {
+            ++first;
+        }
+        assert(log.back() == first);
+    }
+
+    // A lane of vehicles in one call
+    std::vector<jfm::decision::DecisionProgram::Inputs> vehicles(
+        3, {&public_state, &private_state, &perceived});
+    leaves[5]->handles = true;
+    log.clear();
+    assert(program->executeAll(t0, t1, vehicles, global, influences) == 3);
+    assert(log.size() % 3 == 0);
+
+    jfm::decision::VehicleDecisionModelMicro decision_model(program);
+    assert(decision_model.getRootDMS() == root.get());
+    assert(decision_model.getProgram() == program);
+
+    bool thrown = false;
+    try {
+        jfm::decision::DecisionProgram::compile(nullptr);
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    std::cout << "DecisionProgram tests PASSED" << std::endl;
+}
+
+// Test the perception of whole lanes into plain records
+void testLanePerception() {
+    std::cout << "Testing lane perception..." << std::endl;
+    using Record = jfm::agents::VehiclePerceivedRecordMicro;
+
+    jfk::model::Road road("road", jfk::model::Point2D(0.0, 0.0),
+                          jfk::model::Point2D(1000.0, 0.0), 3, 3.5);
+    road.getLane(1)->setSpeedLimit(25.0);
+    for (int i = 0; i < 40; ++i) {
+        auto lane = road.getLane(i % 3);
+        auto vehicle = std::make_shared<jfk::model::Vehicle>("v" + std::to_string(i));
+        // Some vehicles level with others, on their lane or the next
+        vehicle->setLanePosition(std::fmod(37.0 * i, 900.0) - (i % 7 == 0 ? 0.0 : 0.5 * (i % 3)));
+        vehicle->setSpeed(10.0 + i % 9);
+        vehicle->setCurrentLane(lane);
+        lane->addVehicle(vehicle);
+    }
+    for (const auto &lane : road.getLanes()) {
+        lane->sortVehicles();
+    }
+
+    const double range = 100.0;
+    jfm::perception::VehiclePerceptionModelMicro perception(range);
+    std::vector<std::vector<Record>> records;
+    perception.perceiveRoad(road, records);
+    assert(records.size() == 3);
+
+    // The same neighbours as the searches of the spatial indexes
+    auto check = [&](const jfk::model::Vehicle &vehicle,
+                     const jfk::model::Lane *lane,
+                     const Record::Neighbours &neighbours) {
+        const double position = vehicle.getLanePosition();
+        if (!lane) {
+            assert(neighbours.leader == Record::NONE);
+            assert(neighbours.follower == Record::NONE);
+            assert(std::isinf(neighbours.gap_to_leader));
+            return;
+        }
+        const auto &others = lane->getVehicles();
+        const auto *ahead = lane->getSpatialIndex().findAhead(position);
+        if (ahead && vehicle.getGapTo(**ahead) < range) {
+            assert(neighbours.leader != Record::NONE);
+            assert(others[neighbours.leader] == *ahead);
+            assert(neighbours.gap_to_leader == vehicle.getGapTo(**ahead));
+            assert(neighbours.leader_relative_speed ==
+                   vehicle.getRelativeSpeedTo(**ahead));
+        } else {
+            assert(neighbours.leader == Record::NONE);
+            assert(std::isinf(neighbours.gap_to_leader));
+        }
+        const auto *behind = lane->getSpatialIndex().findBehind(position);
+        if (behind && (*behind)->getGapTo(vehicle) < range) {
+            assert(neighbours.follower != Record::NONE);
+            assert(others[neighbours.follower] == *behind);
+            assert(neighbours.gap_to_follower == (*behind)->getGapTo(vehicle));
+        } else {
+            assert(neighbours.follower == Record::NONE);
+        }
+    };
+    std::size_t leaders = 0;
+    for (int i = 0; i < 3; ++i) {
+        const auto &vehicles = road.getLane(i)->getVehicles();
+        assert(records[i].size() == vehicles.size());
+        for (std::size_t k = 0; k < vehicles.size(); ++k) {
+            const Record &record = records[i][k];
+            check(*vehicles[k], road.getLane(i).get(), record.current());
+            check(*vehicles[k], i > 0 ? road.getLane(i - 1).get() : nullptr,
+                  record.left());
+            check(*vehicles[k], i < 2 ? road.getLane(i + 1).get() : nullptr,
+                  record.right());
+            assert(record.has_left_lane == (i > 0));
+            assert(record.has_right_lane == (i < 2));
+            assert(record.speed_limit == road.getLane(i)->getSpeedLimit());
+            assert(record.distance_to_lane_end ==
+                   road.getLane(i)->getLength() - vehicles[k]->getLanePosition());
+            leaders += record.current().leader != Record::NONE ? 1 : 0;
+        }
+    }
+    assert(leaders > 0);
+
+    std::cout << "Lane perception tests PASSED" << std::endl;
+}
+
+// Test the concurrent levels and batched transitions of the coordinator
+void testMultiLevelCoordinator() {
+    std::cout << "Testing MultiLevelCoordinator..." << std::endl;
+    namespace simulation = jfk::simulation;
+    const jfk::agents::LevelIdentifier micro("Microscopic");
+    const jfk::agents::LevelIdentifier macro("Macroscopic");
+    const jfk::agents::LevelIdentifier control("Control");
+
+    auto engine = std::make_shared<simulation::SimulationEngine>();
+    for (int i = 0; i < 8; ++i) {
+        const std::string id = "agent" + std::to_string(i);
+        auto agent = std::make_shared<jfk::agents::VehicleAgent>(id);
+        agent->includeNewLevel(
+            micro, std::make_shared<jfm::agents::VehiclePublicLocalStateMicro>(id),
+            std::make_shared<jfm::agents::VehiclePrivateLocalStateMicro>(id));
+        engine->addAgent(agent);
+    }
+
+    simulation::MultiLevelCoordinator coordinator;
+    coordinator.setSimulationEngine(engine);
+    coordinator.setNumThreads(3);
+    coordinator.addLevel({micro, 0.1, 1, true});
+    coordinator.addLevel({macro, 1.0, 2, true});
+    coordinator.addLevel({control, 1.0, 1});
+
+    // The independent levels run first, possibly at once, then the others
+    std::atomic<int> micro_steps{0};
+    std::atomic<int> macro_steps{0};
+    std::vector<int> seen_by_control;
+    coordinator.setLevelUpdate(
+        micro, [&](const jfk::agents::LevelIdentifier &, double, double dt) {
+            assert(dt == 0.1);
+            ++micro_steps;
+        });
+    coordinator.setLevelUpdate(
+        macro, [&](const jfk::agents::LevelIdentifier &, double, double) {
+            // The vehicles leaving the microscopic area
+            const int step = macro_steps++;
+            coordinator.requestTransition("agent" + std::to_string(2 * step), micro,
+                                          macro);
+            coordinator.requestTransition("agent" + std::to_string(2 * step + 1),
+                                          micro, macro);
+        });
+    coordinator.setLevelUpdate(
+        control, [&](const jfk::agents::LevelIdentifier &, double, double) {
+            seen_by_control.push_back(micro_steps + macro_steps);
+        });
+
+    coordinator.run(4);
+    assert(micro_steps == 4 && macro_steps == 2);
+    assert((seen_by_control == std::vector<int>{2, 3, 5, 6}));
+    assert(coordinator.getPendingTransitionCount() == 0);
+    for (int i = 0; i < 8; ++i) {
+        auto agent = engine->getAgent("agent" + std::to_string(i));
+        assert(agent->hasLevel(macro) == (i < 4));
+        if (i < 4) {
+            auto state = agent->getPublicLocalState(macro);
+            assert(state && state != agent->getPublicLocalState(micro));
+            assert(agent->getPrivateLocalState(macro));
+        }
+    }
+
+    // A batch skips the transitions it cannot apply
+    std::vector<simulation::MultiLevelCoordinator::Transition> batch;
+    for (int i = 4; i < 8; ++i) {
+        batch.emplace_back("agent" + std::to_string(i), micro, macro);
+    }
+    batch.emplace_back("missing", micro, macro);
+    batch.emplace_back("agent0", control, macro);
+    assert(coordinator.transitionAgents(batch) == 4);
+    assert(engine->getAgent("agent7")->hasLevel(macro));
+
+    bool thrown = false;
+    try {
+        coordinator.setLevelUpdate(jfk::agents::LevelIdentifier("Unknown"),
+                                   nullptr);
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    std::cout << "MultiLevelCoordinator tests PASSED" << std::endl;
+}
+
+// Test the parallel perception and decision of the simulation engine
+void testParallelSimulationEngine() {
+    std::cout << "Testing parallel SimulationEngine..." << std::endl;
+    const jfk::agents::LevelIdentifier micro("Microscopic");
+    struct Vehicle {
+        double position;
+        double speed;
+        int lane;
+        bool operator==(const Vehicle &other) const {
+            return position == other.position && speed == other.speed &&
+                   lane == other.lane;
+        }
+    };
+
+    // Enough vehicles for several chunks of 64 agents, behind slow
+    // vehicles so that they brake and change lanes
+    auto run = [&](std::size_t threads) {
+        auto road = std::make_shared<jfk::model::Road>(
+            "road", jfk::model::Point2D(0.0, 0.0),
+            jfk::model::Point2D(5000.0, 0.0), 3, 3.5);
+        for (int i = 0; i < 12; ++i) {
+            auto lane = road->getLane(i % 3);
+            auto slow = std::make_shared<jfk::model::Vehicle>(
+                "slow" + std::to_string(i));
+            slow->setLanePosition(300.0 + 370.0 * i);
+            slow->setSpeed(2.0 + i % 4);
+            slow->setCurrentLane(lane);
+            lane->addVehicle(slow);
+        }
+        for (const auto &lane : road->getLanes()) {
+            lane->sortVehicles();
+        }
+
+        auto engine = std::make_shared<jfk::simulation::SimulationEngine>(0.1);
+        auto reaction =
+            std::make_shared<jfm::reaction::MicroscopicReactionModel>(0.1);
+        reaction->setSimulationEngine(engine.get());
+        engine->setReactionModel(micro, reaction);
+        engine->setNumThreads(threads);
+        for (int i = 0; i < 300; ++i) {
+            const std::string id = "agent" + std::to_string(i);
+            auto agent = std::make_shared<jfk::agents::VehicleAgent>(id);
+            auto state =
+                std::make_shared<jfm::agents::VehiclePublicLocalStateMicro>(id);
+            state->setCurrentLane(road->getLane(i % 3).get());
+            state->setLaneIndex(i % 3);
+            state->setLanePosition(std::fmod(47.0 * i, 4900.0));
+            state->setSpeed(10.0 + i % 11);
+            state->setActive(true);
+            auto memory =
+                std::make_shared<jfm::agents::VehiclePrivateLocalStateMicro>(id);
+            memory->setDesiredSpeed(25.0 + i % 7);
+            auto idm = std::make_shared<jfm::models::IDM>();
+            auto decisions = std::make_shared<jfm::decision::dms::ConjunctionDMS>();
+            decisions->addSubmodel(
+                std::make_shared<jfm::decision::dms::ForwardAccelerationDMS>(idm));
+            decisions->addSubmodel(
+                std::make_shared<jfm::decision::dms::LaneChangeDMS>(
+                    std::make_shared<jfm::models::MOBIL>(), idm));
+            agent->includeNewLevel(micro, state, memory);
+            agent->setModels(
+                micro,
+                std::make_shared<jfm::perception::VehiclePerceptionModelMicro>(
+                    150.0),
+                std::make_shared<jfm::decision::VehicleDecisionModelMicro>(
+                    decisions));
+            engine->addAgent(agent);
+        }
+        engine->run(50);
+
+        std::vector<Vehicle> vehicles;
+        for (const auto &agent : engine->getAgents()) {
+            auto state =
+                std::static_pointer_cast<jfm::agents::VehiclePublicLocalStateMicro>(
+                    agent->getPublicLocalState(micro));
+            vehicles.push_back({state->getLanePosition(), state->getSpeed(),
+                                state->getLaneIndex()});
+        }
+        return vehicles;
+    };
+
+    const auto sequential = run(1);
+    assert(sequential.size() == 300);
+    // The vehicles moved, and some changed lanes
+    std::size_t moved = 0;
+    std::size_t changed = 0;
+    for (std::size_t i = 0; i < sequential.size(); ++i) {
+        moved += sequential[i].position > std::fmod(47.0 * i, 4900.0) ? 1 : 0;
+        changed += sequential[i].lane != static_cast<int>(i % 3) ? 1 : 0;
+    }
+    assert(moved > 0 && changed > 0);
+    assert(run(4) == sequential);
+    assert(run(3) == sequential);
+
+    // A step waits for the queries of the bindings, which share the lock
+    jfk::simulation::SimulationEngine locked;
+    std::shared_lock<std::shared_mutex> query(locked.getAccessMutex());
+    std::atomic<bool> stepped{false};
+    std::thread stepper([&]() {
+        locked.step();
+        stepped = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    assert(!stepped);
+    query.unlock();
+    stepper.join();
+    assert(stepped && locked.getStepCount() == 1);
+
+    std::cout << "Parallel SimulationEngine tests PASSED" << std::endl;
+}
+
+// Test MOBIL (Lane-changing model)
+void testMOBIL() {
+    std::cout << "Testing MOBIL class..." << std::endl;
+
+    // Create MOBIL
+    jfm::models::MOBIL mobil(0.5, 0.1, 4.0, 0.3);
+
+    // Create road with lanes
+    jfk::model::Point2D start(0.0, 0.0);
+    jfk::model::Point2D end(1000.0, 0.0);
+    jfk::model::Road road("test_road", start, end, 3, 3.5);
+
+    auto lane1 = road.getLane(1); // Middle lane
+
+    // Create ego vehicle
+    jfk::model::Vehicle ego("ego");
+    ego.setCurrentLane(lane1);
+    ego.setLanePosition(500.0);
+    ego.setSpeed(25.0);
+
+    // Test lane change decision with empty lanes
+    jfm::models::IDM idm;
+    auto decision = mobil.decideLaneChange(ego, *lane1, nullptr, nullptr, idm);
+
+    // Should return NONE (no adjacent lanes to change to)
+    assert(decision == jfm::models::MOBIL::Direction::NONE);
+
+    // The batched decisions of a road match the per-vehicle ones
+    std::vector<std::shared_ptr<jfk::model::Vehicle>> vehicles;
+    for (int i = 0; i < 60; ++i) {
+        // A dense middle lane, with fast vehicles behind slow ones
+        int index = i % 4 == 0 ? 0 : (i % 4 == 1 ? 2 : 1);
+        auto lane = road.getLane(index);
+        auto vehicle = std::make_shared<jfk::model::Vehicle>("v" + std::to_string(i));
+        vehicle->setLanePosition(8.0 * i + 3.0 * (i % 5));
+        vehicle->setSpeed(8.0 + (i * 7) % 24);
+        vehicle->setCurrentLane(lane);
+        lane->addVehicle(vehicle);
+        vehicles.push_back(vehicle);
+    }
+    std::vector<std::vector<double>> accelerations(3);
+    for (int i = 0; i < 3; ++i) {
+        auto lane = road.getLane(i);
+        for (const auto &vehicle : lane->getVehicles()) {
+            accelerations[i].push_back(
+                idm.calculateAcceleration(*vehicle, lane->getLeader(*vehicle)));
+        }
+    }
+    for (unsigned threads : {1u, 3u}) {
+        std::vector<std::vector<jfm::models::MOBIL::Direction>> decisions;
+        mobil.decideLaneChanges(road, accelerations, idm, decisions, threads);
+        for (int i = 0; i < 3; ++i) {
+            auto lane = road.getLane(i);
+            const auto &lane_vehicles = lane->getVehicles();
+            assert(decisions[i].size() == lane_vehicles.size());
+            for (std::size_t k = 0; k < lane_vehicles.size(); ++k) {
+                auto expected = mobil.decideLaneChange(
+                    *lane_vehicles[k], *lane,
+                    i > 0 ? road.getLane(i - 1).get() : nullptr,
+                    i < 2 ? road.getLane(i + 1).get() : nullptr, idm);
+                assert(decisions[i][k] == expected);
+            }
+        }
+    }
+
+    std::cout << "MOBIL tests PASSED" << std::endl;
+}
+
+// Test the calibration of the driver models
+void testCalibration() {
+    std::cout << "Testing Calibration..." << std::endl;
+    namespace cal = jfm::calibration;
+
+    cal::Scenario scenario;
+    scenario.roads.push_back(std::make_shared<jfk::model::Road>(
+        "highway", jfk::model::Point2D(0.0, 0.0),
+        jfk::model::Point2D(2000.0, 0.0), 2, 3.5));
+    for (int lane = 0; lane < 2; ++lane) {
+        scenario.inflows.push_back({0, lane, 0.4, 20.0});
+        scenario.detectors.push_back({0, lane, 1500.0});
+    }
+    scenario.duration = 180.0;
+
+    // Observations made with known parameters
+    jfm::models::IDM truth;
+    truth.setDesiredSpeed(25.0);
+    truth.setTimeHeadway(1.5);
+    jfm::models::MOBIL mobil;
+    auto observed = cal::simulate(scenario, truth, mobil);
+    assert(observed.num_detectors == 2);
+    assert(observed.getNumPeriods() == 3);
+    std::uint32_t passed = 0;
+    for (std::uint32_t count : observed.counts) {
+        passed += count;
+    }
+    assert(passed > 0);
+
+    // A run only depends on its scenario and models
+    auto again = cal::simulate(scenario, truth, mobil);
+    assert(again.counts == observed.counts);
+    auto objective = cal::detectorError(observed);
+    assert(objective(again) == 0.0);
+
+    cal::Calibrator::Config config;
+    config.max_evaluations = 60;
+    config.num_threads = 3;
+    cal::Calibrator calibrator(
+        scenario,
+        {{"desired_speed", 15.0, 35.0, 18.0}, {"time_headway", 0.8, 2.5, 2.2}},
+        objective, config);
+    const double initial = calibrator.evaluate({18.0, 2.2});
+    assert(initial > 0.0);
+    auto scores = calibrator.evaluateAll({{18.0, 2.2}, {25.0, 1.5}});
+    assert(scores.size() == 2);
+    assert(scores[0] == initial);
+    assert(scores[1] == 0.0);
+
+    auto result = calibrator.run();
+    assert(result.values.size() == 2);
+    assert(result.objective < initial);
+    assert(result.evaluations <= config.max_evaluations + 4);
+    assert(calibrator.evaluate(result.values) == result.objective);
+    for (double value : result.values) {
+        assert(std::isfinite(value));
+    }
+    assert(result.values[0] >= 15.0 && result.values[0] <= 35.0);
+
+    bool thrown = false;
+    try {
+        cal::Calibrator unknown(scenario, {{"speed", 0.0, 1.0, 0.5}}, objective);
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    assert(thrown);
+    thrown = false;
+    try {
+        cal::Calibrator empty(scenario, {{"min_gap", 2.0, 2.0, 2.0}}, objective);
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    std::cout << "Calibration tests PASSED" << std::endl;
+}
+
+// Test MathTools
+void testMathTools() {
+    std::cout << "Testing MathTools class..." << std::endl;
+
+    // Test square function
+    assert(jfk::tools::MathTools::square(3.0) == 9.0);
+    assert(jfk::tools::MathTools::square(-2.0) == 4.0);
+    assert(jfk::tools::MathTools::square(0.0) == 0.0);
+
+    // Test clamp
+    assert(jfk::tools::MathTools::clamp(5.0, 0.0, 10.0) == 5.0);
+    assert(jfk::tools::MathTools::clamp(-5.0, 0.0, 10.0) == 0.0);
+    assert(jfk::tools::MathTools::clamp(15.0, 0.0, 10.0) == 10.0);
+
+    std::cout << "MathTools tests PASSED" << std::endl;
+}
+
+// Test GeometryTools (simplified)
+void testGeometryTools() {
+    std::cout << "Testing GeometryTools class..." << std::endl;
+
+    jfk::model::Point2D p1(0.0, 0.0);
+    jfk::model::Point2D p2(3.0, 4.0);
+
+    // Test that the class exists and basic functionality works
+    // (Distance function signature may vary, so we'll test basic structure)
+
+    std::cout << "GeometryTools basic structure tests PASSED" << std::endl;
+}
+
+// Test FastMath (simplified)
+void testJamFreeFastMath() {
     std::cout << "Testing JamFree FastMath class..." << std::endl;
 
-    // Test sqrt function (most reliable)
-    assert(std::abs(jfk::tools::FastMath::sqrt(4.0) - 2.0) < 1e-9);
-    assert(std::abs(jfk::tools::FastMath::sqrt(9.0) - 3.0) < 1e-9);
-    assert(std::abs(jfk::tools::FastMath::sqrt(0.0) - 0.0) < 1e-9);
+    // The square roots approximate within 1%
+    for (float x : {0.25f, 4.0f, 9.0f, 1e4f}) {
+        assert(std::abs(jfk::tools::FastMath::fastSqrt(x) - std::sqrt(x)) <
+               0.01f * std::sqrt(x));
+        assert(std::abs(jfk::tools::FastMath::fastInvSqrt(x) * std::sqrt(x) -
+                        1.0f) < 0.01f);
+    }
+    assert(jfk::tools::FastMath::fastSqrt(0.0f) == 0.0f);
+    assert(jfk::tools::FastMath::fastPow(2.0, 10) == 1024.0);
+    assert(jfk::tools::FastMath::fastClamp(5.0, 0.0, 1.0) == 1.0);
 
     std::cout << "JamFree FastMath tests PASSED" << std::endl;
 }
@@ -269,7 +2376,1888 @@ void testSpatialIndex() {
     std::cout << "SpatialIndex basic structure tests PASSED" << std::endl;
 }
 
+void testRouter() {
+    std::cout << "Testing Router class..." << std::endl;
+
+    namespace routing = jfk::routing;
+    using jfk::model::Point2D;
+    using jfk::model::Road;
+
+    // A 6x6 grid of two-way streets 100 m apart, at 10 m/s, the ones of
+    // row 1 at 50 m/s
+    const int size = 6;
+    std::vector<std::shared_ptr<Road>> roads;
+    auto addRoad = [&](const Point2D &from, const Point2D &to, double speed) {
+        auto road = std::make_shared<Road>(
+            "road_" + std::to_string(roads.size()), from, to, 1, 3.5);
+        road->getLane(0)->setSpeedLimit(speed);
+        roads.push_back(road);
+    };
+    for (int i = 0; i < size; ++i) {
+        for (int j = 0; j + 1 < size; ++j) {
+            Point2D a(j * 100.0, i * 100.0), b((j + 1) * 100.0, i * 100.0);
+            addRoad(a, b, i == 1 ? 50.0 : 10.0);
+            addRoad(b, a, i == 1 ? 50.0 : 10.0);
+            Point2D c(i * 100.0, j * 100.0), d(i * 100.0, (j + 1) * 100.0);
+            addRoad(c, d, 10.0);
+            addRoad(d, c, 10.0);
+        }
+    }
+
+    auto isAt = [](const Point2D &point, double x, double y) {
+        return point.x == x && point.y == y;
+    };
+
+    routing::Router router;
+    router.preprocess(roads, 4);
+    const routing::RoadGraph &graph = *router.getGraph();
+    assert(graph.getNumNodes() == size * size);
+    assert(graph.getNumEdges() == roads.size());
+    assert(isAt(graph.getPosition(graph.findNearestNode(Point2D(212, 388))),
+                200, 400));
+    assert(isAt(graph.getPosition(graph.findNearestNode(Point2D(-50, 900))),
+                0, 500));
+
+    // The costs of A* with landmarks are the ones of Dijkstra
+    std::vector<double> times;
+    for (std::uint32_t source = 0; source < graph.getNumNodes(); source += 7) {
+        routing::Landmarks::shortestDistances(graph, graph.getTimes(), source,
+                                              false, times);
+        for (std::uint32_t target = 0; target < graph.getNumNodes();
+             ++target) {
+            routing::Route route =
+                router.findRoute(graph.getPosition(source),
+                                 graph.getPosition(target), roads);
+            assert(std::abs(route.cost - times[target]) < 1e-9);
+            assert(route.roads.empty() == (source == target));
+        }
+    }
+
+    // Along the fast row, rather than straight along row 0
+    routing::Route route =
+        router.findRoute(Point2D(0, 0), Point2D(500, 0), roads);
+    assert(std::abs(route.cost - 30.0) < 1e-9);
+    assert(route.roads.size() == 7);
+    assert(route.lane_indices.size() == 7);
+    assert(std::abs(route.total_distance - 700.0) < 1e-9);
+    assert(isAt(route.roads.front()->getStart(), 0, 0));
+    assert(isAt(route.roads.back()->getEnd(), 500, 0));
+
+    // A jam on the fast row
+    std::unordered_map<std::string, double> traffic;
+    for (const auto &road : roads) {
+        if (road->getStart().y == 100.0 && road->getEnd().y == 100.0) {
+            traffic[road->getId()] = 1.0;
+        }
+    }
+    route = router.findRouteWithTraffic(Point2D(0, 0), Point2D(500, 0), roads,
+                                        traffic);
+    assert(std::abs(route.cost - 50.0) < 1e-9);
+    assert(route.roads.size() == 5);
+
+    // A batch gives the routes of the single queries, in parallel too
+    std::vector<routing::ODPair> trips;
+    for (std::uint32_t i = 0; i < graph.getNumNodes(); ++i) {
+        routing::ODPair trip{};
+        trip.origin = graph.getPosition(i);
+        trip.destination =
+            graph.getPosition((i * 7 + 11) % graph.getNumNodes());
+        trips.push_back(trip);
+    }
+    std::vector<double> travel_times(graph.getNumEdges());
+    for (std::size_t r = 0; r < roads.size(); ++r) {
+        const std::uint32_t edge = graph.getEdgeOfRoad(r);
+        const auto it = traffic.find(roads[r]->getId());
+        travel_times[edge] = it == traffic.end()
+                                 ? graph.getTimes()[edge]
+                                 : roads[r]->getLength() / it->second;
+    }
+    for (std::size_t threads : {1, 3}) {
+        router.setNumThreads(threads);
+        std::vector<routing::Route> batch = router.findRoutes(trips, roads);
+        std::vector<routing::Route> jammed =
+            router.findRoutes(trips, roads, travel_times);
+        assert(batch.size() == trips.size() && jammed.size() == trips.size());
+        for (std::size_t i = 0; i < trips.size(); ++i) {
+            route = router.findRoute(trips[i].origin, trips[i].destination,
+                                     roads);
+            assert(batch[i].roads == route.roads);
+            assert(batch[i].cost == route.cost);
+            route = router.findRouteWithTraffic(
+                trips[i].origin, trips[i].destination, roads, traffic);
+            assert(std::abs(jammed[i].cost - route.cost) < 1e-9);
+            assert(std::abs(jammed[i].estimated_time - route.estimated_time) <
+                   1e-9);
+        }
+    }
+    router.setNumThreads(1);
+    bool rejected = false;
+    try {
+        router.findRoutes(trips, roads, std::vector<double>(3, 1.0));
+    } catch (const std::invalid_argument &) {
+        rejected = true;
+    }
+    assert(rejected);
+
+    router.setStrategy(routing::Router::Strategy::SHORTEST_DISTANCE);
+    route = router.findRoute(Point2D(0, 0), Point2D(500, 500), roads);
+    assert(std::abs(route.cost - 1000.0) < 1e-9);
+
+    // Out of reach over a one-way road
+    std::vector<std::shared_ptr<Road>> one_way = {roads[0]};
+    route = router.findRoute(roads[0]->getEnd(), roads[0]->getStart(),
+                             one_way);
+    assert(route.roads.empty() && std::isinf(route.cost));
+
+    std::cout << "Router tests PASSED" << std::endl;
+}
+
+void testRouteTable() {
+    std::cout << "Testing RouteTable class..." << std::endl;
+
+    namespace routing = jfk::routing;
+    using jfk::model::Point2D;
+    using jfk::model::Road;
+
+    // A 4x4 grid of two-way streets 100 m apart
+    const int size = 4;
+    std::vector<std::shared_ptr<Road>> roads;
+    for (int i = 0; i < size; ++i) {
+        for (int j = 0; j + 1 < size; ++j) {
+            const Point2D a(j * 100.0, i * 100.0), b((j + 1) * 100.0, i * 100.0);
+            const Point2D c(i * 100.0, j * 100.0), d(i * 100.0, (j + 1) * 100.0);
+            for (const auto &ends : {std::make_pair(a, b), std::make_pair(b, a),
+                                     std::make_pair(c, d), std::make_pair(d, c)}) {
+                roads.push_back(std::make_shared<Road>(
+                    "road_" + std::to_string(roads.size()), ends.first,
+                    ends.second, 2, 3.5));
+            }
+        }
+    }
+    routing::Router router;
+    router.preprocess(roads, 2);
+    routing::RouteTable table(*router.getGraph());
+    assert(table.size() == 0);
+
+    // The same route interned once, another one apart
+    routing::Route route =
+        router.findRoute(Point2D(0, 0), Point2D(300, 300), roads);
+    assert(route.roads.size() == 6);
+    const auto id = table.intern(route);
+    assert(table.intern(route) == id);
+    assert(table.size() == 1 && table.getNumShared() == 1);
+    assert(table.getNumEdges(id) == 6);
+    assert(table.getTotalDistance(id) == route.total_distance);
+    routing::Route other = route;
+    other.lane_indices[2] = 1;
+    const auto other_id = table.intern(other);
+    assert(other_id != id && table.size() == 2);
+    assert(table.intern(routing::Route()) == routing::RouteTable::NONE);
+
+    // Expanded back into the same roads
+    routing::Route expanded = table.toRoute(other_id);
+    assert(expanded.roads == other.roads);
+    assert(expanded.lane_indices == other.lane_indices);
+    assert(expanded.cost == other.cost);
+
+    // Followed edge by edge
+    routing::RouteProgress progress = routing::RouteTable::begin(other_id);
+    assert(sizeof(progress) == 8);
+    for (std::size_t i = 0; i < other.roads.size(); ++i) {
+        assert(!table.isFinished(progress));
+        assert(table.getCurrentRoad(progress) == other.roads[i].get());
+        assert(table.getCurrentLane(progress) == other.lane_indices[i]);
+        assert(table.advance(progress) == (i + 1 < other.roads.size()));
+    }
+    assert(table.isFinished(progress));
+    assert(table.getCurrentEdge(progress) == routing::RouteTable::NONE);
+    assert(table.getCurrentRoad(progress) == nullptr);
+    progress = routing::RouteTable::begin(id);
+    const std::uint32_t fourth = table.getEdges(id)[3];
+    assert(table.getNextEdge(progress) == table.getEdges(id)[1]);
+    assert(table.advanceTo(progress, fourth) && progress.index == 3);
+    assert(!table.advanceTo(progress, table.getEdges(id)[0]));
+    assert(progress.index == 3);
+
+    // Roads of another network are rejected
+    routing::Route foreign;
+    foreign.roads.push_back(std::make_shared<Road>(
+        "foreign", Point2D(0, 0), Point2D(10, 0), 1, 3.5));
+    bool rejected = false;
+    try {
+        table.intern(foreign);
+    } catch (const std::invalid_argument &) {
+        rejected = true;
+    }
+    assert(rejected);
+
+    // The trips of two OD pairs share two routes
+    routing::ODMatrix matrix;
+    matrix.addZone("a", Point2D(0, 0));
+    matrix.addZone("b", Point2D(300, 300));
+    matrix.addZone("c", Point2D(0, 300));
+    matrix.addDemand("a", "b", 10.0, 0);
+    matrix.addDemand("c", "a", 10.0, 0);
+    matrix.setSeed(7);
+    routing::TripGenerator generator(matrix, router);
+    routing::RouteTable trips_table(*router.getGraph());
+    auto trips = generator.generateTrips(0, 200, roads, trips_table);
+    assert(trips.size() == 200);
+    assert(trips_table.size() == 2 && trips_table.getNumShared() == 198);
+    for (const auto &trip : trips) {
+        const routing::RouteProgress &start = trip.second;
+        assert(start.index == 0 && start.route < 2);
+        const Road *first = trips_table.getCurrentRoad(start);
+        assert(first->getStart().x == trip.first.origin.x &&
+               first->getStart().y == trip.first.origin.y);
+    }
+    auto single = generator.generateTrip(1800.0, roads);
+    assert(single.first.departure_time == 1800.0);
+    assert(!single.second.isEmpty());
+
+    std::cout << "RouteTable tests PASSED" << std::endl;
+}
+
+void testTripStream() {
+    std::cout << "Testing TripStream class..." << std::endl;
+
+    namespace routing = jfk::routing;
+    using jfk::model::Point2D;
+    using jfk::model::Road;
+
+    // A 4x4 grid of two-way streets 100 m apart
+    const int size = 4;
+    std::vector<std::shared_ptr<Road>> roads;
+    for (int i = 0; i < size; ++i) {
+        for (int j = 0; j + 1 < size; ++j) {
+            const Point2D a(j * 100.0, i * 100.0), b((j + 1) * 100.0, i * 100.0);
+            const Point2D c(i * 100.0, j * 100.0), d(i * 100.0, (j + 1) * 100.0);
+            for (const auto &ends : {std::make_pair(a, b), std::make_pair(b, a),
+                                     std::make_pair(c, d), std::make_pair(d, c)}) {
+                roads.push_back(std::make_shared<Road>(
+                    "road_" + std::to_string(roads.size()), ends.first,
+                    ends.second, 1, 3.5));
+            }
+        }
+    }
+    routing::Router router;
+    router.preprocess(roads, 2);
+    routing::RouteTable table(*router.getGraph());
+
+    // A trip per second in the first hour, none in the second
+    routing::ODMatrix matrix;
+    matrix.addZone("a", Point2D(0, 0));
+    matrix.addZone("b", Point2D(300, 300));
+    matrix.addDemand("a", "b", 3600.0, 0);
+    matrix.setSeed(3);
+    routing::TripStream::Config config;
+    config.slice_length = 60.0;
+    config.lookahead = 120.0;
+    config.batch_size = 50;
+    routing::TripStream stream(matrix, router, roads, table, config);
+
+    // Generated as the time goes, a few slices ahead
+    stream.prepare(0.0);
+    assert(stream.getGeneratedTime() == 180.0);
+    assert(stream.getNumPending() > 120 && stream.getNumPending() < 240);
+    std::vector<routing::TripStream::Trip> trips;
+    std::size_t checked = 0;
+    for (double time = 10.0; time <= 4000.0; time += 10.0) {
+        stream.popDue(time, trips);
+        for (; checked < trips.size(); ++checked) {
+            const auto &trip = trips[checked];
+            assert(trip.departure_time <= time && trip.departure_time >= 0.0);
+            assert(checked == 0 ||
+                   trip.departure_time >= trips[checked - 1].departure_time);
+        }
+        assert(stream.getNumPending() < 240);
+    }
+    assert(stream.getNumPending() == 0 && stream.getNumUnrouted() == 0);
+    assert(trips.size() == stream.getNumGenerated());
+    assert(trips.size() >= 3599 && trips.size() <= 3601);
+    assert(table.size() == 1);
+
+    // Injected one by one as the entry of the lane clears
+    routing::ODMatrix single;
+    single.addZone("a", Point2D(0, 0));
+    single.addZone("b", Point2D(300, 0));
+    single.addDemand("a", "b", 360.0, 0);
+    routing::TripStream::Config short_config;
+    short_config.slice_length = 10.0;
+    short_config.lookahead = 0.0;
+    routing::TripStream injector(single, router, roads, table, short_config);
+    auto make = [](const routing::TripStream::Trip &trip,
+                   const std::shared_ptr<jfk::model::Lane> &) {
+        return std::make_shared<jfk::model::Vehicle>(
+            "trip_" + std::to_string(trip.id));
+    };
+    assert(injector.inject(100.0, 8.0, make) == 1);
+    auto lane = table.getGraph().getRoad(table.getCurrentEdge(
+                    routing::RouteTable::begin(table.size() - 1)))->getLane(0);
+    assert(lane->getVehicles().size() == 1);
+    assert(lane->getVehicles().front()->getLanePosition() == 0.0);
+    assert(injector.getNumWaiting() > 5);
+    const std::size_t waiting = injector.getNumWaiting();
+    assert(injector.inject(100.0, 8.0, make) == 0);
+    assert(injector.getNumWaiting() == waiting);
+    lane->getVehicles().front()->setLanePosition(10.0);
+    assert(injector.inject(100.0, 8.0, make) == 1);
+    assert(lane->getVehicles().size() == 2 && injector.getNumInjected() == 2);
+    assert(injector.getNumWaiting() == waiting - 1);
+
+    std::cout << "TripStream tests PASSED" << std::endl;
+}
+
+void testDistributedSimulation() {
+    std::cout << "Testing distributed simulation..." << std::endl;
+
+    namespace routing = jfk::routing;
+    namespace simulation = jfk::simulation;
+    using jfk::model::Point2D;
+    using jfk::model::Road;
+
+    // Two copies of an 8x8 grid of two-way streets of 2 lanes, 200 m apart,
+    // one for each run, as the lanes hold the vehicles
+    const int size = 8;
+    auto makeGrid = [&]() {
+        std::vector<std::shared_ptr<Road>> roads;
+        auto addRoad = [&](const Point2D &from, const Point2D &to) {
+            auto road = std::make_shared<Road>(
+                "road_" + std::to_string(roads.size()), from, to, 2, 3.5);
+            road->getLane(0)->setSpeedLimit(15.0);
+            road->getLane(1)->setSpeedLimit(15.0);
+            roads.push_back(road);
+        };
+        for (int i = 0; i < size; ++i) {
+            for (int j = 0; j + 1 < size; ++j) {
+                Point2D a(j * 200.0, i * 200.0), b((j + 1) * 200.0, i * 200.0);
+                addRoad(a, b);
+                addRoad(b, a);
+                Point2D c(i * 200.0, j * 200.0), d(i * 200.0, (j + 1) * 200.0);
+                addRoad(c, d);
+                addRoad(d, c);
+            }
+        }
+        return roads;
+    };
+    std::vector<std::shared_ptr<Road>> single_roads = makeGrid();
+    std::vector<std::shared_ptr<Road>> split_roads = makeGrid();
+    routing::RoadGraph single_graph(single_roads);
+    routing::RoadGraph split_graph(split_roads);
+
+    // Balanced parts of connected nodes, cutting few edges
+    routing::NetworkPartition whole(single_graph, 1);
+    assert(whole.getNumCutEdges() == 0 && whole.getImbalance() == 1.0);
+    routing::NetworkPartition partition(split_graph, 4);
+    assert(partition.getNumParts() == 4);
+    assert(partition.getImbalance() <= 1.1);
+    assert(partition.getNumCutEdges() > 0);
+    assert(partition.getNumCutEdges() <= split_graph.getNumEdges() / 4);
+    double total = 0.0;
+    for (double weight : partition.getPartWeights()) {
+        assert(weight > 0.0);
+        total += weight;
+    }
+    assert(std::abs(total - split_graph.getNumEdges() * 2 * 0.2) < 1e-9);
+    std::size_t cut = 0;
+    for (std::uint32_t edge = 0; edge < split_graph.getNumEdges(); ++edge) {
+        cut += partition.isCutEdge(edge);
+        assert(partition.getPartOfEdge(edge) ==
+               partition.getPartOfNode(split_graph.getSource(edge)));
+    }
+    assert(cut == partition.getNumCutEdges());
+
+    // The demand of a trip weighs on the edges of its route
+    std::vector<double> demand(split_graph.getNumEdges(), 0.0);
+    demand[0] = 1000.0;
+    routing::NetworkPartition loaded(split_graph, 4, demand);
+    assert(loaded.getEdgeWeights()[0] > 1000.0);
+
+    bool rejected = false;
+    try {
+        routing::NetworkPartition none(split_graph, 0);
+    } catch (const std::invalid_argument &) {
+        rejected = true;
+    }
+    assert(rejected);
+
+    // Trips along shortest routes, the same edges in both graphs
+    routing::Router router;
+    std::unordered_map<const Road *, std::uint32_t> edge_of_road;
+    for (std::uint32_t edge = 0; edge < single_graph.getNumEdges(); ++edge) {
+        edge_of_road[single_graph.getRoad(edge).get()] = edge;
+    }
+    std::vector<simulation::DistributedSimulation::Trip> trips;
+    const std::uint32_t nodes = single_graph.getNumNodes();
+    for (std::uint32_t i = 0; i < 120; ++i) {
+        routing::Route route = router.findRoute(
+            single_graph.getPosition((i * 7) % nodes),
+            single_graph.getPosition((i * 13 + 5) % nodes), single_roads);
+        if (route.roads.empty()) {
+            continue;
+        }
+        simulation::DistributedSimulation::Trip trip;
+        trip.id = "trip_" + std::to_string(i);
+        for (const auto &road : route.roads) {
+            trip.edges.push_back(edge_of_road.at(road.get()));
+        }
+        trip.departure = 0.5 * i;
+        trips.push_back(trip);
+    }
+
+    const jfm::models::IDM idm(15.0);
+    const int steps = 1200;
+    auto single_exchange = simulation::LocalRankExchange::createGroup(1);
+    simulation::DistributedSimulation single(whole, single_exchange[0], idm);
+    for (const auto &trip : trips) {
+        single.addTrip(trip);
+    }
+    for (int step = 0; step < steps; ++step) {
+        single.step();
+    }
+    const auto single_statistics = single.getGlobalStatistics();
+    assert(single_statistics.departed == trips.size());
+    assert(single_statistics.arrived > 0.0);
+    assert(single_statistics.handed_off == 0.0);
+
+    // The ranks run on threads give the same vehicles
+    auto exchanges = simulation::LocalRankExchange::createGroup(4);
+    std::vector<std::unique_ptr<simulation::DistributedSimulation>> ranks;
+    for (const auto &exchange : exchanges) {
+        ranks.push_back(std::make_unique<simulation::DistributedSimulation>(
+            partition, exchange, idm));
+        for (const auto &trip : trips) {
+            ranks.back()->addTrip(trip);
+        }
+    }
+    for (const auto &rank : ranks) {
+        for (int peer : rank->getPeers()) {
+            const auto &back = ranks[peer]->getPeers();
+            assert(std::find(back.begin(), back.end(), rank->getRank()) !=
+                   back.end());
+        }
+    }
+    std::vector<simulation::DistributedSimulation::Statistics> statistics(4);
+    std::vector<std::thread> threads;
+    for (int r = 0; r < 4; ++r) {
+        threads.emplace_back([&, r]() {
+            for (int step = 0; step < steps; ++step) {
+                ranks[r]->step();
+            }
+            statistics[r] = ranks[r]->getGlobalStatistics();
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (const auto &rank_statistics : statistics) {
+        assert(rank_statistics.vehicles == single_statistics.vehicles);
+        assert(rank_statistics.departed == single_statistics.departed);
+        assert(rank_statistics.arrived == single_statistics.arrived);
+        assert(rank_statistics.handed_off > 0.0);
+    }
+
+    std::unordered_map<std::string, std::shared_ptr<jfk::model::Vehicle>>
+        expected;
+    for (const auto &vehicle : single.getVehicles()) {
+        expected[vehicle->getId()] = vehicle;
+    }
+    std::size_t found = 0;
+    for (const auto &rank : ranks) {
+        for (const auto &vehicle : rank->getVehicles()) {
+            const auto &other = expected.at(vehicle->getId());
+            assert(vehicle->getLanePosition() == other->getLanePosition());
+            assert(vehicle->getSpeed() == other->getSpeed());
+            assert(vehicle->getPosition().x == other->getPosition().x);
+            assert(vehicle->getPosition().y == other->getPosition().y);
+            ++found;
+        }
+    }
+    assert(found == expected.size());
+
+    // Rebalancing moves the vehicles and the trips of the edges changing
+    // part, and still gives the same vehicles
+    std::vector<std::shared_ptr<Road>> rebalanced_roads = makeGrid();
+    routing::RoadGraph rebalanced_graph(rebalanced_roads);
+    routing::NetworkPartition initial(rebalanced_graph, 4);
+    auto rebalanced_exchanges = simulation::LocalRankExchange::createGroup(4);
+    std::vector<std::unique_ptr<simulation::DistributedSimulation>> rebalanced;
+    for (const auto &exchange : rebalanced_exchanges) {
+        rebalanced.push_back(
+            std::make_unique<simulation::DistributedSimulation>(
+                initial, exchange, idm));
+        // Any imbalance partitions the network again
+        rebalanced.back()->setRebalancing(100, 1.0);
+        for (const auto &trip : trips) {
+            rebalanced.back()->addTrip(trip);
+        }
+    }
+    threads.clear();
+    for (int r = 0; r < 4; ++r) {
+        threads.emplace_back([&, r]() {
+            for (int step = 0; step < steps; ++step) {
+                rebalanced[r]->step();
+            }
+            statistics[r] = rebalanced[r]->getGlobalStatistics();
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (const auto &rank_statistics : statistics) {
+        assert(rank_statistics.vehicles == single_statistics.vehicles);
+        assert(rank_statistics.departed == single_statistics.departed);
+        assert(rank_statistics.arrived == single_statistics.arrived);
+    }
+    assert(rebalanced[0]->getRebalanceCount() > 0);
+    found = 0;
+    for (const auto &rank : rebalanced) {
+        assert(rank->getRebalanceCount() == rebalanced[0]->getRebalanceCount());
+        assert(rank->getPartition().getNodeParts() ==
+               rebalanced[0]->getPartition().getNodeParts());
+        for (const auto &vehicle : rank->getVehicles()) {
+            const auto &other = expected.at(vehicle->getId());
+            assert(vehicle->getLanePosition() == other->getLanePosition());
+            assert(vehicle->getSpeed() == other->getSpeed());
+            ++found;
+        }
+    }
+    assert(found == expected.size());
+
+    bool below_one = false;
+    try {
+        rebalanced[0]->setRebalancing(10, 0.5);
+    } catch (const std::invalid_argument &) {
+        below_one = true;
+    }
+    assert(below_one);
+
+    std::cout << "Distributed simulation tests PASSED" << std::endl;
+}
+
+// Test OSM parsing
+void testOSMParser() {
+    std::cout << "Testing OSMParser class..." << std::endl;
+
+    namespace osm = jf::realdata::osm;
+    const std::string xml =
+        "<?xml version='1.0' encoding='UTF-8'?>\n"
+        "<osm version=\"0.6\">\n"
+        "  <!-- <node id=\"9\" lat=\"0\" lon=\"0\"/> -->\n"
+        "  <node id=\"1\" lat=\"48.8566140\" lon=\"2.3522219\"/>\n"
+        "  <node id='2' lat='48.8576140' lon='2.3532219'/>\n"
+        "  <node id=\"3\" lat=\"48.9\" lon=\"2.4\">\n"
+        "    <tag k=\"highway\" v=\"traffic_signals\"/>\n"
+        "  </node>\n"
+        "  <way id=\"10\">\n"
+        "    <nd ref=\"1\"/>\n"
+        "    <nd ref=\"2\"/>\n"
+        "    <tag k=\"highway\" v=\"secondary\"/>\n"
+        "    <tag k=\"lanes\" v=\"2;3\"/>\n"
+        "    <tag k=\"maxspeed\" v=\"none\"/>\n"
+        "    <tag k=\"name\" v=\"Rue d&apos;Alsace &amp; Lorraine\"/>\n"
+        "  </way>\n"
+        "  <way id=\"11\">\n"
+        "    <nd ref=\"2\"/>\n"
+        "    <nd ref=\"3\"/>\n"
+        "    <tag k=\"building\" v=\"yes\"/>\n"
+        "  </way>\n"
+        "  <way id=\"12\">\n"
+        "    <nd ref=\"2\"/>\n"
+        "    <nd ref=\"3\"/>\n"
+        "    <tag k=\"highway\" v=\"primary\"/>\n"
+        "    <tag k=\"maxspeed\" v=\"30 mph\"/>\n"
+        "  </way>\n"
+        "  <relation id=\"20\">\n"
+        "    <member type=\"way\" ref=\"10\" role=\"\"/>\n"
+        "    <tag k=\"highway\" v=\"pedestrian\"/>\n"
+        "  </relation>\n"
+        "</osm>\n";
+
+    osm::RoadNetwork network = osm::OSMParser::parseString(xml);
+    assert(network.ways.size() == 2);
+    assert(network.roads.size() == 2);
+
+    const osm::OSMWay &way = network.ways[0];
+    assert(way.id == 10);
+    assert(way.node_refs.size() == 2);
+    assert(way.lanes == 2);
+    assert(way.max_speed == osm::OSMParser::getDefaultSpeedLimit("secondary"));
+    assert(way.name == "Rue d'Alsace & Lorraine");
+    assert(std::abs(network.ways[1].max_speed - 30 * 1.609344) < 1e-9);
+
+    // The nodes of the roads, with the coordinates of the file
+    assert(network.nodes.size() == 3);
+    assert(network.nodes.at(1).lat == 48.8566140);
+    assert(network.nodes.at(1).lon == 2.3522219);
+    assert(network.min_lat == 48.8566140 && network.max_lat == 48.9);
+    assert(network.min_lon == 2.3522219 && network.max_lon == 2.4);
+
+    // Coordinates kept in 1e-7 degrees
+    osm::NodeCoordinates coordinates;
+    for (long long id = 0; id < 5000; ++id) {
+        coordinates.insert(id * 7919, -45.0 + id * 1e-7, 170.1234567);
+    }
+    assert(coordinates.size() == 5000);
+    double lat, lon;
+    assert(coordinates.find(4999 * 7919, lat, lon));
+    assert(std::abs(lat - (-45.0 + 4999 * 1e-7)) < 1e-9);
+    assert(lon == 170.1234567);
+    assert(!coordinates.find(1, lat, lon));
+
+    // A document cut in a tag
+    bool thrown = false;
+    try {
+        osm::OSMParser::parseString("<osm><node id=\"1\" lat=\"4");
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    std::cout << "OSMParser tests PASSED" << std::endl;
+}
+
+// Protocol buffer encoding of the OSM PBF test files
+std::string pbfVarint(unsigned long long value) {
+    std::string bytes;
+    while (value >= 0x80) {
+        bytes += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    bytes += static_cast<char>(value);
+    return bytes;
+}
+
+std::string pbfSigned(long long value) {
+    return pbfVarint((static_cast<unsigned long long>(value) << 1) ^
+                     static_cast<unsigned long long>(value >> 63));
+}
+
+std::string pbfField(int field, const std::string &bytes) {
+    return pbfVarint(field << 3 | 2) + pbfVarint(bytes.size()) + bytes;
+}
+
+std::string pbfBlob(const std::string &type, const std::string &content) {
+    std::string blob = pbfField(1, content); // Raw, not compressed
+    std::string header = pbfField(1, type) + pbfVarint(3 << 3) +
+                         pbfVarint(blob.size());
+    std::string size(4, '\0');
+    size[3] = static_cast<char>(header.size());
+    return size + header + blob;
+}
+
+void testOSMPbfParser() {
+    std::cout << "Testing OSMParser PBF input..." << std::endl;
+
+    namespace osm = jf::realdata::osm;
+
+    // Dense nodes 1, 2 and 3, delta coded, in a first block of granularity
+    // 100 nanodegrees
+    std::string dense =
+        pbfField(1, pbfSigned(1) + pbfSigned(1) + pbfSigned(1)) +
+        pbfField(8, pbfSigned(488566140) + pbfSigned(10000) +
+                        pbfSigned(423860)) +
+        pbfField(9, pbfSigned(23522219) + pbfSigned(10000) +
+                        pbfSigned(467781));
+    std::string nodes = pbfField(1, pbfField(1, "")) +
+                        pbfField(2, pbfField(2, dense));
+
+    // A motorway, a building and a primary road in a second block
+    std::string strings = pbfField(1, "") + pbfField(1, "highway") +
+                          pbfField(1, "motorway") + pbfField(1, "building") +
+                          pbfField(1, "yes") + pbfField(1, "primary");
+    auto way = [](long long id, const std::string &keys,
+                  const std::string &values) {
+        return pbfField(3, pbfVarint(1 << 3) + pbfVarint(id) +
+                               pbfField(2, keys) + pbfField(3, values) +
+                               pbfField(8, pbfSigned(1) + pbfSigned(1)));
+    };
+    std::string ways =
+        pbfField(1, strings) +
+        pbfField(2, way(10, pbfVarint(1), pbfVarint(2)) +
+                        way(11, pbfVarint(3), pbfVarint(4)) +
+                        way(12, pbfVarint(1), pbfVarint(5)));
+
+    const std::string pbf =
+        pbfBlob("OSMHeader", pbfField(4, "OsmSchema-V0.6") +
+                                 pbfField(4, "DenseNodes")) +
+        pbfBlob("OSMData", nodes) + pbfBlob("OSMData", ways);
+    const auto *data = reinterpret_cast<const std::uint8_t *>(pbf.data());
+
+    osm::RoadNetwork network = osm::OSMParser::parsePbf(data, pbf.size());
+    assert(network.ways.size() == 2);
+    assert(network.roads.size() == 2);
+    assert(network.ways[0].id == 10 && network.ways[1].id == 12);
+    assert(network.ways[0].node_refs == std::vector<long long>({1, 2}));
+    assert(network.ways[0].lanes ==
+           osm::OSMParser::getDefaultLanes("motorway"));
+    assert(network.nodes.size() == 2);
+    assert(network.nodes.at(1).lat == 48.8566140);
+    assert(network.nodes.at(2).lon == 2.3532219);
+    assert(network.max_lat == 48.9 && network.max_lon == 2.4);
+
+    // The filter applies as the blocks are decoded, whatever the threads
+    osm::MotorwayFilter motorways;
+    osm::RoadNetwork filtered =
+        osm::OSMParser::parsePbf(data, pbf.size(), &motorways, 4);
+    assert(filtered.ways.size() == 1 && filtered.ways[0].id == 10);
+
+    // A file cut in a blob
+    bool thrown = false;
+    try {
+        osm::OSMParser::parsePbf(data, pbf.size() - 1);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    std::cout << "OSMParser PBF tests PASSED" << std::endl;
+}
+
+void testNetworkCache() {
+    std::cout << "Testing NetworkCache class..." << std::endl;
+
+    namespace osm = jf::realdata::osm;
+    const std::string directory =
+        std::filesystem::temp_directory_path().string();
+    const std::string source = directory + "/jamfree_cache_test.osm";
+    const std::string cache = source + ".cache";
+    std::remove(cache.c_str());
+
+    auto writeSource = [&](const std::string &maxspeed) {
+        std::ofstream file(source, std::ios::trunc);
+        file << "<osm>\n"
+             << "  <node id=\"1\" lat=\"48.8566140\" lon=\"2.3522219\"/>\n"
+             << "  <node id=\"2\" lat=\"48.8576140\" lon=\"2.3532219\"/>\n"
+             << "  <way id=\"10\">\n"
+             << "    <nd ref=\"1\"/>\n"
+             << "    <nd ref=\"2\"/>\n"
+             << "    <tag k=\"highway\" v=\"primary\"/>\n"
+             << "    <tag k=\"lanes\" v=\"2\"/>\n"
+             << "    <tag k=\"maxspeed\" v=\"" << maxspeed << "\"/>\n"
+             << "  </way>\n"
+             << "</osm>\n";
+    };
+    writeSource("70");
+
+    osm::RoadNetwork network;
+    assert(!osm::NetworkCache::load(cache, source, network));
+    osm::RoadNetwork parsed = osm::NetworkCache::loadOrParse(source, cache);
+    assert(osm::NetworkCache::load(cache, source, network));
+
+    // The cached network is the parsed one
+    assert(network.min_lat == parsed.min_lat);
+    assert(network.max_lon == parsed.max_lon);
+    assert(network.nodes.size() == 2);
+    assert(network.nodes.at(2).lat == parsed.nodes.at(2).lat);
+    assert(network.ways.size() == 1);
+    assert(network.ways[0].node_refs == parsed.ways[0].node_refs);
+    assert(network.ways[0].tags == parsed.ways[0].tags);
+    assert(network.ways[0].max_speed == 70.0);
+    assert(network.roads.size() == 1);
+    const auto &road = network.roads[0];
+    assert(road->getId() == parsed.roads[0]->getId());
+    assert(road->getNumLanes() == 2);
+    assert(road->getStart().x == parsed.roads[0]->getStart().x);
+    assert(road->getLength() == parsed.roads[0]->getLength());
+    assert(road->getLane(1)->getSpeedLimit() == 70.0 / 3.6);
+
+    // A cache of another content of the source is stale
+    writeSource("90");
+    assert(!osm::NetworkCache::load(cache, source, network));
+    network = osm::NetworkCache::loadOrParse(source, cache);
+    assert(network.ways[0].max_speed == 90.0);
+    assert(osm::NetworkCache::load(cache, source, network));
+
+    std::remove(cache.c_str());
+    std::remove(source.c_str());
+    std::cout << "NetworkCache tests PASSED" << std::endl;
+}
+
+void testOSMChange() {
+    std::cout << "Testing OSM change files..." << std::endl;
+
+    namespace osm = jf::realdata::osm;
+    auto node = [](int id, const std::string &lat, const std::string &lon) {
+        return "  <node id=\"" + std::to_string(id) + "\" lat=\"" + lat +
+               "\" lon=\"" + lon + "\"/>\n";
+    };
+    auto way = [](int id, int from, int to, const std::string &lanes) {
+        return "  <way id=\"" + std::to_string(id) + "\">\n"
+               "    <nd ref=\"" + std::to_string(from) + "\"/>\n"
+               "    <nd ref=\"" + std::to_string(to) + "\"/>\n"
+               "    <tag k=\"highway\" v=\"primary\"/>\n"
+               "    <tag k=\"lanes\" v=\"" + lanes + "\"/>\n"
+               "  </way>\n";
+    };
+    // Nodes 8 and 9 fix the bounding box, and so the projection
+    const std::string corners =
+        node(8, "48.80", "2.30") + node(9, "48.90", "2.40");
+    const std::string base =
+        "<osm>\n" + corners + node(1, "48.81", "2.31") +
+        node(2, "48.82", "2.32") + node(3, "48.83", "2.33") +
+        node(4, "48.84", "2.34") + way(10, 1, 2, "2") + way(11, 2, 3, "2") +
+        way(12, 3, 4, "2") + way(14, 1, 3, "1") + "</osm>\n";
+    const std::string osc =
+        "<?xml version='1.0' encoding='UTF-8'?>\n"
+        "<osmChange version=\"0.6\">\n"
+        "  <create>\n" + node(5, "48.85", "2.35") + way(13, 4, 5, "1") +
+        "  </create>\n"
+        "  <modify>\n" + node(4, "48.86", "2.34") + way(10, 1, 2, "3") +
+        "  </modify>\n"
+        "  <delete>\n"
+        "    <way id=\"11\" version=\"3\"/>\n"
+        "  </delete>\n"
+        "</osmChange>\n";
+
+    osm::OSMChange change = osm::OSMParser::parseChange(osc);
+    assert(change.nodes.size() == 2 && change.ways.size() == 2);
+    assert(change.deleted_ways == std::vector<long long>({11}));
+    assert(change.deleted_nodes.empty());
+
+    osm::RoadNetwork network = osm::OSMParser::parseString(base);
+    const auto untouched = network.roads[3];
+    osm::NetworkPatch patch = osm::OSMParser::applyChange(network, change);
+
+    // The roads of ways 10, 11 and 12 are removed, the ones of 10, 12 and
+    // 13 built again, the road of way 14 being kept
+    assert(patch.removed_roads.size() == 3);
+    assert(patch.added_roads.size() == 3);
+    assert(network.roads.size() == 4);
+    assert(network.roads[0]->getId() == "osm_way_10");
+    assert(network.roads[0]->getNumLanes() == 3);
+    assert(network.roads[2] == untouched);
+    assert(network.nodes.count(5) == 1 && network.nodes.at(4).lat == 48.86);
+    assert(network.ways.size() == 4);
+
+    // The same network as the one of the changed extract
+    const std::string changed =
+        "<osm>\n" + corners + node(1, "48.81", "2.31") +
+        node(2, "48.82", "2.32") + node(3, "48.83", "2.33") +
+        node(4, "48.86", "2.34") + node(5, "48.85", "2.35") +
+        way(10, 1, 2, "3") + way(12, 3, 4, "2") + way(14, 1, 3, "1") +
+        way(13, 4, 5, "1") + "</osm>\n";
+    osm::RoadNetwork parsed = osm::OSMParser::parseString(changed);
+    assert(parsed.nodes.size() == network.nodes.size());
+    for (const auto &road : parsed.roads) {
+        auto same = std::find_if(
+            network.roads.begin(), network.roads.end(),
+            [&](const auto &other) { return other->getId() == road->getId(); });
+        assert(same != network.roads.end());
+        assert((*same)->getEnd().x == road->getEnd().x);
+        assert((*same)->getEnd().y == road->getEnd().y);
+        assert((*same)->getNumLanes() == road->getNumLanes());
+    }
+
+    // The road index is patched
+    assert(network.road_index.size() == 4);
+    const auto &road13 = network.roads[3];
+    jfk::model::RoadIndex::Match match;
+    assert(network.road_index.nearest(
+        (road13->getStart() + road13->getEnd()) * 0.5, match, 1.0));
+    assert(match.segment->road == road13.get());
+
+    // A cache of the extract gets the changes it lacks, then caches them
+    const std::string directory =
+        std::filesystem::temp_directory_path().string();
+    const std::string source = directory + "/jamfree_change_test.osm";
+    const std::string diff = directory + "/jamfree_change_test.osc";
+    const std::string cache = source + ".cache";
+    std::ofstream(source, std::ios::trunc) << base;
+    std::ofstream(diff, std::ios::trunc) << osc;
+    std::remove(cache.c_str());
+    osm::NetworkCache::loadOrParse(source, cache);
+    osm::RoadNetwork updated =
+        osm::NetworkCache::loadOrParse(source, {diff}, cache);
+    assert(updated.roads.size() == 4);
+    assert(updated.roads[0]->getNumLanes() == 3);
+    assert(!osm::NetworkCache::load(cache, source, network));
+    updated = osm::NetworkCache::loadOrParse(source, {diff}, cache);
+    assert(updated.nodes.at(4).lat == 48.86);
+    assert(updated.road_index.size() == 4);
+
+    std::remove(cache.c_str());
+    std::remove(diff.c_str());
+    std::remove(source.c_str());
+    std::cout << "OSM change tests PASSED" << std::endl;
+}
+
 // Main test runner
+// Test the batch solvers against the models of one link
+void testMacroscopicBatch() {
+    std::cout << "Testing macroscopic batch solvers..." << std::endl;
+
+    namespace macro = jamfree::macroscopic::models;
+    std::vector<macro::LWR> lwrs = {macro::LWR(33.3, 0.15, 1000.0, 100),
+                                    macro::LWR(20.0, 0.12, 500.0, 40),
+                                    macro::LWR(27.0, 0.18, 2000.0, 150)};
+    std::vector<macro::CTM> ctms = {
+        macro::CTM(33.3, 5.56, 0.15, 1000.0, 100),
+        macro::CTM(20.0, 6.0, 0.12, 500.0, 40)};
+    for (std::size_t m = 0; m < lwrs.size(); ++m) {
+        // A queue on a quarter of the ring, light traffic elsewhere
+        for (int i = 0; i < lwrs[m].getNumCells(); ++i) {
+            const bool queue = i < lwrs[m].getNumCells() / 4;
+            lwrs[m].setDensity(i, queue ? 0.11 + 0.01 * m : 0.02);
+        }
+    }
+    for (std::size_t m = 0; m < ctms.size(); ++m) {
+        for (int i = 0; i < ctms[m].getNumCells(); ++i) {
+            ctms[m].setNumVehicles(i, i % 7 == 0 ? 1.4 : 0.2 + 0.1 * m);
+        }
+    }
+
+    macro::LWRBatch lwr_batch;
+    std::vector<std::size_t> lwr_links;
+    for (const auto &model : lwrs) {
+        lwr_links.push_back(lwr_batch.addLink(model));
+    }
+    macro::CTMBatch ctm_batch;
+    std::vector<std::size_t> ctm_links;
+    for (const auto &model : ctms) {
+        ctm_links.push_back(ctm_batch.addLink(model));
+    }
+    assert(lwr_batch.getNumLinks() == 3);
+    assert(lwr_batch.getTotalCells() == 290);
+
+    auto vehicles = [](const macro::LWRBatch &batch, std::size_t link) {
+        double total = 0.0;
+        for (int i = 0; i < batch.getNumCells(link); ++i) {
+            total += batch.getDensity(link, i) * batch.getCellLength(link);
+        }
+        return total;
+    };
+    const double before = vehicles(lwr_batch, lwr_links[0]);
+
+    auto check = [&](std::size_t m) {
+        for (int i = 0; i < lwrs[m].getNumCells(); ++i) {
+            assert(std::abs(lwr_batch.getDensity(lwr_links[m], i) -
+                            lwrs[m].getDensity(i)) < 1e-9);
+            assert(std::abs(lwr_batch.getSpeed(lwr_links[m], i) -
+                            lwrs[m].getSpeed(i)) < 1e-6);
+        }
+    };
+    const double dt = 0.2;
+    for (int step = 0; step < 300; ++step) {
+        lwr_batch.update(dt);
+        ctm_batch.update(dt);
+        for (auto &model : lwrs) {
+            model.update(dt);
+        }
+        for (auto &model : ctms) {
+            model.update(dt);
+        }
+    }
+    for (std::size_t m = 0; m < lwrs.size(); ++m) {
+        check(m);
+    }
+    for (std::size_t m = 0; m < ctms.size(); ++m) {
+        for (int i = 0; i < ctms[m].getNumCells(); ++i) {
+            assert(std::abs(ctm_batch.getNumVehicles(ctm_links[m], i) -
+                            ctms[m].getNumVehicles(i)) < 1e-9);
+        }
+    }
+    // The rings keep their vehicles, and the queue has spread
+    assert(std::abs(vehicles(lwr_batch, lwr_links[0]) - before) < 1e-6);
+    assert(lwr_batch.getDensity(lwr_links[0], 0) < 0.11);
+
+    // Removing a link moves the cells of the next one only
+    lwr_batch.removeLink(lwr_links[1]);
+    assert(!lwr_batch.hasLink(lwr_links[1]));
+    assert(lwr_batch.getTotalCells() == 250);
+    const std::size_t reused = lwr_batch.addLink(20.0, 0.12, 500.0, 40);
+    assert(reused == lwr_links[1]);
+    assert(lwr_batch.getDensity(reused, 0) == 0.0);
+    for (int step = 0; step < 50; ++step) {
+        lwr_batch.update(dt);
+        lwrs[0].update(dt);
+        lwrs[2].update(dt);
+    }
+    check(0);
+    check(2);
+
+    bool rejected = false;
+    try {
+        lwr_batch.getDensity(lwr_links[0], 100);
+    } catch (const std::out_of_range &) {
+        rejected = true;
+    }
+    assert(rejected);
+
+    std::cout << "Macroscopic batch solver tests PASSED" << std::endl;
+}
+
+void testMacroscopicLargeSteps() {
+    std::cout << "Testing macroscopic large time steps..." << std::endl;
+
+    namespace macro = jamfree::macroscopic::models;
+    auto queue = [](macro::LWR &model) {
+        for (int i = 0; i < model.getNumCells(); ++i) {
+            model.setDensity(i, i < model.getNumCells() / 4 ? 0.12 : 0.02);
+        }
+    };
+    auto vehicles = [](const macro::LWR &model) {
+        double total = 0.0;
+        for (int i = 0; i < model.getNumCells(); ++i) {
+            total += model.getDensity(i) * model.getCellLength();
+        }
+        return total;
+    };
+
+    // 10 m cells at 30 m/s: a third of a second, well below a large step
+    macro::LWR lwr(30.0, 0.15, 1000.0, 100);
+    assert(std::abs(lwr.getStableTimeStep() - 1.0 / 3.0) < 1e-12);
+    queue(lwr);
+    macro::LWR naive = lwr;
+    macro::LWR reference = lwr;
+    const double before = vehicles(lwr);
+    macro::LWRBatch batch;
+    const std::size_t link = batch.addLink(lwr);
+    assert(std::abs(batch.getStableTimeStep(link) - 1.0 / 3.0) < 1e-12);
+
+    // A step of 2 s, as 6 stable steps; updated at once, it loses vehicles
+    const double dt = 2.0;
+    for (int step = 0; step < 30; ++step) {
+        assert(lwr.advance(dt) == 6);
+        batch.advance(dt);
+        naive.update(dt);
+        for (int sub = 0; sub < 6; ++sub) {
+            reference.update(dt / 6);
+        }
+    }
+    assert(std::abs(vehicles(lwr) - before) < 1e-6);
+    assert(std::abs(vehicles(naive) - before) > 1.0);
+    for (int i = 0; i < lwr.getNumCells(); ++i) {
+        assert(lwr.getDensity(i) == reference.getDensity(i));
+        assert(std::abs(batch.getDensity(link, i) - lwr.getDensity(i)) < 1e-9);
+    }
+    // Within the stable step, one update
+    assert(lwr.advance(0.2) == 1);
+
+    // The CTM, bounded by its faster wave
+    macro::CTM ctm(20.0, 25.0, 0.15, 500.0, 50);
+    assert(std::abs(ctm.getStableTimeStep() - 0.4) < 1e-12);
+    for (int i = 0; i < ctm.getNumCells(); ++i) {
+        ctm.setNumVehicles(i, i % 5 == 0 ? 1.4 : 0.3);
+    }
+    macro::CTMBatch ctm_batch;
+    const std::size_t ctm_link = ctm_batch.addLink(ctm);
+    assert(std::abs(ctm_batch.getStableTimeStep(ctm_link) - 0.4) < 1e-12);
+    for (int step = 0; step < 20; ++step) {
+        assert(ctm.advance(1.0) == 3);
+        ctm_batch.advance(1.0);
+    }
+    for (int i = 0; i < ctm.getNumCells(); ++i) {
+        assert(std::abs(ctm_batch.getNumVehicles(ctm_link, i) -
+                        ctm.getNumVehicles(i)) < 1e-9);
+    }
+
+    // Macroscopic lanes updated once every 5 microscopic steps
+    using jamfree::hybrid::AdaptiveSimulator;
+    auto run = [&](int period, int steps) {
+        AdaptiveSimulator::Config config;
+        config.macro_period = period;
+        auto simulator = std::make_unique<AdaptiveSimulator>(config);
+        auto road = std::make_shared<jfk::model::Road>(
+            "cycled", jfk::model::Point2D(0.0, 0.0),
+            jfk::model::Point2D(1000.0, 0.0), 1, 3.5);
+        auto lane = road->getLane(0);
+        for (int i = 0; i < 60; ++i) {
+            auto vehicle =
+                std::make_shared<jfk::model::Vehicle>("m" + std::to_string(i));
+            vehicle->setLanePosition(i * 4.0);
+            vehicle->setSpeed(10.0);
+            lane->addVehicle(vehicle);
+        }
+        simulator->registerLane(lane);
+        simulator->forceMacroscopic(lane->getId());
+        jfm::models::IDM idm;
+        for (int step = 0; step < steps; ++step) {
+            simulator->update(0.1, idm);
+        }
+        const auto &cells = simulator->getMacroscopicBatch();
+        const std::size_t macro_link =
+            simulator->getLaneState(lane->getId())->macro_link;
+        return std::vector<double>(
+            cells.getDensities(macro_link),
+            cells.getDensities(macro_link) + cells.getNumCells(macro_link));
+    };
+    const std::vector<double> initial = run(5, 0);
+    assert(run(5, 4) == initial);
+    const std::vector<double> cycled = run(5, 20);
+    const std::vector<double> every = run(1, 20);
+    assert(cycled != initial);
+    double total_cycled = 0.0;
+    double total_every = 0.0;
+    for (std::size_t i = 0; i < cycled.size(); ++i) {
+        total_cycled += cycled[i];
+        total_every += every[i];
+        assert(std::abs(cycled[i] - every[i]) < 0.02);
+    }
+    assert(std::abs(total_cycled - total_every) < 1e-9);
+
+    std::cout << "Macroscopic large time step tests PASSED" << std::endl;
+}
+
+void testNetworkCTM() {
+    std::cout << "Testing network CTM..." << std::endl;
+
+    namespace macro = jamfree::macroscopic::models;
+    using jfk::model::Point2D;
+    using jfk::model::Road;
+    auto makeRoad = [](const Point2D &from, const Point2D &to, int lanes) {
+        auto road = std::make_shared<Road>("road", from, to, lanes, 3.5);
+        for (int i = 0; i < lanes; ++i) {
+            road->getLane(i)->setSpeedLimit(20.0);
+        }
+        return road;
+    };
+
+    // A merge of a road of 2 lanes and one of 1 lane into 1 lane: once
+    // congested, the incoming roads share the outflow as 2 to 1
+    const Point2D node(500.0, 0.0);
+    std::vector<std::shared_ptr<Road>> roads = {
+        makeRoad(Point2D(0.0, 0.0), node, 2),
+        makeRoad(Point2D(500.0, -500.0), node, 1),
+        makeRoad(node, Point2D(1000.0, 0.0), 1)};
+    macro::NetworkCTM merge(roads, 1.0);
+    const auto &graph = merge.getGraph();
+    const std::uint32_t wide = graph.getEdgeOfRoad(0);
+    const std::uint32_t narrow = graph.getEdgeOfRoad(1);
+    assert(merge.getNumCells(wide) == 25);
+    assert(std::abs(merge.getCellLength(wide) - 20.0) < 1e-9);
+    merge.addVehicles(wide, 5000.0);
+    merge.addVehicles(narrow, 5000.0);
+    for (int step = 0; step < 1500; ++step) {
+        merge.update(1.0);
+    }
+    assert(std::abs(merge.getTotalVehicles() + merge.getExitedVehicles() -
+                    10000.0) < 1e-6);
+    const double share =
+        (5000.0 - merge.getQueue(wide)) / (5000.0 - merge.getQueue(narrow));
+    assert(share > 1.8 && share < 2.2);
+
+    // A diverge by turning fractions, blocked as a whole while one of its
+    // outgoing roads is jammed
+    roads = {makeRoad(Point2D(0.0, 0.0), node, 1),
+             makeRoad(node, Point2D(1000.0, 0.0), 1),
+             makeRoad(node, Point2D(500.0, 500.0), 1)};
+    macro::NetworkCTM diverge(roads, 1.0);
+    const auto &diverge_graph = diverge.getGraph();
+    const std::uint32_t in = diverge_graph.getEdgeOfRoad(0);
+    const std::uint32_t first_out =
+        diverge_graph.getFirstEdge(diverge_graph.getTarget(in));
+    diverge.setTurningFractions(in, {1.0, 3.0});
+    for (std::size_t c = 0; c < diverge.getNumCells(in); ++c) {
+        diverge.setNumVehicles(in, c, 0.5);
+    }
+    std::vector<double> times;
+    diverge.getTravelTimes(times);
+    assert(std::abs(times[in] - 25.0) < 1e-9);
+    for (int step = 0; step < 25; ++step) {
+        diverge.update(1.0);
+    }
+    assert(std::abs(diverge.getNumVehicles(first_out) - 3.125) < 1e-9);
+    assert(std::abs(diverge.getNumVehicles(first_out + 1) - 9.375) < 1e-9);
+
+    macro::NetworkCTM blocked(roads, 1.0);
+    for (std::size_t c = 0; c < blocked.getNumCells(in); ++c) {
+        blocked.setNumVehicles(in, c, 0.5);
+        blocked.setNumVehicles(first_out + 1, c, 1e9);
+    }
+    blocked.getTravelTimes(times);
+    assert(std::isinf(times[first_out + 1]));
+    for (int step = 0; step < 5; ++step) {
+        blocked.update(1.0);
+    }
+    assert(blocked.getNumVehicles(first_out) == 0.0);
+    assert(std::abs(blocked.getNumVehicles(in) - 12.5) < 1e-9);
+    blocked.getTravelTimes(times);
+    assert(times[in] > 25.0);
+
+    bool rejected = false;
+    try {
+        blocked.setTurningFractions(in, {1.0});
+    } catch (const std::invalid_argument &) {
+        rejected = true;
+    }
+    assert(rejected);
+
+    std::cout << "Network CTM tests PASSED" << std::endl;
+}
+
+void testLaneProfile() {
+    std::cout << "Testing LaneProfile..." << std::endl;
+
+    using jamfree::macroscopic::models::LaneProfile;
+    using jamfree::macroscopic::models::MicroMacroBridge;
+    using jfk::model::Point2D;
+
+    auto road = std::make_shared<jfk::model::Road>(
+        "profiled", Point2D(0.0, 0.0), Point2D(500.0, 0.0), 1, 3.5);
+    auto lane = road->getLane(0);
+    for (int i = 0; i < 30; ++i) {
+        auto vehicle =
+            std::make_shared<jfk::model::Vehicle>("p" + std::to_string(i));
+        vehicle->setLanePosition(i * 16.0);
+        vehicle->setSpeed(5.0 + (i % 7));
+        lane->addVehicle(vehicle);
+    }
+    const int num_cells = 10;
+    LaneProfile profile(lane->getLength(), num_cells);
+    profile.rebuild(*lane);
+
+    // Moved and reported one by one, some past the end of the lane
+    jfm::models::IDM idm;
+    for (int step = 0; step < 50; ++step) {
+        for (const auto &vehicle : lane->getVehicles()) {
+            const double position = vehicle->getLanePosition();
+            const double speed = vehicle->getSpeed();
+            vehicle->update(0.5, idm.calculateAcceleration(
+                                     *vehicle, lane->getLeader(*vehicle)));
+            profile.move(position, speed, vehicle->getLanePosition(),
+                         vehicle->getSpeed());
+        }
+        lane->sortVehicles();
+    }
+    assert(lane->getVehicles().back()->getLanePosition() > lane->getLength());
+
+    // The same profiles as counted from the vehicles
+    const auto density = MicroMacroBridge::extractDensityProfile(lane, num_cells);
+    const auto flow = MicroMacroBridge::extractFlowProfile(lane, num_cells);
+    const auto speed = MicroMacroBridge::extractSpeedProfile(lane, num_cells);
+    std::vector<double> densities(num_cells);
+    profile.getDensities(densities.data());
+    for (int i = 0; i < num_cells; ++i) {
+        assert(std::abs(densities[i] - density[i]) < 1e-12);
+        assert(std::abs(profile.getFlow(i) - flow[i]) < 1e-9);
+        assert(std::abs(profile.getSpeed(i) - speed[i]) < 1e-9);
+    }
+    const auto stats = MicroMacroBridge::calculateAggregateStats(lane);
+    const auto fast =
+        MicroMacroBridge::calculateAggregateStats(profile, lane->getLength());
+    assert(fast.num_vehicles == stats.num_vehicles);
+    assert(std::abs(fast.avg_speed - stats.avg_speed) < 1e-9);
+    assert(std::abs(fast.avg_flow - stats.avg_flow) < 1e-12);
+
+    // Leaving and entering
+    auto last = lane->getVehicles().front();
+    profile.remove(last->getLanePosition(), last->getSpeed());
+    lane->removeVehicle(last);
+    profile.add(0.0, 2.0);
+    assert(profile.getVehicleCount() == 30);
+    assert(profile.getCount(profile.cellOf(0.0)) >= 1);
+    assert(profile.cellOf(-100.0) == -1 && profile.cellOf(1e6) == -1);
+    profile.clear();
+    assert(profile.getVehicleCount() == 0 && profile.getSpeedSum() == 0.0);
+
+    bool thrown = false;
+    try {
+        LaneProfile invalid(100.0, 0);
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    std::cout << "LaneProfile tests PASSED" << std::endl;
+}
+
+void testFundamentalDiagramEstimator() {
+    std::cout << "Testing FundamentalDiagramEstimator..." << std::endl;
+
+    namespace macro = jamfree::macroscopic::models;
+    using Estimator = macro::FundamentalDiagramEstimator;
+    auto greenshields = [](double vf, double kj, double k) {
+        return vf * (1.0 - k / kj);
+    };
+
+    // Without enough bins, the priors
+    Estimator::Config config;
+    config.free_flow_speed = 25.0;
+    config.jam_density = 0.14;
+    Estimator estimator(config);
+    estimator.addSample(0.01, 24.0, 5.0);
+    Estimator::Estimate estimate = estimator.getEstimate();
+    assert(!estimate.fitted && estimate.free_flow_speed == 25.0);
+    assert(std::abs(estimate.capacity - 25.0 * 0.14 / 4.0) < 1e-12);
+
+    // Samples on a diagram, the free-flow ones many more
+    for (int round = 0; round < 50; ++round) {
+        for (int i = 0; i < 60; ++i) {
+            const double k = 0.002 * i;
+            estimator.addSample(k, greenshields(30.0, 0.12, k),
+                                k < 0.03 ? 20.0 : 1.0);
+        }
+        estimator.forget();
+    }
+    estimate = estimator.getEstimate();
+    assert(estimate.fitted && estimate.num_bins == 12);
+    assert(std::abs(estimate.free_flow_speed - 30.0) < 0.01);
+    assert(std::abs(estimate.jam_density - 0.12) < 1e-4);
+
+    // The old samples forgotten as the traffic changes
+    for (int round = 0; round < 5000; ++round) {
+        for (int i = 0; i < 60; ++i) {
+            const double k = 0.002 * i;
+            estimator.addSample(k, greenshields(20.0, 0.13, k));
+        }
+        estimator.forget();
+    }
+    estimate = estimator.getEstimate();
+    assert(std::abs(estimate.free_flow_speed - 20.0) < 0.1);
+    assert(std::abs(estimate.jam_density - 0.13) < 1e-3);
+
+    // The weights scaled back instead of overflowing
+    Estimator::Config fast;
+    fast.forgetting = 0.5;
+    Estimator forgetful(fast);
+    for (int round = 0; round < 2000; ++round) {
+        forgetful.addSample(0.05, 10.0, 2.0);
+        forgetful.forget();
+    }
+    assert(std::isfinite(forgetful.getTotalWeight()));
+    assert(std::abs(forgetful.getTotalWeight() - 2.0) < 1e-9);
+
+    // Detectors at the flows of the diagram
+    jfk::model::DetectorReports reports;
+    reports.num_detectors = 2;
+    const double period = 60.0;
+    for (int p = 0; p < 40; ++p) {
+        const double k = 0.003 * (p % 30) + 0.005;
+        const double v = greenshields(28.0, 0.11, k);
+        reports.period_end.push_back((p + 1) * period);
+        for (int d = 0; d < 2; ++d) {
+            const double q = d == 0 ? k * v : 0.0;
+            reports.counts.push_back(
+                static_cast<std::uint32_t>(std::lround(q * period)));
+            reports.harmonic_speed.push_back(
+                d == 0 ? static_cast<float>(v) : std::nanf(""));
+        }
+    }
+    Estimator detected;
+    detected.observe(reports, 0, period);
+    estimate = detected.getEstimate();
+    assert(estimate.fitted);
+    assert(std::abs(estimate.free_flow_speed - 28.0) < 1.0);
+    assert(std::abs(estimate.jam_density - 0.11) < 0.01);
+
+    // Fresh parameters of an LWR link, its densities clamped
+    macro::LWRBatch batch;
+    const std::size_t link = batch.addLink(33.3, 0.15, 1000.0, 10);
+    batch.setDensity(link, 0, 0.14);
+    batch.setParameters(link, estimate.free_flow_speed, estimate.jam_density);
+    assert(batch.getFreeFlowSpeed(link) == estimate.free_flow_speed);
+    assert(batch.getDensity(link, 0) == estimate.jam_density);
+
+    bool thrown = false;
+    try {
+        Estimator::Config invalid;
+        invalid.forgetting = 1.5;
+        Estimator rejected(invalid);
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // The macroscopic lanes of a simulator following their estimates
+    using jamfree::hybrid::AdaptiveSimulator;
+    AdaptiveSimulator::Config adaptive;
+    adaptive.calibrate_online = true;
+    AdaptiveSimulator simulator(adaptive);
+    auto road = std::make_shared<jfk::model::Road>(
+        "calibrated", jfk::model::Point2D(0.0, 0.0),
+        jfk::model::Point2D(1000.0, 0.0), 1, 3.5);
+    auto lane = road->getLane(0);
+    for (int i = 0; i < 40; ++i) {
+        auto vehicle =
+            std::make_shared<jfk::model::Vehicle>("c" + std::to_string(i));
+        vehicle->setLanePosition(i * 12.0);
+        vehicle->setSpeed(8.0);
+        lane->addVehicle(vehicle);
+    }
+    simulator.registerLane(lane);
+    jfm::models::IDM idm;
+    for (int step = 0; step < 20; ++step) {
+        simulator.update(0.5, idm);
+    }
+    simulator.forceMacroscopic(lane->getId());
+    Estimator *diagram = simulator.getFundamentalDiagram(lane->getId());
+    assert(diagram && diagram->getTotalWeight() > 0.0);
+    diagram->observe(reports, 0, period);
+    simulator.update(0.5, idm);
+    const auto &lwr = simulator.getMacroscopicBatch();
+    const std::size_t macro_link =
+        simulator.getLaneState(lane->getId())->macro_link;
+    assert(lwr.getFreeFlowSpeed(macro_link) ==
+           diagram->getEstimate().free_flow_speed);
+    assert(simulator.getFundamentalDiagram("unknown") == nullptr);
+
+    std::cout << "FundamentalDiagramEstimator tests PASSED" << std::endl;
+}
+
+void testAdaptiveBudget() {
+    std::cout << "Testing AdaptiveSimulator frame budget..." << std::endl;
+
+    using jamfree::hybrid::AdaptiveSimulator;
+    using jamfree::hybrid::SimulationMode;
+    using jfk::model::Point2D;
+    using jfk::model::Road;
+
+    // Dense long roads, over the density threshold, and a short one
+    std::vector<std::shared_ptr<Road>> roads;
+    for (int r = 0; r < 3; ++r) {
+        roads.push_back(std::make_shared<Road>(
+            "long_" + std::to_string(r), Point2D(0.0, r * 10.0),
+            Point2D(1000.0, r * 10.0), 1, 3.5));
+    }
+    roads.push_back(std::make_shared<Road>("short", Point2D(0.0, 50.0),
+                                           Point2D(40.0, 50.0), 1, 3.5));
+    auto run = [&](double budget_ms) {
+        AdaptiveSimulator::Config config;
+        config.frame_budget_ms = budget_ms;
+        AdaptiveSimulator simulator(config);
+        for (const auto &road : roads) {
+            auto lane = road->getLane(0);
+            lane->clearVehicles();
+            const int count = road->getLength() > 100.0 ? 100 : 4;
+            for (int i = 0; i < count; ++i) {
+                auto vehicle = std::make_shared<jfk::model::Vehicle>(
+                    road->getId() + "_" + std::to_string(i));
+                vehicle->setLanePosition(i * 10.0);
+                vehicle->setSpeed(5.0);
+                lane->addVehicle(vehicle);
+            }
+            simulator.registerLane(lane);
+        }
+        jfm::models::IDM idm;
+        for (int step = 0; step < 40; ++step) {
+            simulator.update(0.1, idm);
+        }
+        return simulator;
+    };
+
+    // Within an ample budget, every lane stays microscopic
+    AdaptiveSimulator ample = run(1e9);
+    assert(ample.getStatistics().micro_lanes == 4);
+    assert(ample.getStatistics().estimated_update_time_ms > 0.0);
+
+    // Over a tight one, the long roads go macroscopic once they may switch
+    AdaptiveSimulator tight = run(1e-12);
+    for (int r = 0; r < 3; ++r) {
+        const auto &lane = roads[r]->getLane(0);
+        assert(tight.getMode(lane->getId()) == SimulationMode::MACROSCOPIC);
+        assert(tight.getLaneState(lane->getId())->micro_ms_per_vehicle > 0.0);
+    }
+    assert(tight.getMode(roads[3]->getLane(0)->getId()) ==
+           SimulationMode::MICROSCOPIC);
+
+    // Switching back puts the same vehicles back, in order
+    const auto &lane = roads[0]->getLane(0);
+    const auto stored = tight.getLaneState(lane->getId())->stored_vehicles;
+    assert(stored.size() == 100 && lane->getVehicles().empty());
+    tight.forceMicroscopic(lane->getId());
+    assert(lane->getVehicles() == stored);
+    assert(tight.getLaneState(lane->getId())->stored_vehicles.empty());
+
+    std::cout << "AdaptiveSimulator frame budget tests PASSED" << std::endl;
+}
+
+void testAdaptiveParallel() {
+    std::cout << "Testing AdaptiveSimulator parallel update..." << std::endl;
+
+    using jamfree::hybrid::AdaptiveSimulator;
+    using jfk::model::Point2D;
+    using jfk::model::Road;
+
+    // Lanes of 30 vehicles, two of them macroscopic, on 1 and 3 threads,
+    // in chunks or in tasks balanced every few steps
+    auto run = [](std::size_t num_threads, int rebalance_period) {
+        std::vector<std::shared_ptr<Road>> roads;
+        AdaptiveSimulator::Config config;
+        config.rebalance_period = rebalance_period;
+        AdaptiveSimulator simulator(config);
+        simulator.setNumThreads(num_threads);
+        for (int r = 0; r < 20; ++r) {
+            auto road = std::make_shared<Road>(
+                "road_" + std::to_string(r), Point2D(0.0, r * 10.0),
+                Point2D(1000.0, r * 10.0), 1, 3.5);
+            auto lane = road->getLane(0);
+            for (int i = 0; i < 30; ++i) {
+                auto vehicle = std::make_shared<jfk::model::Vehicle>(
+                    lane->getId() + "_" + std::to_string(i));
+                vehicle->setLanePosition(i * 20.0);
+                vehicle->setSpeed(5.0 + (i * 7 + r) % 10);
+                lane->addVehicle(vehicle);
+            }
+            simulator.registerLane(lane);
+            roads.push_back(road);
+        }
+        simulator.forceMacroscopic(roads[3]->getLane(0)->getId());
+        simulator.forceMacroscopic(roads[11]->getLane(0)->getId());
+        jfm::models::IDM idm;
+        for (int step = 0; step < 50; ++step) {
+            simulator.update(0.1, idm);
+        }
+        std::vector<double> state;
+        for (const auto &road : roads) {
+            for (const auto &vehicle : road->getLane(0)->getVehicles()) {
+                state.push_back(vehicle->getLanePosition());
+                state.push_back(vehicle->getSpeed());
+            }
+        }
+        const auto &batch = simulator.getMacroscopicBatch();
+        for (const auto id : {roads[3]->getLane(0)->getId(),
+                              roads[11]->getLane(0)->getId()}) {
+            const std::size_t link = simulator.getLaneState(id)->macro_link;
+            for (int i = 0; i < batch.getNumCells(link); ++i) {
+                state.push_back(batch.getDensity(link, i));
+            }
+        }
+        assert(simulator.getStatistics().macro_lanes == 2);
+        return state;
+    };
+
+    // The lanes are independent: the same states, whatever the threads
+    const std::vector<double> sequential = run(1, 0);
+    assert(sequential.size() == 2 * 18 * 30 + 2 * 50);
+    assert(run(3, 0) == sequential);
+    assert(run(3, 5) == sequential);
+    assert(run(1, 5) == sequential);
+
+    std::cout << "AdaptiveSimulator parallel update tests PASSED" << std::endl;
+}
+
+void testAdaptiveDevice() {
+    std::cout << "Testing AdaptiveSimulator device lanes..." << std::endl;
+
+    using jamfree::hybrid::AdaptiveSimulator;
+    using jfk::model::Point2D;
+    using jfk::model::Road;
+
+    // A dense lane of 300 vehicles and a sparse one of 5, on 1 and 3 threads
+    for (const std::size_t num_threads : {std::size_t(1), std::size_t(3)}) {
+        AdaptiveSimulator::Config config;
+        config.device_min_vehicles = 100;
+        config.device_period = 1000;
+        config.micro_to_macro_density = 1e9;
+        AdaptiveSimulator simulator(config);
+        simulator.setNumThreads(num_threads);
+        simulator.setComputeBackend(
+            std::make_shared<jamfree::gpu::cpu::CpuCompute>());
+        std::vector<std::shared_ptr<Road>> roads;
+        const int counts[] = {300, 5};
+        for (int r = 0; r < 2; ++r) {
+            auto road = std::make_shared<Road>(
+                "road_" + std::to_string(r), Point2D(0.0, r * 10.0),
+                Point2D(10000.0, r * 10.0), 1, 3.5);
+            auto lane = road->getLane(0);
+            for (int i = 0; i < counts[r]; ++i) {
+                auto vehicle = std::make_shared<jfk::model::Vehicle>(
+                    lane->getId() + "_" + std::to_string(i));
+                vehicle->setLanePosition(i * 30.0);
+                vehicle->setSpeed(10.0 + i % 5);
+                lane->addVehicle(vehicle);
+            }
+            simulator.registerLane(lane);
+            roads.push_back(road);
+        }
+        const auto dense = roads[0]->getLane(0);
+        const auto sparse = roads[1]->getLane(0);
+        const double first = dense->getVehicles().front()->getLanePosition();
+
+        jfm::models::IDM idm;
+        simulator.update(0.1, idm);
+        assert(simulator.getLaneState(dense->getId())->on_device);
+        assert(!simulator.getLaneState(sparse->getId())->on_device);
+        assert(simulator.getStatistics().device_lanes == 1);
+        for (int step = 1; step < 20; ++step) {
+            simulator.update(0.1, idm);
+        }
+
+        // The states copied back, the lanes kept sorted by position
+        for (const auto &lane : {dense, sparse}) {
+            const auto &vehicles = lane->getVehicles();
+            assert(vehicles.size() == (lane == dense ? 300u : 5u));
+            for (std::size_t i = 1; i < vehicles.size(); ++i) {
+                assert(vehicles[i - 1]->getLanePosition() <=
+                       vehicles[i]->getLanePosition());
+            }
+        }
+        assert(dense->getVehicles().front()->getLanePosition() > first);
+        assert(simulator.getLaneState(dense->getId())->last_update_time_ms >=
+               0.0);
+
+        // Without backend, every lane back on the host
+        simulator.setComputeBackend(nullptr);
+        simulator.update(0.1, idm);
+        assert(simulator.getStatistics().device_lanes == 0);
+    }
+
+    std::cout << "AdaptiveSimulator device lanes tests PASSED" << std::endl;
+}
+
+void testAdaptiveMultirate() {
+    std::cout << "Testing AdaptiveSimulator multi-rate integration..."
+              << std::endl;
+
+    using jamfree::hybrid::AdaptiveSimulator;
+    using jfk::model::Point2D;
+    using jfk::model::Road;
+
+    // Free-flowing vehicles 500 m apart, ahead of a platoon 25 m apart
+    auto run = [](int coarse_steps, int &held) {
+        AdaptiveSimulator::Config config;
+        config.coarse_steps = coarse_steps;
+        config.micro_to_macro_density = 1e9;
+        config.micro_to_macro_count = 1000000;
+        AdaptiveSimulator simulator(config);
+        auto road = std::make_shared<Road>("road", Point2D(0.0, 0.0),
+                                           Point2D(20000.0, 0.0), 1, 3.5);
+        auto lane = road->getLane(0);
+        for (int i = 0; i < 20; ++i) {
+            auto vehicle = std::make_shared<jfk::model::Vehicle>(
+                "v" + std::to_string(i));
+            vehicle->setCurrentLane(lane);
+            vehicle->setLanePosition(i < 10 ? i * 25.0 : 1000.0 + i * 500.0);
+            vehicle->setSpeed(i < 10 ? 20.0 : 33.0);
+            lane->addVehicle(vehicle);
+        }
+        simulator.registerLane(lane);
+        jfm::models::IDM idm;
+        held = 0;
+        for (int step = 0; step < 100; ++step) {
+            simulator.update(0.1, idm);
+            held = std::max(held, simulator.getStatistics().held_vehicles);
+        }
+        std::vector<double> state;
+        const auto &vehicles = lane->getVehicles();
+        for (std::size_t i = 0; i < vehicles.size(); ++i) {
+            // The order kept, the held vehicles read at the current step
+            assert(i == 0 || vehicles[i - 1]->getGapTo(*vehicles[i]) > 0.0);
+            state.push_back(vehicles[i]->getLanePosition());
+            state.push_back(vehicles[i]->getSpeed());
+        }
+        return state;
+    };
+
+    int held = 0;
+    const std::vector<double> fine = run(1, held);
+    assert(held == 0);
+    const std::vector<double> coarse = run(5, held);
+    assert(held >= 10);
+    assert(coarse.size() == fine.size());
+    for (std::size_t i = 0; i < fine.size(); ++i) {
+        assert(std::abs(coarse[i] - fine[i]) < 0.5);
+    }
+
+    std::cout << "AdaptiveSimulator multi-rate integration tests PASSED"
+              << std::endl;
+}
+
+void testComputeBackend() {
+    std::cout << "Testing the CPU compute backend..." << std::endl;
+
+    jamfree::gpu::cpu::CpuCompute cpu;
+    jamfree::gpu::IComputeBackend &backend = cpu;
+    assert(backend.initialize(""));
+    assert(backend.getDeviceName() == "CPU");
+
+    // Two lanes of vehicles in lane order: the leaders on the same lane
+    auto lane_a = std::make_shared<jfk::model::Lane>("a", 0, 3.5, 1000.0);
+    auto lane_b = std::make_shared<jfk::model::Lane>("b", 1, 3.5, 1000.0);
+    std::vector<std::shared_ptr<jfk::model::Vehicle>> vehicles;
+    const double positions[] = {0.0, 30.0, 45.0, 10.0, 60.0};
+    for (int i = 0; i < 5; ++i) {
+        auto vehicle = std::make_shared<jfk::model::Vehicle>(
+            "v" + std::to_string(i));
+        vehicle->setCurrentLane(i < 3 ? lane_a : lane_b);
+        vehicle->setLanePosition(positions[i]);
+        vehicle->setSpeed(10.0 + i);
+        vehicles.push_back(vehicle);
+    }
+    backend.uploadVehicles(vehicles);
+    const auto &states = cpu.getVehicleStates();
+    assert(states[0].leader_index == 1 && states[1].leader_index == 2);
+    assert(states[2].leader_index == -1 && states[3].leader_index == 4);
+    assert(states[4].leader_index == -1);
+
+    // The kernels follow the IDM, gaps net of 5 m long vehicles
+    jfm::models::IDM idm(30.0, 1.5, 2.0, 1.0, 2.0, 4.0);
+    backend.setIDMParams(30.0, 1.5, 2.0, 1.0, 2.0, 4.0);
+    backend.calculateGaps(vehicles.size());
+    backend.computeIDMAccelerations(vehicles.size());
+    assert(std::abs(states[0].gap - 25.0f) < 1e-5f);
+    const double expected = idm.calculateAcceleration(10.0, 25.0, -1.0);
+    assert(expected > -10.0 && expected < 5.0);
+    assert(std::abs(states[0].acceleration - expected) < 1e-4);
+    assert(std::abs(states[2].acceleration -
+                    idm.calculateAcceleration(12.0, INFINITY, 0.0)) < 1e-4);
+
+    backend.updatePositions(vehicles.size(), 0.5);
+    backend.downloadVehicles(vehicles);
+    const double speed = std::max(0.0, 10.0 + 0.5 * expected);
+    assert(std::abs(vehicles[0]->getSpeed() - speed) < 1e-4);
+    assert(std::abs(vehicles[0]->getLanePosition() - 0.5 * speed) < 1e-4);
+
+    // Resident states: a spawn behind v3, then a lane change of v1 to b
+    assert(backend.getSnapshot() == nullptr);
+    backend.resizeVehicles(6);
+    assert(states[5].leader_index == jamfree::gpu::GPUVehicleState::IDLE);
+    assert(states[0].lane == 0 && states[3].lane == 1);
+    jamfree::gpu::GPUVehicleWrite spawn{
+        5, {0.0f, 8.0f, 0.0f, 3, 0.0f, 0.0f, 1}};
+    backend.writeVehicles(&spawn, 1);
+    const jamfree::gpu::GPULeaderWrite changes[] = {{0, 2}, {1, 4}, {3, 1}};
+    backend.writeLeaders(changes, 3);
+    backend.requestSnapshot(6);
+    const jamfree::gpu::GPUVehicleState *first = backend.getSnapshot();
+    backend.simulationStep(6, 0.5);
+    backend.requestSnapshot(6);
+    const jamfree::gpu::GPUVehicleState *second = backend.getSnapshot();
+    // The previous snapshot stays as it was
+    assert(first != second && first[5].speed == 8.0f);
+    assert(second[5].speed > 8.0f && second[5].position > 0.0f);
+    assert(std::abs(second[3].gap - (first[1].position - first[3].position -
+                                     5.0f)) < 1e-4f);
+
+    // A despawned slot keeps still
+    jamfree::gpu::GPUVehicleWrite despawn{
+        4, jamfree::gpu::IComputeBackend::idleVehicle()};
+    backend.writeVehicles(&despawn, 1);
+    backend.simulationStep(6, 0.5);
+    assert(states[4].speed == 0.0f && states[4].position == 0.0f);
+    bool thrown = false;
+    try {
+        jamfree::gpu::GPULeaderWrite out{6, -1};
+        backend.writeLeaders(&out, 1);
+    } catch (const std::out_of_range &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // The sort by lane derives the leaders and the neighbours: v1 moves to
+    // b, on the left of a
+    const jamfree::gpu::GPULaneWrite move{1, 1};
+    backend.writeLanes(&move, 1);
+    backend.setLaneNeighbours({1, -1}, {-1, 0});
+    backend.sortVehicles(6);
+    std::vector<jamfree::gpu::GPUNeighbours> around;
+    backend.downloadNeighbours(around);
+    assert(around.size() == 6);
+    // The first slot of a lane at or ahead of a position, the last behind
+    const auto onLane = [&](int lane, float position, int slot, bool ahead) {
+        int found = -1;
+        for (int i = 0; i < 6; ++i) {
+            if (i == slot || states[i].lane != lane ||
+                states[i].leader_index == jamfree::gpu::GPUVehicleState::IDLE) {
+                continue;
+            }
+            const bool is_ahead = states[i].position > position ||
+                                  (states[i].position == position && i > slot);
+            if (is_ahead != ahead) {
+                continue;
+            }
+            if (found < 0 ||
+                (ahead ? states[i].position < states[found].position
+                       : states[i].position >= states[found].position)) {
+                found = i;
+            }
+        }
+        return found;
+    };
+    for (int i = 0; i < 6; ++i) {
+        if (i == 4) {
+            continue;
+        }
+        const float x = states[i].position;
+        const int lane = states[i].lane;
+        assert(states[i].leader_index == onLane(lane, x, i, true));
+        assert(around[i].follower_index == onLane(lane, x, i, false));
+        const int left = lane == 0 ? 1 : -1;
+        const int right = lane == 1 ? 0 : -1;
+        assert(around[i].left_leader ==
+               (left < 0 ? -1 : onLane(left, x, -1, true)));
+        assert(around[i].left_follower ==
+               (left < 0 ? -1 : onLane(left, x, -1, false)));
+        assert(around[i].right_leader ==
+               (right < 0 ? -1 : onLane(right, x, -1, true)));
+        assert(around[i].right_follower ==
+               (right < 0 ? -1 : onLane(right, x, -1, false)));
+    }
+    assert(states[0].leader_index == 2 && states[2].leader_index == -1);
+    assert(states[4].leader_index == jamfree::gpu::GPUVehicleState::IDLE);
+
+    // A periodic LWR step conserves the vehicles
+    std::vector<double> density(100, 0.02), next;
+    for (int i = 40; i < 60; ++i) {
+        density[i] = 0.1;
+    }
+    backend.updateLWR(density, next, density.size(), 0.5, 10.0, 30.0, 0.15);
+    double before = 0.0, after = 0.0;
+    for (std::size_t i = 0; i < density.size(); ++i) {
+        before += density[i];
+        after += next[i];
+    }
+    assert(next.size() == 100 && std::abs(after - before) < 1e-4);
+    // The queue discharges downstream, fed by less than it discharges
+    assert(next[40] < 0.1 && next[60] > 0.02);
+    assert(std::abs(next[39] - 0.02) < 1e-6);
+
+    // An ensemble of two corridors, each followed with its own parameters
+    std::vector<jamfree::gpu::GPUScenario> scenarios(2);
+    scenarios[0].params = {30.0f, 1.5f, 2.0f, 1.0f, 2.0f, 4.0f};
+    scenarios[1].params = {20.0f, 1.0f, 2.0f, 1.5f, 2.0f, 4.0f};
+    for (int k = 0; k < 2; ++k) {
+        auto lane = std::make_shared<jfk::model::Lane>("e", 0, 3.5, 1000.0);
+        for (int i = 0; i < 2; ++i) {
+            auto vehicle = std::make_shared<jfk::model::Vehicle>(
+                "e" + std::to_string(2 * k + i));
+            vehicle->setCurrentLane(lane);
+            vehicle->setLanePosition(20.0 * i);
+            vehicle->setSpeed(10.0);
+            scenarios[k].vehicles.push_back(vehicle);
+        }
+    }
+    const jamfree::gpu::GPUEnsembleLayout layout =
+        backend.uploadScenarios(scenarios);
+    assert(layout.numScenarios() == 2 && layout.numSlots() == 4);
+    assert(layout.first_slot[1] == 2 && layout.first_lane[1] == 1);
+    // No leader is taken from the other corridor
+    assert(states[1].leader_index == -1 && states[2].leader_index == 3);
+    assert(states[2].lane == 1);
+    backend.sortVehicles(layout.numSlots());
+    assert(states[1].leader_index == -1 && states[2].leader_index == 3);
+    backend.calculateGaps(layout.numSlots());
+    backend.computeIDMAccelerations(layout.numSlots());
+    jfm::models::IDM slow(20.0, 1.0, 2.0, 1.5, 2.0, 4.0);
+    assert(std::abs(states[0].acceleration -
+                    idm.calculateAcceleration(10.0, 15.0, 0.0)) < 1e-4);
+    assert(std::abs(states[2].acceleration -
+                    slow.calculateAcceleration(10.0, 15.0, 0.0)) < 1e-4);
+    backend.simulationStep(layout.numSlots(), 0.5);
+    backend.downloadScenarios(scenarios, layout);
+    assert(scenarios[1].vehicles[1]->getLanePosition() ==
+           static_cast<double>(states[3].position));
+    // The free leader of the second corridor accelerates harder
+    assert(scenarios[0].vehicles[1]->getSpeed() <
+           scenarios[1].vehicles[1]->getSpeed());
+    thrown = false;
+    try {
+        backend.setScenarioParams({scenarios[0].params}, {0, 1});
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    assert(thrown);
+    // setIDMParams() gives all the slots its parameters again
+    backend.setIDMParams(20.0, 1.0, 2.0, 1.5, 2.0, 4.0);
+    backend.computeIDMAccelerations(layout.numSlots());
+    assert(std::abs(states[1].acceleration -
+                    slow.calculateAcceleration(states[1].speed, INFINITY,
+                                               0.0)) < 1e-4);
+
+    std::cout << "CPU compute backend tests PASSED" << std::endl;
+}
+
 int main() {
     std::cout << "Running basic JamFree C++ unit tests..." << std::endl;
     std::cout << "========================================" << std::endl;
@@ -284,14 +4272,60 @@ int main() {
         // Traffic models
         testVehicle();
         testRoadAndLane();
+        testLaneOrdering();
+        testObjectPool();
+        testVehicleStateExport();
+        testSimulationRunner();
+        testVehicleFrameCodec();
+        testTrajectoryRecorder();
+        testTrajectoryReplay();
+        testViewportFilter();
+        testRoadIndex();
+        testLiveTrafficFeed();
         testSpatialIndex();
+        testRouter();
+        testRouteTable();
+        testTripStream();
+        testODMatrix();
+        testDistributedSimulation();
+        testTrafficControl();
+        testDetectorSet();
+        testJunction();
 
         // Microscopic models
         testIDM();
+        testIDMLookup();
+        testLaneVehicleStore();
+        testCarFollowingModel();
+        testDecisionProgram();
+        testLanePerception();
+        testMultiLevelCoordinator();
+        testParallelSimulationEngine();
         testMOBIL();
+        testCalibration();
 
         // Macroscopic models (simplified)
         testMacroscopicModels();
+        testMacroscopicBatch();
+        testMacroscopicLargeSteps();
+        testNetworkCTM();
+
+        // Hybrid
+        testLaneProfile();
+        testFundamentalDiagramEstimator();
+        testAdaptiveBudget();
+        testAdaptiveParallel();
+        testAdaptiveDevice();
+        testAdaptiveMultirate();
+
+        // Compute backends
+        testComputeBackend();
+
+        // Real data
+        testOSMParser();
+        testOSMPbfParser();
+        testNetworkCache();
+        testOSMChange();
 
         std::cout << "========================================" << std::endl;
         std::cout << "ALL BASIC JAMFREE C++ TESTS PASSED! 🚗✨" << std::endl;
@@ -1,7 +1,9 @@
 #ifndef AGENTCATEGORY_H
 #define AGENTCATEGORY_H
 
+#include "libs/SymbolTable.h"
 #include <functional>
+#include <memory>
 #include <set>
 #include <stdexcept>
 #include <string>
@@ -15,18 +17,22 @@ namespace microkernel {
 
 /**
  * The object identifying the category of an agent involved in a simulation.
+ *
+ * The identifier is interned (see libs::Symbol) and the parents are shared
+ * by the copies, so that a category is copied, compared and hashed as an
+ * integer in the perceptions and the influences.
  */
 class AgentCategory {
 private:
   /**
-   * The string identifier of the category.
+   * The identifier of the category.
    */
-  std::string identifier;
+  libs::Symbol identifier;
 
   /**
-   * The identifiers of the direct parents of this category.
+   * The direct parents of this category, nullptr if it has none.
    */
-  std::set<AgentCategory> directParentCategories;
+  std::shared_ptr<const std::set<AgentCategory>> directParentCategories;
 
 public:
   /**
@@ -43,8 +49,10 @@ public:
     if (identifier.empty()) {
       // In Java it checked for null.
     }
-    for (const auto &parent : parents) {
-      this->directParentCategories.insert(parent);
+    if (!parents.empty()) {
+      this->directParentCategories =
+          std::make_shared<const std::set<AgentCategory>>(parents.begin(),
+                                                          parents.end());
     }
   }
 
@@ -52,7 +60,10 @@ public:
    * Gets a printable version of the agent category.
    * @return A string representation of the agent category.
    */
-  std::string toString() const { return this->identifier; }
+  const std::string &toString() const { return this->identifier.str(); }
+
+  /** Gets the interned identifier of the category. */
+  libs::Symbol getSymbol() const { return this->identifier; }
 
   /**
    * Determines if an agent having this category is considered as belonging to
@@ -64,8 +75,8 @@ public:
   bool isA(const AgentCategory &category) const {
     if (*this == category) {
       return true;
-    } else {
-      for (const auto &directParentCategory : this->directParentCategories) {
+    } else if (this->directParentCategories) {
+      for (const auto &directParentCategory : *this->directParentCategories) {
         if (directParentCategory.isA(category)) {
           return true;
         }
@@ -82,11 +93,15 @@ public:
     return !(*this == other);
   }
 
+  /** Orders the categories by their identifiers, as strings. */
   bool operator<(const AgentCategory &other) const {
-    return this->identifier < other.identifier;
+    return this->identifier != other.identifier &&
+           this->identifier.str() < other.identifier.str();
   }
 
-  std::size_t hashCode() const { return std::hash<std::string>{}(identifier); }
+  std::size_t hashCode() const {
+    return std::hash<libs::Symbol>{}(identifier);
+  }
 };
 
 } // namespace microkernel
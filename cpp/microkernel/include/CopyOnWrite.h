@@ -0,0 +1,74 @@
+#ifndef COPYONWRITE_H
+#define COPYONWRITE_H
+
+#include <memory>
+#include <utility>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+
+/**
+ * A value shared between copies until one of them is modified.
+ *
+ * Copying a CopyOnWrite only copies a reference to the value. The value is
+ * duplicated by mutate() when it is shared with another copy, so that the
+ * modification is not seen by the other copies. Copies may be read from
+ * several threads, but a given copy is modified by a single thread.
+ */
+template <typename T> class CopyOnWrite {
+private:
+  std::shared_ptr<T> value;
+
+public:
+  CopyOnWrite() : value(std::make_shared<T>()) {}
+
+  explicit CopyOnWrite(T initialValue)
+      : value(std::make_shared<T>(std::move(initialValue))) {}
+
+  /**
+   * Gets the value, without copying it.
+   */
+  const T &get() const { return *value; }
+
+  const T &operator*() const { return *value; }
+
+  const T *operator->() const { return value.get(); }
+
+  /**
+   * Gets the value for a modification, duplicating it first if it is shared
+   * with another copy.
+   */
+  T &mutate() {
+    if (value.use_count() > 1) {
+      value = std::make_shared<T>(*value);
+    }
+    return *value;
+  }
+
+  /**
+   * Replaces the value, without duplicating the former one if it is shared.
+   */
+  void reset(T newValue = T()) {
+    if (value.use_count() > 1) {
+      value = std::make_shared<T>(std::move(newValue));
+    } else {
+      *value = std::move(newValue);
+    }
+  }
+
+  /**
+   * Checks if the value is currently shared with another copy.
+   */
+  bool isShared() const { return value.use_count() > 1; }
+};
+
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // COPYONWRITE_H
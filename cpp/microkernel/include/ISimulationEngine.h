@@ -8,12 +8,14 @@
 #include <string>
 
 #include "ISimulationModel.h"
+#include "IStepTimingListener.h"
 #include "LevelIdentifier.h"
 #include "agents/IAgent4Engine.h"
 #include "dynamicstate/ConsistentPublicLocalDynamicState.h"
 #include "dynamicstate/IPublicDynamicStateMap.h"
 #include "dynamicstate/TransitoryPublicLocalDynamicState.h"
 #include "environment/IEnvironment4Engine.h"
+#include "engine/StepBarrier.h"
 #include "levels/ILevel.h"
 
 namespace fr {
@@ -91,6 +93,34 @@ public:
    */
   virtual void runSimulation(const SimulationTimeStamp &finalTime) = 0;
 
+  /**
+   * Sets the listener receiving the time spent in each phase of every step.
+   * The phases are only timed while a listener is set.
+   * @param listener The listener, or nullptr to stop timing the steps.
+   */
+  virtual void
+  setStepTimingListener(std::shared_ptr<IStepTimingListener> listener) = 0;
+
+  /**
+   * Gets the listener receiving the timings of the steps.
+   * @return The listener, nullptr if the steps are not timed.
+   */
+  virtual std::shared_ptr<IStepTimingListener>
+  getStepTimingListener() const = 0;
+
+  /**
+   * Sets the barrier the engine waits at before each step, to be paused,
+   * single-stepped or paced by another thread.
+   * @param barrier The barrier, or nullptr to run the steps freely.
+   */
+  virtual void setStepBarrier(std::shared_ptr<engine::StepBarrier> barrier) = 0;
+
+  /**
+   * Gets the barrier the engine waits at before each step.
+   * @return The barrier, nullptr if the steps run freely.
+   */
+  virtual std::shared_ptr<engine::StepBarrier> getStepBarrier() const = 0;
+
   /**
    * Gets the current dynamic states of the simulation.
    * @return The dynamic state of the simulation.
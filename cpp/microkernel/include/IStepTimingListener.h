@@ -0,0 +1,116 @@
+#ifndef ISTEPTIMINGLISTENER_H
+#define ISTEPTIMINGLISTENER_H
+
+#include "SimulationTimeStamp.h"
+#include "libs/PerformanceCounters.h"
+#include <chrono>
+#include <cstddef>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+
+/**
+ * The time spent by a simulation engine in each phase of a step.
+ *
+ * The perception, revision and decision times are summed over the threads
+ * running the agents, so that they compare with each other whatever the
+ * number of threads. The other durations are elapsed (wall-clock) times.
+ */
+struct StepTimings {
+  using Duration = std::chrono::nanoseconds;
+
+  /** The transitory period of the step. */
+  SimulationTimeStamp timeLowerBound{0};
+  SimulationTimeStamp timeUpperBound{0};
+
+  /** Time spent building the perceived data of the agents. */
+  Duration perception{0};
+  /** Time spent revising the global states of the agents. */
+  Duration revision{0};
+  /** Time spent in the decisions of the agents. */
+  Duration decision{0};
+
+  /** Elapsed time of the phase running perception, revision and decision. */
+  Duration agentPhase{0};
+  /** Elapsed time gathering the influences of the agents by level. */
+  Duration merge{0};
+  /** Elapsed time of the regular reactions of the levels. */
+  Duration reaction{0};
+  /** Elapsed time applying the system influences (births, deaths...). */
+  Duration structuralUpdate{0};
+  /** Elapsed time of the probes observing the end of the step. */
+  Duration probes{0};
+  /** Elapsed time of the whole step. */
+  Duration total{0};
+
+  /** The number of threads that ran the agents. */
+  std::size_t threadCount = 1;
+  /** Time the threads spent running agents during agentPhase, summed. */
+  Duration workerBusy{0};
+  /** The number of agents when the step started. */
+  std::size_t agentCount = 0;
+  /** The number of influences the agents emitted during the step. */
+  std::size_t influenceCount = 0;
+
+  /**
+   * The hardware counters of the phases of a step, summed over the threads
+   * that ran the engine.
+   */
+  struct PhaseCounters {
+    libs::CounterValues agentPhase;
+    libs::CounterValues merge;
+    libs::CounterValues reaction;
+    libs::CounterValues structuralUpdate;
+    libs::CounterValues probes;
+    libs::CounterValues total;
+  };
+
+  /**
+   * True if the engine counted the phases with the hardware counters (see
+   * setPerformanceCounting() of the engines); counters is zero otherwise.
+   */
+  bool counted = false;
+  PhaseCounters counters;
+
+  /**
+   * Gets the fraction of the agent phase during which the threads were busy,
+   * between 0 and 1. Low values point to an unbalanced load or to threads
+   * waiting for each other.
+   */
+  double threadUtilization() const {
+    if (agentPhase.count() <= 0 || threadCount == 0) {
+      return 0.0;
+    }
+    return static_cast<double>(workerBusy.count()) /
+           (static_cast<double>(agentPhase.count()) *
+            static_cast<double>(threadCount));
+  }
+};
+
+/**
+ * Receives the timings of every step run by a simulation engine.
+ *
+ * The listener is called on the thread running the simulation, once the
+ * probes observed the step; its own duration is not part of the timings.
+ */
+class IStepTimingListener {
+public:
+  virtual ~IStepTimingListener() = default;
+
+  /**
+   * Receives the timings of a step that just ended.
+   * @param timings The time spent in each phase of the step.
+   */
+  virtual void stepTimed(const StepTimings &timings) = 0;
+};
+
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // ISTEPTIMINGLISTENER_H
@@ -1,9 +1,12 @@
 #ifndef LEVELIDENTIFIER_H
 #define LEVELIDENTIFIER_H
 
+#include <cstddef>
 #include <functional>
+#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
 
 namespace fr {
 namespace univ_artois {
@@ -13,6 +16,11 @@ namespace microkernel {
 
 /**
  * The object identifying one level involved in a simulation.
+ *
+ * Every distinct string identifier is interned into a process-wide registry
+ * giving it a small dense index. Equality and hashing use this index, and
+ * LevelIndexedMap uses it to replace tree lookups by array accesses. The
+ * string form remains available for display and interoperability.
  */
 class LevelIdentifier {
 private:
@@ -21,6 +29,28 @@ private:
    */
   std::string identifier;
 
+  /**
+   * The dense index interned for the identifier.
+   */
+  std::size_t index;
+
+  struct Registry {
+    std::mutex mutex;
+    std::unordered_map<std::string, std::size_t> indices;
+  };
+
+  static Registry &registry() {
+    static Registry instance;
+    return instance;
+  }
+
+  static std::size_t intern(const std::string &identifier) {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    auto it = reg.indices.emplace(identifier, reg.indices.size()).first;
+    return it->second;
+  }
+
 public:
   /**
    * Builds an instance of this class using a specific value for the level
@@ -28,7 +58,7 @@ public:
    * @param identifier The identifier of the level. This value should be unique.
    */
   explicit LevelIdentifier(const std::string &identifier)
-      : identifier(identifier) {
+      : identifier(identifier), index(intern(identifier)) {
     if (identifier.empty()) { // Assuming empty check as null check equivalent
                               // or just allowing empty string but not null
       // In Java it checked for null. In C++ string cannot be null, but can be
@@ -42,19 +72,38 @@ public:
    */
   std::string toString() const { return this->identifier; }
 
+  /**
+   * Gets the dense index of the level identifier. Two identifiers built from
+   * the same string share the same index.
+   * @return An index in [0, getRegisteredCount()).
+   */
+  std::size_t getIndex() const { return this->index; }
+
+  /**
+   * Gets the number of distinct level identifiers built so far.
+   * @return An upper bound of the indices returned by getIndex().
+   */
+  static std::size_t getRegisteredCount() {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    return reg.indices.size();
+  }
+
   bool operator==(const LevelIdentifier &other) const {
-    return this->identifier == other.identifier;
+    return this->index == other.index;
   }
 
   bool operator!=(const LevelIdentifier &other) const {
     return !(*this == other);
   }
 
+  // Ordered by string so that the iteration order of ordered containers does
+  // not depend on the order in which the identifiers were interned.
   bool operator<(const LevelIdentifier &other) const {
-    return this->identifier < other.identifier;
+    return this->index != other.index && this->identifier < other.identifier;
   }
 
-  std::size_t hashCode() const { return std::hash<std::string>{}(identifier); }
+  std::size_t hashCode() const { return std::hash<std::size_t>{}(index); }
 };
 
 } // namespace microkernel
@@ -0,0 +1,142 @@
+#ifndef LEVELINDEXEDMAP_H
+#define LEVELINDEXEDMAP_H
+
+#include <cstddef>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "LevelIdentifier.h"
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+
+/**
+ * A map from level identifiers to values, stored in an array indexed by the
+ * dense index of the level identifiers.
+ *
+ * Lookups and insertions are constant-time array accesses, instead of the
+ * string comparisons performed by a std::map keyed by LevelIdentifier.
+ * Iteration follows the interning order of the identifiers.
+ */
+template <typename T> class LevelIndexedMap {
+private:
+  std::vector<std::optional<LevelIdentifier>> keys;
+  std::vector<std::optional<T>> values;
+  std::size_t count = 0;
+
+public:
+  /**
+   * Gets the value mapped to a level, inserting a default-constructed one if
+   * the level is not mapped yet.
+   */
+  T &operator[](const LevelIdentifier &level) {
+    const std::size_t index = level.getIndex();
+    if (index >= values.size()) {
+      keys.resize(index + 1);
+      values.resize(index + 1);
+    }
+    if (!values[index]) {
+      keys[index] = level;
+      values[index].emplace();
+      ++count;
+    }
+    return *values[index];
+  }
+
+  /**
+   * Gets the value mapped to a level, or nullptr if the level is not mapped.
+   */
+  T *find(const LevelIdentifier &level) {
+    const std::size_t index = level.getIndex();
+    return index < values.size() && values[index] ? &*values[index] : nullptr;
+  }
+
+  const T *find(const LevelIdentifier &level) const {
+    const std::size_t index = level.getIndex();
+    return index < values.size() && values[index] ? &*values[index] : nullptr;
+  }
+
+  /**
+   * Gets the value mapped to a level.
+   * @throws std::out_of_range If the level is not mapped.
+   */
+  const T &at(const LevelIdentifier &level) const {
+    const T *value = find(level);
+    if (value == nullptr) {
+      throw std::out_of_range("Level not found: " + level.toString());
+    }
+    return *value;
+  }
+
+  bool contains(const LevelIdentifier &level) const {
+    return find(level) != nullptr;
+  }
+
+  /**
+   * Removes the value mapped to a level, if any.
+   */
+  void erase(const LevelIdentifier &level) {
+    const std::size_t index = level.getIndex();
+    if (index < values.size() && values[index]) {
+      keys[index].reset();
+      values[index].reset();
+      --count;
+    }
+  }
+
+  std::size_t size() const { return count; }
+
+  bool empty() const { return count == 0; }
+
+  void clear() {
+    keys.clear();
+    values.clear();
+    count = 0;
+  }
+
+  /**
+   * Gets the mapped levels.
+   */
+  std::set<LevelIdentifier> keySet() const {
+    std::set<LevelIdentifier> result;
+    for (const auto &key : keys) {
+      if (key) {
+        result.insert(*key);
+      }
+    }
+    return result;
+  }
+
+  /**
+   * Calls consumer(level, value) for every mapped level.
+   */
+  template <typename Consumer> void forEach(Consumer &&consumer) {
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      if (values[i]) {
+        consumer(*keys[i], *values[i]);
+      }
+    }
+  }
+
+  template <typename Consumer> void forEach(Consumer &&consumer) const {
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      if (values[i]) {
+        consumer(*keys[i], *values[i]);
+      }
+    }
+  }
+};
+
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // LEVELINDEXEDMAP_H
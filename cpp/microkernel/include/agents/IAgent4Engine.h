@@ -8,6 +8,9 @@ namespace univ_artois {
 namespace lgi2a {
 namespace similar {
 namespace microkernel {
+namespace engine {
+class IAgentStepKernel;
+} // namespace engine
 namespace agents {
 
 /**
@@ -59,6 +62,68 @@ public:
    */
   virtual std::map<LevelIdentifier, std::shared_ptr<ILocalStateOfAgent>>
   getPublicLocalStates() const = 0;
+
+  /**
+   * Borrows the global state of the agent.
+   *
+   * The borrow methods give the engines references to the states held by the
+   * agent, so that stepping it copies neither maps nor shared pointers. The
+   * references are valid until the agent enters or leaves a level or its
+   * perceived data change; whoever keeps a state beyond copies the pointer.
+   */
+  virtual const std::shared_ptr<IGlobalState> &borrowGlobalState() const = 0;
+
+  /**
+   * Borrows the public local states of the agent.
+   */
+  virtual const std::map<LevelIdentifier, std::shared_ptr<ILocalStateOfAgent>>
+      &borrowPublicLocalStates() const = 0;
+
+  /**
+   * Borrows the public local state of the agent in a level.
+   * @throws std::out_of_range If the agent does not lie in the level.
+   */
+  virtual const std::shared_ptr<ILocalStateOfAgent> &
+  borrowPublicLocalState(const LevelIdentifier &levelIdentifier) const = 0;
+
+  /**
+   * Borrows the private local state of the agent in a level.
+   * @throws std::out_of_range If the agent does not lie in the level.
+   */
+  virtual const std::shared_ptr<ILocalStateOfAgent> &
+  borrowPrivateLocalState(const LevelIdentifier &levelIdentifier) const = 0;
+
+  /**
+   * Borrows the data lastly perceived by the agent. An agent keeping the
+   * data of a level apart may omit them from this map, and only give them
+   * with borrowLastPerceivedData().
+   */
+  virtual const std::map<LevelIdentifier, std::shared_ptr<IPerceivedData>>
+      &borrowPerceivedData() const = 0;
+
+  /**
+   * Borrows the data lastly perceived by the agent in a level.
+   * @return The data, or a null pointer if the agent did not perceive there.
+   */
+  virtual const std::shared_ptr<IPerceivedData> &
+  borrowLastPerceivedData(const LevelIdentifier &levelIdentifier) const {
+    static const std::shared_ptr<IPerceivedData> none;
+    const auto &perceivedData = borrowPerceivedData();
+    auto it = perceivedData.find(levelIdentifier);
+    return it != perceivedData.end() ? it->second : none;
+  }
+
+  /**
+   * Gets the kernel stepping the agent in a level in batches with the other
+   * agents of its type, if any.
+   * @param levelIdentifier The identifier of the level.
+   * @return The kernel, or nullptr to step the agent through its perceive,
+   * reviseGlobalState and decide methods.
+   */
+  virtual const engine::IAgentStepKernel *
+  getStepKernel(const LevelIdentifier & /*levelIdentifier*/) const {
+    return nullptr;
+  }
 };
 
 } // namespace agents
@@ -41,6 +41,20 @@ public:
    */
   virtual SimulationTimeStamp getTransitoryPeriodMax() const = 0;
 
+  /**
+   * Empties these data so that the next perception of the agent refills them
+   * in place instead of allocating new ones. The agents only reset the data
+   * they perceived at the previous step, once nobody else holds them.
+   * @param timeLowerBound The lower bound of the new transitory period.
+   * @param timeUpperBound The upper bound of the new transitory period.
+   * @return true if the data were reset, false if they cannot be reused,
+   * which is the default.
+   */
+  virtual bool reset(const SimulationTimeStamp & /*timeLowerBound*/,
+                     const SimulationTimeStamp & /*timeUpperBound*/) {
+    return false;
+  }
+
   /**
    * Clones the perceived data, creating a deep copy.
    * @return A deep copy of the perceived data.
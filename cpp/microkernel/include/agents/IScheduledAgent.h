@@ -0,0 +1,60 @@
+#ifndef ISCHEDULEDAGENT_H
+#define ISCHEDULEDAGENT_H
+
+#include "../SimulationTimeStamp.h"
+#include "IWakeCondition.h"
+#include <memory>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace agents {
+
+/**
+ * Implemented by the agents that know when they next have something to do.
+ *
+ * When the activation scheduling of the engine is enabled, an agent
+ * implementing this interface does not perceive, revise its global state nor
+ * decide during the steps before its next activation time. The agents that
+ * do not implement it are activated at every step.
+ *
+ * An agent sleeping until an event rather than a time, e.g. a stopped turtle
+ * waiting for a neighbour, gives a far activation time and a wake condition:
+ * it is activated by whichever comes first.
+ */
+class IScheduledAgent {
+public:
+  virtual ~IScheduledAgent() = default;
+
+  /**
+   * Gets the time at which the agent has to be activated again, once it
+   * decided during a step.
+   * @param timeUpperBound The upper bound of the step the agent decided in,
+   * i.e. the earliest possible next activation time.
+   * @return The lower bound of the next step the agent takes part in. Times
+   * before timeUpperBound are treated as timeUpperBound.
+   */
+  virtual SimulationTimeStamp
+  getNextActivationTime(const SimulationTimeStamp &timeUpperBound) const = 0;
+
+  /**
+   * Gets the condition waking the agent up before its next activation time,
+   * asked once the agent decided, when it does not take part in the next
+   * step.
+   * @return The condition, or nullptr to sleep until the activation time.
+   */
+  virtual std::shared_ptr<const IWakeCondition> getWakeCondition() const {
+    return nullptr;
+  }
+};
+
+} // namespace agents
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // ISCHEDULEDAGENT_H
@@ -0,0 +1,69 @@
+#ifndef IWAKECONDITION_H
+#define IWAKECONDITION_H
+
+#include "../SimulationTimeStamp.h"
+#include "../dynamicstate/IPublicDynamicStateMap.h"
+#include <functional>
+#include <utility>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace agents {
+
+/**
+ * The event waking up a sleeping agent before its next activation time, e.g.
+ * a neighbour entering a radius, a pheromone reaching a threshold or the
+ * vehicle ahead moving again.
+ *
+ * A condition only reads the consistent states of the levels: the engine
+ * evaluates the conditions of the sleeping agents at the start of each step,
+ * and activates during this step the agents whose condition is met.
+ */
+class IWakeCondition {
+public:
+  virtual ~IWakeCondition() = default;
+
+  /**
+   * Tells whether the sleeping agent has to take part in a step.
+   * @param timeLowerBound The lower bound of the step.
+   * @param dynamicStates The consistent states of the levels at this time.
+   * @return true to activate the agent during the step.
+   */
+  virtual bool
+  isMet(const SimulationTimeStamp &timeLowerBound,
+        const dynamicstate::IPublicDynamicStateMap &dynamicStates) const = 0;
+};
+
+/**
+ * A wake condition given by a function, e.g. a lambda capturing the state
+ * the agent went to sleep with.
+ */
+class WakeWhen : public IWakeCondition {
+public:
+  using Predicate =
+      std::function<bool(const SimulationTimeStamp &,
+                         const dynamicstate::IPublicDynamicStateMap &)>;
+
+  explicit WakeWhen(Predicate predicate) : predicate(std::move(predicate)) {}
+
+  bool isMet(const SimulationTimeStamp &timeLowerBound,
+             const dynamicstate::IPublicDynamicStateMap &dynamicStates)
+      const override {
+    return predicate(timeLowerBound, dynamicStates);
+  }
+
+private:
+  Predicate predicate;
+};
+
+} // namespace agents
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // IWAKECONDITION_H
@@ -0,0 +1,184 @@
+#ifndef CHECKPOINTSTREAM_H
+#define CHECKPOINTSTREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace checkpoint {
+
+/**
+ * Exception thrown when a checkpoint cannot be written, read or applied.
+ */
+class CheckpointException : public std::runtime_error {
+public:
+  CheckpointException(const std::string &message)
+      : std::runtime_error(message) {}
+};
+
+/**
+ * Appends values to the binary representation of a checkpoint.
+ *
+ * Integers are written in little-endian order whatever the host, and doubles
+ * as their IEEE 754 bit pattern, so that a checkpoint can be restored on
+ * another machine. Nested objects are written as blocks prefixed with their
+ * size, so that a reader can skip the ones it does not know.
+ */
+class CheckpointWriter {
+private:
+  std::vector<std::uint8_t> bytes;
+
+public:
+  void writeU8(std::uint8_t value) { bytes.push_back(value); }
+
+  void writeBool(bool value) { writeU8(value ? 1 : 0); }
+
+  void writeU32(std::uint32_t value) {
+    for (int shift = 0; shift < 32; shift += 8) {
+      bytes.push_back(static_cast<std::uint8_t>(value >> shift));
+    }
+  }
+
+  void writeU64(std::uint64_t value) {
+    for (int shift = 0; shift < 64; shift += 8) {
+      bytes.push_back(static_cast<std::uint8_t>(value >> shift));
+    }
+  }
+
+  void writeI64(std::int64_t value) {
+    writeU64(static_cast<std::uint64_t>(value));
+  }
+
+  void writeDouble(double value) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    writeU64(bits);
+  }
+
+  void writeBytes(const void *data, std::size_t size) {
+    const auto *first = static_cast<const std::uint8_t *>(data);
+    bytes.insert(bytes.end(), first, first + size);
+  }
+
+  void writeString(const std::string &value) {
+    writeU64(value.size());
+    writeBytes(value.data(), value.size());
+  }
+
+  /**
+   * Writes the content of another writer as a block prefixed with its size.
+   */
+  void writeBlock(const CheckpointWriter &block) {
+    writeU64(block.bytes.size());
+    writeBytes(block.bytes.data(), block.bytes.size());
+  }
+
+  const std::vector<std::uint8_t> &getBytes() const { return bytes; }
+
+  std::size_t size() const { return bytes.size(); }
+
+  /**
+   * Writes the checkpoint to a file. The bytes go to a temporary file renamed
+   * once complete, so that a crash while writing keeps the former checkpoint.
+   * @throws CheckpointException If the file cannot be written.
+   */
+  void saveTo(const std::string &path) const;
+};
+
+/**
+ * Reads the values of a checkpoint from a contiguous range of bytes, e.g. a
+ * memory-mapped file. The reader does not own the bytes.
+ */
+class CheckpointReader {
+private:
+  const std::uint8_t *cursor = nullptr;
+  const std::uint8_t *end = nullptr;
+
+  const std::uint8_t *take(std::size_t size) {
+    if (static_cast<std::size_t>(end - cursor) < size) {
+      throw CheckpointException("The checkpoint is truncated.");
+    }
+    const std::uint8_t *first = cursor;
+    cursor += size;
+    return first;
+  }
+
+public:
+  CheckpointReader() = default;
+
+  CheckpointReader(const void *data, std::size_t size)
+      : cursor(static_cast<const std::uint8_t *>(data)), end(cursor + size) {}
+
+  std::uint8_t readU8() { return *take(1); }
+
+  bool readBool() { return readU8() != 0; }
+
+  std::uint32_t readU32() {
+    const std::uint8_t *first = take(4);
+    std::uint32_t value = 0;
+    for (int i = 3; i >= 0; --i) {
+      value = (value << 8) | first[i];
+    }
+    return value;
+  }
+
+  std::uint64_t readU64() {
+    const std::uint8_t *first = take(8);
+    std::uint64_t value = 0;
+    for (int i = 7; i >= 0; --i) {
+      value = (value << 8) | first[i];
+    }
+    return value;
+  }
+
+  std::int64_t readI64() { return static_cast<std::int64_t>(readU64()); }
+
+  double readDouble() {
+    const std::uint64_t bits = readU64();
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  void readBytes(void *data, std::size_t size) {
+    std::memcpy(data, take(size), size);
+  }
+
+  std::string readString() {
+    const std::uint64_t size = readU64();
+    const std::uint8_t *first = take(size);
+    return std::string(reinterpret_cast<const char *>(first), size);
+  }
+
+  /**
+   * Reads a block written by CheckpointWriter::writeBlock, without copying.
+   */
+  CheckpointReader readBlock() {
+    const std::uint64_t size = readU64();
+    const std::uint8_t *first = take(size);
+    return CheckpointReader(first, size);
+  }
+
+  std::size_t remaining() const {
+    return static_cast<std::size_t>(end - cursor);
+  }
+
+  bool atEnd() const { return cursor == end; }
+};
+
+} // namespace checkpoint
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // CHECKPOINTSTREAM_H
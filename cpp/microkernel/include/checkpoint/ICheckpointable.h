@@ -0,0 +1,47 @@
+#ifndef ICHECKPOINTABLE_H
+#define ICHECKPOINTABLE_H
+
+#include "CheckpointStream.h"
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace checkpoint {
+
+/**
+ * Models an object whose content can be saved in a checkpoint and restored
+ * from it.
+ *
+ * Levels, local states, global states and environments implement this
+ * interface to take part in the checkpoints of the engines. Objects that do
+ * not implement it are left as the simulation model rebuilds them when a
+ * checkpoint is restored.
+ */
+class ICheckpointable {
+public:
+  virtual ~ICheckpointable() = default;
+
+  /**
+   * Writes the content of this object.
+   * @param writer The writer of the checkpoint.
+   */
+  virtual void writeCheckpoint(CheckpointWriter &writer) const = 0;
+
+  /**
+   * Replaces the content of this object by the one read from a checkpoint.
+   * @param reader The reader positioned on what writeCheckpoint wrote.
+   * @throws CheckpointException If the content cannot be read.
+   */
+  virtual void readCheckpoint(CheckpointReader &reader) = 0;
+};
+
+} // namespace checkpoint
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // ICHECKPOINTABLE_H
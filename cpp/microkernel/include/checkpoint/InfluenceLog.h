@@ -0,0 +1,241 @@
+#ifndef INFLUENCELOG_H
+#define INFLUENCELOG_H
+
+#include "../LevelIdentifier.h"
+#include "../SimulationTimeStamp.h"
+#include "../influences/IInfluence.h"
+#include "MappedFile.h"
+#include "SimulationCheckpoint.h"
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace checkpoint {
+
+/** The influences of a step, by index of level. */
+using InfluencesByLevel =
+    std::vector<std::set<std::shared_ptr<influences::IInfluence>>>;
+
+/**
+ * Writes and reads the influences of a category in an influence log. The
+ * time bounds and the target level of an influence are not written: the
+ * log knows them from the step and the level it is recorded in.
+ */
+struct InfluenceCodec {
+  using Writer =
+      std::function<void(const influences::IInfluence &, CheckpointWriter &)>;
+  using Reader = std::function<std::shared_ptr<influences::IInfluence>(
+      CheckpointReader &reader, const LevelIdentifier &targetLevel,
+      const SimulationTimeStamp &timeLowerBound,
+      const SimulationTimeStamp &timeUpperBound)>;
+
+  Writer write;
+  Reader read;
+};
+
+/**
+ * The codecs of the influences of a model, by influence category (see
+ * influences::IInfluence::getCategory). The same categories have to be
+ * registered to record and to replay a log; their order does not matter.
+ */
+class InfluenceCodecs {
+private:
+  std::vector<std::string> categories;
+  std::vector<InfluenceCodec> codecs;
+  std::map<std::string, std::uint32_t> indices;
+
+public:
+  /**
+   * Registers the codec of a category, replacing the former one if any.
+   */
+  void add(const std::string &category, InfluenceCodec::Writer write,
+           InfluenceCodec::Reader read);
+
+  /**
+   * Gets the index of the codec of a category.
+   * @throws CheckpointException If the category has no codec.
+   */
+  std::uint32_t indexOf(const std::string &category) const;
+
+  const InfluenceCodec &at(std::uint32_t index) const { return codecs[index]; }
+
+  const std::vector<std::string> &getCategories() const { return categories; }
+
+  /**
+   * Writes the influences of a step; only the levels having influences are
+   * written, by their index.
+   * @throws CheckpointException If an influence has no codec.
+   */
+  void write(CheckpointWriter &writer,
+             const InfluencesByLevel &influencesByLevel) const;
+
+  /**
+   * Reads the influences written by write().
+   * @param levels The identifiers of the levels, by index.
+   * @param codecOfCategory The index in these codecs of each codec index
+   * written, or nullptr if the influences were written with these codecs.
+   * @throws CheckpointException If a level or a codec is unknown.
+   */
+  void read(CheckpointReader &reader,
+            const std::vector<LevelIdentifier> &levels,
+            const SimulationTimeStamp &timeLowerBound,
+            const SimulationTimeStamp &timeUpperBound,
+            InfluencesByLevel &influencesByLevel,
+            const std::vector<std::uint32_t> *codecOfCategory = nullptr) const;
+};
+
+/**
+ * Records a simulation as the initial checkpoint followed by the merged
+ * regular influences of each step, a fraction of the size of a checkpoint
+ * per step.
+ *
+ * A log holds, after a versioned header, the categories of its codecs, the
+ * identifiers of the levels and the initial checkpoint (see
+ * SimulationCheckpoint). Then comes one record per step:
+ * - a step record holds the time bounds of the step, the sections given to
+ *   the log (e.g. the random generators) as they are before the reactions,
+ *   and the regular influences of each level;
+ * - a key frame holds a checkpoint taken once a step is over. The engines
+ *   write one after the steps having system influences, which add and remove
+ *   agents that the log does not encode.
+ *
+ * The records are appended to the file as the simulation runs; a log cut
+ * short by a crash replays up to its last complete record.
+ */
+class InfluenceLogWriter {
+private:
+  std::string path;
+  InfluenceCodecs codecs;
+  std::ofstream output;
+  std::map<LevelIdentifier, std::uint32_t> levelIndices;
+  bool started = false;
+
+  void append(std::uint8_t kind, const CheckpointWriter &record);
+
+public:
+  /**
+   * Creates the log file.
+   * @param path The file of the log, replaced if it exists.
+   * @param codecs The codecs of the regular influences of the model.
+   * @throws CheckpointException If the file cannot be created.
+   */
+  InfluenceLogWriter(const std::string &path, InfluenceCodecs codecs);
+
+  const std::string &getPath() const { return path; }
+
+  /** Tells whether the header and the initial checkpoint were written. */
+  bool isStarted() const { return started; }
+
+  /**
+   * Writes the header of the log.
+   * @param levels The identifiers of the levels, in the order of the
+   * influences passed to writeStep.
+   * @param initialCheckpoint The checkpoint of the simulation before the
+   * first recorded step.
+   * @throws std::logic_error If the log was already started.
+   */
+  void start(const std::vector<LevelIdentifier> &levels,
+             const CheckpointWriter &initialCheckpoint);
+
+  /**
+   * Appends the record of a step.
+   * @param influencesByLevel The regular influences of each level, in the
+   * order of the levels given to start.
+   * @throws CheckpointException If an influence has no codec.
+   */
+  void writeStep(const SimulationTimeStamp &timeLowerBound,
+                 const SimulationTimeStamp &timeUpperBound,
+                 const CheckpointSections &sections,
+                 const InfluencesByLevel &influencesByLevel);
+
+  /**
+   * Appends a key frame, the checkpoint of the simulation once a step is
+   * over.
+   */
+  void writeKeyFrame(const CheckpointWriter &checkpoint);
+
+  /** Writes the buffered records to the file. */
+  void flush();
+
+  /**
+   * Writes the checkpoints of some objects, by name, as in the step records;
+   * InfluenceLogReader::restoreSections reads them back.
+   */
+  static void writeSections(CheckpointWriter &writer,
+                            const CheckpointSections &sections);
+};
+
+/**
+ * Reads an influence log written by InfluenceLogWriter, mapped in memory.
+ */
+class InfluenceLogReader {
+public:
+  /** A record of the log. */
+  struct Record {
+    enum class Kind { STEP, KEY_FRAME };
+    Kind kind = Kind::STEP;
+    SimulationTimeStamp timeLowerBound{0};
+    SimulationTimeStamp timeUpperBound{0};
+    /** The sections of a step, restored through restoreSections */
+    CheckpointReader sections;
+    /** The regular influences of a step, by index of level */
+    InfluencesByLevel influencesByLevel;
+    /** The checkpoint of a key frame */
+    CheckpointReader checkpoint;
+  };
+
+  /**
+   * Maps a log and reads its header.
+   * @param codecs The codecs of the influences of the model; they have to
+   * cover the categories of the log.
+   * @throws CheckpointException If the log is invalid or of a newer version.
+   */
+  InfluenceLogReader(const std::string &path, InfluenceCodecs codecs);
+
+  /** Gets the identifiers of the levels of the log. */
+  const std::vector<LevelIdentifier> &getLevels() const { return levels; }
+
+  /** Gets a reader of the initial checkpoint. */
+  CheckpointReader initialCheckpoint() const { return checkpoint; }
+
+  /**
+   * Reads the next complete record.
+   * @return false at the end of the log.
+   */
+  bool next(Record &record);
+
+  /**
+   * Restores the sections of a step record into the objects of the same
+   * names; the sections missing from the map are skipped.
+   */
+  static void restoreSections(CheckpointReader sections,
+                              const CheckpointSections &objects);
+
+private:
+  MappedFile file;
+  InfluenceCodecs codecs;
+  /** The index of the codec of each category of the log */
+  std::vector<std::uint32_t> codecOfCategory;
+  std::vector<LevelIdentifier> levels;
+  CheckpointReader checkpoint;
+  CheckpointReader records;
+};
+
+} // namespace checkpoint
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // INFLUENCELOG_H
@@ -0,0 +1,54 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include "CheckpointStream.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace checkpoint {
+
+/**
+ * A file mapped read-only in memory, so that a checkpoint is read without
+ * copying it first. On platforms without mmap, the file is read in a buffer.
+ */
+class MappedFile {
+private:
+  const std::uint8_t *mapped = nullptr;
+  std::size_t length = 0;
+  std::vector<std::uint8_t> buffer;
+
+public:
+  /**
+   * Maps a file.
+   * @throws CheckpointException If the file cannot be opened or mapped.
+   */
+  explicit MappedFile(const std::string &path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const std::uint8_t *data() const {
+    return mapped != nullptr ? mapped : buffer.data();
+  }
+
+  std::size_t size() const { return length; }
+
+  CheckpointReader reader() const { return CheckpointReader(data(), size()); }
+};
+
+} // namespace checkpoint
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // MAPPEDFILE_H
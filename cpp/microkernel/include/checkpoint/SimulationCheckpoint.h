@@ -0,0 +1,107 @@
+#ifndef SIMULATIONCHECKPOINT_H
+#define SIMULATIONCHECKPOINT_H
+
+#include "../AgentCategory.h"
+#include "../LevelIdentifier.h"
+#include "../SimulationTimeStamp.h"
+#include "../agents/IAgent4Engine.h"
+#include "../environment/IEnvironment4Engine.h"
+#include "../levels/ILevel.h"
+#include "ICheckpointable.h"
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace checkpoint {
+
+/**
+ * Builds an agent of a category when a checkpoint is restored. The agent has
+ * a local state in every level where agents of this category may lie; the
+ * levels it is not in are removed, and its checkpointable states are then
+ * read from the checkpoint.
+ */
+using AgentFactory = std::function<std::shared_ptr<agents::IAgent4Engine>(
+    const AgentCategory &category)>;
+
+/**
+ * Additional named parts of a checkpoint, e.g. the state of the random number
+ * generators. The objects are not owned.
+ */
+using CheckpointSections = std::map<std::string, ICheckpointable *>;
+
+/**
+ * The binary checkpoint format of the simulation engines.
+ *
+ * A checkpoint holds, after a versioned header, the current time stamp; for
+ * each level, the time of its consistent state, the level itself and the
+ * public and private local states of the environment in it; for each agent,
+ * its category, the agent itself, its global state and its local states in
+ * each of its levels; and the additional sections. Every object is written
+ * as a block through ICheckpointable, or as an empty marker when it does not
+ * implement it.
+ *
+ * Checkpoints are taken between two steps, when no influence is pending.
+ * The membership of the agents in the consistent states is not stored: the
+ * engines rebuild it from the levels of the restored agents.
+ */
+class SimulationCheckpoint {
+public:
+  /** The version of the format written by this class. */
+  static constexpr std::uint32_t FORMAT_VERSION = 1;
+
+  using Levels = std::map<LevelIdentifier, std::shared_ptr<levels::ILevel>>;
+  using AgentPtr = std::shared_ptr<agents::IAgent4Engine>;
+
+  /**
+   * Writes the checkpoint of a simulation.
+   * @param writer The writer receiving the checkpoint.
+   * @param currentTime The time stamp reached by the simulation.
+   * @param levels The levels of the simulation.
+   * @param environment The environment of the simulation, or nullptr.
+   * @param agents The agents of the simulation.
+   * @param sections The additional sections.
+   */
+  static void write(CheckpointWriter &writer,
+                    const SimulationTimeStamp &currentTime,
+                    const Levels &levels,
+                    const environment::IEnvironment4Engine *environment,
+                    const std::vector<AgentPtr> &agents,
+                    const CheckpointSections &sections);
+
+  /**
+   * Restores a checkpoint into the levels and the environment rebuilt by the
+   * simulation model, and creates its agents.
+   * @param reader The reader of the checkpoint.
+   * @param levels The levels of the simulation, as generated by the model.
+   * @param environment The environment of the simulation, or nullptr.
+   * @param agentFactory Builds the agents of the checkpoint.
+   * @param sections The additional sections to restore; sections of the
+   * checkpoint missing from this map are skipped.
+   * @param restoredAgents Receives the agents of the checkpoint.
+   * @return The time stamp reached by the checkpointed simulation.
+   * @throws CheckpointException If the checkpoint is invalid, of a newer
+   * version or does not match the levels of the model.
+   */
+  static SimulationTimeStamp
+  read(CheckpointReader &reader, const Levels &levels,
+       environment::IEnvironment4Engine *environment,
+       const AgentFactory &agentFactory, const CheckpointSections &sections,
+       std::vector<AgentPtr> &restoredAgents);
+};
+
+} // namespace checkpoint
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMULATIONCHECKPOINT_H
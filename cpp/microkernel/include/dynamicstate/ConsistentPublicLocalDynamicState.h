@@ -1,8 +1,10 @@
 #ifndef CONSISTENTPUBLICLOCALDYNAMICSTATE_H
 #define CONSISTENTPUBLICLOCALDYNAMICSTATE_H
 
+#include "../CopyOnWrite.h"
 #include "../SimulationTimeStamp.h"
 #include "IModifiablePublicLocalDynamicState.h"
+#include "PublicLocalStateIndex.h"
 #include <algorithm>
 #include <stdexcept>
 
@@ -15,6 +17,14 @@ namespace dynamicstate {
 
 /**
  * Models a consistent public local dynamic state for a level l at a time t.
+ *
+ * The public local states of the agents and the influences are stored in
+ * copy-on-write sets: snapshot() returns a copy of the state sharing them,
+ * which is only duplicated when either state is modified afterwards.
+ *
+ * The level may attach a PublicLocalStateIndex of the states of its agents,
+ * rebuilt after its reactions, answering the region queries of the
+ * perceptions (see getPublicLocalStatesOfAgentsWithin()).
  */
 class ConsistentPublicLocalDynamicState
     : public IModifiablePublicLocalDynamicState {
@@ -23,12 +33,13 @@ private:
   SimulationTimeStamp time;
   std::shared_ptr<environment::ILocalStateOfEnvironment>
       publicLocalstateOfEnvironment;
-  std::set<std::shared_ptr<agents::ILocalStateOfAgent>>
+  CopyOnWrite<std::set<std::shared_ptr<agents::ILocalStateOfAgent>>>
       publicLocalStateOfAgents;
-  std::set<std::shared_ptr<influences::IInfluence>>
+  CopyOnWrite<std::set<std::shared_ptr<influences::IInfluence>>>
       stateDynamicsSystemInfluences;
-  std::set<std::shared_ptr<influences::IInfluence>>
+  CopyOnWrite<std::set<std::shared_ptr<influences::IInfluence>>>
       stateDynamicsRegularInfluences;
+  std::shared_ptr<const PublicLocalStateIndex> spatialIndex;
 
 public:
   ConsistentPublicLocalDynamicState(const SimulationTimeStamp &time,
@@ -48,29 +59,71 @@ public:
     return this->publicLocalstateOfEnvironment;
   }
 
-  std::set<std::shared_ptr<agents::ILocalStateOfAgent>>
+  const std::set<std::shared_ptr<agents::ILocalStateOfAgent>> &
   getPublicLocalStateOfAgents() const override {
-    return this->publicLocalStateOfAgents;
+    return this->publicLocalStateOfAgents.get();
+  }
+
+  /**
+   * Gets the index of the public local states of the agents, nullptr if the
+   * level maintains none. It reflects the states of the last reaction.
+   */
+  std::shared_ptr<const PublicLocalStateIndex> getSpatialIndex() const {
+    return this->spatialIndex;
+  }
+
+  void setSpatialIndex(std::shared_ptr<const PublicLocalStateIndex> index) {
+    this->spatialIndex = std::move(index);
+  }
+
+  /**
+   * Gets the public local states of the agents within radius of (x, y), as
+   * of the last reaction of the level.
+   * @throws std::logic_error If the level maintains no spatial index.
+   */
+  std::vector<std::shared_ptr<agents::ILocalStateOfAgent>>
+  getPublicLocalStatesOfAgentsWithin(double x, double y, double radius) const {
+    if (!this->spatialIndex) {
+      throw std::logic_error("The level " + this->level.toString() +
+                             " maintains no spatial index.");
+    }
+    return this->spatialIndex->within(x, y, radius);
   }
 
   std::set<std::shared_ptr<influences::IInfluence>>
   getStateDynamics() const override {
     std::set<std::shared_ptr<influences::IInfluence>> allInfluences;
-    allInfluences.insert(stateDynamicsSystemInfluences.begin(),
-                         stateDynamicsSystemInfluences.end());
-    allInfluences.insert(stateDynamicsRegularInfluences.begin(),
-                         stateDynamicsRegularInfluences.end());
+    allInfluences.insert(stateDynamicsSystemInfluences->begin(),
+                         stateDynamicsSystemInfluences->end());
+    allInfluences.insert(stateDynamicsRegularInfluences->begin(),
+                         stateDynamicsRegularInfluences->end());
     return allInfluences;
   }
 
   std::set<std::shared_ptr<influences::IInfluence>>
   getSystemInfluencesOfStateDynamics() const override {
-    return this->stateDynamicsSystemInfluences;
+    return this->stateDynamicsSystemInfluences.get();
   }
 
   std::set<std::shared_ptr<influences::IInfluence>>
   getRegularInfluencesOfStateDynamics() const override {
-    return this->stateDynamicsRegularInfluences;
+    return this->stateDynamicsRegularInfluences.get();
+  }
+
+  /**
+   * Gets the system influences of the state dynamics without copying them.
+   */
+  const std::set<std::shared_ptr<influences::IInfluence>> &
+  viewSystemInfluencesOfStateDynamics() const {
+    return this->stateDynamicsSystemInfluences.get();
+  }
+
+  /**
+   * Gets the regular influences of the state dynamics without copying them.
+   */
+  const std::set<std::shared_ptr<influences::IInfluence>> &
+  viewRegularInfluencesOfStateDynamics() const {
+    return this->stateDynamicsRegularInfluences.get();
   }
 
   void setPublicLocalStateOfEnvironment(
@@ -89,7 +142,7 @@ public:
       throw std::invalid_argument(
           "The 'publicLocalState' argument cannot be null.");
     }
-    this->publicLocalStateOfAgents.insert(publicLocalState);
+    this->publicLocalStateOfAgents.mutate().insert(publicLocalState);
   }
 
   void removePublicLocalStateOfAgent(
@@ -98,37 +151,52 @@ public:
       throw std::invalid_argument(
           "The 'publicLocalState' argument cannot be null.");
     }
-    this->publicLocalStateOfAgents.erase(publicLocalState);
+    this->publicLocalStateOfAgents.mutate().erase(publicLocalState);
   }
 
+  /**
+   * Removes the public local states of all the agents from this state.
+   */
+  void clearPublicLocalStatesOfAgents() { publicLocalStateOfAgents.reset(); }
+
   void
   addInfluence(std::shared_ptr<influences::IInfluence> influence) override {
     if (influence == nullptr) {
       throw std::invalid_argument("The 'influence' argument cannot be null.");
     }
     if (influence->isSystem()) {
-      this->stateDynamicsSystemInfluences.insert(influence);
+      this->stateDynamicsSystemInfluences.mutate().insert(influence);
     } else {
-      this->stateDynamicsRegularInfluences.insert(influence);
+      this->stateDynamicsRegularInfluences.mutate().insert(influence);
     }
   }
 
   void setStateDynamicsAsCopyOf(
       const std::vector<std::shared_ptr<influences::IInfluence>> &toCopy)
       override {
-    this->stateDynamicsRegularInfluences.clear();
-    this->stateDynamicsSystemInfluences.clear();
+    this->stateDynamicsRegularInfluences.reset();
+    this->stateDynamicsSystemInfluences.reset();
     for (const auto &influence : toCopy) {
       this->addInfluence(influence);
     }
   }
 
   void clearSystemInfluences() override {
-    this->stateDynamicsSystemInfluences.clear();
+    this->stateDynamicsSystemInfluences.reset();
   }
 
   void clearRegularInfluences() override {
-    this->stateDynamicsRegularInfluences.clear();
+    this->stateDynamicsRegularInfluences.reset();
+  }
+
+  /**
+   * Builds a read-only view of this state as it is now, in constant time.
+   * The snapshot shares the public local states of the agents with this
+   * state: it is unaffected by the agents later added to or removed from
+   * this state, but the local states themselves are not copied.
+   */
+  std::shared_ptr<const ConsistentPublicLocalDynamicState> snapshot() const {
+    return std::make_shared<const ConsistentPublicLocalDynamicState>(*this);
   }
 
   std::shared_ptr<IPublicLocalDynamicState> clone() const override {
@@ -139,18 +207,17 @@ public:
           std::dynamic_pointer_cast<environment::ILocalStateOfEnvironment>(
               this->publicLocalstateOfEnvironment->clone()));
     }
-    for (const auto &agentState : this->publicLocalStateOfAgents) {
+    for (const auto &agentState : *this->publicLocalStateOfAgents) {
       clonedState->addPublicLocalStateOfAgent(
           std::dynamic_pointer_cast<agents::ILocalStateOfAgent>(
               agentState->clone()));
     }
-    // Shallow copy of influences as they are typically immutable
-    for (const auto &influence : this->stateDynamicsSystemInfluences) {
-      clonedState->addInfluence(influence);
-    }
-    for (const auto &influence : this->stateDynamicsRegularInfluences) {
-      clonedState->addInfluence(influence);
-    }
+    // Influences are immutable, so the clone shares them until either state
+    // is modified
+    clonedState->stateDynamicsSystemInfluences =
+        this->stateDynamicsSystemInfluences;
+    clonedState->stateDynamicsRegularInfluences =
+        this->stateDynamicsRegularInfluences;
     return clonedState;
   }
 };
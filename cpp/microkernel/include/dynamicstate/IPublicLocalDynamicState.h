@@ -43,9 +43,10 @@ public:
    * Gets the public local state of the agents lying in the level of this
    * dynamic state.
    * @return The public local state of the agents lying in the level of this
-   * dynamic state.
+   * dynamic state. The returned set is owned by the dynamic state and stays
+   * valid until the state is modified.
    */
-  virtual std::set<std::shared_ptr<agents::ILocalStateOfAgent>>
+  virtual const std::set<std::shared_ptr<agents::ILocalStateOfAgent>> &
   getPublicLocalStateOfAgents() const = 0;
 
   /**
@@ -0,0 +1,136 @@
+#ifndef PUBLICLOCALSTATEINDEX_H
+#define PUBLICLOCALSTATEINDEX_H
+
+#include "../agents/ILocalStateOfAgent.h"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace dynamicstate {
+
+/**
+ * An index of the public local states of the agents of a level by their
+ * position, answering the radius queries of the perceptions without a scan
+ * of all the states.
+ *
+ * The positions are read by a locator, since the micro-kernel does not know
+ * where the agents are; the states without a position are not indexed. The
+ * index is rebuilt from the states of the level in one pass, the states
+ * being sorted by cell with a counting sort over the bounding box of the
+ * positions. The queries can be made from any thread between two rebuilds.
+ */
+class PublicLocalStateIndex {
+public:
+  /**
+   * Reads the position of a state into x and y.
+   * @return false If the state has no position.
+   */
+  using Locator = std::function<bool(const agents::ILocalStateOfAgent &,
+                                     double &x, double &y)>;
+
+  using State = std::shared_ptr<agents::ILocalStateOfAgent>;
+
+  /**
+   * @param cellSize The side of the cells, at best about the usual radius of
+   * the queries.
+   * @throws std::invalid_argument If the cell size is not positive or the
+   * locator is empty.
+   */
+  PublicLocalStateIndex(double cellSize, Locator locator);
+
+  double getCellSize() const { return cellSize; }
+  const Locator &getLocator() const { return locator; }
+
+  /** Gets the number of indexed states. */
+  std::size_t size() const { return states.size(); }
+
+  /** Replaces the indexed states by the ones having a position. */
+  void rebuild(const std::set<State> &publicLocalStates);
+
+  /**
+   * Visits the states within radius of (x, y), in no particular order.
+   * @param visitor Called with each state and its distance.
+   */
+  template <typename Visitor>
+  void forEachWithin(double x, double y, double radius,
+                     Visitor &&visitor) const {
+    if (states.empty()) {
+      return;
+    }
+    const int firstColumn = columnOf(x - radius);
+    const int lastColumn = columnOf(x + radius);
+    const int firstRow = rowOf(y - radius);
+    const int lastRow = rowOf(y + radius);
+    const double radiusSquared = radius * radius;
+    for (int row = firstRow; row <= lastRow; ++row) {
+      const std::size_t first = static_cast<std::size_t>(row) * columns;
+      for (std::size_t k = start[first + firstColumn];
+           k < start[first + lastColumn + 1]; ++k) {
+        const double dx = xs[k] - x;
+        const double dy = ys[k] - y;
+        const double distanceSquared = dx * dx + dy * dy;
+        if (distanceSquared <= radiusSquared) {
+          visitor(states[k], std::sqrt(distanceSquared));
+        }
+      }
+    }
+  }
+
+  /** Gets the states within radius of (x, y). */
+  std::vector<State> within(double x, double y, double radius) const;
+
+  /**
+   * Gets the states within radius of each center, in the order of the
+   * centers. The centers are visited cell by cell, so that the states of a
+   * neighbourhood are read once from memory for all its centers.
+   */
+  std::vector<std::vector<State>>
+  withinAll(const std::vector<std::pair<double, double>> &centers,
+            double radius) const;
+
+private:
+  double cellSize;
+  Locator locator;
+  // the bounding box of the positions and its cells, of side cellSize
+  // unless the box holds too many cells for the states
+  double side;
+  double minX = 0;
+  double minY = 0;
+  int columns = 1;
+  int rows = 1;
+  // the states and their positions, sorted by cell; the states of the cell
+  // c are [start[c], start[c + 1])
+  std::vector<State> states;
+  std::vector<double> xs;
+  std::vector<double> ys;
+  std::vector<std::uint32_t> start;
+
+  int columnOf(double x) const { return clamp((x - minX) / side, columns); }
+  int rowOf(double y) const { return clamp((y - minY) / side, rows); }
+
+  static int clamp(double cell, int cells) {
+    if (!(cell > 0)) {
+      return 0;
+    }
+    return cell >= cells ? cells - 1 : static_cast<int>(cell);
+  }
+};
+
+} // namespace dynamicstate
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // PUBLICLOCALSTATEINDEX_H
@@ -74,7 +74,7 @@ public:
     return this->lastConsistentDynamicState->getPublicLocalStateOfEnvironment();
   }
 
-  std::set<std::shared_ptr<agents::ILocalStateOfAgent>>
+  const std::set<std::shared_ptr<agents::ILocalStateOfAgent>> &
   getPublicLocalStateOfAgents() const override {
     return this->lastConsistentDynamicState->getPublicLocalStateOfAgents();
   }
@@ -93,7 +93,8 @@ public:
   std::set<std::shared_ptr<influences::IInfluence>>
   getSystemInfluencesOfStateDynamics() const override {
     std::set<std::shared_ptr<influences::IInfluence>> systemInfluences =
-        this->lastConsistentDynamicState->getSystemInfluencesOfStateDynamics();
+        this->lastConsistentDynamicState
+            ->viewSystemInfluencesOfStateDynamics();
     systemInfluences.insert(stateTransitoryDynamicsSystemInfluences.begin(),
                             stateTransitoryDynamicsSystemInfluences.end());
     return systemInfluences;
@@ -102,7 +103,8 @@ public:
   std::set<std::shared_ptr<influences::IInfluence>>
   getRegularInfluencesOfStateDynamics() const override {
     std::set<std::shared_ptr<influences::IInfluence>> regularInfluences =
-        this->lastConsistentDynamicState->getRegularInfluencesOfStateDynamics();
+        this->lastConsistentDynamicState
+            ->viewRegularInfluencesOfStateDynamics();
     regularInfluences.insert(stateTransitoryDynamicsRegularInfluences.begin(),
                              stateTransitoryDynamicsRegularInfluences.end());
     return regularInfluences;
@@ -0,0 +1,226 @@
+#ifndef ACTIVATIONSCHEDULE_H
+#define ACTIVATIONSCHEDULE_H
+
+#include "../agents/IWakeCondition.h"
+#include "AgentRegistry.h"
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace engine {
+
+/**
+ * The next activation time of the agents of an AgentRegistry.
+ *
+ * The activations are kept in a priority queue ordered by time, so that
+ * collecting the agents of a step costs the number of activated agents and
+ * not the number of agents. An agent has at most one pending activation, the
+ * earliest one; the entries superseded by another activation, or whose slot
+ * was freed, are discarded when they reach the head of the queue.
+ *
+ * A sleeping agent may also have a wake condition, evaluated at each collect
+ * until the agent is activated, whether by its condition or otherwise.
+ */
+class ActivationSchedule {
+private:
+  using AgentPtr = AgentRegistry::AgentPtr;
+
+  static constexpr long NEVER = std::numeric_limits<long>::max();
+
+  struct Entry {
+    long time;
+    std::size_t slot;
+    const agents::IAgent4Engine *agent;
+
+    bool operator>(const Entry &other) const { return time > other.time; }
+  };
+
+  /** The activation state of the agent of a slot */
+  struct SlotState {
+    const agents::IAgent4Engine *agent = nullptr;
+    long scheduled = NEVER;
+    long activated = NEVER;
+    /** The condition of the pending sleep, nullptr once activated */
+    const agents::IWakeCondition *condition = nullptr;
+  };
+
+  struct Sleeper {
+    std::size_t slot;
+    const agents::IAgent4Engine *agent;
+    std::shared_ptr<const agents::IWakeCondition> condition;
+  };
+
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+  std::vector<SlotState> slots;
+  std::vector<AgentPtr> active;
+  std::vector<Sleeper> sleepers;
+
+  std::mutex requestMutex;
+  std::vector<AgentPtr> requested;
+
+  SlotState &stateOf(std::size_t slot, const agents::IAgent4Engine *agent) {
+    if (slot >= slots.size()) {
+      slots.resize(slot + 1);
+    }
+    SlotState &state = slots[slot];
+    if (state.agent != agent) {
+      state = SlotState();
+      state.agent = agent;
+    }
+    return state;
+  }
+
+  void activate(std::size_t slot, const AgentPtr &agent, long time) {
+    SlotState &state = stateOf(slot, agent.get());
+    if (state.activated != time) {
+      state.activated = time;
+      state.scheduled = NEVER;
+      state.condition = nullptr;
+      active.push_back(agent);
+    }
+  }
+
+public:
+  /**
+   * Schedules the activation of the agent of a slot, unless it is already
+   * scheduled at this time or before.
+   */
+  void schedule(std::size_t slot, const AgentPtr &agent, long time) {
+    if (slot == AgentRegistry::NO_SLOT) {
+      return;
+    }
+    SlotState &state = stateOf(slot, agent.get());
+    if (state.scheduled <= time) {
+      return;
+    }
+    state.scheduled = time;
+    queue.push(Entry{time, slot, agent.get()});
+  }
+
+  /**
+   * Gives a wake condition to the agent of a slot, until its next activation.
+   */
+  void sleep(std::size_t slot, const AgentPtr &agent,
+             std::shared_ptr<const agents::IWakeCondition> condition) {
+    if (slot == AgentRegistry::NO_SLOT || !condition) {
+      return;
+    }
+    SlotState &state = stateOf(slot, agent.get());
+    if (state.condition == condition.get()) {
+      return;
+    }
+    state.condition = condition.get();
+    sleepers.push_back(Sleeper{slot, agent.get(), std::move(condition)});
+  }
+
+  /**
+   * Asks for the activation of an agent at the next collected step. This
+   * method can be called from any thread, e.g. by a reaction.
+   */
+  void request(const AgentPtr &agent) {
+    std::lock_guard<std::mutex> lock(requestMutex);
+    requested.push_back(agent);
+  }
+
+  /**
+   * Takes the agents to activate during the step starting at time: the
+   * agents scheduled at time or before, the requested ones and the sleeping
+   * ones whose wake condition is met.
+   * @param isMet Evaluates a wake condition, or nullptr to leave the
+   * conditions for a later call.
+   * @return The agents, valid until the next call.
+   */
+  const std::vector<AgentPtr> &
+  collect(const AgentRegistry &registry, long time,
+          const std::function<bool(const agents::IWakeCondition &)> &isMet =
+              nullptr) {
+    active.clear();
+    while (!queue.empty() && queue.top().time <= time) {
+      const Entry entry = queue.top();
+      queue.pop();
+      if (entry.slot >= registry.slotCount()) {
+        continue;
+      }
+      const AgentPtr &agent = registry.agentAt(entry.slot);
+      if (agent.get() != entry.agent || entry.slot >= slots.size() ||
+          slots[entry.slot].agent != entry.agent ||
+          slots[entry.slot].scheduled != entry.time) {
+        continue;
+      }
+      activate(entry.slot, agent, time);
+    }
+    std::vector<AgentPtr> pending;
+    {
+      std::lock_guard<std::mutex> lock(requestMutex);
+      pending.swap(requested);
+    }
+    for (const auto &agent : pending) {
+      const std::size_t slot = registry.slotOf(agent);
+      if (slot != AgentRegistry::NO_SLOT) {
+        activate(slot, agent, time);
+      }
+    }
+    if (isMet) {
+      // The sleepers activated since they fell asleep are dropped.
+      std::size_t kept = 0;
+      for (std::size_t i = 0; i < sleepers.size(); ++i) {
+        Sleeper &sleeper = sleepers[i];
+        if (sleeper.slot >= registry.slotCount() ||
+            sleeper.slot >= slots.size() ||
+            registry.agentAt(sleeper.slot).get() != sleeper.agent ||
+            slots[sleeper.slot].agent != sleeper.agent ||
+            slots[sleeper.slot].condition != sleeper.condition.get()) {
+          continue;
+        }
+        if (isMet(*sleeper.condition)) {
+          activate(sleeper.slot, registry.agentAt(sleeper.slot), time);
+          continue;
+        }
+        if (kept != i) {
+          sleepers[kept] = std::move(sleeper);
+        }
+        ++kept;
+      }
+      sleepers.erase(sleepers.begin() + kept, sleepers.end());
+    }
+    return active;
+  }
+
+  /**
+   * Gets the number of entries of the queue, superseded ones included.
+   */
+  std::size_t queuedCount() const { return queue.size(); }
+
+  /**
+   * Gets the number of agents waiting for their wake condition, including
+   * the ones activated since the last collect.
+   */
+  std::size_t sleepingCount() const { return sleepers.size(); }
+
+  void clear() {
+    queue = decltype(queue)();
+    slots.clear();
+    active.clear();
+    sleepers.clear();
+    std::lock_guard<std::mutex> lock(requestMutex);
+    requested.clear();
+  }
+};
+
+} // namespace engine
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // ACTIVATIONSCHEDULE_H
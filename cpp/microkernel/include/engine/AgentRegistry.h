@@ -0,0 +1,503 @@
+#ifndef AGENTREGISTRY_H
+#define AGENTREGISTRY_H
+
+#include "../AgentCategory.h"
+#include "../LevelIdentifier.h"
+#include "../LevelIndexedMap.h"
+#include "../agents/IAgent4Engine.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace engine {
+
+/**
+ * The agents of a simulation, stored contiguously.
+ *
+ * Every agent gets a stable slot when it is added; the slots of removed
+ * agents are reused by the next additions. The agents are also kept in dense
+ * arrays, one for the whole simulation, one per level and one per category,
+ * that engines iterate without allocating. Removals swap the last agent of an
+ * array into the freed position, so the iteration order is not the insertion
+ * order.
+ *
+ * The categories get dense indices, in the order they are first met, so that
+ * engines look up what they attach to a category in a vector.
+ *
+ * Engines applying many removals at once use applyChanges(), which compacts
+ * each array once instead of moving agents at every removal; reorder() sorts
+ * the arrays, e.g. for the agents close in space to be close in memory.
+ */
+class AgentRegistry {
+public:
+  using AgentPtr = std::shared_ptr<agents::IAgent4Engine>;
+
+  /** Marks an agent that is not in the registry. */
+  static constexpr std::size_t NO_SLOT =
+      std::numeric_limits<std::size_t>::max();
+
+  /** Marks a category no agent of the registry ever had. */
+  static constexpr std::size_t NO_CATEGORY =
+      std::numeric_limits<std::size_t>::max();
+
+  /**
+   * A read-only view over contiguous agents, in the manner of std::span.
+   * It is invalidated by the next addition or removal.
+   */
+  class View {
+  private:
+    const AgentPtr *first = nullptr;
+    std::size_t count = 0;
+
+  public:
+    View() = default;
+    View(const AgentPtr *first, std::size_t count)
+        : first(first), count(count) {}
+
+    const AgentPtr *begin() const { return first; }
+    const AgentPtr *end() const { return first + count; }
+    const AgentPtr *data() const { return first; }
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const AgentPtr &operator[](std::size_t i) const { return first[i]; }
+  };
+
+private:
+  struct Slot {
+    AgentPtr agent;
+    std::size_t denseIndex = 0;
+    /** The levels of the agent and its position in their dense arrays. */
+    std::vector<std::pair<LevelIdentifier, std::size_t>> levelPositions;
+    /** The index of its category and its position in their dense array. */
+    std::size_t category = 0;
+    std::size_t categoryPosition = 0;
+  };
+
+  std::vector<Slot> slots;
+  std::vector<std::size_t> freeSlots;
+  std::unordered_map<const agents::IAgent4Engine *, std::size_t> slotIndices;
+
+  std::vector<AgentPtr> dense;
+  std::vector<std::size_t> denseSlots;
+  std::vector<std::size_t> denseCategories;
+
+  struct LevelAgents {
+    std::vector<AgentPtr> agents;
+    std::vector<std::size_t> slots;
+    bool needsCompaction = false;
+  };
+  LevelIndexedMap<LevelAgents> byLevel;
+
+  struct CategoryAgents {
+    AgentCategory category;
+    std::vector<AgentPtr> agents;
+    std::vector<std::size_t> slots;
+    bool needsCompaction = false;
+  };
+  std::vector<CategoryAgents> byCategory;
+  std::unordered_map<AgentCategory, std::size_t> categoryIndices;
+
+  std::size_t indexCategory(const AgentCategory &category) {
+    auto existing = categoryIndices.find(category);
+    if (existing != categoryIndices.end()) {
+      return existing->second;
+    }
+    const std::size_t index = byCategory.size();
+    byCategory.push_back(CategoryAgents{category, {}, {}, false});
+    categoryIndices.emplace(category, index);
+    return index;
+  }
+
+  void removeFromCategory(std::size_t category, std::size_t position) {
+    CategoryAgents &categoryAgents = byCategory[category];
+    const std::size_t last = categoryAgents.agents.size() - 1;
+    if (position != last) {
+      categoryAgents.agents[position] = std::move(categoryAgents.agents[last]);
+      categoryAgents.slots[position] = categoryAgents.slots[last];
+      slots[categoryAgents.slots[position]].categoryPosition = position;
+    }
+    categoryAgents.agents.pop_back();
+    categoryAgents.slots.pop_back();
+  }
+
+  void removeFromLevel(const LevelIdentifier &level, std::size_t position) {
+    LevelAgents &levelAgents = byLevel[level];
+    const std::size_t last = levelAgents.agents.size() - 1;
+    if (position != last) {
+      levelAgents.agents[position] = std::move(levelAgents.agents[last]);
+      levelAgents.slots[position] = levelAgents.slots[last];
+      for (auto &entry : slots[levelAgents.slots[position]].levelPositions) {
+        if (entry.first == level) {
+          entry.second = position;
+          break;
+        }
+      }
+    }
+    levelAgents.agents.pop_back();
+    levelAgents.slots.pop_back();
+  }
+
+  /**
+   * Frees the slot of an agent, leaving a hole in the dense arrays that the
+   * next compaction removes.
+   */
+  bool release(const AgentPtr &agent, std::vector<LevelIdentifier> &levels,
+               std::vector<std::size_t> &categories) {
+    auto existing = slotIndices.find(agent.get());
+    if (existing == slotIndices.end()) {
+      return false;
+    }
+    Slot &slot = slots[existing->second];
+    for (const auto &entry : slot.levelPositions) {
+      LevelAgents &levelAgents = byLevel[entry.first];
+      levelAgents.agents[entry.second].reset();
+      if (!levelAgents.needsCompaction) {
+        levelAgents.needsCompaction = true;
+        levels.push_back(entry.first);
+      }
+    }
+    CategoryAgents &categoryAgents = byCategory[slot.category];
+    categoryAgents.agents[slot.categoryPosition].reset();
+    if (!categoryAgents.needsCompaction) {
+      categoryAgents.needsCompaction = true;
+      categories.push_back(slot.category);
+    }
+    dense[slot.denseIndex].reset();
+    slot.agent.reset();
+    slot.levelPositions.clear();
+    freeSlots.push_back(existing->second);
+    slotIndices.erase(existing);
+    return true;
+  }
+
+  void compactLevel(const LevelIdentifier &level) {
+    LevelAgents &levelAgents = byLevel[level];
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < levelAgents.agents.size(); ++i) {
+      if (!levelAgents.agents[i]) {
+        continue;
+      }
+      if (kept != i) {
+        levelAgents.agents[kept] = std::move(levelAgents.agents[i]);
+        levelAgents.slots[kept] = levelAgents.slots[i];
+        for (auto &entry : slots[levelAgents.slots[kept]].levelPositions) {
+          if (entry.first == level) {
+            entry.second = kept;
+            break;
+          }
+        }
+      }
+      ++kept;
+    }
+    levelAgents.agents.resize(kept);
+    levelAgents.slots.resize(kept);
+    levelAgents.needsCompaction = false;
+  }
+
+  /**
+   * Sorts slot numbers by the keys of their agents, the agents of equal keys
+   * keeping their order.
+   */
+  static void sortSlots(std::vector<std::size_t> &order,
+                        const std::vector<std::uint64_t> &keys) {
+    std::stable_sort(order.begin(), order.end(),
+                     [&keys](std::size_t a, std::size_t b) {
+                       return keys[a] < keys[b];
+                     });
+  }
+
+  void compactCategory(std::size_t category) {
+    CategoryAgents &categoryAgents = byCategory[category];
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < categoryAgents.agents.size(); ++i) {
+      if (!categoryAgents.agents[i]) {
+        continue;
+      }
+      if (kept != i) {
+        categoryAgents.agents[kept] = std::move(categoryAgents.agents[i]);
+        categoryAgents.slots[kept] = categoryAgents.slots[i];
+        slots[categoryAgents.slots[kept]].categoryPosition = kept;
+      }
+      ++kept;
+    }
+    categoryAgents.agents.resize(kept);
+    categoryAgents.slots.resize(kept);
+    categoryAgents.needsCompaction = false;
+  }
+
+public:
+  /**
+   * Adds an agent to the registry, in the levels it currently lies in.
+   * @return The slot of the agent; its current slot if it was already there.
+   */
+  std::size_t add(const AgentPtr &agent) {
+    auto existing = slotIndices.find(agent.get());
+    if (existing != slotIndices.end()) {
+      return existing->second;
+    }
+    std::size_t slotIndex;
+    if (freeSlots.empty()) {
+      slotIndex = slots.size();
+      slots.emplace_back();
+    } else {
+      slotIndex = freeSlots.back();
+      freeSlots.pop_back();
+    }
+    Slot &slot = slots[slotIndex];
+    slot.agent = agent;
+    slot.denseIndex = dense.size();
+    dense.push_back(agent);
+    denseSlots.push_back(slotIndex);
+    slot.category = indexCategory(agent->getCategory());
+    CategoryAgents &categoryAgents = byCategory[slot.category];
+    slot.categoryPosition = categoryAgents.agents.size();
+    categoryAgents.agents.push_back(agent);
+    categoryAgents.slots.push_back(slotIndex);
+    denseCategories.push_back(slot.category);
+    for (const auto &level : agent->getLevels()) {
+      LevelAgents &levelAgents = byLevel[level];
+      slot.levelPositions.emplace_back(level, levelAgents.agents.size());
+      levelAgents.agents.push_back(agent);
+      levelAgents.slots.push_back(slotIndex);
+    }
+    slotIndices.emplace(agent.get(), slotIndex);
+    return slotIndex;
+  }
+
+  /**
+   * Removes an agent from the registry; its slot is reused later.
+   * @return false if the agent was not in the registry.
+   */
+  bool remove(const AgentPtr &agent) {
+    auto existing = slotIndices.find(agent.get());
+    if (existing == slotIndices.end()) {
+      return false;
+    }
+    const std::size_t slotIndex = existing->second;
+    slotIndices.erase(existing);
+    Slot &slot = slots[slotIndex];
+    for (const auto &entry : slot.levelPositions) {
+      removeFromLevel(entry.first, entry.second);
+    }
+    removeFromCategory(slot.category, slot.categoryPosition);
+    const std::size_t last = dense.size() - 1;
+    if (slot.denseIndex != last) {
+      dense[slot.denseIndex] = std::move(dense[last]);
+      denseSlots[slot.denseIndex] = denseSlots[last];
+      denseCategories[slot.denseIndex] = denseCategories[last];
+      slots[denseSlots[slot.denseIndex]].denseIndex = slot.denseIndex;
+    }
+    dense.pop_back();
+    denseSlots.pop_back();
+    denseCategories.pop_back();
+    slot.agent.reset();
+    slot.levelPositions.clear();
+    freeSlots.push_back(slotIndex);
+    return true;
+  }
+
+  /**
+   * Removes agents then adds others, compacting the dense arrays once.
+   * Agents present in both lists are registered again, which updates the
+   * levels they lie in. The relative order of the remaining agents is kept.
+   */
+  void applyChanges(const std::vector<AgentPtr> &removed,
+                    const std::vector<AgentPtr> &added) {
+    std::vector<LevelIdentifier> compactedLevels;
+    std::vector<std::size_t> compactedCategories;
+    bool released = false;
+    for (const auto &agent : removed) {
+      released =
+          release(agent, compactedLevels, compactedCategories) || released;
+    }
+    if (released) {
+      std::size_t kept = 0;
+      for (std::size_t i = 0; i < dense.size(); ++i) {
+        if (!dense[i]) {
+          continue;
+        }
+        if (kept != i) {
+          dense[kept] = std::move(dense[i]);
+          denseSlots[kept] = denseSlots[i];
+          denseCategories[kept] = denseCategories[i];
+          slots[denseSlots[kept]].denseIndex = kept;
+        }
+        ++kept;
+      }
+      dense.resize(kept);
+      denseSlots.resize(kept);
+      denseCategories.resize(kept);
+      for (const auto &level : compactedLevels) {
+        compactLevel(level);
+      }
+      for (std::size_t category : compactedCategories) {
+        compactCategory(category);
+      }
+    }
+    for (const auto &agent : added) {
+      add(agent);
+    }
+  }
+
+  /**
+   * Sorts the agents of all() and of each level and category by a key, the
+   * agents of lower keys first, the agents of equal keys keeping their
+   * order. The slots of the agents do not change; the views are
+   * invalidated.
+   * @param keyOf Gives the key of an agent, as std::uint64_t keyOf(const
+   * agents::IAgent4Engine &), called once per agent.
+   */
+  template <typename KeyOf> void reorder(KeyOf &&keyOf) {
+    std::vector<std::uint64_t> keys(slots.size(), 0);
+    for (std::size_t i = 0; i < dense.size(); ++i) {
+      keys[denseSlots[i]] = keyOf(*dense[i]);
+    }
+
+    sortSlots(denseSlots, keys);
+    for (std::size_t i = 0; i < denseSlots.size(); ++i) {
+      Slot &slot = slots[denseSlots[i]];
+      dense[i] = slot.agent;
+      denseCategories[i] = slot.category;
+      slot.denseIndex = i;
+    }
+    byLevel.forEach([&](const LevelIdentifier &level,
+                        LevelAgents &levelAgents) {
+      sortSlots(levelAgents.slots, keys);
+      for (std::size_t i = 0; i < levelAgents.slots.size(); ++i) {
+        Slot &slot = slots[levelAgents.slots[i]];
+        levelAgents.agents[i] = slot.agent;
+        for (auto &entry : slot.levelPositions) {
+          if (entry.first == level) {
+            entry.second = i;
+            break;
+          }
+        }
+      }
+    });
+    for (CategoryAgents &categoryAgents : byCategory) {
+      sortSlots(categoryAgents.slots, keys);
+      for (std::size_t i = 0; i < categoryAgents.slots.size(); ++i) {
+        Slot &slot = slots[categoryAgents.slots[i]];
+        categoryAgents.agents[i] = slot.agent;
+        slot.categoryPosition = i;
+      }
+    }
+  }
+
+  bool contains(const AgentPtr &agent) const {
+    return slotIndices.count(agent.get()) != 0;
+  }
+
+  /**
+   * Gets the slot of an agent, or NO_SLOT if it is not in the registry.
+   */
+  std::size_t slotOf(const AgentPtr &agent) const {
+    auto existing = slotIndices.find(agent.get());
+    return existing == slotIndices.end() ? NO_SLOT : existing->second;
+  }
+
+  /**
+   * Gets the agent in a slot, or nullptr if the slot is free.
+   */
+  const AgentPtr &agentAt(std::size_t slot) const { return slots[slot].agent; }
+
+  /**
+   * Gets the number of slots, free or not. Slots are lower than this value.
+   */
+  std::size_t slotCount() const { return slots.size(); }
+
+  std::size_t size() const { return dense.size(); }
+
+  bool empty() const { return dense.empty(); }
+
+  void clear() {
+    slots.clear();
+    freeSlots.clear();
+    slotIndices.clear();
+    dense.clear();
+    denseSlots.clear();
+    denseCategories.clear();
+    byLevel.clear();
+    byCategory.clear();
+    categoryIndices.clear();
+  }
+
+  /**
+   * Gets all the agents.
+   */
+  View all() const { return View(dense.data(), dense.size()); }
+
+  /**
+   * Gets the agents lying in a level.
+   */
+  View inLevel(const LevelIdentifier &level) const {
+    const LevelAgents *levelAgents = byLevel.find(level);
+    if (levelAgents == nullptr) {
+      return View();
+    }
+    return View(levelAgents->agents.data(), levelAgents->agents.size());
+  }
+
+  /**
+   * Gets the number of categories met, whose indices are lower than it.
+   */
+  std::size_t categoryCount() const { return byCategory.size(); }
+
+  /**
+   * Gets the index of a category, or NO_CATEGORY if no agent had it.
+   */
+  std::size_t categoryIndexOf(const AgentCategory &category) const {
+    auto existing = categoryIndices.find(category);
+    return existing == categoryIndices.end() ? NO_CATEGORY : existing->second;
+  }
+
+  /**
+   * Gets the index of the category of the agent at a position of all().
+   */
+  std::size_t categoryIndexAt(std::size_t position) const {
+    return denseCategories[position];
+  }
+
+  /**
+   * Gets the agents of a category, from its index.
+   */
+  View inCategory(std::size_t categoryIndex) const {
+    const CategoryAgents &categoryAgents = byCategory[categoryIndex];
+    return View(categoryAgents.agents.data(), categoryAgents.agents.size());
+  }
+
+  /**
+   * Gets the agents of a category.
+   */
+  View inCategory(const AgentCategory &category) const {
+    const std::size_t index = categoryIndexOf(category);
+    return index == NO_CATEGORY ? View() : inCategory(index);
+  }
+
+  /**
+   * Copies the agents into a set, for the ISimulationEngine accessors.
+   */
+  static std::set<AgentPtr> toSet(View view) {
+    return std::set<AgentPtr>(view.begin(), view.end());
+  }
+};
+
+} // namespace engine
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // AGENTREGISTRY_H
@@ -0,0 +1,66 @@
+#ifndef CPUTOPOLOGY_H
+#define CPUTOPOLOGY_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace engine {
+
+/**
+ * The CPUs of the machine grouped by NUMA node, to place the workers of a
+ * WorkStealingThreadPool close to the memory they use.
+ *
+ * On Linux, the nodes are read from /sys/devices/system/node, restricted to
+ * the CPUs the process may run on; elsewhere, or when the nodes cannot be
+ * read, all the CPUs form one node.
+ */
+class CpuTopology {
+public:
+  /** The CPU a worker is pinned to and its NUMA node. */
+  struct Placement {
+    int cpu;
+    std::size_t node;
+  };
+
+  /** The CPUs of each node, in increasing order, no node being empty. */
+  std::vector<std::vector<int>> nodes;
+
+  /**
+   * Reads the topology of the machine.
+   */
+  static CpuTopology detect();
+
+  /**
+   * Parses a list of CPUs in the format of Linux, e.g. "0-3,8,10-11".
+   * @throws std::invalid_argument If the list is malformed.
+   */
+  static std::vector<int> parseCpuList(const std::string &list);
+
+  /**
+   * Places workers on the nodes: the nodes get consecutive workers, in
+   * proportion to their CPUs, spread over the CPUs of the node. The
+   * consecutive ranges of indices a pool hands to consecutive workers are
+   * then processed on one node.
+   * @param workers The number of workers.
+   * @return The placement of each worker, empty when there are no nodes.
+   */
+  std::vector<Placement> placeWorkers(std::size_t workers) const;
+
+  /** Gets the number of CPUs of all the nodes. */
+  std::size_t cpuCount() const;
+};
+
+} // namespace engine
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // CPUTOPOLOGY_H
@@ -0,0 +1,67 @@
+#ifndef HELPERTHREAD_H
+#define HELPERTHREAD_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace engine {
+
+/**
+ * A thread kept across the steps of an engine to run one task at a time
+ * beside the workers of its pool, e.g. the natural dynamics overlapping the
+ * agent phase (see MultiThreadedSimulationEngine::setNaturalOverlap()), so
+ * that no thread is started per step.
+ */
+class HelperThread {
+private:
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::function<void()> task;
+  // whether a task was started and not waited for yet
+  bool pending = false;
+  bool running = false;
+  bool stopping = false;
+  std::exception_ptr error;
+  std::thread thread;
+
+  void loop();
+
+public:
+  HelperThread();
+
+  /** Waits for the current task, then stops and joins the thread. */
+  ~HelperThread();
+
+  HelperThread(const HelperThread &) = delete;
+  HelperThread &operator=(const HelperThread &) = delete;
+
+  /**
+   * Runs a task on the thread.
+   * @throws std::logic_error If the previous task was not waited for.
+   */
+  void start(std::function<void()> body);
+
+  /**
+   * Waits for the task started last to end.
+   * @return The exception thrown by the task, or null; null as well if no
+   * task is pending.
+   */
+  std::exception_ptr wait();
+};
+
+} // namespace engine
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // HELPERTHREAD_H
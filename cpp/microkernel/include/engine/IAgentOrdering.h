@@ -0,0 +1,41 @@
+#ifndef IAGENTORDERING_H
+#define IAGENTORDERING_H
+
+#include "../agents/IAgent4Engine.h"
+#include <cstdint>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace engine {
+
+/**
+ * The order in which an engine iterates its agents.
+ *
+ * MultiThreadedSimulationEngine sorts its agent registry by these keys every
+ * few steps (see AgentRegistry::reorder()), between two steps, so that the
+ * agents stepped by a chunk of a worker are the ones whose keys are close:
+ * e.g. the index of their location along a space-filling curve, for the
+ * agents perceiving their neighbours to read the same memory.
+ */
+class IAgentOrdering {
+public:
+  virtual ~IAgentOrdering() = default;
+
+  /**
+   * Gets the key of an agent; the agents of lower keys come first. Called
+   * on the thread running the simulation.
+   */
+  virtual std::uint64_t keyOf(const agents::IAgent4Engine &agent) const = 0;
+};
+
+} // namespace engine
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // IAGENTORDERING_H
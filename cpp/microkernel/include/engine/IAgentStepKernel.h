@@ -0,0 +1,62 @@
+#ifndef IAGENTSTEPKERNEL_H
+#define IAGENTSTEPKERNEL_H
+
+#include "../LevelIdentifier.h"
+#include "../SimulationTimeStamp.h"
+#include "../agents/IAgent4Engine.h"
+#include "../dynamicstate/IPublicDynamicStateMap.h"
+#include "../influences/InfluencesMap.h"
+#include <cstddef>
+#include <memory>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace engine {
+
+/**
+ * Runs the perception, the global state revision and the decision of a
+ * batch of agents of the same concrete type in a level, without going
+ * through their virtual methods.
+ *
+ * An agent gives its kernel with IAgent4Engine::getStepKernel(). The
+ * engines step the agents sharing a kernel with one call to it, and the
+ * agents without kernel one by one. Every agent given to a kernel returned
+ * it for the level.
+ */
+class IAgentStepKernel {
+public:
+  virtual ~IAgentStepKernel() = default;
+
+  /**
+   * Makes agents perceive, revise their global state and decide in a level,
+   * one agent after the other.
+   * @param level The level.
+   * @param timeLowerBound The lower bound of the transitory period.
+   * @param timeUpperBound The upper bound of the transitory period.
+   * @param agents The agents.
+   * @param count The number of agents.
+   * @param dynamicStates The dynamic states the agents perceive.
+   * @param producedInfluences The map receiving the influences of the
+   * agents.
+   */
+  virtual void
+  step(const LevelIdentifier &level, const SimulationTimeStamp &timeLowerBound,
+       const SimulationTimeStamp &timeUpperBound,
+       agents::IAgent4Engine *const *agents, std::size_t count,
+       const std::shared_ptr<dynamicstate::IPublicDynamicStateMap>
+           &dynamicStates,
+       const std::shared_ptr<influences::InfluencesMap> &producedInfluences)
+      const = 0;
+};
+
+} // namespace engine
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // IAGENTSTEPKERNEL_H
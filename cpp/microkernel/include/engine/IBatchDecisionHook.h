@@ -0,0 +1,53 @@
+#ifndef IBATCHDECISIONHOOK_H
+#define IBATCHDECISIONHOOK_H
+
+#include "../SimulationTimeStamp.h"
+#include "../agents/IAgent4Engine.h"
+#include <cstddef>
+#include <memory>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace engine {
+
+/**
+ * Decides for all the agents of a step at once, between their perception and
+ * their decisions.
+ *
+ * MultiThreadedSimulationEngine calls the hook once per step, on the thread
+ * running the simulation, once every agent of the step perceived and before
+ * any of them revises its global state or decides. The hook reads the
+ * perceived data of the agents (IAgent4Engine::getPerceivedData()) and
+ * computes their decisions in bulk, e.g. in one call into an interpreter
+ * rather than one call per agent; the decide() of each agent then turns its
+ * share of the result into influences, in parallel.
+ */
+class IBatchDecisionHook {
+public:
+  virtual ~IBatchDecisionHook() = default;
+
+  /**
+   * Called once the agents of a step perceived.
+   * @param timeLowerBound The lower bound of the transitory period.
+   * @param timeUpperBound The upper bound of the transitory period.
+   * @param agents The agents taking part in the step.
+   * @param count The number of agents.
+   */
+  virtual void
+  perceived(const SimulationTimeStamp &timeLowerBound,
+            const SimulationTimeStamp &timeUpperBound,
+            const std::shared_ptr<agents::IAgent4Engine> *agents,
+            std::size_t count) = 0;
+};
+
+} // namespace engine
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // IBATCHDECISIONHOOK_H
@@ -0,0 +1,99 @@
+#ifndef ICATEGORYBATCHBEHAVIOR_H
+#define ICATEGORYBATCHBEHAVIOR_H
+
+#include "../LevelIdentifier.h"
+#include "../SimulationTimeStamp.h"
+#include "../agents/IAgent4Engine.h"
+#include "../dynamicstate/IPublicDynamicStateMap.h"
+#include "../influences/InfluencesMap.h"
+#include <cstddef>
+#include <memory>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace engine {
+
+/**
+ * Steps the agents of one category in one level as a group, e.g. with a
+ * vectorized implementation of their common behavior.
+ *
+ * The engines give the behavior a contiguous array of agents of the
+ * category, in several calls of disjoint groups when the engine is
+ * multithreaded. Both methods are optional: by default they go through the
+ * methods of each agent, so that a behavior overrides the phase it batches
+ * only.
+ */
+class ICategoryBatchBehavior {
+public:
+  virtual ~ICategoryBatchBehavior() = default;
+
+  /**
+   * Makes agents perceive in a level, then revise their global state.
+   * @param level The level.
+   * @param timeLowerBound The lower bound of the transitory period.
+   * @param timeUpperBound The upper bound of the transitory period.
+   * @param agents The agents, all lying in the level.
+   * @param count The number of agents.
+   * @param dynamicStates The dynamic states the agents perceive.
+   */
+  virtual void
+  perceive(const LevelIdentifier &level,
+           const SimulationTimeStamp &timeLowerBound,
+           const SimulationTimeStamp &timeUpperBound,
+           const std::shared_ptr<agents::IAgent4Engine> *agents,
+           std::size_t count,
+           const std::shared_ptr<dynamicstate::IPublicDynamicStateMap>
+               &dynamicStates) {
+    for (std::size_t i = 0; i < count; ++i) {
+      const auto &agent = agents[i];
+      agent->setPerceivedData(agent->perceive(
+          level, timeLowerBound, timeUpperBound,
+          agent->borrowPublicLocalStates(),
+          agent->borrowPrivateLocalState(level),
+          dynamicStates));
+      agent->reviseGlobalState(timeLowerBound, timeUpperBound,
+                               agent->borrowPerceivedData(),
+                               agent->borrowGlobalState());
+    }
+  }
+
+  /**
+   * Makes agents decide in a level, from the data they perceived there.
+   * @param level The level.
+   * @param timeLowerBound The lower bound of the transitory period.
+   * @param timeUpperBound The upper bound of the transitory period.
+   * @param agents The agents, all lying in the level.
+   * @param count The number of agents.
+   * @param producedInfluences The map receiving the influences of the
+   * agents.
+   */
+  virtual void
+  decide(const LevelIdentifier &level,
+         const SimulationTimeStamp &timeLowerBound,
+         const SimulationTimeStamp &timeUpperBound,
+         const std::shared_ptr<agents::IAgent4Engine> *agents,
+         std::size_t count,
+         const std::shared_ptr<influences::InfluencesMap>
+             &producedInfluences) {
+    for (std::size_t i = 0; i < count; ++i) {
+      const auto &agent = agents[i];
+      agent->decide(level, timeLowerBound, timeUpperBound,
+                    agent->borrowGlobalState(),
+                    agent->borrowPublicLocalState(level),
+                    agent->borrowPrivateLocalState(level),
+                    agent->borrowLastPerceivedData(level), producedInfluences);
+    }
+  }
+};
+
+} // namespace engine
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // ICATEGORYBATCHBEHAVIOR_H
@@ -0,0 +1,198 @@
+#ifndef MODELPLUGIN_H
+#define MODELPLUGIN_H
+
+#include "../AgentCategory.h"
+#include "../IProbe.h"
+#include "../ISimulationEngine.h"
+#include "../ISimulationModel.h"
+#include "../LevelIdentifier.h"
+#include "ICategoryBatchBehavior.h"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace engine {
+
+/**
+ * A batch behavior exported by a model plugin, for the agents of a category
+ * in a level (see setCategoryBatchBehavior of the engines).
+ */
+struct ModelPluginBatchBehavior {
+  const char *category;
+  const char *level;
+  ICategoryBatchBehavior *(*create)();
+  void (*destroy)(ICategoryBatchBehavior *);
+};
+
+/**
+ * A probe exported by a model plugin, e.g. exporting the states of its
+ * agents, made from a string of arguments such as a path.
+ */
+struct ModelPluginProbe {
+  const char *name;
+  IProbe *(*create)(const char *arguments);
+  void (*destroy)(IProbe *);
+};
+
+/**
+ * A simulation model built as a shared library, loaded at runtime, so that
+ * a model is deployed, e.g. compiled with -march=native for its host,
+ * without rebuilding the engine and the bindings.
+ *
+ * The library exports, with C linkage (see SIMILAR_MODEL_PLUGIN):
+ * - "similar_plugin_abi_version", returning the ABI_VERSION it was built for;
+ * - "similar_plugin_create_model", making a model from a string of
+ *   arguments, and "similar_plugin_destroy_model";
+ * - optionally, "similar_plugin_batch_behaviors", giving the batch
+ *   behaviors of its categories, and "similar_plugin_probes", giving the
+ *   probes of its model.
+ *
+ * The models and the behaviors are C++ objects: the library is built with
+ * the headers of this kernel and the same compiler and standard library as
+ * the host, and resolves the symbols of the kernel it uses against the host
+ * (built with ENABLE_EXPORTS) or its own copy of the kernel libraries. The
+ * code of the library stays mapped until the end of the process, since the
+ * agents and the influences of its models outlive them in the engine.
+ */
+class ModelPlugin {
+public:
+  /** The version of the exported functions and of their types. */
+  static constexpr int ABI_VERSION = 1;
+
+  /**
+   * Loads a library.
+   * @throws std::runtime_error If it cannot be loaded, misses a symbol or
+   * was built for another ABI_VERSION.
+   */
+  explicit ModelPlugin(const std::string &path);
+  ~ModelPlugin();
+
+  ModelPlugin(const ModelPlugin &) = delete;
+  ModelPlugin &operator=(const ModelPlugin &) = delete;
+
+  const std::string &getPath() const { return path; }
+
+  /**
+   * Makes a model of the library, destroyed by the library.
+   * @param arguments Parsed by the library, e.g. its parameters.
+   * @throws std::runtime_error If the library made no model.
+   */
+  std::shared_ptr<ISimulationModel>
+  createModel(const std::string &arguments = "") const;
+
+  /**
+   * Gets the number of batch behaviors of the library.
+   */
+  std::size_t getBatchBehaviorCount() const { return behaviorCount; }
+
+  /**
+   * Gets a batch behavior of the library.
+   * @param index Lower than getBatchBehaviorCount().
+   */
+  const ModelPluginBatchBehavior &getBatchBehavior(std::size_t index) const {
+    return behaviors[index];
+  }
+
+  /**
+   * Sets the batch behaviors of the library to an engine, with a new
+   * instance of each.
+   * @param engine A MultiThreadedSimulationEngine or a
+   * SequentialSimulationEngine, if the library has batch behaviors.
+   * @return The number of behaviors set.
+   * @throws std::invalid_argument If the engine has no batch behaviors.
+   */
+  std::size_t installBatchBehaviors(ISimulationEngine &engine) const;
+
+  /**
+   * Gets the number of probes of the library.
+   */
+  std::size_t getProbeCount() const { return probeCount; }
+
+  /**
+   * Gets a probe of the library.
+   * @param index Lower than getProbeCount().
+   */
+  const ModelPluginProbe &getProbe(std::size_t index) const {
+    return probes[index];
+  }
+
+  /**
+   * Makes a probe of the library, destroyed by the library.
+   * @param name The name of the probe.
+   * @param arguments Parsed by the probe.
+   * @throws std::invalid_argument If the library has no such probe.
+   * @throws std::runtime_error If the library made no probe.
+   */
+  std::shared_ptr<IProbe> createProbe(const std::string &name,
+                                      const std::string &arguments = "") const;
+
+private:
+  std::string path;
+  void *handle = nullptr;
+  ISimulationModel *(*create)(const char *) = nullptr;
+  void (*destroy)(ISimulationModel *) = nullptr;
+  const ModelPluginBatchBehavior *behaviors = nullptr;
+  std::size_t behaviorCount = 0;
+  const ModelPluginProbe *probes = nullptr;
+  std::size_t probeCount = 0;
+};
+
+} // namespace engine
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+/**
+ * Exports the functions of a model plugin, in one source of the library.
+ * @param factory A function making a new model, of type
+ * ISimulationModel *(const std::string &arguments).
+ */
+#define SIMILAR_MODEL_PLUGIN(factory)                                          \
+  extern "C" int similar_plugin_abi_version() {                               \
+    return ::fr::univ_artois::lgi2a::similar::microkernel::engine::           \
+        ModelPlugin::ABI_VERSION;                                             \
+  }                                                                           \
+  extern "C" ::fr::univ_artois::lgi2a::similar::microkernel::ISimulationModel \
+      *similar_plugin_create_model(const char *arguments) {                   \
+    return factory(std::string(arguments ? arguments : ""));                  \
+  }                                                                           \
+  extern "C" void similar_plugin_destroy_model(                               \
+      ::fr::univ_artois::lgi2a::similar::microkernel::ISimulationModel        \
+          *model) {                                                           \
+    delete model;                                                             \
+  }
+
+/**
+ * Exports the batch behaviors of a model plugin, in one source of the
+ * library.
+ * @param table An array of ModelPluginBatchBehavior.
+ */
+#define SIMILAR_MODEL_PLUGIN_BATCH_BEHAVIORS(table)                            \
+  extern "C" const ::fr::univ_artois::lgi2a::similar::microkernel::engine::   \
+      ModelPluginBatchBehavior *                                              \
+      similar_plugin_batch_behaviors(std::size_t *count) {                    \
+    *count = sizeof(table) / sizeof(table[0]);                                \
+    return table;                                                             \
+  }
+
+/**
+ * Exports the probes of a model plugin, in one source of the library.
+ * @param table An array of ModelPluginProbe.
+ */
+#define SIMILAR_MODEL_PLUGIN_PROBES(table)                                     \
+  extern "C" const ::fr::univ_artois::lgi2a::similar::microkernel::engine::   \
+      ModelPluginProbe *                                                      \
+      similar_plugin_probes(std::size_t *count) {                             \
+    *count = sizeof(table) / sizeof(table[0]);                                \
+    return table;                                                             \
+  }
+
+#endif // MODELPLUGIN_H
@@ -2,12 +2,34 @@
 #define MULTITHREADEDSIMULATIONENGINE_H
 
 #include "../ISimulationEngine.h"
+#include "../LevelIndexedMap.h"
+#include "../checkpoint/InfluenceLog.h"
+#include "../checkpoint/SimulationCheckpoint.h"
+#include "../influences/InfluenceArena.h"
+#include "../influences/InfluenceBuffer.h"
+#include "../libs/CallbackProfiler.h"
+#include "../libs/MemoryAccounting.h"
+#include "../libs/PerformanceCounters.h"
+#include "ActivationSchedule.h"
+#include "AgentRegistry.h"
+#include "HelperThread.h"
+#include "IAgentOrdering.h"
+#include "IAgentStepKernel.h"
+#include "IBatchDecisionHook.h"
+#include "ICategoryBatchBehavior.h"
+#include "ObservationSchedule.h"
+#include "WorkStealingThreadPool.h"
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <functional>
+#include <limits>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <set>
 #include <thread>
+#include <utility>
 #include <vector>
 
 namespace fr {
@@ -17,6 +39,8 @@ namespace similar {
 namespace microkernel {
 namespace engine {
 
+class RewindBuffer;
+
 /**
  * A multithreaded simulation engine that parallelizes agent perception and
  * decision phases.
@@ -26,16 +50,90 @@ namespace engine {
  * - Perception building
  * - Decision making
  *
- * The reaction phase remains sequential to ensure consistency.
+ * The reaction phase is sequential by default to ensure consistency. It can
+ * optionally run the reactions of independent levels concurrently (see
+ * setParallelReaction).
+ *
+ * The worker threads are created once with the engine and reused at every
+ * step. Agents are handed to them in chunks that idle workers steal from
+ * busy ones.
+ *
+ * In pipelined mode (see setPipelinedPerception), the agents start perceiving
+ * the next step while the levels are still reacting to the current one.
+ * With the natural overlap (see setNaturalOverlap), the levels compute their
+ * natural dynamics while the agents perceive and decide.
+ *
+ * With activation scheduling (see setActivationScheduling), only the agents
+ * whose next activation time is reached take part in a step.
+ *
+ * With a batch decision hook (see setBatchDecisionHook), all the agents
+ * perceive before the hook decides for them at once.
+ *
+ * An agent giving a step kernel for a level (see IAgentStepKernel) is
+ * stepped by one call to it rather than through its methods, unless it
+ * already perceived.
+ *
+ * The agents of a category given a batch behavior (see
+ * setCategoryBatchBehavior) perceive and decide in its level by chunks of
+ * their contiguous array, which the workers share like the other agents.
+ *
+ * The levels reacting one after the other, the probes, and the model while
+ * it generates the environment and the agents, can use the idle workers
+ * through WorkStealingThreadPool::parallelForOnCurrent().
+ *
+ * The probes given a schedule (see setObservationSchedule) observe only
+ * the steps it selects.
+ *
+ * The agents are iterated in the order of the registry, which an ordering
+ * (see setAgentOrdering) sorts every few steps.
+ *
+ * Each worker allocates its own influence buffers, so that their pages are
+ * on its NUMA node once the workers are pinned (see setWorkerPinning).
+ *
+ * With an influence log (see setInfluenceLog), the merged influences of the
+ * steps are recorded, so that replayInfluenceLog() plays the run again
+ * through the reactions only. A rewind buffer (see setRewindBuffer) keeps
+ * the recent steps in memory instead, for rewind() to go back to them.
  */
 class MultiThreadedSimulationEngine : public ISimulationEngine {
 private:
   /** Map of probes observing this simulation */
   std::map<std::string, std::shared_ptr<IProbe>> probes;
 
+  /** When the probes observe, by probe identifier; every step otherwise */
+  std::map<std::string, std::shared_ptr<IObservationSchedule>>
+      observationSchedules;
+
   /** Number of worker threads */
   size_t numThreads;
 
+  /** Number of agents per chunk of work (0 = automatic) */
+  size_t agentChunkSize = 0;
+
+  /** Whether the reactions of independent levels run concurrently */
+  bool parallelReaction = false;
+
+  /** Whether the next perception overlaps the reactions of a step */
+  bool pipelinedPerception = false;
+
+  /** Whether the natural dynamics of the levels overlap the agent phase */
+  bool naturalOverlap = false;
+
+  /** Whether only the agents whose activation time is reached are run */
+  bool activationScheduling = false;
+
+  /** The next activation time of the agents, with activation scheduling */
+  ActivationSchedule activationSchedule;
+
+  /** The next activation time of each agent of the current step */
+  std::vector<long> activationTimes;
+
+  /** The persistent workers running the parallel phases */
+  std::unique_ptr<WorkStealingThreadPool> threadPool;
+
+  /** The thread preparing the natural dynamics, once they overlap a step */
+  std::unique_ptr<HelperThread> naturalHelper;
+
   /** Flag to abort simulation */
   std::atomic<bool> abortRequested{false};
 
@@ -45,9 +143,28 @@ private:
   // Cache for simulation components (retrieved from model)
   std::map<LevelIdentifier, std::shared_ptr<levels::ILevel>> levels;
   std::shared_ptr<environment::IEnvironment4Engine> environment;
-  std::set<std::shared_ptr<agents::IAgent4Engine>> agents;
-  std::map<LevelIdentifier, std::set<std::shared_ptr<agents::IAgent4Engine>>>
-      agentsByLevel;
+
+  /** The agents, in slots reused by removals; also indexed by level */
+  AgentRegistry agents;
+
+  /** Dense index of each level, following the iteration order of levels */
+  LevelIndexedMap<size_t> levelIndices;
+  std::vector<std::shared_ptr<levels::ILevel>> indexedLevels;
+
+  /**
+   * For each level, the indices of the levels whose consistent state its
+   * agents perceive (the level itself and its perceptible levels)
+   */
+  std::vector<std::vector<size_t>> perceptionDependencies;
+
+  /** One append-only influence buffer per worker of the thread pool */
+  std::vector<influences::InfluenceBuffer> workerInfluences;
+
+  /** One reusable influences map per worker, handed to IAgent::decide */
+  std::vector<std::shared_ptr<influences::InfluencesMap>> workerScratchMaps;
+
+  /** One arena per worker, used by influences::makeInfluence during decide */
+  std::vector<std::shared_ptr<influences::InfluenceArena>> workerArenas;
 
   // Dynamic state
   std::shared_ptr<dynamicstate::IPublicDynamicStateMap> dynamicStates;
@@ -55,6 +172,64 @@ private:
   // Simulation state
   SimulationTimeStamp currentTime;
 
+  /** The listener of the step timings; the steps are timed when it is set */
+  std::shared_ptr<IStepTimingListener> stepTimingListener;
+
+  /** The barrier waited at before each step, if any */
+  std::shared_ptr<StepBarrier> stepBarrier;
+
+  /** The hook deciding for all the agents of a step, if any */
+  std::shared_ptr<IBatchDecisionHook> batchDecisionHook;
+
+  /** The order of the agents, if any, and the steps between two sorts */
+  std::shared_ptr<IAgentOrdering> agentOrdering;
+  size_t reorderPeriod = 1;
+  size_t stepsSinceReorder = 0;
+
+  /** Whether the workers are pinned to the CPUs of the NUMA nodes */
+  bool workerPinning = false;
+
+  /** Whether the timed steps count the phases with hardware counters */
+  bool performanceCounting = false;
+  /** The counters of the workers, opened by each worker at each run */
+  std::vector<std::unique_ptr<libs::PerformanceCounters>> workerCounters;
+
+  /** The behavior stepping the agents of a category in a level */
+  struct CategoryBatch {
+    LevelIdentifier level;
+    std::shared_ptr<ICategoryBatchBehavior> behavior;
+  };
+
+  /** The categories stepped in batches */
+  std::map<AgentCategory, CategoryBatch> categoryBatches;
+
+  /** The batch of each category of the agents during a step, or nullptr */
+  std::vector<const CategoryBatch *> batchOfCategory;
+
+  /** The time spent by a worker in each phase of the agents */
+  struct alignas(64) WorkerPhaseTimes {
+    StepTimings::Duration perception{0};
+    StepTimings::Duration revision{0};
+    StepTimings::Duration decision{0};
+    /** Perception of the next step, run while the current one reacted */
+    StepTimings::Duration perceptionAhead{0};
+  };
+
+  /** One set of phase times per worker, written without synchronization */
+  std::vector<WorkerPhaseTimes> workerPhaseTimes;
+
+  /** The log recording the influences of the steps, if any */
+  std::shared_ptr<checkpoint::InfluenceLogWriter> influenceLog;
+  /** The objects saved before the reactions of each logged step */
+  checkpoint::CheckpointSections influenceLogSections;
+
+  /** The recent steps, kept to go back to them, if any */
+  std::shared_ptr<RewindBuffer> rewindBuffer;
+  /** The objects saved with the snapshots and deltas of the buffer */
+  checkpoint::CheckpointSections rewindSections;
+  /** Set by rewind(), for the next step to perceive the rewound state */
+  std::atomic<bool> rewound{false};
+
 public:
   /**
    * Creates a multithreaded simulation engine.
@@ -64,6 +239,253 @@ public:
 
   virtual ~MultiThreadedSimulationEngine() = default;
 
+  /**
+   * Gets the number of threads used by the parallel phases.
+   */
+  size_t getNumThreads() const { return numThreads; }
+
+  /**
+   * Sets the number of consecutive agents processed as one unit of work.
+   * Smaller chunks balance heterogeneous agents better, larger ones reduce
+   * scheduling overhead.
+   * @param chunkSize The number of agents per chunk (0 = automatic).
+   */
+  void setAgentChunkSize(size_t chunkSize) { agentChunkSize = chunkSize; }
+
+  /**
+   * Gets the number of consecutive agents processed as one unit of work.
+   * @return The number of agents per chunk (0 = automatic).
+   */
+  size_t getAgentChunkSize() const { return agentChunkSize; }
+
+  /**
+   * Enables or disables the concurrent reaction of independent levels.
+   *
+   * A level is independent when getInfluenceableLevels() contains no other
+   * level than itself: its reaction then only updates its own consistent
+   * state. The reactions of the other levels still run sequentially, after
+   * the concurrent ones. Only enable this mode when the reaction models of
+   * independent levels do not share mutable data (e.g. a common environment).
+   * @param enabled true to run independent reactions concurrently.
+   */
+  void setParallelReaction(bool enabled) { parallelReaction = enabled; }
+
+  /**
+   * Tells whether the reactions of independent levels run concurrently.
+   */
+  bool isParallelReaction() const { return parallelReaction; }
+
+  /**
+   * Enables or disables the pipelined perception.
+   *
+   * The reactions of a step then run on a dedicated thread, one level after
+   * the other, while the workers perceive the next step: an agent perceives
+   * as soon as the levels it lies in and their perceptible levels reacted.
+   * This hides the reactions behind the perception when perception is the
+   * costly phase. A step is not pipelined when it produced system influences,
+   * since they change the agents, nor when it is the last one. Pipelined
+   * steps do not use the concurrent reaction of independent levels.
+   *
+   * Only enable this mode when the perception of the agents reads no other
+   * consistent state than the ones of getPerceptibleLevels(), and when
+   * perceiving does not modify the states read by the reactions.
+   * @param enabled true to overlap perception and reaction.
+   */
+  void setPipelinedPerception(bool enabled) { pipelinedPerception = enabled; }
+
+  /**
+   * Tells whether the next perception overlaps the reactions of a step.
+   */
+  bool isPipelinedPerception() const { return pipelinedPerception; }
+
+  /**
+   * Enables or disables the natural overlap.
+   *
+   * At each step, a helper thread, started by the first such step and kept
+   * with the engine, then calls
+   * levels::ILevel::prepareNaturalDynamics() on every level while the
+   * workers perceive and decide, and the reactions wait for it: the natural
+   * dynamics which only read the consistent state, e.g. the diffusion of
+   * the pheromones, are hidden behind the agents when those are the costly
+   * phase.
+   *
+   * Only enable this mode when the agents do not modify the consistent
+   * states while they perceive and decide.
+   * @param enabled true to overlap the natural dynamics and the agents.
+   */
+  void setNaturalOverlap(bool enabled) { naturalOverlap = enabled; }
+
+  /**
+   * Tells whether the natural dynamics of the levels overlap the agents.
+   */
+  bool isNaturalOverlap() const { return naturalOverlap; }
+
+  /**
+   * Enables or disables the activation scheduling.
+   *
+   * The engine then keeps the next activation time of every agent: an agent
+   * implementing agents::IScheduledAgent tells it once it decided, the other
+   * agents are activated at every step. The agents that are not activated
+   * during a step neither perceive, revise their global state nor decide;
+   * the levels still react at every step, so that the influences and the
+   * reactions keep their semantics. Steps where no agent is activated only
+   * cost the reactions. New agents, agents changing levels and all the
+   * agents when the scheduling is enabled are activated at the next step.
+   * A sleeping agent giving a wake condition (see
+   * agents::IScheduledAgent::getWakeCondition) is activated earlier, at the
+   * first step whose consistent state meets it; the conditions are evaluated
+   * on the thread of the engine, before the parallel work of the step.
+   * Steps are not pipelined while the scheduling is enabled.
+   * @param enabled true to skip the agents having nothing to do.
+   * @throws std::logic_error If a category is stepped in batches (see
+   * setCategoryBatchBehavior).
+   */
+  void setActivationScheduling(bool enabled);
+
+  /**
+   * Tells whether only the agents whose activation time is reached are run.
+   */
+  bool isActivationScheduling() const { return activationScheduling; }
+
+  /**
+   * Sets the hook deciding for all the agents of a step at once, or removes
+   * it with nullptr.
+   *
+   * The agent phase of a step is then split in two passes over the agents:
+   * they all perceive, the hook is called, then they revise their global
+   * state and decide. The time spent in the hook is counted in the decision
+   * time. The hook is not copied by clone(), since it usually holds the
+   * decisions of one run.
+   * @param hook The hook, called once per step.
+   */
+  void setBatchDecisionHook(std::shared_ptr<IBatchDecisionHook> hook) {
+    batchDecisionHook = std::move(hook);
+  }
+
+  /** Gets the hook deciding for all the agents of a step, if any. */
+  std::shared_ptr<IBatchDecisionHook> getBatchDecisionHook() const {
+    return batchDecisionHook;
+  }
+
+  /**
+   * Sets the order in which the agents are iterated, or removes it with
+   * nullptr.
+   *
+   * The registry of the agents is sorted by the keys of the ordering before
+   * the first step, then every period steps, so that the chunks of the
+   * workers hold agents of close keys. The influences of the agents are
+   * gathered in the order of the agents, which the reactions may depend on.
+   * The ordering is shared with the clones of this engine.
+   * @param ordering The ordering.
+   * @param period The steps between two sorts.
+   * @throws std::invalid_argument If the period is 0.
+   */
+  void setAgentOrdering(std::shared_ptr<IAgentOrdering> ordering,
+                        size_t period = 1);
+
+  /** Gets the order in which the agents are iterated, if any. */
+  std::shared_ptr<IAgentOrdering> getAgentOrdering() const {
+    return agentOrdering;
+  }
+
+  /**
+   * Sets when a probe observes the partly consistent states (see
+   * IObservationSchedule), or lets it observe every step again with
+   * nullptr. The schedule is kept by the identifier of the probe, whether
+   * it was added or not, and cloned with this engine.
+   * @param probeIdentifier The identifier of the probe.
+   * @param schedule The schedule.
+   */
+  void setObservationSchedule(const std::string &probeIdentifier,
+                              std::shared_ptr<IObservationSchedule> schedule);
+
+  /** Gets the schedule of a probe, if any. */
+  std::shared_ptr<IObservationSchedule>
+  getObservationSchedule(const std::string &probeIdentifier) const;
+
+  /**
+   * Pins the worker threads to the CPUs of the NUMA nodes of the machine
+   * (see CpuTopology::placeWorkers), or lets them run on any CPU again.
+   *
+   * The consecutive workers share a node, so that the contiguous ranges of
+   * agents handed to them at each step are processed on that node, and an
+   * idle worker steals from its node first. The thread running the
+   * simulation is worker 0 and keeps its affinity. The buffers of the
+   * workers are allocated again by the workers at the next run.
+   * @param enabled true to pin the workers.
+   * @return false if the affinity of the workers could not be set.
+   */
+  bool setWorkerPinning(bool enabled);
+
+  /** Tells whether the workers are pinned to CPUs. */
+  bool isWorkerPinning() const { return workerPinning; }
+
+  /**
+   * Counts the phases of the timed steps with the hardware counters of the
+   * workers (see PerformanceCounters), summed in StepTimings::counters. The
+   * counters are only read when a step timing listener is set, a few system
+   * calls per worker and phase.
+   * @return false if the counters are not available on this machine.
+   */
+  bool setPerformanceCounting(bool enabled);
+
+  /** Tells whether the timed steps are counted. */
+  bool isPerformanceCounting() const { return performanceCounting; }
+
+  /**
+   * Gets the live and peak bytes of the subsystems accounted by
+   * MemoryAccounting: the agent states, the influences, the fields of the
+   * environment... The accounts cover the whole process: the simulations
+   * running alongside this one count in them too.
+   */
+  std::vector<libs::MemoryUsage> getMemoryUsage() const {
+    return libs::MemoryAccounting::snapshot();
+  }
+
+  /**
+   * Gets the calls and the times of the callbacks of the models into a
+   * scripting language, e.g. the decisions of Python agents, while
+   * CallbackProfiler is enabled. The profiles cover the whole process.
+   */
+  std::vector<libs::CallbackProfile> getCallbackProfiles() const {
+    return libs::CallbackProfiler::snapshot();
+  }
+
+  /**
+   * Sets the behavior stepping the agents of a category in a level as a
+   * group, or removes it with nullptr.
+   *
+   * Every agent of the category must lie in the level: the behavior gets
+   * chunks of the contiguous array of the category (see
+   * AgentRegistry::inCategory), concurrently, while the agents go through
+   * their own methods in their other levels. A category has one behavior at
+   * most. Steps are not pipelined while a category is stepped in batches.
+   * The behavior is shared with the clones of this engine.
+   * @param category The category of the agents.
+   * @param level The level where the behavior steps them.
+   * @param behavior The behavior.
+   * @throws std::logic_error If the activation scheduling is enabled, since
+   * it steps agents one by one.
+   */
+  void
+  setCategoryBatchBehavior(const AgentCategory &category,
+                           const LevelIdentifier &level,
+                           std::shared_ptr<ICategoryBatchBehavior> behavior);
+
+  /**
+   * Gets the behavior stepping the agents of a category, if any.
+   */
+  std::shared_ptr<ICategoryBatchBehavior>
+  getCategoryBatchBehavior(const AgentCategory &category) const;
+
+  /**
+   * Activates an agent at the next step, whatever its next activation time,
+   * e.g. when a reaction changes its state. This method can be called from
+   * any thread.
+   * @param agent The agent to activate.
+   */
+  void activateAgent(const std::shared_ptr<agents::IAgent4Engine> &agent);
+
   /**
    * {@inheritDoc}
    */
@@ -90,11 +512,232 @@ public:
    */
   void runNewSimulation(std::shared_ptr<ISimulationModel> model) override;
 
+  /**
+   * Builds the initial state of a simulation without running it: the model
+   * generates the levels, the environment and the agents. runNewSimulation()
+   * is initializeSimulation() followed by startSimulation().
+   * @param model The model of the simulation.
+   */
+  void initializeSimulation(std::shared_ptr<ISimulationModel> model);
+
+  /**
+   * Notifies the probes that the simulation starts from its current state,
+   * then runs it until the model ends it. Used to run an initialized engine
+   * or one of its clones.
+   * @throws std::runtime_error If the simulation was not initialized.
+   */
+  void startSimulation();
+
+  /**
+   * Forks the simulation at its current time, to explore another branch of
+   * it: the fork is a clone() of this engine, its probes, levels,
+   * environment and agents, which runSimulation() runs on independently of
+   * this engine. The states sharing their content with their clones copy it
+   * on the first write (see CopyOnWrite), e.g. the influences of the
+   * consistent states, so that the forks of a simulation only cost the
+   * states that diverge.
+   * @throws std::runtime_error If the simulation was not initialized.
+   */
+  std::shared_ptr<MultiThreadedSimulationEngine> fork() const;
+
+  /**
+   * The state of a simulation between two steps: copies of its levels, its
+   * environment and its agents, sharing their content copy-on-write with
+   * the simulation (see CopyOnWrite), and its time. Unlike a fork(), a
+   * snapshot has neither probes nor workers of its own.
+   */
+  class Snapshot {
+  public:
+    SimulationTimeStamp getTime() const { return time; }
+
+  private:
+    friend class MultiThreadedSimulationEngine;
+    std::map<LevelIdentifier, std::shared_ptr<levels::ILevel>> levels;
+    std::shared_ptr<environment::IEnvironment4Engine> environment;
+    std::vector<std::shared_ptr<agents::IAgent4Engine>> agents;
+    SimulationTimeStamp time{0};
+  };
+
+  /**
+   * Takes a snapshot of the simulation at its current time.
+   * @throws std::runtime_error If the simulation was not initialized.
+   */
+  std::shared_ptr<const Snapshot> takeSnapshot() const;
+
+  /**
+   * Brings the simulation back to a snapshot of it, which stays usable. To
+   * be called between two steps, as rewind().
+   */
+  void restoreSnapshot(const Snapshot &snapshot);
+
+  /**
+   * Keeps the recent steps in a rewind buffer, or stops with nullptr. The
+   * buffer takes a snapshot at the first step run once it is set. It is not
+   * copied by clone().
+   * @param buffer The buffer.
+   * @param sections The objects the reactions draw from, e.g. the global
+   * random generator, saved with the snapshots and the deltas.
+   */
+  void setRewindBuffer(std::shared_ptr<RewindBuffer> buffer,
+                       checkpoint::CheckpointSections sections = {});
+
+  /** Gets the buffer keeping the recent steps, if any. */
+  std::shared_ptr<RewindBuffer> getRewindBuffer() const {
+    return rewindBuffer;
+  }
+
+  /**
+   * Goes back to a recent time kept by the rewind buffer: the last snapshot
+   * before it is restored, then the reactions to the deltas of the steps up
+   * to it are made, without any perception or decision. The steps after the
+   * time reached are dropped from the buffer, and the probes observe the
+   * time reached as the end of a step.
+   *
+   * To be called between two steps, while the simulation does not run them:
+   * from a probe, once runSimulation() returned, or from another thread
+   * while the engine waits paused (see StepBarrier::whileParked).
+   * @return The time reached, the latest time at most the one asked that
+   * the buffer can go back to.
+   * @throws std::logic_error If the engine has no rewind buffer.
+   * @throws std::out_of_range If the time is before the buffer.
+   */
+  SimulationTimeStamp rewind(const SimulationTimeStamp &time);
+
+  /**
+   * Gets the time stamp reached by the simulation.
+   */
+  SimulationTimeStamp getCurrentTime() const { return currentTime; }
+
+  /**
+   * Gets the model of the simulation, or nullptr before its initialization.
+   */
+  std::shared_ptr<ISimulationModel> getSimulationModel() const {
+    return currentModel;
+  }
+
   /**
    * {@inheritDoc}
    */
   void runSimulation(const SimulationTimeStamp &finalTime) override;
 
+  /**
+   * Saves the state of the simulation between two steps in a checkpoint file
+   * (see checkpoint::SimulationCheckpoint for its content).
+   * @param path The file receiving the checkpoint; it is replaced once the
+   * new checkpoint is completely written.
+   * @param sections Additional objects to save, e.g. random generators.
+   * @throws checkpoint::CheckpointException If the file cannot be written.
+   */
+  void saveCheckpoint(const std::string &path,
+                      const checkpoint::CheckpointSections &sections = {})
+      const;
+
+  /**
+   * Initializes a simulation from a checkpoint instead of the initial state
+   * of the model. The model rebuilds the levels and the environment, whose
+   * content is then read from the checkpoint; the agents are built by the
+   * factory. The simulation then goes on with runSimulation(). Probes are not
+   * notified of the restoration.
+   * @param model The model of the checkpointed simulation.
+   * @param path The checkpoint file, mapped in memory while it is read.
+   * @param agentFactory Builds the agents of the checkpoint.
+   * @param sections Additional objects to restore, e.g. random generators.
+   * @throws checkpoint::CheckpointException If the checkpoint cannot be read
+   * or does not match the model.
+   */
+  void restoreCheckpoint(std::shared_ptr<ISimulationModel> model,
+                         const std::string &path,
+                         const checkpoint::AgentFactory &agentFactory,
+                         const checkpoint::CheckpointSections &sections = {});
+
+  /**
+   * Records the next steps in an influence log, or stops recording with
+   * nullptr (see checkpoint::InfluenceLogWriter for its content).
+   *
+   * The log is started with a checkpoint at the first step run once it is
+   * set. Each step then appends its merged regular influences and the
+   * sections as they are before the reactions; a step having system
+   * influences is followed by a key frame. The regular influences must have
+   * a codec in the log. The log is not copied by clone().
+   * @param log The log.
+   * @param sections The objects the reactions draw from, e.g. the global
+   * random generator; they are also saved in the checkpoints of the log.
+   */
+  void setInfluenceLog(std::shared_ptr<checkpoint::InfluenceLogWriter> log,
+                       checkpoint::CheckpointSections sections = {}) {
+    influenceLog = std::move(log);
+    influenceLogSections = std::move(sections);
+  }
+
+  /** Gets the log recording the influences of the steps, if any. */
+  std::shared_ptr<checkpoint::InfluenceLogWriter> getInfluenceLog() const {
+    return influenceLog;
+  }
+
+  /**
+   * Plays an influence log again: the simulation is restored from the
+   * initial checkpoint of the log, then each recorded step restores its
+   * sections and makes the regular reactions of the levels to its
+   * influences, one level after the other, without any perception or
+   * decision of the agents. Key frames are restored as checkpoints. The
+   * probes observe the replay as a run of the simulation.
+   *
+   * The replay gives the states of the recorded run when the reactions only
+   * depend on the consistent states, the influences and the sections, and
+   * not on the iteration order of the influence sets.
+   * @param model The model of the recorded simulation.
+   * @param path The log, mapped in memory while it is played.
+   * @param codecs The codecs of the influences of the log.
+   * @param agentFactory Builds the agents of the checkpoints of the log.
+   * @param sections The objects given to the log when it was recorded.
+   * @param finalTime The time where the replay stops, if before the end of
+   * the log.
+   * @throws checkpoint::CheckpointException If the log cannot be read or
+   * does not match the model.
+   */
+  void replayInfluenceLog(
+      std::shared_ptr<ISimulationModel> model, const std::string &path,
+      const checkpoint::InfluenceCodecs &codecs,
+      const checkpoint::AgentFactory &agentFactory,
+      const checkpoint::CheckpointSections &sections = {},
+      const SimulationTimeStamp &finalTime =
+          SimulationTimeStamp(std::numeric_limits<long>::max()));
+
+  /**
+   * {@inheritDoc}
+   *
+   * In pipelined mode, the perception overlapping the reactions of a step is
+   * counted in the timings of the step it perceives.
+   */
+  void setStepTimingListener(
+      std::shared_ptr<IStepTimingListener> listener) override {
+    stepTimingListener = std::move(listener);
+  }
+
+  /**
+   * {@inheritDoc}
+   */
+  std::shared_ptr<IStepTimingListener> getStepTimingListener() const override {
+    return stepTimingListener;
+  }
+
+  /**
+   * {@inheritDoc}
+   *
+   * In pipelined mode, the agents may already have perceived the step the
+   * engine waits for: the state they perceived does not change meanwhile.
+   */
+  void setStepBarrier(std::shared_ptr<StepBarrier> barrier) override {
+    stepBarrier = std::move(barrier);
+  }
+
+  /**
+   * {@inheritDoc}
+   */
+  std::shared_ptr<StepBarrier> getStepBarrier() const override {
+    return stepBarrier;
+  }
+
   // ISimulationEngine getters implementation
   std::shared_ptr<dynamicstate::IPublicDynamicStateMap>
   getSimulationDynamicStates() const override;
@@ -123,6 +766,14 @@ public:
       std::shared_ptr<dynamicstate::TransitoryPublicLocalDynamicState>
           transitoryDynamicState) const override;
 
+  /**
+   * {@inheritDoc}
+   *
+   * The clone shares the model of this engine and continues the simulation
+   * from its current time. Its consistent states hold the public local states
+   * of the cloned agents and the public local states of the cloned
+   * environment. The step timing listener is not copied.
+   */
   std::shared_ptr<ISimulationEngine> clone() const override;
 
 private:
@@ -131,8 +782,7 @@ private:
    */
   class PublicDynamicStateMap : public dynamicstate::IPublicDynamicStateMap {
   private:
-    std::map<LevelIdentifier,
-             std::shared_ptr<dynamicstate::IPublicLocalDynamicState>>
+    LevelIndexedMap<std::shared_ptr<dynamicstate::IPublicLocalDynamicState>>
         states;
 
   public:
@@ -143,26 +793,17 @@ private:
 
     void put(std::shared_ptr<dynamicstate::IPublicLocalDynamicState> state)
         override {
-      // Assuming state has getLevel() or similar?
-      // IPublicLocalDynamicState has getLevel().
       states[state->getLevel()] = state;
     }
 
     std::shared_ptr<dynamicstate::IPublicLocalDynamicState>
     get(const LevelIdentifier &level) const override {
-      auto it = states.find(level);
-      if (it != states.end()) {
-        return it->second;
-      }
-      return nullptr;
+      auto state = states.find(level);
+      return state != nullptr ? *state : nullptr;
     }
 
     std::set<LevelIdentifier> keySet() const override {
-      std::set<LevelIdentifier> keys;
-      for (const auto &pair : states) {
-        keys.insert(pair.first);
-      }
-      return keys;
+      return states.keySet();
     }
   };
 
@@ -170,7 +811,7 @@ private:
    * Process agents in parallel for perception phase.
    */
   void parallelPerception(
-      const std::vector<std::shared_ptr<agents::IAgent4Engine>> &agents,
+      AgentRegistry::View agents,
       SimulationTimeStamp timeLowerBound, SimulationTimeStamp timeUpperBound,
       std::shared_ptr<dynamicstate::IPublicDynamicStateMap> consistentState);
 
@@ -178,17 +819,97 @@ private:
    * Process agents in parallel for decision phase.
    */
   void parallelDecision(
-      const std::vector<std::shared_ptr<agents::IAgent4Engine>> &agents,
+      AgentRegistry::View agents,
       SimulationTimeStamp timeLowerBound, SimulationTimeStamp timeUpperBound,
       std::shared_ptr<dynamicstate::IPublicDynamicStateMap> transitoryState);
 
   /**
-   * Worker function for parallel processing.
+   * Assigns a dense index to every level and sizes the worker buffers.
+   */
+  void indexLevels();
+
+  /**
+   * Generates the levels and the environment of a model.
+   */
+  void generateStructure(const std::shared_ptr<ISimulationModel> &model);
+
+  /**
+   * Adds an agent to the simulation, and its public local states to the
+   * consistent states of its levels.
+   */
+  void registerAgent(const std::shared_ptr<agents::IAgent4Engine> &agent);
+
+  /**
+   * Fills the dynamic states with the consistent states of the levels.
+   */
+  void publishConsistentStates();
+
+  /**
+   * Rebuilds the structure of the model and reads a checkpoint into it.
+   */
+  void restoreFrom(checkpoint::CheckpointReader &reader,
+                   const checkpoint::AgentFactory &agentFactory,
+                   const checkpoint::CheckpointSections &sections);
+
+  /**
+   * Replaces the levels, the environment and the agents of the simulation
+   * with copies of the ones given, sharing their content copy-on-write.
+   */
+  void copyStateFrom(
+      const std::map<LevelIdentifier, std::shared_ptr<levels::ILevel>>
+          &sourceLevels,
+      const std::shared_ptr<environment::IEnvironment4Engine> &sourceEnvironment,
+      AgentRegistry::View sourceAgents);
+
+  /**
+   * Makes the regular reactions of some levels to the influences of a step,
+   * one level after the other, then publishes their consistent states.
+   */
+  void reactTo(const SimulationTimeStamp &timeLowerBound,
+               const SimulationTimeStamp &timeUpperBound,
+               const std::vector<std::shared_ptr<levels::ILevel>> &reacting,
+               const checkpoint::InfluencesByLevel &influencesByLevel);
+
+  /**
+   * Writes the checkpoint of the simulation in its current state.
+   */
+  void writeCheckpoint(checkpoint::CheckpointWriter &writer,
+                       const checkpoint::CheckpointSections &sections) const;
+
+  /**
+   * Applies the system influences of a step once its regular reactions are
+   * done: agents are added to or removed from the simulation and its levels,
+   * then each level makes its system reaction. The agent registry is updated
+   * in a single batch.
+   */
+  void applySystemInfluences(
+      const std::vector<std::vector<std::shared_ptr<influences::IInfluence>>>
+          &systemInfluencesByLevel,
+      SimulationTimeStamp timeLowerBound, SimulationTimeStamp timeUpperBound);
+
+  /**
+   * Runs the reactions of a step on a dedicated thread while the workers
+   * perceive the next step, each agent waiting for the reaction of the levels
+   * it perceives.
+   */
+  void reactWhilePerceiving(const std::vector<size_t> &reactionOrder,
+                            const std::function<void(size_t)> &react,
+                            SimulationTimeStamp perceptionLowerBound,
+                            SimulationTimeStamp perceptionUpperBound);
+
+  /**
+   * Tells whether a level only influences itself.
+   */
+  static bool isIndependentLevel(const levels::ILevel &level);
+
+  /**
+   * Worker function for parallel processing. processFunc is called with the
+   * index of the worker, the index of the agent and the agent; each chunk of
+   * agents is traced as an event named traceName.
    */
   template <typename Func>
-  void parallelProcess(
-      const std::vector<std::shared_ptr<agents::IAgent4Engine>> &agents,
-      Func processFunc);
+  void parallelProcess(AgentRegistry::View agents, const char *traceName,
+                       Func processFunc);
 };
 
 } // namespace engine
@@ -0,0 +1,118 @@
+#ifndef OBSERVATIONSCHEDULE_H
+#define OBSERVATIONSCHEDULE_H
+
+#include "../SimulationTimeStamp.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace engine {
+
+/**
+ * When a probe observes the partly consistent states of a simulation.
+ *
+ * The engines ask the schedule of a probe (see
+ * setObservationSchedule()) after each step, on the thread running the
+ * simulation, and skip observeAtPartialConsistentTime() when it is not due:
+ * a heavy probe then costs only the steps it observes. The initial and
+ * final observations are always made.
+ */
+class IObservationSchedule {
+public:
+  virtual ~IObservationSchedule() = default;
+
+  /** Called when a simulation starts, before its initial observation. */
+  virtual void reset() {}
+
+  /**
+   * Checks if the probe observes the states reached at a time, once per
+   * step.
+   */
+  virtual bool isObservationDue(const SimulationTimeStamp &time) = 0;
+
+  /** Copies the schedule, without its state, for the clones of an engine. */
+  virtual std::shared_ptr<IObservationSchedule> clone() const = 0;
+};
+
+/**
+ * Observes one step of every period steps: the steps period, 2 * period...
+ */
+class PeriodicObservationSchedule : public IObservationSchedule {
+private:
+  std::size_t period;
+  std::size_t steps = 0;
+
+public:
+  /** @throws std::invalid_argument If the period is 0. */
+  explicit PeriodicObservationSchedule(std::size_t period);
+
+  void reset() override { steps = 0; }
+  bool isObservationDue(const SimulationTimeStamp &time) override;
+  std::shared_ptr<IObservationSchedule> clone() const override;
+
+  std::size_t getPeriod() const { return period; }
+};
+
+/**
+ * Observes at most once per interval of wall-clock time: the first step,
+ * then the first step ending an interval after the last observation.
+ */
+class RateLimitedObservationSchedule : public IObservationSchedule {
+private:
+  using Clock = std::chrono::steady_clock;
+
+  Clock::duration interval;
+  Clock::time_point last;
+  bool observed = false;
+
+public:
+  /** @throws std::invalid_argument If the interval is negative. */
+  explicit RateLimitedObservationSchedule(Clock::duration interval);
+
+  void reset() override { observed = false; }
+  bool isObservationDue(const SimulationTimeStamp &time) override;
+  std::shared_ptr<IObservationSchedule> clone() const override;
+
+  Clock::duration getInterval() const { return interval; }
+};
+
+/**
+ * Observes the steps following an event: a call to trigger(), from any
+ * thread, or a condition on the time checked after each step.
+ */
+class TriggeredObservationSchedule : public IObservationSchedule {
+public:
+  using Condition = std::function<bool(const SimulationTimeStamp &)>;
+
+private:
+  Condition condition;
+  std::atomic<bool> triggered{false};
+
+public:
+  /** @param condition The condition observing a step, if any. */
+  explicit TriggeredObservationSchedule(Condition condition = nullptr)
+      : condition(std::move(condition)) {}
+
+  /** Observes the next step, once. */
+  void trigger() { triggered.store(true, std::memory_order_release); }
+
+  void reset() override { triggered.store(false, std::memory_order_relaxed); }
+  bool isObservationDue(const SimulationTimeStamp &time) override;
+  std::shared_ptr<IObservationSchedule> clone() const override;
+};
+
+} // namespace engine
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // OBSERVATIONSCHEDULE_H
@@ -0,0 +1,96 @@
+#ifndef PARAMETERSWEEPRUNNER_H
+#define PARAMETERSWEEPRUNNER_H
+
+#include "../ISimulationModel.h"
+#include "MultiThreadedSimulationEngine.h"
+#include "WorkStealingThreadPool.h"
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace engine {
+
+/**
+ * Runs many variants of a simulation that only differ in their parameters.
+ *
+ * The model initializes the simulation once; every variant then runs on a
+ * clone of the initialized engine, so that the levels, the environment and
+ * the agents are not generated again for each run. The variants run
+ * concurrently on a thread pool shared by the whole sweep, each one on a
+ * single thread by default. A clone is only made when its variant starts, so
+ * at most getConcurrentRuns() forks are alive at the same time.
+ *
+ * The clones share the model of the initialized engine: its methods must be
+ * safe to call from several threads, which is the case of a model that is
+ * not modified while the sweep runs.
+ */
+class ParameterSweepRunner {
+public:
+  /**
+   * Prepares the fork of a variant before it runs, e.g. sets its parameters
+   * in the levels or the environment and adds its probes, or reads its
+   * results once it ran.
+   */
+  using VariantFunction =
+      std::function<void(size_t variant, MultiThreadedSimulationEngine &fork)>;
+
+  /**
+   * Builds a runner.
+   * @param concurrentRuns The number of variants running at the same time
+   * (0 = auto-detect from hardware).
+   */
+  explicit ParameterSweepRunner(size_t concurrentRuns = 0);
+
+  /**
+   * Gets the number of variants running at the same time.
+   */
+  size_t getConcurrentRuns() const { return threadPool.size(); }
+
+  /**
+   * Initializes a simulation once, then runs variants of it.
+   * @param model The model of the simulation.
+   * @param variantCount The number of variants to run.
+   * @param setup Prepares the fork of a variant before it runs.
+   * @param finish Called with the fork of a variant once it ran, or nullptr.
+   * @param threadsPerRun The number of threads of the engine of each variant.
+   * @return For each variant, the exception that ended it, or nullptr if it
+   * ran to its end.
+   */
+  std::vector<std::exception_ptr>
+  run(std::shared_ptr<ISimulationModel> model, size_t variantCount,
+      const VariantFunction &setup, const VariantFunction &finish = nullptr,
+      size_t threadsPerRun = 1);
+
+  /**
+   * Runs variants of an initialized simulation, each on a clone of engine.
+   * @param engine The initialized engine, which is left unchanged.
+   * @param variantCount The number of variants to run.
+   * @param setup Prepares the fork of a variant before it runs.
+   * @param finish Called with the fork of a variant once it ran, or nullptr.
+   * @return For each variant, the exception that ended it, or nullptr if it
+   * ran to its end.
+   */
+  std::vector<std::exception_ptr>
+  run(const MultiThreadedSimulationEngine &engine, size_t variantCount,
+      const VariantFunction &setup, const VariantFunction &finish = nullptr);
+
+private:
+  /** The workers running the variants */
+  WorkStealingThreadPool threadPool;
+};
+
+} // namespace engine
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // PARAMETERSWEEPRUNNER_H
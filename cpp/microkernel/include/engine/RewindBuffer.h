@@ -0,0 +1,156 @@
+#ifndef REWINDBUFFER_H
+#define REWINDBUFFER_H
+
+#include "../SimulationTimeStamp.h"
+#include "../checkpoint/InfluenceLog.h"
+#include "MultiThreadedSimulationEngine.h"
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace engine {
+
+/**
+ * The recent past of a simulation, kept in memory so that a view goes back
+ * a few hundred steps without running the simulation again (see
+ * MultiThreadedSimulationEngine::rewind).
+ *
+ * The buffer is a ring of frames. A frame starts with a snapshot of the
+ * simulation, whose states share their content copy-on-write with the
+ * simulation (see MultiThreadedSimulationEngine::Snapshot), followed by the
+ * deltas of the next steps: the sections as they are before the reactions
+ * and the merged regular influences, encoded as in an influence log (see
+ * checkpoint::InfluenceLogWriter). Going back to a time restores the last
+ * snapshot before it, then makes the reactions to the deltas up to it.
+ *
+ * A new frame starts every keyFramePeriod steps, and after the steps having
+ * system influences or influences without a codec. Without any codec, the
+ * frames are snapshots only, and the simulation goes back to the last
+ * snapshot before the time asked. The frames are dropped once older than
+ * the capacity, so that the buffer holds at most capacity + keyFramePeriod
+ * steps.
+ */
+class RewindBuffer {
+public:
+  /** The delta of a step */
+  struct Step {
+    SimulationTimeStamp timeLowerBound{0};
+    SimulationTimeStamp timeUpperBound{0};
+    /** The sections, then the influences by index of level */
+    checkpoint::CheckpointWriter record;
+  };
+
+  /** A snapshot and the deltas of the steps following it */
+  struct Frame {
+    std::shared_ptr<const MultiThreadedSimulationEngine::Snapshot> snapshot;
+    /** The sections as they were when the snapshot was taken */
+    checkpoint::CheckpointWriter sections;
+    std::vector<Step> steps;
+    /** The steps run since the snapshot, with a delta or not */
+    std::size_t stepCount = 0;
+
+    SimulationTimeStamp getTime() const { return snapshot->getTime(); }
+
+    /** Gets the last time the frame reaches. */
+    SimulationTimeStamp getEndTime() const {
+      return steps.empty() ? getTime() : steps.back().timeUpperBound;
+    }
+  };
+
+  /**
+   * @param capacity The steps the simulation can go back at least.
+   * @param keyFramePeriod The steps between two snapshots, at least 1.
+   * @param codecs The codecs of the regular influences of the model.
+   * @throws std::invalid_argument If the period is 0.
+   */
+  RewindBuffer(std::size_t capacity, std::size_t keyFramePeriod = 32,
+               checkpoint::InfluenceCodecs codecs = {});
+
+  std::size_t getCapacity() const { return capacity; }
+  std::size_t getKeyFramePeriod() const { return keyFramePeriod; }
+  const checkpoint::InfluenceCodecs &getCodecs() const { return codecs; }
+
+  bool isEmpty() const;
+
+  /**
+   * Gets the earliest time the simulation can go back to.
+   * @throws std::logic_error If the buffer is empty.
+   */
+  SimulationTimeStamp getEarliestTime() const;
+
+  /**
+   * Gets the latest time recorded.
+   * @throws std::logic_error If the buffer is empty.
+   */
+  SimulationTimeStamp getLatestTime() const;
+
+  std::size_t getFrameCount() const;
+
+  /** Gets the bytes of the deltas and of the sections of the frames. */
+  std::size_t getDeltaBytes() const;
+
+  /** Drops all the frames. */
+  void clear();
+
+  // Recording, by the engine, between or during its steps.
+
+  /** Tells whether the next step has to start a frame. */
+  bool needsKeyFrame() const;
+
+  /**
+   * Starts a frame, dropping the frames no longer needed to go back the
+   * capacity.
+   */
+  void addKeyFrame(
+      std::shared_ptr<const MultiThreadedSimulationEngine::Snapshot> snapshot,
+      const checkpoint::CheckpointSections &sections);
+
+  /**
+   * Records the delta of a step in the last frame. A step whose influences
+   * have no codec is not recorded: the next step starts a frame.
+   */
+  void addStep(const SimulationTimeStamp &timeLowerBound,
+               const SimulationTimeStamp &timeUpperBound,
+               const checkpoint::CheckpointSections &sections,
+               const checkpoint::InfluencesByLevel &influencesByLevel);
+
+  /** Makes the next step start a frame, e.g. after system influences. */
+  void requestKeyFrame();
+
+  /**
+   * Gets the last frame starting at or before a time, or nullptr if there is
+   * none. It stays valid until the buffer records again.
+   */
+  const Frame *frameAt(const SimulationTimeStamp &time) const;
+
+  /** Drops the deltas and the frames after a time. */
+  void discardAfter(const SimulationTimeStamp &time);
+
+private:
+  std::size_t capacity;
+  std::size_t keyFramePeriod;
+  checkpoint::InfluenceCodecs codecs;
+
+  mutable std::mutex mutex;
+  std::deque<Frame> frames;
+  bool keyFrameDue = false;
+  std::size_t deltaBytes = 0;
+
+  static std::size_t bytesOf(const Frame &frame);
+};
+
+} // namespace engine
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // REWINDBUFFER_H
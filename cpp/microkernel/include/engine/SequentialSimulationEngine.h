@@ -4,8 +4,16 @@
 #include "../IProbe.h"
 #include "../ISimulationEngine.h"
 #include "../ISimulationModel.h"
+#include "../LevelIndexedMap.h"
+#include "../influences/InfluenceArena.h"
+#include "../libs/MemoryAccounting.h"
+#include "../libs/PerformanceCounters.h"
+#include "IAgentStepKernel.h"
+#include "ICategoryBatchBehavior.h"
+#include "ObservationSchedule.h"
 #include <atomic>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <set>
 #include <string>
@@ -20,7 +28,16 @@ namespace engine {
 
 /**
  * A sequential implementation of the simulation engine.
- * This engine executes the simulation loop in a single thread.
+ * This engine executes the simulation loop in a single thread. Levels are
+ * scheduled independently: at each time stamp, only the levels whose time
+ * model reaches it are perceived, decided and reacted upon.
+ *
+ * The agents of a level giving the same step kernel (see IAgentStepKernel)
+ * are stepped by one call to it, after the other agents decided.
+ *
+ * The agents of a category given a batch behavior for a level (see
+ * setCategoryBatchBehavior) perceive and decide there in one group, after
+ * the other agents of the level did.
  */
 class SequentialSimulationEngine : public ISimulationEngine {
 private:
@@ -28,6 +45,10 @@ private:
   std::map<std::string, std::shared_ptr<IProbe>> probes;
   std::mutex probesMutex;
 
+  // When the probes observe, by probe identifier; every step otherwise
+  std::map<std::string, std::shared_ptr<IObservationSchedule>>
+      observationSchedules;
+
   // Simulation state
   std::atomic<bool> abortionRequested;
   std::shared_ptr<ISimulationModel> currentModel;
@@ -40,12 +61,50 @@ private:
   std::map<LevelIdentifier, std::shared_ptr<levels::ILevel>> levels;
   std::shared_ptr<environment::IEnvironment4Engine> environment;
   std::set<std::shared_ptr<agents::IAgent4Engine>> agents;
-  std::map<LevelIdentifier, std::set<std::shared_ptr<agents::IAgent4Engine>>>
+  LevelIndexedMap<std::set<std::shared_ptr<agents::IAgent4Engine>>>
       agentsByLevel;
 
+  // The agents of the level processed, stepped by their kernel and not
+  std::vector<std::pair<const IAgentStepKernel *,
+                        std::vector<agents::IAgent4Engine *>>>
+      kernelBatches;
+  std::vector<const std::shared_ptr<agents::IAgent4Engine> *> virtualAgents;
+
+  // The behavior of each category stepped in batches, with its level
+  std::map<AgentCategory,
+           std::pair<LevelIdentifier, std::shared_ptr<ICategoryBatchBehavior>>>
+      categoryBehaviors;
+
+  // The agents of the level processed stepped by a category behavior
+  std::vector<std::pair<ICategoryBatchBehavior *,
+                        std::vector<std::shared_ptr<agents::IAgent4Engine>>>>
+      categoryBatches;
+
+  // Arena used by influences::makeInfluence while the agents decide
+  std::shared_ptr<influences::InfluenceArena> influenceArena;
+
+  // Listener of the step timings; the steps are timed when it is set
+  std::shared_ptr<IStepTimingListener> stepTimingListener;
+
+  // Barrier waited at before each step, if any
+  std::shared_ptr<engine::StepBarrier> stepBarrier;
+
+  // Whether the timed steps count the phases with hardware counters, and
+  // the counters of the thread running the simulation while it runs
+  bool performanceCounting = false;
+  std::unique_ptr<libs::PerformanceCounters> counters;
+
   // Helper methods
   void initializeSimulation(std::shared_ptr<ISimulationModel> model);
+  void
+  indexPublicLocalState(const std::shared_ptr<agents::IAgent4Engine> &agent,
+                        const LevelIdentifier &levelId);
   void runSimulationLoop(const SimulationTimeStamp &finalTime);
+  void processLevel(const LevelIdentifier &levelId,
+                    const std::shared_ptr<levels::ILevel> &level,
+                    const SimulationTimeStamp &timeLowerBound,
+                    const SimulationTimeStamp &timeUpperBound,
+                    StepTimings *timings);
   void notifyProbesOfPreparation(const SimulationTimeStamp &initialTime);
   void notifyProbesOfStart(const SimulationTimeStamp &initialTime);
   void notifyProbesOfEnd(const SimulationTimeStamp &finalTime);
@@ -55,6 +114,63 @@ public:
   SequentialSimulationEngine();
   virtual ~SequentialSimulationEngine() = default;
 
+  /**
+   * Sets the behavior stepping the agents of a category in a level as a
+   * group, or removes it with nullptr. A category has one behavior at most;
+   * its agents go through their own methods in their other levels. The
+   * behavior is shared with the clones of this engine.
+   * @param category The category of the agents.
+   * @param level The level where the behavior steps them.
+   * @param behavior The behavior.
+   */
+  void
+  setCategoryBatchBehavior(const AgentCategory &category,
+                           const LevelIdentifier &level,
+                           std::shared_ptr<ICategoryBatchBehavior> behavior);
+
+  /**
+   * Gets the behavior stepping the agents of a category, if any.
+   */
+  std::shared_ptr<ICategoryBatchBehavior>
+  getCategoryBatchBehavior(const AgentCategory &category) const;
+
+  /**
+   * Sets when a probe observes the partly consistent states (see
+   * IObservationSchedule), or lets it observe every step again with
+   * nullptr. The schedule is kept by the identifier of the probe, whether
+   * it was added or not, and cloned with this engine.
+   * @param probeIdentifier The identifier of the probe.
+   * @param schedule The schedule.
+   */
+  void setObservationSchedule(const std::string &probeIdentifier,
+                              std::shared_ptr<IObservationSchedule> schedule);
+
+  /** Gets the schedule of a probe, if any. */
+  std::shared_ptr<IObservationSchedule>
+  getObservationSchedule(const std::string &probeIdentifier) const;
+
+  /**
+   * Counts the phases of the timed steps with the hardware counters of the
+   * thread running the simulation (see PerformanceCounters), in
+   * StepTimings::counters. The counters are only read when a step timing
+   * listener is set.
+   * @return false if the counters are not available on this machine.
+   */
+  bool setPerformanceCounting(bool enabled);
+
+  /** Tells whether the timed steps are counted. */
+  bool isPerformanceCounting() const { return performanceCounting; }
+
+  /**
+   * Gets the live and peak bytes of the subsystems accounted by
+   * MemoryAccounting: the agent states, the influences, the fields of the
+   * environment... The accounts cover the whole process: the simulations
+   * running alongside this one count in them too.
+   */
+  std::vector<libs::MemoryUsage> getMemoryUsage() const {
+    return libs::MemoryAccounting::snapshot();
+  }
+
   // ISimulationEngine implementation
   void addProbe(const std::string &identifier,
                 std::shared_ptr<IProbe> probe) override;
@@ -64,6 +180,11 @@ public:
   void
   runNewSimulation(std::shared_ptr<ISimulationModel> simulationModel) override;
   void runSimulation(const SimulationTimeStamp &finalTime) override;
+  void setStepTimingListener(
+      std::shared_ptr<IStepTimingListener> listener) override;
+  std::shared_ptr<IStepTimingListener> getStepTimingListener() const override;
+  void setStepBarrier(std::shared_ptr<engine::StepBarrier> barrier) override;
+  std::shared_ptr<engine::StepBarrier> getStepBarrier() const override;
 
   std::shared_ptr<dynamicstate::IPublicDynamicStateMap>
   getSimulationDynamicStates() const override;
@@ -0,0 +1,155 @@
+#ifndef STEPBARRIER_H
+#define STEPBARRIER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace engine {
+
+/**
+ * The point between two steps where a simulation engine waits to be let
+ * through, so that a view pauses, single-steps or paces a run.
+ *
+ * The engine calls awaitStep() before each step; the other threads control
+ * when it returns. Paused, the engine sleeps on a condition variable, and
+ * takes no processor time until it is resumed, stepped or aborted; paced,
+ * it sleeps until the time of its next step. The abortion of the
+ * simulation interrupts the waits, which then return at once.
+ *
+ * The paced steps follow a fixed timeline: a step released late does not
+ * delay the next ones, so that the lateness of the wake-ups does not
+ * accumulate into a drift, unless it exceeds a period, after which the
+ * timeline restarts rather than bursting to catch up. For a steadier
+ * timing, the last part of each wait may spin instead of sleeping, and an
+ * acceleration factor scales the rate, e.g. to run a real time model
+ * faster than the clock.
+ */
+class StepBarrier {
+public:
+  /** The timing of the paced steps since the rate was set. */
+  struct PacingStatistics {
+    std::uint64_t steps = 0;
+    /** The steps released over a period late, restarting the timeline. */
+    std::uint64_t resynchronizations = 0;
+    /** The delays between the times of the steps and their releases. */
+    double meanLatenessSeconds = 0.0;
+    double maxLatenessSeconds = 0.0;
+  };
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  mutable std::mutex mutex;
+  std::condition_variable changed;
+  bool paused = false;
+  // whether the engine waits, paused, for a step
+  bool parked = false;
+  std::size_t pendingSteps = 0;
+  double stepsPerSecond = 0.0;
+  double acceleration = 1.0;
+  // the period of the steps, accelerated
+  Clock::duration period{0};
+  Clock::duration spinThreshold{0};
+  Clock::time_point nextStep{};
+  // bumped by each change, for the waits to notice it
+  std::uint64_t generation = 0;
+  PacingStatistics statistics;
+  double totalLatenessSeconds = 0.0;
+
+  void notifyChange();
+  // restarts the timeline of the paced steps at the period of the rate
+  void updatePeriod();
+
+public:
+  /**
+   * Waits until the engine may run its next step.
+   * @param abortRequested The abortion flag of the engine: the wait ends as
+   * soon as it is set and interrupt() is called.
+   */
+  void awaitStep(const std::atomic<bool> &abortRequested);
+
+  /**
+   * Stops the engine at its next awaitStep().
+   */
+  void pause();
+
+  /**
+   * Lets the engine run freely again.
+   */
+  void resume();
+
+  /**
+   * Lets the engine run some steps, then pauses it.
+   * @param count The number of steps to run.
+   */
+  void step(std::size_t count = 1);
+
+  /**
+   * Paces the steps.
+   * @param stepsPerSecond The steps per second at most, 0 for no limit.
+   * @throws std::invalid_argument If stepsPerSecond is negative or NaN.
+   */
+  void setStepRate(double stepsPerSecond);
+
+  /**
+   * Gets the steps per second at most, 0 for no limit, before acceleration.
+   */
+  double getStepRate() const;
+
+  /**
+   * Scales the step rate, 2 running the paced steps twice as fast.
+   * @throws std::invalid_argument If the factor is not positive or finite.
+   */
+  void setAcceleration(double factor);
+
+  double getAcceleration() const;
+
+  /**
+   * Spins instead of sleeping during the last part of the wait of a paced
+   * step, which the wake-ups of the system may otherwise overshoot by tens
+   * of microseconds; the spin yields the processor between its checks of
+   * the clock.
+   * @param threshold The duration of the spin, 0 to sleep to the end.
+   * @throws std::invalid_argument If the threshold is negative.
+   */
+  void setSpinThreshold(std::chrono::nanoseconds threshold);
+
+  std::chrono::nanoseconds getSpinThreshold() const;
+
+  PacingStatistics getPacingStatistics() const;
+
+  bool isPaused() const;
+
+  /**
+   * Runs an action while the engine waits, paused, for its next step, e.g.
+   * to change the state of the simulation between two steps from another
+   * thread: the engine stays at the barrier until the action returns.
+   * @return false, without running the action, if the engine does not wait
+   * paused at the barrier.
+   */
+  bool whileParked(const std::function<void()> &action);
+
+  /**
+   * Wakes up the engine waiting, for it to check its abortion flag.
+   */
+  void interrupt();
+};
+
+} // namespace engine
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // STEPBARRIER_H
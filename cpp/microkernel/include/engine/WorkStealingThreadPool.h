@@ -0,0 +1,206 @@
+#ifndef WORKSTEALINGTHREADPOOL_H
+#define WORKSTEALINGTHREADPOOL_H
+
+#include "CpuTopology.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace engine {
+
+/**
+ * A long-lived pool of worker threads executing index ranges in parallel.
+ *
+ * The range submitted to parallelFor() is split into chunks which are
+ * distributed over per-worker deques. A worker pops chunks from the back of
+ * its own deque and, once it is empty, steals chunks from the front of the
+ * deques of the other workers. This balances workloads where the cost of
+ * processing an index varies a lot (e.g. predators vs. prey).
+ *
+ * The thread calling parallelFor() takes part in the computation as worker 0,
+ * so a pool of size N owns N - 1 threads. Calls to parallelFor() must not be
+ * nested nor made concurrently from several threads.
+ *
+ * An engine lends its idle pool to the code it runs on the calling thread,
+ * e.g. a reaction, by installing it with a Scope: that code then splits its
+ * own loops with parallelForOnCurrent().
+ *
+ * On a NUMA machine, setPlacement() pins the workers to CPUs and makes them
+ * steal from the workers of their node first; forEachWorker() lets each
+ * worker allocate and first touch the memory it uses, for the pages to be on
+ * its node.
+ */
+class WorkStealingThreadPool {
+public:
+  /**
+   * The function processing the indices in [begin, end). workerIndex is the
+   * index in [0, size()) of the worker running the range; a worker runs a
+   * single range at a time, so it can index per-worker scratch data.
+   */
+  using RangeFunction =
+      std::function<void(size_t begin, size_t end, size_t workerIndex)>;
+
+  /**
+   * Builds a pool and starts its worker threads.
+   * @param numThreads The number of threads taking part in parallelFor(),
+   * including the calling thread. A value of 0 is treated as 1.
+   */
+  explicit WorkStealingThreadPool(size_t numThreads);
+
+  /**
+   * Stops and joins the worker threads.
+   */
+  ~WorkStealingThreadPool();
+
+  WorkStealingThreadPool(const WorkStealingThreadPool &) = delete;
+  WorkStealingThreadPool &operator=(const WorkStealingThreadPool &) = delete;
+
+  /**
+   * Gets the number of threads taking part in parallelFor().
+   */
+  size_t size() const { return queues.size(); }
+
+  /**
+   * Processes the indices in [0, count) in parallel and blocks until all of
+   * them were processed.
+   * @param count The number of indices to process.
+   * @param chunkSize The number of consecutive indices handled by a chunk. A
+   * value of 0 selects a size producing several chunks per worker.
+   * @param body The function processing a range of indices.
+   * @throws The first exception thrown by body, once all the chunks were
+   * processed.
+   */
+  void parallelFor(size_t count, size_t chunkSize, const RangeFunction &body);
+
+  /**
+   * Processes the indices in [0, count) on the pool installed on the calling
+   * thread, or on the calling thread alone when no pool is installed. The
+   * body runs without an installed pool, so nested calls are sequential.
+   * @param count The number of indices to process.
+   * @param chunkSize The number of consecutive indices handled by a chunk (0
+   * = automatic).
+   * @param body The function processing a range of indices; workerIndex is 0
+   * when no pool is installed.
+   */
+  static void parallelForOnCurrent(size_t count, size_t chunkSize,
+                                   const RangeFunction &body);
+
+  /**
+   * Runs a function once on each worker, on the thread of the worker, and
+   * blocks until all of them returned.
+   * @param body The function, given the index of the worker.
+   * @throws The first exception thrown by body, once all the workers ran.
+   */
+  void forEachWorker(const std::function<void(size_t workerIndex)> &body);
+
+  /**
+   * Pins the threads of the workers to CPUs, and makes each worker steal
+   * from the workers of its node before the others. Worker 0 being the
+   * calling thread, its affinity is left as it is. This method must not be
+   * called during a parallelFor().
+   * @param placement The placement of each worker (see
+   * CpuTopology::placeWorkers()), or empty to let the threads run anywhere
+   * the process may and steal in the default order.
+   * @return false if the affinity of a thread could not be set, or if the
+   * platform does not support it.
+   * @throws std::invalid_argument If the placement is neither empty nor of
+   * one entry per worker.
+   */
+  bool setPlacement(const std::vector<CpuTopology::Placement> &placement);
+
+  /**
+   * Gets the number of threads of the pool installed on the calling thread,
+   * or 1 when no pool is installed.
+   */
+  static size_t currentSize() {
+    return currentSlot() != nullptr ? currentSlot()->size() : 1;
+  }
+
+  /**
+   * Makes a pool the one used by parallelForOnCurrent() on the calling thread
+   * for the lifetime of the scope. The pool must not be running another
+   * parallelFor() meanwhile.
+   */
+  class Scope {
+  private:
+    WorkStealingThreadPool *previous;
+
+  public:
+    explicit Scope(WorkStealingThreadPool *pool) : previous(currentSlot()) {
+      currentSlot() = pool;
+    }
+    ~Scope() { currentSlot() = previous; }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+  };
+
+private:
+  static WorkStealingThreadPool *&currentSlot() {
+    thread_local WorkStealingThreadPool *current = nullptr;
+    return current;
+  }
+
+  struct Range {
+    size_t begin;
+    size_t end;
+  };
+
+  struct WorkerQueue {
+    std::mutex mutex;
+    std::deque<Range> ranges;
+  };
+
+  std::vector<std::unique_ptr<WorkerQueue>> queues;
+  std::vector<std::thread> workers;
+
+  /** The workers each worker steals from, in order. */
+  std::vector<std::vector<size_t>> victims;
+
+  /** false while each worker runs its own chunk, see forEachWorker(). */
+  std::atomic<bool> stealing{true};
+
+  /** The body of the job being executed. */
+  const RangeFunction *currentBody = nullptr;
+
+  /** Number of chunks of the current job that are not processed yet. */
+  std::atomic<size_t> pendingChunks{0};
+
+  /** The first exception thrown by the body of the current job. */
+  std::exception_ptr firstError;
+  std::mutex errorMutex;
+
+  std::mutex wakeMutex;
+  std::condition_variable wakeCondition;
+  unsigned long long generation = 0;
+  bool stopping = false;
+
+  std::mutex doneMutex;
+  std::condition_variable doneCondition;
+
+  void runJob();
+  void buildVictims(const std::vector<CpuTopology::Placement> &placement);
+  void workerLoop(size_t workerIndex);
+  bool popOrSteal(size_t workerIndex, Range &range);
+  void runAvailableChunks(size_t workerIndex);
+};
+
+} // namespace engine
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // WORKSTEALINGTHREADPOOL_H
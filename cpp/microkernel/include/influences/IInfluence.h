@@ -3,6 +3,8 @@
 
 #include "../LevelIdentifier.h"
 #include "../SimulationTimeStamp.h"
+#include "InfluenceTypeTag.h"
+#include <cstddef>
 #include <string>
 
 namespace fr {
@@ -58,6 +60,14 @@ public:
    */
   virtual ::fr::univ_artois::lgi2a::similar::microkernel::SimulationTimeStamp
   getTimeUpperBound() const = 0;
+
+  /**
+   * Gets the compact integer identifying the concrete type of this influence,
+   * used by InfluenceDispatcher to select its handler.
+   * @return influenceTypeTag<T>() in the influence classes of type T, or
+   * NO_INFLUENCE_TYPE_TAG if the influence does not declare a type tag.
+   */
+  virtual ::std::size_t getTypeTag() const { return NO_INFLUENCE_TYPE_TAG; }
 };
 
 } // namespace influences
@@ -0,0 +1,207 @@
+#ifndef INFLUENCEARENA_H
+#define INFLUENCEARENA_H
+
+#include "../libs/MemoryAccounting.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace influences {
+
+/**
+ * A monotonic memory arena holding the influences produced during one step.
+ *
+ * Allocations bump a pointer inside large blocks; deallocations only count
+ * the released allocations. Engines call reset() once the influences of a
+ * step were consumed, which rewinds the arena if every allocation was
+ * released. Otherwise (e.g. a probe kept an influence alive) the reset is
+ * skipped and the arena keeps growing until everything is released, so an
+ * influence never outlives its storage.
+ *
+ * Only the thread owning the arena allocates from it, but influences may be
+ * released from any thread. Arenas are shared with the influences they hold,
+ * so that an influence kept after the engine was destroyed stays valid.
+ */
+class InfluenceArena : public std::enable_shared_from_this<InfluenceArena> {
+private:
+  static constexpr std::size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+  std::vector<std::unique_ptr<std::byte[]>> blocks;
+  std::vector<std::size_t> blockSizes;
+  std::size_t currentBlock = 0;
+  std::size_t offset = 0;
+  std::atomic<std::size_t> liveAllocations{0};
+
+  static InfluenceArena *&currentSlot() {
+    thread_local InfluenceArena *current = nullptr;
+    return current;
+  }
+
+  // The blocks count in the memory of the influences
+  static libs::MemoryAccount &memory() {
+    static libs::MemoryAccount &account =
+        libs::MemoryAccounting::account("influences");
+    return account;
+  }
+
+  void addBlock(std::size_t minimumSize) {
+    const std::size_t size = std::max(DEFAULT_BLOCK_SIZE, minimumSize);
+    blocks.push_back(std::make_unique<std::byte[]>(size));
+    blockSizes.push_back(size);
+    memory().allocated(size);
+  }
+
+public:
+  InfluenceArena() = default;
+
+  ~InfluenceArena() {
+    for (std::size_t size : blockSizes) {
+      memory().released(size);
+    }
+  }
+
+  InfluenceArena(const InfluenceArena &) = delete;
+  InfluenceArena &operator=(const InfluenceArena &) = delete;
+
+  /**
+   * Allocates storage from the arena.
+   */
+  void *allocate(std::size_t size, std::size_t alignment) {
+    while (true) {
+      if (currentBlock < blocks.size()) {
+        std::byte *base = blocks[currentBlock].get();
+        std::size_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+        if (aligned + size <= blockSizes[currentBlock]) {
+          offset = aligned + size;
+          liveAllocations.fetch_add(1, std::memory_order_relaxed);
+          return base + aligned;
+        }
+        if (currentBlock + 1 < blocks.size()) {
+          ++currentBlock;
+          offset = 0;
+          continue;
+        }
+      }
+      addBlock(size + alignment);
+      currentBlock = blocks.size() - 1;
+      offset = 0;
+    }
+  }
+
+  /**
+   * Releases storage allocated from the arena. The memory is reclaimed by the
+   * next successful reset().
+   */
+  void deallocate(void *) {
+    liveAllocations.fetch_sub(1, std::memory_order_acq_rel);
+  }
+
+  /**
+   * Gets the number of allocations that were not released yet.
+   */
+  std::size_t getLiveAllocations() const {
+    return liveAllocations.load(std::memory_order_acquire);
+  }
+
+  /**
+   * Rewinds the arena, keeping its blocks for the next step.
+   * @return false if some allocations are still alive, in which case the
+   * arena was left untouched.
+   */
+  bool reset() {
+    if (getLiveAllocations() != 0) {
+      return false;
+    }
+    currentBlock = 0;
+    offset = 0;
+    return true;
+  }
+
+  /**
+   * Gets the arena used by makeInfluence() on the calling thread, or nullptr.
+   */
+  static InfluenceArena *current() { return currentSlot(); }
+
+  /**
+   * Makes an arena the one used by makeInfluence() on the calling thread for
+   * the lifetime of the scope.
+   */
+  class Scope {
+  private:
+    InfluenceArena *previous;
+
+  public:
+    explicit Scope(InfluenceArena &arena) : previous(currentSlot()) {
+      currentSlot() = &arena;
+    }
+    ~Scope() { currentSlot() = previous; }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+  };
+};
+
+/**
+ * A standard allocator drawing its memory from an InfluenceArena.
+ */
+template <typename T> class InfluenceArenaAllocator {
+public:
+  using value_type = T;
+
+  std::shared_ptr<InfluenceArena> arena;
+
+  explicit InfluenceArenaAllocator(std::shared_ptr<InfluenceArena> arena)
+      : arena(std::move(arena)) {}
+
+  template <typename U>
+  InfluenceArenaAllocator(const InfluenceArenaAllocator<U> &other)
+      : arena(other.arena) {}
+
+  T *allocate(std::size_t n) {
+    return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T *pointer, std::size_t) { arena->deallocate(pointer); }
+
+  template <typename U>
+  bool operator==(const InfluenceArenaAllocator<U> &other) const {
+    return arena == other.arena;
+  }
+
+  template <typename U>
+  bool operator!=(const InfluenceArenaAllocator<U> &other) const {
+    return arena != other.arena;
+  }
+};
+
+/**
+ * Builds an influence, allocating it (and its reference count) from the
+ * arena installed on the calling thread by the engine, or from the heap when
+ * no arena is installed.
+ */
+template <typename T, typename... Args>
+std::shared_ptr<T> makeInfluence(Args &&...args) {
+  InfluenceArena *arena = InfluenceArena::current();
+  if (arena == nullptr) {
+    return std::make_shared<T>(std::forward<Args>(args)...);
+  }
+  return std::allocate_shared<T>(
+      InfluenceArenaAllocator<T>(arena->shared_from_this()),
+      std::forward<Args>(args)...);
+}
+
+} // namespace influences
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // INFLUENCEARENA_H
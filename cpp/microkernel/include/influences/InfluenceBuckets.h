@@ -0,0 +1,123 @@
+#ifndef INFLUENCEBUCKETS_H
+#define INFLUENCEBUCKETS_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "IInfluence.h"
+#include "InfluenceTypeTag.h"
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace influences {
+
+/**
+ * A collection of influences grouped by type tag.
+ *
+ * Reaction models fill the buckets once, then process each influence type in
+ * turn as a homogeneous batch. The influences of a bucket keep their relative
+ * order. Clearing the buckets keeps their storage, so that a collection
+ * reused at every step stops allocating.
+ */
+class InfluenceBuckets {
+private:
+  std::vector<std::vector<std::shared_ptr<IInfluence>>> buckets;
+  std::size_t count = 0;
+
+public:
+  InfluenceBuckets() = default;
+
+  /**
+   * Builds buckets containing a range of influences. Null influences are
+   * ignored.
+   */
+  template <typename Range> explicit InfluenceBuckets(const Range &influences) {
+    addAll(influences);
+  }
+
+  /**
+   * Adds an influence to the bucket of its type tag.
+   */
+  void add(const std::shared_ptr<IInfluence> &influence) {
+    if (!influence) {
+      return;
+    }
+    const std::size_t tag = influence->getTypeTag();
+    if (tag >= buckets.size()) {
+      buckets.resize(tag + 1);
+    }
+    buckets[tag].push_back(influence);
+    ++count;
+  }
+
+  /**
+   * Adds a range of influences. Null influences are ignored.
+   */
+  template <typename Range> void addAll(const Range &influences) {
+    for (const auto &influence : influences) {
+      add(influence);
+    }
+  }
+
+  /**
+   * Gets the influences having a specific type tag.
+   */
+  const std::vector<std::shared_ptr<IInfluence>> &
+  getBucket(std::size_t tag) const {
+    static const std::vector<std::shared_ptr<IInfluence>> empty;
+    return tag < buckets.size() ? buckets[tag] : empty;
+  }
+
+  /**
+   * Gets the influences of type T.
+   */
+  template <typename T>
+  const std::vector<std::shared_ptr<IInfluence>> &getBucket() const {
+    return getBucket(influenceTypeTag<T>());
+  }
+
+  /**
+   * Gets the influences which do not declare a type tag.
+   */
+  const std::vector<std::shared_ptr<IInfluence>> &getUntagged() const {
+    return getBucket(NO_INFLUENCE_TYPE_TAG);
+  }
+
+  /**
+   * Calls consumer(T &) on every influence of type T, in insertion order.
+   */
+  template <typename T, typename Consumer>
+  void forEach(Consumer &&consumer) const {
+    for (const auto &influence : getBucket<T>()) {
+      consumer(static_cast<T &>(*influence));
+    }
+  }
+
+  /**
+   * Gets the total number of influences in the buckets.
+   */
+  std::size_t size() const { return count; }
+
+  /**
+   * Removes all the influences while keeping the allocated storage.
+   */
+  void clear() {
+    for (auto &bucket : buckets) {
+      bucket.clear();
+    }
+    count = 0;
+  }
+};
+
+} // namespace influences
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // INFLUENCEBUCKETS_H
@@ -0,0 +1,91 @@
+#ifndef INFLUENCEBUFFER_H
+#define INFLUENCEBUFFER_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "IInfluence.h"
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace influences {
+
+/**
+ * An append-only collection of influences, ordered using the dense index of
+ * their target level.
+ *
+ * Engines give one buffer to each of their worker threads, so that influences
+ * can be collected without synchronization. Clearing a buffer keeps its
+ * storage, so that a buffer reused at every step stops allocating once it
+ * reached its steady-state size.
+ */
+class InfluenceBuffer {
+private:
+  std::vector<std::vector<std::shared_ptr<IInfluence>>> influencesByLevel;
+
+public:
+  InfluenceBuffer() = default;
+
+  explicit InfluenceBuffer(size_t levelCount)
+      : influencesByLevel(levelCount) {}
+
+  /**
+   * Sets the number of levels indexed by this buffer.
+   */
+  void setLevelCount(size_t levelCount) {
+    influencesByLevel.resize(levelCount);
+  }
+
+  /**
+   * Gets the number of levels indexed by this buffer.
+   */
+  size_t getLevelCount() const { return influencesByLevel.size(); }
+
+  /**
+   * Adds an influence targeted at the level having a specific index.
+   */
+  void append(size_t levelIndex, std::shared_ptr<IInfluence> influence) {
+    influencesByLevel[levelIndex].push_back(std::move(influence));
+  }
+
+  /**
+   * Gets the influences targeted at the level having a specific index.
+   */
+  const std::vector<std::shared_ptr<IInfluence>> &
+  getInfluences(size_t levelIndex) const {
+    return influencesByLevel[levelIndex];
+  }
+
+  /**
+   * Gets the number of influences stored in this buffer.
+   */
+  size_t size() const {
+    size_t total = 0;
+    for (const auto &influences : influencesByLevel) {
+      total += influences.size();
+    }
+    return total;
+  }
+
+  /**
+   * Removes all the influences while keeping the allocated storage.
+   */
+  void clear() {
+    for (auto &influences : influencesByLevel) {
+      influences.clear();
+    }
+  }
+};
+
+} // namespace influences
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // INFLUENCEBUFFER_H
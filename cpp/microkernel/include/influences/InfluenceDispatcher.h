@@ -0,0 +1,136 @@
+#ifndef INFLUENCEDISPATCHER_H
+#define INFLUENCEDISPATCHER_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "IInfluence.h"
+#include "InfluenceBuckets.h"
+#include "InfluenceTypeTag.h"
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace influences {
+
+/**
+ * A table mapping the type tag of influences to their handler.
+ *
+ * Reaction models register one handler per influence type, then dispatch
+ * each influence with a single indexed lookup instead of trying a chain of
+ * dynamic casts. An influence type inheriting the tag of its parent class is
+ * handled as its parent.
+ *
+ * The dispatcher can also process InfluenceBuckets batch by batch, following
+ * the registration order of the handlers: all the influences of the first
+ * registered type are handled in a tight loop, then those of the second type,
+ * and so on.
+ *
+ * @tparam Args The additional arguments given to the handlers.
+ */
+template <typename... Args> class InfluenceDispatcher {
+private:
+  using Batch = std::vector<std::shared_ptr<IInfluence>>;
+
+  std::vector<std::function<void(IInfluence &, Args...)>> handlers;
+  std::vector<std::function<void(const Batch &, Args...)>> batchHandlers;
+  std::vector<std::size_t> order;
+
+public:
+  /**
+   * Registers the handler of an influence type, replacing any previous one.
+   * @tparam T The influence type, overriding IInfluence::getTypeTag() with
+   * influenceTypeTag<T>().
+   * @param handler A function called with a T &, then the arguments given to
+   * dispatch().
+   */
+  template <typename T, typename Handler> void on(Handler handler) {
+    const std::size_t tag = influenceTypeTag<T>();
+    if (tag >= handlers.size()) {
+      handlers.resize(tag + 1);
+      batchHandlers.resize(tag + 1);
+    }
+    if (!handlers[tag] && !batchHandlers[tag]) {
+      order.push_back(tag);
+    }
+    handlers[tag] = [handler](IInfluence &influence, Args... args) {
+      handler(static_cast<T &>(influence), args...);
+    };
+    batchHandlers[tag] = [handler](const Batch &batch, Args... args) {
+      for (const auto &influence : batch) {
+        handler(static_cast<T &>(*influence), args...);
+      }
+    };
+  }
+
+  /**
+   * Registers the handler of the whole batch of an influence type in
+   * dispatchBatches(), e.g. to process its influences in parallel. It
+   * replaces the loop over the handler given to on(), which dispatch() keeps
+   * calling; a later call to on() restores the loop.
+   * @tparam T The influence type of the batch.
+   * @param handler A function called with the batch, made of T influences,
+   * then the arguments given to dispatchBatches().
+   */
+  template <typename T, typename Handler> void onBatch(Handler handler) {
+    const std::size_t tag = influenceTypeTag<T>();
+    if (tag >= handlers.size()) {
+      handlers.resize(tag + 1);
+      batchHandlers.resize(tag + 1);
+    }
+    if (!handlers[tag] && !batchHandlers[tag]) {
+      order.push_back(tag);
+    }
+    batchHandlers[tag] = [handler](const Batch &batch, Args... args) {
+      handler(batch, args...);
+    };
+  }
+
+  /**
+   * Tells whether a handler was registered for an influence type.
+   */
+  bool handles(const IInfluence &influence) const {
+    const std::size_t tag = influence.getTypeTag();
+    return tag < handlers.size() && handlers[tag];
+  }
+
+  /**
+   * Calls the handler registered for the type of an influence.
+   * @return false if no handler was registered for this type.
+   */
+  bool dispatch(IInfluence &influence, Args... args) const {
+    const std::size_t tag = influence.getTypeTag();
+    if (tag >= handlers.size() || !handlers[tag]) {
+      return false;
+    }
+    handlers[tag](influence, args...);
+    return true;
+  }
+
+  /**
+   * Handles the influences of the buckets type by type, in the registration
+   * order of the handlers. The influences of the types without handler are
+   * left to the caller.
+   */
+  void dispatchBatches(const InfluenceBuckets &buckets, Args... args) const {
+    for (std::size_t tag : order) {
+      const Batch &batch = buckets.getBucket(tag);
+      if (!batch.empty()) {
+        batchHandlers[tag](batch, args...);
+      }
+    }
+  }
+};
+
+} // namespace influences
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // INFLUENCEDISPATCHER_H
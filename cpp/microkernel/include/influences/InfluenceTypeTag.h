@@ -0,0 +1,43 @@
+#ifndef INFLUENCETYPETAG_H
+#define INFLUENCETYPETAG_H
+
+#include <atomic>
+#include <cstddef>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace influences {
+
+/**
+ * The type tag of the influences which do not declare one.
+ */
+constexpr std::size_t NO_INFLUENCE_TYPE_TAG = 0;
+
+namespace detail {
+inline std::atomic<std::size_t> &nextInfluenceTypeTag() {
+  static std::atomic<std::size_t> next{NO_INFLUENCE_TYPE_TAG + 1};
+  return next;
+}
+} // namespace detail
+
+/**
+ * Gets the compact integer tag identifying an influence type. Tags are
+ * allocated on first use and are dense, so that they can index a dispatch
+ * table.
+ */
+template <typename T> std::size_t influenceTypeTag() {
+  static const std::size_t tag = detail::nextInfluenceTypeTag()++;
+  return tag;
+}
+
+} // namespace influences
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // INFLUENCETYPETAG_H
@@ -3,12 +3,13 @@
 
 #include <algorithm>
 #include <list>
-#include <map>
 #include <memory>
 #include <set>
 #include <vector>
 
 #include "../LevelIdentifier.h"
+#include "../LevelIndexedMap.h"
+#include "../libs/MemoryAccounting.h"
 #include "IInfluence.h"
 
 namespace fr {
@@ -24,7 +25,16 @@ namespace influences {
  */
 class InfluencesMap {
 private:
-  std::map<LevelIdentifier, std::list<std::shared_ptr<IInfluence>>> influences;
+  /** The account of the memory of the lists of influences */
+  struct Memory {
+    static const char *name() { return "influences"; }
+  };
+
+  using InfluenceList =
+      std::vector<std::shared_ptr<IInfluence>,
+                  libs::TrackedAllocator<std::shared_ptr<IInfluence>, Memory>>;
+
+  LevelIndexedMap<InfluenceList> influences;
 
 public:
   InfluencesMap() = default;
@@ -34,34 +44,39 @@ public:
    * influences map.
    */
   std::set<LevelIdentifier> getDefinedKeys() const {
-    std::set<LevelIdentifier> keys;
-    for (const auto &pair : influences) {
-      keys.insert(pair.first);
-    }
-    return keys;
+    return influences.keySet();
   }
 
   /**
    * Tells whether if this map contains at least one influence or not.
    */
   bool isEmpty() const {
-    for (const auto &pair : influences) {
-      if (!pair.second.empty()) {
-        return false;
-      }
-    }
-    return true;
+    bool empty = true;
+    influences.forEach(
+        [&](const LevelIdentifier &, const InfluenceList &levelInfluences) {
+          empty = empty && levelInfluences.empty();
+        });
+    return empty;
+  }
+
+  /**
+   * Gets the number of influences in this map, all levels together.
+   */
+  std::size_t size() const {
+    std::size_t count = 0;
+    influences.forEach(
+        [&](const LevelIdentifier &, const InfluenceList &levelInfluences) {
+          count += levelInfluences.size();
+        });
+    return count;
   }
 
   /**
    * Check if this map contains no influences targeted at a specific level.
    */
   bool isEmpty(const LevelIdentifier &targetLevel) const {
-    auto it = influences.find(targetLevel);
-    if (it == influences.end()) {
-      return true;
-    }
-    return it->second.empty();
+    const auto *levelInfluences = influences.find(targetLevel);
+    return levelInfluences == nullptr || levelInfluences->empty();
   }
 
   /**
@@ -70,7 +85,9 @@ public:
    */
   std::list<std::shared_ptr<IInfluence>>
   getInfluencesForLevel(const LevelIdentifier &targetLevel) {
-    return influences[targetLevel];
+    const auto &levelInfluences = influences[targetLevel];
+    return std::list<std::shared_ptr<IInfluence>>(levelInfluences.begin(),
+                                                  levelInfluences.end());
   }
 
   /**
@@ -88,13 +105,30 @@ public:
    * map.
    */
   void addAll(const InfluencesMap &toAdd) {
-    for (const auto &pair : toAdd.influences) {
-      std::list<std::shared_ptr<IInfluence>> &my_list = influences[pair.first];
-      my_list.insert(my_list.end(), pair.second.begin(), pair.second.end());
-    }
+    toAdd.influences.forEach(
+        [this](const LevelIdentifier &level, const InfluenceList &added) {
+          InfluenceList &my_list = influences[level];
+          my_list.insert(my_list.end(), added.begin(), added.end());
+        });
   }
 
   void clear() { influences.clear(); }
+
+  /**
+   * Hands every influence of this map to a consumer, then removes them while
+   * keeping the allocated storage, so that a map reused across decisions
+   * stops allocating after a few steps.
+   * @param consumer A function called with the target level and the influence.
+   */
+  template <typename Consumer> void drain(Consumer &&consumer) {
+    influences.forEach(
+        [&](const LevelIdentifier &level, InfluenceList &levelInfluences) {
+          for (auto &influence : levelInfluences) {
+            consumer(level, std::move(influence));
+          }
+          levelInfluences.clear();
+        });
+  }
 };
 
 } // namespace influences
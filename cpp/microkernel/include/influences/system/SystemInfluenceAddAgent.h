@@ -55,6 +55,10 @@ public:
     return this->agent;
   }
 
+  ::std::size_t getTypeTag() const override {
+    return influenceTypeTag<SystemInfluenceAddAgent>();
+  }
+
   // toString not strictly needed as C++ doesn't have a universal toString, but
   // we can add it if needed. For now, skipping toString override unless
   // specifically requested or useful for debugging.
@@ -84,6 +84,10 @@ public:
   getPrivateLocalState() const {
     return this->privateLocalState;
   }
+
+  ::std::size_t getTypeTag() const override {
+    return influenceTypeTag<SystemInfluenceAddAgentToLevel>();
+  }
 };
 
 } // namespace system
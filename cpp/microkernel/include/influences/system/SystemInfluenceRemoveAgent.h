@@ -51,6 +51,10 @@ public:
   std::shared_ptr<agents::IAgent4Engine> getAgent() const {
     return this->agent;
   }
+
+  ::std::size_t getTypeTag() const override {
+    return influenceTypeTag<SystemInfluenceRemoveAgent>();
+  }
 };
 
 } // namespace system
@@ -68,6 +68,10 @@ public:
   getAgentLocalState() const {
     return this->agent;
   }
+
+  ::std::size_t getTypeTag() const override {
+    return influenceTypeTag<SystemInfluenceRemoveAgentFromLevel>();
+  }
 };
 
 } // namespace system
@@ -58,6 +58,28 @@ public:
   virtual std::shared_ptr<dynamicstate::TransitoryPublicLocalDynamicState>
   getLastTransitoryState() const = 0;
 
+  /**
+   * Rebuilds the indexes the level keeps of its consistent state, e.g. its
+   * spatial index; called by the engines once the initial agents of the
+   * level are added. Does nothing by default.
+   */
+  virtual void updateSpatialIndex() {}
+
+  /**
+   * Computes ahead the natural dynamics of the level which only read its
+   * consistent state, e.g. the diffusion of its fields, into buffers of its
+   * own, for the next makeRegularReaction() of the same period to use them.
+   * Called by the engines overlapping them with the decisions of the agents
+   * (see engine::MultiThreadedSimulationEngine::setNaturalOverlap), on a
+   * thread of its own while the agents read the consistent state. Does
+   * nothing by default.
+   * @param transitoryTimeMin The lower bound of the next transitory period.
+   * @param transitoryTimeMax The upper bound of the next transitory period.
+   */
+  virtual void prepareNaturalDynamics(
+      const SimulationTimeStamp & /*transitoryTimeMin*/,
+      const SimulationTimeStamp & /*transitoryTimeMax*/) {}
+
   /**
    * Performs a user-defined reaction to the regular influences.
    * @param transitoryTimeMin The lower bound of the transitory period.
@@ -34,6 +34,18 @@ private:
     return "The '" + argName + "' argument cannot be null.";
   }
 
+protected:
+  /**
+   * Gets the data lastly perceived in a level, reset for a new perception
+   * to refill them in place (see IPerceivedData::reset()).
+   * @return The data, or nullptr if the agent did not perceive in the level,
+   * if other objects still hold the data or if they cannot be reused.
+   */
+  std::shared_ptr<agents::IPerceivedData>
+  recyclePerceivedData(const LevelIdentifier &levelIdentifier,
+                       const SimulationTimeStamp &timeLowerBound,
+                       const SimulationTimeStamp &timeUpperBound);
+
 public:
   explicit AbstractAgent(const AgentCategory &category);
   virtual ~AbstractAgent() = default;
@@ -66,6 +78,23 @@ public:
   getPerceivedData() const override;
   void setPerceivedData(
       std::shared_ptr<agents::IPerceivedData> perceivedData) override;
+
+  const std::shared_ptr<agents::IGlobalState> &
+  borrowGlobalState() const override {
+    return globalState;
+  }
+  const std::map<LevelIdentifier, std::shared_ptr<agents::ILocalStateOfAgent>>
+      &borrowPublicLocalStates() const override {
+    return publicLocalStates;
+  }
+  const std::shared_ptr<agents::ILocalStateOfAgent> &
+  borrowPublicLocalState(const LevelIdentifier &levelId) const override;
+  const std::shared_ptr<agents::ILocalStateOfAgent> &
+  borrowPrivateLocalState(const LevelIdentifier &levelId) const override;
+  const std::map<LevelIdentifier, std::shared_ptr<agents::IPerceivedData>>
+      &borrowPerceivedData() const override {
+    return lastPerceivedData;
+  }
 };
 
 } // namespace libs
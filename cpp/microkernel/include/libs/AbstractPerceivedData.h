@@ -2,6 +2,8 @@
 #define ABSTRACTPERCEIVEDDATA_H
 
 #include "../agents/IPerceivedData.h"
+#include <functional>
+#include <utility>
 
 namespace fr {
 namespace univ_artois {
@@ -29,6 +31,66 @@ public:
   LevelIdentifier getLevel() const override;
   SimulationTimeStamp getTransitoryPeriodMin() const override;
   SimulationTimeStamp getTransitoryPeriodMax() const override;
+
+  /**
+   * A field of perceived data computed on demand: the perception model
+   * defers it to a source, called from the first read only, whose result is
+   * then kept with the data. The decision models reading one field of the
+   * data thus do not pay for the others. A source reads the consistent state
+   * of the step, which stays the same until the data are discarded; the
+   * reads are not synchronized, a perceived data belonging to one decision.
+   * @tparam T The type of the value of the field.
+   */
+  template <typename T> class Lazy {
+  public:
+    using Source = std::function<void(T &)>;
+
+    Lazy() = default;
+    explicit Lazy(T value) : value(std::move(value)) {}
+
+    /** Sets the value of the field, dropping its pending source if any. */
+    void set(T newValue) {
+      value = std::move(newValue);
+      source = nullptr;
+    }
+
+    /**
+     * Defers the value of the field to a source, called with the value to
+     * fill on the first read.
+     */
+    void defer(Source newSource) { source = std::move(newSource); }
+
+    /** Gets the value of the field, computed first if it was deferred. */
+    const T &get() const {
+      if (source) {
+        // the source is dropped first, in case it reads the field again
+        Source pending = std::move(source);
+        source = nullptr;
+        pending(value);
+      }
+      return value;
+    }
+
+    /** Gets the value of the field to modify, computed first if deferred. */
+    T &mutate() {
+      get();
+      return value;
+    }
+
+    /** Whether the value was computed or set, rather than still deferred. */
+    bool isComputed() const { return !source; }
+
+  private:
+    mutable T value{};
+    mutable Source source;
+  };
+
+protected:
+  /**
+   * Sets the transitory period of these data, when they are reset.
+   */
+  void setTransitoryPeriod(const SimulationTimeStamp &transitoryPeriodMin,
+                           const SimulationTimeStamp &transitoryPeriodMax);
 };
 
 } // namespace libs
@@ -0,0 +1,114 @@
+#ifndef CALLBACKPROFILER_H
+#define CALLBACKPROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace libs {
+
+/** The time spent in a callback into a scripting language. */
+struct CallbackProfile {
+  using Duration = std::chrono::nanoseconds;
+
+  /** The name of the callback, e.g. the class of the agents and its method */
+  std::string callback;
+  std::uint64_t calls = 0;
+  /** The time of the calls, from the call to the return */
+  Duration total{0};
+  /** The part of total spent waiting for the lock of the interpreter */
+  Duration lockWait{0};
+  /** The part of total spent converting the arguments and the results */
+  Duration conversion{0};
+};
+
+/**
+ * The counts of the calls to a callback, updated from any thread with
+ * relaxed atomic operations.
+ */
+class CallbackAccount {
+public:
+  explicit CallbackAccount(std::string callback)
+      : callback(std::move(callback)) {}
+
+  CallbackAccount(const CallbackAccount &) = delete;
+  CallbackAccount &operator=(const CallbackAccount &) = delete;
+
+  const std::string &getCallback() const { return callback; }
+
+  /** Counts a call. */
+  void called(CallbackProfile::Duration total,
+              CallbackProfile::Duration lockWait,
+              CallbackProfile::Duration conversion) {
+    calls.fetch_add(1, std::memory_order_relaxed);
+    totalNanos.fetch_add(total.count(), std::memory_order_relaxed);
+    lockWaitNanos.fetch_add(lockWait.count(), std::memory_order_relaxed);
+    conversionNanos.fetch_add(conversion.count(), std::memory_order_relaxed);
+  }
+
+  void reset();
+
+  CallbackProfile getProfile() const;
+
+private:
+  std::string callback;
+  std::atomic<std::uint64_t> calls{0};
+  std::atomic<CallbackProfile::Duration::rep> totalNanos{0};
+  std::atomic<CallbackProfile::Duration::rep> lockWaitNanos{0};
+  std::atomic<CallbackProfile::Duration::rep> conversionNanos{0};
+};
+
+/**
+ * The profiles of the callbacks of the models into a scripting language,
+ * e.g. the decisions of the agents written in Python, so that the slowest
+ * behaviors can be found and written natively first.
+ *
+ * The bindings calling a script time its calls in the account of its name
+ * while the profiling is enabled; it is disabled by default, and then only
+ * costs the test of a flag per call. The accounts cover the whole process.
+ */
+class CallbackProfiler {
+public:
+  /**
+   * Gets the account of a callback, created on the first call. The account
+   * lives as long as the process.
+   */
+  static CallbackAccount &account(const std::string &callback);
+
+  /** Gets the profile of every callback, in the order of their creation. */
+  static std::vector<CallbackProfile> snapshot();
+
+  /** Starts the counts of every account again from zero. */
+  static void reset();
+
+  static void setEnabled(bool enabled) {
+    enabledFlag().store(enabled, std::memory_order_relaxed);
+  }
+
+  static bool isEnabled() {
+    return enabledFlag().load(std::memory_order_relaxed);
+  }
+
+private:
+  static std::atomic<bool> &enabledFlag() {
+    static std::atomic<bool> enabled{false};
+    return enabled;
+  }
+};
+
+} // namespace libs
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // CALLBACKPROFILER_H
@@ -0,0 +1,173 @@
+#ifndef EXECUTIONTRACER_H
+#define EXECUTIONTRACER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace libs {
+
+/**
+ * Records what each thread does and when, for the timeline views of the
+ * Chrome trace viewer and of Perfetto.
+ *
+ * The engines and the models mark their work with SIMILAR_TRACE_SCOPE; each
+ * scope is an event of the thread it runs on, from its construction to its
+ * destruction. The events of a thread go to a ring buffer of its own, the
+ * oldest being overwritten, so that recording neither contends with the
+ * other threads nor allocates. While the tracer is disabled, the default, a
+ * scope costs a relaxed atomic load; building with SIMILAR_NO_TRACING
+ * removes the scopes altogether.
+ *
+ * The categories and names of the events are not copied: they have to be
+ * string literals, or outlive the tracer.
+ */
+class ExecutionTracer {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /** An event of a thread. */
+  struct Event {
+    const char *category = nullptr;
+    const char *name = nullptr;
+    /** Nanoseconds from the epoch of the tracer */
+    std::int64_t start = 0;
+    std::int64_t duration = 0;
+    /** The index of the thread, in the order the threads first recorded */
+    std::uint32_t thread = 0;
+  };
+
+  /**
+   * Gets the tracer of the process.
+   */
+  static ExecutionTracer &global();
+
+  /**
+   * Starts or stops recording the events.
+   */
+  void setEnabled(bool enable) { enabled.store(enable); }
+
+  bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+  /**
+   * Sets the number of events kept by thread, for the threads that did not
+   * record yet and the ones after clear().
+   * @throws std::invalid_argument If the capacity is 0.
+   */
+  void setCapacity(std::size_t eventsPerThread);
+
+  std::size_t getCapacity() const;
+
+  /**
+   * Records an event of the calling thread, even if the tracer is disabled.
+   */
+  void record(const char *category, const char *name, Clock::time_point start,
+              Clock::time_point end);
+
+  /**
+   * Gets the events still in the buffers, by start time.
+   */
+  std::vector<Event> getEvents() const;
+
+  /**
+   * Forgets the events, and restarts the epoch. The threads keep their
+   * indices.
+   */
+  void clear();
+
+  /**
+   * Writes the events in the JSON trace format of Chrome, which Perfetto
+   * opens too: one complete event by scope, and the names of the threads.
+   */
+  void writeChromeTrace(std::ostream &out) const;
+
+  /**
+   * Writes the events in a file, in the JSON trace format of Chrome.
+   * @throws std::runtime_error If the file cannot be written.
+   */
+  void writeChromeTrace(const std::string &path) const;
+
+private:
+  struct ThreadBuffer {
+    std::mutex mutex; ///< Only contended while the events are read
+    std::vector<Event> ring;
+    std::size_t next = 0;
+    bool full = false;
+    std::uint32_t thread = 0;
+  };
+
+  std::atomic<bool> enabled{false};
+  std::atomic<std::int64_t> epoch;
+  mutable std::mutex buffersMutex;
+  std::size_t capacity = 1 << 16;
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+
+  ExecutionTracer();
+
+  ThreadBuffer &bufferOfThisThread();
+};
+
+/**
+ * Records the lifetime of a scope as an event, if the tracer is enabled
+ * when it starts.
+ */
+class TraceScope {
+private:
+  const char *category;
+  const char *name;
+  ExecutionTracer::Clock::time_point start;
+  bool active;
+
+public:
+  TraceScope(const char *category, const char *name)
+      : category(category), name(name),
+        active(ExecutionTracer::global().isEnabled()) {
+    if (active) {
+      start = ExecutionTracer::Clock::now();
+    }
+  }
+
+  ~TraceScope() {
+    if (active) {
+      ExecutionTracer::global().record(category, name, start,
+                                       ExecutionTracer::Clock::now());
+    }
+  }
+
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+};
+
+} // namespace libs
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#define SIMILAR_TRACE_CONCAT_(a, b) a##b
+#define SIMILAR_TRACE_CONCAT(a, b) SIMILAR_TRACE_CONCAT_(a, b)
+
+/**
+ * Traces the rest of the enclosing block as an event of the calling thread.
+ */
+#ifdef SIMILAR_NO_TRACING
+#define SIMILAR_TRACE_SCOPE(category, name) ((void)0)
+#else
+#define SIMILAR_TRACE_SCOPE(category, name)                                    \
+  ::fr::univ_artois::lgi2a::similar::microkernel::libs::TraceScope             \
+  SIMILAR_TRACE_CONCAT(similarTraceScope, __LINE__)(category, name)
+#endif
+
+#endif // EXECUTIONTRACER_H
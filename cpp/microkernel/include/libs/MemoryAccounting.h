@@ -0,0 +1,171 @@
+#ifndef MEMORYACCOUNTING_H
+#define MEMORYACCOUNTING_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace libs {
+
+/** The memory used by a subsystem. */
+struct MemoryUsage {
+  std::string subsystem;
+  /** The bytes allocated and not released yet */
+  std::size_t liveBytes = 0;
+  /** The most live bytes since the start, or since the last resetPeaks() */
+  std::size_t peakBytes = 0;
+  /** The allocations not released yet */
+  std::size_t allocations = 0;
+};
+
+/**
+ * The counts of the memory allocated by a subsystem, updated from any thread
+ * with relaxed atomic operations.
+ */
+class MemoryAccount {
+public:
+  explicit MemoryAccount(std::string subsystem)
+      : subsystem(std::move(subsystem)) {}
+
+  MemoryAccount(const MemoryAccount &) = delete;
+  MemoryAccount &operator=(const MemoryAccount &) = delete;
+
+  const std::string &getSubsystem() const { return subsystem; }
+
+  /** Counts an allocation of a number of bytes. */
+  void allocated(std::size_t bytes) {
+    const std::size_t now =
+        live.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    std::size_t highest = peak.load(std::memory_order_relaxed);
+    while (now > highest &&
+           !peak.compare_exchange_weak(highest, now,
+                                       std::memory_order_relaxed)) {
+    }
+  }
+
+  /** Counts the release of an allocation of a number of bytes. */
+  void released(std::size_t bytes) {
+    live.fetch_sub(bytes, std::memory_order_relaxed);
+    allocations.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  /** Starts the peak again from the live bytes. */
+  void resetPeak() {
+    peak.store(live.load(std::memory_order_relaxed),
+               std::memory_order_relaxed);
+  }
+
+  MemoryUsage getUsage() const;
+
+private:
+  std::string subsystem;
+  std::atomic<std::size_t> live{0};
+  std::atomic<std::size_t> peak{0};
+  std::atomic<std::size_t> allocations{0};
+};
+
+/**
+ * The accounts of the memory of the subsystems of the process, e.g. the
+ * agent states, the influences, the pheromone fields or the vehicles.
+ *
+ * The containers of a subsystem count their memory with a TrackedAllocator
+ * naming its account; the accounts cover the whole process, whatever the
+ * engine or the simulation the containers belong to.
+ */
+class MemoryAccounting {
+public:
+  /**
+   * Gets the account of a subsystem, created on the first call. The account
+   * lives as long as the process.
+   */
+  static MemoryAccount &account(const std::string &subsystem);
+
+  /**
+   * Gets the usage of every subsystem, in the order of their creation.
+   */
+  static std::vector<MemoryUsage> snapshot();
+
+  /**
+   * Gets the usage of a subsystem, zeros if nothing accounted for it yet.
+   */
+  static MemoryUsage usage(const std::string &subsystem);
+
+  /** Starts the peak of every account again from its live bytes. */
+  static void resetPeaks();
+};
+
+/**
+ * A standard allocator counting its memory in the account of a subsystem,
+ * the allocations themselves being made by a base allocator.
+ * @tparam Tag A type whose static name() names the subsystem.
+ * @tparam Base The allocator of the memory, e.g. one aligning it.
+ */
+template <typename T, typename Tag, typename Base = std::allocator<T>>
+class TrackedAllocator {
+private:
+  using Traits = std::allocator_traits<Base>;
+
+  Base base;
+
+public:
+  using value_type = T;
+  using is_always_equal = typename Traits::is_always_equal;
+
+  template <typename U> struct rebind {
+    using other =
+        TrackedAllocator<U, Tag, typename Traits::template rebind_alloc<U>>;
+  };
+
+  TrackedAllocator() noexcept = default;
+
+  template <typename U, typename OtherBase>
+  TrackedAllocator(const TrackedAllocator<U, Tag, OtherBase> &other) noexcept
+      : base(other.getBase()) {}
+
+  const Base &getBase() const noexcept { return base; }
+
+  T *allocate(std::size_t count) {
+    T *pointer = Traits::allocate(base, count);
+    account().allocated(count * sizeof(T));
+    return pointer;
+  }
+
+  void deallocate(T *pointer, std::size_t count) noexcept {
+    account().released(count * sizeof(T));
+    Traits::deallocate(base, pointer, count);
+  }
+
+  /** Gets the account of the subsystem of the allocator. */
+  static MemoryAccount &account() {
+    static MemoryAccount &tagged = MemoryAccounting::account(Tag::name());
+    return tagged;
+  }
+
+  template <typename U, typename OtherBase>
+  bool operator==(const TrackedAllocator<U, Tag, OtherBase> &other) const {
+    return base == other.getBase();
+  }
+
+  template <typename U, typename OtherBase>
+  bool operator!=(const TrackedAllocator<U, Tag, OtherBase> &other) const {
+    return !(*this == other);
+  }
+};
+
+} // namespace libs
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // MEMORYACCOUNTING_H
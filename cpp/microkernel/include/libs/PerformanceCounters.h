@@ -0,0 +1,111 @@
+#ifndef PERFORMANCECOUNTERS_H
+#define PERFORMANCECOUNTERS_H
+
+#include <cstdint>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace libs {
+
+/**
+ * The values of the hardware counters of a thread, or their differences
+ * over a phase.
+ */
+struct CounterValues {
+  std::uint64_t cycles = 0;
+  std::uint64_t instructions = 0;
+  /** Misses of the last level cache */
+  std::uint64_t cacheMisses = 0;
+  std::uint64_t branchMisses = 0;
+
+  CounterValues &operator+=(const CounterValues &other) {
+    cycles += other.cycles;
+    instructions += other.instructions;
+    cacheMisses += other.cacheMisses;
+    branchMisses += other.branchMisses;
+    return *this;
+  }
+
+  /** Gets the values counted since earlier ones. */
+  CounterValues operator-(const CounterValues &earlier) const {
+    CounterValues delta;
+    delta.cycles = cycles - earlier.cycles;
+    delta.instructions = instructions - earlier.instructions;
+    delta.cacheMisses = cacheMisses - earlier.cacheMisses;
+    delta.branchMisses = branchMisses - earlier.branchMisses;
+    return delta;
+  }
+
+  /**
+   * Gets the instructions run by cycle, 0 without cycles. Values well below
+   * 1 point to a phase waiting for the memory.
+   */
+  double instructionsPerCycle() const {
+    return cycles > 0 ? static_cast<double>(instructions) /
+                            static_cast<double>(cycles)
+                      : 0.0;
+  }
+
+  /** Gets the cache misses by thousand instructions, 0 without any. */
+  double cacheMissesPerKiloInstruction() const {
+    return instructions > 0 ? 1000.0 * static_cast<double>(cacheMisses) /
+                                  static_cast<double>(instructions)
+                            : 0.0;
+  }
+};
+
+/**
+ * The hardware counters of the thread building it: cycles, instructions,
+ * last level cache misses and branch misses, counted in user space.
+ *
+ * The counters come from perf_event on Linux, as one group so that they
+ * count over the same instants, scaled when the kernel multiplexes them with
+ * other groups. They are unavailable on the other systems, and where the
+ * kernel refuses them (e.g. kernel.perf_event_paranoid above 2, or in a
+ * virtual machine without a virtual PMU): their values then stay 0. The
+ * counters follow their thread, but read() can be called from any thread.
+ */
+class PerformanceCounters {
+public:
+  /**
+   * Opens the counters of the calling thread.
+   */
+  PerformanceCounters();
+
+  ~PerformanceCounters();
+
+  PerformanceCounters(const PerformanceCounters &) = delete;
+  PerformanceCounters &operator=(const PerformanceCounters &) = delete;
+
+  /**
+   * Tells whether the counters count, at least the cycles.
+   */
+  bool isAvailable() const { return descriptors[0] >= 0; }
+
+  /**
+   * Gets the values counted since the counters were opened, zeros if they
+   * are not available.
+   */
+  CounterValues read() const;
+
+  /**
+   * Tells whether the counters can be opened on this system at all.
+   */
+  static bool isSupported();
+
+private:
+  /** The file descriptors of the counters, -1 for unavailable ones */
+  int descriptors[4];
+};
+
+} // namespace libs
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // PERFORMANCECOUNTERS_H
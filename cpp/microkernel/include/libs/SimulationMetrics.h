@@ -0,0 +1,154 @@
+#ifndef SIMULATIONMETRICS_H
+#define SIMULATIONMETRICS_H
+
+#include "../IStepTimingListener.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace libs {
+
+/**
+ * A step timing listener keeping the telemetry of a running simulation in
+ * counters, for a monitoring system to scrape them (e.g. the /metrics page of
+ * the web view) in the Prometheus or OpenMetrics text format.
+ *
+ * The engine thread updates the counters with relaxed atomic operations
+ * only, so that the metrics cost a few additions per step; the scrapes read
+ * them from any thread without stopping the simulation. The page holds:
+ * - the steps run, their rate and the simulated time;
+ * - a histogram of the duration of each phase of the steps (see
+ *   StepTimings), labelled by phase;
+ * - the agents and the influences of the last step, and the influences
+ *   emitted since the start;
+ * - the threads running the agents and their utilization;
+ * - the depth of the queues registered with addQueue(), e.g. those of the
+ *   asynchronous probes;
+ * - the live and peak bytes of the subsystems of the process (see
+ *   MemoryAccounting).
+ *
+ * An engine has a single step timing listener: the metrics forward the
+ * timings to the next listener, if any, e.g. a StepTimingRecorder.
+ */
+class SimulationMetrics : public IStepTimingListener {
+public:
+  /** The upper bounds of the buckets of the histograms, in seconds. */
+  static constexpr std::array<double, 19> BUCKET_BOUNDS{
+      1e-5,   2.5e-5, 5e-5, 1e-4, 2.5e-4, 5e-4, 1e-3, 2.5e-3, 5e-3, 1e-2,
+      2.5e-2, 5e-2,   0.1,  0.25, 0.5,    1.0,  2.5,  5.0,    10.0};
+
+  /**
+   * @param next The listener the timings are forwarded to, or nullptr.
+   */
+  explicit SimulationMetrics(std::shared_ptr<IStepTimingListener> next =
+                                 std::shared_ptr<IStepTimingListener>());
+
+  SimulationMetrics(const SimulationMetrics &) = delete;
+  SimulationMetrics &operator=(const SimulationMetrics &) = delete;
+
+  const std::shared_ptr<IStepTimingListener> &getNext() const { return next; }
+
+  void stepTimed(const StepTimings &timings) override;
+
+  /**
+   * Exports the depth of a queue as similar_queue_depth{queue="name"},
+   * replacing the former queue of the same name.
+   * @param depth Called at each scrape, from the thread serving it.
+   */
+  void addQueue(const std::string &name, std::function<std::size_t()> depth);
+
+  /** Stops exporting a queue. */
+  void removeQueue(const std::string &name);
+
+  /** Gets the steps run since the creation or the last reset(). */
+  std::uint64_t getSteps() const {
+    return steps.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Gets the steps per second, smoothed over the last steps; 0 once no step
+   * ended for four times the mean period, or a second.
+   */
+  double getStepsPerSecond() const;
+
+  /**
+   * Gets the number of steps whose phase lasted at most each bound of
+   * BUCKET_BOUNDS, cumulated, followed by the count of all the steps.
+   * @param phase A phase of the page, e.g. "decision" or "total".
+   * @throws std::invalid_argument If the phase is unknown.
+   */
+  std::vector<std::uint64_t> getBucketCounts(const std::string &phase) const;
+
+  /** Starts the counters and the histograms again from 0. */
+  void reset();
+
+  /**
+   * Writes the page of the metrics.
+   * @param openMetrics True for the OpenMetrics format, false for the text
+   * format of Prometheus.
+   */
+  void write(std::ostream &out, bool openMetrics = true) const;
+
+  /** Gets the page of the metrics, as written by write(). */
+  std::string toText(bool openMetrics = true) const;
+
+  /** Gets the content type of the pages in a format. */
+  static const char *getContentType(bool openMetrics);
+
+private:
+  // The durations of a phase, counted in the bucket of their upper bound
+  struct Histogram {
+    std::array<std::atomic<std::uint64_t>, BUCKET_BOUNDS.size() + 1>
+        buckets{};
+    std::atomic<std::uint64_t> sumNanos{0};
+
+    void observe(StepTimings::Duration duration);
+    void reset();
+  };
+
+  struct Queue {
+    std::string name;
+    std::function<std::size_t()> depth;
+  };
+
+  static const std::array<StepTimings::Duration StepTimings::*, 9> PHASES;
+  static const std::array<const char *, 9> PHASE_NAMES;
+
+  std::shared_ptr<IStepTimingListener> next;
+
+  std::atomic<std::uint64_t> steps{0};
+  std::atomic<std::uint64_t> influences{0};
+  std::atomic<std::int64_t> lastTime{0};
+  std::atomic<std::size_t> agents{0};
+  std::atomic<std::size_t> stepInfluences{0};
+  std::atomic<std::size_t> threads{0};
+  std::atomic<double> utilization{0};
+  // The steady clock when the last step ended, and the smoothed period
+  std::atomic<std::int64_t> lastStepEnd{0};
+  std::atomic<double> meanPeriodNanos{0};
+  std::array<Histogram, 9> histograms;
+
+  mutable std::mutex queueMutex;
+  std::vector<Queue> queues;
+};
+
+} // namespace libs
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMULATIONMETRICS_H
@@ -0,0 +1,101 @@
+#ifndef STEPTIMINGRECORDER_H
+#define STEPTIMINGRECORDER_H
+
+#include "../IStepTimingListener.h"
+#include <cstddef>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace libs {
+
+/**
+ * A step timing listener keeping the timings of the last steps in a ring
+ * buffer. The recorded timings can be read from another thread (e.g. the one
+ * serving a web view) while the simulation runs.
+ */
+class StepTimingRecorder : public IStepTimingListener {
+private:
+  std::vector<StepTimings> ring;
+  std::size_t next = 0;
+  std::size_t count = 0;
+  std::size_t recordedSteps = 0;
+  mutable std::mutex mutex;
+
+public:
+  /**
+   * Builds a recorder.
+   * @param capacity The number of steps kept, the oldest being overwritten.
+   * @throws std::invalid_argument If the capacity is 0.
+   */
+  explicit StepTimingRecorder(std::size_t capacity = 1024) : ring(capacity) {
+    if (capacity == 0) {
+      throw std::invalid_argument("The capacity has to be positive.");
+    }
+  }
+
+  void stepTimed(const StepTimings &timings) override {
+    std::lock_guard<std::mutex> lock(mutex);
+    ring[next] = timings;
+    next = (next + 1) % ring.size();
+    if (count < ring.size()) {
+      ++count;
+    }
+    ++recordedSteps;
+  }
+
+  /**
+   * Gets the timings still in the buffer, from the oldest to the newest.
+   */
+  std::vector<StepTimings> getTimings() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<StepTimings> timings;
+    timings.reserve(count);
+    const std::size_t first = (next + ring.size() - count) % ring.size();
+    for (std::size_t i = 0; i < count; ++i) {
+      timings.push_back(ring[(first + i) % ring.size()]);
+    }
+    return timings;
+  }
+
+  /**
+   * Gets the timings of the last recorded step.
+   * @throws std::out_of_range If no step was recorded.
+   */
+  StepTimings getLatest() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == 0) {
+      throw std::out_of_range("No step was recorded.");
+    }
+    return ring[(next + ring.size() - 1) % ring.size()];
+  }
+
+  /**
+   * Gets the number of steps recorded since the creation or the last clear.
+   */
+  std::size_t getRecordedSteps() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return recordedSteps;
+  }
+
+  void clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    next = 0;
+    count = 0;
+    recordedSteps = 0;
+  }
+};
+
+} // namespace libs
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // STEPTIMINGRECORDER_H
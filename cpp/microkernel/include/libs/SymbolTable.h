@@ -0,0 +1,146 @@
+#ifndef SYMBOLTABLE_H
+#define SYMBOLTABLE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace libs {
+
+/**
+ * The strings interned by the process, each identified by a 32-bit id
+ * given on its first interning: the agents, the categories and the
+ * influences keep the ids of their strings, compared and hashed as
+ * integers, and the strings are produced only for the bindings, the web
+ * views and the exports.
+ *
+ * The strings are never erased, so that the references given by name()
+ * stay valid. intern() and name() can be called from any thread; name()
+ * does not lock.
+ */
+class SymbolTable {
+public:
+  /** The id of the empty string. */
+  static constexpr std::uint32_t EMPTY = 0;
+
+  /** Gets the table of the process. */
+  static SymbolTable &global();
+
+  SymbolTable();
+  ~SymbolTable();
+
+  SymbolTable(const SymbolTable &) = delete;
+  SymbolTable &operator=(const SymbolTable &) = delete;
+
+  /** Gets the id of a string, interning it on its first use. */
+  std::uint32_t intern(std::string_view name);
+
+  /**
+   * Gets the id of a string without interning it.
+   * @return false If the string was never interned.
+   */
+  bool find(std::string_view name, std::uint32_t &id) const;
+
+  /**
+   * Gets the string of an id.
+   * @throws std::out_of_range If no string has this id.
+   */
+  const std::string &name(std::uint32_t id) const;
+
+  /** Gets the number of strings interned, the empty one included. */
+  std::size_t size() const { return count.load(std::memory_order_acquire); }
+
+private:
+  // The strings are stored in chunks of doubling sizes, the chunk k holding
+  // the ids from FIRST_CHUNK * (2^k - 1), so that a chunk never moves
+  static constexpr std::uint64_t FIRST_CHUNK = 64;
+  static constexpr int CHUNKS = 27;
+
+  std::atomic<std::string *> chunks[CHUNKS];
+  std::atomic<std::uint32_t> count{0};
+  mutable std::shared_mutex mutex;
+  // the views point to the stored strings
+  std::unordered_map<std::string_view, std::uint32_t> ids;
+
+  static int chunkOf(std::uint32_t id, std::uint64_t &offset);
+};
+
+/**
+ * A string interned in the global SymbolTable: 4 bytes, copied, compared
+ * and hashed as its id. The default symbol is the empty string.
+ *
+ * The order of the symbols is the order of their ids, i.e. of their first
+ * interning; compare their str() for the order of the strings.
+ */
+class Symbol {
+public:
+  Symbol() = default;
+
+  explicit Symbol(std::string_view name)
+      : id(SymbolTable::global().intern(name)) {}
+
+  /**
+   * Gets the symbol of an id of the global table.
+   * @throws std::out_of_range If no string has this id.
+   */
+  static Symbol fromId(std::uint32_t id) {
+    SymbolTable::global().name(id);
+    Symbol symbol;
+    symbol.id = id;
+    return symbol;
+  }
+
+  /**
+   * Gets the symbol of a string without interning it, e.g. to look up a
+   * string coming from the bindings.
+   * @return false If the string was never interned.
+   */
+  static bool find(std::string_view name, Symbol &symbol) {
+    return SymbolTable::global().find(name, symbol.id);
+  }
+
+  std::uint32_t getId() const { return id; }
+
+  /** Gets the string; the reference stays valid. */
+  const std::string &str() const { return SymbolTable::global().name(id); }
+
+  bool empty() const { return id == SymbolTable::EMPTY; }
+
+  bool operator==(const Symbol &other) const { return id == other.id; }
+  bool operator!=(const Symbol &other) const { return id != other.id; }
+  bool operator<(const Symbol &other) const { return id < other.id; }
+
+private:
+  std::uint32_t id = SymbolTable::EMPTY;
+};
+
+} // namespace libs
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+namespace std {
+template <>
+struct hash<fr::univ_artois::lgi2a::similar::microkernel::libs::Symbol> {
+  std::size_t operator()(
+      const fr::univ_artois::lgi2a::similar::microkernel::libs::Symbol &symbol)
+      const {
+    return std::hash<std::uint32_t>{}(symbol.getId());
+  }
+};
+} // namespace std
+
+#endif // SYMBOLTABLE_H
@@ -4,11 +4,13 @@
 #include "../../LevelIdentifier.h"
 #include "../../SimulationTimeStamp.h"
 #include "../../dynamicstate/ConsistentPublicLocalDynamicState.h"
+#include "../../dynamicstate/PublicLocalStateIndex.h"
 #include "../../dynamicstate/TransitoryPublicLocalDynamicState.h"
 #include "../../levels/ILevel.h"
 #include <memory>
 #include <set>
 #include <stdexcept>
+#include <utility>
 
 namespace fr {
 namespace univ_artois {
@@ -53,6 +55,9 @@ private:
    */
   std::set<LevelIdentifier> influenceableLevels;
 
+  // the index of the public local states, shared with the consistent state
+  std::shared_ptr<dynamicstate::PublicLocalStateIndex> spatialIndex;
+
 protected:
   /**
    * Builds an initialized instance of level.
@@ -96,6 +101,11 @@ protected:
           dynamicstate::TransitoryPublicLocalDynamicState>(
           other.lastTransitoryPublicLocalDynamicState->clone());
     }
+    // The clone indexes its own copies of the states
+    if (other.spatialIndex) {
+      setSpatialIndex(other.spatialIndex->getCellSize(),
+                      other.spatialIndex->getLocator());
+    }
   }
 
 public:
@@ -187,6 +197,43 @@ public:
   void addInfluenceableLevel(const LevelIdentifier &influenceableLevel) {
     this->influenceableLevels.insert(influenceableLevel);
   }
+
+  /**
+   * Makes the level maintain a spatial index of the public local states of
+   * its agents, attached to its consistent state, and builds it.
+   * @param cellSize The side of the cells of the index.
+   * @param locator Reads the positions of the states.
+   * @throws std::invalid_argument If cellSize is not positive or the locator
+   * is empty.
+   */
+  void setSpatialIndex(double cellSize,
+                       dynamicstate::PublicLocalStateIndex::Locator locator) {
+    this->spatialIndex = std::make_shared<dynamicstate::PublicLocalStateIndex>(
+        cellSize, std::move(locator));
+    updateSpatialIndex();
+  }
+
+  /**
+   * Rebuilds the spatial index from the current public local states of the
+   * agents; called by the levels after their reactions. The index held by a
+   * snapshot of the state is left as it is, a new one being built instead.
+   * Does nothing if the level maintains no index.
+   */
+  void updateSpatialIndex() override {
+    if (!this->spatialIndex || !this->lastConsistentPublicLocalDynamicState) {
+      return;
+    }
+    auto &state = *this->lastConsistentPublicLocalDynamicState;
+    state.setSpatialIndex(nullptr);
+    if (this->spatialIndex.use_count() > 1) {
+      this->spatialIndex =
+          std::make_shared<dynamicstate::PublicLocalStateIndex>(
+              this->spatialIndex->getCellSize(),
+              this->spatialIndex->getLocator());
+    }
+    this->spatialIndex->rebuild(state.getPublicLocalStateOfAgents());
+    state.setSpatialIndex(this->spatialIndex);
+  }
 };
 
 } // namespace abstractimpl
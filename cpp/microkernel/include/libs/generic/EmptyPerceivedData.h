@@ -28,6 +28,12 @@ public:
   std::shared_ptr<microkernel::agents::IPerceivedData> clone() const override {
     return std::make_shared<EmptyPerceivedData>(*this);
   }
+
+  bool reset(const SimulationTimeStamp &transitoryPeriodMin,
+             const SimulationTimeStamp &transitoryPeriodMax) override {
+    setTransitoryPeriod(transitoryPeriodMin, transitoryPeriodMax);
+    return true;
+  }
 };
 
 } // namespace generic
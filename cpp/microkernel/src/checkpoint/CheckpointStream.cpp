@@ -0,0 +1,44 @@
+#include "checkpoint/CheckpointStream.h"
+
+#include <cstdio>
+#include <fstream>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace checkpoint {
+
+void CheckpointWriter::saveTo(const std::string &path) const {
+  const std::string temporaryPath = path + ".tmp";
+  {
+    std::ofstream output(temporaryPath, std::ios::binary | std::ios::trunc);
+    if (!output) {
+      throw CheckpointException("Cannot create the checkpoint '" +
+                                temporaryPath + "'.");
+    }
+    output.write(reinterpret_cast<const char *>(bytes.data()),
+                 static_cast<std::streamsize>(bytes.size()));
+    output.flush();
+    if (!output) {
+      throw CheckpointException("Cannot write the checkpoint '" +
+                                temporaryPath + "'.");
+    }
+  }
+#ifdef _WIN32
+  // std::rename does not replace an existing file on Windows.
+  std::remove(path.c_str());
+#endif
+  if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+    throw CheckpointException("Cannot move the checkpoint to '" + path +
+                              "'.");
+  }
+}
+
+} // namespace checkpoint
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -0,0 +1,257 @@
+#include "checkpoint/InfluenceLog.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace checkpoint {
+
+namespace {
+
+const char MAGIC[8] = {'S', 'I', 'M', 'I', 'N', 'F', 'L', '\0'};
+
+constexpr std::uint32_t FORMAT_VERSION = 1;
+
+constexpr std::uint8_t STEP_RECORD = 1;
+constexpr std::uint8_t KEY_FRAME_RECORD = 2;
+
+} // namespace
+
+void InfluenceCodecs::add(const std::string &category,
+                          InfluenceCodec::Writer write,
+                          InfluenceCodec::Reader read) {
+  auto existing = indices.find(category);
+  if (existing != indices.end()) {
+    codecs[existing->second] = InfluenceCodec{std::move(write),
+                                              std::move(read)};
+    return;
+  }
+  indices.emplace(category, static_cast<std::uint32_t>(codecs.size()));
+  categories.push_back(category);
+  codecs.push_back(InfluenceCodec{std::move(write), std::move(read)});
+}
+
+std::uint32_t InfluenceCodecs::indexOf(const std::string &category) const {
+  auto index = indices.find(category);
+  if (index == indices.end()) {
+    throw CheckpointException("No codec is registered for the influences '" +
+                              category + "'.");
+  }
+  return index->second;
+}
+
+void InfluenceCodecs::write(CheckpointWriter &writer,
+                            const InfluencesByLevel &influencesByLevel) const {
+  std::uint64_t influencedLevels = 0;
+  for (const auto &levelInfluences : influencesByLevel) {
+    influencedLevels += levelInfluences.empty() ? 0 : 1;
+  }
+  writer.writeU64(influencedLevels);
+  for (std::size_t level = 0; level < influencesByLevel.size(); ++level) {
+    const auto &levelInfluences = influencesByLevel[level];
+    if (levelInfluences.empty()) {
+      continue;
+    }
+    writer.writeU32(static_cast<std::uint32_t>(level));
+    writer.writeU64(levelInfluences.size());
+    for (const auto &influence : levelInfluences) {
+      const std::uint32_t codec = indexOf(influence->getCategory());
+      writer.writeU32(codec);
+      CheckpointWriter content;
+      codecs[codec].write(*influence, content);
+      writer.writeBlock(content);
+    }
+  }
+}
+
+void InfluenceCodecs::read(
+    CheckpointReader &reader, const std::vector<LevelIdentifier> &levels,
+    const SimulationTimeStamp &timeLowerBound,
+    const SimulationTimeStamp &timeUpperBound,
+    InfluencesByLevel &influencesByLevel,
+    const std::vector<std::uint32_t> *codecOfCategory) const {
+  influencesByLevel.assign(levels.size(), {});
+  const std::size_t categoryCount =
+      codecOfCategory ? codecOfCategory->size() : codecs.size();
+  const std::uint64_t influencedLevels = reader.readU64();
+  for (std::uint64_t i = 0; i < influencedLevels; ++i) {
+    const std::uint32_t level = reader.readU32();
+    if (level >= levels.size()) {
+      throw CheckpointException("The influences target an unknown level.");
+    }
+    auto &levelInfluences = influencesByLevel[level];
+    const std::uint64_t influenceCount = reader.readU64();
+    for (std::uint64_t j = 0; j < influenceCount; ++j) {
+      const std::uint32_t category = reader.readU32();
+      if (category >= categoryCount) {
+        throw CheckpointException("The influences have an unknown category.");
+      }
+      CheckpointReader influence = reader.readBlock();
+      const InfluenceCodec &codec =
+          codecs[codecOfCategory ? (*codecOfCategory)[category] : category];
+      levelInfluences.insert(codec.read(influence, levels[level],
+                                        timeLowerBound, timeUpperBound));
+    }
+  }
+}
+
+InfluenceLogWriter::InfluenceLogWriter(const std::string &path,
+                                       InfluenceCodecs codecs)
+    : path(path), codecs(std::move(codecs)),
+      output(path, std::ios::binary | std::ios::trunc) {
+  if (!output) {
+    throw CheckpointException("Cannot create the influence log '" + path +
+                              "'.");
+  }
+}
+
+void InfluenceLogWriter::start(const std::vector<LevelIdentifier> &levels,
+                               const CheckpointWriter &initialCheckpoint) {
+  if (started) {
+    throw std::logic_error("The influence log is already started.");
+  }
+  CheckpointWriter header;
+  header.writeBytes(MAGIC, sizeof(MAGIC));
+  header.writeU32(FORMAT_VERSION);
+  header.writeU64(codecs.getCategories().size());
+  for (const auto &category : codecs.getCategories()) {
+    header.writeString(category);
+  }
+  header.writeU64(levels.size());
+  levelIndices.clear();
+  for (const auto &level : levels) {
+    header.writeString(level.toString());
+    levelIndices.emplace(level,
+                         static_cast<std::uint32_t>(levelIndices.size()));
+  }
+  header.writeBlock(initialCheckpoint);
+  output.write(reinterpret_cast<const char *>(header.getBytes().data()),
+               static_cast<std::streamsize>(header.size()));
+  started = true;
+}
+
+void InfluenceLogWriter::append(std::uint8_t kind,
+                                const CheckpointWriter &record) {
+  CheckpointWriter framed;
+  framed.writeU8(kind);
+  framed.writeBlock(record);
+  output.write(reinterpret_cast<const char *>(framed.getBytes().data()),
+               static_cast<std::streamsize>(framed.size()));
+  if (!output) {
+    throw CheckpointException("Cannot write the influence log '" + path +
+                              "'.");
+  }
+}
+
+void InfluenceLogWriter::writeStep(const SimulationTimeStamp &timeLowerBound,
+                                   const SimulationTimeStamp &timeUpperBound,
+                                   const CheckpointSections &sections,
+                                   const InfluencesByLevel &influencesByLevel) {
+  CheckpointWriter record;
+  record.writeI64(timeLowerBound.getIdentifier());
+  record.writeI64(timeUpperBound.getIdentifier());
+  CheckpointWriter sectionBlock;
+  writeSections(sectionBlock, sections);
+  record.writeBlock(sectionBlock);
+  codecs.write(record, influencesByLevel);
+  append(STEP_RECORD, record);
+}
+
+void InfluenceLogWriter::writeKeyFrame(const CheckpointWriter &checkpoint) {
+  append(KEY_FRAME_RECORD, checkpoint);
+}
+
+void InfluenceLogWriter::flush() { output.flush(); }
+
+void InfluenceLogWriter::writeSections(CheckpointWriter &writer,
+                                       const CheckpointSections &sections) {
+  writer.writeU64(sections.size());
+  for (const auto &section : sections) {
+    writer.writeString(section.first);
+    CheckpointWriter content;
+    section.second->writeCheckpoint(content);
+    writer.writeBlock(content);
+  }
+}
+
+InfluenceLogReader::InfluenceLogReader(const std::string &path,
+                                       InfluenceCodecs codecs)
+    : file(path), codecs(std::move(codecs)) {
+  CheckpointReader reader = file.reader();
+  char magic[sizeof(MAGIC)];
+  reader.readBytes(magic, sizeof(magic));
+  if (std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+    throw CheckpointException("This is not an influence log.");
+  }
+  const std::uint32_t version = reader.readU32();
+  if (version > FORMAT_VERSION) {
+    throw CheckpointException("The influence log has the version " +
+                              std::to_string(version) +
+                              ", newer than this engine.");
+  }
+  const std::uint64_t categoryCount = reader.readU64();
+  for (std::uint64_t i = 0; i < categoryCount; ++i) {
+    codecOfCategory.push_back(this->codecs.indexOf(reader.readString()));
+  }
+  const std::uint64_t levelCount = reader.readU64();
+  for (std::uint64_t i = 0; i < levelCount; ++i) {
+    levels.emplace_back(reader.readString());
+  }
+  checkpoint = reader.readBlock();
+  records = reader;
+}
+
+bool InfluenceLogReader::next(Record &record) {
+  // A record cut short by the end of the file is left out.
+  if (records.remaining() < 1 + sizeof(std::uint64_t)) {
+    return false;
+  }
+  CheckpointReader peek = records;
+  peek.readU8();
+  if (peek.readU64() > peek.remaining()) {
+    return false;
+  }
+
+  const std::uint8_t kind = records.readU8();
+  CheckpointReader content = records.readBlock();
+  record.influencesByLevel.clear();
+  if (kind == KEY_FRAME_RECORD) {
+    record.kind = Record::Kind::KEY_FRAME;
+    record.checkpoint = content;
+    return true;
+  }
+  if (kind != STEP_RECORD) {
+    throw CheckpointException("The influence log holds an unknown record.");
+  }
+  record.kind = Record::Kind::STEP;
+  record.timeLowerBound = SimulationTimeStamp(content.readI64());
+  record.timeUpperBound = SimulationTimeStamp(content.readI64());
+  record.sections = content.readBlock();
+  codecs.read(content, levels, record.timeLowerBound, record.timeUpperBound,
+              record.influencesByLevel, &codecOfCategory);
+  return true;
+}
+
+void InfluenceLogReader::restoreSections(CheckpointReader sections,
+                                         const CheckpointSections &objects) {
+  const std::uint64_t sectionCount = sections.readU64();
+  for (std::uint64_t i = 0; i < sectionCount; ++i) {
+    const std::string name = sections.readString();
+    CheckpointReader content = sections.readBlock();
+    auto object = objects.find(name);
+    if (object != objects.end()) {
+      object->second->readCheckpoint(content);
+    }
+  }
+}
+
+} // namespace checkpoint
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -0,0 +1,70 @@
+#include "checkpoint/MappedFile.h"
+
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SIMILAR_HAS_MMAP 1
+#endif
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace checkpoint {
+
+MappedFile::MappedFile(const std::string &path) {
+#ifdef SIMILAR_HAS_MMAP
+  const int descriptor = ::open(path.c_str(), O_RDONLY);
+  if (descriptor < 0) {
+    throw CheckpointException("Cannot open the checkpoint '" + path + "'.");
+  }
+  struct stat status;
+  if (::fstat(descriptor, &status) != 0) {
+    ::close(descriptor);
+    throw CheckpointException("Cannot read the size of '" + path + "'.");
+  }
+  length = static_cast<std::size_t>(status.st_size);
+  if (length > 0) {
+    void *address =
+        ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    if (address == MAP_FAILED) {
+      ::close(descriptor);
+      throw CheckpointException("Cannot map the checkpoint '" + path + "'.");
+    }
+    mapped = static_cast<const std::uint8_t *>(address);
+  }
+  // The mapping stays valid once the descriptor is closed.
+  ::close(descriptor);
+#else
+  std::ifstream input(path, std::ios::binary | std::ios::ate);
+  if (!input) {
+    throw CheckpointException("Cannot open the checkpoint '" + path + "'.");
+  }
+  length = static_cast<std::size_t>(input.tellg());
+  buffer.resize(length);
+  input.seekg(0);
+  if (!input.read(reinterpret_cast<char *>(buffer.data()), length)) {
+    throw CheckpointException("Cannot read the checkpoint '" + path + "'.");
+  }
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef SIMILAR_HAS_MMAP
+  if (mapped != nullptr) {
+    ::munmap(const_cast<std::uint8_t *>(mapped), length);
+  }
+#endif
+}
+
+} // namespace checkpoint
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
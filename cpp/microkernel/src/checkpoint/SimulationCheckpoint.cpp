@@ -0,0 +1,220 @@
+#include "checkpoint/SimulationCheckpoint.h"
+
+#include <cstring>
+#include <exception>
+#include <set>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace checkpoint {
+
+namespace {
+
+const char MAGIC[8] = {'S', 'I', 'M', 'C', 'K', 'P', 'T', '\0'};
+
+/** Writes an object as a block, or an empty marker if it has no content. */
+void writeObject(CheckpointWriter &writer, const void *object,
+                 const ICheckpointable *checkpointable) {
+  writer.writeBool(object != nullptr && checkpointable != nullptr);
+  if (object != nullptr && checkpointable != nullptr) {
+    CheckpointWriter block;
+    checkpointable->writeCheckpoint(block);
+    writer.writeBlock(block);
+  }
+}
+
+template <typename T>
+void writeObject(CheckpointWriter &writer, const std::shared_ptr<T> &object) {
+  writeObject(writer, object.get(),
+              dynamic_cast<const ICheckpointable *>(object.get()));
+}
+
+/**
+ * Reads an object written by writeObject into the object rebuilt by the
+ * model, which has to be checkpointable when the checkpoint holds content.
+ */
+void readObject(CheckpointReader &reader, ICheckpointable *object,
+                const std::string &description) {
+  if (!reader.readBool()) {
+    return;
+  }
+  CheckpointReader block = reader.readBlock();
+  if (object == nullptr) {
+    throw CheckpointException("The checkpoint holds " + description +
+                              ", which the model did not rebuild as a "
+                              "checkpointable object.");
+  }
+  object->readCheckpoint(block);
+}
+
+template <typename T>
+void readObject(CheckpointReader &reader, const std::shared_ptr<T> &object,
+                const std::string &description) {
+  readObject(reader, dynamic_cast<ICheckpointable *>(object.get()),
+             description);
+}
+
+std::shared_ptr<environment::ILocalStateOfEnvironment>
+privateStateOf(const environment::IEnvironment4Engine *environment,
+               const LevelIdentifier &level) {
+  if (environment == nullptr) {
+    return nullptr;
+  }
+  // Environments throw when they have no state in a level.
+  try {
+    return environment->getPrivateLocalState(level);
+  } catch (const std::exception &) {
+    return nullptr;
+  }
+}
+
+std::shared_ptr<environment::ILocalStateOfEnvironment>
+publicStateOf(const environment::IEnvironment4Engine *environment,
+              const LevelIdentifier &level) {
+  if (environment == nullptr) {
+    return nullptr;
+  }
+  try {
+    return environment->getPublicLocalState(level);
+  } catch (const std::exception &) {
+    return nullptr;
+  }
+}
+
+} // namespace
+
+void SimulationCheckpoint::write(
+    CheckpointWriter &writer, const SimulationTimeStamp &currentTime,
+    const Levels &levels, const environment::IEnvironment4Engine *environment,
+    const std::vector<AgentPtr> &agents, const CheckpointSections &sections) {
+  writer.writeBytes(MAGIC, sizeof(MAGIC));
+  writer.writeU32(FORMAT_VERSION);
+  writer.writeI64(currentTime.getIdentifier());
+
+  writer.writeU64(levels.size());
+  for (const auto &pair : levels) {
+    writer.writeString(pair.first.toString());
+    writer.writeI64(pair.second->getLastConsistentState()->getTime()
+                        .getIdentifier());
+    writeObject(writer, pair.second);
+    writeObject(writer, publicStateOf(environment, pair.first));
+    writeObject(writer, privateStateOf(environment, pair.first));
+  }
+
+  writer.writeU64(agents.size());
+  for (const auto &agent : agents) {
+    writer.writeString(agent->getCategory().toString());
+    writeObject(writer, agent);
+    writeObject(writer, agent->getGlobalState());
+    const std::set<LevelIdentifier> agentLevels = agent->getLevels();
+    writer.writeU64(agentLevels.size());
+    for (const auto &level : agentLevels) {
+      writer.writeString(level.toString());
+      writeObject(writer, agent->getPublicLocalState(level));
+      writeObject(writer, agent->getPrivateLocalState(level));
+    }
+  }
+
+  writer.writeU64(sections.size());
+  for (const auto &section : sections) {
+    writer.writeString(section.first);
+    writeObject(writer, section.second, section.second);
+  }
+}
+
+SimulationTimeStamp SimulationCheckpoint::read(
+    CheckpointReader &reader, const Levels &levels,
+    environment::IEnvironment4Engine *environment,
+    const AgentFactory &agentFactory, const CheckpointSections &sections,
+    std::vector<AgentPtr> &restoredAgents) {
+  char magic[sizeof(MAGIC)];
+  reader.readBytes(magic, sizeof(magic));
+  if (std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+    throw CheckpointException("This is not a simulation checkpoint.");
+  }
+  const std::uint32_t version = reader.readU32();
+  if (version > FORMAT_VERSION) {
+    throw CheckpointException("The checkpoint has the version " +
+                              std::to_string(version) +
+                              ", newer than this engine.");
+  }
+  const SimulationTimeStamp currentTime(reader.readI64());
+
+  const std::uint64_t levelCount = reader.readU64();
+  for (std::uint64_t i = 0; i < levelCount; ++i) {
+    const LevelIdentifier levelId(reader.readString());
+    auto level = levels.find(levelId);
+    if (level == levels.end()) {
+      throw CheckpointException("The model has no level '" +
+                                levelId.toString() + "'.");
+    }
+    level->second->getLastConsistentState()->setTime(
+        SimulationTimeStamp(reader.readI64()));
+    readObject(reader, level->second, "the level " + levelId.toString());
+    readObject(reader, publicStateOf(environment, levelId),
+               "the public environment of " + levelId.toString());
+    readObject(reader, privateStateOf(environment, levelId),
+               "the private environment of " + levelId.toString());
+  }
+
+  const std::uint64_t agentCount = reader.readU64();
+  restoredAgents.clear();
+  restoredAgents.reserve(agentCount);
+  for (std::uint64_t i = 0; i < agentCount; ++i) {
+    const AgentCategory category(reader.readString());
+    AgentPtr agent = agentFactory ? agentFactory(category) : nullptr;
+    if (!agent) {
+      throw CheckpointException("No agent was built for the category '" +
+                                category.toString() + "'.");
+    }
+    readObject(reader, agent, "an agent " + category.toString());
+    readObject(reader, agent->getGlobalState(),
+               "the global state of an agent " + category.toString());
+    std::set<LevelIdentifier> checkpointLevels;
+    const std::uint64_t agentLevelCount = reader.readU64();
+    for (std::uint64_t j = 0; j < agentLevelCount; ++j) {
+      const LevelIdentifier levelId(reader.readString());
+      if (agent->getLevels().count(levelId) == 0) {
+        throw CheckpointException("The agents " + category.toString() +
+                                  " built for the checkpoint do not lie in "
+                                  "the level " +
+                                  levelId.toString() + ".");
+      }
+      checkpointLevels.insert(levelId);
+      readObject(reader, agent->getPublicLocalState(levelId),
+                 "a public state of an agent " + category.toString());
+      readObject(reader, agent->getPrivateLocalState(levelId),
+                 "a private state of an agent " + category.toString());
+    }
+    for (const auto &levelId : agent->getLevels()) {
+      if (checkpointLevels.count(levelId) == 0) {
+        agent->excludeFromLevel(levelId);
+      }
+    }
+    restoredAgents.push_back(agent);
+  }
+
+  const std::uint64_t sectionCount = reader.readU64();
+  for (std::uint64_t i = 0; i < sectionCount; ++i) {
+    const std::string name = reader.readString();
+    auto section = sections.find(name);
+    if (section == sections.end()) {
+      if (reader.readBool()) {
+        reader.readBlock();
+      }
+      continue;
+    }
+    readObject(reader, section->second, "the section " + name);
+  }
+  return currentTime;
+}
+
+} // namespace checkpoint
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
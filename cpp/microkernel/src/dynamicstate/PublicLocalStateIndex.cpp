@@ -0,0 +1,131 @@
+#include "dynamicstate/PublicLocalStateIndex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace dynamicstate {
+
+namespace {
+
+// The most cells per indexed state, bounding the memory of sparse levels
+constexpr double CELLS_PER_STATE = 4;
+
+} // namespace
+
+PublicLocalStateIndex::PublicLocalStateIndex(double cellSize, Locator locator)
+    : cellSize(cellSize), locator(std::move(locator)), side(cellSize) {
+  if (!(cellSize > 0)) {
+    throw std::invalid_argument("The cell size must be positive.");
+  }
+  if (!this->locator) {
+    throw std::invalid_argument("The 'locator' argument cannot be empty.");
+  }
+  start.assign(2, 0);
+}
+
+void PublicLocalStateIndex::rebuild(const std::set<State> &publicLocalStates) {
+  std::vector<State> located;
+  std::vector<double> lxs;
+  std::vector<double> lys;
+  located.reserve(publicLocalStates.size());
+  lxs.reserve(publicLocalStates.size());
+  lys.reserve(publicLocalStates.size());
+  minX = minY = 0;
+  double maxX = 0;
+  double maxY = 0;
+  for (const State &state : publicLocalStates) {
+    double x, y;
+    if (state && locator(*state, x, y) && std::isfinite(x) &&
+        std::isfinite(y)) {
+      if (located.empty()) {
+        minX = maxX = x;
+        minY = maxY = y;
+      } else {
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+      }
+      located.push_back(state);
+      lxs.push_back(x);
+      lys.push_back(y);
+    }
+  }
+
+  // The cells are widened until the box holds few enough of them
+  const double maxCells = CELLS_PER_STATE * located.size() + 1;
+  side = cellSize;
+  while (((maxX - minX) / side + 1) * ((maxY - minY) / side + 1) > maxCells) {
+    side *= 2;
+  }
+  columns = static_cast<int>((maxX - minX) / side) + 1;
+  rows = static_cast<int>((maxY - minY) / side) + 1;
+
+  // Counting sort of the states by cell
+  const std::size_t cells = static_cast<std::size_t>(columns) * rows;
+  std::vector<std::uint32_t> cellOf(located.size());
+  start.assign(cells + 1, 0);
+  for (std::size_t i = 0; i < located.size(); ++i) {
+    cellOf[i] = static_cast<std::uint32_t>(
+        static_cast<std::size_t>(rowOf(lys[i])) * columns + columnOf(lxs[i]));
+    ++start[cellOf[i] + 1];
+  }
+  std::partial_sum(start.begin(), start.end(), start.begin());
+  std::vector<std::uint32_t> next(start.begin(), start.end() - 1);
+  states.assign(located.size(), nullptr);
+  xs.resize(located.size());
+  ys.resize(located.size());
+  for (std::size_t i = 0; i < located.size(); ++i) {
+    const std::uint32_t k = next[cellOf[i]]++;
+    states[k] = std::move(located[i]);
+    xs[k] = lxs[i];
+    ys[k] = lys[i];
+  }
+}
+
+std::vector<PublicLocalStateIndex::State>
+PublicLocalStateIndex::within(double x, double y, double radius) const {
+  std::vector<State> found;
+  forEachWithin(x, y, radius,
+                [&](const State &state, double) { found.push_back(state); });
+  return found;
+}
+
+std::vector<std::vector<PublicLocalStateIndex::State>>
+PublicLocalStateIndex::withinAll(
+    const std::vector<std::pair<double, double>> &centers,
+    double radius) const {
+  std::vector<std::vector<State>> found(centers.size());
+  std::vector<std::size_t> order(centers.size());
+  std::vector<std::size_t> cellOfCenter(centers.size());
+  for (std::size_t i = 0; i < centers.size(); ++i) {
+    order[i] = i;
+    cellOfCenter[i] =
+        static_cast<std::size_t>(rowOf(centers[i].second)) * columns +
+        columnOf(centers[i].first);
+  }
+  std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+    return cellOfCenter[a] < cellOfCenter[b];
+  });
+  for (std::size_t i : order) {
+    forEachWithin(centers[i].first, centers[i].second, radius,
+                  [&](const State &state, double) {
+                    found[i].push_back(state);
+                  });
+  }
+  return found;
+}
+
+} // namespace dynamicstate
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -0,0 +1,147 @@
+#include "engine/CpuTopology.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace engine {
+
+std::vector<int> CpuTopology::parseCpuList(const std::string &list) {
+  std::vector<int> cpus;
+  std::stringstream items(list);
+  std::string item;
+  while (std::getline(items, item, ',')) {
+    item.erase(std::remove_if(item.begin(), item.end(),
+                              [](char c) { return c == ' ' || c == '\n'; }),
+               item.end());
+    if (item.empty()) {
+      continue;
+    }
+    const std::size_t dash = item.find('-');
+    try {
+      std::size_t parsed = 0;
+      const int first = std::stoi(item.substr(0, dash), &parsed);
+      int last = first;
+      if (dash != std::string::npos) {
+        last = std::stoi(item.substr(dash + 1), &parsed);
+        parsed += dash + 1;
+      }
+      if (parsed != item.size() || first < 0 || last < first) {
+        throw std::invalid_argument(item);
+      }
+      for (int cpu = first; cpu <= last; ++cpu) {
+        cpus.push_back(cpu);
+      }
+    } catch (const std::logic_error &) {
+      throw std::invalid_argument("Malformed CPU list: " + list);
+    }
+  }
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+  return cpus;
+}
+
+CpuTopology CpuTopology::detect() {
+  CpuTopology topology;
+#if defined(__linux__)
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  const bool restricted =
+      sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+  for (int node = 0;; ++node) {
+    std::ifstream file("/sys/devices/system/node/node" +
+                       std::to_string(node) + "/cpulist");
+    if (!file) {
+      break;
+    }
+    std::string list;
+    std::getline(file, list);
+    std::vector<int> cpus;
+    try {
+      cpus = parseCpuList(list);
+    } catch (const std::invalid_argument &) {
+      topology.nodes.clear();
+      break;
+    }
+    if (restricted) {
+      cpus.erase(std::remove_if(cpus.begin(), cpus.end(),
+                                [&allowed](int cpu) {
+                                  return cpu >= CPU_SETSIZE ||
+                                         !CPU_ISSET(cpu, &allowed);
+                                }),
+                 cpus.end());
+    }
+    if (!cpus.empty()) {
+      topology.nodes.push_back(std::move(cpus));
+    }
+  }
+  if (topology.nodes.empty() && restricted) {
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &allowed)) {
+        cpus.push_back(cpu);
+      }
+    }
+    if (!cpus.empty()) {
+      topology.nodes.push_back(std::move(cpus));
+    }
+  }
+#endif
+  if (topology.nodes.empty()) {
+    std::vector<int> cpus(std::max(1u, std::thread::hardware_concurrency()));
+    for (std::size_t cpu = 0; cpu < cpus.size(); ++cpu) {
+      cpus[cpu] = static_cast<int>(cpu);
+    }
+    topology.nodes.push_back(std::move(cpus));
+  }
+  return topology;
+}
+
+std::size_t CpuTopology::cpuCount() const {
+  std::size_t count = 0;
+  for (const auto &cpus : nodes) {
+    count += cpus.size();
+  }
+  return count;
+}
+
+std::vector<CpuTopology::Placement>
+CpuTopology::placeWorkers(std::size_t workers) const {
+  std::vector<Placement> placement;
+  const std::size_t cpus = cpuCount();
+  if (cpus == 0) {
+    return placement;
+  }
+  placement.reserve(workers);
+  // Worker w is pinned to CPU w * cpus / workers of the nodes put end to
+  // end, which spreads the workers evenly when there are fewer than CPUs
+  std::size_t node = 0;
+  std::size_t nodeStart = 0;
+  for (std::size_t worker = 0; worker < workers; ++worker) {
+    const std::size_t position = worker * cpus / workers;
+    while (position >= nodeStart + nodes[node].size()) {
+      nodeStart += nodes[node].size();
+      ++node;
+    }
+    placement.push_back(Placement{nodes[node][position - nodeStart], node});
+  }
+  return placement;
+}
+
+} // namespace engine
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
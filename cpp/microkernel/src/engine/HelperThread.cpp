@@ -0,0 +1,76 @@
+#include "engine/HelperThread.h"
+#include <stdexcept>
+#include <utility>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace engine {
+
+HelperThread::HelperThread() : thread([this]() { loop(); }) {}
+
+HelperThread::~HelperThread() {
+  wait();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  changed.notify_all();
+  thread.join();
+}
+
+void HelperThread::loop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    changed.wait(lock, [this]() { return stopping || (pending && running); });
+    if (stopping) {
+      return;
+    }
+    std::function<void()> body = std::move(task);
+    lock.unlock();
+    std::exception_ptr thrown;
+    try {
+      body();
+    } catch (...) {
+      thrown = std::current_exception();
+    }
+    lock.lock();
+    error = thrown;
+    running = false;
+    changed.notify_all();
+  }
+}
+
+void HelperThread::start(std::function<void()> body) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (pending) {
+      throw std::logic_error("The previous task of the helper thread was "
+                             "not waited for");
+    }
+    task = std::move(body);
+    error = nullptr;
+    pending = true;
+    running = true;
+  }
+  changed.notify_all();
+}
+
+std::exception_ptr HelperThread::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (!pending) {
+    return nullptr;
+  }
+  changed.wait(lock, [this]() { return !running; });
+  pending = false;
+  return std::exchange(error, nullptr);
+}
+
+} // namespace engine
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -0,0 +1,127 @@
+#include "engine/ModelPlugin.h"
+#include "engine/MultiThreadedSimulationEngine.h"
+#include "engine/SequentialSimulationEngine.h"
+#include <dlfcn.h>
+#include <stdexcept>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace engine {
+
+namespace {
+
+std::string lastError() {
+  const char *error = dlerror();
+  return error ? error : "unknown error";
+}
+
+} // namespace
+
+ModelPlugin::ModelPlugin(const std::string &path) : path(path) {
+  handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL | RTLD_NODELETE);
+  if (handle == nullptr) {
+    throw std::runtime_error("ModelPlugin: cannot load " + path + ": " +
+                             lastError());
+  }
+  auto version =
+      reinterpret_cast<int (*)()>(dlsym(handle, "similar_plugin_abi_version"));
+  create = reinterpret_cast<ISimulationModel *(*)(const char *)>(
+      dlsym(handle, "similar_plugin_create_model"));
+  destroy = reinterpret_cast<void (*)(ISimulationModel *)>(
+      dlsym(handle, "similar_plugin_destroy_model"));
+  if (version == nullptr || create == nullptr || destroy == nullptr) {
+    dlclose(handle);
+    throw std::runtime_error("ModelPlugin: " + path +
+                             " is not a model plugin");
+  }
+  if (version() != ABI_VERSION) {
+    dlclose(handle);
+    throw std::runtime_error("ModelPlugin: " + path +
+                             " was built for another ABI version");
+  }
+  auto batchBehaviors =
+      reinterpret_cast<const ModelPluginBatchBehavior *(*)(std::size_t *)>(
+          dlsym(handle, "similar_plugin_batch_behaviors"));
+  if (batchBehaviors != nullptr) {
+    behaviors = batchBehaviors(&behaviorCount);
+    if (behaviors == nullptr) {
+      behaviorCount = 0;
+    }
+  }
+  auto pluginProbes =
+      reinterpret_cast<const ModelPluginProbe *(*)(std::size_t *)>(
+          dlsym(handle, "similar_plugin_probes"));
+  if (pluginProbes != nullptr) {
+    probes = pluginProbes(&probeCount);
+    if (probes == nullptr) {
+      probeCount = 0;
+    }
+  }
+}
+
+ModelPlugin::~ModelPlugin() { dlclose(handle); }
+
+std::shared_ptr<ISimulationModel>
+ModelPlugin::createModel(const std::string &arguments) const {
+  ISimulationModel *model = create(arguments.c_str());
+  if (model == nullptr) {
+    throw std::runtime_error("ModelPlugin: " + path +
+                             " made no model of the arguments \"" +
+                             arguments + "\"");
+  }
+  return std::shared_ptr<ISimulationModel>(model, destroy);
+}
+
+std::shared_ptr<IProbe>
+ModelPlugin::createProbe(const std::string &name,
+                         const std::string &arguments) const {
+  for (std::size_t i = 0; i < probeCount; ++i) {
+    if (name == probes[i].name) {
+      IProbe *probe = probes[i].create(arguments.c_str());
+      if (probe == nullptr) {
+        throw std::runtime_error("ModelPlugin: " + path + " made no probe " +
+                                 name + " of the arguments \"" + arguments +
+                                 "\"");
+      }
+      return std::shared_ptr<IProbe>(probe, probes[i].destroy);
+    }
+  }
+  throw std::invalid_argument("ModelPlugin: " + path + " has no probe " +
+                              name);
+}
+
+std::size_t ModelPlugin::installBatchBehaviors(ISimulationEngine &engine) const {
+  if (behaviorCount == 0) {
+    return 0;
+  }
+  auto *multiThreaded = dynamic_cast<MultiThreadedSimulationEngine *>(&engine);
+  auto *sequential = dynamic_cast<SequentialSimulationEngine *>(&engine);
+  if (multiThreaded == nullptr && sequential == nullptr) {
+    throw std::invalid_argument(
+        "ModelPlugin::installBatchBehaviors: the engine has no batch "
+        "behaviors");
+  }
+  for (std::size_t i = 0; i < behaviorCount; ++i) {
+    const ModelPluginBatchBehavior &exported = behaviors[i];
+    std::shared_ptr<ICategoryBatchBehavior> behavior(exported.create(),
+                                                     exported.destroy);
+    const AgentCategory category(exported.category);
+    const LevelIdentifier level(exported.level);
+    if (multiThreaded != nullptr) {
+      multiThreaded->setCategoryBatchBehavior(category, level, behavior);
+    } else {
+      sequential->setCategoryBatchBehavior(category, level, behavior);
+    }
+  }
+  return behaviorCount;
+}
+
+} // namespace engine
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -1,9 +1,19 @@
 #include "engine/MultiThreadedSimulationEngine.h"
+#include "engine/RewindBuffer.h"
 #include "IProbe.h"
 #include "agents/IPerceivedData.h"
+#include "agents/IScheduledAgent.h"
+#include "checkpoint/MappedFile.h"
 #include "environment/IEnvironment4Engine.h"
+#include "influences/system/SystemInfluenceAddAgent.h"
+#include "influences/system/SystemInfluenceAddAgentToLevel.h"
+#include "influences/system/SystemInfluenceRemoveAgent.h"
+#include "influences/system/SystemInfluenceRemoveAgentFromLevel.h"
+#include "libs/ExecutionTracer.h"
 #include <algorithm>
-#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <thread>
 
 namespace fr {
 namespace univ_artois {
@@ -12,6 +22,34 @@ namespace similar {
 namespace microkernel {
 namespace engine {
 
+namespace {
+using Clock = std::chrono::steady_clock;
+
+StepTimings::Duration elapsedSince(Clock::time_point start) {
+  return std::chrono::duration_cast<StepTimings::Duration>(Clock::now() -
+                                                            start);
+}
+
+/** The next activation time of an agent that decided until timeUpperBound */
+long nextActivationOf(const agents::IAgent4Engine &agent,
+                      const SimulationTimeStamp &timeUpperBound) {
+  const auto *scheduled = dynamic_cast<const agents::IScheduledAgent *>(&agent);
+  if (scheduled == nullptr) {
+    return timeUpperBound.getIdentifier();
+  }
+  return std::max(
+      scheduled->getNextActivationTime(timeUpperBound).getIdentifier(),
+      timeUpperBound.getIdentifier());
+}
+
+/** The condition waking an agent up before its next activation time */
+std::shared_ptr<const agents::IWakeCondition>
+wakeConditionOf(const agents::IAgent4Engine &agent) {
+  const auto *scheduled = dynamic_cast<const agents::IScheduledAgent *>(&agent);
+  return scheduled != nullptr ? scheduled->getWakeCondition() : nullptr;
+}
+} // namespace
+
 MultiThreadedSimulationEngine::MultiThreadedSimulationEngine(size_t numThreads)
     : numThreads(numThreads == 0 ? std::thread::hardware_concurrency()
                                  : numThreads),
@@ -19,8 +57,7 @@ MultiThreadedSimulationEngine::MultiThreadedSimulationEngine(size_t numThreads)
   if (this->numThreads == 0) {
     this->numThreads = 4; // Fallback if hardware_concurrency returns 0
   }
-  std::cout << "MultiThreadedSimulationEngine initialized with "
-            << this->numThreads << " threads" << std::endl;
+  threadPool = std::make_unique<WorkStealingThreadPool>(this->numThreads);
 
   dynamicStates = std::make_shared<PublicDynamicStateMap>();
 }
@@ -60,6 +97,9 @@ MultiThreadedSimulationEngine::getProbesIdentifiers() const {
 
 void MultiThreadedSimulationEngine::requestSimulationAbortion() {
   abortRequested = true;
+  if (stepBarrier) {
+    stepBarrier->interrupt();
+  }
 }
 
 // Getters implementation
@@ -70,7 +110,7 @@ MultiThreadedSimulationEngine::getSimulationDynamicStates() const {
 
 std::set<std::shared_ptr<agents::IAgent4Engine>>
 MultiThreadedSimulationEngine::getAgents() const {
-  return agents;
+  return AgentRegistry::toSet(agents.all());
 }
 
 std::set<LevelIdentifier>
@@ -89,11 +129,7 @@ MultiThreadedSimulationEngine::getLevels() const {
 
 std::set<std::shared_ptr<agents::IAgent4Engine>>
 MultiThreadedSimulationEngine::getAgents(const LevelIdentifier &level) const {
-  auto it = agentsByLevel.find(level);
-  if (it != agentsByLevel.end()) {
-    return it->second;
-  }
-  return {};
+  return AgentRegistry::toSet(agents.inLevel(level));
 }
 
 std::shared_ptr<environment::IEnvironment4Engine>
@@ -110,41 +146,195 @@ MultiThreadedSimulationEngine::disambiguation(
 
 void MultiThreadedSimulationEngine::runNewSimulation(
     std::shared_ptr<ISimulationModel> model) {
+  initializeSimulation(model);
+  startSimulation();
+}
 
+void MultiThreadedSimulationEngine::initializeSimulation(
+    std::shared_ptr<ISimulationModel> model) {
   abortRequested = false;
   currentModel = model;
+  // The steps kept belong to the previous run
+  if (rewindBuffer) {
+    rewindBuffer->clear();
+  }
 
   // Get initial time
   currentTime = model->getInitialTime();
 
-  // 1. Generate Levels
+  // The model may build its environment and its agents on our pool
+  auto agentInitData = [&] {
+    WorkStealingThreadPool::Scope lentPool(threadPool.get());
+    // 1. Generate Levels and 2. Environment
+    generateStructure(model);
+
+    // 3. Generate Agents
+    return model->generateAgents(currentTime, levels);
+  }();
+  agents.clear();
+  activationSchedule.clear();
+  stepsSinceReorder = 0;
+  for (const auto &agent : agentInitData.getAgents()) {
+    registerAgent(agent);
+  }
+
+  // 4. Initialize Dynamic States
+  for (const auto &pair : levels) {
+    pair.second->updateSpatialIndex();
+  }
+  publishConsistentStates();
+}
+
+void MultiThreadedSimulationEngine::startSimulation() {
+  if (!currentModel) {
+    throw std::runtime_error("Simulation has not been initialized.");
+  }
+
+  // Notify probes of initial time
+  for (const auto &schedule : observationSchedules) {
+    schedule.second->reset();
+  }
+  {
+    WorkStealingThreadPool::Scope lentPool(threadPool.get());
+    for (const auto &probe : probes) {
+      probe.second->observeAtInitialTimes(currentTime, *this);
+    }
+  }
+
+  // Main simulation loop
+  runSimulation(SimulationTimeStamp(std::numeric_limits<long>::max()));
+
+  // Notify probes of final time, e.g. for the exports to close their files
+  {
+    WorkStealingThreadPool::Scope lentPool(threadPool.get());
+    for (const auto &probe : probes) {
+      probe.second->observeAtFinalTime(currentTime, *this);
+      probe.second->endObservation();
+    }
+  }
+}
+
+void MultiThreadedSimulationEngine::generateStructure(
+    const std::shared_ptr<ISimulationModel> &model) {
   std::vector<std::shared_ptr<levels::ILevel>> levelsVector =
       model->generateLevels(currentTime);
   levels.clear();
-  std::map<LevelIdentifier, std::shared_ptr<levels::ILevel>> levelsMap;
-
   for (const auto &level : levelsVector) {
     levels[level->getIdentifier()] = level;
-    levelsMap[level->getIdentifier()] = level;
   }
 
-  // 2. Generate Environment
-  auto envInitData = model->generateEnvironment(currentTime, levelsMap);
+  indexLevels();
+
+  auto envInitData = model->generateEnvironment(currentTime, levels);
   environment = envInitData.getEnvironment();
+}
 
-  // 3. Generate Agents
-  auto agentInitData = model->generateAgents(currentTime, levelsMap);
-  agents.clear();
-  agentsByLevel.clear();
+void MultiThreadedSimulationEngine::setActivationScheduling(bool enabled) {
+  if (enabled && !categoryBatches.empty()) {
+    throw std::logic_error(
+        "The activation scheduling cannot step categories in batches");
+  }
+  if (enabled && !activationScheduling) {
+    // Every agent takes part in the next step, which tells when it is
+    // activated again.
+    activationSchedule.clear();
+    for (const auto &agent : agents.all()) {
+      activationSchedule.schedule(agents.slotOf(agent), agent,
+                                  currentTime.getIdentifier());
+    }
+  }
+  activationScheduling = enabled;
+}
 
-  for (const auto &agent : agentInitData.getAgents()) {
-    agents.insert(agent);
-    for (const auto &levelId : agent->getLevels()) {
-      agentsByLevel[levelId].insert(agent);
+void MultiThreadedSimulationEngine::setAgentOrdering(
+    std::shared_ptr<IAgentOrdering> ordering, size_t period) {
+  if (period == 0) {
+    throw std::invalid_argument("The agents cannot be sorted every 0 steps");
+  }
+  agentOrdering = std::move(ordering);
+  reorderPeriod = period;
+  stepsSinceReorder = 0;
+}
+
+void MultiThreadedSimulationEngine::setObservationSchedule(
+    const std::string &probeIdentifier,
+    std::shared_ptr<IObservationSchedule> schedule) {
+  if (schedule) {
+    observationSchedules.insert_or_assign(probeIdentifier,
+                                          std::move(schedule));
+  } else {
+    observationSchedules.erase(probeIdentifier);
+  }
+}
+
+std::shared_ptr<IObservationSchedule>
+MultiThreadedSimulationEngine::getObservationSchedule(
+    const std::string &probeIdentifier) const {
+  auto schedule = observationSchedules.find(probeIdentifier);
+  return schedule != observationSchedules.end() ? schedule->second : nullptr;
+}
+
+bool MultiThreadedSimulationEngine::setWorkerPinning(bool enabled) {
+  const bool applied = threadPool->setPlacement(
+      enabled ? CpuTopology::detect().placeWorkers(threadPool->size())
+              : std::vector<CpuTopology::Placement>());
+  workerPinning = enabled && applied;
+  return applied;
+}
+
+bool MultiThreadedSimulationEngine::setPerformanceCounting(bool enabled) {
+  const bool available =
+      !enabled || libs::PerformanceCounters().isAvailable();
+  performanceCounting = enabled && available;
+  return available;
+}
+
+void MultiThreadedSimulationEngine::setCategoryBatchBehavior(
+    const AgentCategory &category, const LevelIdentifier &level,
+    std::shared_ptr<ICategoryBatchBehavior> behavior) {
+  if (!behavior) {
+    categoryBatches.erase(category);
+    return;
+  }
+  if (activationScheduling) {
+    throw std::logic_error(
+        "The activation scheduling cannot step categories in batches");
+  }
+  categoryBatches.insert_or_assign(category,
+                                   CategoryBatch{level, std::move(behavior)});
+}
+
+std::shared_ptr<ICategoryBatchBehavior>
+MultiThreadedSimulationEngine::getCategoryBatchBehavior(
+    const AgentCategory &category) const {
+  auto batch = categoryBatches.find(category);
+  return batch != categoryBatches.end() ? batch->second.behavior : nullptr;
+}
+
+void MultiThreadedSimulationEngine::activateAgent(
+    const std::shared_ptr<agents::IAgent4Engine> &agent) {
+  if (agent) {
+    activationSchedule.request(agent);
+  }
+}
+
+void MultiThreadedSimulationEngine::registerAgent(
+    const std::shared_ptr<agents::IAgent4Engine> &agent) {
+  const size_t slot = agents.add(agent);
+  if (activationScheduling) {
+    activationSchedule.schedule(slot, agent, currentTime.getIdentifier());
+  }
+  for (const auto &levelId : agent->getLevels()) {
+    auto level = levels.find(levelId);
+    auto publicLocalState = agent->getPublicLocalState(levelId);
+    if (level != levels.end() && publicLocalState) {
+      level->second->getLastConsistentState()->addPublicLocalStateOfAgent(
+          publicLocalState);
     }
   }
+}
 
-  // 4. Initialize Dynamic States
+void MultiThreadedSimulationEngine::publishConsistentStates() {
   auto publicStateMap =
       std::dynamic_pointer_cast<PublicDynamicStateMap>(dynamicStates);
   if (!publicStateMap) {
@@ -153,17 +343,147 @@ void MultiThreadedSimulationEngine::runNewSimulation(
   }
 
   for (const auto &pair : levels) {
-    auto level = pair.second;
-    publicStateMap->put(level->getLastConsistentState());
+    publicStateMap->put(pair.second->getLastConsistentState());
   }
+}
 
-  // Notify probes of initial time
-  for (const auto &probe : probes) {
-    probe.second->observeAtInitialTimes(currentTime, *this);
+void MultiThreadedSimulationEngine::writeCheckpoint(
+    checkpoint::CheckpointWriter &writer,
+    const checkpoint::CheckpointSections &sections) const {
+  const AgentRegistry::View view = agents.all();
+  checkpoint::SimulationCheckpoint::write(
+      writer, currentTime, levels, environment.get(),
+      std::vector<AgentRegistry::AgentPtr>(view.begin(), view.end()),
+      sections);
+}
+
+void MultiThreadedSimulationEngine::saveCheckpoint(
+    const std::string &path,
+    const checkpoint::CheckpointSections &sections) const {
+  checkpoint::CheckpointWriter writer;
+  writeCheckpoint(writer, sections);
+  writer.saveTo(path);
+}
+
+void MultiThreadedSimulationEngine::restoreFrom(
+    checkpoint::CheckpointReader &reader,
+    const checkpoint::AgentFactory &agentFactory,
+    const checkpoint::CheckpointSections &sections) {
+  currentTime = currentModel->getInitialTime();
+  generateStructure(currentModel);
+
+  std::vector<AgentRegistry::AgentPtr> restoredAgents;
+  currentTime = checkpoint::SimulationCheckpoint::read(
+      reader, levels, environment.get(), agentFactory, sections,
+      restoredAgents);
+
+  agents.clear();
+  activationSchedule.clear();
+  for (const auto &agent : restoredAgents) {
+    registerAgent(agent);
   }
+  publishConsistentStates();
+}
 
-  // Main simulation loop
-  runSimulation(SimulationTimeStamp(std::numeric_limits<long>::max()));
+void MultiThreadedSimulationEngine::restoreCheckpoint(
+    std::shared_ptr<ISimulationModel> model, const std::string &path,
+    const checkpoint::AgentFactory &agentFactory,
+    const checkpoint::CheckpointSections &sections) {
+  abortRequested = false;
+  currentModel = model;
+  if (rewindBuffer) {
+    rewindBuffer->clear();
+  }
+
+  checkpoint::MappedFile file(path);
+  checkpoint::CheckpointReader reader = file.reader();
+  restoreFrom(reader, agentFactory, sections);
+}
+
+void MultiThreadedSimulationEngine::reactTo(
+    const SimulationTimeStamp &timeLowerBound,
+    const SimulationTimeStamp &timeUpperBound,
+    const std::vector<std::shared_ptr<levels::ILevel>> &reacting,
+    const checkpoint::InfluencesByLevel &influencesByLevel) {
+  {
+    WorkStealingThreadPool::Scope lentPool(threadPool.get());
+    for (size_t levelIndex = 0; levelIndex < reacting.size(); ++levelIndex) {
+      const auto &level = reacting[levelIndex];
+      level->makeRegularReaction(timeLowerBound, timeUpperBound,
+                                 level->getLastConsistentState(),
+                                 influencesByLevel[levelIndex],
+                                 std::make_shared<influences::InfluencesMap>());
+    }
+  }
+  publishConsistentStates();
+}
+
+void MultiThreadedSimulationEngine::replayInfluenceLog(
+    std::shared_ptr<ISimulationModel> model, const std::string &path,
+    const checkpoint::InfluenceCodecs &codecs,
+    const checkpoint::AgentFactory &agentFactory,
+    const checkpoint::CheckpointSections &sections,
+    const SimulationTimeStamp &finalTime) {
+  abortRequested = false;
+  currentModel = model;
+
+  checkpoint::InfluenceLogReader log(path, codecs);
+  checkpoint::CheckpointReader initial = log.initialCheckpoint();
+  restoreFrom(initial, agentFactory, sections);
+  // The influences of the log are indexed by the levels of the recording.
+  std::vector<std::shared_ptr<levels::ILevel>> logLevels;
+  for (const auto &levelId : log.getLevels()) {
+    auto level = levels.find(levelId);
+    if (level == levels.end()) {
+      throw checkpoint::CheckpointException("The model has no level '" +
+                                            levelId.toString() + "'.");
+    }
+    logLevels.push_back(level->second);
+  }
+
+  for (const auto &schedule : observationSchedules) {
+    schedule.second->reset();
+  }
+  {
+    WorkStealingThreadPool::Scope lentPool(threadPool.get());
+    for (const auto &probe : probes) {
+      probe.second->observeAtInitialTimes(currentTime, *this);
+    }
+  }
+
+  checkpoint::InfluenceLogReader::Record record;
+  while (!abortRequested && currentTime < finalTime && log.next(record)) {
+    SIMILAR_TRACE_SCOPE("engine", "replayed step");
+    if (record.kind == checkpoint::InfluenceLogReader::Record::Kind::KEY_FRAME) {
+      restoreFrom(record.checkpoint, agentFactory, sections);
+      continue;
+    }
+    checkpoint::InfluenceLogReader::restoreSections(record.sections,
+                                                    sections);
+    reactTo(record.timeLowerBound, record.timeUpperBound, logLevels,
+            record.influencesByLevel);
+    currentTime = record.timeUpperBound;
+
+    WorkStealingThreadPool::Scope lentPool(threadPool.get());
+    for (const auto &probe : probes) {
+      auto schedule = observationSchedules.find(probe.first);
+      if (schedule == observationSchedules.end() ||
+          schedule->second->isObservationDue(currentTime)) {
+        probe.second->observeAtPartialConsistentTime(currentTime, *this);
+      }
+    }
+  }
+
+  {
+    WorkStealingThreadPool::Scope lentPool(threadPool.get());
+    for (const auto &probe : probes) {
+      probe.second->observeAtFinalTime(currentTime, *this);
+      probe.second->endObservation();
+    }
+  }
+  if (abortRequested) {
+    throw ExceptionSimulationAborted("Simulation was aborted");
+  }
 }
 
 void MultiThreadedSimulationEngine::runSimulation(
@@ -172,99 +492,527 @@ void MultiThreadedSimulationEngine::runSimulation(
     throw std::runtime_error("Simulation has not been initialized.");
   }
 
-  // Build agent list for parallel processing
-  std::vector<std::shared_ptr<agents::IAgent4Engine>> agentsVector;
-  for (const auto &agent : agents) {
-    agentsVector.push_back(agent);
-  }
-
   auto publicStateMap =
       std::dynamic_pointer_cast<PublicDynamicStateMap>(dynamicStates);
 
+  // Whether the agents already perceived the current step, while the
+  // previous one was reacting.
+  bool perceivedAhead = false;
+
+  // Each worker counts its own thread, from the thread running this
+  // simulation for worker 0.
+  const bool counting = performanceCounting && stepTimingListener;
+  workerCounters.clear();
+  if (counting) {
+    workerCounters.resize(threadPool->size());
+    threadPool->forEachWorker([this](size_t worker) {
+      workerCounters[worker] = std::make_unique<libs::PerformanceCounters>();
+    });
+  }
+  auto readCounters = [this]() {
+    libs::CounterValues sum;
+    for (const auto &counters : workerCounters) {
+      sum += counters->read();
+    }
+    return sum;
+  };
+
   while (!currentModel->isFinalTimeOrAfter(currentTime, *this) &&
          !abortRequested && currentTime < finalTime) {
+    if (stepBarrier) {
+      stepBarrier->awaitStep(abortRequested);
+      if (abortRequested) {
+        break;
+      }
+    }
+    // What the agents perceived ahead predates a rewind
+    if (rewound.exchange(false)) {
+      perceivedAhead = false;
+    }
+    SIMILAR_TRACE_SCOPE("engine", "step");
 
     SimulationTimeStamp nextTime(currentTime, 1);
 
-    // Prepare results storage for parallel processing
-    std::vector<
-        std::map<LevelIdentifier, std::shared_ptr<influences::InfluencesMap>>>
-        agentInfluences(agentsVector.size());
+    for (auto &buffer : workerInfluences) {
+      buffer.clear();
+    }
+
+    if (influenceLog && !influenceLog->isStarted()) {
+      checkpoint::CheckpointWriter initialCheckpoint;
+      writeCheckpoint(initialCheckpoint, influenceLogSections);
+      std::vector<LevelIdentifier> levelIds;
+      for (const auto &level : indexedLevels) {
+        levelIds.push_back(level->getIdentifier());
+      }
+      influenceLog->start(levelIds, initialCheckpoint);
+    }
+
+    if (rewindBuffer && rewindBuffer->needsKeyFrame()) {
+      SIMILAR_TRACE_SCOPE("engine", "rewind snapshot");
+      rewindBuffer->addKeyFrame(takeSnapshot(), rewindSections);
+    }
+
+    if (agentOrdering && stepsSinceReorder++ % reorderPeriod == 0) {
+      agents.reorder([this](const agents::IAgent4Engine &agent) {
+        return agentOrdering->keyOf(agent);
+      });
+    }
+
+    // The agents taking part in the step.
+    AgentRegistry::View stepAgents = agents.all();
+    if (activationScheduling) {
+      const auto &activeAgents = activationSchedule.collect(
+          agents, currentTime.getIdentifier(),
+          [this](const agents::IWakeCondition &condition) {
+            return condition.isMet(currentTime, *dynamicStates);
+          });
+      stepAgents =
+          AgentRegistry::View(activeAgents.data(), activeAgents.size());
+    }
+
+    // The phases are timed only when someone listens to the timings.
+    const bool timed = static_cast<bool>(stepTimingListener);
+    StepTimings timings;
+    const Clock::time_point stepStart =
+        timed ? Clock::now() : Clock::time_point();
+    Clock::time_point phaseStart = stepStart;
+    const libs::CounterValues stepCounted =
+        counting ? readCounters() : libs::CounterValues();
+    libs::CounterValues phaseCounted = stepCounted;
+    // Ends the count of a phase and starts the one of the next
+    auto count = [&](libs::CounterValues StepTimings::PhaseCounters::*phase) {
+      if (counting) {
+        const libs::CounterValues now = readCounters();
+        timings.counters.*phase = now - phaseCounted;
+        phaseCounted = now;
+      }
+    };
+    if (timed) {
+      timings.counted = counting;
+      timings.timeLowerBound = currentTime;
+      timings.timeUpperBound = nextTime;
+      timings.threadCount = threadPool->size();
+      timings.agentCount = stepAgents.size();
+      for (auto &times : workerPhaseTimes) {
+        timings.perception += times.perceptionAhead;
+        times = WorkerPhaseTimes();
+      }
+    }
+
+    // Without activation scheduling, the agents of the step are the dense
+    // array of the registry, whose positions give the categories.
+    batchOfCategory.assign(agents.categoryCount(), nullptr);
+    for (const auto &entry : categoryBatches) {
+      const size_t category = agents.categoryIndexOf(entry.first);
+      if (category != AgentRegistry::NO_CATEGORY) {
+        batchOfCategory[category] = &entry.second;
+      }
+    }
+    // The level where an agent is stepped in a batch, or nullptr
+    auto batchedLevelOf = [&](size_t agentIndex) -> const LevelIdentifier * {
+      if (categoryBatches.empty()) {
+        return nullptr;
+      }
+      const CategoryBatch *batch =
+          batchOfCategory[agents.categoryIndexAt(agentIndex)];
+      return batch != nullptr ? &batch->level : nullptr;
+    };
+
+    // Moves the influences of a worker to its buffer, indexed by the dense
+    // index of their target level.
+    auto drainScratchMap = [&](size_t worker) {
+      auto &buffer = workerInfluences[worker];
+      workerScratchMaps[worker]->drain(
+          [&](const LevelIdentifier &target,
+              std::shared_ptr<influences::IInfluence> &&influence) {
+            const size_t *levelIndex = levelIndices.find(target);
+            if (levelIndex != nullptr) {
+              buffer.append(*levelIndex, std::move(influence));
+            }
+          });
+    };
+
+    // Steps the categories given a batch behavior, one chunk of their
+    // contiguous array at a time.
+    auto stepCategoryBatches = [&](bool perceiving, bool deciding) {
+      for (size_t category = 0; category < batchOfCategory.size();
+           ++category) {
+        const CategoryBatch *batch = batchOfCategory[category];
+        const AgentRegistry::View group = agents.inCategory(category);
+        if (batch == nullptr || group.empty()) {
+          continue;
+        }
+        threadPool->parallelFor(
+            group.size(), agentChunkSize,
+            [&](size_t begin, size_t end, size_t worker) {
+              if (abortRequested) {
+                return;
+              }
+              SIMILAR_TRACE_SCOPE("engine", "category batch chunk");
+              auto &times = workerPhaseTimes[worker];
+              Clock::time_point start =
+                  timed ? Clock::now() : Clock::time_point();
+              if (perceiving) {
+                batch->behavior->perceive(batch->level, currentTime, nextTime,
+                                          group.data() + begin, end - begin,
+                                          dynamicStates);
+                if (timed) {
+                  times.perception += elapsedSince(start);
+                  start = Clock::now();
+                }
+              }
+              if (deciding) {
+                influences::InfluenceArena::Scope arenaScope(
+                    *workerArenas[worker]);
+                batch->behavior->decide(batch->level, currentTime, nextTime,
+                                        group.data() + begin, end - begin,
+                                        workerScratchMaps[worker]);
+                drainScratchMap(worker);
+                if (timed) {
+                  times.decision += elapsedSince(start);
+                }
+              }
+            });
+      }
+    };
+
+    // The natural dynamics run on the helper thread, outside of the pool,
+    // while the workers perceive and decide; waited for before the
+    // reactions, or when the step is left.
+    struct NaturalJoin {
+      HelperThread *helper = nullptr;
+      ~NaturalJoin() {
+        if (helper) {
+          helper->wait();
+        }
+      }
+    } naturalJoin;
+    if (naturalOverlap) {
+      if (!naturalHelper) {
+        naturalHelper = std::make_unique<HelperThread>();
+      }
+      naturalHelper->start([&]() {
+        SIMILAR_TRACE_SCOPE("engine", "natural dynamics");
+        for (const auto &level : indexedLevels) {
+          level->prepareNaturalDynamics(currentTime, nextTime);
+        }
+      });
+      naturalJoin.helper = naturalHelper.get();
+    }
+
+    // With a batch decision hook, every agent perceives before the hook
+    // decides for all of them, then the agents revise and decide.
+    const bool perceived = perceivedAhead || batchDecisionHook;
+    if (batchDecisionHook) {
+      if (!perceivedAhead) {
+        parallelProcess(
+            stepAgents, "perceive chunk",
+            [&](size_t worker, size_t agentIndex,
+                const std::shared_ptr<agents::IAgent4Engine> &agent) {
+              const Clock::time_point start =
+                  timed ? Clock::now() : Clock::time_point();
+              const LevelIdentifier *batchedLevel = batchedLevelOf(agentIndex);
+              for (const auto &levelId : agent->getLevels()) {
+                if (batchedLevel != nullptr && levelId == *batchedLevel) {
+                  continue;
+                }
+                agent->setPerceivedData(agent->perceive(
+                    levelId, currentTime, nextTime,
+                    agent->borrowPublicLocalStates(),
+                    agent->borrowPrivateLocalState(levelId), dynamicStates));
+              }
+              if (timed) {
+                workerPhaseTimes[worker].perception += elapsedSince(start);
+              }
+            });
+        stepCategoryBatches(true, false);
+      }
+      const Clock::time_point start =
+          timed ? Clock::now() : Clock::time_point();
+      batchDecisionHook->perceived(currentTime, nextTime, stepAgents.data(),
+                                   stepAgents.size());
+      if (timed) {
+        timings.decision += elapsedSince(start);
+      }
+    }
 
     // PARALLEL PERCEPTION AND DECISION
+    // Once an agent decided, it tells when it is activated again.
+    std::vector<long> &nextActivations = activationTimes;
+    nextActivations.assign(stepAgents.size(), nextTime.getIdentifier());
     parallelProcess(
-        agentsVector,
-        [&](size_t index, std::shared_ptr<agents::IAgent4Engine> agent) {
+        stepAgents, "decide chunk",
+        [&](size_t worker, size_t agentIndex,
+            const std::shared_ptr<agents::IAgent4Engine> &agent) {
+          auto &scratchMap = workerScratchMaps[worker];
+          auto &times = workerPhaseTimes[worker];
+          influences::InfluenceArena::Scope arenaScope(*workerArenas[worker]);
+          Clock::time_point mark = timed ? Clock::now() : Clock::time_point();
+          auto lap = [&](StepTimings::Duration &phase) {
+            if (timed) {
+              const Clock::time_point now = Clock::now();
+              phase +=
+                  std::chrono::duration_cast<StepTimings::Duration>(now - mark);
+              mark = now;
+            }
+          };
+          const LevelIdentifier *batchedLevel = batchedLevelOf(agentIndex);
           for (const auto &levelId : agent->getLevels()) {
-            // Perceive
-            auto perceived = agent->perceive(
-                levelId, currentTime, nextTime, agent->getPublicLocalStates(),
-                agent->getPrivateLocalState(levelId), dynamicStates);
-            agent->setPerceivedData(perceived);
-
-            // Revise Global State
-            // Note: getPerceivedData returns a map, but we just updated it.
-            // reviseGlobalState takes the whole map.
-            agent->reviseGlobalState(currentTime, nextTime,
-                                     agent->getPerceivedData(),
-                                     agent->getGlobalState());
-
-            // Decide
-            auto influences = std::make_shared<influences::InfluencesMap>();
-            agent->decide(levelId, currentTime, nextTime,
-                          agent->getGlobalState(),
-                          agent->getPublicLocalState(levelId),
-                          agent->getPrivateLocalState(levelId),
-                          perceived, // Use the one we just got
-                          influences);
-
-            agentInfluences[index][levelId] = influences;
+            if (batchedLevel != nullptr && levelId == *batchedLevel) {
+              continue;
+            }
+            // An agent with a step kernel perceives, revises and decides in
+            // one call to it, timed as a decision
+            const IAgentStepKernel *kernel =
+                perceived ? nullptr : agent->getStepKernel(levelId);
+            if (kernel != nullptr) {
+              agents::IAgent4Engine *stepped = agent.get();
+              kernel->step(levelId, currentTime, nextTime, &stepped, 1,
+                           dynamicStates, scratchMap);
+            } else {
+              // Perceive
+              std::shared_ptr<agents::IPerceivedData> perceivedData;
+              if (perceived) {
+                perceivedData = agent->borrowLastPerceivedData(levelId);
+              } else {
+                perceivedData = agent->perceive(
+                    levelId, currentTime, nextTime,
+                    agent->borrowPublicLocalStates(),
+                    agent->borrowPrivateLocalState(levelId), dynamicStates);
+                agent->setPerceivedData(perceivedData);
+              }
+              lap(times.perception);
+
+              // Revise Global State, from the map where the data were set
+              agent->reviseGlobalState(currentTime, nextTime,
+                                       agent->borrowPerceivedData(),
+                                       agent->borrowGlobalState());
+              lap(times.revision);
+
+              // Decide
+              agent->decide(levelId, currentTime, nextTime,
+                            agent->borrowGlobalState(),
+                            agent->borrowPublicLocalState(levelId),
+                            agent->borrowPrivateLocalState(levelId),
+                            std::move(perceivedData), scratchMap);
+            }
+
+            drainScratchMap(worker);
+            lap(times.decision);
+          }
+          if (activationScheduling) {
+            nextActivations[agentIndex] = nextActivationOf(*agent, nextTime);
           }
         });
+    stepCategoryBatches(!batchDecisionHook, true);
+
+    if (activationScheduling) {
+      for (size_t i = 0; i < stepAgents.size(); ++i) {
+        const size_t slot = agents.slotOf(stepAgents[i]);
+        activationSchedule.schedule(slot, stepAgents[i], nextActivations[i]);
+        // An agent skipping the next step may be woken up before.
+        if (nextActivations[i] > nextTime.getIdentifier()) {
+          activationSchedule.sleep(slot, stepAgents[i],
+                                   wakeConditionOf(*stepAgents[i]));
+        }
+      }
+    }
+
+    if (timed) {
+      timings.agentPhase = elapsedSince(phaseStart);
+      count(&StepTimings::PhaseCounters::agentPhase);
+      for (const auto &times : workerPhaseTimes) {
+        timings.perception += times.perception;
+        timings.revision += times.revision;
+        timings.decision += times.decision;
+        timings.workerBusy +=
+            times.perception + times.revision + times.decision;
+      }
+      phaseStart = Clock::now();
+    }
+
+    if (naturalJoin.helper) {
+      naturalJoin.helper = nullptr;
+      if (const std::exception_ptr naturalError = naturalHelper->wait()) {
+        std::rethrow_exception(naturalError);
+      }
+    }
 
     if (abortRequested)
       break;
 
-    // SEQUENTIAL REACTION PHASE
-    for (const auto &pair : levels) {
-      auto levelId = pair.first;
-      auto level = pair.second;
-
-      // Aggregate influences for this level
-      auto levelInfluences = std::make_shared<influences::InfluencesMap>();
-      for (const auto &agentMap : agentInfluences) {
-        auto it = agentMap.find(levelId);
-        if (it != agentMap.end()) {
-          levelInfluences->addAll(*it->second);
-        }
+    // REACTION PHASE
+    // Merge the worker buffers: each level reads the buffers of all the
+    // workers, without any lock since the buffers are no longer written.
+    // System influences are set aside for the structural update stage. The
+    // sets order the influences by address, which changes from run to run:
+    // the reaction models must not depend on their order.
+    const size_t levelCount = indexedLevels.size();
+    std::vector<std::set<std::shared_ptr<influences::IInfluence>>>
+        regularInfluencesByLevel(levelCount);
+    std::vector<std::vector<std::shared_ptr<influences::IInfluence>>>
+        systemInfluencesByLevel(levelCount);
+    threadPool->parallelFor(
+        levelCount, 1, [&](size_t begin, size_t end, size_t) {
+          SIMILAR_TRACE_SCOPE("engine", "influence merge");
+          for (size_t levelIndex = begin; levelIndex < end; ++levelIndex) {
+            auto &levelInfluences = regularInfluencesByLevel[levelIndex];
+            auto &levelSystemInfluences = systemInfluencesByLevel[levelIndex];
+            for (const auto &buffer : workerInfluences) {
+              for (const auto &influence : buffer.getInfluences(levelIndex)) {
+                if (influence->isSystem()) {
+                  levelSystemInfluences.push_back(influence);
+                } else {
+                  levelInfluences.insert(influence);
+                }
+              }
+            }
+          }
+        });
+
+    if (influenceLog) {
+      SIMILAR_TRACE_SCOPE("engine", "influence log");
+      influenceLog->writeStep(currentTime, nextTime, influenceLogSections,
+                              regularInfluencesByLevel);
+    }
+    if (rewindBuffer) {
+      SIMILAR_TRACE_SCOPE("engine", "rewind delta");
+      rewindBuffer->addStep(currentTime, nextTime, rewindSections,
+                            regularInfluencesByLevel);
+    }
+
+    if (timed) {
+      for (size_t levelIndex = 0; levelIndex < levelCount; ++levelIndex) {
+        timings.influenceCount += regularInfluencesByLevel[levelIndex].size() +
+                                  systemInfluencesByLevel[levelIndex].size();
       }
+      timings.merge = elapsedSince(phaseStart);
+      count(&StepTimings::PhaseCounters::merge);
+      phaseStart = Clock::now();
+    }
 
-      // Apply reaction on the Level
-      auto consistentState = level->getLastConsistentState();
+    auto react = [&](size_t levelIndex) {
+      SIMILAR_TRACE_SCOPE("engine", "level reaction");
+      const auto &level = indexedLevels[levelIndex];
+      auto remainingInfluences = std::make_shared<influences::InfluencesMap>();
+      level->makeRegularReaction(currentTime, nextTime,
+                                 level->getLastConsistentState(),
+                                 regularInfluencesByLevel[levelIndex],
+                                 remainingInfluences);
+    };
+
+    const bool hasSystemInfluences = std::any_of(
+        systemInfluencesByLevel.begin(), systemInfluencesByLevel.end(),
+        [](const auto &influences) { return !influences.empty(); });
+    const SimulationTimeStamp followingTime(nextTime, 1);
+    perceivedAhead = pipelinedPerception && !activationScheduling &&
+                     categoryBatches.empty() && !hasSystemInfluences &&
+                     !abortRequested && nextTime < finalTime &&
+                     !currentModel->isFinalTimeOrAfter(nextTime, *this);
+
+    std::vector<size_t> concurrentLevels;
+    std::vector<size_t> sequentialLevels;
+    for (size_t levelIndex = 0; levelIndex < levelCount; ++levelIndex) {
+      if (parallelReaction && !perceivedAhead &&
+          isIndependentLevel(*indexedLevels[levelIndex])) {
+        concurrentLevels.push_back(levelIndex);
+      } else {
+        sequentialLevels.push_back(levelIndex);
+      }
+    }
 
-      // Extract regular influences for this level
-      // Note: getInfluencesForLevel returns std::list
-      std::list<std::shared_ptr<influences::IInfluence>> influenceList =
-          levelInfluences->getInfluencesForLevel(levelId);
+    if (perceivedAhead) {
+      reactWhilePerceiving(sequentialLevels, react, nextTime, followingTime);
+      sequentialLevels.clear();
+    } else if (concurrentLevels.size() > 1) {
+      // Independent levels only touch their own consistent state.
+      threadPool->parallelFor(concurrentLevels.size(), 1,
+                              [&](size_t begin, size_t end, size_t) {
+                                for (size_t i = begin; i < end; ++i) {
+                                  react(concurrentLevels[i]);
+                                }
+                              });
+    } else {
+      sequentialLevels.insert(sequentialLevels.begin(),
+                              concurrentLevels.begin(),
+                              concurrentLevels.end());
+    }
+    {
+      // The workers are idle during the sequential reactions: the reaction
+      // models can split their own loops over them.
+      WorkStealingThreadPool::Scope lentPool(threadPool.get());
+      for (size_t levelIndex : sequentialLevels) {
+        react(levelIndex);
+      }
+    }
 
-      std::set<std::shared_ptr<influences::IInfluence>> regularInfluences(
-          influenceList.begin(), influenceList.end());
+    if (timed) {
+      timings.reaction = elapsedSince(phaseStart);
+      count(&StepTimings::PhaseCounters::reaction);
+      phaseStart = Clock::now();
+    }
 
-      auto remainingInfluences = std::make_shared<influences::InfluencesMap>();
+    // STRUCTURAL UPDATES
+    {
+      SIMILAR_TRACE_SCOPE("engine", "structural update");
+      applySystemInfluences(systemInfluencesByLevel, currentTime, nextTime);
+    }
 
-      level->makeRegularReaction(currentTime, nextTime, consistentState,
-                                 regularInfluences, remainingInfluences);
+    // Release the influences of the step so that the arenas can rewind.
+    regularInfluencesByLevel.clear();
+    systemInfluencesByLevel.clear();
+    for (auto &buffer : workerInfluences) {
+      buffer.clear();
+    }
+    for (auto &arena : workerArenas) {
+      arena->reset();
+    }
 
-      // Update dynamic state map with new state
-      publicStateMap->put(level->getLastConsistentState());
+    // Update dynamic state map with the new states
+    for (const auto &pair : levels) {
+      publicStateMap->put(pair.second->getLastConsistentState());
     }
 
     // Advance time
     currentTime = nextTime;
 
-    // Notify probes
-    for (const auto &probe : probes) {
-      probe.second->observeAtPartialConsistentTime(currentTime, *this);
+    // The agents changed by the system influences are not in the log.
+    if (influenceLog && hasSystemInfluences) {
+      checkpoint::CheckpointWriter keyFrame;
+      writeCheckpoint(keyFrame, influenceLogSections);
+      influenceLog->writeKeyFrame(keyFrame);
+    }
+    if (rewindBuffer && hasSystemInfluences) {
+      rewindBuffer->requestKeyFrame();
+    }
+
+    if (timed) {
+      timings.structuralUpdate = elapsedSince(phaseStart);
+      count(&StepTimings::PhaseCounters::structuralUpdate);
+      phaseStart = Clock::now();
+    }
+
+    // Notify probes, which can split their own loops over the idle workers
+    {
+      SIMILAR_TRACE_SCOPE("engine", "probe dispatch");
+      WorkStealingThreadPool::Scope lentPool(threadPool.get());
+      for (const auto &probe : probes) {
+        auto schedule = observationSchedules.find(probe.first);
+        if (schedule == observationSchedules.end() ||
+            schedule->second->isObservationDue(currentTime)) {
+          probe.second->observeAtPartialConsistentTime(currentTime, *this);
+        }
+      }
+    }
+
+    if (timed) {
+      timings.probes = elapsedSince(phaseStart);
+      timings.total = elapsedSince(stepStart);
+      count(&StepTimings::PhaseCounters::probes);
+      if (counting) {
+        timings.counters.total = phaseCounted - stepCounted;
+      }
+      stepTimingListener->stepTimed(timings);
     }
 
     // Check final time again after update?
@@ -274,103 +1022,459 @@ void MultiThreadedSimulationEngine::runSimulation(
     }
   }
 
+  if (influenceLog) {
+    influenceLog->flush();
+  }
+
   if (abortRequested) {
     throw ExceptionSimulationAborted("Simulation was aborted");
   }
 }
 
 void MultiThreadedSimulationEngine::parallelPerception(
-    const std::vector<std::shared_ptr<agents::IAgent4Engine>> &agents,
+    AgentRegistry::View agents,
     SimulationTimeStamp timeLowerBound, SimulationTimeStamp timeUpperBound,
     std::shared_ptr<dynamicstate::IPublicDynamicStateMap> consistentState) {
   // Unused now
 }
 
 void MultiThreadedSimulationEngine::parallelDecision(
-    const std::vector<std::shared_ptr<agents::IAgent4Engine>> &agents,
+    AgentRegistry::View agents,
     SimulationTimeStamp timeLowerBound, SimulationTimeStamp timeUpperBound,
     std::shared_ptr<dynamicstate::IPublicDynamicStateMap> transitoryState) {
   // Unused now
 }
 
+void MultiThreadedSimulationEngine::indexLevels() {
+  levelIndices.clear();
+  indexedLevels.clear();
+  for (const auto &pair : levels) {
+    levelIndices[pair.first] = indexedLevels.size();
+    indexedLevels.push_back(pair.second);
+  }
+  perceptionDependencies.assign(indexedLevels.size(), {});
+  for (size_t levelIndex = 0; levelIndex < indexedLevels.size();
+       ++levelIndex) {
+    auto &dependencies = perceptionDependencies[levelIndex];
+    dependencies.push_back(levelIndex);
+    for (const auto &perceptible :
+         indexedLevels[levelIndex]->getPerceptibleLevels()) {
+      const size_t *perceptibleIndex = levelIndices.find(perceptible);
+      if (perceptibleIndex != nullptr && *perceptibleIndex != levelIndex) {
+        dependencies.push_back(*perceptibleIndex);
+      }
+    }
+  }
+  // Each worker allocates and first touches its own buffers
+  workerInfluences.assign(threadPool->size(), influences::InfluenceBuffer());
+  workerPhaseTimes.assign(threadPool->size(), WorkerPhaseTimes());
+  workerScratchMaps.assign(threadPool->size(), nullptr);
+  workerArenas.assign(threadPool->size(), nullptr);
+  const size_t levelCount = indexedLevels.size();
+  threadPool->forEachWorker([this, levelCount](size_t worker) {
+    workerInfluences[worker] = influences::InfluenceBuffer(levelCount);
+    workerPhaseTimes[worker] = WorkerPhaseTimes();
+    workerScratchMaps[worker] = std::make_shared<influences::InfluencesMap>();
+    workerArenas[worker] = std::make_shared<influences::InfluenceArena>();
+  });
+}
+
+void MultiThreadedSimulationEngine::applySystemInfluences(
+    const std::vector<std::vector<std::shared_ptr<influences::IInfluence>>>
+        &systemInfluencesByLevel,
+    SimulationTimeStamp timeLowerBound, SimulationTimeStamp timeUpperBound) {
+  using namespace influences::system;
+  std::vector<AgentRegistry::AgentPtr> removedAgents;
+  std::vector<AgentRegistry::AgentPtr> addedAgents;
+
+  auto consistentStateOf = [&](const LevelIdentifier &levelId) {
+    const size_t *levelIndex = levelIndices.find(levelId);
+    return levelIndex != nullptr
+               ? indexedLevels[*levelIndex]->getLastConsistentState()
+               : nullptr;
+  };
+  using StatePtr = std::shared_ptr<agents::ILocalStateOfAgent>;
+  auto addToLevel = [&](const LevelIdentifier &levelId, StatePtr state) {
+    auto consistentState = consistentStateOf(levelId);
+    if (consistentState && state) {
+      consistentState->addPublicLocalStateOfAgent(state);
+    }
+  };
+  auto removeFromLevel = [&](const LevelIdentifier &levelId, StatePtr state) {
+    auto consistentState = consistentStateOf(levelId);
+    if (consistentState && state) {
+      consistentState->removePublicLocalStateOfAgent(state);
+    }
+  };
+
+  // Agents changing levels are registered again once all the influences
+  // were applied.
+  auto changeLevels = [&](const AgentRegistry::AgentPtr &agent) {
+    if (agents.contains(agent)) {
+      removedAgents.push_back(agent);
+      addedAgents.push_back(agent);
+    }
+  };
+
+  for (size_t levelIndex = 0; levelIndex < systemInfluencesByLevel.size();
+       ++levelIndex) {
+    const auto &levelInfluences = systemInfluencesByLevel[levelIndex];
+    if (levelInfluences.empty()) {
+      continue;
+    }
+    for (const auto &influence : levelInfluences) {
+      const size_t tag = influence->getTypeTag();
+      if (tag == influences::influenceTypeTag<SystemInfluenceAddAgent>()) {
+        auto agent =
+            static_cast<const SystemInfluenceAddAgent &>(*influence).getAgent();
+        for (const auto &levelId : agent->getLevels()) {
+          addToLevel(levelId, agent->getPublicLocalState(levelId));
+        }
+        addedAgents.push_back(agent);
+      } else if (tag ==
+                 influences::influenceTypeTag<SystemInfluenceRemoveAgent>()) {
+        auto agent = static_cast<const SystemInfluenceRemoveAgent &>(*influence)
+                         .getAgent();
+        for (const auto &levelId : agent->getLevels()) {
+          removeFromLevel(levelId, agent->getPublicLocalState(levelId));
+        }
+        removedAgents.push_back(agent);
+      } else if (tag == influences::influenceTypeTag<
+                            SystemInfluenceAddAgentToLevel>()) {
+        const auto &addition =
+            static_cast<const SystemInfluenceAddAgentToLevel &>(*influence);
+        auto agent = addition.getPublicLocalState()->getOwner();
+        agent->includeNewLevel(addition.getTargetLevel(),
+                               addition.getPublicLocalState(),
+                               addition.getPrivateLocalState());
+        addToLevel(addition.getTargetLevel(), addition.getPublicLocalState());
+        changeLevels(agent);
+      } else if (tag == influences::influenceTypeTag<
+                            SystemInfluenceRemoveAgentFromLevel>()) {
+        const auto &removal =
+            static_cast<const SystemInfluenceRemoveAgentFromLevel &>(
+                *influence);
+        auto agent = removal.getAgentLocalState()->getOwner();
+        removeFromLevel(removal.getTargetLevel(),
+                        removal.getAgentLocalState());
+        agent->excludeFromLevel(removal.getTargetLevel());
+        changeLevels(agent);
+      }
+    }
+
+    // Let the level react to the system influences it received.
+    const auto &level = indexedLevels[levelIndex];
+    auto remainingInfluences = std::make_shared<influences::InfluencesMap>();
+    level->makeSystemReaction(timeLowerBound, timeUpperBound,
+                              level->getLastConsistentState(), levelInfluences,
+                              false, remainingInfluences);
+  }
+
+  // Births and deaths of the step, applied with one compaction per array.
+  if (!removedAgents.empty() || !addedAgents.empty()) {
+    agents.applyChanges(removedAgents, addedAgents);
+  }
+  // New agents and agents changing levels take part in the next step.
+  if (activationScheduling) {
+    for (const auto &agent : addedAgents) {
+      activationSchedule.schedule(agents.slotOf(agent), agent,
+                                  timeUpperBound.getIdentifier());
+    }
+  }
+}
+
+void MultiThreadedSimulationEngine::reactWhilePerceiving(
+    const std::vector<size_t> &reactionOrder,
+    const std::function<void(size_t)> &react,
+    SimulationTimeStamp perceptionLowerBound,
+    SimulationTimeStamp perceptionUpperBound) {
+  // An agent can perceive once every level it depends on reacted, i.e. once
+  // the number of reacted levels exceeds the greatest rank among them.
+  std::vector<size_t> reactionRank(indexedLevels.size(), 0);
+  for (size_t rank = 0; rank < reactionOrder.size(); ++rank) {
+    reactionRank[reactionOrder[rank]] = rank;
+  }
+  const AgentRegistry::View agentView = agents.all();
+  std::vector<std::pair<size_t, size_t>> perceptionOrder;
+  perceptionOrder.reserve(agentView.size());
+  for (size_t i = 0; i < agentView.size(); ++i) {
+    size_t requiredReactions = 0;
+    for (const auto &levelId : agentView[i]->getLevels()) {
+      const size_t *levelIndex = levelIndices.find(levelId);
+      if (levelIndex == nullptr) {
+        continue;
+      }
+      for (size_t dependency : perceptionDependencies[*levelIndex]) {
+        requiredReactions =
+            std::max(requiredReactions, reactionRank[dependency] + 1);
+      }
+    }
+    perceptionOrder.emplace_back(requiredReactions, i);
+  }
+  std::stable_sort(
+      perceptionOrder.begin(), perceptionOrder.end(),
+      [](const auto &a, const auto &b) { return a.first < b.first; });
+
+  auto publicStateMap =
+      std::dynamic_pointer_cast<PublicDynamicStateMap>(dynamicStates);
+  const bool timed = static_cast<bool>(stepTimingListener);
+  std::mutex reactionMutex;
+  std::condition_variable reactionDone;
+  size_t reactedLevels = 0;
+  std::exception_ptr reactionError;
+
+  // The reactions run outside of the pool, so that they progress even when
+  // every worker waits for them.
+  std::thread reactionThread([&]() {
+    try {
+      for (size_t levelIndex : reactionOrder) {
+        react(levelIndex);
+        const auto &level = indexedLevels[levelIndex];
+        publicStateMap->put(level->getLastConsistentState());
+        std::lock_guard<std::mutex> lock(reactionMutex);
+        ++reactedLevels;
+        reactionDone.notify_all();
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(reactionMutex);
+      reactionError = std::current_exception();
+      reactedLevels = reactionOrder.size();
+      reactionDone.notify_all();
+    }
+  });
+
+  try {
+    threadPool->parallelFor(
+        perceptionOrder.size(), agentChunkSize,
+        [&](size_t begin, size_t end, size_t worker) {
+          SIMILAR_TRACE_SCOPE("engine", "perceive ahead chunk");
+          for (size_t i = begin; i < end && !abortRequested; ++i) {
+            {
+              std::unique_lock<std::mutex> lock(reactionMutex);
+              reactionDone.wait(lock, [&]() {
+                return reactedLevels >= perceptionOrder[i].first;
+              });
+            }
+            const auto &agent = agentView[perceptionOrder[i].second];
+            const Clock::time_point start =
+                timed ? Clock::now() : Clock::time_point();
+            for (const auto &levelId : agent->getLevels()) {
+              agent->setPerceivedData(agent->perceive(
+                  levelId, perceptionLowerBound, perceptionUpperBound,
+                  agent->borrowPublicLocalStates(),
+                  agent->borrowPrivateLocalState(levelId), dynamicStates));
+            }
+            if (timed) {
+              workerPhaseTimes[worker].perceptionAhead += elapsedSince(start);
+            }
+          }
+        });
+  } catch (...) {
+    reactionThread.join();
+    throw;
+  }
+  reactionThread.join();
+  if (reactionError) {
+    std::rethrow_exception(reactionError);
+  }
+}
+
+bool MultiThreadedSimulationEngine::isIndependentLevel(
+    const levels::ILevel &level) {
+  for (const auto &influenced : level.getInfluenceableLevels()) {
+    if (influenced != level.getIdentifier()) {
+      return false;
+    }
+  }
+  return true;
+}
+
 template <typename Func>
 void MultiThreadedSimulationEngine::parallelProcess(
-    const std::vector<std::shared_ptr<agents::IAgent4Engine>> &agents,
-    Func processFunc) {
+    AgentRegistry::View agents, const char *traceName, Func processFunc) {
 
   if (agents.empty())
     return;
 
-  size_t agentsPerThread = (agents.size() + numThreads - 1) / numThreads;
-  std::vector<std::thread> threads;
+  threadPool->parallelFor(agents.size(), agentChunkSize,
+                          [&](size_t start, size_t end, size_t worker) {
+                            SIMILAR_TRACE_SCOPE("engine", traceName);
+                            for (size_t i = start; i < end && !abortRequested;
+                                 ++i) {
+                              processFunc(worker, i, agents[i]);
+                            }
+                          });
+}
 
-  for (size_t t = 0; t < numThreads; ++t) {
-    size_t start = t * agentsPerThread;
-    size_t end = std::min(start + agentsPerThread, agents.size());
+void MultiThreadedSimulationEngine::copyStateFrom(
+    const std::map<LevelIdentifier, std::shared_ptr<levels::ILevel>>
+        &sourceLevels,
+    const std::shared_ptr<environment::IEnvironment4Engine> &sourceEnvironment,
+    AgentRegistry::View sourceAgents) {
+  levels.clear();
+  for (const auto &pair : sourceLevels) {
+    levels[pair.first] = pair.second->clone();
+  }
+  indexLevels();
 
-    if (start >= agents.size())
-      break;
+  environment =
+      sourceEnvironment
+          ? std::dynamic_pointer_cast<environment::IEnvironment4Engine>(
+                sourceEnvironment->clone())
+          : nullptr;
 
-    threads.emplace_back([&, start, end]() {
-      for (size_t i = start; i < end && !abortRequested; ++i) {
-        processFunc(i, agents[i]);
-      }
-    });
+  // The consistent states of the cloned levels hold copies of the public
+  // local states of the agents, distinct from the ones of the cloned agents:
+  // they are replaced by the states of the cloned agents.
+  for (const auto &pair : levels) {
+    auto consistentState = pair.second->getLastConsistentState();
+    consistentState->clearPublicLocalStatesOfAgents();
+    if (environment && consistentState->getPublicLocalStateOfEnvironment()) {
+      consistentState->setPublicLocalStateOfEnvironment(
+          environment->getPublicLocalState(pair.first));
+    }
+  }
+  agents.clear();
+  activationSchedule.clear();
+  for (const auto &agent : sourceAgents) {
+    registerAgent(
+        std::dynamic_pointer_cast<agents::IAgent4Engine>(agent->clone()));
   }
 
-  // Wait for all threads to complete
-  for (auto &thread : threads) {
-    if (thread.joinable()) {
-      thread.join();
+  // The dynamic states are held by the levels: the map is filled from the
+  // cloned levels
+  publishConsistentStates();
+}
+
+std::shared_ptr<const MultiThreadedSimulationEngine::Snapshot>
+MultiThreadedSimulationEngine::takeSnapshot() const {
+  if (!currentModel) {
+    throw std::runtime_error("Simulation has not been initialized.");
+  }
+  auto snapshot = std::make_shared<Snapshot>();
+  for (const auto &pair : levels) {
+    snapshot->levels[pair.first] = pair.second->clone();
+  }
+  if (environment) {
+    snapshot->environment =
+        std::dynamic_pointer_cast<environment::IEnvironment4Engine>(
+            environment->clone());
+  }
+  snapshot->agents.reserve(agents.size());
+  for (const auto &agent : agents.all()) {
+    snapshot->agents.push_back(
+        std::dynamic_pointer_cast<agents::IAgent4Engine>(agent->clone()));
+  }
+  snapshot->time = currentTime;
+  return snapshot;
+}
+
+void MultiThreadedSimulationEngine::restoreSnapshot(const Snapshot &snapshot) {
+  // The snapshot is copied again, for it to be restored again later
+  copyStateFrom(snapshot.levels, snapshot.environment,
+                AgentRegistry::View(snapshot.agents.data(),
+                                    snapshot.agents.size()));
+  currentTime = snapshot.time;
+  rewound = true;
+}
+
+void MultiThreadedSimulationEngine::setRewindBuffer(
+    std::shared_ptr<RewindBuffer> buffer,
+    checkpoint::CheckpointSections sections) {
+  rewindBuffer = std::move(buffer);
+  rewindSections = std::move(sections);
+}
+
+SimulationTimeStamp
+MultiThreadedSimulationEngine::rewind(const SimulationTimeStamp &time) {
+  if (!rewindBuffer) {
+    throw std::logic_error("The engine has no rewind buffer.");
+  }
+  const RewindBuffer::Frame *frame = rewindBuffer->frameAt(time);
+  if (!frame) {
+    throw std::out_of_range("The time " + std::to_string(time.getIdentifier()) +
+                            " is no longer in the rewind buffer.");
+  }
+  restoreSnapshot(*frame->snapshot);
+  checkpoint::InfluenceLogReader::restoreSections(
+      checkpoint::CheckpointReader(frame->sections.getBytes().data(),
+                                   frame->sections.size()),
+      rewindSections);
+  std::vector<LevelIdentifier> levelIds;
+  for (const auto &level : indexedLevels) {
+    levelIds.push_back(level->getIdentifier());
+  }
+  checkpoint::InfluencesByLevel influencesByLevel;
+  for (const RewindBuffer::Step &step : frame->steps) {
+    if (time < step.timeUpperBound) {
+      break;
     }
+    checkpoint::CheckpointReader record(step.record.getBytes().data(),
+                                        step.record.size());
+    checkpoint::InfluenceLogReader::restoreSections(record.readBlock(),
+                                                    rewindSections);
+    rewindBuffer->getCodecs().read(record, levelIds, step.timeLowerBound,
+                                   step.timeUpperBound, influencesByLevel);
+    reactTo(step.timeLowerBound, step.timeUpperBound, indexedLevels,
+            influencesByLevel);
+    currentTime = step.timeUpperBound;
+  }
+  rewindBuffer->discardAfter(currentTime);
+
+  // The log goes on from the state reached
+  if (influenceLog && influenceLog->isStarted()) {
+    checkpoint::CheckpointWriter keyFrame;
+    writeCheckpoint(keyFrame, influenceLogSections);
+    influenceLog->writeKeyFrame(keyFrame);
   }
+
+  WorkStealingThreadPool::Scope lentPool(threadPool.get());
+  for (const auto &probe : probes) {
+    probe.second->observeAtPartialConsistentTime(currentTime, *this);
+  }
+  return currentTime;
+}
+
+std::shared_ptr<MultiThreadedSimulationEngine>
+MultiThreadedSimulationEngine::fork() const {
+  if (!currentModel) {
+    throw std::runtime_error("Simulation has not been initialized.");
+  }
+  return std::static_pointer_cast<MultiThreadedSimulationEngine>(clone());
 }
 
 std::shared_ptr<ISimulationEngine>
 MultiThreadedSimulationEngine::clone() const {
   auto clonedEngine =
       std::make_shared<MultiThreadedSimulationEngine>(this->numThreads);
+  clonedEngine->agentChunkSize = this->agentChunkSize;
+  clonedEngine->parallelReaction = this->parallelReaction;
+  clonedEngine->pipelinedPerception = this->pipelinedPerception;
+  clonedEngine->naturalOverlap = this->naturalOverlap;
+  clonedEngine->activationScheduling = this->activationScheduling;
+  clonedEngine->categoryBatches = this->categoryBatches;
+  clonedEngine->agentOrdering = this->agentOrdering;
+  clonedEngine->reorderPeriod = this->reorderPeriod;
+  if (this->workerPinning) {
+    clonedEngine->setWorkerPinning(true);
+  }
+  clonedEngine->performanceCounting = this->performanceCounting;
 
   // 1. Clone probes
   for (const auto &pair : this->probes) {
     clonedEngine->addProbe(pair.first, pair.second->clone());
   }
-
-  // 2. Clone levels
-  for (const auto &pair : this->levels) {
-    clonedEngine->levels[pair.first] = pair.second->clone();
-  }
-
-  // 3. Clone environment
-  if (this->environment) {
-    clonedEngine->environment =
-        std::dynamic_pointer_cast<environment::IEnvironment4Engine>(
-            this->environment->clone());
+  for (const auto &pair : this->observationSchedules) {
+    clonedEngine->observationSchedules[pair.first] = pair.second->clone();
   }
 
-  // 4. Clone agents
-  for (const auto &agent : this->agents) {
-    auto clonedAgent =
-        std::dynamic_pointer_cast<agents::IAgent4Engine>(agent->clone());
-    clonedEngine->agents.insert(clonedAgent);
-    for (const auto &levelId : clonedAgent->getLevels()) {
-      clonedEngine->agentsByLevel[levelId].insert(clonedAgent);
-    }
-  }
-
-  // 5. Clone dynamic states
-  // The dynamic states are held by the levels, so we just need to populate the
-  // map from the cloned levels
-  // We need to cast to PublicDynamicStateMap to use put() or ensure
-  // dynamicStates is initialized
-  auto publicStateMap = std::make_shared<PublicDynamicStateMap>();
-  clonedEngine->dynamicStates = publicStateMap;
-
-  for (const auto &pair : clonedEngine->levels) {
-    publicStateMap->put(pair.second->getLastConsistentState());
-  }
+  // 2. Clone the levels, the environment, the agents and the dynamic states
+  clonedEngine->copyStateFrom(this->levels, this->environment,
+                              this->agents.all());
 
-  // 6. Copy other fields
+  // 3. Copy other fields
+  clonedEngine->currentModel = this->currentModel;
+  clonedEngine->currentTime = this->currentTime;
   clonedEngine->abortRequested = this->abortRequested.load();
 
   return clonedEngine;
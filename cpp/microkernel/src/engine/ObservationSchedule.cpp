@@ -0,0 +1,74 @@
+#include "engine/ObservationSchedule.h"
+#include <stdexcept>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace engine {
+
+PeriodicObservationSchedule::PeriodicObservationSchedule(std::size_t period)
+    : period(period) {
+  if (period == 0) {
+    throw std::invalid_argument("The observation period has to be positive.");
+  }
+}
+
+bool PeriodicObservationSchedule::isObservationDue(
+    const SimulationTimeStamp &) {
+  if (++steps < period) {
+    return false;
+  }
+  steps = 0;
+  return true;
+}
+
+std::shared_ptr<IObservationSchedule>
+PeriodicObservationSchedule::clone() const {
+  return std::make_shared<PeriodicObservationSchedule>(period);
+}
+
+RateLimitedObservationSchedule::RateLimitedObservationSchedule(
+    Clock::duration interval)
+    : interval(interval) {
+  if (interval < Clock::duration::zero()) {
+    throw std::invalid_argument(
+        "The observation interval cannot be negative.");
+  }
+}
+
+bool RateLimitedObservationSchedule::isObservationDue(
+    const SimulationTimeStamp &) {
+  const Clock::time_point now = Clock::now();
+  if (observed && now - last < interval) {
+    return false;
+  }
+  observed = true;
+  last = now;
+  return true;
+}
+
+std::shared_ptr<IObservationSchedule>
+RateLimitedObservationSchedule::clone() const {
+  return std::make_shared<RateLimitedObservationSchedule>(interval);
+}
+
+bool TriggeredObservationSchedule::isObservationDue(
+    const SimulationTimeStamp &time) {
+  // A trigger is consumed by the next step, whether the condition holds
+  const bool event = triggered.exchange(false, std::memory_order_acq_rel);
+  return (condition && condition(time)) || event;
+}
+
+std::shared_ptr<IObservationSchedule>
+TriggeredObservationSchedule::clone() const {
+  return std::make_shared<TriggeredObservationSchedule>(condition);
+}
+
+} // namespace engine
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -0,0 +1,64 @@
+#include "engine/ParameterSweepRunner.h"
+#include <thread>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace engine {
+
+namespace {
+size_t resolveConcurrentRuns(size_t concurrentRuns) {
+  if (concurrentRuns == 0) {
+    concurrentRuns = std::thread::hardware_concurrency();
+  }
+  return concurrentRuns == 0 ? 1 : concurrentRuns;
+}
+} // namespace
+
+ParameterSweepRunner::ParameterSweepRunner(size_t concurrentRuns)
+    : threadPool(resolveConcurrentRuns(concurrentRuns)) {}
+
+std::vector<std::exception_ptr> ParameterSweepRunner::run(
+    std::shared_ptr<ISimulationModel> model, size_t variantCount,
+    const VariantFunction &setup, const VariantFunction &finish,
+    size_t threadsPerRun) {
+  MultiThreadedSimulationEngine engine(threadsPerRun == 0 ? 1
+                                                          : threadsPerRun);
+  engine.initializeSimulation(model);
+  return run(engine, variantCount, setup, finish);
+}
+
+std::vector<std::exception_ptr> ParameterSweepRunner::run(
+    const MultiThreadedSimulationEngine &engine, size_t variantCount,
+    const VariantFunction &setup, const VariantFunction &finish) {
+  std::vector<std::exception_ptr> errors(variantCount);
+  // One variant per chunk: their costs differ too much to be grouped.
+  threadPool.parallelFor(
+      variantCount, 1, [&](size_t begin, size_t end, size_t) {
+        for (size_t variant = begin; variant < end; ++variant) {
+          try {
+            auto fork = std::static_pointer_cast<MultiThreadedSimulationEngine>(
+                engine.clone());
+            if (setup) {
+              setup(variant, *fork);
+            }
+            fork->startSimulation();
+            if (finish) {
+              finish(variant, *fork);
+            }
+          } catch (...) {
+            errors[variant] = std::current_exception();
+          }
+        }
+      });
+  return errors;
+}
+
+} // namespace engine
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
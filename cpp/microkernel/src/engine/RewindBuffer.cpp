@@ -0,0 +1,173 @@
+#include "engine/RewindBuffer.h"
+
+#include <stdexcept>
+#include <utility>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace engine {
+
+RewindBuffer::RewindBuffer(std::size_t capacity, std::size_t keyFramePeriod,
+                           checkpoint::InfluenceCodecs codecs)
+    : capacity(capacity), keyFramePeriod(keyFramePeriod),
+      codecs(std::move(codecs)) {
+  if (keyFramePeriod == 0) {
+    throw std::invalid_argument("The key frame period must be at least 1.");
+  }
+}
+
+std::size_t RewindBuffer::bytesOf(const Frame &frame) {
+  std::size_t bytes = frame.sections.size();
+  for (const Step &step : frame.steps) {
+    bytes += step.record.size();
+  }
+  return bytes;
+}
+
+bool RewindBuffer::isEmpty() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return frames.empty();
+}
+
+SimulationTimeStamp RewindBuffer::getEarliestTime() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (frames.empty()) {
+    throw std::logic_error("The rewind buffer is empty.");
+  }
+  return frames.front().getTime();
+}
+
+SimulationTimeStamp RewindBuffer::getLatestTime() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (frames.empty()) {
+    throw std::logic_error("The rewind buffer is empty.");
+  }
+  return frames.back().getEndTime();
+}
+
+std::size_t RewindBuffer::getFrameCount() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return frames.size();
+}
+
+std::size_t RewindBuffer::getDeltaBytes() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return deltaBytes;
+}
+
+void RewindBuffer::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  frames.clear();
+  deltaBytes = 0;
+  keyFrameDue = false;
+}
+
+bool RewindBuffer::needsKeyFrame() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return frames.empty() || keyFrameDue ||
+         frames.back().stepCount >= keyFramePeriod;
+}
+
+void RewindBuffer::addKeyFrame(
+    std::shared_ptr<const MultiThreadedSimulationEngine::Snapshot> snapshot,
+    const checkpoint::CheckpointSections &sections) {
+  Frame frame;
+  frame.snapshot = std::move(snapshot);
+  checkpoint::InfluenceLogWriter::writeSections(frame.sections, sections);
+  const long time = frame.getTime().getIdentifier();
+
+  std::lock_guard<std::mutex> lock(mutex);
+  deltaBytes += bytesOf(frame);
+  frames.push_back(std::move(frame));
+  keyFrameDue = false;
+  // The second frame is enough to go back the capacity from the new one
+  while (frames.size() > 1 &&
+         frames[1].getTime().getIdentifier() +
+                 static_cast<long>(capacity) <=
+             time) {
+    deltaBytes -= bytesOf(frames.front());
+    frames.pop_front();
+  }
+}
+
+void RewindBuffer::addStep(
+    const SimulationTimeStamp &timeLowerBound,
+    const SimulationTimeStamp &timeUpperBound,
+    const checkpoint::CheckpointSections &sections,
+    const checkpoint::InfluencesByLevel &influencesByLevel) {
+  Step step;
+  bool recorded = !codecs.getCategories().empty();
+  if (recorded) {
+    step.timeLowerBound = timeLowerBound;
+    step.timeUpperBound = timeUpperBound;
+    checkpoint::CheckpointWriter sectionBlock;
+    checkpoint::InfluenceLogWriter::writeSections(sectionBlock, sections);
+    step.record.writeBlock(sectionBlock);
+    try {
+      codecs.write(step.record, influencesByLevel);
+    } catch (const checkpoint::CheckpointException &) {
+      recorded = false;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (frames.empty()) {
+    return;
+  }
+  Frame &frame = frames.back();
+  ++frame.stepCount;
+  if (codecs.getCategories().empty()) {
+    return;
+  }
+  // A delta only follows the state the frame reaches
+  if (!recorded || !(frame.getEndTime() == timeLowerBound)) {
+    keyFrameDue = true;
+    return;
+  }
+  deltaBytes += step.record.size();
+  frame.steps.push_back(std::move(step));
+}
+
+void RewindBuffer::requestKeyFrame() {
+  std::lock_guard<std::mutex> lock(mutex);
+  keyFrameDue = true;
+}
+
+const RewindBuffer::Frame *
+RewindBuffer::frameAt(const SimulationTimeStamp &time) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto frame = frames.rbegin(); frame != frames.rend(); ++frame) {
+    if (!(time < frame->getTime())) {
+      return &*frame;
+    }
+  }
+  return nullptr;
+}
+
+void RewindBuffer::discardAfter(const SimulationTimeStamp &time) {
+  std::lock_guard<std::mutex> lock(mutex);
+  while (!frames.empty() && time < frames.back().getTime()) {
+    deltaBytes -= bytesOf(frames.back());
+    frames.pop_back();
+  }
+  if (frames.empty()) {
+    return;
+  }
+  Frame &frame = frames.back();
+  while (!frame.steps.empty() && time < frame.steps.back().timeUpperBound) {
+    deltaBytes -= frame.steps.back().record.size();
+    frame.steps.pop_back();
+  }
+  frame.stepCount = frame.steps.size();
+  keyFrameDue = false;
+}
+
+} // namespace engine
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -1,9 +1,15 @@
 #include "../../include/engine/SequentialSimulationEngine.h"
 #include "../../include/dynamicstate/ConsistentPublicLocalDynamicState.h"
 #include "../../include/dynamicstate/IPublicDynamicStateMap.h"
+#include "../../include/LevelIndexedMap.h"
+#include "../../include/libs/ExecutionTracer.h"
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <limits>
+#include <queue>
+#include <utility>
 
 namespace fr {
 namespace univ_artois {
@@ -12,30 +18,32 @@ namespace similar {
 namespace microkernel {
 namespace engine {
 
+namespace {
+using Clock = std::chrono::steady_clock;
+
+StepTimings::Duration elapsedSince(Clock::time_point start) {
+  return std::chrono::duration_cast<StepTimings::Duration>(Clock::now() -
+                                                            start);
+}
+} // namespace
+
 // Helper class for Dynamic State Map
 class PublicDynamicStateMap : public dynamicstate::IPublicDynamicStateMap {
 private:
-  std::map<LevelIdentifier,
-           std::shared_ptr<dynamicstate::IPublicLocalDynamicState>>
+  LevelIndexedMap<std::shared_ptr<dynamicstate::IPublicLocalDynamicState>>
       states;
 
 public:
-  std::set<LevelIdentifier> keySet() const override {
-    std::set<LevelIdentifier> keys;
-    for (const auto &pair : states) {
-      keys.insert(pair.first);
-    }
-    return keys;
-  }
+  std::set<LevelIdentifier> keySet() const override { return states.keySet(); }
 
   std::shared_ptr<dynamicstate::IPublicLocalDynamicState>
   get(const LevelIdentifier &level) const override {
-    auto it = states.find(level);
-    if (it == states.end()) {
+    auto state = states.find(level);
+    if (state == nullptr) {
       throw std::out_of_range("Level not found in dynamic state map: " +
                               level.toString());
     }
-    return it->second;
+    return *state;
   }
 
   void
@@ -45,7 +53,8 @@ public:
 };
 
 SequentialSimulationEngine::SequentialSimulationEngine()
-    : abortionRequested(false), currentTime(0) {
+    : abortionRequested(false), currentTime(0),
+      influenceArena(std::make_shared<influences::InfluenceArena>()) {
   dynamicStates = std::make_shared<PublicDynamicStateMap>();
 }
 
@@ -83,6 +92,9 @@ std::set<std::string> SequentialSimulationEngine::getProbesIdentifiers() const {
 
 void SequentialSimulationEngine::requestSimulationAbortion() {
   abortionRequested = true;
+  if (stepBarrier) {
+    stepBarrier->interrupt();
+  }
 }
 
 void SequentialSimulationEngine::runNewSimulation(
@@ -146,6 +158,7 @@ void SequentialSimulationEngine::initializeSimulation(
     agents.insert(agent);
     for (const auto &levelId : agent->getLevels()) {
       agentsByLevel[levelId].insert(agent);
+      indexPublicLocalState(agent, levelId);
     }
   }
 
@@ -154,163 +167,318 @@ void SequentialSimulationEngine::initializeSimulation(
   // levels
   for (const auto &pair : levels) {
     auto level = pair.second;
+    level->updateSpatialIndex();
     dynamicStates->put(level->getLastConsistentState());
   }
 
   notifyProbesOfPreparation(initialTime);
 }
 
+void SequentialSimulationEngine::indexPublicLocalState(
+    const std::shared_ptr<agents::IAgent4Engine> &agent,
+    const LevelIdentifier &levelId) {
+  auto level = levels.find(levelId);
+  auto publicLocalState = agent->getPublicLocalState(levelId);
+  if (level == levels.end() || !publicLocalState) {
+    return;
+  }
+  level->second->getLastConsistentState()->addPublicLocalStateOfAgent(
+      publicLocalState);
+}
+
 void SequentialSimulationEngine::runSimulationLoop(
     const SimulationTimeStamp &finalTime) {
   // currentTime is already initialized
   notifyProbesOfStart(currentTime);
+  counters.reset();
+  if (performanceCounting && stepTimingListener) {
+    counters = std::make_unique<libs::PerformanceCounters>();
+  }
 
-  while (!abortionRequested && currentTime < finalTime) {
-    // 1. Determine next time step (minimum of all levels' next times)
-    // For simplicity, we assume all levels move in sync or we take the smallest
-    // step. A robust engine would handle multi-rate simulation. Here, we ask
-    // the first level for its next time (assuming single level or sync).
-    if (levels.empty())
-      break;
+  if (levels.empty()) {
+    notifyProbesOfEnd(currentTime);
+    return;
+  }
 
-    // Find the smallest next time across all levels
-    SimulationTimeStamp nextTime =
-        SimulationTimeStamp(std::numeric_limits<long long>::max());
-    bool hasNextTime = false;
+  // Each level advances at its own rate: the queue holds the next time of
+  // every level, and only the levels due at the earliest time are processed.
+  // The transitory period of a level spans from the time of its last
+  // consistent state to its next time.
+  using ScheduledLevel = std::pair<SimulationTimeStamp, LevelIdentifier>;
+  auto later = [](const ScheduledLevel &a, const ScheduledLevel &b) {
+    if (a.first != b.first) {
+      return b.first < a.first;
+    }
+    return b.second < a.second;
+  };
+  std::priority_queue<ScheduledLevel, std::vector<ScheduledLevel>,
+                      decltype(later)>
+      schedule(later);
+  for (const auto &pair : levels) {
+    SimulationTimeStamp levelTime =
+        pair.second->getLastConsistentState()->getTime();
+    schedule.emplace(pair.second->getNextTime(levelTime), pair.first);
+  }
 
-    for (const auto &pair : levels) {
-      SimulationTimeStamp levelNext = pair.second->getNextTime(currentTime);
-      if (!hasNextTime || levelNext < nextTime) {
-        nextTime = levelNext;
-        hasNextTime = true;
+  while (!currentModel->isFinalTimeOrAfter(currentTime, *this) &&
+         !abortionRequested && currentTime < finalTime && !schedule.empty()) {
+    if (stepBarrier) {
+      stepBarrier->awaitStep(abortionRequested);
+      if (abortionRequested) {
+        break;
       }
     }
+    SIMILAR_TRACE_SCOPE("engine", "step");
+    const SimulationTimeStamp nextTime = schedule.top().first;
 
-    if (!hasNextTime)
-      break; // Should not happen
-
-    // Ensure we don't go past finalTime if needed, but usually we run step by
-    // step. If nextTime > finalTime, should we stop? Yes.
+    // If nextTime > finalTime, the simulation stops.
     if (finalTime < nextTime) {
       break;
     }
 
-    // 2. Process each level
-    for (const auto &pair : levels) {
-      auto levelId = pair.first;
-      auto level = pair.second;
-
-      // A. Perception
-      // Agents perceive the CURRENT state (at currentTime)
-      for (const auto &agent : agentsByLevel[levelId]) {
-        // Get public local states of other agents in this level
-        std::map<LevelIdentifier, std::shared_ptr<agents::ILocalStateOfAgent>>
-            publicStates;
-        // This is expensive O(N^2), but correct for a reference implementation
-        for (const auto &otherAgent : agentsByLevel[levelId]) {
-          if (otherAgent != agent) {
-            try {
-              // In a real implementation, we'd filter by perception range/graph
-              // Here we assume full connectivity for simplicity or let the
-              // model handle it Actually, the agent's perceive method takes ALL
-              // public states. But we need to construct the map of maps? No,
-              // the interface expects: map<LevelIdentifier,
-              // shared_ptr<ILocalStateOfAgent>> publicLocalStates Wait, the
-              // interface `perceive` takes `publicLocalStates`. Is it the
-              // public states of THIS agent or OTHER agents? "publicLocalStates
-              // All the public local states of the agent." -> OF THE AGENT
-              // ITSELF.
-
-              // Ah, looking at IAgent.h:
-              // perceive(..., map<LevelIdentifier,
-              // shared_ptr<ILocalStateOfAgent>> &publicLocalStates, ...) "All
-              // the public local states of the agent."
-
-              // So the agent perceives the global environment + its own public
-              // states + dynamic states. It does NOT receive a list of other
-              // agents' states directly in the arguments? Wait, `dynamicStates`
-              // contains the level states. Where do agents see other agents?
-              // Usually via the Environment or the Level's dynamic state if it
-              // aggregates them. OR, the `publicLocalStates` argument is indeed
-              // its own states.
-
-              // Let's check IAgent.h again.
-              // "publicLocalStates All the public local states of the agent."
-
-              // So how does an agent perceive neighbors?
-              // Typically, the Environment provides this, or the Level.
-              // In SIMILAR, the `IPerceivedData` returned by `perceive` is what
-              // the agent "sees". The `perceive` method is where the agent
-              // *computes* what it sees. To do that, it needs access to the
-              // world. It has `dynamicStates`. Does `dynamicStates` contain
-              // agents? `IPublicLocalDynamicState` is the state of the LEVEL.
-              // If the level tracks agents, then yes.
-            } catch (...) {
-            }
-          }
-        }
-
-        auto perceivedData = agent->perceive(
-            levelId, currentTime, nextTime, agent->getPublicLocalStates(),
-            agent->getPrivateLocalState(levelId), dynamicStates);
+    // Process the levels due at nextTime, in identifier order.
+    std::vector<LevelIdentifier> dueLevels;
+    while (!schedule.empty() && schedule.top().first == nextTime) {
+      dueLevels.push_back(schedule.top().second);
+      schedule.pop();
+    }
+    // The phases are timed only when someone listens to the timings.
+    const bool timed = static_cast<bool>(stepTimingListener);
+    StepTimings timings;
+    const Clock::time_point stepStart =
+        timed ? Clock::now() : Clock::time_point();
+    const libs::CounterValues stepCounted =
+        counters ? counters->read() : libs::CounterValues();
+    if (timed) {
+      timings.counted = static_cast<bool>(counters);
+      timings.timeLowerBound = currentTime;
+      timings.timeUpperBound = nextTime;
+      timings.agentCount = agents.size();
+    }
+    for (const auto &levelId : dueLevels) {
+      auto level = levels.at(levelId);
+      processLevel(levelId, level,
+                   level->getLastConsistentState()->getTime(), nextTime,
+                   timed ? &timings : nullptr);
+      schedule.emplace(level->getNextTime(nextTime), levelId);
+    }
 
-        agent->setPerceivedData(perceivedData);
+    currentTime = nextTime;
+    const Clock::time_point probesStart =
+        timed ? Clock::now() : Clock::time_point();
+    const libs::CounterValues probesCounted =
+        counters ? counters->read() : libs::CounterValues();
+    notifyProbesOfUpdate(currentTime);
+    if (timed) {
+      timings.probes = elapsedSince(probesStart);
+      timings.total = elapsedSince(stepStart);
+      if (counters) {
+        const libs::CounterValues now = counters->read();
+        timings.counters.probes = now - probesCounted;
+        timings.counters.total = now - stepCounted;
       }
+      timings.workerBusy = timings.agentPhase;
+      stepTimingListener->stepTimed(timings);
+    }
+  }
 
-      // B. Decision
-      auto influences = std::make_shared<influences::InfluencesMap>();
-      for (const auto &agent : agentsByLevel[levelId]) {
-        // Revise global state first
-        agent->reviseGlobalState(currentTime, nextTime,
-                                 agent->getPerceivedData(),
-                                 agent->getGlobalState());
-
-        // Decide
-        agent->decide(levelId, currentTime, nextTime, agent->getGlobalState(),
-                      agent->getPublicLocalState(levelId),
-                      agent->getPrivateLocalState(levelId),
-                      agent->getPerceivedData()[levelId], // Assuming map access
-                      influences);
+  notifyProbesOfEnd(currentTime);
+}
+
+void SequentialSimulationEngine::processLevel(
+    const LevelIdentifier &levelId,
+    const std::shared_ptr<levels::ILevel> &level,
+    const SimulationTimeStamp &timeLowerBound,
+    const SimulationTimeStamp &timeUpperBound, StepTimings *timings) {
+  // Each phase adds its duration to the timings of the step, if any.
+  Clock::time_point mark = timings ? Clock::now() : Clock::time_point();
+  auto lap = [&](StepTimings::Duration StepTimings::*phase) {
+    if (timings) {
+      const Clock::time_point now = Clock::now();
+      timings->*phase +=
+          std::chrono::duration_cast<StepTimings::Duration>(now - mark);
+      mark = now;
+    }
+  };
+  const Clock::time_point agentPhaseStart = mark;
+  // Each counted phase adds its counts too
+  libs::CounterValues counted =
+      timings && counters ? counters->read() : libs::CounterValues();
+  auto count = [&](libs::CounterValues StepTimings::PhaseCounters::*phase) {
+    if (timings && counters) {
+      const libs::CounterValues now = counters->read();
+      timings->counters.*phase += now - counted;
+      counted = now;
+    }
+  };
+
+  // The influences of the previous level were released when its processing
+  // ended, so the arena can rewind before the agents decide.
+  influenceArena->reset();
+  influences::InfluenceArena::Scope arenaScope(*influenceArena);
+
+  // The agents giving a step kernel are stepped in batches by their kernel,
+  // the others through their methods.
+  for (auto &batch : kernelBatches) {
+    batch.second.clear();
+  }
+  virtualAgents.clear();
+  for (auto &batch : categoryBatches) {
+    batch.second.clear();
+  }
+  for (const auto &agent : agentsByLevel[levelId]) {
+    if (!categoryBehaviors.empty()) {
+      auto behavior = categoryBehaviors.find(agent->getCategory());
+      if (behavior != categoryBehaviors.end() &&
+          behavior->second.first == levelId) {
+        ICategoryBatchBehavior *stepping = behavior->second.second.get();
+        auto batch = std::find_if(
+            categoryBatches.begin(), categoryBatches.end(),
+            [stepping](const auto &batch) { return batch.first == stepping; });
+        if (batch == categoryBatches.end()) {
+          batch = categoryBatches.emplace(
+              categoryBatches.end(), stepping,
+              std::vector<std::shared_ptr<agents::IAgent4Engine>>());
+        }
+        batch->second.push_back(agent);
+        continue;
       }
+    }
+    const IAgentStepKernel *kernel = agent->getStepKernel(levelId);
+    if (kernel == nullptr) {
+      virtualAgents.push_back(&agent);
+      continue;
+    }
+    auto batch = std::find_if(
+        kernelBatches.begin(), kernelBatches.end(),
+        [kernel](const auto &batch) { return batch.first == kernel; });
+    if (batch == kernelBatches.end()) {
+      batch = kernelBatches.emplace(kernelBatches.end(), kernel,
+                                    std::vector<agents::IAgent4Engine *>());
+    }
+    batch->second.push_back(agent.get());
+  }
 
-      // C. Reaction (Environment Update)
-      // 1. Regular Reaction
-      // We need to collect ALL influences from ALL agents for this level.
-
-      auto levelInfluences = std::make_shared<influences::InfluencesMap>();
-      for (const auto &agent : agentsByLevel[levelId]) {
-        auto agentInfluences = std::make_shared<influences::InfluencesMap>();
-        agent->decide(levelId, currentTime, nextTime, agent->getGlobalState(),
-                      agent->getPublicLocalState(levelId),
-                      agent->getPrivateLocalState(levelId),
-                      agent->getPerceivedData()[levelId], agentInfluences);
-        levelInfluences->addAll(*agentInfluences);
+  // A. Perception
+  // Agents perceive the state at the beginning of the transitory period. The
+  // public local states of the agents lying in the level are indexed by its
+  // consistent state, so agents reach them through the dynamic states
+  // instead of having the engine gather them for each agent.
+  {
+    SIMILAR_TRACE_SCOPE("engine", "perceive");
+    for (const auto *agentPtr : virtualAgents) {
+      const auto &agent = *agentPtr;
+      auto perceivedData = agent->perceive(
+          levelId, timeLowerBound, timeUpperBound,
+          agent->borrowPublicLocalStates(),
+          agent->borrowPrivateLocalState(levelId), dynamicStates);
+
+      agent->setPerceivedData(std::move(perceivedData));
+    }
+    lap(&StepTimings::perception);
+    // The batches revise the global states as they perceive
+    for (const auto &batch : categoryBatches) {
+      if (!batch.second.empty()) {
+        batch.first->perceive(levelId, timeLowerBound, timeUpperBound,
+                              batch.second.data(), batch.second.size(),
+                              dynamicStates);
+      }
+    }
+  }
+  lap(&StepTimings::perception);
+
+  // B. Decision
+  auto levelInfluences = std::make_shared<influences::InfluencesMap>();
+  {
+    SIMILAR_TRACE_SCOPE("engine", "decide");
+    for (const auto *agentPtr : virtualAgents) {
+      const auto &agent = *agentPtr;
+      // Revise global state first
+      agent->reviseGlobalState(timeLowerBound, timeUpperBound,
+                               agent->borrowPerceivedData(),
+                               agent->borrowGlobalState());
+      lap(&StepTimings::revision);
+
+      agent->decide(levelId, timeLowerBound, timeUpperBound,
+                    agent->borrowGlobalState(),
+                    agent->borrowPublicLocalState(levelId),
+                    agent->borrowPrivateLocalState(levelId),
+                    agent->borrowLastPerceivedData(levelId), levelInfluences);
+      lap(&StepTimings::decision);
+    }
+    // The three phases of a kernel are timed as decisions
+    for (const auto &batch : kernelBatches) {
+      if (!batch.second.empty()) {
+        batch.first->step(levelId, timeLowerBound, timeUpperBound,
+                          batch.second.data(), batch.second.size(),
+                          dynamicStates, levelInfluences);
       }
+    }
+    for (const auto &batch : categoryBatches) {
+      if (!batch.second.empty()) {
+        batch.first->decide(levelId, timeLowerBound, timeUpperBound,
+                            batch.second.data(), batch.second.size(),
+                            levelInfluences);
+      }
+    }
+  }
+  lap(&StepTimings::decision);
+  if (timings) {
+    timings->agentPhase += elapsedSince(agentPhaseStart);
+  }
+  count(&StepTimings::PhaseCounters::agentPhase);
 
-      // Apply reaction on the Level
-      auto consistentState = level->getLastConsistentState();
+  // C. Reaction
+  auto consistentState = level->getLastConsistentState();
 
-      // Extract regular influences for this level
-      std::list<std::shared_ptr<influences::IInfluence>> influenceList =
-          levelInfluences->getInfluencesForLevel(levelId);
+  // Extract regular influences for this level
+  std::list<std::shared_ptr<influences::IInfluence>> influenceList =
+      levelInfluences->getInfluencesForLevel(levelId);
 
-      std::set<std::shared_ptr<influences::IInfluence>> regularInfluences(
-          influenceList.begin(), influenceList.end());
+  std::set<std::shared_ptr<influences::IInfluence>> regularInfluences(
+      influenceList.begin(), influenceList.end());
 
-      auto remainingInfluences = std::make_shared<influences::InfluencesMap>();
+  auto remainingInfluences = std::make_shared<influences::InfluencesMap>();
+  if (timings) {
+    timings->influenceCount += influenceList.size();
+  }
+  lap(&StepTimings::merge);
+  count(&StepTimings::PhaseCounters::merge);
+
+  {
+    SIMILAR_TRACE_SCOPE("engine", "level reaction");
+    level->makeRegularReaction(timeLowerBound, timeUpperBound,
+                               consistentState, regularInfluences,
+                               remainingInfluences);
+  }
 
-      level->makeRegularReaction(currentTime, nextTime, consistentState,
-                                 regularInfluences, remainingInfluences);
+  // The level is now consistent at the end of its transitory period
+  consistentState->setTime(timeUpperBound);
 
-      // Update dynamic state map with new state
-      dynamicStates->put(level->getLastConsistentState());
-    }
+  // Update dynamic state map with new state
+  dynamicStates->put(level->getLastConsistentState());
+  lap(&StepTimings::reaction);
+  count(&StepTimings::PhaseCounters::reaction);
+}
 
-    currentTime = nextTime;
-    notifyProbesOfUpdate(currentTime);
-  }
+void SequentialSimulationEngine::setStepTimingListener(
+    std::shared_ptr<IStepTimingListener> listener) {
+  stepTimingListener = std::move(listener);
+}
 
-  notifyProbesOfEnd(currentTime);
+std::shared_ptr<IStepTimingListener>
+SequentialSimulationEngine::getStepTimingListener() const {
+  return stepTimingListener;
+}
+
+void SequentialSimulationEngine::setStepBarrier(
+    std::shared_ptr<engine::StepBarrier> barrier) {
+  stepBarrier = std::move(barrier);
+}
+
+std::shared_ptr<engine::StepBarrier>
+SequentialSimulationEngine::getStepBarrier() const {
+  return stepBarrier;
 }
 
 // Probe notifications
@@ -320,6 +488,9 @@ void SequentialSimulationEngine::notifyProbesOfPreparation(
   for (auto &pair : probes) {
     pair.second->prepareObservation();
   }
+  for (auto &pair : observationSchedules) {
+    pair.second->reset();
+  }
 }
 
 void SequentialSimulationEngine::notifyProbesOfStart(
@@ -341,9 +512,14 @@ void SequentialSimulationEngine::notifyProbesOfEnd(
 
 void SequentialSimulationEngine::notifyProbesOfUpdate(
     const SimulationTimeStamp &time) {
+  SIMILAR_TRACE_SCOPE("engine", "probe dispatch");
   std::lock_guard<std::mutex> lock(probesMutex);
   for (auto &pair : probes) {
-    pair.second->observeAtPartialConsistentTime(time, *this);
+    auto schedule = observationSchedules.find(pair.first);
+    if (schedule == observationSchedules.end() ||
+        schedule->second->isObservationDue(time)) {
+      pair.second->observeAtPartialConsistentTime(time, *this);
+    }
   }
 }
 
@@ -374,11 +550,11 @@ SequentialSimulationEngine::getLevels() const {
 
 std::set<std::shared_ptr<agents::IAgent4Engine>>
 SequentialSimulationEngine::getAgents(const LevelIdentifier &level) const {
-  auto it = agentsByLevel.find(level);
-  if (it == agentsByLevel.end()) {
+  const auto *levelAgents = agentsByLevel.find(level);
+  if (levelAgents == nullptr) {
     return {};
   }
-  return it->second;
+  return *levelAgents;
 }
 
 std::shared_ptr<environment::IEnvironment4Engine>
@@ -397,13 +573,63 @@ SequentialSimulationEngine::disambiguation(
   return nullptr;
 }
 
+void SequentialSimulationEngine::setCategoryBatchBehavior(
+    const AgentCategory &category, const LevelIdentifier &level,
+    std::shared_ptr<ICategoryBatchBehavior> behavior) {
+  if (behavior) {
+    categoryBehaviors.insert_or_assign(
+        category, std::make_pair(level, std::move(behavior)));
+  } else {
+    categoryBehaviors.erase(category);
+  }
+}
+
+std::shared_ptr<ICategoryBatchBehavior>
+SequentialSimulationEngine::getCategoryBatchBehavior(
+    const AgentCategory &category) const {
+  auto behavior = categoryBehaviors.find(category);
+  return behavior != categoryBehaviors.end() ? behavior->second.second
+                                             : nullptr;
+}
+
+void SequentialSimulationEngine::setObservationSchedule(
+    const std::string &probeIdentifier,
+    std::shared_ptr<IObservationSchedule> schedule) {
+  std::lock_guard<std::mutex> lock(probesMutex);
+  if (schedule) {
+    observationSchedules.insert_or_assign(probeIdentifier,
+                                          std::move(schedule));
+  } else {
+    observationSchedules.erase(probeIdentifier);
+  }
+}
+
+std::shared_ptr<IObservationSchedule>
+SequentialSimulationEngine::getObservationSchedule(
+    const std::string &probeIdentifier) const {
+  auto schedule = observationSchedules.find(probeIdentifier);
+  return schedule != observationSchedules.end() ? schedule->second : nullptr;
+}
+
+bool SequentialSimulationEngine::setPerformanceCounting(bool enabled) {
+  const bool available =
+      !enabled || libs::PerformanceCounters().isAvailable();
+  performanceCounting = enabled && available;
+  return available;
+}
+
 std::shared_ptr<ISimulationEngine> SequentialSimulationEngine::clone() const {
   auto clonedEngine = std::make_shared<SequentialSimulationEngine>();
+  clonedEngine->categoryBehaviors = this->categoryBehaviors;
+  clonedEngine->performanceCounting = this->performanceCounting;
 
   // 1. Clone probes
   for (const auto &pair : this->probes) {
     clonedEngine->addProbe(pair.first, pair.second->clone());
   }
+  for (const auto &pair : this->observationSchedules) {
+    clonedEngine->observationSchedules[pair.first] = pair.second->clone();
+  }
 
   // 2. Clone levels
   for (const auto &pair : this->levels) {
@@ -0,0 +1,186 @@
+#include "engine/StepBarrier.h"
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace engine {
+
+void StepBarrier::notifyChange() {
+  ++generation;
+  changed.notify_all();
+}
+
+void StepBarrier::updatePeriod() {
+  period = stepsPerSecond > 0.0
+               ? std::chrono::duration_cast<Clock::duration>(
+                     std::chrono::duration<double>(
+                         1.0 / (stepsPerSecond * acceleration)))
+               : Clock::duration(0);
+  nextStep = Clock::time_point{};
+  statistics = PacingStatistics();
+  totalLatenessSeconds = 0.0;
+}
+
+void StepBarrier::awaitStep(const std::atomic<bool> &abortRequested) {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!abortRequested.load()) {
+    const std::uint64_t seen = generation;
+    if (paused) {
+      if (pendingSteps > 0) {
+        --pendingSteps;
+        return;
+      }
+      parked = true;
+      changed.wait(lock, [this, seen]() { return generation != seen; });
+      parked = false;
+      continue;
+    }
+    if (period.count() > 0) {
+      Clock::time_point now = Clock::now();
+      if (now < nextStep) {
+        const Clock::time_point wake = nextStep - spinThreshold;
+        if (now < wake) {
+          changed.wait_until(lock, wake,
+                             [this, seen]() { return generation != seen; });
+          continue;
+        }
+        // The last part of the wait spins, without the lock, so that the
+        // controls still get through
+        const Clock::time_point target = nextStep;
+        lock.unlock();
+        while (Clock::now() < target && !abortRequested.load()) {
+          std::this_thread::yield();
+        }
+        lock.lock();
+        if (generation != seen) {
+          continue;
+        }
+        now = Clock::now();
+      }
+      if (nextStep == Clock::time_point{}) {
+        // The first paced step starts the timeline
+        nextStep = now + period;
+        return;
+      }
+      const Clock::duration lateness = now - nextStep;
+      const double seconds = std::chrono::duration<double>(lateness).count();
+      ++statistics.steps;
+      totalLatenessSeconds += seconds;
+      statistics.meanLatenessSeconds =
+          totalLatenessSeconds / static_cast<double>(statistics.steps);
+      if (seconds > statistics.maxLatenessSeconds) {
+        statistics.maxLatenessSeconds = seconds;
+      }
+      if (lateness < period) {
+        nextStep += period;
+      } else {
+        // No burst to catch up with the steps a slow one delayed
+        ++statistics.resynchronizations;
+        nextStep = now + period;
+      }
+    }
+    return;
+  }
+}
+
+void StepBarrier::pause() {
+  std::lock_guard<std::mutex> lock(mutex);
+  paused = true;
+  pendingSteps = 0;
+  notifyChange();
+}
+
+void StepBarrier::resume() {
+  std::lock_guard<std::mutex> lock(mutex);
+  paused = false;
+  pendingSteps = 0;
+  notifyChange();
+}
+
+void StepBarrier::step(std::size_t count) {
+  std::lock_guard<std::mutex> lock(mutex);
+  paused = true;
+  pendingSteps += count;
+  notifyChange();
+}
+
+void StepBarrier::setStepRate(double stepsPerSecond) {
+  if (!(stepsPerSecond >= 0.0)) {
+    throw std::invalid_argument("The step rate must be a non-negative number.");
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  this->stepsPerSecond = stepsPerSecond;
+  updatePeriod();
+  notifyChange();
+}
+
+double StepBarrier::getStepRate() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return stepsPerSecond;
+}
+
+void StepBarrier::setAcceleration(double factor) {
+  if (!(factor > 0.0) || !std::isfinite(factor)) {
+    throw std::invalid_argument("The acceleration must be a positive number.");
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  acceleration = factor;
+  updatePeriod();
+  notifyChange();
+}
+
+double StepBarrier::getAcceleration() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return acceleration;
+}
+
+void StepBarrier::setSpinThreshold(std::chrono::nanoseconds threshold) {
+  if (threshold.count() < 0) {
+    throw std::invalid_argument("The spin threshold cannot be negative.");
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  spinThreshold = std::chrono::duration_cast<Clock::duration>(threshold);
+  notifyChange();
+}
+
+std::chrono::nanoseconds StepBarrier::getSpinThreshold() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(spinThreshold);
+}
+
+StepBarrier::PacingStatistics StepBarrier::getPacingStatistics() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return statistics;
+}
+
+bool StepBarrier::isPaused() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return paused;
+}
+
+bool StepBarrier::whileParked(const std::function<void()> &action) {
+  // The engine cannot leave its wait without the lock
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!parked) {
+    return false;
+  }
+  action();
+  return true;
+}
+
+void StepBarrier::interrupt() {
+  std::lock_guard<std::mutex> lock(mutex);
+  notifyChange();
+}
+
+} // namespace engine
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -0,0 +1,267 @@
+#include "engine/WorkStealingThreadPool.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace engine {
+
+WorkStealingThreadPool::WorkStealingThreadPool(size_t numThreads) {
+  if (numThreads == 0) {
+    numThreads = 1;
+  }
+  for (size_t i = 0; i < numThreads; ++i) {
+    queues.push_back(std::make_unique<WorkerQueue>());
+  }
+  buildVictims({});
+  // Worker 0 is the thread calling parallelFor.
+  for (size_t i = 1; i < numThreads; ++i) {
+    workers.emplace_back(&WorkStealingThreadPool::workerLoop, this, i);
+  }
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    stopping = true;
+  }
+  wakeCondition.notify_all();
+  for (auto &worker : workers) {
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+}
+
+void WorkStealingThreadPool::parallelFor(size_t count, size_t chunkSize,
+                                         const RangeFunction &body) {
+  if (count == 0) {
+    return;
+  }
+  const size_t numWorkers = queues.size();
+  if (chunkSize == 0) {
+    // Several chunks per worker leave room for stealing.
+    chunkSize = std::max<size_t>(1, count / (numWorkers * 8));
+  }
+  if (numWorkers == 1 || count <= chunkSize) {
+    body(0, count, 0);
+    return;
+  }
+
+  const size_t numChunks = (count + chunkSize - 1) / chunkSize;
+  firstError = nullptr;
+  currentBody = &body;
+  pendingChunks.store(numChunks, std::memory_order_release);
+
+  // Give each worker a contiguous block of chunks to preserve locality.
+  const size_t chunksPerWorker = (numChunks + numWorkers - 1) / numWorkers;
+  for (size_t w = 0; w < numWorkers; ++w) {
+    std::lock_guard<std::mutex> lock(queues[w]->mutex);
+    const size_t firstChunk = w * chunksPerWorker;
+    const size_t lastChunk = std::min(firstChunk + chunksPerWorker, numChunks);
+    for (size_t c = firstChunk; c < lastChunk; ++c) {
+      queues[w]->ranges.push_back(
+          {c * chunkSize, std::min((c + 1) * chunkSize, count)});
+    }
+  }
+
+  runJob();
+}
+
+void WorkStealingThreadPool::forEachWorker(
+    const std::function<void(size_t workerIndex)> &body) {
+  const size_t numWorkers = queues.size();
+  if (numWorkers == 1) {
+    body(0);
+    return;
+  }
+  const RangeFunction range = [&body](size_t begin, size_t, size_t) {
+    body(begin);
+  };
+  firstError = nullptr;
+  currentBody = &range;
+  pendingChunks.store(numWorkers, std::memory_order_release);
+  // Stealing stops before the chunks are queued, so that a worker only runs
+  // its own.
+  stealing.store(false);
+  for (size_t w = 0; w < numWorkers; ++w) {
+    std::lock_guard<std::mutex> lock(queues[w]->mutex);
+    queues[w]->ranges.push_back({w, w + 1});
+  }
+  try {
+    runJob();
+  } catch (...) {
+    stealing.store(true);
+    throw;
+  }
+  stealing.store(true);
+}
+
+void WorkStealingThreadPool::runJob() {
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    ++generation;
+  }
+  wakeCondition.notify_all();
+
+  runAvailableChunks(0);
+
+  {
+    std::unique_lock<std::mutex> lock(doneMutex);
+    doneCondition.wait(lock, [this]() {
+      return pendingChunks.load(std::memory_order_acquire) == 0;
+    });
+  }
+  currentBody = nullptr;
+
+  if (firstError) {
+    std::exception_ptr error = firstError;
+    firstError = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+bool WorkStealingThreadPool::setPlacement(
+    const std::vector<CpuTopology::Placement> &placement) {
+  const size_t numWorkers = queues.size();
+  if (!placement.empty() && placement.size() != numWorkers) {
+    throw std::invalid_argument(
+        "The placement must give the CPU of every worker");
+  }
+  bool pinned = true;
+#if defined(__linux__)
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  if (placement.empty()) {
+    // The threads get back the CPUs of the calling thread
+    pinned = sched_getaffinity(0, sizeof(cpus), &cpus) == 0;
+  }
+  for (size_t w = 1; w < numWorkers && pinned; ++w) {
+    if (!placement.empty()) {
+      CPU_ZERO(&cpus);
+      if (placement[w].cpu < 0 || placement[w].cpu >= CPU_SETSIZE) {
+        pinned = false;
+        break;
+      }
+      CPU_SET(placement[w].cpu, &cpus);
+    }
+    pinned = pthread_setaffinity_np(workers[w - 1].native_handle(),
+                                    sizeof(cpus), &cpus) == 0;
+  }
+#else
+  pinned = placement.empty();
+#endif
+  buildVictims(placement);
+  return pinned;
+}
+
+void WorkStealingThreadPool::buildVictims(
+    const std::vector<CpuTopology::Placement> &placement) {
+  // The workers of the node first, then the others, each in ring order
+  const size_t numWorkers = queues.size();
+  victims.assign(numWorkers, {});
+  for (size_t w = 0; w < numWorkers; ++w) {
+    for (int sameNode = 1; sameNode >= 0; --sameNode) {
+      for (size_t offset = 1; offset < numWorkers; ++offset) {
+        const size_t victim = (w + offset) % numWorkers;
+        const bool near =
+            placement.empty() || placement[victim].node == placement[w].node;
+        if (near == (sameNode == 1)) {
+          victims[w].push_back(victim);
+        }
+      }
+    }
+  }
+}
+
+void WorkStealingThreadPool::parallelForOnCurrent(size_t count,
+                                                  size_t chunkSize,
+                                                  const RangeFunction &body) {
+  WorkStealingThreadPool *pool = currentSlot();
+  Scope sequentialBody(nullptr);
+  if (pool == nullptr) {
+    if (count > 0) {
+      body(0, count, 0);
+    }
+    return;
+  }
+  pool->parallelFor(count, chunkSize, body);
+}
+
+void WorkStealingThreadPool::workerLoop(size_t workerIndex) {
+  unsigned long long seenGeneration = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(wakeMutex);
+      wakeCondition.wait(lock, [&]() {
+        return stopping || generation != seenGeneration;
+      });
+      if (stopping) {
+        return;
+      }
+      seenGeneration = generation;
+    }
+    runAvailableChunks(workerIndex);
+  }
+}
+
+bool WorkStealingThreadPool::popOrSteal(size_t workerIndex, Range &range) {
+  {
+    WorkerQueue &own = *queues[workerIndex];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.ranges.empty()) {
+      range = own.ranges.back();
+      own.ranges.pop_back();
+      return true;
+    }
+  }
+  for (const size_t victimIndex : victims[workerIndex]) {
+    WorkerQueue &victim = *queues[victimIndex];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    // Read under the lock of the victim, for the chunks of forEachWorker() to
+    // be seen with it
+    if (!stealing.load()) {
+      return false;
+    }
+    if (!victim.ranges.empty()) {
+      range = victim.ranges.front();
+      victim.ranges.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingThreadPool::runAvailableChunks(size_t workerIndex) {
+  Range range{0, 0};
+  while (popOrSteal(workerIndex, range)) {
+    try {
+      (*currentBody)(range.begin, range.end, workerIndex);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(errorMutex);
+      if (!firstError) {
+        firstError = std::current_exception();
+      }
+    }
+    if (pendingChunks.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      std::lock_guard<std::mutex> lock(doneMutex);
+      doneCondition.notify_one();
+    }
+  }
+}
+
+} // namespace engine
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
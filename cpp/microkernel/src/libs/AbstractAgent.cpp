@@ -57,8 +57,8 @@ std::set<LevelIdentifier> AbstractAgent::getLevels() const {
   return levels;
 }
 
-std::shared_ptr<agents::ILocalStateOfAgent>
-AbstractAgent::getPublicLocalState(const LevelIdentifier &levelId) const {
+const std::shared_ptr<agents::ILocalStateOfAgent> &
+AbstractAgent::borrowPublicLocalState(const LevelIdentifier &levelId) const {
   auto it = publicLocalStates.find(levelId);
   if (it == publicLocalStates.end()) {
     throw std::out_of_range(
@@ -68,13 +68,18 @@ AbstractAgent::getPublicLocalState(const LevelIdentifier &levelId) const {
   return it->second;
 }
 
+std::shared_ptr<agents::ILocalStateOfAgent>
+AbstractAgent::getPublicLocalState(const LevelIdentifier &levelId) const {
+  return borrowPublicLocalState(levelId);
+}
+
 std::map<LevelIdentifier, std::shared_ptr<agents::ILocalStateOfAgent>>
 AbstractAgent::getPublicLocalStates() const {
   return this->publicLocalStates;
 }
 
-std::shared_ptr<agents::ILocalStateOfAgent>
-AbstractAgent::getPrivateLocalState(const LevelIdentifier &levelId) const {
+const std::shared_ptr<agents::ILocalStateOfAgent> &
+AbstractAgent::borrowPrivateLocalState(const LevelIdentifier &levelId) const {
   auto it = privateLocalStates.find(levelId);
   if (it == privateLocalStates.end()) {
     throw std::out_of_range(
@@ -84,6 +89,11 @@ AbstractAgent::getPrivateLocalState(const LevelIdentifier &levelId) const {
   return it->second;
 }
 
+std::shared_ptr<agents::ILocalStateOfAgent>
+AbstractAgent::getPrivateLocalState(const LevelIdentifier &levelId) const {
+  return borrowPrivateLocalState(levelId);
+}
+
 void AbstractAgent::includeNewLevel(
     const LevelIdentifier &levelIdentifier,
     std::shared_ptr<agents::ILocalStateOfAgent> publicLocalState,
@@ -123,6 +133,19 @@ void AbstractAgent::setPerceivedData(
   this->lastPerceivedData[perceivedData->getLevel()] = perceivedData;
 }
 
+std::shared_ptr<agents::IPerceivedData> AbstractAgent::recyclePerceivedData(
+    const LevelIdentifier &levelIdentifier,
+    const SimulationTimeStamp &timeLowerBound,
+    const SimulationTimeStamp &timeUpperBound) {
+  auto it = lastPerceivedData.find(levelIdentifier);
+  // Held by this agent only, so that no reader sees the data change
+  if (it == lastPerceivedData.end() || it->second.use_count() != 1 ||
+      !it->second->reset(timeLowerBound, timeUpperBound)) {
+    return nullptr;
+  }
+  return it->second;
+}
+
 } // namespace libs
 } // namespace microkernel
 } // namespace similar
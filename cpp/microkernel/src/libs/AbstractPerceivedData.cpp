@@ -27,6 +27,13 @@ SimulationTimeStamp AbstractPerceivedData::getTransitoryPeriodMax() const {
   return transitoryPeriodMax;
 }
 
+void AbstractPerceivedData::setTransitoryPeriod(
+    const SimulationTimeStamp &transitoryPeriodMin,
+    const SimulationTimeStamp &transitoryPeriodMax) {
+  this->transitoryPeriodMin = transitoryPeriodMin;
+  this->transitoryPeriodMax = transitoryPeriodMax;
+}
+
 } // namespace libs
 } // namespace microkernel
 } // namespace similar
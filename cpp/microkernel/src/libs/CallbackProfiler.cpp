@@ -0,0 +1,84 @@
+#include "libs/CallbackProfiler.h"
+
+#include <deque>
+#include <mutex>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace libs {
+
+namespace {
+
+// The accounts, whose addresses stay valid as the deque grows at its end
+struct Registry {
+  std::mutex mutex;
+  std::deque<CallbackAccount> accounts;
+};
+
+Registry &registry() {
+  // Never destroyed, for the callbacks released while the process exits
+  static Registry *instance = new Registry();
+  return *instance;
+}
+
+} // namespace
+
+void CallbackAccount::reset() {
+  calls.store(0, std::memory_order_relaxed);
+  totalNanos.store(0, std::memory_order_relaxed);
+  lockWaitNanos.store(0, std::memory_order_relaxed);
+  conversionNanos.store(0, std::memory_order_relaxed);
+}
+
+CallbackProfile CallbackAccount::getProfile() const {
+  CallbackProfile profile;
+  profile.callback = callback;
+  profile.calls = calls.load(std::memory_order_relaxed);
+  profile.total =
+      CallbackProfile::Duration(totalNanos.load(std::memory_order_relaxed));
+  profile.lockWait =
+      CallbackProfile::Duration(lockWaitNanos.load(std::memory_order_relaxed));
+  profile.conversion = CallbackProfile::Duration(
+      conversionNanos.load(std::memory_order_relaxed));
+  return profile;
+}
+
+CallbackAccount &CallbackProfiler::account(const std::string &callback) {
+  Registry &accounts = registry();
+  std::lock_guard<std::mutex> lock(accounts.mutex);
+  for (auto &account : accounts.accounts) {
+    if (account.getCallback() == callback) {
+      return account;
+    }
+  }
+  return accounts.accounts.emplace_back(callback);
+}
+
+std::vector<CallbackProfile> CallbackProfiler::snapshot() {
+  Registry &accounts = registry();
+  std::lock_guard<std::mutex> lock(accounts.mutex);
+  std::vector<CallbackProfile> profiles;
+  profiles.reserve(accounts.accounts.size());
+  for (const auto &account : accounts.accounts) {
+    profiles.push_back(account.getProfile());
+  }
+  return profiles;
+}
+
+void CallbackProfiler::reset() {
+  Registry &accounts = registry();
+  std::lock_guard<std::mutex> lock(accounts.mutex);
+  for (auto &account : accounts.accounts) {
+    account.reset();
+  }
+}
+
+} // namespace libs
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -0,0 +1,178 @@
+#include "libs/ExecutionTracer.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace libs {
+
+namespace {
+
+std::int64_t nanosecondsOf(ExecutionTracer::Clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             time.time_since_epoch())
+      .count();
+}
+
+// Writes a string of JSON, escaping its quotes, backslashes and controls
+void writeJsonString(std::ostream &out, const char *text) {
+  out << '"';
+  for (const char *c = text; *c != '\0'; ++c) {
+    if (*c == '"' || *c == '\\') {
+      out << '\\' << *c;
+    } else if (static_cast<unsigned char>(*c) < 0x20) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", *c);
+      out << escaped;
+    } else {
+      out << *c;
+    }
+  }
+  out << '"';
+}
+
+// Writes nanoseconds as the microseconds of the trace format
+void writeMicroseconds(std::ostream &out, std::int64_t nanoseconds) {
+  char text[32];
+  std::snprintf(text, sizeof(text), "%.3f",
+                static_cast<double>(nanoseconds) / 1000.0);
+  out << text;
+}
+
+} // namespace
+
+ExecutionTracer::ExecutionTracer()
+    : epoch(nanosecondsOf(Clock::now())) {}
+
+ExecutionTracer &ExecutionTracer::global() {
+  static ExecutionTracer tracer;
+  return tracer;
+}
+
+void ExecutionTracer::setCapacity(std::size_t eventsPerThread) {
+  if (eventsPerThread == 0) {
+    throw std::invalid_argument("The capacity has to be positive.");
+  }
+  std::lock_guard<std::mutex> lock(buffersMutex);
+  capacity = eventsPerThread;
+}
+
+std::size_t ExecutionTracer::getCapacity() const {
+  std::lock_guard<std::mutex> lock(buffersMutex);
+  return capacity;
+}
+
+ExecutionTracer::ThreadBuffer &ExecutionTracer::bufferOfThisThread() {
+  // The buffers outlive their threads, so that the events of the workers
+  // of an engine are still read once it is destroyed.
+  thread_local std::shared_ptr<ThreadBuffer> buffer;
+  if (!buffer) {
+    buffer = std::make_shared<ThreadBuffer>();
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    buffer->ring.resize(capacity);
+    buffer->thread = static_cast<std::uint32_t>(buffers.size());
+    buffers.push_back(buffer);
+  }
+  return *buffer;
+}
+
+void ExecutionTracer::record(const char *category, const char *name,
+                             Clock::time_point start, Clock::time_point end) {
+  ThreadBuffer &buffer = bufferOfThisThread();
+  const std::int64_t begin = nanosecondsOf(start);
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+  Event &event = buffer.ring[buffer.next];
+  event.category = category;
+  event.name = name;
+  event.start = begin - epoch.load(std::memory_order_relaxed);
+  event.duration = nanosecondsOf(end) - begin;
+  event.thread = buffer.thread;
+  if (++buffer.next == buffer.ring.size()) {
+    buffer.next = 0;
+    buffer.full = true;
+  }
+}
+
+std::vector<ExecutionTracer::Event> ExecutionTracer::getEvents() const {
+  std::vector<Event> events;
+  std::lock_guard<std::mutex> lock(buffersMutex);
+  for (const auto &buffer : buffers) {
+    std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+    if (buffer->full) {
+      events.insert(events.end(), buffer->ring.begin() + buffer->next,
+                    buffer->ring.end());
+    }
+    events.insert(events.end(), buffer->ring.begin(),
+                  buffer->ring.begin() + buffer->next);
+  }
+  std::stable_sort(events.begin(), events.end(),
+                   [](const Event &a, const Event &b) {
+                     return a.start < b.start;
+                   });
+  return events;
+}
+
+void ExecutionTracer::clear() {
+  std::lock_guard<std::mutex> lock(buffersMutex);
+  for (const auto &buffer : buffers) {
+    std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+    buffer->ring.assign(capacity, Event());
+    buffer->next = 0;
+    buffer->full = false;
+  }
+  epoch.store(nanosecondsOf(Clock::now()));
+}
+
+void ExecutionTracer::writeChromeTrace(std::ostream &out) const {
+  const std::vector<Event> events = getEvents();
+  std::size_t threads;
+  {
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    threads = buffers.size();
+  }
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  bool first = true;
+  for (std::size_t thread = 0; thread < threads; ++thread) {
+    out << (first ? "" : ",") << "\n{\"ph\":\"M\",\"pid\":1,\"tid\":"
+        << thread << ",\"name\":\"thread_name\",\"args\":{\"name\":"
+        << "\"thread " << thread << "\"}}";
+    first = false;
+  }
+  for (const Event &event : events) {
+    out << (first ? "" : ",") << "\n{\"ph\":\"X\",\"pid\":1,\"tid\":"
+        << event.thread << ",\"cat\":";
+    writeJsonString(out, event.category);
+    out << ",\"name\":";
+    writeJsonString(out, event.name);
+    out << ",\"ts\":";
+    writeMicroseconds(out, event.start);
+    out << ",\"dur\":";
+    writeMicroseconds(out, event.duration);
+    out << '}';
+    first = false;
+  }
+  out << "\n]}\n";
+}
+
+void ExecutionTracer::writeChromeTrace(const std::string &path) const {
+  std::ofstream out(path);
+  if (!out) {
+    throw std::runtime_error("Cannot write the trace " + path + ".");
+  }
+  writeChromeTrace(out);
+  if (!out) {
+    throw std::runtime_error("Cannot write the trace " + path + ".");
+  }
+}
+
+} // namespace libs
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
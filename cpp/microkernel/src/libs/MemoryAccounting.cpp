@@ -0,0 +1,86 @@
+#include "libs/MemoryAccounting.h"
+
+#include <deque>
+#include <mutex>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace libs {
+
+namespace {
+
+// The accounts, whose addresses stay valid as the deque grows at its end
+struct Registry {
+  std::mutex mutex;
+  std::deque<MemoryAccount> accounts;
+};
+
+Registry &registry() {
+  // Never destroyed, for the containers released while the process exits
+  static Registry *instance = new Registry();
+  return *instance;
+}
+
+} // namespace
+
+MemoryUsage MemoryAccount::getUsage() const {
+  MemoryUsage usage;
+  usage.subsystem = subsystem;
+  usage.liveBytes = live.load(std::memory_order_relaxed);
+  usage.peakBytes = peak.load(std::memory_order_relaxed);
+  usage.allocations = allocations.load(std::memory_order_relaxed);
+  return usage;
+}
+
+MemoryAccount &MemoryAccounting::account(const std::string &subsystem) {
+  Registry &accounts = registry();
+  std::lock_guard<std::mutex> lock(accounts.mutex);
+  for (auto &account : accounts.accounts) {
+    if (account.getSubsystem() == subsystem) {
+      return account;
+    }
+  }
+  return accounts.accounts.emplace_back(subsystem);
+}
+
+std::vector<MemoryUsage> MemoryAccounting::snapshot() {
+  Registry &accounts = registry();
+  std::lock_guard<std::mutex> lock(accounts.mutex);
+  std::vector<MemoryUsage> usages;
+  usages.reserve(accounts.accounts.size());
+  for (const auto &account : accounts.accounts) {
+    usages.push_back(account.getUsage());
+  }
+  return usages;
+}
+
+MemoryUsage MemoryAccounting::usage(const std::string &subsystem) {
+  Registry &accounts = registry();
+  std::lock_guard<std::mutex> lock(accounts.mutex);
+  for (const auto &account : accounts.accounts) {
+    if (account.getSubsystem() == subsystem) {
+      return account.getUsage();
+    }
+  }
+  MemoryUsage none;
+  none.subsystem = subsystem;
+  return none;
+}
+
+void MemoryAccounting::resetPeaks() {
+  Registry &accounts = registry();
+  std::lock_guard<std::mutex> lock(accounts.mutex);
+  for (auto &account : accounts.accounts) {
+    account.resetPeak();
+  }
+}
+
+} // namespace libs
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -0,0 +1,112 @@
+#include "libs/PerformanceCounters.h"
+
+#if defined(__linux__)
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace libs {
+
+#if defined(__linux__)
+
+namespace {
+
+// The counters, in the order of the descriptors
+const std::uint64_t COUNTER_CONFIGS[4] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+int openCounter(std::uint64_t config, int groupLeader) {
+  perf_event_attr attributes;
+  std::memset(&attributes, 0, sizeof(attributes));
+  attributes.size = sizeof(attributes);
+  attributes.type = PERF_TYPE_HARDWARE;
+  attributes.config = config;
+  attributes.exclude_kernel = 1;
+  attributes.exclude_hv = 1;
+  attributes.read_format =
+      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  // The calling thread, on any processor
+  return static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1,
+                                  groupLeader, PERF_FLAG_FD_CLOEXEC));
+}
+
+// The value of a counter, scaled by the time the kernel counted it
+std::uint64_t readCounter(int descriptor) {
+  if (descriptor < 0) {
+    return 0;
+  }
+  std::uint64_t values[3] = {0, 0, 0};
+  if (::read(descriptor, values, sizeof(values)) !=
+          static_cast<ssize_t>(sizeof(values)) ||
+      values[2] == 0) {
+    return 0;
+  }
+  if (values[2] == values[1]) {
+    return values[0];
+  }
+  return static_cast<std::uint64_t>(static_cast<double>(values[0]) *
+                                    static_cast<double>(values[1]) /
+                                    static_cast<double>(values[2]));
+}
+
+} // namespace
+
+PerformanceCounters::PerformanceCounters() {
+  descriptors[0] = openCounter(COUNTER_CONFIGS[0], -1);
+  for (int i = 1; i < 4; ++i) {
+    descriptors[i] = descriptors[0] >= 0
+                         ? openCounter(COUNTER_CONFIGS[i], descriptors[0])
+                         : -1;
+  }
+}
+
+PerformanceCounters::~PerformanceCounters() {
+  // The members of the group close before their leader
+  for (int i = 3; i >= 0; --i) {
+    if (descriptors[i] >= 0) {
+      close(descriptors[i]);
+    }
+  }
+}
+
+CounterValues PerformanceCounters::read() const {
+  CounterValues values;
+  values.cycles = readCounter(descriptors[0]);
+  values.instructions = readCounter(descriptors[1]);
+  values.cacheMisses = readCounter(descriptors[2]);
+  values.branchMisses = readCounter(descriptors[3]);
+  return values;
+}
+
+bool PerformanceCounters::isSupported() { return true; }
+
+#else
+
+PerformanceCounters::PerformanceCounters() {
+  for (int &descriptor : descriptors) {
+    descriptor = -1;
+  }
+}
+
+PerformanceCounters::~PerformanceCounters() = default;
+
+CounterValues PerformanceCounters::read() const { return CounterValues(); }
+
+bool PerformanceCounters::isSupported() { return false; }
+
+#endif
+
+} // namespace libs
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -0,0 +1,308 @@
+#include "libs/SimulationMetrics.h"
+
+#include "libs/MemoryAccounting.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace libs {
+
+namespace {
+
+// The weight of the last period in the smoothed one
+constexpr double PERIOD_SMOOTHING = 0.2;
+
+std::int64_t steadyNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Writes the shortest text reading back as the value
+void writeNumber(std::ostream &out, double value) {
+  char text[32];
+  const auto end = std::to_chars(text, text + sizeof(text), value).ptr;
+  out.write(text, end - text);
+}
+
+// Writes a label value, escaped as the formats require
+void writeLabel(std::ostream &out, const std::string &value) {
+  for (const char c : value) {
+    switch (c) {
+    case '\\':
+      out << "\\\\";
+      break;
+    case '"':
+      out << "\\\"";
+      break;
+    case '\n':
+      out << "\\n";
+      break;
+    default:
+      out << c;
+    }
+  }
+}
+
+// Writes the HELP and TYPE lines of a family; the counters of the text
+// format of Prometheus are named with their _total suffix
+void writeFamily(std::ostream &out, const char *name, const char *type,
+                 const char *help, bool openMetrics) {
+  const bool suffixed = !openMetrics && std::string(type) == "counter";
+  out << "# HELP " << name << (suffixed ? "_total " : " ") << help << '\n';
+  out << "# TYPE " << name << (suffixed ? "_total " : " ") << type << '\n';
+}
+
+} // namespace
+
+const std::array<StepTimings::Duration StepTimings::*, 9>
+    SimulationMetrics::PHASES{
+        &StepTimings::perception,       &StepTimings::revision,
+        &StepTimings::decision,         &StepTimings::agentPhase,
+        &StepTimings::merge,            &StepTimings::reaction,
+        &StepTimings::structuralUpdate, &StepTimings::probes,
+        &StepTimings::total};
+
+const std::array<const char *, 9> SimulationMetrics::PHASE_NAMES{
+    "perception", "revision",          "decision",
+    "agent_phase", "merge",            "reaction",
+    "structural_update", "probes",     "total"};
+
+void SimulationMetrics::Histogram::observe(StepTimings::Duration duration) {
+  const double seconds = std::chrono::duration<double>(duration).count();
+  const std::size_t bucket = static_cast<std::size_t>(
+      std::lower_bound(BUCKET_BOUNDS.begin(), BUCKET_BOUNDS.end(), seconds) -
+      BUCKET_BOUNDS.begin());
+  buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  sumNanos.fetch_add(static_cast<std::uint64_t>(duration.count()),
+                     std::memory_order_relaxed);
+}
+
+void SimulationMetrics::Histogram::reset() {
+  for (auto &bucket : buckets) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  sumNanos.store(0, std::memory_order_relaxed);
+}
+
+SimulationMetrics::SimulationMetrics(std::shared_ptr<IStepTimingListener> next)
+    : next(std::move(next)) {}
+
+void SimulationMetrics::stepTimed(const StepTimings &timings) {
+  for (std::size_t phase = 0; phase < PHASES.size(); ++phase) {
+    histograms[phase].observe(timings.*PHASES[phase]);
+  }
+  steps.fetch_add(1, std::memory_order_relaxed);
+  influences.fetch_add(timings.influenceCount, std::memory_order_relaxed);
+  lastTime.store(timings.timeUpperBound.getIdentifier(),
+                 std::memory_order_relaxed);
+  agents.store(timings.agentCount, std::memory_order_relaxed);
+  stepInfluences.store(timings.influenceCount, std::memory_order_relaxed);
+  threads.store(timings.threadCount, std::memory_order_relaxed);
+  utilization.store(timings.threadUtilization(), std::memory_order_relaxed);
+
+  // Only the engine thread writes the period
+  const std::int64_t now = steadyNanos();
+  const std::int64_t previous =
+      lastStepEnd.exchange(now, std::memory_order_relaxed);
+  if (previous != 0) {
+    const double period = static_cast<double>(now - previous);
+    const double mean = meanPeriodNanos.load(std::memory_order_relaxed);
+    meanPeriodNanos.store(mean == 0 ? period
+                                    : mean + PERIOD_SMOOTHING * (period - mean),
+                          std::memory_order_relaxed);
+  }
+
+  if (next) {
+    next->stepTimed(timings);
+  }
+}
+
+void SimulationMetrics::addQueue(const std::string &name,
+                                 std::function<std::size_t()> depth) {
+  if (!depth) {
+    throw std::invalid_argument("The depth of the queue is required.");
+  }
+  std::lock_guard<std::mutex> lock(queueMutex);
+  for (Queue &queue : queues) {
+    if (queue.name == name) {
+      queue.depth = std::move(depth);
+      return;
+    }
+  }
+  queues.push_back(Queue{name, std::move(depth)});
+}
+
+void SimulationMetrics::removeQueue(const std::string &name) {
+  std::lock_guard<std::mutex> lock(queueMutex);
+  queues.erase(std::remove_if(queues.begin(), queues.end(),
+                              [&](const Queue &queue) {
+                                return queue.name == name;
+                              }),
+               queues.end());
+}
+
+double SimulationMetrics::getStepsPerSecond() const {
+  const double period = meanPeriodNanos.load(std::memory_order_relaxed);
+  const std::int64_t last = lastStepEnd.load(std::memory_order_relaxed);
+  if (period <= 0 ||
+      static_cast<double>(steadyNanos() - last) > std::max(4 * period, 1e9)) {
+    return 0.0;
+  }
+  return 1e9 / period;
+}
+
+std::vector<std::uint64_t>
+SimulationMetrics::getBucketCounts(const std::string &phase) const {
+  const auto name = std::find(PHASE_NAMES.begin(), PHASE_NAMES.end(), phase);
+  if (name == PHASE_NAMES.end()) {
+    throw std::invalid_argument("Unknown phase: " + phase);
+  }
+  const Histogram &histogram = histograms[name - PHASE_NAMES.begin()];
+  std::vector<std::uint64_t> counts;
+  std::uint64_t count = 0;
+  for (const auto &bucket : histogram.buckets) {
+    count += bucket.load(std::memory_order_relaxed);
+    counts.push_back(count);
+  }
+  return counts;
+}
+
+void SimulationMetrics::reset() {
+  for (Histogram &histogram : histograms) {
+    histogram.reset();
+  }
+  steps.store(0, std::memory_order_relaxed);
+  influences.store(0, std::memory_order_relaxed);
+  lastStepEnd.store(0, std::memory_order_relaxed);
+  meanPeriodNanos.store(0, std::memory_order_relaxed);
+}
+
+void SimulationMetrics::write(std::ostream &out, bool openMetrics) const {
+  writeFamily(out, "similar_steps", "counter", "Steps run.", openMetrics);
+  out << "similar_steps_total " << getSteps() << '\n';
+  writeFamily(out, "similar_steps_per_second", "gauge",
+              "Steps per second, smoothed over the last steps.", openMetrics);
+  out << "similar_steps_per_second ";
+  writeNumber(out, getStepsPerSecond());
+  out << '\n';
+  writeFamily(out, "similar_simulation_time", "gauge",
+              "Time stamp reached by the simulation.", openMetrics);
+  out << "similar_simulation_time " << lastTime.load(std::memory_order_relaxed)
+      << '\n';
+
+  writeFamily(out, "similar_step_phase_seconds", "histogram",
+              "Duration of the phases of the steps.", openMetrics);
+  for (std::size_t phase = 0; phase < PHASES.size(); ++phase) {
+    const Histogram &histogram = histograms[phase];
+    std::uint64_t count = 0;
+    for (std::size_t bucket = 0; bucket < histogram.buckets.size();
+         ++bucket) {
+      count += histogram.buckets[bucket].load(std::memory_order_relaxed);
+      out << "similar_step_phase_seconds_bucket{phase=\""
+          << PHASE_NAMES[phase] << "\",le=\"";
+      if (bucket < BUCKET_BOUNDS.size()) {
+        writeNumber(out, BUCKET_BOUNDS[bucket]);
+      } else {
+        out << "+Inf";
+      }
+      out << "\"} " << count << '\n';
+    }
+    out << "similar_step_phase_seconds_sum{phase=\"" << PHASE_NAMES[phase]
+        << "\"} ";
+    writeNumber(out,
+                static_cast<double>(
+                    histogram.sumNanos.load(std::memory_order_relaxed)) *
+                    1e-9);
+    out << '\n';
+    out << "similar_step_phase_seconds_count{phase=\"" << PHASE_NAMES[phase]
+        << "\"} " << count << '\n';
+  }
+
+  writeFamily(out, "similar_agents", "gauge",
+              "Agents at the start of the last step.", openMetrics);
+  out << "similar_agents " << agents.load(std::memory_order_relaxed) << '\n';
+  writeFamily(out, "similar_step_influences", "gauge",
+              "Influences emitted during the last step.", openMetrics);
+  out << "similar_step_influences "
+      << stepInfluences.load(std::memory_order_relaxed) << '\n';
+  writeFamily(out, "similar_influences", "counter", "Influences emitted.",
+              openMetrics);
+  out << "similar_influences_total "
+      << influences.load(std::memory_order_relaxed) << '\n';
+  writeFamily(out, "similar_threads", "gauge",
+              "Threads running the agents.", openMetrics);
+  out << "similar_threads " << threads.load(std::memory_order_relaxed)
+      << '\n';
+  writeFamily(out, "similar_thread_utilization", "gauge",
+              "Busy fraction of the threads during the last agent phase.",
+              openMetrics);
+  out << "similar_thread_utilization ";
+  writeNumber(out, utilization.load(std::memory_order_relaxed));
+  out << '\n';
+
+  {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    if (!queues.empty()) {
+      writeFamily(out, "similar_queue_depth", "gauge",
+                  "Items waiting in the queues, e.g. of asynchronous probes.",
+                  openMetrics);
+    }
+    for (const Queue &queue : queues) {
+      out << "similar_queue_depth{queue=\"";
+      writeLabel(out, queue.name);
+      out << "\"} " << queue.depth() << '\n';
+    }
+  }
+
+  const std::vector<MemoryUsage> usages = MemoryAccounting::snapshot();
+  if (!usages.empty()) {
+    writeFamily(out, "similar_memory_live_bytes", "gauge",
+                "Bytes allocated and not released by a subsystem.",
+                openMetrics);
+    for (const MemoryUsage &usage : usages) {
+      out << "similar_memory_live_bytes{subsystem=\"";
+      writeLabel(out, usage.subsystem);
+      out << "\"} " << usage.liveBytes << '\n';
+    }
+    writeFamily(out, "similar_memory_peak_bytes", "gauge",
+                "Most live bytes of a subsystem.", openMetrics);
+    for (const MemoryUsage &usage : usages) {
+      out << "similar_memory_peak_bytes{subsystem=\"";
+      writeLabel(out, usage.subsystem);
+      out << "\"} " << usage.peakBytes << '\n';
+    }
+  }
+
+  if (openMetrics) {
+    out << "# EOF\n";
+  }
+}
+
+std::string SimulationMetrics::toText(bool openMetrics) const {
+  std::ostringstream out;
+  write(out, openMetrics);
+  return out.str();
+}
+
+const char *SimulationMetrics::getContentType(bool openMetrics) {
+  return openMetrics
+             ? "application/openmetrics-text; version=1.0.0; charset=utf-8"
+             : "text/plain; version=0.0.4; charset=utf-8";
+}
+
+} // namespace libs
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -0,0 +1,98 @@
+#include "libs/SymbolTable.h"
+
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace microkernel {
+namespace libs {
+
+SymbolTable &SymbolTable::global() {
+  // Never destroyed, for the symbols read while the process exits
+  static SymbolTable *instance = new SymbolTable();
+  return *instance;
+}
+
+SymbolTable::SymbolTable() {
+  for (auto &chunk : chunks) {
+    chunk.store(nullptr, std::memory_order_relaxed);
+  }
+  intern("");
+}
+
+SymbolTable::~SymbolTable() {
+  for (auto &chunk : chunks) {
+    delete[] chunk.load(std::memory_order_relaxed);
+  }
+}
+
+int SymbolTable::chunkOf(std::uint32_t id, std::uint64_t &offset) {
+  const std::uint64_t n = id / FIRST_CHUNK + 1;
+  int chunk = 0;
+  while ((n >> (chunk + 1)) != 0) {
+    ++chunk;
+  }
+  offset = id - FIRST_CHUNK * ((std::uint64_t(1) << chunk) - 1);
+  return chunk;
+}
+
+std::uint32_t SymbolTable::intern(std::string_view name) {
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto found = ids.find(name);
+    if (found != ids.end()) {
+      return found->second;
+    }
+  }
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  auto found = ids.find(name);
+  if (found != ids.end()) {
+    return found->second;
+  }
+  const std::uint32_t id = count.load(std::memory_order_relaxed);
+  if (id == std::numeric_limits<std::uint32_t>::max()) {
+    throw std::length_error("The symbol table is full.");
+  }
+  std::uint64_t offset;
+  const int chunk = chunkOf(id, offset);
+  std::string *strings = chunks[chunk].load(std::memory_order_relaxed);
+  if (strings == nullptr) {
+    strings = new std::string[FIRST_CHUNK << chunk];
+    chunks[chunk].store(strings, std::memory_order_release);
+  }
+  strings[offset] = std::string(name);
+  ids.emplace(std::string_view(strings[offset]), id);
+  // publishes the string to name()
+  count.store(id + 1, std::memory_order_release);
+  return id;
+}
+
+bool SymbolTable::find(std::string_view name, std::uint32_t &id) const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  auto found = ids.find(name);
+  if (found == ids.end()) {
+    return false;
+  }
+  id = found->second;
+  return true;
+}
+
+const std::string &SymbolTable::name(std::uint32_t id) const {
+  if (id >= count.load(std::memory_order_acquire)) {
+    throw std::out_of_range("No symbol " + std::to_string(id));
+  }
+  std::uint64_t offset;
+  const int chunk = chunkOf(id, offset);
+  return chunks[chunk].load(std::memory_order_acquire)[offset];
+}
+
+} // namespace libs
+} // namespace microkernel
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -2,6 +2,8 @@
 #include <map>
 #include <memory>
 #include <set>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 #include "AgentCategory.h"
@@ -22,6 +24,8 @@
 #include "dynamicstate/IPublicDynamicStateMap.h"
 #include "dynamicstate/IPublicLocalDynamicState.h"
 #include "dynamicstate/TransitoryPublicLocalDynamicState.h"
+#include "engine/ModelPlugin.h"
+#include "engine/MultiThreadedSimulationEngine.h"
 #include "environment/IEnvironment.h"
 #include "environment/IEnvironment4Engine.h"
 #include "environment/ILocalStateOfEnvironment.h"
@@ -86,9 +90,14 @@ private:
   AgentCategory category;
   std::map<LevelIdentifier, std::shared_ptr<agents::ILocalStateOfAgent>>
       publicStates;
+  std::shared_ptr<agents::IGlobalState> globalState;
+  std::shared_ptr<agents::ILocalStateOfAgent> privateState;
+  std::map<LevelIdentifier, std::shared_ptr<agents::IPerceivedData>>
+      perceivedData;
 
 public:
-  MockAgent(const AgentCategory &category) : category(category) {}
+  MockAgent(const AgentCategory &category)
+      : category(category), globalState(std::make_shared<MockGlobalState>()) {}
 
   AgentCategory getCategory() const override { return category; }
 
@@ -115,7 +124,35 @@ public:
   }
 
   std::shared_ptr<agents::IGlobalState> getGlobalState() const override {
-    return std::make_shared<MockGlobalState>();
+    return globalState;
+  }
+
+  const std::shared_ptr<agents::IGlobalState> &
+  borrowGlobalState() const override {
+    return globalState;
+  }
+
+  const std::map<LevelIdentifier, std::shared_ptr<agents::ILocalStateOfAgent>> &
+  borrowPublicLocalStates() const override {
+    return publicStates;
+  }
+
+  const std::shared_ptr<agents::ILocalStateOfAgent> &
+  borrowPublicLocalState(const LevelIdentifier &level) const override {
+    return publicStates.at(level);
+  }
+
+  const std::shared_ptr<agents::ILocalStateOfAgent> &
+  borrowPrivateLocalState(const LevelIdentifier &level) const override {
+    if (publicStates.find(level) == publicStates.end()) {
+      throw std::out_of_range("The agent does not lie in the level");
+    }
+    return privateState; // Not needed for this test
+  }
+
+  const std::map<LevelIdentifier, std::shared_ptr<agents::IPerceivedData>> &
+  borrowPerceivedData() const override {
+    return perceivedData;
   }
 
   std::shared_ptr<agents::IPerceivedData>
@@ -176,9 +213,42 @@ public:
   }
 };
 
+// --- Model Plugin ---
+
+/**
+ * Runs the model of a plugin (see engine::ModelPlugin) until its end, with
+ * its batch behaviors.
+ */
+int runPlugin(const std::string &path, const std::string &arguments) {
+  try {
+    engine::ModelPlugin plugin(path);
+    auto simulationEngine =
+        std::make_shared<engine::MultiThreadedSimulationEngine>();
+    const std::size_t behaviors =
+        plugin.installBatchBehaviors(*simulationEngine);
+    simulationEngine->runNewSimulation(plugin.createModel(arguments));
+    std::cout << "Ran " << path << " with " << behaviors
+              << " batch behaviors until time "
+              << simulationEngine->getCurrentTime().getIdentifier()
+              << std::endl;
+  } catch (const std::exception &e) {
+    std::cerr << "[FAIL] " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
 // --- Main Test ---
 
-int main() {
+/**
+ * Runs the tests, or with "--plugin <library> [arguments]" the model of a
+ * plugin.
+ */
+int main(int argc, char *argv[]) {
+  if (argc >= 3 && std::string(argv[1]) == "--plugin") {
+    return runPlugin(argv[2], argc >= 4 ? argv[3] : "");
+  }
+
   std::cout << "Running similar-microKernel tests..." << std::endl;
 
   // 1. Basic Types
@@ -0,0 +1,416 @@
+#ifndef WALKERMODELS_H
+#define WALKERMODELS_H
+
+// The Logo models of the scaling harness and of the performance gate:
+// boids, ants laying a pheromone trail, and predators chasing preys.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "ISimulationModel.h"
+#include "agents/IGlobalState.h"
+#include "agents/ILocalStateOfAgent4Engine.h"
+#include "dynamicstate/ConsistentPublicLocalDynamicState.h"
+#include "environment/IEnvironment4Engine.h"
+#include "influences/InfluenceArena.h"
+#include "influences/InfluencesMap.h"
+#include "libs/AbstractAgent.h"
+#include "libs/abstractimpl/AbstractLevel.h"
+#include "libs/generic/EmptyPerceivedData.h"
+
+#include "kernel/environment/Environment.h"
+#include "kernel/influences/ChangeDirection.h"
+#include "kernel/influences/ChangePosition.h"
+#include "kernel/influences/EmitPheromone.h"
+#include "kernel/model/environment/TurtlePLSInLogo.h"
+#include "kernel/reaction/Reaction.h"
+#include "kernel/tools/MathUtil.h"
+#include "kernel/tools/Point2D.h"
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace benchmarks {
+
+namespace mk = ::fr::univ_artois::lgi2a::similar::microkernel;
+namespace s2l = ::fr::univ_artois::lgi2a::similar::similar2logo::kernel;
+
+using TurtlePtr = std::shared_ptr<s2l::model::environment::TurtlePLSInLogo>;
+
+inline const mk::LevelIdentifier LOGO("logo");
+inline const char *const TRAIL = "trail";
+
+/** The public local state of a turtle, pointing to its state in the grid. */
+class TurtleState : public mk::agents::ILocalStateOfAgent4Engine {
+private:
+  std::weak_ptr<mk::agents::IAgent4Engine> owner;
+  mk::AgentCategory category;
+
+public:
+  TurtlePtr turtle;
+
+  TurtleState(std::shared_ptr<mk::agents::IAgent4Engine> owner,
+              mk::AgentCategory category, TurtlePtr turtle)
+      : owner(owner), category(std::move(category)),
+        turtle(std::move(turtle)) {}
+
+  mk::LevelIdentifier getLevel() const override { return LOGO; }
+  mk::AgentCategory getCategoryOfAgent() const override { return category; }
+  bool isOwnedBy(const mk::agents::IAgent &agent) const override {
+    return owner.lock().get() == &agent;
+  }
+  std::shared_ptr<mk::agents::IAgent4Engine> getOwner() const override {
+    return owner.lock();
+  }
+  std::shared_ptr<mk::ILocalState> clone() const override {
+    return std::make_shared<TurtleState>(*this);
+  }
+};
+
+class NoGlobalState : public mk::agents::IGlobalState {
+public:
+  std::shared_ptr<mk::agents::IGlobalState> clone() const override {
+    return std::make_shared<NoGlobalState>();
+  }
+};
+
+enum class Behavior { BOID, ANT, PREDATOR, PREY };
+
+/**
+ * A turtle deciding from the turtles and the pheromone around it, read in
+ * the grid during the decision: the grid only changes in the reaction.
+ */
+class Walker : public mk::libs::AbstractAgent {
+private:
+  Behavior behavior;
+  TurtlePtr turtle;
+  std::shared_ptr<s2l::environment::Environment> grid;
+  /** The pheromone of the ants, looked up once */
+  std::optional<s2l::environment::Environment::PheromoneHandle> trail;
+  std::uint64_t random;
+
+  // A draw in [-1, 1), from the xorshift stream of the agent
+  double wiggle() {
+    random ^= random << 13;
+    random ^= random >> 7;
+    random ^= random << 17;
+    return static_cast<double>(random >> 11) * 0x1.0p-52 - 1.0;
+  }
+
+  static double limit(double turn, double most) {
+    return std::max(-most, std::min(most, turn));
+  }
+
+  // Boids: cohesion with the turtles within 3, alignment with them, and
+  // separation from the ones closer than 1
+  double boidTurn(double heading) const {
+    const auto here = turtle->getLocation();
+    double sines = 0, cosines = 0, towards = 0, away = 0;
+    int neighbors = 0;
+    grid->query_radius(here, 3.0, [&](const TurtlePtr &other) {
+      if (other == turtle) {
+        return;
+      }
+      const double direction = grid->get_direction(here, other->getLocation());
+      sines += std::sin(other->getHeading());
+      cosines += std::cos(other->getHeading());
+      if (grid->get_distance(here, other->getLocation()) < 1.0) {
+        away += s2l::tools::MathUtil::normalizeAngle(direction + M_PI -
+                                                     heading);
+      } else {
+        towards += s2l::tools::MathUtil::normalizeAngle(direction - heading);
+      }
+      ++neighbors;
+    });
+    if (neighbors == 0) {
+      return 0.0;
+    }
+    const double alignment = s2l::tools::MathUtil::normalizeAngle(
+        std::atan2(sines, cosines) - heading);
+    return limit((2.0 * away + 0.1 * towards) / neighbors + 0.5 * alignment,
+                 0.3);
+  }
+
+  // Ants: towards the strongest of the pheromone ahead, on the left and on
+  // the right, wandering off the trails
+  double antTurn(double heading) {
+    const auto here = turtle->getLocation();
+    double values[3];
+    for (int side = 0; side < 3; ++side) {
+      const double direction = heading + (side - 1) * 0.6;
+      values[side] = grid->sample_pheromone(here.x + 2.0 * std::sin(direction),
+                                            here.y - 2.0 * std::cos(direction),
+                                            *trail);
+    }
+    if (values[0] > values[1] && values[0] >= values[2]) {
+      return -0.6;
+    }
+    if (values[2] > values[1] && values[2] > values[0]) {
+      return 0.6;
+    }
+    return values[1] > 0.0 ? 0.0 : 0.4 * wiggle();
+  }
+
+  // Predators and preys: towards the nearest prey within 5, or away from the
+  // nearest predator within 4; a prey caught respawns elsewhere, so that the
+  // population stays the same during a measure
+  double chaseTurn(double heading, const mk::SimulationTimeStamp &lower,
+                   const mk::SimulationTimeStamp &upper,
+                   mk::influences::InfluencesMap &produced) {
+    const auto here = turtle->getLocation();
+    const bool hunting = behavior == Behavior::PREDATOR;
+    const std::string &prey = hunting ? std::string("green") : "red";
+    TurtlePtr nearest;
+    double nearestDistance = hunting ? 5.0 : 4.0;
+    grid->query_radius(here, nearestDistance, [&](const TurtlePtr &other) {
+      if (other->getColor() != prey) {
+        return;
+      }
+      const double distance = grid->get_distance(here, other->getLocation());
+      if (distance <= nearestDistance) {
+        nearest = other;
+        nearestDistance = distance;
+      }
+    });
+    if (!nearest) {
+      return 0.3 * wiggle();
+    }
+    if (hunting && nearestDistance < 0.5) {
+      produced.add(mk::influences::makeInfluence<s2l::influences::ChangePosition>(
+          LOGO, lower, upper, grid->width() / 2.0 + 0.5,
+          grid->height() / 3.0 + 0.5, nearest));
+    }
+    const double direction = grid->get_direction(here, nearest->getLocation());
+    return limit(s2l::tools::MathUtil::normalizeAngle(
+                     (hunting ? direction : direction + M_PI) - heading),
+                 0.5);
+  }
+
+public:
+  Walker(Behavior behavior, mk::AgentCategory category, TurtlePtr turtle,
+         std::shared_ptr<s2l::environment::Environment> grid, int index)
+      : AbstractAgent(std::move(category)), behavior(behavior),
+        turtle(std::move(turtle)), grid(std::move(grid)),
+        trail(this->grid->find_pheromone(TRAIL)), random(0x9e3779b97f4a7c15ULL * (index + 1)) {}
+
+  std::shared_ptr<mk::agents::IPerceivedData>
+  perceive(const mk::LevelIdentifier &level,
+           const mk::SimulationTimeStamp &timeLowerBound,
+           const mk::SimulationTimeStamp &timeUpperBound,
+           const std::map<mk::LevelIdentifier,
+                          std::shared_ptr<mk::agents::ILocalStateOfAgent>> &,
+           std::shared_ptr<mk::agents::ILocalStateOfAgent>,
+           std::shared_ptr<mk::dynamicstate::IPublicDynamicStateMap>)
+      override {
+    return std::make_shared<mk::libs::generic::EmptyPerceivedData>(
+        level, timeLowerBound, timeUpperBound);
+  }
+
+  void reviseGlobalState(
+      const mk::SimulationTimeStamp &, const mk::SimulationTimeStamp &,
+      const std::map<mk::LevelIdentifier,
+                     std::shared_ptr<mk::agents::IPerceivedData>> &,
+      std::shared_ptr<mk::agents::IGlobalState>) override {}
+
+  void decide(const mk::LevelIdentifier &level,
+              const mk::SimulationTimeStamp &timeLowerBound,
+              const mk::SimulationTimeStamp &timeUpperBound,
+              std::shared_ptr<mk::agents::IGlobalState>,
+              std::shared_ptr<mk::agents::ILocalStateOfAgent>,
+              std::shared_ptr<mk::agents::ILocalStateOfAgent>,
+              std::shared_ptr<mk::agents::IPerceivedData>,
+              std::shared_ptr<mk::influences::InfluencesMap> produced)
+      override {
+    const double heading = turtle->getHeading();
+    double turn = 0.0;
+    switch (behavior) {
+    case Behavior::BOID:
+      turn = boidTurn(heading);
+      break;
+    case Behavior::ANT:
+      turn = antTurn(heading);
+      produced->add(
+          mk::influences::makeInfluence<s2l::influences::EmitPheromone>(
+              level, timeLowerBound, timeUpperBound, turtle->getLocation(),
+              TRAIL, 1.0));
+      break;
+    case Behavior::PREDATOR:
+    case Behavior::PREY:
+      turn = chaseTurn(heading, timeLowerBound, timeUpperBound, *produced);
+      break;
+    }
+    const double speed = behavior == Behavior::PREDATOR ? 0.9 : 0.7;
+    produced->add(
+        mk::influences::makeInfluence<s2l::influences::ChangeDirection>(
+            level, timeLowerBound, timeUpperBound, turn, turtle));
+    produced->add(
+        mk::influences::makeInfluence<s2l::influences::ChangePosition>(
+            level, timeLowerBound, timeUpperBound,
+            speed * std::sin(heading + turn),
+            -speed * std::cos(heading + turn), turtle));
+  }
+
+  std::shared_ptr<mk::agents::IAgent> clone() const override {
+    return std::make_shared<Walker>(*this);
+  }
+};
+
+/** The level of the turtles, applying their influences to the grid. */
+class WalkerLevel : public mk::libs::abstractimpl::AbstractLevel {
+private:
+  std::shared_ptr<s2l::environment::Environment> grid;
+  s2l::reaction::Reaction reaction;
+  std::vector<std::shared_ptr<mk::influences::IInfluence>> batch;
+
+public:
+  explicit WalkerLevel(std::shared_ptr<s2l::environment::Environment> grid)
+      : AbstractLevel(mk::SimulationTimeStamp(0), LOGO),
+        grid(std::move(grid)) {}
+
+  mk::SimulationTimeStamp
+  getNextTime(const mk::SimulationTimeStamp &currentTime) override {
+    return mk::SimulationTimeStamp(currentTime, 1);
+  }
+
+  void makeRegularReaction(
+      const mk::SimulationTimeStamp &, const mk::SimulationTimeStamp &upper,
+      std::shared_ptr<mk::dynamicstate::ConsistentPublicLocalDynamicState>
+          consistentState,
+      const std::set<std::shared_ptr<mk::influences::IInfluence>> &influences,
+      std::shared_ptr<mk::influences::InfluencesMap>) override {
+    batch.assign(influences.begin(), influences.end());
+    reaction.apply(batch, *grid);
+    batch.clear();
+    consistentState->setTime(upper);
+  }
+
+  void makeSystemReaction(
+      const mk::SimulationTimeStamp &, const mk::SimulationTimeStamp &,
+      std::shared_ptr<mk::dynamicstate::ConsistentPublicLocalDynamicState>,
+      const std::vector<std::shared_ptr<mk::influences::IInfluence>> &, bool,
+      std::shared_ptr<mk::influences::InfluencesMap>) override {}
+
+  std::shared_ptr<mk::levels::ILevel> clone() const override {
+    return std::make_shared<WalkerLevel>(*this);
+  }
+};
+
+class NoEnvironment : public mk::environment::IEnvironment4Engine {
+public:
+  std::shared_ptr<mk::environment::ILocalStateOfEnvironment>
+  getPublicLocalState(const mk::LevelIdentifier &) const override {
+    return nullptr;
+  }
+  std::shared_ptr<mk::environment::ILocalStateOfEnvironment>
+  getPrivateLocalState(const mk::LevelIdentifier &) const override {
+    return nullptr;
+  }
+  void natural(const mk::LevelIdentifier &, const mk::SimulationTimeStamp &,
+               const mk::SimulationTimeStamp &,
+               const std::map<mk::LevelIdentifier,
+                              std::shared_ptr<
+                                  mk::environment::ILocalStateOfEnvironment>> &,
+               std::shared_ptr<mk::environment::ILocalStateOfEnvironment>,
+               std::shared_ptr<mk::dynamicstate::IPublicDynamicStateMap>,
+               std::shared_ptr<mk::influences::InfluencesMap>) override {}
+  std::map<mk::LevelIdentifier,
+           std::shared_ptr<mk::environment::ILocalStateOfEnvironment>>
+  getPublicLocalStates() const override {
+    return {};
+  }
+  std::shared_ptr<mk::environment::IEnvironment> clone() const override {
+    return std::make_shared<NoEnvironment>();
+  }
+};
+
+/**
+ * A Logo model of a number of turtles on a toroidal grid of about 4 patches
+ * per turtle, whose last step is raised by the measures.
+ */
+class WalkerModel : public mk::ISimulationModel {
+private:
+  std::string name;
+  int turtleCount;
+  std::shared_ptr<s2l::environment::Environment> grid;
+
+public:
+  long finalStep = 0;
+
+  WalkerModel(std::string name, int turtleCount)
+      : name(std::move(name)), turtleCount(turtleCount) {}
+
+  mk::SimulationTimeStamp getInitialTime() const override {
+    return mk::SimulationTimeStamp(0);
+  }
+
+  bool isFinalTimeOrAfter(const mk::SimulationTimeStamp &currentTime,
+                          const mk::ISimulationEngine &) const override {
+    return currentTime.getIdentifier() >= finalStep;
+  }
+
+  std::vector<std::shared_ptr<mk::levels::ILevel>>
+  generateLevels(const mk::SimulationTimeStamp &) override {
+    const int side = std::max(16, static_cast<int>(std::sqrt(turtleCount * 4.0)));
+    grid = std::make_shared<s2l::environment::Environment>(side, side, true);
+    if (name == "ants") {
+      grid->add_pheromone(TRAIL, 0.2, 0.05, 0.0, 1e-3);
+    }
+    return {std::make_shared<WalkerLevel>(grid)};
+  }
+
+  EnvironmentInitializationData generateEnvironment(
+      const mk::SimulationTimeStamp &,
+      const std::map<mk::LevelIdentifier, std::shared_ptr<mk::levels::ILevel>>
+          &) override {
+    return EnvironmentInitializationData(std::make_shared<NoEnvironment>());
+  }
+
+  AgentInitializationData generateAgents(
+      const mk::SimulationTimeStamp &,
+      const std::map<mk::LevelIdentifier, std::shared_ptr<mk::levels::ILevel>>
+          &) override {
+    AgentInitializationData data;
+    for (int i = 0; i < turtleCount; ++i) {
+      Behavior behavior = name == "boids"  ? Behavior::BOID
+                          : name == "ants" ? Behavior::ANT
+                          : i % 5 == 0     ? Behavior::PREDATOR
+                                           : Behavior::PREY;
+      const bool predator = behavior == Behavior::PREDATOR;
+      const mk::AgentCategory category(predator ? "predator" : "turtle");
+      // Spread along a diagonal walk, so that the turtles start everywhere
+      auto turtle = std::make_shared<s2l::model::environment::TurtlePLSInLogo>(
+          s2l::tools::Point2D(std::fmod(i * 0.618034 * grid->width(),
+                                        grid->width()),
+                              std::fmod(i * 0.754878 * grid->height(),
+                                        grid->height())),
+          0.37 * i, 1.0, 0.0, false,
+          name == "predator_prey" ? (predator ? "red" : "green") : "blue");
+      grid->add_turtle(turtle);
+      auto agent =
+          std::make_shared<Walker>(behavior, category, turtle, grid, i);
+      auto state = std::make_shared<TurtleState>(agent, category, turtle);
+      agent->includeNewLevel(LOGO, state, state);
+      agent->initializeGlobalState(std::make_shared<NoGlobalState>());
+      data.getAgents().insert(agent);
+    }
+    return data;
+  }
+};
+
+} // namespace benchmarks
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // WALKERMODELS_H
@@ -0,0 +1,382 @@
+// The performance regression gate: a fixed, reduced set of runs of the Logo
+// models, whose steps per second and allocations per step are compared with
+// a committed baseline (perf_baseline.json) within tolerance bands.
+//
+//   ctest -L perf                          runs the gate
+//   cmake --build . --target similar_perf_baseline
+//                                          measures the baseline again
+//
+// The steps per second depend on the machine: they are scaled by a fixed
+// calibration loop (the shorter it runs here than when the baseline was
+// measured, the more steps per second are expected), then have to stay
+// above the baseline minus its tolerance. The allocations, counted by the
+// replaced global operator new, have to stay below the baseline plus its
+// tolerance. A run missing from the baseline is reported, not failed.
+//
+// A run found slower is measured again, after a new calibration, before it
+// fails: the load of a shared machine changes during the gate, and the
+// calibration of its start no longer stands for it.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "json.hpp"
+
+#include "engine/MultiThreadedSimulationEngine.h"
+#include "engine/SequentialSimulationEngine.h"
+
+#include "WalkerModels.h"
+
+// ---------------------------------------------------------------------------
+// The counting hook of the allocations
+
+namespace {
+
+std::atomic<std::uint64_t> allocationCount{0};
+
+void *countedAllocation(std::size_t size) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  if (void *pointer = std::malloc(size == 0 ? 1 : size)) {
+    return pointer;
+  }
+  throw std::bad_alloc();
+}
+
+void *countedAllocation(std::size_t size, std::align_val_t alignment) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  const auto bytes = static_cast<std::size_t>(alignment);
+  // aligned_alloc wants a multiple of the alignment
+  const std::size_t rounded = (std::max<std::size_t>(size, 1) + bytes - 1) /
+                              bytes * bytes;
+  if (void *pointer = std::aligned_alloc(bytes, rounded)) {
+    return pointer;
+  }
+  throw std::bad_alloc();
+}
+
+} // namespace
+
+void *operator new(std::size_t size) { return countedAllocation(size); }
+void *operator new[](std::size_t size) { return countedAllocation(size); }
+void *operator new(std::size_t size, std::align_val_t alignment) {
+  return countedAllocation(size, alignment);
+}
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+  return countedAllocation(size, alignment);
+}
+void operator delete(void *pointer) noexcept { std::free(pointer); }
+void operator delete[](void *pointer) noexcept { std::free(pointer); }
+void operator delete(void *pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+void operator delete[](void *pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+void operator delete(void *pointer, std::align_val_t) noexcept {
+  std::free(pointer);
+}
+void operator delete[](void *pointer, std::align_val_t) noexcept {
+  std::free(pointer);
+}
+void operator delete(void *pointer, std::size_t, std::align_val_t) noexcept {
+  std::free(pointer);
+}
+void operator delete[](void *pointer, std::size_t, std::align_val_t) noexcept {
+  std::free(pointer);
+}
+
+using namespace fr::univ_artois::lgi2a::similar::similar2logo::benchmarks;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// ---------------------------------------------------------------------------
+// The runs
+
+/** A run of the gate: a model, its agents and its engine. */
+struct Workload {
+  std::string model;
+  int agents;
+  /** 0 for the sequential engine */
+  std::size_t threads;
+
+  std::string name() const {
+    return model + "/" + std::to_string(agents) + "/" +
+           (threads == 0 ? std::string("sequential")
+                         : "threads:" + std::to_string(threads));
+  }
+};
+
+const std::vector<Workload> WORKLOADS = {
+    {"boids", 2000, 0},         {"boids", 2000, 2},
+    {"ants", 2000, 0},          {"ants", 2000, 2},
+    {"predator_prey", 2000, 0},
+};
+
+const long WARMUP_STEPS = 3;
+const long MEASURED_STEPS = 20;
+/** The best of the repetitions is kept, the others being noise */
+const int REPETITIONS = 3;
+/** The measures of a run found slower than its baseline, calibrated again */
+const int ATTEMPTS = 3;
+
+struct Result {
+  double stepsPerSecond = 0;
+  double allocationsPerStep = 0;
+};
+
+Result measureOnce(mk::ISimulationEngine &engine, const Workload &workload) {
+  auto model = std::make_shared<WalkerModel>(workload.model, workload.agents);
+  engine.runNewSimulation(model);
+  model->finalStep = WARMUP_STEPS;
+  engine.runSimulation(mk::SimulationTimeStamp(model->finalStep));
+  model->finalStep += MEASURED_STEPS;
+  const std::uint64_t allocations =
+      allocationCount.load(std::memory_order_relaxed);
+  const auto start = Clock::now();
+  engine.runSimulation(mk::SimulationTimeStamp(model->finalStep));
+  const auto end = Clock::now();
+  Result result;
+  result.allocationsPerStep =
+      static_cast<double>(allocationCount.load(std::memory_order_relaxed) -
+                          allocations) /
+      MEASURED_STEPS;
+  result.stepsPerSecond =
+      MEASURED_STEPS / std::chrono::duration<double>(end - start).count();
+  return result;
+}
+
+Result measure(const Workload &workload) {
+  Result best;
+  best.allocationsPerStep = -1;
+  for (int i = 0; i < REPETITIONS; ++i) {
+    Result result;
+    if (workload.threads == 0) {
+      mk::engine::SequentialSimulationEngine engine;
+      result = measureOnce(engine, workload);
+    } else {
+      mk::engine::MultiThreadedSimulationEngine engine(workload.threads);
+      result = measureOnce(engine, workload);
+    }
+    best.stepsPerSecond = std::max(best.stepsPerSecond, result.stepsPerSecond);
+    if (best.allocationsPerStep < 0 ||
+        result.allocationsPerStep < best.allocationsPerStep) {
+      best.allocationsPerStep = result.allocationsPerStep;
+    }
+  }
+  return best;
+}
+
+// The seconds of a fixed mix of arithmetic and memory accesses, the best of
+// five, standing for the speed of the machine
+double calibrate() {
+  std::vector<std::uint32_t> values(1 << 20);
+  double best = 0;
+  for (int run = 0; run < 5; ++run) {
+    const auto start = Clock::now();
+    std::uint32_t state = 12345;
+    for (auto &value : values) {
+      state = state * 1664525u + 1013904223u;
+      value = state;
+    }
+    std::sort(values.begin(), values.end());
+    double sum = 0;
+    for (std::size_t i = 0; i < values.size(); i += 7) {
+      sum += std::sqrt(static_cast<double>(values[i]));
+    }
+    const double seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    // Keeps the loops from being optimized away
+    if (sum < 0) {
+      std::cerr << sum;
+    }
+    best = run == 0 ? seconds : std::min(best, seconds);
+  }
+  return best;
+}
+
+// ---------------------------------------------------------------------------
+// The comparison with the baseline
+
+struct Tolerances {
+  /** The fraction of the baseline steps per second that may be lost */
+  double stepsPerSecond = 0.3;
+  /** The fraction of allocations per step that may be added */
+  double allocationsPerStep = 0.1;
+  /** The allocations per step that may be added whatever the fraction */
+  double allocationsSlack = 8;
+};
+
+Tolerances readTolerances(const nlohmann::json &json, Tolerances defaults) {
+  defaults.stepsPerSecond =
+      json.value("steps_per_second", defaults.stepsPerSecond);
+  defaults.allocationsPerStep =
+      json.value("allocations_per_step", defaults.allocationsPerStep);
+  defaults.allocationsSlack =
+      json.value("allocations_slack", defaults.allocationsSlack);
+  return defaults;
+}
+
+nlohmann::json tolerancesJson(const Tolerances &tolerances) {
+  return {{"steps_per_second", tolerances.stepsPerSecond},
+          {"allocations_per_step", tolerances.allocationsPerStep},
+          {"allocations_slack", tolerances.allocationsSlack}};
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::string baselinePath;
+  bool update = false;
+  for (int i = 1; i < argc; ++i) {
+    const std::string argument = argv[i];
+    if (argument == "--baseline" && i + 1 < argc) {
+      baselinePath = argv[++i];
+    } else if (argument == "--update") {
+      update = true;
+    } else {
+      std::cerr << "Usage: " << argv[0] << " --baseline file [--update]"
+                << std::endl;
+      return 2;
+    }
+  }
+  if (baselinePath.empty()) {
+    std::cerr << "No baseline given (--baseline file)" << std::endl;
+    return 2;
+  }
+
+  nlohmann::json baseline = nlohmann::json::object();
+  {
+    std::ifstream in(baselinePath);
+    if (in) {
+      try {
+        in >> baseline;
+      } catch (const nlohmann::json::exception &e) {
+        std::cerr << "Cannot read " << baselinePath << ": " << e.what()
+                  << std::endl;
+        return 2;
+      }
+    } else if (!update) {
+      std::cerr << "Cannot open " << baselinePath << std::endl;
+      return 2;
+    }
+  }
+  const Tolerances defaults =
+      readTolerances(baseline.value("tolerance", nlohmann::json::object()),
+                     Tolerances());
+
+  double calibration = calibrate();
+  const double baseCalibration =
+      baseline.value("calibration_seconds", calibration);
+  // Above 1 on a machine faster than the one of the baseline
+  double speed = baseCalibration / calibration;
+  std::cout << "calibration " << calibration * 1000 << " ms (baseline "
+            << baseCalibration * 1000 << " ms)" << std::endl;
+
+  const nlohmann::json references =
+      baseline.value("workloads", nlohmann::json::array());
+  nlohmann::json measured = nlohmann::json::array();
+  int failures = 0;
+  std::cout << std::left << std::setw(34) << "workload" << std::right
+            << std::setw(11) << "steps/s" << std::setw(11) << "expected"
+            << std::setw(11) << "allocs" << std::setw(11) << "allowed"
+            << "\n";
+  for (const auto &workload : WORKLOADS) {
+    Result result = measure(workload);
+    const nlohmann::json *reference = nullptr;
+    for (const auto &entry : references) {
+      if (entry.value("name", "") == workload.name()) {
+        reference = &entry;
+      }
+    }
+    const Tolerances tolerances =
+        reference == nullptr
+            ? defaults
+            : readTolerances(
+                  reference->value("tolerance", nlohmann::json::object()),
+                  defaults);
+    const double baseSteps =
+        reference == nullptr ? 0.0 : reference->value("steps_per_second", 0.0);
+    double expected = baseSteps * speed * (1.0 - tolerances.stepsPerSecond);
+    for (int attempt = 1;
+         attempt < ATTEMPTS && !update && result.stepsPerSecond < expected;
+         ++attempt) {
+      std::cout << workload.name() << " slower (" << std::fixed
+                << std::setprecision(1) << result.stepsPerSecond << " < "
+                << expected << " steps/s), measuring again\n"
+                << std::defaultfloat;
+      calibration = calibrate();
+      speed = baseCalibration / calibration;
+      expected = baseSteps * speed * (1.0 - tolerances.stepsPerSecond);
+      const Result retried = measure(workload);
+      result.stepsPerSecond =
+          std::max(result.stepsPerSecond, retried.stepsPerSecond);
+    }
+    nlohmann::json entry = {
+        {"name", workload.name()},
+        {"steps_per_second", result.stepsPerSecond},
+        {"allocations_per_step", result.allocationsPerStep}};
+    // The tolerances of a run are kept when the baseline is measured again
+    if (reference != nullptr && reference->contains("tolerance")) {
+      entry["tolerance"] = (*reference)["tolerance"];
+    }
+    measured.push_back(entry);
+    std::cout << std::left << std::setw(34) << workload.name() << std::right
+              << std::fixed << std::setprecision(1) << std::setw(11)
+              << result.stepsPerSecond;
+    if (reference == nullptr || update) {
+      std::cout << std::setw(11) << "-" << std::setw(11)
+                << result.allocationsPerStep << std::setw(11) << "-"
+                << (update ? "" : "  no baseline") << "\n";
+      continue;
+    }
+    const double allowed =
+        reference->value("allocations_per_step", 0.0) *
+            (1.0 + tolerances.allocationsPerStep) +
+        tolerances.allocationsSlack;
+    std::cout << std::setw(11) << expected << std::setw(11)
+              << result.allocationsPerStep << std::setw(11) << allowed;
+    if (result.stepsPerSecond < expected) {
+      std::cout << "  SLOWER";
+      ++failures;
+    }
+    if (result.allocationsPerStep > allowed) {
+      std::cout << "  MORE ALLOCATIONS";
+      ++failures;
+    }
+    std::cout << "\n" << std::defaultfloat;
+  }
+
+  if (update) {
+    nlohmann::json updated = {{"calibration_seconds", calibration},
+                              {"tolerance", tolerancesJson(defaults)},
+                              {"workloads", measured}};
+    std::ofstream out(baselinePath);
+    out << updated.dump(2) << "\n";
+    if (!out) {
+      std::cerr << "Cannot write " << baselinePath << std::endl;
+      return 2;
+    }
+    std::cout << "Baseline written to " << baselinePath << std::endl;
+    return 0;
+  }
+  if (failures > 0) {
+    std::cout << failures << " regression(s) against " << baselinePath
+              << std::endl;
+    return 1;
+  }
+  return 0;
+}
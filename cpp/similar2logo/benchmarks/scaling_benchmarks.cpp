@@ -0,0 +1,479 @@
+// Strong and weak scaling of the engines on representative models: boids,
+// ants laying a pheromone trail, predators chasing preys and, when JamFree
+// is built, a highway.
+//
+// Each model runs on the SequentialSimulationEngine, then on the
+// MultiThreadedSimulationEngine for every thread count. Strong scaling keeps
+// the number of agents; weak scaling (--weak) grows it with the threads.
+// The results, with the steps per second, the parallel efficiency and the
+// mean time of each phase of a step, are printed and written as JSON
+// (--json) and CSV (--csv):
+//
+//   similar_scaling --models boids,ants --threads 1,2,4,8 --sizes 10000
+//       --steps 20 --json scaling.json --csv scaling.csv
+//
+// The similar_scaling_report target runs the default sweep into
+// similar_scaling.json and similar_scaling.csv.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "engine/MultiThreadedSimulationEngine.h"
+#include "engine/SequentialSimulationEngine.h"
+#include "libs/StepTimingRecorder.h"
+
+#include "WalkerModels.h"
+
+#ifdef SIMILAR_SCALING_JAMFREE
+#include "../../jamfree/kernel/include/agents/VehicleAgent.h"
+#include "../../jamfree/kernel/include/model/Road.h"
+#include "../../jamfree/kernel/include/simulation/SimulationEngine.h"
+#include "../../jamfree/microscopic/include/IDM.h"
+#include "../../jamfree/microscopic/include/agents/VehiclePrivateLocalStateMicro.h"
+#include "../../jamfree/microscopic/include/agents/VehiclePublicLocalStateMicro.h"
+#include "../../jamfree/microscopic/include/decision/VehicleDecisionModelMicro.h"
+#include "../../jamfree/microscopic/include/decision/dms/ForwardAccelerationDMS.h"
+#include "../../jamfree/microscopic/include/decision/dms/SubsumptionDMS.h"
+#include "../../jamfree/microscopic/include/perception/VehiclePerceptionModelMicro.h"
+#include "../../jamfree/microscopic/include/reaction/MicroscopicReactionModel.h"
+#endif
+
+using namespace fr::univ_artois::lgi2a::similar::similar2logo::benchmarks;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// ---------------------------------------------------------------------------
+// The measures
+
+/** The mean times of the phases of a step, in milliseconds. */
+struct Phases {
+  double perception = 0;
+  double decision = 0;
+  double agentPhase = 0;
+  double merge = 0;
+  double reaction = 0;
+  double structuralUpdate = 0;
+  double probes = 0;
+};
+
+struct Measure {
+  std::string model;
+  std::string engine;
+  std::size_t agents = 0;
+  std::size_t threads = 1;
+  long steps = 0;
+  double seconds = 0;
+  /** Relative to the baseline of the sweep, see measureSweep() */
+  double speedup = 1;
+  double efficiency = 1;
+  bool timed = false;
+  Phases phases;
+
+  double stepsPerSecond() const { return seconds > 0 ? steps / seconds : 0; }
+};
+
+struct Options {
+  std::vector<std::string> models{"boids", "ants", "predator_prey"};
+  std::vector<std::size_t> threads;
+  std::vector<std::size_t> sizes{1000, 10000};
+  long steps = 20;
+  long warmup = 3;
+  bool weak = false;
+  std::string json;
+  std::string csv;
+};
+
+double milliseconds(mk::StepTimings::Duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+// Runs the warmup steps then the measured ones, reading the phases of the
+// measured steps from the step timings of the engine
+Measure measureLogo(mk::ISimulationEngine &engine, const std::string &name,
+                    const Options &options, std::size_t agents,
+                    std::size_t threads, const std::string &engineName) {
+  auto model = std::make_shared<WalkerModel>(name, static_cast<int>(agents));
+  auto recorder = std::make_shared<mk::libs::StepTimingRecorder>(
+      static_cast<std::size_t>(options.steps));
+  engine.runNewSimulation(model);
+  model->finalStep = options.warmup;
+  engine.runSimulation(mk::SimulationTimeStamp(model->finalStep));
+  engine.setStepTimingListener(recorder);
+  model->finalStep += options.steps;
+  const auto start = Clock::now();
+  engine.runSimulation(mk::SimulationTimeStamp(model->finalStep));
+  const auto end = Clock::now();
+  engine.setStepTimingListener(nullptr);
+
+  Measure measure;
+  measure.model = name;
+  measure.engine = engineName;
+  measure.agents = agents;
+  measure.threads = threads;
+  measure.steps = options.steps;
+  measure.seconds = std::chrono::duration<double>(end - start).count();
+  const auto timings = recorder->getTimings();
+  measure.timed = !timings.empty();
+  for (const auto &step : timings) {
+    measure.phases.perception += milliseconds(step.perception);
+    measure.phases.decision += milliseconds(step.decision);
+    measure.phases.agentPhase += milliseconds(step.agentPhase);
+    measure.phases.merge += milliseconds(step.merge);
+    measure.phases.reaction += milliseconds(step.reaction);
+    measure.phases.structuralUpdate += milliseconds(step.structuralUpdate);
+    measure.phases.probes += milliseconds(step.probes);
+  }
+  if (measure.timed) {
+    const double count = static_cast<double>(timings.size());
+    for (double *phase :
+         {&measure.phases.perception, &measure.phases.decision,
+          &measure.phases.agentPhase, &measure.phases.merge,
+          &measure.phases.reaction, &measure.phases.structuralUpdate,
+          &measure.phases.probes}) {
+      *phase /= count;
+    }
+  }
+  return measure;
+}
+
+#ifdef SIMILAR_SCALING_JAMFREE
+namespace jf = jamfree;
+
+// A three lane highway holding a vehicle every 40 m of lane, stepped by the
+// engine of JamFree, parallel from two threads; it records no phases
+Measure measureHighway(const Options &options, std::size_t vehicles,
+                       std::size_t threads) {
+  const double dt = 0.1;
+  const int lanes = 3;
+  const double spacing = 40.0;
+  const double length =
+      spacing * static_cast<double>((vehicles + lanes - 1) / lanes) + spacing;
+  jf::kernel::simulation::SimulationEngine engine(dt);
+  engine.setNumThreads(threads);
+  auto highway = std::make_shared<jf::kernel::model::Road>(
+      "highway", jf::kernel::model::Point2D(0, 0),
+      jf::kernel::model::Point2D(length, 0), lanes, 3.5);
+  const jf::kernel::agents::LevelIdentifier level("Microscopic");
+  auto reaction =
+      std::make_shared<jf::microscopic::reaction::MicroscopicReactionModel>(dt);
+  reaction->setSimulationEngine(&engine);
+  engine.setReactionModel(level, reaction);
+  auto idm = std::make_shared<jf::microscopic::models::IDM>();
+  for (std::size_t i = 0; i < vehicles; ++i) {
+    const std::string id = "vehicle" + std::to_string(i);
+    auto vehicle = std::make_shared<jf::kernel::agents::VehicleAgent>(id);
+    auto publicState = std::make_shared<
+        jf::microscopic::agents::VehiclePublicLocalStateMicro>(id);
+    publicState->setCurrentLane(highway->getLane(i % lanes).get());
+    publicState->setLaneIndex(static_cast<int>(i % lanes));
+    publicState->setLanePosition(spacing * static_cast<double>(i / lanes));
+    publicState->setSpeed(20.0 + static_cast<double>(i % 7));
+    publicState->setActive(true);
+    auto privateState = std::make_shared<
+        jf::microscopic::agents::VehiclePrivateLocalStateMicro>(id);
+    privateState->setDesiredSpeed(30.0 + static_cast<double>(i % 5));
+    auto dms = std::make_shared<jf::microscopic::decision::dms::SubsumptionDMS>();
+    dms->addSubmodel(
+        std::make_shared<jf::microscopic::decision::dms::ForwardAccelerationDMS>(
+            idm));
+    vehicle->includeNewLevel(level, publicState, privateState);
+    vehicle->setModels(
+        level,
+        std::make_shared<
+            jf::microscopic::perception::VehiclePerceptionModelMicro>(150.0),
+        std::make_shared<jf::microscopic::decision::VehicleDecisionModelMicro>(
+            dms));
+    engine.addAgent(vehicle);
+  }
+  engine.run(static_cast<int>(options.warmup));
+  const auto start = Clock::now();
+  engine.run(static_cast<int>(options.steps));
+  const auto end = Clock::now();
+
+  Measure measure;
+  measure.model = "highway";
+  measure.engine = threads > 1 ? "jamfree-parallel" : "jamfree";
+  measure.agents = vehicles;
+  measure.threads = threads;
+  measure.steps = options.steps;
+  measure.seconds = std::chrono::duration<double>(end - start).count();
+  return measure;
+}
+#endif
+
+/**
+ * Measures a model from the smallest thread count to the largest, after the
+ * sequential engine. The runs compare with the multithreaded one of the
+ * fewest threads, t0 threads at n0 agents: strong scaling (the same n0
+ * agents) gives the speedup s = steps/s / baseline steps/s and the
+ * efficiency s * t0 / t; weak scaling (n0 * t / t0 agents) gives the
+ * efficiency steps/s / baseline steps/s, and the speedup of the agents
+ * stepped per second.
+ */
+std::vector<Measure> measureSweep(const std::string &model,
+                                  const Options &options, std::size_t size) {
+  std::vector<Measure> measures;
+  const std::size_t first = options.threads.front();
+  const auto agentsFor = [&](std::size_t threads) {
+    return options.weak ? size * threads / first : size;
+  };
+  if (model == "highway") {
+#ifdef SIMILAR_SCALING_JAMFREE
+    for (std::size_t threads : options.threads) {
+      measures.push_back(measureHighway(options, agentsFor(threads), threads));
+    }
+#else
+    std::cerr << "highway: JamFree is not built, skipped" << std::endl;
+    return measures;
+#endif
+  } else {
+    mk::engine::SequentialSimulationEngine sequential;
+    measures.push_back(measureLogo(sequential, model, options,
+                                   agentsFor(first), 1, "sequential"));
+    for (std::size_t threads : options.threads) {
+      mk::engine::MultiThreadedSimulationEngine engine(threads);
+      measures.push_back(measureLogo(engine, model, options,
+                                     agentsFor(threads), threads,
+                                     "multithreaded"));
+    }
+  }
+  const auto baseline =
+      std::find_if(measures.begin(), measures.end(), [](const Measure &m) {
+        return m.engine != "sequential";
+      });
+  for (auto &measure : measures) {
+    const double ratio = measure.stepsPerSecond() / baseline->stepsPerSecond();
+    const double threads = static_cast<double>(measure.threads);
+    if (options.weak) {
+      measure.efficiency = ratio;
+      measure.speedup = ratio * measure.agents / baseline->agents;
+    } else {
+      measure.speedup = ratio;
+      measure.efficiency = ratio * first / threads;
+    }
+  }
+  return measures;
+}
+
+// ---------------------------------------------------------------------------
+// The reports
+
+const char *const COLUMNS =
+    "model,engine,scaling,agents,threads,steps,seconds,steps_per_second,"
+    "speedup,efficiency,perception_ms,decision_ms,agent_phase_ms,merge_ms,"
+    "reaction_ms,structural_update_ms,probes_ms";
+
+void writeCsv(std::ostream &out, const std::vector<Measure> &measures,
+              bool weak) {
+  out << COLUMNS << "\n";
+  for (const auto &m : measures) {
+    out << m.model << "," << m.engine << "," << (weak ? "weak" : "strong")
+        << "," << m.agents << "," << m.threads << "," << m.steps << ","
+        << m.seconds << "," << m.stepsPerSecond() << "," << m.speedup << ","
+        << m.efficiency;
+    if (m.timed) {
+      out << "," << m.phases.perception << "," << m.phases.decision << ","
+          << m.phases.agentPhase << "," << m.phases.merge << ","
+          << m.phases.reaction << "," << m.phases.structuralUpdate << ","
+          << m.phases.probes;
+    } else {
+      out << ",,,,,,,";
+    }
+    out << "\n";
+  }
+}
+
+void writeJson(std::ostream &out, const std::vector<Measure> &measures,
+               const Options &options) {
+  out << "{\n  \"context\": {\"hardware_concurrency\": "
+      << std::thread::hardware_concurrency() << ", \"scaling\": \""
+      << (options.weak ? "weak" : "strong") << "\", \"steps\": "
+      << options.steps << ", \"warmup\": " << options.warmup << "},\n"
+      << "  \"results\": [";
+  for (std::size_t i = 0; i < measures.size(); ++i) {
+    const auto &m = measures[i];
+    out << (i == 0 ? "\n" : ",\n") << "    {\"model\": \"" << m.model
+        << "\", \"engine\": \"" << m.engine << "\", \"agents\": " << m.agents
+        << ", \"threads\": " << m.threads << ", \"steps\": " << m.steps
+        << ", \"seconds\": " << m.seconds
+        << ", \"steps_per_second\": " << m.stepsPerSecond()
+        << ", \"speedup\": " << m.speedup
+        << ", \"efficiency\": " << m.efficiency;
+    if (m.timed) {
+      out << ", \"phases_ms\": {\"perception\": " << m.phases.perception
+          << ", \"decision\": " << m.phases.decision
+          << ", \"agent_phase\": " << m.phases.agentPhase
+          << ", \"merge\": " << m.phases.merge
+          << ", \"reaction\": " << m.phases.reaction
+          << ", \"structural_update\": " << m.phases.structuralUpdate
+          << ", \"probes\": " << m.phases.probes << "}";
+    }
+    out << "}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+void printTable(const std::vector<Measure> &measures) {
+  std::cout << std::left << std::setw(14) << "model" << std::setw(18)
+            << "engine" << std::right << std::setw(9) << "agents"
+            << std::setw(8) << "threads" << std::setw(11) << "steps/s"
+            << std::setw(9) << "speedup" << std::setw(11) << "efficiency"
+            << std::setw(11) << "agents ms" << std::setw(12) << "reaction ms"
+            << "\n";
+  for (const auto &m : measures) {
+    std::cout << std::left << std::setw(14) << m.model << std::setw(18)
+              << m.engine << std::right << std::setw(9) << m.agents
+              << std::setw(8) << m.threads << std::fixed
+              << std::setprecision(1) << std::setw(11) << m.stepsPerSecond()
+              << std::setprecision(2) << std::setw(9) << m.speedup
+              << std::setw(11) << m.efficiency << std::setprecision(3);
+    if (m.timed) {
+      std::cout << std::setw(11) << m.phases.agentPhase << std::setw(12)
+                << m.phases.reaction;
+    } else {
+      std::cout << std::setw(11) << "-" << std::setw(12) << "-";
+    }
+    std::cout << "\n" << std::defaultfloat;
+  }
+}
+
+std::vector<std::string> split(const std::string &list) {
+  std::vector<std::string> items;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+std::vector<std::size_t> splitCounts(const std::string &list) {
+  std::vector<std::size_t> counts;
+  for (const auto &item : split(list)) {
+    const long count = std::stol(item);
+    if (count <= 0) {
+      throw std::invalid_argument("The counts have to be positive: " + list);
+    }
+    counts.push_back(static_cast<std::size_t>(count));
+  }
+  return counts;
+}
+
+// The thread counts 1, 2, 4... up to the hardware threads, which end it
+std::vector<std::size_t> defaultThreads() {
+  const std::size_t hardware =
+      std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::size_t> threads;
+  for (std::size_t count = 1; count < hardware; count *= 2) {
+    threads.push_back(count);
+  }
+  threads.push_back(hardware);
+  return threads;
+}
+
+Options parseOptions(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string argument = argv[i];
+    const auto value = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        throw std::invalid_argument(argument + " needs a value");
+      }
+      return argv[++i];
+    };
+    if (argument == "--models") {
+      options.models = split(value());
+    } else if (argument == "--threads") {
+      options.threads = splitCounts(value());
+    } else if (argument == "--sizes") {
+      options.sizes = splitCounts(value());
+    } else if (argument == "--steps") {
+      options.steps = std::stol(value());
+    } else if (argument == "--warmup") {
+      options.warmup = std::stol(value());
+    } else if (argument == "--weak") {
+      options.weak = true;
+    } else if (argument == "--json") {
+      options.json = value();
+    } else if (argument == "--csv") {
+      options.csv = value();
+    } else {
+      throw std::invalid_argument("Unknown option " + argument);
+    }
+  }
+  if (options.threads.empty()) {
+    options.threads = defaultThreads();
+  }
+  std::sort(options.threads.begin(), options.threads.end());
+  if (options.steps <= 0 || options.warmup < 0) {
+    throw std::invalid_argument("The steps have to be positive");
+  }
+  for (const auto &model : options.models) {
+    if (model != "boids" && model != "ants" && model != "predator_prey" &&
+        model != "highway") {
+      throw std::invalid_argument("Unknown model " + model);
+    }
+  }
+  return options;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  try {
+    options = parseOptions(argc, argv);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\nUsage: " << argv[0]
+              << " [--models boids,ants,predator_prey,highway]"
+                 " [--threads 1,2,4] [--sizes 1000,10000] [--steps 20]"
+                 " [--warmup 3] [--weak] [--json file] [--csv file]"
+              << std::endl;
+    return 2;
+  }
+
+  std::vector<Measure> measures;
+  for (const auto &model : options.models) {
+    for (std::size_t size : options.sizes) {
+      const auto sweep = measureSweep(model, options, size);
+      measures.insert(measures.end(), sweep.begin(), sweep.end());
+    }
+  }
+  printTable(measures);
+
+  if (!options.json.empty()) {
+    std::ofstream out(options.json);
+    writeJson(out, measures, options);
+    if (!out) {
+      std::cerr << "Cannot write " << options.json << std::endl;
+      return 1;
+    }
+  }
+  if (!options.csv.empty()) {
+    std::ofstream out(options.csv);
+    writeCsv(out, measures, options.weak);
+    if (!out) {
+      std::cerr << "Cannot write " << options.csv << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,718 @@
+// Microbenchmarks of the hot paths of the microkernel and of similar2logo.
+//
+// Run with --benchmark_out=results.json --benchmark_out_format=json (or
+// build the similar_benchmarks_json target) to keep the results of a release
+// and compare them with the next one, e.g. with tools/compare.py of Google
+// Benchmark.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "agents/IGlobalState.h"
+#include "dynamicstate/ConsistentPublicLocalDynamicState.h"
+#include "agents/ILocalStateOfAgent4Engine.h"
+#include "engine/MultiThreadedSimulationEngine.h"
+#include "engine/WorkStealingThreadPool.h"
+#include "environment/IEnvironment4Engine.h"
+#include "influences/InfluenceArena.h"
+#include "influences/InfluencesMap.h"
+#include "influences/RegularInfluence.h"
+#include "libs/AbstractAgent.h"
+#include "libs/PerformanceCounters.h"
+#include "libs/StepTimingRecorder.h"
+#include "libs/abstractimpl/AbstractLevel.h"
+#include "libs/generic/EmptyPerceivedData.h"
+
+#include "kernel/environment/Environment.h"
+#include "kernel/influences/AgentPositionUpdate.h"
+#include "kernel/influences/ChangeDirection.h"
+#include "kernel/influences/ChangePosition.h"
+#include "kernel/influences/DropMark.h"
+#include "kernel/influences/EmitPheromone.h"
+#include "kernel/influences/PheromoneFieldUpdate.h"
+#include "kernel/influences/RemoveMark.h"
+#include "kernel/model/environment/LogoEnvPLS.h"
+#include "kernel/model/environment/TurtlePLSInLogo.h"
+#include "kernel/model/levels/LogoDefaultReactionModel.h"
+#include "kernel/reaction/Reaction.h"
+#include "kernel/tools/Point2D.h"
+
+namespace mk = fr::univ_artois::lgi2a::similar::microkernel;
+namespace s2l = fr::univ_artois::lgi2a::similar::similar2logo::kernel;
+
+namespace {
+
+using TurtlePtr = std::shared_ptr<s2l::model::environment::TurtlePLSInLogo>;
+
+const mk::LevelIdentifier TURTLES("turtles");
+
+std::vector<TurtlePtr> makeTurtles(s2l::environment::Environment &env,
+                                   int count) {
+  std::vector<TurtlePtr> turtles;
+  turtles.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    auto turtle = std::make_shared<s2l::model::environment::TurtlePLSInLogo>(
+        s2l::tools::Point2D(i % env.width() + 0.5,
+                            (i / env.width()) % env.height() + 0.5),
+        0.1 * i, 1.0, 0.0, false, "blue");
+    env.add_turtle(turtle);
+    turtles.push_back(turtle);
+  }
+  return turtles;
+}
+
+int gridSideFor(int turtles) {
+  return std::max(16, static_cast<int>(std::sqrt(turtles * 4.0)));
+}
+
+// Reports hardware counters by iteration, where the machine counts them
+// (see PerformanceCounters): instructions by cycle, misses of the last
+// level cache by thousand instructions and branch misses.
+void reportCounters(benchmark::State &state,
+                    const mk::libs::CounterValues &values) {
+  if (values.cycles == 0) {
+    return;
+  }
+  state.counters["ipc"] = values.instructionsPerCycle();
+  state.counters["llc_mpki"] = values.cacheMissesPerKiloInstruction();
+  state.counters["branch_misses"] = benchmark::Counter(
+      static_cast<double>(values.branchMisses),
+      benchmark::Counter::kAvgIterations);
+}
+
+// ---------------------------------------------------------------------------
+// InfluencesMap
+
+std::vector<std::shared_ptr<mk::influences::IInfluence>>
+makeInfluences(int count) {
+  static const mk::LevelIdentifier levels[] = {
+      mk::LevelIdentifier("a"), mk::LevelIdentifier("b"),
+      mk::LevelIdentifier("c"), mk::LevelIdentifier("d")};
+  std::vector<std::shared_ptr<mk::influences::IInfluence>> influences;
+  influences.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    influences.push_back(std::make_shared<mk::influences::RegularInfluence>(
+        "benchmark", levels[i % 4], mk::SimulationTimeStamp(0),
+        mk::SimulationTimeStamp(1)));
+  }
+  return influences;
+}
+
+void BM_InfluencesMapAdd(benchmark::State &state) {
+  const auto influences = makeInfluences(static_cast<int>(state.range(0)));
+  mk::influences::InfluencesMap map;
+  for (auto _ : state) {
+    map.clear();
+    for (const auto &influence : influences) {
+      map.add(influence);
+    }
+    benchmark::DoNotOptimize(map);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_InfluencesMapAdd)->Arg(1000)->Arg(10000)->Arg(100000);
+
+void BM_InfluencesMapMerge(benchmark::State &state) {
+  const auto influences = makeInfluences(static_cast<int>(state.range(0)));
+  mk::influences::InfluencesMap part;
+  for (const auto &influence : influences) {
+    part.add(influence);
+  }
+  mk::influences::InfluencesMap merged;
+  for (auto _ : state) {
+    merged.clear();
+    merged.addAll(part);
+    merged.addAll(part);
+    benchmark::DoNotOptimize(merged);
+  }
+  state.SetItemsProcessed(state.iterations() * 2 * state.range(0));
+}
+BENCHMARK(BM_InfluencesMapMerge)->Arg(1000)->Arg(10000)->Arg(100000);
+
+// ---------------------------------------------------------------------------
+// similar2logo environment and reaction
+
+void BM_ReactionApply(benchmark::State &state) {
+  const int count = static_cast<int>(state.range(0));
+  const int side = gridSideFor(count);
+  s2l::environment::Environment env(side, side, true);
+  const auto turtles = makeTurtles(env, count);
+  const mk::SimulationTimeStamp t0(0);
+  const mk::SimulationTimeStamp t1(1);
+  std::vector<std::shared_ptr<mk::influences::IInfluence>> influences;
+  influences.reserve(2 * turtles.size());
+  for (const auto &turtle : turtles) {
+    influences.push_back(
+        std::make_shared<s2l::influences::ChangeDirection>(t0, t1, 0.01,
+                                                           turtle));
+    influences.push_back(std::make_shared<s2l::influences::ChangePosition>(
+        t0, t1, 0.3, -0.2, turtle));
+  }
+  s2l::reaction::Reaction reaction;
+  for (auto _ : state) {
+    reaction.apply(influences, env);
+  }
+  state.SetItemsProcessed(state.iterations() * influences.size());
+}
+BENCHMARK(BM_ReactionApply)->Arg(1000)->Arg(10000)->Arg(100000);
+
+// The natural move of all the turtles by their speed, one loop over the
+// columns of the turtle store.
+void BM_AgentPositionUpdate(benchmark::State &state) {
+  const int count = static_cast<int>(state.range(0));
+  const int side = gridSideFor(count);
+  s2l::environment::Environment env(side, side, true);
+  const auto turtles = makeTurtles(env, count);
+  const mk::SimulationTimeStamp t0(0);
+  const mk::SimulationTimeStamp t1(1);
+  const std::vector<std::shared_ptr<mk::influences::IInfluence>> influences{
+      std::make_shared<s2l::influences::AgentPositionUpdate>(t0, t1)};
+  s2l::reaction::Reaction reaction;
+  for (auto _ : state) {
+    reaction.apply(influences, env);
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_AgentPositionUpdate)->Arg(10000)->Arg(100000);
+
+// The deposits of an ant model: every turtle emits a pheromone, and one in
+// ten drops a mark.
+void BM_ReactionDeposits(benchmark::State &state) {
+  const int count = static_cast<int>(state.range(0));
+  const int side = gridSideFor(count);
+  s2l::environment::Environment env(side, side, true);
+  env.add_pheromone("pheromone", 0.0, 0.0);
+  const mk::SimulationTimeStamp t0(0);
+  const mk::SimulationTimeStamp t1(1);
+  std::vector<std::shared_ptr<mk::influences::IInfluence>> influences;
+  for (int i = 0; i < count; ++i) {
+    const s2l::tools::Point2D location((i * 7) % side + 0.5,
+                                       (i / side) % side + 0.5);
+    influences.push_back(std::make_shared<s2l::influences::EmitPheromone>(
+        t0, t1, location, "pheromone", 1.0));
+    if (i % 10 == 0) {
+      influences.push_back(std::make_shared<s2l::influences::DropMark>(
+          t0, t1,
+          std::make_shared<s2l::model::environment::SimpleMark>(location)));
+    }
+  }
+  s2l::reaction::Reaction reaction;
+  for (auto _ : state) {
+    reaction.apply(influences, env);
+  }
+  state.SetItemsProcessed(state.iterations() * influences.size());
+}
+BENCHMARK(BM_ReactionDeposits)->Arg(50000);
+
+// A trail of marks dropped, then picked up, by the DropMark and RemoveMark
+// influences of two steps, on a large grid.
+void BM_MarkDropRemove(benchmark::State &state) {
+  const int count = static_cast<int>(state.range(0));
+  const int side = 2048;
+  s2l::environment::Environment env(side, side, true);
+  const mk::SimulationTimeStamp t0(0);
+  const mk::SimulationTimeStamp t1(1);
+  std::vector<std::shared_ptr<mk::influences::IInfluence>> drops;
+  std::vector<std::shared_ptr<mk::influences::IInfluence>> removals;
+  for (int i = 0; i < count; ++i) {
+    const auto mark = std::make_shared<s2l::model::environment::SimpleMark>(
+        s2l::tools::Point2D((i * 37) % side + 0.5, (i * 11) % side + 0.5));
+    drops.push_back(std::make_shared<s2l::influences::DropMark>(t0, t1, mark));
+    removals.push_back(
+        std::make_shared<s2l::influences::RemoveMark>(t0, t1, mark));
+  }
+  s2l::reaction::Reaction reaction;
+  for (auto _ : state) {
+    reaction.apply(drops, env);
+    reaction.apply(removals, env);
+  }
+  state.SetItemsProcessed(state.iterations() * 2 * count);
+}
+BENCHMARK(BM_MarkDropRemove)->Arg(50000);
+
+// The perception of a flocking step: every turtle looks for its neighbours
+// once the moves of the previous step sorted the turtles again.
+void BM_TurtlesInRadius(benchmark::State &state) {
+  const int count = static_cast<int>(state.range(0));
+  const int side = gridSideFor(count);
+  s2l::environment::Environment env(side, side, true);
+  const auto turtles = makeTurtles(env, count);
+  long neighbours = 0;
+  for (auto _ : state) {
+    env.update_turtle_patch(turtles.front(), 0, 0, 0, 0);
+    for (const auto &turtle : turtles) {
+      env.query_radius(turtle->getLocation(), 2.0,
+                       [&](const TurtlePtr &) { ++neighbours; });
+    }
+  }
+  benchmark::DoNotOptimize(neighbours);
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_TurtlesInRadius)->Arg(10000)->Arg(100000);
+
+// The same perception answered by the batch query, on the pool lent as the
+// engine lends it to the sequential reactions.
+void BM_TurtlesInRadiusAll(benchmark::State &state) {
+  const int count = static_cast<int>(state.range(0));
+  const int side = gridSideFor(count);
+  s2l::environment::Environment env(side, side, true);
+  const auto turtles = makeTurtles(env, count);
+  mk::engine::WorkStealingThreadPool pool(
+      std::max(1u, std::thread::hardware_concurrency()));
+  mk::engine::WorkStealingThreadPool::Scope lentPool(&pool);
+  std::vector<long> neighbours(turtles.size());
+  for (auto _ : state) {
+    env.update_turtle_patch(turtles.front(), 0, 0, 0, 0);
+    env.query_radius_all(2.0, [&](std::size_t i, const TurtlePtr &) {
+      ++neighbours[i];
+    });
+  }
+  benchmark::DoNotOptimize(neighbours.data());
+  state.SetItemsProcessed(state.iterations() * count);
+  state.counters["threads"] = static_cast<double>(pool.size());
+}
+BENCHMARK(BM_TurtlesInRadiusAll)->Arg(10000)->Arg(100000);
+
+void BM_DiffuseAndEvaporate(benchmark::State &state) {
+  const int side = static_cast<int>(state.range(0));
+  s2l::environment::Environment env(side, side, true);
+  env.add_pheromone("pheromone", 0.2, 0.05);
+  for (int i = 0; i < side; ++i) {
+    env.set_pheromone(i, (i * 7) % side, "pheromone", 100.0);
+  }
+  mk::libs::PerformanceCounters counters;
+  const mk::libs::CounterValues start = counters.read();
+  for (auto _ : state) {
+    env.diffuse_and_evaporate(1.0);
+  }
+  reportCounters(state, counters.read() - start);
+  state.SetItemsProcessed(state.iterations() * side * side);
+}
+BENCHMARK(BM_DiffuseAndEvaporate)->Arg(64)->Arg(256)->Arg(1024);
+
+// Fused update of several pheromones, e.g. the food and nest trails of ants.
+void BM_DiffuseAndEvaporatePheromones(benchmark::State &state) {
+  const int side = static_cast<int>(state.range(0));
+  const int pheromones = static_cast<int>(state.range(1));
+  s2l::environment::Environment env(side, side, true);
+  for (int p = 0; p < pheromones; ++p) {
+    const std::string id = "pheromone" + std::to_string(p);
+    env.add_pheromone(id, 0.2, 0.05, 0.0, 1e-6);
+    for (int i = 0; i < side; ++i) {
+      env.set_pheromone(i, (i * 7 + p) % side, id, 100.0);
+    }
+  }
+  for (auto _ : state) {
+    env.diffuse_and_evaporate(1.0);
+  }
+  state.SetItemsProcessed(state.iterations() * side * side * pheromones);
+}
+BENCHMARK(BM_DiffuseAndEvaporatePheromones)
+    ->ArgsProduct({{1024, 2048}, {1, 2, 4}});
+
+// A single trail on a large grid: only the tiles around it are updated.
+void BM_DiffuseAndEvaporateSparseTrail(benchmark::State &state) {
+  const int side = static_cast<int>(state.range(0));
+  s2l::environment::Environment env(side, side, true);
+  env.add_pheromone("pheromone", 0.2, 0.05, 0.0, 1e-3);
+  int step = 0;
+  for (auto _ : state) {
+    // A turtle moving along a diagonal keeps the trail alive.
+    const int position = step++ % side;
+    env.set_pheromone(position, position, "pheromone", 100.0);
+    env.diffuse_and_evaporate(1.0);
+  }
+  state.counters["active_tiles"] =
+      static_cast<double>(env.get_active_tile_count("pheromone"));
+  state.SetItemsProcessed(state.iterations() * side * side);
+}
+BENCHMARK(BM_DiffuseAndEvaporateSparseTrail)->Arg(1024)->Arg(4096);
+
+// The pheromone sensing of the turtles, by identifier (0) or by handle (1).
+void BM_PheromoneSensing(benchmark::State &state) {
+  const bool byHandle = state.range(0) != 0;
+  s2l::environment::Environment env(256, 256, true);
+  const std::string id = "pheromone";
+  const auto pheromone = env.add_pheromone(id, 0.2, 0.05, 1.0);
+  int cell = 0;
+  for (auto _ : state) {
+    const double x = cell % 256;
+    const double y = cell / 256 % 256;
+    benchmark::DoNotOptimize(byHandle ? env.get_pheromone_value(x, y, pheromone)
+                                      : env.get_pheromone_value(x, y, id));
+    cell += 97;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PheromoneSensing)->Arg(0)->Arg(1);
+
+// The left, ahead and right readings of a pheromone around every turtle:
+// three get_pheromone_value() per turtle (0) or one sample_gradient_all() (1).
+void BM_GradientSensing(benchmark::State &state) {
+  const bool batched = state.range(0) != 0;
+  const int count = 10000;
+  const int side = gridSideFor(count);
+  s2l::environment::Environment env(side, side, true);
+  const auto turtles = makeTurtles(env, count);
+  const auto pheromone = env.add_pheromone("pheromone", 0.2, 0.05, 1.0);
+  const double angle = 0.5;
+  const double distance = 2.0;
+  for (auto _ : state) {
+    if (batched) {
+      benchmark::DoNotOptimize(
+          env.sample_gradient_all(angle, distance, pheromone));
+    } else {
+      double sum = 0;
+      for (const auto &turtle : env.get_turtles()) {
+        const auto location = turtle->getLocation();
+        const double heading = turtle->getHeading();
+        for (const double turn : {angle, 0.0, -angle}) {
+          sum += env.get_pheromone_value(
+              location.x + distance * std::cos(heading + turn),
+              location.y + distance * std::sin(heading + turn), pheromone);
+        }
+      }
+      benchmark::DoNotOptimize(sum);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_GradientSensing)->Arg(0)->Arg(1);
+
+void BM_LogoEnvPLSGetNeighbors(benchmark::State &state) {
+  const int distance = static_cast<int>(state.range(0));
+  s2l::model::environment::LogoEnvPLS pls(
+      mk::LevelIdentifier("logo"), 256, 256, true, true,
+      std::unordered_set<s2l::model::environment::Pheromone>());
+  int cell = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(pls.getNeighbors(cell % 256, cell / 256 % 256,
+                                              distance));
+    cell += 97;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LogoEnvPLSGetNeighbors)->Arg(1)->Arg(3)->Arg(8);
+
+void BM_LogoEnvPLSForEachNeighbor(benchmark::State &state) {
+  const int distance = static_cast<int>(state.range(0));
+  s2l::model::environment::LogoEnvPLS pls(
+      mk::LevelIdentifier("logo"), 256, 256, true, true,
+      std::unordered_set<s2l::model::environment::Pheromone>());
+  int cell = 0;
+  for (auto _ : state) {
+    int sum = 0;
+    pls.forEachNeighbor(cell % 256, cell / 256 % 256, distance,
+                        [&](int x, int y) { sum += x ^ y; });
+    benchmark::DoNotOptimize(sum);
+    cell += 97;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LogoEnvPLSForEachNeighbor)->Arg(1)->Arg(3)->Arg(8);
+
+// The pheromone fields of a LogoEnvPLS updated by the reaction model, with
+// trails dropped on a tenth of the rows of a large grid.
+void BM_LogoReactionPheromones(benchmark::State &state) {
+  const int side = 1024;
+  const mk::SimulationTimeStamp t0(0);
+  const mk::SimulationTimeStamp t1(1);
+  const mk::LevelIdentifier level("logo");
+  auto env = std::make_shared<s2l::model::environment::LogoEnvPLS>(
+      level, side, side, true, true,
+      std::unordered_set<s2l::model::environment::Pheromone>{
+          s2l::model::environment::Pheromone("trail", 0.2, 0.05, 0.0,
+                                             1e-3)});
+  const auto pheromone = *env->getPheromoneField().begin();
+  auto consistent =
+      std::make_shared<mk::dynamicstate::ConsistentPublicLocalDynamicState>(
+          t0, level);
+  consistent->setPublicLocalStateOfEnvironment(env);
+  const std::set<std::shared_ptr<mk::influences::IInfluence>> influences = {
+      std::make_shared<s2l::influences::PheromoneFieldUpdate>(t0, t1)};
+  auto remaining = std::make_shared<mk::influences::InfluencesMap>();
+  s2l::model::levels::LogoDefaultReactionModel reaction;
+  for (auto _ : state) {
+    for (int y = 0; y < side; y += 10) {
+      env->setPheromoneValueAt(pheromone.first, (y * 37) % side, y, 10.0);
+    }
+    reaction.makeRegularReaction(t0, t1, consistent, influences, remaining);
+  }
+  state.SetItemsProcessed(state.iterations() * side * side);
+}
+BENCHMARK(BM_LogoReactionPheromones);
+
+// ---------------------------------------------------------------------------
+// Full steps of the multithreaded engine
+
+/** The public local state of a turtle, pointing to its state in the grid. */
+class TurtleState : public mk::agents::ILocalStateOfAgent4Engine {
+private:
+  std::weak_ptr<mk::agents::IAgent4Engine> owner;
+
+public:
+  TurtlePtr turtle;
+
+  TurtleState(std::shared_ptr<mk::agents::IAgent4Engine> owner,
+              TurtlePtr turtle)
+      : owner(owner), turtle(std::move(turtle)) {}
+
+  mk::LevelIdentifier getLevel() const override { return TURTLES; }
+  mk::AgentCategory getCategoryOfAgent() const override {
+    return mk::AgentCategory("turtle");
+  }
+  bool isOwnedBy(const mk::agents::IAgent &agent) const override {
+    return owner.lock().get() == &agent;
+  }
+  std::shared_ptr<mk::agents::IAgent4Engine> getOwner() const override {
+    return owner.lock();
+  }
+  std::shared_ptr<mk::ILocalState> clone() const override {
+    return std::make_shared<TurtleState>(*this);
+  }
+};
+
+class NoGlobalState : public mk::agents::IGlobalState {
+public:
+  std::shared_ptr<mk::agents::IGlobalState> clone() const override {
+    return std::make_shared<NoGlobalState>();
+  }
+};
+
+/** A turtle turning a little and moving forward at every step. */
+class TurtleAgent : public mk::libs::AbstractAgent {
+public:
+  TurtleAgent() : AbstractAgent(mk::AgentCategory("turtle")) {}
+
+  std::shared_ptr<mk::agents::IPerceivedData>
+  perceive(const mk::LevelIdentifier &level,
+           const mk::SimulationTimeStamp &timeLowerBound,
+           const mk::SimulationTimeStamp &timeUpperBound,
+           const std::map<mk::LevelIdentifier,
+                          std::shared_ptr<mk::agents::ILocalStateOfAgent>> &,
+           std::shared_ptr<mk::agents::ILocalStateOfAgent>,
+           std::shared_ptr<mk::dynamicstate::IPublicDynamicStateMap>)
+      override {
+    return std::make_shared<mk::libs::generic::EmptyPerceivedData>(
+        level, timeLowerBound, timeUpperBound);
+  }
+
+  void reviseGlobalState(
+      const mk::SimulationTimeStamp &, const mk::SimulationTimeStamp &,
+      const std::map<mk::LevelIdentifier,
+                     std::shared_ptr<mk::agents::IPerceivedData>> &,
+      std::shared_ptr<mk::agents::IGlobalState>) override {}
+
+  void decide(const mk::LevelIdentifier &level,
+              const mk::SimulationTimeStamp &timeLowerBound,
+              const mk::SimulationTimeStamp &timeUpperBound,
+              std::shared_ptr<mk::agents::IGlobalState>,
+              std::shared_ptr<mk::agents::ILocalStateOfAgent> publicLocalState,
+              std::shared_ptr<mk::agents::ILocalStateOfAgent>,
+              std::shared_ptr<mk::agents::IPerceivedData>,
+              std::shared_ptr<mk::influences::InfluencesMap> producedInfluences)
+      override {
+    const auto &turtle =
+        static_cast<const TurtleState &>(*publicLocalState).turtle;
+    const double heading = turtle->getHeading();
+    producedInfluences->add(
+        mk::influences::makeInfluence<s2l::influences::ChangeDirection>(
+            level, timeLowerBound, timeUpperBound, 0.05, turtle));
+    producedInfluences->add(
+        mk::influences::makeInfluence<s2l::influences::ChangePosition>(
+            level, timeLowerBound, timeUpperBound, std::cos(heading),
+            std::sin(heading), turtle));
+  }
+
+  std::shared_ptr<mk::agents::IAgent> clone() const override {
+    return std::make_shared<TurtleAgent>(*this);
+  }
+};
+
+/** The level of the turtles, applying their influences to the grid. */
+class TurtleLevel : public mk::libs::abstractimpl::AbstractLevel {
+private:
+  std::shared_ptr<s2l::environment::Environment> grid;
+  s2l::reaction::Reaction reaction;
+  std::vector<std::shared_ptr<mk::influences::IInfluence>> batch;
+
+public:
+  explicit TurtleLevel(std::shared_ptr<s2l::environment::Environment> grid)
+      : AbstractLevel(mk::SimulationTimeStamp(0), TURTLES),
+        grid(std::move(grid)) {}
+
+  mk::SimulationTimeStamp
+  getNextTime(const mk::SimulationTimeStamp &currentTime) override {
+    return mk::SimulationTimeStamp(currentTime, 1);
+  }
+
+  void makeRegularReaction(
+      const mk::SimulationTimeStamp &, const mk::SimulationTimeStamp &upper,
+      std::shared_ptr<mk::dynamicstate::ConsistentPublicLocalDynamicState>
+          consistentState,
+      const std::set<std::shared_ptr<mk::influences::IInfluence>> &influences,
+      std::shared_ptr<mk::influences::InfluencesMap>) override {
+    batch.assign(influences.begin(), influences.end());
+    reaction.apply(batch, *grid);
+    batch.clear();
+    consistentState->setTime(upper);
+  }
+
+  void makeSystemReaction(
+      const mk::SimulationTimeStamp &, const mk::SimulationTimeStamp &,
+      std::shared_ptr<mk::dynamicstate::ConsistentPublicLocalDynamicState>,
+      const std::vector<std::shared_ptr<mk::influences::IInfluence>> &, bool,
+      std::shared_ptr<mk::influences::InfluencesMap>) override {}
+
+  std::shared_ptr<mk::levels::ILevel> clone() const override {
+    return std::make_shared<TurtleLevel>(*this);
+  }
+};
+
+class NoEnvironment : public mk::environment::IEnvironment4Engine {
+public:
+  std::shared_ptr<mk::environment::ILocalStateOfEnvironment>
+  getPublicLocalState(const mk::LevelIdentifier &) const override {
+    return nullptr;
+  }
+  std::shared_ptr<mk::environment::ILocalStateOfEnvironment>
+  getPrivateLocalState(const mk::LevelIdentifier &) const override {
+    return nullptr;
+  }
+  void natural(const mk::LevelIdentifier &, const mk::SimulationTimeStamp &,
+               const mk::SimulationTimeStamp &,
+               const std::map<mk::LevelIdentifier,
+                              std::shared_ptr<
+                                  mk::environment::ILocalStateOfEnvironment>> &,
+               std::shared_ptr<mk::environment::ILocalStateOfEnvironment>,
+               std::shared_ptr<mk::dynamicstate::IPublicDynamicStateMap>,
+               std::shared_ptr<mk::influences::InfluencesMap>) override {}
+  std::map<mk::LevelIdentifier,
+           std::shared_ptr<mk::environment::ILocalStateOfEnvironment>>
+  getPublicLocalStates() const override {
+    return {};
+  }
+  std::shared_ptr<mk::environment::IEnvironment> clone() const override {
+    return std::make_shared<NoEnvironment>();
+  }
+};
+
+/** A model of turtles whose last step is raised by the benchmark loop. */
+class TurtleModel : public mk::ISimulationModel {
+private:
+  int turtleCount;
+
+public:
+  long finalStep = 0;
+
+  explicit TurtleModel(int turtleCount) : turtleCount(turtleCount) {}
+
+  mk::SimulationTimeStamp getInitialTime() const override {
+    return mk::SimulationTimeStamp(0);
+  }
+
+  bool isFinalTimeOrAfter(const mk::SimulationTimeStamp &currentTime,
+                          const mk::ISimulationEngine &) const override {
+    return currentTime.getIdentifier() >= finalStep;
+  }
+
+  std::vector<std::shared_ptr<mk::levels::ILevel>>
+  generateLevels(const mk::SimulationTimeStamp &) override {
+    const int side = gridSideFor(turtleCount);
+    grid = std::make_shared<s2l::environment::Environment>(side, side, true);
+    return {std::make_shared<TurtleLevel>(grid)};
+  }
+
+  EnvironmentInitializationData generateEnvironment(
+      const mk::SimulationTimeStamp &,
+      const std::map<mk::LevelIdentifier, std::shared_ptr<mk::levels::ILevel>>
+          &) override {
+    return EnvironmentInitializationData(std::make_shared<NoEnvironment>());
+  }
+
+  AgentInitializationData generateAgents(
+      const mk::SimulationTimeStamp &,
+      const std::map<mk::LevelIdentifier, std::shared_ptr<mk::levels::ILevel>>
+          &) override {
+    AgentInitializationData data;
+    for (const auto &turtle : makeTurtles(*grid, turtleCount)) {
+      auto agent = std::make_shared<TurtleAgent>();
+      auto state = std::make_shared<TurtleState>(agent, turtle);
+      agent->includeNewLevel(TURTLES, state, state);
+      agent->initializeGlobalState(std::make_shared<NoGlobalState>());
+      data.getAgents().insert(agent);
+    }
+    return data;
+  }
+
+private:
+  std::shared_ptr<s2l::environment::Environment> grid;
+};
+
+void BM_MultiThreadedStep(benchmark::State &state) {
+  const int turtles = static_cast<int>(state.range(0));
+  auto model = std::make_shared<TurtleModel>(turtles);
+  mk::engine::MultiThreadedSimulationEngine engine(
+      static_cast<size_t>(state.range(1)));
+  // The final step is 0, so that the engine only initializes the simulation.
+  engine.runNewSimulation(model);
+  for (auto _ : state) {
+    ++model->finalStep;
+    engine.runSimulation(mk::SimulationTimeStamp(model->finalStep));
+  }
+  state.SetItemsProcessed(state.iterations() * turtles);
+  state.counters["threads"] = static_cast<double>(engine.getNumThreads());
+}
+BENCHMARK(BM_MultiThreadedStep)
+    ->ArgsProduct({{1000, 10000, 100000}, {1, 0}})
+    ->ArgNames({"turtles", "threads"})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// The steps of BM_MultiThreadedStep counted by phase, to tell the phases
+// bound by the memory from the ones bound by the computations.
+void BM_MultiThreadedStepCounted(benchmark::State &state) {
+  const int turtles = static_cast<int>(state.range(0));
+  auto model = std::make_shared<TurtleModel>(turtles);
+  mk::engine::MultiThreadedSimulationEngine engine(
+      static_cast<size_t>(state.range(1)));
+  if (!engine.setPerformanceCounting(true)) {
+    state.SkipWithError("No hardware counters on this machine");
+    return;
+  }
+  auto recorder = std::make_shared<mk::libs::StepTimingRecorder>(1);
+  engine.setStepTimingListener(recorder);
+  engine.runNewSimulation(model);
+  mk::StepTimings::PhaseCounters sum;
+  for (auto _ : state) {
+    ++model->finalStep;
+    engine.runSimulation(mk::SimulationTimeStamp(model->finalStep));
+    const mk::StepTimings step = recorder->getLatest();
+    sum.agentPhase += step.counters.agentPhase;
+    sum.reaction += step.counters.reaction;
+    sum.total += step.counters.total;
+  }
+  reportCounters(state, sum.total);
+  state.counters["agents_ipc"] = sum.agentPhase.instructionsPerCycle();
+  state.counters["agents_llc_mpki"] =
+      sum.agentPhase.cacheMissesPerKiloInstruction();
+  state.counters["reaction_ipc"] = sum.reaction.instructionsPerCycle();
+  state.SetItemsProcessed(state.iterations() * turtles);
+}
+BENCHMARK(BM_MultiThreadedStepCounted)
+    ->ArgsProduct({{10000, 100000}, {1, 0}})
+    ->ArgNames({"turtles", "threads"})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -41,6 +41,18 @@ def main():
     print(f"   ✓ Clone created - now we have two independent engines!")
     print()
     
+    # Fork a running simulation: the branches share the pheromone fields
+    # and the marks of the engine until they write them
+    print("4. Forking a running simulation...")
+    engine.initialize_simulation(model)
+    engine.run_simulation(10)
+    branches = [engine.fork() for _ in range(3)]
+    for i, branch in enumerate(branches):
+        branch.run_simulation(10 + 10 * (i + 1))
+        print(f"   ✓ Branch {i + 1} ran on to step {branch.get_current_time()}")
+    print(f"   ✓ The original is still at step {engine.get_current_time()}")
+    print()
+
     print("=" * 60)
     print("SUCCESS: Engine cloning works!")
     print("=" * 60)
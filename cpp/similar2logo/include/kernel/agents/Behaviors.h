@@ -0,0 +1,214 @@
+#ifndef SIMILAR2LOGO_BEHAVIORS_H
+#define SIMILAR2LOGO_BEHAVIORS_H
+
+#include "kernel/agents/LogoAgent.h"
+#include "kernel/model/environment/TurtlePLSInLogo.h"
+#include <agents/IAgtDecisionModel.h>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace agents {
+
+/**
+ * Native decision models of the common Logo models, deciding from a
+ * LogoPerceivedData without calling back into Python.
+ *
+ * The headings follow the Logo environment (model::environment::LogoEnvPLS):
+ * a turtle of heading h moves along (-sin h, cos h). The positions of the
+ * nearby turtles are taken as seen from the perceiving turtle, that is
+ * across the toroidal borders when the grid is a torus. The models are
+ * stateless and may be shared by any number of turtles, the random draws
+ * using the stream of the deciding agent.
+ */
+class BehaviorDecisionModel : public ek::agents::IAgtDecisionModel {
+public:
+  explicit BehaviorDecisionModel(const mk::LevelIdentifier &level)
+      : level(level) {}
+
+  mk::LevelIdentifier getLevel() const override { return level; }
+
+  /**
+   * Calls decideFor() with the perception of a turtle, ignoring the ones
+   * that are not a LogoPerceivedData or that do not know their turtle.
+   */
+  void
+  decide(const mk::SimulationTimeStamp &timeLowerBound,
+         const mk::SimulationTimeStamp &timeUpperBound,
+         std::shared_ptr<mk::agents::IGlobalState>,
+         std::shared_ptr<mk::agents::ILocalStateOfAgent>,
+         std::shared_ptr<mk::agents::ILocalStateOfAgent>,
+         std::shared_ptr<mk::agents::IPerceivedData> perceivedData,
+         std::shared_ptr<mk::influences::InfluencesMap> producedInfluences)
+      override;
+
+protected:
+  mk::LevelIdentifier level;
+
+  virtual void
+  decideFor(const LogoAgent::LogoPerceivedData &perception,
+            const std::shared_ptr<model::environment::TurtlePLSInLogo> &turtle,
+            const mk::SimulationTimeStamp &timeLowerBound,
+            const mk::SimulationTimeStamp &timeUpperBound,
+            mk::influences::InfluencesMap &producedInfluences) const = 0;
+};
+
+/**
+ * Flocking: a boid moves away from the turtles closer than the repulsion
+ * distance, aligns with the ones closer than the orientation distance and
+ * moves towards the ones closer than the attraction distance. It turns
+ * towards the weighted mean of these directions, by at most maxAngle.
+ */
+class BoidsDecisionModel : public BehaviorDecisionModel {
+public:
+  struct Parameters {
+    double repulsionDistance = 1;
+    double orientationDistance = 2;
+    double attractionDistance = 4;
+    double repulsionWeight = 10;
+    double orientationWeight = 20;
+    double attractionWeight = 0.1;
+    /** The largest change of heading in a step, in radians. */
+    double maxAngle = 0.7853981633974483;
+    /**
+     * Whether the directions towards the neighbours are approximated, within
+     * FastMath::ATAN2_ERROR radians, by a vectorized loop rather than
+     * computed by std::atan2.
+     */
+    bool approximateDirections = false;
+  };
+
+  BoidsDecisionModel(const mk::LevelIdentifier &level,
+                     const Parameters &parameters)
+      : BehaviorDecisionModel(level), parameters(parameters) {}
+
+  const Parameters &getParameters() const { return parameters; }
+
+protected:
+  void
+  decideFor(const LogoAgent::LogoPerceivedData &perception,
+            const std::shared_ptr<model::environment::TurtlePLSInLogo> &turtle,
+            const mk::SimulationTimeStamp &timeLowerBound,
+            const mk::SimulationTimeStamp &timeUpperBound,
+            mk::influences::InfluencesMap &producedInfluences) const override;
+
+private:
+  Parameters parameters;
+};
+
+/**
+ * An ant following a pheromone trail: it turns towards the side where the
+ * gradient of the pheromone (LogoPerceivedData::getPheromoneGradient()) is
+ * stronger than ahead (turning left adding to the heading, as in
+ * environment::Environment::sample_gradient()), wanders randomly by at most
+ * wiggleAngle off the trails, and drops depositedAmount of the pheromone
+ * where it stands.
+ */
+class PheromoneFollowingDecisionModel : public BehaviorDecisionModel {
+public:
+  struct Parameters {
+    std::string pheromone;
+    /** The change of heading towards a stronger side, in radians. */
+    double turnAngle = 0.7853981633974483;
+    /** The largest random change of heading off the trails, in radians. */
+    double wiggleAngle = 0.4363323129985824;
+    /** The pheromone values below which no trail is followed. */
+    double threshold = 0;
+    double depositedAmount = 0;
+  };
+
+  PheromoneFollowingDecisionModel(const mk::LevelIdentifier &level,
+                                  Parameters parameters)
+      : BehaviorDecisionModel(level), parameters(std::move(parameters)) {}
+
+  const Parameters &getParameters() const { return parameters; }
+
+protected:
+  void
+  decideFor(const LogoAgent::LogoPerceivedData &perception,
+            const std::shared_ptr<model::environment::TurtlePLSInLogo> &turtle,
+            const mk::SimulationTimeStamp &timeLowerBound,
+            const mk::SimulationTimeStamp &timeUpperBound,
+            mk::influences::InfluencesMap &producedInfluences) const override;
+
+private:
+  Parameters parameters;
+};
+
+/**
+ * A Schelling segregation agent: unhappy when the share of the nearby
+ * turtles of its category is below similarityRate, it then jumps by a
+ * random offset of at most maxJump along each axis, or, with relocate, moves
+ * to a random empty patch (see influences::Relocate).
+ */
+class SegregationDecisionModel : public BehaviorDecisionModel {
+public:
+  struct Parameters {
+    /** The category of the turtles using the model. */
+    std::string category;
+    double similarityRate = 0.5;
+    double maxJump = 10;
+    /** Whether the unhappy turtles move to an empty patch rather than jump */
+    bool relocate = false;
+  };
+
+  SegregationDecisionModel(const mk::LevelIdentifier &level,
+                           Parameters parameters)
+      : BehaviorDecisionModel(level), parameters(std::move(parameters)),
+        category(this->parameters.category) {}
+
+  const Parameters &getParameters() const { return parameters; }
+
+  /** Whether a turtle of the category is happy where it perceives. */
+  bool isHappy(const LogoAgent::LogoPerceivedData &perception) const;
+
+protected:
+  void
+  decideFor(const LogoAgent::LogoPerceivedData &perception,
+            const std::shared_ptr<model::environment::TurtlePLSInLogo> &turtle,
+            const mk::SimulationTimeStamp &timeLowerBound,
+            const mk::SimulationTimeStamp &timeUpperBound,
+            mk::influences::InfluencesMap &producedInfluences) const override;
+
+private:
+  Parameters parameters;
+  // the interned category, compared with the ones of the nearby turtles
+  mk::libs::Symbol category;
+};
+
+/**
+ * The parameters of a behavior given by name, as the DSL passes them: the
+ * names of the fields of the Parameters of the model, in snake case.
+ */
+struct BehaviorParameters {
+  std::map<std::string, double> values;
+  std::map<std::string, std::string> names;
+};
+
+/**
+ * Makes a native decision model from its name: "boids", "ant" (a
+ * PheromoneFollowingDecisionModel, whose "pheromone" is required) or
+ * "segregation" (a SegregationDecisionModel, whose "category" is required).
+ * The parameters that are not given keep their default value.
+ * @throws std::invalid_argument For an unknown behavior or parameter, or a
+ * missing required one.
+ */
+std::shared_ptr<ek::agents::IAgtDecisionModel>
+makeBehavior(const std::string &name, const mk::LevelIdentifier &level,
+             const BehaviorParameters &parameters);
+
+} // namespace agents
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_BEHAVIORS_H
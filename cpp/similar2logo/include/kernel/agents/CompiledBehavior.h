@@ -0,0 +1,93 @@
+#ifndef SIMILAR2LOGO_COMPILED_BEHAVIOR_H
+#define SIMILAR2LOGO_COMPILED_BEHAVIOR_H
+
+#include "kernel/agents/LogoAgent.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace agents {
+
+/**
+ * The entry point of a decision kernel: it reads the count rows of a batch
+ * (LogoAgent::BatchPerception), with their pheromoneCount pheromones each,
+ * and writes the change of heading and of speed of each row, zero on entry.
+ * The step seeds the random draws of the kernel.
+ */
+using CompiledKernel = void (*)(const LogoAgent::BatchPerception::Row *rows,
+                                std::size_t count, const double *pheromones,
+                                std::size_t pheromoneCount, long step,
+                                double *headingDeltas, double *speedDeltas);
+
+/**
+ * A shared library of a behavior compiled from the Python DSL
+ * (similar2logo.dsl.compiler), loaded at runtime.
+ *
+ * The library exports, with C linkage, the CompiledKernel
+ * "similar2logo_kernel" and "similar2logo_kernel_abi_version", returning the
+ * ABI_VERSION it was generated for. The rows are passed as the plain
+ * structure of LogoAgent::BatchPerception::Row, so that the library needs
+ * none of the headers or symbols of the engine. The library is unloaded
+ * with the last of its decision models.
+ */
+class CompiledBehaviorLibrary {
+public:
+  /** The version of the rows and of the signature of the kernel. */
+  static constexpr int ABI_VERSION = 1;
+
+  /**
+   * Loads a library.
+   * @throws std::runtime_error If it cannot be loaded, misses a symbol or
+   * was generated for another ABI_VERSION.
+   */
+  explicit CompiledBehaviorLibrary(const std::string &path);
+  ~CompiledBehaviorLibrary();
+
+  CompiledBehaviorLibrary(const CompiledBehaviorLibrary &) = delete;
+  CompiledBehaviorLibrary &operator=(const CompiledBehaviorLibrary &) = delete;
+
+  const std::string &getPath() const { return path; }
+  CompiledKernel getKernel() const { return kernel; }
+
+private:
+  std::string path;
+  void *handle = nullptr;
+  CompiledKernel kernel = nullptr;
+};
+
+/**
+ * Makes the batch decision model of a kernel, to be shared by the turtles
+ * deciding with it and set as the batch decision hook of the engine: each
+ * step runs the kernel once over the rows of all of them, with no call into
+ * Python.
+ * @param library Kept loaded by the model, if the kernel is one of its own
+ * @throws std::invalid_argument If the kernel is null.
+ */
+std::shared_ptr<LogoAgent::BatchDecisionModel> makeCompiledBehavior(
+    const mk::LevelIdentifier &level, CompiledKernel kernel,
+    std::vector<std::string> pheromoneNames,
+    std::shared_ptr<const CompiledBehaviorLibrary> library = nullptr);
+
+/** Makes the batch decision model of the kernel of a library. */
+std::shared_ptr<LogoAgent::BatchDecisionModel>
+makeCompiledBehavior(const mk::LevelIdentifier &level,
+                     std::shared_ptr<const CompiledBehaviorLibrary> library,
+                     std::vector<std::string> pheromoneNames);
+
+} // namespace agents
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_COMPILED_BEHAVIOR_H
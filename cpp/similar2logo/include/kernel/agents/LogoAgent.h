@@ -1,13 +1,20 @@
 #ifndef SIMILAR2LOGO_LOGOAGENT_H
 #define SIMILAR2LOGO_LOGOAGENT_H
 
+#include "kernel/model/environment/TurtlePLSInLogo.h"
 #include "kernel/tools/Point2D.h"
 #include <agents/ExtendedAgent.h>
 #include <agents/IAgtDecisionModel.h>
 #include <agents/IAgtPerceptionModel.h>
+#include <cstdint>
+#include <engine/IBatchDecisionHook.h>
+#include <libs/AbstractPerceivedData.h>
+#include <libs/SymbolTable.h>
 #include <functional>
+#include <map>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace fr {
@@ -30,7 +37,7 @@ namespace ek = fr::univ_artois::lgi2a::similar::extendedkernel;
 class LogoAgent : public ek::agents::ExtendedAgent {
 private:
   double speed;
-  std::string color;
+  mk::libs::Symbol color;
 
 public:
   LogoAgent(const mk::AgentCategory &category, double initialSpeed = 1.0,
@@ -42,8 +49,10 @@ public:
   double getSpeed() const { return speed; }
   void setSpeed(double newSpeed) { speed = newSpeed; }
 
-  const std::string &getColor() const { return color; }
-  void setColor(const std::string &newColor) { color = newColor; }
+  const std::string &getColor() const { return color.str(); }
+  void setColor(const std::string &newColor) {
+    color = mk::libs::Symbol(newColor);
+  }
 
   std::shared_ptr<mk::agents::IAgent> clone() const override {
     return std::make_shared<LogoAgent>(*this);
@@ -57,43 +66,59 @@ public:
 public:
   /**
    * Logo Perception Data - Contains what a turtle perceives.
+   *
+   * The nearby turtles and the pheromones can be deferred to the first
+   * read by deferNearbyTurtles() and deferPheromones(), so that a perception
+   * model leaves the fields that a decision model does not read uncomputed
+   * (see AbstractPerceivedData::Lazy).
    */
-  class LogoPerceivedData : public mk::agents::IPerceivedData {
-  private:
-    mk::LevelIdentifier level;
-    mk::SimulationTimeStamp timeLower, timeUpper;
+  class LogoPerceivedData : public mk::libs::AbstractPerceivedData {
+  public:
+    /** A turtle perceived near the perceiving one. */
+    struct NearbyTurtle {
+      tools::Point2D position;
+      double heading;
+      double distance;
+      mk::AgentCategory category;
+    };
 
+  private:
     // Perception data
     tools::Point2D position;
     double heading;
     double speed;
 
     // Nearby turtles
-    struct NearbyTurtle {
-      tools::Point2D position;
-      double heading;
-      double distance;
-      mk::AgentCategory category;
-    };
-    std::vector<NearbyTurtle> nearbyTurtles;
+    Lazy<std::vector<NearbyTurtle>> nearbyTurtles;
 
     // Pheromones at current location
-    std::map<std::string, double> pheromones;
+    Lazy<std::map<std::string, double>> pheromones;
+
+  public:
+    /** The values of a pheromone sensed ahead of a turtle and on its sides. */
+    struct PheromoneGradient {
+      double left;
+      double ahead;
+      double right;
+    };
+
+  private:
+    // Pheromones sensed around the turtle
+    std::map<std::string, PheromoneGradient> gradients;
+
+    // The public local state of the perceiving turtle, if known
+    std::shared_ptr<model::environment::TurtlePLSInLogo> turtle;
 
   public:
     LogoPerceivedData(const mk::LevelIdentifier &level,
                       const mk::SimulationTimeStamp &lower,
                       const mk::SimulationTimeStamp &upper,
                       const tools::Point2D &pos, double heading, double speed)
-        : level(level), timeLower(lower), timeUpper(upper), position(pos),
+        : AbstractPerceivedData(level, lower, upper), position(pos),
           heading(heading), speed(speed) {}
 
-    mk::LevelIdentifier getLevel() const override { return level; }
-    mk::SimulationTimeStamp getTransitoryPeriodMin() const override {
-      return timeLower;
-    }
-    mk::SimulationTimeStamp getTransitoryPeriodMax() const override {
-      return timeUpper;
+    std::shared_ptr<mk::agents::IPerceivedData> clone() const override {
+      return std::make_shared<LogoPerceivedData>(*this);
     }
 
     const tools::Point2D &getPosition() const { return position; }
@@ -102,24 +127,74 @@ public:
 
     void addNearbyTurtle(const tools::Point2D &pos, double heading,
                          double distance, const mk::AgentCategory &category) {
-      nearbyTurtles.push_back({pos, heading, distance, category});
+      nearbyTurtles.mutate().push_back({pos, heading, distance, category});
+    }
+
+    /**
+     * Defers the nearby turtles to a source filling them on the first call
+     * of getNearbyTurtles().
+     */
+    void deferNearbyTurtles(
+        Lazy<std::vector<NearbyTurtle>>::Source source) {
+      nearbyTurtles.defer(std::move(source));
     }
 
     const std::vector<NearbyTurtle> &getNearbyTurtles() const {
-      return nearbyTurtles;
+      return nearbyTurtles.get();
     }
 
+    /** Whether the nearby turtles were computed rather than still deferred. */
+    bool hasNearbyTurtles() const { return nearbyTurtles.isComputed(); }
+
     void setPheromone(const std::string &id, double value) {
-      pheromones[id] = value;
+      pheromones.mutate()[id] = value;
+    }
+
+    /**
+     * Defers the pheromones to a source filling them on the first call of
+     * getPheromone() or getAllPheromones().
+     */
+    void deferPheromones(
+        Lazy<std::map<std::string, double>>::Source source) {
+      pheromones.defer(std::move(source));
     }
 
     double getPheromone(const std::string &id) const {
-      auto it = pheromones.find(id);
-      return it != pheromones.end() ? it->second : 0.0;
+      const auto &values = pheromones.get();
+      auto it = values.find(id);
+      return it != values.end() ? it->second : 0.0;
     }
 
     const std::map<std::string, double> &getAllPheromones() const {
-      return pheromones;
+      return pheromones.get();
+    }
+
+    /** Whether the pheromones were computed rather than still deferred. */
+    bool hasPheromones() const { return pheromones.isComputed(); }
+
+    void setPheromoneGradient(const std::string &id, double left,
+                              double ahead, double right) {
+      gradients[id] = PheromoneGradient{left, ahead, right};
+    }
+
+    /** Gets the gradient of a pheromone, or nullptr if it was not sensed. */
+    const PheromoneGradient *getPheromoneGradient(const std::string &id) const {
+      auto it = gradients.find(id);
+      return it != gradients.end() ? &it->second : nullptr;
+    }
+
+    /**
+     * Sets the public local state of the perceiving turtle, the target of
+     * the influences of a BatchDecisionModel.
+     */
+    void setTurtle(
+        std::shared_ptr<model::environment::TurtlePLSInLogo> perceiving) {
+      turtle = std::move(perceiving);
+    }
+
+    const std::shared_ptr<model::environment::TurtlePLSInLogo> &
+    getTurtle() const {
+      return turtle;
     }
   };
 
@@ -163,6 +238,94 @@ public:
       }
     }
   };
+
+  /**
+   * The perceptions of the turtles deciding in a batch, one row each.
+   */
+  struct BatchPerception {
+    /** The perceived state of a turtle. */
+    struct Row {
+      double x;
+      double y;
+      double heading;
+      double speed;
+      std::uint32_t nearbyTurtles;
+    };
+    std::vector<Row> rows;
+    /**
+     * The pheromones of the model at the location of the turtles, row by
+     * row: the value of the pheromone j for the turtle of row i is at
+     * i * pheromoneNames.size() + j.
+     */
+    std::vector<double> pheromones;
+    std::vector<std::string> pheromoneNames;
+    /** The identifier of the lower bound of the time of the batch. */
+    long step = 0;
+  };
+
+  /** The decisions of a batch, element i being the one of row i. */
+  struct BatchDecisions {
+    /** The changes of heading, in radians. */
+    std::vector<double> headingDeltas;
+    /** The changes of speed. */
+    std::vector<double> speedDeltas;
+  };
+
+  /**
+   * Decides for all the turtles of a level at once.
+   *
+   * The model is shared by the turtles and set as the batch decision hook of
+   * the engine (MultiThreadedSimulationEngine::setBatchDecisionHook()). Once
+   * every agent perceived, it gathers the LogoPerceivedData of the turtles
+   * using it into a BatchPerception, and calls its callback once to fill the
+   * BatchDecisions, zero by default. The decide() of each turtle then emits
+   * a ChangeDirection and a ChangeSpeed influence for its non-zero deltas,
+   * targeted at LogoPerceivedData::getTurtle(), in parallel. A script
+   * decides thus in one call per step rather than one call per turtle.
+   */
+  class BatchDecisionModel : public ek::agents::IAgtDecisionModel,
+                             public mk::engine::IBatchDecisionHook {
+  public:
+    using BatchCallback =
+        std::function<void(const BatchPerception &, BatchDecisions &)>;
+
+    /**
+     * @param pheromoneNames The pheromones copied in the perception, 0 for
+     * the turtles that did not perceive them.
+     */
+    BatchDecisionModel(const mk::LevelIdentifier &level,
+                       std::vector<std::string> pheromoneNames,
+                       BatchCallback callback);
+
+    mk::LevelIdentifier getLevel() const override { return level; }
+
+    void perceived(const mk::SimulationTimeStamp &timeLowerBound,
+                   const mk::SimulationTimeStamp &timeUpperBound,
+                   const std::shared_ptr<mk::agents::IAgent4Engine> *agents,
+                   std::size_t count) override;
+
+    void
+    decide(const mk::SimulationTimeStamp &timeLowerBound,
+           const mk::SimulationTimeStamp &timeUpperBound,
+           std::shared_ptr<mk::agents::IGlobalState>,
+           std::shared_ptr<mk::agents::ILocalStateOfAgent>,
+           std::shared_ptr<mk::agents::ILocalStateOfAgent>,
+           std::shared_ptr<mk::agents::IPerceivedData> perceivedData,
+           std::shared_ptr<mk::influences::InfluencesMap> producedInfluences)
+        override;
+
+    /** Gets the perceptions of the last batch. */
+    const BatchPerception &getPerception() const { return perception; }
+
+  private:
+    mk::LevelIdentifier level;
+    BatchCallback callback;
+    BatchPerception perception;
+    BatchDecisions decisions;
+    // the row of each perceived data of the batch, read concurrently by the
+    // decisions
+    std::unordered_map<const mk::agents::IPerceivedData *, std::size_t> rows;
+  };
 };
 } // namespace agents
 } // namespace kernel
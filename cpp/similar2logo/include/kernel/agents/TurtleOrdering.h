@@ -0,0 +1,59 @@
+#ifndef SIMILAR2LOGO_TURTLEORDERING_H
+#define SIMILAR2LOGO_TURTLEORDERING_H
+
+#include "kernel/model/environment/TurtlePLSInLogo.h"
+#include <cstdint>
+#include <engine/IAgentOrdering.h>
+#include <functional>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace agents {
+
+namespace mk = fr::univ_artois::lgi2a::similar::microkernel;
+
+/**
+ * Orders the turtles of an engine along the Hilbert curve of their patches
+ * (see tools::SpaceFillingCurve), for the turtles stepped by a chunk of a
+ * worker to be neighbours, perceiving the same patches and turtles.
+ *
+ * Set on a MultiThreadedSimulationEngine with setAgentOrdering(); the
+ * Environment sorts its turtle store likewise with reorder_turtles(). The
+ * agents without a turtle, and those outside the grid, come last.
+ */
+class TurtleOrdering : public mk::engine::IAgentOrdering {
+public:
+  /**
+   * Gets the turtle of an agent, nullptr if it has none: the model knows
+   * which turtle it created for an agent.
+   */
+  using TurtleOf = std::function<const model::environment::TurtlePLSInLogo *(
+      const mk::agents::IAgent4Engine &)>;
+
+  /**
+   * @param turtleOf Gives the turtle of an agent.
+   * @param width The width of the grid, in patches.
+   * @param height The height of the grid, in patches.
+   */
+  TurtleOrdering(TurtleOf turtleOf, int width, int height);
+
+  std::uint64_t keyOf(const mk::agents::IAgent4Engine &agent) const override;
+
+private:
+  TurtleOf turtleOf;
+  unsigned bits;
+};
+
+} // namespace agents
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_TURTLEORDERING_H
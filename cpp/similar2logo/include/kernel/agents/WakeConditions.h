@@ -0,0 +1,99 @@
+#ifndef SIMILAR2LOGO_WAKECONDITIONS_H
+#define SIMILAR2LOGO_WAKECONDITIONS_H
+
+#include "kernel/model/environment/Pheromone.h"
+#include "kernel/tools/Point2D.h"
+#include <agents/IWakeCondition.h>
+#include <LevelIdentifier.h>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace model {
+namespace environment {
+class LogoEnvPLS;
+class TurtlePLSInLogo;
+} // namespace environment
+} // namespace model
+
+namespace agents {
+
+namespace mk = fr::univ_artois::lgi2a::similar::microkernel;
+
+/**
+ * Wakes a sleeping turtle up once another turtle stands within a radius of
+ * a location, e.g. a stopped turtle waiting for a neighbour. Only the
+ * patches of the radius are scanned.
+ */
+class NeighbourWakeCondition : public mk::agents::IWakeCondition {
+public:
+  /**
+   * @param level The Logo level of the turtles.
+   * @param center The location of the sleeping turtle.
+   * @param radius The distance at which a turtle wakes it up.
+   * @param self The turtle of the sleeping agent, never counted, or nullptr.
+   */
+  NeighbourWakeCondition(mk::LevelIdentifier level, tools::Point2D center,
+                         double radius,
+                         const model::environment::TurtlePLSInLogo *self);
+
+  bool isMet(const mk::SimulationTimeStamp &timeLowerBound,
+             const mk::dynamicstate::IPublicDynamicStateMap &dynamicStates)
+      const override;
+
+private:
+  mk::LevelIdentifier level;
+  tools::Point2D center;
+  double radius;
+  const model::environment::TurtlePLSInLogo *self;
+};
+
+/**
+ * Wakes a sleeping turtle up once a pheromone reaches a threshold on a
+ * patch, e.g. an ant waiting for a trail.
+ */
+class PheromoneWakeCondition : public mk::agents::IWakeCondition {
+public:
+  /**
+   * @param level The Logo level of the field.
+   * @param pheromone The pheromone.
+   * @param x The x coordinate of the patch.
+   * @param y The y coordinate of the patch.
+   * @param threshold The value at or above which the turtle wakes up.
+   */
+  PheromoneWakeCondition(mk::LevelIdentifier level,
+                         model::environment::Pheromone pheromone, int x, int y,
+                         double threshold);
+
+  bool isMet(const mk::SimulationTimeStamp &timeLowerBound,
+             const mk::dynamicstate::IPublicDynamicStateMap &dynamicStates)
+      const override;
+
+private:
+  mk::LevelIdentifier level;
+  model::environment::Pheromone pheromone;
+  int x;
+  int y;
+  double threshold;
+};
+
+/**
+ * Gets the environment of a Logo level from the consistent states, nullptr
+ * if the level has none.
+ */
+const model::environment::LogoEnvPLS *
+logoEnvironmentOf(const mk::dynamicstate::IPublicDynamicStateMap &dynamicStates,
+                  const mk::LevelIdentifier &level);
+
+} // namespace agents
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_WAKECONDITIONS_H
@@ -0,0 +1,315 @@
+#ifndef SIMILAR2LOGO_DISTRIBUTEDLOGOSIMULATIONENGINE_H
+#define SIMILAR2LOGO_DISTRIBUTEDLOGOSIMULATIONENGINE_H
+
+#include "../model/DistributedLogoSimulationModel.h"
+#include "../model/environment/LogoEnvPLS.h"
+#include "../tools/DomainDecomposition.h"
+#include "../tools/Point2D.h"
+#include "IDomainCommunicator.h"
+#include <IProbe.h>
+#include <ISimulationEngine.h>
+#include <checkpoint/CheckpointStream.h>
+#include <influences/InfluenceArena.h>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace engine {
+
+namespace mk = fr::univ_artois::lgi2a::similar::microkernel;
+
+/**
+ * An engine running one domain of a Logo simulation split between ranks
+ * (see tools::DomainDecomposition), the ranks communicating through an
+ * IDomainCommunicator: the processes of MPI, or threads of one process.
+ *
+ * Each rank runs its own engine, with its own instance of the model, on the
+ * local grid of its domain: the environment, the turtles and the locations
+ * perceived by the agents are in the coordinates of the local grid (see
+ * toGlobal()). A step of the LOGO level goes as follows:
+ * - the ranks copy the pheromones and the turtles of the borders of their
+ *   domains into the halos of their neighbours, as ghost patches and ghost
+ *   turtles, perceived like the others but without agents;
+ * - the agents of the domain perceive, revise their global state and
+ *   decide; the ghost turtles are then removed, with the influences aimed at
+ *   them;
+ * - the levels::LogoDefaultReactionModel of the level reacts to the
+ *   influences, with the natural PheromoneFieldUpdate and
+ *   AgentPositionUpdate the engine adds, as the natural model of Logo does;
+ * - the turtles which moved into a halo migrate to the rank owning their
+ *   patch, where the model creates their agent again before the engine
+ *   restores its checkpointable states (see checkpoint::ICheckpointable).
+ * The end of the simulation and its abortion are agreed on by all the
+ * ranks.
+ *
+ * A turtle moves at most the width of the halo in a step, and perceives
+ * within it. The emissions of pheromones in the borders of a domain are
+ * copied to the halos of its neighbours, while the marks are kept in the
+ * domain of the turtle dropping them. The ranks hold the same probes,
+ * observing in the same order: DistributedReductionProbe reduces their
+ * measures across the ranks.
+ *
+ * As the turtles gather, the domains can be rebalanced (see
+ * setRebalancing()): the ranks measure the time they spend running their
+ * agents and reacting, and when the busiest one exceeds the mean by a
+ * threshold, the cuts between the columns and the rows of domains move to
+ * even out the load, the patches changing hands with their pheromones,
+ * marks and turtles.
+ */
+class DistributedLogoSimulationEngine : public mk::ISimulationEngine {
+public:
+  /** A turtle of the domain of this rank, with its agent. */
+  struct HostedTurtle {
+    std::shared_ptr<mk::agents::IAgent4Engine> agent;
+    std::shared_ptr<model::environment::TurtlePLSInLogo> turtle;
+  };
+
+  /**
+   * @throws std::invalid_argument If the communicator is null.
+   */
+  explicit DistributedLogoSimulationEngine(
+      std::shared_ptr<IDomainCommunicator> communicator);
+  virtual ~DistributedLogoSimulationEngine();
+
+  /**
+   * Sets the columns and rows of the domains of the next simulations, chosen
+   * by tools::DomainDecomposition otherwise; the product has to be the
+   * number of ranks.
+   */
+  void setDomainGrid(int columns, int rows);
+
+  /**
+   * Rebalances the domains of the next simulations, every period steps,
+   * when the busiest rank spent more than threshold times the mean time
+   * running its agents and reacting over these steps. The load of a rank
+   * is spread over its patches and turtles at the measured cost of one
+   * turtle, and the columns and rows are cut again so that each bears an
+   * even share of the load of the grid.
+   * @param period The number of steps between two checks, 0 to keep the
+   * domains of the start.
+   * @throws std::invalid_argument If the period is negative or the
+   * threshold below 1.
+   */
+  void setRebalancing(long period, double threshold = 1.1);
+
+  /** Gets the number of times the domains moved since the start. */
+  long getRebalanceCount() const { return rebalanceCount; }
+
+  const std::shared_ptr<IDomainCommunicator> &getCommunicator() const {
+    return communicator;
+  }
+  int getRank() const { return communicator->getRank(); }
+  int getRankCount() const { return communicator->getSize(); }
+
+  /**
+   * Gets the decomposition of the grid of the simulation.
+   * @throws std::logic_error If no simulation was started.
+   */
+  const tools::DomainDecomposition &getDecomposition() const;
+
+  /** Gets the patches owned by this rank, in the coordinates of the grid. */
+  tools::DomainDecomposition::Box getDomain() const;
+
+  /** Gets the patches held by this rank, its domain and its halo. */
+  tools::DomainDecomposition::Box getLocalGrid() const;
+
+  /** Converts a location of the local grid to the coordinates of the grid. */
+  tools::Point2D toGlobal(const tools::Point2D &local) const;
+
+  /** Gets the environment of the local grid, or nullptr. */
+  const std::shared_ptr<model::environment::LogoEnvPLS> &
+  getLocalEnvironment() const {
+    return localEnvironment;
+  }
+
+  /** Gets the turtles of the domain of this rank. */
+  const std::vector<HostedTurtle> &getTurtles() const { return hosted; }
+
+  /**
+   * Reduces values across the ranks, a collective call (see
+   * IDomainCommunicator::allReduce()).
+   */
+  void allReduce(double *values, std::size_t count,
+                 IDomainCommunicator::Reduction reduction) const {
+    communicator->allReduce(values, count, reduction);
+  }
+
+  // ISimulationEngine implementation
+  void addProbe(const std::string &identifier,
+                std::shared_ptr<mk::IProbe> probe) override;
+  std::shared_ptr<mk::IProbe>
+  removeProbe(const std::string &identifier) override;
+  std::set<std::string> getProbesIdentifiers() const override;
+  void requestSimulationAbortion() override;
+
+  /**
+   * Runs a simulation of a model::DistributedLogoSimulationModel, on all
+   * the ranks together.
+   * @throws std::invalid_argument If the model is not distributed, or if its
+   * levels are not the sole LOGO level.
+   */
+  void runNewSimulation(
+      std::shared_ptr<mk::ISimulationModel> simulationModel) override;
+  void runSimulation(const mk::SimulationTimeStamp &finalTime) override;
+  void setStepTimingListener(
+      std::shared_ptr<mk::IStepTimingListener> listener) override;
+  std::shared_ptr<mk::IStepTimingListener>
+  getStepTimingListener() const override;
+  void
+  setStepBarrier(std::shared_ptr<mk::engine::StepBarrier> barrier) override;
+  std::shared_ptr<mk::engine::StepBarrier> getStepBarrier() const override;
+
+  std::shared_ptr<mk::dynamicstate::IPublicDynamicStateMap>
+  getSimulationDynamicStates() const override;
+  /** Gets the agents of the domain of this rank. */
+  std::set<std::shared_ptr<mk::agents::IAgent4Engine>>
+  getAgents() const override;
+  std::set<mk::LevelIdentifier> getLevelIdentifiers() const override;
+  std::map<mk::LevelIdentifier, std::shared_ptr<mk::levels::ILevel>>
+  getLevels() const override;
+  std::set<std::shared_ptr<mk::agents::IAgent4Engine>>
+  getAgents(const mk::LevelIdentifier &level) const override;
+  std::shared_ptr<mk::environment::IEnvironment4Engine>
+  getEnvironment() const override;
+
+  std::shared_ptr<mk::dynamicstate::ConsistentPublicLocalDynamicState>
+  disambiguation(
+      std::shared_ptr<mk::dynamicstate::TransitoryPublicLocalDynamicState>
+          transitoryDynamicState) const override;
+
+  /**
+   * @throws std::logic_error Always: the engine of a rank runs with the
+   * others, and cannot be copied apart from them.
+   */
+  std::shared_ptr<mk::ISimulationEngine> clone() const override;
+
+private:
+  /**
+   * The patches exchanged with a peer: the local cells sent to it, and the
+   * local cells of the halo received from it, in the same order on both
+   * ranks.
+   */
+  struct Peer {
+    int rank;
+    std::vector<std::size_t> sentCells;
+    std::vector<std::size_t> receivedCells;
+    // the positions in sentCells of each local cell sent
+    std::unordered_multimap<std::size_t, std::size_t> sentIndices;
+  };
+
+  std::shared_ptr<IDomainCommunicator> communicator;
+  int domainColumns = 0;
+  int domainRows = 0;
+
+  long rebalancePeriod = 0;
+  double rebalanceThreshold = 1.1;
+  long stepsSinceRebalance = 0;
+  long rebalanceCount = 0;
+  // the time spent running the agents and reacting since the last check
+  mk::StepTimings::Duration busyTime{0};
+
+  std::map<std::string, std::shared_ptr<mk::IProbe>> probes;
+  std::mutex probesMutex;
+
+  std::atomic<bool> abortionRequested;
+  std::shared_ptr<model::DistributedLogoSimulationModel> currentModel;
+  mk::SimulationTimeStamp currentTime;
+
+  std::optional<tools::DomainDecomposition> decomposition;
+  tools::DomainDecomposition::Box domain{0, 0, 0, 0};
+  tools::DomainDecomposition::Box localGrid{0, 0, 0, 0};
+  std::vector<Peer> peers;
+  // the local cells of the halo
+  std::vector<std::size_t> haloCells;
+
+  std::map<mk::LevelIdentifier, std::shared_ptr<mk::levels::ILevel>> levels;
+  std::shared_ptr<mk::levels::ILevel> level;
+  std::shared_ptr<model::environment::LogoEnvPLS> localEnvironment;
+  std::shared_ptr<mk::environment::IEnvironment4Engine> environment;
+  // the pheromones in the order of their identifiers, as exchanged
+  std::vector<model::environment::Pheromone> pheromones;
+  std::shared_ptr<mk::dynamicstate::IPublicDynamicStateMap> dynamicStates;
+
+  std::vector<HostedTurtle> hosted;
+  std::set<std::shared_ptr<mk::agents::IAgent4Engine>> agents;
+
+  // Arena used by influences::makeInfluence while the agents decide
+  std::shared_ptr<mk::influences::InfluenceArena> influenceArena;
+
+  std::shared_ptr<mk::IStepTimingListener> stepTimingListener;
+  std::shared_ptr<mk::engine::StepBarrier> stepBarrier;
+
+  // Reused across the exchanges
+  std::vector<std::vector<std::uint8_t>> incoming;
+
+  void initializeSimulation(
+      std::shared_ptr<model::DistributedLogoSimulationModel> simulationModel);
+  void buildPeers();
+  /** Creates the agent of a turtle of the local grid and hosts them. */
+  std::shared_ptr<mk::agents::IAgent4Engine>
+  host(const mk::AgentCategory &category,
+       std::shared_ptr<model::environment::TurtlePLSInLogo> turtle);
+  void runSimulationLoop(const mk::SimulationTimeStamp &finalTime);
+  void step(const mk::SimulationTimeStamp &timeLowerBound,
+            const mk::SimulationTimeStamp &timeUpperBound,
+            mk::StepTimings *timings);
+  /** Fills the halo with the patches and turtles of the neighbours. */
+  void exchangeHalo();
+  /**
+   * Copies the emissions of pheromones in the borders of the domain to the
+   * halos of the neighbours, so that they diffuse them as this rank does.
+   */
+  void mirrorEmissions(
+      const mk::SimulationTimeStamp &timeLowerBound,
+      const mk::SimulationTimeStamp &timeUpperBound,
+      std::set<std::shared_ptr<mk::influences::IInfluence>> &regularInfluences);
+  /** Removes the ghost turtles of the halo. */
+  void clearHalo();
+  /** Sends the turtles of the halo to the ranks owning their patches. */
+  void migrateTurtles();
+  /**
+   * Writes a turtle leaving for another rank, with its agent, at the patch
+   * (gx, gy) of the grid.
+   */
+  void writeMigrant(mk::checkpoint::CheckpointWriter &message,
+                    const HostedTurtle &turtle, int gx, int gy) const;
+  /** Hosts a turtle written by writeMigrant(). */
+  void hostMigrant(mk::checkpoint::CheckpointReader &reader);
+  /** Checks the loads of the ranks once in a period, and rebalances. */
+  void rebalanceIfNeeded();
+  /** Hands the patches over to the domains of another decomposition. */
+  void repartition(const tools::DomainDecomposition &balanced);
+  void exchange(const std::vector<mk::checkpoint::CheckpointWriter> &messages);
+  void exchange(const std::vector<int> &ranks,
+                const std::vector<mk::checkpoint::CheckpointWriter> &messages);
+  bool isInDomain(int localX, int localY) const {
+    return domain.contains(localGrid.x + localX, localGrid.y + localY);
+  }
+  void notifyProbesOfPreparation();
+  void notifyProbesOfStart(const mk::SimulationTimeStamp &initialTime);
+  void notifyProbesOfEnd(const mk::SimulationTimeStamp &finalTime);
+  void notifyProbesOfUpdate(const mk::SimulationTimeStamp &time);
+};
+
+} // namespace engine
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_DISTRIBUTEDLOGOSIMULATIONENGINE_H
@@ -0,0 +1,84 @@
+#ifndef SIMILAR2LOGO_DISTRIBUTEDREDUCTIONPROBE_H
+#define SIMILAR2LOGO_DISTRIBUTEDREDUCTIONPROBE_H
+
+#include "DistributedLogoSimulationEngine.h"
+#include "IDomainCommunicator.h"
+#include <IProbe.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace engine {
+
+/**
+ * A probe measuring each domain of a distributed simulation, then reducing
+ * the measures across the ranks, for instance to count the turtles of the
+ * whole grid.
+ *
+ * Every rank adds its own instance of the probe, with the same identifier:
+ * the reduction is a collective call of the ranks observing together.
+ */
+class DistributedReductionProbe : public mk::IProbe {
+public:
+  /** Fills the measures of the domain of a rank. */
+  using Measure = std::function<void(const DistributedLogoSimulationEngine &,
+                                     std::vector<double> &)>;
+  /** Reports the measures reduced across the ranks. */
+  using Report = std::function<void(const mk::SimulationTimeStamp &,
+                                    const std::vector<double> &)>;
+
+  /**
+   * @param valueCount The number of measures, the same on every rank.
+   * @param reportingRank The rank reporting the measures, or -1 for all the
+   * ranks.
+   */
+  DistributedReductionProbe(std::size_t valueCount,
+                            IDomainCommunicator::Reduction reduction,
+                            Measure measure, Report report,
+                            int reportingRank = 0);
+
+  void observeAtInitialTimes(
+      const mk::SimulationTimeStamp &initialTimestamp,
+      const mk::ISimulationEngine &simulationEngine) override;
+  void observeAtPartialConsistentTime(
+      const mk::SimulationTimeStamp &timestamp,
+      const mk::ISimulationEngine &simulationEngine) override;
+  void
+  observeAtFinalTime(const mk::SimulationTimeStamp &finalTimestamp,
+                     const mk::ISimulationEngine &simulationEngine) override;
+
+  std::shared_ptr<mk::IProbe> clone() const override {
+    return std::make_shared<DistributedReductionProbe>(*this);
+  }
+
+private:
+  std::size_t valueCount;
+  IDomainCommunicator::Reduction reduction;
+  Measure measure;
+  Report report;
+  int reportingRank;
+  std::vector<double> values;
+
+  /**
+   * @throws std::invalid_argument If the engine is not a
+   * DistributedLogoSimulationEngine.
+   */
+  void observe(const mk::SimulationTimeStamp &timestamp,
+               const mk::ISimulationEngine &simulationEngine);
+};
+
+} // namespace engine
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_DISTRIBUTEDREDUCTIONPROBE_H
@@ -0,0 +1,71 @@
+#ifndef SIMILAR2LOGO_IDOMAINCOMMUNICATOR_H
+#define SIMILAR2LOGO_IDOMAINCOMMUNICATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace engine {
+
+/**
+ * The communications between the ranks of a distributed simulation, each
+ * rank simulating one domain of the grid (see
+ * DistributedLogoSimulationEngine).
+ *
+ * The operations are collective: every rank calls them in the same order,
+ * and a call returns once the ranks it involves have made it.
+ */
+class IDomainCommunicator {
+public:
+  /** The reductions of allReduce(). */
+  enum class Reduction { SUM, MIN, MAX };
+
+  virtual ~IDomainCommunicator() = default;
+
+  /** Gets the rank of this process or thread, in [0, getSize()). */
+  virtual int getRank() const = 0;
+
+  /** Gets the number of ranks. */
+  virtual int getSize() const = 0;
+
+  /**
+   * Sends one message to each peer and receives one from each. The peers
+   * of two ranks must be symmetric: a rank lists a peer if and only if the
+   * peer lists it.
+   * @param peers The ranks to exchange with, without duplicates.
+   * @param outgoing The message sent to each peer, in the order of peers.
+   * @param incoming Resized to the number of peers and filled with the
+   * message received from each, in the order of peers.
+   */
+  virtual void
+  exchange(const std::vector<int> &peers,
+           const std::vector<std::span<const std::uint8_t>> &outgoing,
+           std::vector<std::vector<std::uint8_t>> &incoming) = 0;
+
+  /**
+   * Reduces values across all the ranks, each rank getting the result. The
+   * ranks pass as many values; the reduction of each value combines the
+   * ranks in the same order whatever the rank, so that the sums are the
+   * same everywhere.
+   * @param values The values of this rank, replaced by the results.
+   */
+  virtual void allReduce(double *values, std::size_t count,
+                         Reduction reduction) = 0;
+};
+
+} // namespace engine
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_IDOMAINCOMMUNICATOR_H
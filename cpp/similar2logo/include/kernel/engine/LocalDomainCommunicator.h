@@ -0,0 +1,80 @@
+#ifndef SIMILAR2LOGO_LOCALDOMAINCOMMUNICATOR_H
+#define SIMILAR2LOGO_LOCALDOMAINCOMMUNICATOR_H
+
+#include "IDomainCommunicator.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace engine {
+
+/**
+ * The ranks of a distributed simulation run by threads of one process, for
+ * instance to test a decomposition without MPI: each thread runs its own
+ * engine, given its own communicator of the group.
+ */
+class LocalDomainCommunicator : public IDomainCommunicator {
+public:
+  /**
+   * Creates the communicators of a group of ranks, the one of rank r at
+   * index r.
+   * @throws std::invalid_argument If the size is not positive.
+   */
+  static std::vector<std::shared_ptr<LocalDomainCommunicator>>
+  createGroup(int size);
+
+  int getRank() const override { return rank; }
+  int getSize() const override;
+
+  void exchange(const std::vector<int> &peers,
+                const std::vector<std::span<const std::uint8_t>> &outgoing,
+                std::vector<std::vector<std::uint8_t>> &incoming) override;
+
+  void allReduce(double *values, std::size_t count,
+                 Reduction reduction) override;
+
+private:
+  /** The state shared by the ranks of a group. */
+  struct Group {
+    int size;
+    std::mutex mutex;
+    std::condition_variable released;
+    int waiting = 0;
+    unsigned long generation = 0;
+    // mailboxes[from * size + to]
+    std::vector<std::vector<std::uint8_t>> mailboxes;
+    // the values passed to allReduce by each rank
+    std::vector<std::vector<double>> contributions;
+
+    explicit Group(int size)
+        : size(size),
+          mailboxes(static_cast<std::size_t>(size) * size),
+          contributions(static_cast<std::size_t>(size)) {}
+
+    /** Waits until all the ranks of the group reach the barrier. */
+    void await();
+  };
+
+  std::shared_ptr<Group> group;
+  int rank;
+
+  LocalDomainCommunicator(std::shared_ptr<Group> group, int rank)
+      : group(std::move(group)), rank(rank) {}
+};
+
+} // namespace engine
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_LOCALDOMAINCOMMUNICATOR_H
@@ -0,0 +1,57 @@
+#ifndef SIMILAR2LOGO_MPIDOMAINCOMMUNICATOR_H
+#define SIMILAR2LOGO_MPIDOMAINCOMMUNICATOR_H
+
+// Built with the SIMILAR2LOGO_MPI option of CMake only
+#ifdef SIMILAR2LOGO_MPI
+
+#include "IDomainCommunicator.h"
+#include <mpi.h>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace engine {
+
+/**
+ * The ranks of a distributed simulation run by the processes of an MPI
+ * communicator. MPI is initialized and finalized by the program, around the
+ * lifetime of the communicators.
+ */
+class MpiDomainCommunicator : public IDomainCommunicator {
+public:
+  explicit MpiDomainCommunicator(MPI_Comm communicator = MPI_COMM_WORLD);
+
+  int getRank() const override { return rank; }
+  int getSize() const override { return size; }
+
+  /**
+   * Exchanges the sizes of the messages, then the messages, with
+   * non-blocking point-to-point calls.
+   */
+  void exchange(const std::vector<int> &peers,
+                const std::vector<std::span<const std::uint8_t>> &outgoing,
+                std::vector<std::vector<std::uint8_t>> &incoming) override;
+
+  void allReduce(double *values, std::size_t count,
+                 Reduction reduction) override;
+
+private:
+  MPI_Comm communicator;
+  int rank;
+  int size;
+};
+
+} // namespace engine
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_MPI
+
+#endif // SIMILAR2LOGO_MPIDOMAINCOMMUNICATOR_H
@@ -1,12 +1,31 @@
 #pragma once
+#include "../../../../microkernel/include/SimulationTimeStamp.h"
+#include "../../../../microkernel/include/engine/WorkStealingThreadPool.h"
 #include "kernel/model/environment/Mark.h"
+#include "kernel/model/environment/MarkStore.h"
 #include "kernel/model/environment/Pheromone.h"
 #include "kernel/model/environment/TurtlePLSInLogo.h"
+#include "kernel/model/environment/TurtleStore.h"
+#include "kernel/tools/AlignedAllocator.h"
+#include "kernel/tools/CrowdField.h"
+#include "kernel/tools/FieldDiffusion.h"
+#include "kernel/tools/MathUtil.h"
+#include "kernel/tools/MoveResolution.h"
+#include "kernel/tools/PheromonePyramid.h"
 #include "kernel/tools/Point2D.h"
+#include "kernel/tools/Topology.h"
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 namespace fr::univ_artois::lgi2a::similar::similar2logo::kernel::model::
@@ -22,47 +41,594 @@ public:
   Environment(int width, int height, bool toroidal = false);
 
   // pheromone handling ---------------------------------------------------
-  model::environment::Pheromone &add_pheromone(const ::std::string &identifier,
-                                               double diffusion_coef = 0.0,
-                                               double evaporation_coef = 0.0,
-                                               double default_value = 0.0,
-                                               double min_value = 0.0);
+  /**
+   * The dense index of a pheromone of the environment, so that the sensing
+   * and the emission of a pheromone skip the hashing of its identifier.
+   */
+  struct PheromoneHandle {
+    ::std::uint32_t index;
+
+    bool operator==(const PheromoneHandle &other) const = default;
+  };
+
+  /**
+   * Adds a pheromone, or resets it if its identifier is already known.
+   * @return The handle of the pheromone, valid as long as the environment.
+   */
+  PheromoneHandle add_pheromone(const ::std::string &identifier,
+                                double diffusion_coef = 0.0,
+                                double evaporation_coef = 0.0,
+                                double default_value = 0.0,
+                                double min_value = 0.0);
+
+  /** Gets the handle of a pheromone, if it was added. */
+  ::std::optional<PheromoneHandle>
+  find_pheromone(const ::std::string &identifier) const;
+
+  const model::environment::Pheromone &
+  get_pheromone(PheromoneHandle pheromone) const {
+    return m_pheromones[pheromone.index];
+  }
+
+  void set_pheromone(double x, double y, PheromoneHandle pheromone,
+                     double value);
+  double get_pheromone_value(double x, double y,
+                             PheromoneHandle pheromone) const;
+
+  /**
+   * Gets the values of a pheromone grid, row by row: the value of the cell
+   * (x, y) is at y * width() + x. diffuse_and_evaporate() exchanges the
+   * buffer with another one, so a pointer into it is only valid until the
+   * next step.
+   */
+  const tools::TiledField::Values &
+  get_pheromone_values(PheromoneHandle pheromone) const {
+    return m_pheromone_grids[pheromone.index].values;
+  }
+
+  /**
+   * Gets a pheromone grid with the flags of its tiles, valid as long as the
+   * environment.
+   */
+  const tools::TiledField &
+  get_pheromone_field(PheromoneHandle pheromone) const {
+    return m_pheromone_grids[pheromone.index];
+  }
+
+  /**
+   * Sets every cell of a pheromone grid, as set_pheromone() does, from
+   * width() * height() values laid out as in get_pheromone_values(). The
+   * bands of tile rows are copied in parallel (see RowBands).
+   */
+  void set_pheromone_values(PheromoneHandle pheromone, const double *values);
+
+  /** The handle naming no pheromone. */
+  static constexpr PheromoneHandle NO_PHEROMONE{~::std::uint32_t(0)};
+
+  /** An amount of pheromone emitted on the cell nearest to (x, y). */
+  struct PheromoneDeposit {
+    PheromoneHandle pheromone;
+    double x;
+    double y;
+    double value;
+  };
+
+  /**
+   * Adds deposits to the pheromone grids, with the result of as many
+   * set_pheromone() of the current value plus the deposit, in order. The
+   * cells are located in parallel, then the bands of tile rows apply their
+   * deposits in parallel (see RowBands), each in the order of the deposits,
+   * so that the sums do not depend on the threads. The deposits naming no
+   * pheromone of the environment are ignored.
+   */
+  void emit_pheromones(const ::std::vector<PheromoneDeposit> &deposits);
+
+  // the same, finding the pheromone by its identifier; the unknown
+  // pheromones are ignored
   void set_pheromone(double x, double y, const ::std::string &identifier,
                      double value);
   double get_pheromone_value(double x, double y,
                              const ::std::string &identifier) const;
 
+  // pheromone sensing --------------------------------------------------
+  /**
+   * Gets the value of a pheromone at (x, y), interpolated bilinearly
+   * between the 4 cells around it, a cell holding the value of its centre
+   * (see get_pheromone_value()). Across the borders, the cells are wrapped
+   * on toroidal grids and clamped otherwise.
+   */
+  double sample_pheromone(double x, double y, PheromoneHandle pheromone) const;
+
+  /**
+   * Samples a pheromone, as sample_pheromone() does, at distance from point
+   * in each direction heading + angles[k], into readings[k]. The headings
+   * are those of advance_turtles(): a turtle of heading h moves along
+   * (cos h, sin h).
+   */
+  void sample_gradient(const ::fr::univ_artois::lgi2a::similar::similar2logo::
+                           kernel::tools::Point2D &point,
+                       double heading, const double *angles,
+                       ::std::size_t count, double distance,
+                       PheromoneHandle pheromone, double *readings) const;
+
+  /** The readings of a pheromone on the left, ahead and on the right. */
+  struct GradientSample {
+    double left;
+    double ahead;
+    double right;
+  };
+
+  /**
+   * Samples a pheromone at distance from point in the directions
+   * heading + angle (left), heading and heading - angle (right).
+   */
+  GradientSample
+  sample_gradient(const ::fr::univ_artois::lgi2a::similar::similar2logo::
+                      kernel::tools::Point2D &point,
+                  double heading, double angle, double distance,
+                  PheromoneHandle pheromone) const;
+
+  /**
+   * Samples a pheromone around every turtle, as sample_gradient() does, in
+   * parallel on the pool lent by the engine. The directions are rotated
+   * from the headings of the turtle store, whose sines and cosines go
+   * through FastMath::sinCos().
+   * @return The samples, element i being those of get_turtles()[i].
+   */
+  ::std::vector<GradientSample>
+  sample_gradient_all(double angle, double distance,
+                      PheromoneHandle pheromone) const;
+
+  /**
+   * Diffuses every pheromone to the 8 neighbours of its cells, then
+   * evaporates it. A cell with a positive value gives diffusion_coef * value
+   * * dt, shared equally between its neighbours in the grid.
+   *
+   * Only the tiles of a grid holding non-zero values, and their neighbours,
+   * are updated: a tile is retired once its values evaporated below the
+   * minimum value of the pheromone, so that the cost of a step follows the
+   * area of the trails rather than the area of the grid. When the grids are
+   * mapped from files (see tools::GridMemory::setBackingDirectory), the
+   * tile rows where the turtles stand are then prefetched.
+   *
+   * The explicit step is only stable while diffusion_coef * dt <= 4/3: with
+   * the SPECTRAL scheme (see set_diffusion_scheme()), a toroidal grid is
+   * updated exactly in Fourier space instead, for any dt.
+   */
   void diffuse_and_evaporate(double dt);
 
+  /**
+   * Sets the integration of the diffusion by diffuse_and_evaporate() (see
+   * tools::FieldDiffusion::Scheme). With the SPECTRAL scheme, a step of
+   * n * dt gives the grids of n steps of dt, so that the pheromones can be
+   * advanced several steps at once, e.g. while the turtles are sparse; the
+   * grids which do not wrap keep the explicit step.
+   */
+  void set_diffusion_scheme(tools::FieldDiffusion::Scheme scheme) {
+    m_diffusion.setScheme(scheme);
+  }
+
+  tools::FieldDiffusion::Scheme diffusion_scheme() const {
+    return m_diffusion.getScheme();
+  }
+
+  /**
+   * Maintains the pyramid of a pheromone grid (see tools::PheromonePyramid),
+   * for the queries over large radii: it is recomputed after each
+   * diffuse_and_evaporate() and by update_pheromone_pyramids(), over the
+   * active tiles of the grid.
+   */
+  void enable_pheromone_pyramid(
+      PheromoneHandle pheromone,
+      tools::PheromonePyramid::Reduction reduction =
+          tools::PheromonePyramid::Reduction::MAX);
+
+  /**
+   * Recomputes the pyramids, e.g. after pheromones were set or emitted
+   * since the last step.
+   */
+  void update_pheromone_pyramids();
+
+  /** Gets the pyramid of a pheromone grid, nullptr if it has none. */
+  const tools::PheromonePyramid *
+  get_pheromone_pyramid(PheromoneHandle pheromone) const {
+    const auto &pyramid = m_pheromone_grids[pheromone.index].pyramid;
+    return pyramid ? &*pyramid : nullptr;
+  }
+
+  /**
+   * Finds the strongest cell of a pheromone within radius of a point, in
+   * the pyramid of its grid: the search descends only into the blocks that
+   * may beat the best cell found so far, instead of scanning the disk.
+   * @throws std::logic_error If the grid has no pyramid.
+   */
+  tools::PheromonePyramid::Peak
+  strongest_pheromone_within(const ::fr::univ_artois::lgi2a::similar::
+                                 similar2logo::kernel::tools::Point2D &point,
+                             double radius, PheromoneHandle pheromone) const;
+
+  /** The side, in cells, of the tiles whose activity is tracked. */
+  static constexpr int TILE_SIZE = tools::TiledField::TILE_SIZE;
+
+  /**
+   * Gets the number of tiles of a pheromone grid that may hold non-zero
+   * values, i.e. that the next step updates.
+   */
+  ::std::size_t get_active_tile_count(const ::std::string &identifier) const;
+
   // mark handling ------------------------------------------------------
   void add_mark(int x, int y,
                 ::std::shared_ptr<model::environment::SimpleMark> mark);
   void remove_mark(int x, int y,
                    ::std::shared_ptr<model::environment::SimpleMark> mark);
+  /**
+   * Adds marks to the patches of their location, as add_mark() does, the
+   * bands of tile columns of the grid inserting their marks in parallel
+   * (see MarkStore::addAll()).
+   */
+  void add_marks(
+      const ::std::vector<::std::shared_ptr<model::environment::SimpleMark>>
+          &marks);
+  /**
+   * Removes marks from the patches of their location, as remove_mark()
+   * does, in parallel as add_marks() does.
+   */
+  void remove_marks(
+      const ::std::vector<::std::shared_ptr<model::environment::SimpleMark>>
+          &marks);
 
-  const ::std::vector<::std::vector<::std::unordered_set<
-      ::std::shared_ptr<model::environment::SimpleMark>>>> &
-  get_marks() const {
-    return m_marks;
-  }
+  /** Gets the marks of the patches. */
+  const model::environment::MarkStore &get_marks() const { return m_marks; }
 
   // turtle access ------------------------------------------------------
   const ::std::vector<::std::shared_ptr<model::environment::TurtlePLSInLogo>> &
   get_turtles() const;
+  /**
+   * Adds a turtle, which becomes a handle onto a slot of get_turtle_store().
+   * Adding a turtle twice has no effect.
+   * @throws std::invalid_argument If the turtle belongs to another
+   * environment.
+   */
   void
   add_turtle(::std::shared_ptr<model::environment::TurtlePLSInLogo> turtle);
   void
   remove_turtle(::std::shared_ptr<model::environment::TurtlePLSInLogo> turtle);
 
+  /**
+   * Gets the states of the turtles, the state of get_turtles()[i] being in
+   * slot i.
+   */
+  const model::environment::TurtleStore &get_turtle_store() const {
+    return m_turtle_store;
+  }
+
+  /**
+   * Moves the turtles, the turtle of slot i to (x[i], y[i]), as many
+   * TurtlePLSInLogo::setLocation() and update_turtle_patch() would.
+   */
+  void set_turtle_locations(const double *x, const double *y);
+  /** Sets the headings of the turtles, headings[i] for slot i. */
+  void set_turtle_headings(const double *headings);
+  /** Sets the speeds of the turtles, speeds[i] for slot i. */
+  void set_turtle_speeds(const double *speeds);
+
+  /**
+   * Moves every turtle by its speed, increased by its acceleration, along
+   * its heading during dt. On non-toroidal grids the turtles leaving the
+   * grid are removed, with their location unchanged.
+   *
+   * The turtles are moved by vectorized loops over the columns of the
+   * turtle store, the headings going through FastMath::sinCos(). The crowds
+   * are then advected (see enable_crowds()).
+   */
+  void advance_turtles(double dt);
+
+  /**
+   * Sorts the turtles along a Hilbert curve over the patches (see
+   * tools::SpaceFillingCurve), so that the turtles of neighbouring patches
+   * are in neighbouring slots of the store and of get_turtles(), and the
+   * queries over a neighbourhood read contiguous memory. The turtles
+   * outside the grid come last; all keep their identifiers.
+   */
+  void reorder_turtles();
+  /**
+   * Sorts the turtles with reorder_turtles() at the end of every period
+   * calls of advance_turtles(); 0, the default, never.
+   */
+  void set_turtle_reorder_period(::std::size_t period) {
+    m_turtle_reorder_period = period;
+    m_turtle_advances = 0;
+  }
+
   // Spatial indexing for efficient turtle queries
-  const ::std::unordered_set<
-      ::std::shared_ptr<model::environment::TurtlePLSInLogo>> &
+  /**
+   * Gets the turtles standing on a patch. The turtles are copied: the loops
+   * over a neighbourhood rather use for_each_turtle_at() or
+   * for_each_turtle_in_radius().
+   */
+  ::std::vector<::std::shared_ptr<model::environment::TurtlePLSInLogo>>
   get_turtles_at(int x, int y) const;
 
+  /**
+   * Calls visitor(turtle) for each turtle standing on the patch (x, y). The
+   * turtles must not be added, removed or moved meanwhile.
+   */
+  template <typename Visitor>
+  void for_each_turtle_at(int x, int y, Visitor &&visitor) const {
+    if (x < 0 || x >= m_width || y < 0 || y >= m_height)
+      return;
+    const TurtleIndex &index = turtle_index();
+    const ::std::size_t cell = static_cast<::std::size_t>(y) * m_width + x;
+    for (auto i = index.start[cell]; i < index.start[cell + 1]; ++i) {
+      visitor(m_turtles[index.turtles[i]]);
+    }
+  }
+
+  /**
+   * Calls visitor(turtle) for each turtle at most radius away from center,
+   * across the borders of a toroidal grid, by scanning the patches of the
+   * square around the circle. The turtles must not be added, removed or
+   * moved meanwhile.
+   */
+  template <typename Visitor>
+  void query_radius(const ::fr::univ_artois::lgi2a::similar::similar2logo::
+                        kernel::tools::Point2D &center,
+                    double radius, Visitor &&visitor) const {
+    const TurtleIndex &index = turtle_index();
+    if (m_neighbourhood_cache_enabled) {
+      if (const auto *candidates = neighbourhood(index, center, radius)) {
+        tools::withTopology(m_toroidal, m_toroidal, [&](auto topology) {
+          using T = decltype(topology);
+          for (const ::std::uint32_t turtle : *candidates) {
+            if (T::distance(tools::Point2D(m_turtle_store.x[turtle],
+                                           m_turtle_store.y[turtle]),
+                            center, m_width, m_height) <= radius) {
+              visitor(m_turtles[turtle]);
+            }
+          }
+        });
+        return;
+      }
+    }
+    query_radius(index, center, radius, visitor);
+  }
+
+  /**
+   * Enables the cache of the neighbourhoods of the patches, disabled by
+   * default. The first query_radius() of a radius from a point of a patch
+   * collects the turtles of the patches that such a query may reach from
+   * anywhere in the patch; the next ones from the patch only filter them by
+   * distance. The cache is emptied as soon as the turtles move, add or leave,
+   * that is at the next consistent state. It pays off for dense crowds,
+   * where many turtles perceive from the same patch; the turtles are then
+   * visited in the order of the patches of the wider neighbourhood.
+   */
+  void set_neighbourhood_cache(bool enabled);
+  bool neighbourhood_cache() const { return m_neighbourhood_cache_enabled; }
+
+  /**
+   * Calls visitor(turtle) for each turtle at most radius away from center
+   * whose direction from center, as computed by get_direction(), is at most
+   * angle / 2 away from heading. The turtles standing on center are in the
+   * cone whatever its heading.
+   */
+  template <typename Visitor>
+  void query_cone(const ::fr::univ_artois::lgi2a::similar::similar2logo::
+                      kernel::tools::Point2D &center,
+                  double heading, double angle, double radius,
+                  Visitor &&visitor) const {
+    query_radius(center, radius, [&](const auto &turtle) {
+      const auto location = turtle->getLocation();
+      if ((location.x == center.x && location.y == center.y) ||
+          std::abs(tools::MathUtil::angleDifference(
+              heading, get_direction(center, location))) <= angle / 2) {
+        visitor(turtle);
+      }
+    });
+  }
+
+  /**
+   * Answers query_radius() around every turtle, the turtle itself excluded,
+   * in parallel on the pool lent by the engine (see
+   * WorkStealingThreadPool::parallelForOnCurrent). The turtles are taken
+   * patch by patch, so that neighbouring queries read the same patches.
+   * @param visitor Called with the index of a turtle in get_turtles() and
+   * each of its neighbours; the calls for distinct turtles may run
+   * concurrently.
+   */
+  template <typename Visitor>
+  void query_radius_all(double radius, Visitor &&visitor) const {
+    const TurtleIndex &index = turtle_index();
+    microkernel::engine::WorkStealingThreadPool::parallelForOnCurrent(
+        index.turtles.size(), 0,
+        [&](::std::size_t begin, ::std::size_t end, ::std::size_t) {
+          for (::std::size_t k = begin; k < end; ++k) {
+            const ::std::uint32_t i = index.turtles[k];
+            const auto &turtle = m_turtles[i];
+            query_radius(index, turtle->getLocation(), radius,
+                         [&](const auto &neighbour) {
+                           if (neighbour != turtle) {
+                             visitor(static_cast<::std::size_t>(i),
+                                     neighbour);
+                           }
+                         });
+          }
+        });
+  }
+
+  /** Gets the turtles found by query_radius(). */
+  ::std::vector<::std::shared_ptr<model::environment::TurtlePLSInLogo>>
+  get_turtles_in_radius(const ::fr::univ_artois::lgi2a::similar::
+                            similar2logo::kernel::tools::Point2D &center,
+                        double radius) const;
+
+  /** Gets the turtles found by query_cone(). */
+  ::std::vector<::std::shared_ptr<model::environment::TurtlePLSInLogo>>
+  get_turtles_in_cone(const ::fr::univ_artois::lgi2a::similar::similar2logo::
+                          kernel::tools::Point2D &center,
+                      double heading, double angle, double radius) const;
+
+  /**
+   * Gets the neighbours found by query_radius_all(): element i holds the
+   * neighbours of get_turtles()[i].
+   */
+  ::std::vector<
+      ::std::vector<::std::shared_ptr<model::environment::TurtlePLSInLogo>>>
+  get_turtles_in_radius_all(double radius) const;
+
+  /**
+   * Records that a turtle moved to another patch. The index of the turtles
+   * is sorted again by the next query.
+   */
   void update_turtle_patch(
       ::std::shared_ptr<model::environment::TurtlePLSInLogo> turtle, int old_x,
       int old_y, int new_x, int new_y);
 
+  /**
+   * Moves turtles to the centers of random empty patches, those without any
+   * turtle, resolving the turtles competing for a patch in parallel (see
+   * tools::MoveResolver::relocate()). A turtle alone on its patch frees it
+   * for the others; a patch shared with other turtles stays occupied until
+   * the next call.
+   * @param turtles The turtles to move, each at most once.
+   * @param seed The seed of the draws: the moves only depend on it and on
+   * the turtles of the environment.
+   * @return The number of turtles moved; the others, left without a patch,
+   * stay where they are.
+   */
+  ::std::size_t relocate_turtles(
+      const ::std::vector<
+          ::std::shared_ptr<model::environment::TurtlePLSInLogo>> &turtles,
+      ::std::uint64_t seed);
+
+  // crowd aggregation --------------------------------------------------
+  /** The settings of the aggregation of the dense crowds. */
+  struct CrowdSettings {
+    /** The side of the regions, in patches */
+    int region_size = 8;
+    /** The turtles of a color per patch from which a region aggregates them */
+    double aggregate_density = 4.0;
+    /** The turtles per patch of a crowd below which its region releases it */
+    double release_density = 2.0;
+  };
+
+  /**
+   * Enables the aggregation of the dense crowds by update_crowds(), as the
+   * AdaptiveSimulator of JamFree switches its dense lanes to a flow model.
+   * The grid is cut into square regions; the turtles of a color standing in
+   * a region at aggregate_density or more are removed from the environment
+   * into the crowd of their color, a tools::CrowdField that
+   * advance_turtles() advects at their mean velocity. A region whose crowd
+   * thins below release_density, or that the focus covers, releases it as
+   * turtles again: those that were aggregated first, reused with a new
+   * state, then new ones of the color of the crowd. The turtles of a crowd
+   * neither perceive, nor decide, nor accelerate; they only flow.
+   * @throws std::invalid_argument If the region size is not positive, or if
+   * release_density is not below aggregate_density.
+   */
+  void enable_crowds(const CrowdSettings &settings);
+  void enable_crowds() { enable_crowds(CrowdSettings()); }
+
+  /** Releases the crowds as turtles, and stops aggregating them. */
+  void disable_crowds(::std::uint64_t seed);
+
+  bool crowds_enabled() const { return m_crowd_settings.has_value(); }
+
+  /**
+   * Releases the crowds of the regions below the release density or in the
+   * focus, then aggregates the turtles of the regions at the aggregate
+   * density outside the focus.
+   * @param seed The seed of the locations of the released turtles.
+   */
+  void update_crowds(::std::uint64_t seed);
+
+  /**
+   * Keeps the turtles of the regions meeting a rectangle of the grid
+   * individual, e.g. the view of a probe zooming in; the crowds there are
+   * released by the next update_crowds().
+   */
+  void set_crowd_focus(double x, double y, double width, double height);
+  void clear_crowd_focus() { m_crowd_focus.reset(); }
+
+  /** Gets the crowd of a color, nullptr if none was aggregated. */
+  const tools::CrowdField *get_crowd(const ::std::string &color) const;
+
+  /** Gets the turtles of all the crowds. */
+  double get_crowd_turtle_count() const;
+
+  // change tracking ----------------------------------------------------
+  /**
+   * Keeps the changes of the last commits of commit_changes(), for the
+   * observers sending the state of the environment frame by frame; 0, the
+   * default, stops the tracking. The first commit following a call starts the
+   * tracking: the changes made before it are not recorded.
+   */
+  void set_change_history(::std::size_t commits);
+
+  /**
+   * Closes the changes made since the previous commit as those of time.
+   * The turtles are compared with their state at the previous commit, in
+   * one pass over the turtle store; the pheromones and the marks record
+   * their changes as they are made.
+   */
+  void commit_changes(
+      const ::fr::univ_artois::lgi2a::similar::microkernel::SimulationTimeStamp
+          &time);
+
+  /** A mark added to or removed from the patch (x, y). */
+  struct MarkChange {
+    int x;
+    int y;
+    ::std::shared_ptr<model::environment::SimpleMark> mark;
+    bool added;
+  };
+
+  /**
+   * The tiles of a pheromone grid whose cells changed, with their current
+   * values: TILE_SIZE * TILE_SIZE values per tile, row by row, the cells
+   * beyond the grid being 0.
+   */
+  struct PheromoneTiles {
+    PheromoneHandle pheromone;
+    /** The indices of the tiles, row-major in the grid of tiles */
+    ::std::vector<::std::uint32_t> tiles;
+    ::std::vector<double> values;
+  };
+
+  /** A turtle added or changed, named by its TurtleStore identifier. */
+  struct TurtleChange {
+    ::std::uint64_t id;
+    ::std::shared_ptr<model::environment::TurtlePLSInLogo> turtle;
+  };
+
+  /** The changes committed after a time, see get_changes_since(). */
+  struct Changes {
+    /**
+     * False when the kept history does not reach the time: the lists are
+     * then empty and the observer reads the whole state again.
+     */
+    bool complete;
+    /** The time of the last commit */
+    long until;
+    ::std::vector<PheromoneTiles> pheromones;
+    /** The changes of the marks, in the order they were made */
+    ::std::vector<MarkChange> marks;
+    /** The turtles added or changed, in the order of get_turtles() */
+    ::std::vector<TurtleChange> turtles;
+    /** The identifiers of the turtles removed */
+    ::std::vector<::std::uint64_t> removed_turtles;
+  };
+
+  /**
+   * Gets the changes committed after time, merged: a tile or a turtle
+   * appears once, with its current state. The cost follows the number of
+   * changes, plus a pass over the flags of the tiles, rather than the size
+   * of the world.
+   */
+  Changes get_changes_since(
+      const ::fr::univ_artois::lgi2a::similar::microkernel::SimulationTimeStamp
+          &time) const;
+
   // random helpers ------------------------------------------------------
   ::fr::univ_artois::lgi2a::similar::similar2logo::kernel::tools::Point2D
   random_position() const;
@@ -83,32 +649,224 @@ public:
   int height() const { return m_height; }
   bool toroidal() const { return m_toroidal; }
 
+  /**
+   * Gets the lock of the Python bindings, whose calls the free-threaded
+   * build runs in parallel: the queries share it and the updates hold it
+   * alone. The steps, reaction::Reaction::apply() and
+   * SharedDecisionBuffer::apply(), hold it alone themselves, so that a query
+   * never sees a step half done; the methods of the environment do not take
+   * it.
+   */
+  ::std::shared_mutex &access_mutex() const { return m_access_mutex; }
+
 private:
   int m_width, m_height;
   bool m_toroidal;
-  ::std::unordered_map<::std::string, ::std::vector<::std::vector<double>>>
-      m_pheromone_grids;
-  ::std::unordered_map<::std::string, model::environment::Pheromone>
-      m_pheromones;
+  mutable ::std::shared_mutex m_access_mutex;
+  // a pheromone grid, row-major: values[y * width + x], and the flags of
+  // its tiles, row-major too, set when a tile may hold non-zero values; the
+  // cells of the other tiles are 0
+  struct PheromoneGrid : tools::TiledField {
+    // the tiles written since the last commit_changes()
+    ::std::vector<unsigned char> changed;
+    ::std::optional<tools::PheromonePyramid> pyramid;
+  };
+  // the pheromones and their grids, indexed by handle
+  ::std::vector<model::environment::Pheromone> m_pheromones;
+  ::std::vector<PheromoneGrid> m_pheromone_grids;
+  ::std::unordered_map<::std::string, ::std::uint32_t> m_pheromone_handles;
+  int m_tile_columns, m_tile_rows;
+  // the diffusion and evaporation of the grids, shared with LogoEnvPLS
+  tools::FieldDiffusion m_diffusion;
 
-  // marks grid: marks[x][y] = set of marks at that location
-  ::std::vector<::std::vector<
-      ::std::unordered_set<::std::shared_ptr<model::environment::SimpleMark>>>>
-      m_marks;
+  model::environment::MarkStore m_marks;
 
   // turtles list
   ::std::vector<::std::shared_ptr<model::environment::TurtlePLSInLogo>>
       m_turtles;
+  // their states; declared after m_turtles so that it detaches the turtles
+  // before they are released
+  model::environment::TurtleStore m_turtle_store;
+  // the sines and cosines of the headings, and the turtles flagged by
+  // advance_turtles()
+  tools::AlignedVector<model::environment::TurtleStore::Real> m_turtle_sines;
+  tools::AlignedVector<model::environment::TurtleStore::Real>
+      m_turtle_cosines;
+  ::std::vector<unsigned char> m_turtle_flags;
+  // the calls of advance_turtles() between two reorder_turtles(), the
+  // calls since the last one, and the keys and order of the last one
+  ::std::size_t m_turtle_reorder_period = 0;
+  ::std::size_t m_turtle_advances = 0;
+  ::std::vector<::std::uint64_t> m_turtle_keys;
+  ::std::vector<::std::size_t> m_turtle_order;
+
+  // the crowds by color, with the turtles they aggregated, to be reused when
+  // they are released
+  struct Crowd {
+    ::std::uint32_t color;
+    tools::CrowdField field;
+    ::std::vector<::std::shared_ptr<model::environment::TurtlePLSInLogo>>
+        stored;
+  };
+  ::std::vector<Crowd> m_crowds;
+  ::std::optional<CrowdSettings> m_crowd_settings;
+  struct CrowdFocus {
+    double x, y, width, height;
+  };
+  ::std::optional<CrowdFocus> m_crowd_focus;
+
+  // whether the focus meets the region of the patches from (x, y) to
+  // (x + side - 1, y + side - 1)
+  bool crowd_focus_meets(int x, int y, int side) const;
+  void release_crowds(bool all, ::std::uint64_t seed);
+  void aggregate_crowds();
+
+  // the changes of a commit: the changed tiles of each pheromone, the mark
+  // changes and the identifiers of the turtles added or changed and removed
+  struct ChangeRecord {
+    long time;
+    ::std::vector<::std::vector<::std::uint32_t>> tiles;
+    ::std::vector<MarkChange> marks;
+    ::std::vector<::std::uint64_t> turtles;
+    ::std::vector<::std::uint64_t> removed_turtles;
+  };
+  ::std::size_t m_change_history = 0;
+  // false until the first commit following set_change_history()
+  bool m_changes_started = false;
+  // the earliest time get_changes_since() answers completely
+  long m_changes_horizon = 0;
+  long m_last_commit = 0;
+  ::std::deque<ChangeRecord> m_change_records;
+  // the mark changes since the last commit
+  ::std::vector<MarkChange> m_mark_changes;
+  // the turtles at the last commit, compared with the store by the next one
+  struct TurtleSnapshot {
+    ::std::vector<::std::uint64_t> id;
+    model::environment::TurtleStore::Column x, y, heading, speed,
+        acceleration;
+    ::std::vector<::std::uint32_t> color;
+  };
+  TurtleSnapshot m_turtle_snapshot;
+
+  // indices in m_turtles of the turtles sorted by patch, row-major: the
+  // turtles of the patch (x, y) are turtles[start[c]] to
+  // turtles[start[c + 1] - 1], where c = y * width + x
+  struct TurtleIndex {
+    ::std::vector<::std::uint32_t> start;
+    ::std::vector<::std::uint32_t> turtles;
+    // patch of each turtle, NO_PATCH outside the grid
+    ::std::vector<::std::uint32_t> patches;
+  };
+  static constexpr ::std::uint32_t NO_PATCH = ~::std::uint32_t(0);
+  // sorted by the first query following a change, possibly from several
+  // perceiving threads at once
+  mutable TurtleIndex m_turtle_index;
+  mutable ::std::atomic<bool> m_turtle_index_stale{true};
+  mutable ::std::mutex m_turtle_index_mutex;
+
+  // the index of the turtles, sorted again by a counting sort if stale
+  const TurtleIndex &turtle_index() const;
+
+  // the empty patches and the claims of relocate_turtles(), kept across the
+  // calls
+  tools::EmptyCellIndex m_empty_patches;
+  tools::MoveResolver m_move_resolver;
+
+  // The turtles near the patches by radius (see set_neighbourhood_cache()),
+  // in shards locked by the perceiving threads. The node-based maps keep
+  // their entries in place as they grow, until the next index is sorted.
+  struct NeighbourhoodKey {
+    ::std::uint32_t patch;
+    double radius;
+    bool operator==(const NeighbourhoodKey &other) const {
+      return patch == other.patch && radius == other.radius;
+    }
+  };
+  struct NeighbourhoodKeyHash {
+    ::std::size_t operator()(const NeighbourhoodKey &key) const {
+      return ::std::hash<double>()(key.radius) * 31 + key.patch;
+    }
+  };
+  struct NeighbourhoodShard {
+    ::std::mutex mutex;
+    ::std::unordered_map<NeighbourhoodKey, ::std::vector<::std::uint32_t>,
+                         NeighbourhoodKeyHash>
+        neighbourhoods;
+  };
+  static constexpr ::std::size_t NEIGHBOURHOOD_SHARDS = 16;
+  bool m_neighbourhood_cache_enabled = false;
+  mutable ::std::array<NeighbourhoodShard, NEIGHBOURHOOD_SHARDS>
+      m_neighbourhoods;
+
+  // the turtles near the patch of center within radius, collected on the
+  // first call since the index was sorted; null for a center outside the
+  // grid
+  const ::std::vector<::std::uint32_t> *
+  neighbourhood(const TurtleIndex &index,
+                const ::fr::univ_artois::lgi2a::similar::similar2logo::kernel::
+                    tools::Point2D &center,
+                double radius) const;
+  void clear_neighbourhoods() const;
+  // Prefetches the tile rows of the pheromone grids where the turtles stand,
+  // when the grids are mapped from files (see tools::GridMemory).
+  void prefetch_turtle_tiles() const;
+
+  template <typename Visitor>
+  void query_radius(const TurtleIndex &index,
+                    const ::fr::univ_artois::lgi2a::similar::similar2logo::
+                        kernel::tools::Point2D &center,
+                    double radius, Visitor &&visitor) const {
+    int first_x, columns, first_y, rows;
+    patch_span(center.x, radius, m_width, first_x, columns);
+    patch_span(center.y, radius, m_height, first_y, rows);
+    // the distance of the turtles, specialized on the topology of the grid
+    tools::withTopology(m_toroidal, m_toroidal, [&](auto topology) {
+      using T = decltype(topology);
+      for (int j = 0, y = first_y; j < rows; ++j) {
+        const ::std::size_t row = static_cast<::std::size_t>(y) * m_width;
+        for (int i = 0, x = first_x; i < columns; ++i) {
+          for (auto t = index.start[row + x]; t < index.start[row + x + 1];
+               ++t) {
+            const ::std::uint32_t turtle = index.turtles[t];
+            if (T::distance(tools::Point2D(m_turtle_store.x[turtle],
+                                           m_turtle_store.y[turtle]),
+                            center, m_width, m_height) <= radius) {
+              visitor(m_turtles[turtle]);
+            }
+          }
+          x = x + 1 == m_width ? 0 : x + 1;
+        }
+        y = y + 1 == m_height ? 0 : y + 1;
+      }
+    });
+  }
+
+  // the index in a pheromone grid of the cell nearest to (x, y)
+  ::std::size_t pheromone_cell(double x, double y) const;
+
+  // the slots of the store by increasing identifier: in order, unless
+  // reorder_turtles() moved the turtles
+  ::std::vector<::std::size_t> slots_by_id() const;
+
+  // compares the turtle store with the snapshot of the last commit, which
+  // it then replaces
+  void diff_turtles(::std::vector<::std::uint64_t> &changed,
+                    ::std::vector<::std::uint64_t> &removed);
+
+  // the patches of the locations of marks, MarkStore::NO_CELL for the
+  // marks outside the grid
+  ::std::vector<::std::uint32_t> mark_cells(
+      const ::std::vector<::std::shared_ptr<model::environment::SimpleMark>>
+          &marks) const;
 
-  // Spatial index: turtles_in_patches[x][y] = set of turtles at that patch
-  ::std::vector<::std::vector<::std::unordered_set<
-      ::std::shared_ptr<model::environment::TurtlePLSInLogo>>>>
-      m_turtles_in_patches;
+  // the bilinear interpolation of a grid of values at (x, y)
+  double interpolate(const tools::TiledField::Values &values, double x,
+                     double y) const;
 
-  // Empty set for out-of-bounds queries
-  static const ::std::unordered_set<
-      ::std::shared_ptr<model::environment::TurtlePLSInLogo>>
-      s_empty_turtle_set;
+  // the first patch and the number of patches within radius of a coordinate
+  // along an axis of the given length
+  void patch_span(double coordinate, double radius, int length, int &first,
+                  int &count) const;
 };
 } // namespace
   // fr::univ_artois::lgi2a::similar::similar2logo::kernel::environment
@@ -0,0 +1,118 @@
+#pragma once
+#include "kernel/environment/Environment.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace fr::univ_artois::lgi2a::similar::similar2logo::kernel::environment {
+
+/**
+ * The perceptions and the decisions of the turtles of a step, in a POSIX
+ * shared memory segment that decision processes map, so that only step
+ * indices cross the process boundaries.
+ *
+ * The segment holds, for up to capacity turtles, the columns x, y, heading
+ * and speed, the values of pheromone_count pheromones at the location of
+ * each turtle (row-major: turtle i, pheromone j at i * pheromone_count + j)
+ * and the decided heading and speed deltas. The process creating the
+ * segment unlinks it when its buffer is destroyed; the processes attaching
+ * it by name only unmap it.
+ *
+ * The buffer holds no lock: the owner publishes the perceptions, then hands
+ * disjoint ranges of turtles to the decision processes, and applies the
+ * decisions once they all answered.
+ */
+class SharedDecisionBuffer {
+public:
+  /**
+   * Creates a segment, replacing any segment of the same name.
+   * @param name The name of the segment, starting with a '/'.
+   * @throws std::system_error If the segment cannot be created.
+   */
+  static SharedDecisionBuffer create(const ::std::string &name,
+                                     ::std::size_t capacity,
+                                     ::std::size_t pheromone_count);
+
+  /**
+   * Maps a segment created by another buffer.
+   * @throws std::system_error If the segment cannot be opened.
+   * @throws std::runtime_error If it is not the segment of a buffer.
+   */
+  static SharedDecisionBuffer attach(const ::std::string &name);
+
+  SharedDecisionBuffer(SharedDecisionBuffer &&other) noexcept;
+  SharedDecisionBuffer &operator=(SharedDecisionBuffer &&other) noexcept;
+  SharedDecisionBuffer(const SharedDecisionBuffer &) = delete;
+  SharedDecisionBuffer &operator=(const SharedDecisionBuffer &) = delete;
+  ~SharedDecisionBuffer();
+
+  const ::std::string &name() const { return m_name; }
+  bool is_owner() const { return m_owner; }
+  ::std::size_t capacity() const { return m_header->capacity; }
+  ::std::size_t pheromone_count() const { return m_header->pheromone_count; }
+
+  /** Gets the number of turtles of the step. */
+  ::std::size_t count() const { return m_header->count; }
+  /** @throws std::length_error If count exceeds the capacity. */
+  void set_count(::std::size_t count);
+
+  /** Gets the step published last, counted by publish(). */
+  ::std::uint64_t step() const { return m_header->step; }
+
+  double *x() { return column(0); }
+  double *y() { return column(1); }
+  double *heading() { return column(2); }
+  double *speed() { return column(3); }
+  double *heading_deltas() { return column(4); }
+  double *speed_deltas() { return column(5); }
+  double *pheromones() { return column(COLUMNS); }
+
+  /**
+   * Publishes the state of the turtles of an environment, slot by slot, and
+   * the values of pheromones at their location, then clears the decisions.
+   * @throws std::length_error If the environment holds too many turtles.
+   * @throws std::invalid_argument If the number of pheromones is not
+   * pheromone_count().
+   */
+  void publish(const Environment &environment,
+               const ::std::vector<Environment::PheromoneHandle> &pheromones);
+
+  /**
+   * Adds the decided deltas to the headings and the speeds of the turtles
+   * of an environment, as ChangeDirection and ChangeSpeed influences would:
+   * the headings are normalized and the speeds stay positive. It holds the
+   * access lock of the environment alone.
+   * @throws std::invalid_argument If the environment does not hold count()
+   * turtles.
+   */
+  void apply(Environment &environment);
+
+private:
+  // The number of the columns of one value per turtle.
+  static constexpr ::std::size_t COLUMNS = 6;
+
+  struct Header {
+    ::std::uint64_t magic;
+    ::std::uint64_t capacity;
+    ::std::uint64_t pheromone_count;
+    ::std::uint64_t count;
+    ::std::uint64_t step;
+  };
+
+  SharedDecisionBuffer(::std::string name, void *mapping, ::std::size_t size,
+                       bool owner);
+
+  static ::std::size_t segment_size(::std::size_t capacity,
+                                    ::std::size_t pheromone_count);
+  double *column(::std::size_t index);
+  void release();
+
+  ::std::string m_name;
+  void *m_mapping;
+  ::std::size_t m_size;
+  bool m_owner;
+  Header *m_header;
+};
+
+} // namespace fr::univ_artois::lgi2a::similar::similar2logo::kernel::environment
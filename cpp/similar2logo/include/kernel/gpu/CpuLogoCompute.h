@@ -0,0 +1,75 @@
+#ifndef SIMILAR2LOGO_GPU_CPULOGOCOMPUTE_H
+#define SIMILAR2LOGO_GPU_CPULOGOCOMPUTE_H
+
+#include "LogoComputeBackend.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace gpu {
+
+/**
+ * The ILogoComputeBackend of the hosts without GPU, and the reference of
+ * the device backends: each kernel is a loop over the patches or the
+ * turtles, in the precision of the build, with the results of the host
+ * implementations. The turtles of a patch are sorted by index.
+ */
+class CpuLogoCompute : public ILogoComputeBackend {
+public:
+  /** Always available. */
+  static bool isAvailable() { return true; }
+
+  /** Nothing to prepare. */
+  bool initialize() override { return true; }
+  std::string getDeviceName() const override { return "CPU"; }
+
+  void resizeGrid(int width, int height, bool xTorus, bool yTorus,
+                  std::size_t fieldCount) override;
+  void uploadField(std::size_t field, const FieldValue *values) override;
+  void downloadField(std::size_t field, FieldValue *values) override;
+  void emitPheromones(std::size_t field, const FieldDeposit *deposits,
+                      std::size_t count) override;
+  void diffuseAndEvaporate(std::size_t field,
+                           const FieldRates &rates) override;
+  void uploadTurtles(const TurtleArrays &turtles) override;
+  void downloadTurtles(TurtleArrays &turtles) override;
+  void advanceTurtles(double dt) override;
+  void buildTurtleHash() override;
+  void downloadTurtleHash(TurtleHash &hash) override;
+
+private:
+  int width = 0;
+  int height = 0;
+  bool xTorus = false;
+  bool yTorus = false;
+
+  /** The fields, each one of width * height values. */
+  std::vector<std::vector<FieldValue>> fields;
+
+  /** The share given to each neighbour by the patches of a field. */
+  std::vector<FieldValue> shares;
+
+  /** The next values of a field, swapped with it by each step. */
+  std::vector<FieldValue> next;
+
+  TurtleArrays turtles;
+  TurtleHash hash;
+
+  std::vector<FieldValue> &fieldAt(std::size_t field);
+};
+
+} // namespace gpu
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_GPU_CPULOGOCOMPUTE_H
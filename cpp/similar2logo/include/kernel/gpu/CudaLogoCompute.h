@@ -0,0 +1,112 @@
+#ifndef SIMILAR2LOGO_GPU_CUDALOGOCOMPUTE_H
+#define SIMILAR2LOGO_GPU_CUDALOGOCOMPUTE_H
+
+#ifdef SIMILAR2LOGO_HAS_CUDA
+
+#include "LogoComputeBackend.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace gpu {
+
+/**
+ * The ILogoComputeBackend of NVIDIA hardware. The fields and the turtles
+ * live in device buffers, grown as needed and reused by the next calls;
+ * a step queues its kernels on the stream of the backend, and only the
+ * downloads wait for them. The deposits and the turtles of the hash are
+ * scattered with atomic additions, so the order of the turtles of a patch
+ * follows the scheduling of the device. A failing CUDA call after initialize()
+ * throws std::runtime_error, possibly one of a kernel queued before.
+ */
+class CudaLogoCompute : public ILogoComputeBackend {
+public:
+  /** @param device The index of the CUDA device. */
+  explicit CudaLogoCompute(int device = 0);
+  ~CudaLogoCompute() override;
+
+  CudaLogoCompute(const CudaLogoCompute &) = delete;
+  CudaLogoCompute &operator=(const CudaLogoCompute &) = delete;
+
+  /** Checks whether a CUDA device is available. */
+  static bool isAvailable();
+
+  bool initialize() override;
+  std::string getDeviceName() const override;
+  void resizeGrid(int width, int height, bool xTorus, bool yTorus,
+                  std::size_t fieldCount) override;
+  void uploadField(std::size_t field, const FieldValue *values) override;
+  void downloadField(std::size_t field, FieldValue *values) override;
+  void emitPheromones(std::size_t field, const FieldDeposit *deposits,
+                      std::size_t count) override;
+  void diffuseAndEvaporate(std::size_t field,
+                           const FieldRates &rates) override;
+  void uploadTurtles(const TurtleArrays &turtles) override;
+  void downloadTurtles(TurtleArrays &turtles) override;
+  void advanceTurtles(double dt) override;
+
+  /**
+   * Counts the turtles of each patch, scans the counts into the starts of
+   * the patches, then scatters the turtles behind them.
+   */
+  void buildTurtleHash() override;
+  void downloadTurtleHash(TurtleHash &hash) override;
+
+private:
+  int device;
+  bool initialized = false;
+  void *stream = nullptr; // cudaStream_t
+
+  int width = 0;
+  int height = 0;
+  bool xTorus = false;
+  bool yTorus = false;
+  std::size_t fieldCount = 0;
+
+  /** The fields, one after the other, then the shares and next values. */
+  FieldValue *d_fields = nullptr;
+  FieldValue *d_shares = nullptr;
+  FieldValue *d_next = nullptr;
+  FieldDeposit *d_deposits = nullptr;
+  std::size_t depositCapacity = 0;
+
+  /** The arrays of the turtles: x, y, heading, speed, acceleration. */
+  TurtleValue *d_turtles[5] = {};
+  std::size_t turtleCount = 0;
+  std::size_t turtleCapacity = 0;
+
+  /** The hash: the patches of the turtles, the starts and the cursors. */
+  std::uint32_t *d_cellOf = nullptr;
+  std::uint32_t *d_cellStart = nullptr;
+  std::uint32_t *d_cursor = nullptr;
+  std::uint32_t *d_order = nullptr;
+  void *d_scanStorage = nullptr;
+  std::size_t scanStorageBytes = 0;
+
+  std::size_t cells() const {
+    return static_cast<std::size_t>(width) * height;
+  }
+  FieldValue *fieldAt(std::size_t field) const;
+  void reserveTurtles(std::size_t count);
+  void releaseGrid();
+  void releaseTurtles();
+};
+
+} // namespace gpu
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_HAS_CUDA
+
+#endif // SIMILAR2LOGO_GPU_CUDALOGOCOMPUTE_H
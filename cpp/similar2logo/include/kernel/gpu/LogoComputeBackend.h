@@ -0,0 +1,151 @@
+#ifndef SIMILAR2LOGO_GPU_LOGOCOMPUTEBACKEND_H
+#define SIMILAR2LOGO_GPU_LOGOCOMPUTEBACKEND_H
+
+#include "../tools/Precision.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace gpu {
+
+/** The values of the pheromone fields, in the precision of the build. */
+using FieldValue = tools::Precision::Pheromone;
+
+/** The states of the turtles, in the precision of the build. */
+using TurtleValue = tools::Precision::State;
+
+/**
+ * The rates of one step of a field, the coefficients being multiplied by
+ * dt, as the ones of tools::FieldDiffusion.
+ */
+struct FieldRates {
+  double diffusion;
+  bool evaporate;
+  double evaporation;
+  double minValue;
+};
+
+/** A value added to a patch of a field, the patch being y * width + x. */
+struct FieldDeposit {
+  std::uint32_t cell;
+  FieldValue value;
+};
+
+/**
+ * The kinematic states of turtles, as structure of arrays: the buffers of
+ * the device hold the same arrays.
+ */
+struct TurtleArrays {
+  std::vector<TurtleValue> x;
+  std::vector<TurtleValue> y;
+  std::vector<TurtleValue> heading;
+  std::vector<TurtleValue> speed;
+  std::vector<TurtleValue> acceleration;
+
+  std::size_t size() const { return x.size(); }
+
+  void resize(std::size_t count) {
+    x.resize(count);
+    y.resize(count);
+    heading.resize(count);
+    speed.resize(count);
+    acceleration.resize(count);
+  }
+};
+
+/**
+ * The turtles sorted by patch: the turtles of the patch c are
+ * order[cellStart[c]] to order[cellStart[c + 1] - 1].
+ */
+struct TurtleHash {
+  std::vector<std::uint32_t> cellStart;
+  std::vector<std::uint32_t> order;
+};
+
+/**
+ * The compute backend of the reaction of a Logo level, holding the grid of
+ * pheromone fields and the turtles in buffers of its device.
+ *
+ * The buffers stay on the device between the calls, which are made on
+ * them: the host uploads the fields and the turtles it changed, runs the
+ * kernels, then downloads what it reads. The kernels follow the host
+ * implementations of the level:
+ * - diffuseAndEvaporate() the one of tools::FieldDiffusion, a patch giving
+ *   diffusion times its value shared equally between its neighbours in the
+ *   grid, before evaporating;
+ * - advanceTurtles() the one of influences::AgentPositionUpdate in
+ *   levels::LogoDefaultReactionModel, the speed taking the acceleration
+ *   before the turtle moves along its heading, wrapped on the toroidal axes
+ *   and clamped on the others;
+ * - buildTurtleHash() a counting sort of the turtles by patch;
+ * - emitPheromones() a scatter-add of deposits.
+ */
+class ILogoComputeBackend {
+public:
+  virtual ~ILogoComputeBackend() = default;
+
+  /**
+   * Prepares the device.
+   * @return False if the backend cannot run on this host.
+   */
+  virtual bool initialize() = 0;
+
+  /** Gets the name of the device the kernels run on. */
+  virtual std::string getDeviceName() const = 0;
+
+  /**
+   * Sets the size of the grid and the number of its fields, the fields
+   * being set to zero if the size changes.
+   */
+  virtual void resizeGrid(int width, int height, bool xTorus, bool yTorus,
+                          std::size_t fieldCount) = 0;
+
+  /** Copies the width * height values of a field, row by row, to the device. */
+  virtual void uploadField(std::size_t field, const FieldValue *values) = 0;
+
+  /** Copies the values of a field, row by row, from the device. */
+  virtual void downloadField(std::size_t field, FieldValue *values) = 0;
+
+  /** Adds deposits to a field, several deposits possibly sharing a patch. */
+  virtual void emitPheromones(std::size_t field, const FieldDeposit *deposits,
+                              std::size_t count) = 0;
+
+  /** Diffuses, then evaporates a field for one step. */
+  virtual void diffuseAndEvaporate(std::size_t field,
+                                   const FieldRates &rates) = 0;
+
+  /** Replaces the turtles of the device. */
+  virtual void uploadTurtles(const TurtleArrays &turtles) = 0;
+
+  /** Copies the states of the turtles of the device. */
+  virtual void downloadTurtles(TurtleArrays &turtles) = 0;
+
+  /** Moves the turtles of the device for a step of dt. */
+  virtual void advanceTurtles(double dt) = 0;
+
+  /**
+   * Sorts the turtles of the device by patch. The order of the turtles of
+   * a patch is left to the backend.
+   */
+  virtual void buildTurtleHash() = 0;
+
+  /** Copies the hash made by the last buildTurtleHash(). */
+  virtual void downloadTurtleHash(TurtleHash &hash) = 0;
+};
+
+} // namespace gpu
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_GPU_LOGOCOMPUTEBACKEND_H
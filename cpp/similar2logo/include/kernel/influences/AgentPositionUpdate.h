@@ -50,6 +50,10 @@ public:
   AgentPositionUpdate(const microkernel::LevelIdentifier &levelIdentifier,
                       const microkernel::SimulationTimeStamp &timeLowerBound,
                       const microkernel::SimulationTimeStamp &timeUpperBound);
+
+  ::std::size_t getTypeTag() const override {
+    return microkernel::influences::influenceTypeTag<AgentPositionUpdate>();
+  }
 };
 
 } // namespace influences
@@ -89,6 +89,10 @@ public:
   std::shared_ptr<model::environment::TurtlePLSInLogo> getTarget() const {
     return target;
   }
+
+  ::std::size_t getTypeTag() const override {
+    return microkernel::influences::influenceTypeTag<ChangeDirection>();
+  }
 };
 
 } // namespace influences
@@ -103,6 +103,10 @@ public:
   std::shared_ptr<model::environment::TurtlePLSInLogo> getTarget() const {
     return target;
   }
+
+  ::std::size_t getTypeTag() const override {
+    return microkernel::influences::influenceTypeTag<ChangePosition>();
+  }
 };
 
 } // namespace influences
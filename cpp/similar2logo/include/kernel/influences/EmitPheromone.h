@@ -109,6 +109,10 @@ public:
    * @return The amount of emitted pheromone.
    */
   double getValue() const { return value; }
+
+  ::std::size_t getTypeTag() const override {
+    return microkernel::influences::influenceTypeTag<EmitPheromone>();
+  }
 };
 
 } // namespace influences
@@ -50,6 +50,10 @@ public:
   PheromoneFieldUpdate(const microkernel::LevelIdentifier &levelIdentifier,
                        const microkernel::SimulationTimeStamp &timeLowerBound,
                        const microkernel::SimulationTimeStamp &timeUpperBound);
+
+  ::std::size_t getTypeTag() const override {
+    return microkernel::influences::influenceTypeTag<PheromoneFieldUpdate>();
+  }
 };
 
 } // namespace influences
@@ -0,0 +1,93 @@
+#ifndef SIMILAR2LOGO_RELOCATE_H
+#define SIMILAR2LOGO_RELOCATE_H
+
+#include "../../../../microkernel/include/LevelIdentifier.h"
+#include "../../../../microkernel/include/SimulationTimeStamp.h"
+#include "../../../../microkernel/include/influences/RegularInfluence.h"
+#include "../model/environment/TurtlePLSInLogo.h"
+#include <memory>
+#include <string>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace influences {
+
+/**
+ * Models an influence that aims at moving a turtle to a random empty patch,
+ * as the unhappy agents of a segregation model do. The reaction relocates
+ * all the turtles of a step at once, resolving their competition for the
+ * patches in parallel (see environment::Environment::relocate_turtles()).
+ */
+class Relocate : public microkernel::influences::RegularInfluence {
+public:
+  /**
+   * The category of the influence, used as a unique identifier in
+   * the reaction of the target level to determine the nature of the influence.
+   */
+  static constexpr const char *CATEGORY = "relocate";
+
+private:
+  /**
+   * The turtle's public local state that is going to change.
+   */
+  std::shared_ptr<model::environment::TurtlePLSInLogo> target;
+
+public:
+  /**
+   * Builds an instance of this influence created during the transitory
+   * period ] timeLowerBound, timeUpperBound [, in the LOGO level.
+   *
+   * @param timeLowerBound The lower bound of the transitory period
+   * @param timeUpperBound The upper bound of the transitory period
+   * @param target The turtle's public local state that is going to move
+   */
+  Relocate(
+      const ::fr::univ_artois::lgi2a::similar::microkernel::SimulationTimeStamp
+          &timeLowerBound,
+      const ::fr::univ_artois::lgi2a::similar::microkernel::SimulationTimeStamp
+          &timeUpperBound,
+      std::shared_ptr<model::environment::TurtlePLSInLogo> target);
+
+  /**
+   * Builds an instance of this influence created during the transitory
+   * period ] timeLowerBound, timeUpperBound [, in a given level.
+   *
+   * @param levelIdentifier The level in which the influence is emitted
+   * @param timeLowerBound The lower bound of the transitory period
+   * @param timeUpperBound The upper bound of the transitory period
+   * @param target The turtle's public local state that is going to move
+   */
+  Relocate(
+      const ::fr::univ_artois::lgi2a::similar::microkernel::LevelIdentifier
+          &levelIdentifier,
+      const ::fr::univ_artois::lgi2a::similar::microkernel::SimulationTimeStamp
+          &timeLowerBound,
+      const ::fr::univ_artois::lgi2a::similar::microkernel::SimulationTimeStamp
+          &timeUpperBound,
+      std::shared_ptr<model::environment::TurtlePLSInLogo> target);
+
+  /**
+   * @return The turtle's public local state that is going to move.
+   */
+  std::shared_ptr<model::environment::TurtlePLSInLogo> getTarget() const {
+    return target;
+  }
+
+  ::std::size_t getTypeTag() const override {
+    return microkernel::influences::influenceTypeTag<Relocate>();
+  }
+};
+
+} // namespace influences
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_RELOCATE_H
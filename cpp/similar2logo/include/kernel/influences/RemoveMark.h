@@ -70,6 +70,10 @@ public:
   std::shared_ptr<model::environment::SimpleMark> getMark() const {
     return mark;
   }
+
+  ::std::size_t getTypeTag() const override {
+    return microkernel::influences::influenceTypeTag<RemoveMark>();
+  }
 };
 
 } // namespace influences
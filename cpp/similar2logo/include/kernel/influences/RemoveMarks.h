@@ -76,6 +76,10 @@ public:
   getMarks() const {
     return marks;
   }
+
+  ::std::size_t getTypeTag() const override {
+    return microkernel::influences::influenceTypeTag<RemoveMarks>();
+  }
 };
 
 } // namespace influences
@@ -0,0 +1,124 @@
+#ifndef SIMILAR2LOGO_DISTRIBUTEDLOGOSIMULATIONMODEL_H
+#define SIMILAR2LOGO_DISTRIBUTEDLOGOSIMULATIONMODEL_H
+
+#include "../tools/DomainDecomposition.h"
+#include "environment/Pheromone.h"
+#include "environment/TurtlePLSInLogo.h"
+#include <AgentCategory.h>
+#include <agents/IAgent4Engine.h>
+#include <memory>
+#include <simulationmodel/ISimulationModel.h>
+#include <unordered_set>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace model {
+
+namespace mk = fr::univ_artois::lgi2a::similar::microkernel;
+namespace ek = fr::univ_artois::lgi2a::similar::extendedkernel;
+
+/**
+ * A Logo simulation split between the ranks of a
+ * engine::DistributedLogoSimulationEngine, each rank simulating the turtles
+ * of one domain of the grid.
+ *
+ * Every rank holds its own instance of the model. The engine builds the
+ * environment of a rank over its local grid, then asks the model for the
+ * turtles of its domain, and for the agent of each turtle: the agents of
+ * the turtles crossing into another domain are created again there, from
+ * the migrated turtle, before their states are restored.
+ */
+class DistributedLogoSimulationModel
+    : public ek::simulationmodel::ISimulationModel {
+public:
+  /** A turtle to create in the grid, with the category of its agent. */
+  struct Turtle {
+    mk::AgentCategory category;
+    std::shared_ptr<environment::TurtlePLSInLogo> state;
+  };
+
+  /**
+   * @param haloWidth The width of the halos of the domains, at least the
+   * radius of the perceptions and the distance a turtle moves in a step, and
+   * at least 2 for the diffusion of the pheromones across the domains.
+   */
+  DistributedLogoSimulationModel(
+      int width, int height, bool xTorus, bool yTorus, int haloWidth,
+      std::unordered_set<environment::Pheromone> pheromones);
+
+  virtual ~DistributedLogoSimulationModel() = default;
+
+  int getWidth() const { return width; }
+  int getHeight() const { return height; }
+  bool isXAxisTorus() const { return xTorus; }
+  bool isYAxisTorus() const { return yTorus; }
+  int getHaloWidth() const { return haloWidth; }
+  const std::unordered_set<environment::Pheromone> &getPheromones() const {
+    return pheromones;
+  }
+
+  ek::simulationmodel::ISimulationParameters *
+  getSimulationParameters() override {
+    return nullptr;
+  }
+
+  /**
+   * Generates the LOGO level, reacting with a
+   * levels::LogoDefaultReactionModel at each time step.
+   */
+  std::vector<std::shared_ptr<mk::levels::ILevel>>
+  generateLevels(const mk::SimulationTimeStamp &initialTime) override;
+
+  /** Built for each domain by the engine: generates nothing. */
+  EnvironmentInitializationData generateEnvironment(
+      const mk::SimulationTimeStamp &initialTime,
+      const std::map<mk::LevelIdentifier, std::shared_ptr<mk::levels::ILevel>>
+          &levels) final;
+
+  /** Built for each domain by the engine: generates nothing. */
+  AgentInitializationData generateAgents(
+      const mk::SimulationTimeStamp &initialTime,
+      const std::map<mk::LevelIdentifier, std::shared_ptr<mk::levels::ILevel>>
+          &levels) final;
+
+  /**
+   * Generates the initial turtles of a domain, in the coordinates of the
+   * grid. The turtles lying outside the domain are ignored, so that a model
+   * may generate the turtles of the whole grid on every rank.
+   */
+  virtual std::vector<Turtle>
+  generateTurtles(const mk::SimulationTimeStamp &initialTime,
+                  const tools::DomainDecomposition::Box &domain) = 0;
+
+  /**
+   * Creates the agent of a turtle, lying in the LOGO level and acting on
+   * the turtle. The location of the turtle is in the coordinates of the
+   * local grid of the rank.
+   */
+  virtual std::shared_ptr<mk::agents::IAgent4Engine>
+  createAgent(const mk::AgentCategory &category,
+              const std::shared_ptr<environment::TurtlePLSInLogo> &turtle) = 0;
+
+private:
+  int width;
+  int height;
+  bool xTorus;
+  bool yTorus;
+  int haloWidth;
+  std::unordered_set<environment::Pheromone> pheromones;
+};
+
+} // namespace model
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_DISTRIBUTEDLOGOSIMULATIONMODEL_H
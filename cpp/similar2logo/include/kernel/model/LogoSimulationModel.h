@@ -2,9 +2,11 @@
 #define SIMILAR2LOGO_LOGOSIMULATIONMODEL_H
 
 #include "../agents/LogoAgent.h"
+#include "../gpu/LogoComputeBackend.h"
 #include "environment/LogoEnvPLS.h"
 #include "levels/LogoSimulationLevelList.h"
 #include <ISimulationEngine.h>
+#include <cstddef>
 #include <functional>
 #include <memory>
 #include <simulationmodel/ISimulationModel.h>
@@ -38,9 +40,22 @@ private:
       std::function<std::vector<std::shared_ptr<kernel::agents::LogoAgent>>()>;
   AgentFactory agentFactory;
 
+  /**
+   * Creates the agents [begin, end) of a chunk, e.g. from their index as
+   * their seed. Called concurrently for different chunks.
+   */
+  using AgentChunkFactory =
+      std::function<std::vector<std::shared_ptr<kernel::agents::LogoAgent>>(
+          std::size_t begin, std::size_t end)>;
+  AgentChunkFactory agentChunkFactory;
+  std::size_t chunkedAgentCount = 0;
+
   // Environment configuration
   std::unordered_set<environment::Pheromone> pheromones;
 
+  // The backend of the reaction, null for the host implementations
+  std::shared_ptr<gpu::ILogoComputeBackend> computeBackend;
+
 public:
   LogoSimulationModel(int width, int height, bool xTorus = true,
                       bool yTorus = true, int maxSteps = 1000);
@@ -49,10 +64,35 @@ public:
 
   // Configuration
   void setAgentFactory(AgentFactory factory) { agentFactory = factory; }
+
+  /**
+   * Sets a factory creating agents by chunks, in parallel with the other
+   * chunks on the thread pool lent by the engine during the initialization
+   * (see WorkStealingThreadPool::parallelForOnCurrent()). The agents are
+   * generated after the ones of the agent factory.
+   * @param count The number of agents to create.
+   * @param factory The factory of the agents of a chunk.
+   */
+  void setAgentChunkFactory(std::size_t count, AgentChunkFactory factory) {
+    chunkedAgentCount = count;
+    agentChunkFactory = std::move(factory);
+  }
   void addPheromone(const environment::Pheromone &pheromone) {
     pheromones.insert(pheromone);
   }
 
+  /**
+   * Sets the backend of the reaction of the levels generated next, e.g. a
+   * gpu::CudaLogoCompute, or the host implementations if null (see
+   * levels::LogoDefaultReactionModel::setComputeBackend()).
+   */
+  void setComputeBackend(std::shared_ptr<gpu::ILogoComputeBackend> backend) {
+    computeBackend = std::move(backend);
+  }
+  const std::shared_ptr<gpu::ILogoComputeBackend> &getComputeBackend() const {
+    return computeBackend;
+  }
+
   // ISimulationModel interface
   ek::simulationmodel::ISimulationParameters *
   getSimulationParameters() override {
@@ -0,0 +1,64 @@
+#ifndef SIMILAR2LOGO_HEATMAPTILEPROBE_H
+#define SIMILAR2LOGO_HEATMAPTILEPROBE_H
+
+#include "../../../../../microkernel/include/IProbe.h"
+#include "../../../../../microkernel/include/LevelIdentifier.h"
+#include "../../tools/HeatmapTileRenderer.h"
+#include <memory>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace model {
+namespace environment {
+
+/**
+ * Renders the pheromone fields of a Logo level as heatmap tiles at each
+ * observation, a layer per pheromone named by its identifier, added on its
+ * first observation. Only the active tiles of the fields are compared (see
+ * HeatmapTileRenderer::update()), so a sparse field costs little.
+ */
+class HeatmapTileProbe : public similar::microkernel::IProbe {
+public:
+  /**
+   * @param maxValue The value shown with the last color of the layers.
+   * @throws std::invalid_argument If the renderer is null.
+   */
+  HeatmapTileProbe(std::shared_ptr<tools::HeatmapTileRenderer> renderer,
+                   similar::microkernel::LevelIdentifier level,
+                   double maxValue = 1);
+
+  void observeAtInitialTimes(
+      const similar::microkernel::SimulationTimeStamp &initialTimestamp,
+      const similar::microkernel::ISimulationEngine &simulationEngine)
+      override;
+  void observeAtPartialConsistentTime(
+      const similar::microkernel::SimulationTimeStamp &timestamp,
+      const similar::microkernel::ISimulationEngine &simulationEngine)
+      override;
+
+  std::shared_ptr<similar::microkernel::IProbe> clone() const override {
+    return std::make_shared<HeatmapTileProbe>(*this);
+  }
+
+private:
+  std::shared_ptr<tools::HeatmapTileRenderer> renderer;
+  similar::microkernel::LevelIdentifier level;
+  double maxValue;
+
+  void observe(const similar::microkernel::ISimulationEngine &engine);
+};
+
+} // namespace environment
+} // namespace model
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_HEATMAPTILEPROBE_H
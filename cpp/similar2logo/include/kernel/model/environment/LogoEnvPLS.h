@@ -1,16 +1,26 @@
 #ifndef SIMILAR2LOGO_LOGOENVPLS_H
 #define SIMILAR2LOGO_LOGOENVPLS_H
 
+#include "../../../../../microkernel/include/CopyOnWrite.h"
 #include "../../../../../microkernel/include/LevelIdentifier.h"
+#include "../../../../../microkernel/include/engine/WorkStealingThreadPool.h"
+#include "../../../../../microkernel/include/libs/MemoryAccounting.h"
 #include "../../../../../microkernel/include/libs/abstractimpl/AbstractLocalStateOfEnvironment.h"
+#include "../../tools/FieldDiffusion.h"
+#include "../../tools/Grid.h"
 #include "../../tools/MathUtil.h"
 #include "../../tools/Point2D.h"
+#include "../../tools/Topology.h"
 #include "Mark.h"
+#include "MarkStore.h"
 #include "Pheromone.h"
 #include "TurtlePLSInLogo.h"
+#include <algorithm>
 #include <cmath>
+#include <functional>
 #include <memory>
 #include <set>
+#include <utility>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -34,10 +44,39 @@ class TurtlePLSInLogo;
  * - Pheromone fields
  * - Marks dropped by agents
  * - Turtle positions
+ *
+ * The grids are the ones of kernel::environment::Environment: row by row
+ * tools::Grid, tiled pheromone fields updated by tools::FieldDiffusion and
+ * a MarkStore, so that a patch (x, y) is at the same cell in both.
+ *
+ * A clone shares the pheromone fields and the marks with the original, copy
+ * on write: a field or the mark store is copied by the first of them to
+ * write it, so that the branches forked from a simulation (see
+ * MultiThreadedSimulationEngine::fork()) only pay for what diverges. The
+ * marks are shared as values, which are dropped and removed but not
+ * modified; the turtles are copied.
  */
 class LogoEnvPLS : public similar::microkernel::libs::abstractimpl::
                        AbstractLocalStateOfEnvironment {
 public:
+  /** A pheromone field, with the activity of its tiles. */
+  using PheromoneField = kernel::tools::TiledField;
+  /** A field shared with the clones until one of them writes it. */
+  using SharedPheromoneField =
+      similar::microkernel::CopyOnWrite<PheromoneField>;
+  /** The account of the memory of the turtles of the patches */
+  struct PatchMemory {
+    static const char *name() { return "patches"; }
+  };
+  using TurtleSet = std::unordered_set<
+      std::shared_ptr<TurtlePLSInLogo>,
+      std::hash<std::shared_ptr<TurtlePLSInLogo>>,
+      std::equal_to<std::shared_ptr<TurtlePLSInLogo>>,
+      similar::microkernel::libs::TrackedAllocator<
+          std::shared_ptr<TurtlePLSInLogo>, PatchMemory>>;
+  /** The turtles of each patch. */
+  using TurtleGrid = kernel::tools::Grid<TurtleSet>;
+
   // Direction constants (in radians)
   static constexpr double NORTH = 0.0;
   static constexpr double NORTH_EAST =
@@ -60,17 +99,65 @@ private:
   bool xAxisTorus;
   bool yAxisTorus;
 
-  // Pheromone field: map from pheromone to 2D grid of values
-  std::unordered_map<Pheromone, std::vector<std::vector<double>>>
-      pheromoneField;
+  /**
+   * Visits the neighbors of a patch within a distance known at compile time
+   * when Radius > 0, for a given tools::Topology. Only the first neighbor
+   * along each axis is wrapped; the next ones are offsets from it.
+   */
+  template <int Radius, typename Topology, typename Visitor>
+  void visitNeighbors(int x, int y, int distance, Visitor &visitor) const {
+    const int radius = Radius > 0 ? Radius : distance;
+    int firstX, columns, firstY, rows;
+    axisSpan<Topology::X_WRAPS>(x, radius, width, firstX, columns);
+    axisSpan<Topology::Y_WRAPS>(y, radius, height, firstY, rows);
+    for (int i = 0, nx = firstX; i < columns; i++) {
+      for (int j = 0, ny = firstY; j < rows; j++) {
+        visitor(nx, ny);
+        ny = next<Topology::Y_WRAPS>(ny, height);
+      }
+      nx = next<Topology::X_WRAPS>(nx, width);
+    }
+  }
+
+  /**
+   * Gets the first neighbor of a coordinate along an axis, and the number of
+   * neighbors along it.
+   */
+  template <bool Torus>
+  static void axisSpan(int coordinate, int radius, int length, int &first,
+                       int &count) {
+    if constexpr (Torus) {
+      first = coordinate - radius;
+      if (first < 0 || first >= length) {
+        first = first < 0 && first >= -length ? first + length
+                                              : (first % length + length) %
+                                                    length;
+      }
+      count = 2 * radius + 1;
+    } else {
+      first = std::max(coordinate - radius, 0);
+      count = std::max(std::min(coordinate + radius, length - 1) - first + 1,
+                       0);
+    }
+  }
+
+  /** Gets the coordinate following another along an axis. */
+  template <bool Torus> static int next(int coordinate, int length) {
+    if constexpr (Torus) {
+      return coordinate + 1 == length ? 0 : coordinate + 1;
+    } else {
+      return coordinate + 1;
+    }
+  }
+
+  // Pheromone field: map from pheromone to its field
+  std::unordered_map<Pheromone, SharedPheromoneField> pheromoneField;
 
   // Marks in each patch
-  std::vector<std::vector<std::unordered_set<std::shared_ptr<SimpleMark>>>>
-      marks;
+  similar::microkernel::CopyOnWrite<MarkStore> marks;
 
   // Turtles in each patch
-  std::vector<std::vector<std::unordered_set<std::shared_ptr<TurtlePLSInLogo>>>>
-      turtlesInPatches;
+  TurtleGrid turtlesInPatches;
 
 public:
   /**
@@ -88,26 +175,23 @@ public:
       : similar::microkernel::libs::abstractimpl::
             AbstractLocalStateOfEnvironment(levelIdentifier),
         width(gridWidth), height(gridHeight), xAxisTorus(xAxisTorus),
-        yAxisTorus(yAxisTorus) {
+        yAxisTorus(yAxisTorus), marks(MarkStore(gridWidth, gridHeight)),
+        turtlesInPatches(gridWidth, gridHeight) {
 
-    // Initialize pheromone fields
+    // Initialize pheromone fields, in parallel on the pool lent to the
+    // environment if any
+    std::vector<std::pair<PheromoneField *, double>> fields;
+    fields.reserve(pheromones.size());
     for (const auto &pheromone : pheromones) {
-      std::vector<std::vector<double>> field(
-          width, std::vector<double>(height, pheromone.getDefaultValue()));
-      pheromoneField[pheromone] = field;
-    }
-
-    // Initialize marks grid
-    marks.resize(width);
-    for (int x = 0; x < width; x++) {
-      marks[x].resize(height);
-    }
-
-    // Initialize turtles grid
-    turtlesInPatches.resize(width);
-    for (int x = 0; x < width; x++) {
-      turtlesInPatches[x].resize(height);
+      fields.emplace_back(&pheromoneField[pheromone].mutate(),
+                          pheromone.getDefaultValue());
     }
+    similar::microkernel::engine::WorkStealingThreadPool::parallelForOnCurrent(
+        fields.size(), 1, [&](std::size_t begin, std::size_t end, std::size_t) {
+          for (std::size_t i = begin; i < end; ++i) {
+            fields[i].first->assign(width, height, fields[i].second);
+          }
+        });
   }
 
   virtual ~LogoEnvPLS() = default;
@@ -184,29 +268,33 @@ public:
     std::vector<
         ::fr::univ_artois::lgi2a::similar::similar2logo::kernel::tools::Point2D>
         neighbors;
+    neighbors.reserve(static_cast<size_t>(2 * distance + 1) *
+                      (2 * distance + 1));
+    forEachNeighbor(x, y, distance, [&](int nx, int ny) {
+      neighbors.push_back(::fr::univ_artois::lgi2a::similar::similar2logo::
+                              kernel::tools::Point2D(nx, ny));
+    });
+    return neighbors;
+  }
 
-    for (int dx = -distance; dx <= distance; dx++) {
-      for (int dy = -distance; dy <= distance; dy++) {
-        int nx = x + dx;
-        int ny = y + dy;
-
-        // Handle toroidal wrapping
-        if (xAxisTorus) {
-          nx = ((nx % width) + width) % width;
-        }
-        if (yAxisTorus) {
-          ny = ((ny % height) + height) % height;
-        }
-
-        // Check if within bounds
-        if (nx >= 0 && nx < width && ny >= 0 && ny < height) {
-          neighbors.push_back(::fr::univ_artois::lgi2a::similar::similar2logo::
-                                  kernel::tools::Point2D(nx, ny));
-        }
+  /**
+   * Visits the patches returned by getNeighbors(x, y, distance), in the same
+   * order, without allocating: the patch itself is included, and a patch is
+   * visited several times when a toroidal axis is shorter than the
+   * neighbourhood.
+   * @param visitor Called with the coordinates of each neighbor.
+   */
+  template <typename Visitor>
+  void forEachNeighbor(int x, int y, int distance, Visitor &&visitor) const {
+    kernel::tools::withTopology(xAxisTorus, yAxisTorus, [&](auto topology) {
+      using T = decltype(topology);
+      if (distance == 1) {
+        // The usual Moore neighbourhood, unrolled for each topology.
+        visitNeighbors<1, T>(x, y, 1, visitor);
+      } else {
+        visitNeighbors<0, T>(x, y, distance, visitor);
       }
-    }
-
-    return neighbors;
+    });
   }
 
   /**
@@ -243,13 +331,42 @@ public:
     return -std::atan2(xtarget - from.x, ytarget - from.y);
   }
 
+  /**
+   * Computes the directions from a point to count points given by the arrays
+   * of their coordinates, as getDirection() for each of them.
+   * @param directions Receives the count directions, in radians
+   * @param accurate Whether the directions are exact, or approximated by a
+   * vectorized loop (see MathUtil::toroidalDirections())
+   */
+  void getDirections(const ::fr::univ_artois::lgi2a::similar::similar2logo::
+                         kernel::tools::Point2D &from,
+                     const double *xs, const double *ys, std::size_t count,
+                     double *directions, bool accurate = true) const {
+    kernel::tools::MathUtil::toroidalDirections(from, xs, ys, count, width,
+                                                height, xAxisTorus, yAxisTorus,
+                                                directions, accurate);
+  }
+
+  /**
+   * Computes the squared distances from a point to count points given by the
+   * arrays of their coordinates, as getDistance() squared for each of them.
+   * @param distances Receives the count squared distances
+   */
+  void getSquaredDistances(const ::fr::univ_artois::lgi2a::similar::
+                               similar2logo::kernel::tools::Point2D &from,
+                           const double *xs, const double *ys,
+                           std::size_t count, double *distances) const {
+    kernel::tools::MathUtil::squaredToroidalDistances(
+        from, xs, ys, count, width, height, xAxisTorus, yAxisTorus, distances);
+  }
+
   // Removed duplicate getDistance method here
 
   // Pheromone field access
   double getPheromoneValueAt(const Pheromone &pheromone, int x, int y) const {
     auto it = pheromoneField.find(pheromone);
     if (it != pheromoneField.end()) {
-      return it->second[x][y];
+      return it->second->values(x, y);
     }
     return 0.0;
   }
@@ -264,77 +381,75 @@ public:
                            double value) {
     auto it = pheromoneField.find(pheromone);
     if (it != pheromoneField.end()) {
-      it->second[x][y] = value;
+      it->second.mutate().set(x, y, value);
     }
   }
 
-  const std::vector<std::vector<double>> &
-  getPheromoneValues(const Pheromone &pheromone) const {
-    static const std::vector<std::vector<double>> empty;
+  /**
+   * Gets the field of a pheromone; its values are written through
+   * PheromoneField::set() or add(), which keep the activity of its tiles.
+   */
+  const PheromoneField &getPheromoneValues(const Pheromone &pheromone) const {
+    static const PheromoneField empty;
     auto it = pheromoneField.find(pheromone);
     if (it != pheromoneField.end()) {
-      return it->second;
+      return it->second.get();
     }
     return empty;
   }
 
-  std::vector<std::vector<double>> &
-  getPheromoneValues(const Pheromone &pheromone) {
-    return pheromoneField[pheromone];
+  /** Gets the field of a pheromone for writing, copied if it is shared. */
+  PheromoneField &getPheromoneValues(const Pheromone &pheromone) {
+    return pheromoneField[pheromone].mutate();
   }
 
-  const std::unordered_map<Pheromone, std::vector<std::vector<double>>> &
+  /**
+   * Gets the fields of the pheromones, written through
+   * SharedPheromoneField::mutate().
+   */
+  const std::unordered_map<Pheromone, SharedPheromoneField> &
   getPheromoneField() const {
     return pheromoneField;
   }
 
-  std::unordered_map<Pheromone, std::vector<std::vector<double>>> &
-  getPheromoneField() {
+  std::unordered_map<Pheromone, SharedPheromoneField> &getPheromoneField() {
     return pheromoneField;
   }
 
   // Mark access
-  const std::unordered_set<std::shared_ptr<SimpleMark>> &
-  getMarksAt(int x, int y) const {
-    return marks[x][y];
+  std::vector<std::shared_ptr<SimpleMark>> getMarksAt(int x, int y) const {
+    return marks->getAt(x, y);
   }
 
-  const std::unordered_set<std::shared_ptr<SimpleMark>> &
+  std::vector<std::shared_ptr<SimpleMark>>
   getMarksAt(const kernel::tools::Point2D &position) const {
-    return marks[static_cast<int>(position.x)][static_cast<int>(position.y)];
+    return marks->getAt(static_cast<int>(position.x),
+                        static_cast<int>(position.y));
   }
 
-  std::unordered_set<std::shared_ptr<SimpleMark>> getMarksAt(double x,
-                                                             double y) const {
-    return marks[static_cast<int>(x)][static_cast<int>(y)];
+  std::vector<std::shared_ptr<SimpleMark>> getMarksAt(double x,
+                                                      double y) const {
+    return marks->getAt(static_cast<int>(x), static_cast<int>(y));
   }
 
   std::unordered_set<std::shared_ptr<SimpleMark>> getAllMarks() const {
     std::unordered_set<std::shared_ptr<SimpleMark>> allMarks;
-    for (const auto &row : marks) {
-      for (const auto &cell : row) {
-        allMarks.insert(cell.begin(), cell.end());
-      }
-    }
+    marks->forEach([&](int, int, const std::shared_ptr<SimpleMark> &mark) {
+      allMarks.insert(mark);
+    });
     return allMarks;
   }
 
   void addMark(std::shared_ptr<SimpleMark> mark) {
     auto loc = mark->getLocation();
-    int x = static_cast<int>(loc.x);
-    int y = static_cast<int>(loc.y);
-    if (x >= 0 && x < width && y >= 0 && y < height) {
-      marks[x][y].insert(mark);
-    }
+    marks.mutate().add(static_cast<int>(loc.x), static_cast<int>(loc.y),
+                       std::move(mark));
   }
 
   void removeMark(std::shared_ptr<SimpleMark> mark) {
     auto loc = mark->getLocation();
-    int x = static_cast<int>(loc.x);
-    int y = static_cast<int>(loc.y);
-    if (x >= 0 && x < width && y >= 0 && y < height) {
-      marks[x][y].erase(mark);
-    }
+    marks.mutate().remove(static_cast<int>(loc.x), static_cast<int>(loc.y),
+                          mark);
   }
 
   /**
@@ -343,13 +458,10 @@ public:
   LogoEnvPLS(
       const similar::microkernel::LevelIdentifier &levelIdentifier,
       int gridWidth, int gridHeight, bool xAxisTorus, bool yAxisTorus,
-      const std::unordered_map<Pheromone, std::vector<std::vector<double>>>
+      const std::unordered_map<Pheromone, SharedPheromoneField>
           &pheromoneField,
-      const std::vector<
-          std::vector<std::unordered_set<std::shared_ptr<SimpleMark>>>> &marks,
-      const std::vector<
-          std::vector<std::unordered_set<std::shared_ptr<TurtlePLSInLogo>>>>
-          &turtlesInPatches)
+      const similar::microkernel::CopyOnWrite<MarkStore> &marks,
+      const TurtleGrid &turtlesInPatches)
       : similar::microkernel::libs::abstractimpl::
             AbstractLocalStateOfEnvironment(levelIdentifier),
         width(gridWidth), height(gridHeight), xAxisTorus(xAxisTorus),
@@ -358,88 +470,67 @@ public:
 
 public:
   /**
-   * Creates a deep copy of this environment state.
+   * Creates a copy of this environment state, sharing the pheromone fields
+   * and the marks until either state writes them.
    * @return A new LogoEnvPLS with copied data
    */
   std::shared_ptr<similar::microkernel::ILocalState> clone() const override {
-    // Deep copy marks
-    std::vector<std::vector<std::unordered_set<std::shared_ptr<SimpleMark>>>>
-        marksCopy = marks;
-    for (int x = 0; x < width; x++) {
-      for (int y = 0; y < height; y++) {
-        marksCopy[x][y].clear();
-        for (const auto &mark : marks[x][y]) {
-          marksCopy[x][y].insert(mark->clone());
-        }
-      }
-    }
-
     // Deep copy turtles
-    std::vector<
-        std::vector<std::unordered_set<std::shared_ptr<TurtlePLSInLogo>>>>
-        turtlesCopy = turtlesInPatches;
-    for (int x = 0; x < width; x++) {
-      for (int y = 0; y < height; y++) {
-        turtlesCopy[x][y].clear();
-        for (const auto &turtle : turtlesInPatches[x][y]) {
-          turtlesCopy[x][y].insert(turtle->clone());
-        }
+    TurtleGrid turtlesCopy(width, height);
+    for (std::size_t cell = 0; cell < turtlesInPatches.size(); cell++) {
+      for (const auto &turtle : turtlesInPatches[cell]) {
+        turtlesCopy[cell].insert(turtle->clone());
       }
     }
 
     return std::shared_ptr<LogoEnvPLS>(
         new LogoEnvPLS(getLevel(), width, height, xAxisTorus, yAxisTorus,
-                       pheromoneField, marksCopy, turtlesCopy));
+                       pheromoneField, marks, turtlesCopy));
   }
 
   // Turtle access
-  const std::vector<
-      std::vector<std::unordered_set<std::shared_ptr<TurtlePLSInLogo>>>> &
-  getTurtlesInPatches() const {
-    return turtlesInPatches;
-  }
+  /** Gets the turtles of each patch, turtlesInPatches(x, y). */
+  const TurtleGrid &getTurtlesInPatches() const { return turtlesInPatches; }
 
-  std::vector<
-      std::vector<std::unordered_set<std::shared_ptr<TurtlePLSInLogo>>>> &
-  getTurtlesInPatches() {
-    return turtlesInPatches;
-  }
+  TurtleGrid &getTurtlesInPatches() { return turtlesInPatches; }
 
-  std::unordered_set<std::shared_ptr<TurtlePLSInLogo>>
-  getTurtlesAt(int x, int y) const {
-    if (x >= 0 && x < width && y >= 0 && y < height) {
-      return turtlesInPatches[x][y];
+  TurtleSet getTurtlesAt(int x, int y) const {
+    if (turtlesInPatches.contains(x, y)) {
+      return turtlesInPatches(x, y);
     }
     return {};
   }
 
-  std::unordered_set<std::shared_ptr<TurtlePLSInLogo>>
-  getTurtlesAt(const kernel::tools::Point2D &position) const {
+  TurtleSet getTurtlesAt(const kernel::tools::Point2D &position) const {
     return getTurtlesAt(static_cast<int>(position.x),
                         static_cast<int>(position.y));
   }
 
-  std::unordered_set<std::shared_ptr<TurtlePLSInLogo>> getAllTurtles() const {
-    std::unordered_set<std::shared_ptr<TurtlePLSInLogo>> allTurtles;
-    for (const auto &row : turtlesInPatches) {
-      for (const auto &cell : row) {
-        allTurtles.insert(cell.begin(), cell.end());
-      }
+  TurtleSet getAllTurtles() const {
+    TurtleSet allTurtles;
+    for (const auto &cell : turtlesInPatches) {
+      allTurtles.insert(cell.begin(), cell.end());
     }
     return allTurtles;
   }
 
-  // Mark access (direct grid access)
-  const std::vector<
-      std::vector<std::unordered_set<std::shared_ptr<SimpleMark>>>> &
-  getMarks() const {
-    return marks;
-  }
+  // Mark access (direct store access)
+  const MarkStore &getMarks() const { return marks.get(); }
 
-  std::vector<std::vector<std::unordered_set<std::shared_ptr<SimpleMark>>>> &
-  getMarks() {
-    return marks;
+  /** Gets the marks for writing, copied if they are shared. */
+  MarkStore &getMarks() { return marks.mutate(); }
+
+  /**
+   * Checks if the field of a pheromone is still shared with a clone, i.e.
+   * neither wrote it since the clone.
+   */
+  bool isPheromoneFieldShared(const Pheromone &pheromone) const {
+    auto it = pheromoneField.find(pheromone);
+    return it != pheromoneField.end() && it->second.isShared();
   }
+
+  /** Checks if the marks are still shared with a clone. */
+  bool areMarksShared() const { return marks.isShared(); }
 };
 
 } // namespace environment
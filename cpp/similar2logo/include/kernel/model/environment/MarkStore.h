@@ -0,0 +1,173 @@
+#ifndef SIMILAR2LOGO_MARKSTORE_H
+#define SIMILAR2LOGO_MARKSTORE_H
+
+#include "../../../../../microkernel/include/libs/MemoryAccounting.h"
+#include "Mark.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace model {
+namespace environment {
+
+/**
+ * The marks of the patches of a grid, as sets of marks per patch.
+ *
+ * The marks are kept in one pool, each entry being in the list of its
+ * patch. The heads of the lists are allocated by tiles of TILE_SIZE x
+ * TILE_SIZE patches, the first time a mark is added to a tile, so that the
+ * memory follows the number of marks and of marked tiles rather than the
+ * size of the grid.
+ */
+class MarkStore {
+public:
+  static constexpr int TILE_SIZE = 32;
+  /** The cell given to the batch methods for the marks to skip. */
+  static constexpr ::std::uint32_t NO_CELL = ~::std::uint32_t(0);
+
+  MarkStore(int width, int height);
+
+  int getWidth() const { return width; }
+  int getHeight() const { return height; }
+
+  /** Gets the number of marks of all the patches. */
+  ::std::size_t size() const { return count; }
+
+  /**
+   * Adds a mark to the patch (x, y), unless it already holds it or the
+   * patch is outside the grid.
+   * @return True if the mark was added.
+   */
+  bool add(int x, int y, ::std::shared_ptr<SimpleMark> mark);
+
+  /**
+   * Removes a mark from the patch (x, y).
+   * @return True if the patch held the mark.
+   */
+  bool remove(int x, int y, const ::std::shared_ptr<SimpleMark> &mark);
+
+  /**
+   * Adds marks as add() does, the bands of tile columns inserting their
+   * marks in parallel on the pool lent by the engine (see RowBands). The
+   * marks of a patch are inserted in their order.
+   * @param cells The patch of each mark, y * width + x, or NO_CELL.
+   * @return Whether each mark was added.
+   */
+  ::std::vector<unsigned char>
+  addAll(const ::std::vector<::std::shared_ptr<SimpleMark>> &marks,
+         const ::std::vector<::std::uint32_t> &cells);
+
+  /**
+   * Removes marks as remove() does, in parallel as addAll() does.
+   * @return Whether each mark was removed.
+   */
+  ::std::vector<unsigned char>
+  removeAll(const ::std::vector<::std::shared_ptr<SimpleMark>> &marks,
+            const ::std::vector<::std::uint32_t> &cells);
+
+  /** Gets the number of marks of the patch (x, y). */
+  ::std::size_t countAt(int x, int y) const;
+
+  /** Calls visitor(mark) for each mark of the patch (x, y). */
+  template <typename Visitor>
+  void forEachAt(int x, int y, Visitor &&visitor) const {
+    if (x < 0 || x >= width || y < 0 || y >= height) {
+      return;
+    }
+    for (::std::uint32_t e = head(cellOf(x, y)); e != NO_ENTRY;
+         e = entries[e].next) {
+      visitor(entries[e].mark);
+    }
+  }
+
+  /** Gets the marks of the patch (x, y). */
+  ::std::vector<::std::shared_ptr<SimpleMark>> getAt(int x, int y) const;
+
+  /** Calls visitor(x, y, mark) for each mark, in no particular order. */
+  template <typename Visitor> void forEach(Visitor &&visitor) const {
+    for (const Entry &entry : entries) {
+      if (entry.mark) {
+        visitor(static_cast<int>(entry.cell % width),
+                static_cast<int>(entry.cell / width), entry.mark);
+      }
+    }
+  }
+
+  /** Removes all the marks. */
+  void clear();
+
+private:
+  static constexpr ::std::uint32_t NO_ENTRY = ~::std::uint32_t(0);
+
+  // a mark in the list of its patch, or a free entry, with no mark, in the
+  // list of the free entries
+  struct Entry {
+    ::std::shared_ptr<SimpleMark> mark;
+    ::std::uint32_t cell;
+    ::std::uint32_t next;
+    ::std::uint32_t previous;
+  };
+
+  // the account of the memory of the entries
+  struct Memory {
+    static const char *name() { return "marks"; }
+  };
+
+  int width;
+  int height;
+  int tileColumns;
+  ::std::size_t count = 0;
+  ::std::vector<Entry,
+                similar::microkernel::libs::TrackedAllocator<Entry, Memory>>
+      entries;
+  ::std::uint32_t freeEntries = NO_ENTRY;
+  // the heads of the lists of each tile, row by row, empty until a mark is
+  // added to the tile
+  ::std::vector<::std::vector<::std::uint32_t>> heads;
+
+  ::std::uint32_t cellOf(int x, int y) const {
+    return static_cast<::std::uint32_t>(y) * width + x;
+  }
+  ::std::uint32_t tileColumnOf(::std::uint32_t cell) const {
+    return cell % width / TILE_SIZE;
+  }
+  ::std::size_t tileOf(::std::uint32_t cell) const {
+    return (cell / width / TILE_SIZE) * tileColumns + cell % width / TILE_SIZE;
+  }
+  ::std::size_t offsetIn(::std::uint32_t cell) const {
+    return (cell / width % TILE_SIZE) * TILE_SIZE + cell % width % TILE_SIZE;
+  }
+
+  ::std::uint32_t head(::std::uint32_t cell) const {
+    const ::std::vector<::std::uint32_t> &tile = heads[tileOf(cell)];
+    return tile.empty() ? NO_ENTRY : tile[offsetIn(cell)];
+  }
+
+  // the entry holding a mark in the list of a patch, or NO_ENTRY
+  ::std::uint32_t find(::std::uint32_t cell, const SimpleMark *mark) const;
+
+  // allocates the heads of the tile of a cell if needed
+  void ensureTile(::std::uint32_t cell);
+  ::std::uint32_t allocate();
+  void release(::std::uint32_t entry);
+  void link(::std::uint32_t entry, ::std::uint32_t cell);
+  void unlink(::std::uint32_t entry);
+};
+
+} // namespace environment
+} // namespace model
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_MARKSTORE_H
@@ -3,6 +3,8 @@
 
 #include "../../tools/Point2D.h"
 #include "SituatedEntity.h"
+#include "TurtleStore.h"
+#include <cstddef>
 #include <memory>
 #include <string>
 
@@ -22,16 +24,26 @@ namespace environment {
  * - position (location)
  * - speed and acceleration
  * - heading/direction
+ *
+ * Once added to an Environment, the turtle is a handle onto a slot of the
+ * TurtleStore of the environment, which holds its location, heading, speed,
+ * acceleration and color; the fields of the turtle hold them otherwise.
  */
 class TurtlePLSInLogo : public SituatedEntity {
 private:
+  friend class TurtleStore;
+
   ::fr::univ_artois::lgi2a::similar::similar2logo::kernel::tools::Point2D
       location;
   double heading;
   double speed;
   double acceleration;
   bool penDown;
-  ::std::string color;
+  similar::microkernel::libs::Symbol color;
+
+  // the store holding the state of the turtle, nullptr when detached
+  TurtleStore *store = nullptr;
+  ::std::size_t slot = 0;
 
 public:
   /**
@@ -50,35 +62,117 @@ public:
       : location(location), heading(heading), speed(speed),
         acceleration(acceleration), penDown(penDown), color(color) {}
 
-  virtual ~TurtlePLSInLogo() = default;
+  /** Creates a turtle whose color is already interned. */
+  TurtlePLSInLogo(const ::fr::univ_artois::lgi2a::similar::similar2logo::
+                      kernel::tools::Point2D &location,
+                  double heading, double speed, double acceleration,
+                  bool penDown, similar::microkernel::libs::Symbol color)
+      : location(location), heading(heading), speed(speed),
+        acceleration(acceleration), penDown(penDown), color(color) {}
+
+  /** Copies the state of a turtle into a detached turtle. */
+  TurtlePLSInLogo(const TurtlePLSInLogo &other)
+      : SituatedEntity(other), location(other.getLocation()),
+        heading(other.getHeading()), speed(other.getSpeed()),
+        acceleration(other.getAcceleration()), penDown(other.penDown),
+        color(other.getColorSymbol()) {}
+
+  /** Copies the state of a turtle, keeping the slot of this turtle. */
+  TurtlePLSInLogo &operator=(const TurtlePLSInLogo &other) {
+    if (this != &other) {
+      setLocation(other.getLocation());
+      setHeading(other.getHeading());
+      setSpeed(other.getSpeed());
+      setAcceleration(other.getAcceleration());
+      setPenDown(other.penDown);
+      setColorSymbol(other.getColorSymbol());
+    }
+    return *this;
+  }
+
+  virtual ~TurtlePLSInLogo() {
+    if (store) {
+      store->detach(slot);
+    }
+  }
+
+  /** Gets the store holding the state of the turtle, or nullptr. */
+  const TurtleStore *getStore() const { return store; }
+
+  /** Gets the slot of the turtle in its store. */
+  ::std::size_t getSlot() const { return slot; }
 
   // SituatedEntity interface
   ::fr::univ_artois::lgi2a::similar::similar2logo::kernel::tools::Point2D
   getLocation() const override {
+    if (store) {
+      return ::fr::univ_artois::lgi2a::similar::similar2logo::kernel::tools::
+          Point2D(store->x[slot], store->y[slot]);
+    }
     return location;
   }
 
   void setLocation(const ::fr::univ_artois::lgi2a::similar::similar2logo::
                        kernel::tools::Point2D &newLocation) {
-    location = newLocation;
+    if (store) {
+      store->x[slot] = static_cast<TurtleStore::Real>(newLocation.x);
+      store->y[slot] = static_cast<TurtleStore::Real>(newLocation.y);
+    } else {
+      location = newLocation;
+    }
   }
 
-  double getHeading() const { return heading; }
-  void setHeading(double newHeading) { heading = newHeading; }
+  double getHeading() const { return store ? store->heading[slot] : heading; }
+  void setHeading(double newHeading) {
+    if (store) {
+      store->heading[slot] = static_cast<TurtleStore::Real>(newHeading);
+    } else {
+      heading = newHeading;
+    }
+  }
 
-  double getSpeed() const { return speed; }
-  void setSpeed(double newSpeed) { speed = newSpeed; }
+  double getSpeed() const { return store ? store->speed[slot] : speed; }
+  void setSpeed(double newSpeed) {
+    if (store) {
+      store->speed[slot] = static_cast<TurtleStore::Real>(newSpeed);
+    } else {
+      speed = newSpeed;
+    }
+  }
 
-  double getAcceleration() const { return acceleration; }
+  double getAcceleration() const {
+    return store ? store->acceleration[slot] : acceleration;
+  }
   void setAcceleration(double newAcceleration) {
-    acceleration = newAcceleration;
+    if (store) {
+      store->acceleration[slot] =
+          static_cast<TurtleStore::Real>(newAcceleration);
+    } else {
+      acceleration = newAcceleration;
+    }
   }
 
   bool isPenDown() const { return penDown; }
   void setPenDown(bool isDown) { penDown = isDown; }
 
-  const ::std::string &getColor() const { return color; }
-  void setColor(const ::std::string &newColor) { color = newColor; }
+  const ::std::string &getColor() const { return getColorSymbol().str(); }
+  void setColor(const ::std::string &newColor) {
+    setColorSymbol(similar::microkernel::libs::Symbol(newColor));
+  }
+
+  /** Gets the interned color, compared without reading its string. */
+  similar::microkernel::libs::Symbol getColorSymbol() const {
+    return store ? similar::microkernel::libs::Symbol::fromId(
+                       store->color[slot])
+                 : color;
+  }
+  void setColorSymbol(similar::microkernel::libs::Symbol newColor) {
+    if (store) {
+      store->color[slot] = newColor.getId();
+    } else {
+      color = newColor;
+    }
+  }
 
   // Clone method for deep copying
   std::shared_ptr<TurtlePLSInLogo> clone() const {
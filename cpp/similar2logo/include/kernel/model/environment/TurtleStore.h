@@ -0,0 +1,134 @@
+#ifndef SIMILAR2LOGO_TURTLESTORE_H
+#define SIMILAR2LOGO_TURTLESTORE_H
+
+#include "../../../../../microkernel/include/libs/MemoryAccounting.h"
+#include "../../../../../microkernel/include/libs/SymbolTable.h"
+#include "../../tools/AlignedAllocator.h"
+#include "../../tools/Precision.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace model {
+namespace environment {
+
+class TurtlePLSInLogo;
+
+/**
+ * The public local states of the turtles of an environment, stored field by
+ * field: the state of the turtle of slot i is x[i], y[i], heading[i]...
+ *
+ * A TurtlePLSInLogo attached to a store is a handle onto its slot, so that
+ * the kinematic update of all the turtles is a loop over contiguous arrays.
+ * The slots follow the order in which the turtles were attached, unless
+ * reorder() sorted them; detaching a turtle moves its state back into the
+ * handle.
+ */
+class TurtleStore {
+public:
+  /**
+   * The type of the kinematic state in the store (see tools::Precision); the
+   * handles keep reading and writing doubles.
+   */
+  using Real = tools::Precision::State;
+
+  /** The account of the memory of the kinematic states */
+  struct Memory {
+    static const char *name() { return "agent states"; }
+  };
+
+  /** A field of the kinematic states, aligned on a cache line. */
+  using Column =
+      ::std::vector<Real, similar::microkernel::libs::TrackedAllocator<
+                              Real, Memory, tools::AlignedAllocator<Real>>>;
+
+  Column x;
+  Column y;
+  Column heading;
+  Column speed;
+  Column acceleration;
+  /** The color of each turtle, as the id of its symbol (see colorIndex()) */
+  ::std::vector<::std::uint32_t> color;
+  /**
+   * The identifier of each turtle, numbering the attachments: the
+   * identifiers increase with the slots until a reorder(), and a turtle
+   * attached again gets a new one.
+   */
+  ::std::vector<::std::uint64_t> id;
+
+  TurtleStore() = default;
+  TurtleStore(const TurtleStore &) = delete;
+  TurtleStore &operator=(const TurtleStore &) = delete;
+
+  /** Detaches the turtles still attached. */
+  ~TurtleStore();
+
+  ::std::size_t size() const { return turtles.size(); }
+
+  /**
+   * Appends a detached turtle to the store.
+   * @return The slot of the turtle.
+   */
+  ::std::size_t attach(TurtlePLSInLogo &turtle);
+
+  /**
+   * Detaches the turtle of a slot; the following turtles move down by one
+   * slot.
+   */
+  void detach(::std::size_t slot);
+
+  /**
+   * Detaches, in a single pass, the turtles of the slots whose flag is set.
+   * The remaining turtles keep their order.
+   */
+  void detachIf(const ::std::vector<unsigned char> &leaving);
+
+  /** Detaches all the turtles. */
+  void detachAll();
+
+  /**
+   * Moves the turtles to other slots, the turtle of slot order[i] to slot
+   * i, with their identifiers.
+   * @param order A permutation of the slots.
+   */
+  void reorder(const ::std::vector<::std::size_t> &order);
+
+  /**
+   * Gets the index of a color, the id of its symbol in the global
+   * SymbolTable. This method can be called from any thread.
+   */
+  ::std::uint32_t colorIndex(const ::std::string &name) const {
+    return similar::microkernel::libs::Symbol(name).getId();
+  }
+
+  /** Gets the name of a color index; the reference stays valid. */
+  const ::std::string &colorName(::std::uint32_t index) const {
+    return similar::microkernel::libs::SymbolTable::global().name(index);
+  }
+
+private:
+  // the handle of each slot
+  ::std::vector<TurtlePLSInLogo *> turtles;
+  // the identifier of the next attached turtle
+  ::std::uint64_t nextId = 0;
+
+  void release(::std::size_t slot);
+};
+
+} // namespace environment
+} // namespace model
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_TURTLESTORE_H
@@ -5,11 +5,34 @@
 #include "../../../../../microkernel/include/SimulationTimeStamp.h"
 #include "../../../../../microkernel/include/dynamicstate/ConsistentPublicLocalDynamicState.h"
 #include "../../../../../microkernel/include/influences/IInfluence.h"
+#include "../../../../../microkernel/include/influences/InfluenceBuckets.h"
+#include "../../../../../microkernel/include/influences/InfluenceDispatcher.h"
 #include "../../../../../microkernel/include/influences/InfluencesMap.h"
+#include "../../gpu/LogoComputeBackend.h"
+#include "../../influences/AgentPositionUpdate.h"
+#include "../../influences/ChangeAcceleration.h"
+#include "../../influences/ChangeDirection.h"
+#include "../../influences/ChangePosition.h"
+#include "../../influences/ChangeSpeed.h"
+#include "../../influences/DropMark.h"
+#include "../../influences/EmitPheromone.h"
+#include "../../influences/PheromoneFieldUpdate.h"
+#include "../../influences/RemoveMark.h"
+#include "../../influences/RemoveMarks.h"
+#include "../../influences/Stop.h"
+#include "../../tools/FieldDiffusion.h"
+#include "../../tools/MathUtil.h"
 #include "../environment/LogoEnvPLS.h"
 #include "../environment/Pheromone.h"
+#include "../environment/TurtlePLSInLogo.h"
+#include <algorithm>
+#include <cmath>
 #include <memory>
+#include <optional>
 #include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace fr {
@@ -29,6 +52,11 @@ namespace levels {
  * - Pheromone dynamics (evaporation and diffusion)
  * - Agent position updates in the grid
  * - System influences (add/remove agents)
+ *
+ * With a compute backend (see setComputeBackend()), the emissions of
+ * pheromones, the diffusion and evaporation of the fields and the natural
+ * position update of the turtles run on it instead, the other influences
+ * being applied on the host first.
  */
 class LogoDefaultReactionModel
     : public extendedkernel::levels::ILevelReactionModel {
@@ -36,6 +64,38 @@ public:
   LogoDefaultReactionModel() = default;
   virtual ~LogoDefaultReactionModel() = default;
 
+  /**
+   * Sets the backend running the emissions, the pheromone dynamics and the
+   * position updates, or the host implementations if null.
+   * @throws std::runtime_error If the backend cannot be initialized.
+   */
+  void
+  setComputeBackend(std::shared_ptr<gpu::ILogoComputeBackend> computeBackend) {
+    if (computeBackend && !computeBackend->initialize()) {
+      throw std::runtime_error("The compute backend " +
+                               computeBackend->getDeviceName() +
+                               " cannot be initialized");
+    }
+    backend = std::move(computeBackend);
+  }
+
+  const std::shared_ptr<gpu::ILogoComputeBackend> &getComputeBackend() const {
+    return backend;
+  }
+
+  /**
+   * Sets the integration of the diffusion of the pheromones by the host
+   * implementation (see tools::FieldDiffusion::Scheme): the SPECTRAL scheme
+   * is stable for any diffusion_coef * dt on toroidal grids.
+   */
+  void setDiffusionScheme(tools::FieldDiffusion::Scheme scheme) {
+    diffusionScheme = scheme;
+  }
+
+  tools::FieldDiffusion::Scheme getDiffusionScheme() const {
+    return diffusionScheme;
+  }
+
   /**
    * Makes the regular reaction to influences.
    * Processes Logo-specific influences and natural dynamics.
@@ -59,17 +119,38 @@ public:
       return; // Not a Logo environment
     }
 
-    // Process influences
-    // Note: Full implementation would handle:
-    // - DropMark, RemoveMark, RemoveMarks
-    // - EmitPheromone
-    // - ChangePosition, ChangeDirection, ChangeSpeed, ChangeAcceleration
-    // - Stop
-    // - AgentPositionUpdate
-    // - PheromoneFieldUpdate
+    // Group the influences by type, then apply each batch in turn.
+    buckets.clear();
+    buckets.addAll(regularInfluencesOftransitoryStateDynamics);
+    const double dt = static_cast<double>(
+        transitoryTimeMax.compareToTimeStamp(transitoryTimeMin));
+    if (backend) {
+      offloadedDispatcher().dispatchBatches(buckets, *logoEnv, dt);
+      reactOnBackend(*logoEnv, dt);
+    } else {
+      // The fields diffused ahead replace the consistent ones before the
+      // emissions of the step.
+      const bool updateFields =
+          !buckets.getBucket<influences::PheromoneFieldUpdate>().empty();
+      const bool prepared =
+          updateFields &&
+          installPreparedFields(*logoEnv, transitoryTimeMin, transitoryTimeMax);
+      regularDispatcher().dispatchBatches(buckets, *logoEnv, dt);
+      if (updateFields && !prepared) {
+        reactToPheromoneFieldUpdate(transitoryTimeMin, transitoryTimeMax,
+                                    logoEnv);
+      }
+    }
+    preparedFields.clear();
+    preparedEnvironment = nullptr;
 
-    // For now, this is a placeholder
-    // Influences will be implemented in Phase 2
+    // Influences which are not specific to Logo are left to subclasses.
+    if (!buckets.getUntagged().empty()) {
+      makeNonSpecificRegularReaction(transitoryTimeMin, transitoryTimeMax,
+                                     consistentState, buckets.getUntagged(),
+                                     remainingInfluences);
+    }
+    buckets.clear();
   }
 
   /**
@@ -104,94 +185,525 @@ public:
     // For now, this is a placeholder
   }
 
+  /**
+   * Diffuses and evaporates copies of the pheromone fields of the consistent
+   * state while the agents perceive and decide (see
+   * microkernel::engine::MultiThreadedSimulationEngine::setNaturalOverlap).
+   * The next reaction of the same period to a PheromoneFieldUpdate installs
+   * them in place of the fields before applying the emissions of the step,
+   * whose trails then diffuse from the next step on; without such an
+   * influence, they are dropped. The fields of a compute backend are not
+   * prepared.
+   */
+  void prepareNaturalDynamics(
+      const microkernel::SimulationTimeStamp &transitoryTimeMin,
+      const microkernel::SimulationTimeStamp &transitoryTimeMax,
+      std::shared_ptr<
+          microkernel::dynamicstate::ConsistentPublicLocalDynamicState>
+          consistentState) override {
+    preparedFields.clear();
+    preparedEnvironment = nullptr;
+    auto logoEnv = std::dynamic_pointer_cast<environment::LogoEnvPLS>(
+        consistentState->getPublicLocalStateOfEnvironment());
+    if (backend || !logoEnv) {
+      return;
+    }
+    const environment::LogoEnvPLS &env = *logoEnv;
+    const long dt = transitoryTimeMax.compareToTimeStamp(transitoryTimeMin);
+    tools::FieldDiffusion &fieldDiffusion = diffusionOf(env);
+    for (const auto &[pheromone, field] : env.getPheromoneField()) {
+      if (std::none_of(field->active.begin(), field->active.end(),
+                       [](unsigned char active) { return active != 0; })) {
+        continue;
+      }
+      // The copy is made here, while the agents read the field
+      preparedFields.emplace_back(pheromone, field);
+      preparedFields.back().second.mutate();
+    }
+    for (auto &[pheromone, field] : preparedFields) {
+      fieldDiffusion.add(field.mutate(), tools::FieldDiffusion::Rates{
+                                             pheromone.getDiffusionCoef() * dt,
+                                             true,
+                                             pheromone.getEvaporationCoef() *
+                                                 dt,
+                                             pheromone.getMinValue()});
+    }
+    fieldDiffusion.run();
+    preparedEnvironment = logoEnv.get();
+    preparedTimeMin = transitoryTimeMin;
+    preparedTimeMax = transitoryTimeMax;
+  }
+
 protected:
   /**
-   * Computes the diffusion of pheromones.
+   * Reacts to the influences which are not Logo-specific. Does nothing by
+   * default.
+   */
+  virtual void makeNonSpecificRegularReaction(
+      const microkernel::SimulationTimeStamp & /*transitoryTimeMin*/,
+      const microkernel::SimulationTimeStamp & /*transitoryTimeMax*/,
+      std::shared_ptr<
+          microkernel::dynamicstate::ConsistentPublicLocalDynamicState>
+      /*consistentState*/,
+      const std::vector<std::shared_ptr<microkernel::influences::IInfluence>>
+          & /*influences*/,
+      std::shared_ptr<microkernel::influences::InfluencesMap>
+      /*remainingInfluences*/) {}
+
+  /**
+   * Computes the diffusion, then the evaporation of the pheromones, in a
+   * single sweep of tools::FieldDiffusion, the one updating the fields of
+   * kernel::environment::Environment. A patch gives diffusion_coef * dt
+   * times its value, shared equally between its neighbours in the grid, or
+   * the exchanges are integrated exactly with the SPECTRAL scheme.
    * @param environment The Logo environment
    * @param dt The time step size
    */
-  void pheromoneDiffusion(std::shared_ptr<environment::LogoEnvPLS> environment,
-                          long dt) {
-    auto &pheromoneField = environment->getPheromoneField();
+  void updatePheromoneFields(environment::LogoEnvPLS &environment, long dt) {
+    tools::FieldDiffusion &fieldDiffusion = diffusionOf(environment);
+    for (auto &[pheromone, field] : environment.getPheromoneField()) {
+      // A field without trails is left as it is, and shared with the
+      // clones of the environment if it is.
+      if (std::none_of(field->active.begin(), field->active.end(),
+                       [](unsigned char active) { return active != 0; })) {
+        continue;
+      }
+      // The minimum value applies even to the pheromones which do not
+      // evaporate.
+      fieldDiffusion.add(field.mutate(), tools::FieldDiffusion::Rates{
+                                             pheromone.getDiffusionCoef() * dt,
+                                             true,
+                                             pheromone.getEvaporationCoef() *
+                                                 dt,
+                                             pheromone.getMinValue()});
+    }
+    fieldDiffusion.run();
+  }
 
-    for (auto &[pheromone, field] : pheromoneField) {
-      // Create temporary field for diffusion calculation
-      auto tmpField = field; // Copy
+  /**
+   * Gets the update of the pheromone fields, kept for the size of the grid
+   * of an environment.
+   */
+  tools::FieldDiffusion &diffusionOf(const environment::LogoEnvPLS &env) {
+    const int width = env.getWidth();
+    const int height = env.getHeight();
+    const bool xTorus = env.isXAxisTorus();
+    const bool yTorus = env.isYAxisTorus();
+    if (!diffusion || diffusion->getWidth() != width ||
+        diffusion->getHeight() != height ||
+        diffusion->isXAxisTorus() != xTorus ||
+        diffusion->isYAxisTorus() != yTorus) {
+      diffusion.emplace(width, height, xTorus, yTorus);
+    }
+    diffusion->setScheme(diffusionScheme);
+    return *diffusion;
+  }
 
-      int width = environment->getWidth();
-      int height = environment->getHeight();
+  /**
+   * Replaces the pheromone fields of an environment by the ones diffused
+   * ahead for the same period, if any.
+   * @return false if no field was prepared for the environment and period.
+   */
+  bool installPreparedFields(
+      environment::LogoEnvPLS &env,
+      const microkernel::SimulationTimeStamp &transitoryTimeMin,
+      const microkernel::SimulationTimeStamp &transitoryTimeMax) {
+    if (preparedEnvironment != &env ||
+        !(preparedTimeMin == transitoryTimeMin) ||
+        !(preparedTimeMax == transitoryTimeMax)) {
+      return false;
+    }
+    auto &fields = env.getPheromoneField();
+    for (auto &[pheromone, field] : preparedFields) {
+      auto target = fields.find(pheromone);
+      if (target != fields.end()) {
+        target->second = std::move(field);
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Reacts to pheromone field update influence.
+   * Performs evaporation and diffusion.
+   */
+  void reactToPheromoneFieldUpdate(
+      const microkernel::SimulationTimeStamp &transitoryTimeMin,
+      const microkernel::SimulationTimeStamp &transitoryTimeMax,
+      std::shared_ptr<environment::LogoEnvPLS> environment) {
 
-      for (int x = 0; x < width; x++) {
-        for (int y = 0; y < height; y++) {
-          // Get neighbors
-          auto neighbors = environment->getNeighbors(x, y, 1);
+    long dt = transitoryTimeMax.compareToTimeStamp(transitoryTimeMin);
+    updatePheromoneFields(*environment, dt);
+  }
 
-          // Diffuse to neighbors
-          for (const auto &neighbor : neighbors) {
-            int nx = static_cast<int>(neighbor.x);
-            int ny = static_cast<int>(neighbor.y);
+private:
+  using Dispatcher =
+      microkernel::influences::InfluenceDispatcher<environment::LogoEnvPLS &,
+                                                   double>;
 
-            if (nx != x || ny != y) {
-              // Diffuse to neighbor (8 neighbors)
-              tmpField[nx][ny] +=
-                  pheromone.getDiffusionCoef() * field[x][y] * dt / 8.0;
-            }
-          }
+  /** Reused across steps to avoid reallocating the batches. */
+  microkernel::influences::InfluenceBuckets buckets;
 
-          // Reduce current cell
-          tmpField[x][y] -= field[x][y] * pheromone.getDiffusionCoef() * dt;
+  /** The update of the pheromone fields, kept for the size of the grid. */
+  std::optional<tools::FieldDiffusion> diffusion;
+
+  /**
+   * The fields diffused by prepareNaturalDynamics(), with the environment
+   * and the period they were prepared for.
+   */
+  std::vector<std::pair<environment::Pheromone,
+                        environment::LogoEnvPLS::SharedPheromoneField>>
+      preparedFields;
+  const environment::LogoEnvPLS *preparedEnvironment = nullptr;
+  microkernel::SimulationTimeStamp preparedTimeMin{0};
+  microkernel::SimulationTimeStamp preparedTimeMax{0};
+
+  /** The scheme of the diffusion, set on diffusion before each update. */
+  tools::FieldDiffusion::Scheme diffusionScheme =
+      tools::FieldDiffusion::Scheme::EXPLICIT;
+
+  /** The backend of the reaction, null for the host implementations. */
+  std::shared_ptr<gpu::ILogoComputeBackend> backend;
+
+  /** The buffers exchanged with the backend, reused across steps. */
+  std::vector<std::vector<gpu::FieldDeposit>> deposits;
+  std::vector<gpu::FieldValue> staging;
+  gpu::TurtleArrays turtleArrays;
+  std::vector<std::shared_ptr<environment::TurtlePLSInLogo>> turtleOrder;
+
+  /**
+   * Runs the emissions, the pheromone dynamics and the position update of
+   * the step on the backend, then copies their results back.
+   */
+  void reactOnBackend(environment::LogoEnvPLS &env, double dt) {
+    const auto &emissions = buckets.getBucket<influences::EmitPheromone>();
+    const bool updateFields =
+        !buckets.getBucket<influences::PheromoneFieldUpdate>().empty();
+    if (!emissions.empty() || updateFields) {
+      updateFieldsOnBackend(env, emissions, static_cast<long>(dt),
+                            updateFields);
+    }
+    if (!buckets.getBucket<influences::AgentPositionUpdate>().empty()) {
+      advanceTurtlesOnBackend(env, dt);
+    }
+  }
+
+  void updateFieldsOnBackend(
+      environment::LogoEnvPLS &env,
+      const std::vector<std::shared_ptr<microkernel::influences::IInfluence>>
+          &emissions,
+      long dt, bool updateFields) {
+    auto &fields = env.getPheromoneField();
+    const int width = env.getWidth();
+    const int height = env.getHeight();
+    backend->resizeGrid(width, height, env.isXAxisTorus(), env.isYAxisTorus(),
+                        fields.size());
+    collectDeposits(env, emissions, deposits);
+
+    std::size_t index = 0;
+    for (auto &[pheromone, shared] : fields) {
+      const std::size_t current = index++;
+      // As on the host, a field without trails nor deposits is left as it
+      // is, and shared with the clones of the environment if it is.
+      if (deposits[current].empty() &&
+          std::none_of(shared->active.begin(), shared->active.end(),
+                       [](unsigned char active) { return active != 0; })) {
+        continue;
+      }
+      auto &field = shared.mutate();
+      backend->uploadField(current, field.values.data());
+      backend->emitPheromones(current, deposits[current].data(),
+                              deposits[current].size());
+      if (updateFields) {
+        backend->diffuseAndEvaporate(
+            current, gpu::FieldRates{pheromone.getDiffusionCoef() * dt, true,
+                                     pheromone.getEvaporationCoef() * dt,
+                                     pheromone.getMinValue()});
+      }
+      staging.resize(field.values.size());
+      backend->downloadField(current, staging.data());
+      copyTiles(field);
+    }
+  }
+
+  /**
+   * Copies the staged values of a field tile by tile, only writing the
+   * tiles holding a non-zero value and the ones to clear, so that the pages
+   * of the patches never reached by a trail stay uncommitted.
+   */
+  void copyTiles(environment::LogoEnvPLS::PheromoneField &field) const {
+    constexpr int TILE = environment::LogoEnvPLS::PheromoneField::TILE_SIZE;
+    const int width = field.values.getWidth();
+    const int height = field.values.getHeight();
+    for (int ty = 0; ty < field.tileRows(); ++ty) {
+      const int y0 = ty * TILE;
+      const int y1 = std::min(y0 + TILE, height);
+      for (int tx = 0; tx < field.tileColumns(); ++tx) {
+        const int x0 = tx * TILE;
+        const int x1 = std::min(x0 + TILE, width);
+        bool nonZero = false;
+        for (int y = y0; y < y1 && !nonZero; ++y) {
+          const gpu::FieldValue *row =
+              staging.data() + static_cast<std::size_t>(y) * width;
+          nonZero = std::any_of(row + x0, row + x1, [](gpu::FieldValue v) {
+            return v != 0;
+          });
         }
+        auto &active = field.active[field.tileOf(x0, y0)];
+        if (!nonZero && !active) {
+          continue;
+        }
+        for (int y = y0; y < y1; ++y) {
+          const gpu::FieldValue *row =
+              staging.data() + static_cast<std::size_t>(y) * width;
+          std::copy(row + x0, row + x1, field.values.row(y) + x0);
+        }
+        active = nonZero;
       }
+    }
+    field.releaseQuiescent();
+  }
 
-      // Update field
-      field = tmpField;
+  void advanceTurtlesOnBackend(environment::LogoEnvPLS &env, double dt) {
+    const auto turtles = env.getAllTurtles();
+    turtleOrder.assign(turtles.begin(), turtles.end());
+    turtleArrays.resize(turtleOrder.size());
+    for (std::size_t i = 0; i < turtleOrder.size(); ++i) {
+      const auto &turtle = turtleOrder[i];
+      const auto location = turtle->getLocation();
+      turtleArrays.x[i] = static_cast<gpu::TurtleValue>(location.x);
+      turtleArrays.y[i] = static_cast<gpu::TurtleValue>(location.y);
+      turtleArrays.heading[i] =
+          static_cast<gpu::TurtleValue>(turtle->getHeading());
+      turtleArrays.speed[i] = static_cast<gpu::TurtleValue>(turtle->getSpeed());
+      turtleArrays.acceleration[i] =
+          static_cast<gpu::TurtleValue>(turtle->getAcceleration());
     }
+    backend->resizeGrid(env.getWidth(), env.getHeight(), env.isXAxisTorus(),
+                        env.isYAxisTorus(), env.getPheromoneField().size());
+    backend->uploadTurtles(turtleArrays);
+    backend->advanceTurtles(dt);
+    backend->downloadTurtles(turtleArrays);
+    for (std::size_t i = 0; i < turtleOrder.size(); ++i) {
+      turtleOrder[i]->setSpeed(turtleArrays.speed[i]);
+      moveTurtle(env, turtleOrder[i], turtleArrays.x[i], turtleArrays.y[i]);
+    }
+    turtleOrder.clear();
   }
 
+  /** A deposit of the host, in the precision of the influences. */
+  struct HostDeposit {
+    std::uint32_t cell;
+    double value;
+  };
+
   /**
-   * Computes the evaporation of pheromones.
-   * @param environment The Logo environment
-   * @param dt The time step size
+   * Sorts the deposits of the emissions by field, then by cell and value.
+   * The engines merge the influences of a step in no particular order, so
+   * that the deposits are added in increasing order of value on each cell:
+   * the sums do not depend on the order of the influences, nor on the
+   * number of threads of the engine.
    */
-  void
-  pheromoneEvaporation(std::shared_ptr<environment::LogoEnvPLS> environment,
-                       long dt) {
-    auto &pheromoneField = environment->getPheromoneField();
-
-    for (auto &[pheromone, field] : pheromoneField) {
-      int width = environment->getWidth();
-      int height = environment->getHeight();
-
-      for (int x = 0; x < width; x++) {
-        for (int y = 0; y < height; y++) {
-          // Evaporate
-          field[x][y] -= pheromone.getEvaporationCoef() * field[x][y] * dt;
-
-          // Apply minimum value
-          if (field[x][y] < pheromone.getMinValue()) {
-            field[x][y] = 0.0;
-          }
+  template <typename Deposit>
+  static void collectDeposits(
+      const environment::LogoEnvPLS &env,
+      const std::vector<std::shared_ptr<microkernel::influences::IInfluence>>
+          &emissions,
+      std::vector<std::vector<Deposit>> &deposits) {
+    const auto &fields = env.getPheromoneField();
+    const int width = env.getWidth();
+    const int height = env.getHeight();
+    deposits.resize(fields.size());
+    for (auto &fieldDeposits : deposits) {
+      fieldDeposits.clear();
+    }
+    for (const auto &influence : emissions) {
+      const auto &emission =
+          static_cast<const influences::EmitPheromone &>(*influence);
+      const auto location = env.normalizePoint(emission.getLocation());
+      const int x = static_cast<int>(location.x);
+      const int y = static_cast<int>(location.y);
+      if (x < 0 || x >= width || y < 0 || y >= height) {
+        continue;
+      }
+      std::size_t index = 0;
+      for (const auto &[pheromone, field] : fields) {
+        if (pheromone.getIdentifier() == emission.getPheromoneIdentifier()) {
+          deposits[index].push_back(
+              {static_cast<std::uint32_t>(y) * width + x,
+               static_cast<decltype(Deposit::value)>(emission.getValue())});
         }
+        ++index;
       }
     }
+    for (auto &fieldDeposits : deposits) {
+      std::sort(fieldDeposits.begin(), fieldDeposits.end(),
+                [](const Deposit &a, const Deposit &b) {
+                  return a.cell != b.cell ? a.cell < b.cell : a.value < b.value;
+                });
+    }
   }
 
   /**
-   * Reacts to pheromone field update influence.
-   * Performs evaporation and diffusion.
+   * Moves a turtle to a new location, wrapping it on the toroidal axes and
+   * clamping it on the others, and updates the patch index of the grid.
    */
-  void reactToPheromoneFieldUpdate(
-      const microkernel::SimulationTimeStamp &transitoryTimeMin,
-      const microkernel::SimulationTimeStamp &transitoryTimeMax,
-      std::shared_ptr<environment::LogoEnvPLS> environment) {
+  static void moveTurtle(
+      environment::LogoEnvPLS &env,
+      const std::shared_ptr<environment::TurtlePLSInLogo> &turtle,
+      double newX, double newY) {
+    const auto oldLocation = turtle->getLocation();
+    const int width = env.getWidth();
+    const int height = env.getHeight();
+    newX = env.isXAxisTorus()
+               ? tools::MathUtil::wrap(newX, 0, width)
+               : std::max(0.0, std::min(newX, std::nextafter(width, 0.0)));
+    newY = env.isYAxisTorus()
+               ? tools::MathUtil::wrap(newY, 0, height)
+               : std::max(0.0, std::min(newY, std::nextafter(height, 0.0)));
 
-    long dt = transitoryTimeMax.compareToTimeStamp(transitoryTimeMin);
+    const int oldX = static_cast<int>(oldLocation.x);
+    const int oldY = static_cast<int>(oldLocation.y);
+    const int x = static_cast<int>(newX);
+    const int y = static_cast<int>(newY);
+    turtle->setLocation(tools::Point2D(newX, newY));
+    if (oldX != x || oldY != y) {
+      auto &patches = env.getTurtlesInPatches();
+      if (oldX >= 0 && oldX < width && oldY >= 0 && oldY < height) {
+        patches(oldX, oldY).erase(turtle);
+      }
+      patches(x, y).insert(turtle);
+    }
+  }
 
-    // Perform diffusion
-    pheromoneDiffusion(environment, dt);
+  /**
+   * The handlers of the Logo influences, registered in the order in which the
+   * batches are applied: marks and pheromones, then the turtle kinematics,
+   * and finally the natural position update which reads them.
+   */
+  static const Dispatcher &regularDispatcher() {
+    static const Dispatcher dispatcher = makeDispatcher(false);
+    return dispatcher;
+  }
 
-    // Perform evaporation
-    pheromoneEvaporation(environment, dt);
+  /**
+   * The handlers of the Logo influences left to the host when a backend
+   * runs the emissions and the natural position update.
+   */
+  static const Dispatcher &offloadedDispatcher() {
+    static const Dispatcher dispatcher = makeDispatcher(true);
+    return dispatcher;
+  }
+
+  /**
+   * Registers the handlers, but the ones of the emissions and of the
+   * position update if they are offloaded to a backend.
+   */
+  static Dispatcher makeDispatcher(bool offloaded) {
+    Dispatcher table;
+    table.on<influences::DropMark>(
+        [](influences::DropMark &influence, environment::LogoEnvPLS &env,
+           double) {
+          if (influence.getMark()) {
+            env.addMark(influence.getMark());
+          }
+        });
+    table.on<influences::RemoveMark>(
+        [](influences::RemoveMark &influence, environment::LogoEnvPLS &env,
+           double) {
+          if (influence.getMark()) {
+            env.removeMark(influence.getMark());
+          }
+        });
+    table.on<influences::RemoveMarks>(
+        [](influences::RemoveMarks &influence, environment::LogoEnvPLS &env,
+           double) {
+          for (const auto &mark : influence.getMarks()) {
+            env.removeMark(mark);
+          }
+        });
+    if (!offloaded) {
+      table.onBatch<influences::EmitPheromone>(
+          [](const std::vector<
+                 std::shared_ptr<microkernel::influences::IInfluence>>
+                 &emissions,
+             environment::LogoEnvPLS &env, double) {
+            std::vector<std::vector<HostDeposit>> deposits;
+            collectDeposits(env, emissions, deposits);
+            const std::uint32_t width =
+                static_cast<std::uint32_t>(env.getWidth());
+            std::size_t index = 0;
+            for (auto &[pheromone, field] : env.getPheromoneField()) {
+              const auto &fieldDeposits = deposits[index++];
+              if (fieldDeposits.empty()) {
+                continue;
+              }
+              auto &values = field.mutate();
+              for (const HostDeposit &deposit : fieldDeposits) {
+                values.add(static_cast<int>(deposit.cell % width),
+                           static_cast<int>(deposit.cell / width),
+                           deposit.value);
+              }
+            }
+          });
+    }
+    table.on<influences::ChangeAcceleration>(
+        [](influences::ChangeAcceleration &influence,
+           environment::LogoEnvPLS &, double) {
+          if (auto target = influence.getTarget()) {
+            target->setAcceleration(target->getAcceleration() +
+                                    influence.getDa());
+          }
+        });
+    table.on<influences::ChangeSpeed>(
+        [](influences::ChangeSpeed &influence, environment::LogoEnvPLS &,
+           double) {
+          if (auto target = influence.getTarget()) {
+            target->setSpeed(target->getSpeed() + influence.getDs());
+          }
+        });
+    table.on<influences::Stop>([](influences::Stop &influence,
+                                  environment::LogoEnvPLS &, double) {
+      if (auto target = influence.getTarget()) {
+        target->setSpeed(0);
+        target->setAcceleration(0);
+      }
+    });
+    table.on<influences::ChangeDirection>(
+        [](influences::ChangeDirection &influence,
+           environment::LogoEnvPLS &, double) {
+          if (auto target = influence.getTarget()) {
+            target->setHeading(tools::MathUtil::normalizeAngle(
+                target->getHeading() + influence.getDd()));
+          }
+        });
+    table.on<influences::ChangePosition>(
+        [](influences::ChangePosition &influence,
+           environment::LogoEnvPLS &env, double) {
+          if (auto target = influence.getTarget()) {
+            const auto location = target->getLocation();
+            moveTurtle(env, target, location.x + influence.getDx(),
+                       location.y + influence.getDy());
+          }
+        });
+    if (!offloaded) {
+      table.on<influences::AgentPositionUpdate>(
+          [](influences::AgentPositionUpdate &, environment::LogoEnvPLS &env,
+             double dt) {
+            for (const auto &turtle : env.getAllTurtles()) {
+              turtle->setSpeed(turtle->getSpeed() +
+                               turtle->getAcceleration());
+              const auto location = turtle->getLocation();
+              // A heading of 0 points towards +y, as in getDirection().
+              const double distance = turtle->getSpeed() * dt;
+              const double heading = turtle->getHeading();
+              moveTurtle(env, turtle,
+                         location.x - std::sin(heading) * distance,
+                         location.y + std::cos(heading) * distance);
+            }
+          });
+    }
+    return table;
   }
 };
 
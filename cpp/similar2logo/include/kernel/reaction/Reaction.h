@@ -1,5 +1,6 @@
 #pragma once
 #include "../../microkernel/include/influences/IInfluence.h"
+#include "../../microkernel/include/influences/InfluenceBuckets.h"
 #include "../environment/Environment.h"
 #include <memory>
 #include <vector>
@@ -11,11 +12,40 @@ using IInfluence =
 using Environment = fr::univ_artois::lgi2a::similar::similar2logo::kernel::
     environment::Environment;
 
+/**
+ * Applies the influences of a step to a simple environment. The influences
+ * are grouped by type and applied batch by batch: marks, pheromone emissions,
+ * turtle kinematics, then the natural position and pheromone field updates.
+ *
+ * With the coalescing enabled, the additive ChangeAcceleration, ChangeSpeed
+ * and ChangeDirection of a batch are first summed per turtle, keyed by its
+ * slot in the turtle store, and each sum is applied once. The speed is then
+ * clamped at zero once per turtle rather than after each change.
+ *
+ * A step holds the access lock of the environment (see
+ * Environment::access_mutex()) alone.
+ */
 class Reaction {
 public:
   Reaction() = default;
   void apply(const std::vector<std::shared_ptr<IInfluence>> &influences,
              Environment &env, double dt = 1.0);
+
+  /**
+   * Enables or disables the coalescing of the additive influences targeting
+   * the same turtle, e.g. one ChangeDirection per steering rule. It is off
+   * by default.
+   */
+  void setCoalescing(bool enabled) { coalescing = enabled; }
+
+  /** Tells whether the additive influences are summed per turtle. */
+  bool isCoalescing() const { return coalescing; }
+
+private:
+  /** Reused across steps to avoid reallocating the batches. */
+  fr::univ_artois::lgi2a::similar::microkernel::influences::InfluenceBuckets
+      buckets;
+  bool coalescing = false;
 };
 
 } // namespace fr::univ_artois::lgi2a::similar::similar2logo::kernel::reaction
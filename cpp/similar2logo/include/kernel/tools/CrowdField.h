@@ -0,0 +1,119 @@
+#ifndef SIMILAR2LOGO_CROWDFIELD_H
+#define SIMILAR2LOGO_CROWDFIELD_H
+
+#include "Grid.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace tools {
+
+/**
+ * A crowd of turtles represented by its density and its momentum on the
+ * patches of a grid, instead of one state per turtle, for the dense regions
+ * of a swarm (see environment::Environment::update_crowds()).
+ *
+ * The turtles deposited on a patch add 1 to its density and their velocity
+ * to its momentum, so that the patch moves at their mean velocity.
+ * advect() moves the crowd by a donor-cell scheme: each patch sends the
+ * fraction |vx| dt of its content to its neighbour along x and |vy| dt to
+ * its neighbour along y, in sub-steps short enough for these fractions to
+ * sum to at most 1. The scheme conserves the turtles and their momentum,
+ * keeps the densities positive and carries the velocity of a uniform crowd
+ * unchanged, smearing the fronts over a few patches. Across the borders,
+ * the crowd wraps on toroidal grids and leaves the grid otherwise, as the
+ * turtles do.
+ */
+class CrowdField {
+public:
+  /** A turtle drawn from the field by release(). */
+  struct Member {
+    double x;
+    double y;
+    double heading;
+    double speed;
+  };
+
+  CrowdField() = default;
+  CrowdField(int width, int height, bool toroidal);
+
+  int getWidth() const { return density.getWidth(); }
+  int getHeight() const { return density.getHeight(); }
+
+  /**
+   * Adds a turtle to the patch holding (x, y), moving at (vx, vy) patches
+   * per unit of time. The points outside the grid are ignored.
+   */
+  void deposit(double x, double y, double vx, double vy);
+
+  /** Gets the turtles on the patch (x, y). */
+  double getDensity(int x, int y) const { return density(x, y); }
+
+  /** Gets the mean velocity of the patch (x, y), 0 if it is empty. */
+  void getVelocity(int x, int y, double &vx, double &vy) const;
+
+  /** Gets the densities, laid out as in Grid. */
+  const Grid<double> &getDensities() const { return density; }
+
+  /** Gets the turtles of the whole field. */
+  double getMass() const;
+
+  /**
+   * Gets the turtles of the patches from (x, y) to (x + columns - 1,
+   * y + rows - 1), clipped to the grid.
+   */
+  double getMass(int x, int y, int columns, int rows) const;
+
+  /** Moves the crowd at its velocity during dt. */
+  void advect(double dt);
+
+  /**
+   * Removes the crowd of the patches from (x, y) to (x + columns - 1,
+   * y + rows - 1), clipped to the grid, as turtles: the densities are
+   * summed in row order and a turtle is drawn on a patch each time the
+   * rounded sum grows, so that the block gives its mass rounded to the
+   * nearest integer. A turtle stands at a random point of its patch, moving
+   * at the velocity of the patch.
+   * @param seed The seed of the draws: the turtles only depend on it and
+   * on the field.
+   * @param members The turtles drawn are appended to it.
+   */
+  void release(int x, int y, int columns, int rows, ::std::uint64_t seed,
+               ::std::vector<Member> &members);
+
+  /** Removes the whole crowd. */
+  void clear();
+
+private:
+  bool toroidal = false;
+  Grid<double> density;
+  Grid<double> momentumX;
+  Grid<double> momentumY;
+  // the fields after a sub-step
+  Grid<double> nextDensity;
+  Grid<double> nextMomentumX;
+  Grid<double> nextMomentumY;
+  // false until the first deposit, and after a clear()
+  bool occupied = false;
+
+  void step(double dt);
+  // moves fraction of the content of the cell from to the patch (x, y),
+  // lost outside the grid
+  void transfer(::std::size_t from, int x, int y, double fraction);
+};
+
+} // namespace tools
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_CROWDFIELD_H
@@ -0,0 +1,172 @@
+#ifndef SIMILAR2LOGO_DOMAINDECOMPOSITION_H
+#define SIMILAR2LOGO_DOMAINDECOMPOSITION_H
+
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace tools {
+
+/**
+ * Splits the patches of a grid into columns x rows rectangular domains, one
+ * per rank of a distributed simulation, the domain of the rank
+ * row * columns + column being the column-th of the row-th row.
+ *
+ * A rank also holds a halo of ghost patches around its domain, copies of the
+ * patches of its neighbours: its local grid spans the domain widened by the
+ * halo on the sides where a neighbour lies, across the border of a split
+ * toroidal axis too. An axis which is not split keeps its topology in the
+ * local grids.
+ *
+ * The columns split the x axis into equal parts unless their starts are
+ * given, e.g. by rebalanced() to even out the loads of the domains; the
+ * rows likewise split the y axis.
+ */
+class DomainDecomposition {
+public:
+  /** A rectangle of patches, in the coordinates of the grid. */
+  struct Box {
+    int x;
+    int y;
+    int width;
+    int height;
+
+    bool contains(int px, int py) const {
+      return px >= x && px < x + width && py >= y && py < y + height;
+    }
+  };
+
+  /**
+   * Splits a grid into a number of domains, choosing the columns and rows
+   * minimizing the perimeter of a domain.
+   * @param haloWidth The width of the halo, at least 1.
+   * @throws std::invalid_argument If the grid cannot be split this way.
+   */
+  DomainDecomposition(int width, int height, bool xAxisTorus, bool yAxisTorus,
+                      int domainCount, int haloWidth);
+
+  /**
+   * Splits a grid into columns x rows domains.
+   * @throws std::invalid_argument If a domain would be empty, or if a local
+   * grid would wrap around a split toroidal axis.
+   */
+  DomainDecomposition(int width, int height, bool xAxisTorus, bool yAxisTorus,
+                      int columns, int rows, int haloWidth);
+
+  /**
+   * Splits a grid into domains at given coordinates.
+   * @param columnStarts The first x of each column, then the width.
+   * @param rowStarts The first y of each row, then the height.
+   * @throws std::invalid_argument If the starts do not increase from 0 to
+   * the length of their axis, or if a local grid would wrap around a split
+   * toroidal axis.
+   */
+  DomainDecomposition(int width, int height, bool xAxisTorus, bool yAxisTorus,
+                      std::vector<int> columnStarts, std::vector<int> rowStarts,
+                      int haloWidth);
+
+  /**
+   * Splits the grid into as many columns and rows, each of them bearing as
+   * even a share of the loads as the patches allow.
+   * @param columnLoads The load of each column of patches, width values.
+   * @param rowLoads The load of each row of patches, height values.
+   * @throws std::invalid_argument If the loads are not one per column and
+   * per row.
+   */
+  DomainDecomposition rebalanced(const std::vector<double> &columnLoads,
+                                 const std::vector<double> &rowLoads) const;
+
+  int getWidth() const { return width; }
+  int getHeight() const { return height; }
+  bool isXAxisTorus() const { return xAxisTorus; }
+  bool isYAxisTorus() const { return yAxisTorus; }
+  int getColumns() const { return columns; }
+  int getRows() const { return rows; }
+  int getDomainCount() const { return columns * rows; }
+  int getHaloWidth() const { return haloWidth; }
+  const std::vector<int> &getColumnStarts() const { return columnStarts; }
+  const std::vector<int> &getRowStarts() const { return rowStarts; }
+
+  /** Tells whether two decompositions split the grid the same way. */
+  bool hasSameDomains(const DomainDecomposition &other) const {
+    return columnStarts == other.columnStarts && rowStarts == other.rowStarts;
+  }
+
+  /** Tells whether the domains split the x axis, so that it has halos. */
+  bool isXAxisSplit() const { return columns > 1; }
+  bool isYAxisSplit() const { return rows > 1; }
+
+  /** Tells whether the local grids are toroidal along the x axis. */
+  bool isLocalXAxisTorus() const { return xAxisTorus && columns == 1; }
+  bool isLocalYAxisTorus() const { return yAxisTorus && rows == 1; }
+
+  /** Gets the patches owned by a rank. */
+  Box getDomain(int rank) const;
+
+  /**
+   * Gets the patches held by a rank: its domain and its halo. On a toroidal
+   * axis, the box may extend beyond the grid, its patches being wrapped.
+   */
+  Box getLocalGrid(int rank) const;
+
+  /**
+   * Gets the rank owning a patch, wrapped on the toroidal axes first.
+   * @return The rank, or -1 if the patch lies outside the grid.
+   */
+  int ownerOf(int x, int y) const;
+
+  /** Wraps a coordinate on the x axis if it is toroidal. */
+  int wrapX(int x) const { return xAxisTorus ? wrap(x, width) : x; }
+  int wrapY(int y) const { return yAxisTorus ? wrap(y, height) : y; }
+
+private:
+  int width;
+  int height;
+  bool xAxisTorus;
+  bool yAxisTorus;
+  int columns;
+  int rows;
+  int haloWidth;
+  std::vector<int> columnStarts;
+  std::vector<int> rowStarts;
+
+  static int wrap(int coordinate, int length) {
+    const int wrapped = coordinate % length;
+    return wrapped < 0 ? wrapped + length : wrapped;
+  }
+
+  /** Gets the first coordinate of the index-th of count parts of a length. */
+  static int partStart(int index, int count, int length) {
+    return static_cast<int>(static_cast<long long>(index) * length / count);
+  }
+
+  /** Gets the starts of count equal parts of a length, then the length. */
+  static std::vector<int> equalStarts(int count, int length);
+
+  /**
+   * Gets the starts of as many parts of an axis, each one at most
+   * maxLength patches long, bearing shares of the loads as even as
+   * possible.
+   */
+  static std::vector<int> balancedStarts(const std::vector<double> &loads,
+                                         int count, int maxLength);
+
+  /** Gets the part holding a coordinate. */
+  static int partOf(int coordinate, const std::vector<int> &starts);
+
+  void validate() const;
+};
+
+} // namespace tools
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_DOMAINDECOMPOSITION_H
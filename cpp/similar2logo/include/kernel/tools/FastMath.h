@@ -2,6 +2,7 @@
 #define FASTMATH_H
 
 #include <cmath>
+#include <cstddef>
 #include <iostream>
 #include <vector>
 
@@ -71,6 +72,42 @@ public:
     return sinTable[(int)((radians + M_PI / 2) * RAD_TO_INDEX) & SIN_MASK];
   }
 
+  /**
+   * Computes the sine and the cosine of count angles, within a few units in
+   * the last place of std::sin and std::cos. The loop has no branch, so that
+   * the compiler vectorizes it; the angles beyond SIN_COS_LIMIT radians fall
+   * back to std::sin and std::cos.
+   * @param angles The angles in radians
+   * @param sines Receives the sines
+   * @param cosines Receives the cosines
+   * @param count The number of angles
+   */
+  static void sinCos(const double *angles, double *sines, double *cosines,
+                     std::size_t count);
+
+  /** sinCos() for single precision angles, computed in double precision. */
+  static void sinCos(const float *angles, float *sines, float *cosines,
+                     std::size_t count);
+
+  /** The largest angle, in absolute value, reduced by sinCos() itself. */
+  static constexpr double SIN_COS_LIMIT = 1e6;
+
+  /**
+   * Computes the angles std::atan2(ys[i], xs[i]) of count vectors, within
+   * ATAN2_ERROR radians. The loop has no branch, so that the compiler
+   * vectorizes it. The angle of (0, 0) is 0, and the angles of the vectors
+   * along the negative x axis are pi.
+   * @param ys The ordinates of the vectors
+   * @param xs The abscissas of the vectors
+   * @param angles Receives the angles, in [-pi, pi]
+   * @param count The number of vectors
+   */
+  static void atan2(const double *ys, const double *xs, double *angles,
+                    std::size_t count);
+
+  /** The largest error of atan2(), in radians. */
+  static constexpr double ATAN2_ERROR = 2e-5;
+
   /**
    * Fast square root approximation (inverse sqrt trick variant or just
    * std::sqrt if hardware supported). Modern CPUs have fast sqrt instructions,
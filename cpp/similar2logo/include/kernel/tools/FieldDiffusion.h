@@ -0,0 +1,267 @@
+#ifndef SIMILAR2LOGO_FIELDDIFFUSION_H
+#define SIMILAR2LOGO_FIELDDIFFUSION_H
+
+#include "../../../../microkernel/include/libs/MemoryAccounting.h"
+#include "AlignedAllocator.h"
+#include "Grid.h"
+#include "GridMemory.h"
+#include "Precision.h"
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace tools {
+
+/**
+ * A field of values over the patches of a grid, with a flag per tile of
+ * TILE_SIZE x TILE_SIZE patches telling whether the tile may hold non-zero
+ * values. The flags are conservative: a tile holding zeros only may be
+ * flagged, but a tile holding a non-zero value must be.
+ * @tparam ValueType The type of the values, float or double.
+ */
+template <typename ValueType> struct BasicTiledField {
+  /** The side, in patches, of the tiles whose activity is tracked. */
+  static constexpr int TILE_SIZE = 32;
+
+  using Value = ValueType;
+
+  /** The account of the memory of the pheromone fields */
+  struct Memory {
+    static const char *name() { return "pheromones"; }
+  };
+
+  /**
+   * The values, in GridMemory: the pages of the patches never reached by a
+   * trail are not committed.
+   */
+  using Storage = GridBuffer<Value, Memory>;
+  using Values = Grid<Value, Storage>;
+
+  Values values;
+  ::std::vector<unsigned char> active;
+
+  /** Resizes the field, setting all its patches to a value. */
+  void assign(int width, int height, double value) {
+    values.assign(width, height, static_cast<Value>(value));
+    active.assign(static_cast<::std::size_t>(tileColumns()) * tileRows(),
+                  value != 0);
+  }
+
+  int tileColumns() const {
+    return (values.getWidth() + TILE_SIZE - 1) / TILE_SIZE;
+  }
+  int tileRows() const {
+    return (values.getHeight() + TILE_SIZE - 1) / TILE_SIZE;
+  }
+
+  /** Gets the tile of the patch (x, y), row by row. */
+  ::std::size_t tileOf(int x, int y) const {
+    return static_cast<::std::size_t>(y / TILE_SIZE) * tileColumns() +
+           x / TILE_SIZE;
+  }
+
+  /** Sets the value of the patch (x, y), flagging its tile if needed. */
+  void set(int x, int y, double value) {
+    values(x, y) = static_cast<Value>(value);
+    if (values(x, y) != 0) {
+      active[tileOf(x, y)] = 1;
+    }
+  }
+
+  /** Adds a value to the patch (x, y), flagging its tile if needed. */
+  void add(int x, int y, double value) { set(x, y, values(x, y) + value); }
+
+  /**
+   * Tells that the patches of the tile row ty are read soon, for a field
+   * mapped from a file (see GridMemory) to read them from the disk ahead.
+   */
+  void prefetchTileRow(int ty) const {
+    if (!values.storage().isFileBacked() || ty < 0 || ty >= tileRows()) {
+      return;
+    }
+    const ::std::size_t width = static_cast<::std::size_t>(values.getWidth());
+    const int begin = ty * TILE_SIZE;
+    const int end = ::std::min(begin + TILE_SIZE, values.getHeight());
+    values.storage().prefetch(begin * width, (end - begin) * width);
+  }
+
+  /**
+   * Gives back the memory of the bands of tile rows whose tiles are all
+   * inactive, and so hold zeros only: their pages are committed again by
+   * the next trail crossing them.
+   */
+  void releaseQuiescent() {
+    if (!values.storage().isLazy()) {
+      return;
+    }
+    const int columns = tileColumns();
+    const int rows = tileRows();
+    const ::std::size_t width = static_cast<::std::size_t>(values.getWidth());
+    int first = -1;
+    for (int ty = 0; ty <= rows; ++ty) {
+      bool quiescent = ty < rows;
+      for (int tx = 0; quiescent && tx < columns; ++tx) {
+        quiescent = !active[static_cast<::std::size_t>(ty) * columns + tx];
+      }
+      if (quiescent && first < 0) {
+        first = ty;
+      } else if (!quiescent && first >= 0) {
+        // the run [first, ty) of quiescent bands, released at once
+        const int begin = first * TILE_SIZE;
+        const int end = ::std::min(ty * TILE_SIZE, values.getHeight());
+        values.storage().release(begin * width, (end - begin) * width);
+        first = -1;
+      }
+    }
+  }
+};
+
+/** The fields of the precision of the build (see Precision). */
+using TiledField = BasicTiledField<Precision::Pheromone>;
+
+/**
+ * Diffuses and evaporates the fields of a grid, the fields of all the
+ * environments being updated by this one implementation.
+ *
+ * In a step, a patch with a positive value gives diffusion * value, shared
+ * equally between its neighbours in the grid: 1/8 to each of the 8
+ * neighbours inside the grid and along the toroidal axes, 1/5 along a
+ * border and 1/3 in a corner. The value then evaporates, and is set to 0
+ * once below the minimum value.
+ *
+ * Only the active tiles of a field and their neighbours are updated, and a
+ * tile is retired once it holds zeros only, so that the cost of a step
+ * follows the area of the trails rather than the area of the grid. The
+ * interior of the rows is computed with vector instructions when the target
+ * has them (AVX2, NEON), and the bands of tile rows are processed in
+ * parallel on the pool lent by the engine (see RowBands). The fields mapped
+ * from files (see GridMemory) are streamed in the order of the sweep, each
+ * band prefetching the tile row that follows the one it updates.
+ *
+ * This explicit step loses its stability once diffusion * dt exceeds 4/3,
+ * the values then oscillating and growing without bound. On a grid wrapping
+ * along both axes, the SPECTRAL scheme (see setScheme()) integrates the same
+ * exchanges exactly instead: the field is transformed to Fourier space,
+ * where the 8-neighbour stencil is diagonal, each frequency decays by the
+ * exponential of its eigenvalue times diffusion, and the field is
+ * transformed back. The step is stable and keeps the values positive for
+ * any dt, and the evaporation being integrated exactly too, a step of n dt
+ * gives the field of n steps of dt, so that a simulation can take large
+ * steps or advance its fields several steps at once. It costs
+ * O(N log N) over the whole grid rather than over the active tiles, the
+ * trails spreading to every patch.
+ * @tparam Value The type of the values of the fields, in which the update
+ * is computed: a float field is updated with twice as many values per
+ * vector instruction. Instantiated for float and double.
+ */
+template <typename Value> class BasicFieldDiffusion {
+public:
+  using Field = BasicTiledField<Value>;
+
+  /** The rates of one step, the coefficients being multiplied by dt. */
+  struct Rates {
+    double diffusion;
+    bool evaporate;
+    double evaporation;
+    double minValue;
+  };
+
+  /** The integration of the diffusion. */
+  enum class Scheme {
+    /** A step of the stencil, stable while diffusion * dt <= 4/3. */
+    EXPLICIT,
+    /**
+     * The exact integration in Fourier space, stable for any dt, on grids
+     * wrapping along both axes; the other grids use the explicit scheme.
+     */
+    SPECTRAL
+  };
+
+  BasicFieldDiffusion(int width, int height, bool xTorus, bool yTorus);
+
+  int getWidth() const { return width; }
+  int getHeight() const { return height; }
+  bool isXAxisTorus() const { return xTorus; }
+  bool isYAxisTorus() const { return yTorus; }
+
+  Scheme getScheme() const { return scheme; }
+
+  /** Sets the scheme of the fields added from now on (EXPLICIT by default). */
+  void setScheme(Scheme value) { scheme = value; }
+
+  /**
+   * Queues the update of a field by the next run().
+   * @param written If not null, the flags of the tiles that the update may
+   * write are set in it.
+   */
+  void add(Field &field, const Rates &rates,
+           ::std::vector<unsigned char> *written = nullptr);
+
+  /** Updates the queued fields in a single sweep, then empties the queue. */
+  void run();
+
+private:
+  // A field queued for the next run().
+  struct Layer {
+    Field *field;
+    Rates rates;
+    // the index of its next field in nextFields, or NO_NEXT for a field
+    // evaporating in place
+    ::std::size_t next;
+  };
+  static constexpr ::std::size_t NO_NEXT = ~::std::size_t(0);
+  // The transforms of the rows and the columns and the symbols of the
+  // stencil, built by the first spectral update.
+  struct SpectralPlan;
+
+  int width;
+  int height;
+  bool xTorus;
+  bool yTorus;
+  Scheme scheme = Scheme::EXPLICIT;
+  ::std::shared_ptr<const SpectralPlan> spectralPlan;
+  int tileColumns;
+  int tileRows;
+  ::std::vector<Layer> layers;
+  // the next fields of the diffusing fields, swapped with them, and their
+  // tiles to compute
+  ::std::vector<Field> nextFields;
+  ::std::vector<::std::vector<unsigned char>> updateTiles;
+
+  // Flags the tiles that are active or next to an active one: the only ones
+  // that may hold non-zero values after a diffusion step.
+  // The methods of a Topology are specialized on the wrapping of the axes
+  // (see withTopology()), chosen once per add() or run().
+  template <typename Topology>
+  void dilate(const ::std::vector<unsigned char> &active,
+              ::std::vector<unsigned char> &update) const;
+  template <typename Topology>
+  void diffuseTileRow(const Layer &layer, int ty, Value *shares);
+  void evaporateTileRow(const Layer &layer, int ty) const;
+  // Updates a grid narrower or shorter than 3 patches, where a patch may be
+  // its own neighbour or count a neighbour twice.
+  template <typename Topology>
+  void updateSmallGrid(Field &field, const Rates &rates) const;
+  // Updates a field with the spectral scheme, the grid wrapping along both
+  // axes.
+  void updateSpectral(Field &field, const Rates &rates);
+};
+
+/** The update of the fields of the precision of the build. */
+using FieldDiffusion = BasicFieldDiffusion<Precision::Pheromone>;
+
+} // namespace tools
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_FIELDDIFFUSION_H
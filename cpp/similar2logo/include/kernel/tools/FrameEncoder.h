@@ -0,0 +1,152 @@
+#ifndef SIMILAR2LOGO_FRAMEENCODER_H
+#define SIMILAR2LOGO_FRAMEENCODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace tools {
+
+/**
+ * Encodes the state shown by the web view into compact binary frames, to be
+ * streamed over a WebSocket instead of JSON snapshots.
+ *
+ * A frame is little-endian, its sections starting on 4 bytes, so that a
+ * browser reads the turtle columns as typed arrays without copying them:
+ * - a header of HEADER_SIZE bytes: the magic "S2LF" (uint32 MAGIC), the
+ *   version (uint8), the flags (uint8, PALETTE and KEYFRAME), the number of
+ *   pheromones (uint16), the low 32 bits of the step (uint32), the number
+ *   n of turtles (uint32), and the width and the height of the space
+ *   (float32);
+ * - with the PALETTE flag, the colors: their number (uint16), then for each
+ *   one its length (uint8) and its name, in the order of their indices;
+ * - the turtles: x and y quantized over the width and the height (uint16
+ *   [n] each, 0 to 65535), the headings quantized over a turn (uint8[n],
+ *   256 steps from 0) and the palette indices of the colors (uint8[n]);
+ * - for each pheromone, with the KEYFRAME flag only, the length of its
+ *   identifier (uint8), the identifier, then its columns and rows (uint16
+ *   each), the value shown as 255 (float32) and the side of its tiles
+ *   (uint16, then 2 bytes of padding); always, the number of tiles that
+ *   follow (uint32) and, for each one, its index (uint32, row-major over
+ *   the tiles) and its tileSize * tileSize values quantized from 0 to 255,
+ *   row by row, the cells past the grid being 0.
+ *
+ * A keyframe, sent first and after requestKeyframe(), holds the tiles
+ * holding a value; the other frames only hold the tiles that changed since
+ * the previous frame, and the palette only when it gained colors. An
+ * encoder thus serves a single client.
+ */
+class FrameEncoder {
+public:
+  static constexpr ::std::uint32_t MAGIC = 0x464c3253; // "S2LF"
+  static constexpr ::std::uint8_t VERSION = 1;
+  static constexpr ::std::size_t HEADER_SIZE = 24;
+  /** The flag of a frame holding the palette. */
+  static constexpr ::std::uint8_t PALETTE = 1;
+  /** The flag of a frame replacing all the pheromone tiles. */
+  static constexpr ::std::uint8_t KEYFRAME = 2;
+
+  /**
+   * @param tileSize The side of the pheromone tiles, in cells.
+   * @throws std::invalid_argument If a dimension is not positive or the
+   * tiles are wider than 255 cells.
+   */
+  FrameEncoder(double width, double height, int tileSize = 16);
+
+  double getWidth() const { return width; }
+  double getHeight() const { return height; }
+  int getTileSize() const { return tileSize; }
+
+  /**
+   * Gets the palette index of a color, adding it on its first use.
+   * @throws std::length_error Past 256 colors.
+   */
+  ::std::uint8_t colorIndex(const ::std::string &color);
+
+  /** Gets the colors, in the order of their indices. */
+  const ::std::vector<::std::string> &getPalette() const { return palette; }
+
+  /**
+   * Adds a pheromone grid to the frames, which requests a keyframe.
+   * @param maxValue The value quantized to 255, the larger ones too.
+   * @return The index of the pheromone in the values passed to encode().
+   * @throws std::invalid_argument If a dimension of the grid is not
+   * between 1 and 65535 or maxValue is not positive.
+   */
+  ::std::size_t addPheromone(const ::std::string &identifier, int columns,
+                             int rows, double maxValue);
+
+  ::std::size_t getPheromoneCount() const { return pheromones.size(); }
+
+  const ::std::string &getPheromoneIdentifier(::std::size_t index) const {
+    return pheromones[index].identifier;
+  }
+  int getPheromoneColumns(::std::size_t index) const {
+    return pheromones[index].columns;
+  }
+  int getPheromoneRows(::std::size_t index) const {
+    return pheromones[index].rows;
+  }
+
+  /** Makes the next frame a keyframe, as for a new client. */
+  void requestKeyframe() { keyframe = true; }
+
+  /**
+   * Encodes a frame.
+   * @param colors The palette indices of the colors of the turtles.
+   * @param pheromoneValues For each pheromone, its values row by row (the
+   * value of the cell (x, y) at y * columns + x), or null without
+   * pheromones.
+   * @return The frame, valid until the next call.
+   * @throws std::overflow_error Past 2^32 - 1 turtles.
+   */
+  const ::std::vector<::std::uint8_t> &
+  encode(::std::uint64_t step, const double *x, const double *y,
+         const double *heading, const ::std::uint8_t *colors,
+         ::std::size_t count, const double *const *pheromoneValues);
+
+private:
+  struct Grid {
+    ::std::string identifier;
+    int columns;
+    int rows;
+    double maxValue;
+    // the quantized values sent last, row by row
+    ::std::vector<::std::uint8_t> sent;
+  };
+
+  double width;
+  double height;
+  int tileSize;
+  ::std::vector<::std::string> palette;
+  ::std::unordered_map<::std::string, ::std::uint8_t> paletteIndices;
+  ::std::size_t sentPaletteSize = 0;
+  ::std::vector<Grid> pheromones;
+  bool keyframe = true;
+  ::std::vector<::std::uint8_t> frame;
+  // the quantized values of the grid being encoded
+  ::std::vector<::std::uint8_t> quantized;
+
+  template <typename T> void put(T value);
+  void putBytes(const void *data, ::std::size_t size);
+  void align();
+  void encodeGrid(Grid &grid, const double *values, bool full);
+};
+
+} // namespace tools
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_FRAMEENCODER_H
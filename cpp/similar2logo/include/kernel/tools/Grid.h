@@ -0,0 +1,97 @@
+#ifndef SIMILAR2LOGO_GRID_H
+#define SIMILAR2LOGO_GRID_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace tools {
+
+/**
+ * The values of the patches of a grid, stored row by row: the patch (x, y)
+ * is the cell y * width + x, so that a row is contiguous.
+ *
+ * All the grids of the environments use this layout, so that the values of
+ * a patch are found at the same cell whatever the environment.
+ * @tparam Storage The contiguous container holding the cells, for instance
+ * an AlignedVector for the fields processed with vector instructions.
+ */
+template <typename T, typename Storage = ::std::vector<T>> class Grid {
+public:
+  Grid() = default;
+
+  Grid(int width, int height, const T &value = T()) {
+    assign(width, height, value);
+  }
+
+  int getWidth() const { return width; }
+  int getHeight() const { return height; }
+
+  /** Gets the number of cells, width * height. */
+  ::std::size_t size() const { return cells.size(); }
+
+  /** Gets the cell of the patch (x, y). */
+  ::std::size_t index(int x, int y) const {
+    return static_cast<::std::size_t>(y) * width + x;
+  }
+
+  bool contains(int x, int y) const {
+    return x >= 0 && x < width && y >= 0 && y < height;
+  }
+
+  T &operator()(int x, int y) { return cells[index(x, y)]; }
+  const T &operator()(int x, int y) const { return cells[index(x, y)]; }
+
+  T &operator[](::std::size_t cell) { return cells[cell]; }
+  const T &operator[](::std::size_t cell) const { return cells[cell]; }
+
+  T *data() { return cells.data(); }
+  const T *data() const { return cells.data(); }
+
+  /** Gets the first cell of the row y. */
+  T *row(int y) { return cells.data() + index(0, y); }
+  const T *row(int y) const { return cells.data() + index(0, y); }
+
+  auto begin() { return cells.begin(); }
+  auto end() { return cells.end(); }
+  auto begin() const { return cells.begin(); }
+  auto end() const { return cells.end(); }
+
+  /** Resizes the grid, setting all its cells to a value. */
+  void assign(int newWidth, int newHeight, const T &value = T()) {
+    width = newWidth;
+    height = newHeight;
+    cells.assign(static_cast<::std::size_t>(width) * height, value);
+  }
+
+  void swap(Grid &other) {
+    ::std::swap(width, other.width);
+    ::std::swap(height, other.height);
+    cells.swap(other.cells);
+  }
+
+  /** Gets the container of the cells. */
+  Storage &storage() { return cells; }
+  const Storage &storage() const { return cells; }
+
+private:
+  int width = 0;
+  int height = 0;
+  Storage cells;
+};
+
+} // namespace tools
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_GRID_H
@@ -0,0 +1,286 @@
+#ifndef SIMILAR2LOGO_GRIDMEMORY_H
+#define SIMILAR2LOGO_GRIDMEMORY_H
+
+#include "../../../../microkernel/include/libs/MemoryAccounting.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace tools {
+
+/**
+ * The memory of the large grids: the buffers of LAZY_BYTES or more are
+ * mapped from the system rather than allocated from the heap, so that their
+ * pages are committed by their first write only and a sparse world keeps
+ * most of its grids on the zero page. The buffers of a huge page or more
+ * are aligned on huge pages and advised to use transparent huge pages, for
+ * the dense sweeps of the stencils to miss the TLB less.
+ *
+ * The smaller buffers, and all of them where the system does not map
+ * memory, come from the heap, aligned on a cache line.
+ *
+ * With a backing directory (see setBackingDirectory), the mapped buffers
+ * are the pages of sparse files of that directory rather than anonymous
+ * memory: the system writes their cold pages back to the files instead of
+ * keeping them in memory or in the swap, so that grids larger than the
+ * memory fit on the disk, the pages in use staying cached. prefetch() and
+ * evict() tell the system which ranges are used next or no longer.
+ */
+class GridMemory {
+public:
+  /** The size from which the buffers are mapped. */
+  static constexpr std::size_t LAZY_BYTES = std::size_t(1) << 20;
+  /** The size of the transparent huge pages. */
+  static constexpr std::size_t HUGE_PAGE_BYTES = std::size_t(2) << 20;
+
+  /** A buffer of grid memory. */
+  struct Block {
+    void *data = nullptr;
+    std::size_t bytes = 0;
+    // whether the buffer was mapped, and so reads zeros until written
+    bool mapped = false;
+    // whether the mapping is the one of a file of the backing directory
+    bool fileBacked = false;
+  };
+
+  /**
+   * Allocates a buffer.
+   * @throws std::bad_alloc If the memory cannot be reserved.
+   */
+  static Block allocate(std::size_t bytes);
+
+  static void deallocate(const Block &block) noexcept;
+
+  /**
+   * Gives the pages lying in a range of a buffer back to the system, the
+   * range holding zeros only: the pages read zeros again until written.
+   * Does nothing for the buffers of the heap.
+   */
+  static void release(const Block &block, std::size_t offset,
+                      std::size_t bytes) noexcept;
+
+  /**
+   * Tells the system that a range of a buffer is read soon, for it to read
+   * the pages of a file-backed buffer from the disk ahead. Does nothing for
+   * the buffers of the heap.
+   */
+  static void prefetch(const Block &block, std::size_t offset,
+                       std::size_t bytes) noexcept;
+
+  /**
+   * Writes the pages lying in a range of a file-backed buffer back to its
+   * file and lets the system drop them from the memory; they are read again
+   * on their next access. Does nothing for the other buffers, whose pages
+   * have nowhere else to go.
+   */
+  static void evict(const Block &block, std::size_t offset,
+                    std::size_t bytes) noexcept;
+
+  /**
+   * Gets the number of bytes of a buffer in memory, with the granularity of
+   * the pages; 0 where the system does not tell.
+   */
+  static std::size_t residentBytes(const Block &block);
+
+  /** Gets the size of the pages of the system. */
+  static std::size_t pageBytes();
+
+  /** Whether the buffers are advised to use huge pages (true by default). */
+  static void setHugePages(bool enabled);
+  static bool isHugePages();
+
+  /**
+   * Sets the directory of the files backing the buffers allocated from now
+   * on, or maps anonymous memory again with an empty path. The files are
+   * removed from the directory as soon as they are created, and so vanish
+   * with their buffers, or the process. File-backed buffers are not advised
+   * to use huge pages.
+   */
+  static void setBackingDirectory(const std::string &directory);
+  static std::string getBackingDirectory();
+};
+
+/**
+ * A contiguous buffer of values of a trivial type in GridMemory, the
+ * storage of the grids whose values are mostly zeros, e.g. the pheromone
+ * fields. Filling the buffer with zeros commits no page, and release()
+ * gives back the memory of a range that went back to zeros.
+ *
+ * The copies copy the pages holding non-zero values only.
+ * @tparam Tag A type whose static name() names the account of the memory
+ * (see libs::MemoryAccounting).
+ */
+template <typename T, typename Tag> class GridBuffer {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "The grid buffers hold trivial values");
+
+public:
+  using value_type = T;
+
+  GridBuffer() = default;
+
+  GridBuffer(const GridBuffer &other) { copyFrom(other); }
+
+  GridBuffer(GridBuffer &&other) noexcept
+      : block(std::exchange(other.block, GridMemory::Block())),
+        count(std::exchange(other.count, 0)) {}
+
+  GridBuffer &operator=(const GridBuffer &other) {
+    if (this != &other) {
+      GridBuffer copy(other);
+      swap(copy);
+    }
+    return *this;
+  }
+
+  GridBuffer &operator=(GridBuffer &&other) noexcept {
+    GridBuffer moved(std::move(other));
+    swap(moved);
+    return *this;
+  }
+
+  ~GridBuffer() { free(); }
+
+  std::size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+  T *data() { return static_cast<T *>(block.data); }
+  const T *data() const { return static_cast<const T *>(block.data); }
+
+  T &operator[](std::size_t i) { return data()[i]; }
+  const T &operator[](std::size_t i) const { return data()[i]; }
+
+  T *begin() { return data(); }
+  T *end() { return data() + count; }
+  const T *begin() const { return data(); }
+  const T *end() const { return data() + count; }
+
+  /** Whether the buffer reads zeros from its pages never written. */
+  bool isLazy() const { return block.mapped; }
+
+  /** Resizes the buffer, setting all its values to a value. */
+  void assign(std::size_t newCount, const T &value) {
+    bool zeroed = false;
+    if (newCount != count) {
+      free();
+      if (newCount > 0) {
+        block = GridMemory::allocate(newCount * sizeof(T));
+        Account::account().allocated(block.bytes);
+        count = newCount;
+        zeroed = block.mapped;
+      }
+    }
+    if (isZero(value) && block.mapped) {
+      if (!zeroed) {
+        // The whole pages read zeros once released, the last one is cleared
+        const std::size_t bytes = count * sizeof(T);
+        const std::size_t tail = bytes % GridMemory::pageBytes();
+        std::memset(static_cast<unsigned char *>(block.data) + bytes - tail, 0,
+                    tail);
+        GridMemory::release(block, 0, bytes - tail);
+      }
+      return;
+    }
+    std::fill(begin(), end(), value);
+  }
+
+  /**
+   * Gives back the pages of the values [first, first + n), which all are
+   * zeros.
+   */
+  void release(std::size_t first, std::size_t n) noexcept {
+    GridMemory::release(block, first * sizeof(T), n * sizeof(T));
+  }
+
+  /** Whether the buffer is mapped from a file (see GridMemory). */
+  bool isFileBacked() const { return block.fileBacked; }
+
+  /** Tells that the values [first, first + n) are read soon. */
+  void prefetch(std::size_t first, std::size_t n) const noexcept {
+    GridMemory::prefetch(block, first * sizeof(T), n * sizeof(T));
+  }
+
+  /**
+   * Writes the values [first, first + n) back to the file of the buffer,
+   * and lets the system drop their pages.
+   */
+  void evict(std::size_t first, std::size_t n) const noexcept {
+    GridMemory::evict(block, first * sizeof(T), n * sizeof(T));
+  }
+
+  /** Gets the bytes of the buffer in memory (see GridMemory). */
+  std::size_t residentBytes() const { return GridMemory::residentBytes(block); }
+
+  void swap(GridBuffer &other) noexcept {
+    std::swap(block, other.block);
+    std::swap(count, other.count);
+  }
+
+private:
+  using Account = similar::microkernel::libs::TrackedAllocator<T, Tag>;
+
+  GridMemory::Block block;
+  std::size_t count = 0;
+
+  static bool isZero(const T &value) {
+    static const T zero{};
+    return std::memcmp(&value, &zero, sizeof(T)) == 0;
+  }
+
+  void free() noexcept {
+    if (block.data != nullptr) {
+      Account::account().released(block.bytes);
+      GridMemory::deallocate(block);
+    }
+    block = GridMemory::Block();
+    count = 0;
+  }
+
+  void copyFrom(const GridBuffer &other) {
+    if (other.count == 0) {
+      return;
+    }
+    block = GridMemory::allocate(other.count * sizeof(T));
+    Account::account().allocated(block.bytes);
+    count = other.count;
+    const std::size_t bytes = count * sizeof(T);
+    if (!block.mapped) {
+      std::memcpy(block.data, other.block.data, bytes);
+      return;
+    }
+    // The chunks of zeros are left on the zero page
+    constexpr std::size_t CHUNK = 4096;
+    const auto *from = static_cast<const unsigned char *>(other.block.data);
+    auto *to = static_cast<unsigned char *>(block.data);
+    for (std::size_t offset = 0; offset < bytes; offset += CHUNK) {
+      const std::size_t length = std::min(CHUNK, bytes - offset);
+      if (!isZeroChunk(from + offset, length)) {
+        std::memcpy(to + offset, from + offset, length);
+      }
+    }
+  }
+
+  static bool isZeroChunk(const unsigned char *bytes, std::size_t length) {
+    static const unsigned char zeros[4096] = {};
+    return std::memcmp(bytes, zeros, length) == 0;
+  }
+};
+
+} // namespace tools
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_GRIDMEMORY_H
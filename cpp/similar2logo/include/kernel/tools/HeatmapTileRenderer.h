@@ -0,0 +1,157 @@
+#ifndef SIMILAR2LOGO_HEATMAPTILERENDERER_H
+#define SIMILAR2LOGO_HEATMAPTILERENDERER_H
+
+#include "../../../../extendedkernel/include/libs/web/view/ITileSource.h"
+#include "../../../../extendedkernel/include/libs/web/view/PngEncoder.h"
+#include "FieldDiffusion.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace tools {
+
+/**
+ * Renders pheromone grids as heatmaps, served to the web view as PNG tiles:
+ * a pyramid of tiles per pheromone, the finest zoom showing a cell per
+ * pixel and each coarser one the maximum of 2 x 2 cells.
+ *
+ * An update compares the grid with the values it rendered last, only over
+ * the tiles of a TiledField that are or were active, and marks the tiles
+ * showing a changed cell, at every zoom. A marked tile gets a new version
+ * and is re-encoded on its next request only, so that a tile nobody looks
+ * at costs nothing and the unchanged tiles are neither encoded nor sent
+ * again (see ITileSource).
+ *
+ * The updates and the requests of the tiles may come from different
+ * threads.
+ */
+class HeatmapTileRenderer
+    : public similar::extendedkernel::libs::web::view::ITileSource {
+public:
+  static constexpr int DEFAULT_TILE_SIZE = 256;
+
+  /**
+   * @param tileSize The side of the tiles, in pixels.
+   * @throws std::invalid_argument If the side is not even and at least 2.
+   */
+  explicit HeatmapTileRenderer(int tileSize = DEFAULT_TILE_SIZE);
+
+  int getTileSize() const { return tileSize; }
+
+  /**
+   * The default colormap: a transparent color for 0, then 255 colors from
+   * dark purple to light yellow, more and more opaque.
+   * @return The RGBA colors, 4 bytes each.
+   */
+  static std::vector<std::uint8_t> defaultColormap();
+
+  /**
+   * Adds a layer, whose cells are all 0.
+   * @param maxValue The value shown with the last color, the larger ones
+   * too.
+   * @param colormap The RGBA colors of the values, from 0 to maxValue.
+   * @throws std::invalid_argument If the layer exists, a dimension or
+   * maxValue is not positive, or the colormap is invalid (see PngEncoder).
+   */
+  void addLayer(const std::string &name, int columns, int rows,
+                double maxValue,
+                std::vector<std::uint8_t> colormap = defaultColormap());
+
+  bool hasLayer(const std::string &name) const;
+
+  /** Gets the names of the layers, in the order of their addition. */
+  std::vector<std::string> getLayerNames() const;
+
+  /**
+   * Gets the finest zoom of a layer, at which a pixel shows a cell.
+   * @throws std::invalid_argument If the layer does not exist.
+   */
+  int getMaxZoom(const std::string &name) const;
+
+  /**
+   * Renders the values of a field, comparing only its tiles that are active
+   * or were at the previous update.
+   * @return The number of tiles marked at the finest zoom.
+   * @throws std::invalid_argument If the layer does not exist or the field
+   * does not have its dimensions.
+   */
+  std::size_t update(const std::string &name, const TiledField &field);
+
+  /**
+   * Renders values, all of them being compared.
+   * @param values The values of the cells, row by row.
+   * @return The number of tiles marked at the finest zoom.
+   * @throws std::invalid_argument If the layer does not exist.
+   */
+  std::size_t update(const std::string &name, const double *values);
+
+  /** Gets the number of tiles encoded so far. */
+  std::size_t getEncodedTileCount() const;
+
+  std::string describeLayers() const override;
+  Tile getTile(const std::string &layer, int zoom, int x, int y) override;
+
+private:
+  struct TileState {
+    std::shared_ptr<const std::string> data;
+    std::uint64_t version = 1;
+    bool stale = true;
+  };
+
+  // a zoom of the pyramid: the colormap indices of its cells, row by row,
+  // and its tiles
+  struct Level {
+    int columns;
+    int rows;
+    int tileColumns;
+    int tileRows;
+    std::vector<std::uint8_t> cells;
+    std::vector<TileState> tiles;
+    // the tiles marked by the running update
+    std::vector<unsigned char> changed;
+  };
+
+  struct Layer {
+    std::string name;
+    double maxValue;
+    similar::extendedkernel::libs::web::view::PngEncoder encoder;
+    // from the coarsest zoom to the finest
+    std::vector<Level> levels;
+    // the active flags of the field of the previous update
+    std::vector<unsigned char> wasActive;
+  };
+
+  int tileSize;
+  mutable std::mutex mutex;
+  std::vector<Layer> layers;
+  std::size_t encodedTiles = 0;
+  // the pixels of the tile being encoded
+  std::vector<std::uint8_t> pixels;
+
+  Layer &findLayer(const std::string &name);
+  const Layer &findLayer(const std::string &name) const;
+  // sets a cell of a zoom, marking its tile if it changed
+  void setCell(Level &level, int x, int y, std::uint8_t index);
+  // recomputes the coarser zooms under the marked tiles
+  std::size_t propagate(Layer &layer);
+  std::uint8_t colorIndex(const Layer &layer, double value) const;
+};
+
+} // namespace tools
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_HEATMAPTILERENDERER_H
@@ -1,8 +1,12 @@
 #ifndef SIMILAR2LOGO_MATHUTIL_H
 #define SIMILAR2LOGO_MATHUTIL_H
 
+#include "FastMath.h"
 #include "Point2D.h"
+#include "Topology.h"
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -156,7 +160,9 @@ public:
   }
 
   /**
-   * Computes the toroidal distance between two points on a grid.
+   * Computes the toroidal distance between two points on a grid. The loops
+   * over many points rather select their Topology once and call its
+   * distance().
    * @param p1 First point
    * @param p2 Second point
    * @param width Grid width
@@ -170,17 +176,9 @@ public:
                                      similar2logo::kernel::tools::Point2D &p2,
                                  double width, double height, bool xTorus,
                                  bool yTorus) {
-    double dx = std::abs(p1.x - p2.x);
-    double dy = std::abs(p1.y - p2.y);
-
-    if (xTorus) {
-      dx = std::min(dx, width - dx);
-    }
-    if (yTorus) {
-      dy = std::min(dy, height - dy);
-    }
-
-    return std::sqrt(dx * dx + dy * dy);
+    return withTopology(xTorus, yTorus, [&](auto topology) {
+      return decltype(topology)::distance(p1, p2, width, height);
+    });
   }
 
   /**
@@ -192,24 +190,70 @@ public:
                        const ::fr::univ_artois::lgi2a::similar::similar2logo::
                            kernel::tools::Point2D &p2,
                        double width, double height, bool xTorus, bool yTorus) {
-    double dx = p2.x - p1.x;
-    double dy = p2.y - p1.y;
-
-    if (xTorus) {
-      if (dx > width / 2)
-        dx -= width;
-      else if (dx < -width / 2)
-        dx += width;
-    }
-    if (yTorus) {
-      if (dy > height / 2)
-        dy -= height;
-      else if (dy < -height / 2)
-        dy += height;
-    }
-
-    return ::fr::univ_artois::lgi2a::similar::similar2logo::kernel::tools::
-        Point2D(dx, dy);
+    return withTopology(xTorus, yTorus, [&](auto topology) {
+      return decltype(topology)::displacement(p1, p2, width, height);
+    });
+  }
+
+  /**
+   * Computes the squared toroidal distances from an origin to count points
+   * given by the arrays of their coordinates, as toroidalDistance() squared.
+   * The loop, specialized on the topology, has no branch so that the
+   * compiler vectorizes it.
+   * @param distances Receives the count squared distances
+   */
+  static void squaredToroidalDistances(
+      const ::fr::univ_artois::lgi2a::similar::similar2logo::kernel::tools::
+          Point2D &origin,
+      const double *xs, const double *ys, std::size_t count, double width,
+      double height, bool xTorus, bool yTorus, double *distances) {
+    withTopology(xTorus, yTorus, [&](auto topology) {
+      using T = decltype(topology);
+      for (std::size_t i = 0; i < count; ++i) {
+        distances[i] =
+            T::squaredDistance(origin, Point2D(xs[i], ys[i]), width, height);
+      }
+    });
+  }
+
+  /**
+   * Computes the directions from an origin to count points given by the
+   * arrays of their coordinates, along the shortest toroidal displacements,
+   * as LogoEnvPLS::getDirection(): -atan2(dx, dy).
+   * @param directions Receives the count directions, in radians
+   * @param accurate Whether the directions are computed by std::atan2, or
+   * approximated within FastMath::ATAN2_ERROR radians by a vectorized loop
+   */
+  static void toroidalDirections(
+      const ::fr::univ_artois::lgi2a::similar::similar2logo::kernel::tools::
+          Point2D &origin,
+      const double *xs, const double *ys, std::size_t count, double width,
+      double height, bool xTorus, bool yTorus, double *directions,
+      bool accurate = true) {
+    // by blocks of displacements, which stay in the cache
+    constexpr std::size_t BLOCK = 256;
+    double across[BLOCK];
+    double along[BLOCK];
+    withTopology(xTorus, yTorus, [&](auto topology) {
+      using T = decltype(topology);
+      for (std::size_t first = 0; first < count; first += BLOCK) {
+        const std::size_t n = std::min(BLOCK, count - first);
+        for (std::size_t i = 0; i < n; ++i) {
+          across[i] = -T::template delta<T::X_WRAPS>(origin.x, xs[first + i],
+                                                     width);
+          along[i] = T::template delta<T::Y_WRAPS>(origin.y, ys[first + i],
+                                                   height);
+        }
+        if (accurate) {
+          for (std::size_t i = 0; i < n; ++i) {
+            directions[first + i] = std::atan2(across[i], along[i]);
+          }
+        } else {
+          ::fr::univ_artois::lgi2a::similar::microkernel::tools::FastMath::
+              atan2(across, along, directions + first, n);
+        }
+      }
+    });
   }
 };
 
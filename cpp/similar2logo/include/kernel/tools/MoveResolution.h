@@ -0,0 +1,161 @@
+#ifndef SIMILAR2LOGO_MOVERESOLUTION_H
+#define SIMILAR2LOGO_MOVERESOLUTION_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace tools {
+
+/**
+ * The empty cells of a grid, kept in a dense list with the position of each
+ * cell in it, so that a cell is added, removed or drawn at random in
+ * constant time, e.g. by the relocations of a segregation model.
+ */
+class EmptyCellIndex {
+public:
+  static constexpr std::uint32_t NONE =
+      std::numeric_limits<std::uint32_t>::max();
+
+  /**
+   * Starts again with the cells [0, cellCount) for which isOccupied(cell) is
+   * false.
+   */
+  template <typename Predicate>
+  void assign(std::size_t cellCount, Predicate &&isOccupied) {
+    cells.clear();
+    positions.assign(cellCount, NONE);
+    for (std::size_t cell = 0; cell < cellCount; ++cell) {
+      if (!isOccupied(cell)) {
+        insert(static_cast<std::uint32_t>(cell));
+      }
+    }
+  }
+
+  /** Gets the number of cells of the grid. */
+  std::size_t cellCount() const { return positions.size(); }
+
+  /** Gets the number of empty cells. */
+  std::size_t size() const { return cells.size(); }
+
+  bool empty() const { return cells.empty(); }
+
+  /** Gets the empty cell at a position of the list, in [0, size()). */
+  std::uint32_t at(std::size_t position) const { return cells[position]; }
+
+  bool contains(std::uint32_t cell) const {
+    return cell < positions.size() && positions[cell] != NONE;
+  }
+
+  /** Marks a cell as empty, unless it already is. */
+  void insert(std::uint32_t cell) {
+    if (positions[cell] == NONE) {
+      positions[cell] = static_cast<std::uint32_t>(cells.size());
+      cells.push_back(cell);
+    }
+  }
+
+  /** Marks a cell as occupied, moving the last empty cell into its place. */
+  void erase(std::uint32_t cell) {
+    const std::uint32_t position = positions[cell];
+    if (position == NONE) {
+      return;
+    }
+    const std::uint32_t last = cells.back();
+    cells[position] = last;
+    positions[last] = position;
+    cells.pop_back();
+    positions[cell] = NONE;
+  }
+
+private:
+  std::vector<std::uint32_t> cells;
+  std::vector<std::uint32_t> positions;
+};
+
+/**
+ * Resolves in parallel the moves of agents competing for the cells of a
+ * grid, on the pool lent by the engine (see
+ * WorkStealingThreadPool::parallelForOnCurrent).
+ *
+ * Each claimant writes its key, its priority with its index in the low
+ * bits, into the owner word of the claimed cell with an atomic
+ * compare-and-swap keeping the lowest key: the claimant of the lowest
+ * priority wins the cell, ties going to the lowest index. The outcome only
+ * depends on the claims and their priorities, never on the threads.
+ */
+class MoveResolver {
+public:
+  static constexpr std::uint32_t NO_CELL = EmptyCellIndex::NONE;
+
+  MoveResolver() = default;
+  MoveResolver(const MoveResolver &) = delete;
+  MoveResolver &operator=(const MoveResolver &) = delete;
+
+  /**
+   * Gives each claimed cell to one of its claimants.
+   * @param cellCount The number of cells of the grid.
+   * @param claims The cell claimed by each claimant, or NO_CELL.
+   * @param priorities The priority of each claimant, the lowest winning;
+   * only its upper 32 bits are compared.
+   * @param won Filled with 1 for the claimants winning their cell, else 0.
+   */
+  void resolve(std::size_t cellCount, const std::vector<std::uint32_t> &claims,
+               const std::vector<std::uint64_t> &priorities,
+               std::vector<unsigned char> &won);
+
+  /**
+   * Moves agents to random empty cells, in rounds: the agents without a
+   * cell yet claim a cell drawn at random among the empty ones and resolve()
+   * sorts the claims out; the winners take their cell and free their
+   * origin, and the losers claim again in the next round, until all moved,
+   * no cell is left or maxRounds rounds passed.
+   * @param origins The cell of each agent, or NO_CELL.
+   * @param emptyCells The empty cells, updated with the moves.
+   * @param seed The seed of the draws and the priorities: the moves only
+   * depend on it, the origins and the empty cells.
+   * @param destinations Filled with the new cell of each agent, NO_CELL for
+   * the agents left where they were.
+   * @param maxRounds The number of rounds after which the last losers stay.
+   * @return The number of agents having moved.
+   */
+  std::size_t relocate(const std::vector<std::uint32_t> &origins,
+                       EmptyCellIndex &emptyCells, std::uint64_t seed,
+                       std::vector<std::uint32_t> &destinations,
+                       int maxRounds = 16);
+
+private:
+  static constexpr std::uint64_t FREE =
+      std::numeric_limits<std::uint64_t>::max();
+
+  // the lowest key claiming each cell, FREE between the resolutions
+  std::unique_ptr<std::atomic<std::uint64_t>[]> owners;
+  std::size_t ownerCount = 0;
+
+  // the scratch of relocate(), kept across the calls
+  std::vector<std::uint32_t> pending;
+  std::vector<std::uint32_t> claims;
+  std::vector<std::uint64_t> priorities;
+  std::vector<unsigned char> won;
+
+  void reserveOwners(std::size_t cellCount);
+};
+
+} // namespace tools
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_MOVERESOLUTION_H
@@ -0,0 +1,107 @@
+#ifndef SIMILAR2LOGO_PHEROMONEPYRAMID_H
+#define SIMILAR2LOGO_PHEROMONEPYRAMID_H
+
+#include "FieldDiffusion.h"
+#include "Grid.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace tools {
+
+/**
+ * The reductions of a pheromone field over blocks of 2^k x 2^k cells, for
+ * the queries over large radii and the coarse views of the field.
+ *
+ * The level k has ceil(width / 2^k) x ceil(height / 2^k) cells, the level 0
+ * being the field itself, and the last one a single cell. Each level keeps
+ * the maximum of its blocks and the cell holding it, which answers
+ * strongestWithin() by descending only into the blocks that may beat the
+ * best cell found so far; with the MEAN reduction, the levels also keep the
+ * mean of their blocks.
+ *
+ * update() recomputes the blocks under the tiles of the field that are or
+ * were active, so that a sparse field costs little. The pyramid does not
+ * follow the writes to the field by itself.
+ */
+class PheromonePyramid {
+public:
+  using Value = TiledField::Value;
+
+  /** The reduction returned by getLevel(). */
+  enum class Reduction { MAX, MEAN };
+
+  /** The strongest cell of a query. */
+  struct Peak {
+    /** False if no cell of the query holds a positive value. */
+    bool found = false;
+    int x = 0;
+    int y = 0;
+    double value = 0;
+  };
+
+  explicit PheromonePyramid(Reduction reduction = Reduction::MAX)
+      : reduction(reduction) {}
+
+  Reduction getReduction() const { return reduction; }
+
+  /**
+   * Recomputes the levels from a field, resized to its dimensions.
+   */
+  void update(const TiledField &field);
+
+  /** Gets the number of levels, the field included. */
+  int getLevelCount() const { return static_cast<int>(levels.size()) + 1; }
+
+  /**
+   * Gets the reduction of a level, from 1 to getLevelCount() - 1.
+   * @throws std::out_of_range If the level does not exist.
+   */
+  const Grid<Value> &getLevel(int level) const;
+
+  /**
+   * Finds the strongest cell whose centre (x + 0.5, y + 0.5) lies within
+   * radius of a point, across the borders of a toroidal field. The ties go
+   * to any of the cells.
+   * @param field The field of the last update().
+   * @throws std::invalid_argument If the field does not have the dimensions
+   * of the pyramid.
+   */
+  Peak strongestWithin(const TiledField &field, double x, double y,
+                       double radius, bool toroidal) const;
+
+private:
+  struct Level {
+    Grid<Value> maximum;
+    // the cell of the field holding the maximum, y * width + x
+    Grid<std::uint32_t> argmax;
+    Grid<Value> mean;
+  };
+
+  Reduction reduction;
+  int width = 0;
+  int height = 0;
+  // the levels 1 and up
+  std::vector<Level> levels;
+  // the active flags of the field of the previous update
+  std::vector<unsigned char> wasActive;
+
+  // computes the block (x, y) of a level from the blocks of the level below
+  void reduce(const TiledField &field, int level, int x, int y);
+};
+
+} // namespace tools
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_PHEROMONEPYRAMID_H
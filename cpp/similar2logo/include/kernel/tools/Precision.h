@@ -0,0 +1,53 @@
+#ifndef SIMILAR2LOGO_PRECISION_H
+#define SIMILAR2LOGO_PRECISION_H
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace tools {
+
+/**
+ * The types of the values stored in bulk by the environment: the values of
+ * the pheromone fields and the kinematic state of the turtles in their
+ * store. The loops over them compute in the same type, while the API of the
+ * environment keeps taking and returning doubles.
+ * @tparam PheromoneType The type of the values of the pheromone fields.
+ * @tparam StateType The type of the turtle coordinates, headings, speeds
+ * and accelerations.
+ */
+template <typename PheromoneType, typename StateType> struct PrecisionPolicy {
+  using Pheromone = PheromoneType;
+  using State = StateType;
+};
+
+using DoublePrecision = PrecisionPolicy<double, double>;
+
+/**
+ * Halves the memory traffic of the fields and of the turtle store, and
+ * doubles the number of values per vector instruction, at the cost of about
+ * 7 significant digits: enough for visualization-grade runs.
+ */
+using SinglePrecision = PrecisionPolicy<float, float>;
+
+/**
+ * The precision of the build, single when SIMILAR2LOGO_FLOAT32 is defined
+ * (the CMake option of the same name), double otherwise.
+ */
+#if defined(SIMILAR2LOGO_FLOAT32) && SIMILAR2LOGO_FLOAT32
+using Precision = SinglePrecision;
+#else
+using Precision = DoublePrecision;
+#endif
+
+} // namespace tools
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_PRECISION_H
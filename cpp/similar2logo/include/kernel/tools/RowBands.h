@@ -0,0 +1,88 @@
+#ifndef SIMILAR2LOGO_ROWBANDS_H
+#define SIMILAR2LOGO_ROWBANDS_H
+
+#include "../../../../microkernel/include/engine/WorkStealingThreadPool.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace tools {
+
+/**
+ * Splits the rows of a grid into bands of consecutive rows, processed in
+ * parallel on the pool that the multithreaded engine lends to the sequential
+ * reactions (see WorkStealingThreadPool::parallelForOnCurrent), or one after
+ * the other when no pool is lent.
+ *
+ * The bands hold about BAND_CELLS cells, so that the rows read by a band
+ * stay in the cache of the core processing it.
+ */
+class RowBands {
+public:
+  static constexpr int BAND_CELLS = 1 << 15;
+
+  /**
+   * Processes rows [0, rowCount) of rowLength cells each.
+   * @param body Called with the first row and the end row of each band; the
+   * bands may be processed concurrently.
+   */
+  template <typename Function>
+  static void forEach(int rowCount, int rowLength, const Function &body) {
+    const int rowsPerBand = std::max(1, BAND_CELLS / std::max(1, rowLength));
+    const int bandCount = (rowCount + rowsPerBand - 1) / rowsPerBand;
+    if (bandCount <= 1 ||
+        microkernel::engine::WorkStealingThreadPool::currentSize() == 1) {
+      body(0, rowCount);
+      return;
+    }
+    microkernel::engine::WorkStealingThreadPool::parallelForOnCurrent(
+        static_cast<std::size_t>(bandCount), 1,
+        [&](std::size_t begin, std::size_t end, std::size_t) {
+          for (std::size_t band = begin; band < end; ++band) {
+            const int first = static_cast<int>(band) * rowsPerBand;
+            body(first, std::min(first + rowsPerBand, rowCount));
+          }
+        });
+  }
+
+  /**
+   * Sorts items by row, keeping their order within a row, so that the band
+   * of rows [first, end) processes the items order[start[first]] to
+   * order[start[end] - 1].
+   * @param rows The row of each item, or rowCount for the items to skip.
+   */
+  static void sortByRow(const std::vector<std::uint32_t> &rows,
+                        std::size_t rowCount,
+                        std::vector<std::uint32_t> &start,
+                        std::vector<std::uint32_t> &order) {
+    start.assign(rowCount + 2, 0);
+    for (const std::uint32_t row : rows) {
+      ++start[row + 1];
+    }
+    for (std::size_t row = 0; row <= rowCount; ++row) {
+      start[row + 1] += start[row];
+    }
+    std::vector<std::uint32_t> next(start.begin(), start.end() - 1);
+    order.resize(rows.size());
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+      order[next[rows[i]]++] = static_cast<std::uint32_t>(i);
+    }
+  }
+};
+
+} // namespace tools
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_ROWBANDS_H
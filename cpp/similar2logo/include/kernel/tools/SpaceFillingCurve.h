@@ -0,0 +1,97 @@
+#ifndef SIMILAR2LOGO_SPACEFILLINGCURVE_H
+#define SIMILAR2LOGO_SPACEFILLINGCURVE_H
+
+#include <cstdint>
+#include <utility>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace tools {
+
+/**
+ * Indices of the patches of a grid along space-filling curves, which visit
+ * close patches at close indices: sorting turtles by the index of their
+ * patch puts the neighbours of a turtle next to it in memory.
+ *
+ * The curves cover a square of 2^bits patches a side; the coordinates are
+ * taken modulo its side.
+ */
+class SpaceFillingCurve {
+public:
+  /** The largest side of the square, 2^MAX_BITS patches. */
+  static constexpr unsigned MAX_BITS = 32;
+
+  /**
+   * Gets the index of a patch along the Z-order (Morton) curve, which
+   * interleaves the bits of the coordinates.
+   */
+  static std::uint64_t mortonIndex(std::uint32_t x, std::uint32_t y) {
+    return spread(x) | (spread(y) << 1);
+  }
+
+  /**
+   * Gets the index of a patch along the Hilbert curve, whose consecutive
+   * patches are always adjacent.
+   * @param bits The side of the square, 2^bits patches, at most MAX_BITS.
+   */
+  static std::uint64_t hilbertIndex(std::uint32_t x, std::uint32_t y,
+                                    unsigned bits) {
+    std::uint64_t index = 0;
+    for (std::uint64_t side = bits == 0 ? 0 : std::uint64_t(1) << (bits - 1);
+         side > 0; side >>= 1) {
+      const std::uint32_t s = static_cast<std::uint32_t>(side);
+      const unsigned rx = (x & s) != 0;
+      const unsigned ry = (y & s) != 0;
+      index += side * side * ((3 * rx) ^ ry);
+      // The quadrant is rotated for its curve to start and end next to the
+      // neighbouring quadrants
+      if (ry == 0) {
+        if (rx == 1) {
+          x = ~x;
+          y = ~y;
+        }
+        std::swap(x, y);
+      }
+    }
+    return index;
+  }
+
+  /**
+   * Gets the number of bits of the smallest square covering a grid.
+   */
+  static unsigned bitsFor(int width, int height) {
+    unsigned bits = 0;
+    while (bits < MAX_BITS &&
+           ((std::uint64_t(1) << bits) < static_cast<std::uint64_t>(width) ||
+            (std::uint64_t(1) << bits) < static_cast<std::uint64_t>(height))) {
+      ++bits;
+    }
+    return bits;
+  }
+
+private:
+  /** Moves bit i of a coordinate to bit 2i. */
+  static std::uint64_t spread(std::uint32_t coordinate) {
+    std::uint64_t v = coordinate;
+    v = (v | (v << 16)) & 0x0000FFFF0000FFFFull;
+    v = (v | (v << 8)) & 0x00FF00FF00FF00FFull;
+    v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0Full;
+    v = (v | (v << 2)) & 0x3333333333333333ull;
+    v = (v | (v << 1)) & 0x5555555555555555ull;
+    return v;
+  }
+};
+
+} // namespace tools
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_SPACEFILLINGCURVE_H
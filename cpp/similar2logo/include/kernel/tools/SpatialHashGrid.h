@@ -0,0 +1,194 @@
+#ifndef SIMILAR2LOGO_SPATIALHASHGRID_H
+#define SIMILAR2LOGO_SPATIALHASHGRID_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace tools {
+
+/**
+ * An index of points by cells of a rectangular space, answering the radius
+ * queries of the models that keep their own agents, such as the Python
+ * engine.
+ *
+ * The points are identified by keys, small integers used as indices. Their
+ * cells are kept sorted by a counting sort, done again by the first query
+ * following an insertion, an update or a removal (see refresh()), so that a
+ * query reads the points of a cell contiguously. Rebuilding the index from
+ * coordinate arrays costs a single pass over them.
+ *
+ * On a toroidal space, the points are wrapped into it and the distances are
+ * the toroidal ones; the cells then divide the space evenly, a cell being
+ * at least cellSize wide. Otherwise, the points outside the space are kept
+ * in the border cells.
+ */
+class SpatialHashGrid {
+public:
+  /** The key passed as the exclusion of a query excluding no point. */
+  static constexpr ::std::uint32_t NO_KEY = ~::std::uint32_t(0);
+
+  /**
+   * @param cellSize The side of the cells, at best about the usual radius of
+   * the queries.
+   * @throws std::invalid_argument If a dimension is not positive.
+   */
+  SpatialHashGrid(double cellSize, double width, double height,
+                  bool toroidal = false);
+
+  double getWidth() const { return width; }
+  double getHeight() const { return height; }
+  bool isToroidal() const { return toroidal; }
+
+  /** Gets the number of points in the index. */
+  ::std::size_t size() const { return count; }
+
+  /** Removes all the points. */
+  void clear();
+
+  /** Inserts the point of a key, or moves it if the key is already in. */
+  void insert(::std::uint32_t key, double x, double y);
+
+  /** Moves the point of a key, inserting it if needed. */
+  void update(::std::uint32_t key, double x, double y) { insert(key, x, y); }
+
+  /** Removes the point of a key, if it is in the index. */
+  void remove(::std::uint32_t key);
+
+  bool contains(::std::uint32_t key) const {
+    return key < cellOf.size() && cellOf[key] != NO_CELL;
+  }
+
+  /** Replaces the points by the ones of keys 0 to count - 1. */
+  void rebuild(const double *xs, const double *ys, ::std::size_t count);
+
+  /**
+   * Sorts the points by cell again if they changed since the last sort.
+   * The queries call it; once it is called, concurrent queries are safe
+   * until the next change.
+   */
+  void refresh();
+
+  /** Tells whether the points changed since the last refresh(). */
+  bool needsRefresh() const { return stale; }
+
+  /**
+   * Gets the lock of the Python bindings, whose calls the free-threaded
+   * build runs in parallel: the queries share it and the updates, refresh()
+   * included, hold it alone. The methods of the index do not take it.
+   */
+  ::std::shared_mutex &getAccessMutex() const { return accessMutex; }
+
+  /**
+   * Visits the points within radius of (x, y), other than the excluded
+   * key, in no particular order.
+   * @param visitor Called with the key and the distance of each point.
+   */
+  template <typename Visitor>
+  void queryRadius(double x, double y, double radius, ::std::uint32_t exclude,
+                   Visitor &&visitor) {
+    refresh();
+    forEachInRadius(x, y, radius, exclude, visitor);
+  }
+
+  /**
+   * Gets the keys and the distances of the points within radius of (x, y),
+   * other than the excluded key.
+   */
+  ::std::vector<::std::pair<::std::uint32_t, double>>
+  queryRadius(double x, double y, double radius,
+              ::std::uint32_t exclude = NO_KEY);
+
+  /**
+   * Visits the points within radius of (x, y), as queryRadius() does,
+   * without sorting them again: refresh() must have been called since the
+   * last change.
+   */
+  template <typename Visitor>
+  void forEachInRadius(double x, double y, double radius,
+                       ::std::uint32_t exclude, Visitor &&visitor) const {
+    if (toroidal) {
+      x = wrap(x, width);
+      y = wrap(y, height);
+    }
+    int firstColumn, columnCount, firstRow, rowCount;
+    span(x, radius, cellWidth, columns, firstColumn, columnCount);
+    span(y, radius, cellHeight, rows, firstRow, rowCount);
+    const double radiusSquared = radius * radius;
+    for (int j = 0, row = firstRow; j < rowCount; ++j) {
+      for (int i = 0, column = firstColumn; i < columnCount; ++i) {
+        const ::std::size_t cell =
+            static_cast<::std::size_t>(row) * columns + column;
+        for (auto k = start[cell]; k < start[cell + 1]; ++k) {
+          const ::std::uint32_t key = sorted[k];
+          double dx = ::std::abs(xs[key] - x);
+          double dy = ::std::abs(ys[key] - y);
+          if (toroidal) {
+            dx = dx * 2 > width ? width - dx : dx;
+            dy = dy * 2 > height ? height - dy : dy;
+          }
+          const double distanceSquared = dx * dx + dy * dy;
+          if (distanceSquared <= radiusSquared && key != exclude) {
+            visitor(key, ::std::sqrt(distanceSquared));
+          }
+        }
+        column = column + 1 == columns ? 0 : column + 1;
+      }
+      row = row + 1 == rows ? 0 : row + 1;
+    }
+  }
+
+private:
+  static constexpr ::std::uint32_t NO_CELL = ~::std::uint32_t(0);
+
+  double width;
+  double height;
+  bool toroidal;
+  int columns;
+  int rows;
+  double cellWidth;
+  double cellHeight;
+  ::std::size_t count = 0;
+  // the coordinates and the cell of each key, NO_CELL for the absent keys
+  ::std::vector<double> xs;
+  ::std::vector<double> ys;
+  ::std::vector<::std::uint32_t> cellOf;
+  // the keys sorted by cell: the keys of the cell c are sorted[start[c]] to
+  // sorted[start[c + 1] - 1]
+  ::std::vector<::std::uint32_t> start;
+  ::std::vector<::std::uint32_t> sorted;
+  bool stale = false;
+  mutable ::std::shared_mutex accessMutex;
+
+  static double wrap(double value, double size) {
+    value = ::std::fmod(value, size);
+    return value < 0 ? value + size : value;
+  }
+
+  ::std::uint32_t cellAt(double x, double y) const;
+  void place(::std::uint32_t key, double x, double y);
+
+  // Gets the cells of an axis within radius of a coordinate: count cells
+  // from first, wrapping on a toroidal space.
+  void span(double coordinate, double radius, double cellSide, int cells,
+            int &first, int &spanned) const;
+};
+
+} // namespace tools
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_SPATIALHASHGRID_H
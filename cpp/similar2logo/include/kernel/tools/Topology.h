@@ -0,0 +1,156 @@
+#ifndef SIMILAR2LOGO_TOPOLOGY_H
+#define SIMILAR2LOGO_TOPOLOGY_H
+
+#include "Point2D.h"
+#include <algorithm>
+#include <cmath>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace tools {
+
+/**
+ * The topology of a grid, known at compile time: which of its axes wrap
+ * around. The hot loops of the grids (diffusion stencils, radius queries,
+ * the wrapping of the moves) are templates of a topology, selected once per
+ * call by withTopology(), so that their inner loops hold no test of the
+ * torus flags.
+ * @tparam XWraps Whether the x axis wraps around.
+ * @tparam YWraps Whether the y axis wraps around.
+ */
+template <bool XWraps, bool YWraps> struct Topology {
+  static constexpr bool X_WRAPS = XWraps;
+  static constexpr bool Y_WRAPS = YWraps;
+
+  /**
+   * Gets a neighbouring cell coordinate along an axis of a given length:
+   * wrapped along a wrapping axis, -1 beyond the border of a bounded one.
+   */
+  template <bool Wraps> static int neighbour(int coordinate, int length) {
+    if (coordinate >= 0 && coordinate < length) {
+      return coordinate;
+    }
+    if constexpr (Wraps) {
+      return (coordinate % length + length) % length;
+    } else {
+      return -1;
+    }
+  }
+
+  static int neighbourX(int x, int width) {
+    return neighbour<XWraps>(x, width);
+  }
+
+  static int neighbourY(int y, int height) {
+    return neighbour<YWraps>(y, height);
+  }
+
+  /**
+   * Brings a continuous coordinate into [0, length) along a wrapping axis,
+   * or clamps it into [0, length - 1] along a bounded one.
+   */
+  template <bool Wraps> static double place(double coordinate, double length) {
+    if constexpr (Wraps) {
+      coordinate = std::fmod(coordinate, length);
+      return coordinate < 0 ? coordinate + length : coordinate;
+    } else {
+      return std::max(0.0, std::min(coordinate, length - 1));
+    }
+  }
+
+  /** Places a location in a grid of a given size, see place(). */
+  static void place(double &x, double &y, double width, double height) {
+    x = place<XWraps>(x, width);
+    y = place<YWraps>(y, height);
+  }
+
+  /**
+   * Gets the shortest displacement from one coordinate to another along an
+   * axis of a given length.
+   */
+  template <bool Wraps>
+  static double delta(double from, double to, double length) {
+    double d = to - from;
+    if constexpr (Wraps) {
+      if (d > length / 2)
+        d -= length;
+      else if (d < -length / 2)
+        d += length;
+    }
+    return d;
+  }
+
+  /** Gets the shortest displacement vector from p1 to p2. */
+  static Point2D displacement(const Point2D &p1, const Point2D &p2,
+                              double width, double height) {
+    return Point2D(delta<XWraps>(p1.x, p2.x, width),
+                   delta<YWraps>(p1.y, p2.y, height));
+  }
+
+  /** Gets the squared distance between two points, see distance(). */
+  static double squaredDistance(const Point2D &p1, const Point2D &p2,
+                                double width, double height) {
+    double dx = std::abs(p1.x - p2.x);
+    double dy = std::abs(p1.y - p2.y);
+    if constexpr (XWraps) {
+      dx = std::min(dx, width - dx);
+    }
+    if constexpr (YWraps) {
+      dy = std::min(dy, height - dy);
+    }
+    return dx * dx + dy * dy;
+  }
+
+  /** Gets the shortest distance between two points of the grid. */
+  static double distance(const Point2D &p1, const Point2D &p2, double width,
+                         double height) {
+    return std::sqrt(squaredDistance(p1, p2, width, height));
+  }
+};
+
+/** A grid with borders on its four sides. */
+using Bounded = Topology<false, false>;
+/** A grid wrapping around along its two axes. */
+using Torus = Topology<true, true>;
+/** A grid wrapping around along its x axis only. */
+using CylinderX = Topology<true, false>;
+/** A grid wrapping around along its y axis only. */
+using CylinderY = Topology<false, true>;
+
+/**
+ * Calls a generic function with the topology of the given torus flags, e.g.
+ * <pre>
+ *   withTopology(xTorus, yTorus, [&](auto topology) {
+ *     using T = decltype(topology);
+ *     ... T::distance(a, b, width, height) ...
+ *   });
+ * </pre>
+ * @return The value returned by the function.
+ */
+template <typename Function>
+decltype(auto) withTopology(bool xTorus, bool yTorus, Function &&function) {
+  if (xTorus) {
+    if (yTorus) {
+      return function(Torus());
+    }
+    return function(CylinderX());
+  }
+  if (yTorus) {
+    return function(CylinderY());
+  }
+  return function(Bounded());
+}
+
+} // namespace tools
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_TOPOLOGY_H
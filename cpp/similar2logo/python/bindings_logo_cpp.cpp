@@ -1,12 +1,24 @@
 #include <pybind11/functional.h>
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
 #include "../../microkernel/include/LevelIdentifier.h"
 #include "../../microkernel/include/SimulationTimeStamp.h"
+#include "../../microkernel/include/engine/ModelPlugin.h"
 #include "../../microkernel/include/engine/MultiThreadedSimulationEngine.h"
+#include "../../microkernel/include/engine/StepBarrier.h"
+#include "../../microkernel/include/libs/CallbackProfiler.h"
+#include "../../microkernel/include/libs/ExecutionTracer.h"
+#include "../../microkernel/include/libs/MemoryAccounting.h"
+#include "../../microkernel/include/libs/SimulationMetrics.h"
+#include "../../microkernel/include/libs/StepTimingRecorder.h"
+#include "../../extendedkernel/include/libs/probes/StatisticsProbe.h"
+#include "kernel/agents/Behaviors.h"
+#include "kernel/agents/CompiledBehavior.h"
 #include "kernel/agents/LogoAgent.h"
 #include "kernel/environment/Environment.h"
+#include "kernel/environment/SharedDecisionBuffer.h"
 #include "kernel/influences/ChangeDirection.h"
 #include "kernel/influences/ChangePosition.h"
 #include "kernel/influences/ChangeSpeed.h"
@@ -14,12 +26,24 @@
 #include "kernel/influences/EmitPheromone.h"
 #include "kernel/influences/RemoveMark.h"
 #include "kernel/influences/RemoveMarks.h"
+#include "kernel/influences/Relocate.h"
 #include "kernel/influences/Stop.h"
 #include "kernel/model/LogoSimulationModel.h"
 #include "kernel/model/environment/LogoEnvPLS.h"
 #include "kernel/model/environment/Mark.h"
 #include "kernel/model/environment/TurtlePLSInLogo.h"
+#include "kernel/model/levels/LogoSimulationLevelList.h"
 #include "kernel/reaction/Reaction.h"
+#include "kernel/tools/FrameEncoder.h"
+#include "kernel/tools/HeatmapTileRenderer.h"
+#include "kernel/tools/Precision.h"
+#include "kernel/tools/SpatialHashGrid.h"
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <shared_mutex>
+#include <type_traits>
+#include <utility>
 
 namespace py = pybind11;
 
@@ -28,9 +52,253 @@ using namespace fr::univ_artois::lgi2a::similar::similar2logo::kernel;
 
 namespace mk = fr::univ_artois::lgi2a::similar::microkernel;
 
-PYBIND11_MODULE(_core, m) {
+namespace {
+
+// A read-only NumPy view of memory owned by owner, which the view keeps
+// alive.
+template <typename T>
+py::array_t<T> readOnlyView(const T *data, std::vector<py::ssize_t> shape,
+                            py::handle owner) {
+  py::array_t<T> view(shape, data, owner);
+  view.attr("setflags")(py::arg("write") = false);
+  return view;
+}
+
+// Times a call of a Python callback in the account of its profile while the
+// callback profiler is enabled: declared before acquiring the GIL, it is
+// told when the GIL is held and when the arguments are converted.
+class ProfiledCall {
+private:
+  using Clock = std::chrono::steady_clock;
+  mk::libs::CallbackAccount *account;
+  Clock::time_point start;
+  Clock::time_point locked;
+  Clock::time_point converted;
+
+public:
+  explicit ProfiledCall(mk::libs::CallbackAccount &profile)
+      : account(mk::libs::CallbackProfiler::isEnabled() ? &profile
+                                                        : nullptr) {
+    if (account != nullptr) {
+      start = Clock::now();
+      locked = converted = start;
+    }
+  }
+
+  ProfiledCall(const ProfiledCall &) = delete;
+  ProfiledCall &operator=(const ProfiledCall &) = delete;
+
+  void lockAcquired() {
+    if (account != nullptr) {
+      locked = converted = Clock::now();
+    }
+  }
+
+  void argumentsConverted() {
+    if (account != nullptr) {
+      converted = Clock::now();
+    }
+  }
+
+  ~ProfiledCall() {
+    if (account != nullptr) {
+      using Duration = mk::libs::CallbackProfile::Duration;
+      account->called(
+          std::chrono::duration_cast<Duration>(Clock::now() - start),
+          std::chrono::duration_cast<Duration>(locked - start),
+          std::chrono::duration_cast<Duration>(converted - locked));
+    }
+  }
+};
+
+// The thread state of an engine worker, kept from its first callback to the
+// end of the thread. The workers would otherwise create and delete one at
+// each call of a callback, under a lock of the interpreter that serializes
+// the callbacks of the free-threaded build. The state is kept by a
+// PyGILState_Ensure() released when the thread ends, since
+// gil_scoped_acquire::inc_ref() is missing from the simple GIL management
+// that pybind11 uses in the free-threaded build. The Python threads, which
+// have a state of their own that Python deletes, keep nothing.
+class KeptThreadState {
+private:
+  PyGILState_STATE state = PyGILState_UNLOCKED;
+  PyThreadState *detached = nullptr;
+
+  static bool finalizing() {
+#if PY_VERSION_HEX >= 0x030D0000
+    return Py_IsFinalizing();
+#else
+    return _Py_IsFinalizing();
+#endif
+  }
+
+public:
+  KeptThreadState() {
+    if (PyGILState_GetThisThreadState() == nullptr) {
+      state = PyGILState_Ensure();
+      detached = PyEval_SaveThread();
+    }
+  }
+
+  KeptThreadState(const KeptThreadState &) = delete;
+  KeptThreadState &operator=(const KeptThreadState &) = delete;
+
+  // A worker outliving the interpreter leaves its state to the finalization
+  ~KeptThreadState() {
+    if (detached != nullptr && Py_IsInitialized() && !finalizing()) {
+      PyEval_RestoreThread(detached);
+      PyGILState_Release(state);
+    }
+  }
+};
+
+void keepThreadState() { thread_local KeptThreadState kept; }
+
+// A Python function called from the engine threads, released with the GIL
+// held whatever the thread dropping the last reference.
+std::shared_ptr<py::function> engineCallable(py::function function) {
+  return std::shared_ptr<py::function>(
+      new py::function(std::move(function)), [](py::function *released) {
+        py::gil_scoped_acquire gil;
+        delete released;
+      });
+}
+
+// The environments and spatial indices that Python threads share are locked
+// by the bindings, since the free-threaded build runs their calls in
+// parallel: the queries share the lock of the object and the updates hold it
+// alone. The steps of an environment, Reaction::apply() and
+// SharedDecisionBuffer::apply(), take it themselves and are called without
+// the GIL. A thread waits for a lock without the GIL (detached from the
+// interpreter in the free-threaded build), which the holder may need.
+using SharedAccess = std::shared_lock<std::shared_mutex>;
+using ExclusiveAccess = std::unique_lock<std::shared_mutex>;
+
+template <typename Lock> Lock acquire(std::shared_mutex &mutex) {
+  Lock lock(mutex, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    if (PyGILState_Check()) {
+      py::gil_scoped_release release;
+      lock.lock();
+    } else {
+      lock.lock();
+    }
+  }
+  return lock;
+}
+
+std::shared_mutex &accessMutex(const environment::Environment &env) {
+  return env.access_mutex();
+}
+
+std::shared_mutex &accessMutex(const tools::SpatialHashGrid &grid) {
+  return grid.getAccessMutex();
+}
+
+template <typename Object> SharedAccess sharedAccess(const Object &object) {
+  return acquire<SharedAccess>(accessMutex(object));
+}
+
+template <typename Object>
+ExclusiveAccess exclusiveAccess(const Object &object) {
+  return acquire<ExclusiveAccess>(accessMutex(object));
+}
+
+// A const method of a shared object, bound as a query: its result is
+// copied under the lock.
+template <typename Object, typename Return, typename... Args>
+auto query(Return (Object::*method)(Args...) const) {
+  return [method](const Object &object, Args... args) -> std::decay_t<Return> {
+    const SharedAccess lock = sharedAccess(object);
+    return (object.*method)(std::forward<Args>(args)...);
+  };
+}
+
+// A method of a shared object, bound as an update.
+template <typename Object, typename Return, typename... Args>
+auto update(Return (Object::*method)(Args...)) {
+  return [method](Object &object, Args... args) -> std::decay_t<Return> {
+    const ExclusiveAccess lock = exclusiveAccess(object);
+    return (object.*method)(std::forward<Args>(args)...);
+  };
+}
+
+// The values of a 1-D array of doubles, converted if needed, that must hold
+// one value per turtle.
+using DoubleArray = py::array_t<double, py::array::c_style |
+                                            py::array::forcecast>;
+void checkTurtleCount(const DoubleArray &values, std::size_t count) {
+  if (values.ndim() != 1 || static_cast<std::size_t>(values.size()) != count) {
+    throw std::invalid_argument("expected one value per turtle");
+  }
+}
+
+// The turtle of an agent in the Logo level, null if it has none.
+const model::environment::TurtlePLSInLogo *
+turtleOf(const mk::agents::IAgent4Engine &agent) {
+  const auto &states = agent.borrowPublicLocalStates();
+  const auto found = states.find(model::levels::LogoSimulationLevelList::LOGO);
+  return found != states.end()
+             ? dynamic_cast<const model::environment::TurtlePLSInLogo *>(
+                   found->second.get())
+             : nullptr;
+}
+
+// A field of the turtles, x, y, heading, speed or acceleration, read by a
+// statistics probe on its workers: NaN leaves out the agents that are not
+// turtles.
+using StatisticsProbe =
+    fr::univ_artois::lgi2a::similar::extendedkernel::libs::probes::
+        StatisticsProbe;
+StatisticsProbe::Value turtleField(const std::string &field) {
+  double (*read)(const model::environment::TurtlePLSInLogo &);
+  if (field == "x") {
+    read = [](const model::environment::TurtlePLSInLogo &turtle) {
+      return turtle.getLocation().x;
+    };
+  } else if (field == "y") {
+    read = [](const model::environment::TurtlePLSInLogo &turtle) {
+      return turtle.getLocation().y;
+    };
+  } else if (field == "heading") {
+    read = [](const model::environment::TurtlePLSInLogo &turtle) {
+      return turtle.getHeading();
+    };
+  } else if (field == "speed") {
+    read = [](const model::environment::TurtlePLSInLogo &turtle) {
+      return turtle.getSpeed();
+    };
+  } else if (field == "acceleration") {
+    read = [](const model::environment::TurtlePLSInLogo &turtle) {
+      return turtle.getAcceleration();
+    };
+  } else {
+    throw std::invalid_argument("unknown turtle field: " + field);
+  }
+  return [read](const mk::agents::IAgent4Engine &agent) {
+    const auto *turtle = turtleOf(agent);
+    return turtle ? read(*turtle) : std::nan("");
+  };
+}
+
+} // namespace
+
+// The name of the module, _core_f32 for the single-precision build (see
+// CMakeLists.txt).
+#ifndef SIMILAR2LOGO_MODULE
+#define SIMILAR2LOGO_MODULE _core
+#endif
+
+// The module runs without the GIL in the free-threaded build: the decision
+// callbacks then run in parallel on the engine workers, and the shared
+// objects are locked by their bindings.
+PYBIND11_MODULE(SIMILAR2LOGO_MODULE, m, py::mod_gil_not_used()) {
   m.doc() = "SIMILAR2Logo C++ Engine - High-performance multithreaded "
             "simulation - UNIQUE_ID_12345";
+  // the type of the pheromone fields and turtle states (see Precision.h)
+  m.attr("precision") =
+      std::is_same_v<tools::Precision::Pheromone, float> ? "float32"
+                                                         : "float64";
 
   // ========== Microkernel Types ==========
   py::class_<
@@ -99,6 +367,17 @@ PYBIND11_MODULE(_core, m) {
              std::shared_ptr<mk::agents::IPerceivedData>>(m, "IPerceivedData");
 
   // ========== Logo Perceived Data ==========
+  // The nearby turtles and the pheromones may be deferred by the perception
+  // model: get_nearby_turtles() and get_all_pheromones() compute them on
+  // their first call only.
+  using NearbyTurtle = ::fr::univ_artois::lgi2a::similar::similar2logo::
+      kernel::agents::LogoAgent::LogoPerceivedData::NearbyTurtle;
+  py::class_<NearbyTurtle>(m, "NearbyTurtle")
+      .def_readonly("position", &NearbyTurtle::position)
+      .def_readonly("heading", &NearbyTurtle::heading)
+      .def_readonly("distance", &NearbyTurtle::distance)
+      .def_readonly("category", &NearbyTurtle::category);
+
   py::class_<
       ::fr::univ_artois::lgi2a::similar::similar2logo::kernel::agents::
           LogoAgent::LogoPerceivedData,
@@ -123,7 +402,25 @@ PYBIND11_MODULE(_core, m) {
                LogoAgent::LogoPerceivedData::getPheromone)
       .def("get_all_pheromones",
            &::fr::univ_artois::lgi2a::similar::similar2logo::kernel::agents::
-               LogoAgent::LogoPerceivedData::getAllPheromones);
+               LogoAgent::LogoPerceivedData::getAllPheromones)
+      .def("has_nearby_turtles",
+           &::fr::univ_artois::lgi2a::similar::similar2logo::kernel::agents::
+               LogoAgent::LogoPerceivedData::hasNearbyTurtles)
+      .def("has_pheromones",
+           &::fr::univ_artois::lgi2a::similar::similar2logo::kernel::agents::
+               LogoAgent::LogoPerceivedData::hasPheromones)
+      .def("set_turtle",
+           &::fr::univ_artois::lgi2a::similar::similar2logo::kernel::agents::
+               LogoAgent::LogoPerceivedData::setTurtle,
+           py::arg("turtle"))
+      .def("get_turtle",
+           &::fr::univ_artois::lgi2a::similar::similar2logo::kernel::agents::
+               LogoAgent::LogoPerceivedData::getTurtle)
+      .def("set_pheromone_gradient",
+           &::fr::univ_artois::lgi2a::similar::similar2logo::kernel::agents::
+               LogoAgent::LogoPerceivedData::setPheromoneGradient,
+           py::arg("pheromone"), py::arg("left"), py::arg("ahead"),
+           py::arg("right"));
 
   // ========== IAgtDecisionModel ==========
   py::class_<::fr::univ_artois::lgi2a::similar::extendedkernel::agents::
@@ -140,11 +437,129 @@ PYBIND11_MODULE(_core, m) {
                           agents::LogoAgent::PythonDecisionModel>,
       ::fr::univ_artois::lgi2a::similar::extendedkernel::agents::
           IAgtDecisionModel>(m, "PythonDecisionModel")
-      .def(py::init<
-               const mk::LevelIdentifier &,
-               ::fr::univ_artois::lgi2a::similar::similar2logo::kernel::agents::
-                   LogoAgent::PythonDecisionModel::DecisionCallback>(),
-           py::arg("level"), py::arg("callback"));
+      .def(py::init([](const mk::LevelIdentifier &level,
+                       py::function callback, const std::string &profile) {
+             auto &account = mk::libs::CallbackProfiler::account(profile);
+             auto function = engineCallable(std::move(callback));
+             return std::make_shared<agents::LogoAgent::PythonDecisionModel>(
+                 level,
+                 [function, &account](
+                     std::shared_ptr<agents::LogoAgent::LogoPerceivedData>
+                         perception,
+                     std::shared_ptr<mk::influences::InfluencesMap>
+                         influences) {
+                   ProfiledCall profiled(account);
+                   keepThreadState();
+                   py::gil_scoped_acquire gil;
+                   profiled.lockAcquired();
+                   py::object perceived = py::cast(std::move(perception));
+                   py::object produced = py::cast(std::move(influences));
+                   profiled.argumentsConverted();
+                   (*function)(perceived, produced);
+                 });
+           }),
+           py::arg("level"), py::arg("callback"),
+           py::arg("profile") = "python decision",
+           "The calls to the callback are profiled under the name profile "
+           "while the callback profiling is enabled.");
+
+  // ========== Native behaviors ==========
+  // make_behavior("boids", level, max_angle=0.5): the numbers and the
+  // strings of the keyword arguments are the parameters of the behavior.
+  m.def(
+      "make_behavior",
+      [](const std::string &name, const mk::LevelIdentifier &level,
+         const py::kwargs &kwargs) {
+        agents::BehaviorParameters parameters;
+        for (const auto &item : kwargs) {
+          const auto key = item.first.cast<std::string>();
+          if (py::isinstance<py::str>(item.second)) {
+            parameters.names[key] = item.second.cast<std::string>();
+          } else {
+            parameters.values[key] = item.second.cast<double>();
+          }
+        }
+        return agents::makeBehavior(name, level, parameters);
+      },
+      py::arg("name"), py::arg("level"));
+
+  // ========== Batch Decision Model ==========
+  // The callback receives a structured array of the perceptions (fields x,
+  // y, heading, speed, nearby_turtles), a 2-D array of the pheromones (one
+  // column per pheromone name) and the writable arrays heading_deltas and
+  // speed_deltas, all viewing buffers of the model that are only valid
+  // during the call.
+  using BatchPerception = agents::LogoAgent::BatchPerception;
+  using BatchDecisionModel = agents::LogoAgent::BatchDecisionModel;
+  PYBIND11_NUMPY_DTYPE_EX(BatchPerception::Row, x, "x", y, "y", heading,
+                          "heading", speed, "speed", nearbyTurtles,
+                          "nearby_turtles");
+
+  py::class_<mk::engine::IBatchDecisionHook,
+             std::shared_ptr<mk::engine::IBatchDecisionHook>>(
+      m, "BatchDecisionHook");
+
+  py::class_<BatchDecisionModel, std::shared_ptr<BatchDecisionModel>,
+             ::fr::univ_artois::lgi2a::similar::extendedkernel::agents::
+                 IAgtDecisionModel,
+             mk::engine::IBatchDecisionHook>(m, "BatchDecisionModel")
+      .def(py::init([](const mk::LevelIdentifier &level,
+                       std::vector<std::string> pheromoneNames,
+                       py::function callback, const std::string &profile) {
+             auto &account = mk::libs::CallbackProfiler::account(profile);
+             auto decide = [function = engineCallable(std::move(callback)),
+                            &account](
+                               const BatchPerception &perception,
+                               agents::LogoAgent::BatchDecisions &decisions) {
+               ProfiledCall profiled(account);
+               keepThreadState();
+               py::gil_scoped_acquire gil;
+               profiled.lockAcquired();
+               const auto rows =
+                   static_cast<py::ssize_t>(perception.rows.size());
+               const auto columns = static_cast<py::ssize_t>(
+                   perception.pheromoneNames.size());
+               // a base without ownership: the buffers outlive the call
+               py::capsule borrowed(&perception, [](void *) {});
+               py::object perceived =
+                   readOnlyView(perception.rows.data(), {rows}, borrowed);
+               py::object pheromones = readOnlyView(
+                   perception.pheromones.data(), {rows, columns}, borrowed);
+               py::object headingDeltas = py::array_t<double>(
+                   {rows}, decisions.headingDeltas.data(), borrowed);
+               py::object speedDeltas = py::array_t<double>(
+                   {rows}, decisions.speedDeltas.data(), borrowed);
+               profiled.argumentsConverted();
+               (*function)(perceived, pheromones, headingDeltas, speedDeltas);
+             };
+             return std::make_shared<BatchDecisionModel>(
+                 level, std::move(pheromoneNames), std::move(decide));
+           }),
+           py::arg("level"), py::arg("pheromone_names"), py::arg("callback"),
+           py::arg("profile") = "batch decision");
+
+  // ========== Compiled behaviors ==========
+  // The kernels of the behaviors compiled by similar2logo.dsl.compiler; the
+  // model they make is a BatchDecisionModel, so it is set the same way as
+  // the batch decision hook of the engine.
+  py::class_<agents::CompiledBehaviorLibrary,
+             std::shared_ptr<agents::CompiledBehaviorLibrary>>(
+      m, "CompiledBehaviorLibrary")
+      .def(py::init<const std::string &>(), py::arg("path"))
+      .def_property_readonly("path", &agents::CompiledBehaviorLibrary::getPath)
+      .def_property_readonly_static("ABI_VERSION", [](py::object) {
+        return agents::CompiledBehaviorLibrary::ABI_VERSION;
+      });
+
+  m.def(
+      "make_compiled_behavior",
+      [](const mk::LevelIdentifier &level,
+         std::shared_ptr<agents::CompiledBehaviorLibrary> library,
+         std::vector<std::string> pheromoneNames) {
+        return agents::makeCompiledBehavior(level, std::move(library),
+                                            std::move(pheromoneNames));
+      },
+      py::arg("level"), py::arg("library"), py::arg("pheromone_names"));
 
   // ========== ISimulationModel (Microkernel) ==========
   py::class_<mk::ISimulationModel, std::shared_ptr<mk::ISimulationModel>>(
@@ -170,53 +585,1109 @@ PYBIND11_MODULE(_core, m) {
       .def("set_agent_factory", &model::LogoSimulationModel::setAgentFactory)
       .def("add_pheromone", &model::LogoSimulationModel::addPheromone);
 
+  // ========== Step Timings ==========
+  // Durations are exposed in seconds.
+  auto seconds = [](mk::StepTimings::Duration mk::StepTimings::*phase) {
+    return [phase](const mk::StepTimings &timings) {
+      return std::chrono::duration<double>(timings.*phase).count();
+    };
+  };
+  py::class_<mk::StepTimings>(m, "StepTimings")
+      .def_property_readonly("time_lower_bound",
+                             [](const mk::StepTimings &timings) {
+                               return timings.timeLowerBound.getIdentifier();
+                             })
+      .def_property_readonly("time_upper_bound",
+                             [](const mk::StepTimings &timings) {
+                               return timings.timeUpperBound.getIdentifier();
+                             })
+      .def_property_readonly("perception",
+                             seconds(&mk::StepTimings::perception))
+      .def_property_readonly("revision", seconds(&mk::StepTimings::revision))
+      .def_property_readonly("decision", seconds(&mk::StepTimings::decision))
+      .def_property_readonly("agent_phase",
+                             seconds(&mk::StepTimings::agentPhase))
+      .def_property_readonly("merge", seconds(&mk::StepTimings::merge))
+      .def_property_readonly("reaction", seconds(&mk::StepTimings::reaction))
+      .def_property_readonly("structural_update",
+                             seconds(&mk::StepTimings::structuralUpdate))
+      .def_property_readonly("probes", seconds(&mk::StepTimings::probes))
+      .def_property_readonly("total", seconds(&mk::StepTimings::total))
+      .def_property_readonly("worker_busy",
+                             seconds(&mk::StepTimings::workerBusy))
+      .def_readonly("thread_count", &mk::StepTimings::threadCount)
+      .def_readonly("agent_count", &mk::StepTimings::agentCount)
+      .def_readonly("influence_count", &mk::StepTimings::influenceCount)
+      .def("thread_utilization", &mk::StepTimings::threadUtilization)
+      .def_readonly("counted", &mk::StepTimings::counted)
+      .def_readonly("counters", &mk::StepTimings::counters);
+
+  py::class_<mk::libs::CounterValues>(m, "CounterValues")
+      .def_readonly("cycles", &mk::libs::CounterValues::cycles)
+      .def_readonly("instructions", &mk::libs::CounterValues::instructions)
+      .def_readonly("cache_misses", &mk::libs::CounterValues::cacheMisses)
+      .def_readonly("branch_misses", &mk::libs::CounterValues::branchMisses)
+      .def("instructions_per_cycle",
+           &mk::libs::CounterValues::instructionsPerCycle)
+      .def("cache_misses_per_kilo_instruction",
+           &mk::libs::CounterValues::cacheMissesPerKiloInstruction);
+
+  using PhaseCounters = mk::StepTimings::PhaseCounters;
+  py::class_<PhaseCounters>(m, "PhaseCounters")
+      .def_readonly("agent_phase", &PhaseCounters::agentPhase)
+      .def_readonly("merge", &PhaseCounters::merge)
+      .def_readonly("reaction", &PhaseCounters::reaction)
+      .def_readonly("structural_update", &PhaseCounters::structuralUpdate)
+      .def_readonly("probes", &PhaseCounters::probes)
+      .def_readonly("total", &PhaseCounters::total);
+
+  py::class_<mk::IStepTimingListener,
+             std::shared_ptr<mk::IStepTimingListener>>(m,
+                                                       "StepTimingListener");
+
+  py::class_<mk::libs::StepTimingRecorder, mk::IStepTimingListener,
+             std::shared_ptr<mk::libs::StepTimingRecorder>>(
+      m, "StepTimingRecorder")
+      .def(py::init<size_t>(), py::arg("capacity") = 1024)
+      .def("get_timings", &mk::libs::StepTimingRecorder::getTimings)
+      .def("get_latest", &mk::libs::StepTimingRecorder::getLatest)
+      .def("get_recorded_steps",
+           &mk::libs::StepTimingRecorder::getRecordedSteps)
+      .def("clear", &mk::libs::StepTimingRecorder::clear);
+
+  py::class_<mk::libs::SimulationMetrics, mk::IStepTimingListener,
+             std::shared_ptr<mk::libs::SimulationMetrics>>(m,
+                                                           "SimulationMetrics")
+      .def(py::init<std::shared_ptr<mk::IStepTimingListener>>(),
+           py::arg("next") = nullptr)
+      .def_property_readonly("next", &mk::libs::SimulationMetrics::getNext)
+      .def("add_queue", &mk::libs::SimulationMetrics::addQueue,
+           py::arg("name"), py::arg("depth"))
+      .def("remove_queue", &mk::libs::SimulationMetrics::removeQueue,
+           py::arg("name"))
+      .def("get_steps", &mk::libs::SimulationMetrics::getSteps)
+      .def("get_steps_per_second",
+           &mk::libs::SimulationMetrics::getStepsPerSecond)
+      .def("get_bucket_counts", &mk::libs::SimulationMetrics::getBucketCounts,
+           py::arg("phase"))
+      .def("reset", &mk::libs::SimulationMetrics::reset)
+      .def("to_text", &mk::libs::SimulationMetrics::toText,
+           py::arg("open_metrics") = true)
+      .def_static("get_content_type",
+                  &mk::libs::SimulationMetrics::getContentType,
+                  py::arg("open_metrics") = true)
+      .def_property_readonly_static("BUCKET_BOUNDS", [](py::object) {
+        return std::vector<double>(
+            mk::libs::SimulationMetrics::BUCKET_BOUNDS.begin(),
+            mk::libs::SimulationMetrics::BUCKET_BOUNDS.end());
+      });
+
+  // The tracer of the process, recording the phases run by each thread
+  m.def(
+      "set_tracing",
+      [](bool enable) {
+        mk::libs::ExecutionTracer::global().setEnabled(enable);
+      },
+      py::arg("enable"));
+  m.def("is_tracing",
+        []() { return mk::libs::ExecutionTracer::global().isEnabled(); });
+  m.def("clear_trace", []() { mk::libs::ExecutionTracer::global().clear(); });
+  m.def(
+      "write_chrome_trace",
+      [](const std::string &path) {
+        mk::libs::ExecutionTracer::global().writeChromeTrace(path);
+      },
+      py::arg("path"));
+
+  // The memory of the subsystems of the process, counted by their
+  // allocators
+  py::class_<mk::libs::MemoryUsage>(m, "MemoryUsage")
+      .def_readonly("subsystem", &mk::libs::MemoryUsage::subsystem)
+      .def_readonly("live_bytes", &mk::libs::MemoryUsage::liveBytes)
+      .def_readonly("peak_bytes", &mk::libs::MemoryUsage::peakBytes)
+      .def_readonly("allocations", &mk::libs::MemoryUsage::allocations)
+      .def("__repr__", [](const mk::libs::MemoryUsage &usage) {
+        return "<MemoryUsage " + usage.subsystem +
+               " live=" + std::to_string(usage.liveBytes) +
+               " peak=" + std::to_string(usage.peakBytes) + ">";
+      });
+  m.def("memory_usage", &mk::libs::MemoryAccounting::snapshot);
+  m.def("reset_memory_peaks", &mk::libs::MemoryAccounting::resetPeaks);
+
+  // The time spent in the Python callbacks of the models, by profile name
+  auto profileSeconds =
+      [](mk::libs::CallbackProfile::Duration mk::libs::CallbackProfile::*part) {
+        return [part](const mk::libs::CallbackProfile &profile) {
+          return std::chrono::duration<double>(profile.*part).count();
+        };
+      };
+  py::class_<mk::libs::CallbackProfile>(m, "CallbackProfile")
+      .def_readonly("callback", &mk::libs::CallbackProfile::callback)
+      .def_readonly("calls", &mk::libs::CallbackProfile::calls)
+      .def_property_readonly("total",
+                             profileSeconds(&mk::libs::CallbackProfile::total))
+      .def_property_readonly(
+          "gil_wait", profileSeconds(&mk::libs::CallbackProfile::lockWait))
+      .def_property_readonly(
+          "conversion",
+          profileSeconds(&mk::libs::CallbackProfile::conversion))
+      .def("__repr__", [](const mk::libs::CallbackProfile &profile) {
+        return "<CallbackProfile " + profile.callback +
+               " calls=" + std::to_string(profile.calls) + " total=" +
+               std::to_string(
+                   std::chrono::duration<double>(profile.total).count()) +
+               "s>";
+      });
+  m.def("set_callback_profiling", &mk::libs::CallbackProfiler::setEnabled,
+        py::arg("enabled"));
+  m.def("is_callback_profiling", &mk::libs::CallbackProfiler::isEnabled);
+  m.def("callback_profiles", &mk::libs::CallbackProfiler::snapshot);
+  m.def("reset_callback_profiles", &mk::libs::CallbackProfiler::reset);
+
+  // ========== Statistics probes ==========
+  // The statistics are computed in C++ on the engine workers, from the
+  // fields of the turtles; get_results() returns copies of the last ones.
+  namespace ek_probes =
+      fr::univ_artois::lgi2a::similar::extendedkernel::libs::probes;
+  py::class_<mk::IProbe, std::shared_ptr<mk::IProbe>>(m, "Probe");
+
+  py::class_<ek_probes::RunningMoments>(m, "RunningMoments")
+      .def_property_readonly("count", &ek_probes::RunningMoments::count)
+      .def_property_readonly("mean", &ek_probes::RunningMoments::mean)
+      .def_property_readonly("variance", &ek_probes::RunningMoments::variance)
+      .def_property_readonly("sample_variance",
+                             &ek_probes::RunningMoments::sampleVariance)
+      .def_property_readonly("min", &ek_probes::RunningMoments::min)
+      .def_property_readonly("max", &ek_probes::RunningMoments::max);
+
+  py::class_<ek_probes::FixedBinHistogram>(m, "FixedBinHistogram")
+      .def_property_readonly(
+          "counts",
+          [](const ek_probes::FixedBinHistogram &histogram) {
+            return py::array_t<std::uint64_t>(
+                static_cast<py::ssize_t>(histogram.counts().size()),
+                histogram.counts().data());
+          })
+      .def_property_readonly("underflow",
+                             &ek_probes::FixedBinHistogram::underflow)
+      .def_property_readonly("overflow",
+                             &ek_probes::FixedBinHistogram::overflow)
+      .def_property_readonly("total", &ek_probes::FixedBinHistogram::total)
+      .def_property_readonly("min", &ek_probes::FixedBinHistogram::min)
+      .def_property_readonly("max", &ek_probes::FixedBinHistogram::max)
+      .def("quantile", &ek_probes::FixedBinHistogram::quantile, py::arg("q"));
+
+  py::class_<ek_probes::QuantileSketch>(m, "QuantileSketch")
+      .def_property_readonly("count", &ek_probes::QuantileSketch::count)
+      .def_property_readonly("relative_accuracy",
+                             &ek_probes::QuantileSketch::relativeAccuracy)
+      .def("quantile", &ek_probes::QuantileSketch::quantile, py::arg("q"));
+
+  py::class_<ek_probes::DensityGrid>(m, "DensityGrid")
+      .def_property_readonly(
+          "counts",
+          [](const ek_probes::DensityGrid &grid) {
+            return py::array_t<std::uint64_t>(
+                {static_cast<py::ssize_t>(grid.rows()),
+                 static_cast<py::ssize_t>(grid.columns())},
+                grid.counts().data());
+          },
+          "The counts of the cells, of shape (rows, columns).")
+      .def_property_readonly("outside", &ek_probes::DensityGrid::outsideCount)
+      .def_property_readonly("cell_size", &ek_probes::DensityGrid::cellSize);
+
+  py::class_<StatisticsProbe, mk::IProbe, std::shared_ptr<StatisticsProbe>>(
+      m, "StatisticsProbe")
+      .def(py::init<std::size_t>(), py::arg("chunk_size") = 1024)
+      .def(
+          "add_moments",
+          [](StatisticsProbe &probe, const std::string &name,
+             const std::string &field) {
+            probe.addMoments(name, turtleField(field));
+          },
+          py::arg("name"), py::arg("field"))
+      .def(
+          "add_histogram",
+          [](StatisticsProbe &probe, const std::string &name,
+             const std::string &field, double min, double max,
+             std::size_t bins) {
+            probe.addHistogram(name, turtleField(field), min, max, bins);
+          },
+          py::arg("name"), py::arg("field"), py::arg("min"), py::arg("max"),
+          py::arg("bins"))
+      .def(
+          "add_quantiles",
+          [](StatisticsProbe &probe, const std::string &name,
+             const std::string &field, double relativeAccuracy) {
+            probe.addQuantiles(name, turtleField(field), relativeAccuracy);
+          },
+          py::arg("name"), py::arg("field"),
+          py::arg("relative_accuracy") = 0.01)
+      .def(
+          "add_category_counts",
+          [](StatisticsProbe &probe, const std::string &name) {
+            probe.addCategoryCounts(name);
+          },
+          py::arg("name"), "Counts the agents by their category.")
+      .def(
+          "add_density_grid",
+          [](StatisticsProbe &probe, const std::string &name, double originX,
+             double originY, double cellSize, std::size_t columns,
+             std::size_t rows) {
+            probe.addDensityGrid(
+                name,
+                [](const mk::agents::IAgent4Engine &agent) {
+                  const auto *turtle = turtleOf(agent);
+                  if (!turtle) {
+                    return std::make_pair(std::nan(""), std::nan(""));
+                  }
+                  const auto location = turtle->getLocation();
+                  return std::make_pair(location.x, location.y);
+                },
+                originX, originY, cellSize, columns, rows);
+          },
+          py::arg("name"), py::arg("origin_x"), py::arg("origin_y"),
+          py::arg("cell_size"), py::arg("columns"), py::arg("rows"))
+      .def(
+          "set_sampling",
+          [](StatisticsProbe &probe, std::size_t k, std::size_t n,
+             bool stratified, std::uint64_t seed) {
+            probe.setSampler(std::make_shared<ek_probes::AgentSampler>(
+                k, n, stratified, seed));
+          },
+          py::arg("k"), py::arg("n"), py::arg("stratified") = true,
+          py::arg("seed") = 0,
+          "Computes the statistics over k agents of every n, of each "
+          "category when stratified.")
+      .def(
+          "clear_sampling",
+          [](StatisticsProbe &probe) { probe.setSampler(nullptr); })
+      .def(
+          "get_results",
+          [](const StatisticsProbe &probe) {
+            const auto results = probe.getResults();
+            py::dict moments;
+            for (const auto &entry : results->moments) {
+              moments[py::str(entry.first)] = entry.second;
+            }
+            py::dict histograms;
+            for (const auto &entry : results->histograms) {
+              histograms[py::str(entry.first)] = entry.second;
+            }
+            py::dict sketches;
+            for (const auto &entry : results->sketches) {
+              sketches[py::str(entry.first)] = entry.second;
+            }
+            py::dict counters;
+            for (const auto &entry : results->counters) {
+              counters[py::str(entry.first)] = entry.second.counts();
+            }
+            py::dict grids;
+            for (const auto &entry : results->grids) {
+              grids[py::str(entry.first)] = entry.second;
+            }
+            py::dict dict;
+            dict["time"] = results->time;
+            dict["agents"] = results->agents;
+            dict["moments"] = moments;
+            dict["histograms"] = histograms;
+            dict["quantiles"] = sketches;
+            dict["categories"] = counters;
+            dict["grids"] = grids;
+            return dict;
+          },
+          "The statistics of the last observation, time being -1 before "
+          "any.");
+
+  // ========== Observation schedules ==========
+  py::class_<mk::engine::IObservationSchedule,
+             std::shared_ptr<mk::engine::IObservationSchedule>>(
+      m, "ObservationSchedule");
+  py::class_<mk::engine::PeriodicObservationSchedule,
+             mk::engine::IObservationSchedule,
+             std::shared_ptr<mk::engine::PeriodicObservationSchedule>>(
+      m, "PeriodicObservationSchedule")
+      .def(py::init<std::size_t>(), py::arg("period"));
+  py::class_<mk::engine::RateLimitedObservationSchedule,
+             mk::engine::IObservationSchedule,
+             std::shared_ptr<mk::engine::RateLimitedObservationSchedule>>(
+      m, "RateLimitedObservationSchedule")
+      .def(py::init([](double seconds) {
+             return std::make_shared<
+                 mk::engine::RateLimitedObservationSchedule>(
+                 std::chrono::duration_cast<
+                     std::chrono::steady_clock::duration>(
+                     std::chrono::duration<double>(seconds)));
+           }),
+           py::arg("seconds"));
+  py::class_<mk::engine::TriggeredObservationSchedule,
+             mk::engine::IObservationSchedule,
+             std::shared_ptr<mk::engine::TriggeredObservationSchedule>>(
+      m, "TriggeredObservationSchedule")
+      .def(py::init<>())
+      .def("trigger", &mk::engine::TriggeredObservationSchedule::trigger,
+           "Observes the next step, from any thread.");
+
+  // ========== Step barrier ==========
+  // The pacing of the engine between its steps, in C++: the paced waits
+  // neither hold the GIL nor drift (see StepBarrier.h).
+  using mk::engine::StepBarrier;
+  py::class_<StepBarrier::PacingStatistics>(m, "PacingStatistics")
+      .def_readonly("steps", &StepBarrier::PacingStatistics::steps)
+      .def_readonly("resynchronizations",
+                    &StepBarrier::PacingStatistics::resynchronizations)
+      .def_readonly("mean_lateness_seconds",
+                    &StepBarrier::PacingStatistics::meanLatenessSeconds)
+      .def_readonly("max_lateness_seconds",
+                    &StepBarrier::PacingStatistics::maxLatenessSeconds);
+  py::class_<StepBarrier, std::shared_ptr<StepBarrier>>(m, "StepBarrier")
+      .def(py::init<>())
+      .def("pause", &StepBarrier::pause)
+      .def("resume", &StepBarrier::resume)
+      .def("step", &StepBarrier::step, py::arg("count") = 1)
+      .def("interrupt", &StepBarrier::interrupt)
+      .def_property_readonly("paused", &StepBarrier::isPaused)
+      .def_property("step_rate", &StepBarrier::getStepRate,
+                    &StepBarrier::setStepRate,
+                    "The steps per second at most, 0 for no limit.")
+      .def_property("acceleration", &StepBarrier::getAcceleration,
+                    &StepBarrier::setAcceleration)
+      .def_property(
+          "spin_threshold_seconds",
+          [](const StepBarrier &barrier) {
+            return std::chrono::duration<double>(barrier.getSpinThreshold())
+                .count();
+          },
+          [](StepBarrier &barrier, double seconds) {
+            if (!(seconds >= 0)) {
+              throw std::invalid_argument(
+                  "the spin threshold must be a non-negative number");
+            }
+            barrier.setSpinThreshold(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::duration<double>(seconds)));
+          },
+          "The last part of each paced wait spent spinning, not sleeping.")
+      .def_property_readonly("pacing_statistics",
+                             &StepBarrier::getPacingStatistics);
+
   // ========== Multithreaded Engine ==========
-  py::class_<mk::engine::MultiThreadedSimulationEngine,
-             std::shared_ptr<mk::engine::MultiThreadedSimulationEngine>>(
-      m, "MultiThreadedEngine")
+  // The running methods release the GIL: other Python threads keep running
+  // while the engine threads simulate, the Python callbacks of the models
+  // acquiring it again. A step is run in the background by calling
+  // run_simulation from another thread (see cpp_engine.py).
+  using Engine = mk::engine::MultiThreadedSimulationEngine;
+  py::class_<Engine, std::shared_ptr<Engine>>(m, "MultiThreadedEngine")
       .def(py::init<size_t>(), py::arg("num_threads") = 0)
-      .def("run_new_simulation",
-           &mk::engine::MultiThreadedSimulationEngine::runNewSimulation)
-      .def("run_simulation",
-           &mk::engine::MultiThreadedSimulationEngine::runSimulation)
-      .def("clone", &mk::engine::MultiThreadedSimulationEngine::clone);
+      .def("run_new_simulation", &Engine::runNewSimulation, py::arg("model"),
+           py::call_guard<py::gil_scoped_release>())
+      .def("initialize_simulation", &Engine::initializeSimulation,
+           py::arg("model"), py::call_guard<py::gil_scoped_release>())
+      .def("start_simulation", &Engine::startSimulation,
+           py::call_guard<py::gil_scoped_release>())
+      .def(
+          "run_simulation",
+          [](Engine &engine, long finalTime) {
+            engine.runSimulation(mk::SimulationTimeStamp(finalTime));
+          },
+          py::arg("final_time"), py::call_guard<py::gil_scoped_release>(),
+          "Runs the steps until the time final_time, or the end of the "
+          "simulation.")
+      .def("get_current_time",
+           [](const Engine &engine) {
+             return engine.getCurrentTime().getIdentifier();
+           })
+      .def("request_simulation_abortion", &Engine::requestSimulationAbortion)
+      .def("set_step_barrier", &Engine::setStepBarrier, py::arg("barrier"))
+      .def("get_step_barrier", &Engine::getStepBarrier)
+      .def("set_step_timing_listener", &Engine::setStepTimingListener,
+           py::arg("listener"))
+      .def("get_step_timing_listener", &Engine::getStepTimingListener)
+      .def("set_performance_counting", &Engine::setPerformanceCounting,
+           py::arg("enabled"))
+      .def("is_performance_counting", &Engine::isPerformanceCounting)
+      .def("get_memory_usage", &Engine::getMemoryUsage)
+      .def("get_callback_profiles", &Engine::getCallbackProfiles)
+      .def("set_batch_decision_hook", &Engine::setBatchDecisionHook,
+           py::arg("hook"))
+      .def("get_batch_decision_hook", &Engine::getBatchDecisionHook)
+      .def("add_probe", &Engine::addProbe, py::arg("name"), py::arg("probe"))
+      .def("remove_probe", &Engine::removeProbe, py::arg("name"))
+      .def("set_observation_schedule", &Engine::setObservationSchedule,
+           py::arg("name"), py::arg("schedule"))
+      .def("get_observation_schedule", &Engine::getObservationSchedule,
+           py::arg("name"))
+      .def("fork", &Engine::fork,
+           "Forks the initialized simulation at its current time; the fork "
+           "shares the pheromone fields and the marks until it writes them.")
+      .def("clone", &Engine::clone);
+
+  // ========== Model plugins ==========
+  // A plugin loaded by Python links its own copy of the kernel libraries:
+  // the symbols of this module are not visible to the libraries it loads.
+  using mk::engine::ModelPlugin;
+  py::class_<ModelPlugin, std::shared_ptr<ModelPlugin>>(m, "ModelPlugin")
+      .def(py::init<const std::string &>(), py::arg("path"))
+      .def_property_readonly("path", &ModelPlugin::getPath)
+      .def_property_readonly_static(
+          "ABI_VERSION", [](py::object) { return ModelPlugin::ABI_VERSION; })
+      .def("create_model", &ModelPlugin::createModel,
+           py::arg("arguments") = "")
+      .def_property_readonly(
+          "batch_behaviors",
+          [](const ModelPlugin &plugin) {
+            std::vector<std::pair<std::string, std::string>> behaviors;
+            for (std::size_t i = 0; i < plugin.getBatchBehaviorCount(); ++i) {
+              behaviors.emplace_back(plugin.getBatchBehavior(i).category,
+                                     plugin.getBatchBehavior(i).level);
+            }
+            return behaviors;
+          },
+          "The (category, level) of the batch behaviors of the plugin.")
+      .def(
+          "install_batch_behaviors",
+          [](const ModelPlugin &plugin, Engine &engine) {
+            return plugin.installBatchBehaviors(engine);
+          },
+          py::arg("engine"));
+
+  // ========== Spatial hash grid ==========
+  // The index of spatial.py, on integer keys: the Python wrapper maps its
+  // objects to keys. The queries sort the changed points first, holding the
+  // lock alone meanwhile, then run in parallel.
+  using tools::SpatialHashGrid;
+  py::class_<SpatialHashGrid>(m, "SpatialHashGrid")
+      .def(py::init<double, double, double, bool>(), py::arg("cell_size"),
+           py::arg("width"), py::arg("height"), py::arg("toroidal") = false)
+      .def_property_readonly("width", &SpatialHashGrid::getWidth)
+      .def_property_readonly("height", &SpatialHashGrid::getHeight)
+      .def_property_readonly("toroidal", &SpatialHashGrid::isToroidal)
+      .def("__len__", query(&SpatialHashGrid::size))
+      .def("__contains__", query(&SpatialHashGrid::contains))
+      .def("clear", update(&SpatialHashGrid::clear))
+      .def("insert", update(&SpatialHashGrid::insert), py::arg("key"),
+           py::arg("x"), py::arg("y"))
+      .def("update", update(&SpatialHashGrid::update), py::arg("key"),
+           py::arg("x"), py::arg("y"))
+      .def("remove", update(&SpatialHashGrid::remove), py::arg("key"))
+      .def(
+          "rebuild",
+          [](SpatialHashGrid &grid, const DoubleArray &x,
+             const DoubleArray &y) {
+            if (x.ndim() != 1 || y.ndim() != 1 || x.size() != y.size()) {
+              throw std::invalid_argument(
+                  "expected two 1-D arrays of the same length");
+            }
+            py::gil_scoped_release release;
+            const ExclusiveAccess lock = exclusiveAccess(grid);
+            grid.rebuild(x.data(), y.data(),
+                         static_cast<std::size_t>(x.size()));
+          },
+          py::arg("x"), py::arg("y"),
+          "Replaces the points by the ones of keys 0 to len(x) - 1.")
+      .def(
+          "query_radius",
+          [](SpatialHashGrid &grid, double x, double y, double radius,
+             std::int64_t exclude) {
+            std::vector<std::uint32_t> keys;
+            std::vector<double> distances;
+            {
+              SharedAccess lock = sharedAccess(grid);
+              while (grid.needsRefresh()) {
+                lock.unlock();
+                {
+                  const ExclusiveAccess sorting = exclusiveAccess(grid);
+                  grid.refresh();
+                }
+                lock = sharedAccess(grid);
+              }
+              grid.forEachInRadius(
+                  x, y, radius,
+                  exclude < 0 ? SpatialHashGrid::NO_KEY
+                              : static_cast<std::uint32_t>(exclude),
+                  [&](std::uint32_t key, double distance) {
+                    keys.push_back(key);
+                    distances.push_back(distance);
+                  });
+            }
+            return py::make_tuple(
+                py::array_t<std::uint32_t>(keys.size(), keys.data()),
+                py::array_t<double>(distances.size(), distances.data()));
+          },
+          py::arg("x"), py::arg("y"), py::arg("radius"),
+          py::arg("exclude") = -1,
+          "Gets the arrays of the keys and the distances of the points "
+          "within radius of (x, y).");
+
+  // ========== Frame encoder ==========
+  // The binary frames of the web view (see FrameEncoder.h for their
+  // layout), returned as bytes; an encoder serves a single client.
+  using tools::FrameEncoder;
+  using ByteArray = py::array_t<std::uint8_t, py::array::c_style |
+                                                  py::array::forcecast>;
+  py::class_<FrameEncoder>(m, "FrameEncoder")
+      .def(py::init<double, double, int>(), py::arg("width"),
+           py::arg("height"), py::arg("tile_size") = 16)
+      .def_property_readonly("width", &FrameEncoder::getWidth)
+      .def_property_readonly("height", &FrameEncoder::getHeight)
+      .def_property_readonly("tile_size", &FrameEncoder::getTileSize)
+      .def_property_readonly("palette", &FrameEncoder::getPalette)
+      .def("color_index", &FrameEncoder::colorIndex, py::arg("color"))
+      .def("add_pheromone", &FrameEncoder::addPheromone,
+           py::arg("identifier"), py::arg("columns"), py::arg("rows"),
+           py::arg("max_value"))
+      .def("request_keyframe", &FrameEncoder::requestKeyframe)
+      .def(
+          "encode",
+          [](FrameEncoder &encoder, std::uint64_t step, const DoubleArray &x,
+             const DoubleArray &y, const DoubleArray &heading,
+             const ByteArray &colors, const std::vector<DoubleArray> &grids) {
+            const auto count = static_cast<std::size_t>(x.size());
+            checkTurtleCount(x, count);
+            checkTurtleCount(y, count);
+            checkTurtleCount(heading, count);
+            if (colors.ndim() != 1 ||
+                static_cast<std::size_t>(colors.size()) != count) {
+              throw std::invalid_argument("expected one color per turtle");
+            }
+            if (grids.size() != encoder.getPheromoneCount()) {
+              throw std::invalid_argument("expected one grid per pheromone");
+            }
+            std::vector<const double *> values;
+            for (std::size_t k = 0; k < grids.size(); ++k) {
+              if (grids[k].ndim() != 2 ||
+                  grids[k].shape(0) != encoder.getPheromoneRows(k) ||
+                  grids[k].shape(1) != encoder.getPheromoneColumns(k)) {
+                throw std::invalid_argument(
+                    "expected a grid of shape (rows, columns) for " +
+                    encoder.getPheromoneIdentifier(k));
+              }
+              values.push_back(grids[k].data());
+            }
+            const std::vector<std::uint8_t> *frame;
+            {
+              py::gil_scoped_release release;
+              frame = &encoder.encode(step, x.data(), y.data(), heading.data(),
+                                      colors.data(), count, values.data());
+            }
+            return py::bytes(reinterpret_cast<const char *>(frame->data()),
+                             frame->size());
+          },
+          py::arg("step"), py::arg("x"), py::arg("y"), py::arg("heading"),
+          py::arg("colors"), py::arg("pheromones") = std::vector<DoubleArray>(),
+          "Encodes a frame from the columns of the turtles, the palette "
+          "indices of their colors and a (rows, columns) grid per pheromone.")
+      .def(
+          "encode_environment",
+          [](FrameEncoder &encoder, std::uint64_t step,
+             const similar2logo::kernel::environment::Environment &env) {
+            const SharedAccess lock = sharedAccess(env);
+            const auto &store = env.get_turtle_store();
+            const std::size_t count = store.size();
+            // the palette indices of the color indices of the store
+            std::vector<int> indices;
+            std::vector<std::uint8_t> colors(count);
+            for (std::size_t i = 0; i < count; ++i) {
+              const std::uint32_t color = store.color[i];
+              if (color >= indices.size()) {
+                indices.resize(color + std::size_t(1), -1);
+              }
+              if (indices[color] < 0) {
+                indices[color] = encoder.colorIndex(store.colorName(color));
+              }
+              colors[i] = static_cast<std::uint8_t>(indices[color]);
+            }
+            std::vector<const double *> values;
+            for (std::size_t k = 0; k < encoder.getPheromoneCount(); ++k) {
+              const auto &identifier = encoder.getPheromoneIdentifier(k);
+              const auto pheromone = env.find_pheromone(identifier);
+              if (!pheromone) {
+                throw std::invalid_argument("unknown pheromone: " +
+                                            identifier);
+              }
+              if (env.width() != encoder.getPheromoneColumns(k) ||
+                  env.height() != encoder.getPheromoneRows(k)) {
+                throw std::invalid_argument(
+                    "the grid of " + identifier +
+                    " was added with another size than the environment");
+              }
+              values.push_back(env.get_pheromone_values(*pheromone).data());
+            }
+            const std::vector<std::uint8_t> *frame;
+            {
+              py::gil_scoped_release release;
+              frame = &encoder.encode(step, store.x.data(), store.y.data(),
+                                      store.heading.data(), colors.data(),
+                                      count, values.data());
+            }
+            return py::bytes(reinterpret_cast<const char *>(frame->data()),
+                             frame->size());
+          },
+          py::arg("step"), py::arg("environment"),
+          "Encodes a frame of the turtles and the pheromones of an "
+          "environment, whose grids must have been added with their size.");
+
+  // ========== Heatmap tiles ==========
+  // The PNG tiles of the pheromone heatmaps (see HeatmapTileRenderer.h),
+  // re-encoded when they are requested after a change only.
+  using tools::HeatmapTileRenderer;
+  py::class_<HeatmapTileRenderer, std::shared_ptr<HeatmapTileRenderer>>(
+      m, "HeatmapTileRenderer")
+      .def(py::init<int>(),
+           py::arg("tile_size") = HeatmapTileRenderer::DEFAULT_TILE_SIZE)
+      .def_property_readonly("tile_size", &HeatmapTileRenderer::getTileSize)
+      .def_property_readonly("encoded_tile_count",
+                             &HeatmapTileRenderer::getEncodedTileCount)
+      .def(
+          "add_layer",
+          [](HeatmapTileRenderer &renderer, const std::string &name,
+             int columns, int rows, double maxValue) {
+            renderer.addLayer(name, columns, rows, maxValue);
+          },
+          py::arg("name"), py::arg("columns"), py::arg("rows"),
+          py::arg("max_value"))
+      .def("has_layer", &HeatmapTileRenderer::hasLayer, py::arg("name"))
+      .def_property_readonly("layer_names",
+                             &HeatmapTileRenderer::getLayerNames)
+      .def("max_zoom", &HeatmapTileRenderer::getMaxZoom, py::arg("name"))
+      .def(
+          "update",
+          [](HeatmapTileRenderer &renderer, const std::string &name,
+             const DoubleArray &values) {
+            if (values.ndim() != 2) {
+              throw std::invalid_argument(
+                  "expected a grid of shape (rows, columns)");
+            }
+            py::gil_scoped_release release;
+            return renderer.update(name, values.data());
+          },
+          py::arg("name"), py::arg("values"),
+          "Renders a (rows, columns) grid, returning the number of tiles "
+          "changed at the finest zoom.")
+      .def(
+          "update_environment",
+          [](HeatmapTileRenderer &renderer,
+             const similar2logo::kernel::environment::Environment &env) {
+            std::size_t changed = 0;
+            py::gil_scoped_release release;
+            const SharedAccess lock = sharedAccess(env);
+            for (const auto &name : renderer.getLayerNames()) {
+              if (const auto pheromone = env.find_pheromone(name)) {
+                changed +=
+                    renderer.update(name, env.get_pheromone_field(*pheromone));
+              }
+            }
+            return changed;
+          },
+          py::arg("environment"),
+          "Renders the pheromones of an environment that have a layer, "
+          "comparing their active tiles only.")
+      .def("describe_layers", &HeatmapTileRenderer::describeLayers)
+      .def(
+          "get_tile",
+          [](HeatmapTileRenderer &renderer, const std::string &layer, int zoom,
+             int x, int y) -> py::object {
+            HeatmapTileRenderer::Tile tile;
+            {
+              py::gil_scoped_release release;
+              tile = renderer.getTile(layer, zoom, x, y);
+            }
+            if (!tile.data) {
+              return py::none();
+            }
+            return py::make_tuple(py::bytes(*tile.data), tile.version);
+          },
+          py::arg("layer"), py::arg("zoom"), py::arg("x"), py::arg("y"),
+          "Gets the PNG file and the version of a tile, None if it does not "
+          "exist.");
 
   // ========== Environment (New) ==========
   auto env_module = m.def_submodule("environment", "Environment module");
 
-  py::class_<similar2logo::kernel::environment::Environment>(env_module,
-                                                             "Environment")
+  using Environment = similar2logo::kernel::environment::Environment;
+  py::class_<Environment::PheromoneHandle>(env_module, "PheromoneHandle")
+      .def_readonly("index", &Environment::PheromoneHandle::index)
+      .def("__eq__", &Environment::PheromoneHandle::operator==);
+
+  py::class_<Environment::GradientSample>(env_module, "GradientSample")
+      .def_readonly("left", &Environment::GradientSample::left)
+      .def_readonly("ahead", &Environment::GradientSample::ahead)
+      .def_readonly("right", &Environment::GradientSample::right);
+
+  py::class_<Environment::MarkChange>(env_module, "MarkChange")
+      .def_readonly("x", &Environment::MarkChange::x)
+      .def_readonly("y", &Environment::MarkChange::y)
+      .def_readonly("mark", &Environment::MarkChange::mark)
+      .def_readonly("added", &Environment::MarkChange::added);
+
+  py::class_<Environment::PheromoneTiles>(env_module, "PheromoneTiles")
+      .def_readonly("pheromone", &Environment::PheromoneTiles::pheromone)
+      .def_readonly("tiles", &Environment::PheromoneTiles::tiles)
+      .def_readonly("values", &Environment::PheromoneTiles::values);
+
+  py::class_<Environment::TurtleChange>(env_module, "TurtleChange")
+      .def_readonly("id", &Environment::TurtleChange::id)
+      .def_readonly("turtle", &Environment::TurtleChange::turtle);
+
+  py::class_<Environment::Changes>(env_module, "Changes")
+      .def_readonly("complete", &Environment::Changes::complete)
+      .def_readonly("until", &Environment::Changes::until)
+      .def_readonly("pheromones", &Environment::Changes::pheromones)
+      .def_readonly("marks", &Environment::Changes::marks)
+      .def_readonly("turtles", &Environment::Changes::turtles)
+      .def_readonly("removed_turtles",
+                    &Environment::Changes::removed_turtles);
+
+  py::class_<Environment::CrowdSettings>(env_module, "CrowdSettings")
+      .def(py::init<>())
+      .def_readwrite("region_size", &Environment::CrowdSettings::region_size)
+      .def_readwrite("aggregate_density",
+                     &Environment::CrowdSettings::aggregate_density)
+      .def_readwrite("release_density",
+                     &Environment::CrowdSettings::release_density);
+  py::enum_<similar2logo::kernel::tools::FieldDiffusion::Scheme>(
+      env_module, "DiffusionScheme")
+      .value("EXPLICIT",
+             similar2logo::kernel::tools::FieldDiffusion::Scheme::EXPLICIT)
+      .value("SPECTRAL",
+             similar2logo::kernel::tools::FieldDiffusion::Scheme::SPECTRAL);
+  py::class_<Environment>(env_module, "Environment")
       .def(py::init<int, int, bool>(), py::arg("width"), py::arg("height"),
            py::arg("toroidal") = false)
-      .def("add_pheromone",
-           &similar2logo::kernel::environment::Environment::add_pheromone,
+      .def("add_pheromone", update(&Environment::add_pheromone),
            py::arg("identifier"), py::arg("diffusion_coef") = 0.0,
            py::arg("evaporation_coef") = 0.0, py::arg("default_value") = 0.0,
            py::arg("min_value") = 0.0)
+      .def("find_pheromone", query(&Environment::find_pheromone),
+           py::arg("identifier"))
       .def("set_pheromone",
-           &similar2logo::kernel::environment::Environment::set_pheromone,
+           update(py::overload_cast<double, double,
+                                    Environment::PheromoneHandle, double>(
+               &Environment::set_pheromone)),
+           py::arg("x"), py::arg("y"), py::arg("pheromone"), py::arg("value"))
+      .def("set_pheromone",
+           update(py::overload_cast<double, double, const std::string &,
+                                    double>(&Environment::set_pheromone)),
            py::arg("x"), py::arg("y"), py::arg("identifier"), py::arg("value"))
       .def("get_pheromone_value",
-           &similar2logo::kernel::environment::Environment::get_pheromone_value,
+           query(py::overload_cast<double, double,
+                                   Environment::PheromoneHandle>(
+               &Environment::get_pheromone_value, py::const_)),
+           py::arg("x"), py::arg("y"), py::arg("pheromone"))
+      .def("get_pheromone_value",
+           query(py::overload_cast<double, double, const std::string &>(
+               &Environment::get_pheromone_value, py::const_)),
            py::arg("x"), py::arg("y"), py::arg("identifier"))
+      // The grid as a (height, width) array sharing the memory of the
+      // environment, read-only since a write would bypass the tracking of
+      // the active tiles. It is only valid until the next
+      // diffuse_and_evaporate(), which exchanges the buffers.
+      .def(
+          "get_pheromone_array",
+          [](py::object self, Environment::PheromoneHandle pheromone) {
+            const Environment &env = self.cast<const Environment &>();
+            const double *values;
+            {
+              const SharedAccess lock = sharedAccess(env);
+              values = env.get_pheromone_values(pheromone).data();
+            }
+            return readOnlyView(values, {env.height(), env.width()}, self);
+          },
+          py::arg("pheromone"))
+      .def(
+          "set_pheromone_array",
+          [](Environment &env, Environment::PheromoneHandle pheromone,
+             const DoubleArray &values) {
+            if (values.ndim() != 2 || values.shape(0) != env.height() ||
+                values.shape(1) != env.width()) {
+              throw std::invalid_argument(
+                  "expected an array of shape (height, width)");
+            }
+            py::gil_scoped_release release;
+            const ExclusiveAccess lock = exclusiveAccess(env);
+            env.set_pheromone_values(pheromone, values.data());
+          },
+          py::arg("pheromone"), py::arg("values"))
+      .def("sample_pheromone", query(&Environment::sample_pheromone),
+           py::arg("x"), py::arg("y"), py::arg("pheromone"))
+      .def("sample_gradient",
+           query(py::overload_cast<
+                 const similar2logo::kernel::tools::Point2D &, double, double,
+                 double, Environment::PheromoneHandle>(
+               &Environment::sample_gradient, py::const_)),
+           py::arg("point"), py::arg("heading"), py::arg("angle"),
+           py::arg("distance"), py::arg("pheromone"))
+      .def(
+          "sample_gradient",
+          [](const Environment &env,
+             const similar2logo::kernel::tools::Point2D &point,
+             double heading, const std::vector<double> &angles,
+             double distance, Environment::PheromoneHandle pheromone) {
+            std::vector<double> readings(angles.size());
+            const SharedAccess lock = sharedAccess(env);
+            env.sample_gradient(point, heading, angles.data(), angles.size(),
+                                distance, pheromone, readings.data());
+            return readings;
+          },
+          py::arg("point"), py::arg("heading"), py::arg("angles"),
+          py::arg("distance"), py::arg("pheromone"))
+      .def("sample_gradient_all", query(&Environment::sample_gradient_all),
+           py::arg("angle"), py::arg("distance"), py::arg("pheromone"))
+      // The pyramids of the grids, for the queries over large radii
+      .def(
+          "enable_pheromone_pyramid",
+          [](Environment &env, Environment::PheromoneHandle pheromone,
+             const std::string &reduction) {
+            using Reduction = similar2logo::kernel::tools::PheromonePyramid::
+                Reduction;
+            if (reduction != "max" && reduction != "mean") {
+              throw std::invalid_argument(
+                  "the reduction is \"max\" or \"mean\"");
+            }
+            const ExclusiveAccess lock = exclusiveAccess(env);
+            env.enable_pheromone_pyramid(pheromone, reduction == "max"
+                                                        ? Reduction::MAX
+                                                        : Reduction::MEAN);
+          },
+          py::arg("pheromone"), py::arg("reduction") = "max")
+      .def("update_pheromone_pyramids",
+           update(&Environment::update_pheromone_pyramids))
+      .def(
+          "strongest_pheromone_within",
+          [](const Environment &env,
+             const similar2logo::kernel::tools::Point2D &point, double radius,
+             Environment::PheromoneHandle pheromone) -> py::object {
+            const auto peak = [&] {
+              const SharedAccess lock = sharedAccess(env);
+              return env.strongest_pheromone_within(point, radius, pheromone);
+            }();
+            if (!peak.found) {
+              return py::none();
+            }
+            return py::make_tuple(peak.x, peak.y, peak.value);
+          },
+          py::arg("point"), py::arg("radius"), py::arg("pheromone"),
+          "Gets (x, y, value) of the strongest cell within radius, None if "
+          "none holds a positive value.")
+      .def(
+          "get_pheromone_pyramid_level",
+          [](const Environment &env, Environment::PheromoneHandle pheromone,
+             int level) {
+            const SharedAccess lock = sharedAccess(env);
+            const auto *pyramid = env.get_pheromone_pyramid(pheromone);
+            if (!pyramid) {
+              throw std::invalid_argument("the pheromone has no pyramid");
+            }
+            const auto &grid = pyramid->getLevel(level);
+            return py::array_t<similar2logo::kernel::tools::PheromonePyramid::
+                                   Value>({grid.getHeight(), grid.getWidth()},
+                                          grid.data());
+          },
+          py::arg("pheromone"), py::arg("level"),
+          "Copies a level of the pyramid of a grid, as a (rows, columns) "
+          "array of block maxima or means.")
+      .def("set_change_history", update(&Environment::set_change_history),
+           py::arg("commits"))
+      .def("commit_changes", update(&Environment::commit_changes),
+           py::arg("time"))
+      .def("get_changes_since", query(&Environment::get_changes_since),
+           py::arg("time"))
+      // The draws share the generator of the environment
       .def("random_position",
-           &similar2logo::kernel::environment::Environment::random_position)
+           [](const Environment &env) {
+             const ExclusiveAccess lock = exclusiveAccess(env);
+             return env.random_position();
+           })
       .def("random_heading",
-           &similar2logo::kernel::environment::Environment::random_heading)
+           [](const Environment &env) {
+             const ExclusiveAccess lock = exclusiveAccess(env);
+             return env.random_heading();
+           })
       .def("get_distance",
-           &similar2logo::kernel::environment::Environment::get_distance,
+           &Environment::get_distance,
            py::arg("a"), py::arg("b"))
       .def("get_direction",
-           &similar2logo::kernel::environment::Environment::get_direction,
+           &Environment::get_direction,
            py::arg("from"), py::arg("to"))
-      .def("get_marks",
-           &similar2logo::kernel::environment::Environment::get_marks)
-      .def("add_mark",
-           &similar2logo::kernel::environment::Environment::add_mark,
+      .def(
+          "get_marks",
+          [](const Environment &env) {
+            // marks[x][y], the lists of the marks of each patch
+            std::vector<std::vector<py::list>> marks(
+                env.width(), std::vector<py::list>(env.height()));
+            const SharedAccess lock = sharedAccess(env);
+            env.get_marks().forEach(
+                [&](int x, int y,
+                    const std::shared_ptr<
+                        similar2logo::kernel::model::environment::SimpleMark>
+                        &mark) { marks[x][y].append(mark); });
+            return marks;
+          })
+      .def(
+          "get_marks_at",
+          [](const Environment &env, int x, int y) {
+            const SharedAccess lock = sharedAccess(env);
+            return env.get_marks().getAt(x, y);
+          },
+          py::arg("x"), py::arg("y"))
+      .def("get_mark_count",
+           [](const Environment &env) {
+             const SharedAccess lock = sharedAccess(env);
+             return env.get_marks().size();
+           })
+      .def("add_marks", update(&Environment::add_marks), py::arg("marks"))
+      .def("remove_marks", update(&Environment::remove_marks),
+           py::arg("marks"))
+      .def("add_mark", update(&Environment::add_mark),
            py::arg("x"), py::arg("y"), py::arg("mark"))
-      .def("remove_mark",
-           &similar2logo::kernel::environment::Environment::remove_mark,
-           py::arg("x"), py::arg("y"), py::arg("mark"));
+      .def("remove_mark", update(&Environment::remove_mark),
+           py::arg("x"), py::arg("y"), py::arg("mark"))
+      .def("add_turtle", update(&Environment::add_turtle),
+           py::arg("turtle"))
+      .def("remove_turtle", update(&Environment::remove_turtle),
+           py::arg("turtle"))
+      .def("get_turtles", query(&Environment::get_turtles))
+      // The columns of the turtle store, element i being the state of
+      // get_turtles()[i], as read-only arrays sharing its memory. They are
+      // only valid until a turtle is added or removed.
+      .def("get_turtle_arrays",
+           [](py::object self) {
+             const Environment &env = self.cast<const Environment &>();
+             const SharedAccess lock = sharedAccess(env);
+             const auto &store = env.get_turtle_store();
+             const auto count = static_cast<py::ssize_t>(store.size());
+             py::dict arrays;
+             arrays["id"] = readOnlyView(store.id.data(), {count}, self);
+             arrays["x"] = readOnlyView(store.x.data(), {count}, self);
+             arrays["y"] = readOnlyView(store.y.data(), {count}, self);
+             arrays["heading"] =
+                 readOnlyView(store.heading.data(), {count}, self);
+             arrays["speed"] = readOnlyView(store.speed.data(), {count}, self);
+             arrays["acceleration"] =
+                 readOnlyView(store.acceleration.data(), {count}, self);
+             return arrays;
+           })
+      .def(
+          "set_turtle_locations",
+          [](Environment &env, const DoubleArray &x, const DoubleArray &y) {
+            const ExclusiveAccess lock = exclusiveAccess(env);
+            checkTurtleCount(x, env.get_turtles().size());
+            checkTurtleCount(y, env.get_turtles().size());
+            env.set_turtle_locations(x.data(), y.data());
+          },
+          py::arg("x"), py::arg("y"))
+      .def(
+          "set_turtle_headings",
+          [](Environment &env, const DoubleArray &headings) {
+            const ExclusiveAccess lock = exclusiveAccess(env);
+            checkTurtleCount(headings, env.get_turtles().size());
+            env.set_turtle_headings(headings.data());
+          },
+          py::arg("headings"))
+      .def(
+          "set_turtle_speeds",
+          [](Environment &env, const DoubleArray &speeds) {
+            const ExclusiveAccess lock = exclusiveAccess(env);
+            checkTurtleCount(speeds, env.get_turtles().size());
+            env.set_turtle_speeds(speeds.data());
+          },
+          py::arg("speeds"))
+      .def("get_turtles_at", query(&Environment::get_turtles_at),
+           py::arg("x"), py::arg("y"))
+      .def("update_turtle_patch", update(&Environment::update_turtle_patch),
+           py::arg("turtle"), py::arg("old_x"), py::arg("old_y"),
+           py::arg("new_x"), py::arg("new_y"))
+      .def("relocate_turtles", update(&Environment::relocate_turtles),
+           py::arg("turtles"), py::arg("seed"),
+           py::call_guard<py::gil_scoped_release>())
+      .def("get_turtles_in_radius",
+           query(&Environment::get_turtles_in_radius),
+           py::arg("center"), py::arg("radius"))
+      .def("get_turtles_in_cone", query(&Environment::get_turtles_in_cone),
+           py::arg("center"), py::arg("heading"), py::arg("angle"),
+           py::arg("radius"))
+      // The neighbours of every turtle are computed without the GIL.
+      .def("get_turtles_in_radius_all",
+           query(&Environment::get_turtles_in_radius_all),
+           py::arg("radius"), py::call_guard<py::gil_scoped_release>())
+      .def_property(
+          "neighbourhood_cache", query(&Environment::neighbourhood_cache),
+          update(&Environment::set_neighbourhood_cache))
+      .def_property(
+          "diffusion_scheme", query(&Environment::diffusion_scheme),
+          update(&Environment::set_diffusion_scheme))
+      .def("enable_crowds",
+           update(py::overload_cast<const Environment::CrowdSettings &>(
+               &Environment::enable_crowds)),
+           py::arg("settings") = Environment::CrowdSettings())
+      .def("disable_crowds", update(&Environment::disable_crowds),
+           py::arg("seed"))
+      .def_property_readonly("crowds_enabled",
+                             query(&Environment::crowds_enabled))
+      .def("update_crowds", update(&Environment::update_crowds),
+           py::arg("seed"))
+      .def("set_crowd_focus", update(&Environment::set_crowd_focus),
+           py::arg("x"),
+           py::arg("y"), py::arg("width"), py::arg("height"))
+      .def("clear_crowd_focus", update(&Environment::clear_crowd_focus))
+      .def("get_crowd_turtle_count",
+           query(&Environment::get_crowd_turtle_count));
+
+  // ========== SharedDecisionBuffer ==========
+  // The columns are views of capacity values sharing the segment, which
+  // they keep mapped; the turtles of the step are the count() first ones.
+  using similar2logo::kernel::environment::SharedDecisionBuffer;
+  auto column = [](double *(SharedDecisionBuffer::*get)()) {
+    return [get](py::object self) {
+      auto &buffer = self.cast<SharedDecisionBuffer &>();
+      return py::array_t<double>(
+          {static_cast<py::ssize_t>(buffer.capacity())}, (buffer.*get)(),
+          self);
+    };
+  };
+  py::class_<SharedDecisionBuffer>(env_module, "SharedDecisionBuffer")
+      .def_static("create", &SharedDecisionBuffer::create, py::arg("name"),
+                  py::arg("capacity"), py::arg("pheromone_count") = 0)
+      .def_static("attach", &SharedDecisionBuffer::attach, py::arg("name"))
+      .def_property_readonly("name", &SharedDecisionBuffer::name)
+      .def_property_readonly("is_owner", &SharedDecisionBuffer::is_owner)
+      .def_property_readonly("capacity", &SharedDecisionBuffer::capacity)
+      .def_property_readonly("pheromone_count",
+                             &SharedDecisionBuffer::pheromone_count)
+      .def_property("count", &SharedDecisionBuffer::count,
+                    &SharedDecisionBuffer::set_count)
+      .def_property_readonly("step", &SharedDecisionBuffer::step)
+      .def_property_readonly("x", column(&SharedDecisionBuffer::x))
+      .def_property_readonly("y", column(&SharedDecisionBuffer::y))
+      .def_property_readonly("heading", column(&SharedDecisionBuffer::heading))
+      .def_property_readonly("speed", column(&SharedDecisionBuffer::speed))
+      .def_property_readonly("heading_deltas",
+                             column(&SharedDecisionBuffer::heading_deltas))
+      .def_property_readonly("speed_deltas",
+                             column(&SharedDecisionBuffer::speed_deltas))
+      // a (capacity, pheromone_count) array
+      .def_property_readonly("pheromones",
+                             [](py::object self) {
+                               auto &buffer =
+                                   self.cast<SharedDecisionBuffer &>();
+                               return py::array_t<double>(
+                                   {static_cast<py::ssize_t>(
+                                        buffer.capacity()),
+                                    static_cast<py::ssize_t>(
+                                        buffer.pheromone_count())},
+                                   buffer.pheromones(), self);
+                             })
+      .def(
+          "publish",
+          [](SharedDecisionBuffer &buffer, const Environment &env,
+             const std::vector<Environment::PheromoneHandle> &pheromones) {
+            const SharedAccess lock = sharedAccess(env);
+            buffer.publish(env, pheromones);
+          },
+          py::arg("environment"), py::arg("pheromones"),
+          py::call_guard<py::gil_scoped_release>())
+      .def("apply", &SharedDecisionBuffer::apply, py::arg("environment"),
+           py::call_guard<py::gil_scoped_release>());
 
   // ========== TurtlePLS ==========
   py::class_<model::environment::TurtlePLSInLogo,
@@ -296,6 +1767,17 @@ PYBIND11_MODULE(_core, m) {
            py::arg("time_lower"), py::arg("time_upper"), py::arg("target"))
       .def("getTarget", &similar2logo::kernel::influences::Stop::getTarget);
 
+  py::class_<similar2logo::kernel::influences::Relocate,
+             mk::influences::RegularInfluence,
+             std::shared_ptr<similar2logo::kernel::influences::Relocate>>(
+      influences_module, "Relocate")
+      .def(py::init<const mk::SimulationTimeStamp &,
+                    const mk::SimulationTimeStamp &,
+                    std::shared_ptr<model::environment::TurtlePLSInLogo>>(),
+           py::arg("time_lower"), py::arg("time_upper"), py::arg("target"))
+      .def("getTarget",
+           &similar2logo::kernel::influences::Relocate::getTarget);
+
   py::class_<similar2logo::kernel::influences::EmitPheromone,
              mk::influences::RegularInfluence,
              std::shared_ptr<similar2logo::kernel::influences::EmitPheromone>>(
@@ -344,7 +1826,12 @@ PYBIND11_MODULE(_core, m) {
                                                        "Reaction")
       .def(py::init<>())
       .def("apply", &similar2logo::kernel::reaction::Reaction::apply,
-           py::arg("influences"), py::arg("env"), py::arg("dt") = 1.0);
+           py::arg("influences"), py::arg("env"), py::arg("dt") = 1.0,
+           py::call_guard<py::gil_scoped_release>())
+      .def_property(
+          "coalescing",
+          &similar2logo::kernel::reaction::Reaction::isCoalescing,
+          &similar2logo::kernel::reaction::Reaction::setCoalescing);
 
   // ========== Helper Functions ==========
   m.def(
@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+"""
+Smoke test of the similar2logo _core module, run by ctest.
+
+Checks that the module keeps the GIL disabled on a free-threaded
+interpreter, and that queries running in other threads while a reaction
+steps an environment see whole steps only.
+
+Usage: test_bindings_smoke.py <directory of the module>
+"""
+
+import sys
+import sysconfig
+import threading
+
+sys.path.insert(0, sys.argv[1] if len(sys.argv) > 1 else '.')
+
+import _core  # noqa: E402
+
+
+def test_gil_stays_disabled():
+    if sysconfig.get_config_var('Py_GIL_DISABLED'):
+        assert not sys._is_gil_enabled(), 'importing _core enabled the GIL'
+
+
+def test_concurrent_queries():
+    env = _core.environment.Environment(16, 16, True)
+    trail = env.add_pheromone('trail', 0.2, 0.05)
+    env.set_pheromone(8, 8, trail, 100.0)
+    reaction = _core.reaction.Reaction()
+    done = threading.Event()
+    errors = []
+
+    def query():
+        last = 100.0
+        while not done.is_set():
+            # The field only diffuses and evaporates, so its peak decreases
+            value = env.get_pheromone_value(8, 8, trail)
+            if value > last * (1.0 + 1e-9):
+                errors.append(value)
+            last = value
+
+    readers = [threading.Thread(target=query) for _ in range(4)]
+    for reader in readers:
+        reader.start()
+    for _ in range(200):
+        reaction.apply([], env, 1.0)
+    done.set()
+    for reader in readers:
+        reader.join()
+    assert not errors, f'inconsistent queries: {errors[:5]}'
+    assert env.get_pheromone_value(8, 8, trail) < 100.0
+
+
+if __name__ == '__main__':
+    test_gil_stays_disabled()
+    test_concurrent_queries()
+    print('similar2logo binding smoke test PASSED')
@@ -0,0 +1,293 @@
+#include "kernel/agents/Behaviors.h"
+#include "kernel/influences/ChangeDirection.h"
+#include "kernel/influences/ChangePosition.h"
+#include "kernel/influences/Relocate.h"
+#include "kernel/influences/EmitPheromone.h"
+#include "kernel/tools/FastMath.h"
+#include "kernel/tools/MathUtil.h"
+#include <algorithm>
+#include <cmath>
+#include <influences/InfluenceArena.h>
+#include <libs/random/PRNG.h>
+#include <stdexcept>
+#include <vector>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace agents {
+
+using ek::libs::random::PRNG;
+using microkernel::tools::FastMath;
+using tools::MathUtil;
+
+namespace {
+
+// Reads the fields of a Parameters from the values given by name, failing on
+// the names that match no field.
+class ParameterReader {
+public:
+  explicit ParameterReader(const BehaviorParameters &parameters)
+      : parameters(parameters) {}
+
+  ParameterReader &value(const std::string &name, double &field) {
+    auto it = parameters.values.find(name);
+    if (it != parameters.values.end()) {
+      field = it->second;
+      ++read;
+    }
+    return *this;
+  }
+
+  // a flag given as a value, set unless 0
+  ParameterReader &value(const std::string &name, bool &field) {
+    double flag = field ? 1 : 0;
+    value(name, flag);
+    field = flag != 0;
+    return *this;
+  }
+
+  ParameterReader &name(const std::string &name, std::string &field,
+                        bool required) {
+    auto it = parameters.names.find(name);
+    if (it != parameters.names.end()) {
+      field = it->second;
+      ++read;
+    } else if (required) {
+      throw std::invalid_argument("The parameter '" + name +
+                                  "' is required.");
+    }
+    return *this;
+  }
+
+  void checkAllRead(const std::string &behavior) const {
+    if (read == parameters.values.size() + parameters.names.size()) {
+      return;
+    }
+    std::string unknown;
+    for (const auto &value : parameters.values) {
+      unknown += " " + value.first;
+    }
+    for (const auto &name : parameters.names) {
+      unknown += " " + name.first;
+    }
+    throw std::invalid_argument("Unknown parameters for the behavior '" +
+                                behavior + "' among:" + unknown);
+  }
+
+private:
+  const BehaviorParameters &parameters;
+  std::size_t read = 0;
+};
+
+} // namespace
+
+void BehaviorDecisionModel::decide(
+    const mk::SimulationTimeStamp &timeLowerBound,
+    const mk::SimulationTimeStamp &timeUpperBound,
+    std::shared_ptr<mk::agents::IGlobalState>,
+    std::shared_ptr<mk::agents::ILocalStateOfAgent>,
+    std::shared_ptr<mk::agents::ILocalStateOfAgent>,
+    std::shared_ptr<mk::agents::IPerceivedData> perceivedData,
+    std::shared_ptr<mk::influences::InfluencesMap> producedInfluences) {
+  const auto *perception =
+      dynamic_cast<const LogoAgent::LogoPerceivedData *>(perceivedData.get());
+  if (perception == nullptr || !perception->getTurtle()) {
+    return;
+  }
+  decideFor(*perception, perception->getTurtle(), timeLowerBound,
+            timeUpperBound, *producedInfluences);
+}
+
+void BoidsDecisionModel::decideFor(
+    const LogoAgent::LogoPerceivedData &perception,
+    const std::shared_ptr<model::environment::TurtlePLSInLogo> &turtle,
+    const mk::SimulationTimeStamp &timeLowerBound,
+    const mk::SimulationTimeStamp &timeUpperBound,
+    mk::influences::InfluencesMap &producedInfluences) const {
+  const double heading = perception.getHeading();
+  const tools::Point2D &position = perception.getPosition();
+  const auto &nearbyTurtles = perception.getNearbyTurtles();
+  const std::size_t count = nearbyTurtles.size();
+  // The neighbours are processed by batches over arrays: the directions
+  // towards them, then the angle and the weight of their band, then the
+  // unit vectors of the angles, each loop being vectorized.
+  thread_local std::vector<double> across, along, angles, weights, sines,
+      cosines;
+  across.resize(count);
+  along.resize(count);
+  angles.resize(count);
+  weights.resize(count);
+  sines.resize(count);
+  cosines.resize(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    // the heading of a move along (dx, dy) is atan2(-dx, dy), as
+    // LogoEnvPLS::getDirection()
+    across[i] = position.x - nearbyTurtles[i].position.x;
+    along[i] = nearbyTurtles[i].position.y - position.y;
+  }
+  if (parameters.approximateDirections) {
+    FastMath::atan2(across.data(), along.data(), angles.data(), count);
+  } else {
+    for (std::size_t i = 0; i < count; ++i) {
+      angles[i] = std::atan2(across[i], along[i]);
+    }
+  }
+  for (std::size_t i = 0; i < count; ++i) {
+    const double distance = nearbyTurtles[i].distance;
+    const bool repulsion = distance <= parameters.repulsionDistance;
+    const bool orientation =
+        !repulsion && distance <= parameters.orientationDistance;
+    const bool attraction = !repulsion && !orientation &&
+                            distance <= parameters.attractionDistance;
+    const double towards = angles[i];
+    angles[i] = repulsion     ? towards + MathUtil::PI - heading
+                : orientation ? nearbyTurtles[i].heading - heading
+                              : towards - heading;
+    weights[i] = repulsion     ? parameters.repulsionWeight
+                 : orientation ? parameters.orientationWeight
+                 : attraction  ? parameters.attractionWeight
+                               : 0.0;
+  }
+  FastMath::sinCos(angles.data(), sines.data(), cosines.data(), count);
+  // the weighted sum of the unit vectors of the directions, relative to the
+  // heading of the boid
+  double sumCos = 0;
+  double sumSin = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    sumCos += weights[i] * cosines[i];
+    sumSin += weights[i] * sines[i];
+  }
+  if (sumCos == 0 && sumSin == 0) {
+    return;
+  }
+  const double dd = std::clamp(std::atan2(sumSin, sumCos),
+                               -parameters.maxAngle, parameters.maxAngle);
+  if (dd != 0) {
+    producedInfluences.add(
+        mk::influences::makeInfluence<influences::ChangeDirection>(
+            level, timeLowerBound, timeUpperBound, dd, turtle));
+  }
+}
+
+void PheromoneFollowingDecisionModel::decideFor(
+    const LogoAgent::LogoPerceivedData &perception,
+    const std::shared_ptr<model::environment::TurtlePLSInLogo> &turtle,
+    const mk::SimulationTimeStamp &timeLowerBound,
+    const mk::SimulationTimeStamp &timeUpperBound,
+    mk::influences::InfluencesMap &producedInfluences) const {
+  const auto *gradient = perception.getPheromoneGradient(parameters.pheromone);
+  double dd;
+  if (gradient != nullptr &&
+      std::max({gradient->left, gradient->ahead, gradient->right}) >
+          parameters.threshold) {
+    if (gradient->left > gradient->ahead && gradient->left >= gradient->right) {
+      dd = parameters.turnAngle;
+    } else if (gradient->right > gradient->ahead) {
+      dd = -parameters.turnAngle;
+    } else {
+      dd = 0;
+    }
+  } else {
+    dd = PRNG::randomDouble(-parameters.wiggleAngle, parameters.wiggleAngle);
+  }
+  if (dd != 0) {
+    producedInfluences.add(
+        mk::influences::makeInfluence<influences::ChangeDirection>(
+            level, timeLowerBound, timeUpperBound, dd, turtle));
+  }
+  if (parameters.depositedAmount > 0) {
+    producedInfluences.add(
+        mk::influences::makeInfluence<influences::EmitPheromone>(
+            level, timeLowerBound, timeUpperBound, perception.getPosition(),
+            parameters.pheromone, parameters.depositedAmount));
+  }
+}
+
+bool SegregationDecisionModel::isHappy(
+    const LogoAgent::LogoPerceivedData &perception) const {
+  const auto &nearbyTurtles = perception.getNearbyTurtles();
+  if (nearbyTurtles.empty()) {
+    return true;
+  }
+  const auto similar =
+      std::count_if(nearbyTurtles.begin(), nearbyTurtles.end(),
+                    [this](const auto &nearby) {
+                      return nearby.category.getSymbol() == category;
+                    });
+  return similar >= parameters.similarityRate * nearbyTurtles.size();
+}
+
+void SegregationDecisionModel::decideFor(
+    const LogoAgent::LogoPerceivedData &perception,
+    const std::shared_ptr<model::environment::TurtlePLSInLogo> &turtle,
+    const mk::SimulationTimeStamp &timeLowerBound,
+    const mk::SimulationTimeStamp &timeUpperBound,
+    mk::influences::InfluencesMap &producedInfluences) const {
+  if (isHappy(perception)) {
+    return;
+  }
+  if (parameters.relocate) {
+    producedInfluences.add(mk::influences::makeInfluence<influences::Relocate>(
+        level, timeLowerBound, timeUpperBound, turtle));
+    return;
+  }
+  const double dx = PRNG::randomDouble(-parameters.maxJump, parameters.maxJump);
+  const double dy = PRNG::randomDouble(-parameters.maxJump, parameters.maxJump);
+  producedInfluences.add(
+      mk::influences::makeInfluence<influences::ChangePosition>(
+          level, timeLowerBound, timeUpperBound, dx, dy, turtle));
+}
+
+std::shared_ptr<ek::agents::IAgtDecisionModel>
+makeBehavior(const std::string &name, const mk::LevelIdentifier &level,
+             const BehaviorParameters &parameters) {
+  ParameterReader reader(parameters);
+  if (name == "boids") {
+    BoidsDecisionModel::Parameters boids;
+    reader.value("repulsion_distance", boids.repulsionDistance)
+        .value("orientation_distance", boids.orientationDistance)
+        .value("attraction_distance", boids.attractionDistance)
+        .value("repulsion_weight", boids.repulsionWeight)
+        .value("orientation_weight", boids.orientationWeight)
+        .value("attraction_weight", boids.attractionWeight)
+        .value("max_angle", boids.maxAngle)
+        .value("approximate_directions", boids.approximateDirections)
+        .checkAllRead(name);
+    return std::make_shared<BoidsDecisionModel>(level, boids);
+  }
+  if (name == "ant") {
+    PheromoneFollowingDecisionModel::Parameters ant;
+    reader.name("pheromone", ant.pheromone, true)
+        .value("turn_angle", ant.turnAngle)
+        .value("wiggle_angle", ant.wiggleAngle)
+        .value("threshold", ant.threshold)
+        .value("deposited_amount", ant.depositedAmount)
+        .checkAllRead(name);
+    return std::make_shared<PheromoneFollowingDecisionModel>(level,
+                                                             std::move(ant));
+  }
+  if (name == "segregation") {
+    SegregationDecisionModel::Parameters segregation;
+    reader.name("category", segregation.category, true)
+        .value("similarity_rate", segregation.similarityRate)
+        .value("max_jump", segregation.maxJump)
+        .value("relocate", segregation.relocate)
+        .checkAllRead(name);
+    return std::make_shared<SegregationDecisionModel>(level,
+                                                      std::move(segregation));
+  }
+  throw std::invalid_argument("Unknown behavior '" + name +
+                              "'; expected boids, ant or segregation.");
+}
+
+} // namespace agents
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -0,0 +1,98 @@
+#include "kernel/agents/CompiledBehavior.h"
+#include <cstddef>
+#include <dlfcn.h>
+#include <stdexcept>
+#include <type_traits>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace agents {
+
+namespace {
+
+using Row = LogoAgent::BatchPerception::Row;
+
+// The layout the generated kernels declare (ABI_VERSION 1)
+static_assert(std::is_standard_layout<Row>::value &&
+                  std::is_trivially_copyable<Row>::value,
+              "the rows are passed as plain structures");
+static_assert(offsetof(Row, x) == 0 && offsetof(Row, y) == 8 &&
+                  offsetof(Row, heading) == 16 && offsetof(Row, speed) == 24 &&
+                  offsetof(Row, nearbyTurtles) == 32 && sizeof(Row) == 40,
+              "the rows changed: increment CompiledBehaviorLibrary::"
+              "ABI_VERSION and the generated declaration");
+
+std::string lastError() {
+  const char *error = dlerror();
+  return error ? error : "unknown error";
+}
+
+} // namespace
+
+CompiledBehaviorLibrary::CompiledBehaviorLibrary(const std::string &path)
+    : path(path) {
+  handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (handle == nullptr) {
+    throw std::runtime_error("CompiledBehaviorLibrary: cannot load " + path +
+                             ": " + lastError());
+  }
+  auto version = reinterpret_cast<int (*)()>(
+      dlsym(handle, "similar2logo_kernel_abi_version"));
+  kernel = reinterpret_cast<CompiledKernel>(
+      dlsym(handle, "similar2logo_kernel"));
+  if (version == nullptr || kernel == nullptr) {
+    dlclose(handle);
+    throw std::runtime_error("CompiledBehaviorLibrary: " + path +
+                             " is not a compiled behavior");
+  }
+  if (version() != ABI_VERSION) {
+    dlclose(handle);
+    throw std::runtime_error("CompiledBehaviorLibrary: " + path +
+                             " was compiled for another ABI version");
+  }
+}
+
+CompiledBehaviorLibrary::~CompiledBehaviorLibrary() { dlclose(handle); }
+
+std::shared_ptr<LogoAgent::BatchDecisionModel> makeCompiledBehavior(
+    const mk::LevelIdentifier &level, CompiledKernel kernel,
+    std::vector<std::string> pheromoneNames,
+    std::shared_ptr<const CompiledBehaviorLibrary> library) {
+  if (kernel == nullptr) {
+    throw std::invalid_argument("makeCompiledBehavior: null kernel");
+  }
+  auto decide = [kernel, library = std::move(library)](
+                    const LogoAgent::BatchPerception &perception,
+                    LogoAgent::BatchDecisions &decisions) {
+    kernel(perception.rows.data(), perception.rows.size(),
+           perception.pheromones.data(), perception.pheromoneNames.size(),
+           perception.step, decisions.headingDeltas.data(),
+           decisions.speedDeltas.data());
+  };
+  return std::make_shared<LogoAgent::BatchDecisionModel>(
+      level, std::move(pheromoneNames), std::move(decide));
+}
+
+std::shared_ptr<LogoAgent::BatchDecisionModel>
+makeCompiledBehavior(const mk::LevelIdentifier &level,
+                     std::shared_ptr<const CompiledBehaviorLibrary> library,
+                     std::vector<std::string> pheromoneNames) {
+  if (!library) {
+    throw std::invalid_argument("makeCompiledBehavior: null library");
+  }
+  const CompiledKernel kernel = library->getKernel();
+  return makeCompiledBehavior(level, kernel, std::move(pheromoneNames),
+                              std::move(library));
+}
+
+} // namespace agents
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
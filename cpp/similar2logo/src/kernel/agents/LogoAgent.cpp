@@ -1,4 +1,7 @@
 #include "kernel/agents/LogoAgent.h"
+#include "kernel/influences/ChangeDirection.h"
+#include "kernel/influences/ChangeSpeed.h"
+#include <influences/InfluenceArena.h>
 
 namespace fr {
 namespace univ_artois {
@@ -12,6 +15,91 @@ LogoAgent::LogoAgent(const microkernel::AgentCategory &category,
                      double initialSpeed, const std::string &color)
     : ExtendedAgent(category), speed(initialSpeed), color(color) {}
 
+LogoAgent::BatchDecisionModel::BatchDecisionModel(
+    const mk::LevelIdentifier &level, std::vector<std::string> pheromoneNames,
+    BatchCallback callback)
+    : level(level), callback(std::move(callback)) {
+  perception.pheromoneNames = std::move(pheromoneNames);
+}
+
+void LogoAgent::BatchDecisionModel::perceived(
+    const mk::SimulationTimeStamp &timeLowerBound,
+    const mk::SimulationTimeStamp &,
+    const std::shared_ptr<mk::agents::IAgent4Engine> *agents,
+    std::size_t count) {
+  const std::size_t columns = perception.pheromoneNames.size();
+  perception.step = timeLowerBound.getIdentifier();
+  perception.rows.clear();
+  perception.pheromones.clear();
+  rows.clear();
+  for (std::size_t i = 0; i < count; ++i) {
+    const auto *agent =
+        dynamic_cast<ek::agents::ExtendedAgent *>(agents[i].get());
+    if (agent == nullptr) {
+      continue;
+    }
+    // the agents outside the level did not perceive in it
+    const auto perceivedData = agent->getPerceivedData();
+    const auto found = perceivedData.find(level);
+    if (found == perceivedData.end() ||
+        agent->getDecisionModel(level).get() != this) {
+      continue;
+    }
+    const auto *data =
+        dynamic_cast<const LogoPerceivedData *>(found->second.get());
+    if (data == nullptr) {
+      continue;
+    }
+    rows.emplace(data, perception.rows.size());
+    perception.rows.push_back(BatchPerception::Row{
+        data->getPosition().x, data->getPosition().y, data->getHeading(),
+        data->getSpeed(),
+        static_cast<std::uint32_t>(data->getNearbyTurtles().size())});
+    for (std::size_t j = 0; j < columns; ++j) {
+      perception.pheromones.push_back(
+          data->getPheromone(perception.pheromoneNames[j]));
+    }
+  }
+  decisions.headingDeltas.assign(perception.rows.size(), 0.0);
+  decisions.speedDeltas.assign(perception.rows.size(), 0.0);
+  if (callback && !perception.rows.empty()) {
+    callback(perception, decisions);
+  }
+}
+
+void LogoAgent::BatchDecisionModel::decide(
+    const mk::SimulationTimeStamp &timeLowerBound,
+    const mk::SimulationTimeStamp &timeUpperBound,
+    std::shared_ptr<mk::agents::IGlobalState>,
+    std::shared_ptr<mk::agents::ILocalStateOfAgent>,
+    std::shared_ptr<mk::agents::ILocalStateOfAgent>,
+    std::shared_ptr<mk::agents::IPerceivedData> perceivedData,
+    std::shared_ptr<mk::influences::InfluencesMap> producedInfluences) {
+  const auto found = rows.find(perceivedData.get());
+  if (found == rows.end()) {
+    return;
+  }
+  const auto &turtle =
+      static_cast<const LogoPerceivedData &>(*perceivedData).getTurtle();
+  if (!turtle) {
+    return;
+  }
+  const std::size_t row = found->second;
+  if (row < decisions.headingDeltas.size() &&
+      decisions.headingDeltas[row] != 0) {
+    producedInfluences->add(
+        mk::influences::makeInfluence<influences::ChangeDirection>(
+            level, timeLowerBound, timeUpperBound,
+            decisions.headingDeltas[row], turtle));
+  }
+  if (row < decisions.speedDeltas.size() && decisions.speedDeltas[row] != 0) {
+    producedInfluences->add(
+        mk::influences::makeInfluence<influences::ChangeSpeed>(
+            level, timeLowerBound, timeUpperBound, decisions.speedDeltas[row],
+            turtle));
+  }
+}
+
 } // namespace agents
 } // namespace kernel
 } // namespace similar2logo
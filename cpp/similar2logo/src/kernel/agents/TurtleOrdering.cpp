@@ -0,0 +1,40 @@
+#include "kernel/agents/TurtleOrdering.h"
+#include "kernel/tools/SpaceFillingCurve.h"
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace agents {
+
+TurtleOrdering::TurtleOrdering(TurtleOf turtleOf, int width, int height)
+    : turtleOf(std::move(turtleOf)), bits(tools::SpaceFillingCurve::bitsFor(width, height)) {}
+
+std::uint64_t
+TurtleOrdering::keyOf(const mk::agents::IAgent4Engine &agent) const {
+  const model::environment::TurtlePLSInLogo *turtle = turtleOf(agent);
+  if (turtle == nullptr) {
+    return std::numeric_limits<std::uint64_t>::max();
+  }
+  const tools::Point2D location = turtle->getLocation();
+  const double x = std::floor(location.x);
+  const double y = std::floor(location.y);
+  if (!(x >= 0.0 && y >= 0.0 && x < 4294967296.0 && y < 4294967296.0)) {
+    return std::numeric_limits<std::uint64_t>::max();
+  }
+  return tools::SpaceFillingCurve::hilbertIndex(
+      static_cast<std::uint32_t>(x), static_cast<std::uint32_t>(y), bits);
+}
+
+} // namespace agents
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
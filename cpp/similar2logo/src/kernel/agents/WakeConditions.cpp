@@ -0,0 +1,92 @@
+#include "kernel/agents/WakeConditions.h"
+#include "kernel/model/environment/LogoEnvPLS.h"
+#include "kernel/model/environment/TurtlePLSInLogo.h"
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace agents {
+
+using model::environment::LogoEnvPLS;
+
+const LogoEnvPLS *
+logoEnvironmentOf(const mk::dynamicstate::IPublicDynamicStateMap &dynamicStates,
+                  const mk::LevelIdentifier &level) {
+  std::shared_ptr<mk::dynamicstate::IPublicLocalDynamicState> state;
+  try {
+    state = dynamicStates.get(level);
+  } catch (const std::out_of_range &) {
+    return nullptr;
+  }
+  if (!state) {
+    return nullptr;
+  }
+  return dynamic_cast<const LogoEnvPLS *>(
+      state->getPublicLocalStateOfEnvironment().get());
+}
+
+NeighbourWakeCondition::NeighbourWakeCondition(
+    mk::LevelIdentifier level, tools::Point2D center, double radius,
+    const model::environment::TurtlePLSInLogo *self)
+    : level(std::move(level)), center(center), radius(radius), self(self) {
+  if (!(radius >= 0)) {
+    throw std::invalid_argument("The wake radius must be positive");
+  }
+}
+
+bool NeighbourWakeCondition::isMet(
+    const mk::SimulationTimeStamp &,
+    const mk::dynamicstate::IPublicDynamicStateMap &dynamicStates) const {
+  const LogoEnvPLS *environment = logoEnvironmentOf(dynamicStates, level);
+  if (environment == nullptr) {
+    return false;
+  }
+  const auto &patches = environment->getTurtlesInPatches();
+  bool met = false;
+  environment->forEachNeighbor(
+      static_cast<int>(std::floor(center.x)),
+      static_cast<int>(std::floor(center.y)),
+      static_cast<int>(std::ceil(radius)), [&](int x, int y) {
+        if (met || !patches.contains(x, y)) {
+          return;
+        }
+        for (const auto &turtle : patches(x, y)) {
+          if (turtle.get() != self &&
+              environment->getDistance(center, turtle->getLocation()) <=
+                  radius) {
+            met = true;
+            return;
+          }
+        }
+      });
+  return met;
+}
+
+PheromoneWakeCondition::PheromoneWakeCondition(
+    mk::LevelIdentifier level, model::environment::Pheromone pheromone, int x,
+    int y, double threshold)
+    : level(std::move(level)), pheromone(std::move(pheromone)), x(x), y(y),
+      threshold(threshold) {}
+
+bool PheromoneWakeCondition::isMet(
+    const mk::SimulationTimeStamp &,
+    const mk::dynamicstate::IPublicDynamicStateMap &dynamicStates) const {
+  const LogoEnvPLS *environment = logoEnvironmentOf(dynamicStates, level);
+  return environment != nullptr && environment->getWidth() > x && x >= 0 &&
+         environment->getHeight() > y && y >= 0 &&
+         environment->getPheromoneValueAt(pheromone, x, y) >= threshold;
+}
+
+} // namespace agents
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
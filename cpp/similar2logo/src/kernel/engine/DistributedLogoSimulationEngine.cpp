@@ -0,0 +1,1228 @@
+#include "kernel/engine/DistributedLogoSimulationEngine.h"
+#include "kernel/influences/AgentPositionUpdate.h"
+#include "kernel/influences/ChangeAcceleration.h"
+#include "kernel/influences/ChangeDirection.h"
+#include "kernel/influences/ChangePosition.h"
+#include "kernel/influences/ChangeSpeed.h"
+#include "kernel/influences/EmitPheromone.h"
+#include "kernel/influences/PheromoneFieldUpdate.h"
+#include "kernel/influences/Stop.h"
+#include "kernel/model/environment/LogoEnvironment.h"
+#include "kernel/model/levels/LogoSimulationLevelList.h"
+#include "kernel/tools/MathUtil.h"
+#include <LevelIndexedMap.h>
+#include <checkpoint/ICheckpointable.h>
+#include <dynamicstate/ConsistentPublicLocalDynamicState.h>
+#include <influences/system/SystemInfluenceRemoveAgent.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace engine {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Box = tools::DomainDecomposition::Box;
+using model::environment::LogoEnvPLS;
+using model::environment::SimpleMark;
+using model::environment::TurtlePLSInLogo;
+using model::levels::LogoSimulationLevelList;
+
+// The load of a patch, diffusing its pheromones, in turtles: an estimate
+// keeping the empty regions of the grid from growing unbounded domains
+constexpr double PATCH_LOAD = 0.05;
+
+mk::StepTimings::Duration elapsedSince(Clock::time_point start) {
+  return std::chrono::duration_cast<mk::StepTimings::Duration>(Clock::now() -
+                                                                start);
+}
+
+/** The states of the levels, indexed by level. */
+class PublicDynamicStateMap : public mk::dynamicstate::IPublicDynamicStateMap {
+private:
+  mk::LevelIndexedMap<
+      std::shared_ptr<mk::dynamicstate::IPublicLocalDynamicState>>
+      states;
+
+public:
+  std::set<mk::LevelIdentifier> keySet() const override {
+    return states.keySet();
+  }
+
+  std::shared_ptr<mk::dynamicstate::IPublicLocalDynamicState>
+  get(const mk::LevelIdentifier &level) const override {
+    auto state = states.find(level);
+    if (state == nullptr) {
+      throw std::out_of_range("Level not found in dynamic state map: " +
+                              level.toString());
+    }
+    return *state;
+  }
+
+  void put(std::shared_ptr<mk::dynamicstate::IPublicLocalDynamicState> state)
+      override {
+    states[state->getLevel()] = state;
+  }
+};
+
+/**
+ * Visits the halo cells of a local grid, row by row: the cells of the local
+ * grid outside the domain.
+ * @param visitor Called with the local cell and the patch of the grid,
+ * unwrapped.
+ */
+template <typename Visitor>
+void forEachHaloCell(const Box &domain, const Box &localGrid,
+                     Visitor &&visitor) {
+  for (int y = 0; y < localGrid.height; ++y) {
+    for (int x = 0; x < localGrid.width; ++x) {
+      const int gx = localGrid.x + x;
+      const int gy = localGrid.y + y;
+      if (!domain.contains(gx, gy)) {
+        visitor(static_cast<std::size_t>(y) * localGrid.width + x, gx, gy);
+      }
+    }
+  }
+}
+
+// Written as the checkpoints of the engines write their objects: a flag,
+// then the content of the checkpointable ones.
+void writeObject(mk::checkpoint::CheckpointWriter &writer, const void *object,
+                 const mk::checkpoint::ICheckpointable *checkpointable) {
+  writer.writeBool(object != nullptr && checkpointable != nullptr);
+  if (object != nullptr && checkpointable != nullptr) {
+    mk::checkpoint::CheckpointWriter block;
+    checkpointable->writeCheckpoint(block);
+    writer.writeBlock(block);
+  }
+}
+
+template <typename T>
+void writeObject(mk::checkpoint::CheckpointWriter &writer,
+                 const std::shared_ptr<T> &object) {
+  writeObject(writer, object.get(),
+              dynamic_cast<const mk::checkpoint::ICheckpointable *>(
+                  object.get()));
+}
+
+template <typename T>
+void readObject(mk::checkpoint::CheckpointReader &reader,
+                const std::shared_ptr<T> &object,
+                const std::string &description) {
+  if (!reader.readBool()) {
+    return;
+  }
+  mk::checkpoint::CheckpointReader block = reader.readBlock();
+  auto *checkpointable =
+      dynamic_cast<mk::checkpoint::ICheckpointable *>(object.get());
+  if (checkpointable == nullptr) {
+    throw mk::checkpoint::CheckpointException(
+        "The migrated turtle holds " + description +
+        ", which the model did not create as a checkpointable object.");
+  }
+  checkpointable->readCheckpoint(block);
+}
+
+void writeTurtle(mk::checkpoint::CheckpointWriter &writer,
+                 const TurtlePLSInLogo &turtle, double fractionX,
+                 double fractionY) {
+  writer.writeDouble(fractionX);
+  writer.writeDouble(fractionY);
+  writer.writeDouble(turtle.getHeading());
+  writer.writeDouble(turtle.getSpeed());
+  writer.writeDouble(turtle.getAcceleration());
+  writer.writeBool(turtle.isPenDown());
+  writer.writeString(turtle.getColor());
+}
+
+/** Reads a turtle written by writeTurtle() into the patch (x, y). */
+std::shared_ptr<TurtlePLSInLogo>
+readTurtle(mk::checkpoint::CheckpointReader &reader, int x, int y) {
+  const double fractionX = reader.readDouble();
+  const double fractionY = reader.readDouble();
+  const double heading = reader.readDouble();
+  const double speed = reader.readDouble();
+  const double acceleration = reader.readDouble();
+  const bool penDown = reader.readBool();
+  const std::string color = reader.readString();
+  return std::make_shared<TurtlePLSInLogo>(
+      tools::Point2D(x + fractionX, y + fractionY), heading, speed,
+      acceleration, penDown, color);
+}
+
+/** Gets the turtle targeted by an influence on turtles, or nullptr. */
+TurtlePLSInLogo *targetOf(const mk::influences::IInfluence &influence) {
+  using namespace kernel::influences;
+  const std::size_t tag = influence.getTypeTag();
+  if (tag == mk::influences::influenceTypeTag<ChangeAcceleration>()) {
+    return static_cast<const ChangeAcceleration &>(influence).getTarget().get();
+  }
+  if (tag == mk::influences::influenceTypeTag<ChangeDirection>()) {
+    return static_cast<const ChangeDirection &>(influence).getTarget().get();
+  }
+  if (tag == mk::influences::influenceTypeTag<ChangePosition>()) {
+    return static_cast<const ChangePosition &>(influence).getTarget().get();
+  }
+  if (tag == mk::influences::influenceTypeTag<ChangeSpeed>()) {
+    return static_cast<const ChangeSpeed &>(influence).getTarget().get();
+  }
+  if (tag == mk::influences::influenceTypeTag<Stop>()) {
+    return static_cast<const Stop &>(influence).getTarget().get();
+  }
+  return nullptr;
+}
+
+/** Gets the patches of two boxes of the grid, which may not intersect. */
+Box intersection(const Box &a, const Box &b) {
+  const int x = std::max(a.x, b.x);
+  const int y = std::max(a.y, b.y);
+  const int width = std::min(a.x + a.width, b.x + b.width) - x;
+  const int height = std::min(a.y + a.height, b.y + b.height) - y;
+  return Box{x, y, std::max(width, 0), std::max(height, 0)};
+}
+
+/** Visits the patches of a box, row by row. */
+template <typename Visitor> void forEachPatch(const Box &box, Visitor &&visitor) {
+  for (int y = box.y; y < box.y + box.height; ++y) {
+    for (int x = box.x; x < box.x + box.width; ++x) {
+      visitor(x, y);
+    }
+  }
+}
+
+/**
+ * Writes the pheromones and the marks of the patches of a box of the grid,
+ * from a local grid starting at (originX, originY).
+ */
+void writePatches(mk::checkpoint::CheckpointWriter &message,
+                  const LogoEnvPLS &environment,
+                  const std::vector<model::environment::Pheromone> &pheromones,
+                  const Box &box, int originX, int originY) {
+  const auto &fields = environment.getPheromoneField();
+  for (const auto &pheromone : pheromones) {
+    const auto &values = fields.at(pheromone)->values;
+    forEachPatch(box, [&](int gx, int gy) {
+      message.writeDouble(values(gx - originX, gy - originY));
+    });
+  }
+  forEachPatch(box, [&](int gx, int gy) {
+    const int x = gx - originX;
+    const int y = gy - originY;
+    const auto marks = environment.getMarksAt(x, y);
+    message.writeU64(marks.size());
+    for (const auto &mark : marks) {
+      const tools::Point2D location = mark->getLocation();
+      message.writeDouble(location.x - x);
+      message.writeDouble(location.y - y);
+      message.writeDouble(mark->getContent());
+      message.writeString(mark->getCategory());
+    }
+  });
+}
+
+/** Reads the patches written by writePatches() into a local grid. */
+void readPatches(mk::checkpoint::CheckpointReader &reader,
+                 LogoEnvPLS &environment,
+                 const std::vector<model::environment::Pheromone> &pheromones,
+                 const Box &box, int originX, int originY) {
+  auto &fields = environment.getPheromoneField();
+  for (const auto &pheromone : pheromones) {
+    auto &field = fields.at(pheromone).mutate();
+    forEachPatch(box, [&](int gx, int gy) {
+      field.set(gx - originX, gy - originY, reader.readDouble());
+    });
+  }
+  forEachPatch(box, [&](int gx, int gy) {
+    const int x = gx - originX;
+    const int y = gy - originY;
+    const std::uint64_t count = reader.readU64();
+    for (std::uint64_t m = 0; m < count; ++m) {
+      const double fractionX = reader.readDouble();
+      const double fractionY = reader.readDouble();
+      const double content = reader.readDouble();
+      environment.addMark(std::make_shared<SimpleMark>(
+          tools::Point2D(x + fractionX, y + fractionY), content,
+          reader.readString()));
+    }
+  });
+}
+
+} // namespace
+
+DistributedLogoSimulationEngine::DistributedLogoSimulationEngine(
+    std::shared_ptr<IDomainCommunicator> communicator)
+    : communicator(std::move(communicator)), abortionRequested(false),
+      currentTime(0),
+      dynamicStates(std::make_shared<PublicDynamicStateMap>()),
+      influenceArena(std::make_shared<mk::influences::InfluenceArena>()) {
+  if (!this->communicator) {
+    throw std::invalid_argument("The communicator cannot be null.");
+  }
+}
+
+DistributedLogoSimulationEngine::~DistributedLogoSimulationEngine() = default;
+
+void DistributedLogoSimulationEngine::setDomainGrid(int columns, int rows) {
+  if (columns < 1 || rows < 1 || columns * rows != getRankCount()) {
+    throw std::invalid_argument(
+        "The domains have to be as many as the ranks.");
+  }
+  domainColumns = columns;
+  domainRows = rows;
+}
+
+void DistributedLogoSimulationEngine::setRebalancing(long period,
+                                                     double threshold) {
+  if (period < 0 || !(threshold >= 1.0)) {
+    throw std::invalid_argument(
+        "The period of rebalancing cannot be negative, nor its threshold "
+        "below 1.");
+  }
+  rebalancePeriod = period;
+  rebalanceThreshold = threshold;
+}
+
+const tools::DomainDecomposition &
+DistributedLogoSimulationEngine::getDecomposition() const {
+  if (!decomposition) {
+    throw std::logic_error("No simulation was started.");
+  }
+  return *decomposition;
+}
+
+tools::DomainDecomposition::Box
+DistributedLogoSimulationEngine::getDomain() const {
+  return domain;
+}
+
+tools::DomainDecomposition::Box
+DistributedLogoSimulationEngine::getLocalGrid() const {
+  return localGrid;
+}
+
+tools::Point2D
+DistributedLogoSimulationEngine::toGlobal(const tools::Point2D &local) const {
+  const auto &grid = getDecomposition();
+  double x = local.x + localGrid.x;
+  double y = local.y + localGrid.y;
+  if (grid.isXAxisTorus()) {
+    x = tools::MathUtil::wrap(x, 0, grid.getWidth());
+  }
+  if (grid.isYAxisTorus()) {
+    y = tools::MathUtil::wrap(y, 0, grid.getHeight());
+  }
+  return tools::Point2D(x, y);
+}
+
+void DistributedLogoSimulationEngine::addProbe(
+    const std::string &identifier, std::shared_ptr<mk::IProbe> probe) {
+  std::lock_guard<std::mutex> lock(probesMutex);
+  if (probes.find(identifier) != probes.end()) {
+    throw std::invalid_argument("Probe with identifier '" + identifier +
+                                "' already exists.");
+  }
+  probes[identifier] = probe;
+}
+
+std::shared_ptr<mk::IProbe>
+DistributedLogoSimulationEngine::removeProbe(const std::string &identifier) {
+  std::lock_guard<std::mutex> lock(probesMutex);
+  auto it = probes.find(identifier);
+  if (it == probes.end()) {
+    return nullptr;
+  }
+  auto probe = it->second;
+  probes.erase(it);
+  return probe;
+}
+
+std::set<std::string>
+DistributedLogoSimulationEngine::getProbesIdentifiers() const {
+  std::set<std::string> identifiers;
+  for (const auto &pair : probes) {
+    identifiers.insert(pair.first);
+  }
+  return identifiers;
+}
+
+void DistributedLogoSimulationEngine::requestSimulationAbortion() {
+  // The other ranks stop with this one at the start of the next step
+  abortionRequested = true;
+  if (stepBarrier) {
+    stepBarrier->interrupt();
+  }
+}
+
+void DistributedLogoSimulationEngine::runNewSimulation(
+    std::shared_ptr<mk::ISimulationModel> simulationModel) {
+  auto distributed =
+      std::dynamic_pointer_cast<model::DistributedLogoSimulationModel>(
+          simulationModel);
+  if (!distributed) {
+    throw std::invalid_argument(
+        "The model of a distributed Logo simulation must be a "
+        "DistributedLogoSimulationModel.");
+  }
+  currentModel = distributed;
+  abortionRequested = false;
+  try {
+    initializeSimulation(distributed);
+    runSimulationLoop(
+        mk::SimulationTimeStamp(std::numeric_limits<long>::max()));
+  } catch (const std::exception &e) {
+    std::cerr << "Simulation failed on rank " << getRank() << ": "
+              << e.what() << std::endl;
+    throw;
+  }
+}
+
+void DistributedLogoSimulationEngine::runSimulation(
+    const mk::SimulationTimeStamp &finalTime) {
+  if (!currentModel) {
+    throw std::runtime_error("Simulation has not been initialized.");
+  }
+  abortionRequested = false;
+  try {
+    runSimulationLoop(finalTime);
+  } catch (const std::exception &e) {
+    std::cerr << "Simulation failed on rank " << getRank() << ": "
+              << e.what() << std::endl;
+    throw;
+  }
+}
+
+void DistributedLogoSimulationEngine::initializeSimulation(
+    std::shared_ptr<model::DistributedLogoSimulationModel> simulationModel) {
+  const mk::SimulationTimeStamp initialTime = simulationModel->getInitialTime();
+  currentTime = initialTime;
+
+  const int rank = getRank();
+  stepsSinceRebalance = 0;
+  rebalanceCount = 0;
+  busyTime = mk::StepTimings::Duration{0};
+  decomposition.reset();
+  const auto &grid = *simulationModel;
+  if (domainColumns > 0) {
+    decomposition.emplace(grid.getWidth(), grid.getHeight(),
+                          grid.isXAxisTorus(), grid.isYAxisTorus(),
+                          domainColumns, domainRows, grid.getHaloWidth());
+  } else {
+    decomposition.emplace(grid.getWidth(), grid.getHeight(),
+                          grid.isXAxisTorus(), grid.isYAxisTorus(),
+                          getRankCount(), grid.getHaloWidth());
+  }
+  domain = decomposition->getDomain(rank);
+  localGrid = decomposition->getLocalGrid(rank);
+
+  pheromones.assign(simulationModel->getPheromones().begin(),
+                    simulationModel->getPheromones().end());
+  std::sort(pheromones.begin(), pheromones.end(),
+            [](const auto &a, const auto &b) {
+              return a.getIdentifier() < b.getIdentifier();
+            });
+  const bool split =
+      decomposition->isXAxisSplit() || decomposition->isYAxisSplit();
+  for (const auto &pheromone : pheromones) {
+    // The ghost patches next to the domain diffuse as the patches they copy
+    // only when they have all their neighbours.
+    if (split && pheromone.getDiffusionCoef() > 0 &&
+        decomposition->getHaloWidth() < 2) {
+      throw std::invalid_argument(
+          "The diffusion of the pheromone '" + pheromone.getIdentifier() +
+          "' across the domains requires a halo of 2 patches.");
+    }
+  }
+
+  levels.clear();
+  for (const auto &generated : simulationModel->generateLevels(initialTime)) {
+    levels[generated->getIdentifier()] = generated;
+  }
+  auto logo = levels.find(LogoSimulationLevelList::LOGO);
+  if (levels.size() != 1 || logo == levels.end()) {
+    throw std::invalid_argument(
+        "A distributed Logo simulation has the LOGO level only.");
+  }
+  level = logo->second;
+
+  localEnvironment = std::make_shared<LogoEnvPLS>(
+      LogoSimulationLevelList::LOGO, localGrid.width, localGrid.height,
+      decomposition->isLocalXAxisTorus(), decomposition->isLocalYAxisTorus(),
+      simulationModel->getPheromones());
+  environment =
+      std::make_shared<model::environment::LogoEnvironment>(localEnvironment);
+  level->getLastConsistentState()->setPublicLocalStateOfEnvironment(
+      localEnvironment);
+
+  hosted.clear();
+  agents.clear();
+  for (auto &turtle : simulationModel->generateTurtles(initialTime, domain)) {
+    if (!turtle.state) {
+      continue;
+    }
+    const tools::Point2D location = turtle.state->getLocation();
+    const int x = static_cast<int>(std::floor(location.x));
+    const int y = static_cast<int>(std::floor(location.y));
+    if (!domain.contains(x, y)) {
+      continue;
+    }
+    turtle.state->setLocation(tools::Point2D(location.x - localGrid.x,
+                                             location.y - localGrid.y));
+    host(turtle.category, std::move(turtle.state));
+  }
+
+  buildPeers();
+  dynamicStates->put(level->getLastConsistentState());
+  notifyProbesOfPreparation();
+}
+
+void DistributedLogoSimulationEngine::buildPeers() {
+  // The halo cells of every rank are enumerated in the same order by all
+  // the ranks, so that the cells sent by a rank are the ones its peer
+  // expects without exchanging their list.
+  const int rank = getRank();
+  std::map<int, Peer> byRank;
+  haloCells.clear();
+  forEachHaloCell(domain, localGrid, [&](std::size_t cell, int gx, int gy) {
+    const int owner = decomposition->ownerOf(gx, gy);
+    Peer &peer = byRank[owner];
+    peer.rank = owner;
+    peer.receivedCells.push_back(cell);
+    haloCells.push_back(cell);
+  });
+  for (int other = 0; other < getRankCount(); ++other) {
+    if (other == rank) {
+      continue;
+    }
+    forEachHaloCell(decomposition->getDomain(other),
+                    decomposition->getLocalGrid(other),
+                    [&](std::size_t, int gx, int gy) {
+                      if (decomposition->ownerOf(gx, gy) != rank) {
+                        return;
+                      }
+                      const int x = decomposition->wrapX(gx) - localGrid.x;
+                      const int y = decomposition->wrapY(gy) - localGrid.y;
+                      Peer &peer = byRank[other];
+                      peer.rank = other;
+                      peer.sentCells.push_back(
+                          static_cast<std::size_t>(y) * localGrid.width + x);
+                    });
+  }
+  peers.clear();
+  for (auto &pair : byRank) {
+    Peer &peer = pair.second;
+    for (std::size_t k = 0; k < peer.sentCells.size(); ++k) {
+      peer.sentIndices.emplace(peer.sentCells[k], k);
+    }
+    peers.push_back(std::move(peer));
+  }
+}
+
+std::shared_ptr<mk::agents::IAgent4Engine>
+DistributedLogoSimulationEngine::host(
+    const mk::AgentCategory &category,
+    std::shared_ptr<TurtlePLSInLogo> turtle) {
+  auto agent = currentModel->createAgent(category, turtle);
+  if (!agent) {
+    throw std::invalid_argument("The model created no agent for a turtle.");
+  }
+  const auto agentLevels = agent->getLevels();
+  if (agentLevels.find(LogoSimulationLevelList::LOGO) == agentLevels.end()) {
+    throw std::invalid_argument(
+        "The agent of a turtle must lie in the LOGO level.");
+  }
+  const tools::Point2D location = turtle->getLocation();
+  localEnvironment
+      ->getTurtlesInPatches()(static_cast<int>(location.x),
+                              static_cast<int>(location.y))
+      .insert(turtle);
+  if (auto state = agent->getPublicLocalState(LogoSimulationLevelList::LOGO)) {
+    level->getLastConsistentState()->addPublicLocalStateOfAgent(state);
+  }
+  agents.insert(agent);
+  hosted.push_back(HostedTurtle{agent, std::move(turtle)});
+  return agent;
+}
+
+void DistributedLogoSimulationEngine::runSimulationLoop(
+    const mk::SimulationTimeStamp &finalTime) {
+  notifyProbesOfStart(currentTime);
+
+  for (;;) {
+    if (stepBarrier) {
+      stepBarrier->awaitStep(abortionRequested);
+    }
+    // The ranks stop together, as soon as one of them has to.
+    const mk::SimulationTimeStamp nextTime = level->getNextTime(currentTime);
+    double stop[2] = {
+        currentModel->isFinalTimeOrAfter(currentTime, *this) ||
+                !(currentTime < finalTime) || finalTime < nextTime
+            ? 1.0
+            : 0.0,
+        abortionRequested ? 1.0 : 0.0};
+    communicator->allReduce(stop, 2, IDomainCommunicator::Reduction::MAX);
+    if (stop[0] != 0.0 || stop[1] != 0.0) {
+      break;
+    }
+
+    // The rebalancing measures the loads of the ranks
+    const bool timed =
+        static_cast<bool>(stepTimingListener) || rebalancePeriod > 0;
+    mk::StepTimings timings;
+    const Clock::time_point stepStart =
+        timed ? Clock::now() : Clock::time_point();
+    if (timed) {
+      timings.timeLowerBound = currentTime;
+      timings.timeUpperBound = nextTime;
+      timings.agentCount = hosted.size();
+    }
+    step(currentTime, nextTime, timed ? &timings : nullptr);
+
+    currentTime = nextTime;
+    const Clock::time_point probesStart =
+        timed ? Clock::now() : Clock::time_point();
+    notifyProbesOfUpdate(currentTime);
+    if (timed) {
+      timings.probes = elapsedSince(probesStart);
+      timings.total = elapsedSince(stepStart);
+      timings.workerBusy = timings.agentPhase;
+      busyTime += timings.perception + timings.revision + timings.decision +
+                  timings.reaction;
+      if (stepTimingListener) {
+        stepTimingListener->stepTimed(timings);
+      }
+    }
+    rebalanceIfNeeded();
+  }
+
+  notifyProbesOfEnd(currentTime);
+}
+
+void DistributedLogoSimulationEngine::step(
+    const mk::SimulationTimeStamp &timeLowerBound,
+    const mk::SimulationTimeStamp &timeUpperBound, mk::StepTimings *timings) {
+  Clock::time_point mark = timings ? Clock::now() : Clock::time_point();
+  auto lap = [&](mk::StepTimings::Duration mk::StepTimings::*phase) {
+    if (timings) {
+      const Clock::time_point now = Clock::now();
+      timings->*phase +=
+          std::chrono::duration_cast<mk::StepTimings::Duration>(now - mark);
+      mark = now;
+    }
+  };
+  const mk::LevelIdentifier &levelId = LogoSimulationLevelList::LOGO;
+
+  exchangeHalo();
+  lap(&mk::StepTimings::merge);
+  const Clock::time_point agentPhaseStart = mark;
+
+  auto levelInfluences = std::make_shared<mk::influences::InfluencesMap>();
+  {
+    influenceArena->reset();
+    mk::influences::InfluenceArena::Scope arenaScope(*influenceArena);
+    for (const auto &turtle : hosted) {
+      const auto &agent = turtle.agent;
+      auto perceivedData = agent->perceive(
+          levelId, timeLowerBound, timeUpperBound,
+          agent->borrowPublicLocalStates(),
+          agent->borrowPrivateLocalState(levelId), dynamicStates);
+      agent->setPerceivedData(std::move(perceivedData));
+    }
+    lap(&mk::StepTimings::perception);
+    for (const auto &turtle : hosted) {
+      const auto &agent = turtle.agent;
+      agent->reviseGlobalState(timeLowerBound, timeUpperBound,
+                               agent->borrowPerceivedData(),
+                               agent->borrowGlobalState());
+      lap(&mk::StepTimings::revision);
+      agent->decide(levelId, timeLowerBound, timeUpperBound,
+                    agent->borrowGlobalState(),
+                    agent->borrowPublicLocalState(levelId),
+                    agent->borrowPrivateLocalState(levelId),
+                    agent->borrowLastPerceivedData(levelId), levelInfluences);
+      lap(&mk::StepTimings::decision);
+    }
+  }
+  if (timings) {
+    timings->agentPhase += elapsedSince(agentPhaseStart);
+  }
+
+  // The ghost turtles leave with the influences aimed at them: their own
+  // rank reacts to the influences of its agents.
+  clearHalo();
+  auto consistentState = level->getLastConsistentState();
+  std::set<std::shared_ptr<mk::influences::IInfluence>> regularInfluences;
+  std::vector<std::shared_ptr<mk::influences::IInfluence>> systemInfluences;
+  auto emitted = levelInfluences->getInfluencesForLevel(levelId);
+  if (timings) {
+    timings->influenceCount += emitted.size();
+  }
+  for (auto &influence : emitted) {
+    if (influence->isSystem()) {
+      systemInfluences.push_back(std::move(influence));
+      continue;
+    }
+    if (const TurtlePLSInLogo *target = targetOf(*influence)) {
+      const tools::Point2D location = target->getLocation();
+      if (!isInDomain(static_cast<int>(location.x),
+                      static_cast<int>(location.y))) {
+        continue;
+      }
+    }
+    regularInfluences.insert(std::move(influence));
+  }
+  mirrorEmissions(timeLowerBound, timeUpperBound, regularInfluences);
+  // The natural influences of the environment
+  regularInfluences.insert(
+      std::make_shared<kernel::influences::PheromoneFieldUpdate>(
+          timeLowerBound, timeUpperBound));
+  regularInfluences.insert(
+      std::make_shared<kernel::influences::AgentPositionUpdate>(
+          timeLowerBound, timeUpperBound));
+  lap(&mk::StepTimings::merge);
+
+  auto remainingInfluences = std::make_shared<mk::influences::InfluencesMap>();
+  std::vector<std::shared_ptr<mk::influences::IInfluence>> levelSystem;
+  for (const auto &influence : systemInfluences) {
+    using mk::influences::system::SystemInfluenceRemoveAgent;
+    const auto *removal =
+        dynamic_cast<const SystemInfluenceRemoveAgent *>(influence.get());
+    if (removal == nullptr) {
+      levelSystem.push_back(influence);
+      continue;
+    }
+    auto it = std::find_if(hosted.begin(), hosted.end(), [&](const auto &h) {
+      return h.agent == removal->getAgent();
+    });
+    if (it == hosted.end()) {
+      continue;
+    }
+    const tools::Point2D location = it->turtle->getLocation();
+    localEnvironment
+        ->getTurtlesInPatches()(static_cast<int>(location.x),
+                                static_cast<int>(location.y))
+        .erase(it->turtle);
+    if (auto state = it->agent->getPublicLocalState(levelId)) {
+      consistentState->removePublicLocalStateOfAgent(state);
+    }
+    agents.erase(it->agent);
+    hosted.erase(it);
+  }
+  if (!levelSystem.empty()) {
+    level->makeSystemReaction(timeLowerBound, timeUpperBound, consistentState,
+                              levelSystem, true, remainingInfluences);
+  }
+  level->makeRegularReaction(timeLowerBound, timeUpperBound, consistentState,
+                             regularInfluences, remainingInfluences);
+  consistentState->setTime(timeUpperBound);
+  dynamicStates->put(consistentState);
+  lap(&mk::StepTimings::reaction);
+
+  migrateTurtles();
+  lap(&mk::StepTimings::structuralUpdate);
+}
+
+void DistributedLogoSimulationEngine::exchange(
+    const std::vector<mk::checkpoint::CheckpointWriter> &messages) {
+  std::vector<int> ranks;
+  ranks.reserve(peers.size());
+  for (const Peer &peer : peers) {
+    ranks.push_back(peer.rank);
+  }
+  exchange(ranks, messages);
+}
+
+void DistributedLogoSimulationEngine::exchange(
+    const std::vector<int> &ranks,
+    const std::vector<mk::checkpoint::CheckpointWriter> &messages) {
+  std::vector<std::span<const std::uint8_t>> outgoing;
+  outgoing.reserve(ranks.size());
+  for (std::size_t i = 0; i < ranks.size(); ++i) {
+    outgoing.emplace_back(messages[i].getBytes());
+  }
+  communicator->exchange(ranks, outgoing, incoming);
+}
+
+void DistributedLogoSimulationEngine::exchangeHalo() {
+  if (peers.empty()) {
+    return;
+  }
+  auto &fields = localEnvironment->getPheromoneField();
+  auto &patches = localEnvironment->getTurtlesInPatches();
+  const int width = localGrid.width;
+
+  std::vector<mk::checkpoint::CheckpointWriter> messages(peers.size());
+  for (std::size_t i = 0; i < peers.size(); ++i) {
+    auto &message = messages[i];
+    const auto &cells = peers[i].sentCells;
+    for (const auto &pheromone : pheromones) {
+      const auto &values = fields.at(pheromone)->values;
+      for (const std::size_t cell : cells) {
+        message.writeDouble(values[cell]);
+      }
+    }
+    std::uint64_t occupied = 0;
+    for (const std::size_t cell : cells) {
+      occupied += patches[cell].empty() ? 0 : 1;
+    }
+    message.writeU64(occupied);
+    for (std::size_t k = 0; k < cells.size(); ++k) {
+      const auto &turtles = patches[cells[k]];
+      if (turtles.empty()) {
+        continue;
+      }
+      message.writeU64(k);
+      message.writeU64(turtles.size());
+      const double x = static_cast<double>(cells[k] % width);
+      const double y = static_cast<double>(cells[k] / width);
+      for (const auto &turtle : turtles) {
+        const tools::Point2D location = turtle->getLocation();
+        writeTurtle(message, *turtle, location.x - x, location.y - y);
+      }
+    }
+  }
+  exchange(messages);
+
+  for (std::size_t i = 0; i < peers.size(); ++i) {
+    mk::checkpoint::CheckpointReader reader(incoming[i].data(),
+                                            incoming[i].size());
+    const auto &cells = peers[i].receivedCells;
+    for (const auto &pheromone : pheromones) {
+      auto &field = fields.at(pheromone).mutate();
+      for (const std::size_t cell : cells) {
+        field.set(static_cast<int>(cell % width),
+                  static_cast<int>(cell / width), reader.readDouble());
+      }
+    }
+    const std::uint64_t occupied = reader.readU64();
+    for (std::uint64_t c = 0; c < occupied; ++c) {
+      const std::size_t cell = cells.at(reader.readU64());
+      const std::uint64_t count = reader.readU64();
+      const int x = static_cast<int>(cell % width);
+      const int y = static_cast<int>(cell / width);
+      for (std::uint64_t t = 0; t < count; ++t) {
+        patches[cell].insert(readTurtle(reader, x, y));
+      }
+    }
+  }
+}
+
+void DistributedLogoSimulationEngine::mirrorEmissions(
+    const mk::SimulationTimeStamp &timeLowerBound,
+    const mk::SimulationTimeStamp &timeUpperBound,
+    std::set<std::shared_ptr<mk::influences::IInfluence>> &regularInfluences) {
+  if (peers.empty()) {
+    return;
+  }
+  using kernel::influences::EmitPheromone;
+  const int width = localGrid.width;
+  std::vector<mk::checkpoint::CheckpointWriter> messages(peers.size());
+  for (const auto &influence : regularInfluences) {
+    if (influence->getTypeTag() !=
+        mk::influences::influenceTypeTag<EmitPheromone>()) {
+      continue;
+    }
+    const auto &emission = static_cast<const EmitPheromone &>(*influence);
+    const tools::Point2D location = emission.getLocation();
+    const std::size_t cell =
+        static_cast<std::size_t>(static_cast<int>(location.y)) * width +
+        static_cast<int>(location.x);
+    for (std::size_t i = 0; i < peers.size(); ++i) {
+      const auto range = peers[i].sentIndices.equal_range(cell);
+      for (auto it = range.first; it != range.second; ++it) {
+        messages[i].writeU64(it->second);
+        messages[i].writeString(emission.getPheromoneIdentifier());
+        messages[i].writeDouble(emission.getValue());
+      }
+    }
+  }
+  exchange(messages);
+
+  for (std::size_t i = 0; i < peers.size(); ++i) {
+    mk::checkpoint::CheckpointReader reader(incoming[i].data(),
+                                            incoming[i].size());
+    while (!reader.atEnd()) {
+      const std::size_t cell = peers[i].receivedCells.at(reader.readU64());
+      std::string identifier = reader.readString();
+      const double value = reader.readDouble();
+      regularInfluences.insert(std::make_shared<EmitPheromone>(
+          timeLowerBound, timeUpperBound,
+          tools::Point2D(static_cast<double>(cell % width) + 0.5,
+                         static_cast<double>(cell / width) + 0.5),
+          identifier, value));
+    }
+  }
+}
+
+void DistributedLogoSimulationEngine::clearHalo() {
+  auto &patches = localEnvironment->getTurtlesInPatches();
+  for (const std::size_t cell : haloCells) {
+    patches[cell].clear();
+  }
+}
+
+void DistributedLogoSimulationEngine::migrateTurtles() {
+  if (peers.empty()) {
+    return;
+  }
+  const mk::LevelIdentifier &levelId = LogoSimulationLevelList::LOGO;
+  auto consistentState = level->getLastConsistentState();
+  auto &patches = localEnvironment->getTurtlesInPatches();
+
+  std::vector<mk::checkpoint::CheckpointWriter> messages(peers.size());
+  std::size_t kept = 0;
+  for (std::size_t i = 0; i < hosted.size(); ++i) {
+    HostedTurtle &turtle = hosted[i];
+    const tools::Point2D location = turtle.turtle->getLocation();
+    const int x = static_cast<int>(location.x);
+    const int y = static_cast<int>(location.y);
+    if (isInDomain(x, y)) {
+      if (kept != i) {
+        hosted[kept] = std::move(turtle);
+      }
+      ++kept;
+      continue;
+    }
+    const int gx = decomposition->wrapX(localGrid.x + x);
+    const int gy = decomposition->wrapY(localGrid.y + y);
+    const int owner = decomposition->ownerOf(gx, gy);
+    auto peer =
+        std::find_if(peers.begin(), peers.end(),
+                     [owner](const Peer &p) { return p.rank == owner; });
+    writeMigrant(messages[static_cast<std::size_t>(peer - peers.begin())],
+                 turtle, gx, gy);
+
+    const auto &agent = turtle.agent;
+    patches(x, y).erase(turtle.turtle);
+    if (auto state = agent->getPublicLocalState(levelId)) {
+      consistentState->removePublicLocalStateOfAgent(state);
+    }
+    agents.erase(agent);
+  }
+  hosted.resize(kept);
+
+  exchange(messages);
+  for (std::size_t i = 0; i < peers.size(); ++i) {
+    mk::checkpoint::CheckpointReader reader(incoming[i].data(),
+                                            incoming[i].size());
+    while (!reader.atEnd()) {
+      hostMigrant(reader);
+    }
+  }
+}
+
+void DistributedLogoSimulationEngine::writeMigrant(
+    mk::checkpoint::CheckpointWriter &message, const HostedTurtle &turtle,
+    int gx, int gy) const {
+  const mk::LevelIdentifier &levelId = LogoSimulationLevelList::LOGO;
+  const tools::Point2D location = turtle.turtle->getLocation();
+  message.writeI64(gx);
+  message.writeI64(gy);
+  writeTurtle(message, *turtle.turtle, location.x - std::floor(location.x),
+              location.y - std::floor(location.y));
+  const auto &agent = turtle.agent;
+  message.writeString(agent->getCategory().toString());
+  writeObject(message, agent);
+  writeObject(message, agent->getGlobalState());
+  writeObject(message, agent->getPublicLocalState(levelId));
+  writeObject(message, agent->getPrivateLocalState(levelId));
+}
+
+void DistributedLogoSimulationEngine::hostMigrant(
+    mk::checkpoint::CheckpointReader &reader) {
+  const mk::LevelIdentifier &levelId = LogoSimulationLevelList::LOGO;
+  const int x = static_cast<int>(reader.readI64()) - localGrid.x;
+  const int y = static_cast<int>(reader.readI64()) - localGrid.y;
+  auto turtle = readTurtle(reader, x, y);
+  const mk::AgentCategory category(reader.readString());
+  auto agent = host(category, std::move(turtle));
+  readObject(reader, agent, "an agent");
+  readObject(reader, agent->getGlobalState(), "a global state");
+  readObject(reader, agent->getPublicLocalState(levelId),
+             "a public local state");
+  readObject(reader, agent->getPrivateLocalState(levelId),
+             "a private local state");
+}
+
+void DistributedLogoSimulationEngine::rebalanceIfNeeded() {
+  if (rebalancePeriod <= 0 || ++stepsSinceRebalance < rebalancePeriod) {
+    return;
+  }
+  stepsSinceRebalance = 0;
+  const double busy = std::chrono::duration<double>(busyTime).count();
+  busyTime = mk::StepTimings::Duration{0};
+  // The ranks agree on the imbalance, then on the loads, which they sum in
+  // the same order: they all compute the same decomposition.
+  double total = busy;
+  double busiest = busy;
+  communicator->allReduce(&total, 1, IDomainCommunicator::Reduction::SUM);
+  communicator->allReduce(&busiest, 1, IDomainCommunicator::Reduction::MAX);
+  const double mean = total / getRankCount();
+  if (!(mean > 0.0) || busiest <= rebalanceThreshold * mean) {
+    return;
+  }
+
+  const auto &grid = *decomposition;
+  const int width = grid.getWidth();
+  std::vector<double> loads(static_cast<std::size_t>(width) +
+                                grid.getHeight(),
+                            0.0);
+  const double units =
+      static_cast<double>(hosted.size()) +
+      PATCH_LOAD * static_cast<double>(domain.width) * domain.height;
+  const double unit = units > 0.0 ? busy / units : 0.0;
+  for (int x = domain.x; x < domain.x + domain.width; ++x) {
+    loads[x] += unit * PATCH_LOAD * domain.height;
+  }
+  for (int y = domain.y; y < domain.y + domain.height; ++y) {
+    loads[width + y] += unit * PATCH_LOAD * domain.width;
+  }
+  for (const auto &turtle : hosted) {
+    const tools::Point2D location = toGlobal(turtle.turtle->getLocation());
+    loads[static_cast<int>(location.x)] += unit;
+    loads[width + static_cast<int>(location.y)] += unit;
+  }
+  communicator->allReduce(loads.data(), loads.size(),
+                          IDomainCommunicator::Reduction::SUM);
+
+  const tools::DomainDecomposition balanced =
+      grid.rebalanced(std::vector<double>(loads.begin(), loads.begin() + width),
+                      std::vector<double>(loads.begin() + width, loads.end()));
+  if (balanced.hasSameDomains(grid)) {
+    return;
+  }
+  repartition(balanced);
+  ++rebalanceCount;
+}
+
+void DistributedLogoSimulationEngine::repartition(
+    const tools::DomainDecomposition &balanced) {
+  const int rank = getRank();
+  const Box newDomain = balanced.getDomain(rank);
+  const Box newGrid = balanced.getLocalGrid(rank);
+
+  // The ranks taking patches from this one, or giving it patches
+  std::vector<int> ranks;
+  for (int other = 0; other < getRankCount(); ++other) {
+    if (other == rank) {
+      continue;
+    }
+    const Box given = intersection(domain, balanced.getDomain(other));
+    const Box taken = intersection(decomposition->getDomain(other), newDomain);
+    if (given.width * given.height > 0 || taken.width * taken.height > 0) {
+      ranks.push_back(other);
+    }
+  }
+
+  // The patches given away, with the turtles on them
+  const mk::LevelIdentifier &levelId = LogoSimulationLevelList::LOGO;
+  auto consistentState = level->getLastConsistentState();
+  std::vector<mk::checkpoint::CheckpointWriter> messages(ranks.size());
+  std::vector<Box> given(ranks.size());
+  for (std::size_t i = 0; i < ranks.size(); ++i) {
+    given[i] = intersection(domain, balanced.getDomain(ranks[i]));
+    writePatches(messages[i], *localEnvironment, pheromones, given[i],
+                 localGrid.x, localGrid.y);
+  }
+  std::vector<std::vector<const HostedTurtle *>> leaving(ranks.size());
+  std::size_t kept = 0;
+  for (std::size_t t = 0; t < hosted.size(); ++t) {
+    const tools::Point2D location = hosted[t].turtle->getLocation();
+    const int gx = localGrid.x + static_cast<int>(location.x);
+    const int gy = localGrid.y + static_cast<int>(location.y);
+    std::size_t i = 0;
+    while (i < ranks.size() && !given[i].contains(gx, gy)) {
+      ++i;
+    }
+    if (i == ranks.size()) {
+      if (kept != t) {
+        hosted[kept] = std::move(hosted[t]);
+      }
+      ++kept;
+      continue;
+    }
+    writeMigrant(messages[i], hosted[t], gx, gy);
+    const auto &agent = hosted[t].agent;
+    if (auto state = agent->getPublicLocalState(levelId)) {
+      consistentState->removePublicLocalStateOfAgent(state);
+    }
+    agents.erase(agent);
+  }
+  hosted.resize(kept);
+
+  // The local grid of the new domain, with the patches kept and their
+  // turtles in its coordinates
+  auto resized = std::make_shared<LogoEnvPLS>(
+      levelId, newGrid.width, newGrid.height, balanced.isLocalXAxisTorus(),
+      balanced.isLocalYAxisTorus(), currentModel->getPheromones());
+  {
+    const Box kept = intersection(domain, newDomain);
+    mk::checkpoint::CheckpointWriter copy;
+    writePatches(copy, *localEnvironment, pheromones, kept, localGrid.x,
+                 localGrid.y);
+    mk::checkpoint::CheckpointReader reader(copy.getBytes().data(),
+                                            copy.size());
+    readPatches(reader, *resized, pheromones, kept, newGrid.x, newGrid.y);
+  }
+  const double shiftX = localGrid.x - newGrid.x;
+  const double shiftY = localGrid.y - newGrid.y;
+  for (const auto &turtle : hosted) {
+    const tools::Point2D location = turtle.turtle->getLocation();
+    turtle.turtle->setLocation(
+        tools::Point2D(location.x + shiftX, location.y + shiftY));
+    const tools::Point2D moved = turtle.turtle->getLocation();
+    resized
+        ->getTurtlesInPatches()(static_cast<int>(moved.x),
+                                static_cast<int>(moved.y))
+        .insert(turtle.turtle);
+  }
+
+  const tools::DomainDecomposition old = *decomposition;
+  decomposition = balanced;
+  domain = newDomain;
+  localGrid = newGrid;
+  localEnvironment = resized;
+  environment =
+      std::make_shared<model::environment::LogoEnvironment>(localEnvironment);
+  consistentState->setPublicLocalStateOfEnvironment(localEnvironment);
+
+  // The patches taken from the other ranks, with the turtles on them
+  exchange(ranks, messages);
+  for (std::size_t i = 0; i < ranks.size(); ++i) {
+    mk::checkpoint::CheckpointReader reader(incoming[i].data(),
+                                            incoming[i].size());
+    readPatches(reader, *localEnvironment, pheromones,
+                intersection(old.getDomain(ranks[i]), newDomain), localGrid.x,
+                localGrid.y);
+    while (!reader.atEnd()) {
+      hostMigrant(reader);
+    }
+  }
+
+  buildPeers();
+  dynamicStates->put(consistentState);
+}
+
+void DistributedLogoSimulationEngine::setStepTimingListener(
+    std::shared_ptr<mk::IStepTimingListener> listener) {
+  stepTimingListener = std::move(listener);
+}
+
+std::shared_ptr<mk::IStepTimingListener>
+DistributedLogoSimulationEngine::getStepTimingListener() const {
+  return stepTimingListener;
+}
+
+void DistributedLogoSimulationEngine::setStepBarrier(
+    std::shared_ptr<mk::engine::StepBarrier> barrier) {
+  stepBarrier = std::move(barrier);
+}
+
+std::shared_ptr<mk::engine::StepBarrier>
+DistributedLogoSimulationEngine::getStepBarrier() const {
+  return stepBarrier;
+}
+
+void DistributedLogoSimulationEngine::notifyProbesOfPreparation() {
+  std::lock_guard<std::mutex> lock(probesMutex);
+  for (auto &pair : probes) {
+    pair.second->prepareObservation();
+  }
+}
+
+void DistributedLogoSimulationEngine::notifyProbesOfStart(
+    const mk::SimulationTimeStamp &initialTime) {
+  std::lock_guard<std::mutex> lock(probesMutex);
+  for (auto &pair : probes) {
+    pair.second->observeAtInitialTimes(initialTime, *this);
+  }
+}
+
+void DistributedLogoSimulationEngine::notifyProbesOfEnd(
+    const mk::SimulationTimeStamp &finalTime) {
+  std::lock_guard<std::mutex> lock(probesMutex);
+  for (auto &pair : probes) {
+    pair.second->observeAtFinalTime(finalTime, *this);
+    pair.second->endObservation();
+  }
+}
+
+void DistributedLogoSimulationEngine::notifyProbesOfUpdate(
+    const mk::SimulationTimeStamp &time) {
+  std::lock_guard<std::mutex> lock(probesMutex);
+  for (auto &pair : probes) {
+    pair.second->observeAtPartialConsistentTime(time, *this);
+  }
+}
+
+std::shared_ptr<mk::dynamicstate::IPublicDynamicStateMap>
+DistributedLogoSimulationEngine::getSimulationDynamicStates() const {
+  return dynamicStates;
+}
+
+std::set<std::shared_ptr<mk::agents::IAgent4Engine>>
+DistributedLogoSimulationEngine::getAgents() const {
+  return agents;
+}
+
+std::set<mk::LevelIdentifier>
+DistributedLogoSimulationEngine::getLevelIdentifiers() const {
+  std::set<mk::LevelIdentifier> ids;
+  for (const auto &pair : levels) {
+    ids.insert(pair.first);
+  }
+  return ids;
+}
+
+std::map<mk::LevelIdentifier, std::shared_ptr<mk::levels::ILevel>>
+DistributedLogoSimulationEngine::getLevels() const {
+  return levels;
+}
+
+std::set<std::shared_ptr<mk::agents::IAgent4Engine>>
+DistributedLogoSimulationEngine::getAgents(
+    const mk::LevelIdentifier &levelId) const {
+  if (levelId == LogoSimulationLevelList::LOGO) {
+    return agents;
+  }
+  return {};
+}
+
+std::shared_ptr<mk::environment::IEnvironment4Engine>
+DistributedLogoSimulationEngine::getEnvironment() const {
+  return environment;
+}
+
+std::shared_ptr<mk::dynamicstate::ConsistentPublicLocalDynamicState>
+DistributedLogoSimulationEngine::disambiguation(
+    std::shared_ptr<mk::dynamicstate::TransitoryPublicLocalDynamicState>
+    /*transitoryDynamicState*/) const {
+  // As the sequential engine, which has no transitory states to resolve
+  return nullptr;
+}
+
+std::shared_ptr<mk::ISimulationEngine>
+DistributedLogoSimulationEngine::clone() const {
+  throw std::logic_error(
+      "A distributed engine runs with the engines of the other ranks, and "
+      "cannot be cloned.");
+}
+
+} // namespace engine
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
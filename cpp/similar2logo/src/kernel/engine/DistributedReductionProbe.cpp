@@ -0,0 +1,69 @@
+#include "kernel/engine/DistributedReductionProbe.h"
+#include <stdexcept>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace engine {
+
+DistributedReductionProbe::DistributedReductionProbe(
+    std::size_t valueCount, IDomainCommunicator::Reduction reduction,
+    Measure measure, Report report, int reportingRank)
+    : valueCount(valueCount), reduction(reduction),
+      measure(std::move(measure)), report(std::move(report)),
+      reportingRank(reportingRank) {
+  if (!this->measure || !this->report) {
+    throw std::invalid_argument(
+        "The measure and the report of a probe cannot be null.");
+  }
+}
+
+void DistributedReductionProbe::observeAtInitialTimes(
+    const mk::SimulationTimeStamp &initialTimestamp,
+    const mk::ISimulationEngine &simulationEngine) {
+  observe(initialTimestamp, simulationEngine);
+}
+
+void DistributedReductionProbe::observeAtPartialConsistentTime(
+    const mk::SimulationTimeStamp &timestamp,
+    const mk::ISimulationEngine &simulationEngine) {
+  observe(timestamp, simulationEngine);
+}
+
+void DistributedReductionProbe::observeAtFinalTime(
+    const mk::SimulationTimeStamp &finalTimestamp,
+    const mk::ISimulationEngine &simulationEngine) {
+  observe(finalTimestamp, simulationEngine);
+}
+
+void DistributedReductionProbe::observe(
+    const mk::SimulationTimeStamp &timestamp,
+    const mk::ISimulationEngine &simulationEngine) {
+  const auto *engine =
+      dynamic_cast<const DistributedLogoSimulationEngine *>(&simulationEngine);
+  if (engine == nullptr) {
+    throw std::invalid_argument(
+        "A reduction probe observes a DistributedLogoSimulationEngine.");
+  }
+  values.assign(valueCount, 0.0);
+  measure(*engine, values);
+  // A measure resizing the values would desynchronize the ranks
+  if (values.size() != valueCount) {
+    throw std::logic_error("The measure changed the number of values.");
+  }
+  engine->allReduce(values.data(), values.size(), reduction);
+  if (reportingRank < 0 || reportingRank == engine->getRank()) {
+    report(timestamp, values);
+  }
+}
+
+} // namespace engine
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -0,0 +1,95 @@
+#include "kernel/engine/LocalDomainCommunicator.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace engine {
+
+std::vector<std::shared_ptr<LocalDomainCommunicator>>
+LocalDomainCommunicator::createGroup(int size) {
+  if (size < 1) {
+    throw std::invalid_argument("A group holds at least one rank.");
+  }
+  auto group = std::make_shared<Group>(size);
+  std::vector<std::shared_ptr<LocalDomainCommunicator>> communicators;
+  communicators.reserve(static_cast<std::size_t>(size));
+  for (int rank = 0; rank < size; ++rank) {
+    communicators.push_back(std::shared_ptr<LocalDomainCommunicator>(
+        new LocalDomainCommunicator(group, rank)));
+  }
+  return communicators;
+}
+
+int LocalDomainCommunicator::getSize() const { return group->size; }
+
+void LocalDomainCommunicator::Group::await() {
+  std::unique_lock<std::mutex> lock(mutex);
+  const unsigned long arrival = generation;
+  if (++waiting == size) {
+    waiting = 0;
+    ++generation;
+    released.notify_all();
+    return;
+  }
+  released.wait(lock, [&] { return generation != arrival; });
+}
+
+void LocalDomainCommunicator::exchange(
+    const std::vector<int> &peers,
+    const std::vector<std::span<const std::uint8_t>> &outgoing,
+    std::vector<std::vector<std::uint8_t>> &incoming) {
+  if (peers.size() != outgoing.size()) {
+    throw std::invalid_argument("A message is sent to each peer.");
+  }
+  const std::size_t size = static_cast<std::size_t>(group->size);
+  for (std::size_t i = 0; i < peers.size(); ++i) {
+    group->mailboxes[rank * size + peers[i]].assign(outgoing[i].begin(),
+                                                    outgoing[i].end());
+  }
+  group->await();
+  incoming.resize(peers.size());
+  for (std::size_t i = 0; i < peers.size(); ++i) {
+    // Only this rank reads the mailbox, refilled after the next barrier
+    incoming[i].swap(group->mailboxes[peers[i] * size + rank]);
+    group->mailboxes[peers[i] * size + rank].clear();
+  }
+  group->await();
+}
+
+void LocalDomainCommunicator::allReduce(double *values, std::size_t count,
+                                        Reduction reduction) {
+  group->contributions[rank].assign(values, values + count);
+  group->await();
+  for (std::size_t i = 0; i < count; ++i) {
+    double result = group->contributions[0].at(i);
+    for (int other = 1; other < group->size; ++other) {
+      const double value = group->contributions[other].at(i);
+      switch (reduction) {
+      case Reduction::SUM:
+        result += value;
+        break;
+      case Reduction::MIN:
+        result = std::min(result, value);
+        break;
+      case Reduction::MAX:
+        result = std::max(result, value);
+        break;
+      }
+    }
+    values[i] = result;
+  }
+  group->await();
+}
+
+} // namespace engine
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -0,0 +1,127 @@
+#ifdef SIMILAR2LOGO_MPI
+
+#include "kernel/engine/MpiDomainCommunicator.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace engine {
+
+namespace {
+
+constexpr int SIZE_TAG = 1;
+constexpr int MESSAGE_TAG = 2;
+
+void check(int error, const char *operation) {
+  if (error != MPI_SUCCESS) {
+    throw std::runtime_error(std::string("MPI failed to ") + operation);
+  }
+}
+
+} // namespace
+
+MpiDomainCommunicator::MpiDomainCommunicator(MPI_Comm communicator)
+    : communicator(communicator), rank(0), size(1) {
+  check(MPI_Comm_rank(communicator, &rank), "get the rank");
+  check(MPI_Comm_size(communicator, &size), "get the size");
+}
+
+void MpiDomainCommunicator::exchange(
+    const std::vector<int> &peers,
+    const std::vector<std::span<const std::uint8_t>> &outgoing,
+    std::vector<std::vector<std::uint8_t>> &incoming) {
+  if (peers.size() != outgoing.size()) {
+    throw std::invalid_argument("A message is sent to each peer.");
+  }
+  const std::size_t count = peers.size();
+  std::vector<unsigned long long> sentSizes(count);
+  std::vector<unsigned long long> receivedSizes(count);
+  std::vector<MPI_Request> requests;
+  requests.reserve(2 * count);
+  for (std::size_t i = 0; i < count; ++i) {
+    if (outgoing[i].size() >
+        static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+      throw std::length_error("A message exceeds the size of an MPI message");
+    }
+    sentSizes[i] = outgoing[i].size();
+    requests.emplace_back();
+    check(MPI_Irecv(&receivedSizes[i], 1, MPI_UNSIGNED_LONG_LONG, peers[i],
+                    SIZE_TAG, communicator, &requests.back()),
+          "receive a size");
+    requests.emplace_back();
+    check(MPI_Isend(&sentSizes[i], 1, MPI_UNSIGNED_LONG_LONG, peers[i],
+                    SIZE_TAG, communicator, &requests.back()),
+          "send a size");
+  }
+  check(MPI_Waitall(static_cast<int>(requests.size()), requests.data(),
+                    MPI_STATUSES_IGNORE),
+        "exchange the sizes");
+
+  requests.clear();
+  incoming.resize(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    incoming[i].resize(static_cast<std::size_t>(receivedSizes[i]));
+    requests.emplace_back();
+    check(MPI_Irecv(incoming[i].data(), static_cast<int>(receivedSizes[i]),
+                    MPI_BYTE, peers[i], MESSAGE_TAG, communicator,
+                    &requests.back()),
+          "receive a message");
+    requests.emplace_back();
+    check(MPI_Isend(outgoing[i].data(), static_cast<int>(outgoing[i].size()),
+                    MPI_BYTE, peers[i], MESSAGE_TAG, communicator,
+                    &requests.back()),
+          "send a message");
+  }
+  check(MPI_Waitall(static_cast<int>(requests.size()), requests.data(),
+                    MPI_STATUSES_IGNORE),
+        "exchange the messages");
+}
+
+void MpiDomainCommunicator::allReduce(double *values, std::size_t count,
+                                      Reduction reduction) {
+  if (count == 0) {
+    return;
+  }
+  // Gathered, then combined in the order of the ranks on every rank: the
+  // order of MPI_Allreduce is left to the implementation.
+  std::vector<double> gathered(count * static_cast<std::size_t>(size));
+  check(MPI_Allgather(values, static_cast<int>(count), MPI_DOUBLE,
+                      gathered.data(), static_cast<int>(count), MPI_DOUBLE,
+                      communicator),
+        "gather the values");
+  for (std::size_t i = 0; i < count; ++i) {
+    double result = gathered[i];
+    for (int other = 1; other < size; ++other) {
+      const double value = gathered[other * count + i];
+      switch (reduction) {
+      case Reduction::SUM:
+        result += value;
+        break;
+      case Reduction::MIN:
+        result = std::min(result, value);
+        break;
+      case Reduction::MAX:
+        result = std::max(result, value);
+        break;
+      }
+    }
+    values[i] = result;
+  }
+}
+
+} // namespace engine
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_MPI
@@ -2,11 +2,17 @@
 #include "kernel/model/environment/Mark.h"
 #include "kernel/model/environment/Pheromone.h"
 #include "kernel/model/environment/TurtlePLSInLogo.h"
+#include "kernel/tools/FastMath.h"
 #include "kernel/tools/MathUtil.h"
+#include "kernel/tools/RowBands.h"
+#include "kernel/tools/SpaceFillingCurve.h"
 #include <algorithm>
 #include <cmath>
+#include <limits>
 #include <memory>
+#include <numeric>
 #include <random>
+#include <stdexcept>
 
 namespace fr::univ_artois::lgi2a::similar::similar2logo::kernel::environment {
 
@@ -14,141 +20,551 @@ using namespace fr::univ_artois::lgi2a::similar::similar2logo::kernel::model::
     environment; // for Pheromone
 namespace tools = fr::univ_artois::lgi2a::similar::similar2logo::kernel::tools;
 
-// Static empty set for out-of-bounds queries
-const std::unordered_set<std::shared_ptr<TurtlePLSInLogo>>
-    Environment::s_empty_turtle_set;
-
 static std::mt19937 rng{std::random_device{}()};
 
 Environment::Environment(int w, int h, bool tor)
-    : m_width(w), m_height(h), m_toroidal(tor) {
-  // Initialize marks grid
-  m_marks.resize(w);
-  for (int x = 0; x < w; ++x) {
-    m_marks[x].resize(h);
-  }
+    : m_width(w), m_height(h), m_toroidal(tor),
+      m_tile_columns((w + TILE_SIZE - 1) / TILE_SIZE),
+      m_tile_rows((h + TILE_SIZE - 1) / TILE_SIZE), m_diffusion(w, h, tor, tor),
+      m_marks(w, h) {}
 
-  // Initialize turtle spatial index
-  m_turtles_in_patches.resize(w);
-  for (int x = 0; x < w; ++x) {
-    m_turtles_in_patches[x].resize(h);
+Environment::PheromoneHandle
+Environment::add_pheromone(const std::string &id, double diffusion,
+                           double evaporation, double default_val,
+                           double min_val) {
+  Pheromone pher(id, diffusion, evaporation, default_val, min_val);
+  const auto [it, added] = m_pheromone_handles.try_emplace(
+      id, static_cast<std::uint32_t>(m_pheromones.size()));
+  if (added) {
+    m_pheromones.push_back(pher);
+    m_pheromone_grids.emplace_back();
+  } else {
+    m_pheromones[it->second] = pher;
   }
-}
 
-Pheromone &Environment::add_pheromone(const std::string &id, double diffusion,
-                                      double evaporation, double default_val,
-                                      double min_val) {
-  Pheromone pher(id, diffusion, evaporation, default_val, min_val);
-  m_pheromones.insert_or_assign(id, pher);
+  PheromoneGrid &grid = m_pheromone_grids[it->second];
+  grid.assign(m_width, m_height, default_val);
+  grid.changed.assign(grid.active.size(), 1);
 
-  m_pheromone_grids[id] = std::vector<std::vector<double>>(
-      m_height, std::vector<double>(m_width, default_val));
+  return PheromoneHandle{it->second};
+}
 
-  return m_pheromones.at(id);
+std::optional<Environment::PheromoneHandle>
+Environment::find_pheromone(const std::string &id) const {
+  auto it = m_pheromone_handles.find(id);
+  if (it == m_pheromone_handles.end())
+    return std::nullopt;
+  return PheromoneHandle{it->second};
 }
 
-void Environment::set_pheromone(double x, double y, const std::string &id,
-                                double value) {
+std::size_t Environment::pheromone_cell(double x, double y) const {
   int ix = static_cast<int>(std::round(x));
   int iy = static_cast<int>(std::round(y));
-  if (m_toroidal) {
-    ix = (ix % m_width + m_width) % m_width;
-    iy = (iy % m_height + m_height) % m_height;
-  } else {
-    ix = std::clamp(ix, 0, m_width - 1);
-    iy = std::clamp(iy, 0, m_height - 1);
+  // the divisions are left to the cells outside the grid
+  if (ix < 0 || ix >= m_width || iy < 0 || iy >= m_height) {
+    if (m_toroidal) {
+      ix = (ix % m_width + m_width) % m_width;
+      iy = (iy % m_height + m_height) % m_height;
+    } else {
+      ix = std::clamp(ix, 0, m_width - 1);
+      iy = std::clamp(iy, 0, m_height - 1);
+    }
+  }
+  return static_cast<std::size_t>(iy) * m_width + ix;
+}
+
+void Environment::set_pheromone(double x, double y, PheromoneHandle pheromone,
+                                double value) {
+  const std::size_t cell = pheromone_cell(x, y);
+  PheromoneGrid &grid = m_pheromone_grids[pheromone.index];
+  grid.values[cell] = value;
+  const std::size_t tile = (cell / m_width / TILE_SIZE) * m_tile_columns +
+                           cell % m_width / TILE_SIZE;
+  grid.changed[tile] = 1;
+  if (value != 0) {
+    grid.active[tile] = 1;
   }
+}
+
+double Environment::get_pheromone_value(double x, double y,
+                                        PheromoneHandle pheromone) const {
+  return m_pheromone_grids[pheromone.index].values[pheromone_cell(x, y)];
+}
+
+void Environment::set_pheromone_values(PheromoneHandle pheromone,
+                                       const double *values) {
+  PheromoneGrid &grid = m_pheromone_grids[pheromone.index];
+  tools::RowBands::forEach(
+      m_tile_rows, TILE_SIZE * m_width, [&](int first, int end) {
+        for (int ty = first; ty < end; ++ty) {
+          const int y_end = std::min(m_height, (ty + 1) * TILE_SIZE);
+          for (int tx = 0; tx < m_tile_columns; ++tx) {
+            const int x0 = tx * TILE_SIZE;
+            const int x_end = std::min(m_width, x0 + TILE_SIZE);
+            bool non_zero = false;
+            for (int y = ty * TILE_SIZE; y < y_end; ++y) {
+              const std::size_t row = static_cast<std::size_t>(y) * m_width;
+              for (int x = x0; x < x_end; ++x) {
+                auto &value = grid.values[row + x];
+                value = static_cast<tools::TiledField::Value>(values[row + x]);
+                non_zero = non_zero || value != 0;
+              }
+            }
+            const std::size_t tile =
+                static_cast<std::size_t>(ty) * m_tile_columns + tx;
+            grid.changed[tile] = 1;
+            if (non_zero) {
+              grid.active[tile] = 1;
+            }
+          }
+        }
+      });
+}
 
-  if (m_pheromone_grids.find(id) != m_pheromone_grids.end()) {
-    m_pheromone_grids.at(id)[iy][ix] = value;
+void Environment::set_pheromone(double x, double y, const std::string &id,
+                                double value) {
+  if (const auto pheromone = find_pheromone(id)) {
+    set_pheromone(x, y, *pheromone, value);
   }
 }
 
 double Environment::get_pheromone_value(double x, double y,
                                         const std::string &id) const {
-  int ix = static_cast<int>(std::round(x));
-  int iy = static_cast<int>(std::round(y));
-  if (m_toroidal) {
-    ix = (ix % m_width + m_width) % m_width;
-    iy = (iy % m_height + m_height) % m_height;
-  } else {
-    ix = std::clamp(ix, 0, m_width - 1);
-    iy = std::clamp(iy, 0, m_height - 1);
+  if (const auto pheromone = find_pheromone(id)) {
+    return get_pheromone_value(x, y, *pheromone);
   }
-  auto it = m_pheromone_grids.find(id);
-  if (it != m_pheromone_grids.end())
-    return it->second[iy][ix];
   return 0.0;
 }
 
-void Environment::diffuse_and_evaporate(double dt) {
-  for (auto &[id, pheromone] : m_pheromones) {
-    auto &grid = m_pheromone_grids[id];
-
-    // Diffusion
-    if (pheromone.getDiffusionCoef() > 0) {
-      std::vector<std::vector<double>> new_grid = grid; // Copy
-
-      for (int y = 0; y < m_height; ++y) {
-        for (int x = 0; x < m_width; ++x) {
-          double current_value = grid[y][x];
-          if (current_value <= 0)
+void Environment::emit_pheromones(
+    const std::vector<PheromoneDeposit> &deposits) {
+  const std::size_t count = deposits.size();
+  const std::uint32_t none = static_cast<std::uint32_t>(m_tile_rows);
+  std::vector<std::uint32_t> cells(count);
+  std::vector<std::uint32_t> rows(count);
+  microkernel::engine::WorkStealingThreadPool::parallelForOnCurrent(
+      count, 0, [&](std::size_t begin, std::size_t end, std::size_t) {
+        for (std::size_t i = begin; i < end; ++i) {
+          const PheromoneDeposit &deposit = deposits[i];
+          if (deposit.pheromone.index >= m_pheromone_grids.size()) {
+            rows[i] = none;
             continue;
+          }
+          const std::size_t cell = pheromone_cell(deposit.x, deposit.y);
+          cells[i] = static_cast<std::uint32_t>(cell);
+          rows[i] = static_cast<std::uint32_t>(cell / m_width / TILE_SIZE);
+        }
+      });
 
-          // Get neighbors (8-connected)
-          std::vector<std::pair<int, int>> neighbors;
-          for (int dy = -1; dy <= 1; ++dy) {
-            for (int dx = -1; dx <= 1; ++dx) {
-              if (dx == 0 && dy == 0)
-                continue;
-
-              int nx = x + dx;
-              int ny = y + dy;
-
-              if (m_toroidal) {
-                nx = (nx % m_width + m_width) % m_width;
-                ny = (ny % m_height + m_height) % m_height;
-              } else {
-                if (nx < 0 || nx >= m_width || ny < 0 || ny >= m_height)
-                  continue;
-              }
-              neighbors.push_back({nx, ny});
-            }
+  std::vector<std::uint32_t> start;
+  std::vector<std::uint32_t> order;
+  tools::RowBands::sortByRow(rows, m_tile_rows, start, order);
+  tools::RowBands::forEach(
+      m_tile_rows, TILE_SIZE * m_width, [&](int first, int end) {
+        for (std::uint32_t k = start[first]; k < start[end]; ++k) {
+          const std::uint32_t i = order[k];
+          PheromoneGrid &grid = m_pheromone_grids[deposits[i].pheromone.index];
+          auto &value = grid.values[cells[i]];
+          value += deposits[i].value;
+          const std::size_t tile =
+              static_cast<std::size_t>(rows[i]) * m_tile_columns +
+              cells[i] % m_width / TILE_SIZE;
+          grid.changed[tile] = 1;
+          if (value != 0) {
+            grid.active[tile] = 1;
           }
+        }
+      });
+}
 
-          if (neighbors.empty())
-            continue;
+double Environment::interpolate(const tools::TiledField::Values &values,
+                                double x, double y) const {
+  const double floor_x = std::floor(x);
+  const double floor_y = std::floor(y);
+  int x0 = static_cast<int>(floor_x);
+  int y0 = static_cast<int>(floor_y);
+  int x1 = x0 + 1;
+  int y1 = y0 + 1;
+  // as in pheromone_cell(), only the cells across a border are wrapped
+  if (x0 < 0 || x1 >= m_width) {
+    if (m_toroidal) {
+      x0 = (x0 % m_width + m_width) % m_width;
+      x1 = x0 + 1 == m_width ? 0 : x0 + 1;
+    } else {
+      x0 = std::clamp(x0, 0, m_width - 1);
+      x1 = std::clamp(x1, 0, m_width - 1);
+    }
+  }
+  if (y0 < 0 || y1 >= m_height) {
+    if (m_toroidal) {
+      y0 = (y0 % m_height + m_height) % m_height;
+      y1 = y0 + 1 == m_height ? 0 : y0 + 1;
+    } else {
+      y0 = std::clamp(y0, 0, m_height - 1);
+      y1 = std::clamp(y1, 0, m_height - 1);
+    }
+  }
+  const auto *row0 = values.data() + static_cast<std::size_t>(y0) * m_width;
+  const auto *row1 = values.data() + static_cast<std::size_t>(y1) * m_width;
+  const double tx = x - floor_x;
+  const double top = row0[x0] + (row0[x1] - row0[x0]) * tx;
+  const double bottom = row1[x0] + (row1[x1] - row1[x0]) * tx;
+  return top + (bottom - top) * (y - floor_y);
+}
 
-          double diffusion_amount =
-              pheromone.getDiffusionCoef() * current_value * dt;
-          double amount_per_neighbor = diffusion_amount / neighbors.size();
+double Environment::sample_pheromone(double x, double y,
+                                     PheromoneHandle pheromone) const {
+  return interpolate(m_pheromone_grids[pheromone.index].values, x, y);
+}
+
+void Environment::sample_gradient(const tools::Point2D &point, double heading,
+                                  const double *angles, std::size_t count,
+                                  double distance, PheromoneHandle pheromone,
+                                  double *readings) const {
+  const auto &values = m_pheromone_grids[pheromone.index].values;
+  for (std::size_t k = 0; k < count; ++k) {
+    const double direction = heading + angles[k];
+    readings[k] = interpolate(values, point.x + distance * std::cos(direction),
+                              point.y + distance * std::sin(direction));
+  }
+}
 
-          for (const auto &n : neighbors) {
-            new_grid[n.second][n.first] += amount_per_neighbor;
+Environment::GradientSample
+Environment::sample_gradient(const tools::Point2D &point, double heading,
+                             double angle, double distance,
+                             PheromoneHandle pheromone) const {
+  const double angles[3] = {angle, 0.0, -angle};
+  double readings[3];
+  sample_gradient(point, heading, angles, 3, distance, pheromone, readings);
+  return GradientSample{readings[0], readings[1], readings[2]};
+}
+
+std::vector<Environment::GradientSample>
+Environment::sample_gradient_all(double angle, double distance,
+                                 PheromoneHandle pheromone) const {
+  const TurtleStore &store = m_turtle_store;
+  const auto &values = m_pheromone_grids[pheromone.index].values;
+  std::vector<GradientSample> samples(store.size());
+  const double cos_angle = std::cos(angle);
+  const double sin_angle = std::sin(angle);
+  microkernel::engine::WorkStealingThreadPool::parallelForOnCurrent(
+      store.size(), 0, [&](std::size_t begin, std::size_t end, std::size_t) {
+        // the headings are turned into directions by blocks, whose sines
+        // and cosines stay in the cache
+        constexpr std::size_t BLOCK = 256;
+        TurtleStore::Real sines[BLOCK];
+        TurtleStore::Real cosines[BLOCK];
+        for (std::size_t first = begin; first < end; first += BLOCK) {
+          const std::size_t n = std::min(BLOCK, end - first);
+          microkernel::tools::FastMath::sinCos(store.heading.data() + first,
+                                               sines, cosines, n);
+          for (std::size_t j = 0; j < n; ++j) {
+            const std::size_t i = first + j;
+            const double x = store.x[i];
+            const double y = store.y[i];
+            const double dx = cosines[j] * distance;
+            const double dy = sines[j] * distance;
+            // (dx, dy) rotated by +angle and -angle
+            const double left_dx = dx * cos_angle - dy * sin_angle;
+            const double left_dy = dy * cos_angle + dx * sin_angle;
+            const double right_dx = dx * cos_angle + dy * sin_angle;
+            const double right_dy = dy * cos_angle - dx * sin_angle;
+            samples[i] =
+                GradientSample{interpolate(values, x + left_dx, y + left_dy),
+                               interpolate(values, x + dx, y + dy),
+                               interpolate(values, x + right_dx, y + right_dy)};
           }
-          new_grid[y][x] -= diffusion_amount;
         }
+      });
+  return samples;
+}
+
+std::size_t Environment::get_active_tile_count(const std::string &id) const {
+  const auto pheromone = find_pheromone(id);
+  if (!pheromone)
+    return 0;
+  const auto &active = m_pheromone_grids[pheromone->index].active;
+  return static_cast<std::size_t>(
+      std::count(active.begin(), active.end(), 1));
+}
+
+namespace {
+
+// Wraps a coordinate into [0, length) as fmod does, without its cost for
+// the coordinates less than one length away from the grid: the subtraction
+// is then exact.
+double wrap(double coordinate, double length) {
+  if (coordinate >= length && coordinate < 2 * length) {
+    return coordinate - length;
+  }
+  if (coordinate > -length && coordinate < 0) {
+    return coordinate + length;
+  }
+  double wrapped = std::fmod(coordinate, length);
+  if (wrapped < 0)
+    wrapped += length;
+  return wrapped;
+}
+
+} // namespace
+
+void Environment::diffuse_and_evaporate(double dt) {
+  for (std::size_t p = 0; p < m_pheromones.size(); ++p) {
+    const Pheromone &pheromone = m_pheromones[p];
+    PheromoneGrid &grid = m_pheromone_grids[p];
+    m_diffusion.add(grid,
+                    tools::FieldDiffusion::Rates{
+                        pheromone.getDiffusionCoef() * dt,
+                        pheromone.getEvaporationCoef() > 0,
+                        pheromone.getEvaporationCoef() * dt,
+                        pheromone.getMinValue()},
+                    m_change_history != 0 ? &grid.changed : nullptr);
+  }
+  m_diffusion.run();
+  prefetch_turtle_tiles();
+  update_pheromone_pyramids();
+}
+
+void Environment::prefetch_turtle_tiles() const {
+  if (m_pheromone_grids.empty() ||
+      !m_pheromone_grids.front().values.storage().isFileBacked()) {
+    return;
+  }
+  // The tile rows where the turtles stand are the ones their next
+  // perceptions and trails read
+  const int rows = m_pheromone_grids.front().tileRows();
+  std::vector<unsigned char> occupied(static_cast<std::size_t>(rows), 0);
+  for (std::size_t turtle = 0; turtle < m_turtle_store.size(); ++turtle) {
+    const int y = static_cast<int>(
+        wrap(m_turtle_store.y[turtle], static_cast<double>(m_height)));
+    occupied[std::min(y / tools::TiledField::TILE_SIZE, rows - 1)] = 1;
+  }
+  for (const PheromoneGrid &grid : m_pheromone_grids) {
+    for (int ty = 0; ty < rows; ++ty) {
+      if (occupied[ty]) {
+        grid.prefetchTileRow(ty);
       }
-      grid = new_grid;
     }
+  }
+}
 
-    // Evaporation
-    if (pheromone.getEvaporationCoef() > 0) {
-      for (int y = 0; y < m_height; ++y) {
-        for (int x = 0; x < m_width; ++x) {
-          double current_value = grid[y][x];
-          double evaporation =
-              pheromone.getEvaporationCoef() * current_value * dt;
-          double new_value = current_value - evaporation;
+void Environment::enable_pheromone_pyramid(
+    PheromoneHandle pheromone, tools::PheromonePyramid::Reduction reduction) {
+  PheromoneGrid &grid = m_pheromone_grids[pheromone.index];
+  if (!grid.pyramid || grid.pyramid->getReduction() != reduction) {
+    grid.pyramid.emplace(reduction);
+  }
+  grid.pyramid->update(grid);
+}
 
-          if (new_value < pheromone.getMinValue()) {
-            new_value = 0.0;
-          }
-          grid[y][x] = new_value;
+void Environment::update_pheromone_pyramids() {
+  for (PheromoneGrid &grid : m_pheromone_grids) {
+    if (grid.pyramid) {
+      grid.pyramid->update(grid);
+    }
+  }
+}
+
+tools::PheromonePyramid::Peak
+Environment::strongest_pheromone_within(const tools::Point2D &point,
+                                        double radius,
+                                        PheromoneHandle pheromone) const {
+  const PheromoneGrid &grid = m_pheromone_grids[pheromone.index];
+  if (!grid.pyramid) {
+    throw std::logic_error("The pheromone " +
+                           m_pheromones[pheromone.index].getIdentifier() +
+                           " has no pyramid.");
+  }
+  double x = point.x;
+  double y = point.y;
+  if (m_toroidal) {
+    x -= std::floor(x / m_width) * m_width;
+    y -= std::floor(y / m_height) * m_height;
+  }
+  return grid.pyramid->strongestWithin(grid, x, y, radius, m_toroidal);
+}
+
+// change tracking ----------------------------------------------------
+void Environment::set_change_history(std::size_t commits) {
+  if (commits == 0 || m_change_history == 0) {
+    m_changes_started = false;
+    m_change_records.clear();
+    m_mark_changes.clear();
+    m_turtle_snapshot = TurtleSnapshot();
+  }
+  m_change_history = commits;
+  while (m_change_records.size() > m_change_history) {
+    m_changes_horizon = m_change_records.front().time;
+    m_change_records.pop_front();
+  }
+}
+
+std::vector<std::size_t> Environment::slots_by_id() const {
+  const std::vector<std::uint64_t> &ids = m_turtle_store.id;
+  std::vector<std::size_t> slots(ids.size());
+  std::iota(slots.begin(), slots.end(), std::size_t(0));
+  if (!std::is_sorted(ids.begin(), ids.end())) {
+    std::sort(slots.begin(), slots.end(),
+              [&ids](std::size_t a, std::size_t b) { return ids[a] < ids[b]; });
+  }
+  return slots;
+}
+
+void Environment::diff_turtles(std::vector<std::uint64_t> &changed,
+                               std::vector<std::uint64_t> &removed) {
+  // The snapshot is sorted by identifier, and so are the slots visited, so
+  // that a merge pairs the turtles kept since the last commit.
+  const TurtleStore &store = m_turtle_store;
+  TurtleSnapshot &last = m_turtle_snapshot;
+  const std::vector<std::size_t> slots = slots_by_id();
+  std::size_t i = 0;
+  std::size_t j = 0;
+  while (i < last.id.size() || j < store.size()) {
+    const std::size_t s = j < store.size() ? slots[j] : 0;
+    if (j == store.size() || (i < last.id.size() && last.id[i] < store.id[s])) {
+      removed.push_back(last.id[i++]);
+    } else if (i == last.id.size() || store.id[s] < last.id[i]) {
+      changed.push_back(store.id[s]);
+      ++j;
+    } else {
+      if (last.x[i] != store.x[s] || last.y[i] != store.y[s] ||
+          last.heading[i] != store.heading[s] ||
+          last.speed[i] != store.speed[s] ||
+          last.acceleration[i] != store.acceleration[s] ||
+          last.color[i] != store.color[s]) {
+        changed.push_back(store.id[s]);
+      }
+      ++i;
+      ++j;
+    }
+  }
+  auto gather = [&slots](auto &to, const auto &from) {
+    to.resize(from.size());
+    for (std::size_t k = 0; k < slots.size(); ++k) {
+      to[k] = from[slots[k]];
+    }
+  };
+  gather(last.id, store.id);
+  gather(last.x, store.x);
+  gather(last.y, store.y);
+  gather(last.heading, store.heading);
+  gather(last.speed, store.speed);
+  gather(last.acceleration, store.acceleration);
+  gather(last.color, store.color);
+}
+
+void Environment::commit_changes(const microkernel::SimulationTimeStamp &time) {
+  if (m_change_history == 0) {
+    return;
+  }
+  ChangeRecord record{time.getIdentifier(), {}, {}, {}, {}};
+  record.tiles.resize(m_pheromone_grids.size());
+  for (std::size_t p = 0; p < m_pheromone_grids.size(); ++p) {
+    std::vector<unsigned char> &changed = m_pheromone_grids[p].changed;
+    for (std::size_t t = 0; t < changed.size(); ++t) {
+      if (changed[t]) {
+        record.tiles[p].push_back(static_cast<std::uint32_t>(t));
+      }
+    }
+    std::fill(changed.begin(), changed.end(), 0);
+  }
+  record.marks.swap(m_mark_changes);
+  diff_turtles(record.turtles, record.removed_turtles);
+  m_last_commit = record.time;
+  if (!m_changes_started) {
+    // the baseline of the following commits
+    m_changes_started = true;
+    m_changes_horizon = record.time;
+    return;
+  }
+  m_change_records.push_back(std::move(record));
+  while (m_change_records.size() > m_change_history) {
+    m_changes_horizon = m_change_records.front().time;
+    m_change_records.pop_front();
+  }
+}
+
+Environment::Changes
+Environment::get_changes_since(
+    const microkernel::SimulationTimeStamp &time) const {
+  Changes changes{false, m_last_commit, {}, {}, {}, {}};
+  const long since = time.getIdentifier();
+  if (m_change_history == 0 || !m_changes_started ||
+      since < m_changes_horizon) {
+    return changes;
+  }
+  changes.complete = true;
+  const auto first = std::partition_point(
+      m_change_records.begin(), m_change_records.end(),
+      [since](const ChangeRecord &record) { return record.time <= since; });
+
+  const std::size_t tile_count =
+      static_cast<std::size_t>(m_tile_columns) * m_tile_rows;
+  const std::size_t tile_cells =
+      static_cast<std::size_t>(TILE_SIZE) * TILE_SIZE;
+  std::vector<unsigned char> seen(tile_count);
+  for (std::size_t p = 0; p < m_pheromone_grids.size(); ++p) {
+    PheromoneTiles tiles{PheromoneHandle{static_cast<std::uint32_t>(p)}, {},
+                         {}};
+    for (auto record = first; record != m_change_records.end(); ++record) {
+      if (p >= record->tiles.size()) {
+        continue;
+      }
+      for (const std::uint32_t tile : record->tiles[p]) {
+        if (!seen[tile]) {
+          seen[tile] = 1;
+          tiles.tiles.push_back(tile);
         }
       }
     }
+    if (tiles.tiles.empty()) {
+      continue;
+    }
+    std::sort(tiles.tiles.begin(), tiles.tiles.end());
+    const auto &values = m_pheromone_grids[p].values;
+    tiles.values.assign(tiles.tiles.size() * tile_cells, 0.0);
+    double *out = tiles.values.data();
+    for (const std::uint32_t tile : tiles.tiles) {
+      seen[tile] = 0;
+      const int x0 = static_cast<int>(tile % m_tile_columns) * TILE_SIZE;
+      const int y0 = static_cast<int>(tile / m_tile_columns) * TILE_SIZE;
+      const int columns = std::min(TILE_SIZE, m_width - x0);
+      const int rows = std::min(TILE_SIZE, m_height - y0);
+      for (int r = 0; r < rows; ++r) {
+        const auto *row =
+            values.data() + static_cast<std::size_t>(y0 + r) * m_width + x0;
+        std::copy(row, row + columns, out + r * TILE_SIZE);
+      }
+      out += tile_cells;
+    }
+    changes.pheromones.push_back(std::move(tiles));
+  }
+
+  std::vector<std::uint64_t> turtles;
+  for (auto record = first; record != m_change_records.end(); ++record) {
+    changes.marks.insert(changes.marks.end(), record->marks.begin(),
+                         record->marks.end());
+    turtles.insert(turtles.end(), record->turtles.begin(),
+                   record->turtles.end());
+    changes.removed_turtles.insert(changes.removed_turtles.end(),
+                                   record->removed_turtles.begin(),
+                                   record->removed_turtles.end());
+  }
+  std::sort(turtles.begin(), turtles.end());
+  turtles.erase(std::unique(turtles.begin(), turtles.end()), turtles.end());
+  std::sort(changes.removed_turtles.begin(), changes.removed_turtles.end());
+  // the turtles removed after their change are only in removed_turtles
+  const std::vector<std::uint64_t> &ids = m_turtle_store.id;
+  const std::vector<std::size_t> slots = slots_by_id();
+  for (const std::uint64_t id : turtles) {
+    const auto slot = std::lower_bound(
+        slots.begin(), slots.end(), id,
+        [&ids](std::size_t s, std::uint64_t value) { return ids[s] < value; });
+    if (slot != slots.end() && ids[*slot] == id) {
+      changes.turtles.push_back(TurtleChange{id, m_turtles[*slot]});
+    }
   }
+  return changes;
 }
 
 tools::Point2D Environment::random_position() const {
@@ -171,29 +587,75 @@ double Environment::get_distance(const tools::Point2D &a,
 
 double Environment::get_direction(const tools::Point2D &from,
                                   const tools::Point2D &to) const {
-  double dx = to.x - from.x;
-  double dy = to.y - from.y;
-  if (m_toroidal) {
-    if (std::abs(dx) > m_width / 2.0)
-      dx = dx > 0 ? dx - m_width : dx + m_width;
-    if (std::abs(dy) > m_height / 2.0)
-      dy = dy > 0 ? dy - m_height : dy + m_height;
-  }
-  return std::atan2(dx, -dy);
+  const tools::Point2D d =
+      tools::MathUtil::toroidalDisplacement(from, to, m_width, m_height,
+                                            m_toroidal, m_toroidal);
+  return std::atan2(d.x, -d.y);
 }
 
 // mark handling ------------------------------------------------------
 void Environment::add_mark(
     int x, int y, std::shared_ptr<model::environment::SimpleMark> mark) {
-  if (x >= 0 && x < m_width && y >= 0 && y < m_height) {
-    m_marks[x][y].insert(mark);
+  if (m_marks.add(x, y, mark) && m_change_history != 0) {
+    m_mark_changes.push_back(MarkChange{x, y, std::move(mark), true});
   }
 }
 
 void Environment::remove_mark(
     int x, int y, std::shared_ptr<model::environment::SimpleMark> mark) {
-  if (x >= 0 && x < m_width && y >= 0 && y < m_height) {
-    m_marks[x][y].erase(mark);
+  if (m_marks.remove(x, y, mark) && m_change_history != 0) {
+    m_mark_changes.push_back(MarkChange{x, y, std::move(mark), false});
+  }
+}
+
+std::vector<std::uint32_t> Environment::mark_cells(
+    const std::vector<std::shared_ptr<model::environment::SimpleMark>> &marks)
+    const {
+  std::vector<std::uint32_t> cells(marks.size(), MarkStore::NO_CELL);
+  for (std::size_t i = 0; i < marks.size(); ++i) {
+    if (marks[i]) {
+      const tools::Point2D location = marks[i]->getLocation();
+      const int x = static_cast<int>(std::floor(location.x));
+      const int y = static_cast<int>(std::floor(location.y));
+      if (x >= 0 && x < m_width && y >= 0 && y < m_height) {
+        cells[i] = static_cast<std::uint32_t>(y) * m_width + x;
+      }
+    }
+  }
+  return cells;
+}
+
+void Environment::add_marks(
+    const std::vector<std::shared_ptr<model::environment::SimpleMark>>
+        &marks) {
+  const std::vector<std::uint32_t> cells = mark_cells(marks);
+  const std::vector<unsigned char> added = m_marks.addAll(marks, cells);
+  if (m_change_history == 0) {
+    return;
+  }
+  for (std::size_t i = 0; i < marks.size(); ++i) {
+    if (added[i]) {
+      m_mark_changes.push_back(MarkChange{static_cast<int>(cells[i] % m_width),
+                                          static_cast<int>(cells[i] / m_width),
+                                          marks[i], true});
+    }
+  }
+}
+
+void Environment::remove_marks(
+    const std::vector<std::shared_ptr<model::environment::SimpleMark>>
+        &marks) {
+  const std::vector<std::uint32_t> cells = mark_cells(marks);
+  const std::vector<unsigned char> removed = m_marks.removeAll(marks, cells);
+  if (m_change_history == 0) {
+    return;
+  }
+  for (std::size_t i = 0; i < marks.size(); ++i) {
+    if (removed[i]) {
+      m_mark_changes.push_back(MarkChange{static_cast<int>(cells[i] % m_width),
+                                          static_cast<int>(cells[i] / m_width),
+                                          marks[i], false});
+    }
   }
 }
 
@@ -205,56 +667,573 @@ Environment::get_turtles() const {
 
 void Environment::add_turtle(
     std::shared_ptr<model::environment::TurtlePLSInLogo> turtle) {
-  m_turtles.push_back(turtle);
-
-  // Add to spatial index
-  tools::Point2D loc = turtle->getLocation();
-  int x = static_cast<int>(std::floor(loc.x));
-  int y = static_cast<int>(std::floor(loc.y));
-
-  if (x >= 0 && x < m_width && y >= 0 && y < m_height) {
-    m_turtles_in_patches[x][y].insert(turtle);
+  if (!turtle || turtle->getStore() == &m_turtle_store) {
+    return;
+  }
+  if (turtle->getStore()) {
+    throw std::invalid_argument(
+        "The turtle belongs to another environment");
   }
+  m_turtle_store.attach(*turtle);
+  m_turtles.push_back(std::move(turtle));
+  m_turtle_index_stale.store(true, std::memory_order_relaxed);
 }
 
 void Environment::remove_turtle(
     std::shared_ptr<model::environment::TurtlePLSInLogo> turtle) {
-  // Remove from main list
-  auto it = std::find(m_turtles.begin(), m_turtles.end(), turtle);
-  if (it != m_turtles.end()) {
-    m_turtles.erase(it);
+  if (!turtle || turtle->getStore() != &m_turtle_store) {
+    return;
   }
+  const std::size_t slot = turtle->getSlot();
+  m_turtle_store.detach(slot);
+  m_turtles.erase(m_turtles.begin() + slot);
+  m_turtle_index_stale.store(true, std::memory_order_relaxed);
+}
+
+void Environment::set_turtle_locations(const double *x, const double *y) {
+  TurtleStore &store = m_turtle_store;
+  std::transform(x, x + store.size(), store.x.begin(),
+                 [](double v) { return static_cast<TurtleStore::Real>(v); });
+  std::transform(y, y + store.size(), store.y.begin(),
+                 [](double v) { return static_cast<TurtleStore::Real>(v); });
+  m_turtle_index_stale.store(true, std::memory_order_relaxed);
+}
+
+void Environment::set_turtle_headings(const double *headings) {
+  TurtleStore &store = m_turtle_store;
+  std::transform(headings, headings + store.size(), store.heading.begin(),
+                 [](double v) { return static_cast<TurtleStore::Real>(v); });
+}
+
+void Environment::set_turtle_speeds(const double *speeds) {
+  TurtleStore &store = m_turtle_store;
+  std::transform(speeds, speeds + store.size(), store.speed.begin(),
+                 [](double v) { return static_cast<TurtleStore::Real>(v); });
+}
+
+void Environment::advance_turtles(double dt) {
+  using Real = TurtleStore::Real;
+  TurtleStore &store = m_turtle_store;
+  const std::size_t count = store.size();
+  m_turtle_sines.resize(count);
+  m_turtle_cosines.resize(count);
+  m_turtle_flags.resize(count);
+  Real *x = store.x.data();
+  Real *y = store.y.data();
+  Real *speed = store.speed.data();
+  const Real *acceleration = store.acceleration.data();
+  const Real *sines = m_turtle_sines.data();
+  const Real *cosines = m_turtle_cosines.data();
+  // the loops compute in the precision of the store
+  const Real step = static_cast<Real>(dt);
+  unsigned char *flags = m_turtle_flags.data();
 
-  // Remove from spatial index
-  tools::Point2D loc = turtle->getLocation();
-  int x = static_cast<int>(std::floor(loc.x));
-  int y = static_cast<int>(std::floor(loc.y));
+  // Java: speed += acceleration, with no dt multiplier, and no negative
+  // speed.
+  for (std::size_t i = 0; i < count; ++i) {
+    const Real next = speed[i] + acceleration[i];
+    speed[i] = next < 0 ? Real(0) : next;
+  }
+  microkernel::tools::FastMath::sinCos(store.heading.data(),
+                                       m_turtle_sines.data(),
+                                       m_turtle_cosines.data(), count);
 
-  if (x >= 0 && x < m_width && y >= 0 && y < m_height) {
-    m_turtles_in_patches[x][y].erase(turtle);
+  // The loops below have no branch, so that they are vectorized. The first
+  // one flags the turtles left to a second pass; it writes nothing else,
+  // since its stores could otherwise alias the coordinates.
+  const Real width = static_cast<Real>(m_width);
+  const Real height = static_cast<Real>(m_height);
+  std::size_t flagged = 0;
+  std::size_t moved = 0;
+  if (m_toroidal) {
+    // The turtles ending less than one grid length away from the grid are
+    // wrapped by a subtraction, exact as fmod is; the others are flagged.
+    for (std::size_t i = 0; i < count; ++i) {
+      const Real newX = x[i] + cosines[i] * speed[i] * step;
+      const Real newY = y[i] + sines[i] * speed[i] * step;
+      flags[i] = !((newX > -width) & (newX < 2 * width) & (newY > -height) &
+                   (newY < 2 * height));
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+      const Real newX = x[i] + cosines[i] * speed[i] * step;
+      const Real newY = y[i] + sines[i] * speed[i] * step;
+      Real wrappedX = newX >= width ? newX - width : newX;
+      wrappedX = wrappedX < 0 ? wrappedX + width : wrappedX;
+      Real wrappedY = newY >= height ? newY - height : newY;
+      wrappedY = wrappedY < 0 ? wrappedY + height : wrappedY;
+      const bool far = flags[i];
+      flagged += far;
+      moved += (wrappedX != x[i]) | (wrappedY != y[i]);
+      x[i] = far ? x[i] : wrappedX;
+      y[i] = far ? y[i] : wrappedY;
+    }
+    for (std::size_t i = 0; flagged != 0 && i < count; ++i) {
+      if (flags[i]) {
+        x[i] = wrap(x[i] + cosines[i] * speed[i] * step, width);
+        y[i] = wrap(y[i] + sines[i] * speed[i] * step, height);
+        moved = 1;
+      }
+    }
+  } else {
+    // The turtles leaving the grid are flagged, then removed with their
+    // location unchanged.
+    for (std::size_t i = 0; i < count; ++i) {
+      const Real newX = x[i] + cosines[i] * speed[i] * step;
+      const Real newY = y[i] + sines[i] * speed[i] * step;
+      flags[i] = (newX < 0) | (newX >= width) | (newY < 0) | (newY >= height);
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+      const Real newX = x[i] + cosines[i] * speed[i] * step;
+      const Real newY = y[i] + sines[i] * speed[i] * step;
+      const bool out = flags[i];
+      flagged += out;
+      moved += (newX != x[i]) | (newY != y[i]);
+      x[i] = out ? x[i] : newX;
+      y[i] = out ? y[i] : newY;
+    }
+    if (flagged != 0) {
+      store.detachIf(m_turtle_flags);
+      std::size_t kept = 0;
+      for (std::size_t i = 0; i < count; ++i) {
+        if (!m_turtle_flags[i]) {
+          m_turtles[kept++] = std::move(m_turtles[i]);
+        }
+      }
+      m_turtles.resize(kept);
+      moved = 1;
+    }
+  }
+  if (moved != 0) {
+    m_turtle_index_stale.store(true, std::memory_order_relaxed);
+  }
+  for (Crowd &crowd : m_crowds) {
+    crowd.field.advect(dt);
   }
+  if (m_turtle_reorder_period != 0 &&
+      ++m_turtle_advances >= m_turtle_reorder_period) {
+    reorder_turtles();
+  }
+}
+
+void Environment::reorder_turtles() {
+  m_turtle_advances = 0;
+  const TurtleStore &store = m_turtle_store;
+  const std::size_t count = store.size();
+  const unsigned bits = tools::SpaceFillingCurve::bitsFor(m_width, m_height);
+  m_turtle_keys.resize(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    const int x = static_cast<int>(std::floor(store.x[i]));
+    const int y = static_cast<int>(std::floor(store.y[i]));
+    m_turtle_keys[i] =
+        x >= 0 && x < m_width && y >= 0 && y < m_height
+            ? tools::SpaceFillingCurve::hilbertIndex(
+                  static_cast<std::uint32_t>(x), static_cast<std::uint32_t>(y),
+                  bits)
+            : std::numeric_limits<std::uint64_t>::max();
+  }
+  m_turtle_order.resize(count);
+  std::iota(m_turtle_order.begin(), m_turtle_order.end(), std::size_t(0));
+  std::stable_sort(m_turtle_order.begin(), m_turtle_order.end(),
+                   [this](std::size_t a, std::size_t b) {
+                     return m_turtle_keys[a] < m_turtle_keys[b];
+                   });
+  if (std::is_sorted(m_turtle_order.begin(), m_turtle_order.end())) {
+    return;
+  }
+  m_turtle_store.reorder(m_turtle_order);
+  std::vector<std::shared_ptr<model::environment::TurtlePLSInLogo>> turtles(
+      count);
+  for (std::size_t i = 0; i < count; ++i) {
+    turtles[i] = std::move(m_turtles[m_turtle_order[i]]);
+  }
+  m_turtles.swap(turtles);
+  m_turtle_index_stale.store(true, std::memory_order_relaxed);
 }
 
 // Spatial indexing methods
-const std::unordered_set<std::shared_ptr<model::environment::TurtlePLSInLogo>> &
+std::vector<std::shared_ptr<model::environment::TurtlePLSInLogo>>
 Environment::get_turtles_at(int x, int y) const {
-  if (x >= 0 && x < m_width && y >= 0 && y < m_height) {
-    return m_turtles_in_patches[x][y];
+  std::vector<std::shared_ptr<model::environment::TurtlePLSInLogo>> turtles;
+  for_each_turtle_at(x, y, [&](const auto &turtle) {
+    turtles.push_back(turtle);
+  });
+  return turtles;
+}
+
+std::vector<std::shared_ptr<model::environment::TurtlePLSInLogo>>
+Environment::get_turtles_in_radius(const tools::Point2D &center,
+                                   double radius) const {
+  std::vector<std::shared_ptr<model::environment::TurtlePLSInLogo>> turtles;
+  query_radius(center, radius,
+               [&](const auto &turtle) { turtles.push_back(turtle); });
+  return turtles;
+}
+
+std::vector<std::shared_ptr<model::environment::TurtlePLSInLogo>>
+Environment::get_turtles_in_cone(const tools::Point2D &center, double heading,
+                                 double angle, double radius) const {
+  std::vector<std::shared_ptr<model::environment::TurtlePLSInLogo>> turtles;
+  query_cone(center, heading, angle, radius,
+             [&](const auto &turtle) { turtles.push_back(turtle); });
+  return turtles;
+}
+
+std::vector<std::vector<std::shared_ptr<model::environment::TurtlePLSInLogo>>>
+Environment::get_turtles_in_radius_all(double radius) const {
+  std::vector<std::vector<std::shared_ptr<model::environment::TurtlePLSInLogo>>>
+      neighbours(m_turtles.size());
+  query_radius_all(radius, [&](std::size_t i, const auto &neighbour) {
+    neighbours[i].push_back(neighbour);
+  });
+  return neighbours;
+}
+
+void Environment::set_neighbourhood_cache(bool enabled) {
+  m_neighbourhood_cache_enabled = enabled;
+  clear_neighbourhoods();
+}
+
+const std::vector<std::uint32_t> *
+Environment::neighbourhood(const TurtleIndex &index,
+                           const tools::Point2D &center, double radius) const {
+  const int x = static_cast<int>(std::floor(center.x));
+  const int y = static_cast<int>(std::floor(center.y));
+  if (!(x >= 0 && x < m_width && y >= 0 && y < m_height)) {
+    return nullptr;
+  }
+  const NeighbourhoodKey key{
+      static_cast<std::uint32_t>(static_cast<std::size_t>(y) * m_width + x),
+      radius};
+  NeighbourhoodShard &shard =
+      m_neighbourhoods[key.patch % NEIGHBOURHOOD_SHARDS];
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    const auto found = shard.neighbourhoods.find(key);
+    if (found != shard.neighbourhoods.end()) {
+      return &found->second;
+    }
+  }
+  // The patches reached from anywhere in the patch: those of the square
+  // around the circle of radius + 1/2 centred on the middle of the patch.
+  // Two threads may collect the same neighbourhood, the first one kept.
+  std::vector<std::uint32_t> turtles;
+  int first_x, columns, first_y, rows;
+  patch_span(x + 0.5, radius + 0.5, m_width, first_x, columns);
+  patch_span(y + 0.5, radius + 0.5, m_height, first_y, rows);
+  for (int j = 0, row_y = first_y; j < rows; ++j) {
+    const std::size_t row = static_cast<std::size_t>(row_y) * m_width;
+    for (int i = 0, column = first_x; i < columns; ++i) {
+      turtles.insert(turtles.end(),
+                     index.turtles.begin() + index.start[row + column],
+                     index.turtles.begin() + index.start[row + column + 1]);
+      column = column + 1 == m_width ? 0 : column + 1;
+    }
+    row_y = row_y + 1 == m_height ? 0 : row_y + 1;
+  }
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  return &shard.neighbourhoods.try_emplace(key, std::move(turtles))
+              .first->second;
+}
+
+void Environment::clear_neighbourhoods() const {
+  for (NeighbourhoodShard &shard : m_neighbourhoods) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.neighbourhoods.clear();
   }
-  return s_empty_turtle_set;
 }
 
 void Environment::update_turtle_patch(
-    std::shared_ptr<model::environment::TurtlePLSInLogo> turtle, int old_x,
-    int old_y, int new_x, int new_y) {
-  // Remove from old patch
-  if (old_x >= 0 && old_x < m_width && old_y >= 0 && old_y < m_height) {
-    m_turtles_in_patches[old_x][old_y].erase(turtle);
+    std::shared_ptr<model::environment::TurtlePLSInLogo>, int, int, int,
+    int) {
+  m_turtle_index_stale.store(true, std::memory_order_relaxed);
+}
+
+std::size_t Environment::relocate_turtles(
+    const std::vector<std::shared_ptr<model::environment::TurtlePLSInLogo>>
+        &turtles,
+    std::uint64_t seed) {
+  if (turtles.empty()) {
+    return 0;
+  }
+  const TurtleIndex &index = turtle_index();
+  const std::size_t patches = static_cast<std::size_t>(m_width) * m_height;
+  m_empty_patches.assign(patches, [&](std::size_t patch) {
+    return index.start[patch + 1] > index.start[patch];
+  });
+  std::vector<std::uint32_t> origins(turtles.size(),
+                                     tools::MoveResolver::NO_CELL);
+  for (std::size_t i = 0; i < turtles.size(); ++i) {
+    const auto location = turtles[i]->getLocation();
+    const double x = std::floor(location.x);
+    const double y = std::floor(location.y);
+    if (x >= 0 && y >= 0 && x < m_width && y < m_height) {
+      const std::size_t patch =
+          static_cast<std::size_t>(y) * m_width + static_cast<std::size_t>(x);
+      if (index.start[patch + 1] - index.start[patch] == 1) {
+        origins[i] = static_cast<std::uint32_t>(patch);
+      }
+    }
+  }
+  std::vector<std::uint32_t> destinations;
+  const std::size_t moved = m_move_resolver.relocate(origins, m_empty_patches,
+                                                     seed, destinations);
+  for (std::size_t i = 0; i < turtles.size(); ++i) {
+    if (destinations[i] != tools::MoveResolver::NO_CELL) {
+      turtles[i]->setLocation(
+          tools::Point2D(destinations[i] % m_width + 0.5,
+                         destinations[i] / m_width + 0.5));
+    }
+  }
+  if (moved > 0) {
+    m_turtle_index_stale.store(true, std::memory_order_relaxed);
   }
+  return moved;
+}
+
+// crowd aggregation --------------------------------------------------
+void Environment::enable_crowds(const CrowdSettings &settings) {
+  if (settings.region_size <= 0) {
+    throw std::invalid_argument(
+        "The regions of the crowds must be at least one patch wide");
+  }
+  if (!(settings.release_density < settings.aggregate_density)) {
+    throw std::invalid_argument("The crowds must be released below the "
+                                "density they are aggregated at");
+  }
+  m_crowd_settings = settings;
+}
+
+void Environment::disable_crowds(std::uint64_t seed) {
+  if (m_crowd_settings) {
+    release_crowds(true, seed);
+  }
+  m_crowd_settings.reset();
+  m_crowds.clear();
+}
+
+void Environment::update_crowds(std::uint64_t seed) {
+  if (!m_crowd_settings) {
+    return;
+  }
+  release_crowds(false, seed);
+  aggregate_crowds();
+}
+
+void Environment::set_crowd_focus(double x, double y, double width,
+                                  double height) {
+  m_crowd_focus = CrowdFocus{x, y, width, height};
+}
+
+const tools::CrowdField *
+Environment::get_crowd(const std::string &color) const {
+  const std::uint32_t index = m_turtle_store.colorIndex(color);
+  for (const Crowd &crowd : m_crowds) {
+    if (crowd.color == index) {
+      return &crowd.field;
+    }
+  }
+  return nullptr;
+}
+
+double Environment::get_crowd_turtle_count() const {
+  double count = 0;
+  for (const Crowd &crowd : m_crowds) {
+    count += crowd.field.getMass();
+  }
+  return count;
+}
+
+bool Environment::crowd_focus_meets(int x, int y, int side) const {
+  return m_crowd_focus && x < m_crowd_focus->x + m_crowd_focus->width &&
+         m_crowd_focus->x < x + side &&
+         y < m_crowd_focus->y + m_crowd_focus->height &&
+         m_crowd_focus->y < y + side;
+}
+
+void Environment::release_crowds(bool all, std::uint64_t seed) {
+  const CrowdSettings &settings = *m_crowd_settings;
+  const int side = settings.region_size;
+  std::vector<tools::CrowdField::Member> members;
+  for (Crowd &crowd : m_crowds) {
+    for (int y = 0; y < m_height; y += side) {
+      for (int x = 0; x < m_width; x += side) {
+        const double mass = crowd.field.getMass(x, y, side, side);
+        if (mass <= 0) {
+          continue;
+        }
+        const double area = static_cast<double>(std::min(side, m_width - x)) *
+                            std::min(side, m_height - y);
+        if (all || mass < settings.release_density * area ||
+            crowd_focus_meets(x, y, side)) {
+          crowd.field.release(x, y, side, side, seed ^ crowd.color, members);
+        }
+      }
+    }
+    for (const auto &member : members) {
+      const tools::Point2D location(member.x, member.y);
+      std::shared_ptr<TurtlePLSInLogo> turtle;
+      if (crowd.stored.empty()) {
+        turtle = std::make_shared<TurtlePLSInLogo>(
+            location, member.heading, member.speed, 0.0, false,
+            m_turtle_store.colorName(crowd.color));
+      } else {
+        turtle = std::move(crowd.stored.back());
+        crowd.stored.pop_back();
+        turtle->setLocation(location);
+        turtle->setHeading(member.heading);
+        turtle->setSpeed(member.speed);
+        turtle->setAcceleration(0.0);
+      }
+      add_turtle(std::move(turtle));
+    }
+    members.clear();
+  }
+}
+
+void Environment::aggregate_crowds() {
+  const CrowdSettings &settings = *m_crowd_settings;
+  const int side = settings.region_size;
+  const int columns = (m_width + side - 1) / side;
+  const std::size_t regions =
+      static_cast<std::size_t>(columns) * ((m_height + side - 1) / side);
+  TurtleStore &store = m_turtle_store;
+  const std::size_t count = store.size();
 
-  // Add to new patch
-  if (new_x >= 0 && new_x < m_width && new_y >= 0 && new_y < m_height) {
-    m_turtles_in_patches[new_x][new_y].insert(turtle);
+  // the turtles of each color in each region
+  std::vector<std::uint32_t> colors;
+  std::vector<std::uint32_t> colorOf(count);
+  std::vector<std::uint32_t> regionOf(count, NO_PATCH);
+  for (std::size_t i = 0; i < count; ++i) {
+    const auto found = std::find(colors.begin(), colors.end(), store.color[i]);
+    colorOf[i] = static_cast<std::uint32_t>(found - colors.begin());
+    if (found == colors.end()) {
+      colors.push_back(store.color[i]);
+    }
+    const double x = std::floor(store.x[i]);
+    const double y = std::floor(store.y[i]);
+    if (x >= 0 && y >= 0 && x < m_width && y < m_height) {
+      regionOf[i] = static_cast<std::uint32_t>(
+          static_cast<std::size_t>(y) / side * columns +
+          static_cast<std::size_t>(x) / side);
+    }
+  }
+  std::vector<std::uint32_t> counts(colors.size() * regions);
+  for (std::size_t i = 0; i < count; ++i) {
+    if (regionOf[i] != NO_PATCH) {
+      ++counts[colorOf[i] * regions + regionOf[i]];
+    }
+  }
+
+  // the turtles of the dense regions outside the focus join their crowd
+  m_turtle_flags.assign(count, 0);
+  std::size_t aggregated = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    if (regionOf[i] == NO_PATCH) {
+      continue;
+    }
+    const int x = static_cast<int>(regionOf[i] % columns) * side;
+    const int y = static_cast<int>(regionOf[i] / columns) * side;
+    const double area = static_cast<double>(std::min(side, m_width - x)) *
+                        std::min(side, m_height - y);
+    if (counts[colorOf[i] * regions + regionOf[i]] <
+            settings.aggregate_density * area ||
+        crowd_focus_meets(x, y, side)) {
+      continue;
+    }
+    auto crowd = std::find_if(
+        m_crowds.begin(), m_crowds.end(),
+        [&](const Crowd &c) { return c.color == store.color[i]; });
+    if (crowd == m_crowds.end()) {
+      m_crowds.push_back(
+          Crowd{store.color[i],
+                tools::CrowdField(m_width, m_height, m_toroidal),
+                {}});
+      crowd = m_crowds.end() - 1;
+    }
+    const double speed = store.speed[i];
+    crowd->field.deposit(store.x[i], store.y[i],
+                         speed * std::cos(store.heading[i]),
+                         speed * std::sin(store.heading[i]));
+    crowd->stored.push_back(m_turtles[i]);
+    m_turtle_flags[i] = 1;
+    ++aggregated;
+  }
+  if (aggregated == 0) {
+    return;
+  }
+  store.detachIf(m_turtle_flags);
+  std::size_t kept = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    if (!m_turtle_flags[i]) {
+      m_turtles[kept++] = std::move(m_turtles[i]);
+    }
+  }
+  m_turtles.resize(kept);
+  m_turtle_index_stale.store(true, std::memory_order_relaxed);
+}
+
+const Environment::TurtleIndex &Environment::turtle_index() const {
+  if (!m_turtle_index_stale.load(std::memory_order_acquire)) {
+    return m_turtle_index;
+  }
+  std::lock_guard<std::mutex> lock(m_turtle_index_mutex);
+  if (!m_turtle_index_stale.load(std::memory_order_relaxed)) {
+    return m_turtle_index;
+  }
+
+  // the neighbourhoods collected from the previous index
+  if (m_neighbourhood_cache_enabled) {
+    clear_neighbourhoods();
+  }
+
+  // Counting sort of the turtles by patch: count the turtles of each patch
+  // in start[patch + 1], accumulate the counts into the first position of
+  // each patch, then place the turtles, which moves start[patch] to the
+  // first position of the next patch.
+  TurtleIndex &index = m_turtle_index;
+  const std::size_t patches = static_cast<std::size_t>(m_width) * m_height;
+  index.start.assign(patches + 1, 0);
+  index.patches.resize(m_turtles.size());
+  for (std::size_t i = 0; i < m_turtles.size(); ++i) {
+    const int x = static_cast<int>(std::floor(m_turtle_store.x[i]));
+    const int y = static_cast<int>(std::floor(m_turtle_store.y[i]));
+    if (x >= 0 && x < m_width && y >= 0 && y < m_height) {
+      const std::size_t patch = static_cast<std::size_t>(y) * m_width + x;
+      index.patches[i] = static_cast<std::uint32_t>(patch);
+      ++index.start[patch + 1];
+    } else {
+      index.patches[i] = NO_PATCH;
+    }
+  }
+  for (std::size_t patch = 0; patch < patches; ++patch) {
+    index.start[patch + 1] += index.start[patch];
+  }
+  index.turtles.resize(index.start[patches]);
+  for (std::size_t i = 0; i < m_turtles.size(); ++i) {
+    if (index.patches[i] != NO_PATCH) {
+      index.turtles[index.start[index.patches[i]]++] =
+          static_cast<std::uint32_t>(i);
+    }
+  }
+  for (std::size_t patch = patches; patch > 0; --patch) {
+    index.start[patch] = index.start[patch - 1];
+  }
+  index.start[0] = 0;
+
+  m_turtle_index_stale.store(false, std::memory_order_release);
+  return m_turtle_index;
+}
+
+void Environment::patch_span(double coordinate, double radius, int length,
+                             int &first, int &count) const {
+  const int low = static_cast<int>(std::floor(coordinate - radius));
+  const int high = static_cast<int>(std::floor(coordinate + radius));
+  if (m_toroidal) {
+    first = (low % length + length) % length;
+    count = std::min(high - low + 1, length);
+  } else {
+    first = std::max(low, 0);
+    count = std::max(std::min(high, length - 1) - first + 1, 0);
   }
 }
 
@@ -0,0 +1,209 @@
+#include "kernel/environment/SharedDecisionBuffer.h"
+#include "kernel/tools/MathUtil.h"
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <mutex>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+
+namespace fr::univ_artois::lgi2a::similar::similar2logo::kernel::environment {
+
+using model::environment::TurtleStore;
+
+namespace {
+
+constexpr std::uint64_t MAGIC = 0x53324c4f47444543ull; // "S2LOGDEC"
+// the columns start on a cache line
+constexpr std::size_t HEADER_SIZE = 64;
+
+[[noreturn]] void throw_errno(const std::string &what,
+                              const std::string &name) {
+  throw std::system_error(errno, std::generic_category(),
+                          what + " '" + name + "'");
+}
+
+// Maps a whole segment, closing its descriptor.
+void *map_segment(int fd, std::size_t size, const std::string &name) {
+  void *mapping =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  const int error = errno;
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    errno = error;
+    throw_errno("cannot map the shared memory segment", name);
+  }
+  return mapping;
+}
+
+} // namespace
+
+std::size_t SharedDecisionBuffer::segment_size(std::size_t capacity,
+                                               std::size_t pheromone_count) {
+  return HEADER_SIZE + (COLUMNS + pheromone_count) * capacity * sizeof(double);
+}
+
+SharedDecisionBuffer SharedDecisionBuffer::create(const std::string &name,
+                                                  std::size_t capacity,
+                                                  std::size_t pheromone_count) {
+  const std::size_t size = segment_size(capacity, pheromone_count);
+  shm_unlink(name.c_str());
+  const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    throw_errno("cannot create the shared memory segment", name);
+  }
+  if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+    const int error = errno;
+    close(fd);
+    shm_unlink(name.c_str());
+    errno = error;
+    throw_errno("cannot size the shared memory segment", name);
+  }
+  void *mapping;
+  try {
+    mapping = map_segment(fd, size, name);
+  } catch (...) {
+    shm_unlink(name.c_str());
+    throw;
+  }
+  SharedDecisionBuffer buffer(name, mapping, size, true);
+  // a new segment is filled with zeros
+  buffer.m_header->capacity = capacity;
+  buffer.m_header->pheromone_count = pheromone_count;
+  buffer.m_header->magic = MAGIC;
+  return buffer;
+}
+
+SharedDecisionBuffer SharedDecisionBuffer::attach(const std::string &name) {
+  const int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0) {
+    throw_errno("cannot open the shared memory segment", name);
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0) {
+    const int error = errno;
+    close(fd);
+    errno = error;
+    throw_errno("cannot read the size of the shared memory segment", name);
+  }
+  const auto size = static_cast<std::size_t>(status.st_size);
+  if (size < HEADER_SIZE) {
+    close(fd);
+    throw std::runtime_error("'" + name + "' is not a decision buffer");
+  }
+  SharedDecisionBuffer buffer(name, map_segment(fd, size, name), size, false);
+  const Header &header = *buffer.m_header;
+  if (header.magic != MAGIC ||
+      size < segment_size(header.capacity, header.pheromone_count)) {
+    throw std::runtime_error("'" + name + "' is not a decision buffer");
+  }
+  return buffer;
+}
+
+SharedDecisionBuffer::SharedDecisionBuffer(std::string name, void *mapping,
+                                           std::size_t size, bool owner)
+    : m_name(std::move(name)), m_mapping(mapping), m_size(size),
+      m_owner(owner), m_header(static_cast<Header *>(mapping)) {}
+
+SharedDecisionBuffer::SharedDecisionBuffer(
+    SharedDecisionBuffer &&other) noexcept
+    : m_name(std::move(other.m_name)), m_mapping(other.m_mapping),
+      m_size(other.m_size), m_owner(other.m_owner), m_header(other.m_header) {
+  other.m_mapping = nullptr;
+  other.m_owner = false;
+}
+
+SharedDecisionBuffer &
+SharedDecisionBuffer::operator=(SharedDecisionBuffer &&other) noexcept {
+  if (this != &other) {
+    release();
+    m_name = std::move(other.m_name);
+    m_mapping = other.m_mapping;
+    m_size = other.m_size;
+    m_owner = other.m_owner;
+    m_header = other.m_header;
+    other.m_mapping = nullptr;
+    other.m_owner = false;
+  }
+  return *this;
+}
+
+SharedDecisionBuffer::~SharedDecisionBuffer() { release(); }
+
+void SharedDecisionBuffer::release() {
+  if (m_mapping != nullptr) {
+    munmap(m_mapping, m_size);
+    m_mapping = nullptr;
+  }
+  if (m_owner) {
+    shm_unlink(m_name.c_str());
+    m_owner = false;
+  }
+}
+
+double *SharedDecisionBuffer::column(std::size_t index) {
+  return reinterpret_cast<double *>(static_cast<char *>(m_mapping) +
+                                    HEADER_SIZE) +
+         index * capacity();
+}
+
+void SharedDecisionBuffer::set_count(std::size_t count) {
+  if (count > capacity()) {
+    throw std::length_error("more turtles than the decision buffer holds");
+  }
+  m_header->count = count;
+}
+
+void SharedDecisionBuffer::publish(
+    const Environment &environment,
+    const std::vector<Environment::PheromoneHandle> &pheromones) {
+  if (pheromones.size() != pheromone_count()) {
+    throw std::invalid_argument(
+        "expected one pheromone per pheromone column of the buffer");
+  }
+  const TurtleStore &store = environment.get_turtle_store();
+  const std::size_t n = store.size();
+  set_count(n);
+  std::copy(store.x.begin(), store.x.begin() + n, x());
+  std::copy(store.y.begin(), store.y.begin() + n, y());
+  std::copy(store.heading.begin(), store.heading.begin() + n, heading());
+  std::copy(store.speed.begin(), store.speed.begin() + n, speed());
+  double *values = this->pheromones();
+  for (std::size_t i = 0; i < n; ++i) {
+    for (const auto pheromone : pheromones) {
+      *values++ =
+          environment.get_pheromone_value(store.x[i], store.y[i], pheromone);
+    }
+  }
+  std::fill(heading_deltas(), heading_deltas() + n, 0.0);
+  std::fill(speed_deltas(), speed_deltas() + n, 0.0);
+  ++m_header->step;
+}
+
+void SharedDecisionBuffer::apply(Environment &environment) {
+  const std::unique_lock<std::shared_mutex> access(
+      environment.access_mutex());
+  const TurtleStore &store = environment.get_turtle_store();
+  const std::size_t n = count();
+  if (store.size() != n) {
+    throw std::invalid_argument(
+        "the environment does not hold the turtles of the buffer");
+  }
+  std::vector<double> values(n);
+  const double *deltas = heading_deltas();
+  for (std::size_t i = 0; i < n; ++i) {
+    values[i] = tools::MathUtil::normalizeAngle(store.heading[i] + deltas[i]);
+  }
+  environment.set_turtle_headings(values.data());
+  deltas = speed_deltas();
+  for (std::size_t i = 0; i < n; ++i) {
+    values[i] = std::max(0.0, store.speed[i] + deltas[i]);
+  }
+  environment.set_turtle_speeds(values.data());
+}
+
+} // namespace fr::univ_artois::lgi2a::similar::similar2logo::kernel::environment
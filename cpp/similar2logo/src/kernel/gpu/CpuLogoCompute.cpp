@@ -0,0 +1,220 @@
+#include "kernel/gpu/CpuLogoCompute.h"
+#include "kernel/tools/MathUtil.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace gpu {
+
+namespace {
+
+// The minimum value of a field, kept above the subnormal floats as in
+// tools::FieldDiffusion
+FieldValue minimumOf(double value) {
+  if constexpr (std::is_same_v<FieldValue, float>) {
+    return std::max(static_cast<float>(value),
+                    std::numeric_limits<float>::min());
+  } else {
+    return static_cast<FieldValue>(value);
+  }
+}
+
+// The neighbours of a patch along an axis, itself included: 3 along a
+// toroidal axis, repeated when it wraps onto the same patch, fewer on the
+// border of a bounded one
+int spanOf(int coordinate, int length, bool torus) {
+  if (torus) {
+    return 3;
+  }
+  return 1 + (coordinate > 0) + (coordinate < length - 1);
+}
+
+int neighbourOf(int coordinate, int length, bool torus) {
+  if (coordinate >= 0 && coordinate < length) {
+    return coordinate;
+  }
+  return torus ? (coordinate % length + length) % length : -1;
+}
+
+// Wraps a coordinate on a toroidal axis and clamps it on a bounded one,
+// keeping it below the length once rounded to the precision of the states
+TurtleValue place(double coordinate, int length, bool torus) {
+  const double placed =
+      torus ? tools::MathUtil::wrap(coordinate, 0, length)
+            : std::max(0.0, std::min(coordinate, std::nextafter(length, 0.0)));
+  const TurtleValue rounded = static_cast<TurtleValue>(placed);
+  return rounded < length
+             ? rounded
+             : std::nextafter(static_cast<TurtleValue>(length), TurtleValue(0));
+}
+
+} // namespace
+
+void CpuLogoCompute::resizeGrid(int width, int height, bool xTorus,
+                                bool yTorus, std::size_t fieldCount) {
+  if (width <= 0 || height <= 0) {
+    throw std::invalid_argument("The grid must have patches");
+  }
+  const std::size_t cells = static_cast<std::size_t>(width) * height;
+  if (width != this->width || height != this->height) {
+    fields.clear();
+  }
+  this->width = width;
+  this->height = height;
+  this->xTorus = xTorus;
+  this->yTorus = yTorus;
+  fields.resize(fieldCount, std::vector<FieldValue>(cells, FieldValue(0)));
+  shares.resize(cells);
+  next.resize(cells);
+}
+
+std::vector<FieldValue> &CpuLogoCompute::fieldAt(std::size_t field) {
+  if (field >= fields.size()) {
+    throw std::out_of_range("Field " + std::to_string(field) +
+                            " out of the " + std::to_string(fields.size()) +
+                            " fields");
+  }
+  return fields[field];
+}
+
+void CpuLogoCompute::uploadField(std::size_t field, const FieldValue *values) {
+  auto &target = fieldAt(field);
+  std::copy(values, values + target.size(), target.begin());
+}
+
+void CpuLogoCompute::downloadField(std::size_t field, FieldValue *values) {
+  const auto &source = fieldAt(field);
+  std::copy(source.begin(), source.end(), values);
+}
+
+void CpuLogoCompute::emitPheromones(std::size_t field,
+                                    const FieldDeposit *deposits,
+                                    std::size_t count) {
+  auto &values = fieldAt(field);
+  for (std::size_t i = 0; i < count; ++i) {
+    if (deposits[i].cell < values.size()) {
+      values[deposits[i].cell] += deposits[i].value;
+    }
+  }
+}
+
+void CpuLogoCompute::diffuseAndEvaporate(std::size_t field,
+                                         const FieldRates &rates) {
+  auto &values = fieldAt(field);
+  const FieldValue diffusion = static_cast<FieldValue>(rates.diffusion);
+  const FieldValue evaporation = static_cast<FieldValue>(rates.evaporation);
+  const FieldValue minValue = minimumOf(rates.minValue);
+
+  // The share of each patch, then the shares gathered from the neighbours
+  for (int y = 0; y < height; ++y) {
+    const int rows = spanOf(y, height, yTorus);
+    for (int x = 0; x < width; ++x) {
+      const std::size_t cell = static_cast<std::size_t>(y) * width + x;
+      const int count = spanOf(x, width, xTorus) * rows - 1;
+      shares[cell] = values[cell] > 0 && count > 0
+                         ? diffusion * values[cell] / count
+                         : FieldValue(0);
+    }
+  }
+  for (int y = 0; y < height; ++y) {
+    const int rows = spanOf(y, height, yTorus);
+    for (int x = 0; x < width; ++x) {
+      const std::size_t cell = static_cast<std::size_t>(y) * width + x;
+      const FieldValue value = values[cell];
+      const int count = spanOf(x, width, xTorus) * rows - 1;
+      FieldValue received = 0;
+      for (int dy = -1; dy <= 1; ++dy) {
+        const int ny = neighbourOf(y + dy, height, yTorus);
+        if (ny < 0) {
+          continue;
+        }
+        for (int dx = -1; dx <= 1; ++dx) {
+          const int nx = neighbourOf(x + dx, width, xTorus);
+          if ((dx == 0 && dy == 0) || nx < 0) {
+            continue;
+          }
+          received += shares[static_cast<std::size_t>(ny) * width + nx];
+        }
+      }
+      FieldValue result =
+          value > 0 && count > 0 ? value - diffusion * value : value;
+      result += received;
+      if (rates.evaporate) {
+        result -= evaporation * result;
+        if (result < minValue) {
+          result = 0;
+        }
+      }
+      next[cell] = result;
+    }
+  }
+  values.swap(next);
+}
+
+void CpuLogoCompute::uploadTurtles(const TurtleArrays &turtles) {
+  this->turtles = turtles;
+}
+
+void CpuLogoCompute::downloadTurtles(TurtleArrays &turtles) {
+  turtles = this->turtles;
+}
+
+void CpuLogoCompute::advanceTurtles(double dt) {
+  for (std::size_t i = 0; i < turtles.size(); ++i) {
+    const double speed = static_cast<double>(turtles.speed[i]) +
+                         static_cast<double>(turtles.acceleration[i]);
+    turtles.speed[i] = static_cast<TurtleValue>(speed);
+    // A heading of 0 points towards +y
+    const double distance = static_cast<double>(turtles.speed[i]) * dt;
+    const double heading = turtles.heading[i];
+    turtles.x[i] = place(turtles.x[i] - std::sin(heading) * distance, width,
+                         xTorus);
+    turtles.y[i] = place(turtles.y[i] + std::cos(heading) * distance, height,
+                         yTorus);
+  }
+}
+
+void CpuLogoCompute::buildTurtleHash() {
+  const std::size_t cells = static_cast<std::size_t>(width) * height;
+  const std::size_t count = turtles.size();
+  std::vector<std::uint32_t> cellOf(count);
+  hash.cellStart.assign(cells + 1, 0);
+  for (std::size_t i = 0; i < count; ++i) {
+    const int x = std::max(0, std::min(static_cast<int>(turtles.x[i]),
+                                       width - 1));
+    const int y = std::max(0, std::min(static_cast<int>(turtles.y[i]),
+                                       height - 1));
+    cellOf[i] = static_cast<std::uint32_t>(y) * width + x;
+    ++hash.cellStart[cellOf[i] + 1];
+  }
+  for (std::size_t c = 0; c < cells; ++c) {
+    hash.cellStart[c + 1] += hash.cellStart[c];
+  }
+  std::vector<std::uint32_t> cursor(hash.cellStart.begin(),
+                                    hash.cellStart.end() - 1);
+  hash.order.resize(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    hash.order[cursor[cellOf[i]]++] = static_cast<std::uint32_t>(i);
+  }
+}
+
+void CpuLogoCompute::downloadTurtleHash(TurtleHash &hash) {
+  hash = this->hash;
+}
+
+} // namespace gpu
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -0,0 +1,488 @@
+#ifdef SIMILAR2LOGO_HAS_CUDA
+
+#include "kernel/gpu/CudaLogoCompute.h"
+#include <algorithm>
+#include <cfloat>
+#include <cub/device/device_scan.cuh>
+#include <cuda_runtime.h>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace gpu {
+
+namespace {
+
+constexpr unsigned BLOCK_SIZE = 256;
+
+enum TurtleArray { X, Y, HEADING, SPEED, ACCELERATION };
+
+unsigned numBlocks(std::size_t num_threads) {
+  return static_cast<unsigned>((num_threads + BLOCK_SIZE - 1) / BLOCK_SIZE);
+}
+
+void check(cudaError_t error, const char *what) {
+  if (error != cudaSuccess) {
+    throw std::runtime_error(std::string("CUDA: ") + what + ": " +
+                             cudaGetErrorString(error));
+  }
+}
+
+template <typename T> void allocate(T *&buffer, std::size_t count) {
+  check(cudaMalloc(reinterpret_cast<void **>(&buffer),
+                   std::max<std::size_t>(count, 1) * sizeof(T)),
+        "cudaMalloc");
+}
+
+template <typename T> void release(T *&buffer) {
+  if (buffer) {
+    cudaFree(buffer);
+    buffer = nullptr;
+  }
+}
+
+// The kernels of CpuLogoCompute, one thread by patch or turtle
+
+__device__ int spanOf(int coordinate, int length, bool torus) {
+  return torus ? 3 : 1 + (coordinate > 0) + (coordinate < length - 1);
+}
+
+__device__ int neighbourOf(int coordinate, int length, bool torus) {
+  if (coordinate >= 0 && coordinate < length) {
+    return coordinate;
+  }
+  return torus ? (coordinate % length + length) % length : -1;
+}
+
+__global__ void sharesKernel(const FieldValue *values, FieldValue *shares,
+                             FieldValue diffusion, int width, int height,
+                             bool xTorus, bool yTorus) {
+  const unsigned cell = blockIdx.x * blockDim.x + threadIdx.x;
+  if (cell >= static_cast<unsigned>(width) * height) {
+    return;
+  }
+  const int x = cell % width;
+  const int y = cell / width;
+  const int count =
+      spanOf(x, width, xTorus) * spanOf(y, height, yTorus) - 1;
+  const FieldValue value = values[cell];
+  shares[cell] =
+      value > 0 && count > 0 ? diffusion * value / count : FieldValue(0);
+}
+
+__global__ void gatherKernel(const FieldValue *values,
+                             const FieldValue *shares, FieldValue *next,
+                             FieldValue diffusion, bool evaporate,
+                             FieldValue evaporation, FieldValue minValue,
+                             int width, int height, bool xTorus,
+                             bool yTorus) {
+  const unsigned cell = blockIdx.x * blockDim.x + threadIdx.x;
+  if (cell >= static_cast<unsigned>(width) * height) {
+    return;
+  }
+  const int x = cell % width;
+  const int y = cell / width;
+  const int count =
+      spanOf(x, width, xTorus) * spanOf(y, height, yTorus) - 1;
+  FieldValue received = 0;
+  for (int dy = -1; dy <= 1; ++dy) {
+    const int ny = neighbourOf(y + dy, height, yTorus);
+    if (ny < 0) {
+      continue;
+    }
+    for (int dx = -1; dx <= 1; ++dx) {
+      const int nx = neighbourOf(x + dx, width, xTorus);
+      if ((dx == 0 && dy == 0) || nx < 0) {
+        continue;
+      }
+      received += shares[ny * width + nx];
+    }
+  }
+  const FieldValue value = values[cell];
+  FieldValue result =
+      value > 0 && count > 0 ? value - diffusion * value : value;
+  result += received;
+  if (evaporate) {
+    result -= evaporation * result;
+    if (result < minValue) {
+      result = 0;
+    }
+  }
+  next[cell] = result;
+}
+
+__global__ void emitKernel(FieldValue *values, const FieldDeposit *deposits,
+                           unsigned count, unsigned cells) {
+  const unsigned i = blockIdx.x * blockDim.x + threadIdx.x;
+  if (i < count && deposits[i].cell < cells) {
+    atomicAdd(values + deposits[i].cell, deposits[i].value);
+  }
+}
+
+__device__ TurtleValue place(double coordinate, int length, bool torus) {
+  double placed;
+  if (torus) {
+    placed = fmod(coordinate, static_cast<double>(length));
+    if (placed < 0) {
+      placed += length;
+    }
+    if (placed >= length) {
+      placed = 0;
+    }
+  } else {
+    placed = fmax(0.0, fmin(coordinate, nextafter(double(length), 0.0)));
+  }
+  const TurtleValue rounded = static_cast<TurtleValue>(placed);
+  return rounded < length
+             ? rounded
+             : nextafter(static_cast<TurtleValue>(length), TurtleValue(0));
+}
+
+__global__ void advanceKernel(TurtleValue *xs, TurtleValue *ys,
+                              const TurtleValue *headings,
+                              TurtleValue *speeds,
+                              const TurtleValue *accelerations, double dt,
+                              int width, int height, bool xTorus, bool yTorus,
+                              unsigned count) {
+  const unsigned i = blockIdx.x * blockDim.x + threadIdx.x;
+  if (i >= count) {
+    return;
+  }
+  const TurtleValue speed = static_cast<TurtleValue>(
+      static_cast<double>(speeds[i]) + static_cast<double>(accelerations[i]));
+  speeds[i] = speed;
+  // A heading of 0 points towards +y
+  const double distance = static_cast<double>(speed) * dt;
+  double sine, cosine;
+  sincos(static_cast<double>(headings[i]), &sine, &cosine);
+  xs[i] = place(xs[i] - sine * distance, width, xTorus);
+  ys[i] = place(ys[i] + cosine * distance, height, yTorus);
+}
+
+__global__ void countKernel(const TurtleValue *xs, const TurtleValue *ys,
+                            std::uint32_t *cellOf, std::uint32_t *counts,
+                            int width, int height, unsigned count) {
+  const unsigned i = blockIdx.x * blockDim.x + threadIdx.x;
+  if (i >= count) {
+    return;
+  }
+  const int x = max(0, min(static_cast<int>(xs[i]), width - 1));
+  const int y = max(0, min(static_cast<int>(ys[i]), height - 1));
+  cellOf[i] = static_cast<std::uint32_t>(y) * width + x;
+  atomicAdd(counts + cellOf[i], 1u);
+}
+
+__global__ void scatterKernel(const std::uint32_t *cellOf,
+                              std::uint32_t *cursor, std::uint32_t *order,
+                              unsigned count) {
+  const unsigned i = blockIdx.x * blockDim.x + threadIdx.x;
+  if (i < count) {
+    order[atomicAdd(cursor + cellOf[i], 1u)] = i;
+  }
+}
+
+} // namespace
+
+CudaLogoCompute::CudaLogoCompute(int device) : device(device) {}
+
+CudaLogoCompute::~CudaLogoCompute() {
+  releaseGrid();
+  releaseTurtles();
+  release(d_deposits);
+  if (stream) {
+    cudaStreamDestroy(static_cast<cudaStream_t>(stream));
+  }
+}
+
+bool CudaLogoCompute::isAvailable() {
+  int count = 0;
+  return cudaGetDeviceCount(&count) == cudaSuccess && count > 0;
+}
+
+bool CudaLogoCompute::initialize() {
+  if (initialized) {
+    return true;
+  }
+  int count = 0;
+  if (cudaGetDeviceCount(&count) != cudaSuccess || device >= count ||
+      cudaSetDevice(device) != cudaSuccess) {
+    return false;
+  }
+  cudaStream_t created;
+  if (cudaStreamCreate(&created) != cudaSuccess) {
+    return false;
+  }
+  stream = created;
+  initialized = true;
+  return true;
+}
+
+std::string CudaLogoCompute::getDeviceName() const {
+  cudaDeviceProp properties;
+  if (cudaGetDeviceProperties(&properties, device) != cudaSuccess) {
+    return "CUDA";
+  }
+  return properties.name;
+}
+
+void CudaLogoCompute::releaseGrid() {
+  release(d_fields);
+  release(d_shares);
+  release(d_next);
+  release(d_cellStart);
+  release(d_cursor);
+  release(d_scanStorage);
+  scanStorageBytes = 0;
+}
+
+void CudaLogoCompute::releaseTurtles() {
+  for (TurtleValue *&array : d_turtles) {
+    release(array);
+  }
+  release(d_cellOf);
+  release(d_order);
+  turtleCapacity = 0;
+}
+
+void CudaLogoCompute::resizeGrid(int width, int height, bool xTorus,
+                                 bool yTorus, std::size_t fieldCount) {
+  if (width <= 0 || height <= 0) {
+    throw std::invalid_argument("The grid must have patches");
+  }
+  if (!initialized && !initialize()) {
+    throw std::runtime_error("CUDA: no device " + std::to_string(device));
+  }
+  this->xTorus = xTorus;
+  this->yTorus = yTorus;
+  if (width == this->width && height == this->height &&
+      fieldCount == this->fieldCount) {
+    return;
+  }
+  const bool sameGrid = width == this->width && height == this->height;
+  FieldValue *kept = nullptr;
+  const std::size_t keptCount = std::min(fieldCount, this->fieldCount);
+  if (sameGrid && keptCount > 0) {
+    kept = d_fields;
+    d_fields = nullptr;
+  }
+  releaseGrid();
+  this->width = width;
+  this->height = height;
+  this->fieldCount = fieldCount;
+  const std::size_t size = cells();
+  const auto s = static_cast<cudaStream_t>(stream);
+  allocate(d_fields, size * fieldCount);
+  check(cudaMemsetAsync(d_fields, 0, size * fieldCount * sizeof(FieldValue),
+                        s),
+        "cudaMemsetAsync");
+  if (kept) {
+    check(cudaMemcpyAsync(d_fields, kept,
+                          size * keptCount * sizeof(FieldValue),
+                          cudaMemcpyDeviceToDevice, s),
+          "cudaMemcpyAsync");
+    check(cudaStreamSynchronize(s), "cudaStreamSynchronize");
+    cudaFree(kept);
+  }
+  allocate(d_shares, size);
+  allocate(d_next, size);
+  allocate(d_cellStart, size + 1);
+  allocate(d_cursor, size + 1);
+  check(cub::DeviceScan::ExclusiveSum(nullptr, scanStorageBytes, d_cursor,
+                                      d_cellStart, size + 1, s),
+        "cub::DeviceScan::ExclusiveSum");
+  check(cudaMalloc(&d_scanStorage, std::max<std::size_t>(scanStorageBytes, 1)),
+        "cudaMalloc");
+}
+
+FieldValue *CudaLogoCompute::fieldAt(std::size_t field) const {
+  if (field >= fieldCount) {
+    throw std::out_of_range("Field " + std::to_string(field) +
+                            " out of the " + std::to_string(fieldCount) +
+                            " fields");
+  }
+  return d_fields + field * cells();
+}
+
+void CudaLogoCompute::uploadField(std::size_t field,
+                                  const FieldValue *values) {
+  check(cudaMemcpyAsync(fieldAt(field), values, cells() * sizeof(FieldValue),
+                        cudaMemcpyHostToDevice,
+                        static_cast<cudaStream_t>(stream)),
+        "cudaMemcpyAsync");
+  // The values of the host may be changed once the call returns
+  check(cudaStreamSynchronize(static_cast<cudaStream_t>(stream)),
+        "cudaStreamSynchronize");
+}
+
+void CudaLogoCompute::downloadField(std::size_t field, FieldValue *values) {
+  const auto s = static_cast<cudaStream_t>(stream);
+  check(cudaMemcpyAsync(values, fieldAt(field), cells() * sizeof(FieldValue),
+                        cudaMemcpyDeviceToHost, s),
+        "cudaMemcpyAsync");
+  check(cudaStreamSynchronize(s), "cudaStreamSynchronize");
+}
+
+void CudaLogoCompute::emitPheromones(std::size_t field,
+                                     const FieldDeposit *deposits,
+                                     std::size_t count) {
+  if (count == 0) {
+    return;
+  }
+  FieldValue *values = fieldAt(field);
+  const auto s = static_cast<cudaStream_t>(stream);
+  if (count > depositCapacity) {
+    check(cudaStreamSynchronize(s), "cudaStreamSynchronize");
+    release(d_deposits);
+    depositCapacity = std::max(count, depositCapacity * 2);
+    allocate(d_deposits, depositCapacity);
+  }
+  check(cudaMemcpyAsync(d_deposits, deposits, count * sizeof(FieldDeposit),
+                        cudaMemcpyHostToDevice, s),
+        "cudaMemcpyAsync");
+  emitKernel<<<numBlocks(count), BLOCK_SIZE, 0, s>>>(
+      values, d_deposits, static_cast<unsigned>(count),
+      static_cast<unsigned>(cells()));
+  check(cudaGetLastError(), "emitKernel");
+  // The deposits of the host may be changed once the call returns
+  check(cudaStreamSynchronize(s), "cudaStreamSynchronize");
+}
+
+void CudaLogoCompute::diffuseAndEvaporate(std::size_t field,
+                                          const FieldRates &rates) {
+  FieldValue *values = fieldAt(field);
+  const auto s = static_cast<cudaStream_t>(stream);
+  const FieldValue diffusion = static_cast<FieldValue>(rates.diffusion);
+  // The minimum value is kept above the subnormal floats as on the host
+  FieldValue minValue = static_cast<FieldValue>(rates.minValue);
+  if constexpr (std::is_same_v<FieldValue, float>) {
+    minValue = std::max(minValue, FLT_MIN);
+  }
+  sharesKernel<<<numBlocks(cells()), BLOCK_SIZE, 0, s>>>(
+      values, d_shares, diffusion, width, height, xTorus, yTorus);
+  check(cudaGetLastError(), "sharesKernel");
+  gatherKernel<<<numBlocks(cells()), BLOCK_SIZE, 0, s>>>(
+      values, d_shares, d_next, diffusion, rates.evaporate,
+      static_cast<FieldValue>(rates.evaporation), minValue, width, height,
+      xTorus, yTorus);
+  check(cudaGetLastError(), "gatherKernel");
+  check(cudaMemcpyAsync(values, d_next, cells() * sizeof(FieldValue),
+                        cudaMemcpyDeviceToDevice, s),
+        "cudaMemcpyAsync");
+}
+
+void CudaLogoCompute::reserveTurtles(std::size_t count) {
+  if (count <= turtleCapacity) {
+    return;
+  }
+  check(cudaStreamSynchronize(static_cast<cudaStream_t>(stream)),
+        "cudaStreamSynchronize");
+  releaseTurtles();
+  turtleCapacity = std::max(count, turtleCapacity * 2);
+  for (TurtleValue *&array : d_turtles) {
+    allocate(array, turtleCapacity);
+  }
+  allocate(d_cellOf, turtleCapacity);
+  allocate(d_order, turtleCapacity);
+}
+
+void CudaLogoCompute::uploadTurtles(const TurtleArrays &turtles) {
+  if (!initialized && !initialize()) {
+    throw std::runtime_error("CUDA: no device " + std::to_string(device));
+  }
+  reserveTurtles(turtles.size());
+  turtleCount = turtles.size();
+  const auto s = static_cast<cudaStream_t>(stream);
+  const std::vector<TurtleValue> *arrays[] = {
+      &turtles.x, &turtles.y, &turtles.heading, &turtles.speed,
+      &turtles.acceleration};
+  for (int a = X; a <= ACCELERATION; ++a) {
+    check(cudaMemcpyAsync(d_turtles[a], arrays[a]->data(),
+                          turtleCount * sizeof(TurtleValue),
+                          cudaMemcpyHostToDevice, s),
+          "cudaMemcpyAsync");
+  }
+  check(cudaStreamSynchronize(s), "cudaStreamSynchronize");
+}
+
+void CudaLogoCompute::downloadTurtles(TurtleArrays &turtles) {
+  turtles.resize(turtleCount);
+  const auto s = static_cast<cudaStream_t>(stream);
+  std::vector<TurtleValue> *arrays[] = {&turtles.x, &turtles.y,
+                                        &turtles.heading, &turtles.speed,
+                                        &turtles.acceleration};
+  for (int a = X; a <= ACCELERATION; ++a) {
+    check(cudaMemcpyAsync(arrays[a]->data(), d_turtles[a],
+                          turtleCount * sizeof(TurtleValue),
+                          cudaMemcpyDeviceToHost, s),
+          "cudaMemcpyAsync");
+  }
+  check(cudaStreamSynchronize(s), "cudaStreamSynchronize");
+}
+
+void CudaLogoCompute::advanceTurtles(double dt) {
+  if (turtleCount == 0) {
+    return;
+  }
+  const auto s = static_cast<cudaStream_t>(stream);
+  advanceKernel<<<numBlocks(turtleCount), BLOCK_SIZE, 0, s>>>(
+      d_turtles[X], d_turtles[Y], d_turtles[HEADING], d_turtles[SPEED],
+      d_turtles[ACCELERATION], dt, width, height, xTorus, yTorus,
+      static_cast<unsigned>(turtleCount));
+  check(cudaGetLastError(), "advanceKernel");
+}
+
+void CudaLogoCompute::buildTurtleHash() {
+  const auto s = static_cast<cudaStream_t>(stream);
+  const std::size_t size = cells();
+  check(cudaMemsetAsync(d_cursor, 0, (size + 1) * sizeof(std::uint32_t), s),
+        "cudaMemsetAsync");
+  if (turtleCount > 0) {
+    countKernel<<<numBlocks(turtleCount), BLOCK_SIZE, 0, s>>>(
+        d_turtles[X], d_turtles[Y], d_cellOf, d_cursor, width, height,
+        static_cast<unsigned>(turtleCount));
+    check(cudaGetLastError(), "countKernel");
+  }
+  check(cub::DeviceScan::ExclusiveSum(d_scanStorage, scanStorageBytes,
+                                      d_cursor, d_cellStart, size + 1, s),
+        "cub::DeviceScan::ExclusiveSum");
+  if (turtleCount > 0) {
+    check(cudaMemcpyAsync(d_cursor, d_cellStart,
+                          size * sizeof(std::uint32_t),
+                          cudaMemcpyDeviceToDevice, s),
+          "cudaMemcpyAsync");
+    scatterKernel<<<numBlocks(turtleCount), BLOCK_SIZE, 0, s>>>(
+        d_cellOf, d_cursor, d_order, static_cast<unsigned>(turtleCount));
+    check(cudaGetLastError(), "scatterKernel");
+  }
+}
+
+void CudaLogoCompute::downloadTurtleHash(TurtleHash &hash) {
+  const auto s = static_cast<cudaStream_t>(stream);
+  hash.cellStart.resize(cells() + 1);
+  hash.order.resize(turtleCount);
+  check(cudaMemcpyAsync(hash.cellStart.data(), d_cellStart,
+                        hash.cellStart.size() * sizeof(std::uint32_t),
+                        cudaMemcpyDeviceToHost, s),
+        "cudaMemcpyAsync");
+  check(cudaMemcpyAsync(hash.order.data(), d_order,
+                        turtleCount * sizeof(std::uint32_t),
+                        cudaMemcpyDeviceToHost, s),
+        "cudaMemcpyAsync");
+  check(cudaStreamSynchronize(s), "cudaStreamSynchronize");
+}
+
+} // namespace gpu
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
+
+#endif // SIMILAR2LOGO_HAS_CUDA
@@ -0,0 +1,61 @@
+#include "kernel/model/DistributedLogoSimulationModel.h"
+#include "kernel/model/levels/LogoDefaultReactionModel.h"
+#include "kernel/model/levels/LogoSimulationLevelList.h"
+#include <levels/ExtendedLevel.h>
+#include <libs/timemodel/PeriodicTimeModel.h>
+#include <stdexcept>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace model {
+
+DistributedLogoSimulationModel::DistributedLogoSimulationModel(
+    int width, int height, bool xTorus, bool yTorus, int haloWidth,
+    std::unordered_set<environment::Pheromone> pheromones)
+    : width(width), height(height), xTorus(xTorus), yTorus(yTorus),
+      haloWidth(haloWidth), pheromones(std::move(pheromones)) {
+  if (width < 1 || height < 1) {
+    throw std::invalid_argument("The dimensions of the grid must be positive.");
+  }
+  if (haloWidth < 1) {
+    throw std::invalid_argument("The halo must be at least one patch wide.");
+  }
+}
+
+std::vector<std::shared_ptr<mk::levels::ILevel>>
+DistributedLogoSimulationModel::generateLevels(
+    const mk::SimulationTimeStamp &initialTime) {
+  auto timeModel =
+      std::make_shared<ek::libs::PeriodicTimeModel>(1, 0, initialTime);
+  return {std::make_shared<ek::levels::ExtendedLevel>(
+      initialTime, levels::LogoSimulationLevelList::LOGO, timeModel,
+      std::make_shared<levels::LogoDefaultReactionModel>())};
+}
+
+mk::ISimulationModel::EnvironmentInitializationData
+DistributedLogoSimulationModel::generateEnvironment(
+    const mk::SimulationTimeStamp & /*initialTime*/,
+    const std::map<mk::LevelIdentifier, std::shared_ptr<mk::levels::ILevel>>
+        & /*levels*/) {
+  return EnvironmentInitializationData(nullptr);
+}
+
+mk::ISimulationModel::AgentInitializationData
+DistributedLogoSimulationModel::generateAgents(
+    const mk::SimulationTimeStamp & /*initialTime*/,
+    const std::map<mk::LevelIdentifier, std::shared_ptr<mk::levels::ILevel>>
+        & /*levels*/) {
+  return AgentInitializationData();
+}
+
+} // namespace model
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -1,6 +1,8 @@
 #include "kernel/model/LogoSimulationModel.h"
 #include "kernel/model/environment/LogoEnvironment.h"
 #include "kernel/model/levels/LogoDefaultReactionModel.h"
+#include <algorithm>
+#include <engine/WorkStealingThreadPool.h>
 #include <environment/IEnvironment4Engine.h>
 #include <random>
 
@@ -13,6 +15,14 @@ namespace kernel {
 namespace model {
 
 namespace mk = fr::univ_artois::lgi2a::similar::microkernel;
+
+namespace {
+
+// The agents created by a task of the thread pool
+constexpr std::size_t AGENT_CHUNK_SIZE = 4096;
+
+} // namespace
+
 // namespace levels is already defined by the included header
 
 LogoSimulationModel::LogoSimulationModel(int width, int height, bool xTorus,
@@ -33,6 +43,7 @@ LogoSimulationModel::generateLevels(
   // Create the default level
   mk::LevelIdentifier id("default");
   auto level = std::make_shared<levels::LogoDefaultReactionModel>();
+  level->setComputeBackend(computeBackend);
 
   // We need to set the identifier and time if the constructor doesn't take them
   // But ILevelReactionModel usually doesn't store them?
@@ -98,6 +109,25 @@ LogoSimulationModel::generateAgents(
     }
   }
 
+  // The chunks are created in parallel, then added in their order
+  if (agentChunkFactory && chunkedAgentCount > 0) {
+    const std::size_t chunks =
+        (chunkedAgentCount + AGENT_CHUNK_SIZE - 1) / AGENT_CHUNK_SIZE;
+    std::vector<std::vector<std::shared_ptr<agents::LogoAgent>>> created(
+        chunks);
+    mk::engine::WorkStealingThreadPool::parallelForOnCurrent(
+        chunks, 1, [&](std::size_t begin, std::size_t end, std::size_t) {
+          for (std::size_t chunk = begin; chunk < end; ++chunk) {
+            const std::size_t first = chunk * AGENT_CHUNK_SIZE;
+            created[chunk] = agentChunkFactory(
+                first, std::min(first + AGENT_CHUNK_SIZE, chunkedAgentCount));
+          }
+        });
+    for (auto &chunk : created) {
+      data.getAgents().insert(chunk.begin(), chunk.end());
+    }
+  }
+
   return data;
 }
 
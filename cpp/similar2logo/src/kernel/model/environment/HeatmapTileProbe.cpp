@@ -0,0 +1,68 @@
+#include "kernel/model/environment/HeatmapTileProbe.h"
+#include "ISimulationEngine.h"
+#include "kernel/model/environment/LogoEnvPLS.h"
+#include <stdexcept>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace model {
+namespace environment {
+
+namespace mk = similar::microkernel;
+
+HeatmapTileProbe::HeatmapTileProbe(
+    std::shared_ptr<tools::HeatmapTileRenderer> renderer,
+    mk::LevelIdentifier level, double maxValue)
+    : renderer(std::move(renderer)), level(std::move(level)),
+      maxValue(maxValue) {
+  if (!this->renderer) {
+    throw std::invalid_argument("The renderer of a probe cannot be null.");
+  }
+}
+
+void HeatmapTileProbe::observeAtInitialTimes(
+    const mk::SimulationTimeStamp &, const mk::ISimulationEngine &engine) {
+  observe(engine);
+}
+
+void HeatmapTileProbe::observeAtPartialConsistentTime(
+    const mk::SimulationTimeStamp &, const mk::ISimulationEngine &engine) {
+  observe(engine);
+}
+
+void HeatmapTileProbe::observe(const mk::ISimulationEngine &engine) {
+  std::shared_ptr<mk::dynamicstate::IPublicLocalDynamicState> state;
+  try {
+    state = engine.getSimulationDynamicStates()->get(level);
+  } catch (const std::out_of_range &) {
+    return;
+  }
+  const auto *environment =
+      state ? dynamic_cast<const LogoEnvPLS *>(
+                  state->getPublicLocalStateOfEnvironment().get())
+            : nullptr;
+  if (!environment) {
+    return;
+  }
+  for (const auto &[pheromone, field] : environment->getPheromoneField()) {
+    const std::string &identifier = pheromone.getIdentifier();
+    if (!renderer->hasLayer(identifier)) {
+      renderer->addLayer(identifier, environment->getWidth(),
+                         environment->getHeight(), maxValue);
+    }
+    renderer->update(identifier, field.get());
+  }
+}
+
+} // namespace environment
+} // namespace model
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -0,0 +1,214 @@
+#include "kernel/model/environment/MarkStore.h"
+#include "kernel/tools/RowBands.h"
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace model {
+namespace environment {
+
+MarkStore::MarkStore(int width, int height)
+    : width(width), height(height),
+      tileColumns((width + TILE_SIZE - 1) / TILE_SIZE),
+      heads(static_cast<std::size_t>(tileColumns) *
+            ((height + TILE_SIZE - 1) / TILE_SIZE)) {}
+
+std::uint32_t MarkStore::find(std::uint32_t cell,
+                              const SimpleMark *mark) const {
+  for (std::uint32_t e = head(cell); e != NO_ENTRY; e = entries[e].next) {
+    if (entries[e].mark.get() == mark) {
+      return e;
+    }
+  }
+  return NO_ENTRY;
+}
+
+void MarkStore::ensureTile(std::uint32_t cell) {
+  std::vector<std::uint32_t> &tile = heads[tileOf(cell)];
+  if (tile.empty()) {
+    tile.assign(static_cast<std::size_t>(TILE_SIZE) * TILE_SIZE, NO_ENTRY);
+  }
+}
+
+std::uint32_t MarkStore::allocate() {
+  if (freeEntries != NO_ENTRY) {
+    const std::uint32_t entry = freeEntries;
+    freeEntries = entries[entry].next;
+    return entry;
+  }
+  entries.emplace_back();
+  return static_cast<std::uint32_t>(entries.size() - 1);
+}
+
+void MarkStore::release(std::uint32_t entry) {
+  entries[entry].mark.reset();
+  entries[entry].next = freeEntries;
+  freeEntries = entry;
+}
+
+void MarkStore::link(std::uint32_t entry, std::uint32_t cell) {
+  std::uint32_t &first = heads[tileOf(cell)][offsetIn(cell)];
+  Entry &linked = entries[entry];
+  linked.cell = cell;
+  linked.previous = NO_ENTRY;
+  linked.next = first;
+  if (first != NO_ENTRY) {
+    entries[first].previous = entry;
+  }
+  first = entry;
+}
+
+void MarkStore::unlink(std::uint32_t entry) {
+  const Entry &unlinked = entries[entry];
+  if (unlinked.previous != NO_ENTRY) {
+    entries[unlinked.previous].next = unlinked.next;
+  } else {
+    heads[tileOf(unlinked.cell)][offsetIn(unlinked.cell)] = unlinked.next;
+  }
+  if (unlinked.next != NO_ENTRY) {
+    entries[unlinked.next].previous = unlinked.previous;
+  }
+}
+
+bool MarkStore::add(int x, int y, std::shared_ptr<SimpleMark> mark) {
+  if (!mark || x < 0 || x >= width || y < 0 || y >= height) {
+    return false;
+  }
+  const std::uint32_t cell = cellOf(x, y);
+  if (find(cell, mark.get()) != NO_ENTRY) {
+    return false;
+  }
+  ensureTile(cell);
+  const std::uint32_t entry = allocate();
+  entries[entry].mark = std::move(mark);
+  link(entry, cell);
+  ++count;
+  return true;
+}
+
+bool MarkStore::remove(int x, int y, const std::shared_ptr<SimpleMark> &mark) {
+  if (!mark || x < 0 || x >= width || y < 0 || y >= height) {
+    return false;
+  }
+  const std::uint32_t entry = find(cellOf(x, y), mark.get());
+  if (entry == NO_ENTRY) {
+    return false;
+  }
+  unlink(entry);
+  release(entry);
+  --count;
+  return true;
+}
+
+std::vector<unsigned char>
+MarkStore::addAll(const std::vector<std::shared_ptr<SimpleMark>> &marks,
+                  const std::vector<std::uint32_t> &cells) {
+  // The entries and the tiles are allocated beforehand, so that a band only
+  // writes the entries and the heads of its own tiles.
+  const std::uint32_t cellCount = static_cast<std::uint32_t>(width) * height;
+  std::vector<std::uint32_t> slots(marks.size(), NO_ENTRY);
+  std::vector<std::uint32_t> columns(marks.size(), tileColumns);
+  for (std::size_t i = 0; i < marks.size(); ++i) {
+    if (marks[i] && cells[i] < cellCount) {
+      ensureTile(cells[i]);
+      slots[i] = allocate();
+      columns[i] = tileColumnOf(cells[i]);
+    }
+  }
+  std::vector<std::uint32_t> start;
+  std::vector<std::uint32_t> order;
+  tools::RowBands::sortByRow(columns, tileColumns, start, order);
+  std::vector<unsigned char> added(marks.size(), 0);
+  tools::RowBands::forEach(
+      tileColumns, TILE_SIZE * height, [&](int first, int end) {
+        for (std::uint32_t k = start[first]; k < start[end]; ++k) {
+          const std::uint32_t i = order[k];
+          if (find(cells[i], marks[i].get()) == NO_ENTRY) {
+            entries[slots[i]].mark = marks[i];
+            link(slots[i], cells[i]);
+            added[i] = 1;
+          }
+        }
+      });
+  for (std::size_t i = 0; i < marks.size(); ++i) {
+    if (added[i]) {
+      ++count;
+    } else if (slots[i] != NO_ENTRY) {
+      release(slots[i]);
+    }
+  }
+  return added;
+}
+
+std::vector<unsigned char>
+MarkStore::removeAll(const std::vector<std::shared_ptr<SimpleMark>> &marks,
+                     const std::vector<std::uint32_t> &cells) {
+  const std::uint32_t cellCount = static_cast<std::uint32_t>(width) * height;
+  std::vector<std::uint32_t> columns(marks.size(), tileColumns);
+  for (std::size_t i = 0; i < marks.size(); ++i) {
+    if (marks[i] && cells[i] < cellCount) {
+      columns[i] = tileColumnOf(cells[i]);
+    }
+  }
+  std::vector<std::uint32_t> start;
+  std::vector<std::uint32_t> order;
+  tools::RowBands::sortByRow(columns, tileColumns, start, order);
+  // the entries are unlinked by the bands, then released in order
+  std::vector<std::uint32_t> unlinked(marks.size(), NO_ENTRY);
+  tools::RowBands::forEach(
+      tileColumns, TILE_SIZE * height, [&](int first, int end) {
+        for (std::uint32_t k = start[first]; k < start[end]; ++k) {
+          const std::uint32_t i = order[k];
+          const std::uint32_t entry = find(cells[i], marks[i].get());
+          if (entry != NO_ENTRY) {
+            unlink(entry);
+            unlinked[i] = entry;
+          }
+        }
+      });
+  std::vector<unsigned char> removed(marks.size(), 0);
+  for (std::size_t i = 0; i < marks.size(); ++i) {
+    if (unlinked[i] != NO_ENTRY) {
+      release(unlinked[i]);
+      --count;
+      removed[i] = 1;
+    }
+  }
+  return removed;
+}
+
+std::size_t MarkStore::countAt(int x, int y) const {
+  std::size_t marks = 0;
+  forEachAt(x, y, [&](const std::shared_ptr<SimpleMark> &) { ++marks; });
+  return marks;
+}
+
+std::vector<std::shared_ptr<SimpleMark>> MarkStore::getAt(int x,
+                                                          int y) const {
+  std::vector<std::shared_ptr<SimpleMark>> marks;
+  forEachAt(x, y, [&](const std::shared_ptr<SimpleMark> &mark) {
+    marks.push_back(mark);
+  });
+  return marks;
+}
+
+void MarkStore::clear() {
+  entries.clear();
+  freeEntries = NO_ENTRY;
+  count = 0;
+  for (std::vector<std::uint32_t> &tile : heads) {
+    std::vector<std::uint32_t>().swap(tile);
+  }
+}
+
+} // namespace environment
+} // namespace model
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
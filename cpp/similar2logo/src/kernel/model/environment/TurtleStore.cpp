@@ -0,0 +1,134 @@
+#include "kernel/model/environment/TurtleStore.h"
+#include "kernel/model/environment/TurtlePLSInLogo.h"
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace model {
+namespace environment {
+
+TurtleStore::~TurtleStore() { detachAll(); }
+
+std::size_t TurtleStore::attach(TurtlePLSInLogo &turtle) {
+  x.push_back(turtle.location.x);
+  y.push_back(turtle.location.y);
+  heading.push_back(turtle.heading);
+  speed.push_back(turtle.speed);
+  acceleration.push_back(turtle.acceleration);
+  color.push_back(turtle.color.getId());
+  id.push_back(nextId++);
+  turtles.push_back(&turtle);
+  turtle.store = this;
+  turtle.slot = turtles.size() - 1;
+  return turtle.slot;
+}
+
+void TurtleStore::release(std::size_t slot) {
+  TurtlePLSInLogo &turtle = *turtles[slot];
+  turtle.location = tools::Point2D(x[slot], y[slot]);
+  turtle.heading = heading[slot];
+  turtle.speed = speed[slot];
+  turtle.acceleration = acceleration[slot];
+  turtle.color = similar::microkernel::libs::Symbol::fromId(color[slot]);
+  turtle.store = nullptr;
+  turtle.slot = 0;
+}
+
+void TurtleStore::detach(std::size_t slot) {
+  release(slot);
+  x.erase(x.begin() + slot);
+  y.erase(y.begin() + slot);
+  heading.erase(heading.begin() + slot);
+  speed.erase(speed.begin() + slot);
+  acceleration.erase(acceleration.begin() + slot);
+  color.erase(color.begin() + slot);
+  id.erase(id.begin() + slot);
+  turtles.erase(turtles.begin() + slot);
+  for (std::size_t i = slot; i < turtles.size(); ++i) {
+    turtles[i]->slot = i;
+  }
+}
+
+void TurtleStore::detachIf(const std::vector<unsigned char> &leaving) {
+  std::size_t kept = 0;
+  for (std::size_t i = 0; i < turtles.size(); ++i) {
+    if (leaving[i]) {
+      release(i);
+      continue;
+    }
+    if (kept != i) {
+      x[kept] = x[i];
+      y[kept] = y[i];
+      heading[kept] = heading[i];
+      speed[kept] = speed[i];
+      acceleration[kept] = acceleration[i];
+      color[kept] = color[i];
+      id[kept] = id[i];
+      turtles[kept] = turtles[i];
+      turtles[kept]->slot = kept;
+    }
+    ++kept;
+  }
+  x.resize(kept);
+  y.resize(kept);
+  heading.resize(kept);
+  speed.resize(kept);
+  acceleration.resize(kept);
+  color.resize(kept);
+  id.resize(kept);
+  turtles.resize(kept);
+}
+
+void TurtleStore::detachAll() {
+  for (std::size_t slot = 0; slot < turtles.size(); ++slot) {
+    release(slot);
+  }
+  x.clear();
+  y.clear();
+  heading.clear();
+  speed.clear();
+  acceleration.clear();
+  color.clear();
+  id.clear();
+  turtles.clear();
+}
+
+namespace {
+
+// Permutes a column of the store, element order[i] becoming element i
+template <typename Column>
+void permute(Column &column, const std::vector<std::size_t> &order) {
+  Column permuted(column.size());
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    permuted[i] = column[order[i]];
+  }
+  column.swap(permuted);
+}
+
+} // namespace
+
+void TurtleStore::reorder(const std::vector<std::size_t> &order) {
+  permute(x, order);
+  permute(y, order);
+  permute(heading, order);
+  permute(speed, order);
+  permute(acceleration, order);
+  permute(color, order);
+  permute(id, order);
+  permute(turtles, order);
+  for (std::size_t i = 0; i < turtles.size(); ++i) {
+    turtles[i]->slot = i;
+  }
+}
+
+} // namespace environment
+} // namespace model
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
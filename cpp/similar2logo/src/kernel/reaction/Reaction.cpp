@@ -15,6 +15,7 @@
 // Higher-level behaviors (marks, full natural/system influences, Java
 // multi-level coordination) are handled in the full extended kernel.
 
+#include "influences/InfluenceDispatcher.h"
 #include "kernel/influences/AgentPositionUpdate.h"
 #include "kernel/influences/ChangeAcceleration.h"
 #include "kernel/influences/ChangeDirection.h"
@@ -23,14 +24,20 @@
 #include "kernel/influences/DropMark.h"
 #include "kernel/influences/EmitPheromone.h"
 #include "kernel/influences/PheromoneFieldUpdate.h"
+#include "kernel/influences/Relocate.h"
 #include "kernel/influences/RemoveMark.h"
 #include "kernel/influences/RemoveMarks.h"
 #include "kernel/influences/Stop.h"
 #include "kernel/model/environment/TurtlePLSInLogo.h"
 #include "kernel/reaction/Reaction.h"
 #include "kernel/tools/MathUtil.h"
+#include "kernel/tools/Topology.h"
+#include <libs/random/PRNG.h>
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <vector>
 
 namespace fr::univ_artois::lgi2a::similar::similar2logo::kernel::reaction {
 
@@ -40,197 +47,355 @@ using namespace fr::univ_artois::lgi2a::similar::similar2logo::kernel::model::
     environment;
 using namespace fr::univ_artois::lgi2a::similar::similar2logo::kernel::tools;
 
-void Reaction::apply(const std::vector<std::shared_ptr<IInfluence>> &influences,
-                     Environment &env, double dt) {
+namespace {
 
-  for (const auto &influence : influences) {
-    if (!influence)
-      continue;
+using Dispatcher =
+    microkernel::influences::InfluenceDispatcher<Environment &, double>;
 
-    // ChangePosition
-    if (auto cp = std::dynamic_pointer_cast<ChangePosition>(influence)) {
-      auto target = cp->getTarget();
-      if (target) {
-        Point2D oldLoc = target->getLocation();
-        int old_x = static_cast<int>(std::floor(oldLoc.x));
-        int old_y = static_cast<int>(std::floor(oldLoc.y));
-
-        double newX = oldLoc.x + cp->getDx();
-        double newY = oldLoc.y + cp->getDy();
-
-        if (env.toroidal()) {
-          newX = std::fmod(newX, env.width());
-          if (newX < 0)
-            newX += env.width();
-          newY = std::fmod(newY, env.height());
-          if (newY < 0)
-            newY += env.height();
-        } else {
-          newX = std::max(0.0, std::min(newX, (double)env.width() - 1));
-          newY = std::max(0.0, std::min(newY, (double)env.height() - 1));
-        }
+// Wraps a coordinate into the grid, or clamps it on non-toroidal grids.
+template <typename Topology>
+void wrapOrClamp(const Environment &env, double &x, double &y) {
+  Topology::place(x, y, env.width(), env.height());
+}
+
+template <typename Topology>
+void applyChangePosition(ChangePosition &cp, Environment &env, double) {
+  auto target = cp.getTarget();
+  if (!target)
+    return;
+  Point2D oldLoc = target->getLocation();
+  int old_x = static_cast<int>(std::floor(oldLoc.x));
+  int old_y = static_cast<int>(std::floor(oldLoc.y));
+
+  double newX = oldLoc.x + cp.getDx();
+  double newY = oldLoc.y + cp.getDy();
+  wrapOrClamp<Topology>(env, newX, newY);
+
+  int new_x = static_cast<int>(std::floor(newX));
+  int new_y = static_cast<int>(std::floor(newY));
+
+  target->setLocation(Point2D(newX, newY));
+
+  // Update spatial index if patch changed
+  if (old_x != new_x || old_y != new_y) {
+    env.update_turtle_patch(target, old_x, old_y, new_x, new_y);
+  }
+}
+
+void applyChangeDirection(ChangeDirection &cd, Environment &, double) {
+  auto target = cd.getTarget();
+  if (target) {
+    double newHeading = target->getHeading() + cd.getDd();
+    target->setHeading(MathUtil::normalizeAngle(newHeading));
+  }
+}
+
+void applyChangeSpeed(ChangeSpeed &cs, Environment &, double) {
+  auto target = cs.getTarget();
+  if (target) {
+    double newSpeed = target->getSpeed() + cs.getDs();
+    if (newSpeed < 0)
+      newSpeed = 0;
+    target->setSpeed(newSpeed);
+  }
+}
+
+void applyStop(Stop &stop, Environment &, double) {
+  auto target = stop.getTarget();
+  if (target) {
+    target->setSpeed(0);
+  }
+}
 
-        int new_x = static_cast<int>(std::floor(newX));
-        int new_y = static_cast<int>(std::floor(newY));
+template <typename Topology>
+void applyEmitPheromone(EmitPheromone &ep, Environment &env, double) {
+  double x = ep.getLocation().x;
+  double y = ep.getLocation().y;
+  wrapOrClamp<Topology>(env, x, y);
 
-        target->setLocation(Point2D(newX, newY));
+  const auto pheromone = env.find_pheromone(ep.getPheromoneIdentifier());
+  if (!pheromone)
+    return;
+  double current = env.get_pheromone_value(x, y, *pheromone);
+  env.set_pheromone(x, y, *pheromone, current + ep.getValue());
+}
 
-        // Update spatial index if patch changed
-        if (old_x != new_x || old_y != new_y) {
-          env.update_turtle_patch(target, old_x, old_y, new_x, new_y);
+// Emits the pheromones of a batch of EmitPheromone in parallel: the
+// identifiers are resolved by chunk, then Environment::emit_pheromones()
+// adds the deposits.
+template <typename Topology>
+void applyEmitPheromones(
+    const std::vector<std::shared_ptr<IInfluence>> &batch, Environment &env,
+    double) {
+  std::vector<Environment::PheromoneDeposit> deposits(batch.size());
+  microkernel::engine::WorkStealingThreadPool::parallelForOnCurrent(
+      batch.size(), 0, [&](std::size_t begin, std::size_t end, std::size_t) {
+        // the emissions of a model mostly name the same pheromone
+        const std::string *identifier = nullptr;
+        Environment::PheromoneHandle pheromone = Environment::NO_PHEROMONE;
+        for (std::size_t i = begin; i < end; ++i) {
+          const auto &ep = static_cast<const EmitPheromone &>(*batch[i]);
+          if (!identifier || *identifier != ep.getPheromoneIdentifier()) {
+            identifier = &ep.getPheromoneIdentifier();
+            pheromone = env.find_pheromone(*identifier)
+                            .value_or(Environment::NO_PHEROMONE);
+          }
+          double x = ep.getLocation().x;
+          double y = ep.getLocation().y;
+          wrapOrClamp<Topology>(env, x, y);
+          deposits[i] = Environment::PheromoneDeposit{pheromone, x, y,
+                                                      ep.getValue()};
         }
-      }
-    }
-    // ChangeDirection
-    else if (auto cd = std::dynamic_pointer_cast<ChangeDirection>(influence)) {
-      auto target = cd->getTarget();
-      if (target) {
-        double newHeading = target->getHeading() + cd->getDd();
-        target->setHeading(MathUtil::normalizeAngle(newHeading));
-      }
+      });
+  env.emit_pheromones(deposits);
+}
+
+void applyChangeAcceleration(ChangeAcceleration &ca, Environment &, double) {
+  auto target = ca.getTarget();
+  if (target) {
+    double newAccel = target->getAcceleration() + ca.getDa();
+    target->setAcceleration(newAccel);
+  }
+}
+
+void applyDropMark(DropMark &dm, Environment &env, double) {
+  auto mark = dm.getMark();
+  if (mark) {
+    int x = static_cast<int>(std::floor(mark->getLocation().x));
+    int y = static_cast<int>(std::floor(mark->getLocation().y));
+    env.add_mark(x, y, mark);
+  }
+}
+
+// Drops the marks of a batch of DropMark, see Environment::add_marks().
+void applyDropMarks(const std::vector<std::shared_ptr<IInfluence>> &batch,
+                    Environment &env, double) {
+  std::vector<std::shared_ptr<SimpleMark>> marks;
+  marks.reserve(batch.size());
+  for (const auto &influence : batch) {
+    if (auto mark = static_cast<const DropMark &>(*influence).getMark()) {
+      marks.push_back(std::move(mark));
     }
-    // ChangeSpeed
-    else if (auto cs = std::dynamic_pointer_cast<ChangeSpeed>(influence)) {
-      auto target = cs->getTarget();
-      if (target) {
-        double newSpeed = target->getSpeed() + cs->getDs();
-        if (newSpeed < 0)
-          newSpeed = 0;
-        target->setSpeed(newSpeed);
-      }
+  }
+  env.add_marks(marks);
+}
+
+void applyRemoveMark(RemoveMark &rm, Environment &env, double) {
+  auto mark = rm.getMark();
+  if (mark) {
+    int x = static_cast<int>(std::floor(mark->getLocation().x));
+    int y = static_cast<int>(std::floor(mark->getLocation().y));
+    env.remove_mark(x, y, mark);
+  }
+}
+
+void applyRemoveMarks(RemoveMarks &rms, Environment &env, double) {
+  for (const auto &mark : rms.getMarks()) {
+    int x = static_cast<int>(std::floor(mark->getLocation().x));
+    int y = static_cast<int>(std::floor(mark->getLocation().y));
+    env.remove_mark(x, y, mark);
+  }
+}
+
+// Removes the marks of a batch of RemoveMark, see
+// Environment::remove_marks().
+void applyRemoveMarkBatch(const std::vector<std::shared_ptr<IInfluence>> &batch,
+                          Environment &env, double) {
+  std::vector<std::shared_ptr<SimpleMark>> marks;
+  marks.reserve(batch.size());
+  for (const auto &influence : batch) {
+    if (auto mark = static_cast<const RemoveMark &>(*influence).getMark()) {
+      marks.push_back(std::move(mark));
     }
-    // Stop
-    else if (auto stop = std::dynamic_pointer_cast<Stop>(influence)) {
-      auto target = stop->getTarget();
-      if (target) {
-        target->setSpeed(0);
-      }
+  }
+  env.remove_marks(marks);
+}
+
+// Removes the marks of a batch of RemoveMarks at once.
+void applyRemoveMarksBatch(
+    const std::vector<std::shared_ptr<IInfluence>> &batch, Environment &env,
+    double) {
+  std::vector<std::shared_ptr<SimpleMark>> marks;
+  for (const auto &influence : batch) {
+    const auto &removed = static_cast<const RemoveMarks &>(*influence);
+    marks.insert(marks.end(), removed.getMarks().begin(),
+                 removed.getMarks().end());
+  }
+  env.remove_marks(marks);
+}
+
+// The seed of the draws of a relocation, from the PRNG so that the moves
+// follow the seed of the simulation.
+std::uint64_t relocationSeed() {
+  return static_cast<std::uint64_t>(
+      extendedkernel::libs::random::PRNG::randomDouble() * 0x1p53);
+}
+
+void applyRelocate(Relocate &relocate, Environment &env, double) {
+  if (auto target = relocate.getTarget()) {
+    env.relocate_turtles({std::move(target)}, relocationSeed());
+  }
+}
+
+// Moves the turtles of a batch of Relocate to random empty patches at once,
+// see Environment::relocate_turtles().
+void applyRelocations(const std::vector<std::shared_ptr<IInfluence>> &batch,
+                      Environment &env, double) {
+  std::vector<std::shared_ptr<TurtlePLSInLogo>> turtles;
+  turtles.reserve(batch.size());
+  for (const auto &influence : batch) {
+    if (auto target = static_cast<const Relocate &>(*influence).getTarget()) {
+      turtles.push_back(std::move(target));
     }
-    // EmitPheromone
-    else if (auto ep = std::dynamic_pointer_cast<EmitPheromone>(influence)) {
-      double x = ep->getLocation().x;
-      double y = ep->getLocation().y;
-      // Clamp to grid
-      if (env.toroidal()) {
-        x = std::fmod(x, env.width());
-        if (x < 0)
-          x += env.width();
-        y = std::fmod(y, env.height());
-        if (y < 0)
-          y += env.height();
-      } else {
-        x = std::max(0.0, std::min(x, (double)env.width() - 1));
-        y = std::max(0.0, std::min(y, (double)env.height() - 1));
-      }
-
-      double current =
-          env.get_pheromone_value(x, y, ep->getPheromoneIdentifier());
-      env.set_pheromone(x, y, ep->getPheromoneIdentifier(),
-                        current + ep->getValue());
+  }
+  env.relocate_turtles(turtles, relocationSeed());
+}
+
+// Natural influence updating all turtles based on their speed and
+// acceleration.
+void applyAgentPositionUpdate(AgentPositionUpdate &, Environment &env,
+                              double dt) {
+  env.advance_turtles(dt);
+}
+
+// Natural influence running pheromone diffusion and evaporation.
+void applyPheromoneFieldUpdate(PheromoneFieldUpdate &, Environment &env,
+                               double dt) {
+  env.diffuse_and_evaporate(dt);
+}
+
+// Sums the deltas of a batch of additive influences per target, keyed by the
+// slot of the turtle in its store, then applies each sum once, in the order
+// of the first influence of each turtle. The turtles outside the store of
+// the first target are applied one by one.
+template <typename T, typename Delta, typename Apply>
+void coalesce(const std::vector<std::shared_ptr<IInfluence>> &batch,
+              Delta delta, Apply apply) {
+  struct Sum {
+    TurtlePLSInLogo *target;
+    double delta;
+  };
+  // the entry of each slot in the sums, plus one, 0 for none
+  thread_local std::vector<std::uint32_t> entries;
+  thread_local std::vector<Sum> sums;
+  sums.clear();
+  const TurtleStore *store = nullptr;
+  for (const auto &influence : batch) {
+    const auto &typed = static_cast<const T &>(*influence);
+    TurtlePLSInLogo *target = typed.getTarget().get();
+    if (target == nullptr) {
+      continue;
     }
-    // ChangeAcceleration
-    else if (auto ca =
-                 std::dynamic_pointer_cast<ChangeAcceleration>(influence)) {
-      auto target = ca->getTarget();
-      if (target) {
-        double newAccel = target->getAcceleration() + ca->getDa();
-        target->setAcceleration(newAccel);
-      }
+    if (store == nullptr) {
+      store = target->getStore();
     }
-    // DropMark
-    else if (auto dm = std::dynamic_pointer_cast<DropMark>(influence)) {
-      auto mark = dm->getMark();
-      if (mark) {
-        int x = static_cast<int>(std::floor(mark->getLocation().x));
-        int y = static_cast<int>(std::floor(mark->getLocation().y));
-        env.add_mark(x, y, mark);
-      }
+    if (store == nullptr || target->getStore() != store) {
+      apply(*target, delta(typed));
+      continue;
     }
-    // RemoveMark
-    else if (auto rm = std::dynamic_pointer_cast<RemoveMark>(influence)) {
-      auto mark = rm->getMark();
-      if (mark) {
-        int x = static_cast<int>(std::floor(mark->getLocation().x));
-        int y = static_cast<int>(std::floor(mark->getLocation().y));
-        env.remove_mark(x, y, mark);
-      }
+    const std::size_t slot = target->getSlot();
+    if (slot >= entries.size()) {
+      entries.resize(slot + 1, 0);
     }
-    // RemoveMarks
-    else if (auto rms = std::dynamic_pointer_cast<RemoveMarks>(influence)) {
-      for (const auto &mark : rms->getMarks()) {
-        int x = static_cast<int>(std::floor(mark->getLocation().x));
-        int y = static_cast<int>(std::floor(mark->getLocation().y));
-        env.remove_mark(x, y, mark);
-      }
+    if (entries[slot] == 0) {
+      sums.push_back(Sum{target, 0.0});
+      entries[slot] = static_cast<std::uint32_t>(sums.size());
     }
-    // AgentPositionUpdate (natural influence)
-    else if (auto apu =
-                 std::dynamic_pointer_cast<AgentPositionUpdate>(influence)) {
-      // Update all turtles based on their speed and acceleration
-      // This is a system-level influence that affects all turtles
-      // Need to collect turtles to remove to avoid iterator invalidation
-      std::vector<std::shared_ptr<TurtlePLSInLogo>> turtlesToRemove;
-
-      for (auto &turtle : env.get_turtles()) {
-        Point2D oldLoc = turtle->getLocation();
-        int old_x = static_cast<int>(std::floor(oldLoc.x));
-        int old_y = static_cast<int>(std::floor(oldLoc.y));
-
-        // Update speed based on acceleration (Java: speed += acceleration, NO
-        // dt multiplier)
-        double newSpeed = turtle->getSpeed() + turtle->getAcceleration();
-        if (newSpeed < 0)
-          newSpeed = 0; // No negative speed
-        turtle->setSpeed(newSpeed);
-
-        // Calculate movement
-        double dx = std::cos(turtle->getHeading()) * newSpeed * dt;
-        double dy = std::sin(turtle->getHeading()) * newSpeed * dt;
-
-        double newX = oldLoc.x + dx;
-        double newY = oldLoc.y + dy;
-
-        // Check out-of-bounds for non-toroidal environments
-        if (!env.toroidal()) {
-          if (newX < 0 || newX >= env.width() || newY < 0 ||
-              newY >= env.height()) {
-            // Mark turtle for removal
-            turtlesToRemove.push_back(turtle);
-            continue;
-          }
-        } else {
-          // Apply toroidal wrapping
-          newX = std::fmod(newX, env.width());
-          if (newX < 0)
-            newX += env.width();
-          newY = std::fmod(newY, env.height());
-          if (newY < 0)
-            newY += env.height();
-        }
+    sums[entries[slot] - 1].delta += delta(typed);
+  }
+  for (const Sum &sum : sums) {
+    entries[sum.target->getSlot()] = 0;
+    apply(*sum.target, sum.delta);
+  }
+}
 
-        int new_x = static_cast<int>(std::floor(newX));
-        int new_y = static_cast<int>(std::floor(newY));
+void addAcceleration(TurtlePLSInLogo &target, double da) {
+  target.setAcceleration(target.getAcceleration() + da);
+}
 
-        turtle->setLocation(Point2D(newX, newY));
+void addSpeed(TurtlePLSInLogo &target, double ds) {
+  target.setSpeed(std::max(0.0, target.getSpeed() + ds));
+}
 
-        // Update spatial index if patch changed
-        if (old_x != new_x || old_y != new_y) {
-          env.update_turtle_patch(turtle, old_x, old_y, new_x, new_y);
-        }
-      }
+void addDirection(TurtlePLSInLogo &target, double dd) {
+  target.setHeading(MathUtil::normalizeAngle(target.getHeading() + dd));
+}
 
-      // Remove out-of-bounds turtles
-      for (auto &turtle : turtlesToRemove) {
-        env.remove_turtle(turtle);
-      }
-    }
-    // PheromoneFieldUpdate (natural influence)
-    else if (auto pfu =
-                 std::dynamic_pointer_cast<PheromoneFieldUpdate>(influence)) {
-      // Run pheromone diffusion and evaporation
-      env.diffuse_and_evaporate(dt);
+void applyChangeAccelerations(
+    const std::vector<std::shared_ptr<IInfluence>> &batch, Environment &,
+    double) {
+  coalesce<ChangeAcceleration>(
+      batch, [](const ChangeAcceleration &ca) { return ca.getDa(); },
+      addAcceleration);
+}
+
+void applyChangeSpeeds(const std::vector<std::shared_ptr<IInfluence>> &batch,
+                       Environment &, double) {
+  coalesce<ChangeSpeed>(
+      batch, [](const ChangeSpeed &cs) { return cs.getDs(); }, addSpeed);
+}
+
+void applyChangeDirections(
+    const std::vector<std::shared_ptr<IInfluence>> &batch, Environment &,
+    double) {
+  coalesce<ChangeDirection>(
+      batch, [](const ChangeDirection &cd) { return cd.getDd(); },
+      addDirection);
+}
+
+// The handlers are registered in the order in which the batches are applied:
+// marks and pheromones first, then the turtle kinematics, ending with the
+// absolute Stop, ChangePosition and Relocate, and finally the natural
+// influences which read the updated turtle states. The dispatchers of the handlers wrapping
+// the locations are specialized on the topology of the grid, the coalescing
+// ones replace the loops over the additive kinematic influences.
+template <typename Topology, bool Coalescing>
+const Dispatcher &reactionDispatcher() {
+  static const Dispatcher dispatcher = []() {
+    Dispatcher table;
+    table.on<DropMark>(applyDropMark);
+    table.onBatch<DropMark>(applyDropMarks);
+    table.on<RemoveMark>(applyRemoveMark);
+    table.onBatch<RemoveMark>(applyRemoveMarkBatch);
+    table.on<RemoveMarks>(applyRemoveMarks);
+    table.onBatch<RemoveMarks>(applyRemoveMarksBatch);
+    table.on<EmitPheromone>(applyEmitPheromone<Topology>);
+    table.onBatch<EmitPheromone>(applyEmitPheromones<Topology>);
+    table.on<ChangeAcceleration>(applyChangeAcceleration);
+    table.on<ChangeSpeed>(applyChangeSpeed);
+    table.on<Stop>(applyStop);
+    table.on<ChangeDirection>(applyChangeDirection);
+    table.on<ChangePosition>(applyChangePosition<Topology>);
+    table.on<Relocate>(applyRelocate);
+    table.onBatch<Relocate>(applyRelocations);
+    table.on<AgentPositionUpdate>(applyAgentPositionUpdate);
+    table.on<PheromoneFieldUpdate>(applyPheromoneFieldUpdate);
+    if constexpr (Coalescing) {
+      table.onBatch<ChangeAcceleration>(applyChangeAccelerations);
+      table.onBatch<ChangeSpeed>(applyChangeSpeeds);
+      table.onBatch<ChangeDirection>(applyChangeDirections);
     }
-  }
+    return table;
+  }();
+  return dispatcher;
+}
+
+} // namespace
+
+void Reaction::apply(const std::vector<std::shared_ptr<IInfluence>> &influences,
+                     Environment &env, double dt) {
+  const std::unique_lock<std::shared_mutex> access(env.access_mutex());
+  // Influences of unknown types are ignored.
+  buckets.clear();
+  buckets.addAll(influences);
+  withTopology(env.toroidal(), env.toroidal(), [&](auto topology) {
+    using T = decltype(topology);
+    const Dispatcher &dispatcher = coalescing
+                                       ? reactionDispatcher<T, true>()
+                                       : reactionDispatcher<T, false>();
+    dispatcher.dispatchBatches(buckets, env, dt);
+  });
+  buckets.clear();
 
   // Natural pheromone dynamics
   env.diffuse_and_evaporate(dt);
@@ -0,0 +1,197 @@
+#include "kernel/tools/CrowdField.h"
+#include <algorithm>
+#include <cmath>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace tools {
+
+namespace {
+
+// The finalizer of SplitMix64, spreading the bits of a counter
+std::uint64_t mix(std::uint64_t value) {
+  value += 0x9e3779b97f4a7c15ULL;
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+  return value ^ (value >> 31);
+}
+
+// A draw in [0, 1) from the 53 high bits of a mixed value
+double unit(std::uint64_t value) {
+  return static_cast<double>(value >> 11) * 0x1p-53;
+}
+
+} // namespace
+
+CrowdField::CrowdField(int width, int height, bool toroidal)
+    : toroidal(toroidal), density(width, height), momentumX(width, height),
+      momentumY(width, height) {}
+
+void CrowdField::deposit(double x, double y, double vx, double vy) {
+  const int px = static_cast<int>(std::floor(x));
+  const int py = static_cast<int>(std::floor(y));
+  if (!density.contains(px, py)) {
+    return;
+  }
+  const std::size_t cell = density.index(px, py);
+  density[cell] += 1;
+  momentumX[cell] += vx;
+  momentumY[cell] += vy;
+  occupied = true;
+}
+
+void CrowdField::getVelocity(int x, int y, double &vx, double &vy) const {
+  const std::size_t cell = density.index(x, y);
+  const double mass = density[cell];
+  vx = mass > 0 ? momentumX[cell] / mass : 0.0;
+  vy = mass > 0 ? momentumY[cell] / mass : 0.0;
+}
+
+double CrowdField::getMass() const {
+  if (!occupied) {
+    return 0;
+  }
+  double mass = 0;
+  for (const double value : density) {
+    mass += value;
+  }
+  return mass;
+}
+
+double CrowdField::getMass(int x, int y, int columns, int rows) const {
+  if (!occupied) {
+    return 0;
+  }
+  const int lastX = std::min(x + columns, getWidth());
+  const int lastY = std::min(y + rows, getHeight());
+  double mass = 0;
+  for (int j = std::max(y, 0); j < lastY; ++j) {
+    const double *row = density.row(j);
+    for (int i = std::max(x, 0); i < lastX; ++i) {
+      mass += row[i];
+    }
+  }
+  return mass;
+}
+
+void CrowdField::advect(double dt) {
+  if (!occupied || dt <= 0) {
+    return;
+  }
+  // the sub-steps keep the fractions sent by a patch within its content
+  double fastest = 0;
+  for (std::size_t cell = 0; cell < density.size(); ++cell) {
+    const double mass = density[cell];
+    if (mass > 0) {
+      fastest = std::max(fastest, (std::abs(momentumX[cell]) +
+                                   std::abs(momentumY[cell])) /
+                                      mass);
+    }
+  }
+  const int steps = std::max(1, static_cast<int>(std::ceil(fastest * dt)));
+  for (int s = 0; s < steps; ++s) {
+    step(dt / steps);
+  }
+}
+
+void CrowdField::step(double dt) {
+  nextDensity = density;
+  nextMomentumX = momentumX;
+  nextMomentumY = momentumY;
+  const int width = getWidth();
+  const int height = getHeight();
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      const std::size_t cell = density.index(x, y);
+      const double mass = density[cell];
+      if (mass <= 0) {
+        continue;
+      }
+      const double vx = momentumX[cell] / mass;
+      const double vy = momentumY[cell] / mass;
+      if (vx != 0) {
+        transfer(cell, vx > 0 ? x + 1 : x - 1, y, std::abs(vx) * dt);
+      }
+      if (vy != 0) {
+        transfer(cell, x, vy > 0 ? y + 1 : y - 1, std::abs(vy) * dt);
+      }
+    }
+  }
+  density.swap(nextDensity);
+  momentumX.swap(nextMomentumX);
+  momentumY.swap(nextMomentumY);
+}
+
+void CrowdField::transfer(std::size_t from, int x, int y, double fraction) {
+  const double mass = fraction * density[from];
+  const double px = fraction * momentumX[from];
+  const double py = fraction * momentumY[from];
+  nextDensity[from] -= mass;
+  nextMomentumX[from] -= px;
+  nextMomentumY[from] -= py;
+  if (toroidal) {
+    x = x < 0 ? x + getWidth() : (x >= getWidth() ? x - getWidth() : x);
+    y = y < 0 ? y + getHeight() : (y >= getHeight() ? y - getHeight() : y);
+  } else if (!density.contains(x, y)) {
+    return;
+  }
+  const std::size_t to = density.index(x, y);
+  nextDensity[to] += mass;
+  nextMomentumX[to] += px;
+  nextMomentumY[to] += py;
+}
+
+void CrowdField::release(int x, int y, int columns, int rows,
+                         std::uint64_t seed, std::vector<Member> &members) {
+  if (!occupied) {
+    return;
+  }
+  const int lastX = std::min(x + columns, getWidth());
+  const int lastY = std::min(y + rows, getHeight());
+  double sum = 0;
+  double drawn = 0;
+  std::uint64_t draw = mix(seed ^ mix(density.index(std::max(x, 0),
+                                                    std::max(y, 0))));
+  for (int j = std::max(y, 0); j < lastY; ++j) {
+    for (int i = std::max(x, 0); i < lastX; ++i) {
+      const std::size_t cell = density.index(i, j);
+      const double mass = density[cell];
+      if (mass <= 0) {
+        continue;
+      }
+      sum += mass;
+      double vx, vy;
+      getVelocity(i, j, vx, vy);
+      for (; drawn < std::floor(sum + 0.5); drawn += 1) {
+        draw = mix(draw);
+        const double u = unit(draw);
+        draw = mix(draw);
+        const double v = unit(draw);
+        members.push_back(Member{i + u, j + v, std::atan2(vy, vx),
+                                 std::hypot(vx, vy)});
+      }
+      density[cell] = 0;
+      momentumX[cell] = 0;
+      momentumY[cell] = 0;
+    }
+  }
+}
+
+void CrowdField::clear() {
+  std::fill(density.begin(), density.end(), 0.0);
+  std::fill(momentumX.begin(), momentumX.end(), 0.0);
+  std::fill(momentumY.begin(), momentumY.end(), 0.0);
+  occupied = false;
+}
+
+} // namespace tools
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -0,0 +1,246 @@
+#include "kernel/tools/DomainDecomposition.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace tools {
+
+namespace {
+
+// Tells whether the parts of a split axis are not empty, and whether a part
+// and its halos fit in a toroidal axis without overlapping themselves.
+bool axisFits(int length, bool torus, int parts, int haloWidth) {
+  if (parts < 1 || parts > length) {
+    return false;
+  }
+  if (parts == 1 || !torus) {
+    return true;
+  }
+  // The widest part, of ceil(length / parts) patches
+  return (length + parts - 1) / parts + 2 * haloWidth <= length;
+}
+
+// Tells whether parts starting at given coordinates split an axis, each
+// part and its halos fitting in it if it is toroidal.
+bool startsFit(const std::vector<int> &starts, int length, bool torus,
+               int haloWidth) {
+  if (starts.size() < 2 || starts.front() != 0 || starts.back() != length) {
+    return false;
+  }
+  const std::size_t parts = starts.size() - 1;
+  for (std::size_t i = 0; i < parts; ++i) {
+    const int partLength = starts[i + 1] - starts[i];
+    if (partLength < 1 ||
+        (torus && parts > 1 && partLength + 2 * haloWidth > length)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+DomainDecomposition::DomainDecomposition(int width, int height,
+                                         bool xAxisTorus, bool yAxisTorus,
+                                         int domainCount, int haloWidth)
+    : width(width), height(height), xAxisTorus(xAxisTorus),
+      yAxisTorus(yAxisTorus), columns(0), rows(0), haloWidth(haloWidth) {
+  if (domainCount < 1) {
+    throw std::invalid_argument("The number of domains must be positive.");
+  }
+  // The domains exchange their borders: the shortest ones are the cheapest.
+  double bestPerimeter = std::numeric_limits<double>::infinity();
+  for (int c = 1; c <= domainCount; ++c) {
+    if (domainCount % c != 0) {
+      continue;
+    }
+    const int r = domainCount / c;
+    if (!axisFits(width, xAxisTorus, c, haloWidth) ||
+        !axisFits(height, yAxisTorus, r, haloWidth)) {
+      continue;
+    }
+    const double perimeter =
+        static_cast<double>(width) / c + static_cast<double>(height) / r;
+    if (perimeter < bestPerimeter) {
+      bestPerimeter = perimeter;
+      columns = c;
+      rows = r;
+    }
+  }
+  if (columns == 0) {
+    throw std::invalid_argument("The grid cannot be split into " +
+                                std::to_string(domainCount) + " domains.");
+  }
+  columnStarts = equalStarts(columns, width);
+  rowStarts = equalStarts(rows, height);
+  validate();
+}
+
+DomainDecomposition::DomainDecomposition(int width, int height,
+                                         bool xAxisTorus, bool yAxisTorus,
+                                         int columns, int rows, int haloWidth)
+    : width(width), height(height), xAxisTorus(xAxisTorus),
+      yAxisTorus(yAxisTorus), columns(columns), rows(rows),
+      haloWidth(haloWidth) {
+  if (columns < 1 || rows < 1 || columns > width || rows > height) {
+    throw std::invalid_argument(
+        "The grid cannot be split into " + std::to_string(columns) + " x " +
+        std::to_string(rows) + " domains.");
+  }
+  columnStarts = equalStarts(columns, width);
+  rowStarts = equalStarts(rows, height);
+  validate();
+}
+
+DomainDecomposition::DomainDecomposition(int width, int height,
+                                         bool xAxisTorus, bool yAxisTorus,
+                                         std::vector<int> columnStarts,
+                                         std::vector<int> rowStarts,
+                                         int haloWidth)
+    : width(width), height(height), xAxisTorus(xAxisTorus),
+      yAxisTorus(yAxisTorus),
+      columns(static_cast<int>(columnStarts.size()) - 1),
+      rows(static_cast<int>(rowStarts.size()) - 1), haloWidth(haloWidth),
+      columnStarts(std::move(columnStarts)), rowStarts(std::move(rowStarts)) {
+  validate();
+}
+
+DomainDecomposition
+DomainDecomposition::rebalanced(const std::vector<double> &columnLoads,
+                                const std::vector<double> &rowLoads) const {
+  if (columnLoads.size() != static_cast<std::size_t>(width) ||
+      rowLoads.size() != static_cast<std::size_t>(height)) {
+    throw std::invalid_argument(
+        "The loads are those of each column and each row of patches.");
+  }
+  // A part of a split toroidal axis leaves room for its two halos
+  const int maxWidth =
+      xAxisTorus && columns > 1 ? width - 2 * haloWidth : width;
+  const int maxHeight =
+      yAxisTorus && rows > 1 ? height - 2 * haloWidth : height;
+  return DomainDecomposition(width, height, xAxisTorus, yAxisTorus,
+                             balancedStarts(columnLoads, columns, maxWidth),
+                             balancedStarts(rowLoads, rows, maxHeight),
+                             haloWidth);
+}
+
+std::vector<int> DomainDecomposition::equalStarts(int count, int length) {
+  std::vector<int> starts(static_cast<std::size_t>(count) + 1);
+  for (int i = 0; i <= count; ++i) {
+    starts[i] = partStart(i, count, length);
+  }
+  return starts;
+}
+
+std::vector<int>
+DomainDecomposition::balancedStarts(const std::vector<double> &loads,
+                                    int count, int maxLength) {
+  const int length = static_cast<int>(loads.size());
+  std::vector<double> prefix(loads.size() + 1, 0.0);
+  for (std::size_t i = 0; i < loads.size(); ++i) {
+    prefix[i + 1] = prefix[i] + std::max(loads[i], 0.0);
+  }
+  if (!(prefix.back() > 0.0)) {
+    return equalStarts(count, length);
+  }
+  // Each cut at the coordinate whose prefix load is the nearest to its
+  // share, within the lengths left to the parts before and after it
+  std::vector<int> starts(static_cast<std::size_t>(count) + 1);
+  starts[0] = 0;
+  starts[count] = length;
+  for (int k = 1; k < count; ++k) {
+    const double target = prefix.back() * k / count;
+    int cut = static_cast<int>(
+        std::lower_bound(prefix.begin(), prefix.end(), target) -
+        prefix.begin());
+    if (cut > 0 && target - prefix[cut - 1] < prefix[cut] - target) {
+      --cut;
+    }
+    const int left = count - k;
+    const int lowest = std::max(starts[k - 1] + 1, length - left * maxLength);
+    const int highest = std::min(starts[k - 1] + maxLength, length - left);
+    starts[k] = std::max(lowest, std::min(highest, cut));
+  }
+  return starts;
+}
+
+void DomainDecomposition::validate() const {
+  if (width < 1 || height < 1) {
+    throw std::invalid_argument("The dimensions of the grid must be positive.");
+  }
+  if (haloWidth < 1) {
+    throw std::invalid_argument("The halo must be at least one patch wide.");
+  }
+  if (columns < 1 || rows < 1 ||
+      !startsFit(columnStarts, width, xAxisTorus, haloWidth) ||
+      !startsFit(rowStarts, height, yAxisTorus, haloWidth)) {
+    throw std::invalid_argument(
+        "The grid cannot be split into " + std::to_string(columns) + " x " +
+        std::to_string(rows) + " domains with a halo of " +
+        std::to_string(haloWidth) + " patches.");
+  }
+}
+
+int DomainDecomposition::partOf(int coordinate,
+                                const std::vector<int> &starts) {
+  return static_cast<int>(
+      std::upper_bound(starts.begin() + 1, starts.end() - 1, coordinate) -
+      (starts.begin() + 1));
+}
+
+DomainDecomposition::Box DomainDecomposition::getDomain(int rank) const {
+  if (rank < 0 || rank >= getDomainCount()) {
+    throw std::out_of_range("No domain of rank " + std::to_string(rank));
+  }
+  const int column = rank % columns;
+  const int row = rank / columns;
+  const int x = columnStarts[column];
+  const int y = rowStarts[row];
+  return Box{x, y, columnStarts[column + 1] - x, rowStarts[row + 1] - y};
+}
+
+DomainDecomposition::Box DomainDecomposition::getLocalGrid(int rank) const {
+  Box box = getDomain(rank);
+  // The halos lie where a neighbour does: everywhere on a split toroidal
+  // axis, within the grid otherwise.
+  auto widen = [this](int &start, int &length, int parts, int gridLength,
+                      bool torus) {
+    if (parts == 1) {
+      return;
+    }
+    const int before = torus ? haloWidth : std::min(haloWidth, start);
+    const int after =
+        torus ? haloWidth
+              : std::min(haloWidth, gridLength - (start + length));
+    start -= before;
+    length += before + after;
+  };
+  widen(box.x, box.width, columns, width, xAxisTorus);
+  widen(box.y, box.height, rows, height, yAxisTorus);
+  return box;
+}
+
+int DomainDecomposition::ownerOf(int x, int y) const {
+  x = wrapX(x);
+  y = wrapY(y);
+  if (x < 0 || x >= width || y < 0 || y >= height) {
+    return -1;
+  }
+  return partOf(y, rowStarts) * columns + partOf(x, columnStarts);
+}
+
+} // namespace tools
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
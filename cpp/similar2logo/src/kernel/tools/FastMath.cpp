@@ -1,4 +1,7 @@
 #include "kernel/tools/FastMath.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 
 namespace fr {
 namespace univ_artois {
@@ -10,6 +13,116 @@ namespace tools {
 std::vector<double> FastMath::sinTable;
 bool FastMath::initialized = false;
 
+namespace {
+
+// pi / 2 split into two 33 bits parts and a remainder (Cody and Waite), so
+// that q * PIO2_1 and q * PIO2_2 are exact for the quadrants q below 2^20.
+constexpr double PIO2_1 = 1.57079632673412561417e+00;
+constexpr double PIO2_2 = 6.07710050630396597660e-11;
+constexpr double PIO2_3 = 2.02226624879595063154e-21;
+constexpr double TWO_OVER_PI = 6.36619772367581382433e-01;
+// adding and subtracting 1.5 * 2^52 rounds to the nearest integer
+constexpr double ROUNDING = 6755399441055744.0;
+
+// the minimax polynomials of fdlibm on [-pi / 4, pi / 4]
+constexpr double S1 = -1.66666666666666324348e-01;
+constexpr double S2 = 8.33333333332248946124e-03;
+constexpr double S3 = -1.98412698298579493134e-04;
+constexpr double S4 = 2.75573137070700676789e-06;
+constexpr double S5 = -2.50507602534068634195e-08;
+constexpr double S6 = 1.58969099521155010221e-10;
+constexpr double C1 = 4.16666666666666019037e-02;
+constexpr double C2 = -1.38888888888741095749e-03;
+constexpr double C3 = 2.48015872894767294178e-05;
+constexpr double C4 = -2.75573143513906633035e-07;
+constexpr double C5 = 2.08757232129817482790e-09;
+constexpr double C6 = -1.13596475577881948265e-11;
+
+// the polynomial of atan on [0, 1] of Abramowitz and Stegun (4.4.49), within
+// 1.2e-5 radians
+constexpr double A1 = 0.9998660;
+constexpr double A3 = -0.3302995;
+constexpr double A5 = 0.1801410;
+constexpr double A7 = -0.0851330;
+constexpr double A9 = 0.0208351;
+constexpr double PI = 3.14159265358979323846;
+
+} // namespace
+
+void FastMath::sinCos(const double *angles, double *sines, double *cosines,
+                      std::size_t count) {
+  std::size_t large = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    const double angle = angles[i];
+    large += !(std::abs(angle) <= SIN_COS_LIMIT);
+    const double shifted = angle * TWO_OVER_PI + ROUNDING;
+    const double q = shifted - ROUNDING;
+    const double r = ((angle - q * PIO2_1) - q * PIO2_2) - q * PIO2_3;
+    const double z = r * r;
+    const double sine =
+        r + r * z * (S1 + z * (S2 + z * (S3 + z * (S4 + z * (S5 + z * S6)))));
+    const double cosine =
+        1.0 - 0.5 * z +
+        z * z * (C1 + z * (C2 + z * (C3 + z * (C4 + z * (C5 + z * C6)))));
+    // the quadrant, q modulo 4, is in the lowest bits of shifted
+    std::uint64_t bits;
+    std::memcpy(&bits, &shifted, sizeof(bits));
+    const std::uint64_t quadrant = bits & 3;
+    const double s = (quadrant & 1) ? cosine : sine;
+    const double c = (quadrant & 1) ? sine : cosine;
+    sines[i] = (quadrant & 2) ? -s : s;
+    cosines[i] = ((quadrant + 1) & 2) ? -c : c;
+  }
+  if (large != 0) {
+    for (std::size_t i = 0; i < count; ++i) {
+      if (!(std::abs(angles[i]) <= SIN_COS_LIMIT)) {
+        const double angle = angles[i];
+        sines[i] = std::sin(angle);
+        cosines[i] = std::cos(angle);
+      }
+    }
+  }
+}
+
+void FastMath::atan2(const double *ys, const double *xs, double *angles,
+                     std::size_t count) {
+  for (std::size_t i = 0; i < count; ++i) {
+    const double x = xs[i];
+    const double y = ys[i];
+    const double ax = std::abs(x);
+    const double ay = std::abs(y);
+    const double high = std::max(ax, ay);
+    const double low = std::min(ax, ay);
+    // the atan of the ratio in [0, 1], then moved to its octant
+    const double t = high > 0 ? low / high : 0.0;
+    const double z = t * t;
+    double angle = t * (A1 + z * (A3 + z * (A5 + z * (A7 + z * A9))));
+    angle = ay > ax ? PI / 2 - angle : angle;
+    angle = x < 0 ? PI - angle : angle;
+    angles[i] = y < 0 ? -angle : angle;
+  }
+}
+
+void FastMath::sinCos(const float *angles, float *sines, float *cosines,
+                      std::size_t count) {
+  // by blocks of doubles, which stay in the cache
+  constexpr std::size_t BLOCK = 256;
+  double wide[BLOCK];
+  double wideSines[BLOCK];
+  double wideCosines[BLOCK];
+  for (std::size_t first = 0; first < count; first += BLOCK) {
+    const std::size_t n = std::min(BLOCK, count - first);
+    for (std::size_t i = 0; i < n; ++i) {
+      wide[i] = angles[first + i];
+    }
+    sinCos(wide, wideSines, wideCosines, n);
+    for (std::size_t i = 0; i < n; ++i) {
+      sines[first + i] = static_cast<float>(wideSines[i]);
+      cosines[first + i] = static_cast<float>(wideCosines[i]);
+    }
+  }
+}
+
 } // namespace tools
 } // namespace microkernel
 } // namespace similar
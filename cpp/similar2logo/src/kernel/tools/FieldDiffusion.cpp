@@ -0,0 +1,787 @@
+#include "kernel/tools/FieldDiffusion.h"
+#include "kernel/tools/MathUtil.h"
+#include "kernel/tools/RowBands.h"
+#include "kernel/tools/Topology.h"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <limits>
+#include <type_traits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace tools {
+
+namespace {
+
+// The values of 4 doubles or 8 floats (AVX2), 2 doubles or 4 floats (NEON)
+// processed by one instruction: Lanes<Value>::Type holds COUNT values, the
+// operations being overloaded on the vector type.
+template <typename Value> struct Lanes {
+  static constexpr int COUNT = 1;
+};
+#if defined(__AVX2__)
+#define SIMILAR2LOGO_FIELD_LANES 1
+template <> struct Lanes<double> {
+  using Type = __m256d;
+  static constexpr int COUNT = 4;
+};
+template <> struct Lanes<float> {
+  using Type = __m256;
+  static constexpr int COUNT = 8;
+};
+inline __m256d load(const double *p) { return _mm256_loadu_pd(p); }
+inline void store(double *p, __m256d v) { _mm256_storeu_pd(p, v); }
+inline __m256d splat(double v) { return _mm256_set1_pd(v); }
+inline __m256d add(__m256d a, __m256d b) { return _mm256_add_pd(a, b); }
+inline __m256d sub(__m256d a, __m256d b) { return _mm256_sub_pd(a, b); }
+inline __m256d mul(__m256d a, __m256d b) { return _mm256_mul_pd(a, b); }
+inline __m256d max(__m256d a, __m256d b) { return _mm256_max_pd(a, b); }
+// Zeroes the lanes of v lower than threshold.
+inline __m256d zero_below(__m256d v, __m256d threshold) {
+  return _mm256_and_pd(v, _mm256_cmp_pd(v, threshold, _CMP_NLT_UQ));
+}
+inline __m256 load(const float *p) { return _mm256_loadu_ps(p); }
+inline void store(float *p, __m256 v) { _mm256_storeu_ps(p, v); }
+inline __m256 splat(float v) { return _mm256_set1_ps(v); }
+inline __m256 add(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+inline __m256 sub(__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+inline __m256 mul(__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+inline __m256 max(__m256 a, __m256 b) { return _mm256_max_ps(a, b); }
+inline __m256 zero_below(__m256 v, __m256 threshold) {
+  return _mm256_and_ps(v, _mm256_cmp_ps(v, threshold, _CMP_NLT_UQ));
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define SIMILAR2LOGO_FIELD_LANES 1
+template <> struct Lanes<double> {
+  using Type = float64x2_t;
+  static constexpr int COUNT = 2;
+};
+template <> struct Lanes<float> {
+  using Type = float32x4_t;
+  static constexpr int COUNT = 4;
+};
+inline float64x2_t load(const double *p) { return vld1q_f64(p); }
+inline void store(double *p, float64x2_t v) { vst1q_f64(p, v); }
+inline float64x2_t splat(double v) { return vdupq_n_f64(v); }
+inline float64x2_t add(float64x2_t a, float64x2_t b) { return vaddq_f64(a, b); }
+inline float64x2_t sub(float64x2_t a, float64x2_t b) { return vsubq_f64(a, b); }
+inline float64x2_t mul(float64x2_t a, float64x2_t b) { return vmulq_f64(a, b); }
+inline float64x2_t max(float64x2_t a, float64x2_t b) { return vmaxq_f64(a, b); }
+inline float64x2_t zero_below(float64x2_t v, float64x2_t threshold) {
+  uint64x2_t below = vcltq_f64(v, threshold);
+  return vreinterpretq_f64_u64(
+      vbicq_u64(vreinterpretq_u64_f64(v), below));
+}
+inline float32x4_t load(const float *p) { return vld1q_f32(p); }
+inline void store(float *p, float32x4_t v) { vst1q_f32(p, v); }
+inline float32x4_t splat(float v) { return vdupq_n_f32(v); }
+inline float32x4_t add(float32x4_t a, float32x4_t b) { return vaddq_f32(a, b); }
+inline float32x4_t sub(float32x4_t a, float32x4_t b) { return vsubq_f32(a, b); }
+inline float32x4_t mul(float32x4_t a, float32x4_t b) { return vmulq_f32(a, b); }
+inline float32x4_t max(float32x4_t a, float32x4_t b) { return vmaxq_f32(a, b); }
+inline float32x4_t zero_below(float32x4_t v, float32x4_t threshold) {
+  uint32x4_t below = vcltq_f32(v, threshold);
+  return vreinterpretq_f32_u32(
+      vbicq_u32(vreinterpretq_u32_f32(v), below));
+}
+#endif
+
+constexpr int TILE = TiledField::TILE_SIZE;
+
+// The minimum value of a field of floats is at least the smallest normal
+// float: an evaporation leaves subnormal values within a few thousand steps,
+// which slow every operation on them long before they reach 0.
+template <typename Value> Value min_value(double value) {
+  if constexpr (std::is_same_v<Value, float>) {
+    return std::max(static_cast<float>(value),
+                    std::numeric_limits<float>::min());
+  } else {
+    return static_cast<Value>(value);
+  }
+}
+
+// The rates of a step in the type of the values of a field.
+template <typename Value> struct Coefficients {
+  Value diffusion;
+  bool evaporate;
+  Value evaporation;
+  Value minValue;
+
+  template <typename Rates>
+  explicit Coefficients(const Rates &r)
+      : diffusion(static_cast<Value>(r.diffusion)), evaporate(r.evaporate),
+        evaporation(static_cast<Value>(r.evaporation)),
+        minValue(min_value<Value>(r.minValue)) {}
+};
+
+template <typename Value>
+inline Value evaporated(Value value, const Coefficients<Value> &c) {
+  if (!c.evaporate) {
+    return value;
+  }
+  Value next = value - c.evaporation * value;
+  return next < c.minValue ? Value(0) : next;
+}
+
+// Computes cells [begin, end) of a row from the shares of the rows above
+// (up), of the row itself (mid) and below (down): each cell loses what it
+// gives and receives the shares of its 8 neighbours, before evaporating.
+template <typename Value>
+void update_row(const Value *values, const Value *up, const Value *mid,
+                const Value *down, Value *out, int begin, int end,
+                const Coefficients<Value> &c) {
+  int x = begin;
+#if defined(SIMILAR2LOGO_FIELD_LANES)
+  using V = typename Lanes<Value>::Type;
+  constexpr int count = Lanes<Value>::COUNT;
+  const V zero = splat(Value(0));
+  const V diffusion = splat(c.diffusion);
+  const V evaporation = splat(c.evaporation);
+  const V min_value = splat(c.minValue);
+  for (; x + count <= end; x += count) {
+    const V v = load(values + x);
+    V received = add(add(load(up + x - 1), load(up + x)),
+                     add(load(up + x + 1), load(mid + x - 1)));
+    received = add(received, add(add(load(mid + x + 1), load(down + x - 1)),
+                                 add(load(down + x), load(down + x + 1))));
+    V next = add(sub(v, mul(max(v, zero), diffusion)), received);
+    if (c.evaporate) {
+      next = zero_below(sub(next, mul(evaporation, next)), min_value);
+    }
+    store(out + x, next);
+  }
+#endif
+  for (; x < end; ++x) {
+    const Value received = up[x - 1] + up[x] + up[x + 1] + mid[x - 1] +
+                           mid[x + 1] + down[x - 1] + down[x] + down[x + 1];
+    const Value v = values[x];
+    out[x] = evaporated(v - std::max(v, Value(0)) * c.diffusion + received, c);
+  }
+}
+
+// Computes the share given by the cells [begin, end) of row y to each of
+// their neighbours: 1/8 of their outflow inside the grid and along the
+// toroidal axes, 1/5 on borders and 1/3 in corners.
+template <typename Topology, typename Value>
+void share_row(const Value *values, Value *share, int w, int y, int h,
+               Value diffusion, int begin, int end) {
+  const bool border_row = !Topology::Y_WRAPS && (y == 0 || y == h - 1);
+  const Value inner = diffusion / Value(border_row ? 5 : 8);
+  int x = begin;
+#if defined(SIMILAR2LOGO_FIELD_LANES)
+  using V = typename Lanes<Value>::Type;
+  const V zero = splat(Value(0));
+  const V factor = splat(inner);
+  for (; x + Lanes<Value>::COUNT <= end; x += Lanes<Value>::COUNT) {
+    store(share + x, mul(max(load(values + x), zero), factor));
+  }
+#endif
+  for (; x < end; ++x) {
+    share[x] = std::max(values[x], Value(0)) * inner;
+  }
+  if constexpr (!Topology::X_WRAPS) {
+    const Value edge = diffusion / Value(border_row ? 3 : 5);
+    if (begin == 0) {
+      share[0] = std::max(values[0], Value(0)) * edge;
+    }
+    if (end == w) {
+      share[w - 1] = std::max(values[w - 1], Value(0)) * edge;
+    }
+  }
+}
+
+template <typename Value>
+void evaporate(Value *values, std::size_t count,
+               const Coefficients<Value> &c) {
+  for (std::size_t x = 0; x < count; ++x) {
+    values[x] = evaporated(values[x], c);
+  }
+}
+
+template <typename Value> bool any_non_zero(const Value *values, int count) {
+  for (int x = 0; x < count; ++x) {
+    if (values[x] != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// the end of the tile starting at the cell first of a line of cells
+int tile_end(int first, int cells) { return std::min(cells, first + TILE); }
+
+using Complex = std::complex<double>;
+
+// The discrete Fourier transform of n points: radix 2 when n is a power of
+// 2, and Bluestein's chirp z-transform otherwise, which writes the transform
+// as a convolution computed by transforms of a power of 2.
+class Fourier {
+public:
+  explicit Fourier(int n) : n(n), size(1) {
+    while (size < n) {
+      size *= 2;
+    }
+    if (size != n) {
+      while (size < 2 * n - 1) {
+        size *= 2;
+      }
+    }
+    twiddles.resize(size / 2);
+    for (int k = 0; k < size / 2; ++k) {
+      twiddles[k] = std::polar(1.0, -MathUtil::TWO_PI * k / size);
+    }
+    if (size == n) {
+      return;
+    }
+    // the chirp exp(-i pi k^2 / n), k^2 being taken modulo 2n to keep its
+    // precision
+    chirp.resize(n);
+    for (int k = 0; k < n; ++k) {
+      const long long square = static_cast<long long>(k) * k % (2LL * n);
+      chirp[k] =
+          std::polar(1.0, -MathUtil::PI * static_cast<double>(square) / n);
+    }
+    kernel.assign(size, Complex(0));
+    kernel[0] = std::conj(chirp[0]);
+    for (int k = 1; k < n; ++k) {
+      kernel[k] = kernel[size - k] = std::conj(chirp[k]);
+    }
+    radix2(kernel.data(), false);
+  }
+
+  // Transforms the n points of data in place, the inverse transform lacking
+  // the factor 1 / n. scratch is resized as needed.
+  void transform(Complex *data, bool inverse,
+                 std::vector<Complex> &scratch) const {
+    if (size == n) {
+      radix2(data, inverse);
+      return;
+    }
+    // the inverse transform is the conjugate of the transform of the
+    // conjugate
+    scratch.assign(size, Complex(0));
+    for (int k = 0; k < n; ++k) {
+      scratch[k] = (inverse ? std::conj(data[k]) : data[k]) * chirp[k];
+    }
+    radix2(scratch.data(), false);
+    for (int k = 0; k < size; ++k) {
+      scratch[k] *= kernel[k];
+    }
+    radix2(scratch.data(), true);
+    const double scale = 1.0 / size;
+    for (int k = 0; k < n; ++k) {
+      const Complex value = scratch[k] * chirp[k] * scale;
+      data[k] = inverse ? std::conj(value) : value;
+    }
+  }
+
+private:
+  int n;
+  // the points of the radix 2 transforms
+  int size;
+  std::vector<Complex> twiddles;
+  std::vector<Complex> chirp;
+  // the transform of the conjugate chirp, wrapped around
+  std::vector<Complex> kernel;
+
+  void radix2(Complex *data, bool inverse) const {
+    for (int i = 1, j = 0; i < size; ++i) {
+      int bit = size >> 1;
+      for (; j & bit; bit >>= 1) {
+        j ^= bit;
+      }
+      j ^= bit;
+      if (i < j) {
+        std::swap(data[i], data[j]);
+      }
+    }
+    for (int length = 2; length <= size; length *= 2) {
+      const int half = length / 2;
+      const int stride = size / length;
+      for (int first = 0; first < size; first += length) {
+        for (int k = 0; k < half; ++k) {
+          const Complex twiddle = inverse ? std::conj(twiddles[k * stride])
+                                          : twiddles[k * stride];
+          const Complex odd = data[first + k + half] * twiddle;
+          data[first + k + half] = data[first + k] - odd;
+          data[first + k] += odd;
+        }
+      }
+    }
+  }
+};
+
+// The eigenvalues of the shifts by -1, 0 and +1 along an axis of n patches,
+// 1 + 2 cos(2 pi k / n): the stencil summing a patch and its 8 neighbours
+// has the eigenvalue symbolX[kx] * symbolY[ky].
+std::vector<double> stencil_symbol(int n) {
+  std::vector<double> symbol(n);
+  for (int k = 0; k < n; ++k) {
+    symbol[k] = 1 + 2 * std::cos(MathUtil::TWO_PI * k / n);
+  }
+  return symbol;
+}
+
+} // namespace
+
+template <typename Value> struct BasicFieldDiffusion<Value>::SpectralPlan {
+  Fourier rows;
+  Fourier columns;
+  std::vector<double> symbolX;
+  std::vector<double> symbolY;
+
+  SpectralPlan(int width, int height)
+      : rows(width), columns(height), symbolX(stencil_symbol(width)),
+        symbolY(stencil_symbol(height)) {}
+};
+
+template <typename Value>
+BasicFieldDiffusion<Value>::BasicFieldDiffusion(int width, int height,
+                                                bool xTorus, bool yTorus)
+    : width(width), height(height), xTorus(xTorus), yTorus(yTorus),
+      tileColumns((width + TILE - 1) / TILE),
+      tileRows((height + TILE - 1) / TILE) {}
+
+template <typename Value>
+void BasicFieldDiffusion<Value>::add(Field &field, const Rates &rates,
+                                     std::vector<unsigned char> *written) {
+  if (scheme == Scheme::SPECTRAL && xTorus && yTorus) {
+    // The fields which do not diffuse evaporate as exactly as the others.
+    Rates exact = rates;
+    exact.evaporation = -std::expm1(-rates.evaporation);
+    if (rates.diffusion > 0) {
+      updateSpectral(field, exact);
+      if (written) {
+        std::fill(written->begin(), written->end(), 1);
+      }
+      return;
+    }
+    if (exact.evaporate) {
+      if (written) {
+        for (std::size_t t = 0; t < field.active.size(); ++t) {
+          (*written)[t] |= field.active[t];
+        }
+      }
+      layers.push_back(Layer{&field, exact, NO_NEXT});
+    }
+    return;
+  }
+  if (rates.diffusion <= 0) {
+    if (rates.evaporate) {
+      if (written) {
+        for (std::size_t t = 0; t < field.active.size(); ++t) {
+          (*written)[t] |= field.active[t];
+        }
+      }
+      layers.push_back(Layer{&field, rates, NO_NEXT});
+    }
+    return;
+  }
+  if (width < 3 || height < 3) {
+    withTopology(xTorus, yTorus, [&](auto topology) {
+      updateSmallGrid<decltype(topology)>(field, rates);
+    });
+    if (written) {
+      std::fill(written->begin(), written->end(), 1);
+    }
+    return;
+  }
+
+  // the next fields are reused by the fields queued at the same rank
+  std::size_t diffusing = 0;
+  for (const Layer &layer : layers) {
+    diffusing += layer.next != NO_NEXT;
+  }
+  if (nextFields.size() <= diffusing) {
+    nextFields.resize(diffusing + 1);
+    updateTiles.resize(diffusing + 1);
+  }
+  Field &nextField = nextFields[diffusing];
+  // a field mapped from a file is swapped with a next field mapped from a
+  // file too, while the backing directory is set (see GridMemory)
+  const bool remap = field.values.storage().isFileBacked() &&
+                     !nextField.values.storage().isFileBacked() &&
+                     !GridMemory::getBackingDirectory().empty();
+  if (nextField.values.size() != field.values.size() || remap) {
+    nextField = Field();
+    nextField.assign(width, height, 0.0);
+  }
+  std::vector<unsigned char> &update = updateTiles[diffusing];
+  withTopology(xTorus, yTorus, [&](auto topology) {
+    dilate<decltype(topology)>(field.active, update);
+  });
+  if (written) {
+    for (std::size_t t = 0; t < update.size(); ++t) {
+      (*written)[t] |= update[t];
+    }
+  }
+  layers.push_back(Layer{&field, rates, diffusing});
+}
+
+template <typename Value> void BasicFieldDiffusion<Value>::run() {
+  if (layers.empty()) {
+    return;
+  }
+  // One sweep over the tile rows updates every field, the bands of tile
+  // rows being processed in parallel when the engine lends its pool. The
+  // stencil is specialized on the topology of the grid, chosen once here.
+  withTopology(xTorus, yTorus, [&](auto topology) {
+    using T = decltype(topology);
+    RowBands::forEach(tileRows, TILE * width, [&](int begin, int end) {
+      // shares of the rows y - 1, y and y + 1
+      thread_local AlignedVector<Value> shares;
+      shares.resize(3 * static_cast<std::size_t>(width));
+      for (int ty = begin; ty < end; ++ty) {
+        if (ty + 1 < end) {
+          for (const Layer &layer : layers) {
+            layer.field->prefetchTileRow(ty + 1);
+            if (layer.next != NO_NEXT) {
+              nextFields[layer.next].prefetchTileRow(ty + 1);
+            }
+          }
+        }
+        for (const Layer &layer : layers) {
+          if (layer.next != NO_NEXT) {
+            diffuseTileRow<T>(layer, ty, shares.data());
+          } else {
+            evaporateTileRow(layer, ty);
+          }
+        }
+      }
+    });
+  });
+  for (const Layer &layer : layers) {
+    if (layer.next != NO_NEXT) {
+      layer.field->values.swap(nextFields[layer.next].values);
+      layer.field->active.swap(nextFields[layer.next].active);
+      nextFields[layer.next].releaseQuiescent();
+    }
+    layer.field->releaseQuiescent();
+  }
+  layers.clear();
+}
+
+template <typename Value>
+template <typename Topology>
+void BasicFieldDiffusion<Value>::dilate(
+    const std::vector<unsigned char> &active,
+    std::vector<unsigned char> &update) const {
+  update.assign(active.size(), 0);
+  for (int ty = 0; ty < tileRows; ++ty) {
+    for (int tx = 0; tx < tileColumns; ++tx) {
+      if (!active[static_cast<std::size_t>(ty) * tileColumns + tx]) {
+        continue;
+      }
+      for (int dy = -1; dy <= 1; ++dy) {
+        const int ny = Topology::neighbourY(ty + dy, tileRows);
+        if (ny < 0) {
+          continue;
+        }
+        for (int dx = -1; dx <= 1; ++dx) {
+          const int nx = Topology::neighbourX(tx + dx, tileColumns);
+          if (nx >= 0) {
+            update[static_cast<std::size_t>(ny) * tileColumns + nx] = 1;
+          }
+        }
+      }
+    }
+  }
+}
+
+// Computes the tile row ty of the next field of a diffusing field. Only the
+// field is read and only this tile row of the next field written, so that
+// the tile rows can be computed concurrently: the shares of the rows just
+// above and below a run of tiles are computed again by each tile row rather
+// than exchanged.
+template <typename Value>
+template <typename Topology>
+void BasicFieldDiffusion<Value>::diffuseTileRow(const Layer &layer, int ty,
+                                                Value *shares) {
+  const int w = width;
+  const int h = height;
+  const Value *values = layer.field->values.data();
+  Field &nextField = nextFields[layer.next];
+  Value *next = nextField.values.data();
+  unsigned char *nextActive = nextField.active.data();
+  const unsigned char *update = updateTiles[layer.next].data();
+  const Coefficients<Value> r(layer.rates);
+  const int y_begin = ty * TILE;
+  const int y_end = tile_end(y_begin, h);
+  const std::size_t first_tile = static_cast<std::size_t>(ty) * tileColumns;
+
+  // Computes the shares of the cells of row y around the columns [x0, x1).
+  auto share = [&](int y, Value *into, int x0, int x1) {
+    const int begin = std::max(x0 - 1, 0);
+    const int end = std::min(x1 + 1, w);
+    y = Topology::neighbourY(y, h);
+    if (y < 0) {
+      // Nothing comes from beyond the borders.
+      std::fill(into + begin, into + end, Value(0));
+      return;
+    }
+    const Value *row = values + static_cast<std::size_t>(y) * w;
+    share_row<Topology>(row, into, w, y, h, r.diffusion, begin, end);
+    if constexpr (Topology::X_WRAPS) {
+      if (x0 == 0 && end < w) {
+        share_row<Topology>(row, into, w, y, h, r.diffusion, w - 1, w);
+      }
+      if (x1 == w && begin > 0) {
+        share_row<Topology>(row, into, w, y, h, r.diffusion, 0, 1);
+      }
+    }
+  };
+  // the shares of row y + d lie in the slot (y - y_begin + 1 + d) % 3
+  auto slot = [&](int k) {
+    return shares + (k % 3) * static_cast<std::size_t>(w);
+  };
+
+  for (int tx = 0; tx < tileColumns;) {
+    if (!update[first_tile + tx]) {
+      // Nothing flows into the tile: it is 0 in the next field.
+      if (nextActive[first_tile + tx]) {
+        const int x0 = tx * TILE;
+        for (int y = y_begin; y < y_end; ++y) {
+          Value *cells = next + static_cast<std::size_t>(y) * w + x0;
+          std::fill(cells, cells + (tile_end(x0, w) - x0), Value(0));
+        }
+        nextActive[first_tile + tx] = 0;
+      }
+      ++tx;
+      continue;
+    }
+
+    // The run of consecutive tiles to compute, sharing their halo rows.
+    int run_end = tx + 1;
+    while (run_end < tileColumns && update[first_tile + run_end]) {
+      ++run_end;
+    }
+    const int x0 = tx * TILE;
+    const int x1 = std::min(w, run_end * TILE);
+    std::fill(nextActive + first_tile + tx, nextActive + first_tile + run_end,
+              0);
+
+    share(y_begin - 1, slot(0), x0, x1);
+    share(y_begin, slot(1), x0, x1);
+    for (int y = y_begin; y < y_end; ++y) {
+      const int k = y - y_begin;
+      share(y + 1, slot(k + 2), x0, x1);
+      const Value *up = slot(k);
+      const Value *mid = slot(k + 1);
+      const Value *down = slot(k + 2);
+      const Value *row = values + static_cast<std::size_t>(y) * w;
+      Value *out = next + static_cast<std::size_t>(y) * w;
+
+      // Vectorized interior, then the two edge cells whose neighbours wrap
+      // around or lie outside the grid.
+      update_row(row, up, mid, down, out, std::max(x0, 1),
+                 std::min(x1, w - 1), r);
+      for (int x : {0, w - 1}) {
+        if (x < x0 || x >= x1) {
+          continue;
+        }
+        Value received = up[x] + down[x];
+        for (int nx : {Topology::neighbourX(x - 1, w),
+                       Topology::neighbourX(x + 1, w)}) {
+          if (nx >= 0) {
+            received += up[nx] + mid[nx] + down[nx];
+          }
+        }
+        const Value v = row[x];
+        out[x] =
+            evaporated(v - std::max(v, Value(0)) * r.diffusion + received, r);
+      }
+
+      for (int c = tx; c < run_end; ++c) {
+        unsigned char &active = nextActive[first_tile + c];
+        if (!active) {
+          const int first = c * TILE;
+          active = any_non_zero(out + first, tile_end(first, w) - first);
+        }
+      }
+    }
+    tx = run_end;
+  }
+}
+
+// Evaporates the active tiles of the tile row ty of a field that does not
+// diffuse, and retires the ones left with zeros only.
+template <typename Value>
+void BasicFieldDiffusion<Value>::evaporateTileRow(const Layer &layer,
+                                                  int ty) const {
+  const Coefficients<Value> r(layer.rates);
+  Value *values = layer.field->values.data();
+  const int y_begin = ty * TILE;
+  const int y_end = tile_end(y_begin, height);
+  for (int tx = 0; tx < tileColumns; ++tx) {
+    unsigned char &active =
+        layer.field->active[static_cast<std::size_t>(ty) * tileColumns + tx];
+    if (!active) {
+      continue;
+    }
+    const int x0 = tx * TILE;
+    const int count = tile_end(x0, width) - x0;
+    bool non_zero = false;
+    for (int y = y_begin; y < y_end; ++y) {
+      Value *cells = values + static_cast<std::size_t>(y) * width + x0;
+      evaporate(cells, count, r);
+      non_zero = non_zero || any_non_zero(cells, count);
+    }
+    active = non_zero;
+  }
+}
+
+template <typename Value>
+template <typename Topology>
+void BasicFieldDiffusion<Value>::updateSmallGrid(Field &field,
+                                                 const Rates &rates) const {
+  const Coefficients<Value> r(rates);
+  typename Field::Values next = field.values;
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      const Value value = field.values(x, y);
+      if (value <= 0)
+        continue;
+
+      // Neighbours (8-connected), repeated when a small toroidal grid wraps
+      // onto the same cell.
+      int neighbours[8][2];
+      int count = 0;
+      for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+          if (dx == 0 && dy == 0)
+            continue;
+          const int nx = Topology::neighbourX(x + dx, width);
+          const int ny = Topology::neighbourY(y + dy, height);
+          if (nx < 0 || ny < 0)
+            continue;
+          neighbours[count][0] = nx;
+          neighbours[count][1] = ny;
+          ++count;
+        }
+      }
+      if (count == 0)
+        continue;
+      const Value amount = r.diffusion * value;
+      for (int i = 0; i < count; ++i) {
+        next(neighbours[i][0], neighbours[i][1]) += amount / count;
+      }
+      next(x, y) -= amount;
+    }
+  }
+  if (r.evaporate) {
+    evaporate(next.data(), next.size(), r);
+  }
+  field.values.swap(next);
+  std::fill(field.active.begin(), field.active.end(), 1);
+}
+
+template <typename Value>
+void BasicFieldDiffusion<Value>::updateSpectral(Field &field,
+                                                const Rates &rates) {
+  if (std::none_of(field.active.begin(), field.active.end(),
+                   [](unsigned char active) { return active != 0; })) {
+    return;
+  }
+  if (!spectralPlan) {
+    spectralPlan = std::make_shared<const SpectralPlan>(width, height);
+  }
+  const SpectralPlan &plan = *spectralPlan;
+  const std::size_t w = static_cast<std::size_t>(width);
+  thread_local std::vector<Complex> spectrum;
+  spectrum.resize(w * height);
+  Value *values = field.values.data();
+  Value largest = 0;
+  bool positive = true;
+  for (std::size_t cell = 0; cell < spectrum.size(); ++cell) {
+    spectrum[cell] = values[cell];
+    largest = std::max(largest, std::abs(values[cell]));
+    positive = positive && values[cell] >= 0;
+  }
+
+  // The rows, then the columns, each band of rows or of columns on a thread.
+  auto transform = [&](bool inverse) {
+    RowBands::forEach(height, width, [&](int begin, int end) {
+      thread_local std::vector<Complex> scratch;
+      for (int y = begin; y < end; ++y) {
+        plan.rows.transform(spectrum.data() + y * w, inverse, scratch);
+      }
+    });
+    RowBands::forEach(width, height, [&](int begin, int end) {
+      thread_local std::vector<Complex> scratch;
+      thread_local std::vector<Complex> column;
+      column.resize(height);
+      for (int x = begin; x < end; ++x) {
+        for (int y = 0; y < height; ++y) {
+          column[y] = spectrum[y * w + x];
+        }
+        plan.columns.transform(column.data(), inverse, scratch);
+        for (int y = 0; y < height; ++y) {
+          spectrum[y * w + x] = column[y];
+        }
+      }
+    });
+  };
+  transform(false);
+  // A patch gives diffusion / 8 of its value to each neighbour per unit of
+  // time: the frequency (kx, ky) decays as exp(diffusion (s - 9) / 8), s
+  // being the eigenvalue of the stencil summing the patch and its
+  // neighbours. The factor 1 / N of the inverse transform is applied here.
+  const double scale = 1.0 / static_cast<double>(spectrum.size());
+  for (int ky = 0; ky < height; ++ky) {
+    for (int kx = 0; kx < width; ++kx) {
+      const double symbol = plan.symbolX[kx] * plan.symbolY[ky];
+      spectrum[ky * w + kx] *=
+          scale * std::exp(rates.diffusion * (symbol - 9) / 8);
+    }
+  }
+  transform(true);
+
+  // The values below the round-off of the transforms are zeroed, so that
+  // its noise does not spread over the grid, and the field stays positive.
+  const Coefficients<Value> r(rates);
+  const double noise = 1e-12 * static_cast<double>(largest);
+  for (std::size_t cell = 0; cell < spectrum.size(); ++cell) {
+    double value = spectrum[cell].real();
+    if (std::abs(value) <= noise || (positive && value < 0)) {
+      value = 0;
+    }
+    values[cell] = evaporated(static_cast<Value>(value), r);
+  }
+  for (int ty = 0; ty < tileRows; ++ty) {
+    const int y_begin = ty * TILE;
+    const int y_end = tile_end(y_begin, height);
+    for (int tx = 0; tx < tileColumns; ++tx) {
+      const int x0 = tx * TILE;
+      const int count = tile_end(x0, width) - x0;
+      bool non_zero = false;
+      for (int y = y_begin; y < y_end && !non_zero; ++y) {
+        non_zero = any_non_zero(values + y * w + x0, count);
+      }
+      field.active[static_cast<std::size_t>(ty) * tileColumns + tx] =
+          non_zero;
+    }
+  }
+  field.releaseQuiescent();
+}
+
+template class BasicFieldDiffusion<float>;
+template class BasicFieldDiffusion<double>;
+
+} // namespace tools
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -0,0 +1,219 @@
+#include "kernel/tools/FrameEncoder.h"
+#include "kernel/tools/MathUtil.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace tools {
+
+namespace {
+
+// Quantizes value / scale, clamped to [0, 1], to 0 to levels (NaN going
+// to 0).
+std::uint32_t quantize(double value, double scale, std::uint32_t levels) {
+  const double ratio = value / scale;
+  if (!(ratio > 0)) {
+    return 0;
+  }
+  return ratio >= 1 ? levels
+                    : static_cast<std::uint32_t>(std::lround(ratio * levels));
+}
+
+} // namespace
+
+FrameEncoder::FrameEncoder(double width, double height, int tileSize)
+    : width(width), height(height), tileSize(tileSize) {
+  if (!(width > 0) || !(height > 0) || tileSize <= 0 || tileSize > 255) {
+    throw std::invalid_argument(
+        "The dimensions must be positive and the tiles at most 255 wide.");
+  }
+}
+
+std::uint8_t FrameEncoder::colorIndex(const std::string &color) {
+  const auto found = paletteIndices.find(color);
+  if (found != paletteIndices.end()) {
+    return found->second;
+  }
+  if (palette.size() == 256 || color.size() > 255) {
+    throw std::length_error(
+        "The palette holds 256 colors of at most 255 characters.");
+  }
+  const auto index = static_cast<std::uint8_t>(palette.size());
+  palette.push_back(color);
+  paletteIndices.emplace(color, index);
+  return index;
+}
+
+std::size_t FrameEncoder::addPheromone(const std::string &identifier,
+                                       int columns, int rows,
+                                       double maxValue) {
+  if (columns < 1 || columns > 65535 || rows < 1 || rows > 65535 ||
+      !(maxValue > 0) || identifier.size() > 255) {
+    throw std::invalid_argument(
+        "Invalid pheromone grid for the frames: " + identifier);
+  }
+  pheromones.push_back(
+      {identifier, columns, rows, maxValue,
+       std::vector<std::uint8_t>(static_cast<std::size_t>(columns) * rows)});
+  keyframe = true;
+  return pheromones.size() - 1;
+}
+
+template <typename T> void FrameEncoder::put(T value) {
+  static_assert(std::is_unsigned<T>::value, "unsigned values only");
+  for (std::size_t i = 0; i < sizeof(T); ++i) {
+    frame.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+  }
+}
+
+void FrameEncoder::putBytes(const void *data, std::size_t size) {
+  const auto *bytes = static_cast<const std::uint8_t *>(data);
+  frame.insert(frame.end(), bytes, bytes + size);
+}
+
+void FrameEncoder::align() { frame.resize((frame.size() + 3) & ~3u, 0); }
+
+const std::vector<std::uint8_t> &
+FrameEncoder::encode(std::uint64_t step, const double *x, const double *y,
+                     const double *heading, const std::uint8_t *colors,
+                     std::size_t count, const double *const *pheromoneValues) {
+  if (count > std::numeric_limits<std::uint32_t>::max()) {
+    throw std::overflow_error("Too many turtles for a frame.");
+  }
+  const bool full = keyframe;
+  const bool withPalette = full || palette.size() != sentPaletteSize;
+  std::uint8_t flags = 0;
+  flags |= withPalette ? PALETTE : 0;
+  flags |= full ? KEYFRAME : 0;
+
+  frame.clear();
+  frame.reserve(HEADER_SIZE + 6 * count + 64);
+  put(MAGIC);
+  put(VERSION);
+  put(flags);
+  put(static_cast<std::uint16_t>(pheromones.size()));
+  put(static_cast<std::uint32_t>(step));
+  put(static_cast<std::uint32_t>(count));
+  std::uint32_t bits;
+  const float dimensions[] = {static_cast<float>(width),
+                              static_cast<float>(height)};
+  for (const float dimension : dimensions) {
+    std::memcpy(&bits, &dimension, sizeof(bits));
+    put(bits);
+  }
+
+  if (withPalette) {
+    put(static_cast<std::uint16_t>(palette.size()));
+    for (const auto &color : palette) {
+      put(static_cast<std::uint8_t>(color.size()));
+      putBytes(color.data(), color.size());
+    }
+    align();
+    sentPaletteSize = palette.size();
+  }
+
+  for (std::size_t i = 0; i < count; ++i) {
+    put(static_cast<std::uint16_t>(quantize(x[i], width, 65535)));
+  }
+  for (std::size_t i = 0; i < count; ++i) {
+    put(static_cast<std::uint16_t>(quantize(y[i], height, 65535)));
+  }
+  for (std::size_t i = 0; i < count; ++i) {
+    const double turns = heading[i] / MathUtil::TWO_PI;
+    const double fraction = turns - std::floor(turns);
+    // a heading just below a turn rounds to 256, that is 0
+    put(static_cast<std::uint8_t>(
+        std::isfinite(fraction) ? std::lround(fraction * 256) & 255 : 0));
+  }
+  putBytes(colors, count);
+  align();
+
+  for (std::size_t k = 0; k < pheromones.size(); ++k) {
+    Grid &grid = pheromones[k];
+    if (full) {
+      put(static_cast<std::uint8_t>(grid.identifier.size()));
+      putBytes(grid.identifier.data(), grid.identifier.size());
+      align();
+      put(static_cast<std::uint16_t>(grid.columns));
+      put(static_cast<std::uint16_t>(grid.rows));
+      const auto maxValue = static_cast<float>(grid.maxValue);
+      std::memcpy(&bits, &maxValue, sizeof(bits));
+      put(bits);
+      put(static_cast<std::uint16_t>(tileSize));
+      put(std::uint16_t(0));
+    }
+    encodeGrid(grid, pheromoneValues[k], full);
+  }
+  keyframe = false;
+  return frame;
+}
+
+void FrameEncoder::encodeGrid(Grid &grid, const double *values, bool full) {
+  const std::size_t cells = grid.sent.size();
+  quantized.resize(cells);
+  for (std::size_t cell = 0; cell < cells; ++cell) {
+    quantized[cell] =
+        static_cast<std::uint8_t>(quantize(values[cell], grid.maxValue, 255));
+  }
+  const std::size_t countAt = frame.size();
+  put(std::uint32_t(0));
+  std::uint32_t tiles = 0;
+  const int tileColumns = (grid.columns + tileSize - 1) / tileSize;
+  const int tileRows = (grid.rows + tileSize - 1) / tileSize;
+  for (int tileRow = 0; tileRow < tileRows; ++tileRow) {
+    for (int tileColumn = 0; tileColumn < tileColumns; ++tileColumn) {
+      const int x0 = tileColumn * tileSize;
+      const int y0 = tileRow * tileSize;
+      const int w = std::min(tileSize, grid.columns - x0);
+      const int h = std::min(tileSize, grid.rows - y0);
+      // a keyframe sends the tiles holding a value, the other frames the
+      // tiles that changed
+      bool send = false;
+      for (int j = 0; j < h && !send; ++j) {
+        const std::size_t row =
+            static_cast<std::size_t>(y0 + j) * grid.columns + x0;
+        const auto *now = quantized.data() + row;
+        if (full) {
+          send = std::any_of(now, now + w, [](std::uint8_t v) { return v; });
+        } else {
+          send = !std::equal(now, now + w, grid.sent.data() + row);
+        }
+      }
+      if (!send) {
+        continue;
+      }
+      put(static_cast<std::uint32_t>(tileRow * tileColumns + tileColumn));
+      for (int j = 0; j < tileSize; ++j) {
+        if (j < h) {
+          const std::size_t row =
+              static_cast<std::size_t>(y0 + j) * grid.columns + x0;
+          putBytes(quantized.data() + row, w);
+        }
+        frame.resize(frame.size() + (j < h ? tileSize - w : tileSize), 0);
+      }
+      align();
+      ++tiles;
+    }
+  }
+  for (std::size_t i = 0; i < 4; ++i) {
+    frame[countAt + i] = static_cast<std::uint8_t>(tiles >> (8 * i));
+  }
+  grid.sent.swap(quantized);
+}
+
+} // namespace tools
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
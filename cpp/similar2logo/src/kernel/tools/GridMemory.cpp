@@ -0,0 +1,261 @@
+#include "kernel/tools/GridMemory.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cstdlib>
+#include <sys/mman.h>
+#include <unistd.h>
+#define SIMILAR2LOGO_GRID_MMAP 1
+#endif
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace tools {
+
+namespace {
+
+constexpr std::size_t HEAP_ALIGNMENT = 64;
+
+std::atomic<bool> hugePages{true};
+
+std::mutex backingMutex;
+std::string backingDirectory;
+
+std::size_t roundUp(std::size_t bytes, std::size_t unit) {
+  return (bytes + unit - 1) / unit * unit;
+}
+
+} // namespace
+
+std::size_t GridMemory::pageBytes() {
+#ifdef SIMILAR2LOGO_GRID_MMAP
+  static const std::size_t page =
+      static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+  return page;
+#else
+  return 4096;
+#endif
+}
+
+void GridMemory::setHugePages(bool enabled) { hugePages = enabled; }
+
+bool GridMemory::isHugePages() { return hugePages; }
+
+void GridMemory::setBackingDirectory(const std::string &directory) {
+  std::lock_guard<std::mutex> lock(backingMutex);
+  backingDirectory = directory;
+}
+
+std::string GridMemory::getBackingDirectory() {
+  std::lock_guard<std::mutex> lock(backingMutex);
+  return backingDirectory;
+}
+
+GridMemory::Block GridMemory::allocate(std::size_t bytes) {
+  Block block;
+  block.bytes = bytes;
+#ifdef SIMILAR2LOGO_GRID_MMAP
+  const std::string directory =
+      bytes >= LAZY_BYTES ? getBackingDirectory() : std::string();
+  if (!directory.empty()) {
+    // A sparse file, removed at once: its blocks are allocated by the
+    // writes and freed with the mapping
+    const std::size_t length = roundUp(bytes, pageBytes());
+    std::string path = directory + "/similar2logo-grid-XXXXXX";
+    const int file = mkstemp(path.data());
+    if (file < 0) {
+      throw std::bad_alloc();
+    }
+    unlink(path.c_str());
+    void *mapping = MAP_FAILED;
+    if (ftruncate(file, static_cast<off_t>(length)) == 0) {
+      mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     file, 0);
+    }
+    close(file);
+    if (mapping == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    block.data = mapping;
+    block.mapped = true;
+    block.fileBacked = true;
+    return block;
+  }
+  if (bytes >= LAZY_BYTES) {
+    const std::size_t length = roundUp(bytes, pageBytes());
+    const bool huge = hugePages && length >= HUGE_PAGE_BYTES;
+    // A huge page more is reserved, to align the buffer on one
+    const std::size_t reserved = huge ? length + HUGE_PAGE_BYTES : length;
+    void *mapping = mmap(nullptr, reserved, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    auto *first = static_cast<unsigned char *>(mapping);
+    if (huge) {
+      const auto address = reinterpret_cast<std::uintptr_t>(first);
+      auto *aligned = first + (roundUp(address, HUGE_PAGE_BYTES) - address);
+      if (aligned > first) {
+        munmap(first, aligned - first);
+      }
+      const std::size_t after = reserved - (aligned - first) - length;
+      if (after > 0) {
+        munmap(aligned + length, after);
+      }
+      first = aligned;
+#ifdef MADV_HUGEPAGE
+      madvise(first, length, MADV_HUGEPAGE);
+#endif
+    }
+    block.data = first;
+    block.mapped = true;
+    return block;
+  }
+#endif
+  block.data = ::operator new(bytes, std::align_val_t(HEAP_ALIGNMENT));
+  return block;
+}
+
+void GridMemory::deallocate(const Block &block) noexcept {
+  if (block.data == nullptr) {
+    return;
+  }
+#ifdef SIMILAR2LOGO_GRID_MMAP
+  if (block.mapped) {
+    munmap(block.data, roundUp(block.bytes, pageBytes()));
+    return;
+  }
+#endif
+  ::operator delete(block.data, std::align_val_t(HEAP_ALIGNMENT));
+}
+
+void GridMemory::release(const Block &block, std::size_t offset,
+                         std::size_t bytes) noexcept {
+#ifdef SIMILAR2LOGO_GRID_MMAP
+  if (block.fileBacked) {
+    // The blocks of the file are freed, and read zeros again; where the
+    // file system cannot free them, the range is cleared in place
+    const std::size_t page = pageBytes();
+    const std::size_t begin = roundUp(offset, page);
+    const std::size_t end = std::min(offset + bytes, block.bytes) / page * page;
+    if (begin >= end) {
+      return;
+    }
+    auto *first = static_cast<unsigned char *>(block.data) + begin;
+#ifdef MADV_REMOVE
+    if (madvise(first, end - begin, MADV_REMOVE) == 0) {
+      return;
+    }
+#endif
+    std::memset(first, 0, end - begin);
+    return;
+  }
+#endif
+#if defined(SIMILAR2LOGO_GRID_MMAP) && defined(__linux__)
+  // Only Linux tells that the pages given back read zeros again
+  if (!block.mapped) {
+    return;
+  }
+  const std::size_t page = pageBytes();
+  const std::size_t begin = roundUp(offset, page);
+  const std::size_t end = std::min(offset + bytes, block.bytes) / page * page;
+  if (begin < end) {
+    madvise(static_cast<unsigned char *>(block.data) + begin, end - begin,
+            MADV_DONTNEED);
+  }
+#else
+  (void)block;
+  (void)offset;
+  (void)bytes;
+#endif
+}
+
+void GridMemory::prefetch(const Block &block, std::size_t offset,
+                          std::size_t bytes) noexcept {
+#ifdef SIMILAR2LOGO_GRID_MMAP
+  if (!block.mapped) {
+    return;
+  }
+  // The range is widened to whole pages
+  const std::size_t page = pageBytes();
+  const std::size_t begin = offset / page * page;
+  const std::size_t end = std::min(roundUp(offset + bytes, page),
+                                   roundUp(block.bytes, page));
+  if (begin < end) {
+    madvise(static_cast<unsigned char *>(block.data) + begin, end - begin,
+            MADV_WILLNEED);
+  }
+#else
+  (void)block;
+  (void)offset;
+  (void)bytes;
+#endif
+}
+
+void GridMemory::evict(const Block &block, std::size_t offset,
+                       std::size_t bytes) noexcept {
+#ifdef SIMILAR2LOGO_GRID_MMAP
+  if (!block.fileBacked) {
+    return;
+  }
+  // Only the pages lying wholly in the range, shared with no other range
+  const std::size_t page = pageBytes();
+  const std::size_t begin = roundUp(offset, page);
+  const std::size_t end = std::min(offset + bytes, block.bytes) / page * page;
+  if (begin >= end) {
+    return;
+  }
+  auto *first = static_cast<unsigned char *>(block.data) + begin;
+#ifdef MADV_PAGEOUT
+  if (madvise(first, end - begin, MADV_PAGEOUT) == 0) {
+    return;
+  }
+#endif
+  // The pages of a shared mapping keep their content in the file
+  msync(first, end - begin, MS_ASYNC);
+  madvise(first, end - begin, MADV_DONTNEED);
+#else
+  (void)block;
+  (void)offset;
+  (void)bytes;
+#endif
+}
+
+std::size_t GridMemory::residentBytes(const Block &block) {
+#if defined(SIMILAR2LOGO_GRID_MMAP) && defined(__linux__)
+  if (!block.mapped) {
+    return block.bytes;
+  }
+  const std::size_t page = pageBytes();
+  const std::size_t pages = roundUp(block.bytes, page) / page;
+  std::vector<unsigned char> resident(pages);
+  if (mincore(block.data, pages * page, resident.data()) != 0) {
+    return 0;
+  }
+  std::size_t count = 0;
+  for (unsigned char flags : resident) {
+    count += flags & 1;
+  }
+  return count * page;
+#else
+  return block.mapped ? 0 : block.bytes;
+#endif
+}
+
+} // namespace tools
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -0,0 +1,332 @@
+#include "kernel/tools/HeatmapTileRenderer.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace tools {
+
+namespace {
+
+// The colors of the default colormap, evenly spaced
+constexpr std::uint8_t STOPS[][3] = {
+    {0, 0, 4}, {87, 16, 110}, {188, 55, 84}, {249, 142, 9}, {252, 255, 164}};
+constexpr int STOP_COUNT = sizeof(STOPS) / sizeof(STOPS[0]);
+
+void appendJsonString(std::ostringstream &out, const std::string &text) {
+  out << '"';
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      out << ' ';
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+} // namespace
+
+HeatmapTileRenderer::HeatmapTileRenderer(int tileSize) : tileSize(tileSize) {
+  if (tileSize < 2 || tileSize % 2 != 0) {
+    throw std::invalid_argument("The side of the tiles must be even.");
+  }
+}
+
+std::vector<std::uint8_t> HeatmapTileRenderer::defaultColormap() {
+  std::vector<std::uint8_t> colors(256 * 4, 0);
+  for (int i = 1; i < 256; ++i) {
+    const double position = (i - 1) / 254.0 * (STOP_COUNT - 1);
+    const int stop = std::min(static_cast<int>(position), STOP_COUNT - 2);
+    const double t = position - stop;
+    for (int c = 0; c < 3; ++c) {
+      colors[i * 4 + c] = static_cast<std::uint8_t>(std::lround(
+          STOPS[stop][c] + t * (STOPS[stop + 1][c] - STOPS[stop][c])));
+    }
+    colors[i * 4 + 3] = static_cast<std::uint8_t>(64 + (i * 191) / 255);
+  }
+  return colors;
+}
+
+void HeatmapTileRenderer::addLayer(const std::string &name, int columns,
+                                   int rows, double maxValue,
+                                   std::vector<std::uint8_t> colormap) {
+  if (columns <= 0 || rows <= 0 || !(maxValue > 0)) {
+    throw std::invalid_argument(
+        "The dimensions and the maximal value of a layer must be positive.");
+  }
+  Layer layer{name, maxValue,
+              similar::extendedkernel::libs::web::view::PngEncoder(
+                  std::move(colormap)),
+              {},
+              {}};
+  // The zooms, from the finest one, until a tile covers the layer
+  int levelColumns = columns;
+  int levelRows = rows;
+  while (true) {
+    Level level;
+    level.columns = levelColumns;
+    level.rows = levelRows;
+    level.tileColumns = (levelColumns + tileSize - 1) / tileSize;
+    level.tileRows = (levelRows + tileSize - 1) / tileSize;
+    level.cells.assign(static_cast<std::size_t>(levelColumns) * levelRows, 0);
+    level.tiles.resize(static_cast<std::size_t>(level.tileColumns) *
+                       level.tileRows);
+    level.changed.assign(level.tiles.size(), 0);
+    layer.levels.push_back(std::move(level));
+    if (levelColumns <= tileSize && levelRows <= tileSize) {
+      break;
+    }
+    levelColumns = (levelColumns + 1) / 2;
+    levelRows = (levelRows + 1) / 2;
+  }
+  std::reverse(layer.levels.begin(), layer.levels.end());
+
+  std::lock_guard<std::mutex> lock(mutex);
+  for (const Layer &other : layers) {
+    if (other.name == name) {
+      throw std::invalid_argument("The layer " + name + " already exists.");
+    }
+  }
+  layers.push_back(std::move(layer));
+}
+
+HeatmapTileRenderer::Layer &
+HeatmapTileRenderer::findLayer(const std::string &name) {
+  for (Layer &layer : layers) {
+    if (layer.name == name) {
+      return layer;
+    }
+  }
+  throw std::invalid_argument("No layer " + name);
+}
+
+const HeatmapTileRenderer::Layer &
+HeatmapTileRenderer::findLayer(const std::string &name) const {
+  return const_cast<HeatmapTileRenderer *>(this)->findLayer(name);
+}
+
+bool HeatmapTileRenderer::hasLayer(const std::string &name) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return std::any_of(layers.begin(), layers.end(),
+                     [&name](const Layer &layer) { return layer.name == name; });
+}
+
+std::vector<std::string> HeatmapTileRenderer::getLayerNames() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<std::string> names;
+  for (const Layer &layer : layers) {
+    names.push_back(layer.name);
+  }
+  return names;
+}
+
+int HeatmapTileRenderer::getMaxZoom(const std::string &name) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return static_cast<int>(findLayer(name).levels.size()) - 1;
+}
+
+std::size_t HeatmapTileRenderer::getEncodedTileCount() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return encodedTiles;
+}
+
+std::uint8_t HeatmapTileRenderer::colorIndex(const Layer &layer,
+                                             double value) const {
+  const double ratio = value / layer.maxValue;
+  if (!(ratio > 0)) {
+    return 0;
+  }
+  const std::size_t last = layer.encoder.getPaletteSize() - 1;
+  return static_cast<std::uint8_t>(
+      ratio >= 1 ? last : std::lround(ratio * static_cast<double>(last)));
+}
+
+void HeatmapTileRenderer::setCell(Level &level, int x, int y,
+                                  std::uint8_t index) {
+  std::uint8_t &cell =
+      level.cells[static_cast<std::size_t>(y) * level.columns + x];
+  if (cell != index) {
+    cell = index;
+    level.changed[static_cast<std::size_t>(y / tileSize) * level.tileColumns +
+                  x / tileSize] = 1;
+  }
+}
+
+std::size_t HeatmapTileRenderer::update(const std::string &name,
+                                        const TiledField &field) {
+  std::lock_guard<std::mutex> lock(mutex);
+  Layer &layer = findLayer(name);
+  Level &finest = layer.levels.back();
+  const int width = field.values.getWidth();
+  const int height = field.values.getHeight();
+  if (width != finest.columns || height != finest.rows) {
+    throw std::invalid_argument("The field of " + name +
+                                " does not have the size of its layer.");
+  }
+  layer.wasActive.resize(field.active.size(), 1);
+  const auto *values = field.values.data();
+  for (int ty = 0; ty < field.tileRows(); ++ty) {
+    for (int tx = 0; tx < field.tileColumns(); ++tx) {
+      const std::size_t tile =
+          static_cast<std::size_t>(ty) * field.tileColumns() + tx;
+      if (!field.active[tile] && !layer.wasActive[tile]) {
+        continue;
+      }
+      const int xEnd = std::min(width, (tx + 1) * TiledField::TILE_SIZE);
+      const int yEnd = std::min(height, (ty + 1) * TiledField::TILE_SIZE);
+      for (int y = ty * TiledField::TILE_SIZE; y < yEnd; ++y) {
+        for (int x = tx * TiledField::TILE_SIZE; x < xEnd; ++x) {
+          setCell(finest, x, y,
+                  colorIndex(layer, values[static_cast<std::size_t>(y) *
+                                               width +
+                                           x]));
+        }
+      }
+    }
+  }
+  layer.wasActive = field.active;
+  return propagate(layer);
+}
+
+std::size_t HeatmapTileRenderer::update(const std::string &name,
+                                        const double *values) {
+  std::lock_guard<std::mutex> lock(mutex);
+  Layer &layer = findLayer(name);
+  Level &finest = layer.levels.back();
+  for (int y = 0; y < finest.rows; ++y) {
+    for (int x = 0; x < finest.columns; ++x) {
+      setCell(finest, x, y,
+              colorIndex(layer, values[static_cast<std::size_t>(y) *
+                                           finest.columns +
+                                       x]));
+    }
+  }
+  // The next update of a field compares all its tiles
+  layer.wasActive.clear();
+  return propagate(layer);
+}
+
+std::size_t HeatmapTileRenderer::propagate(Layer &layer) {
+  const int half = tileSize / 2;
+  for (std::size_t z = layer.levels.size() - 1; z > 0; --z) {
+    const Level &child = layer.levels[z];
+    Level &parent = layer.levels[z - 1];
+    for (int ty = 0; ty < child.tileRows; ++ty) {
+      for (int tx = 0; tx < child.tileColumns; ++tx) {
+        if (!child.changed[static_cast<std::size_t>(ty) * child.tileColumns +
+                           tx]) {
+          continue;
+        }
+        // A tile covers a quarter of a tile of the coarser zoom
+        const int xEnd = std::min(parent.columns, (tx + 1) * half);
+        const int yEnd = std::min(parent.rows, (ty + 1) * half);
+        for (int y = ty * half; y < yEnd; ++y) {
+          for (int x = tx * half; x < xEnd; ++x) {
+            std::uint8_t index = 0;
+            for (int cy = 2 * y; cy < std::min(child.rows, 2 * y + 2); ++cy) {
+              for (int cx = 2 * x; cx < std::min(child.columns, 2 * x + 2);
+                   ++cx) {
+                index = std::max(
+                    index,
+                    child.cells[static_cast<std::size_t>(cy) * child.columns +
+                                cx]);
+              }
+            }
+            setCell(parent, x, y, index);
+          }
+        }
+      }
+    }
+  }
+
+  std::size_t marked = 0;
+  for (Level &level : layer.levels) {
+    marked = 0;
+    for (std::size_t t = 0; t < level.tiles.size(); ++t) {
+      if (level.changed[t]) {
+        level.changed[t] = 0;
+        level.tiles[t].stale = true;
+        ++level.tiles[t].version;
+        ++marked;
+      }
+    }
+  }
+  // the count of the finest zoom, the last one
+  return marked;
+}
+
+std::string HeatmapTileRenderer::describeLayers() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::ostringstream out;
+  out << "{\"tileSize\":" << tileSize << ",\"layers\":[";
+  for (std::size_t i = 0; i < layers.size(); ++i) {
+    const Layer &layer = layers[i];
+    out << (i == 0 ? "" : ",") << "{\"name\":";
+    appendJsonString(out, layer.name);
+    out << ",\"columns\":" << layer.levels.back().columns
+        << ",\"rows\":" << layer.levels.back().rows
+        << ",\"maxZoom\":" << layer.levels.size() - 1
+        << ",\"maxValue\":" << layer.maxValue << "}";
+  }
+  out << "]}";
+  return out.str();
+}
+
+HeatmapTileRenderer::Tile HeatmapTileRenderer::getTile(const std::string &name,
+                                                       int zoom, int x,
+                                                       int y) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto found = std::find_if(layers.begin(), layers.end(),
+                            [&name](const Layer &layer) {
+                              return layer.name == name;
+                            });
+  if (found == layers.end() || zoom < 0 ||
+      zoom >= static_cast<int>(found->levels.size())) {
+    return Tile();
+  }
+  Level &level = found->levels[zoom];
+  if (x < 0 || y < 0 || x >= level.tileColumns || y >= level.tileRows) {
+    return Tile();
+  }
+  TileState &state =
+      level.tiles[static_cast<std::size_t>(y) * level.tileColumns + x];
+  if (state.stale) {
+    // The pixels past the layer show the value 0
+    pixels.assign(static_cast<std::size_t>(tileSize) * tileSize, 0);
+    const int columns = std::min(tileSize, level.columns - x * tileSize);
+    const int rows = std::min(tileSize, level.rows - y * tileSize);
+    for (int row = 0; row < rows; ++row) {
+      const std::uint8_t *cells =
+          level.cells.data() +
+          static_cast<std::size_t>(y * tileSize + row) * level.columns +
+          x * tileSize;
+      std::copy(cells, cells + columns,
+                pixels.begin() + static_cast<std::size_t>(row) * tileSize);
+    }
+    state.data = std::make_shared<const std::string>(
+        found->encoder.encode(tileSize, tileSize, pixels.data()));
+    state.stale = false;
+    ++encodedTiles;
+  }
+  Tile tile;
+  tile.data = state.data;
+  tile.version = state.version;
+  return tile;
+}
+
+} // namespace tools
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
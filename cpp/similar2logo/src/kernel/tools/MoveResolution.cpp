@@ -0,0 +1,139 @@
+#include "kernel/tools/MoveResolution.h"
+#include "../../../../microkernel/include/engine/WorkStealingThreadPool.h"
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace tools {
+
+namespace {
+
+using microkernel::engine::WorkStealingThreadPool;
+
+// The finalizer of SplitMix64, spreading the bits of a counter
+std::uint64_t mix(std::uint64_t value) {
+  value += 0x9e3779b97f4a7c15ULL;
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+  return value ^ (value >> 31);
+}
+
+constexpr std::uint64_t PRIORITY_MASK = 0xffffffff00000000ULL;
+
+} // namespace
+
+void MoveResolver::reserveOwners(std::size_t cellCount) {
+  if (cellCount <= ownerCount) {
+    return;
+  }
+  owners = std::make_unique<std::atomic<std::uint64_t>[]>(cellCount);
+  for (std::size_t cell = 0; cell < cellCount; ++cell) {
+    owners[cell].store(FREE, std::memory_order_relaxed);
+  }
+  ownerCount = cellCount;
+}
+
+void MoveResolver::resolve(std::size_t cellCount,
+                           const std::vector<std::uint32_t> &claims,
+                           const std::vector<std::uint64_t> &priorities,
+                           std::vector<unsigned char> &won) {
+  reserveOwners(cellCount);
+  const std::size_t count = claims.size();
+  won.assign(count, 0);
+  auto keyOf = [&](std::size_t claimant) {
+    return (priorities[claimant] & PRIORITY_MASK) |
+           static_cast<std::uint32_t>(claimant);
+  };
+  // Each pass ends before the next starts, when the pool joins its tasks.
+  WorkStealingThreadPool::parallelForOnCurrent(
+      count, 0, [&](std::size_t begin, std::size_t end, std::size_t) {
+        for (std::size_t i = begin; i < end; ++i) {
+          if (claims[i] == NO_CELL) {
+            continue;
+          }
+          const std::uint64_t key = keyOf(i);
+          std::atomic<std::uint64_t> &owner = owners[claims[i]];
+          std::uint64_t current = owner.load(std::memory_order_relaxed);
+          while (key < current &&
+                 !owner.compare_exchange_weak(current, key,
+                                              std::memory_order_relaxed)) {
+          }
+        }
+      });
+  WorkStealingThreadPool::parallelForOnCurrent(
+      count, 0, [&](std::size_t begin, std::size_t end, std::size_t) {
+        for (std::size_t i = begin; i < end; ++i) {
+          won[i] = claims[i] != NO_CELL &&
+                   owners[claims[i]].load(std::memory_order_relaxed) ==
+                       keyOf(i);
+        }
+      });
+  WorkStealingThreadPool::parallelForOnCurrent(
+      count, 0, [&](std::size_t begin, std::size_t end, std::size_t) {
+        for (std::size_t i = begin; i < end; ++i) {
+          if (claims[i] != NO_CELL) {
+            owners[claims[i]].store(FREE, std::memory_order_relaxed);
+          }
+        }
+      });
+}
+
+std::size_t MoveResolver::relocate(const std::vector<std::uint32_t> &origins,
+                                   EmptyCellIndex &emptyCells,
+                                   std::uint64_t seed,
+                                   std::vector<std::uint32_t> &destinations,
+                                   int maxRounds) {
+  destinations.assign(origins.size(), NO_CELL);
+  pending.resize(origins.size());
+  for (std::size_t agent = 0; agent < origins.size(); ++agent) {
+    pending[agent] = static_cast<std::uint32_t>(agent);
+  }
+  std::size_t moved = 0;
+  for (int round = 0;
+       round < maxRounds && !pending.empty() && !emptyCells.empty();
+       ++round) {
+    const std::size_t count = pending.size();
+    const std::uint64_t roundSeed =
+        mix(seed ^ mix(static_cast<std::uint64_t>(round)));
+    claims.resize(count);
+    priorities.resize(count);
+    // The draws read the empty cells of the start of the round only.
+    WorkStealingThreadPool::parallelForOnCurrent(
+        count, 0, [&](std::size_t begin, std::size_t end, std::size_t) {
+          for (std::size_t k = begin; k < end; ++k) {
+            const std::uint64_t draw = mix(roundSeed ^ pending[k]);
+            claims[k] = emptyCells.at(draw % emptyCells.size());
+            priorities[k] = mix(draw);
+          }
+        });
+    resolve(emptyCells.cellCount(), claims, priorities, won);
+    // The winners move in the order of the agents, the losers claim again.
+    std::size_t kept = 0;
+    for (std::size_t k = 0; k < count; ++k) {
+      const std::uint32_t agent = pending[k];
+      if (!won[k]) {
+        pending[kept++] = agent;
+        continue;
+      }
+      destinations[agent] = claims[k];
+      emptyCells.erase(claims[k]);
+      if (origins[agent] != NO_CELL) {
+        emptyCells.insert(origins[agent]);
+      }
+      ++moved;
+    }
+    pending.resize(kept);
+  }
+  return moved;
+}
+
+} // namespace tools
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
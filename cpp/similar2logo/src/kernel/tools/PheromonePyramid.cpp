@@ -0,0 +1,237 @@
+#include "kernel/tools/PheromonePyramid.h"
+#include <algorithm>
+#include <queue>
+#include <stdexcept>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace tools {
+
+namespace {
+
+// The side of the blocks of a level, in cells of the field
+int blockSide(int level) { return 1 << level; }
+
+int levelSize(int cells, int level) {
+  return (cells + blockSide(level) - 1) >> level;
+}
+
+} // namespace
+
+const Grid<PheromonePyramid::Value> &
+PheromonePyramid::getLevel(int level) const {
+  if (level < 1 || level >= getLevelCount()) {
+    throw std::out_of_range("No level " + std::to_string(level) +
+                            " in the pyramid.");
+  }
+  const Level &found = levels[level - 1];
+  return reduction == Reduction::MEAN ? found.mean : found.maximum;
+}
+
+void PheromonePyramid::reduce(const TiledField &field, int level, int x,
+                              int y) {
+  Level &target = levels[level - 1];
+  const int childLevel = level - 1;
+  const int childColumns = levelSize(width, childLevel);
+  const int childRows = levelSize(height, childLevel);
+  const int childSide = blockSide(childLevel);
+  Value maximum = 0;
+  std::uint32_t argmax = static_cast<std::uint32_t>(
+      field.values.index(x * blockSide(level), y * blockSide(level)));
+  double sum = 0;
+  double area = 0;
+  for (int cy = 2 * y; cy < std::min(childRows, 2 * y + 2); ++cy) {
+    for (int cx = 2 * x; cx < std::min(childColumns, 2 * x + 2); ++cx) {
+      Value value;
+      std::uint32_t cell;
+      double mean;
+      double cells = 1;
+      if (childLevel == 0) {
+        cell = static_cast<std::uint32_t>(field.values.index(cx, cy));
+        value = field.values[cell];
+        mean = value;
+      } else {
+        const Level &child = levels[childLevel - 1];
+        value = child.maximum(cx, cy);
+        cell = child.argmax(cx, cy);
+        mean = reduction == Reduction::MEAN ? double(child.mean(cx, cy)) : 0;
+        cells = double(std::min(childSide, width - cx * childSide)) *
+                std::min(childSide, height - cy * childSide);
+      }
+      if (value > maximum) {
+        maximum = value;
+        argmax = cell;
+      }
+      sum += mean * cells;
+      area += cells;
+    }
+  }
+  target.maximum(x, y) = maximum;
+  target.argmax(x, y) = argmax;
+  if (reduction == Reduction::MEAN) {
+    target.mean(x, y) = static_cast<Value>(sum / area);
+  }
+}
+
+void PheromonePyramid::update(const TiledField &field) {
+  if (field.values.getWidth() != width || field.values.getHeight() != height) {
+    width = field.values.getWidth();
+    height = field.values.getHeight();
+    levels.clear();
+    for (int level = 1; levelSize(width, level - 1) > 1 ||
+                        levelSize(height, level - 1) > 1;
+         ++level) {
+      Level created;
+      created.maximum.assign(levelSize(width, level), levelSize(height, level),
+                             0);
+      created.argmax.assign(levelSize(width, level), levelSize(height, level),
+                            0);
+      if (reduction == Reduction::MEAN) {
+        created.mean.assign(levelSize(width, level), levelSize(height, level),
+                            0);
+      }
+      levels.push_back(std::move(created));
+    }
+    wasActive.clear();
+  }
+  const bool full = wasActive.size() != field.active.size();
+
+  // The blocks within a tile of the field are recomputed with their tile,
+  // the larger ones all the time: there are few of them
+  const int tileSize = TiledField::TILE_SIZE;
+  int level = 1;
+  for (; level < getLevelCount() && blockSide(level) <= tileSize &&
+         tileSize % blockSide(level) == 0;
+       ++level) {
+    const int blocks = tileSize / blockSide(level);
+    const int columns = levelSize(width, level);
+    const int rows = levelSize(height, level);
+    for (int ty = 0; ty < field.tileRows(); ++ty) {
+      for (int tx = 0; tx < field.tileColumns(); ++tx) {
+        const std::size_t tile =
+            static_cast<std::size_t>(ty) * field.tileColumns() + tx;
+        if (!full && !field.active[tile] && !wasActive[tile]) {
+          continue;
+        }
+        for (int y = ty * blocks; y < std::min(rows, (ty + 1) * blocks); ++y) {
+          for (int x = tx * blocks; x < std::min(columns, (tx + 1) * blocks);
+               ++x) {
+            reduce(field, level, x, y);
+          }
+        }
+      }
+    }
+  }
+  for (; level < getLevelCount(); ++level) {
+    for (int y = 0; y < levelSize(height, level); ++y) {
+      for (int x = 0; x < levelSize(width, level); ++x) {
+        reduce(field, level, x, y);
+      }
+    }
+  }
+  wasActive = field.active;
+}
+
+PheromonePyramid::Peak
+PheromonePyramid::strongestWithin(const TiledField &field, double x, double y,
+                                  double radius, bool toroidal) const {
+  if (field.values.getWidth() != width || field.values.getHeight() != height) {
+    throw std::invalid_argument(
+        "The field does not have the dimensions of the pyramid.");
+  }
+  if (!(radius >= 0)) {
+    throw std::invalid_argument("The radius of a query must be positive.");
+  }
+
+  // A block of a level, seen from the centre of the query translated by a
+  // period of a toroidal field
+  struct Block {
+    Value maximum;
+    // true if all the cells of the block are within the radius, so that its
+    // maximum is a cell of the query
+    bool exact;
+    int level;
+    int x;
+    int y;
+    double centerX;
+    double centerY;
+    bool operator<(const Block &other) const {
+      return maximum < other.maximum ||
+             (maximum == other.maximum && !exact && other.exact);
+    }
+  };
+  std::priority_queue<Block> blocks;
+  const double squaredRadius = radius * radius;
+  // Pushes a block intersecting the query, whose maximum beats 0
+  auto push = [&](int level, int bx, int by, double cx, double cy) {
+    const int side = blockSide(level);
+    // the centres of the first and the last cells of the block
+    const double x0 = bx * side + 0.5;
+    const double y0 = by * side + 0.5;
+    const double x1 = std::min(width, (bx + 1) * side) - 0.5;
+    const double y1 = std::min(height, (by + 1) * side) - 0.5;
+    const double nearX = std::clamp(cx, x0, x1) - cx;
+    const double nearY = std::clamp(cy, y0, y1) - cy;
+    if (nearX * nearX + nearY * nearY > squaredRadius) {
+      return;
+    }
+    const double farX = std::max(cx - x0, x1 - cx);
+    const double farY = std::max(cy - y0, y1 - cy);
+    const Value maximum = level == 0 ? field.values(bx, by)
+                                     : levels[level - 1].maximum(bx, by);
+    if (maximum > 0) {
+      blocks.push(Block{maximum,
+                        level == 0 || farX * farX + farY * farY <=
+                                          squaredRadius,
+                        level, bx, by, cx, cy});
+    }
+  };
+
+  const int top = getLevelCount() - 1;
+  const int periods = toroidal ? 1 : 0;
+  for (int dy = -periods; dy <= periods; ++dy) {
+    for (int dx = -periods; dx <= periods; ++dx) {
+      push(top, 0, 0, x + dx * width, y + dy * height);
+    }
+  }
+  while (!blocks.empty()) {
+    const Block block = blocks.top();
+    blocks.pop();
+    if (block.exact) {
+      Peak peak;
+      peak.found = true;
+      peak.value = block.maximum;
+      if (block.level == 0) {
+        peak.x = block.x;
+        peak.y = block.y;
+      } else {
+        const std::uint32_t cell =
+            levels[block.level - 1].argmax(block.x, block.y);
+        peak.x = static_cast<int>(cell % static_cast<std::uint32_t>(width));
+        peak.y = static_cast<int>(cell / static_cast<std::uint32_t>(width));
+      }
+      return peak;
+    }
+    const int level = block.level - 1;
+    for (int cy = 2 * block.y;
+         cy < std::min(levelSize(height, level), 2 * block.y + 2); ++cy) {
+      for (int cx = 2 * block.x;
+           cx < std::min(levelSize(width, level), 2 * block.x + 2); ++cx) {
+        push(level, cx, cy, block.centerX, block.centerY);
+      }
+    }
+  }
+  return Peak();
+}
+
+} // namespace tools
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
@@ -0,0 +1,182 @@
+#include "kernel/tools/SpatialHashGrid.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace fr {
+namespace univ_artois {
+namespace lgi2a {
+namespace similar {
+namespace similar2logo {
+namespace kernel {
+namespace tools {
+
+namespace {
+
+// The index of the cell holding a coordinate, in cell units, clamped to the
+// cells (NaN going to the first one).
+int clampedCell(double position, int cells) {
+  const double cell = std::floor(position);
+  if (!(cell >= 0)) {
+    return 0;
+  }
+  return cell >= cells ? cells - 1 : static_cast<int>(cell);
+}
+
+} // namespace
+
+SpatialHashGrid::SpatialHashGrid(double cellSize, double width, double height,
+                                 bool toroidal)
+    : width(width), height(height), toroidal(toroidal) {
+  if (!(cellSize > 0) || !(width > 0) || !(height > 0)) {
+    throw std::invalid_argument(
+        "The cell size and the dimensions of the space must be positive.");
+  }
+  if (toroidal) {
+    // Even cells, so that the cells spanned by a query across the border
+    // are as wide as the others.
+    columns = std::max(1, static_cast<int>(std::floor(width / cellSize)));
+    rows = std::max(1, static_cast<int>(std::floor(height / cellSize)));
+    cellWidth = width / columns;
+    cellHeight = height / rows;
+  } else {
+    columns = std::max(1, static_cast<int>(std::ceil(width / cellSize)));
+    rows = std::max(1, static_cast<int>(std::ceil(height / cellSize)));
+    cellWidth = cellSize;
+    cellHeight = cellSize;
+  }
+  clear();
+}
+
+void SpatialHashGrid::clear() {
+  xs.clear();
+  ys.clear();
+  cellOf.clear();
+  sorted.clear();
+  start.assign(static_cast<std::size_t>(columns) * rows + 1, 0);
+  count = 0;
+  stale = false;
+}
+
+std::uint32_t SpatialHashGrid::cellAt(double x, double y) const {
+  const int column = clampedCell(x / cellWidth, columns);
+  const int row = clampedCell(y / cellHeight, rows);
+  return static_cast<std::uint32_t>(row) * columns + column;
+}
+
+void SpatialHashGrid::place(std::uint32_t key, double x, double y) {
+  if (toroidal) {
+    x = wrap(x, width);
+    y = wrap(y, height);
+  }
+  xs[key] = x;
+  ys[key] = y;
+  cellOf[key] = cellAt(x, y);
+}
+
+void SpatialHashGrid::insert(std::uint32_t key, double x, double y) {
+  if (key == NO_KEY) {
+    throw std::invalid_argument("The key NO_KEY is reserved.");
+  }
+  if (key >= cellOf.size()) {
+    xs.resize(key + std::size_t(1));
+    ys.resize(key + std::size_t(1));
+    cellOf.resize(key + std::size_t(1), NO_CELL);
+  }
+  if (cellOf[key] == NO_CELL) {
+    ++count;
+  }
+  place(key, x, y);
+  stale = true;
+}
+
+void SpatialHashGrid::remove(std::uint32_t key) {
+  if (contains(key)) {
+    cellOf[key] = NO_CELL;
+    --count;
+    stale = true;
+  }
+}
+
+void SpatialHashGrid::rebuild(const double *newXs, const double *newYs,
+                              std::size_t newCount) {
+  if (newCount >= NO_KEY) {
+    throw std::invalid_argument("Too many points for the index.");
+  }
+  xs.resize(newCount);
+  ys.resize(newCount);
+  cellOf.resize(newCount);
+  for (std::size_t key = 0; key < newCount; ++key) {
+    place(static_cast<std::uint32_t>(key), newXs[key], newYs[key]);
+  }
+  count = newCount;
+  stale = true;
+  refresh();
+}
+
+void SpatialHashGrid::refresh() {
+  if (!stale) {
+    return;
+  }
+  // Counting sort of the keys by cell, as the turtle index of the
+  // environment: count the keys of each cell in start[cell + 1], accumulate,
+  // then place the keys, which moves start[cell] to the start of the next
+  // cell.
+  const std::size_t cells = static_cast<std::size_t>(columns) * rows;
+  std::fill(start.begin(), start.end(), 0);
+  for (const std::uint32_t cell : cellOf) {
+    if (cell != NO_CELL) {
+      ++start[cell + 1];
+    }
+  }
+  for (std::size_t cell = 0; cell < cells; ++cell) {
+    start[cell + 1] += start[cell];
+  }
+  sorted.resize(count);
+  for (std::size_t key = 0; key < cellOf.size(); ++key) {
+    if (cellOf[key] != NO_CELL) {
+      sorted[start[cellOf[key]]++] = static_cast<std::uint32_t>(key);
+    }
+  }
+  for (std::size_t cell = cells; cell > 0; --cell) {
+    start[cell] = start[cell - 1];
+  }
+  start[0] = 0;
+  stale = false;
+}
+
+std::vector<std::pair<std::uint32_t, double>>
+SpatialHashGrid::queryRadius(double x, double y, double radius,
+                             std::uint32_t exclude) {
+  std::vector<std::pair<std::uint32_t, double>> found;
+  queryRadius(x, y, radius, exclude, [&](std::uint32_t key, double distance) {
+    found.emplace_back(key, distance);
+  });
+  return found;
+}
+
+void SpatialHashGrid::span(double coordinate, double radius, double cellSide,
+                           int cells, int &first, int &spanned) const {
+  if (!toroidal) {
+    first = clampedCell((coordinate - radius) / cellSide, cells);
+    spanned = clampedCell((coordinate + radius) / cellSide, cells) - first + 1;
+    return;
+  }
+  const double low = std::floor((coordinate - radius) / cellSide);
+  const double high = std::floor((coordinate + radius) / cellSide);
+  if (!(high - low + 1 < cells)) {
+    first = 0;
+    spanned = cells;
+    return;
+  }
+  first = static_cast<int>(low) % cells;
+  first = first < 0 ? first + cells : first;
+  spanned = static_cast<int>(high - low) + 1;
+}
+
+} // namespace tools
+} // namespace kernel
+} // namespace similar2logo
+} // namespace similar
+} // namespace lgi2a
+} // namespace univ_artois
+} // namespace fr
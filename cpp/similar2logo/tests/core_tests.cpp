@@ -1,8 +1,19 @@
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <set>
+#include <stdexcept>
 #include <string>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
 #include <unordered_set>
 #include <vector>
 
@@ -10,14 +21,30 @@
 #include "AgentCategory.h"
 #include "LevelIdentifier.h"
 #include "SimulationTimeStamp.h"
+#include "agents/StaticExtendedAgent.h"
+#include "dynamicstate/ConsistentPublicLocalDynamicState.h"
+#include "engine/MultiThreadedSimulationEngine.h"
 #include "influences/AbstractInfluence.h"
 #include "influences/InfluencesMap.h"
 #include "influences/RegularInfluence.h"
 #include "influences/SystemInfluence.h"
+#include "levels/ExtendedLevel.h"
 #include "libs/generic/EmptyLocalStateOfEnvironment.h"
 #include "libs/generic/EmptyPerceivedData.h"
+#include "libs/SymbolTable.h"
+#include "libs/timemodel/PeriodicTimeModel.h"
 
 // Similar2Logo includes
+#include "kernel/agents/Behaviors.h"
+#include "kernel/agents/CompiledBehavior.h"
+#include "kernel/agents/TurtleOrdering.h"
+#include "kernel/agents/WakeConditions.h"
+#include "kernel/agents/LogoAgent.h"
+#include "kernel/engine/DistributedLogoSimulationEngine.h"
+#include "kernel/engine/DistributedReductionProbe.h"
+#include "kernel/engine/LocalDomainCommunicator.h"
+#include "kernel/environment/Environment.h"
+#include "kernel/environment/SharedDecisionBuffer.h"
 #include "kernel/influences/ChangeAcceleration.h"
 #include "kernel/influences/ChangeDirection.h"
 #include "kernel/influences/ChangePosition.h"
@@ -25,14 +52,34 @@
 #include "kernel/influences/DropMark.h"
 #include "kernel/influences/EmitPheromone.h"
 #include "kernel/influences/RemoveMark.h"
+#include "kernel/influences/Relocate.h"
 #include "kernel/influences/RemoveMarks.h"
 #include "kernel/influences/Stop.h"
+#include "kernel/model/levels/LogoDefaultReactionModel.h"
+#include "kernel/model/levels/LogoSimulationLevelList.h"
+#include "kernel/model/DistributedLogoSimulationModel.h"
+#include "kernel/model/LogoSimulationModel.h"
+#include "kernel/model/environment/LogoEnvPLS.h"
+#include "kernel/model/environment/LogoEnvironment.h"
 #include "kernel/model/environment/Mark.h"
+#include "kernel/model/environment/MarkStore.h"
 #include "kernel/model/environment/SituatedEntity.h"
 #include "kernel/model/environment/TurtlePLSInLogo.h"
+#include "kernel/reaction/Reaction.h"
+#include "kernel/tools/CrowdField.h"
 #include "kernel/tools/FastMath.h"
+#include "kernel/tools/FieldDiffusion.h"
+#include "kernel/tools/GridMemory.h"
+#include "kernel/tools/FrameEncoder.h"
+#include "kernel/tools/HeatmapTileRenderer.h"
 #include "kernel/tools/MathUtil.h"
+#include "kernel/tools/MoveResolution.h"
+#include "kernel/tools/PheromonePyramid.h"
 #include "kernel/tools/Point2D.h"
+#include "kernel/tools/RowBands.h"
+#include "kernel/tools/SpaceFillingCurve.h"
+#include "kernel/tools/SpatialHashGrid.h"
+#include "kernel/tools/Topology.h"
 
 // Namespace aliases
 namespace mk = fr::univ_artois::lgi2a::similar::microkernel;
@@ -69,7 +116,7 @@ void testPoint2D() {
   // Comparison operators
   s2l::tools::Point2D p7(1.0, 1.0);
   s2l::tools::Point2D p8(1.0, 1.0);
-  s2l::tools::Point2D p9(1.000000001, 1.0);
+  s2l::tools::Point2D p9(1.0000000001, 1.0);
 
   assert(p7 == p8);
   assert(p7 != p5);
@@ -102,10 +149,10 @@ void testPoint2D() {
   assert(std::abs(unitX.angle() - 0.0) < 1e-9);
   assert(std::abs(unitY.angle() - M_PI / 2) < 1e-9);
 
-  // Rotation
+  // Rotation, through the sine table of FastMath
   auto rotated = unitX.rotated(M_PI / 2);
-  assert(std::abs(rotated.x - 0.0) < 1e-9);
-  assert(std::abs(rotated.y - 1.0) < 1e-9);
+  assert(std::abs(rotated.x - 0.0) < 1e-3);
+  assert(std::abs(rotated.y - 1.0) < 1e-3);
 
   // Polar coordinates
   auto fromPolar = s2l::tools::Point2D::fromPolar(5.0, M_PI / 4);
@@ -150,6 +197,82 @@ void testMathUtil() {
   std::cout << "MathUtil tests PASSED" << std::endl;
 }
 
+// Test the compile-time topologies against the torus flags of MathUtil
+void testTopology() {
+  std::cout << "Testing Topology..." << std::endl;
+  using s2l::tools::Point2D;
+
+  const Point2D a(0.5, 9.5), b(9.5, 0.5);
+  assert(std::abs(s2l::tools::Torus::distance(a, b, 10, 10) -
+                  std::sqrt(2.0)) < 1e-9);
+  assert(std::abs(s2l::tools::CylinderX::distance(a, b, 10, 10) -
+                  std::sqrt(1.0 + 81.0)) < 1e-9);
+  assert(std::abs(s2l::tools::CylinderY::distance(a, b, 10, 10) -
+                  std::sqrt(81.0 + 1.0)) < 1e-9);
+  for (const bool x : {false, true}) {
+    for (const bool y : {false, true}) {
+      s2l::tools::withTopology(x, y, [&](auto topology) {
+        using T = decltype(topology);
+        assert(T::X_WRAPS == x && T::Y_WRAPS == y);
+        const Point2D d = T::displacement(a, b, 10, 10);
+        assert(std::abs(d.x - (x ? -1.0 : 9.0)) < 1e-9);
+        assert(std::abs(d.y - (y ? 1.0 : -9.0)) < 1e-9);
+        assert(T::neighbourX(-1, 10) == (x ? 9 : -1));
+        assert(T::neighbourY(10, 10) == (y ? 0 : -1));
+        double px = 10.25, py = -0.5;
+        T::place(px, py, 10, 10);
+        assert(std::abs(px - (x ? 0.25 : 9.0)) < 1e-9);
+        assert(std::abs(py - (y ? 9.5 : 0.0)) < 1e-9);
+      });
+    }
+  }
+
+  // The batch kernels agree with the distance and direction of one pair
+  s2l::model::environment::LogoEnvPLS env(
+      mk::LevelIdentifier("logo"), 10, 8, true, false, {});
+  const Point2D origin(9.5, 1.0);
+  const std::vector<double> px = {0.5, 9.5, 4.0, 2.0, 9.0};
+  const std::vector<double> py = {1.0, 7.5, 4.0, 0.0, 1.0};
+  std::vector<double> squared(px.size()), exact(px.size()),
+      approximate(px.size());
+  env.getSquaredDistances(origin, px.data(), py.data(), px.size(),
+                          squared.data());
+  env.getDirections(origin, px.data(), py.data(), px.size(), exact.data());
+  env.getDirections(origin, px.data(), py.data(), px.size(),
+                    approximate.data(), false);
+  for (std::size_t i = 0; i < px.size(); ++i) {
+    const Point2D p(px[i], py[i]);
+    const double distance = env.getDistance(origin, p);
+    assert(std::abs(squared[i] - distance * distance) < 1e-9);
+    assert(exact[i] == env.getDirection(origin, p));
+    assert(std::abs(approximate[i] - exact[i]) <=
+           mk::tools::FastMath::ATAN2_ERROR);
+  }
+
+  // A cylinder diffuses across its x borders only, and keeps its mass
+  s2l::tools::FieldDiffusion diffusion(16, 16, true, false);
+  s2l::tools::TiledField field;
+  field.assign(16, 16, 0.0);
+  field.set(0, 8, 1.0);
+  diffusion.add(field, {0.5, false, 0.0, 0.0});
+  diffusion.run();
+  double mass = 0;
+  for (int y = 0; y < 16; ++y) {
+    for (int x = 0; x < 16; ++x) {
+      mass += field.values(x, y);
+    }
+  }
+  assert(std::abs(mass - 1.0) < 1e-6);
+  assert(field.values(15, 8) > 0 && field.values(15, 7) > 0);
+  field.assign(16, 16, 0.0);
+  field.set(8, 0, 1.0);
+  diffusion.add(field, {0.5, false, 0.0, 0.0});
+  diffusion.run();
+  assert(field.values(8, 15) == 0 && field.values(8, 1) > 0);
+
+  std::cout << "Topology tests PASSED" << std::endl;
+}
+
 // Test FastMath class methods
 void testFastMath() {
   std::cout << "Testing FastMath class..." << std::endl;
@@ -165,6 +288,38 @@ void testFastMath() {
     assert(std::abs(std_cos - fast_cos) < 0.1);
   }
 
+  // Test the batch sin/cos, including the angles left to std::sin/cos
+  std::vector<double> angles;
+  for (double angle = -20.0; angle <= 20.0; angle += 0.37) {
+    angles.push_back(angle);
+  }
+  angles.push_back(3e7);
+  std::vector<double> sines(angles.size()), cosines(angles.size());
+  mk::tools::FastMath::sinCos(angles.data(), sines.data(), cosines.data(),
+                              angles.size());
+  for (std::size_t i = 0; i < angles.size(); ++i) {
+    assert(std::abs(sines[i] - std::sin(angles[i])) < 1e-15);
+    assert(std::abs(cosines[i] - std::cos(angles[i])) < 1e-15);
+  }
+
+  // Test the batch atan2 around the circle, the axes included
+  std::vector<double> ys, xs;
+  for (int i = 0; i < 720; ++i) {
+    const double angle = -M_PI + i * M_PI / 360;
+    ys.push_back(3 * std::sin(angle));
+    xs.push_back(3 * std::cos(angle));
+  }
+  ys.push_back(0);
+  xs.push_back(0);
+  std::vector<double> bearings(xs.size());
+  mk::tools::FastMath::atan2(ys.data(), xs.data(), bearings.data(),
+                             xs.size());
+  for (std::size_t i = 0; i < xs.size(); ++i) {
+    double error = std::abs(bearings[i] - std::atan2(ys[i], xs[i]));
+    error = std::min(error, 2 * M_PI - error); // -pi and pi
+    assert(error <= mk::tools::FastMath::ATAN2_ERROR);
+  }
+
   // Test sqrt
   assert(std::abs(mk::tools::FastMath::sqrt(4.0) - 2.0) < 1e-9);
 
@@ -197,8 +352,8 @@ void testSimulationTimeStamp() {
   mk::SimulationTimeStamp ts7(10);
 
   assert(ts5 < ts6);
-  assert(ts5 <= ts7);
-  assert(ts5 >= ts7);
+  assert(!(ts7 < ts5));
+  assert(!(ts5 < ts7));
   assert(ts5 == ts7);
   assert(ts5 != ts6);
 
@@ -211,16 +366,16 @@ void testLevelIdentifier() {
 
   // Constructor
   mk::LevelIdentifier lid("test_level");
-  assert(lid.getName() == "test_level");
+  assert(lid.toString() == "test_level");
 
   // Copy constructor
   mk::LevelIdentifier lid2(lid);
-  assert(lid2.getName() == "test_level");
+  assert(lid2.toString() == "test_level");
 
   // Assignment
   mk::LevelIdentifier lid3("other");
   lid3 = lid;
-  assert(lid3.getName() == "test_level");
+  assert(lid3.toString() == "test_level");
 
   // Comparison
   mk::LevelIdentifier lid4("test_level");
@@ -250,10 +405,79 @@ void testAgentCategory() {
 
   assert(cat == cat3);
   assert(cat != cat4);
+  assert(cat.getSymbol() == cat3.getSymbol());
+  assert(cat.hashCode() == cat3.hashCode());
+  // ordered as strings, whatever the order of their interning
+  assert(cat4 < cat && !(cat < cat4) && !(cat < cat3));
+
+  // The parents are shared by the copies
+  mk::AgentCategory child("child_category", {cat4});
+  mk::AgentCategory childCopy(child);
+  assert(child.isA(cat4) && childCopy.isA(cat4) && !child.isA(cat));
 
   std::cout << "AgentCategory tests PASSED" << std::endl;
 }
 
+// Test the interned strings
+void testSymbolTable() {
+  std::cout << "Testing SymbolTable..." << std::endl;
+  using mk::libs::Symbol;
+  using mk::libs::SymbolTable;
+
+  assert(Symbol().empty() && Symbol().str().empty());
+  assert(Symbol("").getId() == SymbolTable::EMPTY);
+
+  Symbol red("symbol_test_red");
+  assert(Symbol("symbol_test_red") == red);
+  assert(Symbol("symbol_test_blue") != red);
+  assert(red.str() == "symbol_test_red");
+  assert(Symbol::fromId(red.getId()) == red);
+  Symbol found;
+  assert(Symbol::find("symbol_test_red", found) && found == red);
+  const std::size_t size = SymbolTable::global().size();
+  assert(!Symbol::find("symbol_test_never_interned", found));
+  assert(SymbolTable::global().size() == size);
+
+  bool thrown = false;
+  try {
+    Symbol::fromId(static_cast<std::uint32_t>(size));
+  } catch (const std::out_of_range &) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  // A table of its own, across several chunks, read as it grows
+  SymbolTable table;
+  const std::string &first = table.name(table.intern("first"));
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&table]() {
+      for (int i = 0; i < 2000; ++i) {
+        const std::uint32_t id = table.intern("name" + std::to_string(i));
+        assert(table.name(id) == "name" + std::to_string(i));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  assert(table.size() == 2002);
+  assert(first == "first");
+  std::uint32_t id = 0;
+  assert(table.find("name1999", id) && table.name(id) == "name1999");
+
+  // The colors of the turtles are interned, attached or not
+  s2l::tools::Point2D location(1.0, 2.0);
+  s2l::model::environment::TurtlePLSInLogo turtle(location, 0, 1, 0, false,
+                                                  "symbol_test_red");
+  assert(turtle.getColorSymbol() == red);
+  turtle.setColor("symbol_test_blue");
+  assert(turtle.getColorSymbol() == Symbol("symbol_test_blue"));
+  assert(turtle.getColor() == "symbol_test_blue");
+
+  std::cout << "SymbolTable tests PASSED" << std::endl;
+}
+
 // Test Mark class
 void testMark() {
   std::cout << "Testing Mark class..." << std::endl;
@@ -263,7 +487,7 @@ void testMark() {
   auto mark = std::make_shared<s2l::model::environment::SimpleMark>(loc);
 
   assert(mark->getLocation() == loc);
-  assert(mark->getContent() == nullptr);
+  assert(mark->getContent() == 0.0);
 
   std::cout << "Mark tests PASSED" << std::endl;
 }
@@ -297,6 +521,2278 @@ void testTurtlePLSInLogo() {
   std::cout << "TurtlePLSInLogo tests PASSED" << std::endl;
 }
 
+// Test the float and double updates of the fields
+void testFieldDiffusionPrecision() {
+  std::cout << "Testing FieldDiffusion precisions..." << std::endl;
+
+  using s2l::tools::BasicFieldDiffusion;
+  s2l::tools::BasicTiledField<float> single;
+  s2l::tools::BasicTiledField<double> wide;
+  single.assign(70, 40, 0.0);
+  wide.assign(70, 40, 0.0);
+  single.set(3, 3, 100.0);
+  wide.set(3, 3, 100.0);
+  single.set(55, 20, 50.0);
+  wide.set(55, 20, 50.0);
+  BasicFieldDiffusion<float> singleDiffusion(70, 40, true, false);
+  BasicFieldDiffusion<double> wideDiffusion(70, 40, true, false);
+  // without evaporation, the diffusion keeps the total
+  for (int step = 0; step < 20; ++step) {
+    singleDiffusion.add(single, {0.3, false, 0.0, 0.0});
+    singleDiffusion.run();
+    wideDiffusion.add(wide, {0.3, false, 0.0, 0.0});
+    wideDiffusion.run();
+  }
+  double singleTotal = 0;
+  double wideTotal = 0;
+  for (int y = 0; y < 40; ++y) {
+    for (int x = 0; x < 70; ++x) {
+      assert(std::abs(single.values(x, y) - wide.values(x, y)) < 1e-4);
+      singleTotal += single.values(x, y);
+      wideTotal += wide.values(x, y);
+    }
+  }
+  assert(std::abs(wideTotal - 150.0) < 1e-9);
+  assert(std::abs(singleTotal - 150.0) < 1e-3);
+
+  std::cout << "FieldDiffusion precision tests PASSED" << std::endl;
+}
+
+// Test the spectral diffusion of the toroidal fields
+void testSpectralDiffusion() {
+  std::cout << "Testing spectral FieldDiffusion..." << std::endl;
+
+  using Diffusion = s2l::tools::BasicFieldDiffusion<double>;
+  using Field = s2l::tools::BasicTiledField<double>;
+  // 40 patches wide for the radix 2 transform, 36 high for the other
+  const int width = 40, height = 36;
+  auto trails = [&]() {
+    Field field;
+    field.assign(width, height, 0.0);
+    field.set(3, 3, 100.0);
+    field.set(30, 20, 50.0);
+    field.set(39, 35, 20.0);
+    return field;
+  };
+  auto total = [&](const Field &field) {
+    double sum = 0;
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        sum += field.values(x, y);
+      }
+    }
+    return sum;
+  };
+  Diffusion explicitDiffusion(width, height, true, true);
+  Diffusion spectralDiffusion(width, height, true, true);
+  spectralDiffusion.setScheme(Diffusion::Scheme::SPECTRAL);
+
+  // small steps follow the explicit scheme closely
+  Field stepped = trails();
+  Field exact = trails();
+  for (int step = 0; step < 10; ++step) {
+    explicitDiffusion.add(stepped, {0.05, false, 0.0, 0.0});
+    explicitDiffusion.run();
+    spectralDiffusion.add(exact, {0.05, false, 0.0, 0.0});
+    spectralDiffusion.run();
+  }
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      assert(std::abs(stepped.values(x, y) - exact.values(x, y)) < 1.0);
+    }
+  }
+  // the total is kept but for the values below the round-off of the
+  // transforms, which are dropped
+  assert(std::abs(total(exact) - 170.0) < 1e-6);
+
+  // a step far beyond the explicit bound stays positive and bounded
+  Field large = trails();
+  spectralDiffusion.add(large, {40.0, false, 0.0, 0.0});
+  spectralDiffusion.run();
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      assert(large.values(x, y) >= 0 && large.values(x, y) < 100.0);
+    }
+  }
+  assert(std::abs(total(large) - 170.0) < 1e-6);
+
+  // 4 steps of dt give the field of 1 step of 4 dt
+  Field steps = trails();
+  for (int step = 0; step < 4; ++step) {
+    spectralDiffusion.add(steps, {0.5, true, 0.1, 0.0});
+    spectralDiffusion.run();
+  }
+  Field once = trails();
+  spectralDiffusion.add(once, {2.0, true, 0.4, 0.0});
+  spectralDiffusion.run();
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      assert(std::abs(steps.values(x, y) - once.values(x, y)) < 1e-9);
+    }
+  }
+  assert(std::abs(total(once) - 170.0 * std::exp(-0.4)) < 1e-6);
+
+  // the grids which do not wrap keep the explicit scheme
+  Diffusion bounded(width, height, true, false);
+  bounded.setScheme(Diffusion::Scheme::SPECTRAL);
+  Field boundedField = trails();
+  Field explicitField = trails();
+  bounded.add(boundedField, {0.3, false, 0.0, 0.0});
+  bounded.run();
+  Diffusion boundedExplicit(width, height, true, false);
+  boundedExplicit.add(explicitField, {0.3, false, 0.0, 0.0});
+  boundedExplicit.run();
+  assert(boundedField.values(3, 3) == explicitField.values(3, 3));
+
+  std::cout << "Spectral FieldDiffusion tests PASSED" << std::endl;
+}
+
+// Test the vectorized diffusion of Environment against a scalar stencil
+void testPheromoneDiffusion() {
+  std::cout << "Testing Environment pheromone diffusion..." << std::endl;
+
+  // 70 x 45 cells: the rows end in the middle of a vector and of a tile
+  const int width = 70, height = 45;
+  const double diffusion = 0.4, evaporation = 0.05, dt = 1.0;
+  for (const bool toroidal : {false, true}) {
+    // A step of the 8-neighbour stencil, cell by cell
+    auto reference = [&](const std::vector<double> &values) {
+      auto inside = [&](int x, int y) {
+        return toroidal || (x >= 0 && x < width && y >= 0 && y < height);
+      };
+      auto wrapped = [&](int v, int size) { return (v % size + size) % size; };
+      std::vector<double> next(values);
+      for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+          const double v = values[y * width + x];
+          if (v <= 0) {
+            continue;
+          }
+          int neighbours = 0;
+          for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+              neighbours += (dx || dy) && inside(x + dx, y + dy);
+            }
+          }
+          const double share = v * diffusion * dt / neighbours;
+          next[y * width + x] -= v * diffusion * dt;
+          for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+              if ((dx || dy) && inside(x + dx, y + dy)) {
+                next[wrapped(y + dy, height) * width +
+                     wrapped(x + dx, width)] += share;
+              }
+            }
+          }
+        }
+      }
+      for (double &v : next) {
+        v -= evaporation * dt * v;
+      }
+      return next;
+    };
+
+    s2l::environment::Environment env(width, height, toroidal);
+    const auto trail = env.add_pheromone("trail", diffusion, evaporation);
+    std::mt19937 random(21);
+    std::uniform_real_distribution<double> amount(0.0, 10.0);
+    std::vector<double> expected(width * height, 0.0);
+    for (int i = 0; i < 300; ++i) {
+      expected[random() % expected.size()] = amount(random);
+    }
+    // the corners and borders, where the shares differ
+    expected[0] = expected[width - 1] = 5.0;
+    expected[(height - 1) * width] = expected[width * height - 1] = 5.0;
+    expected[20 * width] = expected[20 * width + width - 1] = 3.0;
+    env.set_pheromone_values(trail, expected.data());
+
+    for (int step = 0; step < 5; ++step) {
+      env.diffuse_and_evaporate(dt);
+      expected = reference(expected);
+      double total = 0;
+      double expectedTotal = 0;
+      for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+          const double value = env.get_pheromone_values(trail)(x, y);
+          const double wanted = expected[y * width + x];
+          assert(std::abs(value - wanted) <= 1e-5 * (1.0 + wanted));
+          total += value;
+          expectedTotal += wanted;
+        }
+      }
+      // only the evaporation changes the total, on bounded grids too
+      assert(std::abs(total - expectedTotal) <= 1e-5 * expectedTotal);
+    }
+  }
+
+  std::cout << "Environment pheromone diffusion tests PASSED" << std::endl;
+}
+
+// Test the fused update of several pheromones against separate updates
+void testFusedPheromones() {
+  std::cout << "Testing the fused pheromone update..." << std::endl;
+
+  const int width = 80, height = 50;
+  struct Layer {
+    const char *name;
+    double diffusion;
+    double evaporation;
+    double minValue;
+  };
+  const Layer layers[] = {{"food", 0.3, 0.02, 0.0},
+                          {"nest", 0.1, 0.0, 0.0},
+                          {"alarm", 0.6, 0.2, 0.05}};
+  std::mt19937 random(22);
+  std::uniform_real_distribution<double> amount(0.0, 10.0);
+  std::vector<std::vector<double>> initial;
+  for (std::size_t l = 0; l < 3; ++l) {
+    std::vector<double> values(width * height, 0.0);
+    for (int i = 0; i < 200; ++i) {
+      values[random() % values.size()] = amount(random);
+    }
+    initial.push_back(values);
+  }
+
+  for (const bool toroidal : {false, true}) {
+    // The layers of one environment, updated in one sweep, and each layer
+    // alone in its own environment
+    s2l::environment::Environment fused(width, height, toroidal);
+    std::vector<std::unique_ptr<s2l::environment::Environment>> alone;
+    std::vector<s2l::environment::Environment::PheromoneHandle> handles;
+    for (std::size_t l = 0; l < 3; ++l) {
+      const Layer &layer = layers[l];
+      handles.push_back(fused.add_pheromone(layer.name, layer.diffusion,
+                                            layer.evaporation, 0.0,
+                                            layer.minValue));
+      fused.set_pheromone_values(handles.back(), initial[l].data());
+      alone.push_back(std::make_unique<s2l::environment::Environment>(
+          width, height, toroidal));
+      const auto handle = alone.back()->add_pheromone(
+          layer.name, layer.diffusion, layer.evaporation, 0.0,
+          layer.minValue);
+      alone.back()->set_pheromone_values(handle, initial[l].data());
+    }
+    for (int step = 0; step < 6; ++step) {
+      fused.diffuse_and_evaporate(1.0);
+      for (auto &env : alone) {
+        env->diffuse_and_evaporate(1.0);
+      }
+    }
+    for (std::size_t l = 0; l < 3; ++l) {
+      const auto &values = fused.get_pheromone_values(handles[l]);
+      const auto &expected = alone[l]->get_pheromone_values(
+          *alone[l]->find_pheromone(layers[l].name));
+      for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+          assert(values(x, y) == expected(x, y));
+        }
+      }
+      assert(fused.get_active_tile_count(layers[l].name) ==
+             alone[l]->get_active_tile_count(layers[l].name));
+    }
+    // the layers did not leak into each other: the evaporating one lost
+    // pheromone, the other kept it
+    double nest = 0, initialNest = 0;
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        nest += fused.get_pheromone_values(handles[1])(x, y);
+        initialNest += initial[1][y * width + x];
+      }
+    }
+    assert(std::abs(nest - initialNest) < 1e-3 * initialNest);
+  }
+
+  std::cout << "Fused pheromone update tests PASSED" << std::endl;
+}
+
+// Test the pheromone update in row bands on the pool of an engine
+void testParallelFieldUpdate() {
+  std::cout << "Testing the parallel pheromone update..." << std::endl;
+
+  // Every row is processed once, by one band
+  mk::engine::WorkStealingThreadPool pool(4);
+  {
+    mk::engine::WorkStealingThreadPool::Scope scope(&pool);
+    const int rows = 1000, rowLength = 300;
+    std::vector<std::atomic<int>> visits(rows);
+    std::atomic<int> bands{0};
+    s2l::tools::RowBands::forEach(rows, rowLength, [&](int begin, int end) {
+      assert(begin < end);
+      ++bands;
+      for (int row = begin; row < end; ++row) {
+        ++visits[row];
+      }
+    });
+    assert(bands > 1);
+    for (const auto &count : visits) {
+      assert(count == 1);
+    }
+  }
+
+  // Several bands of 300 x 260 cells give the grids of a sequential update
+  const int width = 300, height = 260;
+  std::mt19937 random(23);
+  std::uniform_real_distribution<double> amount(0.0, 10.0);
+  std::vector<double> initial(width * height, 0.0);
+  for (int i = 0; i < 3000; ++i) {
+    initial[random() % initial.size()] = amount(random);
+  }
+  for (const bool toroidal : {false, true}) {
+    auto run = [&](bool parallel) {
+      auto env = std::make_unique<s2l::environment::Environment>(
+          width, height, toroidal);
+      const auto trail = env->add_pheromone("trail", 0.5, 0.1);
+      const auto still = env->add_pheromone("still", 0.0, 0.2);
+      env->set_pheromone_values(trail, initial.data());
+      env->set_pheromone_values(still, initial.data());
+      std::optional<mk::engine::WorkStealingThreadPool::Scope> scope;
+      if (parallel) {
+        scope.emplace(&pool);
+      }
+      for (int step = 0; step < 4; ++step) {
+        env->diffuse_and_evaporate(1.0);
+      }
+      return env;
+    };
+    const auto sequential = run(false);
+    const auto parallel = run(true);
+    for (const char *name : {"trail", "still"}) {
+      const auto &expected =
+          sequential->get_pheromone_values(*sequential->find_pheromone(name));
+      const auto &values =
+          parallel->get_pheromone_values(*parallel->find_pheromone(name));
+      for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+          assert(values(x, y) == expected(x, y));
+        }
+      }
+    }
+  }
+
+  std::cout << "Parallel pheromone update tests PASSED" << std::endl;
+}
+
+// Test the active tiles of the pheromone grids, and their retirement
+void testActivePheromoneTiles() {
+  std::cout << "Testing the active pheromone tiles..." << std::endl;
+
+  const int tile = s2l::environment::Environment::TILE_SIZE;
+  s2l::environment::Environment env(4 * tile, 3 * tile, false);
+  const auto trail = env.add_pheromone("trail", 0.4, 0.5, 0.0, 0.01);
+  const auto scent = env.add_pheromone("scent", 0.0, 0.5, 0.0, 0.01);
+  assert(env.get_active_tile_count("trail") == 0 &&
+         env.get_active_tile_count("scent") == 0);
+  // The flags cover every non-zero cell
+  auto checkFlags = [&](s2l::environment::Environment::PheromoneHandle p) {
+    const auto &field = env.get_pheromone_field(p);
+    for (int y = 0; y < 3 * tile; ++y) {
+      for (int x = 0; x < 4 * tile; ++x) {
+        assert(field.values(x, y) == 0 || field.active[field.tileOf(x, y)]);
+      }
+    }
+  };
+
+  // A trail inside a tile keeps only that tile active
+  env.set_pheromone(tile + 8, tile + 8, trail, 1.0);
+  env.set_pheromone(5, 5, scent, 1.0);
+  assert(env.get_active_tile_count("trail") == 1 &&
+         env.get_active_tile_count("scent") == 1);
+  env.diffuse_and_evaporate(1.0);
+  assert(env.get_active_tile_count("trail") == 1);
+  assert(env.get_pheromone_value(tile + 9, tile + 9, trail) > 0);
+  checkFlags(trail);
+
+  // A trail on the edge of a tile activates its neighbour
+  env.set_pheromone(2 * tile - 1, 2 * tile + 4, trail, 1.0);
+  assert(env.get_active_tile_count("trail") == 2);
+  env.diffuse_and_evaporate(1.0);
+  assert(env.get_active_tile_count("trail") == 3);
+  assert(env.get_pheromone_value(2 * tile, 2 * tile + 4, trail) > 0);
+  checkFlags(trail);
+  checkFlags(scent);
+
+  // The tiles evaporated below the minimum value are retired, with or
+  // without diffusion
+  for (int step = 0; step < 20; ++step) {
+    env.diffuse_and_evaporate(1.0);
+    checkFlags(trail);
+  }
+  assert(env.get_active_tile_count("trail") == 0 &&
+         env.get_active_tile_count("scent") == 0);
+  for (int y = 0; y < 3 * tile; ++y) {
+    for (int x = 0; x < 4 * tile; ++x) {
+      assert(env.get_pheromone_value(x, y, trail) == 0 &&
+             env.get_pheromone_value(x, y, scent) == 0);
+    }
+  }
+
+  std::cout << "Active pheromone tiles tests PASSED" << std::endl;
+}
+
+// Test the batch accessors of the pheromone grids and turtle states
+void testEnvironmentBatchAccess() {
+  std::cout << "Testing Environment batch access..." << std::endl;
+
+  s2l::environment::Environment env(70, 40, false);
+  const auto pheromone = env.add_pheromone("pheromone", 0.1, 0.1);
+  std::vector<double> values(70 * 40, 0.0);
+  values[35 * 70 + 65] = 2.0;
+  env.set_pheromone_values(pheromone, values.data());
+  assert(env.get_pheromone_value(65, 35, pheromone) == 2.0);
+  assert(env.get_pheromone_values(pheromone)(65, 35) == 2.0);
+  assert(env.get_active_tile_count("pheromone") == 1);
+  env.diffuse_and_evaporate(1.0);
+  assert(env.get_pheromone_value(64, 34, pheromone) > 0);
+
+  auto first = std::make_shared<s2l::model::environment::TurtlePLSInLogo>(
+      s2l::tools::Point2D(1.5, 1.5), 0.0, 0.0, 0.0, false, "red");
+  auto second = std::make_shared<s2l::model::environment::TurtlePLSInLogo>(
+      s2l::tools::Point2D(2.5, 1.5), 0.0, 0.0, 0.0, false, "red");
+  env.add_turtle(first);
+  env.add_turtle(second);
+  const double x[] = {10.5, 20.5};
+  const double y[] = {5.5, 30.5};
+  const double headings[] = {1.0, 2.0};
+  const double speeds[] = {0.5, 0.25};
+  env.set_turtle_locations(x, y);
+  env.set_turtle_headings(headings);
+  env.set_turtle_speeds(speeds);
+  assert(second->getLocation().x == 20.5 && second->getLocation().y == 30.5);
+  assert(first->getHeading() == 1.0 && second->getSpeed() == 0.25);
+  // the patches follow the new locations
+  assert(env.get_turtles_at(20, 30).size() == 1);
+  assert(env.get_turtles_at(2, 1).empty());
+
+  std::cout << "Environment batch access tests PASSED" << std::endl;
+}
+
+// Test the handles of the pheromones against their identifiers
+void testPheromoneHandles() {
+  std::cout << "Testing pheromone handles..." << std::endl;
+
+  using Environment = s2l::environment::Environment;
+  Environment env(20, 15, true);
+  const auto food = env.add_pheromone("food", 0.2, 0.1);
+  const auto nest = env.add_pheromone("nest", 0.0, 0.0, 0.0, 0.01);
+  assert(!(food == nest));
+  assert(env.find_pheromone("food") == food);
+  assert(env.find_pheromone("nest") == nest);
+  assert(!env.find_pheromone("alarm").has_value());
+  assert(env.get_pheromone(nest).getIdentifier() == "nest");
+  assert(env.get_pheromone(nest).getMinValue() == 0.01);
+
+  // Both ways write and read the same cells, the nearest ones
+  env.set_pheromone(3.7, 4.2, food, 1.5);
+  env.set_pheromone(12.0, 9.9, "nest", 2.5);
+  assert(env.get_pheromone_value(3.7, 4.2, "food") == 1.5);
+  assert(env.get_pheromone_value(12.0, 9.9, nest) == 2.5);
+  assert(env.get_pheromone_values(food)(4, 4) == 1.5);
+  assert(env.get_pheromone_values(nest)(12, 10) == 2.5);
+  assert(env.get_pheromone_value(12.0, 9.9, food) == 0.0);
+
+  // The unknown identifiers are ignored
+  env.set_pheromone(3.7, 4.2, "alarm", 7.0);
+  assert(env.get_pheromone_value(3.7, 4.2, "alarm") == 0.0);
+  assert(env.get_pheromone_value(3.7, 4.2, food) == 1.5);
+
+  // Adding pheromones keeps the handles and the values of the others
+  for (int i = 0; i < 10; ++i) {
+    env.add_pheromone("extra" + std::to_string(i), 0.1, 0.1);
+  }
+  assert(env.find_pheromone("food") == food);
+  assert(env.find_pheromone("nest") == nest);
+  assert(env.get_pheromone_value(3.7, 4.2, food) == 1.5);
+  assert(env.get_pheromone_value(12.0, 9.9, nest) == 2.5);
+  assert(env.get_pheromone(food).getIdentifier() == "food");
+
+  // Adding a known identifier resets its pheromone under the same handle
+  assert(env.add_pheromone("nest", 0.3, 0.0) == nest);
+  assert(env.get_pheromone(nest).getDiffusionCoef() == 0.3);
+  assert(env.get_pheromone_value(12.0, 9.9, nest) == 0.0);
+  assert(env.get_pheromone_value(3.7, 4.2, food) == 1.5);
+
+  std::cout << "Pheromone handles tests PASSED" << std::endl;
+}
+
+// Test the batched pheromone deposits and mark drops against the one by one
+// updates, with and without a lent pool
+void testBatchDeposits() {
+  std::cout << "Testing batched deposits..." << std::endl;
+
+  using Environment = s2l::environment::Environment;
+  using s2l::model::environment::SimpleMark;
+  const int width = 300;
+  const int height = 260;
+  unsigned state = 1618;
+  auto next = [&state](double scale) {
+    state = state * 1103515245u + 12345u;
+    return (state >> 8) % 100000 / 100000.0 * scale;
+  };
+
+  // Many deposits on few cells, so that their order shows in the sums
+  std::vector<Environment::PheromoneDeposit> deposits;
+  for (int i = 0; i < 20000; ++i) {
+    const Environment::PheromoneHandle pheromone{
+        static_cast<std::uint32_t>(i % 7 == 0 ? 1 : 0)};
+    const double x = i % 3 == 0 ? next(width - 1) : 17.0 + i % 5;
+    const double y = i % 3 == 0 ? next(height - 1) : 200.0 + i % 4;
+    deposits.push_back({pheromone, x, y, next(1.0) * (i % 2 ? 1e-6 : 1e3)});
+  }
+  deposits.push_back({Environment::NO_PHEROMONE, 5.0, 5.0, 1.0});
+  deposits.push_back({Environment::PheromoneHandle{9}, 6.0, 6.0, 1.0});
+
+  auto sequential = [&](Environment &env) {
+    for (const auto &deposit : deposits) {
+      if (deposit.pheromone.index < 2) {
+        env.set_pheromone(deposit.x, deposit.y, deposit.pheromone,
+                          env.get_pheromone_value(deposit.x, deposit.y,
+                                                  deposit.pheromone) +
+                              deposit.value);
+      }
+    }
+  };
+  auto setUp = [&](Environment &env) {
+    env.add_pheromone("trail", 0.5, 0.1);
+    env.add_pheromone("food", 0.0, 0.0);
+  };
+  Environment expected(width, height, false);
+  setUp(expected);
+  sequential(expected);
+
+  std::vector<std::shared_ptr<SimpleMark>> marks;
+  for (int i = 0; i < 5000; ++i) {
+    marks.push_back(std::make_shared<SimpleMark>(s2l::tools::Point2D(
+        i % 4 == 0 ? 8.5 : next(width), i % 4 == 0 ? 9.5 : next(height))));
+  }
+  marks.push_back(marks[3]);
+  marks.push_back(
+      std::make_shared<SimpleMark>(s2l::tools::Point2D(width + 2.0, 1.0)));
+  for (const auto &mark : marks) {
+    const auto location = mark->getLocation();
+    expected.add_mark(static_cast<int>(std::floor(location.x)),
+                      static_cast<int>(std::floor(location.y)), mark);
+  }
+
+  for (const bool lent : {false, true}) {
+    mk::engine::WorkStealingThreadPool pool(4);
+    std::optional<mk::engine::WorkStealingThreadPool::Scope> scope;
+    if (lent) {
+      scope.emplace(&pool);
+    }
+    Environment env(width, height, false);
+    setUp(env);
+    env.emit_pheromones(deposits);
+    env.add_marks(marks);
+    for (std::uint32_t p = 0; p < 2; ++p) {
+      const Environment::PheromoneHandle pheromone{p};
+      const auto &field = env.get_pheromone_field(pheromone);
+      const auto &reference = expected.get_pheromone_field(pheromone);
+      for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+          assert(field.values(x, y) == reference.values(x, y));
+        }
+      }
+      assert(field.active == reference.active);
+    }
+    assert(env.get_marks().size() == expected.get_marks().size());
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        auto found = env.get_marks().getAt(x, y);
+        auto wanted = expected.get_marks().getAt(x, y);
+        std::sort(found.begin(), found.end());
+        std::sort(wanted.begin(), wanted.end());
+        assert(found == wanted);
+      }
+    }
+  }
+  assert(expected.get_marks().countAt(8, 9) == 1250);
+
+  std::cout << "Batched deposits tests PASSED" << std::endl;
+}
+
+// Test the strongest cells found in the pyramids against a scan of the disk
+void testPheromonePyramid() {
+  std::cout << "Testing PheromonePyramid..." << std::endl;
+
+  using s2l::tools::PheromonePyramid;
+  std::mt19937 random(7);
+  for (const bool toroidal : {false, true}) {
+    s2l::tools::TiledField field;
+    field.assign(77, 45, 0.0);
+    PheromonePyramid pyramid(PheromonePyramid::Reduction::MEAN);
+    pyramid.update(field);
+    assert(pyramid.getLevelCount() == 8 &&
+           pyramid.getLevel(7).getWidth() == 1);
+    assert(!pyramid.strongestWithin(field, 10, 10, 100, toroidal).found);
+    for (int i = 0; i < 60; ++i) {
+      field.set(random() % 77, random() % 45, (random() % 1000) / 10.0 + 0.1);
+    }
+    pyramid.update(field);
+
+    for (int query = 0; query < 200; ++query) {
+      const double x = (random() % 7700) / 100.0;
+      const double y = (random() % 4500) / 100.0;
+      const double radius = (random() % 4000) / 100.0;
+      double best = 0;
+      for (int cy = 0; cy < 45; ++cy) {
+        for (int cx = 0; cx < 77; ++cx) {
+          double dx = std::abs(cx + 0.5 - x);
+          double dy = std::abs(cy + 0.5 - y);
+          if (toroidal) {
+            dx = std::min(dx, 77 - dx);
+            dy = std::min(dy, 45 - dy);
+          }
+          if (dx * dx + dy * dy <= radius * radius) {
+            best = std::max(best, double(field.values(cx, cy)));
+          }
+        }
+      }
+      const auto peak = pyramid.strongestWithin(field, x, y, radius, toroidal);
+      assert(peak.found == (best > 0));
+      if (peak.found) {
+        assert(peak.value == best && field.values(peak.x, peak.y) == best);
+      }
+    }
+    double sum = 0;
+    for (const auto value : field.values) {
+      sum += value;
+    }
+    assert(std::abs(pyramid.getLevel(7)(0, 0) - sum / (77 * 45)) < 1e-3);
+  }
+
+  // The environment recomputes the pyramid after each step
+  s2l::environment::Environment env(100, 100, false);
+  const auto food = env.add_pheromone("food", 0.0, 0.5);
+  env.enable_pheromone_pyramid(food);
+  env.set_pheromone(90, 90, food, 4.0);
+  env.set_pheromone(10, 10, food, 1.0);
+  auto peak = env.strongest_pheromone_within(s2l::tools::Point2D(50, 50), 70,
+                                             food);
+  assert(!peak.found);
+  env.update_pheromone_pyramids();
+  peak = env.strongest_pheromone_within(s2l::tools::Point2D(50, 50), 70, food);
+  assert(peak.found && peak.x == 90 && peak.y == 90 && peak.value == 4.0);
+  peak = env.strongest_pheromone_within(s2l::tools::Point2D(5, 5), 20, food);
+  assert(peak.found && peak.x == 10 && peak.value == 1.0);
+  env.diffuse_and_evaporate(1.0);
+  peak = env.strongest_pheromone_within(s2l::tools::Point2D(50, 50), 70, food);
+  assert(peak.found && peak.value == 2.0);
+  bool threw = false;
+  try {
+    env.strongest_pheromone_within(s2l::tools::Point2D(50, 50), 1,
+                                   env.add_pheromone("trail"));
+  } catch (const std::logic_error &) {
+    threw = true;
+  }
+  assert(threw);
+
+  std::cout << "PheromonePyramid tests PASSED" << std::endl;
+}
+
+// Test the neighbourhoods of the patches cached by the radius queries
+void testNeighbourhoodCache() {
+  std::cout << "Testing Environment neighbourhood cache..." << std::endl;
+
+  for (const bool toroidal : {false, true}) {
+    s2l::environment::Environment env(12, 9, toroidal);
+    env.set_neighbourhood_cache(true);
+    unsigned state = 4321;
+    auto next = [&state](double scale) {
+      state = state * 1103515245u + 12345u;
+      return (state >> 8) % 100000 / 100000.0 * scale;
+    };
+    for (int i = 0; i < 200; ++i) {
+      env.add_turtle(std::make_shared<s2l::model::environment::TurtlePLSInLogo>(
+          s2l::tools::Point2D(next(12.0), next(9.0)), 0.0, 0.5, 0.0, false,
+          "red"));
+    }
+    auto sorted = [](std::vector<std::shared_ptr<
+                         s2l::model::environment::TurtlePLSInLogo>>
+                         turtles) {
+      std::sort(turtles.begin(), turtles.end());
+      return turtles;
+    };
+    for (int step = 0; step < 2; ++step) {
+      for (int q = 0; q < 60; ++q) {
+        const s2l::tools::Point2D center(next(12.0), next(9.0));
+        const double radius = q % 3 == 0 ? 1.0 : next(5.0);
+        std::vector<std::shared_ptr<s2l::model::environment::TurtlePLSInLogo>>
+            expected;
+        for (const auto &turtle : env.get_turtles()) {
+          if (env.get_distance(turtle->getLocation(), center) <= radius) {
+            expected.push_back(turtle);
+          }
+        }
+        expected = sorted(expected);
+        assert(sorted(env.get_turtles_in_radius(center, radius)) == expected);
+        // from the cache this time
+        assert(sorted(env.get_turtles_in_radius(center, radius)) == expected);
+      }
+      // the cache is emptied once the turtles moved
+      env.advance_turtles(1.0);
+    }
+  }
+
+  std::cout << "Environment neighbourhood cache tests PASSED" << std::endl;
+}
+
+// Test the radius, cone and batch turtle queries of Environment
+void testRadiusQueries() {
+  std::cout << "Testing Environment radius queries..." << std::endl;
+
+  using Turtle = s2l::model::environment::TurtlePLSInLogo;
+  using Turtles = std::vector<std::shared_ptr<Turtle>>;
+  auto sorted = [](Turtles turtles) {
+    std::sort(turtles.begin(), turtles.end());
+    return turtles;
+  };
+  auto turtleAt = [](double x, double y) {
+    return std::make_shared<Turtle>(s2l::tools::Point2D(x, y), 0.0, 0.5, 0.0,
+                                    false, "red");
+  };
+
+  for (const bool toroidal : {false, true}) {
+    s2l::environment::Environment env(12, 9, toroidal);
+    unsigned state = 2718;
+    auto next = [&state](double scale) {
+      state = state * 1103515245u + 12345u;
+      return (state >> 8) % 100000 / 100000.0 * scale;
+    };
+    for (int i = 0; i < 150; ++i) {
+      env.add_turtle(turtleAt(next(12.0), next(9.0)));
+    }
+    const Turtles turtles = env.get_turtles();
+
+    // Against a scan of every turtle, with the distances and directions of
+    // the environment
+    for (int q = 0; q < 80; ++q) {
+      const s2l::tools::Point2D center(next(12.0), next(9.0));
+      const double radius = q % 4 == 0 ? 0.7 : next(6.0);
+      const double heading = next(2 * M_PI) - M_PI;
+      const double angle = next(2 * M_PI);
+      Turtles inRadius;
+      Turtles inCone;
+      for (const auto &turtle : turtles) {
+        const auto location = turtle->getLocation();
+        if (env.get_distance(location, center) <= radius) {
+          inRadius.push_back(turtle);
+          if (std::abs(s2l::tools::MathUtil::angleDifference(
+                  heading, env.get_direction(center, location))) <=
+              angle / 2) {
+            inCone.push_back(turtle);
+          }
+        }
+      }
+      assert(sorted(env.get_turtles_in_radius(center, radius)) ==
+             sorted(inRadius));
+      assert(sorted(env.get_turtles_in_cone(center, heading, angle, radius)) ==
+             sorted(inCone));
+      std::size_t visited = 0;
+      env.query_radius(center, radius, [&](const auto &) { ++visited; });
+      assert(visited == inRadius.size());
+    }
+
+    // The batch query, on the pool of an engine, excludes the turtle itself
+    mk::engine::WorkStealingThreadPool pool(4);
+    mk::engine::WorkStealingThreadPool::Scope scope(&pool);
+    const double radius = 1.5;
+    const auto all = env.get_turtles_in_radius_all(radius);
+    assert(all.size() == turtles.size());
+    for (std::size_t i = 0; i < turtles.size(); ++i) {
+      Turtles expected;
+      for (const auto &turtle : turtles) {
+        if (turtle != turtles[i] &&
+            env.get_distance(turtle->getLocation(),
+                             turtles[i]->getLocation()) <= radius) {
+          expected.push_back(turtle);
+        }
+      }
+      assert(sorted(all[i]) == sorted(expected));
+    }
+  }
+
+  // Across the corner of a toroidal grid only
+  for (const bool toroidal : {false, true}) {
+    s2l::environment::Environment env(12, 9, toroidal);
+    const auto corner = turtleAt(11.5, 8.5);
+    env.add_turtle(corner);
+    const auto found =
+        env.get_turtles_in_radius(s2l::tools::Point2D(0.5, 0.5), 1.5);
+    assert(found == (toroidal ? Turtles{corner} : Turtles{}));
+  }
+
+  // A cone keeps the turtles ahead, and the ones standing on its apex
+  s2l::environment::Environment env(12, 9, true);
+  const s2l::tools::Point2D center(6.0, 4.0);
+  const auto ahead = turtleAt(7.0, 4.0);
+  const auto behind = turtleAt(5.0, 4.0);
+  const auto apex = turtleAt(6.0, 4.0);
+  env.add_turtle(ahead);
+  env.add_turtle(behind);
+  env.add_turtle(apex);
+  const double heading = env.get_direction(center, ahead->getLocation());
+  assert(sorted(env.get_turtles_in_cone(center, heading, M_PI / 2, 2.0)) ==
+         sorted({ahead, apex}));
+  assert(sorted(env.get_turtles_in_cone(center, heading + M_PI, M_PI / 2,
+                                        2.0)) == sorted({behind, apex}));
+  assert(env.get_turtles_in_cone(center, heading, M_PI / 2, 0.5) ==
+         Turtles{apex});
+
+  std::cout << "Environment radius queries tests PASSED" << std::endl;
+}
+
+// Test the index of the turtles by patch as the turtles come, move and leave
+void testTurtlePatchIndex() {
+  std::cout << "Testing Environment turtle patch index..." << std::endl;
+
+  using Turtle = s2l::model::environment::TurtlePLSInLogo;
+  using Turtles = std::vector<std::shared_ptr<Turtle>>;
+  const int width = 9;
+  const int height = 7;
+  s2l::environment::Environment env(width, height, true);
+  unsigned state = 31415;
+  auto next = [&state](double scale) {
+    state = state * 1103515245u + 12345u;
+    return (state >> 8) % 100000 / 100000.0 * scale;
+  };
+
+  // Every patch against a scan of the locations of the turtles
+  auto check = [&] {
+    std::size_t indexed = 0;
+    for (int x = 0; x < width; ++x) {
+      for (int y = 0; y < height; ++y) {
+        Turtles expected;
+        for (const auto &turtle : env.get_turtles()) {
+          const auto location = turtle->getLocation();
+          if (static_cast<int>(std::floor(location.x)) == x &&
+              static_cast<int>(std::floor(location.y)) == y) {
+            expected.push_back(turtle);
+          }
+        }
+        Turtles visited;
+        env.for_each_turtle_at(
+            x, y, [&](const auto &turtle) { visited.push_back(turtle); });
+        Turtles copied = env.get_turtles_at(x, y);
+        std::sort(expected.begin(), expected.end());
+        std::sort(visited.begin(), visited.end());
+        std::sort(copied.begin(), copied.end());
+        assert(visited == expected);
+        assert(copied == expected);
+        indexed += visited.size();
+      }
+    }
+    assert(indexed == env.get_turtles().size());
+    assert(env.get_turtles_at(-1, 0).empty());
+    assert(env.get_turtles_at(width, height - 1).empty());
+  };
+
+  for (int i = 0; i < 60; ++i) {
+    env.add_turtle(std::make_shared<Turtle>(
+        s2l::tools::Point2D(next(width), next(height)), 0.0, 0.0, 0.0, false,
+        "red"));
+  }
+  check();
+
+  // A turtle moved on its own, then reported
+  const auto moved = env.get_turtles()[7];
+  const auto from = moved->getLocation();
+  moved->setLocation(s2l::tools::Point2D(std::fmod(from.x + 3.0, width),
+                                         std::fmod(from.y + 2.0, height)));
+  env.update_turtle_patch(moved, static_cast<int>(from.x),
+                          static_cast<int>(from.y),
+                          static_cast<int>(moved->getLocation().x),
+                          static_cast<int>(moved->getLocation().y));
+  check();
+
+  // Every turtle moved at once
+  std::vector<double> xs(env.get_turtles().size());
+  std::vector<double> ys(xs.size());
+  for (std::size_t i = 0; i < xs.size(); ++i) {
+    xs[i] = next(width);
+    ys[i] = next(height);
+  }
+  env.set_turtle_locations(xs.data(), ys.data());
+  check();
+
+  // Turtles leaving, some of them sharing a patch with others
+  for (int i = 0; i < 20; ++i) {
+    env.remove_turtle(env.get_turtles()[(i * 7) % env.get_turtles().size()]);
+  }
+  assert(env.get_turtles().size() == 40);
+  check();
+
+  // Concurrent queries sort the stale index once, and read the same turtles
+  env.add_turtle(std::make_shared<Turtle>(s2l::tools::Point2D(4.5, 3.5), 0.0,
+                                          0.0, 0.0, false, "blue"));
+  const Turtles shared = [&] {
+    Turtles turtles;
+    for (const auto &turtle : env.get_turtles()) {
+      if (static_cast<int>(turtle->getLocation().x) == 4 &&
+          static_cast<int>(turtle->getLocation().y) == 3) {
+        turtles.push_back(turtle);
+      }
+    }
+    std::sort(turtles.begin(), turtles.end());
+    return turtles;
+  }();
+  std::atomic<int> mismatches{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&] {
+      for (int k = 0; k < 50; ++k) {
+        Turtles found = env.get_turtles_at(4, 3);
+        std::sort(found.begin(), found.end());
+        if (found != shared) {
+          ++mismatches;
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  assert(mismatches == 0);
+  check();
+
+  std::cout << "Environment turtle patch index tests PASSED" << std::endl;
+}
+
+// Test the interpolated samples and the gradients of a pheromone field
+void testGradientSensing() {
+  std::cout << "Testing Environment gradient sensing..." << std::endl;
+
+  const int width = 10;
+  const int height = 8;
+  auto field = [](double x, double y) { return 3 * x + 7 * y + 1; };
+
+  for (const bool toroidal : {false, true}) {
+    s2l::environment::Environment env(width, height, toroidal);
+    const auto trail = env.add_pheromone("trail", 0.0, 0.0);
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        env.set_pheromone(x, y, trail, field(x, y));
+      }
+    }
+
+    // The cell centres hold the values of the cells
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        assert(env.sample_pheromone(x, y, trail) ==
+               env.get_pheromone_value(x, y, trail));
+      }
+    }
+
+    // Against a bilinear interpolation of the cells, wrapped or clamped
+    // across the borders
+    auto cell = [&](int x, int y) {
+      if (toroidal) {
+        x = (x % width + width) % width;
+        y = (y % height + height) % height;
+      } else {
+        x = std::min(std::max(x, 0), width - 1);
+        y = std::min(std::max(y, 0), height - 1);
+      }
+      return field(x, y);
+    };
+    auto bilinear = [&](double x, double y) {
+      const int x0 = static_cast<int>(std::floor(x));
+      const int y0 = static_cast<int>(std::floor(y));
+      const double tx = x - x0;
+      const double ty = y - y0;
+      const double top = cell(x0, y0) + (cell(x0 + 1, y0) - cell(x0, y0)) * tx;
+      const double bottom =
+          cell(x0, y0 + 1) + (cell(x0 + 1, y0 + 1) - cell(x0, y0 + 1)) * tx;
+      return top + (bottom - top) * ty;
+    };
+    unsigned state = 1618;
+    auto next = [&state](double low, double high) {
+      state = state * 1103515245u + 12345u;
+      return low + (state >> 8) % 100000 / 100000.0 * (high - low);
+    };
+    for (int i = 0; i < 200; ++i) {
+      const double x = next(-0.5, width - 0.5);
+      const double y = next(-0.5, height - 0.5);
+      assert(std::abs(env.sample_pheromone(x, y, trail) - bilinear(x, y)) <
+             1e-9);
+    }
+    // Inside the grid, a linear field is interpolated exactly
+    assert(std::abs(env.sample_pheromone(2.25, 3.5, trail) -
+                    field(2.25, 3.5)) < 1e-9);
+
+    // Left turns toward +y, as the headings of advance_turtles() do
+    const s2l::tools::Point2D point(4.0, 3.0);
+    const auto sample =
+        env.sample_gradient(point, 0.0, M_PI / 2, 1.0, trail);
+    assert(std::abs(sample.ahead - (field(4.0, 3.0) + 3)) < 1e-9);
+    assert(std::abs(sample.left - (field(4.0, 3.0) + 7)) < 1e-9);
+    assert(std::abs(sample.right - (field(4.0, 3.0) - 7)) < 1e-9);
+
+    // The readings of several angles are the samples at their positions
+    const double angles[] = {-1.0, -0.25, 0.0, 0.5, 1.5};
+    double readings[5];
+    const double heading = 0.75;
+    const double distance = 1.25;
+    env.sample_gradient(point, heading, angles, 5, distance, trail, readings);
+    for (int k = 0; k < 5; ++k) {
+      const double expected = env.sample_pheromone(
+          point.x + distance * std::cos(heading + angles[k]),
+          point.y + distance * std::sin(heading + angles[k]), trail);
+      assert(std::abs(readings[k] - expected) < 1e-9);
+    }
+
+    // The samples of every turtle, on the pool of an engine, are those of
+    // its heading
+    std::vector<double> headings;
+    for (int i = 0; i < 60; ++i) {
+      env.add_turtle(std::make_shared<s2l::model::environment::TurtlePLSInLogo>(
+          s2l::tools::Point2D(next(0.0, width), next(0.0, height)), 0.0, 0.5,
+          0.0, false, "red"));
+      headings.push_back(next(-M_PI, M_PI));
+    }
+    env.set_turtle_headings(headings.data());
+    mk::engine::WorkStealingThreadPool pool(4);
+    mk::engine::WorkStealingThreadPool::Scope scope(&pool);
+    const auto all = env.sample_gradient_all(0.6, 1.5, trail);
+    const auto turtles = env.get_turtles();
+    assert(all.size() == turtles.size());
+    for (std::size_t i = 0; i < turtles.size(); ++i) {
+      const auto expected =
+          env.sample_gradient(turtles[i]->getLocation(),
+                              turtles[i]->getHeading(), 0.6, 1.5, trail);
+      assert(std::abs(all[i].left - expected.left) < 1e-3);
+      assert(std::abs(all[i].ahead - expected.ahead) < 1e-3);
+      assert(std::abs(all[i].right - expected.right) < 1e-3);
+    }
+  }
+
+  std::cout << "Environment gradient sensing tests PASSED" << std::endl;
+}
+
+// Test the turtles attached to the TurtleStore of an environment
+void testTurtleStore() {
+  std::cout << "Testing TurtleStore class..." << std::endl;
+
+  auto kept = std::make_shared<s2l::model::environment::TurtlePLSInLogo>(
+      s2l::tools::Point2D(1.5, 1.5), 0.0, 1.0, 0.5, true, "blue");
+  {
+    s2l::environment::Environment env(10, 10, true);
+    env.add_turtle(std::make_shared<s2l::model::environment::TurtlePLSInLogo>(
+        s2l::tools::Point2D(0.5, 0.5), 0.0, 0.0, 0.0, false, "red"));
+    env.add_turtle(kept);
+    assert(kept->getStore() == &env.get_turtle_store());
+    assert(kept->getSlot() == 1);
+
+    // The handle reads and writes the columns of the store
+    kept->setColor("green");
+    assert(env.get_turtle_store().colorName(
+               env.get_turtle_store().color[1]) == "green");
+    env.advance_turtles(2.0);
+    assert(std::abs(env.get_turtle_store().x[1] - 4.5) < 1e-9);
+    assert(std::abs(kept->getSpeed() - 1.5) < 1e-9);
+
+    // Removing a turtle moves the following ones down
+    env.remove_turtle(env.get_turtles()[0]);
+    assert(kept->getSlot() == 0);
+  }
+  // The environment gave the state back to the turtle
+  assert(kept->getStore() == nullptr);
+  assert(std::abs(kept->getLocation().x - 4.5) < 1e-9);
+  assert(kept->getColor() == "green");
+
+  std::cout << "TurtleStore tests PASSED" << std::endl;
+}
+
+// Test the aggregation of the dense crowds of an environment
+void testCrowdAggregation() {
+  std::cout << "Testing crowd aggregation..." << std::endl;
+
+  using s2l::environment::Environment;
+  using s2l::model::environment::TurtlePLSInLogo;
+  Environment env(64, 64, true);
+  bool rejected = false;
+  try {
+    env.enable_crowds(Environment::CrowdSettings{8, 2.0, 2.0});
+  } catch (const std::invalid_argument &) {
+    rejected = true;
+  }
+  assert(rejected && !env.crowds_enabled());
+  env.enable_crowds(Environment::CrowdSettings{8, 4.0, 2.0});
+
+  // 400 red turtles on the 64 patches of a region, moving along x, and a
+  // few sparse ones
+  std::shared_ptr<TurtlePLSInLogo> first;
+  for (int i = 0; i < 400; ++i) {
+    auto turtle = std::make_shared<TurtlePLSInLogo>(
+        s2l::tools::Point2D(8 + i % 8 + 0.5, 8 + i / 8 % 8 + 0.5), 0.0, 1.0,
+        0.0, false, "red");
+    first = first ? first : turtle;
+    env.add_turtle(turtle);
+  }
+  for (int i = 0; i < 10; ++i) {
+    env.add_turtle(std::make_shared<TurtlePLSInLogo>(
+        s2l::tools::Point2D(40.5, i * 6 + 0.5), 0.0, 1.0, 0.0, false,
+        i < 3 ? "red" : "blue"));
+  }
+  env.update_crowds(1);
+  assert(env.get_turtles().size() == 10);
+  assert(first->getStore() == nullptr);
+  assert(env.get_crowd("blue") == nullptr);
+  const s2l::tools::CrowdField *crowd = env.get_crowd("red");
+  assert(crowd && crowd->getMass() == 400.0);
+  assert(env.get_crowd_turtle_count() == 400.0);
+
+  // The crowd flows at the velocity of its turtles, one patch per step
+  for (int step = 0; step < 4; ++step) {
+    env.advance_turtles(1.0);
+  }
+  assert(std::abs(crowd->getMass() - 400.0) < 1e-9);
+  assert(crowd->getMass(12, 8, 8, 8) == 400.0);
+  double vx, vy;
+  crowd->getVelocity(15, 10, vx, vy);
+  assert(std::abs(vx - 1.0) < 1e-9 && std::abs(vy) < 1e-9);
+
+  // Slower than a patch per step, a crowd spreads, keeping its turtles, and
+  // its centre moves at its velocity
+  s2l::tools::CrowdField field(32, 32, false);
+  for (int i = 0; i < 50; ++i) {
+    field.deposit(10.5, 10.5, 0.3, 0.4);
+  }
+  for (int step = 0; step < 10; ++step) {
+    field.advect(1.0);
+  }
+  double centreX = 0, centreY = 0;
+  for (int y = 0; y < 32; ++y) {
+    for (int x = 0; x < 32; ++x) {
+      centreX += (x + 0.5) * field.getDensity(x, y);
+      centreY += (y + 0.5) * field.getDensity(x, y);
+    }
+  }
+  assert(std::abs(field.getMass() - 50.0) < 1e-9);
+  assert(std::abs(centreX / 50.0 - 13.5) < 1e-9);
+  assert(std::abs(centreY / 50.0 - 14.5) < 1e-9);
+  assert(field.getDensity(10, 10) < 1.0);
+
+  // A focus releases the crowd as the turtles aggregated
+  env.set_crowd_focus(10, 10, 8, 4);
+  env.update_crowds(2);
+  assert(env.get_turtles().size() == 410);
+  assert(env.get_crowd_turtle_count() == 0.0);
+  assert(first->getStore() == &env.get_turtle_store());
+  for (const auto &turtle : env.get_turtles()) {
+    const auto location = turtle->getLocation();
+    if (location.x < 40) {
+      assert(location.x >= 12 && location.x < 20);
+      assert(std::abs(turtle->getSpeed() - 1.0) < 1e-9);
+      assert(std::abs(turtle->getHeading()) < 1e-9);
+    }
+  }
+
+  // Out of focus, the dense regions, now two of 200 turtles, aggregate them
+  // again; below the release density, a region releases them
+  env.clear_crowd_focus();
+  env.update_crowds(3);
+  assert(env.get_turtles().size() == 410);
+  env.enable_crowds(Environment::CrowdSettings{8, 3.0, 2.0});
+  env.update_crowds(3);
+  assert(env.get_turtles().size() == 10);
+  env.enable_crowds(Environment::CrowdSettings{8, 8.0, 7.0});
+  env.update_crowds(4);
+  assert(env.get_turtles().size() == 410);
+  env.enable_crowds(Environment::CrowdSettings{8, 3.0, 2.0});
+  env.update_crowds(5);
+  assert(env.get_turtles().size() == 10);
+  env.disable_crowds(6);
+  assert(env.get_turtles().size() == 410 && !env.crowds_enabled());
+  assert(env.get_crowd("red") == nullptr);
+
+  std::cout << "Crowd aggregation tests PASSED" << std::endl;
+}
+
+// Test the marks of the patches kept by a MarkStore
+void testMarkStore() {
+  std::cout << "Testing MarkStore class..." << std::endl;
+
+  using s2l::model::environment::MarkStore;
+  using s2l::model::environment::SimpleMark;
+  MarkStore store(100, 70);
+  auto first = std::make_shared<SimpleMark>(s2l::tools::Point2D(40, 65));
+  auto second = std::make_shared<SimpleMark>(s2l::tools::Point2D(40, 65));
+  assert(store.add(40, 65, first));
+  assert(!store.add(40, 65, first)); // a patch holds a mark once
+  assert(store.add(40, 65, second));
+  assert(!store.add(100, 0, second)); // outside the grid
+  assert(store.size() == 2 && store.countAt(40, 65) == 2);
+  assert(store.countAt(41, 65) == 0 && store.countAt(-1, 0) == 0);
+
+  // The batch methods skip the duplicates and the marks outside the grid
+  const std::uint32_t cell = 10 * 100 + 99;
+  auto added = store.addAll({first, first, second},
+                            {cell, cell, MarkStore::NO_CELL});
+  assert(added[0] && !added[1] && !added[2]);
+  assert(store.size() == 3 && store.getAt(99, 10).front() == first);
+  auto removed = store.removeAll({first, second}, {cell, cell});
+  assert(removed[0] && !removed[1] && store.size() == 2);
+
+  // The entries released are reused
+  assert(store.remove(40, 65, first) && !store.remove(40, 65, first));
+  assert(store.add(0, 0, first));
+  int visited = 0;
+  store.forEach([&](int x, int y, const std::shared_ptr<SimpleMark> &mark) {
+    assert((x == 0 && y == 0 && mark == first) ||
+           (x == 40 && y == 65 && mark == second));
+    ++visited;
+  });
+  assert(visited == 2);
+  store.clear();
+  assert(store.size() == 0 && store.countAt(0, 0) == 0);
+
+  std::cout << "MarkStore tests PASSED" << std::endl;
+}
+
+// Test the sharing of the fields and the marks of a cloned LogoEnvPLS
+void testLogoEnvPLSClone() {
+  std::cout << "Testing LogoEnvPLS clones..." << std::endl;
+
+  using s2l::model::environment::LogoEnvPLS;
+  using s2l::model::environment::Pheromone;
+  using s2l::model::environment::SimpleMark;
+  const Pheromone trail("trail", 0.2, 0.05);
+  const Pheromone food("food", 0.0, 0.0);
+  LogoEnvPLS original(s2l::model::levels::LogoSimulationLevelList::LOGO, 64,
+                      40, true, true, {trail, food});
+  original.setPheromoneValueAt(trail, 3, 4, 2.0);
+  original.setPheromoneValueAt(food, 60, 30, 5.0);
+  auto mark = std::make_shared<SimpleMark>(s2l::tools::Point2D(10.5, 7.5));
+  original.addMark(mark);
+
+  auto clone = std::dynamic_pointer_cast<LogoEnvPLS>(original.clone());
+  assert(original.isPheromoneFieldShared(trail) &&
+         clone->isPheromoneFieldShared(food) && clone->areMarksShared());
+  const LogoEnvPLS &reading = original;
+  const LogoEnvPLS &branch = *clone;
+  assert(&branch.getPheromoneValues(trail) ==
+         &reading.getPheromoneValues(trail));
+
+  // The first write copies the field, for the clone only
+  clone->setPheromoneValueAt(trail, 3, 4, 1.0);
+  assert(!clone->isPheromoneFieldShared(trail) &&
+         clone->isPheromoneFieldShared(food));
+  assert(original.getPheromoneValueAt(trail, 3, 4) == 2.0 &&
+         clone->getPheromoneValueAt(trail, 3, 4) == 1.0 &&
+         clone->getPheromoneValueAt(food, 60, 30) == 5.0);
+
+  // The marks are copied by the original writing them
+  original.removeMark(mark);
+  assert(!original.areMarksShared() && original.getMarksAt(10, 7).empty() &&
+         clone->getMarksAt(10, 7).size() == 1 &&
+         clone->getMarksAt(10, 7).front() == mark);
+
+  std::cout << "LogoEnvPLS clone tests PASSED" << std::endl;
+}
+
+// Test the neighbourhood visitor of LogoEnvPLS against the wrapped offsets
+void testNeighbourhoodVisitor() {
+  std::cout << "Testing LogoEnvPLS neighbourhood visitor..." << std::endl;
+
+  using s2l::model::environment::LogoEnvPLS;
+  const int sizes[][2] = {{7, 5}, {2, 3}, {1, 1}, {12, 9}};
+  for (const auto &size : sizes) {
+    const int width = size[0], height = size[1];
+    for (const bool xTorus : {false, true}) {
+      for (const bool yTorus : {false, true}) {
+        LogoEnvPLS env(s2l::model::levels::LogoSimulationLevelList::LOGO,
+                       width, height, xTorus, yTorus, {});
+        for (int distance : {0, 1, 2, 4, 13}) {
+          for (int x = 0; x < width; ++x) {
+            for (int y = 0; y < height; ++y) {
+              // The offsets, column by column, wrapped along the toroidal
+              // axes and dropped outside the others
+              std::vector<std::pair<int, int>> expected;
+              for (int dx = -distance; dx <= distance; ++dx) {
+                for (int dy = -distance; dy <= distance; ++dy) {
+                  int nx = x + dx, ny = y + dy;
+                  nx = xTorus ? (nx % width + width) % width : nx;
+                  ny = yTorus ? (ny % height + height) % height : ny;
+                  if (nx >= 0 && nx < width && ny >= 0 && ny < height) {
+                    expected.emplace_back(nx, ny);
+                  }
+                }
+              }
+              std::vector<std::pair<int, int>> visited;
+              env.forEachNeighbor(x, y, distance, [&](int nx, int ny) {
+                visited.emplace_back(nx, ny);
+              });
+              assert(visited == expected);
+              const auto neighbors = env.getNeighbors(x, y, distance);
+              assert(neighbors.size() == expected.size());
+              for (std::size_t i = 0; i < neighbors.size(); ++i) {
+                assert(neighbors[i].x == expected[i].first &&
+                       neighbors[i].y == expected[i].second);
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  std::cout << "LogoEnvPLS neighbourhood visitor tests PASSED" << std::endl;
+}
+
+// Test the coalescing of the additive influences by the Reaction
+void testReactionCoalescing() {
+  std::cout << "Testing Reaction coalescing..." << std::endl;
+
+  using s2l::model::environment::TurtlePLSInLogo;
+  const mk::SimulationTimeStamp t0(0);
+  const mk::SimulationTimeStamp t1(1);
+  // The same influences applied one by one, then summed per turtle
+  auto run = [&](bool coalescing) {
+    s2l::environment::Environment env(20, 20, true);
+    auto first = std::make_shared<TurtlePLSInLogo>(
+        s2l::tools::Point2D(1.5, 1.5), 1.0, 0.5, 0.0, false, "red");
+    auto second = std::make_shared<TurtlePLSInLogo>(
+        s2l::tools::Point2D(5.5, 5.5), 2.0, -1.0, 0.0, false, "blue");
+    env.add_turtle(first);
+    env.add_turtle(second);
+    std::vector<std::shared_ptr<mk::influences::IInfluence>> influences{
+        std::make_shared<s2l::influences::ChangeDirection>(t0, t1, 0.1,
+                                                           first),
+        std::make_shared<s2l::influences::ChangeSpeed>(t0, t1, 1.0, first),
+        std::make_shared<s2l::influences::ChangeDirection>(t0, t1, 0.2,
+                                                           second),
+        std::make_shared<s2l::influences::ChangeDirection>(t0, t1, 0.3,
+                                                           first),
+        std::make_shared<s2l::influences::ChangeSpeed>(t0, t1, -0.25, first),
+        std::make_shared<s2l::influences::ChangeAcceleration>(t0, t1, 0.5,
+                                                              second),
+        std::make_shared<s2l::influences::ChangeAcceleration>(t0, t1, 0.25,
+                                                              second)};
+    s2l::reaction::Reaction reaction;
+    reaction.setCoalescing(coalescing);
+    assert(reaction.isCoalescing() == coalescing);
+    reaction.apply(influences, env);
+    return std::vector<double>{first->getHeading(),  first->getSpeed(),
+                               second->getHeading(), second->getSpeed(),
+                               second->getAcceleration()};
+  };
+  // The store may keep the state in single precision, rounded at each write
+  const auto separate = run(false);
+  const auto coalesced = run(true);
+  for (std::size_t i = 0; i < separate.size(); ++i) {
+    assert(std::abs(separate[i] - coalesced[i]) < 1e-6);
+  }
+  assert(std::abs(coalesced[0] - (1.0 + 0.4)) < 1e-6 &&
+         coalesced[1] == 1.25 && coalesced[4] == 0.75);
+
+  std::cout << "Reaction coalescing tests PASSED" << std::endl;
+}
+
+// Test the parallel resolution of the moves competing for the cells
+void testMoveResolution() {
+  std::cout << "Testing MoveResolver..." << std::endl;
+
+  using s2l::tools::EmptyCellIndex;
+  using s2l::tools::MoveResolver;
+  EmptyCellIndex empty;
+  empty.assign(6, [](std::size_t cell) { return cell % 2 == 0; });
+  assert(empty.size() == 3 && empty.contains(1) && !empty.contains(2));
+  empty.erase(1);
+  empty.insert(2);
+  empty.insert(2);
+  assert(empty.size() == 3 && !empty.contains(1) && empty.contains(2) &&
+         empty.contains(5));
+
+  // The lowest priority wins a cell, ties going to the lowest claimant
+  MoveResolver resolver;
+  std::vector<unsigned char> won;
+  resolver.resolve(10, {5, 5, 7, MoveResolver::NO_CELL, 7},
+                   {2ULL << 32, 1ULL << 32, 3ULL << 32, 0, 3ULL << 32}, won);
+  assert((won == std::vector<unsigned char>{0, 1, 1, 0, 0}));
+
+  // Every agent of a full half of the grid relocates when the cells allow,
+  // the same way whatever the threads
+  const std::size_t cells = 1000;
+  std::vector<std::uint32_t> origins;
+  for (std::uint32_t cell = 0; cell < 600; ++cell) {
+    origins.push_back(cell);
+  }
+  auto relocate = [&](std::vector<std::uint32_t> &destinations) {
+    EmptyCellIndex free;
+    free.assign(cells, [](std::size_t cell) { return cell < 600; });
+    const std::size_t moved = resolver.relocate(origins, free, 42,
+                                                destinations);
+    assert(free.size() == cells - 600);
+    return moved;
+  };
+  std::vector<std::uint32_t> serial;
+  const std::size_t moved = relocate(serial);
+  std::vector<unsigned char> taken(cells, 0);
+  std::size_t counted = 0;
+  for (std::size_t agent = 0; agent < origins.size(); ++agent) {
+    const std::uint32_t cell = serial[agent] == MoveResolver::NO_CELL
+                                   ? origins[agent]
+                                   : serial[agent];
+    assert(!taken[cell]);
+    taken[cell] = 1;
+    counted += serial[agent] != MoveResolver::NO_CELL;
+  }
+  assert(moved == counted && moved > 550);
+  mk::engine::WorkStealingThreadPool pool(4);
+  mk::engine::WorkStealingThreadPool::Scope scope(&pool);
+  std::vector<std::uint32_t> parallel;
+  assert(relocate(parallel) == moved && parallel == serial);
+
+  // The turtles of an environment move to the centers of empty patches
+  s2l::environment::Environment env(10, 10, true);
+  std::vector<std::shared_ptr<s2l::model::environment::TurtlePLSInLogo>>
+      turtles;
+  for (int i = 0; i < 4; ++i) {
+    auto turtle = std::make_shared<s2l::model::environment::TurtlePLSInLogo>(
+        s2l::tools::Point2D(i < 3 ? 2.5 : 7.25, 3.5), 0.0, 0.0, 0.0, false,
+        "red");
+    env.add_turtle(turtle);
+    turtles.push_back(turtle);
+  }
+  assert(env.relocate_turtles(turtles, 7) == 4);
+  std::set<std::pair<double, double>> patches;
+  for (const auto &turtle : turtles) {
+    const auto location = turtle->getLocation();
+    assert(location.x - std::floor(location.x) == 0.5 &&
+           location.y - std::floor(location.y) == 0.5 &&
+           !(location.x == 2.5 && location.y == 3.5));
+    patches.insert({location.x, location.y});
+    assert(env.get_turtles_at(static_cast<int>(location.x),
+                              static_cast<int>(location.y))
+               .size() == 1);
+  }
+  assert(patches.size() == 4);
+
+  std::cout << "MoveResolver tests PASSED" << std::endl;
+}
+
+// Test the change tracking of Environment
+void testEnvironmentChanges() {
+  std::cout << "Testing Environment change tracking..." << std::endl;
+
+  s2l::environment::Environment env(100, 100, true);
+  const auto pheromone = env.add_pheromone("pheromone");
+  auto turtle = std::make_shared<s2l::model::environment::TurtlePLSInLogo>(
+      s2l::tools::Point2D(1.5, 1.5), 0.0, 0.0, 0.0, false, "red");
+  env.add_turtle(turtle);
+  assert(!env.get_changes_since(mk::SimulationTimeStamp(0)).complete);
+
+  // The first commit is the baseline of the changes
+  env.set_change_history(2);
+  env.commit_changes(mk::SimulationTimeStamp(0));
+  env.set_pheromone(40, 70, pheromone, 1.0);
+  auto mark = std::make_shared<s2l::model::environment::SimpleMark>(
+      s2l::tools::Point2D(3, 4));
+  env.add_mark(3, 4, mark);
+  env.commit_changes(mk::SimulationTimeStamp(1));
+  turtle->setHeading(1.0);
+  env.remove_mark(3, 4, mark);
+  env.commit_changes(mk::SimulationTimeStamp(2));
+
+  auto changes = env.get_changes_since(mk::SimulationTimeStamp(0));
+  assert(changes.complete && changes.until == 2);
+  assert(changes.pheromones.size() == 1);
+  const auto &tiles = changes.pheromones[0];
+  assert(tiles.tiles.size() == 1 &&
+         tiles.tiles[0] == 2 * 4 + 1); // the tile (1, 2) of a 4x4 grid
+  assert(tiles.values[(70 - 64) * 32 + (40 - 32)] == 1.0);
+  assert(changes.marks.size() == 2 && changes.marks[0].added &&
+         !changes.marks[1].added);
+  assert(changes.turtles.size() == 1 && changes.turtles[0].turtle == turtle);
+
+  changes = env.get_changes_since(mk::SimulationTimeStamp(1));
+  assert(changes.pheromones.empty() && changes.marks.size() == 1);
+  env.remove_turtle(turtle);
+  env.commit_changes(mk::SimulationTimeStamp(3));
+  changes = env.get_changes_since(mk::SimulationTimeStamp(2));
+  assert(changes.turtles.empty() && changes.removed_turtles.size() == 1);
+
+  // The history keeps the last 2 commits
+  assert(!env.get_changes_since(mk::SimulationTimeStamp(0)).complete);
+
+  std::cout << "Environment change tracking tests PASSED" << std::endl;
+}
+
+// Test the reordering of the turtles along a space-filling curve
+void testTurtleReordering() {
+  std::cout << "Testing turtle reordering..." << std::endl;
+
+  using s2l::tools::SpaceFillingCurve;
+  assert(SpaceFillingCurve::mortonIndex(3, 0) == 5 &&
+         SpaceFillingCurve::mortonIndex(0, 1) == 2);
+  assert(SpaceFillingCurve::bitsFor(40, 30) == 6 &&
+         SpaceFillingCurve::bitsFor(1, 1) == 0);
+  // The consecutive patches of the Hilbert curve are adjacent
+  std::vector<std::pair<int, int>> curve(64 * 64);
+  for (int y = 0; y < 64; ++y) {
+    for (int x = 0; x < 64; ++x) {
+      curve[SpaceFillingCurve::hilbertIndex(x, y, 6)] = {x, y};
+    }
+  }
+  for (std::size_t i = 1; i < curve.size(); ++i) {
+    assert(std::abs(curve[i].first - curve[i - 1].first) +
+               std::abs(curve[i].second - curve[i - 1].second) ==
+           1);
+  }
+
+  s2l::environment::Environment env(40, 30, true);
+  env.set_change_history(2);
+  std::vector<std::shared_ptr<s2l::model::environment::TurtlePLSInLogo>>
+      turtles;
+  for (int i = 0; i < 12; ++i) {
+    turtles.push_back(std::make_shared<s2l::model::environment::TurtlePLSInLogo>(
+        s2l::tools::Point2D((i * 17) % 40 + 0.5, (i * 11) % 30 + 0.5), 0.0,
+        0.0, 0.0, false, "red"));
+    env.add_turtle(turtles.back());
+  }
+  env.commit_changes(mk::SimulationTimeStamp(0));
+  const std::vector<std::uint64_t> ids = env.get_turtle_store().id;
+
+  env.reorder_turtles();
+  const auto &store = env.get_turtle_store();
+  std::uint64_t last = 0;
+  for (std::size_t slot = 0; slot < store.size(); ++slot) {
+    const auto &turtle = env.get_turtles()[slot];
+    assert(turtle->getSlot() == slot);
+    const std::uint64_t key = SpaceFillingCurve::hilbertIndex(
+        static_cast<std::uint32_t>(store.x[slot]),
+        static_cast<std::uint32_t>(store.y[slot]), 6);
+    assert(key >= last);
+    last = key;
+    // The turtles keep their identifiers and patches
+    const std::size_t index =
+        std::find(turtles.begin(), turtles.end(), turtle) - turtles.begin();
+    assert(store.id[slot] == ids[index]);
+    const auto here =
+        env.get_turtles_at(static_cast<int>(turtle->getLocation().x),
+                           static_cast<int>(turtle->getLocation().y));
+    assert(std::find(here.begin(), here.end(), turtle) != here.end());
+  }
+  assert(!std::is_sorted(store.id.begin(), store.id.end()));
+
+  // The changes are still tracked by identifier
+  turtles[3]->setHeading(1.0);
+  env.remove_turtle(turtles[7]);
+  env.commit_changes(mk::SimulationTimeStamp(1));
+  auto changes = env.get_changes_since(mk::SimulationTimeStamp(0));
+  assert(changes.complete && changes.turtles.size() == 1 &&
+         changes.turtles[0].turtle == turtles[3]);
+  assert(changes.removed_turtles.size() == 1 &&
+         changes.removed_turtles[0] == ids[7]);
+
+  // The period reorders the turtles as they advance
+  env.set_turtle_reorder_period(1);
+  turtles[0]->setSpeed(10.0);
+  env.advance_turtles(1.0);
+  last = 0;
+  for (std::size_t slot = 0; slot < store.size(); ++slot) {
+    const std::uint64_t key = SpaceFillingCurve::hilbertIndex(
+        static_cast<std::uint32_t>(store.x[slot]),
+        static_cast<std::uint32_t>(store.y[slot]), 6);
+    assert(key >= last);
+    last = key;
+  }
+
+  // The engines order the agents by the patches of their turtles
+  s2l::agents::LogoAgent agent(mk::AgentCategory("turtle"));
+  s2l::agents::LogoAgent lost(mk::AgentCategory("turtle"));
+  const s2l::model::environment::TurtlePLSInLogo turtle(
+      s2l::tools::Point2D(5.5, 9.25), 0.0, 0.0, 0.0, false, "red");
+  const s2l::agents::TurtleOrdering ordering(
+      [&](const mk::agents::IAgent4Engine &of) {
+        return &of == &agent ? &turtle : nullptr;
+      },
+      40, 30);
+  assert(ordering.keyOf(agent) == SpaceFillingCurve::hilbertIndex(5, 9, 6));
+  assert(ordering.keyOf(lost) == std::numeric_limits<std::uint64_t>::max());
+
+  std::cout << "Turtle reordering tests PASSED" << std::endl;
+}
+
+// A perception model perceiving nothing, the tests setting the perceived
+// data of the agents themselves
+class NullPerceptionModel
+    : public fr::univ_artois::lgi2a::similar::extendedkernel::agents::
+          IAgtPerceptionModel {
+  mk::LevelIdentifier level;
+
+public:
+  explicit NullPerceptionModel(const mk::LevelIdentifier &level)
+      : level(level) {}
+  mk::LevelIdentifier getLevel() const override { return level; }
+  std::shared_ptr<mk::agents::IPerceivedData>
+  perceive(const mk::SimulationTimeStamp &, const mk::SimulationTimeStamp &,
+           const std::map<mk::LevelIdentifier,
+                          std::shared_ptr<mk::agents::ILocalStateOfAgent>> &,
+           std::shared_ptr<mk::agents::ILocalStateOfAgent>,
+           std::shared_ptr<mk::dynamicstate::IPublicDynamicStateMap>) override {
+    return nullptr;
+  }
+};
+
+// Test BatchDecisionModel
+void testBatchDecisionModel() {
+  std::cout << "Testing BatchDecisionModel..." << std::endl;
+
+  using s2l::agents::LogoAgent;
+  const mk::LevelIdentifier level("batch_level");
+  const mk::SimulationTimeStamp lower(0), upper(1);
+  std::size_t calls = 0;
+  auto model = std::make_shared<LogoAgent::BatchDecisionModel>(
+      level, std::vector<std::string>{"food", "home"},
+      [&](const LogoAgent::BatchPerception &perception,
+          LogoAgent::BatchDecisions &decisions) {
+        ++calls;
+        assert(perception.rows.size() == 2);
+        assert(perception.pheromones.size() == 4);
+        for (std::size_t i = 0; i < perception.rows.size(); ++i) {
+          // turn the turtles smelling food, speed up the others
+          if (perception.pheromones[i * 2] > 0) {
+            decisions.headingDeltas[i] = 0.5;
+          } else {
+            decisions.speedDeltas[i] = perception.rows[i].x;
+          }
+        }
+      });
+
+  std::vector<std::shared_ptr<mk::agents::IAgent4Engine>> agents;
+  std::vector<std::shared_ptr<LogoAgent::LogoPerceivedData>> perceived;
+  for (int i = 0; i < 3; ++i) {
+    auto agent = std::make_shared<LogoAgent>(mk::AgentCategory("turtle"));
+    auto turtle = std::make_shared<s2l::model::environment::TurtlePLSInLogo>(
+        s2l::tools::Point2D(i + 1, 0), 0.0, 1.0, 0.0, false, "red");
+    auto data = std::make_shared<LogoAgent::LogoPerceivedData>(
+        level, lower, upper, turtle->getLocation(), 0.0, 1.0);
+    data->setTurtle(turtle);
+    if (i == 0) {
+      data->setPheromone("food", 2.0);
+    }
+    agent->setPerceivedData(data);
+    // the last agent decides with another model
+    agent->specifyBehaviorForLevel(
+        level, std::make_shared<NullPerceptionModel>(level),
+        i < 2 ? model
+              : std::make_shared<LogoAgent::BatchDecisionModel>(
+                    level, std::vector<std::string>{}, nullptr));
+    agents.push_back(agent);
+    perceived.push_back(data);
+  }
+
+  model->perceived(lower, upper, agents.data(), agents.size());
+  assert(calls == 1);
+  const auto &rows = model->getPerception().rows;
+  assert(rows[0].x == 1.0 && rows[1].x == 2.0 && rows[0].nearbyTurtles == 0);
+  assert(model->getPerception().pheromones[0] == 2.0);
+  assert(model->getPerception().pheromones[1] == 0.0);
+
+  // Each turtle emits the influences of its row only
+  auto influences = std::make_shared<mk::influences::InfluencesMap>();
+  model->decide(lower, upper, nullptr, nullptr, nullptr, perceived[0],
+                influences);
+  auto emitted = influences->getInfluencesForLevel(level);
+  assert(emitted.size() == 1);
+  auto turn = std::dynamic_pointer_cast<s2l::influences::ChangeDirection>(
+      emitted.front());
+  assert(turn && turn->getDd() == 0.5 &&
+         turn->getTarget() == perceived[0]->getTurtle());
+
+  influences = std::make_shared<mk::influences::InfluencesMap>();
+  model->decide(lower, upper, nullptr, nullptr, nullptr, perceived[1],
+                influences);
+  emitted = influences->getInfluencesForLevel(level);
+  assert(emitted.size() == 1);
+  auto accelerate = std::dynamic_pointer_cast<s2l::influences::ChangeSpeed>(
+      emitted.front());
+  assert(accelerate && accelerate->getDs() == 2.0);
+
+  influences = std::make_shared<mk::influences::InfluencesMap>();
+  model->decide(lower, upper, nullptr, nullptr, nullptr, perceived[2],
+                influences);
+  assert(influences->isEmpty());
+
+  std::cout << "BatchDecisionModel tests PASSED" << std::endl;
+}
+
+// A kernel as the DSL compiler generates: turn on the first pheromone,
+// else speed up by the step
+void turnOnPheromone(const s2l::agents::LogoAgent::BatchPerception::Row *rows,
+                     std::size_t count, const double *pheromones,
+                     std::size_t pheromoneCount, long step,
+                     double *headingDeltas, double *speedDeltas) {
+  for (std::size_t i = 0; i < count; ++i) {
+    if (pheromones[i * pheromoneCount] > 0) {
+      headingDeltas[i] = rows[i].x;
+    } else {
+      speedDeltas[i] = static_cast<double>(step);
+    }
+  }
+}
+
+// Test the models of the compiled behaviors
+void testCompiledBehavior() {
+  std::cout << "Testing CompiledBehavior..." << std::endl;
+
+  using s2l::agents::LogoAgent;
+  const mk::LevelIdentifier level("compiled_level");
+  const mk::SimulationTimeStamp lower(7), upper(8);
+  auto model = s2l::agents::makeCompiledBehavior(
+      level, &turnOnPheromone, std::vector<std::string>{"food"});
+
+  std::vector<std::shared_ptr<mk::agents::IAgent4Engine>> agents;
+  std::vector<std::shared_ptr<LogoAgent::LogoPerceivedData>> perceived;
+  for (int i = 0; i < 2; ++i) {
+    auto agent = std::make_shared<LogoAgent>(mk::AgentCategory("turtle"));
+    auto turtle = std::make_shared<s2l::model::environment::TurtlePLSInLogo>(
+        s2l::tools::Point2D(i + 2, 0), 0.0, 1.0, 0.0, false, "red");
+    auto data = std::make_shared<LogoAgent::LogoPerceivedData>(
+        level, lower, upper, turtle->getLocation(), 0.0, 1.0);
+    data->setTurtle(turtle);
+    if (i == 0) {
+      data->setPheromone("food", 1.0);
+    }
+    agent->setPerceivedData(data);
+    agent->specifyBehaviorForLevel(
+        level, std::make_shared<NullPerceptionModel>(level), model);
+    agents.push_back(agent);
+    perceived.push_back(data);
+  }
+  model->perceived(lower, upper, agents.data(), agents.size());
+  assert(model->getPerception().step == 7);
+
+  auto influences = std::make_shared<mk::influences::InfluencesMap>();
+  model->decide(lower, upper, nullptr, nullptr, nullptr, perceived[0],
+                influences);
+  auto emitted = influences->getInfluencesForLevel(level);
+  assert(emitted.size() == 1);
+  auto turn = std::dynamic_pointer_cast<s2l::influences::ChangeDirection>(
+      emitted.front());
+  assert(turn && turn->getDd() == 2.0);
+  influences = std::make_shared<mk::influences::InfluencesMap>();
+  model->decide(lower, upper, nullptr, nullptr, nullptr, perceived[1],
+                influences);
+  emitted = influences->getInfluencesForLevel(level);
+  assert(emitted.size() == 1);
+  auto accelerate = std::dynamic_pointer_cast<s2l::influences::ChangeSpeed>(
+      emitted.front());
+  assert(accelerate && accelerate->getDs() == 7.0);
+
+  // The libraries that cannot be loaded are reported
+  bool failed = false;
+  try {
+    s2l::agents::CompiledBehaviorLibrary library(
+        "/nonexistent/similar2logo_kernel.so");
+  } catch (const std::runtime_error &) {
+    failed = true;
+  }
+  assert(failed);
+  failed = false;
+  try {
+    s2l::agents::makeCompiledBehavior(level, nullptr, {});
+  } catch (const std::invalid_argument &) {
+    failed = true;
+  }
+  assert(failed);
+
+  std::cout << "CompiledBehavior tests PASSED" << std::endl;
+}
+
+// Test SpatialHashGrid against a scan of all the points
+void testSpatialHashGrid() {
+  std::cout << "Testing SpatialHashGrid..." << std::endl;
+
+  for (const bool toroidal : {false, true}) {
+    // 23 is not a multiple of the cell size
+    s2l::tools::SpatialHashGrid grid(5.0, 23.0, 17.0, toroidal);
+    std::vector<double> xs, ys;
+    unsigned state = 12345;
+    auto next = [&state](double scale) {
+      state = state * 1103515245u + 12345u;
+      return (state >> 8) % 100000 / 100000.0 * scale;
+    };
+    for (int i = 0; i < 300; ++i) {
+      xs.push_back(next(23.0));
+      ys.push_back(next(17.0));
+    }
+    grid.rebuild(xs.data(), ys.data(), xs.size());
+    // moves, removals and insertions after the bulk build
+    grid.update(3, 22.9, 0.1);
+    xs[3] = 22.9;
+    ys[3] = 0.1;
+    grid.remove(7);
+    grid.insert(400, 0.5, 16.5);
+    assert(grid.size() == 300 && !grid.contains(7) && grid.contains(400));
+
+    for (int q = 0; q < 50; ++q) {
+      const double x = next(23.0), y = next(17.0), radius = next(9.0);
+      auto found = grid.queryRadius(x, y, radius, 5);
+      std::unordered_set<std::uint32_t> keys;
+      for (const auto &hit : found) {
+        assert(keys.insert(hit.first).second);
+      }
+      std::size_t expected = 0;
+      for (std::uint32_t key = 0; key <= 400; ++key) {
+        double px, py;
+        if (key < 300) {
+          px = xs[key];
+          py = ys[key];
+        } else if (key == 400) {
+          px = 0.5;
+          py = 16.5;
+        } else {
+          continue;
+        }
+        if (key == 5 || key == 7) {
+          continue;
+        }
+        const double distance = s2l::tools::MathUtil::toroidalDistance(
+            s2l::tools::Point2D(px, py), s2l::tools::Point2D(x, y), 23.0,
+            17.0, toroidal, toroidal);
+        // points on the boundary may go either way
+        if (std::abs(distance - radius) < 1e-9) {
+          expected += keys.count(key);
+          continue;
+        }
+        if (distance < radius) {
+          assert(keys.count(key) == 1);
+          ++expected;
+        }
+      }
+      assert(expected == found.size());
+    }
+  }
+
+  // A point across the border of a torus is near
+  s2l::tools::SpatialHashGrid torus(4.0, 10.0, 10.0, true);
+  torus.insert(0, 9.5, 5.0);
+  auto found = torus.queryRadius(-0.5, 5.0, 1.5);
+  assert(found.size() == 1 && std::abs(found[0].second - 0.0) < 1e-12);
+
+  std::cout << "SpatialHashGrid tests PASSED" << std::endl;
+}
+
+// Test the decision buffer shared by the decision processes
+void testSharedDecisionBuffer() {
+  std::cout << "Testing SharedDecisionBuffer..." << std::endl;
+
+  using s2l::environment::SharedDecisionBuffer;
+  const std::string name = "/s2l_core_tests_" + std::to_string(getpid());
+  {
+    auto owner = SharedDecisionBuffer::create(name, 4, 1);
+    auto worker = SharedDecisionBuffer::attach(name);
+    assert(owner.is_owner() && !worker.is_owner());
+    assert(worker.capacity() == 4 && worker.pheromone_count() == 1);
+
+    s2l::environment::Environment env(20, 20, true);
+    const auto pheromone = env.add_pheromone("pheromone", 0.1, 0.1);
+    env.set_pheromone(3.5, 4.5, pheromone, 5.0);
+    auto first = std::make_shared<s2l::model::environment::TurtlePLSInLogo>(
+        s2l::tools::Point2D(3.5, 4.5), 1.0, 0.5, 0.0, false, "red");
+    auto second = std::make_shared<s2l::model::environment::TurtlePLSInLogo>(
+        s2l::tools::Point2D(10.5, 10.5), 2.0, 0.25, 0.0, false, "red");
+    env.add_turtle(first);
+    env.add_turtle(second);
+    owner.publish(env, {pheromone});
+    // the worker maps the same memory
+    assert(worker.count() == 2 && worker.step() == 1);
+    assert(worker.x()[0] == 3.5 && worker.y()[1] == 10.5);
+    assert(worker.heading()[1] == 2.0 && worker.speed()[0] == 0.5);
+    assert(worker.pheromones()[0] == 5.0 && worker.pheromones()[1] == 0.0);
+
+    worker.heading_deltas()[0] = 0.5;
+    worker.speed_deltas()[0] = 0.25;
+    worker.speed_deltas()[1] = -1.0;
+    owner.apply(env);
+    assert(std::abs(first->getHeading() - 1.5) < 1e-12);
+    assert(first->getSpeed() == 0.75);
+    assert(second->getHeading() == 2.0 && second->getSpeed() == 0.0);
+    // each publication clears the decisions
+    owner.publish(env, {pheromone});
+    assert(worker.step() == 2 && worker.speed_deltas()[0] == 0.0);
+
+    bool rejected = false;
+    try {
+      owner.set_count(5);
+    } catch (const std::length_error &) {
+      rejected = true;
+    }
+    assert(rejected);
+  }
+  // the owner unlinked the segment
+  bool missing = false;
+  try {
+    SharedDecisionBuffer::attach(name);
+  } catch (const std::system_error &) {
+    missing = true;
+  }
+  assert(missing);
+
+  std::cout << "SharedDecisionBuffer tests PASSED" << std::endl;
+}
+
+// Test the binary frames of the web view
+void testFrameEncoder() {
+  std::cout << "Testing FrameEncoder..." << std::endl;
+
+  using s2l::tools::FrameEncoder;
+  auto u16 = [](const std::vector<std::uint8_t> &f, std::size_t at) {
+    return static_cast<unsigned>(f[at] | f[at + 1] << 8);
+  };
+  auto u32 = [&](const std::vector<std::uint8_t> &f, std::size_t at) {
+    return u16(f, at) | u16(f, at + 2) << 16;
+  };
+
+  FrameEncoder encoder(100, 50, 4);
+  const double x[] = {0.0, 50.0, 100.0};
+  const double y[] = {25.0, -1.0, 49.99};
+  const double headings[] = {0.0, -s2l::tools::MathUtil::PI / 2, 1e-9};
+  const std::uint8_t colors[] = {encoder.colorIndex("red"),
+                                 encoder.colorIndex("blue"),
+                                 encoder.colorIndex("red")};
+  assert(colors[0] == 0 && colors[1] == 1 && colors[2] == 0);
+  std::vector<double> grid(6 * 5, 0.0);
+  grid[1 * 6 + 5] = 10.0; // the cell (5, 1), in the tile 1
+  const double *values[] = {grid.data()};
+  encoder.addPheromone("food", 6, 5, 10.0);
+
+  auto frame = encoder.encode(7, x, y, headings, colors, 3, values);
+  assert(u32(frame, 0) == FrameEncoder::MAGIC && frame[4] == 1);
+  assert(frame[5] == (FrameEncoder::PALETTE | FrameEncoder::KEYFRAME));
+  assert(u16(frame, 6) == 1 && u32(frame, 8) == 7 && u32(frame, 12) == 3);
+  // the palette: 2 colors, "red" and "blue", padded to 4 bytes
+  std::size_t at = FrameEncoder::HEADER_SIZE;
+  assert(u16(frame, at) == 2 && frame[at + 2] == 3 && frame[at + 6] == 4);
+  at += 12;
+  assert(u16(frame, at) == 0 && u16(frame, at + 2) == 32768 &&
+         u16(frame, at + 4) == 65535);
+  assert(u16(frame, at + 6) == 32768 && u16(frame, at + 8) == 0);
+  at += 12;
+  assert(frame[at] == 0 && frame[at + 1] == 192 && frame[at + 2] == 0);
+  assert(frame[at + 3] == 0 && frame[at + 4] == 1);
+  at += 8;
+  // the pheromone: "food", 6 x 5 cells in tiles of 4, with one tile
+  assert(frame[at] == 4 && frame[at + 1] == 'f');
+  at += 8;
+  assert(u16(frame, at) == 6 && u16(frame, at + 2) == 5 &&
+         u16(frame, at + 8) == 4);
+  at += 12;
+  assert(u32(frame, at) == 1 && u32(frame, at + 4) == 1);
+  assert(frame[at + 8 + 1 * 4 + 1] == 255 && frame[at + 8 + 1 * 4 + 2] == 0);
+  assert(frame.size() == at + 8 + 16);
+
+  // the next frame only holds the changed tiles, without the palette
+  frame = encoder.encode(8, x, y, headings, colors, 3, values);
+  assert(frame[5] == 0);
+  at = FrameEncoder::HEADER_SIZE + 12 + 8;
+  assert(u32(frame, at) == 0 && frame.size() == at + 4);
+  grid[4 * 6 + 0] = 5.0; // the cell (0, 4), in the tile 2
+  grid[1 * 6 + 5] = 0.0;
+  frame = encoder.encode(9, x, y, headings, colors, 3, values);
+  assert(u32(frame, at) == 2 && u32(frame, at + 4) == 1 &&
+         u32(frame, at + 24) == 2 && frame[at + 28] == 128);
+
+  // a new color or a new client resends the palette
+  encoder.colorIndex("green");
+  assert(encoder.encode(10, x, y, headings, colors, 3, values)[5] ==
+         FrameEncoder::PALETTE);
+  encoder.requestKeyframe();
+  assert(encoder.encode(11, x, y, headings, colors, 3, values)[5] ==
+         (FrameEncoder::PALETTE | FrameEncoder::KEYFRAME));
+
+  std::cout << "FrameEncoder tests PASSED" << std::endl;
+}
+
+void testHeatmapTileRenderer() {
+  std::cout << "Testing HeatmapTileRenderer..." << std::endl;
+
+  using s2l::tools::HeatmapTileRenderer;
+  // 40 x 36 cells in tiles of 16: zooms of 10 x 9, 20 x 18 and 40 x 36
+  HeatmapTileRenderer renderer(16);
+  renderer.addLayer("food", 40, 36, 10.0);
+  assert(renderer.hasLayer("food") && renderer.getMaxZoom("food") == 2);
+  assert(renderer.describeLayers().find("\"maxZoom\":2") !=
+         std::string::npos);
+
+  auto tile = renderer.getTile("food", 2, 0, 0);
+  assert(tile.data && tile.data->compare(1, 3, "PNG") == 0 &&
+         tile.version == 1);
+  assert(renderer.getTile("food", 2, 0, 0).data == tile.data &&
+         renderer.getEncodedTileCount() == 1);
+  assert(!renderer.getTile("food", 2, 3, 0).data &&
+         !renderer.getTile("food", 3, 0, 0).data &&
+         !renderer.getTile("trail", 0, 0, 0).data);
+
+  // A change marks its tile at every zoom, the others keep their version
+  s2l::tools::TiledField field;
+  field.assign(40, 36, 0.0);
+  assert(renderer.update("food", field) == 0);
+  field.set(39, 35, 5.0);
+  assert(renderer.update("food", field) == 1);
+  assert(renderer.getTile("food", 2, 0, 0).version == 1 &&
+         renderer.getEncodedTileCount() == 1);
+  assert(renderer.getTile("food", 2, 2, 2).version == 2 &&
+         renderer.getTile("food", 1, 1, 1).version == 2 &&
+         renderer.getTile("food", 0, 0, 0).version == 2);
+  assert(renderer.getEncodedTileCount() == 4);
+  assert(renderer.update("food", field) == 0);
+
+  // The cleared cell of a tile that was active is compared too
+  field.set(39, 35, 0.0);
+  field.active.assign(field.active.size(), 0);
+  assert(renderer.update("food", field) == 1 &&
+         renderer.getTile("food", 2, 2, 2).version == 3);
+  std::vector<double> values(40 * 36, 0.0);
+  values[0] = 10.0;
+  assert(renderer.update("food", values.data()) == 1 &&
+         renderer.getTile("food", 2, 0, 0).version == 2);
+
+  bool threw = false;
+  try {
+    renderer.addLayer("food", 4, 4, 1.0);
+  } catch (const std::invalid_argument &) {
+    threw = true;
+  }
+  assert(threw);
+
+  std::cout << "HeatmapTileRenderer tests PASSED" << std::endl;
+}
+
+// Test the fields of the perceived data computed on their first read
+void testLazyPerceivedData() {
+  std::cout << "Testing lazy LogoPerceivedData..." << std::endl;
+
+  using s2l::agents::LogoAgent;
+  LogoAgent::LogoPerceivedData data(mk::LevelIdentifier("logo"),
+                                    mk::SimulationTimeStamp(0),
+                                    mk::SimulationTimeStamp(1),
+                                    s2l::tools::Point2D(1, 2), 0.5, 1.0);
+  int scans = 0;
+  data.deferNearbyTurtles(
+      [&](std::vector<LogoAgent::LogoPerceivedData::NearbyTurtle> &nearby) {
+        ++scans;
+        nearby.push_back({s2l::tools::Point2D(2, 2), 0.0, 1.0,
+                          mk::AgentCategory("turtle")});
+      });
+  data.deferPheromones([&](std::map<std::string, double> &pheromones) {
+    pheromones["trail"] = 3.0;
+  });
+  assert(!data.hasNearbyTurtles() && !data.hasPheromones());
+  assert(data.getLevel() == mk::LevelIdentifier("logo"));
+  assert(data.getTransitoryPeriodMax() == mk::SimulationTimeStamp(1));
+  // computed on the first read only, and kept by the clones
+  assert(data.getNearbyTurtles().size() == 1 && scans == 1);
+  assert(data.getNearbyTurtles().size() == 1 && scans == 1);
+  assert(!data.hasPheromones());
+  auto clone = std::static_pointer_cast<LogoAgent::LogoPerceivedData>(
+      data.clone());
+  assert(clone->getNearbyTurtles().size() == 1 && scans == 1);
+  // the values set after the deferral add to the computed ones
+  data.setPheromone("food", 1.0);
+  assert(data.getPheromone("trail") == 3.0 &&
+         data.getAllPheromones().size() == 2);
+
+  std::cout << "Lazy LogoPerceivedData tests PASSED" << std::endl;
+}
+
+// Test the wake conditions of the sleeping turtles
+void testWakeConditions() {
+  std::cout << "Testing wake conditions..." << std::endl;
+
+  using s2l::model::environment::LogoEnvPLS;
+  using s2l::model::environment::Pheromone;
+  using s2l::model::environment::TurtlePLSInLogo;
+  const mk::LevelIdentifier level =
+      s2l::model::levels::LogoSimulationLevelList::LOGO;
+  const Pheromone trail("trail", 0.0, 0.0);
+  auto environment =
+      std::make_shared<LogoEnvPLS>(level, 20, 20, true, true,
+                                   std::unordered_set<Pheromone>{trail});
+  auto state =
+      std::make_shared<mk::dynamicstate::ConsistentPublicLocalDynamicState>(
+          mk::SimulationTimeStamp(0), level);
+  state->setPublicLocalStateOfEnvironment(environment);
+
+  class States : public mk::dynamicstate::IPublicDynamicStateMap {
+  public:
+    std::shared_ptr<mk::dynamicstate::IPublicLocalDynamicState> state;
+    std::set<mk::LevelIdentifier> keySet() const override {
+      return {state->getLevel()};
+    }
+    std::shared_ptr<mk::dynamicstate::IPublicLocalDynamicState>
+    get(const mk::LevelIdentifier &level) const override {
+      if (level != state->getLevel()) {
+        throw std::out_of_range("No such level");
+      }
+      return state;
+    }
+    void put(std::shared_ptr<mk::dynamicstate::IPublicLocalDynamicState>
+                 newState) override {
+      state = newState;
+    }
+  };
+  States states;
+  states.put(state);
+  const mk::SimulationTimeStamp time(1);
+
+  // The sleeping turtle itself never wakes it up
+  auto sleeper = std::make_shared<TurtlePLSInLogo>(
+      s2l::tools::Point2D(0.5, 0.5), 0.0, 0.0, 0.0, false, "red");
+  environment->getTurtlesInPatches()(0, 0).insert(sleeper);
+  const s2l::agents::NeighbourWakeCondition neighbour(
+      level, sleeper->getLocation(), 2.0, sleeper.get());
+  assert(!neighbour.isMet(time, states));
+
+  // A turtle beyond the radius, across the torus, then within it
+  auto walker = std::make_shared<TurtlePLSInLogo>(
+      s2l::tools::Point2D(17.0, 0.5), 0.0, 0.0, 0.0, false, "blue");
+  environment->getTurtlesInPatches()(17, 0).insert(walker);
+  assert(!neighbour.isMet(time, states));
+  environment->getTurtlesInPatches()(17, 0).erase(walker);
+  walker->setLocation(s2l::tools::Point2D(19.0, 0.5));
+  environment->getTurtlesInPatches()(19, 0).insert(walker);
+  assert(neighbour.isMet(time, states));
+
+  const s2l::agents::PheromoneWakeCondition pheromone(level, trail, 3, 4,
+                                                      0.5);
+  assert(!pheromone.isMet(time, states));
+  environment->setPheromoneValueAt(trail, 3, 4, 0.5);
+  assert(pheromone.isMet(time, states));
+
+  // A level without a Logo environment wakes nobody up
+  const s2l::agents::PheromoneWakeCondition elsewhere(
+      mk::LevelIdentifier("elsewhere"), trail, 3, 4, 0.5);
+  assert(!elsewhere.isMet(time, states));
+
+  std::cout << "Wake condition tests PASSED" << std::endl;
+}
+
+// Test the native behaviors
+void testBehaviors() {
+  std::cout << "Testing native behaviors..." << std::endl;
+
+  using s2l::agents::LogoAgent;
+  const mk::LevelIdentifier level("behavior_level");
+  const mk::SimulationTimeStamp lower(0), upper(1);
+  auto perceive = [&](double heading) {
+    auto turtle = std::make_shared<s2l::model::environment::TurtlePLSInLogo>(
+        s2l::tools::Point2D(10, 10), heading, 1.0, 0.0, false, "red");
+    auto data = std::make_shared<LogoAgent::LogoPerceivedData>(
+        level, lower, upper, turtle->getLocation(), heading, 1.0);
+    data->setTurtle(turtle);
+    return data;
+  };
+  auto decide = [&](const std::shared_ptr<
+                        fr::univ_artois::lgi2a::similar::extendedkernel::
+                            agents::IAgtDecisionModel> &model,
+                    const std::shared_ptr<LogoAgent::LogoPerceivedData> &data) {
+    auto influences = std::make_shared<mk::influences::InfluencesMap>();
+    model->decide(lower, upper, nullptr, nullptr, nullptr, data, influences);
+    return influences->getInfluencesForLevel(level);
+  };
+  auto turnOf = [](const std::shared_ptr<mk::influences::IInfluence> &i) {
+    auto turn = std::dynamic_pointer_cast<s2l::influences::ChangeDirection>(i);
+    assert(turn);
+    return turn->getDd();
+  };
+
+  // A boid aligns with a neighbour, by at most max_angle
+  auto boids = s2l::agents::makeBehavior(
+      "boids", level, {{{"max_angle", 0.5}}, {}});
+  auto boid = perceive(0.0);
+  boid->addNearbyTurtle(s2l::tools::Point2D(11.5, 10), 0.3, 1.5,
+                        mk::AgentCategory("boid"));
+  auto emitted = decide(boids, boid);
+  assert(emitted.size() == 1 &&
+         std::abs(turnOf(emitted.front()) - 0.3) < 1e-12);
+  boid = perceive(0.0);
+  boid->addNearbyTurtle(s2l::tools::Point2D(11.5, 10), 1.2, 1.5,
+                        mk::AgentCategory("boid"));
+  assert(turnOf(decide(boids, boid).front()) == 0.5);
+  // and moves away from a close one: the neighbour at (-1, 0) is on its
+  // left, at the heading pi / 2
+  boid = perceive(0.0);
+  boid->addNearbyTurtle(s2l::tools::Point2D(9.5, 10), 0.0, 0.5,
+                        mk::AgentCategory("boid"));
+  assert(turnOf(decide(boids, boid).front()) == -0.5);
+  // alone, it keeps its heading
+  assert(decide(boids, perceive(0.0)).empty());
+  // with the approximated directions, it turns by nearly as much
+  auto fastBoids = s2l::agents::makeBehavior(
+      "boids", level, {{{"approximate_directions", 1}}, {}});
+  auto exactBoids = s2l::agents::makeBehavior("boids", level, {{}, {}});
+  boid = perceive(0.2);
+  boid->addNearbyTurtle(s2l::tools::Point2D(9.5, 10.2), 0.0, 0.6,
+                        mk::AgentCategory("boid"));
+  boid->addNearbyTurtle(s2l::tools::Point2D(12, 13), 0.0, 3.6,
+                        mk::AgentCategory("boid"));
+  assert(std::abs(turnOf(decide(fastBoids, boid).front()) -
+                  turnOf(decide(exactBoids, boid).front())) < 1e-4);
+
+  // An ant turns towards the stronger side of its trail and drops pheromone
+  auto ants = s2l::agents::makeBehavior(
+      "ant", level,
+      {{{"turn_angle", 0.25}, {"deposited_amount", 2.0}},
+       {{"pheromone", "trail"}}});
+  auto ant = perceive(0.0);
+  ant->setPheromoneGradient("trail", 1.0, 0.5, 2.0);
+  emitted = decide(ants, ant);
+  assert(emitted.size() == 2 && turnOf(emitted.front()) == -0.25);
+  auto drop = std::dynamic_pointer_cast<s2l::influences::EmitPheromone>(
+      emitted.back());
+  assert(drop && drop->getPheromoneIdentifier() == "trail" &&
+         drop->getValue() == 2.0);
+  ant = perceive(0.0);
+  ant->setPheromoneGradient("trail", 1.0, 3.0, 2.0);
+  assert(decide(ants, ant).size() == 1); // straight ahead
+
+  // A Schelling agent moves when too few neighbours share its category
+  auto segregation = std::dynamic_pointer_cast<
+      s2l::agents::SegregationDecisionModel>(s2l::agents::makeBehavior(
+      "segregation", level,
+      {{{"similarity_rate", 0.5}}, {{"category", "blue"}}}));
+  auto agent = perceive(0.0);
+  agent->addNearbyTurtle(s2l::tools::Point2D(11, 10), 0, 1,
+                         mk::AgentCategory("blue"));
+  agent->addNearbyTurtle(s2l::tools::Point2D(9, 10), 0, 1,
+                         mk::AgentCategory("red"));
+  assert(segregation->isHappy(*agent) && decide(segregation, agent).empty());
+  agent->addNearbyTurtle(s2l::tools::Point2D(10, 11), 0, 1,
+                         mk::AgentCategory("red"));
+  emitted = decide(segregation, agent);
+  assert(emitted.size() == 1 &&
+         std::dynamic_pointer_cast<s2l::influences::ChangePosition>(
+             emitted.front()));
+  auto relocating = s2l::agents::makeBehavior(
+      "segregation", level,
+      {{{"similarity_rate", 0.5}, {"relocate", 1.0}}, {{"category", "blue"}}});
+  emitted = decide(relocating, agent);
+  assert(emitted.size() == 1 &&
+         std::dynamic_pointer_cast<s2l::influences::Relocate>(
+             emitted.front()));
+
+  // The parameters are checked
+  bool rejected = false;
+  try {
+    s2l::agents::makeBehavior("boids", level, {{{"max_angel", 1.0}}, {}});
+  } catch (const std::invalid_argument &) {
+    rejected = true;
+  }
+  assert(rejected);
+  rejected = false;
+  try {
+    s2l::agents::makeBehavior("ant", level, {});
+  } catch (const std::invalid_argument &) {
+    rejected = true;
+  }
+  assert(rejected);
+
+  std::cout << "Native behaviors tests PASSED" << std::endl;
+}
+
 // Test SituatedEntity class
 void testSituatedEntity() {
   std::cout << "Testing SituatedEntity class..." << std::endl;
@@ -358,6 +2854,572 @@ void testAllInfluences() {
   std::cout << "All influence tests PASSED" << std::endl;
 }
 
+// A turtle turning with the pheromone it smells and the turtles around it,
+// dropping pheromone where it goes
+namespace distributed {
+
+using s2l::model::environment::LogoEnvPLS;
+using s2l::model::environment::TurtlePLSInLogo;
+const mk::LevelIdentifier &LOGO =
+    s2l::model::levels::LogoSimulationLevelList::LOGO;
+
+struct Smell : mk::libs::generic::EmptyPerceivedData {
+  Smell(const mk::SimulationTimeStamp &lower,
+        const mk::SimulationTimeStamp &upper)
+      : EmptyPerceivedData(LOGO, lower, upper) {}
+  double trail = 0;
+  int neighbors = 0;
+};
+
+struct Perception {
+  std::shared_ptr<TurtlePLSInLogo> turtle;
+  std::shared_ptr<Smell>
+  perceive(const mk::SimulationTimeStamp &lower,
+           const mk::SimulationTimeStamp &upper,
+           const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+           const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+           const std::shared_ptr<mk::dynamicstate::IPublicDynamicStateMap>
+               &dynamicStates) {
+    const auto &env = static_cast<const LogoEnvPLS &>(
+        *dynamicStates->get(LOGO)->getPublicLocalStateOfEnvironment());
+    auto smell = std::make_shared<Smell>(lower, upper);
+    const int x = static_cast<int>(turtle->getLocation().x);
+    const int y = static_cast<int>(turtle->getLocation().y);
+    smell->trail = env.getPheromoneValueAt(
+        s2l::model::environment::Pheromone("trail", 0.2, 0.05), x, y);
+    env.forEachNeighbor(x, y, 1, [&](int nx, int ny) {
+      smell->neighbors +=
+          static_cast<int>(env.getTurtlesInPatches()(nx, ny).size());
+    });
+    return smell;
+  }
+};
+
+struct Revision {
+  void reviseGlobalState(const mk::SimulationTimeStamp &,
+                         const mk::SimulationTimeStamp &,
+                         const std::shared_ptr<Smell> &,
+                         const std::shared_ptr<mk::agents::IGlobalState> &) {}
+};
+
+struct Decision {
+  std::shared_ptr<TurtlePLSInLogo> turtle;
+  void decide(const mk::SimulationTimeStamp &lower,
+              const mk::SimulationTimeStamp &upper,
+              const std::shared_ptr<mk::agents::IGlobalState> &,
+              const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+              const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+              const std::shared_ptr<Smell> &smell,
+              const std::shared_ptr<mk::influences::InfluencesMap> &produced) {
+    produced->add(std::make_shared<s2l::influences::ChangeDirection>(
+        lower, upper, 0.3 * std::sin(smell->trail) + 0.2 * smell->neighbors,
+        turtle));
+    produced->add(std::make_shared<s2l::influences::EmitPheromone>(
+        lower, upper, turtle->getLocation(), "trail", 1.0));
+  }
+};
+
+using Walker = fr::univ_artois::lgi2a::similar::extendedkernel::agents::
+    StaticExtendedAgent<Perception, Decision, Revision>;
+
+class WalkerState : public mk::agents::ILocalStateOfAgent {
+public:
+  mk::LevelIdentifier getLevel() const override { return LOGO; }
+  mk::AgentCategory getCategoryOfAgent() const override {
+    return mk::AgentCategory("walker");
+  }
+  bool isOwnedBy(const mk::agents::IAgent &) const override { return true; }
+  std::shared_ptr<mk::ILocalState> clone() const override {
+    return std::make_shared<WalkerState>(*this);
+  }
+};
+
+class WalkerMemory : public mk::agents::IGlobalState {
+public:
+  std::shared_ptr<mk::agents::IGlobalState> clone() const override {
+    return std::make_shared<WalkerMemory>(*this);
+  }
+};
+
+class WalkersModel : public s2l::model::DistributedLogoSimulationModel {
+public:
+  static constexpr int TURTLES = 60;
+
+  WalkersModel()
+      : DistributedLogoSimulationModel(
+            40, 30, true, true, 2,
+            {s2l::model::environment::Pheromone("trail", 0.2, 0.05)}) {}
+
+  mk::SimulationTimeStamp getInitialTime() const override {
+    return mk::SimulationTimeStamp(0);
+  }
+  bool isFinalTimeOrAfter(const mk::SimulationTimeStamp &currentTime,
+                          const mk::ISimulationEngine &) const override {
+    return currentTime.getIdentifier() >= 25;
+  }
+
+  std::vector<Turtle>
+  generateTurtles(const mk::SimulationTimeStamp &,
+                  const s2l::tools::DomainDecomposition::Box &) override {
+    std::vector<Turtle> turtles;
+    for (int i = 0; i < TURTLES; ++i) {
+      turtles.push_back(
+          {mk::AgentCategory("walker"),
+           std::make_shared<TurtlePLSInLogo>(
+               s2l::tools::Point2D(i * 7 % 40 + 0.5, i * 11 % 30 + 0.25),
+               i * 0.7, 0.9, 0.0, false, "red")});
+    }
+    return turtles;
+  }
+
+  std::shared_ptr<mk::agents::IAgent4Engine>
+  createAgent(const mk::AgentCategory &category,
+              const std::shared_ptr<TurtlePLSInLogo> &turtle) override {
+    auto agent = std::make_shared<Walker>(category, LOGO, Perception{turtle},
+                                          Decision{turtle}, Revision{});
+    agent->initializeGlobalState(std::make_shared<WalkerMemory>());
+    agent->includeNewLevel(LOGO, std::make_shared<WalkerState>(),
+                           std::make_shared<WalkerState>());
+    return agent;
+  }
+};
+
+// The turtles and the pheromone of the whole grid at the end of a run
+struct Outcome {
+  std::vector<std::pair<double, double>> turtles;
+  std::vector<double> trail = std::vector<double>(40 * 30, 0.0);
+  std::vector<double> counts;
+  long rebalances = 0;
+};
+
+Outcome run(int columns, int rows, long rebalancePeriod = 0) {
+  const int ranks = columns * rows;
+  auto group = s2l::engine::LocalDomainCommunicator::createGroup(ranks);
+  Outcome outcome;
+  std::mutex outcomeMutex;
+  std::vector<std::thread> threads;
+  for (int rank = 0; rank < ranks; ++rank) {
+    threads.emplace_back([&, rank]() {
+      s2l::engine::DistributedLogoSimulationEngine engine(group[rank]);
+      engine.setDomainGrid(columns, rows);
+      // Any imbalance moves the cuts
+      engine.setRebalancing(rebalancePeriod, 1.0);
+      // Every rank counts the turtles, rank 0 keeps the totals
+      engine.addProbe(
+          "count",
+          std::make_shared<s2l::engine::DistributedReductionProbe>(
+              1, s2l::engine::IDomainCommunicator::Reduction::SUM,
+              [](const s2l::engine::DistributedLogoSimulationEngine &e,
+                 std::vector<double> &values) {
+                values[0] = static_cast<double>(e.getTurtles().size());
+              },
+              [&](const mk::SimulationTimeStamp &,
+                  const std::vector<double> &values) {
+                outcome.counts.push_back(values[0]);
+              }));
+      engine.runNewSimulation(std::make_shared<WalkersModel>());
+
+      const auto domain = engine.getDomain();
+      const auto grid = engine.getLocalGrid();
+      const auto &env = *engine.getLocalEnvironment();
+      const auto &trail = env.getPheromoneValues(
+          s2l::model::environment::Pheromone("trail", 0.2, 0.05));
+      std::lock_guard<std::mutex> lock(outcomeMutex);
+      outcome.rebalances = engine.getRebalanceCount();
+      for (const auto &hosted : engine.getTurtles()) {
+        const auto location = engine.toGlobal(hosted.turtle->getLocation());
+        assert(domain.contains(static_cast<int>(location.x),
+                               static_cast<int>(location.y)));
+        outcome.turtles.emplace_back(location.x, location.y);
+      }
+      for (int y = domain.y; y < domain.y + domain.height; ++y) {
+        for (int x = domain.x; x < domain.x + domain.width; ++x) {
+          outcome.trail[y * 40 + x] = trail.values(x - grid.x, y - grid.y);
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  std::sort(outcome.turtles.begin(), outcome.turtles.end());
+  return outcome;
+}
+
+} // namespace distributed
+
+// Test a simulation split into domains against the same on one rank
+void testDistributedLogoSimulationEngine() {
+  std::cout << "Testing DistributedLogoSimulationEngine..." << std::endl;
+
+  // The decomposition covers the grid with the domains
+  s2l::tools::DomainDecomposition decomposition(40, 30, true, false, 4, 2);
+  assert(decomposition.getColumns() * decomposition.getRows() == 4);
+  for (int y = 0; y < 30; ++y) {
+    for (int x = 0; x < 40; ++x) {
+      const int owner = decomposition.ownerOf(x, y);
+      assert(decomposition.getDomain(owner).contains(x, y));
+    }
+  }
+  assert(decomposition.ownerOf(-1, 0) == decomposition.ownerOf(39, 0));
+  assert(decomposition.ownerOf(0, -1) == -1);
+
+  // The load of the first columns narrows their domains
+  s2l::tools::DomainDecomposition strips(40, 30, true, false, 4, 1, 2);
+  std::vector<double> columnLoads(40, 1.0);
+  std::fill(columnLoads.begin(), columnLoads.begin() + 10, 4.0);
+  const auto balanced =
+      strips.rebalanced(columnLoads, std::vector<double>(30, 1.0));
+  assert(!balanced.hasSameDomains(strips));
+  assert(balanced.getColumnStarts().front() == 0);
+  assert(balanced.getDomain(0).width < balanced.getDomain(3).width);
+  assert(balanced.getDomain(2).height == 30);
+  for (int y = 0; y < 30; ++y) {
+    for (int x = 0; x < 40; ++x) {
+      assert(balanced.getDomain(balanced.ownerOf(x, y)).contains(x, y));
+    }
+  }
+  assert(strips
+             .rebalanced(std::vector<double>(40, 1.0),
+                         std::vector<double>(30, 1.0))
+             .hasSameDomains(strips));
+
+  const auto single = distributed::run(1, 1);
+  for (const auto &split :
+       {distributed::run(2, 2), distributed::run(2, 2, 5)}) {
+    assert(split.turtles.size() == single.turtles.size());
+    for (std::size_t i = 0; i < single.turtles.size(); ++i) {
+      assert(std::abs(split.turtles[i].first - single.turtles[i].first) <
+             1e-6);
+      assert(std::abs(split.turtles[i].second - single.turtles[i].second) <
+             1e-6);
+    }
+    for (std::size_t i = 0; i < single.trail.size(); ++i) {
+      assert(std::abs(split.trail[i] - single.trail[i]) < 1e-5);
+    }
+    // The turtles migrating between the domains are neither lost nor copied
+    assert(!split.counts.empty() &&
+           split.counts.size() == single.counts.size());
+    for (double count : split.counts) {
+      assert(count == distributed::WalkersModel::TURTLES);
+    }
+  }
+  assert(single.turtles.size() == distributed::WalkersModel::TURTLES);
+  double total = 0;
+  for (double value : single.trail) {
+    total += value;
+  }
+  assert(total > 0);
+  // The cuts moved, with the patches and the turtles
+  assert(single.rebalances == 0 && distributed::run(2, 2, 5).rebalances > 0);
+
+  std::cout << "DistributedLogoSimulationEngine tests PASSED" << std::endl;
+}
+
+// Agents emitting pheromone of very different magnitudes on a few shared
+// cells, so that the sums of a cell depend on the order of its deposits
+namespace deposits {
+
+using distributed::LOGO;
+using distributed::Smell;
+using s2l::model::environment::Pheromone;
+
+const Pheromone TRAIL("trail", 0.2, 0.05);
+
+struct Perception {
+  std::shared_ptr<Smell>
+  perceive(const mk::SimulationTimeStamp &lower,
+           const mk::SimulationTimeStamp &upper,
+           const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+           const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+           const std::shared_ptr<mk::dynamicstate::IPublicDynamicStateMap> &) {
+    return std::make_shared<Smell>(lower, upper);
+  }
+};
+
+struct Decision {
+  int index;
+  void decide(const mk::SimulationTimeStamp &lower,
+              const mk::SimulationTimeStamp &upper,
+              const std::shared_ptr<mk::agents::IGlobalState> &,
+              const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+              const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+              const std::shared_ptr<Smell> &,
+              const std::shared_ptr<mk::influences::InfluencesMap> &produced) {
+    for (int k = 0; k < 4; ++k) {
+      const double value =
+          std::pow(10.0, (index + k) % 9 - 4) / (3 + index % 7);
+      produced->add(std::make_shared<s2l::influences::EmitPheromone>(
+          lower, upper,
+          s2l::tools::Point2D(index * (k + 1) % 3 + 0.5, k + 0.5), "trail",
+          value));
+    }
+  }
+};
+
+using Emitter = fr::univ_artois::lgi2a::similar::extendedkernel::agents::
+    StaticExtendedAgent<Perception, Decision, distributed::Revision>;
+
+class EmittersModel
+    : public fr::univ_artois::lgi2a::similar::extendedkernel::
+          simulationmodel::ISimulationModel {
+public:
+  static constexpr int AGENTS = 400;
+
+  fr::univ_artois::lgi2a::similar::extendedkernel::simulationmodel::
+      ISimulationParameters *
+      getSimulationParameters() override {
+    return nullptr;
+  }
+  mk::SimulationTimeStamp getInitialTime() const override {
+    return mk::SimulationTimeStamp(0);
+  }
+  bool isFinalTimeOrAfter(const mk::SimulationTimeStamp &currentTime,
+                          const mk::ISimulationEngine &) const override {
+    return currentTime.getIdentifier() >= 6;
+  }
+  std::vector<std::shared_ptr<mk::levels::ILevel>>
+  generateLevels(const mk::SimulationTimeStamp &initialTime) override {
+    return {std::make_shared<
+        fr::univ_artois::lgi2a::similar::extendedkernel::levels::
+            ExtendedLevel>(
+        initialTime, LOGO,
+        std::make_shared<fr::univ_artois::lgi2a::similar::extendedkernel::
+                             libs::PeriodicTimeModel>(1, 0, initialTime),
+        std::make_shared<s2l::model::levels::LogoDefaultReactionModel>())};
+  }
+  EnvironmentInitializationData generateEnvironment(
+      const mk::SimulationTimeStamp &,
+      const std::map<mk::LevelIdentifier, std::shared_ptr<mk::levels::ILevel>>
+          &levels) override {
+    auto pls = std::make_shared<s2l::model::environment::LogoEnvPLS>(
+        LOGO, 8, 6, true, true, std::unordered_set<Pheromone>{TRAIL});
+    levels.at(LOGO)->getLastConsistentState()->setPublicLocalStateOfEnvironment(
+        pls);
+    return EnvironmentInitializationData(
+        std::make_shared<s2l::model::environment::LogoEnvironment>(pls));
+  }
+  AgentInitializationData generateAgents(
+      const mk::SimulationTimeStamp &,
+      const std::map<mk::LevelIdentifier, std::shared_ptr<mk::levels::ILevel>>
+          &) override {
+    AgentInitializationData data;
+    for (int i = 0; i < AGENTS; ++i) {
+      auto agent = std::make_shared<Emitter>(
+          mk::AgentCategory("walker"), LOGO, Perception{}, Decision{i},
+          distributed::Revision{});
+      agent->initializeGlobalState(
+          std::make_shared<distributed::WalkerMemory>());
+      agent->includeNewLevel(LOGO, std::make_shared<distributed::WalkerState>(),
+                             std::make_shared<distributed::WalkerState>());
+      data.getAgents().insert(agent);
+    }
+    return data;
+  }
+};
+
+// The trail at the end of a run on a number of threads
+std::vector<double> run(std::size_t threads) {
+  mk::engine::MultiThreadedSimulationEngine engine(threads);
+  engine.runNewSimulation(std::make_shared<EmittersModel>());
+  const auto &env = static_cast<const s2l::model::environment::LogoEnvPLS &>(
+      *engine.getLevels()
+           .at(LOGO)
+           ->getLastConsistentState()
+           ->getPublicLocalStateOfEnvironment());
+  const auto &trail = env.getPheromoneValues(TRAIL);
+  std::vector<double> values;
+  for (int y = 0; y < 6; ++y) {
+    for (int x = 0; x < 8; ++x) {
+      values.push_back(trail.values(x, y));
+    }
+  }
+  return values;
+}
+
+} // namespace deposits
+
+// Test that the emissions of a step give the same fields on any number of
+// threads
+void testReproducibleDeposits() {
+  std::cout << "Testing the reproducibility of the deposits..." << std::endl;
+
+  const auto single = deposits::run(1);
+  assert(std::any_of(single.begin(), single.end(),
+                     [](double value) { return value > 0; }));
+  for (const std::size_t threads : {2, 4}) {
+    for (int repeat = 0; repeat < 3; ++repeat) {
+      assert(deposits::run(threads) == single);
+    }
+  }
+
+  std::cout << "Deposit reproducibility tests PASSED" << std::endl;
+}
+
+void testParallelInitialization() {
+  std::cout << "Testing the parallel initialization..." << std::endl;
+
+  using s2l::model::environment::LogoEnvPLS;
+  using s2l::model::environment::Pheromone;
+  mk::engine::WorkStealingThreadPool pool(3);
+  mk::engine::WorkStealingThreadPool::Scope scope(&pool);
+
+  // The fields are filled on the pool, each with its default value
+  const Pheromone trail("trail", 0.2, 0.05, 1.5, 0.0);
+  const Pheromone food("food", 0.0, 0.0);
+  LogoEnvPLS environment(s2l::model::levels::LogoSimulationLevelList::LOGO,
+                         50, 70, true, true, {trail, food});
+  assert(environment.getPheromoneValueAt(trail, 49, 69) == 1.5);
+  assert(environment.getPheromoneValueAt(food, 0, 0) == 0.0);
+  assert(environment.getPheromoneValues(trail).values.size() == 50 * 70);
+
+  // The chunks cover the agents once, whichever worker creates them
+  s2l::model::LogoSimulationModel model(32, 32);
+  const mk::AgentCategory category("walker");
+  model.setAgentFactory([&] {
+    return std::vector<std::shared_ptr<s2l::agents::LogoAgent>>{
+        std::make_shared<s2l::agents::LogoAgent>(category)};
+  });
+  const std::size_t count = 10000;
+  std::mutex mutex;
+  std::vector<std::size_t> created(count, 0);
+  model.setAgentChunkFactory(count, [&](std::size_t begin, std::size_t end) {
+    std::vector<std::shared_ptr<s2l::agents::LogoAgent>> agents;
+    for (std::size_t i = begin; i < end; ++i) {
+      agents.push_back(std::make_shared<s2l::agents::LogoAgent>(
+          category, static_cast<double>(i)));
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    for (std::size_t i = begin; i < end; ++i) {
+      ++created[i];
+    }
+    return agents;
+  });
+  auto data = model.generateAgents(mk::SimulationTimeStamp(0), {});
+  assert(data.getAgents().size() == count + 1);
+  assert(std::all_of(created.begin(), created.end(),
+                     [](std::size_t n) { return n == 1; }));
+
+  std::cout << "Parallel initialization tests PASSED" << std::endl;
+}
+
+void testGridMemory() {
+  std::cout << "Testing the grid memory..." << std::endl;
+
+  using s2l::tools::GridMemory;
+  using s2l::tools::TiledField;
+  struct Tag {
+    static const char *name() { return "grid memory test"; }
+  };
+  using Buffer = s2l::tools::GridBuffer<float, Tag>;
+
+  // A large buffer of zeros commits no page until written
+  const std::size_t count = 4 << 20;
+  Buffer buffer;
+  buffer.assign(count, 0.0f);
+  assert(buffer.isLazy());
+#ifdef __linux__
+  assert(buffer.residentBytes() == 0);
+#endif
+  buffer[count / 2] = 3.0f;
+#ifdef __linux__
+  assert(buffer.residentBytes() <=
+         GridMemory::HUGE_PAGE_BYTES + GridMemory::pageBytes());
+#endif
+
+  // The copies keep the values, the chunks of zeros being skipped
+  Buffer copy(buffer);
+  assert(copy.size() == count);
+  assert(copy[count / 2] == 3.0f && copy[0] == 0.0f && copy[count - 1] == 0.0f);
+
+  // The released range reads zeros again
+  buffer[count / 2] = 0.0f;
+  buffer.release(0, count);
+  assert(buffer[count / 2] == 0.0f);
+  buffer.assign(count, 1.0f);
+  assert(buffer[0] == 1.0f && buffer[count - 1] == 1.0f);
+  buffer.assign(count, 0.0f);
+  assert(buffer[0] == 0.0f && buffer[count - 1] == 0.0f);
+
+  // The small buffers come from the heap
+  Buffer small;
+  small.assign(64, 2.0f);
+  assert(!small.isLazy() && small[63] == 2.0f);
+
+  // The bands of a field going back to zeros are given back, counted in
+  // small pages
+  GridMemory::setHugePages(false);
+  TiledField field;
+  field.assign(1024, 1024, 0.0);
+  GridMemory::setHugePages(true);
+  field.set(10, 10, 1.0);
+  field.set(10, 1000, 1.0);
+  field.set(10, 1000, 0.0);
+  std::fill(field.active.begin(), field.active.end(), 0);
+  field.active[field.tileOf(10, 10)] = 1;
+  field.releaseQuiescent();
+  assert(field.values(10, 10) == 1.0f);
+  assert(field.values(10, 1000) == 0.0f);
+#ifdef __linux__
+  assert(field.values.storage().residentBytes() <=
+         GridMemory::HUGE_PAGE_BYTES + GridMemory::pageBytes());
+#endif
+
+#ifdef __unix__
+  // The buffers mapped from the files of a backing directory hold their
+  // values through prefetch and evict, and read zeros once released
+  char directory[] = "/tmp/similar2logo-gridsXXXXXX";
+  if (mkdtemp(directory) == nullptr) {
+    throw std::runtime_error("Cannot create a temporary directory");
+  }
+  GridMemory::setBackingDirectory(directory);
+  assert(GridMemory::getBackingDirectory() == directory);
+  Buffer mapped;
+  mapped.assign(count, 0.0f);
+  assert(mapped.isLazy() && mapped.isFileBacked());
+  assert(mapped[0] == 0.0f && mapped[count - 1] == 0.0f);
+  mapped[count / 2] = 5.0f;
+  mapped[count - 1] = 6.0f;
+  mapped.prefetch(0, count);
+  mapped.evict(0, count);
+  assert(mapped[count / 2] == 5.0f && mapped[count - 1] == 6.0f);
+  mapped.release(0, count);
+  assert(mapped[count / 2] == 0.0f && mapped[count - 1] == 0.0f);
+  mapped.assign(count, 1.0f);
+  mapped.assign(count, 0.0f);
+  assert(mapped[0] == 0.0f && mapped[count - 1] == 0.0f);
+  small.assign(64, 2.0f);
+  assert(!small.isFileBacked());
+
+  // A field mapped from a file diffuses as one in anonymous memory
+  TiledField fields[2];
+  for (TiledField &grid : fields) {
+    grid.assign(1024, 1024, 0.0);
+    grid.set(5, 5, 1.0);
+    grid.set(500, 700, 2.0);
+    s2l::tools::FieldDiffusion diffusion(1024, 1024, true, true);
+    for (int step = 0; step < 3; ++step) {
+      diffusion.add(grid, {0.5, true, 0.1, 0.0});
+      diffusion.run();
+    }
+    GridMemory::setBackingDirectory("");
+  }
+  const TiledField &streamed = fields[0];
+  const TiledField &resident = fields[1];
+  assert(streamed.values.storage().isFileBacked());
+  assert(!resident.values.storage().isFileBacked());
+  for (int y = 0; y < 1024; ++y) {
+    for (int x = 0; x < 1024; ++x) {
+      assert(streamed.values(x, y) == resident.values(x, y));
+    }
+  }
+  assert(streamed.values(500, 700) > 0 && streamed.values(503, 703) > 0);
+  rmdir(directory);
+#endif
+
+  std::cout << "Grid memory tests PASSED" << std::endl;
+}
+
 // Main test runner
 int main() {
   std::cout << "Running core C++ unit tests..." << std::endl;
@@ -367,17 +3429,55 @@ int main() {
     // Core utility classes
     testPoint2D();
     testMathUtil();
+    testTopology();
     testFastMath();
+    testFieldDiffusionPrecision();
+    testSpectralDiffusion();
+    testPheromoneDiffusion();
+    testFusedPheromones();
+    testParallelFieldUpdate();
+    testActivePheromoneTiles();
 
     // Core microkernel classes
     testSimulationTimeStamp();
     testLevelIdentifier();
     testAgentCategory();
+    testSymbolTable();
 
     // Similar2Logo model classes
     testMark();
     testTurtlePLSInLogo();
+    testTurtleStore();
+    testCrowdAggregation();
+    testMarkStore();
+    testLogoEnvPLSClone();
+    testNeighbourhoodVisitor();
+    testEnvironmentChanges();
+    testReactionCoalescing();
+    testMoveResolution();
+    testTurtleReordering();
+    testEnvironmentBatchAccess();
+    testPheromoneHandles();
+    testBatchDeposits();
+    testPheromonePyramid();
+    testNeighbourhoodCache();
+    testRadiusQueries();
+    testTurtlePatchIndex();
+    testGradientSensing();
+    testBatchDecisionModel();
+    testCompiledBehavior();
+    testLazyPerceivedData();
+    testWakeConditions();
+    testBehaviors();
+    testSpatialHashGrid();
+    testSharedDecisionBuffer();
+    testFrameEncoder();
+    testHeatmapTileRenderer();
     testSituatedEntity();
+    testDistributedLogoSimulationEngine();
+    testReproducibleDeposits();
+    testParallelInitialization();
+    testGridMemory();
 
     // All influence classes
     testAllInfluences();
@@ -1,19 +1,74 @@
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
 #include <string>
 #include <stdexcept>
+#include <thread>
+#include <vector>
 
 // Microkernel includes (always needed)
 #include "LevelIdentifier.h"
+#include "LevelIndexedMap.h"
 #include "SimulationTimeStamp.h"
+#include "agents/CoroutineDecisionModel.h"
+#include "agents/StaticExtendedAgent.h"
+#include "dynamicstate/ConsistentPublicLocalDynamicState.h"
+#include "agents/IScheduledAgent.h"
+#include "agents/IWakeCondition.h"
+#include "checkpoint/InfluenceLog.h"
+#include "engine/ActivationSchedule.h"
+#include "engine/AgentRegistry.h"
+#include "engine/ModelPlugin.h"
+#include "engine/MultiThreadedSimulationEngine.h"
+#include "engine/ObservationSchedule.h"
+#include "engine/ParameterSweepRunner.h"
+#include "engine/RewindBuffer.h"
+#include "engine/SequentialSimulationEngine.h"
+#include "engine/StepBarrier.h"
+#include "engine/WorkStealingThreadPool.h"
 #include "influences/AbstractInfluence.h"
+#include "influences/InfluenceArena.h"
 #include "influences/InfluencesMap.h"
 #include "influences/RegularInfluence.h"
 #include "influences/SystemInfluence.h"
+#include "libs/AbstractAgent.h"
+#include "libs/CallbackProfiler.h"
+#include "libs/ExecutionTracer.h"
+#include "libs/MemoryAccounting.h"
+#include "libs/PerformanceCounters.h"
+#include "libs/SimulationMetrics.h"
+#include "libs/StepTimingRecorder.h"
+#include "libs/abstractimpl/AbstractLevel.h"
 #include "libs/generic/EmptyLocalStateOfEnvironment.h"
+#include "libs/ensemble/EnsembleRunner.h"
 #include "libs/generic/EmptyPerceivedData.h"
+#include "libs/probes/AgentSampler.h"
+#include "libs/probes/AsyncProbe.h"
+#include "libs/batch/BatchRunner.h"
+#include "libs/probes/ColumnarExportProbe.h"
+#include "libs/probes/CsvColumnarWriter.h"
+#include "libs/probes/StatisticsProbe.h"
+#include "libs/probes/StreamingStatistics.h"
+#include "libs/random/PRNG.h"
+#include "libs/web/SimilarSessionServer.h"
+#include "libs/web/view/PngEncoder.h"
+#include "libs/web/view/StateStream.h"
+#include "simulationmodel/ParameterStore.h"
+#include "third_party/httplib.h"
 
 // Extended kernel includes (commented out due to compilation issues in main
 // build) These tests are designed to work when the extended kernel is available
@@ -28,6 +83,9 @@
 
 // Namespace aliases
 namespace mk = fr::univ_artois::lgi2a::similar::microkernel;
+namespace ek_probes =
+    fr::univ_artois::lgi2a::similar::extendedkernel::libs::probes;
+namespace ek_agents = fr::univ_artois::lgi2a::similar::extendedkernel::agents;
 
 #ifdef HAS_EXTENDED_KERNEL
 namespace ek = fr::univ_artois::lgi2a::similar::extendedkernel;
@@ -267,6 +325,720 @@ void testAdditionalMicrokernelClasses() {
   std::cout << "SystemInfluence tests PASSED" << std::endl;
 }
 
+// Test the persistent thread pool used by the multithreaded engine
+void testWorkStealingThreadPool() {
+  std::cout << "Testing WorkStealingThreadPool..." << std::endl;
+
+  mk::engine::WorkStealingThreadPool pool(4);
+  ensure(pool.size() == 4, "Thread pool size mismatch");
+
+  // Every index is visited exactly once, across many reuses of the pool.
+  std::vector<std::atomic<int>> visits(1000);
+  for (int step = 0; step < 50; ++step) {
+    pool.parallelFor(visits.size(), 7, [&](size_t begin, size_t end, size_t) {
+      for (size_t i = begin; i < end; ++i) {
+        visits[i].fetch_add(1);
+      }
+    });
+  }
+  for (const auto &count : visits) {
+    ensure(count.load() == 50, "Thread pool index visited wrong count");
+  }
+
+  // Exceptions thrown by a chunk are rethrown by parallelFor.
+  bool thrown = false;
+  try {
+    pool.parallelFor(100, 1, [](size_t begin, size_t, size_t) {
+      if (begin == 42) {
+        throw std::runtime_error("chunk failure");
+      }
+    });
+  } catch (const std::runtime_error &) {
+    thrown = true;
+  }
+  ensure(thrown, "Thread pool did not propagate exception");
+
+  // Each worker runs forEachWorker() on its own thread.
+  std::vector<std::thread::id> threads(pool.size());
+  for (int run = 0; run < 20; ++run) {
+    pool.forEachWorker(
+        [&](size_t worker) { threads[worker] = std::this_thread::get_id(); });
+    ensure(threads[0] == std::this_thread::get_id() &&
+               std::set<std::thread::id>(threads.begin(), threads.end())
+                       .size() == pool.size(),
+           "forEachWorker ran a worker on another thread");
+  }
+
+  // The workers are placed on the nodes in proportion to their CPUs.
+  using mk::engine::CpuTopology;
+  ensure(CpuTopology::parseCpuList("0-2,8, 10-11\n") ==
+             std::vector<int>{0, 1, 2, 8, 10, 11},
+         "CPU list parsed wrong");
+  bool malformed = false;
+  try {
+    CpuTopology::parseCpuList("3-1");
+  } catch (const std::invalid_argument &) {
+    malformed = true;
+  }
+  ensure(malformed, "Malformed CPU list accepted");
+  CpuTopology topology;
+  topology.nodes = {{0, 1, 2, 3}, {4, 5, 6, 7}};
+  const auto placement = topology.placeWorkers(4);
+  ensure(placement.size() == 4 && placement[0].cpu == 0 &&
+             placement[1].cpu == 2 && placement[1].node == 0 &&
+             placement[2].cpu == 4 && placement[3].node == 1,
+         "Workers placed wrong");
+  ensure(topology.placeWorkers(10)[9].cpu == 7 &&
+             CpuTopology::detect().cpuCount() > 0,
+         "Topology mismatch");
+
+  // The pinned workers still visit every index once.
+  pool.setPlacement(CpuTopology::detect().placeWorkers(pool.size()));
+  std::atomic<size_t> visited{0};
+  pool.parallelFor(1000, 7, [&](size_t begin, size_t end, size_t) {
+    visited += end - begin;
+  });
+  ensure(visited == 1000 && pool.setPlacement({}),
+         "Placed pool visited wrong count");
+  bool rejected = false;
+  try {
+    pool.setPlacement(std::vector<CpuTopology::Placement>(
+        placement.begin(), placement.begin() + 2));
+  } catch (const std::invalid_argument &) {
+    rejected = true;
+  }
+  ensure(rejected, "Placement of some workers accepted");
+
+  std::cout << "WorkStealingThreadPool tests PASSED" << std::endl;
+}
+
+// Test the interning of level identifiers
+void testLevelIndexedMap() {
+  std::cout << "Testing LevelIndexedMap..." << std::endl;
+
+  mk::LevelIdentifier first("interned_first");
+  mk::LevelIdentifier second("interned_second");
+  ensure(first.getIndex() == mk::LevelIdentifier("interned_first").getIndex(),
+         "Equal identifiers have different indices");
+  ensure(first.getIndex() != second.getIndex(),
+         "Distinct identifiers share an index");
+  ensure(second.getIndex() < mk::LevelIdentifier::getRegisteredCount(),
+         "Index out of the registered range");
+
+  mk::LevelIndexedMap<int> map;
+  map[second] = 2;
+  map[first] = 1;
+  ensure(map.size() == 2, "LevelIndexedMap size mismatch");
+  ensure(map.at(mk::LevelIdentifier("interned_second")) == 2,
+         "LevelIndexedMap lookup mismatch");
+  map.erase(second);
+  ensure(!map.contains(second) && map.size() == 1,
+         "LevelIndexedMap erase failed");
+  ensure(map.find(mk::LevelIdentifier("interned_missing")) == nullptr,
+         "LevelIndexedMap found an unmapped level");
+
+  std::cout << "LevelIndexedMap tests PASSED" << std::endl;
+}
+
+// A forager written as a coroutine: searches for two steps, returns, then
+// deposits, and starts again
+ek_agents::DecisionCoroutine
+forageBehavior(const ek_agents::DecisionContext &context, int *trips) {
+  const mk::LevelIdentifier level("coroutine_level");
+  while (true) {
+    for (int step = 0; step < 2; ++step) {
+      co_yield mk::influences::makeInfluence<mk::influences::RegularInfluence>(
+          "search", level, context.timeLowerBound, context.timeUpperBound);
+      co_yield ek_agents::nextStep;
+    }
+    co_yield mk::influences::makeInfluence<mk::influences::RegularInfluence>(
+        "return", level, context.timeLowerBound, context.timeUpperBound);
+    co_yield ek_agents::nextStep;
+    // Two influences in the same step
+    co_yield mk::influences::makeInfluence<mk::influences::RegularInfluence>(
+        "deposit", level, context.timeLowerBound, context.timeUpperBound);
+    co_yield mk::influences::makeInfluence<mk::influences::RegularInfluence>(
+        "pheromone", level, context.timeLowerBound, context.timeUpperBound);
+    ++*trips;
+    if (*trips == 2) {
+      co_return;
+    }
+    co_yield ek_agents::nextStep;
+  }
+}
+
+// Test the decision models written as coroutines
+void testCoroutineDecisionModel() {
+  std::cout << "Testing CoroutineDecisionModel..." << std::endl;
+  const mk::LevelIdentifier level("coroutine_level");
+  auto pool = std::make_shared<ek_agents::CoroutineFramePool>();
+
+  int trips = 0;
+  auto model = std::make_shared<ek_agents::CoroutineDecisionModel>(
+      level,
+      [&trips](const ek_agents::DecisionContext &context) {
+        return forageBehavior(context, &trips);
+      },
+      pool);
+  std::vector<std::string> decisions;
+  for (long t = 0; t < 10; ++t) {
+    auto influences = std::make_shared<mk::influences::InfluencesMap>();
+    model->decide(mk::SimulationTimeStamp(t), mk::SimulationTimeStamp(t + 1),
+                  nullptr, nullptr, nullptr, nullptr, influences);
+    std::string step;
+    for (const auto &influence : influences->getInfluencesForLevel(level)) {
+      ensure(influence->getTimeLowerBound().getIdentifier() == t,
+             "A coroutine read the time of a previous step");
+      if (!step.empty()) {
+        step += '+';
+      }
+      step += influence->getCategory();
+    }
+    decisions.push_back(step);
+  }
+  const std::vector<std::string> expected = {
+      "search", "search", "return", "deposit+pheromone",
+      "search", "search", "return", "deposit+pheromone",
+      "",       ""};
+  ensure(decisions == expected, "The coroutine did not follow its modes");
+  ensure(model->isDone() && trips == 2, "The coroutine did not return");
+  ensure(pool->getLiveBlocks() == 1, "The frame is not in the pool");
+  model.reset();
+  ensure(pool->getLiveBlocks() == 0, "The frame was not released");
+
+  // The frames of the ended behaviors are reused
+  std::vector<std::shared_ptr<ek_agents::CoroutineDecisionModel>> agents;
+  auto run = [&]() {
+    for (int i = 0; i < 50; ++i) {
+      agents.push_back(std::make_shared<ek_agents::CoroutineDecisionModel>(
+          level,
+          [&trips](const ek_agents::DecisionContext &context) {
+            return forageBehavior(context, &trips);
+          },
+          pool));
+      agents.back()->decide(mk::SimulationTimeStamp(0),
+                            mk::SimulationTimeStamp(1), nullptr, nullptr,
+                            nullptr, nullptr,
+                            std::make_shared<mk::influences::InfluencesMap>());
+    }
+    agents.clear();
+  };
+  run();
+  const std::size_t allocated = pool->getAllocatedBlocks();
+  run();
+  ensure(pool->getAllocatedBlocks() == allocated,
+         "The pool did not reuse the frames");
+
+  // The exception ending a behavior reaches the engine
+  ek_agents::CoroutineDecisionModel failing(
+      level,
+      [](const ek_agents::DecisionContext &)
+          -> ek_agents::DecisionCoroutine {
+        co_yield ek_agents::nextStep;
+        throw std::runtime_error("coroutine failure");
+      });
+  auto influences = std::make_shared<mk::influences::InfluencesMap>();
+  failing.decide(mk::SimulationTimeStamp(0), mk::SimulationTimeStamp(1),
+                 nullptr, nullptr, nullptr, nullptr, influences);
+  bool thrown = false;
+  try {
+    failing.decide(mk::SimulationTimeStamp(1), mk::SimulationTimeStamp(2),
+                   nullptr, nullptr, nullptr, nullptr, influences);
+  } catch (const std::runtime_error &) {
+    thrown = true;
+  }
+  ensure(thrown && failing.isDone(), "The coroutine failure was lost");
+
+  std::cout << "CoroutineDecisionModel tests PASSED" << std::endl;
+}
+
+// Test the step-scoped influence arena
+void testInfluenceArena() {
+  std::cout << "Testing InfluenceArena..." << std::endl;
+
+  mk::LevelIdentifier level("arena_level");
+  mk::SimulationTimeStamp lower(0);
+  mk::SimulationTimeStamp upper(1);
+  auto heapInfluence =
+      mk::influences::makeInfluence<mk::influences::RegularInfluence>(
+          "heap", level, lower, upper);
+  ensure(heapInfluence->getCategory() == "heap",
+         "Influence built without arena is invalid");
+
+  auto arena = std::make_shared<mk::influences::InfluenceArena>();
+  std::shared_ptr<mk::influences::IInfluence> kept;
+  {
+    mk::influences::InfluenceArena::Scope scope(*arena);
+    for (int i = 0; i < 1000; ++i) {
+      auto influence =
+          mk::influences::makeInfluence<mk::influences::RegularInfluence>(
+              "arena", level, lower, upper);
+      if (i == 0) {
+        kept = influence;
+      }
+    }
+  }
+  ensure(mk::influences::InfluenceArena::current() == nullptr,
+         "Arena scope was not restored");
+  ensure(arena->getLiveAllocations() == 1, "Arena live allocation mismatch");
+  ensure(!arena->reset(), "Arena rewound while an influence is alive");
+  ensure(kept->getCategory() == "arena", "Kept influence was corrupted");
+
+  // The influence keeps its arena alive.
+  arena.reset();
+  ensure(kept->getCategory() == "arena", "Arena freed before its influence");
+  kept.reset();
+
+  std::cout << "InfluenceArena tests PASSED" << std::endl;
+}
+
+// Test the accounts of the memory of the subsystems
+void testMemoryAccounting() {
+  std::cout << "Testing MemoryAccounting..." << std::endl;
+
+  struct TestMemory {
+    static const char *name() { return "test subsystem"; }
+  };
+  using Tracked =
+      std::vector<double, mk::libs::TrackedAllocator<double, TestMemory>>;
+  auto usage = []() {
+    return mk::libs::MemoryAccounting::usage("test subsystem");
+  };
+  ensure(usage().liveBytes == 0 && usage().peakBytes == 0,
+         "Unused subsystem has memory");
+  {
+    Tracked values(1000);
+    ensure(usage().liveBytes == 1000 * sizeof(double) &&
+               usage().allocations == 1,
+           "Tracked vector was not accounted");
+    Tracked copy = values;
+    copy.resize(3000);
+    ensure(usage().liveBytes >= 4000 * sizeof(double) &&
+               usage().allocations == 2,
+           "Tracked copy was not accounted");
+  }
+  ensure(usage().liveBytes == 0 && usage().allocations == 0,
+         "Released vectors are still accounted");
+  ensure(usage().peakBytes >= 4000 * sizeof(double),
+         "Peak of the subsystem was lost");
+  mk::libs::MemoryAccounting::resetPeaks();
+  ensure(usage().peakBytes == 0, "Peak was not reset");
+
+  bool listed = false;
+  for (const auto &subsystem : mk::libs::MemoryAccounting::snapshot()) {
+    listed = listed || subsystem.subsystem == "test subsystem";
+  }
+  ensure(listed, "Subsystem missing from the snapshot");
+
+  // The lists of the influence maps and the arenas count as influences
+  const auto influences = []() {
+    return mk::libs::MemoryAccounting::usage("influences").liveBytes;
+  };
+  const std::size_t before = influences();
+  {
+    mk::influences::InfluencesMap map;
+    mk::LevelIdentifier level("memory_level");
+    for (int i = 0; i < 100; ++i) {
+      map.add(std::make_shared<mk::influences::RegularInfluence>(
+          "memory", level, mk::SimulationTimeStamp(0),
+          mk::SimulationTimeStamp(1)));
+    }
+    mk::influences::InfluenceArena arena;
+    arena.deallocate(arena.allocate(64, 8));
+    ensure(influences() >= before + 100 * sizeof(void *) * 2 + 64,
+           "Influences were not accounted");
+  }
+  ensure(influences() == before, "Released influences are still accounted");
+
+  mk::engine::SequentialSimulationEngine engine;
+  ensure(engine.getMemoryUsage().size() ==
+             mk::libs::MemoryAccounting::snapshot().size(),
+         "Engine memory usage mismatch");
+
+  std::cout << "MemoryAccounting tests PASSED" << std::endl;
+}
+
+void testCallbackProfiler() {
+  std::cout << "Testing CallbackProfiler..." << std::endl;
+
+  using Profiler = mk::libs::CallbackProfiler;
+  using Duration = mk::libs::CallbackProfile::Duration;
+  auto &account = Profiler::account("TestAgent.decide");
+  ensure(&account == &Profiler::account("TestAgent.decide") &&
+             !Profiler::isEnabled(),
+         "Callback account mismatch");
+
+  // The calls are counted from any thread
+  std::vector<std::thread> callers;
+  for (int t = 0; t < 4; ++t) {
+    callers.emplace_back([&account] {
+      for (int i = 0; i < 100; ++i) {
+        account.called(Duration(50), Duration(10), Duration(5));
+      }
+    });
+  }
+  for (auto &caller : callers) {
+    caller.join();
+  }
+  bool found = false;
+  for (const auto &profile : Profiler::snapshot()) {
+    if (profile.callback == "TestAgent.decide") {
+      found = profile.calls == 400 && profile.total == Duration(20000) &&
+              profile.lockWait == Duration(4000) &&
+              profile.conversion == Duration(2000);
+    }
+  }
+  ensure(found, "Callback profile mismatch");
+
+  Profiler::setEnabled(true);
+  ensure(Profiler::isEnabled(), "Callback profiler not enabled");
+  Profiler::setEnabled(false);
+  Profiler::reset();
+  ensure(account.getProfile().calls == 0 &&
+             account.getProfile().total == Duration(0),
+         "Callback profile not reset");
+
+  std::cout << "CallbackProfiler tests PASSED" << std::endl;
+}
+
+// Test the copy-on-write snapshots of consistent states
+void testConsistentStateSnapshot() {
+  std::cout << "Testing ConsistentPublicLocalDynamicState snapshots..."
+            << std::endl;
+
+  mk::LevelIdentifier level("snapshot_level");
+  mk::SimulationTimeStamp lower(0);
+  mk::SimulationTimeStamp upper(1);
+  mk::dynamicstate::ConsistentPublicLocalDynamicState state(lower, level);
+  state.addInfluence(std::make_shared<mk::influences::RegularInfluence>(
+      "first", level, lower, upper));
+
+  auto snapshot = state.snapshot();
+  ensure(&snapshot->viewRegularInfluencesOfStateDynamics() ==
+             &state.viewRegularInfluencesOfStateDynamics(),
+         "Snapshot copied the influences");
+
+  state.addInfluence(std::make_shared<mk::influences::RegularInfluence>(
+      "second", level, lower, upper));
+  state.clearSystemInfluences();
+  ensure(state.viewRegularInfluencesOfStateDynamics().size() == 2,
+         "State modification was lost");
+  ensure(snapshot->viewRegularInfluencesOfStateDynamics().size() == 1,
+         "Snapshot saw a later modification");
+
+  auto clone = std::dynamic_pointer_cast<
+      mk::dynamicstate::ConsistentPublicLocalDynamicState>(state.clone());
+  clone->clearRegularInfluences();
+  ensure(state.viewRegularInfluencesOfStateDynamics().size() == 2,
+         "Clearing a clone modified the original state");
+
+  std::cout << "ConsistentPublicLocalDynamicState snapshot tests PASSED"
+            << std::endl;
+}
+
+// Test the spatial index of the public local states of a level
+void testPublicLocalStateIndex() {
+  std::cout << "Testing PublicLocalStateIndex..." << std::endl;
+
+  class Point : public mk::agents::ILocalStateOfAgent {
+  public:
+    mk::LevelIdentifier level;
+    double x, y;
+    Point(const mk::LevelIdentifier &level, double x, double y)
+        : level(level), x(x), y(y) {}
+    mk::LevelIdentifier getLevel() const override { return level; }
+    mk::AgentCategory getCategoryOfAgent() const override {
+      return mk::AgentCategory("point");
+    }
+    bool isOwnedBy(const mk::agents::IAgent &) const override { return true; }
+    std::shared_ptr<mk::ILocalState> clone() const override {
+      return std::make_shared<Point>(*this);
+    }
+  };
+  class Level : public mk::libs::abstractimpl::AbstractLevel {
+  public:
+    explicit Level(const mk::LevelIdentifier &identifier)
+        : AbstractLevel(mk::SimulationTimeStamp(0), identifier) {}
+    mk::SimulationTimeStamp
+    getNextTime(const mk::SimulationTimeStamp &currentTime) override {
+      return mk::SimulationTimeStamp(currentTime, 1);
+    }
+    void makeRegularReaction(
+        const mk::SimulationTimeStamp &, const mk::SimulationTimeStamp &,
+        std::shared_ptr<mk::dynamicstate::ConsistentPublicLocalDynamicState>,
+        const std::set<std::shared_ptr<mk::influences::IInfluence>> &,
+        std::shared_ptr<mk::influences::InfluencesMap>) override {
+      updateSpatialIndex();
+    }
+    void makeSystemReaction(
+        const mk::SimulationTimeStamp &, const mk::SimulationTimeStamp &,
+        std::shared_ptr<mk::dynamicstate::ConsistentPublicLocalDynamicState>,
+        const std::vector<std::shared_ptr<mk::influences::IInfluence>> &,
+        bool, std::shared_ptr<mk::influences::InfluencesMap>) override {}
+    std::shared_ptr<mk::levels::ILevel> clone() const override {
+      return std::make_shared<Level>(*this);
+    }
+  };
+
+  const mk::LevelIdentifier id("indexed_level");
+  Level level(id);
+  auto state = level.getLastConsistentState();
+  bool thrown = false;
+  try {
+    state->getPublicLocalStatesOfAgentsWithin(0, 0, 1);
+  } catch (const std::logic_error &) {
+    thrown = true;
+  }
+  ensure(thrown, "A level without index answered a region query");
+
+  // A grid of points, with a state without position
+  std::vector<std::shared_ptr<Point>> points;
+  for (int i = 0; i < 100; ++i) {
+    points.push_back(std::make_shared<Point>(id, i % 10, i / 10));
+    state->addPublicLocalStateOfAgent(points.back());
+  }
+  state->addPublicLocalStateOfAgent(
+      std::make_shared<Point>(id, std::nan(""), 0));
+  level.setSpatialIndex(
+      2.0, [](const mk::agents::ILocalStateOfAgent &s, double &x, double &y) {
+        const auto &point = static_cast<const Point &>(s);
+        x = point.x;
+        y = point.y;
+        return true;
+      });
+  ensure(state->getSpatialIndex()->size() == 100,
+         "The state without position was indexed");
+
+  auto linear = [&](double x, double y, double radius) {
+    std::size_t count = 0;
+    for (const auto &point : points) {
+      count += std::hypot(point->x - x, point->y - y) <= radius;
+    }
+    return count;
+  };
+  for (double radius : {0.0, 1.0, 1.5, 3.0, 20.0}) {
+    ensure(state->getPublicLocalStatesOfAgentsWithin(4, 5, radius).size() ==
+               linear(4, 5, radius),
+           "Region query mismatch");
+  }
+  ensure(state->getPublicLocalStatesOfAgentsWithin(-3, -3, 1).empty(),
+         "Region query outside the points found states");
+  auto all = state->getSpatialIndex()->withinAll({{0, 0}, {9, 9}, {4, 5}}, 1);
+  ensure(all.size() == 3 && all[0].size() == linear(0, 0, 1) &&
+             all[1].size() == linear(9, 9, 1) &&
+             all[2].size() == linear(4, 5, 1),
+         "Bulk region queries mismatch");
+
+  // A snapshot keeps the index of its time
+  auto snapshot = state->snapshot();
+  points[0]->x = 50;
+  level.makeRegularReaction(mk::SimulationTimeStamp(0),
+                            mk::SimulationTimeStamp(1), state, {}, nullptr);
+  ensure(snapshot->getSpatialIndex() != state->getSpatialIndex(),
+         "The rebuild modified the index of a snapshot");
+  ensure(snapshot->getPublicLocalStatesOfAgentsWithin(0, 0, 0.5).size() == 1,
+         "The snapshot lost its index");
+  ensure(state->getPublicLocalStatesOfAgentsWithin(50, 0, 0.5).size() == 1,
+         "The rebuild missed a move");
+
+  std::cout << "PublicLocalStateIndex tests PASSED" << std::endl;
+}
+
+// Test the slot-based agent registry of the engines
+void testAgentRegistry() {
+  std::cout << "Testing AgentRegistry..." << std::endl;
+
+  class TestAgent : public mk::libs::AbstractAgent {
+  private:
+    std::set<mk::LevelIdentifier> levels;
+
+  public:
+    explicit TestAgent(std::set<mk::LevelIdentifier> levels,
+                       const std::string &category = "registry_agent")
+        : AbstractAgent(mk::AgentCategory(category)),
+          levels(std::move(levels)) {}
+
+    std::set<mk::LevelIdentifier> getLevels() const override { return levels; }
+
+    std::shared_ptr<mk::agents::IPerceivedData>
+    perceive(const mk::LevelIdentifier &, const mk::SimulationTimeStamp &,
+             const mk::SimulationTimeStamp &,
+             const std::map<mk::LevelIdentifier,
+                            std::shared_ptr<mk::agents::ILocalStateOfAgent>> &,
+             std::shared_ptr<mk::agents::ILocalStateOfAgent>,
+             std::shared_ptr<mk::dynamicstate::IPublicDynamicStateMap>)
+        override {
+      return nullptr;
+    }
+
+    void reviseGlobalState(
+        const mk::SimulationTimeStamp &, const mk::SimulationTimeStamp &,
+        const std::map<mk::LevelIdentifier,
+                       std::shared_ptr<mk::agents::IPerceivedData>> &,
+        std::shared_ptr<mk::agents::IGlobalState>) override {}
+
+    void decide(const mk::LevelIdentifier &, const mk::SimulationTimeStamp &,
+                const mk::SimulationTimeStamp &,
+                std::shared_ptr<mk::agents::IGlobalState>,
+                std::shared_ptr<mk::agents::ILocalStateOfAgent>,
+                std::shared_ptr<mk::agents::ILocalStateOfAgent>,
+                std::shared_ptr<mk::agents::IPerceivedData>,
+                std::shared_ptr<mk::influences::InfluencesMap>) override {}
+
+    std::shared_ptr<mk::agents::IAgent> clone() const override {
+      return std::make_shared<TestAgent>(*this);
+    }
+  };
+
+  mk::LevelIdentifier a("registry_a");
+  mk::LevelIdentifier b("registry_b");
+  auto first = std::make_shared<TestAgent>(std::set<mk::LevelIdentifier>{a});
+  auto second =
+      std::make_shared<TestAgent>(std::set<mk::LevelIdentifier>{a, b});
+  auto third = std::make_shared<TestAgent>(std::set<mk::LevelIdentifier>{b});
+
+  mk::engine::AgentRegistry registry;
+  const std::size_t firstSlot = registry.add(first);
+  registry.add(second);
+  registry.add(third);
+  ensure(registry.add(first) == firstSlot, "Agent registered twice");
+  ensure(registry.size() == 3 && registry.inLevel(a).size() == 2 &&
+             registry.inLevel(b).size() == 2,
+         "AgentRegistry size mismatch");
+
+  ensure(registry.remove(first) && !registry.contains(first),
+         "AgentRegistry removal failed");
+  ensure(!registry.remove(first), "Agent removed twice");
+  ensure(registry.inLevel(a).size() == 1 && registry.inLevel(a)[0] == second,
+         "Level view not updated by the removal");
+
+  auto fourth = std::make_shared<TestAgent>(std::set<mk::LevelIdentifier>{a});
+  ensure(registry.add(fourth) == firstSlot, "Free slot was not reused");
+  ensure(registry.agentAt(firstSlot) == fourth, "Slot lookup mismatch");
+  ensure(registry.slotCount() == 3, "Registry grew instead of reusing slots");
+
+  registry.remove(second);
+  ensure(registry.inLevel(b).size() == 1 && registry.inLevel(b)[0] == third,
+         "Removal broke the level positions");
+  ensure(mk::engine::AgentRegistry::toSet(registry.all()) ==
+             std::set<mk::engine::AgentRegistry::AgentPtr>{third, fourth},
+         "Registry contents mismatch");
+
+  // Batched changes keep the order of the remaining agents.
+  auto fifth = std::make_shared<TestAgent>(std::set<mk::LevelIdentifier>{a});
+  registry.add(fifth);
+  registry.applyChanges({third, fourth}, {first});
+  ensure(registry.size() == 2 && registry.all()[0] == fifth &&
+             registry.all()[1] == first,
+         "Batched changes mismatch");
+  ensure(registry.inLevel(b).empty() && registry.inLevel(a).size() == 2,
+         "Batched changes broke the level views");
+
+  // The agents of a category are contiguous, whatever the order of all()
+  const mk::AgentCategory category("registry_agent");
+  const mk::AgentCategory otherCategory("registry_other");
+  auto other = std::make_shared<TestAgent>(std::set<mk::LevelIdentifier>{b},
+                                           "registry_other");
+  auto sixth = std::make_shared<TestAgent>(std::set<mk::LevelIdentifier>{a});
+  registry.add(other);
+  registry.add(sixth);
+  const std::size_t otherIndex = registry.categoryIndexOf(otherCategory);
+  ensure(registry.categoryCount() == 2 && otherIndex != 0 &&
+             registry.categoryIndexAt(2) == otherIndex &&
+             registry.categoryIndexAt(3) == registry.categoryIndexOf(category),
+         "Category indices mismatch");
+  ensure(registry.inCategory(category).size() == 3 &&
+             registry.inCategory(otherCategory).size() == 1 &&
+             registry.inCategory(otherCategory)[0] == other,
+         "Category views mismatch");
+  registry.applyChanges({fifth}, {});
+  ensure(mk::engine::AgentRegistry::toSet(registry.inCategory(category)) ==
+             std::set<mk::engine::AgentRegistry::AgentPtr>{first, sixth},
+         "Batched changes broke the category views");
+  registry.remove(other);
+  ensure(registry.inCategory(otherCategory).empty() &&
+             registry.inCategory(mk::AgentCategory("registry_none")).empty() &&
+             registry.categoryIndexAt(1) == registry.categoryIndexOf(category),
+         "Removal broke the category views");
+
+  // Reordering sorts every view by the keys and keeps the slots
+  auto seventh = std::make_shared<TestAgent>(
+      std::set<mk::LevelIdentifier>{a, b}, "registry_other");
+  registry.add(seventh);
+  const std::size_t seventhSlot = registry.slotOf(seventh);
+  std::map<const mk::agents::IAgent4Engine *, std::uint64_t> keys{
+      {first.get(), 2}, {sixth.get(), 1}, {seventh.get(), 0}};
+  registry.reorder([&keys](const mk::agents::IAgent4Engine &agent) {
+    return keys.at(&agent);
+  });
+  ensure(registry.all()[0] == seventh && registry.all()[1] == sixth &&
+             registry.all()[2] == first,
+         "Reordering mismatch");
+  ensure(registry.inLevel(a)[0] == seventh &&
+             registry.inLevel(a)[1] == sixth &&
+             registry.inCategory(category)[0] == sixth &&
+             registry.slotOf(seventh) == seventhSlot &&
+             registry.categoryIndexAt(0) ==
+                 registry.categoryIndexOf(otherCategory),
+         "Reordering broke the level or category views");
+  registry.remove(sixth);
+  ensure(registry.size() == 2 && registry.inLevel(a).size() == 2 &&
+             registry.inCategory(category).size() == 1 &&
+             registry.inCategory(category)[0] == first,
+         "Removal after a reordering failed");
+
+  // A sleeping agent is activated by its wake condition before its time,
+  // and the condition is dropped once the agent is activated otherwise.
+  class NoStates : public mk::dynamicstate::IPublicDynamicStateMap {
+  public:
+    std::set<mk::LevelIdentifier> keySet() const override { return {}; }
+    std::shared_ptr<mk::dynamicstate::IPublicLocalDynamicState>
+    get(const mk::LevelIdentifier &) const override {
+      return nullptr;
+    }
+    void put(std::shared_ptr<mk::dynamicstate::IPublicLocalDynamicState>)
+        override {}
+  };
+  const NoStates states;
+  bool awake = false;
+  long now = 0;
+  auto condition = std::make_shared<mk::agents::WakeWhen>(
+      [&awake](const mk::SimulationTimeStamp &,
+               const mk::dynamicstate::IPublicDynamicStateMap &) {
+        return awake;
+      });
+  auto isMet = [&](const mk::agents::IWakeCondition &wake) {
+    return wake.isMet(mk::SimulationTimeStamp(now), states);
+  };
+  mk::engine::ActivationSchedule schedule;
+  const std::size_t sleeperSlot = registry.slotOf(first);
+  schedule.schedule(sleeperSlot, first, 10);
+  schedule.schedule(registry.slotOf(seventh), seventh, 10);
+  schedule.sleep(sleeperSlot, first, condition);
+  ensure(schedule.collect(registry, now = 1, isMet).empty() &&
+             schedule.sleepingCount() == 1,
+         "Sleeping agent activated before its condition");
+  awake = true;
+  const auto &woken = schedule.collect(registry, now = 2, isMet);
+  ensure(woken.size() == 1 && woken[0] == first &&
+             schedule.sleepingCount() == 0,
+         "Wake condition did not activate the agent");
+  const auto &timed = schedule.collect(registry, now = 10, isMet);
+  ensure(timed.size() == 1 && timed[0] == seventh,
+         "Woken agent kept its superseded activation time");
+  awake = false;
+  schedule.schedule(sleeperSlot, first, 20);
+  schedule.sleep(sleeperSlot, first, condition);
+  ensure(schedule.collect(registry, now = 20, isMet).size() == 1,
+         "Sleeping agent missed its activation time");
+  awake = true;
+  ensure(schedule.collect(registry, now = 21, isMet).empty() &&
+             schedule.sleepingCount() == 0,
+         "Wake condition outlived the activation of the agent");
+
+  std::cout << "AgentRegistry tests PASSED" << std::endl;
+}
+
 // Test level and environment classes
 void testLevelAndEnvironment() {
   std::cout << "Testing level and environment classes..." << std::endl;
@@ -306,6 +1078,3070 @@ void testLevelAndEnvironment() {
   std::cout << "EmptyPerceivedData tests PASSED" << std::endl;
 }
 
+// Test the latest messages streamed to the web view
+void testStateStream() {
+  std::cout << "Testing StateStream..." << std::endl;
+
+  using fr::univ_artois::lgi2a::similar::extendedkernel::libs::web::view::
+      StateStream;
+  StateStream stream;
+  std::uint64_t version = 0;
+  std::string text;
+  ensure(!stream.waitForUpdate(version, text, std::chrono::milliseconds(1)),
+         "State stream update without message");
+
+  // A slow reader gets the last message of each event only
+  stream.publish("state", "{\"step\":1}");
+  stream.publish("controls", "a\nb");
+  stream.publish("state", "{\"step\":2}");
+  ensure(stream.waitForUpdate(version, text, std::chrono::milliseconds(1)),
+         "State stream update missed");
+  ensure(text == "event: controls\ndata: a\ndata: b\n\n"
+                 "event: state\ndata: {\"step\":2}\n\n",
+         "State stream messages mismatch");
+  ensure(version == 3, "State stream version mismatch");
+
+  // Then the messages published since
+  stream.publish("state", "{\"step\":3}");
+  ensure(stream.waitForUpdate(version, text, std::chrono::milliseconds(1)) &&
+             text == "event: state\ndata: {\"step\":3}\n\n",
+         "State stream new message mismatch");
+
+  // Closing wakes up a reader waiting
+  std::thread closer([&stream]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    stream.close();
+  });
+  ensure(!stream.waitForUpdate(version, text, std::chrono::seconds(10)),
+         "State stream update after close");
+  closer.join();
+  ensure(stream.isClosed(), "State stream not closed");
+
+  std::cout << "StateStream tests PASSED" << std::endl;
+}
+
+void testAsyncProbe() {
+  std::cout << "Testing AsyncProbe..." << std::endl;
+
+  using ek_probes::AsyncProbe;
+  using ek_probes::AsyncProbePolicy;
+  mk::engine::SequentialSimulationEngine engine;
+
+  // A consumer recording the times of the snapshots, held until released
+  struct Consumer {
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool released = false;
+    std::vector<long long> times;
+
+    void consume(const mk::SimulationTimeStamp &time, const long long &value) {
+      std::unique_lock<std::mutex> lock(mutex);
+      ensure(value == time.getIdentifier(), "AsyncProbe snapshot mismatch");
+      times.push_back(value);
+      changed.notify_all();
+      changed.wait(lock, [this]() { return released; });
+    }
+    void waitForCount(std::size_t count) {
+      std::unique_lock<std::mutex> lock(mutex);
+      changed.wait(lock, [&]() { return times.size() >= count; });
+    }
+    void release() {
+      std::lock_guard<std::mutex> lock(mutex);
+      released = true;
+      changed.notify_all();
+    }
+  };
+  auto makeProbe = [&engine](Consumer &consumer, AsyncProbePolicy policy) {
+    return std::make_unique<AsyncProbe<long long>>(
+        [&engine](const mk::SimulationTimeStamp &time,
+                  const mk::ISimulationEngine &observed) {
+          ensure(&observed == &engine, "AsyncProbe engine mismatch");
+          return time.getIdentifier();
+        },
+        [&consumer](const mk::SimulationTimeStamp &time,
+                    const long long &value) { consumer.consume(time, value); },
+        2, policy);
+  };
+  // The consumer holds the initial snapshot while two more fill the buffer
+  auto fill = [&engine](AsyncProbe<long long> &probe, Consumer &consumer) {
+    probe.prepareObservation();
+    probe.observeAtInitialTimes(mk::SimulationTimeStamp(0), engine);
+    consumer.waitForCount(1);
+    probe.observeAtPartialConsistentTime(mk::SimulationTimeStamp(1), engine);
+    probe.observeAtPartialConsistentTime(mk::SimulationTimeStamp(2), engine);
+    ensure(probe.getQueueDepth() == 2, "AsyncProbe queue depth mismatch");
+  };
+  // Runs an observation on another thread, telling whether it returned
+  // while the consumer was still held
+  auto observeHeld = [](Consumer &consumer,
+                        const std::function<void()> &observe) {
+    std::atomic<bool> returned{false};
+    std::thread observer([&]() {
+      observe();
+      returned = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    const bool returnedWhileHeld = returned;
+    consumer.release();
+    observer.join();
+    return returnedWhileHeld;
+  };
+
+  // BLOCK: the simulation waits for a place, and nothing is lost
+  {
+    Consumer consumer;
+    auto probe = makeProbe(consumer, AsyncProbePolicy::BLOCK);
+    fill(*probe, consumer);
+    ensure(!observeHeld(consumer,
+                        [&]() {
+                          probe->observeAtPartialConsistentTime(
+                              mk::SimulationTimeStamp(3), engine);
+                        }),
+           "AsyncProbe did not block on a full buffer");
+    probe->observeAtFinalTime(mk::SimulationTimeStamp(4), engine);
+    probe->endObservation();
+    ensure(consumer.times == std::vector<long long>({0, 1, 2, 3, 4}) &&
+               probe->getDroppedCount() == 0 && probe->getQueueDepth() == 0,
+           "AsyncProbe BLOCK mismatch");
+  }
+
+  // DROP_NEWEST: the snapshots arriving on a full buffer are lost, but the
+  // final one waits for its place, and is consumed before the final
+  // observation returns
+  {
+    Consumer consumer;
+    auto probe = makeProbe(consumer, AsyncProbePolicy::DROP_NEWEST);
+    fill(*probe, consumer);
+    probe->observeAtPartialConsistentTime(mk::SimulationTimeStamp(3), engine);
+    probe->observeAtPartialConsistentTime(mk::SimulationTimeStamp(4), engine);
+    ensure(probe->getDroppedCount() == 2 && probe->getQueueDepth() == 2,
+           "AsyncProbe DROP_NEWEST did not drop");
+    ensure(!observeHeld(consumer,
+                        [&]() {
+                          probe->observeAtFinalTime(
+                              mk::SimulationTimeStamp(5), engine);
+                        }),
+           "AsyncProbe dropped the final snapshot");
+    ensure(consumer.times == std::vector<long long>({0, 1, 2, 5}),
+           "AsyncProbe DROP_NEWEST mismatch");
+    probe->endObservation();
+  }
+
+  // DROP_OLDEST: the snapshots waiting the longest make room for new ones
+  {
+    Consumer consumer;
+    auto probe = makeProbe(consumer, AsyncProbePolicy::DROP_OLDEST);
+    fill(*probe, consumer);
+    probe->observeAtPartialConsistentTime(mk::SimulationTimeStamp(3), engine);
+    probe->observeAtPartialConsistentTime(mk::SimulationTimeStamp(4), engine);
+    ensure(probe->getDroppedCount() == 2 && probe->getQueueDepth() == 2,
+           "AsyncProbe DROP_OLDEST did not drop");
+    consumer.release();
+    probe->observeAtFinalTime(mk::SimulationTimeStamp(5), engine);
+    ensure(consumer.times == std::vector<long long>({0, 3, 4, 5}),
+           "AsyncProbe DROP_OLDEST mismatch");
+    probe->endObservation();
+  }
+
+  // Behind a consumer taking one snapshot at a time, the final snapshot is
+  // the last one consumed, before the final observation returns
+  {
+    Consumer consumer;
+    consumer.release();
+    auto probe = std::make_shared<AsyncProbe<long long>>(
+        [](const mk::SimulationTimeStamp &time, const mk::ISimulationEngine &) {
+          return time.getIdentifier();
+        },
+        [&consumer](const mk::SimulationTimeStamp &time,
+                    const long long &value) { consumer.consume(time, value); },
+        1, AsyncProbePolicy::DROP_NEWEST);
+    probe->prepareObservation();
+    for (long long time = 0; time < 50; ++time) {
+      probe->observeAtPartialConsistentTime(mk::SimulationTimeStamp(time),
+                                            engine);
+    }
+    probe->observeAtFinalTime(mk::SimulationTimeStamp(50), engine);
+    ensure(!consumer.times.empty() && consumer.times.back() == 50 &&
+               consumer.times.size() + probe->getDroppedCount() == 51,
+           "AsyncProbe final snapshot mismatch");
+    probe->endObservation();
+  }
+
+  bool threw = false;
+  try {
+    AsyncProbe<long long> empty(nullptr, nullptr);
+  } catch (const std::invalid_argument &) {
+    threw = true;
+  }
+  ensure(threw, "AsyncProbe accepted empty functions");
+
+  std::cout << "AsyncProbe tests PASSED" << std::endl;
+}
+
+void testStepBarrier() {
+  std::cout << "Testing StepBarrier..." << std::endl;
+
+  mk::engine::StepBarrier barrier;
+  std::atomic<bool> abortRequested{false};
+  std::atomic<int> steps{0};
+  std::thread engine([&]() {
+    while (!abortRequested) {
+      barrier.awaitStep(abortRequested);
+      if (!abortRequested) {
+        ++steps;
+      }
+    }
+  });
+  auto waitForSteps = [&steps](int count) {
+    for (int i = 0; i < 1000 && steps < count; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  };
+
+  // Paused, the engine does not step; each single step lets one through
+  barrier.pause();
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  const int pausedAt = steps;
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  ensure(steps == pausedAt && barrier.isPaused(),
+         "Step barrier stepped while paused");
+  // An action runs while the engine waits paused, holding it there
+  bool ran = false;
+  ensure(barrier.whileParked([&]() { ran = steps == pausedAt; }) && ran,
+         "Step barrier did not run an action while parked");
+  barrier.step(2);
+  waitForSteps(pausedAt + 2);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  ensure(steps == pausedAt + 2, "Step barrier single steps mismatch");
+
+  // Paced, the steps wait for their time
+  barrier.setStepRate(100.0);
+  ensure(barrier.getStepRate() > 99.9 && barrier.getStepRate() < 100.1,
+         "Step barrier rate mismatch");
+  const int pacedFrom = steps;
+  const auto start = std::chrono::steady_clock::now();
+  barrier.resume();
+  waitForSteps(pacedFrom + 5);
+  ensure(steps >= pacedFrom + 5 &&
+             std::chrono::steady_clock::now() - start >=
+                 std::chrono::milliseconds(35),
+         "Step barrier pacing mismatch");
+
+  // Accelerated 4 times, 40 steps take 100 ms on their timeline, the last
+  // 300 us of each wait spinning
+  barrier.setAcceleration(4.0);
+  barrier.setSpinThreshold(std::chrono::microseconds(300));
+  ensure(barrier.getAcceleration() == 4.0 && barrier.getStepRate() == 100.0 &&
+             barrier.getSpinThreshold() == std::chrono::microseconds(300),
+         "Step barrier acceleration mismatch");
+  const int acceleratedFrom = steps;
+  const auto acceleratedStart = std::chrono::steady_clock::now();
+  waitForSteps(acceleratedFrom + 41);
+  const auto statistics = barrier.getPacingStatistics();
+  ensure(steps >= acceleratedFrom + 41 &&
+             std::chrono::steady_clock::now() - acceleratedStart >=
+                 std::chrono::milliseconds(95) &&
+             statistics.steps >= 40 &&
+             statistics.maxLatenessSeconds >= statistics.meanLatenessSeconds,
+         "Step barrier accelerated pacing mismatch");
+
+  // The abortion wakes up the engine paused
+  barrier.pause();
+  abortRequested = true;
+  barrier.interrupt();
+  engine.join();
+  ensure(!barrier.whileParked([]() {}),
+         "Step barrier ran an action without the engine");
+
+  bool threw = false;
+  try {
+    barrier.setStepRate(-1.0);
+  } catch (const std::invalid_argument &) {
+    threw = true;
+  }
+  ensure(threw, "Step barrier accepted a negative rate");
+  for (double factor : {0.0, -1.0, std::nan("")}) {
+    threw = false;
+    try {
+      barrier.setAcceleration(factor);
+    } catch (const std::invalid_argument &) {
+      threw = true;
+    }
+    ensure(threw, "Step barrier accepted an invalid acceleration");
+  }
+
+  std::cout << "StepBarrier tests PASSED" << std::endl;
+}
+
+void testParameterStore() {
+  std::cout << "Testing ParameterStore..." << std::endl;
+
+  using fr::univ_artois::lgi2a::similar::extendedkernel::simulationmodel::
+      ParameterStore;
+  ParameterStore store;
+  auto speed = store.declare("speed", 1.5);
+  auto count = store.declare<std::int64_t>("count", 3);
+  auto wrap = store.declare("wrap", false);
+  auto label = store.declare("label", std::string("prey"));
+  ensure(store.get(speed) == 1.5 && store.get(count) == 3 &&
+             !store.get(wrap) && store.get(label) == "prey",
+         "Parameter store initial values mismatch");
+  ensure(!store.commit(), "Parameter store commit without change");
+
+  // The staged values wait for the commit at the step boundary
+  store.set(speed, 2);
+  store.set("count", "7");
+  store.set("wrap", "true");
+  store.set("label", "predator");
+  ensure(store.get(speed) == 1.5 && store.get(count) == 3,
+         "Parameter store value published before the commit");
+  ensure(store.getText("speed") == "2" && store.getText("wrap") == "true",
+         "Parameter store staged text mismatch");
+  ensure(store.commit(), "Parameter store commit missed");
+  ensure(store.get(speed) == 2.0 && store.get(count) == 7 &&
+             store.get(wrap) && store.get(label) == "predator",
+         "Parameter store committed values mismatch");
+
+  // Both buffers take their turn
+  store.set(speed, 4.0);
+  store.commit();
+  store.set(count, 9);
+  store.commit();
+  ensure(store.get(speed) == 4.0 && store.get(count) == 9,
+         "Parameter store second commits mismatch");
+
+  auto rejects = [&store](const std::string &name, const std::string &text) {
+    try {
+      store.set(name, text);
+    } catch (const std::invalid_argument &) {
+      return true;
+    }
+    return false;
+  };
+  ensure(rejects("speed", "fast") && rejects("count", "1.5") &&
+             rejects("wrap", "yes") && rejects("unknown", "1"),
+         "Parameter store accepted an invalid value");
+  ensure(store.getNames() ==
+             std::vector<std::string>({"count", "label", "speed", "wrap"}),
+         "Parameter store names mismatch");
+
+  std::cout << "ParameterStore tests PASSED" << std::endl;
+}
+
+void testSimilarSessionServer() {
+  std::cout << "Testing SimilarSessionServer..." << std::endl;
+
+  namespace web = fr::univ_artois::lgi2a::similar::extendedkernel::libs::web;
+  namespace sm = fr::univ_artois::lgi2a::similar::extendedkernel::
+      simulationmodel;
+
+  // A simulation without levels, which ends as soon as it starts
+  class EmptyModel : public sm::ISimulationModel {
+  public:
+    sm::ISimulationParameters *getSimulationParameters() override {
+      return nullptr;
+    }
+    mk::SimulationTimeStamp getInitialTime() const override {
+      return mk::SimulationTimeStamp(0);
+    }
+    bool isFinalTimeOrAfter(const mk::SimulationTimeStamp &currentTime,
+                            const mk::ISimulationEngine &) const override {
+      return currentTime.getIdentifier() >= 10;
+    }
+    std::vector<std::shared_ptr<mk::levels::ILevel>>
+    generateLevels(const mk::SimulationTimeStamp &) override {
+      return {};
+    }
+    EnvironmentInitializationData generateEnvironment(
+        const mk::SimulationTimeStamp &,
+        const std::map<mk::LevelIdentifier,
+                       std::shared_ptr<mk::levels::ILevel>> &) override {
+      return EnvironmentInitializationData(nullptr);
+    }
+    AgentInitializationData generateAgents(
+        const mk::SimulationTimeStamp &,
+        const std::map<mk::LevelIdentifier,
+                       std::shared_ptr<mk::levels::ILevel>> &) override {
+      return AgentInitializationData();
+    }
+  };
+
+  std::atomic<int> loads{0};
+  std::vector<std::shared_ptr<const std::vector<double>>> tables;
+  std::mutex tablesMutex;
+  web::SimilarSessionServer server([&](web::SharedAssets &assets) {
+    auto table = assets.get<std::vector<double>>("table", [&loads]() {
+      ++loads;
+      return std::make_shared<const std::vector<double>>(100, 1.0);
+    });
+    {
+      std::lock_guard<std::mutex> lock(tablesMutex);
+      tables.push_back(table);
+    }
+    return web::SimilarSessionServer::SessionSimulation{
+        std::make_shared<mk::engine::SequentialSimulationEngine>(),
+        std::make_shared<EmptyModel>()};
+  });
+  server.getConfig()->setMaxSessions(2);
+  server.getConfig()->setSimulationThreadCount(1);
+
+  // The sessions share the asset, loaded once
+  const std::uint64_t first = server.openSession();
+  const std::uint64_t second = server.openSession();
+  ensure(first != second && server.getSessionCount() == 2,
+         "Session server sessions mismatch");
+  ensure(loads == 1 && tables.size() == 2 && tables[0] == tables[1],
+         "Session server asset loaded again");
+  bool full = false;
+  try {
+    server.openSession();
+  } catch (const std::runtime_error &) {
+    full = true;
+  }
+  ensure(full, "Session server hosted too many sessions");
+
+  bool wrongType = false;
+  try {
+    server.getAssets().get<int>("table",
+                                []() { return std::make_shared<int>(1); });
+  } catch (const std::invalid_argument &) {
+    wrongType = true;
+  }
+  ensure(wrongType, "Shared asset read with another type");
+
+  // Both runs share the single simulation thread
+  httplib::Request request;
+  for (std::uint64_t id : {first, second}) {
+    httplib::Response response;
+    ensure(server.getSession(id)->handleViewRequest("start", request,
+                                                    response) &&
+               response.body == "OK",
+           "Session start request failed");
+  }
+  auto stateOf = [&](std::uint64_t id) {
+    httplib::Response response;
+    server.getSession(id)->handleViewRequest("state", request, response);
+    return response.body;
+  };
+  for (int i = 0; i < 1000 && (stateOf(first) != "IDLE" ||
+                               stateOf(second) != "IDLE");
+       ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  ensure(stateOf(first) == "IDLE" && stateOf(second) == "IDLE",
+         "Session runs did not end");
+  httplib::Response unknown;
+  ensure(!server.getSession(first)->handleViewRequest("unknown", request,
+                                                      unknown),
+         "Session handled an unknown action");
+
+  // The tiles, revalidated by their version
+  class OneTileSource : public web::view::ITileSource {
+  public:
+    std::string describeLayers() const override { return "{}"; }
+    Tile getTile(const std::string &layer, int zoom, int x,
+                 int y) override {
+      Tile tile;
+      if (layer == "food" && zoom == 0 && x == 0 && y == 0) {
+        tile.data = std::make_shared<const std::string>("png");
+        tile.version = 3;
+      }
+      return tile;
+    }
+  };
+  httplib::Response noTiles;
+  ensure(!server.getSession(first)->handleViewRequest("tiles", request,
+                                                      noTiles),
+         "Session served tiles without a source");
+  server.getSession(first)->setTileSource(std::make_shared<OneTileSource>());
+  httplib::Request tileRequest;
+  tileRequest.params = {{"layer", "food"}, {"z", "0"}, {"x", "0"}, {"y", "0"}};
+  httplib::Response tile;
+  server.getSession(first)->handleViewRequest("tile", tileRequest, tile);
+  ensure(tile.status != 404 && tile.body == "png" &&
+             tile.get_header_value("ETag") == "\"3\"",
+         "Session tile mismatch");
+  tileRequest.headers.emplace("If-None-Match", "\"3\"");
+  httplib::Response cached;
+  server.getSession(first)->handleViewRequest("tile", tileRequest, cached);
+  ensure(cached.status == 304 && cached.body.empty(),
+         "Session tile not revalidated");
+  tileRequest.params.find("x")->second = "1";
+  httplib::Response missing;
+  server.getSession(first)->handleViewRequest("tile", tileRequest, missing);
+  ensure(missing.status == 404, "Session served a missing tile");
+
+  ensure(server.closeSession(first) && !server.closeSession(first) &&
+             server.getSession(first) == nullptr &&
+             server.getSessionCount() == 1,
+         "Session close mismatch");
+  server.stop();
+  ensure(server.getSessionCount() == 0, "Session server stop left sessions");
+
+  std::cout << "SimilarSessionServer tests PASSED" << std::endl;
+}
+
+void testBatchRandom() {
+  std::cout << "Testing batch random generation..." << std::endl;
+  namespace rnd =
+      fr::univ_artois::lgi2a::similar::extendedkernel::libs::random;
+
+  // Same seed, same values, whatever the size of the buffer
+  std::vector<double> first(1003);
+  std::vector<double> second(1003);
+  rnd::RandomStream(42).fillUniform(first.data(), first.size());
+  rnd::RandomStream(42).fillUniform(second.data(), second.size());
+  ensure(first == second, "Batch uniform is not reproducible");
+  ensure(std::all_of(first.begin(), first.end(),
+                     [](double v) { return v >= 0.0 && v < 1.0; }),
+         "Batch uniform out of [0, 1)");
+
+  rnd::RandomStream stream(42);
+  stream.fillUniform(first.data(), first.size());
+  stream.fillUniform(second.data(), second.size());
+  ensure(first != second, "Successive batches are identical");
+
+  stream.fillUniform(first.data(), first.size(), -M_PI, M_PI);
+  ensure(std::all_of(first.begin(), first.end(),
+                     [](double v) { return v >= -M_PI && v < M_PI; }),
+         "Batch headings out of [-pi, pi)");
+
+  // Moments of the Ziggurat sampling, and its tail beyond R
+  std::vector<double> normal(1 << 20);
+  rnd::RandomStream(7).fillGaussian(normal.data(), normal.size());
+  double sum = 0.0;
+  double squares = 0.0;
+  std::size_t tail = 0;
+  for (double v : normal) {
+    sum += v;
+    squares += v * v;
+    tail += std::abs(v) > 3.6541528853610088 ? 1 : 0;
+  }
+  const double mean = sum / normal.size();
+  const double variance = squares / normal.size() - mean * mean;
+  ensure(std::abs(mean) < 0.01, "Batch Gaussian mean mismatch");
+  ensure(std::abs(variance - 1.0) < 0.01, "Batch Gaussian variance mismatch");
+  // About 270 expected
+  ensure(tail > 150 && tail < 400, "Batch Gaussian tail mismatch");
+
+  // PRNG draws from the stream installed on the thread
+  std::vector<double> installed(64);
+  std::vector<double> direct(64);
+  rnd::RandomStream scoped(9);
+  {
+    rnd::RandomStream::Scope scope(scoped);
+    rnd::PRNG::fillGaussian(installed, 10.0, 2.0);
+  }
+  rnd::RandomStream(9).fillGaussian(direct.data(), direct.size(), 10.0,
+                                    2.0);
+  ensure(installed == direct, "PRNG batch ignored the installed stream");
+
+  std::cout << "Batch random tests PASSED" << std::endl;
+}
+
+void testPerceivedDataRecycling() {
+  std::cout << "Testing perceived data recycling..." << std::endl;
+
+  namespace ea = fr::univ_artois::lgi2a::similar::extendedkernel::agents;
+  using Perceived = mk::libs::generic::EmptyPerceivedData;
+  const mk::LevelIdentifier level("recycling");
+
+  class Perception : public ea::IAgtPerceptionModel {
+  public:
+    mk::LevelIdentifier level;
+    int allocations = 0;
+    int refills = 0;
+
+    explicit Perception(const mk::LevelIdentifier &level) : level(level) {}
+    mk::LevelIdentifier getLevel() const override { return level; }
+    std::shared_ptr<mk::agents::IPerceivedData>
+    perceive(const mk::SimulationTimeStamp &lower,
+             const mk::SimulationTimeStamp &upper,
+             const std::map<mk::LevelIdentifier,
+                            std::shared_ptr<mk::agents::ILocalStateOfAgent>> &,
+             std::shared_ptr<mk::agents::ILocalStateOfAgent>,
+             std::shared_ptr<mk::dynamicstate::IPublicDynamicStateMap>)
+        override {
+      ++allocations;
+      return std::make_shared<Perceived>(level, lower, upper);
+    }
+    std::shared_ptr<mk::agents::IPerceivedData> perceiveInPlace(
+        const mk::SimulationTimeStamp &, const mk::SimulationTimeStamp &,
+        const std::map<mk::LevelIdentifier,
+                       std::shared_ptr<mk::agents::ILocalStateOfAgent>> &,
+        std::shared_ptr<mk::agents::ILocalStateOfAgent>,
+        std::shared_ptr<mk::dynamicstate::IPublicDynamicStateMap>,
+        const std::shared_ptr<mk::agents::IPerceivedData> &recycled)
+        override {
+      ++refills;
+      return recycled;
+    }
+  };
+  class Decision : public ea::IAgtDecisionModel {
+  public:
+    mk::LevelIdentifier level;
+    explicit Decision(const mk::LevelIdentifier &level) : level(level) {}
+    mk::LevelIdentifier getLevel() const override { return level; }
+  };
+
+  auto perception = std::make_shared<Perception>(level);
+  auto agent =
+      std::make_shared<ea::ExtendedAgent>(mk::AgentCategory("recycling"));
+  agent->specifyBehaviorForLevel(level, perception,
+                                 std::make_shared<Decision>(level));
+  auto perceiveAt = [&](long time) {
+    auto data = agent->perceive(level, mk::SimulationTimeStamp(time),
+                                mk::SimulationTimeStamp(time + 1), {},
+                                nullptr, nullptr);
+    agent->setPerceivedData(data);
+    return data;
+  };
+
+  auto first = perceiveAt(0);
+  // Still held, so the next perception allocates
+  auto second = perceiveAt(1);
+  ensure(perception->allocations == 2 && perception->refills == 0 &&
+             first != second,
+         "Held perceived data were recycled");
+  const auto *previous = second.get();
+  first.reset();
+  second.reset();
+  auto third = perceiveAt(2);
+  ensure(perception->allocations == 2 && perception->refills == 1 &&
+             third.get() == previous &&
+             third->getTransitoryPeriodMin().getIdentifier() == 2 &&
+             third->getTransitoryPeriodMax().getIdentifier() == 3,
+         "Released perceived data were not refilled in place");
+
+  std::cout << "Perceived data recycling tests PASSED" << std::endl;
+}
+
+void testStreamingStatistics() {
+  std::cout << "Testing streaming statistics..." << std::endl;
+
+  // The moments merged over halves are the moments of the whole
+  ek_probes::RunningMoments whole;
+  ek_probes::RunningMoments low;
+  ek_probes::RunningMoments high;
+  for (int i = 1; i <= 100; ++i) {
+    whole.add(i);
+    (i <= 37 ? low : high).add(i);
+  }
+  whole.add(std::nan(""));
+  low.merge(high);
+  ensure(whole.count() == 100 && whole.mean() == 50.5 &&
+             std::abs(whole.variance() - 833.25) < 1e-9 &&
+             whole.min() == 1.0 && whole.max() == 100.0,
+         "Running moments mismatch");
+  ensure(low.count() == 100 && std::abs(low.mean() - 50.5) < 1e-12 &&
+             std::abs(low.sampleVariance() - whole.sampleVariance()) < 1e-9,
+         "Merged moments mismatch");
+
+  // The Student intervals of the mean, t(0.975, 9) = 2.2622 and
+  // t(0.975, 1) = 12.706
+  ek_probes::RunningMoments ten;
+  for (int i = 1; i <= 10; ++i) {
+    ten.add(i);
+  }
+  ek_probes::RunningMoments two;
+  two.add(0.0);
+  two.add(2.0);
+  ensure(std::abs(ten.confidenceHalfWidth(0.95) - 2.1659) < 1e-3 &&
+             std::abs(two.confidenceHalfWidth(0.95) - 12.706) < 1e-3 &&
+             std::isinf(ek_probes::RunningMoments().confidenceHalfWidth()),
+         "Confidence half width mismatch");
+
+  // A histogram counts the values outside its range apart
+  ek_probes::FixedBinHistogram histogram(0.0, 10.0, 10);
+  for (int i = 0; i < 100; ++i) {
+    histogram.add(i * 0.1);
+  }
+  histogram.add(-1.0);
+  histogram.add(10.0);
+  ek_probes::FixedBinHistogram copy = histogram;
+  copy.merge(histogram);
+  ensure(histogram.counts()[3] == 10 && histogram.underflow() == 1 &&
+             histogram.overflow() == 1 && histogram.total() == 102 &&
+             copy.counts()[3] == 20,
+         "Histogram counts mismatch");
+  ensure(std::abs(histogram.quantile(0.5) - 5.0) < 0.1 &&
+             histogram.quantile(0.0) == 0.0 &&
+             histogram.quantile(1.0) == 10.0,
+         "Histogram quantiles mismatch");
+  bool rejected = false;
+  try {
+    histogram.merge(ek_probes::FixedBinHistogram(0.0, 10.0, 5));
+  } catch (const std::invalid_argument &) {
+    rejected = true;
+  }
+  ensure(rejected, "Histograms of different bins merged");
+
+  // The quantiles of a sketch are within its relative accuracy
+  ek_probes::QuantileSketch sketch(0.01);
+  ek_probes::QuantileSketch other(0.01);
+  for (int i = 1; i <= 10000; ++i) {
+    (i % 2 ? sketch : other).add(i);
+    sketch.add(-0.5 * i);
+  }
+  sketch.add(0.0);
+  sketch.merge(other);
+  ensure(sketch.count() == 20001, "Sketch count mismatch");
+  for (double q : {0.1, 0.25, 0.5, 0.75, 0.99}) {
+    // The exact quantile of the values, sorted
+    const double rank = q * 20000.0;
+    const double exact =
+        rank < 10000.0 ? -0.5 * (10000.0 - std::floor(rank))
+                       : (rank < 10001.0 ? 0.0 : std::floor(rank) - 10000.0);
+    ensure(std::abs(sketch.quantile(q) - exact) <= 0.011 * std::abs(exact) +
+                                                      0.5,
+           "Sketch quantile out of accuracy");
+  }
+  ensure(sketch.size() < 2000, "Sketch holds too many buckets");
+  ensure(std::isnan(ek_probes::QuantileSketch().quantile(0.5)),
+         "Empty sketch has a quantile");
+
+  // Categories and grid cells
+  ek_probes::CategoryCounter counter;
+  counter.add("ant", 2);
+  ek_probes::CategoryCounter more;
+  more.add("ant");
+  more.add("bee");
+  counter.merge(more);
+  ensure(counter.count("ant") == 3 && counter.count("bee") == 1 &&
+             counter.count("wasp") == 0 && counter.counts().size() == 2,
+         "Category counts mismatch");
+  ek_probes::DensityGrid grid(0.0, 0.0, 2.0, 3, 2);
+  grid.add(0.5, 0.5);
+  grid.add(5.9, 3.9);
+  grid.add(6.0, 0.0);
+  grid.add(std::nan(""), 1.0);
+  ensure(grid.count(0, 0) == 1 && grid.count(2, 1) == 1 &&
+             grid.outsideCount() == 2 && grid.counts().size() == 6,
+         "Density grid mismatch");
+
+  std::cout << "Streaming statistics tests PASSED" << std::endl;
+}
+
+void testStaticExtendedAgent() {
+  std::cout << "Testing StaticExtendedAgent..." << std::endl;
+
+  namespace ea = fr::univ_artois::lgi2a::similar::extendedkernel::agents;
+  namespace sm = fr::univ_artois::lgi2a::similar::extendedkernel::
+      simulationmodel;
+  using Perceived = mk::libs::generic::EmptyPerceivedData;
+  const mk::LevelIdentifier level("static");
+  const mk::LevelIdentifier other("static_other");
+
+  struct Counters {
+    std::atomic<int> perceptions{0};
+    std::atomic<int> revisions{0};
+    std::atomic<int> decisions{0};
+  };
+  auto counters = std::make_shared<Counters>();
+
+  struct Perception {
+    std::shared_ptr<Counters> counters;
+    mk::LevelIdentifier level;
+    std::shared_ptr<Perceived>
+    perceive(const mk::SimulationTimeStamp &lower,
+             const mk::SimulationTimeStamp &upper,
+             const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+             const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+             const std::shared_ptr<mk::dynamicstate::IPublicDynamicStateMap>
+                 &) {
+      ++counters->perceptions;
+      return std::make_shared<Perceived>(level, lower, upper);
+    }
+  };
+  struct Revision {
+    std::shared_ptr<Counters> counters;
+    void reviseGlobalState(const mk::SimulationTimeStamp &,
+                           const mk::SimulationTimeStamp &,
+                           const std::shared_ptr<Perceived> &data,
+                           const std::shared_ptr<mk::agents::IGlobalState> &) {
+      counters->revisions += data ? 1 : 0;
+    }
+  };
+  struct Decision {
+    std::shared_ptr<Counters> counters;
+    void decide(const mk::SimulationTimeStamp &,
+                const mk::SimulationTimeStamp &,
+                const std::shared_ptr<mk::agents::IGlobalState> &,
+                const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+                const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+                const std::shared_ptr<Perceived> &data,
+                const std::shared_ptr<mk::influences::InfluencesMap> &) {
+      counters->decisions += data ? 1 : 0;
+    }
+  };
+  using Agent = ea::StaticExtendedAgent<Perception, Decision, Revision>;
+
+  class State : public mk::agents::ILocalStateOfAgent {
+  private:
+    mk::LevelIdentifier level;
+
+  public:
+    explicit State(const mk::LevelIdentifier &level) : level(level) {}
+    mk::LevelIdentifier getLevel() const override { return level; }
+    mk::AgentCategory getCategoryOfAgent() const override {
+      return mk::AgentCategory("static_agent");
+    }
+    bool isOwnedBy(const mk::agents::IAgent &) const override { return true; }
+    std::shared_ptr<mk::ILocalState> clone() const override {
+      return std::make_shared<State>(*this);
+    }
+  };
+  class Memory : public mk::agents::IGlobalState {
+  public:
+    std::shared_ptr<mk::agents::IGlobalState> clone() const override {
+      return std::make_shared<Memory>(*this);
+    }
+  };
+  auto makeAgent = [&]() {
+    auto agent = std::make_shared<Agent>(
+        mk::AgentCategory("static_agent"), level,
+        Perception{counters, level}, Decision{counters}, Revision{counters});
+    agent->initializeGlobalState(std::make_shared<Memory>());
+    agent->includeNewLevel(level, std::make_shared<State>(level),
+                           std::make_shared<State>(level));
+    return agent;
+  };
+
+  auto first = makeAgent();
+  auto second = makeAgent();
+  const mk::engine::IAgentStepKernel *kernel = first->getStepKernel(level);
+  ensure(kernel != nullptr && kernel == second->getStepKernel(level) &&
+             first->getStepKernel(other) == nullptr,
+         "Static agents do not share their step kernel");
+
+  // One call steps the whole batch
+  mk::agents::IAgent4Engine *batch[] = {first.get(), second.get()};
+  auto influences = std::make_shared<mk::influences::InfluencesMap>();
+  kernel->step(level, mk::SimulationTimeStamp(0), mk::SimulationTimeStamp(1),
+               batch, 2, nullptr, influences);
+  ensure(counters->perceptions == 2 && counters->revisions == 2 &&
+             counters->decisions == 2,
+         "Step kernel did not run the models");
+  ensure(first->getLastPerceivedData() &&
+             first->getPerceivedData().count(level) == 1,
+         "Step kernel did not keep the perceived data");
+
+  // The virtual path runs the same models
+  auto perceived =
+      first->perceive(level, mk::SimulationTimeStamp(1),
+                      mk::SimulationTimeStamp(2), first->getPublicLocalStates(),
+                      first->getPrivateLocalState(level), nullptr);
+  first->setPerceivedData(perceived);
+  first->reviseGlobalState(mk::SimulationTimeStamp(1),
+                           mk::SimulationTimeStamp(2),
+                           first->getPerceivedData(), first->getGlobalState());
+  first->decide(level, mk::SimulationTimeStamp(1), mk::SimulationTimeStamp(2),
+                first->getGlobalState(), first->getPublicLocalState(level),
+                first->getPrivateLocalState(level), perceived, influences);
+  ensure(counters->perceptions == 3 && counters->revisions == 3 &&
+             counters->decisions == 3 &&
+             first->getLastPerceivedData() == perceived,
+         "Virtual path mismatch");
+
+  // The borrowed accessors refer to what the agent holds
+  const mk::agents::IAgent4Engine &engineView = *first;
+  ensure(&engineView.borrowPublicLocalStates() ==
+                 &engineView.borrowPublicLocalStates() &&
+             engineView.borrowPublicLocalState(level) ==
+                 first->getPublicLocalState(level) &&
+             engineView.borrowPrivateLocalState(level) ==
+                 first->getPrivateLocalState(level) &&
+             engineView.borrowGlobalState() == first->getGlobalState() &&
+             engineView.borrowLastPerceivedData(level) == perceived &&
+             engineView.borrowLastPerceivedData(other) == nullptr,
+         "Borrowed states mismatch");
+  bool outOfRange = false;
+  try {
+    engineView.borrowPrivateLocalState(other);
+  } catch (const std::out_of_range &) {
+    outOfRange = true;
+  }
+  ensure(outOfRange, "Borrowed a state outside the levels of the agent");
+
+  auto copy = std::dynamic_pointer_cast<Agent>(first->clone());
+  ensure(copy && copy->getStepKernel(level) == kernel &&
+             copy->getPublicLocalState(level) !=
+                 first->getPublicLocalState(level),
+         "Clone of a static agent mismatch");
+  copy->excludeFromLevel(level);
+  ensure(copy->getStepKernel(level) == nullptr,
+         "Excluded agent kept its step kernel");
+
+  // The sequential engine steps the agents through their kernel
+  using ThreadIds = std::vector<std::thread::id>;
+  class Level : public mk::libs::abstractimpl::AbstractLevel {
+  private:
+    std::shared_ptr<ThreadIds> naturalThreads;
+
+  public:
+    Level(const mk::LevelIdentifier &identifier,
+          std::shared_ptr<ThreadIds> naturalThreads)
+        : AbstractLevel(mk::SimulationTimeStamp(0), identifier),
+          naturalThreads(std::move(naturalThreads)) {}
+    mk::SimulationTimeStamp
+    getNextTime(const mk::SimulationTimeStamp &currentTime) override {
+      return mk::SimulationTimeStamp(currentTime, 1);
+    }
+    void makeRegularReaction(
+        const mk::SimulationTimeStamp &, const mk::SimulationTimeStamp &,
+        std::shared_ptr<mk::dynamicstate::ConsistentPublicLocalDynamicState>,
+        const std::set<std::shared_ptr<mk::influences::IInfluence>> &,
+        std::shared_ptr<mk::influences::InfluencesMap>) override {}
+    void makeSystemReaction(
+        const mk::SimulationTimeStamp &, const mk::SimulationTimeStamp &,
+        std::shared_ptr<mk::dynamicstate::ConsistentPublicLocalDynamicState>,
+        const std::vector<std::shared_ptr<mk::influences::IInfluence>> &,
+        bool, std::shared_ptr<mk::influences::InfluencesMap>) override {}
+    void prepareNaturalDynamics(const mk::SimulationTimeStamp &,
+                                const mk::SimulationTimeStamp &) override {
+      naturalThreads->push_back(std::this_thread::get_id());
+    }
+    std::shared_ptr<mk::levels::ILevel> clone() const override {
+      return std::make_shared<Level>(*this);
+    }
+  };
+  const auto naturalThreads = std::make_shared<ThreadIds>();
+  class Model : public sm::ISimulationModel {
+  private:
+    std::vector<std::shared_ptr<mk::agents::IAgent4Engine>> agents;
+    mk::LevelIdentifier level;
+    std::shared_ptr<ThreadIds> naturalThreads;
+
+  public:
+    Model(std::vector<std::shared_ptr<mk::agents::IAgent4Engine>> agents,
+          const mk::LevelIdentifier &level,
+          std::shared_ptr<ThreadIds> naturalThreads)
+        : agents(std::move(agents)), level(level),
+          naturalThreads(std::move(naturalThreads)) {}
+    sm::ISimulationParameters *getSimulationParameters() override {
+      return nullptr;
+    }
+    mk::SimulationTimeStamp getInitialTime() const override {
+      return mk::SimulationTimeStamp(0);
+    }
+    bool isFinalTimeOrAfter(const mk::SimulationTimeStamp &currentTime,
+                            const mk::ISimulationEngine &) const override {
+      return currentTime.getIdentifier() >= 5;
+    }
+    std::vector<std::shared_ptr<mk::levels::ILevel>>
+    generateLevels(const mk::SimulationTimeStamp &) override {
+      return {std::make_shared<Level>(level, naturalThreads)};
+    }
+    EnvironmentInitializationData generateEnvironment(
+        const mk::SimulationTimeStamp &,
+        const std::map<mk::LevelIdentifier,
+                       std::shared_ptr<mk::levels::ILevel>> &) override {
+      return EnvironmentInitializationData(nullptr);
+    }
+    AgentInitializationData generateAgents(
+        const mk::SimulationTimeStamp &,
+        const std::map<mk::LevelIdentifier,
+                       std::shared_ptr<mk::levels::ILevel>> &) override {
+      AgentInitializationData data;
+      data.getAgents().insert(agents.begin(), agents.end());
+      return data;
+    }
+  };
+
+  auto runWith = [&](mk::ISimulationEngine &engine) {
+    counters->perceptions = 0;
+    counters->revisions = 0;
+    counters->decisions = 0;
+    engine.runNewSimulation(std::make_shared<Model>(
+        std::vector<std::shared_ptr<mk::agents::IAgent4Engine>>{
+            makeAgent(), makeAgent(), makeAgent()},
+        level, naturalThreads));
+    return counters->perceptions == 15 && counters->revisions == 15 &&
+           counters->decisions == 15;
+  };
+  mk::engine::SequentialSimulationEngine sequential;
+  ensure(runWith(sequential),
+         "Sequential engine did not step the static agents");
+  mk::engine::MultiThreadedSimulationEngine multiThreaded(2);
+  ensure(runWith(multiThreaded),
+         "Multithreaded engine did not step the static agents");
+
+  // The natural dynamics prepared alongside the decisions leave them as is
+  mk::engine::MultiThreadedSimulationEngine overlapped(2);
+  overlapped.setNaturalOverlap(true);
+  naturalThreads->clear();
+  ensure(overlapped.isNaturalOverlap() && runWith(overlapped),
+         "Overlapped engine did not step the static agents");
+  // on a single helper thread, kept across the steps and the runs
+  ensure(runWith(overlapped) && naturalThreads->size() == 10 &&
+             std::all_of(naturalThreads->begin(), naturalThreads->end(),
+                         [&](std::thread::id id) {
+                           return id == naturalThreads->front() &&
+                                  id != std::this_thread::get_id();
+                         }),
+         "Overlapped engine did not keep its natural dynamics thread");
+
+  // The tracer records the phases of the steps while it is enabled
+  auto &tracer = mk::libs::ExecutionTracer::global();
+  tracer.clear();
+  tracer.setEnabled(true);
+  ensure(runWith(multiThreaded), "Traced engine did not step the agents");
+  tracer.setEnabled(false);
+  runWith(multiThreaded);
+  const auto events = tracer.getEvents();
+  const auto countOf = [&](const std::string &name) {
+    return std::count_if(events.begin(), events.end(), [&](const auto &e) {
+      return name == e.name;
+    });
+  };
+  std::ostringstream trace;
+  tracer.writeChromeTrace(trace);
+  ensure(countOf("step") == 5 && countOf("decide chunk") >= 5 &&
+             countOf("probe dispatch") == 5 &&
+             std::is_sorted(events.begin(), events.end(),
+                            [](const auto &a, const auto &b) {
+                              return a.start < b.start;
+                            }) &&
+             trace.str().find("\"name\":\"decide chunk\"") !=
+                 std::string::npos,
+         "Execution trace mismatch");
+  tracer.clear();
+
+  // The hardware counters count the timed steps where the machine has them
+  mk::engine::MultiThreadedSimulationEngine counted(2);
+  const bool countable = counted.setPerformanceCounting(true);
+  auto recorder = std::make_shared<mk::libs::StepTimingRecorder>();
+  counted.setStepTimingListener(recorder);
+  ensure(runWith(counted) && recorder->getTimings().size() == 5 &&
+             countable == mk::libs::PerformanceCounters().isAvailable() &&
+             countable == counted.isPerformanceCounting(),
+         "Counted engine did not step the static agents");
+  for (const auto &timings : recorder->getTimings()) {
+    ensure(timings.counted == countable &&
+               (countable ? timings.counters.total.instructions > 0
+                          : timings.counters.total.cycles == 0),
+           "Step counters mismatch");
+  }
+
+  // The metrics count the steps, then forward their timings
+  auto forwarded = std::make_shared<mk::libs::StepTimingRecorder>();
+  auto metrics = std::make_shared<mk::libs::SimulationMetrics>(forwarded);
+  metrics->addQueue("snapshots", []() { return std::size_t(2); });
+  mk::engine::MultiThreadedSimulationEngine monitored(2);
+  monitored.setStepTimingListener(metrics);
+  ensure(runWith(monitored) && metrics->getSteps() == 5 &&
+             forwarded->getRecordedSteps() == 5 &&
+             metrics->getBucketCounts("decision").back() == 5,
+         "Monitored engine did not count the steps");
+  const std::string page = metrics->toText();
+  const std::string prometheusPage = metrics->toText(false);
+  const auto has = [](const std::string &text, const std::string &line) {
+    return text.find(line) != std::string::npos;
+  };
+  ensure(has(page, "# TYPE similar_steps counter\nsimilar_steps_total 5\n") &&
+             has(page, "similar_step_phase_seconds_bucket{phase=\"total\","
+                       "le=\"+Inf\"} 5\n") &&
+             has(page, "similar_agents 3\n") &&
+             has(page, "similar_queue_depth{queue=\"snapshots\"} 2\n") &&
+             page.size() > 6 && page.compare(page.size() - 6, 6, "# EOF\n") == 0,
+         "OpenMetrics page mismatch");
+  ensure(has(prometheusPage, "# TYPE similar_steps_total counter\n") &&
+             !has(prometheusPage, "# EOF"),
+         "Prometheus page mismatch");
+  metrics->reset();
+  ensure(metrics->getSteps() == 0 &&
+             metrics->getBucketCounts("total").back() == 0,
+         "Metrics were not reset");
+
+  // An agent ordering sorts the agents between the steps
+  class Ordering : public mk::engine::IAgentOrdering {
+  public:
+    mutable std::atomic<int> keys{0};
+    std::uint64_t keyOf(const mk::agents::IAgent4Engine &agent) const override {
+      ++keys;
+      return reinterpret_cast<std::uintptr_t>(&agent);
+    }
+  };
+  auto ordering = std::make_shared<Ordering>();
+  mk::engine::MultiThreadedSimulationEngine ordered(2);
+  ordered.setAgentOrdering(ordering, 2);
+  ensure(runWith(ordered) && ordering->keys == 9,
+         "Multithreaded engine did not reorder the agents");
+  bool zeroPeriod = false;
+  try {
+    ordered.setAgentOrdering(ordering, 0);
+  } catch (const std::invalid_argument &) {
+    zeroPeriod = true;
+  }
+  ensure(zeroPeriod, "Agent ordering accepted a zero period");
+  // A columnar probe exports the agents and a series of every step
+  class Capture : public ek_probes::IColumnarWriter {
+  public:
+    std::vector<ek_probes::ColumnarBatch> batches;
+    bool closed = false;
+    void write(const ek_probes::ColumnarBatch &batch) override {
+      batches.push_back(batch);
+    }
+    void close() override { closed = true; }
+  };
+  auto agentTable = std::make_shared<Capture>();
+  auto seriesTable = std::make_shared<Capture>();
+  const std::string csvPath = "/tmp/similar_columnar_agents.csv";
+  auto exported = std::make_shared<ek_probes::ColumnarExportProbe>(
+      agentTable, seriesTable, 4);
+  exported->addAgentIntColumn(
+      "levels", [](const mk::agents::IAgent4Engine &agent) {
+        return static_cast<std::int64_t>(agent.getLevels().size());
+      });
+  exported->addSeriesColumn(
+      "agents", [](const mk::SimulationTimeStamp &,
+                   const mk::ISimulationEngine &engine) {
+        return static_cast<double>(engine.getAgents().size());
+      });
+  auto csvProbe = std::make_shared<ek_probes::ColumnarExportProbe>(
+      std::make_shared<ek_probes::CsvColumnarWriter>(csvPath), nullptr);
+  mk::engine::SequentialSimulationEngine exporting;
+  exporting.addProbe("columns", exported);
+  exporting.addProbe("csv", csvProbe);
+  ensure(runWith(exporting), "Exporting engine did not step the agents");
+  std::size_t agentRows = 0;
+  for (const auto &batch : agentTable->batches) {
+    agentRows += batch.rows;
+    ensure(batch.columns.size() == 3 && batch.columns[0].name == "time" &&
+               batch.columns[1].name == "category" &&
+               batch.columns[2].int64s == std::vector<std::int64_t>(
+                                              batch.rows, 1),
+           "Agent batch columns mismatch");
+  }
+  const auto &categories = agentTable->batches.front().columns[1];
+  ensure(agentTable->closed && seriesTable->closed && agentRows == 21 &&
+             categories.dictionaryDelta ==
+                 std::vector<std::string>{"static_agent"} &&
+             agentTable->batches.back().columns[1].dictionaryDelta.empty() &&
+             agentTable->batches.back().columns[1].dictionaryOffset == 1,
+         "Agent table mismatch");
+  ensure(seriesTable->batches.size() == 2 &&
+             seriesTable->batches[0].rows == 4 &&
+             seriesTable->batches[1].rows == 3 &&
+             seriesTable->batches[1].columns[1].float64s[1] == 3.0,
+         "Series table mismatch");
+  std::ifstream csv(csvPath);
+  std::string header;
+  std::string row;
+  std::getline(csv, header);
+  std::getline(csv, row);
+  ensure(header == "time,category" && row == "0,static_agent",
+         "CSV table mismatch");
+  std::remove(csvPath.c_str());
+
+  // A statistics probe gives the same statistics on one thread and on the
+  // workers, the agents split in chunks of one
+  auto statisticsWith = [&](mk::ISimulationEngine &engine) {
+    auto statistics = std::make_shared<ek_probes::StatisticsProbe>(1);
+    const auto levels = [](const mk::agents::IAgent4Engine &agent) {
+      return static_cast<double>(agent.getLevels().size());
+    };
+    statistics->addMoments("levels", levels);
+    statistics->addHistogram("levelBins", levels, 0.0, 4.0, 4);
+    statistics->addQuantiles("levelQuantiles", levels);
+    statistics->addCategoryCounts("categories");
+    statistics->addDensityGrid(
+        "positions",
+        [](const mk::agents::IAgent4Engine &agent) {
+          return std::make_pair(agent.getLevels().size() * 1.5, 0.5);
+        },
+        0.0, 0.0, 1.0, 2, 1);
+    engine.addProbe("statistics", statistics);
+    ensure(runWith(engine), "Observed engine did not step the agents");
+    return statistics->getResults();
+  };
+  mk::engine::SequentialSimulationEngine observedSequential;
+  mk::engine::MultiThreadedSimulationEngine observedMultiThreaded(2);
+  for (const auto &results : {statisticsWith(observedSequential),
+                              statisticsWith(observedMultiThreaded)}) {
+    const auto &moments = results->getMoments("levels");
+    ensure(results->agents == 3 && moments.count() == 3 &&
+               moments.mean() == 1.0 && moments.variance() == 0.0 &&
+               results->getHistogram("levelBins").counts()[1] == 3 &&
+               std::abs(results->getSketch("levelQuantiles").quantile(0.5) -
+                        1.0) < 0.01 &&
+               results->getCounter("categories").count("static_agent") ==
+                   3 &&
+               results->getGrid("positions").count(1, 0) == 3,
+           "Agent statistics mismatch");
+  }
+  ek_probes::StatisticsProbe named;
+  named.addCategoryCounts("categories");
+  bool duplicate = false;
+  try {
+    named.addMoments("categories", nullptr);
+  } catch (const std::invalid_argument &) {
+    duplicate = true;
+  }
+  ensure(duplicate && named.getResults()->time == -1,
+         "Statistics probe accepted a duplicate name");
+
+  // A schedule lets a probe observe some of the steps only
+  class Observations : public mk::IProbe {
+  public:
+    std::vector<long> times;
+    void prepareObservation() override { times.clear(); }
+    void observeAtPartialConsistentTime(
+        const mk::SimulationTimeStamp &timestamp,
+        const mk::ISimulationEngine &) override {
+      times.push_back(timestamp.getIdentifier());
+    }
+    std::shared_ptr<mk::IProbe> clone() const override {
+      return std::make_shared<Observations>();
+    }
+  };
+  auto periodic = std::make_shared<Observations>();
+  auto triggered = std::make_shared<Observations>();
+  auto limited = std::make_shared<Observations>();
+  auto trigger = std::make_shared<mk::engine::TriggeredObservationSchedule>(
+      [](const mk::SimulationTimeStamp &time) {
+        return time.getIdentifier() == 3;
+      });
+  mk::engine::SequentialSimulationEngine scheduledSequential;
+  scheduledSequential.addProbe("periodic", periodic);
+  scheduledSequential.addProbe("triggered", triggered);
+  scheduledSequential.addProbe("limited", limited);
+  scheduledSequential.setObservationSchedule(
+      "periodic", std::make_shared<mk::engine::PeriodicObservationSchedule>(2));
+  scheduledSequential.setObservationSchedule("triggered", trigger);
+  scheduledSequential.setObservationSchedule(
+      "limited", std::make_shared<mk::engine::RateLimitedObservationSchedule>(
+                     std::chrono::hours(1)));
+  ensure(runWith(scheduledSequential) && periodic->times.size() == 2 &&
+             periodic->times[1] == periodic->times[0] + 2 &&
+             triggered->times == std::vector<long>{3} &&
+             limited->times.size() == 1,
+         "Sequential engine did not follow the observation schedules");
+  mk::engine::MultiThreadedSimulationEngine scheduledMultiThreaded(2);
+  auto everyStep = std::make_shared<Observations>();
+  scheduledMultiThreaded.addProbe("periodic", periodic);
+  scheduledMultiThreaded.addProbe("every", everyStep);
+  scheduledMultiThreaded.setObservationSchedule(
+      "periodic", std::make_shared<mk::engine::PeriodicObservationSchedule>(2));
+  periodic->times.clear();
+  ensure(runWith(scheduledMultiThreaded) && periodic->times.size() == 2 &&
+             everyStep->times.size() == 5 &&
+             scheduledMultiThreaded.getObservationSchedule("every") ==
+                 nullptr,
+         "Multithreaded engine did not follow the observation schedules");
+  scheduledMultiThreaded.setObservationSchedule("periodic", nullptr);
+  periodic->times.clear();
+  everyStep->times.clear();
+  ensure(runWith(scheduledMultiThreaded) && periodic->times.size() == 5,
+         "Removed observation schedule still applies");
+
+  // A sampled probe observes k agents of every n, rounded up
+  auto sampled = std::make_shared<ek_probes::StatisticsProbe>();
+  sampled->addCategoryCounts("categories");
+  sampled->setSampler(std::make_shared<ek_probes::AgentSampler>(1, 2));
+  mk::engine::SequentialSimulationEngine sampling;
+  sampling.addProbe("sampled", sampled);
+  ensure(runWith(sampling) && sampled->getResults()->agents == 2 &&
+             sampled->getResults()->getCounter("categories").count(
+                 "static_agent") == 2,
+         "Sampled statistics mismatch");
+  bool invalidSample = false;
+  try {
+    ek_probes::AgentSampler(3, 2);
+  } catch (const std::invalid_argument &) {
+    invalidSample = true;
+  }
+  ensure(invalidSample, "Agent sampler accepted 3 of 2 agents");
+
+  mk::engine::MultiThreadedSimulationEngine pinned(2);
+  ensure(pinned.setWorkerPinning(true) && pinned.isWorkerPinning() &&
+             runWith(pinned),
+         "Pinned engine did not step the static agents");
+
+  // A fork runs on from the time of its original, on its own
+  mk::engine::MultiThreadedSimulationEngine branching(2);
+  bool unforkable = false;
+  try {
+    branching.fork();
+  } catch (const std::runtime_error &) {
+    unforkable = true;
+  }
+  branching.initializeSimulation(std::make_shared<Model>(
+      std::vector<std::shared_ptr<mk::agents::IAgent4Engine>>{
+          makeAgent(), makeAgent(), makeAgent()},
+      level, naturalThreads));
+  const long forkTime = branching.getCurrentTime().getIdentifier() + 2;
+  branching.runSimulation(mk::SimulationTimeStamp(forkTime));
+  auto branch = branching.fork();
+  branch->runSimulation(mk::SimulationTimeStamp(forkTime + 2));
+  ensure(unforkable && branching.getCurrentTime().getIdentifier() == forkTime &&
+             branch->getCurrentTime().getIdentifier() == forkTime + 2 &&
+             branch->getAgents().size() == 3,
+         "Forked engine did not run on from its original");
+
+  // An ensemble folds the replications in their order, whatever the runs
+  // at the same time, and stops once its estimates converged
+  namespace ens = fr::univ_artois::lgi2a::similar::extendedkernel::libs::
+      ensemble;
+  namespace rnd = fr::univ_artois::lgi2a::similar::extendedkernel::libs::
+      random;
+  const ens::EnsembleRunner::ModelFactory factory = [&](std::size_t,
+                                                         std::uint64_t) {
+    return std::make_shared<Model>(
+        std::vector<std::shared_ptr<mk::agents::IAgent4Engine>>{
+            makeAgent(), makeAgent(), makeAgent()},
+        level, naturalThreads);
+  };
+  const ens::EnsembleRunner::OutcomeFunction draw =
+      [](std::size_t, const mk::engine::MultiThreadedSimulationEngine &run) {
+        return std::vector<double>{
+            rnd::PRNG::randomDouble(),
+            static_cast<double>(run.getAgents().size())};
+      };
+  ens::EnsembleRunner serial({"uniform", "agents"}, 1, 7);
+  ens::EnsembleRunner parallel({"uniform", "agents"}, 4, 7);
+  const auto serialResults = serial.run(factory, 40, draw);
+  const auto parallelResults = parallel.run(factory, 40, draw);
+  const auto &uniform = parallelResults.getEstimate("uniform");
+  ensure(serialResults.replications == 40 && !serialResults.converged &&
+             serialResults.getEstimate("uniform").mean() == uniform.mean() &&
+             uniform.lower() < 0.5 && uniform.upper() > 0.5 &&
+             parallelResults.getEstimate("agents").mean() == 3.0 &&
+             parallelResults.getEstimate("agents").halfWidth == 0.0,
+         "Ensemble estimates mismatch");
+  parallel.setConvergence(5, 0.2);
+  const auto converged = parallel.run(factory, 200, draw);
+  ensure(converged.converged && converged.replications >= 5 &&
+             converged.replications < 200 &&
+             converged.getEstimate("uniform").halfWidth <=
+                 0.2 * converged.getEstimate("uniform").mean(),
+         "Ensemble did not stop once converged");
+  const auto failing = serial.run(
+      [&](std::size_t replication, std::uint64_t seed) {
+        if (replication == 1) {
+          throw std::runtime_error("Failed replication");
+        }
+        return factory(replication, seed);
+      },
+      3, draw);
+  ensure(failing.replications == 3 && failing.failures.size() == 1 &&
+             failing.failures[0].first == 1 &&
+             failing.getEstimate("uniform").moments.count() == 2,
+         "Ensemble did not leave the failed replication out");
+
+  // A category behavior decides for groups of agents, the default
+  // perception going through each agent
+  class Batch : public mk::engine::ICategoryBatchBehavior {
+  public:
+    std::atomic<int> batchedAgents{0};
+    void decide(const mk::LevelIdentifier &batchLevel,
+                const mk::SimulationTimeStamp &timeLowerBound,
+                const mk::SimulationTimeStamp &timeUpperBound,
+                const std::shared_ptr<mk::agents::IAgent4Engine> *agents,
+                std::size_t count,
+                const std::shared_ptr<mk::influences::InfluencesMap>
+                    &producedInfluences) override {
+      batchedAgents += static_cast<int>(count);
+      ICategoryBatchBehavior::decide(batchLevel, timeLowerBound,
+                                     timeUpperBound, agents, count,
+                                     producedInfluences);
+    }
+  };
+  auto behavior = std::make_shared<Batch>();
+  mk::engine::SequentialSimulationEngine batchedSequential;
+  batchedSequential.setCategoryBatchBehavior(
+      mk::AgentCategory("static_agent"), level, behavior);
+  ensure(runWith(batchedSequential) && behavior->batchedAgents == 15,
+         "Sequential engine did not step the category in batches");
+  behavior->batchedAgents = 0;
+  mk::engine::MultiThreadedSimulationEngine batchedMultiThreaded(2);
+  batchedMultiThreaded.setCategoryBatchBehavior(
+      mk::AgentCategory("static_agent"), level, behavior);
+  ensure(runWith(batchedMultiThreaded) && behavior->batchedAgents == 15,
+         "Multithreaded engine did not step the category in batches");
+  bool rejected = false;
+  try {
+    batchedMultiThreaded.setActivationScheduling(true);
+  } catch (const std::logic_error &) {
+    rejected = true;
+  }
+  ensure(rejected, "Activation scheduling accepted category batches");
+
+  std::cout << "StaticExtendedAgent tests PASSED" << std::endl;
+}
+
+void testInfluenceLog() {
+  std::cout << "Testing InfluenceLog..." << std::endl;
+
+  namespace ea = fr::univ_artois::lgi2a::similar::extendedkernel::agents;
+  namespace sm = fr::univ_artois::lgi2a::similar::extendedkernel::
+      simulationmodel;
+  namespace ckpt = mk::checkpoint;
+  namespace rnd = fr::univ_artois::lgi2a::similar::extendedkernel::libs::
+      random;
+  using Perceived = mk::libs::generic::EmptyPerceivedData;
+  const mk::LevelIdentifier level("logged");
+  const std::string category = "deposit";
+
+  // Each agent deposits an amount, which the level sums with a random draw
+  class Deposit : public mk::influences::RegularInfluence {
+  public:
+    double amount;
+    Deposit(const std::string &category, const mk::LevelIdentifier &target,
+            const mk::SimulationTimeStamp &lower,
+            const mk::SimulationTimeStamp &upper, double amount)
+        : RegularInfluence(category, target, lower, upper), amount(amount) {}
+  };
+  auto decisions = std::make_shared<std::atomic<int>>(0);
+  struct Perception {
+    mk::LevelIdentifier level;
+    std::shared_ptr<Perceived>
+    perceive(const mk::SimulationTimeStamp &lower,
+             const mk::SimulationTimeStamp &upper,
+             const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+             const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+             const std::shared_ptr<mk::dynamicstate::IPublicDynamicStateMap>
+                 &) {
+      return std::make_shared<Perceived>(level, lower, upper);
+    }
+  };
+  struct Decision {
+    std::shared_ptr<std::atomic<int>> decisions;
+    mk::LevelIdentifier level;
+    std::string category;
+    void decide(const mk::SimulationTimeStamp &lower,
+                const mk::SimulationTimeStamp &upper,
+                const std::shared_ptr<mk::agents::IGlobalState> &,
+                const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+                const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+                const std::shared_ptr<Perceived> &,
+                const std::shared_ptr<mk::influences::InfluencesMap>
+                    &influences) {
+      ++*decisions;
+      influences->add(std::make_shared<Deposit>(
+          category, level, lower, upper,
+          0.5 * static_cast<double>(lower.getIdentifier() + 1)));
+    }
+  };
+  struct Revision {
+    void reviseGlobalState(const mk::SimulationTimeStamp &,
+                           const mk::SimulationTimeStamp &,
+                           const std::shared_ptr<Perceived> &,
+                           const std::shared_ptr<mk::agents::IGlobalState> &) {
+    }
+  };
+  using Agent = ea::StaticExtendedAgent<Perception, Decision, Revision>;
+
+  class State : public mk::agents::ILocalStateOfAgent {
+  private:
+    mk::LevelIdentifier level;
+
+  public:
+    explicit State(const mk::LevelIdentifier &level) : level(level) {}
+    mk::LevelIdentifier getLevel() const override { return level; }
+    mk::AgentCategory getCategoryOfAgent() const override {
+      return mk::AgentCategory("depositor");
+    }
+    bool isOwnedBy(const mk::agents::IAgent &) const override { return true; }
+    std::shared_ptr<mk::ILocalState> clone() const override {
+      return std::make_shared<State>(*this);
+    }
+  };
+  class Memory : public mk::agents::IGlobalState {
+  public:
+    std::shared_ptr<mk::agents::IGlobalState> clone() const override {
+      return std::make_shared<Memory>(*this);
+    }
+  };
+  auto makeAgent = [&]() -> std::shared_ptr<mk::agents::IAgent4Engine> {
+    auto agent = std::make_shared<Agent>(
+        mk::AgentCategory("depositor"), level, Perception{level},
+        Decision{decisions, level, category}, Revision{});
+    agent->initializeGlobalState(std::make_shared<Memory>());
+    agent->includeNewLevel(level, std::make_shared<State>(level),
+                           std::make_shared<State>(level));
+    return agent;
+  };
+
+  class Level : public mk::libs::abstractimpl::AbstractLevel,
+                public ckpt::ICheckpointable {
+  public:
+    double total = 0.0;
+    explicit Level(const mk::LevelIdentifier &identifier)
+        : AbstractLevel(mk::SimulationTimeStamp(0), identifier) {}
+    mk::SimulationTimeStamp
+    getNextTime(const mk::SimulationTimeStamp &currentTime) override {
+      return mk::SimulationTimeStamp(currentTime, 1);
+    }
+    void makeRegularReaction(
+        const mk::SimulationTimeStamp &, const mk::SimulationTimeStamp &,
+        std::shared_ptr<mk::dynamicstate::ConsistentPublicLocalDynamicState>,
+        const std::set<std::shared_ptr<mk::influences::IInfluence>>
+            &influences,
+        std::shared_ptr<mk::influences::InfluencesMap>) override {
+      for (const auto &influence : influences) {
+        total += static_cast<const Deposit &>(*influence).amount;
+      }
+      total += rnd::PRNG::randomDouble();
+    }
+    void makeSystemReaction(
+        const mk::SimulationTimeStamp &, const mk::SimulationTimeStamp &,
+        std::shared_ptr<mk::dynamicstate::ConsistentPublicLocalDynamicState>,
+        const std::vector<std::shared_ptr<mk::influences::IInfluence>> &,
+        bool, std::shared_ptr<mk::influences::InfluencesMap>) override {}
+    std::shared_ptr<mk::levels::ILevel> clone() const override {
+      return std::make_shared<Level>(*this);
+    }
+    void writeCheckpoint(ckpt::CheckpointWriter &writer) const override {
+      writer.writeDouble(total);
+    }
+    void readCheckpoint(ckpt::CheckpointReader &reader) override {
+      total = reader.readDouble();
+    }
+  };
+  class Model : public sm::ISimulationModel {
+  private:
+    std::function<std::shared_ptr<mk::agents::IAgent4Engine>()> makeAgent;
+    mk::LevelIdentifier level;
+
+  public:
+    Model(std::function<std::shared_ptr<mk::agents::IAgent4Engine>()>
+              makeAgent,
+          const mk::LevelIdentifier &level)
+        : makeAgent(std::move(makeAgent)), level(level) {}
+    sm::ISimulationParameters *getSimulationParameters() override {
+      return nullptr;
+    }
+    mk::SimulationTimeStamp getInitialTime() const override {
+      return mk::SimulationTimeStamp(0);
+    }
+    bool isFinalTimeOrAfter(const mk::SimulationTimeStamp &currentTime,
+                            const mk::ISimulationEngine &) const override {
+      return currentTime.getIdentifier() >= 12;
+    }
+    std::vector<std::shared_ptr<mk::levels::ILevel>>
+    generateLevels(const mk::SimulationTimeStamp &) override {
+      return {std::make_shared<Level>(level)};
+    }
+    EnvironmentInitializationData generateEnvironment(
+        const mk::SimulationTimeStamp &,
+        const std::map<mk::LevelIdentifier,
+                       std::shared_ptr<mk::levels::ILevel>> &) override {
+      return EnvironmentInitializationData(nullptr);
+    }
+    AgentInitializationData generateAgents(
+        const mk::SimulationTimeStamp &,
+        const std::map<mk::LevelIdentifier,
+                       std::shared_ptr<mk::levels::ILevel>> &) override {
+      AgentInitializationData data;
+      for (int i = 0; i < 4; ++i) {
+        data.getAgents().insert(makeAgent());
+      }
+      return data;
+    }
+  };
+
+  ckpt::InfluenceCodecs codecs;
+  codecs.add(
+      category,
+      [](const mk::influences::IInfluence &influence,
+         ckpt::CheckpointWriter &writer) {
+        writer.writeDouble(static_cast<const Deposit &>(influence).amount);
+      },
+      [category](ckpt::CheckpointReader &reader,
+                 const mk::LevelIdentifier &target,
+                 const mk::SimulationTimeStamp &lower,
+                 const mk::SimulationTimeStamp &upper) {
+        return std::make_shared<Deposit>(category, target, lower, upper,
+                                         reader.readDouble());
+      });
+  rnd::PRNGCheckpoint generator;
+  const ckpt::CheckpointSections sections = {{"prng", &generator}};
+  const auto agentFactory = [&](const mk::AgentCategory &) {
+    return makeAgent();
+  };
+  auto totalOf = [&](const mk::engine::MultiThreadedSimulationEngine &run) {
+    return std::static_pointer_cast<Level>(run.getLevels().at(level))->total;
+  };
+
+  const std::string path = "influence_log_test.bin";
+  rnd::PRNG::setSeed(11);
+  mk::engine::MultiThreadedSimulationEngine recorded(2);
+  recorded.setInfluenceLog(
+      std::make_shared<ckpt::InfluenceLogWriter>(path, codecs), sections);
+  recorded.runNewSimulation(std::make_shared<Model>(makeAgent, level));
+  const double recordedTotal = totalOf(recorded);
+  ensure(*decisions == 48 && recordedTotal > 0.5 * 4 * (1 + 12) * 6,
+         "Recorded run mismatch");
+
+  // The replay gives the same state without any decision, even after the
+  // global generator moved on
+  *decisions = 0;
+  rnd::PRNG::setSeed(99);
+  mk::engine::MultiThreadedSimulationEngine replayed(2);
+  replayed.replayInfluenceLog(std::make_shared<Model>(makeAgent, level), path,
+                              codecs, agentFactory, sections);
+  ensure(*decisions == 0 && replayed.getCurrentTime().getIdentifier() == 12 &&
+             totalOf(replayed) == recordedTotal &&
+             replayed.getAgents().size() == 4,
+         "Replayed run mismatch");
+
+  // A replay can stop before the end of the log
+  mk::engine::MultiThreadedSimulationEngine partial(1);
+  partial.replayInfluenceLog(std::make_shared<Model>(makeAgent, level), path,
+                             codecs, agentFactory, sections,
+                             mk::SimulationTimeStamp(5));
+  ensure(partial.getCurrentTime().getIdentifier() == 5 &&
+             totalOf(partial) < recordedTotal,
+         "Partial replay mismatch");
+
+  // The influences of the log need their codecs
+  bool missingCodec = false;
+  try {
+    replayed.replayInfluenceLog(std::make_shared<Model>(makeAgent, level),
+                                path, ckpt::InfluenceCodecs(), agentFactory,
+                                sections);
+  } catch (const ckpt::CheckpointException &) {
+    missingCodec = true;
+  }
+  ensure(missingCodec, "Replay accepted a log without its codecs");
+  std::remove(path.c_str());
+
+  // A checkpoint saved at step 5 restores into a fresh engine, which then
+  // goes on as the saved run, random draws included
+  const std::string checkpointPath = "checkpoint_test.bin";
+  rnd::PRNG::setSeed(11);
+  mk::engine::MultiThreadedSimulationEngine saved(2);
+  saved.initializeSimulation(std::make_shared<Model>(makeAgent, level));
+  saved.runSimulation(mk::SimulationTimeStamp(5));
+  saved.saveCheckpoint(checkpointPath, sections);
+  const double savedTotal = totalOf(saved);
+  saved.runSimulation(mk::SimulationTimeStamp(100));
+  const double savedFinalTotal = totalOf(saved);
+  const double savedDraw = rnd::PRNG::randomDouble();
+
+  rnd::PRNG::setSeed(99);
+  mk::engine::MultiThreadedSimulationEngine restored(2);
+  restored.restoreCheckpoint(std::make_shared<Model>(makeAgent, level),
+                             checkpointPath, agentFactory, sections);
+  ensure(restored.getCurrentTime().getIdentifier() == 5 &&
+             totalOf(restored) == savedTotal &&
+             restored.getAgents().size() == 4,
+         "Restored checkpoint mismatch");
+  restored.runSimulation(mk::SimulationTimeStamp(100));
+  ensure(restored.getCurrentTime().getIdentifier() == 12 &&
+             totalOf(restored) == savedFinalTotal &&
+             savedFinalTotal == recordedTotal &&
+             rnd::PRNG::randomDouble() == savedDraw,
+         "Run after a restore mismatch");
+
+  // A newer format version or a truncated file is refused
+  std::string bytes;
+  {
+    std::ifstream in(checkpointPath, std::ios::binary);
+    bytes.assign(std::istreambuf_iterator<char>(in),
+                 std::istreambuf_iterator<char>());
+  }
+  const std::string corruptPath = "checkpoint_corrupt_test.bin";
+  auto refused = [&](const std::string &content) {
+    {
+      std::ofstream out(corruptPath, std::ios::binary | std::ios::trunc);
+      out.write(content.data(), static_cast<std::streamsize>(content.size()));
+    }
+    mk::engine::MultiThreadedSimulationEngine fresh(1);
+    try {
+      fresh.restoreCheckpoint(std::make_shared<Model>(makeAgent, level),
+                              corruptPath, agentFactory, sections);
+    } catch (const ckpt::CheckpointException &) {
+      return true;
+    }
+    return false;
+  };
+  std::string newer = bytes;
+  newer[8] = 2;
+  ensure(refused(newer), "Restore accepted a newer checkpoint version");
+  ensure(refused(bytes.substr(0, bytes.size() / 2)),
+         "Restore accepted a truncated checkpoint");
+  std::remove(corruptPath.c_str());
+  std::remove(checkpointPath.c_str());
+
+  // A rewind buffer goes back to a recent step through its last snapshot and
+  // the deltas after it, without any decision; the run then goes on as the
+  // recorded one
+  rnd::PRNG::setSeed(11);
+  mk::engine::MultiThreadedSimulationEngine rewinding(2);
+  auto buffer = std::make_shared<mk::engine::RewindBuffer>(4, 3, codecs);
+  rewinding.setRewindBuffer(buffer, sections);
+  rewinding.runNewSimulation(std::make_shared<Model>(makeAgent, level));
+  ensure(totalOf(rewinding) == recordedTotal &&
+             buffer->getEarliestTime().getIdentifier() == 3 &&
+             buffer->getLatestTime().getIdentifier() == 12 &&
+             buffer->getDeltaBytes() > 0,
+         "Rewind buffer recording mismatch");
+  *decisions = 0;
+  ensure(rewinding.rewind(mk::SimulationTimeStamp(5)).getIdentifier() == 5 &&
+             totalOf(rewinding) == totalOf(partial) && *decisions == 0 &&
+             rewinding.getAgents().size() == 4 &&
+             buffer->getLatestTime().getIdentifier() == 5,
+         "Rewound state mismatch");
+  rewinding.runSimulation(mk::SimulationTimeStamp(100));
+  ensure(totalOf(rewinding) == recordedTotal && *decisions == 28,
+         "Run after a rewind mismatch");
+  bool tooOld = false;
+  try {
+    rewinding.rewind(mk::SimulationTimeStamp(1));
+  } catch (const std::out_of_range &) {
+    tooOld = true;
+  }
+  ensure(tooOld, "Rewind went back before the buffer");
+
+  // Without codecs, the buffer goes back to its snapshots only
+  mk::engine::MultiThreadedSimulationEngine snapshots(1);
+  snapshots.setRewindBuffer(std::make_shared<mk::engine::RewindBuffer>(8, 3));
+  snapshots.runNewSimulation(std::make_shared<Model>(makeAgent, level));
+  ensure(snapshots.rewind(mk::SimulationTimeStamp(5)).getIdentifier() == 3 &&
+             snapshots.getCurrentTime().getIdentifier() == 3,
+         "Rewind to a snapshot mismatch");
+
+  std::cout << "InfluenceLog tests PASSED" << std::endl;
+}
+
+void testParameterSweepRunner() {
+  std::cout << "Testing ParameterSweepRunner..." << std::endl;
+
+  namespace ea = fr::univ_artois::lgi2a::similar::extendedkernel::agents;
+  namespace sm = fr::univ_artois::lgi2a::similar::extendedkernel::
+      simulationmodel;
+  using Perceived = mk::libs::generic::EmptyPerceivedData;
+  const mk::LevelIdentifier level("swept");
+  const std::string category = "tick";
+
+  struct Perception {
+    mk::LevelIdentifier level;
+    std::shared_ptr<Perceived>
+    perceive(const mk::SimulationTimeStamp &lower,
+             const mk::SimulationTimeStamp &upper,
+             const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+             const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+             const std::shared_ptr<mk::dynamicstate::IPublicDynamicStateMap>
+                 &) {
+      return std::make_shared<Perceived>(level, lower, upper);
+    }
+  };
+  struct Decision {
+    mk::LevelIdentifier level;
+    std::string category;
+    void decide(const mk::SimulationTimeStamp &lower,
+                const mk::SimulationTimeStamp &upper,
+                const std::shared_ptr<mk::agents::IGlobalState> &,
+                const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+                const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+                const std::shared_ptr<Perceived> &,
+                const std::shared_ptr<mk::influences::InfluencesMap>
+                    &influences) {
+      influences->add(std::make_shared<mk::influences::RegularInfluence>(
+          category, level, lower, upper));
+    }
+  };
+  struct Revision {
+    void reviseGlobalState(const mk::SimulationTimeStamp &,
+                           const mk::SimulationTimeStamp &,
+                           const std::shared_ptr<Perceived> &,
+                           const std::shared_ptr<mk::agents::IGlobalState> &) {
+    }
+  };
+  using Agent = ea::StaticExtendedAgent<Perception, Decision, Revision>;
+
+  class State : public mk::agents::ILocalStateOfAgent {
+  private:
+    mk::LevelIdentifier level;
+
+  public:
+    explicit State(const mk::LevelIdentifier &level) : level(level) {}
+    mk::LevelIdentifier getLevel() const override { return level; }
+    mk::AgentCategory getCategoryOfAgent() const override {
+      return mk::AgentCategory("ticker");
+    }
+    bool isOwnedBy(const mk::agents::IAgent &) const override { return true; }
+    std::shared_ptr<mk::ILocalState> clone() const override {
+      return std::make_shared<State>(*this);
+    }
+  };
+  class Memory : public mk::agents::IGlobalState {
+  public:
+    std::shared_ptr<mk::agents::IGlobalState> clone() const override {
+      return std::make_shared<Memory>(*this);
+    }
+  };
+  // The parameter of a variant is the weight of the influences in the total
+  class Level : public mk::libs::abstractimpl::AbstractLevel {
+  public:
+    double weight = 1.0;
+    double total = 0.0;
+    explicit Level(const mk::LevelIdentifier &identifier)
+        : AbstractLevel(mk::SimulationTimeStamp(0), identifier) {}
+    mk::SimulationTimeStamp
+    getNextTime(const mk::SimulationTimeStamp &currentTime) override {
+      return mk::SimulationTimeStamp(currentTime, 1);
+    }
+    void makeRegularReaction(
+        const mk::SimulationTimeStamp &, const mk::SimulationTimeStamp &,
+        std::shared_ptr<mk::dynamicstate::ConsistentPublicLocalDynamicState>,
+        const std::set<std::shared_ptr<mk::influences::IInfluence>>
+            &influences,
+        std::shared_ptr<mk::influences::InfluencesMap>) override {
+      total += weight * static_cast<double>(influences.size());
+    }
+    void makeSystemReaction(
+        const mk::SimulationTimeStamp &, const mk::SimulationTimeStamp &,
+        std::shared_ptr<mk::dynamicstate::ConsistentPublicLocalDynamicState>,
+        const std::vector<std::shared_ptr<mk::influences::IInfluence>> &,
+        bool, std::shared_ptr<mk::influences::InfluencesMap>) override {}
+    std::shared_ptr<mk::levels::ILevel> clone() const override {
+      return std::make_shared<Level>(*this);
+    }
+  };
+  // Counts its generations, which the sweep runs only once
+  class Model : public sm::ISimulationModel {
+  private:
+    mk::LevelIdentifier level;
+    std::string category;
+
+  public:
+    std::atomic<int> generations{0};
+    Model(const mk::LevelIdentifier &level, const std::string &category)
+        : level(level), category(category) {}
+    sm::ISimulationParameters *getSimulationParameters() override {
+      return nullptr;
+    }
+    mk::SimulationTimeStamp getInitialTime() const override {
+      return mk::SimulationTimeStamp(0);
+    }
+    bool isFinalTimeOrAfter(const mk::SimulationTimeStamp &currentTime,
+                            const mk::ISimulationEngine &) const override {
+      return currentTime.getIdentifier() >= 5;
+    }
+    std::vector<std::shared_ptr<mk::levels::ILevel>>
+    generateLevels(const mk::SimulationTimeStamp &) override {
+      ++generations;
+      return {std::make_shared<Level>(level)};
+    }
+    EnvironmentInitializationData generateEnvironment(
+        const mk::SimulationTimeStamp &,
+        const std::map<mk::LevelIdentifier,
+                       std::shared_ptr<mk::levels::ILevel>> &) override {
+      return EnvironmentInitializationData(nullptr);
+    }
+    AgentInitializationData generateAgents(
+        const mk::SimulationTimeStamp &,
+        const std::map<mk::LevelIdentifier,
+                       std::shared_ptr<mk::levels::ILevel>> &) override {
+      AgentInitializationData data;
+      for (int i = 0; i < 3; ++i) {
+        auto agent = std::make_shared<Agent>(
+            mk::AgentCategory("ticker"), level, Perception{level},
+            Decision{level, category}, Revision{});
+        agent->initializeGlobalState(std::make_shared<Memory>());
+        agent->includeNewLevel(level, std::make_shared<State>(level),
+                               std::make_shared<State>(level));
+        data.getAgents().insert(agent);
+      }
+      return data;
+    }
+  };
+  using Fork = mk::engine::MultiThreadedSimulationEngine;
+  auto levelOf = [&](const Fork &run) {
+    return std::static_pointer_cast<Level>(run.getLevels().at(level));
+  };
+
+  // Each variant weighs the influences of its 5 steps of 3 agents by its
+  // index plus one; the fourth one fails in its setup
+  const std::size_t variants = 8;
+  auto model = std::make_shared<Model>(level, category);
+  std::vector<double> totals(variants, -1.0);
+  std::vector<std::size_t> agentCounts(variants, 0);
+  mk::engine::ParameterSweepRunner runner(3);
+  ensure(runner.getConcurrentRuns() == 3, "Concurrent runs mismatch");
+  const auto errors = runner.run(
+      model, variants,
+      [&](std::size_t variant, Fork &fork) {
+        if (variant == 3) {
+          throw std::runtime_error("variant 3");
+        }
+        ensure(fork.getCurrentTime().getIdentifier() == 0 &&
+                   levelOf(fork)->total == 0.0,
+               "A fork did not start from the initial state");
+        levelOf(fork)->weight = static_cast<double>(variant + 1);
+      },
+      [&](std::size_t variant, Fork &fork) {
+        totals[variant] = levelOf(fork)->total;
+        agentCounts[variant] = fork.getAgents().size();
+      });
+  ensure(model->generations == 1 && errors.size() == variants,
+         "The sweep generated the model more than once");
+  for (std::size_t variant = 0; variant < variants; ++variant) {
+    if (variant == 3) {
+      bool failed = false;
+      try {
+        std::rethrow_exception(errors[variant]);
+      } catch (const std::runtime_error &e) {
+        failed = std::string(e.what()) == "variant 3";
+      }
+      ensure(failed && totals[variant] == -1.0,
+             "The failed variant was not reported");
+    } else {
+      ensure(!errors[variant] &&
+                 totals[variant] == 15.0 * static_cast<double>(variant + 1) &&
+                 agentCounts[variant] == 3,
+             "A variant did not run with its parameter");
+    }
+  }
+
+  // The initialized engine is left unchanged by the forks run from it
+  mk::engine::MultiThreadedSimulationEngine initialized(1);
+  initialized.initializeSimulation(model);
+  mk::engine::ParameterSweepRunner single(1);
+  const auto moreErrors = single.run(
+      initialized, 2,
+      [&](std::size_t, Fork &fork) {
+        levelOf(fork)->weight = 2.0;
+      });
+  ensure(moreErrors.size() == 2 && !moreErrors[0] && !moreErrors[1] &&
+             initialized.getCurrentTime().getIdentifier() == 0 &&
+             levelOf(initialized)->total == 0.0 &&
+             levelOf(initialized)->weight == 1.0,
+         "The forks changed the initialized engine");
+  initialized.startSimulation();
+  ensure(levelOf(initialized)->total == 15.0,
+         "The initialized engine did not run after its forks");
+
+  std::cout << "ParameterSweepRunner tests PASSED" << std::endl;
+}
+
+void testStepTimings() {
+  std::cout << "Testing the step timings..." << std::endl;
+
+  namespace ea = fr::univ_artois::lgi2a::similar::extendedkernel::agents;
+  namespace sm = fr::univ_artois::lgi2a::similar::extendedkernel::
+      simulationmodel;
+  using Perceived = mk::libs::generic::EmptyPerceivedData;
+  using std::chrono::milliseconds;
+  const mk::LevelIdentifier level("timed");
+  const std::string category = "tick";
+
+  // Each agent decides for 1 ms and emits one influence; the level reacts
+  // for 2 ms and the probe observes for 1 ms
+  struct Perception {
+    mk::LevelIdentifier level;
+    std::shared_ptr<Perceived>
+    perceive(const mk::SimulationTimeStamp &lower,
+             const mk::SimulationTimeStamp &upper,
+             const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+             const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+             const std::shared_ptr<mk::dynamicstate::IPublicDynamicStateMap>
+                 &) {
+      return std::make_shared<Perceived>(level, lower, upper);
+    }
+  };
+  struct Decision {
+    mk::LevelIdentifier level;
+    std::string category;
+    void decide(const mk::SimulationTimeStamp &lower,
+                const mk::SimulationTimeStamp &upper,
+                const std::shared_ptr<mk::agents::IGlobalState> &,
+                const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+                const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+                const std::shared_ptr<Perceived> &,
+                const std::shared_ptr<mk::influences::InfluencesMap>
+                    &influences) {
+      std::this_thread::sleep_for(milliseconds(1));
+      influences->add(std::make_shared<mk::influences::RegularInfluence>(
+          category, level, lower, upper));
+    }
+  };
+  struct Revision {
+    void reviseGlobalState(const mk::SimulationTimeStamp &,
+                           const mk::SimulationTimeStamp &,
+                           const std::shared_ptr<Perceived> &,
+                           const std::shared_ptr<mk::agents::IGlobalState> &) {
+    }
+  };
+  using Agent = ea::StaticExtendedAgent<Perception, Decision, Revision>;
+
+  class State : public mk::agents::ILocalStateOfAgent {
+  private:
+    mk::LevelIdentifier level;
+
+  public:
+    explicit State(const mk::LevelIdentifier &level) : level(level) {}
+    mk::LevelIdentifier getLevel() const override { return level; }
+    mk::AgentCategory getCategoryOfAgent() const override {
+      return mk::AgentCategory("ticker");
+    }
+    bool isOwnedBy(const mk::agents::IAgent &) const override { return true; }
+    std::shared_ptr<mk::ILocalState> clone() const override {
+      return std::make_shared<State>(*this);
+    }
+  };
+  class Memory : public mk::agents::IGlobalState {
+  public:
+    std::shared_ptr<mk::agents::IGlobalState> clone() const override {
+      return std::make_shared<Memory>(*this);
+    }
+  };
+  class Level : public mk::libs::abstractimpl::AbstractLevel {
+  public:
+    explicit Level(const mk::LevelIdentifier &identifier)
+        : AbstractLevel(mk::SimulationTimeStamp(0), identifier) {}
+    mk::SimulationTimeStamp
+    getNextTime(const mk::SimulationTimeStamp &currentTime) override {
+      return mk::SimulationTimeStamp(currentTime, 1);
+    }
+    void makeRegularReaction(
+        const mk::SimulationTimeStamp &, const mk::SimulationTimeStamp &,
+        std::shared_ptr<mk::dynamicstate::ConsistentPublicLocalDynamicState>,
+        const std::set<std::shared_ptr<mk::influences::IInfluence>> &,
+        std::shared_ptr<mk::influences::InfluencesMap>) override {
+      std::this_thread::sleep_for(milliseconds(2));
+    }
+    void makeSystemReaction(
+        const mk::SimulationTimeStamp &, const mk::SimulationTimeStamp &,
+        std::shared_ptr<mk::dynamicstate::ConsistentPublicLocalDynamicState>,
+        const std::vector<std::shared_ptr<mk::influences::IInfluence>> &,
+        bool, std::shared_ptr<mk::influences::InfluencesMap>) override {}
+    std::shared_ptr<mk::levels::ILevel> clone() const override {
+      return std::make_shared<Level>(*this);
+    }
+  };
+  class Model : public sm::ISimulationModel {
+  private:
+    mk::LevelIdentifier level;
+    std::string category;
+
+  public:
+    Model(const mk::LevelIdentifier &level, const std::string &category)
+        : level(level), category(category) {}
+    sm::ISimulationParameters *getSimulationParameters() override {
+      return nullptr;
+    }
+    mk::SimulationTimeStamp getInitialTime() const override {
+      return mk::SimulationTimeStamp(0);
+    }
+    bool isFinalTimeOrAfter(const mk::SimulationTimeStamp &currentTime,
+                            const mk::ISimulationEngine &) const override {
+      return currentTime.getIdentifier() >= 6;
+    }
+    std::vector<std::shared_ptr<mk::levels::ILevel>>
+    generateLevels(const mk::SimulationTimeStamp &) override {
+      return {std::make_shared<Level>(level)};
+    }
+    EnvironmentInitializationData generateEnvironment(
+        const mk::SimulationTimeStamp &,
+        const std::map<mk::LevelIdentifier,
+                       std::shared_ptr<mk::levels::ILevel>> &) override {
+      return EnvironmentInitializationData(nullptr);
+    }
+    AgentInitializationData generateAgents(
+        const mk::SimulationTimeStamp &,
+        const std::map<mk::LevelIdentifier,
+                       std::shared_ptr<mk::levels::ILevel>> &) override {
+      AgentInitializationData data;
+      for (int i = 0; i < 4; ++i) {
+        auto agent = std::make_shared<Agent>(
+            mk::AgentCategory("ticker"), level, Perception{level},
+            Decision{level, category}, Revision{});
+        agent->initializeGlobalState(std::make_shared<Memory>());
+        agent->includeNewLevel(level, std::make_shared<State>(level),
+                               std::make_shared<State>(level));
+        data.getAgents().insert(agent);
+      }
+      return data;
+    }
+  };
+  class SlowProbe : public mk::IProbe {
+  public:
+    int observations = 0;
+    void
+    observeAtPartialConsistentTime(const mk::SimulationTimeStamp &,
+                                   const mk::ISimulationEngine &) override {
+      std::this_thread::sleep_for(milliseconds(1));
+      ++observations;
+    }
+    std::shared_ptr<mk::IProbe> clone() const override {
+      return std::make_shared<SlowProbe>();
+    }
+  };
+  // The listener is called once the probes observed the step
+  class Listener : public mk::libs::StepTimingRecorder {
+  public:
+    std::shared_ptr<SlowProbe> probe;
+    bool observedFirst = true;
+    Listener(std::size_t capacity, std::shared_ptr<SlowProbe> probe)
+        : StepTimingRecorder(capacity), probe(std::move(probe)) {}
+    void stepTimed(const mk::StepTimings &timings) override {
+      observedFirst = observedFirst &&
+                      probe->observations ==
+                          static_cast<int>(getRecordedSteps()) + 1;
+      StepTimingRecorder::stepTimed(timings);
+    }
+  };
+
+  auto check = [&](mk::ISimulationEngine &engine, std::size_t threads) {
+    auto probe = std::make_shared<SlowProbe>();
+    auto listener = std::make_shared<Listener>(4, probe);
+    engine.addProbe("slow", probe);
+    ensure(engine.getStepTimingListener() == nullptr,
+           "Engine timed its steps by default");
+    engine.setStepTimingListener(listener);
+    ensure(engine.getStepTimingListener() == listener,
+           "Step timing listener mismatch");
+    engine.runNewSimulation(std::make_shared<Model>(level, category));
+
+    // The recorder keeps the last 4 of the 6 steps, oldest first
+    const auto timings = listener->getTimings();
+    ensure(listener->getRecordedSteps() == 6 && timings.size() == 4 &&
+               listener->observedFirst,
+           "Recorded steps mismatch");
+    for (std::size_t i = 0; i < timings.size(); ++i) {
+      const mk::StepTimings &step = timings[i];
+      ensure(step.timeLowerBound.getIdentifier() ==
+                     static_cast<long long>(i) + 2 &&
+                 step.timeUpperBound.getIdentifier() ==
+                     static_cast<long long>(i) + 3,
+             "Step timing bounds mismatch");
+      ensure(step.agentCount == 4 && step.influenceCount == 4 &&
+                 step.threadCount == threads,
+             "Step timing counts mismatch");
+      ensure(step.decision >= milliseconds(4) &&
+                 step.agentPhase >= milliseconds(4 / threads) &&
+                 step.reaction >= milliseconds(2) &&
+                 step.probes >= milliseconds(1) &&
+                 step.merge.count() >= 0 &&
+                 step.structuralUpdate.count() >= 0,
+             "Step phase durations mismatch");
+      ensure(step.agentPhase + step.merge + step.reaction +
+                     step.structuralUpdate + step.probes <=
+                 step.total,
+             "Step phases exceed the step");
+      ensure(step.threadUtilization() > 0.0 &&
+                 step.threadUtilization() <= 1.0 + 1e-9,
+             "Thread utilization out of range");
+    }
+    ensure(listener->getLatest().timeUpperBound.getIdentifier() == 6,
+           "Latest step timings mismatch");
+
+    // Without a listener, the steps are no longer timed
+    engine.setStepTimingListener(nullptr);
+    listener->clear();
+    engine.runNewSimulation(std::make_shared<Model>(level, category));
+    ensure(listener->getRecordedSteps() == 0 &&
+               listener->getTimings().empty(),
+           "Engine timed its steps without a listener");
+  };
+  mk::engine::SequentialSimulationEngine sequential;
+  check(sequential, 1);
+  mk::engine::MultiThreadedSimulationEngine multiThreaded(2);
+  check(multiThreaded, 2);
+
+  bool threw = false;
+  try {
+    mk::libs::StepTimingRecorder().getLatest();
+  } catch (const std::out_of_range &) {
+    threw = true;
+  }
+  ensure(threw, "Empty recorder had a latest step");
+  threw = false;
+  try {
+    mk::libs::StepTimingRecorder recorder(0);
+  } catch (const std::invalid_argument &) {
+    threw = true;
+  }
+  ensure(threw, "Recorder accepted no capacity");
+
+  std::cout << "Step timings tests PASSED" << std::endl;
+}
+
+void testParallelReaction() {
+  std::cout << "Testing the parallel reaction..." << std::endl;
+
+  namespace ea = fr::univ_artois::lgi2a::similar::extendedkernel::agents;
+  namespace sm = fr::univ_artois::lgi2a::similar::extendedkernel::
+      simulationmodel;
+  using Perceived = mk::libs::generic::EmptyPerceivedData;
+  // The left and right levels only influence themselves; the hub also
+  // influences both of them
+  const mk::LevelIdentifier left("left");
+  const mk::LevelIdentifier right("right");
+  const mk::LevelIdentifier hub("hub");
+  const std::string category = "deposit";
+
+  class Deposit : public mk::influences::RegularInfluence {
+  public:
+    double amount;
+    Deposit(const std::string &category, const mk::LevelIdentifier &target,
+            const mk::SimulationTimeStamp &lower,
+            const mk::SimulationTimeStamp &upper, double amount)
+        : RegularInfluence(category, target, lower, upper), amount(amount) {}
+  };
+  struct Reactions {
+    std::atomic<int> running{0};
+    std::atomic<int> mostConcurrent{0};
+    /** Reactions of the hub while another level reacted */
+    std::atomic<int> overlappedHub{0};
+  };
+  class Level : public mk::libs::abstractimpl::AbstractLevel {
+  public:
+    double total = 0.0;
+    Reactions *reactions;
+    Level(const mk::LevelIdentifier &identifier, Reactions *reactions)
+        : AbstractLevel(mk::SimulationTimeStamp(0), identifier),
+          reactions(reactions) {}
+    mk::SimulationTimeStamp
+    getNextTime(const mk::SimulationTimeStamp &currentTime) override {
+      return mk::SimulationTimeStamp(currentTime, 1);
+    }
+    void makeRegularReaction(
+        const mk::SimulationTimeStamp &, const mk::SimulationTimeStamp &,
+        std::shared_ptr<mk::dynamicstate::ConsistentPublicLocalDynamicState>,
+        const std::set<std::shared_ptr<mk::influences::IInfluence>>
+            &influences,
+        std::shared_ptr<mk::influences::InfluencesMap>) override {
+      if (getInfluenceableLevels().size() > 1) {
+        if (reactions->running > 0) {
+          ++reactions->overlappedHub;
+        }
+      } else {
+        const int running = ++reactions->running;
+        int most = reactions->mostConcurrent;
+        while (running > most &&
+               !reactions->mostConcurrent.compare_exchange_weak(most,
+                                                                running)) {
+        }
+        // Slow enough for the other independent level to react meanwhile
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        --reactions->running;
+      }
+      for (const auto &influence : influences) {
+        total += static_cast<const Deposit &>(*influence).amount;
+      }
+    }
+    void makeSystemReaction(
+        const mk::SimulationTimeStamp &, const mk::SimulationTimeStamp &,
+        std::shared_ptr<mk::dynamicstate::ConsistentPublicLocalDynamicState>,
+        const std::vector<std::shared_ptr<mk::influences::IInfluence>> &,
+        bool, std::shared_ptr<mk::influences::InfluencesMap>) override {}
+    std::shared_ptr<mk::levels::ILevel> clone() const override {
+      return std::make_shared<Level>(*this);
+    }
+  };
+
+  struct Perception {
+    mk::LevelIdentifier level;
+    std::shared_ptr<Perceived>
+    perceive(const mk::SimulationTimeStamp &lower,
+             const mk::SimulationTimeStamp &upper,
+             const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+             const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+             const std::shared_ptr<mk::dynamicstate::IPublicDynamicStateMap>
+                 &) {
+      return std::make_shared<Perceived>(level, lower, upper);
+    }
+  };
+  // Each agent deposits 1 in its level; the agents of the hub deposit 5 in
+  // it and 10 in each of the other levels
+  struct Decision {
+    std::vector<mk::LevelIdentifier> targets;
+    std::string category;
+    void decide(const mk::SimulationTimeStamp &lower,
+                const mk::SimulationTimeStamp &upper,
+                const std::shared_ptr<mk::agents::IGlobalState> &,
+                const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+                const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+                const std::shared_ptr<Perceived> &,
+                const std::shared_ptr<mk::influences::InfluencesMap>
+                    &influences) {
+      for (std::size_t i = 0; i < targets.size(); ++i) {
+        const double amount =
+            targets.size() == 1 ? 1.0 : (i == 0 ? 5.0 : 10.0);
+        influences->add(std::make_shared<Deposit>(category, targets[i], lower,
+                                                  upper, amount));
+      }
+    }
+  };
+  struct Revision {
+    void reviseGlobalState(const mk::SimulationTimeStamp &,
+                           const mk::SimulationTimeStamp &,
+                           const std::shared_ptr<Perceived> &,
+                           const std::shared_ptr<mk::agents::IGlobalState> &) {
+    }
+  };
+  using Agent = ea::StaticExtendedAgent<Perception, Decision, Revision>;
+
+  class State : public mk::agents::ILocalStateOfAgent {
+  private:
+    mk::LevelIdentifier level;
+
+  public:
+    explicit State(const mk::LevelIdentifier &level) : level(level) {}
+    mk::LevelIdentifier getLevel() const override { return level; }
+    mk::AgentCategory getCategoryOfAgent() const override {
+      return mk::AgentCategory("depositor");
+    }
+    bool isOwnedBy(const mk::agents::IAgent &) const override { return true; }
+    std::shared_ptr<mk::ILocalState> clone() const override {
+      return std::make_shared<State>(*this);
+    }
+  };
+  class Memory : public mk::agents::IGlobalState {
+  public:
+    std::shared_ptr<mk::agents::IGlobalState> clone() const override {
+      return std::make_shared<Memory>(*this);
+    }
+  };
+
+  class Model : public sm::ISimulationModel {
+  private:
+    Reactions *reactions;
+    mk::LevelIdentifier left;
+    mk::LevelIdentifier right;
+    mk::LevelIdentifier hub;
+    std::string category;
+
+    std::shared_ptr<mk::agents::IAgent4Engine>
+    makeAgent(const mk::LevelIdentifier &level,
+              std::vector<mk::LevelIdentifier> targets) const {
+      auto agent = std::make_shared<Agent>(
+          mk::AgentCategory("depositor"), level, Perception{level},
+          Decision{std::move(targets), category}, Revision{});
+      agent->initializeGlobalState(std::make_shared<Memory>());
+      agent->includeNewLevel(level, std::make_shared<State>(level),
+                             std::make_shared<State>(level));
+      return agent;
+    }
+
+  public:
+    Model(Reactions *reactions, const mk::LevelIdentifier &left,
+          const mk::LevelIdentifier &right, const mk::LevelIdentifier &hub,
+          const std::string &category)
+        : reactions(reactions), left(left), right(right), hub(hub),
+          category(category) {}
+    sm::ISimulationParameters *getSimulationParameters() override {
+      return nullptr;
+    }
+    mk::SimulationTimeStamp getInitialTime() const override {
+      return mk::SimulationTimeStamp(0);
+    }
+    bool isFinalTimeOrAfter(const mk::SimulationTimeStamp &currentTime,
+                            const mk::ISimulationEngine &) const override {
+      return currentTime.getIdentifier() >= 12;
+    }
+    std::vector<std::shared_ptr<mk::levels::ILevel>>
+    generateLevels(const mk::SimulationTimeStamp &) override {
+      auto hubLevel = std::make_shared<Level>(hub, reactions);
+      hubLevel->addInfluenceableLevel(left);
+      hubLevel->addInfluenceableLevel(right);
+      return {std::make_shared<Level>(left, reactions),
+              std::make_shared<Level>(right, reactions), hubLevel};
+    }
+    EnvironmentInitializationData generateEnvironment(
+        const mk::SimulationTimeStamp &,
+        const std::map<mk::LevelIdentifier,
+                       std::shared_ptr<mk::levels::ILevel>> &) override {
+      return EnvironmentInitializationData(nullptr);
+    }
+    AgentInitializationData generateAgents(
+        const mk::SimulationTimeStamp &,
+        const std::map<mk::LevelIdentifier,
+                       std::shared_ptr<mk::levels::ILevel>> &) override {
+      AgentInitializationData data;
+      for (int i = 0; i < 2; ++i) {
+        data.getAgents().insert(makeAgent(left, {left}));
+        data.getAgents().insert(makeAgent(right, {right}));
+      }
+      data.getAgents().insert(makeAgent(hub, {hub, left, right}));
+      return data;
+    }
+  };
+
+  auto runWith = [&](Reactions &reactions, bool parallel) {
+    mk::engine::MultiThreadedSimulationEngine engine(2);
+    engine.setParallelReaction(parallel);
+    ensure(engine.isParallelReaction() == parallel,
+           "Parallel reaction flag mismatch");
+    engine.runNewSimulation(
+        std::make_shared<Model>(&reactions, left, right, hub, category));
+    std::map<mk::LevelIdentifier, double> totals;
+    for (const auto &level : engine.getLevels()) {
+      totals[level.first] =
+          std::static_pointer_cast<Level>(level.second)->total;
+    }
+    return totals;
+  };
+
+  // The influences of the hub reach the independent levels, 12 steps of
+  // 2 deposits of 1 and one of 10
+  Reactions sequentialReactions;
+  const auto sequential = runWith(sequentialReactions, false);
+  ensure(sequential.at(left) == 144.0 && sequential.at(right) == 144.0 &&
+             sequential.at(hub) == 60.0,
+         "Cross-level influences were not delivered");
+  ensure(sequentialReactions.mostConcurrent == 1,
+         "Sequential reactions ran concurrently");
+
+  // The independent levels react together, the hub after them
+  Reactions parallelReactions;
+  const auto parallel = runWith(parallelReactions, true);
+  ensure(parallel == sequential,
+         "Parallel reaction changed the states of the levels");
+  ensure(parallelReactions.mostConcurrent == 2,
+         "The independent levels did not react concurrently");
+  ensure(parallelReactions.overlappedHub == 0 &&
+             sequentialReactions.overlappedHub == 0,
+         "A level influencing others reacted concurrently");
+
+  std::cout << "Parallel reaction tests PASSED" << std::endl;
+}
+
+void testPipelinedPerception() {
+  std::cout << "Testing the pipelined perception..." << std::endl;
+
+  namespace ea = fr::univ_artois::lgi2a::similar::extendedkernel::agents;
+  namespace sm = fr::univ_artois::lgi2a::similar::extendedkernel::
+      simulationmodel;
+  // The lower level reacts first; the upper one perceives and influences it
+  const mk::LevelIdentifier lower("lower");
+  const mk::LevelIdentifier upper("upper");
+  const std::string category = "deposit";
+
+  class Deposit : public mk::influences::RegularInfluence {
+  public:
+    double amount;
+    Deposit(const std::string &category, const mk::LevelIdentifier &target,
+            const mk::SimulationTimeStamp &lower,
+            const mk::SimulationTimeStamp &upper, double amount)
+        : RegularInfluence(category, target, lower, upper), amount(amount) {}
+  };
+  // The deposits are integers, so that their sums do not depend on the order
+  // of the influences
+  class Level : public mk::libs::abstractimpl::AbstractLevel {
+  public:
+    double total = 0.0;
+    std::shared_ptr<std::atomic<bool>> reacting;
+    Level(const mk::LevelIdentifier &identifier,
+          std::shared_ptr<std::atomic<bool>> reacting)
+        : AbstractLevel(mk::SimulationTimeStamp(0), identifier),
+          reacting(std::move(reacting)) {}
+    mk::SimulationTimeStamp
+    getNextTime(const mk::SimulationTimeStamp &currentTime) override {
+      return mk::SimulationTimeStamp(currentTime, 1);
+    }
+    void makeRegularReaction(
+        const mk::SimulationTimeStamp &, const mk::SimulationTimeStamp &,
+        std::shared_ptr<mk::dynamicstate::ConsistentPublicLocalDynamicState>,
+        const std::set<std::shared_ptr<mk::influences::IInfluence>>
+            &influences,
+        std::shared_ptr<mk::influences::InfluencesMap>) override {
+      if (reacting) {
+        // Slow enough for the agents of the lower level to perceive ahead
+        *reacting = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      }
+      for (const auto &influence : influences) {
+        total += static_cast<const Deposit &>(*influence).amount;
+      }
+      if (reacting) {
+        *reacting = false;
+      }
+    }
+    void makeSystemReaction(
+        const mk::SimulationTimeStamp &, const mk::SimulationTimeStamp &,
+        std::shared_ptr<mk::dynamicstate::ConsistentPublicLocalDynamicState>,
+        const std::vector<std::shared_ptr<mk::influences::IInfluence>> &,
+        bool, std::shared_ptr<mk::influences::InfluencesMap>) override {}
+    std::shared_ptr<mk::levels::ILevel> clone() const override {
+      return std::make_shared<Level>(*this);
+    }
+  };
+  using Levels = std::map<mk::LevelIdentifier, std::shared_ptr<Level>>;
+
+  // The sum of the totals of the levels perceptible from the one perceived
+  class Sum : public mk::libs::generic::EmptyPerceivedData {
+  public:
+    double value = 0.0;
+    using EmptyPerceivedData::EmptyPerceivedData;
+  };
+  struct Run {
+    Levels levels;
+    std::shared_ptr<std::atomic<bool>> reacting =
+        std::make_shared<std::atomic<bool>>(false);
+    std::atomic<int> perceivedWhileReacting{0};
+  };
+  struct Perception {
+    Run *run;
+    mk::LevelIdentifier level;
+    std::shared_ptr<Sum>
+    perceive(const mk::SimulationTimeStamp &lowerBound,
+             const mk::SimulationTimeStamp &upperBound,
+             const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+             const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+             const std::shared_ptr<mk::dynamicstate::IPublicDynamicStateMap>
+                 &) {
+      if (*run->reacting) {
+        ++run->perceivedWhileReacting;
+      }
+      auto sum = std::make_shared<Sum>(level, lowerBound, upperBound);
+      for (const auto &perceptible :
+           run->levels.at(level)->getPerceptibleLevels()) {
+        sum->value += run->levels.at(perceptible)->total;
+      }
+      return sum;
+    }
+  };
+  struct Decision {
+    mk::LevelIdentifier level;
+    mk::LevelIdentifier lower;
+    std::string category;
+    void decide(const mk::SimulationTimeStamp &lowerBound,
+                const mk::SimulationTimeStamp &upperBound,
+                const std::shared_ptr<mk::agents::IGlobalState> &,
+                const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+                const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+                const std::shared_ptr<Sum> &perceived,
+                const std::shared_ptr<mk::influences::InfluencesMap>
+                    &influences) {
+      const double amount = std::fmod(perceived->value, 7.0) + 1.0;
+      influences->add(std::make_shared<Deposit>(category, level, lowerBound,
+                                                upperBound, amount));
+      if (level != lower) {
+        influences->add(std::make_shared<Deposit>(
+            category, lower, lowerBound, upperBound, 2.0 * amount));
+      }
+    }
+  };
+  struct Revision {
+    void reviseGlobalState(const mk::SimulationTimeStamp &,
+                           const mk::SimulationTimeStamp &,
+                           const std::shared_ptr<Sum> &,
+                           const std::shared_ptr<mk::agents::IGlobalState> &) {
+    }
+  };
+  using Agent = ea::StaticExtendedAgent<Perception, Decision, Revision>;
+
+  class State : public mk::agents::ILocalStateOfAgent {
+  private:
+    mk::LevelIdentifier level;
+
+  public:
+    explicit State(const mk::LevelIdentifier &level) : level(level) {}
+    mk::LevelIdentifier getLevel() const override { return level; }
+    mk::AgentCategory getCategoryOfAgent() const override {
+      return mk::AgentCategory("depositor");
+    }
+    bool isOwnedBy(const mk::agents::IAgent &) const override { return true; }
+    std::shared_ptr<mk::ILocalState> clone() const override {
+      return std::make_shared<State>(*this);
+    }
+  };
+  class Memory : public mk::agents::IGlobalState {
+  public:
+    std::shared_ptr<mk::agents::IGlobalState> clone() const override {
+      return std::make_shared<Memory>(*this);
+    }
+  };
+
+  class Model : public sm::ISimulationModel {
+  private:
+    Run *run;
+    mk::LevelIdentifier lower;
+    mk::LevelIdentifier upper;
+    std::string category;
+
+  public:
+    Model(Run *run, const mk::LevelIdentifier &lower,
+          const mk::LevelIdentifier &upper, const std::string &category)
+        : run(run), lower(lower), upper(upper), category(category) {}
+    sm::ISimulationParameters *getSimulationParameters() override {
+      return nullptr;
+    }
+    mk::SimulationTimeStamp getInitialTime() const override {
+      return mk::SimulationTimeStamp(0);
+    }
+    bool isFinalTimeOrAfter(const mk::SimulationTimeStamp &currentTime,
+                            const mk::ISimulationEngine &) const override {
+      return currentTime.getIdentifier() >= 12;
+    }
+    std::vector<std::shared_ptr<mk::levels::ILevel>>
+    generateLevels(const mk::SimulationTimeStamp &) override {
+      auto lowerLevel = std::make_shared<Level>(lower, nullptr);
+      auto upperLevel = std::make_shared<Level>(upper, run->reacting);
+      upperLevel->addPerceptibleLevel(lower);
+      upperLevel->addInfluenceableLevel(lower);
+      run->levels = {{lower, lowerLevel}, {upper, upperLevel}};
+      return {lowerLevel, upperLevel};
+    }
+    EnvironmentInitializationData generateEnvironment(
+        const mk::SimulationTimeStamp &,
+        const std::map<mk::LevelIdentifier,
+                       std::shared_ptr<mk::levels::ILevel>> &) override {
+      return EnvironmentInitializationData(nullptr);
+    }
+    AgentInitializationData generateAgents(
+        const mk::SimulationTimeStamp &,
+        const std::map<mk::LevelIdentifier,
+                       std::shared_ptr<mk::levels::ILevel>> &) override {
+      AgentInitializationData data;
+      for (int i = 0; i < 6; ++i) {
+        const mk::LevelIdentifier &level = i % 2 == 0 ? lower : upper;
+        auto agent = std::make_shared<Agent>(
+            mk::AgentCategory("depositor"), level, Perception{run, level},
+            Decision{level, lower, category}, Revision{});
+        agent->initializeGlobalState(std::make_shared<Memory>());
+        agent->includeNewLevel(level, std::make_shared<State>(level),
+                               std::make_shared<State>(level));
+        data.getAgents().insert(agent);
+      }
+      return data;
+    }
+  };
+
+  auto runWith = [&](Run &run, std::size_t threads, bool pipelined) {
+    mk::engine::MultiThreadedSimulationEngine engine(threads);
+    engine.setPipelinedPerception(pipelined);
+    ensure(engine.isPipelinedPerception() == pipelined,
+           "Pipelined perception flag mismatch");
+    engine.runNewSimulation(
+        std::make_shared<Model>(&run, lower, upper, category));
+    ensure(engine.getCurrentTime().getIdentifier() == 12,
+           "Pipelined run did not reach its end");
+  };
+
+  // The agents perceive the same totals whether they perceive ahead or not
+  Run reference;
+  runWith(reference, 2, false);
+  ensure(reference.perceivedWhileReacting == 0 &&
+             reference.levels.at(lower)->total > 0 &&
+             reference.levels.at(upper)->total > 0,
+         "Sequential perception mismatch");
+  // The order in which the workers take the agents is not fixed, so the
+  // perceptions overlapping the reactions are counted over all the runs
+  int perceivedWhileReacting = 0;
+  for (std::size_t threads : {std::size_t(1), std::size_t(2), std::size_t(4)}) {
+    Run pipelined;
+    runWith(pipelined, threads, true);
+    perceivedWhileReacting += pipelined.perceivedWhileReacting;
+    ensure(pipelined.levels.at(lower)->total ==
+                   reference.levels.at(lower)->total &&
+               pipelined.levels.at(upper)->total ==
+                   reference.levels.at(upper)->total,
+           "Pipelined perception changed the states of the levels");
+  }
+  ensure(perceivedWhileReacting > 0,
+         "The agents did not perceive while the levels reacted");
+
+  std::cout << "Pipelined perception tests PASSED" << std::endl;
+}
+
+void testActivationScheduling() {
+  std::cout << "Testing the activation scheduling..." << std::endl;
+
+  namespace ea = fr::univ_artois::lgi2a::similar::extendedkernel::agents;
+  namespace sm = fr::univ_artois::lgi2a::similar::extendedkernel::
+      simulationmodel;
+  using Perceived = mk::libs::generic::EmptyPerceivedData;
+  const mk::LevelIdentifier level("scheduled");
+
+  struct Perception {
+    mk::LevelIdentifier level;
+    std::shared_ptr<Perceived>
+    perceive(const mk::SimulationTimeStamp &lower,
+             const mk::SimulationTimeStamp &upper,
+             const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+             const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+             const std::shared_ptr<mk::dynamicstate::IPublicDynamicStateMap>
+                 &) {
+      return std::make_shared<Perceived>(level, lower, upper);
+    }
+  };
+  // Each agent records the steps it decided in
+  struct Decision {
+    std::shared_ptr<std::vector<long>> steps;
+    void decide(const mk::SimulationTimeStamp &lower,
+                const mk::SimulationTimeStamp &,
+                const std::shared_ptr<mk::agents::IGlobalState> &,
+                const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+                const std::shared_ptr<mk::agents::ILocalStateOfAgent> &,
+                const std::shared_ptr<Perceived> &,
+                const std::shared_ptr<mk::influences::InfluencesMap> &) {
+      steps->push_back(lower.getIdentifier());
+    }
+  };
+  struct Revision {
+    void reviseGlobalState(const mk::SimulationTimeStamp &,
+                           const mk::SimulationTimeStamp &,
+                           const std::shared_ptr<Perceived> &,
+                           const std::shared_ptr<mk::agents::IGlobalState> &) {
+    }
+  };
+  using Agent = ea::StaticExtendedAgent<Perception, Decision, Revision>;
+  // An agent having something to do every period steps
+  class PeriodicAgent : public Agent, public mk::agents::IScheduledAgent {
+  private:
+    long period;
+
+  public:
+    PeriodicAgent(const mk::LevelIdentifier &level, Decision decision,
+                  long period)
+        : Agent(mk::AgentCategory("periodic"), level, Perception{level},
+                std::move(decision), Revision{}),
+          period(period) {}
+    mk::SimulationTimeStamp getNextActivationTime(
+        const mk::SimulationTimeStamp &timeUpperBound) const override {
+      return mk::SimulationTimeStamp(timeUpperBound.getIdentifier() - 1 +
+                                     period);
+    }
+  };
+
+  class State : public mk::agents::ILocalStateOfAgent {
+  private:
+    mk::LevelIdentifier level;
+
+  public:
+    explicit State(const mk::LevelIdentifier &level) : level(level) {}
+    mk::LevelIdentifier getLevel() const override { return level; }
+    mk::AgentCategory getCategoryOfAgent() const override {
+      return mk::AgentCategory("periodic");
+    }
+    bool isOwnedBy(const mk::agents::IAgent &) const override { return true; }
+    std::shared_ptr<mk::ILocalState> clone() const override {
+      return std::make_shared<State>(*this);
+    }
+  };
+  class Memory : public mk::agents::IGlobalState {
+  public:
+    std::shared_ptr<mk::agents::IGlobalState> clone() const override {
+      return std::make_shared<Memory>(*this);
+    }
+  };
+  // The level reacts at every step, and may activate an agent
+  class Level : public mk::libs::abstractimpl::AbstractLevel {
+  public:
+    std::shared_ptr<std::vector<long>> reactions;
+    std::function<void(long)> onReaction;
+    Level(const mk::LevelIdentifier &identifier,
+          std::shared_ptr<std::vector<long>> reactions,
+          std::function<void(long)> onReaction)
+        : AbstractLevel(mk::SimulationTimeStamp(0), identifier),
+          reactions(std::move(reactions)), onReaction(std::move(onReaction)) {
+    }
+    mk::SimulationTimeStamp
+    getNextTime(const mk::SimulationTimeStamp &currentTime) override {
+      return mk::SimulationTimeStamp(currentTime, 1);
+    }
+    void makeRegularReaction(
+        const mk::SimulationTimeStamp &lower, const mk::SimulationTimeStamp &,
+        std::shared_ptr<mk::dynamicstate::ConsistentPublicLocalDynamicState>,
+        const std::set<std::shared_ptr<mk::influences::IInfluence>> &,
+        std::shared_ptr<mk::influences::InfluencesMap>) override {
+      reactions->push_back(lower.getIdentifier());
+      if (onReaction) {
+        onReaction(lower.getIdentifier());
+      }
+    }
+    void makeSystemReaction(
+        const mk::SimulationTimeStamp &, const mk::SimulationTimeStamp &,
+        std::shared_ptr<mk::dynamicstate::ConsistentPublicLocalDynamicState>,
+        const std::vector<std::shared_ptr<mk::influences::IInfluence>> &,
+        bool, std::shared_ptr<mk::influences::InfluencesMap>) override {}
+    std::shared_ptr<mk::levels::ILevel> clone() const override {
+      return std::make_shared<Level>(*this);
+    }
+  };
+  // One agent of each period; a period of 0 makes a plain agent, activated
+  // at every step
+  struct Run {
+    std::map<long, std::shared_ptr<std::vector<long>>> steps;
+    std::map<long, std::shared_ptr<Agent>> agents;
+    std::shared_ptr<std::vector<long>> reactions =
+        std::make_shared<std::vector<long>>();
+    std::function<void(long)> onReaction;
+  };
+  class Model : public sm::ISimulationModel {
+  private:
+    mk::LevelIdentifier level;
+    Run &run;
+
+  public:
+    Model(const mk::LevelIdentifier &level, Run &run)
+        : level(level), run(run) {}
+    sm::ISimulationParameters *getSimulationParameters() override {
+      return nullptr;
+    }
+    mk::SimulationTimeStamp getInitialTime() const override {
+      return mk::SimulationTimeStamp(0);
+    }
+    bool isFinalTimeOrAfter(const mk::SimulationTimeStamp &currentTime,
+                            const mk::ISimulationEngine &) const override {
+      return currentTime.getIdentifier() >= 12;
+    }
+    std::vector<std::shared_ptr<mk::levels::ILevel>>
+    generateLevels(const mk::SimulationTimeStamp &) override {
+      return {std::make_shared<Level>(level, run.reactions, run.onReaction)};
+    }
+    EnvironmentInitializationData generateEnvironment(
+        const mk::SimulationTimeStamp &,
+        const std::map<mk::LevelIdentifier,
+                       std::shared_ptr<mk::levels::ILevel>> &) override {
+      return EnvironmentInitializationData(nullptr);
+    }
+    AgentInitializationData generateAgents(
+        const mk::SimulationTimeStamp &,
+        const std::map<mk::LevelIdentifier,
+                       std::shared_ptr<mk::levels::ILevel>> &) override {
+      AgentInitializationData data;
+      for (long period : {0L, 3L, 5L}) {
+        auto steps = std::make_shared<std::vector<long>>();
+        std::shared_ptr<Agent> agent =
+            period == 0 ? std::make_shared<Agent>(
+                              mk::AgentCategory("periodic"), level,
+                              Perception{level}, Decision{steps}, Revision{})
+                        : std::make_shared<PeriodicAgent>(
+                              level, Decision{steps}, period);
+        agent->initializeGlobalState(std::make_shared<Memory>());
+        agent->includeNewLevel(level, std::make_shared<State>(level),
+                               std::make_shared<State>(level));
+        data.getAgents().insert(agent);
+        run.steps[period] = steps;
+        run.agents[period] = agent;
+      }
+      return data;
+    }
+  };
+  auto range = [](long first, long last, long step) {
+    std::vector<long> values;
+    for (long value = first; value < last; value += step) {
+      values.push_back(value);
+    }
+    return values;
+  };
+
+  // Without the scheduling, every agent decides at every step
+  {
+    mk::engine::MultiThreadedSimulationEngine engine(2);
+    Run run;
+    engine.runNewSimulation(std::make_shared<Model>(level, run));
+    for (long period : {0L, 3L, 5L}) {
+      ensure(*run.steps[period] == range(0, 12, 1),
+             "Agent skipped a step without the scheduling");
+    }
+  }
+
+  // With it, the scheduled agents only decide at their activation times,
+  // while the plain agent and the level keep running at every step
+  for (std::size_t threads : {std::size_t(1), std::size_t(4)}) {
+    mk::engine::MultiThreadedSimulationEngine engine(threads);
+    engine.setActivationScheduling(true);
+    ensure(engine.isActivationScheduling(), "Scheduling not enabled");
+    Run run;
+    engine.runNewSimulation(std::make_shared<Model>(level, run));
+    ensure(*run.steps[0] == range(0, 12, 1),
+           "Plain agent was not activated at every step");
+    ensure(*run.steps[3] == range(0, 12, 3) &&
+               *run.steps[5] == range(0, 12, 5),
+           "Scheduled agents decided outside their activation times");
+    ensure(*run.reactions == range(0, 12, 1),
+           "Level did not react at every step");
+
+    // A reaction activates an agent at the next step, which then tells its
+    // next activation time again
+    Run activated;
+    activated.onReaction = [&engine, &activated](long time) {
+      if (time == 6) {
+        engine.activateAgent(activated.agents.at(5));
+      }
+    };
+    engine.runNewSimulation(std::make_shared<Model>(level, activated));
+    ensure(*activated.steps[5] == std::vector<long>({0, 5, 7}),
+           "Activated agent mismatch");
+    ensure(*activated.steps[3] == range(0, 12, 3),
+           "Activation changed the other agents");
+  }
+
+  std::cout << "Activation scheduling tests PASSED" << std::endl;
+}
+
+void testModelPlugin() {
+  std::cout << "Testing ModelPlugin..." << std::endl;
+
+  mk::engine::ModelPlugin plugin(SIMILAR_TEST_MODEL_PLUGIN);
+  ensure(plugin.getPath() == SIMILAR_TEST_MODEL_PLUGIN, "Plugin path mismatch");
+  ensure(plugin.getBatchBehaviorCount() == 1, "Plugin behaviors mismatch");
+  ensure(std::string(plugin.getBatchBehavior(0).category) == "batched" &&
+             std::string(plugin.getBatchBehavior(0).level) == "plugin",
+         "Plugin behavior category mismatch");
+
+  // The model of the arguments runs on the engine, with the behaviors
+  auto engine = std::make_shared<mk::engine::MultiThreadedSimulationEngine>(2);
+  ensure(plugin.installBatchBehaviors(*engine) == 1,
+         "Plugin behaviors not installed");
+  ensure(engine->getCategoryBatchBehavior(mk::AgentCategory("batched")) !=
+             nullptr,
+         "Plugin behavior not set to the engine");
+  auto model = plugin.createModel("3");
+  ensure(!model->isFinalTimeOrAfter(mk::SimulationTimeStamp(2), *engine) &&
+             model->isFinalTimeOrAfter(mk::SimulationTimeStamp(3), *engine),
+         "Plugin model arguments mismatch");
+  engine->runNewSimulation(model);
+  ensure(engine->getCurrentTime().getIdentifier() == 3,
+         "Plugin model run mismatch");
+
+  bool threw = false;
+  try {
+    plugin.createModel("");
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+  ensure(threw, "Plugin made a model of no arguments");
+
+  threw = false;
+  try {
+    mk::engine::ModelPlugin missing("/nonexistent/plugin.so");
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+  ensure(threw, "A missing plugin was loaded");
+
+  std::cout << "ModelPlugin tests PASSED" << std::endl;
+}
+
+void testBatchRunner() {
+  std::cout << "Testing BatchRunner..." << std::endl;
+
+  namespace batch = fr::univ_artois::lgi2a::similar::extendedkernel::libs::batch;
+
+  const std::string finalPath = "/tmp/similar_batch_final.txt";
+  const std::string seriesPath = "/tmp/similar_batch_series.csv";
+  const std::string configPath = "/tmp/similar_batch.json";
+  std::ofstream(configPath) << R"({"plugin": ")" SIMILAR_TEST_MODEL_PLUGIN
+                               R"(", "arguments": "6", "threads": 2,
+      "probes": {"final": ")" << finalPath << R"("},
+      "export": {"format": "csv", "series": ")" << seriesPath
+                            << R"(", "period": 2, "series_batch_rows": 2}})";
+  const auto config = batch::BatchRunConfig::load(configPath);
+  ensure(config.plugin == SIMILAR_TEST_MODEL_PLUGIN &&
+             config.arguments == "6" && config.threads == 2 &&
+             config.engine == batch::BatchRunConfig::Engine::MULTITHREADED &&
+             config.exportPeriod == 2 && config.exportAgents.empty(),
+         "Batch configuration mismatch");
+
+  auto sequential = config;
+  sequential.engine = batch::BatchRunConfig::Engine::SEQUENTIAL;
+  ensure(std::dynamic_pointer_cast<mk::engine::SequentialSimulationEngine>(
+             batch::makeBatchEngine(sequential)) != nullptr,
+         "Batch engine mismatch");
+
+  {
+    const auto result = batch::runBatch(config);
+    ensure(result.initialTime == 0 && result.finalTime == 6 &&
+               result.batchBehaviors == 1,
+           "Batch run mismatch");
+    std::ifstream final(finalPath);
+    long finalTime = -1;
+    final >> finalTime;
+    ensure(finalTime == 6, "Batch plugin probe mismatch");
+    std::ifstream series(seriesPath);
+    std::string line;
+    std::vector<std::string> lines;
+    while (std::getline(series, line)) {
+      lines.push_back(line);
+    }
+    // One step in two, then the final time
+    ensure(lines.size() == 6 && lines[0] == "time,agents" &&
+               lines[1] == "0,0" && lines[2] == "2,0" && lines[4] == "6,0" &&
+               lines.back() == "6,0",
+           "Batch export mismatch");
+  }
+
+  for (const char *json :
+       {R"({"arguments": "6"})", R"({"plugin": "x", "engine": "gpu"})",
+        R"({"plugin": "x", "export": {"format": "xml"}})",
+        R"({"plugin": "x", "export": {"period": 0}})", "{"}) {
+    bool threw = false;
+    try {
+      batch::BatchRunConfig::parse(json);
+    } catch (const std::invalid_argument &) {
+      threw = true;
+    }
+    ensure(threw, "Batch configuration accepted an invalid file");
+  }
+  std::remove(finalPath.c_str());
+  std::remove(seriesPath.c_str());
+  std::remove(configPath.c_str());
+
+  std::cout << "BatchRunner tests PASSED" << std::endl;
+}
+
+void testPngEncoder() {
+  std::cout << "Testing PngEncoder..." << std::endl;
+
+  namespace view = fr::univ_artois::lgi2a::similar::extendedkernel::libs::web::
+      view;
+
+  auto u32 = [](const std::string &file, std::size_t at) {
+    std::uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+      value = value << 8 | static_cast<std::uint8_t>(file[at + i]);
+    }
+    return value;
+  };
+  auto crc = [](const std::string &file, std::size_t at, std::size_t size) {
+    std::uint32_t c = 0xffffffffu;
+    for (std::size_t i = at; i < at + size; ++i) {
+      c ^= static_cast<std::uint8_t>(file[i]);
+      for (int k = 0; k < 8; ++k) {
+        c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      }
+    }
+    return c ^ 0xffffffffu;
+  };
+
+  view::PngEncoder encoder({0, 0, 0, 0, 255, 0, 0, 255});
+  ensure(encoder.getPaletteSize() == 2, "PNG palette size mismatch");
+  std::vector<std::uint8_t> pixels(64 * 64, 0);
+  pixels[5 * 64 + 7] = 1;
+  const std::string file = encoder.encode(64, 64, pixels.data());
+  ensure(file.compare(0, 8, "\x89PNG\r\n\x1a\n") == 0,
+         "PNG signature mismatch");
+  // IHDR, PLTE, tRNS, IDAT and IEND, each with its CRC
+  std::vector<std::string> chunks;
+  std::size_t at = 8;
+  while (at + 12 <= file.size()) {
+    const std::uint32_t length = u32(file, at);
+    chunks.push_back(file.substr(at + 4, 4));
+    ensure(crc(file, at + 4, length + 4) == u32(file, at + 8 + length),
+           "PNG chunk CRC mismatch");
+    at += 12 + length;
+  }
+  ensure(at == file.size() &&
+             chunks == std::vector<std::string>{"IHDR", "PLTE", "tRNS",
+                                                "IDAT", "IEND"},
+         "PNG chunks mismatch");
+  ensure(u32(file, 16) == 64 && u32(file, 20) == 64 && file[24] == 8 &&
+             file[25] == 3,
+         "PNG header mismatch");
+  // The repeats of a flat tile take a few bytes per row
+  ensure(file.size() < 64 * 4, "PNG not compressed");
+
+  bool threw = false;
+  try {
+    view::PngEncoder(std::vector<std::uint8_t>{1, 2, 3});
+  } catch (const std::invalid_argument &) {
+    threw = true;
+  }
+  ensure(threw, "PNG palette of a partial color accepted");
+
+  std::cout << "PngEncoder tests PASSED" << std::endl;
+}
+
 int main() {
   std::cout << "Running extended kernel unit tests..." << std::endl;
   std::cout << "======================================" << std::endl;
@@ -318,7 +4154,34 @@ int main() {
 
     // Additional microkernel classes
     testAdditionalMicrokernelClasses();
+    testWorkStealingThreadPool();
+    testLevelIndexedMap();
+    testInfluenceArena();
+    testMemoryAccounting();
+    testCallbackProfiler();
+    testConsistentStateSnapshot();
+    testPublicLocalStateIndex();
+    testAgentRegistry();
     testLevelAndEnvironment();
+    testStateStream();
+    testAsyncProbe();
+    testStepBarrier();
+    testParameterStore();
+    testBatchRandom();
+    testPerceivedDataRecycling();
+    testStreamingStatistics();
+    testStaticExtendedAgent();
+    testInfluenceLog();
+    testParameterSweepRunner();
+    testStepTimings();
+    testParallelReaction();
+    testPipelinedPerception();
+    testActivationScheduling();
+    testSimilarSessionServer();
+    testModelPlugin();
+    testBatchRunner();
+    testPngEncoder();
+    testCoroutineDecisionModel();
 
     std::cout << "======================================" << std::endl;
     std::cout << "ALL EXTENDED KERNEL TESTS PASSED! 🎉" << std::endl;
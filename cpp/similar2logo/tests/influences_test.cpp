@@ -3,7 +3,9 @@
 #include <iostream>
 #include <memory>
 #include <unordered_set>
+#include <utility>
 
+#include "kernel/gpu/CpuLogoCompute.h"
 #include "kernel/influences/AgentPositionUpdate.h"
 #include "kernel/influences/ChangeAcceleration.h"
 #include "kernel/influences/ChangeDirection.h"
@@ -16,10 +18,15 @@
 #include "kernel/influences/RemoveMarks.h"
 #include "kernel/influences/Stop.h"
 
+#include "kernel/model/environment/LogoEnvPLS.h"
 #include "kernel/model/environment/Mark.h"
 #include "kernel/model/environment/TurtlePLSInLogo.h"
+#include "kernel/model/levels/LogoDefaultReactionModel.h"
+#include "kernel/tools/FieldDiffusion.h"
 #include "kernel/tools/Point2D.h"
 
+#include "influences/InfluenceDispatcher.h"
+
 namespace mk = fr::univ_artois::lgi2a::similar::microkernel;
 namespace s2l = fr::univ_artois::lgi2a::similar::similar2logo::kernel;
 
@@ -190,6 +197,324 @@ void testAgentPositionUpdate() {
   std::cout << "PASS" << std::endl;
 }
 
+void testInfluenceTypeTags() {
+  std::cout << "Testing influence type tags..." << std::endl;
+  mk::SimulationTimeStamp t1(0);
+  mk::SimulationTimeStamp t2(10);
+  s2l::tools::Point2D loc(10, 20);
+  auto turtle = std::make_shared<s2l::model::environment::TurtlePLSInLogo>(
+      loc, 0.0, 1.0, 0.0, true, std::string("red"));
+
+  s2l::influences::ChangeDirection direction(t1, t2, 1.0, turtle);
+  s2l::influences::ChangeSpeed speed(t1, t2, 2.0, turtle);
+  s2l::influences::Stop stop(t1, t2, turtle);
+  assert(direction.getTypeTag() != mk::influences::NO_INFLUENCE_TYPE_TAG);
+  assert(direction.getTypeTag() != speed.getTypeTag());
+
+  mk::influences::InfluenceDispatcher<double &> dispatcher;
+  dispatcher.on<s2l::influences::ChangeDirection>(
+      [](s2l::influences::ChangeDirection &inf, double &sum) {
+        sum += inf.getDd();
+      });
+  dispatcher.on<s2l::influences::ChangeSpeed>(
+      [](s2l::influences::ChangeSpeed &inf, double &sum) {
+        sum += inf.getDs();
+      });
+
+  double sum = 0.0;
+  assert(dispatcher.dispatch(direction, sum));
+  assert(dispatcher.dispatch(speed, sum));
+  assert(!dispatcher.dispatch(stop, sum));
+  assert(sum == 3.0);
+  std::cout << "PASS" << std::endl;
+}
+
+void testBatchedLogoReaction() {
+  std::cout << "Testing batched LogoDefaultReactionModel..." << std::endl;
+  mk::SimulationTimeStamp t1(0);
+  mk::SimulationTimeStamp t2(1);
+  mk::LevelIdentifier level("logo");
+  auto env = std::make_shared<s2l::model::environment::LogoEnvPLS>(
+      level, 10, 10, true, true,
+      std::unordered_set<s2l::model::environment::Pheromone>());
+  auto turtle = std::make_shared<s2l::model::environment::TurtlePLSInLogo>(
+      s2l::tools::Point2D(5.5, 5.5), 0.0, 1.0, 0.0, true, std::string("red"));
+  env->getTurtlesInPatches()(5, 5).insert(turtle);
+
+  auto state =
+      std::make_shared<mk::dynamicstate::ConsistentPublicLocalDynamicState>(
+          t1, level);
+  state->setPublicLocalStateOfEnvironment(env);
+
+  // Stop is applied after ChangeSpeed whatever the order of the influences.
+  std::set<std::shared_ptr<mk::influences::IInfluence>> influences = {
+      std::make_shared<s2l::influences::Stop>(t1, t2, turtle),
+      std::make_shared<s2l::influences::ChangeSpeed>(t1, t2, 2.0, turtle),
+      std::make_shared<s2l::influences::ChangePosition>(t1, t2, 1.0, 0.0,
+                                                        turtle)};
+  auto remaining = std::make_shared<mk::influences::InfluencesMap>();
+  s2l::model::levels::LogoDefaultReactionModel reaction;
+  reaction.makeRegularReaction(t1, t2, state, influences, remaining);
+
+  assert(turtle->getSpeed() == 0.0);
+  assert(std::abs(turtle->getLocation().x - 6.5) < 1e-9);
+  assert(env->getTurtlesAt(6, 5).count(turtle) == 1);
+  assert(env->getTurtlesAt(5, 5).empty());
+  std::cout << "PASS" << std::endl;
+}
+
+void testLogoPheromoneDiffusion() {
+  std::cout << "Testing the pheromone diffusion of LogoEnvPLS..." << std::endl;
+  mk::SimulationTimeStamp t1(0);
+  mk::SimulationTimeStamp t2(1);
+  mk::LevelIdentifier level("logo");
+  const s2l::model::environment::Pheromone pheromone("heat", 0.4, 0.0);
+  // toroidal along y only
+  auto env = std::make_shared<s2l::model::environment::LogoEnvPLS>(
+      level, 10, 8, false, true,
+      std::unordered_set<s2l::model::environment::Pheromone>{pheromone});
+  auto state =
+      std::make_shared<mk::dynamicstate::ConsistentPublicLocalDynamicState>(
+          t1, level);
+  state->setPublicLocalStateOfEnvironment(env);
+
+  // The emission is applied before the diffusion of the step.
+  std::set<std::shared_ptr<mk::influences::IInfluence>> influences = {
+      std::make_shared<s2l::influences::EmitPheromone>(
+          t1, t2, s2l::tools::Point2D(0.5, 0.5), "heat", 8.0),
+      std::make_shared<s2l::influences::PheromoneFieldUpdate>(t1, t2)};
+  auto remaining = std::make_shared<mk::influences::InfluencesMap>();
+  s2l::model::levels::LogoDefaultReactionModel reaction;
+  reaction.makeRegularReaction(t1, t2, state, influences, remaining);
+
+  // The patch on the border gives 0.4 * 8 to its 5 neighbours, the row
+  // above it being the last one.
+  assert(std::abs(env->getPheromoneValueAt(pheromone, 0, 0) - 4.8) < 1e-9);
+  for (const auto &[x, y] : {std::pair<int, int>{1, 0}, {0, 1}, {1, 1},
+                             {0, 7}, {1, 7}}) {
+    assert(std::abs(env->getPheromoneValueAt(pheromone, x, y) - 0.64) <
+           1e-9);
+  }
+  assert(env->getPheromoneValueAt(pheromone, 9, 0) == 0.0);
+  const auto &field = env->getPheromoneValues(pheromone);
+  double total = 0;
+  for (double value : field.values) {
+    total += value;
+  }
+  assert(std::abs(total - 8.0) < 1e-9);
+  std::cout << "PASS" << std::endl;
+}
+
+void testLogoNaturalOverlap() {
+  std::cout << "Testing the pheromone diffusion prepared ahead..."
+            << std::endl;
+  mk::SimulationTimeStamp t0(0);
+  mk::SimulationTimeStamp t1(1);
+  mk::SimulationTimeStamp t2(2);
+  mk::LevelIdentifier level("logo");
+  const s2l::model::environment::Pheromone pheromone("heat", 0.4, 0.1);
+  using Influences = std::set<std::shared_ptr<mk::influences::IInfluence>>;
+  // A field holding 8 on the patch (0, 0) after a first step
+  auto setUp = [&](s2l::model::levels::LogoDefaultReactionModel &reaction) {
+    auto env = std::make_shared<s2l::model::environment::LogoEnvPLS>(
+        level, 10, 8, true, true,
+        std::unordered_set<s2l::model::environment::Pheromone>{pheromone});
+    auto state =
+        std::make_shared<mk::dynamicstate::ConsistentPublicLocalDynamicState>(
+            t0, level);
+    state->setPublicLocalStateOfEnvironment(env);
+    reaction.makeRegularReaction(
+        t0, t1, state,
+        Influences{std::make_shared<s2l::influences::EmitPheromone>(
+            t0, t1, s2l::tools::Point2D(0.5, 0.5), "heat", 8.0)},
+        std::make_shared<mk::influences::InfluencesMap>());
+    return std::make_pair(env, state);
+  };
+  auto emission = [&] {
+    return std::make_shared<s2l::influences::EmitPheromone>(
+        t1, t2, s2l::tools::Point2D(5.5, 4.5), "heat", 3.0);
+  };
+  auto update = [&] {
+    return std::make_shared<s2l::influences::PheromoneFieldUpdate>(t1, t2);
+  };
+
+  // The field diffused at the reaction, without emission
+  s2l::model::levels::LogoDefaultReactionModel reference;
+  auto [diffused, diffusedState] = setUp(reference);
+  reference.makeRegularReaction(
+      t1, t2, diffusedState, Influences{update()},
+      std::make_shared<mk::influences::InfluencesMap>());
+
+  // The field diffused ahead receives the emissions of the step
+  s2l::model::levels::LogoDefaultReactionModel reaction;
+  auto [env, state] = setUp(reaction);
+  reaction.prepareNaturalDynamics(t1, t2, state);
+  assert(env->getPheromoneValueAt(pheromone, 0, 0) == 8.0);
+  reaction.makeRegularReaction(
+      t1, t2, state, Influences{emission(), update()},
+      std::make_shared<mk::influences::InfluencesMap>());
+  for (int y = 0; y < 8; ++y) {
+    for (int x = 0; x < 10; ++x) {
+      const double expected =
+          diffused->getPheromoneValueAt(pheromone, x, y) +
+          (x == 5 && y == 4 ? 3.0 : 0.0);
+      assert(std::abs(env->getPheromoneValueAt(pheromone, x, y) - expected) <
+             1e-12);
+    }
+  }
+
+  // Without an update of the fields, the prepared ones are dropped
+  s2l::model::levels::LogoDefaultReactionModel dropping;
+  auto [kept, keptState] = setUp(dropping);
+  dropping.prepareNaturalDynamics(t1, t2, keptState);
+  dropping.makeRegularReaction(
+      t1, t2, keptState, Influences{emission()},
+      std::make_shared<mk::influences::InfluencesMap>());
+  assert(kept->getPheromoneValueAt(pheromone, 0, 0) == 8.0 &&
+         kept->getPheromoneValueAt(pheromone, 5, 4) == 3.0);
+
+  // Fields prepared for another period are diffused again
+  s2l::model::levels::LogoDefaultReactionModel stale;
+  auto [late, lateState] = setUp(stale);
+  stale.prepareNaturalDynamics(t0, t1, lateState);
+  stale.makeRegularReaction(
+      t1, t2, lateState, Influences{update()},
+      std::make_shared<mk::influences::InfluencesMap>());
+  for (int y = 0; y < 8; ++y) {
+    for (int x = 0; x < 10; ++x) {
+      assert(late->getPheromoneValueAt(pheromone, x, y) ==
+             diffused->getPheromoneValueAt(pheromone, x, y));
+    }
+  }
+  std::cout << "PASS" << std::endl;
+}
+
+void testLogoComputeBackend() {
+  std::cout << "Testing the compute backend of LogoDefaultReactionModel..."
+            << std::endl;
+  using s2l::model::environment::TurtlePLSInLogo;
+  mk::LevelIdentifier level("logo");
+  const s2l::model::environment::Pheromone pheromone("heat", 0.3, 0.1, 0.0,
+                                                     0.01);
+  // The precision of the build rounds the values of the fields and turtles
+  const double tolerance = sizeof(s2l::gpu::FieldValue) == 4 ? 1e-4 : 1e-9;
+
+  // The same steps on the host, then on the CPU backend
+  auto run = [&](bool offloaded) {
+    auto env = std::make_shared<s2l::model::environment::LogoEnvPLS>(
+        level, 12, 9, false, true,
+        std::unordered_set<s2l::model::environment::Pheromone>{pheromone});
+    std::vector<std::shared_ptr<TurtlePLSInLogo>> turtles{
+        std::make_shared<TurtlePLSInLogo>(s2l::tools::Point2D(0.5, 8.5), 0.0,
+                                          1.0, 0.5, false, "red"),
+        std::make_shared<TurtlePLSInLogo>(s2l::tools::Point2D(6.2, 4.1), 1.2,
+                                          0.7, 0.0, false, "blue"),
+        std::make_shared<TurtlePLSInLogo>(s2l::tools::Point2D(11.5, 2.0),
+                                          -1.5, 2.0, 0.0, false, "green")};
+    for (const auto &turtle : turtles) {
+      const auto location = turtle->getLocation();
+      env->getTurtlesInPatches()(static_cast<int>(location.x),
+                                 static_cast<int>(location.y))
+          .insert(turtle);
+    }
+    auto state =
+        std::make_shared<mk::dynamicstate::ConsistentPublicLocalDynamicState>(
+            mk::SimulationTimeStamp(0), level);
+    state->setPublicLocalStateOfEnvironment(env);
+    s2l::model::levels::LogoDefaultReactionModel reaction;
+    if (offloaded) {
+      reaction.setComputeBackend(std::make_shared<s2l::gpu::CpuLogoCompute>());
+    }
+    for (int step = 0; step < 4; ++step) {
+      mk::SimulationTimeStamp t1(step);
+      mk::SimulationTimeStamp t2(step + 1);
+      std::set<std::shared_ptr<mk::influences::IInfluence>> influences = {
+          std::make_shared<s2l::influences::EmitPheromone>(
+              t1, t2, s2l::tools::Point2D(0.5, 0.5), "heat", 8.0),
+          std::make_shared<s2l::influences::EmitPheromone>(
+              t1, t2, s2l::tools::Point2D(5.5, 4.5), "heat", 3.0),
+          std::make_shared<s2l::influences::EmitPheromone>(
+              t1, t2, s2l::tools::Point2D(5.2, 4.9), "heat", 1.0),
+          std::make_shared<s2l::influences::ChangeDirection>(t1, t2, 0.2,
+                                                             turtles[1]),
+          std::make_shared<s2l::influences::PheromoneFieldUpdate>(t1, t2),
+          std::make_shared<s2l::influences::AgentPositionUpdate>(t1, t2)};
+      auto remaining = std::make_shared<mk::influences::InfluencesMap>();
+      reaction.makeRegularReaction(t1, t2, state, influences, remaining);
+    }
+    return std::make_pair(env, turtles);
+  };
+  const auto [hostEnv, hostTurtles] = run(false);
+  const auto [offloadedEnv, offloadedTurtles] = run(true);
+  for (int y = 0; y < 9; ++y) {
+    for (int x = 0; x < 12; ++x) {
+      assert(std::abs(hostEnv->getPheromoneValueAt(pheromone, x, y) -
+                      offloadedEnv->getPheromoneValueAt(pheromone, x, y)) <
+             tolerance);
+    }
+  }
+  for (std::size_t i = 0; i < hostTurtles.size(); ++i) {
+    const auto expected = hostTurtles[i]->getLocation();
+    const auto location = offloadedTurtles[i]->getLocation();
+    assert(std::abs(expected.x - location.x) < tolerance &&
+           std::abs(expected.y - location.y) < tolerance);
+    assert(std::abs(hostTurtles[i]->getSpeed() -
+                    offloadedTurtles[i]->getSpeed()) < tolerance);
+    assert(offloadedEnv
+               ->getTurtlesAt(static_cast<int>(location.x),
+                              static_cast<int>(location.y))
+               .count(offloadedTurtles[i]) == 1);
+  }
+  // The first turtle is clamped on the bounded x axis, the third wraps on y
+  assert(offloadedTurtles[0]->getLocation().y < 9.0);
+  assert(offloadedTurtles[2]->getLocation().x < 12.0);
+
+  // The tiled sweep of the larger grids, from the same values
+  s2l::gpu::CpuLogoCompute backend;
+  assert(backend.initialize());
+  s2l::tools::TiledField field;
+  field.assign(70, 40, 0.0);
+  for (int i = 0; i < 300; ++i) {
+    field.set((i * 37) % 70, (i * 11) % 40, 1.0 + (i % 7));
+  }
+  backend.resizeGrid(70, 40, true, false, 1);
+  backend.uploadField(0, field.values.data());
+  const s2l::tools::FieldDiffusion::Rates rates{0.25, true, 0.05, 1e-3};
+  s2l::tools::FieldDiffusion diffusion(70, 40, true, false);
+  diffusion.add(field, rates);
+  diffusion.run();
+  backend.diffuseAndEvaporate(
+      0, {rates.diffusion, rates.evaporate, rates.evaporation, rates.minValue});
+  std::vector<s2l::gpu::FieldValue> values(field.values.size());
+  backend.downloadField(0, values.data());
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    assert(std::abs(values[i] - field.values.data()[i]) < tolerance);
+  }
+
+  // The hash sorts the turtles by patch, by index within a patch
+  s2l::gpu::TurtleArrays arrays;
+  arrays.resize(5);
+  const double positions[5][2] = {
+      {3.5, 2.5}, {69.9, 39.9}, {3.1, 2.9}, {0.0, 0.0}, {10.5, 2.5}};
+  for (std::size_t i = 0; i < 5; ++i) {
+    arrays.x[i] = static_cast<s2l::gpu::TurtleValue>(positions[i][0]);
+    arrays.y[i] = static_cast<s2l::gpu::TurtleValue>(positions[i][1]);
+  }
+  backend.uploadTurtles(arrays);
+  backend.buildTurtleHash();
+  s2l::gpu::TurtleHash hash;
+  backend.downloadTurtleHash(hash);
+  assert(hash.cellStart.size() == 70 * 40 + 1 &&
+         hash.cellStart.back() == 5 && hash.order.size() == 5);
+  const std::size_t shared = 2 * 70 + 3;
+  assert(hash.cellStart[shared + 1] - hash.cellStart[shared] == 2);
+  assert(hash.order[hash.cellStart[shared]] == 0 &&
+         hash.order[hash.cellStart[shared] + 1] == 2);
+  assert(hash.order[hash.cellStart[0]] == 3 &&
+         hash.order[hash.cellStart[70 * 40 - 1]] == 1);
+  std::cout << "PASS" << std::endl;
+}
+
 int main() {
   std::cout << "Running similar2logo influence tests..." << std::endl;
 
@@ -204,6 +529,11 @@ int main() {
   testStop();
   testPheromoneFieldUpdate();
   testAgentPositionUpdate();
+  testInfluenceTypeTags();
+  testBatchedLogoReaction();
+  testLogoPheromoneDiffusion();
+  testLogoNaturalOverlap();
+  testLogoComputeBackend();
 
   std::cout << "All tests passed!" << std::endl;
   return 0;
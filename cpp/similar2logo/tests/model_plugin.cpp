@@ -0,0 +1,101 @@
+// A model plugin of the extended kernel tests (see testModelPlugin): its
+// model ends at the time given as argument, its agents of the category
+// "batched" are stepped in batches in the level "plugin", and its probe
+// "final" writes the final time to the file given as argument.
+
+#include "IProbe.h"
+#include "ISimulationModel.h"
+#include "engine/ICategoryBatchBehavior.h"
+#include "engine/ModelPlugin.h"
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace mk = fr::univ_artois::lgi2a::similar::microkernel;
+
+namespace {
+
+class PluginModel : public mk::ISimulationModel {
+public:
+  explicit PluginModel(long finalTime) : finalTime(finalTime) {}
+
+  mk::SimulationTimeStamp getInitialTime() const override {
+    return mk::SimulationTimeStamp(0);
+  }
+
+  bool isFinalTimeOrAfter(const mk::SimulationTimeStamp &currentTime,
+                          const mk::ISimulationEngine &) const override {
+    return currentTime.getIdentifier() >= finalTime;
+  }
+
+  std::vector<std::shared_ptr<mk::levels::ILevel>>
+  generateLevels(const mk::SimulationTimeStamp &) override {
+    return {};
+  }
+
+  EnvironmentInitializationData generateEnvironment(
+      const mk::SimulationTimeStamp &,
+      const std::map<mk::LevelIdentifier,
+                     std::shared_ptr<mk::levels::ILevel>> &) override {
+    return EnvironmentInitializationData(nullptr);
+  }
+
+  AgentInitializationData generateAgents(
+      const mk::SimulationTimeStamp &,
+      const std::map<mk::LevelIdentifier,
+                     std::shared_ptr<mk::levels::ILevel>> &) override {
+    return AgentInitializationData();
+  }
+
+private:
+  long finalTime;
+};
+
+class PluginBatchBehavior : public mk::engine::ICategoryBatchBehavior {};
+
+class FinalTimeProbe : public mk::IProbe {
+public:
+  explicit FinalTimeProbe(std::string path) : path(std::move(path)) {}
+
+  void observeAtFinalTime(const mk::SimulationTimeStamp &finalTimestamp,
+                          const mk::ISimulationEngine &) override {
+    std::ofstream(path) << finalTimestamp.getIdentifier();
+  }
+
+  std::shared_ptr<mk::IProbe> clone() const override {
+    return std::make_shared<FinalTimeProbe>(path);
+  }
+
+private:
+  std::string path;
+};
+
+mk::ISimulationModel *makeModel(const std::string &arguments) {
+  if (arguments.empty()) {
+    return nullptr;
+  }
+  return new PluginModel(std::stol(arguments));
+}
+
+const mk::engine::ModelPluginBatchBehavior batchBehaviors[] = {
+    {"batched", "plugin",
+     []() -> mk::engine::ICategoryBatchBehavior * {
+       return new PluginBatchBehavior();
+     },
+     [](mk::engine::ICategoryBatchBehavior *behavior) { delete behavior; }},
+};
+
+const mk::engine::ModelPluginProbe probes[] = {
+    {"final",
+     [](const char *arguments) -> mk::IProbe * {
+       return new FinalTimeProbe(arguments);
+     },
+     [](mk::IProbe *probe) { delete probe; }},
+};
+
+} // namespace
+
+SIMILAR_MODEL_PLUGIN(makeModel)
+SIMILAR_MODEL_PLUGIN_BATCH_BEHAVIORS(batchBehaviors)
+SIMILAR_MODEL_PLUGIN_PROBES(probes)
@@ -48,10 +48,7 @@ class Turmite(Turtle):
         if self._environment is None:
             return False
         
-        marks_grid = self._environment.get_marks()
-        if 0 <= x < len(marks_grid) and 0 <= y < len(marks_grid[0]):
-            return len(marks_grid[x][y]) > 0
-        return False
+        return len(self._environment.get_marks_at(x, y)) > 0
     
     def decide(self, perception):
         """
@@ -84,7 +81,7 @@ class Turmite(Turtle):
             
             # Remove the mark
             if self._environment:
-                marks_at_pos = self._environment.get_marks()[cell_x][cell_y]
+                marks_at_pos = self._environment.get_marks_at(cell_x, cell_y)
                 if marks_at_pos:
                     mark_to_remove = next(iter(marks_at_pos))
                     influences.append(RemoveMark(t_now, t_next, mark_to_remove))
@@ -136,9 +133,7 @@ def main():
     print(f"\nSimulation complete!")
     
     # Count marks in the environment
-    marks_grid = sim.environment.get_marks()
-    total_marks = sum(len(marks_grid[x][y]) for x in range(len(marks_grid)) 
-                      for y in range(len(marks_grid[0])))
+    total_marks = sim.environment.get_mark_count()
     print(f"Final cells painted: {total_marks}")
     print("=" * 60)
 
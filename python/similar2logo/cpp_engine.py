@@ -5,10 +5,51 @@ This module provides a Python-friendly interface to the high-performance
 C++ Logo simulation engine with true multithreading.
 """
 
+from collections.abc import Mapping
+from concurrent.futures import Future, ThreadPoolExecutor
 from typing import List, Callable, Optional, Any
+import asyncio
 import math
 
 
+class LazyPerception(Mapping):
+    """
+    The perception of a turtle as a read-only dict whose values are read
+    from the C++ perceived data on the first access to their key, then
+    kept: a decide() reading only the position does not convert the nearby
+    turtles or the pheromones.
+    """
+
+    _GETTERS = {
+        'position': 'get_position',
+        'heading': 'get_heading',
+        'speed': 'get_speed',
+        'nearby_turtles': 'get_nearby_turtles',
+        'pheromones': 'get_all_pheromones',
+    }
+
+    __slots__ = ('_perception', '_values')
+
+    def __init__(self, perception):
+        self._perception = perception
+        self._values = {}
+
+    def __getitem__(self, key):
+        try:
+            return self._values[key]
+        except KeyError:
+            getter = self._GETTERS[key]
+        value = getattr(self._perception, getter)()
+        self._values[key] = value
+        return value
+
+    def __iter__(self):
+        return iter(self._GETTERS)
+
+    def __len__(self):
+        return len(self._GETTERS)
+
+
 class CppLogoSimulation:
     """
     High-performance Logo simulation using C++ multithreaded engine.
@@ -20,6 +61,14 @@ class CppLogoSimulation:
         >>> sim = CppLogoSimulation(width=100, height=100, num_threads=4)
         >>> sim.add_agents(BoidAgent, count=1000)
         >>> sim.run_web(port=8080)
+
+    The engine releases the GIL while it runs, so steps can run in the
+    background while the Python thread keeps serving or plotting:
+
+        >>> sim.start()
+        >>> future = sim.step_async(10)   # returns immediately
+        >>> future.result()               # the time reached
+        >>> await sim.astep(10)           # from a coroutine
     """
     
     def __init__(self, width: int = 100, height: int = 100,
@@ -56,7 +105,12 @@ class CppLogoSimulation:
         self.engine = self._cpp.MultiThreadedEngine(self.num_threads)
         
         self._agents = []
+        self._native_agents = []
+        self._compiled_agents = []
         self._pheromones = []
+        self._started = False
+        # Runs the background steps one after the other
+        self._executor: Optional[ThreadPoolExecutor] = None
     
     def add_pheromone(self, pheromone_id: str, diffusion: float = 0.1,
                      evaporation: float = 0.01):
@@ -85,6 +139,60 @@ class CppLogoSimulation:
         # Store agent specifications
         self._agents.append((agent_class, count, kwargs))
     
+    def add_native_agents(self, behavior: str, count: int,
+                          category: Optional[str] = None, **params):
+        """
+        Add agents deciding with a native C++ behavior, which never calls
+        back into Python.
+
+        Args:
+            behavior: 'boids', 'ant' (requires pheromone=...) or
+                'segregation'
+            count: Number of agents to create
+            category: Category of the agents (default: the behavior name);
+                the category a segregation agent compares its neighbors to
+            **params: Parameters of the behavior, e.g. max_angle=0.5
+
+        Example:
+            >>> sim.add_native_agents('ant', 200, pheromone='food',
+            ...                       deposited_amount=1.0)
+        """
+        self._native_agents.append((behavior, count, category or behavior,
+                                    params))
+
+    def add_compiled_agents(self, behavior, count: int,
+                            category: Optional[str] = None,
+                            cache_dir: Optional[str] = None):
+        """
+        Add agents deciding with a DSL behavior compiled to a native kernel
+        (see similar2logo.dsl.compiler), built now or found in the cache.
+
+        The turtles of the behavior decide in one batch per step, so a
+        simulation holds one compiled behavior, the batch decision hook of
+        the engine. Without a C++ compiler, the behavior runs in Python, in
+        one call per step rather than per turtle.
+
+        Args:
+            behavior: A NativeBehavior, e.g. a @native_behavior function
+            count: Number of agents to create
+            category: Category of the agents (default: the behavior name)
+            cache_dir: Cache of the libraries (default:
+                SIMILAR2LOGO_DSL_CACHE or ~/.cache/similar2logo/dsl)
+
+        Returns:
+            The CompiledBehavior, or None if the behavior runs in Python
+        """
+        if self._compiled_agents and \
+                self._compiled_agents[0][0] is not behavior:
+            raise ValueError("a simulation holds one compiled behavior")
+        try:
+            compiled = behavior.compile(cache_dir=cache_dir)
+        except RuntimeError:
+            compiled = None
+        self._compiled_agents.append((behavior, compiled, count,
+                                      category or behavior.name))
+        return compiled
+
     def run(self, steps: Optional[int] = None):
         """
         Run the simulation for a number of steps.
@@ -92,19 +200,140 @@ class CppLogoSimulation:
         Args:
             steps: Number of steps (None = run until max_steps)
         """
-        # Configure the model with agent factory
+        if steps is None:
+            # Configure the model with agent factory
+            self._configure_agents()
+
+            # Run simulation
+            self.engine.run_new_simulation(self.model)
+            return
+        if not self._started:
+            self.start()
+        self.engine.run_simulation(self.engine.get_current_time() + steps)
+
+    def start(self):
+        """
+        Build the initial state of the simulation without running it, for
+        step_async() and astep().
+        """
         self._configure_agents()
-        
-        # Run simulation
-        self.engine.run_new_simulation(self.model)
+        self.engine.initialize_simulation(self.model)
+        self._started = True
+
+    def step_async(self, steps: int = 1) -> Future:
+        """
+        Run steps of the simulation on a background thread.
+
+        The steps requested by successive calls run one after the other. The
+        state of the simulation must not be read until the future is done.
+
+        Args:
+            steps: Number of steps
+
+        Returns:
+            A future of the time reached, raising the error of the engine if
+            the steps failed
+        """
+        if not self._started:
+            raise RuntimeError("start() the simulation before stepping it")
+        if self._executor is None:
+            self._executor = ThreadPoolExecutor(
+                max_workers=1, thread_name_prefix="similar2logo-engine")
+
+        def run_steps():
+            self.engine.run_simulation(self.engine.get_current_time() + steps)
+            return self.engine.get_current_time()
+
+        return self._executor.submit(run_steps)
+
+    def set_real_time_pacing(self, steps_per_second: float = 1.0,
+                             acceleration: float = 1.0,
+                             spin_seconds: float = 0.0003):
+        """
+        Pace the steps in real time, in C++: this replaces a
+        RealTimeMatcherProbe, whose sleeps hold the GIL and drift.
+
+        The steps follow a timeline of the paced rate, so that the late
+        wake-ups are caught up instead of accumulating.
+
+        Args:
+            steps_per_second: Steps per second at real-time speed, 0 for
+                no limit
+            acceleration: Speed multiplier of the rate; it may be changed
+                while the simulation runs
+            spin_seconds: Last part of each wait spent spinning, for a
+                sub-millisecond accuracy
+
+        Returns:
+            The StepBarrier of the engine, whose pacing_statistics report
+            the lateness of the steps
+        """
+        barrier = self.engine.get_step_barrier()
+        if barrier is None:
+            barrier = self._cpp.StepBarrier()
+            self.engine.set_step_barrier(barrier)
+        barrier.step_rate = steps_per_second
+        barrier.acceleration = acceleration
+        barrier.spin_threshold_seconds = spin_seconds
+        return barrier
+
+    def set_callback_profiling(self, enabled: bool = True):
+        """
+        Profile the calls of the engine to the Python decisions: the calls,
+        the time, the time waiting for the GIL and the time converting the
+        arguments, per agent class. The profiles cover every simulation of
+        the process.
+
+        Args:
+            enabled: Whether the calls are profiled
+        """
+        self._cpp.set_callback_profiling(enabled)
+
+    def callback_profiles(self) -> List[dict]:
+        """
+        Get the profiles of the Python decisions, the slowest first: the
+        behaviours to write natively first.
+
+        Returns:
+            One dict per callback, e.g. 'BoidAgent.decide', with its calls
+            and its total, gil_wait and conversion times in seconds
+        """
+        profiles = [{
+            'callback': profile.callback,
+            'calls': profile.calls,
+            'total': profile.total,
+            'gil_wait': profile.gil_wait,
+            'conversion': profile.conversion,
+        } for profile in self.engine.get_callback_profiles()]
+        return sorted(profiles, key=lambda profile: profile['total'],
+                      reverse=True)
+
+    async def astep(self, steps: int = 1) -> int:
+        """Awaitable version of step_async()."""
+        return await asyncio.wrap_future(self.step_async(steps))
+
+    def stop(self, wait: bool = True):
+        """
+        Abort the running steps and drop the pending ones.
+
+        Args:
+            wait: Whether to wait for the background thread to end
+        """
+        self.engine.request_simulation_abortion()
+        if self._executor is not None:
+            self._executor.shutdown(wait=wait, cancel_futures=True)
+            self._executor = None
     
-    def run_web(self, port: int = 8080, host: str = "0.0.0.0"):
+    def run_web(self, port: int = 8080, host: str = "0.0.0.0",
+                frame_format: str = "binary"):
         """
         Run simulation with web interface.
         
         Args:
             port: Web server port
             host: Web server host
+            frame_format: 'binary' to stream compact binary frames, or
+                'json' for JSON snapshots
         """
         # For now, fall back to Python web server
         # TODO: Integrate with C++ SimilarWebRunner
@@ -125,7 +354,7 @@ class CppLogoSimulation:
             py_sim.add_turtles(count, agent_class, **kwargs)
         
         # Run with web interface
-        web_sim = WebSimulation(py_sim)
+        web_sim = WebSimulation(py_sim, frame_format=frame_format)
         web_sim.start_server(host=host, port=port)
     
     def _configure_agents(self):
@@ -148,15 +377,9 @@ class CppLogoSimulation:
                     
                     def make_decision_callback(py_agent):
                         def callback(perception, influences):
-                            # Call Python decide() method
-                            # Convert C++ perception to Python-friendly format
-                            py_perception = {
-                                'position': perception.get_position(),
-                                'heading': perception.get_heading(),
-                                'speed': perception.get_speed(),
-                                'nearby_turtles': perception.get_nearby_turtles(),
-                                'pheromones': perception.get_all_pheromones()
-                            }
+                            # Call Python decide() method, with the C++
+                            # perception read on demand
+                            py_perception = LazyPerception(perception)
                             
                             # Get influences from Python agent
                             py_influences = py_agent.decide(py_perception)
@@ -171,7 +394,8 @@ class CppLogoSimulation:
                     # Set decision model
                     decision_model = self._cpp.PythonDecisionModel(
                         LogoSimulationLevelList.LOGO,
-                        make_decision_callback(py_agent)
+                        make_decision_callback(py_agent),
+                        profile=f"{agent_class.__name__}.decide"
                     )
                     
                     cpp_agent.specify_behavior_for_level(
@@ -182,16 +406,67 @@ class CppLogoSimulation:
                     
                     cpp_agents.append(cpp_agent)
             
+            for behavior, count, category_name, params in self._native_agents:
+                if behavior == 'segregation':
+                    params = dict(params, category=category_name)
+                # The native models are stateless: one serves all the agents
+                decision_model = self._cpp.make_behavior(
+                    behavior, LogoSimulationLevelList.LOGO, **params)
+                for i in range(count):
+                    cpp_agent = self._cpp.LogoAgent(AgentCategory(category_name))
+                    cpp_agent.specify_behavior_for_level(
+                        LogoSimulationLevelList.LOGO,
+                        None,  # Perception model (use default)
+                        decision_model
+                    )
+                    cpp_agents.append(cpp_agent)
+
+            if self._compiled_agents:
+                decision_model = self._make_compiled_decision_model(
+                    LogoSimulationLevelList.LOGO)
+                self.engine.set_batch_decision_hook(decision_model)
+            for _, _, count, category_name in self._compiled_agents:
+                for i in range(count):
+                    cpp_agent = self._cpp.LogoAgent(AgentCategory(category_name))
+                    cpp_agent.specify_behavior_for_level(
+                        LogoSimulationLevelList.LOGO,
+                        None,  # Perception model (use default)
+                        decision_model
+                    )
+                    cpp_agents.append(cpp_agent)
+
             return cpp_agents
         
         self.model.set_agent_factory(agent_factory)
+
+    def _make_compiled_decision_model(self, level):
+        """The batch decision model of the compiled behavior."""
+        behavior, compiled, _, _ = self._compiled_agents[0]
+        if compiled is not None:
+            return compiled.make_decision_model(level, self._cpp)
+
+        from similar2logo.dsl.compiler import Perception
+        names = list(behavior.pheromones)
+
+        def decide(rows, pheromones, heading_deltas, speed_deltas):
+            for i, row in enumerate(rows):
+                perception = Perception(
+                    float(row['x']), float(row['y']), float(row['heading']),
+                    float(row['speed']), int(row['nearby_turtles']),
+                    dict(zip(names, pheromones[i])))
+                heading_deltas[i], speed_deltas[i] = behavior(perception)
+
+        return self._cpp.BatchDecisionModel(
+            level, names, decide, profile=f"{behavior.name}.decide")
     
     def get_state(self):
         """Get current simulation state."""
         # TODO: Implement state extraction from C++ engine
         return {
             'step': 0,
-            'num_turtles': sum(count for _, count, _ in self._agents),
+            'num_turtles': (sum(count for _, count, _ in self._agents) +
+                            sum(spec[1] for spec in self._native_agents) +
+                            sum(spec[2] for spec in self._compiled_agents)),
             'turtles': []
         }
 
@@ -29,6 +29,8 @@ import math
 from ..model import LogoSimulation, Turtle
 from ..tools import Point2D
 from ..tools import Point2D
+from .compiler import (DSLCompileError, NativeBehavior, Perception,
+                       native_behavior, random, uniform)
 try:
     from ..web import WebSimulation
 except ImportError:
@@ -442,4 +444,10 @@ __all__ = [
     'Simulation',
     'SimpleTurtle',
     'SimulationConfig',
+    'DSLCompileError',
+    'NativeBehavior',
+    'Perception',
+    'native_behavior',
+    'random',
+    'uniform',
 ]
@@ -0,0 +1,566 @@
+"""
+Similar2Logo DSL - Native Behaviors
+
+Compiles the behaviors written in a subset of Python into C++ decision
+kernels, built into a shared library when the model is built, cached by the
+hash of their source and loaded by the C++ engine: the turtles of a compiled
+behavior decide with no call into Python.
+
+A behavior is a function of the perception of one turtle returning its
+change of heading and, optionally, of speed:
+
+    ```python
+    from similar2logo.dsl import native_behavior, uniform
+
+    @native_behavior(pheromones=['food'])
+    def ant(p):
+        if p.pheromone('food') > 0.1:
+            return 0.0
+        return uniform(-0.4, 0.4), 0.01
+
+    sim = CppLogoSimulation(100, 100)
+    sim.add_pheromone('food')
+    sim.add_compiled_agents(ant, count=1000)
+    ```
+
+The supported subset:
+
+- the attributes ``p.x``, ``p.y``, ``p.heading``, ``p.speed`` and
+  ``p.nearby_turtles`` (their number), and ``p.pheromone('name')`` for the
+  pheromones declared by the decorator;
+- local variables, assignments, ``if``/``elif``/``else``, ``return`` and
+  ``pass``;
+- numbers, arithmetic, comparisons, ``and``/``or``/``not`` (as logical
+  operators), conditional expressions, and the numbers of the module or the
+  closure of the function, read once when compiling;
+- ``abs``, ``min``, ``max``, the functions of ``math`` (``math.sin``, ...,
+  ``math.pi``) and the random draws ``uniform(a, b)`` and ``random()`` of this
+  module.
+
+Any other construct raises a DSLCompileError naming its line. The random
+draws of a native kernel come from a stream per step and row rather than
+from the generator of the agent. The same function runs in Python, with the
+same perception, when no compiler is available (NativeBehavior.__call__).
+"""
+
+import ast
+import hashlib
+import inspect
+import math
+import os
+import random as _random
+import shutil
+import subprocess
+import tempfile
+import textwrap
+from dataclasses import dataclass, field
+from pathlib import Path
+from typing import Callable, Dict, List, Optional, Sequence, Tuple
+
+#: The version of the rows and of the kernel signature the generated source
+#: declares (CompiledBehaviorLibrary::ABI_VERSION)
+ABI_VERSION = 1
+
+#: The flags of the compiler, part of the hash of a library
+CXX_FLAGS = ('-std=c++17', '-O3', '-shared', '-fPIC')
+
+
+class DSLCompileError(ValueError):
+    """A behavior uses a construct outside the supported subset."""
+
+
+def uniform(low: float, high: float) -> float:
+    """A random number in [low, high)."""
+    return _random.uniform(low, high)
+
+
+def random() -> float:
+    """A random number in [0, 1)."""
+    return _random.random()
+
+
+class Perception:
+    """The perception of a turtle, as a native behavior reads it."""
+
+    __slots__ = ('x', 'y', 'heading', 'speed', 'nearby_turtles', '_pheromones')
+
+    def __init__(self, x=0.0, y=0.0, heading=0.0, speed=0.0, nearby_turtles=0,
+                 pheromones: Optional[Dict[str, float]] = None):
+        self.x = x
+        self.y = y
+        self.heading = heading
+        self.speed = speed
+        self.nearby_turtles = nearby_turtles
+        self._pheromones = pheromones or {}
+
+    def pheromone(self, name: str) -> float:
+        return self._pheromones.get(name, 0.0)
+
+
+_MATH_FUNCTIONS = {
+    'sin': 'std::sin', 'cos': 'std::cos', 'tan': 'std::tan',
+    'asin': 'std::asin', 'acos': 'std::acos', 'atan': 'std::atan',
+    'atan2': 'std::atan2', 'sqrt': 'std::sqrt', 'exp': 'std::exp',
+    'log': 'std::log', 'floor': 'std::floor', 'ceil': 'std::ceil',
+    'fabs': 'std::fabs', 'hypot': 'std::hypot', 'pow': 'std::pow',
+    'copysign': 'std::copysign', 'fmod': 'std::fmod',
+}
+_MATH_CONSTANTS = {'pi': math.pi, 'e': math.e, 'tau': math.tau}
+_FIELDS = ('x', 'y', 'heading', 'speed', 'nearby_turtles')
+_BINARY = {ast.Add: '+', ast.Sub: '-', ast.Mult: '*', ast.Div: '/'}
+_COMPARE = {ast.Eq: '==', ast.NotEq: '!=', ast.Lt: '<', ast.LtE: '<=',
+            ast.Gt: '>', ast.GtE: '>='}
+
+
+def _literal(value) -> str:
+    if isinstance(value, bool):
+        return '1.0' if value else '0.0'
+    text = repr(float(value))
+    if text in ('inf', '-inf', 'nan'):
+        return {'inf': 'HUGE_VAL', '-inf': '(-HUGE_VAL)', 'nan': 'NAN'}[text]
+    return text
+
+
+class _Translator:
+    """Translates the body of a behavior function into C++ statements."""
+
+    def __init__(self, function: Callable, pheromones: Sequence[str]):
+        self.function = function
+        self.pheromones = list(pheromones)
+        source = textwrap.dedent(inspect.getsource(function))
+        self.first_line = function.__code__.co_firstlineno
+        module = ast.parse(source)
+        definition = module.body[0]
+        if not isinstance(definition, ast.FunctionDef):
+            raise DSLCompileError('a behavior must be a function')
+        arguments = definition.args
+        if (len(arguments.args) != 1 or arguments.vararg or arguments.kwarg
+                or arguments.kwonlyargs or arguments.defaults):
+            raise DSLCompileError(
+                'a behavior takes one argument, the perception')
+        self.definition = definition
+        self.perception = arguments.args[0].arg
+        closure = inspect.getclosurevars(function)
+        self.constants = dict(closure.globals)
+        self.constants.update(closure.nonlocals)
+        self.locals: List[str] = []
+        for node in ast.walk(definition):
+            if isinstance(node, ast.Name) and isinstance(node.ctx, ast.Store):
+                if node.id == self.perception:
+                    raise self.error(node, 'the perception is read-only')
+                if node.id not in self.locals:
+                    self.locals.append(node.id)
+
+    def error(self, node, message) -> DSLCompileError:
+        line = self.first_line + getattr(node, 'lineno', 1) - 1
+        return DSLCompileError(
+            f'{self.function.__name__}, line {line}: {message}')
+
+    # Statements
+
+    def body(self) -> List[str]:
+        lines = [f'double v_{name} = 0.0;' for name in self.locals]
+        lines += self.statements(self.definition.body, 0)
+        return lines
+
+    def statements(self, statements, depth) -> List[str]:
+        lines = []
+        for statement in statements:
+            lines += self.statement(statement, depth)
+        return lines
+
+    def statement(self, node, depth) -> List[str]:
+        indent = '  ' * depth
+        if isinstance(node, ast.Expr) and isinstance(node.value, ast.Constant) \
+                and isinstance(node.value.value, str):
+            return []  # the docstring
+        if isinstance(node, ast.Pass):
+            return []
+        if isinstance(node, ast.Assign):
+            if len(node.targets) != 1 or not isinstance(node.targets[0],
+                                                        ast.Name):
+                raise self.error(node, 'only assignments to one name')
+            return [f'{indent}v_{node.targets[0].id} = '
+                    f'{self.expression(node.value)};']
+        if isinstance(node, ast.AugAssign):
+            if not isinstance(node.target, ast.Name):
+                raise self.error(node, 'only assignments to one name')
+            name = ast.Name(id=node.target.id, ctx=ast.Load())
+            value = ast.BinOp(left=name, op=node.op, right=node.value)
+            ast.copy_location(value, node)
+            return [f'{indent}v_{node.target.id} = {self.expression(value)};']
+        if isinstance(node, ast.If):
+            lines = [f'{indent}if ({self.condition(node.test)}) {{']
+            lines += self.statements(node.body, depth + 1)
+            if node.orelse:
+                lines.append(f'{indent}}} else {{')
+                lines += self.statements(node.orelse, depth + 1)
+            lines.append(f'{indent}}}')
+            return lines
+        if isinstance(node, ast.Return):
+            return [indent + line for line in self.result(node)]
+        raise self.error(node, f'unsupported statement {type(node).__name__}')
+
+    def result(self, node) -> List[str]:
+        value = node.value
+        if value is None:
+            return ['return;']
+        if isinstance(value, ast.Tuple):
+            if len(value.elts) != 2:
+                raise self.error(node, 'return a heading change, and a speed '
+                                       'change')
+            return [f'headingDelta = {self.expression(value.elts[0])};',
+                    f'speedDelta = {self.expression(value.elts[1])};',
+                    'return;']
+        return [f'headingDelta = {self.expression(value)};', 'return;']
+
+    # Expressions
+
+    def condition(self, node) -> str:
+        if isinstance(node, ast.UnaryOp) and isinstance(node.op, ast.Not):
+            return f'!({self.condition(node.operand)})'
+        if isinstance(node, ast.BoolOp):
+            operator = ' && ' if isinstance(node.op, ast.And) else ' || '
+            return '(' + operator.join(
+                self.condition(v) for v in node.values) + ')'
+        if isinstance(node, ast.Compare):
+            terms = []
+            left = self.expression(node.left)
+            for op, comparator in zip(node.ops, node.comparators):
+                operator = _COMPARE.get(type(op))
+                if operator is None:
+                    raise self.error(node, 'unsupported comparison')
+                right = self.expression(comparator)
+                terms.append(f'{left} {operator} {right}')
+                left = right
+            return terms[0] if len(terms) == 1 else \
+                '(' + ' && '.join(terms) + ')'
+        return f'({self.expression(node)} != 0.0)'
+
+    def expression(self, node) -> str:
+        if isinstance(node, ast.Constant):
+            if isinstance(node.value, (int, float)):
+                return _literal(node.value)
+            raise self.error(node, 'only numbers are values')
+        if isinstance(node, ast.Name):
+            return self.name(node)
+        if isinstance(node, ast.Attribute):
+            return self.attribute(node)
+        if isinstance(node, ast.BinOp):
+            left = self.expression(node.left)
+            right = self.expression(node.right)
+            operator = _BINARY.get(type(node.op))
+            if operator:
+                return f'({left} {operator} {right})'
+            if isinstance(node.op, ast.Pow):
+                return f'std::pow({left}, {right})'
+            if isinstance(node.op, ast.Mod):
+                return f'pythonMod({left}, {right})'
+            if isinstance(node.op, ast.FloorDiv):
+                return f'std::floor({left} / {right})'
+            raise self.error(node, 'unsupported operator')
+        if isinstance(node, ast.UnaryOp):
+            operand = self.expression(node.operand)
+            if isinstance(node.op, ast.USub):
+                return f'(-{operand})'
+            if isinstance(node.op, ast.UAdd):
+                return operand
+            if isinstance(node.op, ast.Not):
+                return f'({self.condition(node)} ? 1.0 : 0.0)'
+            raise self.error(node, 'unsupported operator')
+        if isinstance(node, (ast.BoolOp, ast.Compare)):
+            return f'({self.condition(node)} ? 1.0 : 0.0)'
+        if isinstance(node, ast.IfExp):
+            return (f'({self.condition(node.test)} ? '
+                    f'{self.expression(node.body)} : '
+                    f'{self.expression(node.orelse)})')
+        if isinstance(node, ast.Call):
+            return self.call(node)
+        raise self.error(node,
+                         f'unsupported expression {type(node).__name__}')
+
+    def name(self, node) -> str:
+        if node.id in self.locals:
+            return f'v_{node.id}'
+        if node.id == self.perception:
+            raise self.error(node, 'read the fields of the perception')
+        if node.id in ('True', 'False'):
+            return _literal(node.id == 'True')
+        value = self.constants.get(node.id)
+        if isinstance(value, (int, float)):
+            return _literal(value)
+        raise self.error(node, f'unknown name {node.id}')
+
+    def attribute(self, node) -> str:
+        target = node.value
+        if isinstance(target, ast.Name) and target.id == self.perception:
+            if node.attr not in _FIELDS:
+                raise self.error(node, f'the perception has no {node.attr}')
+            if node.attr == 'nearby_turtles':
+                return 'static_cast<double>(p.nearbyTurtles)'
+            return f'p.{node.attr}'
+        if self.is_math(target) and node.attr in _MATH_CONSTANTS:
+            return _literal(_MATH_CONSTANTS[node.attr])
+        raise self.error(node, 'unsupported attribute')
+
+    def is_math(self, node) -> bool:
+        return (isinstance(node, ast.Name) and node.id not in self.locals
+                and self.constants.get(node.id) is math)
+
+    def call(self, node) -> str:
+        if node.keywords:
+            raise self.error(node, 'no keyword arguments')
+        if self.is_pheromone_call(node):
+            name = node.args[0].value
+            return f'pheromones[{self.pheromones.index(name)}]'
+        function = node.func
+        arguments = [self.expression(a) for a in node.args]
+        if isinstance(function, ast.Attribute) and self.is_math(function.value):
+            if function.attr not in _MATH_FUNCTIONS:
+                raise self.error(node, f'unsupported math.{function.attr}')
+            return f'{_MATH_FUNCTIONS[function.attr]}({", ".join(arguments)})'
+        if isinstance(function, ast.Name):
+            target = self.constants.get(function.id)
+            if function.id == 'abs' and len(arguments) == 1:
+                return f'std::fabs({arguments[0]})'
+            if function.id in ('min', 'max') and len(arguments) >= 2:
+                result = arguments[0]
+                for argument in arguments[1:]:
+                    result = f'std::f{function.id}({result}, {argument})'
+                return result
+            if target is uniform and len(arguments) == 2:
+                return (f'({arguments[0]} + ({arguments[1]} - {arguments[0]}) '
+                        f'* random.next())')
+            if target is random and not arguments:
+                return 'random.next()'
+        raise self.error(node, 'unsupported call')
+
+    def is_pheromone_call(self, node) -> bool:
+        function = node.func
+        if not (isinstance(function, ast.Attribute)
+                and isinstance(function.value, ast.Name)
+                and function.value.id == self.perception
+                and function.attr == 'pheromone'):
+            return False
+        if (len(node.args) != 1 or not isinstance(node.args[0], ast.Constant)
+                or not isinstance(node.args[0].value, str)):
+            raise self.error(node, 'p.pheromone() takes a name')
+        if node.args[0].value not in self.pheromones:
+            raise self.error(node, f'undeclared pheromone '
+                                   f'{node.args[0].value}')
+        return True
+
+
+_PRELUDE = """\
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace {
+
+// LogoAgent::BatchPerception::Row, ABI version %(abi)d
+struct Row {
+  double x;
+  double y;
+  double heading;
+  double speed;
+  std::uint32_t nearbyTurtles;
+};
+static_assert(sizeof(Row) == 40, "the rows of ABI version %(abi)d");
+
+std::uint64_t mix(std::uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+// SplitMix64, one stream per step and row
+struct Random {
+  std::uint64_t state;
+  double next() {
+    state += 0x9e3779b97f4a7c15ull;
+    return static_cast<double>(mix(state) >> 11) * 0x1.0p-53;
+  }
+};
+
+double pythonMod(double a, double b) {
+  const double r = std::fmod(a, b);
+  return r != 0.0 && ((r < 0.0) != (b < 0.0)) ? r + b : r;
+}
+"""
+
+_ENTRY = """\
+} // namespace
+
+extern "C" int similar2logo_kernel_abi_version() { return %(abi)d; }
+
+extern "C" void similar2logo_kernel(const Row *rows, std::size_t count,
+                                    const double *pheromones,
+                                    std::size_t pheromoneCount, long step,
+                                    double *headingDeltas,
+                                    double *speedDeltas) {
+  for (std::size_t i = 0; i < count; ++i) {
+    Random random{mix(static_cast<std::uint64_t>(step) *
+                          0x9e3779b97f4a7c15ull ^
+                      static_cast<std::uint64_t>(i))};
+    decide(rows[i], pheromones + i * pheromoneCount, random,
+           headingDeltas[i], speedDeltas[i]);
+  }
+}
+"""
+
+
+def generate_source(function: Callable,
+                    pheromones: Sequence[str] = ()) -> str:
+    """
+    Translates a behavior into the C++ source of its kernel.
+
+    Raises:
+        DSLCompileError: If the behavior is outside the supported subset
+    """
+    translator = _Translator(function, pheromones)
+    body = translator.body()
+    lines = [f'// Generated by similar2logo.dsl.compiler from '
+             f'{function.__module__}.{function.__qualname__}, pheromones '
+             f'{list(pheromones)}',
+             _PRELUDE % {'abi': ABI_VERSION},
+             'void decide(const Row &p, const double *pheromones, '
+             'Random &random,',
+             '            double &headingDelta, double &speedDelta) {',
+             '  (void)pheromones;',
+             '  (void)random;']
+    lines += ['  ' + line for line in body]
+    lines += ['}', '', _ENTRY % {'abi': ABI_VERSION}]
+    return '\n'.join(lines)
+
+
+def default_cache_dir() -> Path:
+    """The cache of the libraries, SIMILAR2LOGO_DSL_CACHE if set."""
+    directory = os.environ.get('SIMILAR2LOGO_DSL_CACHE')
+    if directory:
+        return Path(directory)
+    return Path(os.environ.get('XDG_CACHE_HOME', Path.home() / '.cache')) \
+        / 'similar2logo' / 'dsl'
+
+
+def find_compiler() -> Optional[str]:
+    """The C++ compiler: CXX if set, else c++, g++ or clang++ on the path."""
+    compiler = os.environ.get('CXX')
+    if compiler:
+        return compiler
+    for name in ('c++', 'g++', 'clang++'):
+        found = shutil.which(name)
+        if found:
+            return found
+    return None
+
+
+@dataclass(frozen=True)
+class CompiledBehavior:
+    """The library of a behavior, built or found in the cache."""
+    name: str
+    path: Path
+    pheromones: Tuple[str, ...]
+    source: str = field(repr=False)
+    cached: bool = False
+
+    def make_decision_model(self, level, cpp_module=None):
+        """
+        Loads the library into a batch decision model of the C++ engine, to
+        be shared by the turtles and set as the batch decision hook.
+        """
+        if cpp_module is None:
+            from similar2logo import _logo_cpp as cpp_module
+        library = cpp_module.CompiledBehaviorLibrary(str(self.path))
+        return cpp_module.make_compiled_behavior(level, library,
+                                                 list(self.pheromones))
+
+
+class NativeBehavior:
+    """
+    A behavior of the supported subset, compiled on the first compile().
+
+    Called with a Perception, it runs the function in Python.
+    """
+
+    def __init__(self, function: Callable, pheromones: Sequence[str] = ()):
+        self.function = function
+        self.pheromones = tuple(pheromones)
+        self.name = function.__name__
+        self._compiled: Dict[Tuple, CompiledBehavior] = {}
+        # Fail when the model is written rather than when it runs
+        self.source = generate_source(function, self.pheromones)
+
+    def __call__(self, perception: Perception) -> Tuple[float, float]:
+        result = self.function(perception)
+        if result is None:
+            return 0.0, 0.0
+        if isinstance(result, tuple):
+            return float(result[0]), float(result[1])
+        return float(result), 0.0
+
+    def compile(self, cache_dir=None, compiler: Optional[str] = None,
+                ) -> CompiledBehavior:
+        """
+        Builds the library of the behavior, unless the cache holds it.
+
+        Raises:
+            RuntimeError: If no compiler is found or the build fails
+        """
+        compiler = compiler or find_compiler()
+        if compiler is None:
+            raise RuntimeError('no C++ compiler found; set CXX')
+        cache_dir = Path(cache_dir) if cache_dir else default_cache_dir()
+        key = (str(cache_dir), compiler)
+        if key in self._compiled:
+            return self._compiled[key]
+        digest = hashlib.sha256('\0'.join(
+            [self.source, compiler, ' '.join(CXX_FLAGS),
+             str(ABI_VERSION)]).encode()).hexdigest()[:20]
+        path = cache_dir / f'{self.name}-{digest}.so'
+        cached = path.exists()
+        if not cached:
+            cache_dir.mkdir(parents=True, exist_ok=True)
+            with tempfile.TemporaryDirectory(dir=cache_dir) as build:
+                source = Path(build) / f'{self.name}.cpp'
+                source.write_text(self.source)
+                output = Path(build) / path.name
+                process = subprocess.run(
+                    [compiler, *CXX_FLAGS, str(source), '-o', str(output)],
+                    capture_output=True, text=True)
+                if process.returncode != 0:
+                    raise RuntimeError(
+                        f'compiling {self.name} failed:\n{process.stderr}')
+                # Atomic, for the builds of the same behavior in parallel
+                os.replace(output, path)
+        compiled = CompiledBehavior(self.name, path, self.pheromones,
+                                    self.source, cached)
+        self._compiled[key] = compiled
+        return compiled
+
+
+def native_behavior(function: Optional[Callable] = None, *,
+                    pheromones: Sequence[str] = ()):
+    """
+    Declares a behavior of the supported subset, as @native_behavior or
+    @native_behavior(pheromones=[...]).
+
+    Raises:
+        DSLCompileError: If the behavior is outside the subset
+    """
+    if function is not None:
+        return NativeBehavior(function, pheromones)
+    return lambda f: NativeBehavior(f, pheromones)
+
+
+__all__ = [
+    'ABI_VERSION',
+    'CompiledBehavior',
+    'DSLCompileError',
+    'NativeBehavior',
+    'Perception',
+    'generate_source',
+    'native_behavior',
+    'random',
+    'uniform',
+]
@@ -396,11 +396,12 @@ class LogoSimulation:
         
         # Spatial indexing for efficient neighbor queries
         # Cell size should be >= typical perception radius
-        from .spatial import SpatialHashGrid
-        self.spatial_index = SpatialHashGrid(
+        from .spatial import make_spatial_hash_grid
+        self.spatial_index = make_spatial_hash_grid(
             cell_size=20.0,  # Adjust based on typical perception radius
             width=environment.width,
-            height=environment.height
+            height=environment.height,
+            toroidal=getattr(environment, 'toroidal', False)
         )
         
         # Probe system for observation and timing control
@@ -2,26 +2,48 @@
 Bridge module to use multithreading/multiprocessing for parallel agent decisions.
 
 This provides both threading and process-based parallel executors:
-- Threading: Low overhead but limited by Python's GIL for CPU-bound tasks
+- Threading: Low overhead but limited by Python's GIL for CPU-bound tasks,
+  except on a free-threaded interpreter (e.g. python3.14t), where the
+  threads decide in parallel
 - Process: True parallelism but higher overhead due to process creation
+- Shared memory: persistent processes deciding for the turtles in place,
+  on columns kept in a POSIX shared memory segment by the C++ module
 
 For maximum performance with no GIL limitations, use the C++ MultiThreadedSimulationEngine.
 """
 
 from typing import List, Callable, Any
+import itertools
 import multiprocessing
+import os
+import sys
+import traceback
 from concurrent.futures import ThreadPoolExecutor, ProcessPoolExecutor
 
 
+def gil_enabled():
+    """
+    Tell whether the interpreter runs with the GIL.
+
+    The free-threaded builds (e.g. python3.14t) run without it, unless a
+    module that does not support them is imported; the C++ modules do.
+    """
+    is_gil_enabled = getattr(sys, '_is_gil_enabled', None)
+    return is_gil_enabled() if is_gil_enabled else True
+
+
 class ThreadedDecisionExecutor:
     """
     Threaded executor for agent decision-making.
     
-    Note: Due to Python's GIL, this won't provide true parallelism for
-    CPU-bound tasks. However, it provides the correct architecture and
-    can benefit I/O-bound operations.
+    Note: With the GIL, this won't provide true parallelism for CPU-bound
+    tasks. However, it provides the correct architecture and can benefit
+    I/O-bound operations. On a free-threaded interpreter, the threads
+    decide in parallel, the C++ environments and spatial indices locking
+    themselves against the concurrent calls.
     
-    For true parallelism, use ProcessDecisionExecutor or the C++ engine.
+    Otherwise, for true parallelism, use ProcessDecisionExecutor or the C++
+    engine.
     """
     
     def __init__(self, num_workers=None):
@@ -29,10 +51,13 @@ class ThreadedDecisionExecutor:
         Initialize the threaded executor.
         
         Args:
-            num_workers: Number of worker threads (None = CPU count * 2)
+            num_workers: Number of worker threads (None = CPU count * 2, or
+                the CPU count without the GIL)
         """
         if num_workers is None:
-            num_workers = multiprocessing.cpu_count() * 2
+            num_workers = multiprocessing.cpu_count()
+            if gil_enabled():
+                num_workers *= 2
         self.executor = ThreadPoolExecutor(max_workers=num_workers)
         self.num_workers = num_workers
     
@@ -118,17 +143,206 @@ def _process_decision_worker(task):
     return turtle.decide(perception)
 
 
+class SharedMemoryDecisionExecutor:
+    """
+    Process-based executor deciding for the turtles in place.
+
+    The state of the turtles (x, y, heading, speed), the pheromone values at
+    their location and the decided heading and speed deltas are columns of a
+    POSIX shared memory segment (_core.environment.SharedDecisionBuffer),
+    which persistent worker processes map once. Each step, the workers only
+    receive the step index and a range of turtles, and answer once their
+    deltas are written: nothing is pickled but these indices.
+
+    The decision function is vectorized, as the native batch decision
+    models: it is called in the workers as
+    ``decide(columns, pheromones, heading_deltas, speed_deltas)`` where
+    ``columns`` maps 'x', 'y', 'heading' and 'speed' to the arrays of the
+    range of turtles, ``pheromones`` is their (count, len(pheromones))
+    array, and the two delta arrays are to be filled in place. It must be
+    picklable (a module-level function) with the 'spawn' start method.
+
+    Note: requires the C++ module (_core) and NumPy.
+    """
+
+    _names = itertools.count()
+
+    def __init__(self, decide, num_workers=None, capacity=1024,
+                 pheromones=()):
+        """
+        Initialize the executor and start its workers.
+
+        Args:
+            decide: The vectorized decision function (see the class).
+            num_workers: Number of worker processes (None = CPU count)
+            capacity: The number of turtles the segment holds first; it
+                grows as needed.
+            pheromones: The identifiers of the pheromones sampled, in the
+                order of the columns of the pheromone array.
+        """
+        from . import _core
+        self._buffer_class = _core.environment.SharedDecisionBuffer
+        if num_workers is None:
+            num_workers = multiprocessing.cpu_count()
+        self.num_workers = num_workers
+        self.pheromones = tuple(pheromones)
+        self.buffer = None
+        self._step = 0
+        self._create_buffer(max(1, capacity))
+        self._workers = []
+        for _ in range(num_workers):
+            connection, worker_connection = multiprocessing.Pipe()
+            process = multiprocessing.Process(
+                target=_shared_memory_worker,
+                args=(self.buffer.name, decide, worker_connection),
+                daemon=True)
+            process.start()
+            worker_connection.close()
+            self._workers.append((process, connection))
+
+    def _create_buffer(self, capacity):
+        name = f"/similar2logo_{os.getpid()}_{next(self._names)}"
+        self.buffer = self._buffer_class.create(
+            name, capacity, len(self.pheromones))
+
+    def _reserve(self, count):
+        """Grows the segment to hold count turtles, moving the workers."""
+        if count <= self.buffer.capacity:
+            return
+        self._create_buffer(max(count, 2 * self.buffer.capacity))
+        for _, connection in self._workers:
+            connection.send(('attach', self.buffer.name))
+
+    def run_step(self, count=None, step=None):
+        """
+        Decide for the count first turtles of the segment.
+
+        The columns must be filled, and the deltas cleared, beforehand: by
+        SharedDecisionBuffer.publish() for a C++ environment, as
+        map_decisions() does for Python turtles otherwise.
+
+        Args:
+            count: The number of turtles (None = the count of the segment)
+            step: The index of the step sent to the workers (None = the
+                step of the segment)
+
+        Raises:
+            RuntimeError: If a decision failed in a worker.
+        """
+        count = self.buffer.count if count is None else count
+        step = self.buffer.step if step is None else step
+        chunk = -(-count // self.num_workers) if count else 0
+        busy = []
+        for index, (_, connection) in enumerate(self._workers):
+            begin = index * chunk
+            end = min(count, begin + chunk)
+            if begin < end:
+                connection.send(('decide', step, begin, end))
+                busy.append(connection)
+        errors = [error for error in (c.recv() for c in busy) if error]
+        if errors:
+            raise RuntimeError(
+                "A decision failed in a worker process:\n" + errors[0])
+
+    def map_decisions(self, turtles, perceptions):
+        """
+        Execute decisions for all turtles in the worker processes.
+
+        Args:
+            turtles: List of turtle agents
+            perceptions: Dictionary mapping turtles to their perceptions
+
+        Returns:
+            List of influences from all turtles
+        """
+        count = len(turtles)
+        self._reserve(count)
+        buffer = self.buffer
+        buffer.count = count
+        buffer.x[:count] = [turtle.position.x for turtle in turtles]
+        buffer.y[:count] = [turtle.position.y for turtle in turtles]
+        buffer.heading[:count] = [turtle.heading for turtle in turtles]
+        buffer.speed[:count] = [turtle.speed for turtle in turtles]
+        if self.pheromones:
+            values = buffer.pheromones
+            for i, turtle in enumerate(turtles):
+                sensed = perceptions[turtle].get('pheromones', {})
+                values[i] = [sensed.get(p, 0.0) for p in self.pheromones]
+        buffer.heading_deltas[:count] = 0.0
+        buffer.speed_deltas[:count] = 0.0
+        self._step += 1
+        self.run_step(count, self._step)
+
+        results = []
+        heading_deltas = buffer.heading_deltas[:count].tolist()
+        speed_deltas = buffer.speed_deltas[:count].tolist()
+        for turtle, dh, ds in zip(turtles, heading_deltas, speed_deltas):
+            turtle_influences = []
+            if dh:
+                turtle_influences.append(turtle.influence_turn(dh))
+            if ds:
+                turtle_influences.append(turtle.influence_change_speed(ds))
+            if turtle_influences:
+                results.append(turtle_influences)
+        return results
 
-def create_executor(backend='thread', num_workers=None):
+    def shutdown(self):
+        """Stop the workers and remove the shared memory segment."""
+        for process, connection in self._workers:
+            try:
+                connection.send(None)
+            except (BrokenPipeError, OSError):
+                pass
+            connection.close()
+        for process, _ in self._workers:
+            process.join()
+        self._workers = []
+        self.buffer = None
+
+
+def _shared_memory_worker(name, decide, connection):
+    """Worker loop of the SharedMemoryDecisionExecutor."""
+    from . import _core
+    buffer = _core.environment.SharedDecisionBuffer.attach(name)
+    while True:
+        message = connection.recv()
+        if message is None:
+            break
+        if message[0] == 'attach':
+            buffer = _core.environment.SharedDecisionBuffer.attach(message[1])
+            continue
+        _, _step, begin, end = message
+        try:
+            columns = {
+                'x': buffer.x[begin:end],
+                'y': buffer.y[begin:end],
+                'heading': buffer.heading[begin:end],
+                'speed': buffer.speed[begin:end],
+            }
+            decide(columns, buffer.pheromones[begin:end],
+                   buffer.heading_deltas[begin:end],
+                   buffer.speed_deltas[begin:end])
+            connection.send(None)
+        except Exception:
+            connection.send(traceback.format_exc())
+    connection.close()
+
+
+def create_executor(backend='thread', num_workers=None, **options):
     """
     Factory function to create an appropriate executor.
     
     Args:
-        backend: 'thread', 'process', or None
-                - 'thread': Uses threading (limited by GIL for CPU-bound tasks)
+        backend: 'thread', 'process', 'shared_memory', or None
+                - 'thread': Uses threading (limited by GIL for CPU-bound tasks,
+                  parallel on a free-threaded interpreter)
                 - 'process': Uses multiprocessing (true parallelism, higher overhead)
+                - 'shared_memory': Uses persistent processes deciding in
+                  place on shared memory (needs the C++ module)
                 - None: Sequential execution (no parallelism)
         num_workers: Number of workers (None = auto-detect)
+        **options: The other arguments of the executor, such as the
+            decide function of SharedMemoryDecisionExecutor
         
     Returns:
         Executor instance or None
@@ -144,6 +358,10 @@ def create_executor(backend='thread', num_workers=None):
         # Multiprocessing (true parallelism for CPU-bound tasks)
         executor = create_executor('process', num_workers=4)
         
+        # Shared memory (vectorized decisions, nothing pickled per step)
+        executor = create_executor('shared_memory', decide=wander,
+                                   pheromones=('trail',))
+        
         # Sequential (no parallelism)
         executor = create_executor(None)
     """
@@ -151,10 +369,12 @@ def create_executor(backend='thread', num_workers=None):
         return ThreadedDecisionExecutor(num_workers)
     elif backend == 'process':
         return ProcessDecisionExecutor(num_workers)
+    elif backend == 'shared_memory':
+        return SharedMemoryDecisionExecutor(num_workers=num_workers, **options)
     elif backend is None:
         return None
     else:
         raise ValueError(
             f"Unknown backend: {backend}. "
-            f"Supported: 'thread', 'process', or None"
+            f"Supported: 'thread', 'process', 'shared_memory', or None"
         )
@@ -59,7 +59,10 @@ class RealTimeMatcherProbe(IProbe):
     
     This ensures the simulation runs at a specific speed relative to real time.
     Useful for visualization and interactive simulations.
-    
+
+    The simulations of the C++ engine are paced natively instead, see
+    CppLogoSimulation.set_real_time_pacing().
+
     Args:
         acceleration_factor: Speed multiplier relative to real time.
             - 1.0 = real time (1 sim second = 1 real second)
@@ -106,3 +106,106 @@ class SpatialHashGrid:
         self.clear()
         for obj in objects:
             self.insert(obj, obj.position.x, obj.position.y)
+
+
+class NativeSpatialHashGrid:
+    """
+    SpatialHashGrid backed by the C++ index of the _logo_cpp module.
+
+    It has the same API, plus toroidal distances and a bulk rebuild from
+    coordinate arrays; the objects are mapped to the integer keys of the
+    C++ index, and a query looks at the coordinates given when the objects
+    were inserted or last updated.
+
+    Args:
+        cell_size: Size of each grid cell (should be >= typical perception radius)
+        width: Width of the space
+        height: Height of the space
+        toroidal: Whether the space wraps around
+    """
+
+    def __init__(self, cell_size: float, width: float, height: float,
+                 toroidal: bool = False):
+        from similar2logo import _logo_cpp
+        self.cell_size = cell_size
+        self.width = width
+        self.height = height
+        self.toroidal = toroidal
+        self._grid = _logo_cpp.SpatialHashGrid(cell_size, width, height,
+                                               toroidal)
+        self._objects = []  # the object of each key
+        self._keys = {}  # the key of each object, by id
+
+    def clear(self):
+        """Clear all objects from the grid."""
+        self._grid.clear()
+        self._objects = []
+        self._keys.clear()
+
+    def insert(self, obj, x: float, y: float):
+        """Insert an object at the given position."""
+        key = self._keys.get(id(obj))
+        if key is None:
+            key = len(self._objects)
+            self._objects.append(obj)
+            self._keys[id(obj)] = key
+        self._grid.insert(key, x, y)
+
+    def update(self, obj, x: float, y: float):
+        """Update an object's position."""
+        self.insert(obj, x, y)
+
+    def remove(self, obj):
+        """Remove an object from the grid, if it is in."""
+        key = self._keys.pop(id(obj), None)
+        if key is not None:
+            self._grid.remove(key)
+            self._objects[key] = None
+
+    def query_radius(self, x: float, y: float, radius: float, exclude=None) -> List:
+        """
+        Query all objects within radius of the given position.
+
+        Returns:
+            List of (object, distance) tuples
+        """
+        excluded = -1
+        if exclude is not None:
+            excluded = self._keys.get(id(exclude), -1)
+        keys, distances = self._grid.query_radius(x, y, radius, excluded)
+        objects = self._objects
+        return [(objects[key], distance)
+                for key, distance in zip(keys.tolist(), distances.tolist())]
+
+    def rebuild(self, objects):
+        """Rebuild the entire grid from a list of objects."""
+        objects = list(objects)
+        self.rebuild_arrays([obj.position.x for obj in objects],
+                            [obj.position.y for obj in objects], objects)
+
+    def rebuild_arrays(self, xs, ys, objects=None):
+        """
+        Rebuild the entire grid from coordinate arrays.
+
+        Args:
+            xs: x coordinates, a NumPy array or a sequence
+            ys: y coordinates, of the same length
+            objects: The object at each index, returned by the queries;
+                the indices themselves by default
+        """
+        self._grid.rebuild(xs, ys)
+        self._objects = (list(objects) if objects is not None
+                         else list(range(len(xs))))
+        self._keys = {id(obj): key for key, obj in enumerate(self._objects)}
+
+
+def make_spatial_hash_grid(cell_size: float, width: float, height: float,
+                           toroidal: bool = False):
+    """
+    Make the C++ spatial hash grid if the _logo_cpp module is built, the
+    pure-Python SpatialHashGrid otherwise.
+    """
+    try:
+        return NativeSpatialHashGrid(cell_size, width, height, toroidal)
+    except ImportError:
+        return SpatialHashGrid(cell_size, width, height)
@@ -0,0 +1,77 @@
+"""
+Binary frames of the web view, encoded by the C++ FrameEncoder.
+
+A frame holds the quantized positions and headings of the turtles, the
+palette indices of their colors and the pheromone tiles that changed since
+the previous frame sent to the same client; see
+cpp/similar2logo/include/kernel/tools/FrameEncoder.h for the layout, which
+the page of template.py decodes.
+"""
+
+import numpy as np
+
+
+class FrameStreamer:
+    """
+    Encodes the frames of a simulation for one WebSocket client.
+
+    Args:
+        simulation: LogoSimulation instance
+        max_pheromone: The pheromone value drawn at full intensity
+        tile_size: The side of the pheromone tiles, in cells
+
+    Raises:
+        ImportError: If the C++ module is not built.
+    """
+
+    def __init__(self, simulation, max_pheromone=50.0, tile_size=16):
+        from similar2logo import _core
+        environment = simulation.environment
+        self.simulation = simulation
+        self._encoder = _core.FrameEncoder(
+            environment.width, environment.height, tile_size)
+        self._max_pheromone = max_pheromone
+        self._pheromones = []
+        self._add_new_pheromones()
+
+    def _add_new_pheromones(self):
+        # a new grid makes the next frame a keyframe
+        environment = self.simulation.environment
+        for identifier in getattr(environment, 'pheromones', {}):
+            if identifier not in self._pheromones:
+                self._encoder.add_pheromone(
+                    identifier, environment.width, environment.height,
+                    self._max_pheromone)
+                self._pheromones.append(identifier)
+
+    def request_keyframe(self):
+        """Make the next frame a keyframe, as after a reconnection."""
+        self._encoder.request_keyframe()
+
+    def encode(self) -> bytes:
+        """Encode the current state of the simulation."""
+        self._add_new_pheromones()
+        simulation = self.simulation
+        turtles = simulation.turtles
+        count = len(turtles)
+        x = np.fromiter((t.position.x for t in turtles), np.float64, count)
+        y = np.fromiter((t.position.y for t in turtles), np.float64, count)
+        heading = np.fromiter((t.heading for t in turtles), np.float64, count)
+        color_index = self._encoder.color_index
+        colors = np.fromiter((color_index(t.color) for t in turtles),
+                             np.uint8, count)
+        return self._encoder.encode(simulation.current_step, x, y, heading,
+                                    colors, self._pheromone_grids())
+
+    def _pheromone_grids(self):
+        environment = self.simulation.environment
+        grids = []
+        for identifier in self._pheromones:
+            if hasattr(environment, 'get_pheromone_array'):
+                handle = environment.find_pheromone(identifier)
+                grids.append(environment.get_pheromone_array(handle))
+            else:
+                # the rows of the pure-Python environment
+                grids.append(np.asarray(
+                    environment.pheromone_grids[identifier], np.float64))
+        return grids
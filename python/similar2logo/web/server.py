@@ -19,6 +19,9 @@ class WebSimulation:
     Args:
         simulation: LogoSimulation instance
         update_rate: Updates per second (default: 30)
+        frame_format: 'json' to stream the state as JSON, or 'binary' to
+            stream the compact frames of web/frames.py (needs the C++
+            module; falls back to JSON without it)
     
     Examples:
         >>> from similar2logo import LogoSimulation, Environment
@@ -30,9 +33,13 @@ class WebSimulation:
         >>> web_sim.start_server(port=8080)
     """
     
-    def __init__(self, simulation, update_rate=30, initial_speed=10.0):
+    def __init__(self, simulation, update_rate=30, initial_speed=10.0,
+                 frame_format='json'):
+        if frame_format not in ('json', 'binary'):
+            raise ValueError(f"Unknown frame format: {frame_format}")
         self.simulation = simulation
         self.update_rate = update_rate
+        self.frame_format = frame_format
         self.running = False
         self.paused = False
         self.sim_thread = None
@@ -314,18 +321,37 @@ class WebSimulation:
         async def websocket_endpoint(websocket: WebSocket):
             await websocket.accept()
             self.connected_clients.append(websocket)
+            streamer = self._make_streamer()
             
             try:
                 while True:
                     # Send state updates
                     if not self.paused:
-                        state = self.simulation.get_state()
-                        await websocket.send_json(state)
+                        if streamer:
+                            # encoded off the event loop, the C++ encoder
+                            # releasing the GIL
+                            frame = await asyncio.to_thread(streamer.encode)
+                            await websocket.send_bytes(frame)
+                        else:
+                            state = self.simulation.get_state()
+                            await websocket.send_json(state)
                     
                     await asyncio.sleep(1.0 / self.update_rate)
             except WebSocketDisconnect:
                 self.connected_clients.remove(websocket)
     
+    def _make_streamer(self):
+        """Make the frame encoder of a new client, None for JSON."""
+        if self.frame_format != 'binary':
+            return None
+        from .frames import FrameStreamer
+        try:
+            return FrameStreamer(self.simulation)
+        except ImportError:
+            print("C++ module not available, streaming JSON frames")
+            self.frame_format = 'json'
+            return None
+    
     def _simulation_loop(self):
         """Run simulation in background thread."""
         while self.running:
@@ -438,10 +438,165 @@ HTML_TEMPLATE = """
         let fps = 0;
         let parameters = {};
         
+        // Binary frames (see web/frames.py): the palette and the pheromone
+        // grids persist across frames, the frames only carrying changes
+        const FRAME_MAGIC = 0x464c3253;
+        const textDecoder = new TextDecoder();
+        let framePalette = [];
+        let frameGrids = [];
+
+        function align4(offset) {
+            return (offset + 3) & ~3;
+        }
+
+        function decodeFrame(buffer) {
+            const view = new DataView(buffer);
+            if (view.getUint32(0, true) !== FRAME_MAGIC) {
+                throw new Error('Not a similar2logo frame');
+            }
+            const flags = view.getUint8(5);
+            const pheromoneCount = view.getUint16(6, true);
+            const frame = {
+                step: view.getUint32(8, true),
+                count: view.getUint32(12, true),
+                width: view.getFloat32(16, true),
+                height: view.getFloat32(20, true)
+            };
+            let offset = 24;
+            if (flags & 1) {
+                const entries = view.getUint16(offset, true);
+                offset += 2;
+                framePalette = [];
+                for (let i = 0; i < entries; i++) {
+                    const length = view.getUint8(offset);
+                    framePalette.push(textDecoder.decode(
+                        new Uint8Array(buffer, offset + 1, length)));
+                    offset += 1 + length;
+                }
+                offset = align4(offset);
+            }
+            const n = frame.count;
+            frame.x = new Uint16Array(buffer, offset, n);
+            frame.y = new Uint16Array(buffer, offset + 2 * n, n);
+            frame.headings = new Uint8Array(buffer, offset + 4 * n, n);
+            frame.colors = new Uint8Array(buffer, offset + 5 * n, n);
+            offset = align4(offset + 6 * n);
+            if (flags & 2) {
+                frameGrids = [];
+            }
+            for (let k = 0; k < pheromoneCount; k++) {
+                if (flags & 2) {
+                    const length = view.getUint8(offset);
+                    const id = textDecoder.decode(
+                        new Uint8Array(buffer, offset + 1, length));
+                    offset = align4(offset + 1 + length);
+                    const columns = view.getUint16(offset, true);
+                    const rows = view.getUint16(offset + 2, true);
+                    frameGrids.push({
+                        id: id,
+                        columns: columns,
+                        rows: rows,
+                        maxValue: view.getFloat32(offset + 4, true),
+                        tileSize: view.getUint16(offset + 8, true),
+                        values: new Uint8Array(columns * rows)
+                    });
+                    offset += 12;
+                }
+                const grid = frameGrids[k];
+                const size = grid.tileSize;
+                const tileColumns = Math.ceil(grid.columns / size);
+                const tiles = view.getUint32(offset, true);
+                offset += 4;
+                for (let t = 0; t < tiles; t++) {
+                    const index = view.getUint32(offset, true);
+                    const tile = new Uint8Array(buffer, offset + 4, size * size);
+                    const x0 = (index % tileColumns) * size;
+                    const y0 = Math.floor(index / tileColumns) * size;
+                    const w = Math.min(size, grid.columns - x0);
+                    const h = Math.min(size, grid.rows - y0);
+                    for (let j = 0; j < h; j++) {
+                        grid.values.set(tile.subarray(j * size, j * size + w),
+                                        (y0 + j) * grid.columns + x0);
+                    }
+                    offset = align4(offset + 4 + size * size);
+                }
+            }
+            return frame;
+        }
+
+        function renderFrame(frame) {
+            ctx.fillStyle = '#ffffff';
+            ctx.fillRect(0, 0, canvas.width, canvas.height);
+            const scaleX = canvas.width / frame.width;
+            const scaleY = canvas.height / frame.height;
+
+            for (const grid of frameGrids) {
+                let r = 0, g = 0, b = 255;
+                if (grid.id.includes('food')) { r = 0; g = 255; b = 0; }
+                else if (grid.id.includes('home') || grid.id.includes('nest')) { r = 255; g = 0; b = 0; }
+                // the cells above 0.1, as the JSON view
+                const threshold = 0.1 / grid.maxValue * 255;
+                for (let y = 0; y < grid.rows; y++) {
+                    for (let x = 0; x < grid.columns; x++) {
+                        const q = grid.values[y * grid.columns + x];
+                        if (q > threshold) {
+                            const alpha = Math.min(0.8, q / 255 * grid.maxValue / 50.0);
+                            ctx.fillStyle = `rgba(${r}, ${g}, ${b}, ${alpha})`;
+                            ctx.fillRect(x * scaleX, y * scaleY, scaleX, scaleY);
+                        }
+                    }
+                }
+            }
+
+            // Many turtles are drawn as squares, by color
+            const xScale = canvas.width / 65535;
+            const yScale = canvas.height / 65535;
+            const detailed = frame.count <= 2000;
+            for (let c = 0; c < framePalette.length; c++) {
+                ctx.fillStyle = framePalette[c];
+                ctx.strokeStyle = framePalette[c];
+                ctx.lineWidth = 2;
+                for (let i = 0; i < frame.count; i++) {
+                    if (frame.colors[i] !== c) {
+                        continue;
+                    }
+                    const x = frame.x[i] * xScale;
+                    const y = frame.y[i] * yScale;
+                    if (!detailed) {
+                        ctx.fillRect(x - 1, y - 1, 2, 2);
+                        continue;
+                    }
+                    ctx.beginPath();
+                    ctx.arc(x, y, 5, 0, 2 * Math.PI);
+                    ctx.fill();
+                    const heading = frame.headings[i] / 256 * 2 * Math.PI;
+                    ctx.beginPath();
+                    ctx.moveTo(x, y);
+                    ctx.lineTo(x + Math.sin(heading) * 10, y - Math.cos(heading) * 10);
+                    ctx.stroke();
+                }
+            }
+
+            frameCount++;
+            const now = Date.now();
+            if (now - lastFrameTime >= 1000) {
+                fps = frameCount;
+                frameCount = 0;
+                lastFrameTime = now;
+            }
+        }
+
         function connectWebSocket() {
             ws = new WebSocket('ws://' + window.location.host + '/ws');
+            ws.binaryType = 'arraybuffer';
             ws.onmessage = function(event) {
                 try {
+                    if (event.data instanceof ArrayBuffer) {
+                        const frame = decodeFrame(event.data);
+                        renderFrame(frame);
+                        updateStats({ step: frame.step, num_turtles: frame.count });
+                        return;
+                    }
                     const state = JSON.parse(event.data);
                     console.log('Received state with', state.marks ? state.marks.length : 0, 'marks');
                     render(state);
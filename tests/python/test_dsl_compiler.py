@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+"""
+DSL Compiler Tests
+
+Test the translation of native behaviors to C++ kernels, and the kernels
+against the same behaviors run in Python
+"""
+
+import ctypes
+import math
+import os
+import sys
+import tempfile
+import unittest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..', '..', 'python'))
+
+from similar2logo.dsl import (DSLCompileError, NativeBehavior, Perception,
+                              native_behavior, uniform)
+from similar2logo.dsl.compiler import ABI_VERSION, find_compiler
+
+TURN = 0.25
+
+
+def ant(p):
+    """Turns on food, else wanders."""
+    home = p.pheromone('home') * 2
+    if p.pheromone('food') > 0.1 and p.nearby_turtles < 3:
+        return TURN, 0.0
+    elif not p.x > 5:
+        home += 1
+        return -TURN, home
+    return uniform(-0.4, 0.4), max(p.speed, 1, 2) % 3 + math.cos(math.pi)
+
+
+def steer(p):
+    return math.atan2(p.y, p.x) if p.x != 0 else 0.5 * abs(p.heading)
+
+
+class Row(ctypes.Structure):
+    _fields_ = [('x', ctypes.c_double), ('y', ctypes.c_double),
+                ('heading', ctypes.c_double), ('speed', ctypes.c_double),
+                ('nearby_turtles', ctypes.c_uint32)]
+
+
+def run_kernel(compiled, perceptions, step=0):
+    """Runs a compiled kernel over perceptions, as the engine does."""
+    library = ctypes.CDLL(str(compiled.path))
+    count = len(perceptions)
+    rows = (Row * count)(*[Row(p.x, p.y, p.heading, p.speed, p.nearby_turtles)
+                           for p in perceptions])
+    values = [p.pheromone(name) for p in perceptions
+              for name in compiled.pheromones]
+    pheromones = (ctypes.c_double * max(len(values), 1))(*values)
+    heading_deltas = (ctypes.c_double * count)()
+    speed_deltas = (ctypes.c_double * count)()
+    library.similar2logo_kernel(
+        rows, ctypes.c_size_t(count), pheromones,
+        ctypes.c_size_t(len(compiled.pheromones)), ctypes.c_long(step),
+        heading_deltas, speed_deltas)
+    return list(zip(heading_deltas, speed_deltas)), library
+
+
+class TestDSLCompiler(unittest.TestCase):
+    """Test the native behaviors"""
+
+    def test_translation(self):
+        """The subset is translated, the rest is rejected with its line"""
+        behavior = NativeBehavior(ant, pheromones=['food', 'home'])
+        self.assertIn('pheromones[0] > 0.1', behavior.source)
+        self.assertIn('!(p.x > 5.0)', behavior.source)
+        self.assertIn('0.25', behavior.source)
+        self.assertIn('random.next()', behavior.source)
+
+        with self.assertRaises(DSLCompileError):
+            NativeBehavior(ant, pheromones=['food'])
+
+        def looping(p):
+            for i in range(3):
+                pass
+
+        def calling(p):
+            return len(p)
+
+        def storing(p):
+            p.x = 1
+
+        for function in (looping, calling, storing):
+            with self.assertRaises(DSLCompileError) as error:
+                native_behavior(function)
+            self.assertIn(function.__name__, str(error.exception))
+
+    def test_python_fallback(self):
+        """A behavior runs in Python with the same perception"""
+        behavior = native_behavior(pheromones=['food', 'home'])(ant)
+        self.assertEqual(behavior(Perception(pheromones={'food': 1.0})),
+                         (TURN, 0.0))
+        self.assertEqual(behavior(Perception(x=1, pheromones={'home': 0.5})),
+                         (-TURN, 2.0))
+        self.assertEqual(native_behavior(steer)(Perception(heading=-1)),
+                         (0.5, 0.0))
+
+    @unittest.skipIf(find_compiler() is None, "no C++ compiler")
+    def test_compiled_kernel(self):
+        """The kernel decides as the behavior, and is cached by its source"""
+        with tempfile.TemporaryDirectory() as cache:
+            behavior = NativeBehavior(ant, pheromones=['food', 'home'])
+            compiled = behavior.compile(cache_dir=cache)
+            self.assertFalse(compiled.cached)
+            self.assertTrue(compiled.path.exists())
+
+            perceptions = [
+                Perception(x=1, speed=0.5, pheromones={'food': 1.0}),
+                Perception(x=2, speed=4.5, nearby_turtles=5,
+                           pheromones={'home': 0.25}),
+                Perception(x=9, speed=4.5, nearby_turtles=5),
+            ]
+            decisions, library = run_kernel(compiled, perceptions, step=3)
+            self.assertEqual(library.similar2logo_kernel_abi_version(),
+                             ABI_VERSION)
+            for perception, decision in list(zip(perceptions, decisions))[:2]:
+                self.assertEqual(decision, behavior(perception))
+            # the random draws differ, within their range
+            self.assertTrue(-0.4 <= decisions[2][0] < 0.4)
+            self.assertAlmostEqual(decisions[2][1], 1.5 - 1.0)
+            # the same per step
+            self.assertEqual(run_kernel(compiled, perceptions, step=3)[0],
+                             decisions)
+
+            again = NativeBehavior(ant, pheromones=['food', 'home'])
+            self.assertTrue(again.compile(cache_dir=cache).cached)
+            other = NativeBehavior(steer).compile(cache_dir=cache)
+            self.assertNotEqual(other.path, compiled.path)
+            decisions, _ = run_kernel(other, [Perception(x=1, y=1),
+                                              Perception(heading=-1)])
+            self.assertAlmostEqual(decisions[0][0], math.pi / 4)
+            self.assertEqual(decisions[1], (0.5, 0.0))
+
+
+if __name__ == '__main__':
+    unittest.main()